@@ -19,6 +19,11 @@ local atk = require "ai.core.attack.util"
 local fmt = require "format"
 local scans = require "ai.core.misc.scans"
 
+-- Scratch vectors for the goals computed by the *_accurate functions, they
+-- are overwritten every call so they must not be stored.
+local __goal = vec2.new()
+local __goal0 = vec2.new()
+
 local __choose_land_target, __hyp_approach, __landgo, __moveto_generic, __run_target, __shoot_turret -- Forward-declared functions
 
 --[[
@@ -245,8 +250,6 @@ function follow( target )
    end
 end
 function follow_accurate( target )
-   local p = ai.pilot()
-
    -- Will just float without a target to escort.
    if not target:exists() then
       ai.poptask()
@@ -256,10 +259,8 @@ function follow_accurate( target )
    -- Stealth like whoever is being followed
    ai.stealth( target:flags("stealth") )
 
-   local goal = ai.follow_accurate(target, mem.radius,
-         mem.angle, mem.Kp, mem.Kd)
-
-   local mod = vec2.mod(goal - p:pos())
+   local goal, mod = ai.follow_accurate(target, mem.radius,
+         mem.angle, mem.Kp, mem.Kd, nil, __goal)
 
    --  Always face the goal
    local dir   = ai.face(goal)
@@ -292,8 +293,7 @@ function follow_fleet ()
       end
 
       local angle, radius, method = table.unpack(mem.form_pos)
-      local goal  = ai.follow_accurate(leader, radius, angle, mem.Kp, mem.Kd, method) -- Standard controller
-      local dist  = ai.dist(goal)
+      local goal, dist = ai.follow_accurate(leader, radius, angle, mem.Kp, mem.Kd, method, __goal) -- Standard controller
 
       if mem.app == 2 then
          local dir   = ai.face(goal)
@@ -309,8 +309,7 @@ function follow_fleet ()
          if dist > 300 then -- We're much too far away, we need to toggle large correction
             mem.app = 2
          else  -- Derivative-augmented controller
-            local goal0 = ai.follow_accurate(leader, radius, angle, 2*mem.Kp, 10*mem.Kd, method)
-            local dist0 = ai.dist(goal0)
+            local goal0, dist0 = ai.follow_accurate(leader, radius, angle, 2*mem.Kp, 10*mem.Kd, method, __goal0)
             local dir = ai.face(goal0)
             if dist0 > 300 then
                if dir < math.rad(10) then  -- Must approach
@@ -455,9 +454,8 @@ end
 --]]
 function runaway( target )
    if mem.mothership and mem.mothership:exists() then
-      local goal = ai.follow_accurate( mem.mothership, 0, 0, mem.Kp, mem.Kd )
+      local goal, dist = ai.follow_accurate( mem.mothership, 0, 0, mem.Kp, mem.Kd, nil, __goal )
       local dir  = ai.face( goal )
-      local dist = ai.dist( goal )
 
       if dist > 300 then
          if dir < math.rad(10) then
@@ -982,10 +980,9 @@ function mine_drill( ast )
    local _dist, angle = vec2.polar( p:pos() - target )
 
    -- First task : place the ship close to the asteroid
-   local goal = ai.face_accurate( target, vel, 0, angle, mem.Kp, mem.Kd )
+   local goal, mod = ai.face_accurate( target, vel, 0, angle, mem.Kp, mem.Kd, __goal )
 
    local dir  = ai.face(goal)
-   local mod  = ai.dist(goal)
 
    if dir < math.rad(10) and mod > mbd then
       ai.accel()
@@ -1032,17 +1029,16 @@ function mine_shoot( ast )
    local _dist, angle = vec2.polar( p:pos() - target )
 
    -- First task : place the ship close to the asteroid
-   local goal = ai.face_accurate( target, vel, trange, angle, mem.Kp, mem.Kd )
+   local goal, mod = ai.face_accurate( target, vel, trange, angle, mem.Kp, mem.Kd, __goal )
 
    local dir  = ai.face(goal)
-   local mod  = ai.dist(goal)
 
    if dir < math.rad(10) and mod > mbd then
       ai.accel()
    end
 
-   local relpos = vec2.add( p:pos(), vec2.mul(target,-1) ):mod()
-   local relvel = vec2.add( p:vel(), vec2.mul(vel,-1) ):mod()
+   local relpos = ai.dist( target )
+   local relvel = p:vel():dist( vel )
 
    if relpos < wrange and relvel < 10 then
       ai.pushsubtask("_killasteroid", ast )
@@ -1105,10 +1101,9 @@ function gather ()
       return
    end
 
-   local goal = ai.face_accurate( target, vel, 0, 0, mem.Kp, mem.Kd )
+   local goal, mod = ai.face_accurate( target, vel, 0, 0, mem.Kp, mem.Kd, __goal )
 
    local dir  = ai.face(goal)
-   local mod  = ai.dist(goal)
 
    if dir < math.rad(10) and mod > 100 then
       ai.accel()
@@ -1131,10 +1126,9 @@ function flyback( dock )
       ai.poptask()
       return
    end
-   local goal = ai.follow_accurate(target, 0, 0, mem.Kp, mem.Kd)
+   local goal, dist = ai.follow_accurate(target, 0, 0, mem.Kp, mem.Kd, nil, __goal)
 
    local dir  = ai.face( goal )
-   local dist = ai.dist( goal )
 
    if dist > 300 then
       if dir < math.rad(10) then
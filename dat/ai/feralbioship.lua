@@ -10,6 +10,9 @@ mem.atk_board     = false
 mem.comm_no       = _("No response.")
 mem.loiter        = math.huge
 
+-- Scratch vector for face_accurate, overwritten every call
+local __goal = vec2.new()
+
 function mine_bite( ast )
    if not ast:exists() then
       ai.poptask()
@@ -25,7 +28,7 @@ function mine_bite( ast )
    local _dist, angle = vec2.polar( p:pos() - target )
 
    -- First task : place the ship close to the asteroid
-   local goal = ai.face_accurate( target, vel, 0, angle, mem.Kp, mem.Kd )
+   local goal = ai.face_accurate( target, vel, 0, angle, mem.Kp, mem.Kd, __goal )
 
    local dir  = ai.face(goal)
    if dir < math.rad(20) then
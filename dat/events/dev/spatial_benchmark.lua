@@ -0,0 +1,80 @@
+--[[
+<?xml version='1.0' encoding='utf8'?>
+<event name="Spatial Index Benchmark">
+ <location>none</location>
+ <chance>0</chance>
+</event>
+--]]
+--[[
+   Compares the pilot spatial indices on the skirmish benchmark.
+   Trigger it with naev.eventStart("Spatial Index Benchmark")
+   When finishes, outputs a csv table that can be used directly
+--]]
+local TRIES = 10
+
+local tests = {}
+function create ()
+   table.insert( tests, { index="quadtree", cell_size=0 } )
+   for i,cell_size in ipairs{128,256,512,1024,2048} do
+      table.insert( tests, { index="grid", cell_size=cell_size } )
+   end
+   for k,t in ipairs(tests) do
+      t.avg = {}
+      t.wrst = {}
+      t.elapsed = {}
+   end
+
+   player.pilot():setPos( vec2.new(1e6, 1e6) )
+   player.pilot():setVel( vec2.new() )
+
+   hook.timer( 0, "donext" )
+   hook.custom( "benchmark", "donext" )
+end
+
+local function computestats( tbl )
+   local mean = 0
+   for k,v in ipairs(tbl) do
+      mean = mean + v
+   end
+   mean = mean / #tbl
+   local stddev = 0
+   for k,v in ipairs(tbl) do
+      stddev = stddev + (v-mean)^2
+   end
+   stddev = math.sqrt( stddev / (#tbl-1) )
+   return mean, stddev
+end
+
+local cur = 1
+function donext( data )
+   if type(data)=="table" then
+      table.insert( tests[cur].avg, data.avg )
+      table.insert( tests[cur].wrst, data.wrst )
+      table.insert( tests[cur].elapsed, data.elapsed )
+   end
+   if #tests[cur].avg >= TRIES then
+      cur = cur+1
+   end
+   local curtest = tests[ cur ]
+   if not curtest then
+      local csvfile = file.new("spatial_benchmark.csv")
+      csvfile:open("w")
+      local function log( msg )
+         print( msg )
+         csvfile:write( msg.."\n")
+      end
+      log("   index, cell_size,         avg,        wrst")
+      for k,t in ipairs(tests) do
+         local avg, avgstd = computestats( t.avg )
+         local wrst, wrststd = computestats( t.wrst )
+         log(string.format("%8s,% 10d, %.2f (%.1f), %.2f (%.1f)",
+            t.index, t.cell_size, avg, avgstd, wrst, wrststd ))
+      end
+      csvfile:close()
+      naev.spatialIndex( "quadtree" )
+      evt.finish()
+      return
+   end
+   naev.spatialIndex( curtest.index, curtest.cell_size )
+   naev.eventStart("Skirmish Benchmark") -- triggers a player.teleport that applies the spatial index
+end
@@ -1,10 +1,15 @@
 #include "lib/sdf.glsl"
 #include "lib/simplex.glsl"
 
+#ifdef SPFX_PARTICLE
+in float u_time;
+in float u_r;
+#else /* SPFX_PARTICLE */
 uniform float u_time = 0.0;
+uniform float u_r = 0.0;
+#endif /* SPFX_PARTICLE */
 uniform float u_speed = 1.0;
 uniform float u_grain = 1.0;
-uniform float u_r = 0.0;
 
 vec4 effect( vec4 unused, sampler2D tex, vec2 texture_coords, vec2 screen_coords )
 {
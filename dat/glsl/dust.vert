@@ -3,18 +3,54 @@ uniform vec3 dims;
 uniform vec3 screen;
 uniform vec2 offset_xy;
 uniform bool use_lines;
+uniform vec4 grid; /* Cell size, cells per row, cells per column, dust per cell. */
+uniform float lod;
 
-in vec4 vertex;
-in float brightness;
 out float brightness_geom;
 
+const int LAYERS = 4;
+
+/* Integer hash (lowbias32). */
+uint hash( uint x )
+{
+   x ^= x >> 16u;
+   x *= 0x7feb352du;
+   x ^= x >> 15u;
+   x *= 0x846ca68bu;
+   x ^= x >> 16u;
+   return x;
+}
+
+float hash_float( inout uint h )
+{
+   h = hash( h );
+   return float(h >> 8u) / 16777216.0;
+}
+
 void main(void) {
-   vec4 center = vertex;
-   float b = 1.0/(9.0 - 10.0*brightness);
-   center.xy += offset_xy * b;
-   center.xy = mod(center.xy + screen.xy/2.0, screen.xy) - screen.xy/2.0;
+   /* Dust is generated on a grid of cells covering the view of each layer. */
+   int id      = gl_VertexID;
+   int perlayer= int(grid.y*grid.z*grid.w);
+   int layer   = id / perlayer;
+   id         -= layer * perlayer;
+   int k       = id % int(grid.w);
+   int c       = id / int(grid.w);
+   vec2 cpos   = vec2( float(c % int(grid.y)), float(c / int(grid.y)) );
+
+   /* Layers get a base brightness, which gives their parallax. */
+   float base  = 0.2 + 0.6 * (float(layer)+0.5) / float(LAYERS);
+   float b     = 1.0/(9.0 - 10.0*base);
+   vec2 view   = -offset_xy * b;
+   vec2 cell   = floor( (view - screen.xy) / grid.x ) + cpos;
+
+   /* Everything about the dust comes from its cell and index. */
+   uint h = hash( uint(int(cell.x)) ^ hash( uint(int(cell.y)) ^ hash( uint(layer*65536 + k) ) ) );
+   vec2 pos    = (cell + vec2( hash_float(h), hash_float(h) )) * grid.x;
+   float brightness = clamp( base + (hash_float(h)-0.5) * 0.6 / float(LAYERS), 0.2, 0.8 );
+
+   /* Dust over the level of detail fades out. */
+   brightness *= clamp( (lod - hash_float(h)) * 20.0, 0.0, 1.0 );
 
-   /* Calculate position */
-   gl_Position = projection * center;
+   gl_Position = projection * vec4( pos - view, 0.0, 1.0 );
    brightness_geom = brightness;
 }
@@ -3,8 +3,13 @@
 #include "lib/gamma.glsl"
 
 /* Common uniforms for special effects. */
+#ifdef SPFX_PARTICLE
+in float u_time;              /**< Elapsed time. */
+in float u_r;                 /**< Random seed. */
+#else /* SPFX_PARTICLE */
 uniform float u_time = 0.0;   /**< Elapsed time. */
 uniform float u_r = 0.0;      /**< Random seed. */
+#endif /* SPFX_PARTICLE */
 
 /* Main constants. */
 const float CAM_DIST = 2.0;         /**< Distance of the camera from the origin. Defaults to 2.0. */
@@ -0,0 +1,16 @@
+uniform float alpha;
+
+in vec2 pos;
+in vec4 colour;
+in float paramf;
+out vec4 colour_out;
+
+/* Same as factiondisk.frag. */
+void main(void) {
+   colour_out = colour;
+   colour_out.a *= alpha;
+
+   float dist = length(pos);
+   colour_out.a *= exp( 1.0 / (dist+1.0) - 0.5) - 1.0;
+   colour_out.a *= smoothstep( 0.5*paramf, paramf, dist );
+}
@@ -0,0 +1,22 @@
+uniform mat4 projection;
+uniform vec2 offset;
+uniform float zoom;
+uniform float radius;
+
+in vec2 vertex_center;
+in vec2 vertex_corner;
+in float vertex_size;
+in vec4 vertex_colour;
+out vec2 pos;
+out vec4 colour;
+out float paramf;
+
+void main(void) {
+   float s     = vertex_size * zoom;
+   vec2 p      = offset + vertex_center * zoom + vertex_corner * s;
+
+   pos         = vertex_corner;
+   colour      = vertex_colour;
+   paramf      = radius / s;
+   gl_Position = projection * vec4( p, 0.0, 1.0 );
+}
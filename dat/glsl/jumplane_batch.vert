@@ -0,0 +1,30 @@
+uniform mat4 projection;
+uniform vec2 offset;
+uniform float zoom;
+
+in vec2 vertex_center;
+in vec2 vertex_corner;
+in vec2 vertex_dir;
+in float vertex_width;
+in vec4 vertex_colour;
+in vec4 vertex_colour2;
+out vec2 pos;
+out vec2 dimensions;
+out vec4 colour;
+out vec4 colour2;
+
+void main(void) {
+   /* Lane goes along the x axis, like rendering jumplane.frag rotated. */
+   vec2 d      = vertex_dir * zoom;
+   float l     = length(d);
+   vec2 u      = (l > 0.0) ? d / l : vec2( 1.0, 0.0 );
+   vec2 v      = vec2( -u.y, u.x );
+   vec2 p      = offset + vertex_center * zoom
+         + u * vertex_corner.x * l + v * vertex_corner.y * vertex_width;
+
+   pos         = vertex_corner;
+   dimensions  = vec2( l, vertex_width );
+   colour      = vertex_colour;
+   colour2     = vertex_colour2;
+   gl_Position = projection * vec4( p, 0.0, 1.0 );
+}
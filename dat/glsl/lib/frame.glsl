@@ -0,0 +1,11 @@
+#ifndef _FRAME_GLSL
+#define _FRAME_GLSL
+
+/* Per frame data, uploaded once per frame for all the shaders. */
+layout(std140) uniform NaevFrame {
+   vec4 naev_Time;   /* x: real time elapsed, y: duration of the frame. */
+   vec4 naev_Camera; /* xy: position of the camera, z: zoom. */
+   vec4 naev_Screen; /* xy: screen size, zw: screen size in real pixels. */
+};
+
+#endif /* _FRAME_GLSL */
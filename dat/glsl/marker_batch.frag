@@ -0,0 +1,49 @@
+#include "lib/sdf.glsl"
+
+in vec2 pos;
+in vec4 colour;
+in vec2 dimensions;
+in float shape;
+out vec4 colour_out;
+
+void main(void) {
+   float alpha, beta;
+   if (shape < 0.5) {
+      /* Pilot, same as pilotmarker.frag. */
+      vec2 uv = vec2( pos.y, pos.x );
+      float m = 1.0 / dimensions.x;
+      float d = sdTriangleEquilateral( uv*1.15  ) / 1.15;
+      d = abs(d+2.0*m);
+      alpha = smoothstep(    -m, 0.0, -d);
+      beta  = smoothstep(-2.0*m,  -m, -d);
+   }
+   else if (shape < 1.5) {
+      /* Asteroid, same as asteroidmarker.frag. */
+      vec2 uv = pos * dimensions;
+      float d = sdBox( uv, dimensions-vec2(2.0) );
+      alpha = smoothstep(-1.0,  0.0, -d);
+      beta  = smoothstep(-2.0, -1.0, -d);
+   }
+   else if (shape < 2.5) {
+      /* Stealth aura, same as stealthaura.frag. */
+      float m = 1.0 / dimensions.x;
+      float d = sdCircle( pos, 1.0-m );
+      colour_out = colour * smoothstep(-m, 0.0, -d) * length(pos);
+      return;
+   }
+   else if (shape < 3.5) {
+      /* Empty circle, same as circle.frag. */
+      float d = abs( sdCircle( pos*dimensions, dimensions.x-1.0 ) );
+      colour_out = colour;
+      colour_out.a *= smoothstep(-1.0, 0.0, -d);
+      return;
+   }
+   else {
+      /* Empty box, one pixel wide. */
+      float d = abs( sdBox( pos*dimensions, dimensions-vec2(1.0) ) );
+      colour_out = colour;
+      colour_out.a *= smoothstep(-1.0, 0.0, -d);
+      return;
+   }
+   colour_out = colour * vec4( vec3(alpha), beta );
+}
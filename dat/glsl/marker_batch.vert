@@ -0,0 +1,19 @@
+uniform mat4 projection;
+
+in vec4 vertex;
+in vec2 vertex_pos;
+in vec4 vertex_colour;
+in vec2 vertex_dim;
+in float vertex_shape;
+out vec2 pos;
+out vec4 colour;
+out vec2 dimensions;
+out float shape;
+
+void main(void) {
+   pos         = vertex_pos;
+   colour      = vertex_colour;
+   dimensions  = vertex_dim;
+   shape       = vertex_shape;
+   gl_Position = projection * vertex;
+}
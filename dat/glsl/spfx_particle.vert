@@ -0,0 +1,15 @@
+uniform float u_now;    /**< Current time of the particle ring. */
+
+in vec4 particle;       /**< Position and velocity at emission. */
+in vec3 particle_time;  /**< Emission time, death time and random seed. */
+out float time_geom;
+out float r_geom;
+
+void main(void) {
+   float age = u_now - particle_time.x;
+
+   /* Negative time marks dead particles, the geometry shader skips them. */
+   time_geom = (u_now < particle_time.y) ? age : -1.0;
+   r_geom = particle_time.z;
+   gl_Position = vec4( particle.xy + age*particle.zw, 0.0, 1.0 );
+}
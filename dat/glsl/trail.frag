@@ -20,17 +20,14 @@ subroutine uniform trail_func_prototype trail_func;
 
 // For ideas: https://thebookofshaders.com/05/
 
-uniform vec4 c1;  // Start colour
-uniform vec4 c2;  // End colour
-uniform float t1; // Start time [0,1]
-uniform float t2; // End time [0,1]
-uniform float dt; // Current time (in seconds)
-uniform vec2 pos1;// Start position
-uniform vec2 pos2;// End position
-uniform float r;  // Unique value per trail [0,1]
 uniform vec3 nebu_col; // Base colour of the nebula, only changes when entering new system
 
-in vec2 pos;
+in vec2 pos;      // Position within the segment [0,1]
+in vec4 colour;   // Colour
+in vec3 px;       // Length along the trail, start and end thickness
+in float t;       // Time [0,1]
+in float dt;      // Current time (in seconds)
+in float r;       // Unique value per trail [0,1]
 out vec4 colour_out;
 
 /* Has a peak at 1/k */
@@ -267,11 +264,11 @@ vec4 trail_split( vec4 colour, vec2 pos_tex, vec2 pos_px )
 void main(void) {
    vec2 pos_tex, pos_px;
 
-   // Interpolate
-   colour_out = mix( c1, c2, pos.x );
-   pos_px    = mix( pos1, pos2, pos );
-   pos_px.y *= pos.y;
-   pos_tex.x = mix( t1, t2, pos.x );
+   // Interpolated by the vertex stage
+   colour_out = colour;
+   pos_px.x  = px.x;
+   pos_px.y  = mix( px.y, px.z, pos.y ) * pos.y;
+   pos_tex.x = t;
    pos_tex.y = 2. * pos.y - 1.;
 
 #ifdef HAS_GL_ARB_shader_subroutine
@@ -0,0 +1,21 @@
+uniform mat4 projection;
+in vec4 vertex;         /**< Screen position and position within the segment. */
+in vec4 vertex_colour;  /**< Colour of the segment end. */
+in vec3 vertex_px;      /**< Length along the trail, start and end thickness. */
+in vec3 vertex_trail;   /**< Trail time, trail timer and unique value. */
+out vec2 pos;
+out vec4 colour;
+out vec3 px;
+out float t;
+out float dt;
+out float r;
+
+void main(void) {
+   pos      = vertex.zw;
+   colour   = vertex_colour;
+   px       = vertex_px;
+   t        = vertex_trail.x;
+   dt       = vertex_trail.y;
+   r        = vertex_trail.z;
+   gl_Position = projection * vec4( vertex.xy, 0.0, 1.0 );
+}
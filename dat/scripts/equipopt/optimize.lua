@@ -134,6 +134,76 @@ special_ships["Heavy Drone"] = function( p )
 end
 
 
+--[[
+      Cache of solved loadouts
+
+   Solving the linear program is the expensive part of equipping, and
+   spawns keep asking for the same ship with the same cores, outfits and
+   parameters. A few solutions are kept per key so the random component of
+   the objective still gives some variety once the cache is warm.
+--]]
+local loadout_cache = {}
+local loadout_cache_size = 0
+local LOADOUT_CACHE_VARIANTS = 4 -- Solutions kept per key
+local LOADOUT_CACHE_MAX = 256 -- Keys kept before the cache is flushed
+
+local function cache_serialize( t, out )
+   local keys = {}
+   for k in pairs(t) do
+      table.insert( keys, k )
+   end
+   table.sort( keys, function( a, b ) return tostring(a) < tostring(b) end )
+   for _i,k in ipairs(keys) do
+      local v = t[k]
+      table.insert( out, tostring(k) )
+      if type(v)=="table" then
+         table.insert( out, "{" )
+         cache_serialize( v, out )
+         table.insert( out, "}" )
+      else
+         table.insert( out, tostring(v) )
+      end
+   end
+end
+
+local function cache_key( ps, cores, outfit_list, params, nebu_vol )
+   local out = { ps:nameRaw(), tostring(nebu_vol) }
+   for k,v in ipairs(cores or {}) do
+      table.insert( out, tostring(v) )
+   end
+   table.insert( out, "|" )
+   for k,v in ipairs(outfit_list) do
+      table.insert( out, tostring(v) )
+   end
+   table.insert( out, "|" )
+   cache_serialize( params, out )
+   return table.concat( out, "\31" )
+end
+
+local function cache_add( key, loadout )
+   local c = loadout_cache[ key ]
+   if not c then
+      if loadout_cache_size >= LOADOUT_CACHE_MAX then
+         loadout_cache = {}
+         loadout_cache_size = 0
+      end
+      c = {}
+      loadout_cache[ key ] = c
+      loadout_cache_size = loadout_cache_size+1
+   end
+   if #c < LOADOUT_CACHE_VARIANTS then
+      table.insert( c, loadout )
+   end
+end
+
+local function cache_get( key )
+   local c = loadout_cache[ key ]
+   if not c or #c < LOADOUT_CACHE_VARIANTS then
+      return nil
+   end
+   return choose_one( c )
+end
+
 --[[
       Goodness functions to rank how good each outfits are
 --]]
@@ -290,6 +360,24 @@ function optimize.optimize( p, cores, outfit_list, params )
       end
    end
 
+   -- Reuse a previous solution if the problem would be the same
+   local _nebu_dens, nebu_vol = system.cur():nebula()
+   local ckey
+   if not pt.bioship and not params.noremove then
+      ckey = cache_key( ps, cores, outfit_list, params, nebu_vol )
+      local loadout = cache_get( ckey )
+      if loadout then
+         p:outfitsBatch( function ()
+            for k,o in ipairs(loadout) do
+               p:outfitAdd( o, 1, true )
+            end
+         end )
+         p:fillAmmo()
+         ai_setup.setup(p)
+         return true
+      end
+   end
+
    -- Global ship stuff
    local ss = p:shipstat( nil, true ) -- Should include cores!!
    local st = p:stats() -- also include cores
@@ -506,7 +594,6 @@ function optimize.optimize( p, cores, outfit_list, params )
       sworthy = sworthy + 1
    end
    -- For volatile systems we don't want ships to explode!
-   local _nebu_dens, nebu_vol = system.cur():nebula()
    if nebu_vol > 0 then
       sworthy = sworthy + 1
    end
@@ -695,6 +782,7 @@ function optimize.optimize( p, cores, outfit_list, params )
    local smod = 1
    local done
    local z, x, constraints
+   local loadout
    repeat
       try = try + 1
       done = true
@@ -744,17 +832,22 @@ function optimize.optimize( p, cores, outfit_list, params )
 
       -- Interpret results
       c = 1
-      for i,s in ipairs(slots) do
-         for j,o in ipairs(s.outfits) do
-            if x[c] == 1 then
-               local q = p:outfitAdd( o, 1, true )
-               if q < 1 then
-                  warn(string.format(_("Unable to equip outfit '%s' on '%s'!"), o,  p:name()))
+      loadout = {}
+      p:outfitsBatch( function ()
+         for i,s in ipairs(slots) do
+            for j,o in ipairs(s.outfits) do
+               if x[c] == 1 then
+                  local q = p:outfitAdd( o, 1, true )
+                  if q < 1 then
+                     warn(string.format(_("Unable to equip outfit '%s' on '%s'!"), o,  p:name()))
+                  else
+                     table.insert( loadout, o )
+                  end
                end
+               c = c + 1
             end
-            c = c + 1
          end
-      end
+      end )
 
       -- Due to the approximation, sometimes they end up with not enough
       -- energy, we'll try again with larger energy constraints
@@ -772,6 +865,9 @@ function optimize.optimize( p, cores, outfit_list, params )
       print_debug( p, st, ss, outfit_list, params, constraints, energygoal, emod, mmod, nebu_row, budget_row )
       return false
    end
+   if ckey then
+      cache_add( ckey, loadout )
+   end
 
    -- Fill ammo
    p:fillAmmo()
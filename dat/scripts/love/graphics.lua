@@ -155,8 +155,8 @@ function graphics.Image:draw( ... )
       h  = h * q.h
    end
    -- TODO be less horribly inefficient
-   local shader = graphics._shader or graphics._shader_default
-   shader = shader.shader
+   local gshader = graphics._shader or graphics._shader_default
+   local shader = gshader.shader
    local s1, s2, s3, s4
    local canvas = graphics._canvas
    if canvas then
@@ -171,7 +171,7 @@ function graphics.Image:draw( ... )
       s4 = 0.0
    end
    -- TODO properly solve this, what happens is it gets run before the window size gets set
-   shader:sendRaw( "love_ScreenSize", s1, s2, s3, s4 )
+   shader:sendRaw( gshader._screensize, s1, s2, s3, s4 )
 
    -- Get transformation and run
    local s = self.s
@@ -608,8 +608,10 @@ void main(void) {
    s.shader = naev.shader.new(
          prepend..frag..pixelcode,
          prepend..vert..vertexcode )
+   -- Drawing sets the screen size every time, so look it up only once
+   s._screensize = s.shader:uniform( "love_ScreenSize" )
    -- Set some default uniform values for when post-process shaders are used
-   s.shader:sendRaw( "love_ScreenSize", love.w, love.h, 1.0, 0.0 )
+   s.shader:sendRaw( s._screensize, love.w, love.h, 1.0, 0.0 )
    return s
 end
 function graphics.setShader( shader )
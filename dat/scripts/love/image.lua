@@ -49,12 +49,9 @@ function image.ImageData:setPixel( x, y, r, g, b, a )
    self.d:set( pos+3, a )
 end
 function image.ImageData:paste( source, dx, dy, sx, sy, sw, sh )
-   -- probably very slow
-   for y = 0,sh-1 do
-      local dstx = _id_pos(self, dx, dy+y )
-      local srcx = _id_pos(source, sx, sy+y )
-      self.d:paste( source.d, dstx, srcx, 4*sw )
-   end
+   local dstx = _id_pos(self, dx, dy )
+   local srcx = _id_pos(source, sx, sy )
+   self.d:paste( source.d, dstx, srcx, 4*sw, sh, 4*self.w, 4*source.w )
    return self
 end
 function image.ImageData:mapPixel( pixelFunction, x, y, width, height )
@@ -52,6 +52,15 @@
  * cleaned up in a garbage collector. This is to avoid accessing invalid task
  * memory.
  *
+ * Threading
+ *
+ *  All the AI runs on naevL. The movement and weapon commands are recorded
+ * and applied by ai_thinkFlush after every pilot has thought, but the scripts
+ * themselves can not be moved to other Lua states: the pilot memory and
+ * environments live in the naevL registry, and every profile goes through the
+ * common libraries in dat/ai/core, which use the pilot library (including
+ * calls that change the pilot like outfitToggle) and not just the ai module.
+ *
  * @note Nothing in this file can be considered reentrant.  Plan accordingly.
  *
  * @todo Clean up most of the code, it was written as one of the first
@@ -72,6 +81,7 @@
 #include "ai.h"
 
 #include "conf.h"
+#include "arena.h"
 #include "array.h"
 #include "board.h"
 #include "escort.h"
@@ -93,6 +103,7 @@
 #include "physics.h"
 #include "pilot.h"
 #include "player.h"
+#include "player_autonav.h"
 #include "rng.h"
 #include "space.h"
 
@@ -102,13 +113,20 @@
  * They can be used for stuff like movement or for pieces of code which might
  *  run AI stuff when the AI module is not reentrant.
  */
-#define ai_setFlag(f)   (pilot_flags |= f ) /**< Sets pilot flag f */
-#define ai_isFlag(f)    (pilot_flags & f ) /**< Checks pilot flag f */
+#define ai_setFlag(f)   (ai_cmd.flags |= f ) /**< Sets pilot flag f */
+#define ai_isFlag(f)    (ai_cmd.flags & f ) /**< Checks pilot flag f */
 /* flags */
 #define AI_PRIMARY      (1<<0)   /**< Firing primary weapon */
 #define AI_SECONDARY    (1<<1)   /**< Firing secondary weapon */
 #define AI_DISTRESS     (1<<2)   /**< Sent distress signal. */
 
+/*
+ * control tick budget
+ */
+#define AI_BUDGET_PRIORITY_RANGE 5000. /**< Pilots closer than this to the player get the full budget. */
+#define AI_BUDGET_RESERVE  0.25  /**< Fraction of the budget reserved for high priority pilots. */
+#define AI_BUDGET_DEFER_MAX 4    /**< Maximum amount of frames a control tick can be deferred. */
+
 /*
  * all the AI profiles
  */
@@ -116,6 +134,9 @@ static AI_Profile* profiles = NULL; /**< Array of AI_Profiles loaded. */
 static nlua_env equip_env = LUA_NOREF; /**< Equipment enviornment. */
 static IntList ai_qtquery; /**< Quadtree query. */
 static double ai_dt = 0.; /**< Current update tick, useful in some cases. **/
+static int ai_budgetUsed = 0; /**< Control ticks run this frame. */
+static Uint64 ai_controlTime = 0; /**< Performance counter ticks spent on control this frame, only for reporting. */
+static int ai_budgetDeferred = 0; /**< Number of control ticks deferred this frame. */
 
 /*
  * prototypes
@@ -127,10 +148,13 @@ static int ai_setMemory (void);
 static void ai_create( Pilot* pilot );
 static int ai_loadEquip (void);
 static int ai_sort( const void *p1, const void *p2 );
+static int ai_budgetDefer( const Pilot *p );
+static void ai_cmdApply( Pilot *p, double acc, double turn, int flags, const char *distressmsg );
 /* Task management. */
 static void ai_taskGC( Pilot* pilot );
 static Task* ai_createTask( lua_State *L, int subtask );
 static int ai_tasktarget( lua_State *L, const Task *t );
+static int ai_pushgoal( lua_State *L, int ind, const vec2 *goal, double dist );
 
 /*
  * AI routines for Lua
@@ -337,10 +361,34 @@ static const luaL_Reg aiL_methods[] = {
  * current pilot "thinking" and assorted variables
  */
 Pilot *cur_pilot           = NULL; /**< Current pilot.  All functions use this. */
-static double pilot_acc    = 0.; /**< Current pilot's acceleration. */
-static double pilot_turn   = 0.; /**< Current pilot's turning. */
-static int pilot_flags     = 0; /**< Handle stuff like weapon firing. */
-static char aiL_distressmsg[STRMAX_SHORT]; /**< Buffer to store distress message. */
+
+/**
+ * @brief Commands issued by the current pilot while thinking.
+ *
+ * The movement and weapon functions only record into the buffer. Once the
+ *  pilot is done thinking it is queued, and ai_thinkFlush replays all the
+ *  queued commands in a single pass after every pilot has thought, so no
+ *  pilot sees the result of another's decisions from the same frame.
+ */
+typedef struct AICommand_ {
+   double acc;    /**< Current pilot's acceleration. */
+   double turn;   /**< Current pilot's turning. */
+   int flags;     /**< Handle stuff like weapon firing. */
+   char distressmsg[STRMAX_SHORT]; /**< Buffer to store distress message. */
+} AICommand;
+static AICommand ai_cmd; /**< Command buffer of the current pilot. */
+
+/**
+ * @brief Command of a pilot waiting to be applied by ai_thinkFlush.
+ */
+typedef struct AICommandQueued_ {
+   unsigned int pilot; /**< ID of the pilot, it may be gone when flushed. */
+   double acc;         /**< Acceleration. */
+   double turn;        /**< Turning. */
+   int flags;          /**< Weapon firing and such. */
+   char *distressmsg;  /**< Distress message, only set with AI_DISTRESS. */
+} AICommandQueued;
+static AICommandQueued *ai_cmdQueue = NULL; /**< Commands waiting to be applied (array.h). */
 
 /*
  * ai status, used so that create functions can't be used elsewhere
@@ -438,37 +486,166 @@ void ai_unsetPilot( AIMemory oldmem )
  */
 void ai_thinkSetup( double dt )
 {
-   /* Clean up some variables */
-   pilot_acc   = 0.;
-   pilot_turn  = 0.;
-   pilot_flags = 0;
-   ai_dt       = dt;
+   /* Clean up the command buffer. */
+   ai_cmd.acc     = 0.;
+   ai_cmd.turn    = 0.;
+   ai_cmd.flags   = 0;
+   ai_dt          = dt;
+}
+
+/**
+ * @brief Resets the control tick budget, should be called every frame
+ *        before the pilots think.
+ */
+void ai_thinkBudgetStart (void)
+{
+   ai_budgetUsed     = 0;
+   ai_budgetDeferred = 0;
+   ai_controlTime    = 0;
 }
 
 /**
- * @brief Applies the result of thinking.
+ * @brief Finishes the control tick budget of the frame.
+ *
+ *    @return Number of control ticks that were deferred this frame.
+ */
+int ai_thinkBudgetEnd (void)
+{
+   NTracingPlotI( "ai_deferred", ai_budgetDeferred );
+   NTracingPlotI( "ai_control_ticks", ai_budgetUsed );
+   NTracingPlotF( "ai_control_ms", 1000. * (double)ai_controlTime / (double)SDL_GetPerformanceFrequency() );
+#if HAVE_TRACY
+   {
+      /* Size of the task queues, subtasks included. */
+      Pilot *const* pilots = pilot_getAll();
+      int ntasks = 0;
+      for (int i=0; i<array_size(pilots); i++)
+         for (const Task *t=pilots[i]->task; t!=NULL; t=t->next) {
+            ntasks++;
+            for (const Task *st=t->subtask; st!=NULL; st=st->next)
+               ntasks++;
+         }
+      NTracingPlotI( "ai_tasks", ntasks );
+   }
+#endif /* HAVE_TRACY */
+   return ai_budgetDeferred;
+}
+
+/**
+ * @brief Checks to see if a control tick should be deferred to the next frame.
+ *
+ * The budget is counted in control ticks rather than time, so that what
+ *  the AI does only depends on the game state and not on the machine. Pilots
+ *  in combat or near the player can use the entire budget, while the rest
+ *  leave a fraction of it untouched so the important pilots still get to
+ *  think when a lot of pilots are ticking at the same time.
+ *
+ *    @param p Pilot to check.
+ *    @return 1 if the control tick should be deferred.
+ */
+static int ai_budgetDefer( const Pilot *p )
+{
+   int budget;
+
+   if (conf.ai_budget <= 0)
+      return 0;
+
+   /* Never defer what the player controls or expects to respond directly. */
+   if (pilot_isFlag(p, PILOT_PLAYER) || pilot_isFlag(p, PILOT_MANUAL_CONTROL))
+      return 0;
+
+   /* Don't starve pilots. */
+   if (p->tcontrol_deferred >= AI_BUDGET_DEFER_MAX)
+      return 0;
+
+   budget = conf.ai_budget;
+   if (!pilot_isFlag(p, PILOT_COMBAT) && ((player.p == NULL) ||
+         (vec2_dist2( &p->solid.pos, &player.p->solid.pos ) >
+          pow2(AI_BUDGET_PRIORITY_RANGE))))
+      budget = MAX( 1, (int)(budget * (1.-AI_BUDGET_RESERVE)) );
+
+   return (ai_budgetUsed >= budget);
+}
+
+/**
+ * @brief Applies a command to a pilot.
  *
  *    @param p Pilot to apply to.
+ *    @param acc Acceleration to set.
+ *    @param turn Turning to set.
+ *    @param flags Weapon firing and such to do.
+ *    @param distressmsg Distress message if AI_DISTRESS is set.
  */
-void ai_thinkApply( Pilot *p )
+static void ai_cmdApply( Pilot *p, double acc, double turn, int flags, const char *distressmsg )
 {
-   /* Make sure pilot_acc and pilot_turn are legal */
-   pilot_acc   = CLAMP( -PILOT_REVERSE_THRUST*p->stats.misc_reverse_thrust, 1., pilot_acc );
-   pilot_turn  = CLAMP( -1., 1., pilot_turn );
+   /* Make sure acceleration and turning are legal */
+   acc  = CLAMP( -PILOT_REVERSE_THRUST*p->stats.misc_reverse_thrust, 1., acc );
+   turn = CLAMP( -1., 1., turn );
 
    /* Set turn and accel. */
-   pilot_setTurn( p, pilot_turn );
-   pilot_setAccel( p, pilot_acc );
+   pilot_setTurn( p, turn );
+   pilot_setAccel( p, acc );
 
    /* fire weapons if needed */
-   if (ai_isFlag(AI_PRIMARY))
+   if (flags & AI_PRIMARY)
       pilot_shoot(p, 0); /* primary */
-   if (ai_isFlag(AI_SECONDARY))
+   if (flags & AI_SECONDARY)
       pilot_shoot(p, 1 ); /* secondary */
 
    /* other behaviours. */
-   if (ai_isFlag(AI_DISTRESS))
-      pilot_distress(p, NULL, aiL_distressmsg);
+   if (flags & AI_DISTRESS)
+      pilot_distress(p, NULL, distressmsg);
+}
+
+/**
+ * @brief Applies the result of thinking right away.
+ *
+ * Used by thinking outside of the pilot update, like autonav.
+ *
+ *    @param p Pilot to apply to.
+ */
+void ai_thinkApply( Pilot *p )
+{
+   ai_cmdApply( p, ai_cmd.acc, ai_cmd.turn, ai_cmd.flags, ai_cmd.distressmsg );
+}
+
+/**
+ * @brief Queues the result of thinking to be applied by ai_thinkFlush.
+ *
+ *    @param p Pilot that thought.
+ */
+static void ai_thinkQueue( const Pilot *p )
+{
+   AICommandQueued *q;
+
+   if (ai_cmdQueue == NULL)
+      ai_cmdQueue = array_create( AICommandQueued );
+   q = &array_grow( &ai_cmdQueue );
+   q->pilot = p->id;
+   q->acc   = ai_cmd.acc;
+   q->turn  = ai_cmd.turn;
+   q->flags = ai_cmd.flags;
+   q->distressmsg = ai_isFlag(AI_DISTRESS) ? strdup( ai_cmd.distressmsg ) : NULL;
+}
+
+/**
+ * @brief Applies the commands of all the pilots that thought.
+ *
+ * Should be called once every pilot is done thinking for the frame, it runs
+ *  single-threaded in the order the pilots thought.
+ */
+void ai_thinkFlush (void)
+{
+   if (ai_cmdQueue == NULL)
+      return;
+   for (int i=0; i<array_size(ai_cmdQueue); i++) {
+      AICommandQueued *q = &ai_cmdQueue[i];
+      Pilot *p = pilot_get( q->pilot );
+      if ((p != NULL) && !pilot_isFlag(p, PILOT_DELETE))
+         ai_cmdApply( p, q->acc, q->turn, q->flags, q->distressmsg );
+      free( q->distressmsg );
+   }
+   array_erase( &ai_cmdQueue, array_begin(ai_cmdQueue), array_end(ai_cmdQueue) );
 }
 
 /**
@@ -712,6 +889,7 @@ static int ai_loadProfile( AI_Profile *prof, const char* filename )
 
    /* Create Lua. */
    env = nlua_newEnv();
+   nlua_setEnvName( env, "ai/%s", prof->name );
    nlua_loadStandard(env);
    prof->env = env;
 
@@ -798,6 +976,12 @@ void ai_exit (void)
 
    /* Clean up query stuff. */
    il_destroy( &ai_qtquery );
+
+   /* Drop the commands that were never applied. */
+   for (int i=0; i<array_size(ai_cmdQueue); i++)
+      free( ai_cmdQueue[i].distressmsg );
+   array_free( ai_cmdQueue );
+   ai_cmdQueue = NULL;
 }
 
 /**
@@ -835,10 +1019,16 @@ void ai_think( Pilot* pilot, double dt, int dotask )
    /* Get current task. */
    t = ai_curTask( cur_pilot );
 
-   /* control function if pilot is idle or tick is up */
-   if ((cur_pilot->tcontrol < 0.) || (t == NULL)) {
+   /* control function if pilot is idle or tick is up, unless over budget
+    * in which case it's tried again next frame */
+   if (((cur_pilot->tcontrol < 0.) || (t == NULL)) && ai_budgetDefer( cur_pilot )) {
+      cur_pilot->tcontrol_deferred++;
+      ai_budgetDeferred++;
+   }
+   else if ((cur_pilot->tcontrol < 0.) || (t == NULL)) {
       NTracingZoneName( _ctx_control, "ai_think[control]", 1 );
 
+      Uint64 tstart = SDL_GetPerformanceCounter();
       double crate = cur_pilot->ai->control_rate;
       if (pilot_isFlag(pilot,PILOT_PLAYER) ||
           pilot_isFlag(cur_pilot, PILOT_MANUAL_CONTROL)) {
@@ -852,10 +1042,17 @@ void ai_think( Pilot* pilot, double dt, int dotask )
       }
       /* Try to desync control ticks when possible by adding randomness. */
       cur_pilot->tcontrol = crate * (0.9+0.2*RNGF());
+      /* Nothing needs quick reactions while autonav fast forwards. */
+      if (player_autonavFastForward() && !pilot_isFlag(pilot,PILOT_PLAYER))
+         cur_pilot->tcontrol *= AUTONAV_FF_AI_RATE;
+      cur_pilot->tcontrol_deferred = 0;
 
       /* Task may have changed due to control tick. */
       t = ai_curTask( cur_pilot );
 
+      ai_budgetUsed++;
+      ai_controlTime += SDL_GetPerformanceCounter() - tstart;
+
       NTracingZoneEnd( _ctx_control );
    }
 
@@ -900,8 +1097,8 @@ void ai_think( Pilot* pilot, double dt, int dotask )
       NTracingZoneEnd( _ctx_task );
    }
 
-   /* Applies local variables to the pilot. */
-   ai_thinkApply( cur_pilot );
+   /* Applied once every pilot has thought. */
+   ai_thinkQueue( cur_pilot );
 
    /* Restore memory. */
    ai_unsetPilot( oldmem );
@@ -1270,6 +1467,24 @@ static int ai_tasktarget( lua_State *L, const Task *t )
    return 1;
 }
 
+/**
+ * @brief Pushes a goal computed by the *_accurate functions and its distance.
+ *
+ * If there is a vector at ind, the goal is written into it instead of creating
+ *  a new one.
+ */
+static int ai_pushgoal( lua_State *L, int ind, const vec2 *goal, double dist )
+{
+   if (lua_isvector(L,ind)) {
+      *lua_tovector(L,ind) = *goal;
+      lua_pushvalue(L,ind);
+   }
+   else
+      lua_pushvector( L, *goal );
+   lua_pushnumber( L, dist );
+   return 2;
+}
+
 /**
  * @defgroup AI Lua AI Bindings
  *
@@ -1774,7 +1989,7 @@ static int aiL_scandone( lua_State *L )
 static int aiL_accel( lua_State *L )
 {
    double n = luaL_optnumber( L, 1, 1. );
-   pilot_acc = CLAMP( 0., 1., n );
+   ai_cmd.acc = CLAMP( 0., 1., n );
    return 0;
 }
 
@@ -1786,7 +2001,7 @@ static int aiL_accel( lua_State *L )
  */
 static int aiL_turn( lua_State *L )
 {
-   pilot_turn = luaL_checknumber(L,1);
+   ai_cmd.turn = luaL_checknumber(L,1);
    return 0;
 }
 
@@ -1827,7 +2042,7 @@ static int aiL_face( lua_State *L )
       double d = lua_tonumber(L,1);
       diff = angle_diff( cur_pilot->solid.dir, d );
       /* Make pilot turn. */
-      pilot_turn = k_diff * diff;
+      ai_cmd.turn = k_diff * diff;
       /* Return angle away from target. */
       lua_pushnumber(L, ABS(diff));
       return 1;
@@ -1871,7 +2086,7 @@ static int aiL_face( lua_State *L )
    diff = angle_diff( cur_pilot->solid.dir, atan2( dy, dx ) );
 
    /* Make pilot turn. */
-   pilot_turn = k_diff * diff;
+   ai_cmd.turn = k_diff * diff;
 
    /* Return angle away from target. */
    lua_pushnumber(L, ABS(diff));
@@ -1977,7 +2192,7 @@ static int aiL_careful_face( lua_State *L )
    diff = angle_diff( cur_pilot->solid.dir, VANGLE(F) );
 
    /* Make pilot turn. */
-   pilot_turn = k_diff * diff;
+   ai_cmd.turn = k_diff * diff;
 
    /* Return angle away from target. */
    lua_pushnumber(L, ABS(diff));
@@ -2009,7 +2224,7 @@ static int aiL_aim( lua_State *L )
    /* Calculate what we need to turn */
    mod = 1./(cur_pilot->turn*ai_dt);
    diff = angle_diff(cur_pilot->solid.dir, angle);
-   pilot_turn = mod * diff;
+   ai_cmd.turn = mod * diff;
 
    lua_pushnumber(L, ABS(diff));
    return 1;
@@ -2069,7 +2284,7 @@ static int aiL_iface( lua_State *L )
          number will give a more dramatic 'lead' */
       double speedmap = -copysign(1. - 1. / (FABS(drift_azimuthal/200.) + 1.), drift_azimuthal) * M_PI_2;
       diff = angle_diff(heading_offset_azimuth, speedmap);
-      pilot_turn = -diff / (ai_dt * cur_pilot->turn);
+      ai_cmd.turn = -diff / (ai_dt * cur_pilot->turn);
    }
    /* turn most efficiently to face the target. If we intercept the correct quadrant in the UV plane first, then the code above will kick in */
    /* some special case logic is added to optimize turn time. Reducing this to only the else cases would speed up the operation
@@ -2077,7 +2292,7 @@ static int aiL_iface( lua_State *L )
    else {
       /* signal that we're not in a productive direction for accelerating */
       diff = M_PI;
-      pilot_turn = heading_offset_azimuth / (ai_dt * cur_pilot->turn);
+      ai_cmd.turn = heading_offset_azimuth / (ai_dt * cur_pilot->turn);
    }
 
    /* Return angle in degrees away from target. */
@@ -2226,11 +2441,11 @@ static int aiL_brake( lua_State *L )
    }
 
    diff = angle_diff( cur_pilot->solid.dir, dir );
-   pilot_turn = diff / (cur_pilot->turn * ai_dt);
+   ai_cmd.turn = diff / (cur_pilot->turn * ai_dt);
    if (ABS(diff) < MIN_DIR_ERR)
-      pilot_acc = accel;
+      ai_cmd.acc = accel;
    else
-      pilot_acc = 0.;
+      ai_cmd.acc = 0.;
    lua_pushboolean(L, 0);
    return 1;
 }
@@ -2357,8 +2572,8 @@ static int aiL_getlandspob( lua_State *L )
    /* Check if we should get only friendlies. */
    only_friend = lua_toboolean(L, 1);
 
-   /* Allocate memory. */
-   ind = array_create_size( int, array_size(cur_system->spobs) );
+   /* Allocate memory, only needed for this frame. */
+   ind = array_create_arena( int, array_size(cur_system->spobs), arena_frame() );
 
    /* Copy friendly spob.s */
    for (int i=0; i<array_size(cur_system->spobs); i++) {
@@ -2380,10 +2595,8 @@ static int aiL_getlandspob( lua_State *L )
    }
 
    /* no spob to land on found */
-   if (array_size(ind)==0) {
-      array_free(ind);
+   if (array_size(ind)==0)
       return 0;
-   }
 
    /* we can actually get a random spob now */
    id = RNG(0,array_size(ind)-1);
@@ -2391,7 +2604,6 @@ static int aiL_getlandspob( lua_State *L )
    spob = p->id;
    lua_pushspob( L, spob );
    cur_pilot->nav_spob = ind[ id ];
-   array_free(ind);
 
    return 1;
 }
@@ -2620,9 +2832,9 @@ static int aiL_rndhyptarget( lua_State *L )
 
    useshidden = faction_usesHiddenJumps( cur_pilot->faction );
 
-   /* Find usable jump points. */
-   jumps = array_create_size( JumpPoint*, array_size(cur_system->jumps) );
-   id    = array_create_size( int, array_size(cur_system->jumps) );
+   /* Find usable jump points, only needed for this frame. */
+   jumps = array_create_arena( JumpPoint*, array_size(cur_system->jumps), arena_frame() );
+   id    = array_create_arena( int, array_size(cur_system->jumps), arena_frame() );
    for (int i=0; i < array_size(cur_system->jumps); i++) {
       JumpPoint *jiter = &cur_system->jumps[i];
 
@@ -2663,10 +2875,6 @@ static int aiL_rndhyptarget( lua_State *L )
    lj.destid = jumps[r]->targetid;
    lj.srcid = cur_system->id;
 
-   /* Clean up. */
-   array_free(jumps);
-   array_free(id);
-
    /* Return Jump. */
    lua_pushjump( L, lj );
    return 1;
@@ -2740,7 +2948,9 @@ static int aiL_relvel( lua_State *L )
  *    @luatparam[opt=10.] number Kp The first controller parameter
  *    @luatparam[opt=20.] number Kd The second controller parameter
  *    @luatparam[opt] string method Method to compute goal angle
- *    @luareturn The point to go to as a vector2.
+ *    @luatparam[opt] Vec2 out Vector to store the goal in instead of creating a new one.
+ *    @luatreturn Vec2 The point to go to.
+ *    @luatreturn number Distance from the pilot to the point.
  * @luafunc follow_accurate
  */
 static int aiL_follow_accurate( lua_State *L )
@@ -2780,10 +2990,7 @@ static int aiL_follow_accurate( lua_State *L )
    vec2_cset( &goal, cons.x + p->solid.pos.x, cons.y + p->solid.pos.y);
 
    /* Push info */
-   lua_pushvector( L, goal );
-
-   return 1;
-
+   return ai_pushgoal( L, 7, &goal, VMOD(cons) );
 }
 
 /**
@@ -2795,7 +3002,9 @@ static int aiL_follow_accurate( lua_State *L )
  *    @luatparam[opt=0.] number angle The requested angle between p and target (radians)
  *    @luatparam[opt=10.] number Kp The first controller parameter
  *    @luatparam[opt=20.] number Kd The second controller parameter
- *    @luareturn The point to go to as a vector2.
+ *    @luatparam[opt] Vec2 out Vector to store the goal in instead of creating a new one.
+ *    @luatreturn Vec2 The point to go to.
+ *    @luatreturn number Distance from the pilot to the point.
  * @luafunc face_accurate
  */
 static int aiL_face_accurate( lua_State *L )
@@ -2823,10 +3032,7 @@ static int aiL_face_accurate( lua_State *L )
    vec2_cset( &goal, cons.x + p->solid.pos.x, cons.y + p->solid.pos.y);
 
    /* Push info */
-   lua_pushvector( L, goal );
-
-   return 1;
-
+   return ai_pushgoal( L, 7, &goal, VMOD(cons) );
 }
 
 /**
@@ -3322,9 +3528,9 @@ static int aiL_shoot_indicator( lua_State *L )
 static int aiL_distress( lua_State *L )
 {
    if (lua_isstring(L,1))
-      snprintf( aiL_distressmsg, sizeof(aiL_distressmsg), "%s", lua_tostring(L,1) );
+      snprintf( ai_cmd.distressmsg, sizeof(ai_cmd.distressmsg), "%s", lua_tostring(L,1) );
    else if (lua_isnoneornil(L,1))
-      aiL_distressmsg[0] = '\0';
+      ai_cmd.distressmsg[0] = '\0';
    else
       NLUA_INVALID_PARAMETER(L,1);
 
@@ -97,6 +97,9 @@ void ai_getDistress( const Pilot *p, const Pilot *distressed, const Pilot *attac
 void ai_think( Pilot* pilot, double dt, int dotask );
 AIMemory ai_setPilot( Pilot *p );
 void ai_unsetPilot( AIMemory oldmem );
+void ai_thinkBudgetStart (void);
+int ai_thinkBudgetEnd (void);
 void ai_thinkSetup( double dt );
 void ai_thinkApply( Pilot *p );
+void ai_thinkFlush (void);
 void ai_init( Pilot *p );
@@ -0,0 +1,220 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file arena.c
+ *
+ * @brief Linear arena allocators.
+ *
+ * Arenas hand out memory from large chunks and release it all at once when
+ *  reset, so temporaries don't fragment the heap. The frame arena is reset at
+ *  the end of every top level frame in main_loop and is meant for data that
+ *  does not outlive the frame. Other arenas can be created for data with a
+ *  known lifetime, such as the temporaries of loading.
+ *
+ * When reset, the chunks of an arena are merged into a single one large
+ *  enough for everything they held, so that arenas with a steady use settle
+ *  on one chunk.
+ */
+/** @cond */
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "arena.h"
+
+#include "ntracing.h"
+
+#define ARENA_ALIGN     alignof(max_align_t) /**< Alignment of all the allocations. */
+#define ARENA_HEADER    ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1)) /**< Space taken by the chunk header. */
+
+static Arena *arena_frame_arena = NULL; /**< Arena for the temporaries of the current frame. */
+
+/*
+ * Prototypes.
+ */
+static ArenaChunk *arena_chunkNew( Arena *a, size_t size );
+static void arena_chunksFree( Arena *a );
+
+/**
+ * @brief Gets the data of a chunk.
+ */
+static inline char *arena_chunkData( ArenaChunk *c )
+{
+   return (char*)c + ARENA_HEADER;
+}
+
+/**
+ * @brief Adds a new chunk to an arena.
+ */
+static ArenaChunk *arena_chunkNew( Arena *a, size_t size )
+{
+   ArenaChunk *c;
+   size = MAX( size, a->chunk_size );
+   c = nmalloc( ARENA_HEADER + size );
+   c->next = a->chunks;
+   c->size = size;
+   c->used = 0;
+   a->chunks = c;
+   a->reserved += size;
+   return c;
+}
+
+/**
+ * @brief Frees all the chunks of an arena.
+ */
+static void arena_chunksFree( Arena *a )
+{
+   ArenaChunk *c = a->chunks;
+   while (c != NULL) {
+      ArenaChunk *next = c->next;
+      nfree( c );
+      c = next;
+   }
+   a->chunks   = NULL;
+   a->reserved = 0;
+}
+
+/**
+ * @brief Creates an arena.
+ *
+ *    @param name Name of the arena for the statistics, must be a string literal.
+ *    @param chunk_size Minimum size of the chunks, 0 for the default.
+ *    @return The new arena.
+ */
+Arena *arena_create( const char *name, size_t chunk_size )
+{
+   Arena *a = calloc( 1, sizeof(Arena) );
+   a->name       = name;
+   a->chunk_size = (chunk_size > 0) ? chunk_size : ARENA_CHUNK_DEFAULT;
+   return a;
+}
+
+/**
+ * @brief Destroys an arena and everything allocated from it.
+ */
+void arena_destroy( Arena *a )
+{
+   if (a == NULL)
+      return;
+   arena_chunksFree( a );
+   free( a );
+}
+
+/**
+ * @brief Allocates memory from an arena.
+ *
+ *    @param a Arena to allocate from.
+ *    @param size Size to allocate.
+ *    @return Memory aligned for any type, valid until the arena is reset.
+ */
+void *arena_alloc( Arena *a, size_t size )
+{
+   ArenaChunk *c = a->chunks;
+   void *ptr;
+
+   size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+   if ((c == NULL) || (c->size - c->used < size))
+      c = arena_chunkNew( a, size );
+
+   ptr = arena_chunkData( c ) + c->used;
+   c->used += size;
+   a->used += size;
+   a->peak  = MAX( a->peak, a->used );
+   a->last  = ptr;
+   return ptr;
+}
+
+/**
+ * @brief Grows memory allocated from an arena.
+ *
+ * The last allocation is grown in place when it fits in its chunk, otherwise
+ *  the data is copied to a new allocation. Shrinking does nothing.
+ *
+ *    @param a Arena the memory was allocated from.
+ *    @param ptr Memory to grow, or NULL to allocate.
+ *    @param oldsize Size of the memory.
+ *    @param size New size.
+ *    @return The grown memory.
+ */
+void *arena_realloc( Arena *a, void *ptr, size_t oldsize, size_t size )
+{
+   void *newptr;
+
+   if (ptr == NULL)
+      return arena_alloc( a, size );
+   if (size <= oldsize)
+      return ptr;
+
+   /* Last allocation can be grown in place. */
+   if ((ptr == a->last) && (a->chunks != NULL)) {
+      ArenaChunk *c = a->chunks;
+      size_t start = (char*)ptr - arena_chunkData( c );
+      size_t end   = (start + size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+      if (end <= c->size) {
+         a->used += end - c->used;
+         a->peak  = MAX( a->peak, a->used );
+         c->used  = end;
+         return ptr;
+      }
+   }
+
+   newptr = arena_alloc( a, size );
+   memcpy( newptr, ptr, oldsize );
+   return newptr;
+}
+
+/**
+ * @brief Releases everything allocated from an arena.
+ *
+ *    @param a Arena to reset.
+ */
+void arena_reset( Arena *a )
+{
+   NTracingPlotI( a->name, (int64_t)a->used );
+
+   /* Merge the chunks so the next use fits in one. */
+   if ((a->chunks != NULL) && (a->chunks->next != NULL)) {
+      size_t reserved = a->reserved;
+      arena_chunksFree( a );
+      arena_chunkNew( a, reserved );
+   }
+   else if (a->chunks != NULL)
+      a->chunks->used = 0;
+   a->used = 0;
+   a->last = NULL;
+}
+
+/**
+ * @brief Gets the arena for the temporaries of the current frame.
+ *
+ * Only to be used from the main thread, and not for anything that has to
+ *  survive past the end of the frame.
+ */
+Arena *arena_frame (void)
+{
+   if (arena_frame_arena == NULL)
+      arena_frame_arena = arena_create( "arena_frame", 0 );
+   return arena_frame_arena;
+}
+
+/**
+ * @brief Releases the temporaries of the frame.
+ */
+void arena_frameReset (void)
+{
+   if (arena_frame_arena != NULL)
+      arena_reset( arena_frame_arena );
+}
+
+/**
+ * @brief Frees the frame arena.
+ */
+void arena_exit (void)
+{
+   arena_destroy( arena_frame_arena );
+   arena_frame_arena = NULL;
+}
@@ -0,0 +1,46 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+#define ARENA_CHUNK_DEFAULT   (64*1024) /**< Default size of the chunks of an arena. */
+
+/**
+ * @brief Chunk of memory of an arena.
+ */
+typedef struct ArenaChunk_ {
+   struct ArenaChunk_ *next; /**< Previous chunk, NULL if it is the first. */
+   size_t size;              /**< Usable size of the chunk. */
+   size_t used;              /**< Bytes allocated from the chunk. */
+} ArenaChunk;
+
+/**
+ * @brief Linear allocator, everything it allocated is released at once.
+ *
+ * Not thread-safe, each arena must only be used by a single thread at a time.
+ */
+typedef struct Arena_ {
+   const char *name;    /**< Name used for the statistics, must be a string literal. */
+   ArenaChunk *chunks;  /**< Chunk being allocated from, linked to the previous ones. */
+   size_t chunk_size;   /**< Minimum size of new chunks. */
+   void *last;          /**< Last allocation, which can be grown in place. */
+   size_t used;         /**< Bytes currently allocated. */
+   size_t reserved;     /**< Bytes currently reserved in chunks. */
+   size_t peak;         /**< Most bytes allocated between two resets. */
+} Arena;
+
+/* Arenas. */
+Arena *arena_create( const char *name, size_t chunk_size );
+void arena_destroy( Arena *a );
+void *arena_alloc( Arena *a, size_t size );
+void *arena_realloc( Arena *a, void *ptr, size_t oldsize, size_t size );
+void arena_reset( Arena *a );
+
+/* Frame arena. */
+Arena *arena_frame (void);
+void arena_frameReset (void);
+void arena_exit (void);
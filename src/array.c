@@ -12,36 +12,60 @@
 
 #include "array.h"
 
+#include "arena.h"
 #include "nstring.h"
 #include "ntracing.h"
 
 void *_array_create_helper(size_t e_size, size_t capacity)
 {
+   return _array_create_arena_helper( e_size, capacity, NULL );
+}
+
+void *_array_create_arena_helper(size_t e_size, size_t capacity, Arena *arena)
+{
+   _private_container *c;
+
    if ( capacity <= 0 )
       capacity = 1;
 
-   _private_container *c = nmalloc( sizeof(_private_container) + e_size * capacity );
+   if (arena != NULL)
+      c = arena_alloc( arena, sizeof(_private_container) + e_size * capacity );
+   else
+      c = nmalloc( sizeof(_private_container) + e_size * capacity );
 
 #if DEBUG_ARRAYS
    c->_sentinel = ARRAY_SENTINEL;
 #endif
    c->_reserved = capacity;
    c->_size = 0;
+   c->_arena = arena;
    return c->_array;
 }
 
+/**
+ * @brief Reallocates a container to its reserved size, from where it was allocated.
+ */
+static _private_container *_array_realloc_container(_private_container *c, size_t e_size, size_t old_reserved)
+{
+   if (c->_arena != NULL)
+      return arena_realloc( c->_arena, c, sizeof(_private_container) + e_size * old_reserved,
+            sizeof(_private_container) + e_size * c->_reserved );
+   return nrealloc( c, sizeof(_private_container) + e_size * c->_reserved );
+}
+
 static void _array_resize_container(_private_container **c_, size_t e_size, size_t new_size)
 {
    assert( new_size <= (size_t)INT_MAX );
    _private_container *c = *c_;
 
    if (new_size > c->_reserved) {
+      size_t old_reserved = c->_reserved;
       /* increases the reserved space */
       do
          c->_reserved *= 2;
       while (new_size > c->_reserved);
 
-      c = nrealloc( c, sizeof(_private_container) + e_size * c->_reserved );
+      c = _array_realloc_container( c, e_size, old_reserved );
    }
 
    c->_size = new_size;
@@ -61,7 +85,7 @@ void *_array_grow_helper(void **a, size_t e_size)
    if (c->_size == c->_reserved) {
       /* Array full, doubles the reserved memory */
       c->_reserved *= 2;
-      c = nrealloc( c, sizeof(_private_container) + e_size * c->_reserved );
+      c = _array_realloc_container( c, e_size, c->_size );
       *a = c->_array;
    }
 
@@ -87,6 +111,9 @@ void _array_erase_helper(void **a, size_t e_size, void *first, void *last)
 void _array_shrink_helper(void **a, size_t e_size)
 {
    _private_container *c = _array_private_container(*a);
+   /* Arena memory can't be given back. */
+   if (c->_arena != NULL)
+      return;
    if (c->_size != 0) {
       c = nrealloc( c, sizeof(_private_container) + e_size * c->_size );
       c->_reserved = c->_size;
@@ -101,7 +128,11 @@ void _array_free_helper(void *a)
 {
    if (a==NULL)
       return;
-   nfree( _array_private_container(a) );
+   _private_container *c = _array_private_container(a);
+   /* Released with the arena. */
+   if (c->_arena != NULL)
+      return;
+   nfree( c );
 }
 
 void *_array_copy_helper(size_t e_size, void *a)
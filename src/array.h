@@ -32,6 +32,10 @@
  * array_free( my_array );
  * my_array = NULL;
  * @endcode
+ *
+ * Arrays can also be created in an arena (arena.h), for example the frame
+ * arena for temporaries. Their memory is then released when the arena is
+ * reset, and array_free and array_shrink do nothing on them.
  */
 #pragma once
 
@@ -46,6 +50,8 @@
 
 #define ARRAY_SENTINEL 0x15bada55 /**< Badass sentinel. */
 
+struct Arena_;
+
 /**
  * @brief Private container type for the arrays.
  */
@@ -55,10 +61,12 @@ typedef struct {
 #endif /* DEBUG_ARRAYS */
    size_t _reserved;      /**< Number of elements reserved */
    size_t _size;          /**< Number of elements in the array */
+   struct Arena_ *_arena; /**< Arena the array lives in, NULL for the heap. */
    char alignas(max_align_t) _array[];  /**< Begin of the array */
 } _private_container;
 
 void *_array_create_helper(size_t e_size, size_t initial_size);
+void *_array_create_arena_helper(size_t e_size, size_t initial_size, struct Arena_ *arena);
 void *_array_grow_helper(void **a, size_t e_size);
 void _array_resize_helper(void **a, size_t e_size, size_t new_size);
 void _array_erase_helper(void **a, size_t e_size, void *first, void *last);
@@ -101,6 +109,17 @@ static inline _private_container *_array_private_container(void *a)
  */
 #define array_create_size(basic_type, capacity) \
       ((basic_type *)(_array_create_helper(sizeof(basic_type), capacity)))
+/**
+ * @brief Creates a new dynamic array of `basic_type' in an arena.
+ *
+ * The array is valid until the arena is reset.
+ *
+ *    @param basic_type Type of the array to create.
+ *    @param capacity Initial size.
+ *    @param arena Arena to allocate from (see arena.h).
+ */
+#define array_create_arena(basic_type, capacity, arena) \
+      ((basic_type *)(_array_create_arena_helper(sizeof(basic_type), capacity, arena)))
 /**
  * @brief Resizes the array to accomodate new_size elements.
  *
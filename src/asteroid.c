@@ -16,6 +16,7 @@
 
 #include "conf.h"
 #include "array.h"
+#include "bitset.h"
 #include "camera.h"
 #include "gatherable.h"
 #include "space.h"
@@ -42,17 +43,41 @@ typedef struct Debris_ {
 const double DEBRIS_BUFFER = 1000.; /**< Buffer to smooth appearance of debris */
 
 static const double SCAN_FADE = 10.; /**< 1/time it takes to fade in/out scanning text. */
+static const double ASTEROID_SLEEP_MARGIN = 5000.; /**< Distance from the edge of a field at which pilots or the camera keep it awake. */
+static const double ASTEROID_SLEEP_STEP = 0.25; /**< Time between updates of sleeping fields. */
 
 static Debris *debris_stack = NULL; /**< All the debris in the current system (array.h). */
 static glTexture **debris_gfx = NULL; /**< Graphics to use for debris. */
 static double asteroid_dt = 0.; /**< Used as a global variable when threading. */
 
+/**
+ * @brief Asteroid near the screen in the current frame.
+ */
+typedef struct AsteroidVisible_ {
+   int field; /**< Field of the asteroid. */
+   int id;    /**< Index of the asteroid in the field. */
+} AsteroidVisible;
+static AsteroidVisible *asteroid_visible = NULL; /**< Asteroids to render this frame, in field order (array.h). */
+
+/**
+ * @brief Asteroid explosion nearby pilots have to be alerted of.
+ */
+typedef struct AsteroidAlert_ {
+   LuaAsteroid_t la; /**< Asteroid that exploded. */
+   vec2 pos;         /**< Position of the explosion. */
+   double range;     /**< Range of the alert. */
+} AsteroidAlert;
+static AsteroidAlert *asteroid_alerts = NULL; /**< Explosions since the last alert flush (array.h). */
+static uint32_t *asteroid_alerted = NULL; /**< Pilot stack indices already alerted in the flush (bitset.h). */
+static const Pilot **asteroid_alertRecv = NULL; /**< Receivers of the alert being sent (array.h). */
+
 /*
  * Useful data for asteroids.
  */
 static AsteroidType *asteroid_types = NULL; /**< Asteroid types stack (array.h). */
 static AsteroidTypeGroup *asteroid_groups = NULL; /**< Asteroid type groups stack (array.h). */
 static glTexture **asteroid_gfx = NULL; /**< Graphics for the asteroids (array.h). */
+static float *asteroid_polyArena = NULL; /**< Points of all the rotated collision polygons. */
 static int asteroid_creating = 0;
 
 /* Prototypes. */
@@ -62,8 +87,10 @@ static int asteroid_loadPLG( AsteroidType *temp, const char *buf );
 static int astgroup_cmp( const void *p1, const void *p2 );
 static int astgroup_parse( AsteroidTypeGroup *ag, const char *file );
 static int asttype_load (void);
+static int asttype_rotatePolygons (void);
 
 static int asteroid_updateSingle( Asteroid *a );
+static int asteroids_fieldAwake( const AsteroidAnchor *ast );
 static void asteroid_renderSingle( const Asteroid *a );
 static void debris_renderSingle( const Debris *d, double cx, double cy );
 static void debris_init( Debris *deb );
@@ -177,6 +204,28 @@ static int asteroid_updateSingle( Asteroid *a )
    return 0;
 }
 
+/**
+ * @brief Checks to see if anything is close enough to a field to need it
+ *        simulated every frame.
+ *
+ *    @param ast Field to check.
+ *    @return 1 if a pilot or the camera is near the field.
+ */
+static int asteroids_fieldAwake( const AsteroidAnchor *ast )
+{
+   Pilot *const* pilot_stack = pilot_getAll();
+   double r2 = pow2( ast->radius + ASTEROID_SLEEP_MARGIN );
+   vec2 cam;
+
+   cam_getPos( &cam.x, &cam.y );
+   if (vec2_dist2( &ast->pos, &cam ) < r2)
+      return 1;
+   for (int i=0; i<array_size(pilot_stack); i++)
+      if (vec2_dist2( &ast->pos, &pilot_stack[i]->solid.pos ) < r2)
+         return 1;
+   return 0;
+}
+
 /**
  * @brief Controls fleet spawning.
  *
@@ -184,11 +233,21 @@ static int asteroid_updateSingle( Asteroid *a )
  */
 void asteroids_update( double dt )
 {
+   int removed;
+
    NTracingZone( _ctx, 1 );
 
    /* Asteroids/Debris update */
    for (int i=0; i<array_size(cur_system->asteroids); i++) {
       AsteroidAnchor *ast = &cur_system->asteroids[i];
+
+      /* Fields nobody is near only get updated every once in a while with
+       * the accumulated time. Asteroids move in straight lines inside the
+       * field, so the large steps give nearly the same positions. */
+      ast->sleep_dt += dt;
+      if ((ast->sleep_dt < ASTEROID_SLEEP_STEP) && !asteroids_fieldAwake( ast ))
+         continue;
+
       ast->has_exclusion = 0;
 
       for (int k=0; k<array_size(cur_system->astexclude); k++) {
@@ -202,12 +261,13 @@ void asteroids_update( double dt )
       }
 
       /* Now just thread it and zoom. */
-      asteroid_dt = dt;
+      asteroid_dt = ast->sleep_dt;
+      ast->sleep_dt = 0.;
       for (int j=0; j<array_size(ast->asteroids); j++) {
          Asteroid *a = &ast->asteroids[j];
          /* Skip inexistent asteroids. */
          if (a->state == ASTEROID_XX) {
-            a->timer -= dt;
+            a->timer -= asteroid_dt;
             if (a->timer < 0.) {
                a->state = ASTEROID_XX_TO_BG;
                a->timer_max = a->timer = 1. + 3.*RNGF();
@@ -217,10 +277,14 @@ void asteroids_update( double dt )
          asteroid_updateSingle( a );
       }
 
-      /* Do quadtree stuff. Can't be threaded. */
-      qt_clear( &ast->qt );
+      /* Do quadtree stuff. Can't be threaded. Asteroids are only relinked
+       * when they move across leaves. */
+      removed = 0;
+      while (array_size(ast->qt_elems) < array_size(ast->asteroids))
+         array_push_back( &ast->qt_elems, -1 );
       for (int j=0; j<array_size(ast->asteroids); j++) {
          const Asteroid *a = &ast->asteroids[j];
+         int *elem = &ast->qt_elems[j];
          /* Add to quadtree if in foreground. */
          if (a->state == ASTEROID_FG) {
             int x, y, w2, h2, px, py;
@@ -230,9 +294,19 @@ void asteroids_update( double dt )
             py = round(a->sol.pre.y);
             w2 = ceil(a->gfx->sw*0.5);
             h2 = ceil(a->gfx->sh*0.5);
-            qt_insert( &ast->qt, j, MIN(x,px)-w2, MIN(y,py)-h2, MAX(x,px)+w2, MAX(y,py)+h2 );
+            if (*elem < 0)
+               *elem = qt_insert( &ast->qt, j, MIN(x,px)-w2, MIN(y,py)-h2, MAX(x,px)+w2, MAX(y,py)+h2 );
+            else
+               qt_move( &ast->qt, *elem, MIN(x,px)-w2, MIN(y,py)-h2, MAX(x,px)+w2, MAX(y,py)+h2 );
+         }
+         else if (*elem >= 0) {
+            qt_remove( &ast->qt, *elem );
+            *elem = -1;
+            removed = 1;
          }
       }
+      if (removed)
+         qt_cleanup( &ast->qt );
    }
 
    /* Only have to update stuff if not simulating. */
@@ -270,6 +344,20 @@ void asteroids_update( double dt )
       }
    }
 
+#if HAVE_TRACY
+   {
+      int nasteroids = 0, nawake = 0;
+      for (int i=0; i<array_size(cur_system->asteroids); i++) {
+         const AsteroidAnchor *ast = &cur_system->asteroids[i];
+         nasteroids += array_size(ast->asteroids);
+         nawake += (ast->sleep_dt <= 0.); /* Just updated. */
+      }
+      NTracingPlotI( "asteroids", nasteroids );
+      NTracingPlotI( "asteroid_fields_awake", nawake );
+      NTracingPlotI( "debris", array_size(debris_stack) );
+   }
+#endif /* HAVE_TRACY */
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -288,6 +376,11 @@ void asteroids_init (void)
       debris_gfx = array_create( glTexture* );
    array_erase( &debris_gfx, array_begin(debris_gfx), array_end(debris_gfx) );
 
+   /* Alerts from the previous system are meaningless. */
+   if (asteroid_alerts == NULL)
+      asteroid_alerts = array_create( AsteroidAlert );
+   array_erase( &asteroid_alerts, array_begin(asteroid_alerts), array_end(asteroid_alerts) );
+
    /* Set up asteroids. */
    for (int i=0; i<array_size(cur_system->asteroids); i++) {
       AsteroidAnchor *ast = &cur_system->asteroids[i];
@@ -312,6 +405,10 @@ void asteroids_init (void)
       qr = ceil(ast->radius);
       qt_create( &ast->qt, qx-qr, qy-qr, qx+qr, qy+qr, 2, 5 );
       ast->qt_init = 1;
+      if (ast->qt_elems == NULL)
+         ast->qt_elems = array_create( int );
+      array_resize( &ast->qt_elems, 0 );
+      ast->sleep_dt = 0.;
 
       /* Add the asteroids to the anchor */
       array_erase( &ast->asteroids, array_begin(ast->asteroids), array_end(ast->asteroids) );
@@ -496,9 +593,14 @@ void asteroids_computeInternals( AsteroidAnchor *a )
 int asteroids_load (void)
 {
    char **asteroid_files;
+   int npolys;
+#if DEBUGGING
+   Uint32 time = SDL_GetTicks();
+#endif /* DEBUGGING */
 
    /* Load asteroid types. */
    asttype_load();
+   npolys = asttype_rotatePolygons();
 
    /* Load asteroid graphics. */
    asteroid_files = PHYSFS_enumerateFiles( SPOB_GFX_SPACE_PATH"asteroid/" );
@@ -511,9 +613,91 @@ int asteroids_load (void)
    }
 
    PHYSFS_freeList( asteroid_files );
+
+   /* Pack all the asteroid graphics together so fields draw in one go. */
+   glTexture **atlas = array_create( glTexture* );
+   for (int i=0; i<array_size(asteroid_types); i++)
+      for (int j=0; j<array_size(asteroid_types[i].gfxs); j++)
+         array_push_back( &atlas, asteroid_types[i].gfxs[j] );
+   gl_atlasPack( atlas, array_size(atlas) );
+   array_free( atlas );
+
+#if DEBUGGING
+   if (conf.devmode) {
+      time = SDL_GetTicks() - time;
+      DEBUG( n_( "Loaded %d Asteroid Type in %.3f s", "Loaded %d Asteroid Types in %.3f s", array_size(asteroid_types) ), array_size(asteroid_types), time/1000. );
+   }
+   else
+      DEBUG( n_( "Loaded %d Asteroid Type", "Loaded %d Asteroid Types", array_size(asteroid_types) ), array_size(asteroid_types) );
+   DEBUG( n_( "Precomputed %d rotated collision polygon", "Precomputed %d rotated collision polygons", npolys ), npolys );
+#else /* DEBUGGING */
+   (void) npolys;
+#endif /* DEBUGGING */
    return 0;
 }
 
+/**
+ * @brief Precomputes the rotated collision polygons of all the asteroid types.
+ *
+ * Asteroids can be at any angle, so instead of rotating their polygon on every
+ *  hit, ASTEROID_POLYGON_DIRS rotations of each are computed at load time and
+ *  collisions just use the closest one. All the points are packed into a
+ *  single arena.
+ *
+ *    @return Number of rotated polygons.
+ */
+static int asttype_rotatePolygons (void)
+{
+   size_t npts = 0, off = 0;
+   int n = 0;
+
+   for (int i=0; i<array_size(asteroid_types); i++) {
+      const AsteroidType *at = &asteroid_types[i];
+      for (int j=0; j<array_size(at->polygon); j++)
+         npts += (size_t)at->polygon[j].npt * ASTEROID_POLYGON_DIRS;
+   }
+   asteroid_polyArena = malloc( MAX( 1, 2*npts ) * sizeof(float) );
+
+   for (int i=0; i<array_size(asteroid_types); i++) {
+      AsteroidType *at = &asteroid_types[i];
+      at->polygon_rot = malloc( MAX( 1, array_size(at->polygon) * ASTEROID_POLYGON_DIRS ) * sizeof(CollPoly) );
+      for (int j=0; j<array_size(at->polygon); j++) {
+         const CollPoly *pol = &at->polygon[j];
+         for (int d=0; d<ASTEROID_POLYGON_DIRS; d++) {
+            CollPoly *rpol = &at->polygon_rot[ j*ASTEROID_POLYGON_DIRS + d ];
+            RotatePolygonInto( rpol, pol, 2.*M_PI*d / ASTEROID_POLYGON_DIRS,
+                  &asteroid_polyArena[ off ], &asteroid_polyArena[ off+pol->npt ] );
+            off += 2*pol->npt;
+            n++;
+         }
+      }
+   }
+   return n;
+}
+
+/**
+ * @brief Gets the collision polygon of an asteroid at its current angle.
+ *
+ *    @param a Asteroid to get the polygon of.
+ *    @return The rotated polygon, or NULL if the asteroid has no polygon.
+ */
+const CollPoly *asteroid_polygon( const Asteroid *a )
+{
+   const AsteroidType *at = a->type;
+   int id, d;
+   double ang;
+
+   if (a->polygon->npt == 0)
+      return NULL;
+
+   id  = a->polygon - at->polygon;
+   ang = fmod( a->ang, 2.*M_PI );
+   if (ang < 0.)
+      ang += 2.*M_PI;
+   d   = (int)round( ang * ASTEROID_POLYGON_DIRS / (2.*M_PI) ) % ASTEROID_POLYGON_DIRS;
+   return &at->polygon_rot[ id*ASTEROID_POLYGON_DIRS + d ];
+}
+
 /**
  * @brief Compares two asteroid types.
  */
@@ -736,7 +920,7 @@ static int asteroid_loadPLG( AsteroidType *temp, const char *buf )
    polygon->npt = 0;
 
    /* See if the file does exist. */
-   if (!PHYSFS_exists(file)) {
+   if (!ndata_exists(file)) {
       WARN(_("%s xml collision polygon does not exist!\n \
                Please use the script 'polygon_from_sprite.py'\n \
                This file can be found in Naev's artwork repo."), file);
@@ -826,6 +1010,52 @@ static int astgroup_parse( AsteroidTypeGroup *ag, const char *file )
    return 0;
 }
 
+/**
+ * @brief Finds the asteroids near the screen for this frame.
+ *
+ * Fields away from the camera view get skipped as a whole. The quadtrees
+ *  only hold the foreground asteroids, so the rest are checked one by one.
+ */
+void asteroids_cull (void)
+{
+   double x1, y1, x2, y2;
+
+   if (asteroid_visible == NULL)
+      asteroid_visible = array_create( AsteroidVisible );
+   array_resize( &asteroid_visible, 0 );
+   if (cur_system == NULL)
+      return;
+
+   NTracingZone( _ctx, 1 );
+
+   cam_getViewRect( &x1, &y1, &x2, &y2, 0. );
+   for (int i=0; i<array_size(cur_system->asteroids); i++) {
+      const AsteroidAnchor *ast = &cur_system->asteroids[i];
+
+      /* See if the asteroid field is in range, if not skip. */
+      if ((ast->pos.x+ast->radius < x1) || (ast->pos.x-ast->radius > x2) ||
+            (ast->pos.y+ast->radius < y1) || (ast->pos.y-ast->radius > y2))
+         continue;
+
+      for (int j=0; j<array_size(ast->asteroids); j++) {
+         const Asteroid *a = &ast->asteroids[j];
+         double w2, h2;
+         if (a->state == ASTEROID_XX)
+            continue;
+         w2 = a->gfx->sw*0.5;
+         h2 = a->gfx->sh*0.5;
+         if ((a->sol.pos.x+w2 < x1) || (a->sol.pos.x-w2 > x2) ||
+               (a->sol.pos.y+h2 < y1) || (a->sol.pos.y-h2 > y2))
+            continue;
+         AsteroidVisible *v = &array_grow( &asteroid_visible );
+         v->field = i;
+         v->id    = j;
+      }
+   }
+
+   NTracingZoneEnd( _ctx );
+}
+
 /**
  * @brief Renders the system overlay.
  */
@@ -839,11 +1069,13 @@ void asteroids_renderOverlay (void)
    NTracingZone( _ctx, 1 );
 
    /* Render the debris. */
+   gl_batchBegin();
    for (int j=0; j<array_size(debris_stack); j++) {
       const Debris *d = &debris_stack[j];
       if (d->height > 1.)
          debris_renderSingle( d, cx, cy );
    }
+   gl_batchEnd();
 
    NTracingZoneEnd( _ctx );
 }
@@ -853,29 +1085,23 @@ void asteroids_renderOverlay (void)
  */
 void asteroids_render (void)
 {
-   double cx, cy, z;
+   double cx, cy;
    cam_getPos( &cx, &cy );
-   z = cam_getZoom();
    cx -= SCREEN_W/2.;
    cy -= SCREEN_H/2.;
 
    NTracingZone( _ctx, 1 );
 
-   /* Render the asteroids & debris. */
-   for (int i=0; i<array_size(cur_system->asteroids); i++) {
-      const AsteroidAnchor *ast = &cur_system->asteroids[i];
-      double x, y, r;
-
-      /* See if the asteroid field is in range, if not skip. */
-      gl_gameToScreenCoords( &x, &y, ast->pos.x, ast->pos.y );
-      r = ast->radius * z;
-      if ((x < -r) || (x > SCREEN_W+r) ||
-         (y < -r) || (y > SCREEN_H+r))
+   /* Render the asteroids found by asteroids_cull. */
+   gl_batchBegin();
+   for (int i=0; i<array_size(asteroid_visible); i++) {
+      const AsteroidVisible *v = &asteroid_visible[i];
+      const AsteroidAnchor *ast;
+      if (v->field >= array_size(cur_system->asteroids))
          continue;
-
-      /* Render all asteroids. */
-      for (int j=0; j<array_size(ast->asteroids); j++)
-        asteroid_renderSingle( &ast->asteroids[j] );
+      ast = &cur_system->asteroids[ v->field ];
+      if (v->id < array_size(ast->asteroids))
+         asteroid_renderSingle( &ast->asteroids[ v->id ] );
    }
 
    /* Render the debris. */
@@ -884,6 +1110,7 @@ void asteroids_render (void)
       if (d->height <= 1.)
          debris_renderSingle( d, cx, cy );
    }
+   gl_batchEnd();
 
    /* Render gatherable stuff. */
    gatherable_render();
@@ -942,6 +1169,7 @@ static void asteroid_renderSingle( const Asteroid *a )
       return;
    col = cFontWhite;
    col.a = a->scan_alpha;
+   gl_batchFlush(); /* Text goes over the asteroids drawn so far. */
    gl_gameToScreenCoords( &nx, &ny, a->sol.pos.x, a->sol.pos.y );
    gl_printRaw( &gl_smallFont, nx+a->gfx->sw/2, ny-gl_smallFont.h/2, &col, -1., _(at->scanned_msg) );
    /*
@@ -967,6 +1195,60 @@ static void debris_renderSingle( const Debris *d, double cx, double cy )
    gl_renderSpriteScaleRotate( d->gfx, d->pos.x+cx, d->pos.y+cy, scale, scale, d->ang, 0, 0, &col );
 }
 
+/**
+ * @brief Alerts the pilots near the asteroids that exploded since the last
+ *        call.
+ *
+ * Pilots are found with the pilot spatial index, so this has to be called once
+ *  it is up to date. Each pilot gets at most a single alert per call, for the
+ *  first explosion in its range, so bursts of explosions don't flood the AI.
+ */
+void asteroids_alertFlush (void)
+{
+   Pilot *const* pilot_stack;
+
+   if (array_size(asteroid_alerts) <= 0)
+      return;
+
+   NTracingZone( _ctx, 1 );
+
+   pilot_stack = pilot_getAll();
+   bitset_clear( asteroid_alerted );
+   if (asteroid_alertRecv == NULL)
+      asteroid_alertRecv = array_create( const Pilot* );
+   for (int i=0; i<array_size(asteroid_alerts); i++) {
+      const AsteroidAlert *alert = &asteroid_alerts[i];
+      double rad2 = pow2( alert->range );
+      const IntList *qt = pilot_collideQuery(
+            floor(alert->pos.x-alert->range), floor(alert->pos.y-alert->range),
+            ceil(alert->pos.x+alert->range), ceil(alert->pos.y+alert->range) );
+
+      array_resize( &asteroid_alertRecv, 0 );
+      for (int j=0; j<il_size(qt); j++) {
+         const Pilot *p;
+         int id = il_get( qt, j, 0 );
+         if ((id >= array_size(pilot_stack)) || bitset_test( asteroid_alerted, id ))
+            continue;
+         p = pilot_stack[id];
+         if (pilot_isFlag( p, PILOT_DELETE ))
+            continue;
+         if (vec2_dist2( &p->solid.pos, &alert->pos ) > rad2)
+            continue;
+         bitset_set( &asteroid_alerted, id );
+         array_grow( &asteroid_alertRecv ) = p;
+      }
+
+      if (array_size(asteroid_alertRecv) > 0) {
+         lua_pushasteroid( naevL, alert->la );
+         pilot_msgGroup( NULL, asteroid_alertRecv, array_size(asteroid_alertRecv), "asteroid", -1 );
+         lua_pop(naevL,1);
+      }
+   }
+   array_resize( &asteroid_alerts, 0 );
+
+   NTracingZoneEnd( _ctx );
+}
+
 /**
  * @brief Frees an asteroid anchor.
  *
@@ -978,6 +1260,7 @@ void asteroid_free( AsteroidAnchor *ast )
       qt_destroy( &ast->qt );
    free(ast->label);
    array_free(ast->asteroids);
+   array_free(ast->qt_elems);
    array_free(ast->groups);
    array_free(ast->groupsw);
 }
@@ -1007,9 +1290,12 @@ void asteroids_free (void)
       for (int j=0; j<array_size(at->polygon); j++)
          FreePolygon( &at->polygon[j] );
       array_free(at->polygon);
+      free(at->polygon_rot);
    }
    array_free(asteroid_types);
    asteroid_types = NULL;
+   free(asteroid_polyArena);
+   asteroid_polyArena = NULL;
 
    /* Free the asteroid groups. */
    for (int i=0; i<array_size(asteroid_groups); i++) {
@@ -1024,6 +1310,14 @@ void asteroids_free (void)
    /* Clean up debris. */
    array_free( debris_stack );
    debris_stack = NULL;
+   array_free( asteroid_visible );
+   asteroid_visible = NULL;
+   array_free( asteroid_alerts );
+   asteroid_alerts = NULL;
+   array_free( asteroid_alerted );
+   asteroid_alerted = NULL;
+   array_free( asteroid_alertRecv );
+   asteroid_alertRecv = NULL;
 
    /* Free the gatherable stack. */
    gatherable_free();
@@ -1134,11 +1428,9 @@ void asteroid_explode( Asteroid *a, int max_rarity, double mining_bonus )
 {
    Damage dmg;
    char buf[16];
-   double rad2;
-   LuaAsteroid_t la;
+   AsteroidAlert *alert;
    const AsteroidType *at = a->type;
    const AsteroidAnchor *field = &cur_system->asteroids[a->parent];
-   Pilot *const* pilot_stack = pilot_getAll();
 
    /* Manage the explosion */
    dmg.type          = dtype_get("explosion_splash");
@@ -1152,20 +1444,14 @@ void asteroid_explode( Asteroid *a, int max_rarity, double mining_bonus )
    snprintf(buf, sizeof(buf), "explosion%d", RNG(0,2));
    sound_playPos( sound_get(buf), a->sol.pos.x, a->sol.pos.y, a->sol.vel.x, a->sol.vel.y );
 
-   /* Alert nearby pilots. */
-   rad2 = pow2( at->alert_range );
-   la.parent = a->parent;
-   la.id = a->id;
-   lua_pushasteroid( naevL, la );
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      Pilot *p = pilot_stack[i];
-
-      if (vec2_dist2( &p->solid.pos, &a->sol.pos ) > rad2)
-         continue;
-
-      pilot_msg( NULL, p, "asteroid", -1 );
-   }
-   lua_pop(naevL,1);
+   /* Alert nearby pilots once the spatial index is updated. */
+   if (asteroid_alerts == NULL)
+      asteroid_alerts = array_create( AsteroidAlert );
+   alert = &array_grow( &asteroid_alerts );
+   alert->la.parent = a->parent;
+   alert->la.id     = a->id;
+   alert->pos       = a->sol.pos;
+   alert->range     = at->alert_range;
 
    /* Release commodity rewards. */
    if (max_rarity >= 0) {
@@ -1217,3 +1503,8 @@ void asteroid_collideQueryIL( AsteroidAnchor *anc, IntList *il, int x1, int y1,
 {
    qt_query( &anc->qt, il, x1, y1, x2, y2 );
 }
+
+void asteroid_collideQueryILScratch( const AsteroidAnchor *anc, IntList *il, QuadtreeScratch *scratch, int x1, int y1, int x2, int y2 )
+{
+   qt_query_scratch( &anc->qt, scratch, il, x1, y1, x2, y2 );
+}
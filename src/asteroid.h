@@ -19,6 +19,7 @@
 #define ASTEROID_DEFAULT_ACCEL     1.  /**< Acceleration applied when asteroid leaves asteroid field. */
 
 #define ASTEROID_REF_AREA     250e3    /**< The "density" value in an asteroid field means 1 rock per this area. */
+#define ASTEROID_POLYGON_DIRS 128      /**< Number of precomputed rotations of the collision polygons. */
 
 /* Asteroid status enum. Order is based on how asteroids are generated. */
 enum {
@@ -50,6 +51,7 @@ typedef struct AsteroidType_ {
    char *scanned_msg;   /**< Scanned message. */
    glTexture **gfxs;    /**< asteroid possible gfxs. */
    CollPoly *polygon;   /**< Collision polygons associated to gfxs. */
+   CollPoly *polygon_rot; /**< Rotated collision polygons, ASTEROID_POLYGON_DIRS per polygon. */
    AsteroidReward *material; /**< Materials contained in the asteroid. */
    double armour_min;   /**< Minimum "armour" of the asteroid. */
    double armour_max;   /**< Maximum "armour" of the asteroid. */
@@ -116,7 +118,9 @@ typedef struct AsteroidAnchor_ {
    /* Collision stuff. */
    Quadtree qt;   /**< Handles collisions. */
    int qt_init;   /**< Whether or not the quadtree has been initialized. */
+   int *qt_elems; /**< Quadtree element of each asteroid, -1 if not in the tree (array.h). */
    int has_exclusion; /**< Used for updating. */
+   double sleep_dt; /**< Time not yet simulated while the field is sleeping. */
 } AsteroidAnchor;
 
 /**
@@ -136,6 +140,7 @@ void asteroids_init (void);
 
 /* Updating and rendering. */
 void asteroids_update( double dt );
+void asteroids_cull (void);
 void asteroids_render (void);
 void asteroids_renderOverlay (void);
 
@@ -152,4 +157,7 @@ int asteroids_inField( const vec2 *p );
 void asteroids_computeInternals( AsteroidAnchor *a );
 void asteroid_hit( Asteroid *a, const Damage *dmg, int max_rarity, double mine_bonus );
 void asteroid_explode( Asteroid *a, int max_rarity, double mine_bonus );
+void asteroids_alertFlush (void);
+const CollPoly *asteroid_polygon( const Asteroid *a );
 void asteroid_collideQueryIL( AsteroidAnchor *anc, IntList *il, int x1, int y1, int x2, int y2 );
+void asteroid_collideQueryILScratch( const AsteroidAnchor *anc, IntList *il, QuadtreeScratch *scratch, int x1, int y1, int x2, int y2 );
@@ -58,6 +58,8 @@ static unsigned int bkg_idgen = 0; /**< ID generator for backgrounds. */
  */
 static nlua_env bkg_cur_env = LUA_NOREF; /**< Current Lua state. */
 static nlua_env bkg_def_env = LUA_NOREF; /**< Default Lua state. */
+static nlua_env bkg_next_env = LUA_NOREF; /**< Prefetched Lua state. */
+static char *bkg_next_name = NULL; /**< Name of the prefetched script. */
 static int bkg_L_renderbg = LUA_NOREF; /**< Background rendering function. */
 static int bkg_L_rendermg = LUA_NOREF; /**< Middleground rendering function. */
 static int bkg_L_renderfg = LUA_NOREF; /**< Foreground rendering function. */
@@ -66,9 +68,11 @@ static int bkg_L_renderov = LUA_NOREF; /**< Overlay rendering function. */
 /*
  * Background dust.
  */
-#define STAR_BUF     250 /**< Area to leave around screen for dust, more = less repetition */
-static gl_vbo *dust_vertexVBO = NULL; /**< Star Vertex VBO. */
-static unsigned int ndust = 0; /**< Total dust. */
+#define STAR_BUF     250 /**< Area to leave around screen for dust. */
+#define DUST_LAYERS  4   /**< Parallax layers of dust, must match dust.vert. */
+#define DUST_CELL    256. /**< Size of the cells the dust is generated in. */
+#define DUST_LOD_MIN 0.25 /**< Smallest fraction of dust drawn when zoomed out. */
+static unsigned int dust_percell = 0; /**< Dust per cell of each layer. */
 static GLfloat dust_x = 0.; /**< Star X movement. */
 static GLfloat dust_y = 0.; /**< Star Y movement. */
 
@@ -86,51 +90,15 @@ static void bkg_sort( background_image_t *arr );
 /**
  * @brief Initializes background dust.
  *
+ * The dust is generated procedurally by the shader from a grid of cells
+ *  following the camera, so only its density has to be set.
+ *
  *    @param n Number of dust to add (dust per 800x640 screen).
  */
 void background_initDust( int n )
 {
-   GLfloat w, h, hw, hh;
-   double size;
-   GLfloat *dust_vertex;
-
-   NTracingZone( _ctx, 1 );
-
-   /* Calculate size. */
-   size  = SCREEN_W*SCREEN_H+STAR_BUF*STAR_BUF;
-   size /= pow2(conf.zoom_far);
-
-   /* Calculate dust buffer. */
-   w  = (SCREEN_W + 2.*STAR_BUF);
-   w += (w / conf.zoom_far - 1.);
-   h  = (SCREEN_H + 2.*STAR_BUF);
-   h += (h / conf.zoom_far - 1.);
-   hw = w / 2.;
-   hh = h / 2.;
-
-   /* Calculate dust. */
-   size  *= n;
-   ndust = (unsigned int)(size/(800.*600.));
-
-   /* Create data. */
-   dust_vertex = malloc( ndust * sizeof(GLfloat) * 3 );
-
-   for (unsigned int i=0; i < ndust; i++) {
-      /* Set the position. */
-      dust_vertex[3*i+0] = RNGF()*w - hw;
-      dust_vertex[3*i+1] = RNGF()*h - hh;
-      /* Set the colour. */
-      dust_vertex[3*i+2] = RNGF()*0.6 + 0.2;
-   }
-
-   /* Recreate VBO. */
-   gl_vboDestroy( dust_vertexVBO );
-   dust_vertexVBO = gl_vboCreateStatic(
-         ndust * sizeof(GLfloat) * 3, dust_vertex );
-
-   free(dust_vertex);
-
-   NTracingZoneEnd( _ctx );
+   double density = (double)n / (800.*600.);
+   dust_percell = (unsigned int)round( density * pow2(DUST_CELL) / DUST_LAYERS );
 }
 
 /**
@@ -151,9 +119,13 @@ void background_renderDust( const double dt )
 {
    (void) dt;
    GLfloat h, w, m;
-   double z, angle;
+   double z, angle, lod;
    mat4 projection;
    int points = 1;
+   int cx, cy;
+
+   if (dust_percell == 0)
+      return;
 
    NTracingZone( _ctx, 1 );
 
@@ -189,37 +161,28 @@ void background_renderDust( const double dt )
       }
    }
 
-   /* Calculate some dimensions. */
-   w  = (SCREEN_W + 2.*STAR_BUF);
-   w += (w / conf.zoom_far - 1.);
-   h  = (SCREEN_H + 2.*STAR_BUF);
-   h += (h / conf.zoom_far - 1.);
+   /* Only the cells in view get generated, with less dust when zoomed out. */
+   w   = SCREEN_W / (2.*z) + STAR_BUF;
+   h   = SCREEN_H / (2.*z) + STAR_BUF;
+   cx  = (int)ceil( 2.*w / DUST_CELL ) + 1;
+   cy  = (int)ceil( 2.*h / DUST_CELL ) + 1;
+   lod = CLAMP( DUST_LOD_MIN, 1., z );
 
    /* Common shader stuff. */
    glUseProgram(shaders.dust.program);
    gl_uniformMat4(shaders.dust.projection, &projection);
    glUniform2f(shaders.dust.offset_xy, dust_x, dust_y);
    if (points)
-      glUniform3f(shaders.dust.dims, 2./gl_screen.scale, 0., 0.);
+      glUniform3f(shaders.dust.dims, MAX(2., 1./z)/gl_screen.scale, 0., 0.);
    else
       glUniform3f(shaders.dust.dims, MAX(1.,2.-m/20.)/gl_screen.scale, angle, m);
    glUniform3f(shaders.dust.screen, w, h, 1. / gl_screen.scale);
    glUniform1i(shaders.dust.use_lines, !points);
+   glUniform4f(shaders.dust.grid, DUST_CELL, cx, cy, dust_percell);
+   glUniform1f(shaders.dust.lod, lod);
 
-   /* Vertices. */
-   glEnableVertexAttribArray( shaders.dust.vertex );
-   glEnableVertexAttribArray( shaders.dust.brightness );
-
-   /* Set up the vertices. */
-   gl_vboActivateAttribOffset( dust_vertexVBO, shaders.dust.vertex, 0,
-         2, GL_FLOAT, 3 * sizeof(GLfloat) );
-   gl_vboActivateAttribOffset( dust_vertexVBO, shaders.dust.brightness, 2 * sizeof(GLfloat),
-         1, GL_FLOAT, 3 * sizeof(GLfloat) );
-   glDrawArrays( GL_POINTS, 0, ndust );
-
-   /* Disable vertex array. */
-   glDisableVertexAttribArray( shaders.dust.vertex );
-   glDisableVertexAttribArray( shaders.dust.brightness );
+   /* The vertices are all generated from their index. */
+   gl_drawArrays( GL_POINTS, 0, DUST_LAYERS * cx * cy * dust_percell );
 
    glUseProgram(0);
 
@@ -349,18 +312,30 @@ unsigned int background_addImage( const glTexture *image, double x, double y,
  */
 static void background_renderImages( background_image_t *bkg_arr )
 {
+   double cx,cy, gx,gy;
+
    /* Skip rendering altogether if disabled. */
    if (conf.bg_brightness <= 0.)
       return;
 
-   /* Render images in order. */
+   if (array_size(bkg_arr) <= 0)
+      return;
+
+   cam_getPos( &cx, &cy );
+   gui_getOffset( &gx, &gy );
+
+   /* Render images in order, runs of images sharing a texture get batched.
+    * Batches are grouped by texture, so we flush whenever it changes to
+    * preserve the parallax ordering. */
+   gl_batchBegin();
    for (int i=0; i<array_size(bkg_arr); i++) {
-      double cx,cy, x,y, gx,gy, z, m;
+      double x,y, z, m;
       glColour col;
       background_image_t *bkg = &bkg_arr[i];
 
-      cam_getPos( &cx, &cy );
-      gui_getOffset( &gx, &gy );
+      if ((i > 0) && (bkg->image->texture != bkg_arr[i-1].image->texture))
+         gl_batchFlush();
+
       m = bkg->move;
       z = bkg->scale;
       x  = (bkg->x - cx) * m - z*bkg->image->sw/2. + gx + SCREEN_W/2.;
@@ -373,6 +348,7 @@ static void background_renderImages( background_image_t *bkg_arr )
 
       gl_renderTexture( bkg->image, x, y, z*bkg->image->sw, z*bkg->image->sh, 0., 0., bkg->image->srw, bkg->image->srh, &col, bkg->angle );
    }
+   gl_batchEnd();
 }
 
 /**
@@ -430,6 +406,31 @@ int background_init (void)
    return 0;
 }
 
+/**
+ * @brief Creates the environment of a background script ahead of time.
+ *
+ * The next background_load with the same name uses it instead of creating it
+ *  again, only the "background" function is left to run then.
+ *
+ *    @param name Name of the background script, NULL to drop the prefetched one.
+ */
+void background_prefetch( const char *name )
+{
+   if ((name != NULL) && (bkg_next_name != NULL) && (strcmp( bkg_next_name, name ) == 0))
+      return;
+
+   nlua_freeEnv( bkg_next_env );
+   bkg_next_env = LUA_NOREF;
+   free( bkg_next_name );
+   bkg_next_name = NULL;
+
+   if (name == NULL)
+      return;
+   bkg_next_env = background_create( name );
+   if (bkg_next_env != LUA_NOREF)
+      bkg_next_name = strdup( name );
+}
+
 /**
  * @brief Loads a background script by name.
  */
@@ -446,6 +447,13 @@ int background_load( const char *name )
    /* Load default. */
    if (name == NULL)
       bkg_cur_env = bkg_def_env;
+   /* Use the prefetched script. */
+   else if ((bkg_next_name != NULL) && (strcmp( bkg_next_name, name ) == 0)) {
+      bkg_cur_env = bkg_next_env;
+      bkg_next_env = LUA_NOREF;
+      free( bkg_next_name );
+      bkg_next_name = NULL;
+   }
    /* Load new script. */
    else
       bkg_cur_env = background_create( name );
@@ -545,11 +553,9 @@ void background_free (void)
    /* Free the Lua. */
    nlua_freeEnv( bkg_cur_env );
    bkg_cur_env = LUA_NOREF;
+   background_prefetch( NULL );
 
-   gl_vboDestroy( dust_vertexVBO );
-   dust_vertexVBO = NULL;
-
-   ndust = 0;
+   dust_percell = 0;
 }
 
 /**
@@ -22,6 +22,7 @@ void background_moveDust( double x, double y );
 /* Init. */
 int background_init (void);
 int background_load( const char *name );
+void background_prefetch( const char *name );
 
 /* Clean up. */
 void background_clear (void);
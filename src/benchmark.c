@@ -0,0 +1,522 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file benchmark.c
+ *
+ * @brief Deterministic battle benchmark for tracking simulation performance.
+ *
+ * Sets up big fights with a fixed random seed and runs the updates a fixed
+ *  amount of times without rendering, reporting how long each stage took.
+ *  Pathfinding, safe lane charting and spawning are timed the same way, and
+ *  Lua scripts can be run as benchmarks with --benchmark-script.
+ *
+ * The name lookups done meanwhile, mostly by the Lua scripts, are recorded
+ *  and replayed at the end against the name indices and a linear search over
+ *  the same names, like the lookups were done before the indices.
+ *
+ * The AI budget is disabled while benchmarking, so the control ticks run
+ *  when they are due whatever the configuration is.
+ *
+ * Along with the human readable report, every stage is logged as a
+ *  "benchmark,scenario,stage,count,total ms,ms per count" line so that runs
+ *  can be compared between commits by grepping the output.
+ */
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define BENCHMARK_MALLINFO 1 /**< Can report heap usage. */
+#endif
+
+#include "naev.h"
+/** @endcond */
+
+#include "benchmark.h"
+
+#include "array.h"
+#include "conf.h"
+#include "faction.h"
+#include "hook.h"
+#include "log.h"
+#include "map.h"
+#include "nameindex.h"
+#include "ndata.h"
+#include "nlua.h"
+#include "nstring.h"
+#include "pilot.h"
+#include "rng.h"
+#include "safelanes.h"
+#include "ship.h"
+#include "space.h"
+#include "weapon.h"
+
+#define BENCHMARK_SEED     0x6e616576  /**< Seed to use for the random numbers. */
+#define BENCHMARK_DT       (1./60.)    /**< Time step of the updates. */
+#define BENCHMARK_SYSTEM   "Adraia"    /**< System to fight in, has no asteroids. */
+#define BENCHMARK_HOOKS    10000       /**< Timer and date hooks to track. */
+#define BENCHMARK_PATHS    100         /**< Jump paths to look for per update requested. */
+#define BENCHMARK_LOOKUPS  20          /**< Times the recorded name lookups are replayed. */
+
+/**
+ * @brief Names of an index in the order they were added, to search them linearly.
+ */
+typedef struct BenchmarkNames_ {
+   int nocase;             /**< Whether or not the names are case insensitive. */
+   NameIndexSlot *slots;   /**< Names ordered by their index (array.h). */
+} BenchmarkNames;
+
+/**
+ * @brief Group of pilots to add to the battle.
+ */
+typedef struct BenchmarkFleet_ {
+   const char *ship;    /**< Ship of the pilots. */
+   const char *faction; /**< Faction of the pilots. */
+   const char *ai;      /**< AI of the pilots. */
+   int n;               /**< Number of pilots. */
+} BenchmarkFleet;
+
+/**
+ * @brief Fight to run the benchmark on.
+ */
+typedef struct BenchmarkScenario_ {
+   const char *name;             /**< Name of the scenario. */
+   double spread;                /**< Fraction of the system radius to spawn the pilots in. */
+   BenchmarkFleet fleets[2];     /**< Pilots fighting. */
+} BenchmarkScenario;
+
+static const BenchmarkScenario benchmark_scenarios[] = {
+   { "battle", 0.9, {
+      { "Empire Lancelot", "Empire", "empire", 200 },
+      { "Drone", "Collective", "collective", 300 } } },
+   /* Everyone starts within range so the weapon stack fills up immediately. */
+   { "weapons", 0.1, {
+      { "Empire Admonisher", "Empire", "empire", 150 },
+      { "Drone", "Collective", "collective", 300 } } },
+}; /**< Scenarios run by the benchmark. */
+
+static const char *benchmark_spawn_systems[] = {
+   "Gamma Polaris",
+   "Dvaer",
+   "Hakoi",
+}; /**< Busy systems to time the spawning in. */
+
+/**
+ * @brief Gets the amount of heap memory in use.
+ */
+static size_t benchmark_heap (void)
+{
+#ifdef BENCHMARK_MALLINFO
+   return mallinfo2().uordblks;
+#else /* BENCHMARK_MALLINFO */
+   return 0;
+#endif /* BENCHMARK_MALLINFO */
+}
+
+/**
+ * @brief Logs the time taken by a stage.
+ *
+ *    @param scenario Name of the scenario the stage belongs to.
+ *    @param name Name of the stage.
+ *    @param ticks Performance counter ticks spent on the stage.
+ *    @param total Ticks spent on the whole scenario, for the percentage.
+ *    @param n Number of updates, or whatever else the stage did n times.
+ */
+static void benchmark_logStage( const char *scenario, const char *name, Uint64 ticks, Uint64 total, int n )
+{
+   double ms = 1000. * (double)ticks / (double)SDL_GetPerformanceFrequency();
+   n = MAX( n, 1 );
+   LOG( "   %-24s %10.2f ms %8.4f ms/update %5.1f%%", name, ms, ms / n,
+         (total > 0) ? 100. * (double)ticks / (double)total : 0. );
+   LOG( "benchmark,%s,%s,%d,%.4f,%.6f", scenario, name, n, ms, ms / n );
+}
+
+/**
+ * @brief Runs a benchmark scenario.
+ *
+ *    @param bs Scenario to run.
+ *    @param n Number of updates to run.
+ *    @return 0 on success.
+ */
+static int benchmark_scenario( const BenchmarkScenario *bs, int n )
+{
+   UpdateTimings ut;
+   Uint64 start, total;
+   size_t heap_start, heap_end;
+   PilotFlags flags;
+   int nweapons;
+
+   LOG(_("Running benchmark scenario '%s' for %d updates."), bs->name, n);
+
+   /* Set up the fight. Seeded again after loading the system so the fight
+    * does not depend on what space_init used. */
+   rng_seed( BENCHMARK_SEED );
+   pilots_cleanAll();
+   space_init( BENCHMARK_SYSTEM, 0 );
+   pilots_cleanAll();
+   space_spawn = 0;
+   rng_seed( BENCHMARK_SEED );
+   pilot_clearFlagsRaw( flags );
+   for (size_t i=0; i<sizeof(bs->fleets)/sizeof(bs->fleets[0]); i++) {
+      const BenchmarkFleet *bf = &bs->fleets[i];
+      const Ship *s = ship_get( bf->ship );
+      int f = faction_get( bf->faction );
+      if ((s == NULL) || (f < 0)) {
+         WARN(_("Benchmark fleet '%s' of '%s' not found!"), bf->ship, bf->faction);
+         return -1;
+      }
+      for (int j=0; j<bf->n; j++) {
+         vec2 pos, vel;
+         vec2_pset( &pos, cur_system->radius*bs->spread*sqrt(RNGF()), RNGF()*2.*M_PI );
+         vec2_cset( &vel, 0., 0. );
+         pilot_create( s, NULL, f, bf->ai, RNGF()*2.*M_PI, &pos, &vel, flags, 0, 0 );
+      }
+   }
+
+   /* Run the updates. */
+   memset( &ut, 0, sizeof(ut) );
+   nweapons = 0;
+   heap_start = benchmark_heap();
+   update_setTimings( &ut );
+   start = SDL_GetPerformanceCounter();
+   for (int i=0; i<n; i++) {
+      update_routine( BENCHMARK_DT, 1 );
+      nweapons = MAX( nweapons, array_size( weapon_getStack() ) );
+   }
+   total = SDL_GetPerformanceCounter() - start;
+   update_setTimings( NULL );
+   heap_end = benchmark_heap();
+
+   /* Report. */
+   LOG(_("Benchmark '%s' results (%d pilots left, up to %d weapons):"), bs->name,
+         array_size( pilot_getAll() ), nweapons);
+   benchmark_logStage( bs->name, "total", total, total, n );
+   benchmark_logStage( bs->name, "purge", ut.purge, total, n );
+   benchmark_logStage( bs->name, "space_update", ut.space, total, n );
+   benchmark_logStage( bs->name, "spfx_update", ut.spfx, total, n );
+   benchmark_logStage( bs->name, "weapons_updateCollide", ut.collide, total, n );
+   benchmark_logStage( bs->name, "pilots_update", ut.pilots, total, n );
+   benchmark_logStage( bs->name, "weapons_update", ut.weapons, total, n );
+#ifdef BENCHMARK_MALLINFO
+   LOG(_("   Heap in use went from %.1f MiB to %.1f MiB"),
+         (double)heap_start / (1024.*1024.), (double)heap_end / (1024.*1024.));
+#else /* BENCHMARK_MALLINFO */
+   (void) heap_start;
+   (void) heap_end;
+#endif /* BENCHMARK_MALLINFO */
+
+   pilots_cleanAll();
+   weapon_clear();
+   return 0;
+}
+
+/**
+ * @brief Runs the timer and date hook benchmark.
+ *
+ *    @param n Number of updates to run.
+ *    @return 0 on success.
+ */
+static int benchmark_hooks( int n )
+{
+   Uint64 timers, dates;
+   int due;
+
+   LOG(_("Running benchmark scenario '%s' for %d updates."), "hooks", n);
+   rng_seed( BENCHMARK_SEED );
+   due = hooks_benchmark( BENCHMARK_HOOKS, n, BENCHMARK_DT, &timers, &dates );
+
+   LOG(_("Benchmark '%s' results (%d timer and date hooks, %d were due):"), "hooks",
+         BENCHMARK_HOOKS, due);
+   benchmark_logStage( "hooks", "total", timers+dates, timers+dates, n );
+   benchmark_logStage( "hooks", "timers", timers, timers+dates, n );
+   benchmark_logStage( "hooks", "dates", dates, timers+dates, n );
+   return 0;
+}
+
+/**
+ * @brief Runs the pathfinding benchmark.
+ *
+ * Looks for the jump paths between random pairs of systems like the map and
+ *  the AI do, ignoring what is known.
+ *
+ *    @param n Number of updates requested, the amount of paths scales with it.
+ *    @return 0 on success.
+ */
+static int benchmark_pathfinding( int n )
+{
+   const StarSystem *systems = system_getAll();
+   int nsys = array_size( systems );
+   int npaths = n * BENCHMARK_PATHS / 60;
+   int found = 0;
+   long jumps = 0;
+   Uint64 start, total;
+
+   LOG(_("Running benchmark scenario '%s' for %d paths."), "pathfinding", npaths);
+   if (nsys < 2) {
+      WARN(_("Not enough systems to run the pathfinding benchmark!"));
+      return -1;
+   }
+
+   rng_seed( BENCHMARK_SEED );
+   start = SDL_GetPerformanceCounter();
+   for (int i=0; i<npaths; i++) {
+      const StarSystem *a = &systems[ RNG( 0, nsys-1 ) ];
+      const StarSystem *b = &systems[ RNG( 0, nsys-1 ) ];
+      StarSystem **path = map_getJumpPathSys( a, NULL, b, 1, 1, NULL, NULL );
+      if (path != NULL) {
+         found++;
+         jumps += array_size( path );
+      }
+      array_free( path );
+   }
+   total = SDL_GetPerformanceCounter() - start;
+
+   LOG(_("Benchmark '%s' results (%d paths found, %.1f jumps on average):"), "pathfinding",
+         found, (found > 0) ? (double)jumps / (double)found : 0.);
+   benchmark_logStage( "pathfinding", "total", total, total, npaths );
+   return 0;
+}
+
+/**
+ * @brief Runs the safe lane benchmark, charting the lanes without the cache.
+ *
+ *    @return 0 on success.
+ */
+static int benchmark_safelanes (void)
+{
+   Uint64 start, total;
+   int iters;
+
+   LOG(_("Running benchmark scenario '%s'."), "safelanes");
+   start = SDL_GetPerformanceCounter();
+   iters = safelanes_benchmark();
+   total = SDL_GetPerformanceCounter() - start;
+
+   LOG(_("Benchmark '%s' results (%d iterations):"), "safelanes", iters);
+   benchmark_logStage( "safelanes", "total", total, total, iters );
+   return 0;
+}
+
+/**
+ * @brief Runs the spawning benchmark.
+ *
+ * Enters busy systems with the spawning enabled, so the faction spawn scripts
+ *  fill them up and keep them populated during the updates.
+ *
+ *    @param n Number of updates to run in each system.
+ *    @return 0 on success.
+ */
+static int benchmark_spawning( int n )
+{
+   UpdateTimings ut;
+   Uint64 start, init, total;
+   int npilots = 0;
+
+   LOG(_("Running benchmark scenario '%s' for %d updates."), "spawning", n);
+   memset( &ut, 0, sizeof(ut) );
+   init  = 0;
+   total = 0;
+   for (size_t i=0; i<sizeof(benchmark_spawn_systems)/sizeof(benchmark_spawn_systems[0]); i++) {
+      rng_seed( BENCHMARK_SEED );
+      pilots_cleanAll();
+      start = SDL_GetPerformanceCounter();
+      space_init( benchmark_spawn_systems[i], 0 );
+      init += SDL_GetPerformanceCounter() - start;
+
+      update_setTimings( &ut );
+      start = SDL_GetPerformanceCounter();
+      for (int j=0; j<n; j++)
+         update_routine( BENCHMARK_DT, 1 );
+      total += SDL_GetPerformanceCounter() - start;
+      update_setTimings( NULL );
+      npilots += array_size( pilot_getAll() );
+   }
+   total += init;
+
+   LOG(_("Benchmark '%s' results (%d pilots left):"), "spawning", npilots);
+   benchmark_logStage( "spawning", "total", total, total, n );
+   benchmark_logStage( "spawning", "space_init", init, total, n );
+   benchmark_logStage( "spawning", "space_update", ut.space, total, n );
+   benchmark_logStage( "spawning", "pilots_update", ut.pilots, total, n );
+
+   pilots_cleanAll();
+   weapon_clear();
+   return 0;
+}
+
+/**
+ * @brief Compares two name index slots by their index.
+ */
+static int benchmark_cmpSlot( const void *ptr1, const void *ptr2 )
+{
+   return ((const NameIndexSlot*)ptr1)->id - ((const NameIndexSlot*)ptr2)->id;
+}
+
+/**
+ * @brief Looks up a name like before the name indices, going over all of them.
+ *
+ *    @param bn Names to search.
+ *    @param name Name to look up.
+ *    @return Index of the first name matching, or -1 if not found.
+ */
+static int benchmark_linearGet( const BenchmarkNames *bn, const char *name )
+{
+   for (int i=0; i<array_size(bn->slots); i++) {
+      const char *s = bn->slots[i].name;
+      if (bn->nocase ? (strcasecmp( s, name )==0) : (strcmp( s, name )==0))
+         return bn->slots[i].id;
+   }
+   return -1;
+}
+
+/**
+ * @brief Runs the name lookup benchmark by replaying recorded lookups.
+ *
+ *    @param scenario Name to report the results as.
+ *    @param trace Recorded lookups (array.h).
+ *    @return 0 on success.
+ */
+static int benchmark_lookups( const char *scenario, const NameIndexTrace *trace )
+{
+   BenchmarkNames *lists;
+   int n = (trace != NULL) ? array_size( trace->names ) : 0;
+   int nidx;
+   int nhash, nlinear;
+   Uint64 start, thash, tlinear;
+
+   LOG(_("Running benchmark scenario '%s' for %d recorded lookups."), scenario, n);
+   if (n <= 0) {
+      WARN(_("No name lookups were recorded!"));
+      return 0;
+   }
+
+   /* Get the names of each index looked up, in stack order. */
+   nidx  = array_size( trace->indices );
+   lists = calloc( nidx, sizeof(BenchmarkNames) );
+   for (int k=0; k<nidx; k++) {
+      const NameIndex *ni = &trace->indices[k];
+      BenchmarkNames *bn = &lists[k];
+      bn->nocase  = ni->nocase;
+      bn->slots   = array_create_size( NameIndexSlot, MAX( ni->n, 1 ) );
+      for (uint32_t j=0; j<ni->size; j++)
+         if (ni->slots[j].name != NULL)
+            array_push_back( &bn->slots, ni->slots[j] );
+      qsort( bn->slots, array_size(bn->slots), sizeof(NameIndexSlot), benchmark_cmpSlot );
+   }
+
+   nhash = 0;
+   start = SDL_GetPerformanceCounter();
+   for (int r=0; r<BENCHMARK_LOOKUPS; r++)
+      for (int i=0; i<n; i++)
+         nhash += (nameindex_get( &trace->indices[ trace->lookups[i] ], trace->names[i] ) >= 0);
+   thash = SDL_GetPerformanceCounter() - start;
+
+   nlinear = 0;
+   start = SDL_GetPerformanceCounter();
+   for (int r=0; r<BENCHMARK_LOOKUPS; r++)
+      for (int i=0; i<n; i++)
+         nlinear += (benchmark_linearGet( &lists[ trace->lookups[i] ], trace->names[i] ) >= 0);
+   tlinear = SDL_GetPerformanceCounter() - start;
+
+   if (nhash != nlinear)
+      WARN(_("Name index found %d names but the linear search found %d!"), nhash, nlinear);
+
+   LOG(_("Benchmark '%s' results (%d lookups in %d indices replayed %d times, %d found):"), scenario,
+         n, nidx, BENCHMARK_LOOKUPS, nhash / BENCHMARK_LOOKUPS);
+   benchmark_logStage( scenario, "nameindex", thash, thash+tlinear, n*BENCHMARK_LOOKUPS );
+   benchmark_logStage( scenario, "linear", tlinear, thash+tlinear, n*BENCHMARK_LOOKUPS );
+
+   for (int k=0; k<nidx; k++)
+      array_free( lists[k].slots );
+   free( lists );
+   return 0;
+}
+
+/**
+ * @brief Runs all the benchmark scenarios.
+ *
+ *    @param n Number of updates to run for each scenario.
+ *    @return 0 on success.
+ */
+int benchmark_run( int n )
+{
+   int ret = 0;
+   int ai_budget = conf.ai_budget;
+   NameIndexTrace *trace;
+   conf.ai_budget = 0;
+   nameindex_traceStart();
+   for (size_t i=0; i<sizeof(benchmark_scenarios)/sizeof(benchmark_scenarios[0]); i++)
+      ret |= benchmark_scenario( &benchmark_scenarios[i], n );
+   ret |= benchmark_hooks( n );
+   ret |= benchmark_pathfinding( n );
+   ret |= benchmark_safelanes();
+   ret |= benchmark_spawning( n );
+   trace = nameindex_traceStop();
+   ret |= benchmark_lookups( "lookups", trace );
+   nameindex_traceFree( trace );
+   conf.ai_budget = ai_budget;
+   return ret;
+}
+
+/**
+ * @brief Runs a Lua script from the data as a benchmark.
+ *
+ * The script is run with the standard libraries in an empty system and with
+ *  the random numbers seeded, so its results are comparable between runs. It
+ *  can report its own timings, the whole run is reported as well.
+ *
+ *    @param path Path of the script in the data.
+ *    @return 0 on success.
+ */
+int benchmark_script( const char *path )
+{
+   nlua_env env;
+   char *buf;
+   size_t bufsize;
+   Uint64 start, total;
+   int ret;
+   int ai_budget;
+   NameIndexTrace *trace;
+
+   buf = ndata_read( path, &bufsize );
+   if (buf == NULL) {
+      WARN(_("Benchmark script '%s' not found!"), path);
+      return -1;
+   }
+
+   LOG(_("Running benchmark script '%s'."), path);
+   ai_budget = conf.ai_budget;
+   conf.ai_budget = 0;
+   rng_seed( BENCHMARK_SEED );
+   pilots_cleanAll();
+   space_init( BENCHMARK_SYSTEM, 0 );
+   pilots_cleanAll();
+   space_spawn = 0;
+   rng_seed( BENCHMARK_SEED );
+
+   env = nlua_newEnv();
+   nlua_loadStandard( env );
+   nameindex_traceStart();
+   start = SDL_GetPerformanceCounter();
+   ret = nlua_dobufenv( env, buf, bufsize, path );
+   total = SDL_GetPerformanceCounter() - start;
+   trace = nameindex_traceStop();
+   if (ret != 0)
+      WARN(_("Benchmark script '%s' failed:\n%s"), path, lua_tostring( naevL, -1 ));
+   else {
+      LOG(_("Benchmark '%s' results:"), path);
+      benchmark_logStage( path, "total", total, total, 1 );
+      /* Lookups the script made. */
+      if ((trace != NULL) && (array_size(trace->names) > 0))
+         benchmark_lookups( path, trace );
+   }
+   nameindex_traceFree( trace );
+   nlua_freeEnv( env );
+   free( buf );
+
+   pilots_cleanAll();
+   weapon_clear();
+   conf.ai_budget = ai_budget;
+   return ret;
+}
@@ -0,0 +1,7 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+int benchmark_run( int n );
+int benchmark_script( const char *path );
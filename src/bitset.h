@@ -0,0 +1,64 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/**
+ * @file bitset.h
+ *
+ * @brief Dense bitsets of non-negative IDs.
+ *
+ * The bitsets are arrays (array.h) of 32 bit words that grow as needed when
+ *  setting bits, NULL being a valid empty bitset.
+ */
+/** @cond */
+#include <stdint.h>
+#include <string.h>
+/** @endcond */
+
+#include "array.h"
+
+/**
+ * @brief Sets a bit of a bitset, growing it if necessary.
+ *
+ *    @param bits Bitset to set the bit of.
+ *    @param id Bit to set.
+ */
+static inline void bitset_set( uint32_t **bits, int id )
+{
+   int w = id / 32;
+   if (*bits == NULL)
+      *bits = array_create( uint32_t );
+   if (w >= array_size(*bits)) {
+      int n = array_size(*bits);
+      array_resize( bits, w+1 );
+      memset( &(*bits)[n], 0, (w+1-n) * sizeof(uint32_t) );
+   }
+   (*bits)[w] |= 1u << (id % 32);
+}
+
+/**
+ * @brief Tests a bit of a bitset.
+ *
+ *    @param bits Bitset to test.
+ *    @param id Bit to test.
+ *    @return 1 if the bit is set, 0 otherwise.
+ */
+static inline int bitset_test( const uint32_t *bits, int id )
+{
+   int w = id / 32;
+   if ((id < 0) || (w >= array_size(bits)))
+      return 0;
+   return !!(bits[w] & (1u << (id % 32)));
+}
+
+/**
+ * @brief Clears all the bits of a bitset.
+ *
+ *    @param bits Bitset to clear.
+ */
+static inline void bitset_clear( uint32_t *bits )
+{
+   if (bits != NULL)
+      memset( bits, 0, array_size(bits) * sizeof(uint32_t) );
+}
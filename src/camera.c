@@ -19,10 +19,14 @@
 #include "log.h"
 #include "nebula.h"
 #include "pause.h"
+#include "pilot.h"
 #include "player.h"
 #include "space.h"
 
 #define CAMERA_DIR      (M_PI/2.)
+#define CAMERA_AHEAD_TIME        3.    /**< Seconds of the camera path to look ahead. */
+#define CAMERA_PREFETCH_INTERVAL 0.25  /**< Seconds between the prefetches. */
+#define CAMERA_PREFETCH_MARGIN   200.  /**< Screen pixels around the view to prefetch. */
 
 static unsigned int camera_followpilot = 0; /**< Pilot to follow. */
 static int zoom_override   = 0; /**< Whether or not to override the zoom. */
@@ -44,6 +48,12 @@ static double target_Y     = 0.; /**< Target Y position. */
 static int camera_fly      = 0; /**< Camera is flying to target. */
 static double camera_flyspeed = 0.; /**< Speed when flying. */
 static double camera_zoomspeed = 0.; /**< Speed when zooming. */
+static double camera_prefetch_timer = 0.; /**< Time left until the next prefetch. */
+/* Interpolation between fixed updates. */
+static double interp_X     = 0.; /**< X position before the last fixed update. */
+static double interp_Y     = 0.; /**< Y position before the last fixed update. */
+static double interp_realX = 0.; /**< Real X position while rendering. */
+static double interp_realY = 0.; /**< Real Y position while rendering. */
 
 /*
  * Prototypes.
@@ -52,6 +62,7 @@ static void cam_updateFly( double x, double y, double dt );
 static void cam_updatePilot( Pilot *follow, double dt );
 static void cam_updatePilotZoom( const Pilot *follow, const Pilot *target, double dt );
 static void cam_updateManualZoom( double dt );
+static void cam_prefetch( double dt );
 
 /**
  * @brief Overrides the zoom system.
@@ -121,6 +132,67 @@ void cam_getPos( double *x, double *y )
    *y = camera_Y;
 }
 
+/**
+ * @brief Gets the part of the system shown on screen.
+ *
+ *    @param[out] x1 Left edge in game coordinates.
+ *    @param[out] y1 Bottom edge in game coordinates.
+ *    @param[out] x2 Right edge in game coordinates.
+ *    @param[out] y2 Top edge in game coordinates.
+ *    @param margin Space to add around the screen, in screen pixels.
+ */
+void cam_getViewRect( double *x1, double *y1, double *x2, double *y2, double margin )
+{
+   double gx, gy, z;
+
+   /* Inverse of gl_gameToScreenCoords. */
+   z = cam_getZoom();
+   gui_getOffset( &gx, &gy );
+   *x1 = camera_X + (-margin - gx - SCREEN_W*0.5) / z;
+   *y1 = camera_Y + (-margin - gy - SCREEN_H*0.5) / z;
+   *x2 = camera_X + (SCREEN_W*0.5 + margin - gx) / z;
+   *y2 = camera_Y + (SCREEN_H*0.5 + margin - gy) / z;
+}
+
+/**
+ * @brief Gets the part of the system that will be shown on screen soon.
+ *
+ * Covers the current view and where it will be a few seconds ahead, going by
+ *  the velocity of the camera and the zoom it is heading to.
+ *
+ *    @param[out] x1 Left edge in game coordinates.
+ *    @param[out] y1 Bottom edge in game coordinates.
+ *    @param[out] x2 Right edge in game coordinates.
+ *    @param[out] y2 Top edge in game coordinates.
+ *    @param margin Space to add around the screen, in screen pixels.
+ */
+void cam_getAheadRect( double *x1, double *y1, double *x2, double *y2, double margin )
+{
+   double gx, gy, z, ax, ay;
+
+   /* Zooming out shows more, so go with the farthest zoom. */
+   z = cam_getZoom();
+   if (target_Z > 0.)
+      z = MIN( z, target_Z );
+   gui_getOffset( &gx, &gy );
+   *x1 = camera_X + (-margin - gx - SCREEN_W*0.5) / z;
+   *y1 = camera_Y + (-margin - gy - SCREEN_H*0.5) / z;
+   *x2 = camera_X + (SCREEN_W*0.5 + margin - gx) / z;
+   *y2 = camera_Y + (SCREEN_H*0.5 + margin - gy) / z;
+
+   /* Sweep it along the path. */
+   ax = camera_VX * CAMERA_AHEAD_TIME;
+   ay = camera_VY * CAMERA_AHEAD_TIME;
+   if (ax < 0.)
+      *x1 += ax;
+   else
+      *x2 += ax;
+   if (ay < 0.)
+      *y1 += ay;
+   else
+      *y2 += ay;
+}
+
 /**
  * @brief Gets the camera position differential (change in last frame).
  */
@@ -163,6 +235,8 @@ void cam_setTargetPilot( unsigned int follow, int soft_over )
             camera_Y = y;
             old_X    = x;
             old_Y    = y;
+            interp_X = x;
+            interp_Y = y;
          }
       }
       camera_fly = 0;
@@ -190,6 +264,8 @@ void cam_setTargetPos( double x, double y, int soft_over )
       camera_Y = y;
       old_X    = x;
       old_Y    = y;
+      interp_X = x;
+      interp_Y = y;
       camera_fly = 0;
    }
    else {
@@ -213,6 +289,42 @@ int cam_getTarget( void )
    return camera_followpilot;
 }
 
+/**
+ * @brief Stores the camera position before a fixed update.
+ */
+void cam_interpStore (void)
+{
+   interp_X = camera_X;
+   interp_Y = camera_Y;
+}
+
+/**
+ * @brief Moves the camera to where it is rendered between fixed updates.
+ *
+ * Has to be followed by cam_interpEnd once done rendering.
+ *
+ *    @param alpha Fraction of a fixed update left over after the last one.
+ */
+void cam_interpBegin( double alpha )
+{
+   interp_realX = camera_X;
+   interp_realY = camera_Y;
+   /* Jumped somewhere else, like when the player enters a system. */
+   if (pow2(camera_X-interp_X) + pow2(camera_Y-interp_Y) > pow2(SCREEN_W+SCREEN_H))
+      return;
+   camera_X = interp_X + alpha*(camera_X-interp_X);
+   camera_Y = interp_Y + alpha*(camera_Y-interp_Y);
+}
+
+/**
+ * @brief Puts the camera back where it really is after rendering.
+ */
+void cam_interpEnd (void)
+{
+   camera_X = interp_realX;
+   camera_Y = interp_realY;
+}
+
 /**
  * @brief Updates the camera.
  *
@@ -277,9 +389,32 @@ void cam_update( double dt )
    camera_DX = (camera_X - camera_DX);
    camera_DY = (camera_Y - camera_DY);
 
-   /* Compute velocity. */
-   camera_VX = camera_DX / dt;
-   camera_VY = camera_DY / dt;
+   /* Compute velocity, snapping the camera with no time passing keeps the old one. */
+   if (dt > 0.) {
+      camera_VX = camera_DX / dt;
+      camera_VY = camera_DY / dt;
+      cam_prefetch( dt );
+   }
+}
+
+/**
+ * @brief Warms up what is about to come into view.
+ *
+ * Textures, sounds and sprite sheets otherwise get loaded or created when
+ *  first used, which hitches during fast approaches. Spobs ahead are kept
+ *  updated by space_update using cam_getAheadRect.
+ */
+static void cam_prefetch( double dt )
+{
+   double x1, y1, x2, y2;
+
+   camera_prefetch_timer -= dt;
+   if (camera_prefetch_timer > 0.)
+      return;
+   camera_prefetch_timer = CAMERA_PREFETCH_INTERVAL;
+
+   cam_getAheadRect( &x1, &y1, &x2, &y2, CAMERA_PREFETCH_MARGIN );
+   pilots_prefetch( x1, y1, x2, y2 );
 }
 
 /**
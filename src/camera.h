@@ -11,6 +11,8 @@
 double cam_getZoom (void);
 double cam_getZoomTarget (void);
 void cam_getPos( double *x, double *y );
+void cam_getViewRect( double *x1, double *y1, double *x2, double *y2, double margin );
+void cam_getAheadRect( double *x1, double *y1, double *x2, double *y2, double margin );
 void cam_getDPos( double *dx, double *dy );
 void cam_getVel( double *vx, double *vy );
 int cam_getTarget( void );
@@ -28,3 +30,6 @@ void cam_setTargetPos( double x, double y, int soft_over );
  * Update.
  */
 void cam_update( double dt );
+void cam_interpStore (void);
+void cam_interpBegin( double alpha );
+void cam_interpEnd (void);
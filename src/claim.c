@@ -13,6 +13,7 @@
 #include "claim.h"
 
 #include "array.h"
+#include "bitset.h"
 #include "event.h"
 #include "log.h"
 #include "mission.h"
@@ -24,6 +25,7 @@
 struct Claim_s {
    int active;    /**< Have we, in fact, claimed these contents?. */
    int *ids;      /**< System ids. */
+   uint32_t *sysbits; /**< Bitset (bitset.h) of the claimed system ids. */
    char **strs;   /**< Strings. */
    int exclusive; /**< Whether or not this claim is exclusive. Exclusive claims
       do not allow other claims to work, but non-exclusive do not have this issue,
@@ -31,7 +33,47 @@ struct Claim_s {
       exclusive claims. */
 };
 
-static char **claimed_strs = NULL; /**< Global claimed strings. */
+/**
+ * @brief String claimed by the active claims.
+ */
+typedef struct ClaimedStr_ {
+   char *str;  /**< Claimed string. */
+   int n;      /**< Number of active claims with the string. */
+} ClaimedStr;
+
+static ClaimedStr *claimed_strs = NULL; /**< Global claimed strings, sorted (array.h). */
+
+/*
+ * Prototypes.
+ */
+static int claim_strFind( const char *str, int *pos );
+
+/**
+ * @brief Looks for a globally claimed string.
+ *
+ *    @param str String to look for.
+ *    @param[out] pos Position it is at or should be inserted at.
+ *    @return 1 if the string is claimed, 0 otherwise.
+ */
+static int claim_strFind( const char *str, int *pos )
+{
+   int lo = 0;
+   int hi = array_size(claimed_strs);
+   while (lo < hi) {
+      int mid = (lo+hi) / 2;
+      int c = strcmp( claimed_strs[mid].str, str );
+      if (c == 0) {
+         *pos = mid;
+         return 1;
+      }
+      if (c < 0)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   *pos = lo;
+   return 0;
+}
 
 /**
  * @brief Creates a system claim.
@@ -44,6 +86,7 @@ Claim_t *claim_create( int exclusive )
    Claim_t *claim= malloc( sizeof(Claim_t) );
    claim->active = 0;
    claim->ids    = NULL;
+   claim->sysbits = NULL;
    claim->strs   = NULL;
    claim->exclusive = exclusive;
 
@@ -83,6 +126,7 @@ int claim_addSys( Claim_t *claim, int ss_id )
 
    /* New ID. */
    array_push_back( &claim->ids, ss_id );
+   bitset_set( &claim->sysbits, ss_id );
    return 0;
 }
 
@@ -129,10 +173,9 @@ int claim_test( const Claim_t *claim )
 
    /* Check strings. */
    for (int i=0; i<array_size(claim->strs); i++) {
-      for (int j=0; j<array_size(claimed_strs); j++) {
-         if (strcmp( claim->strs[i], claimed_strs[j] )==0)
-            return 1;
-      }
+      int pos;
+      if (claim_strFind( claim->strs[i], &pos ))
+         return 1;
    }
 
    return 0;
@@ -174,11 +217,7 @@ int claim_testSys( const Claim_t *claim, int sys )
       return 0;
 
    /* See if the system is claimed. */
-   for (int i=0; i<array_size(claim->ids); i++)
-      if (claim->ids[i] == sys)
-         return 1;
-
-   return 0;
+   return bitset_test( claim->sysbits, sys );
 }
 
 /**
@@ -198,15 +237,14 @@ void claim_destroy( Claim_t *claim )
       }
    }
    array_free( claim->ids );
+   array_free( claim->sysbits );
 
    for (int i=0; i<array_size(claim->strs); i++) {
-      if (claim->active) {
-         for (int j=0; j<array_size(claimed_strs); j++) {
-            if (strcmp(claim->strs[i], claimed_strs[j])==0) {
-               free( claimed_strs[j] );
-               array_erase( &claimed_strs, &claimed_strs[j], &claimed_strs[j+1] );
-               break;
-            }
+      int pos;
+      if (claim->active && claim_strFind( claim->strs[i], &pos )) {
+         if (--claimed_strs[pos].n <= 0) {
+            free( claimed_strs[pos].str );
+            array_erase( &claimed_strs, &claimed_strs[pos], &claimed_strs[pos+1] );
          }
       }
       free( claim->strs[i] );
@@ -228,7 +266,7 @@ void claim_clear (void)
    }
 
    for (int i=0; i<array_size(claimed_strs); i++)
-      free(claimed_strs[i]);
+      free(claimed_strs[i].str);
    array_free(claimed_strs);
    claimed_strs = NULL;
 }
@@ -261,9 +299,19 @@ void claim_activate( Claim_t *claim )
 
    /* Add strings. */
    if ((claimed_strs == NULL) && (array_size(claim->strs) > 0))
-      claimed_strs = array_create( char* );
-   for (int i=0; i<array_size(claim->strs); i++)
-      array_push_back( &claimed_strs, strdup( claim->strs[i] ) );
+      claimed_strs = array_create( ClaimedStr );
+   for (int i=0; i<array_size(claim->strs); i++) {
+      int pos;
+      if (claim_strFind( claim->strs[i], &pos ))
+         claimed_strs[pos].n++;
+      else {
+         ClaimedStr cs = { .str = strdup( claim->strs[i] ), .n = 1 };
+         array_push_back( &claimed_strs, cs );
+         memmove( &claimed_strs[pos+1], &claimed_strs[pos],
+               (array_size(claimed_strs)-pos-1) * sizeof(ClaimedStr) );
+         claimed_strs[pos] = cs;
+      }
+   }
    claim->active = 1;
 }
 
@@ -21,6 +21,14 @@
 /*
  * Prototypes
  */
+static inline int PolygonEdgeWinding( float xi, float yi, float xj, float yj,
+      float x, float y );
+static inline double LineSide( double sx, double sy, double dx, double dy,
+      double x, double y );
+static inline int LineMissesEdge( double ci, double cj );
+static inline uint64_t TransRow( const glTexture *t, int x, int y );
+static inline uint64_t TransSpan( int n );
+static inline int TransFirstBit( uint64_t m );
 static int PointInPolygon( const CollPoly* at, const vec2* ap,
       float x, float y );
 static int LineOnPolygon( const CollPoly* at, const vec2* ap,
@@ -83,6 +91,50 @@ void FreePolygon( CollPoly *polygon )
    array_free( polygon->y );
 }
 
+/**
+ * @brief Gets the opacity of 64 pixels of a row of a transparency bitmask.
+ *
+ *    @param t Texture to get the bits of.
+ *    @param x X position of the first pixel in the sheet.
+ *    @param y Y position of the row in the sheet.
+ *    @return Bits set for the opaque pixels, starting at x with the lowest bit.
+ */
+static inline uint64_t TransRow( const glTexture *t, int x, int y )
+{
+   int w = x / 64;
+   int b = x % 64;
+   const uint64_t *row = &t->trans[ y*t->trans_w ];
+   uint64_t bits = row[w] >> b;
+   if ((b > 0) && (w+1 < t->trans_w))
+      bits |= row[w+1] << (64-b);
+   return bits;
+}
+
+/**
+ * @brief Gets a mask of the n lowest bits, up to 64.
+ */
+static inline uint64_t TransSpan( int n )
+{
+   return (n >= 64) ? ~UINT64_C(0) : ((UINT64_C(1) << n) - 1);
+}
+
+/**
+ * @brief Gets the position of the lowest set bit, which must exist.
+ */
+static inline int TransFirstBit( uint64_t m )
+{
+#if defined(__GNUC__)
+   return __builtin_ctzll( m );
+#else /* defined(__GNUC__) */
+   int n = 0;
+   while (!(m & 1)) {
+      m >>= 1;
+      n++;
+   }
+   return n;
+#endif /* defined(__GNUC__) */
+}
+
 /**
  * @brief Checks whether or not two sprites collide.
  *
@@ -155,17 +207,20 @@ int CollideSprite( const glTexture* at, const int asx, const int asy, const vec2
    bbx =  bsx*(int)(bt->sw) - bx1;
    bby = rbsy*(int)(bt->sh) - by1;
 
-   for (y=inter_y0; y<=inter_y1; y++)
-      for (x=inter_x0; x<=inter_x1; x++)
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ((!gl_isTrans(at, abx + x, aby + y)) &&
-               (!gl_isTrans(bt, bbx + x, bby + y))) {
-
+   /* Test 64 pixels of each row at a time. */
+   for (y=inter_y0; y<=inter_y1; y++) {
+      for (x=inter_x0; x<=inter_x1; x+=64) {
+         uint64_t m = TransRow( at, abx + x, aby + y ) &
+               TransRow( bt, bbx + x, bby + y ) &
+               TransSpan( inter_x1 - x + 1 );
+         if (m) {
             /* Set the crash position. */
-            crash->x = x;
+            crash->x = x + TransFirstBit( m );
             crash->y = y;
             return 1;
          }
+      }
+   }
 
    return 0;
 }
@@ -230,14 +285,17 @@ int CollideSpritePolygon( const CollPoly* at, const vec2* ap,
    bbx =  bsx*(int)(bt->sw) - bx1;
    bby = rbsy*(int)(bt->sh) - by1;
    for (y=inter_y0; y<=inter_y1; y++) {
-      for (x=inter_x0; x<=inter_x1; x++) {
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ((!gl_isTrans(bt, bbx + x, bby + y))) {
-            if (PointInPolygon( at, ap, (float)x, (float)y )) {
-               crash->x = x;
+      for (x=inter_x0; x<=inter_x1; x+=64) {
+         /* Only test the opaque pixels. */
+         uint64_t m = TransRow( bt, bbx + x, bby + y ) & TransSpan( inter_x1 - x + 1 );
+         while (m) {
+            int px = x + TransFirstBit( m );
+            if (PointInPolygon( at, ap, (float)px, (float)y )) {
+               crash->x = px;
                crash->y = y;
                return 1;
             }
+            m &= m-1;
          }
       }
    }
@@ -330,12 +388,29 @@ int CollidePolygon( const CollPoly* at, const vec2* ap,
  *    @param[in] theta Rotation angle (radian).
  */
 void RotatePolygon( CollPoly* rpolygon, CollPoly* ipolygon, float theta )
+{
+   RotatePolygonInto( rpolygon, ipolygon, theta,
+         malloc( ipolygon->npt*sizeof(float) ),
+         malloc( ipolygon->npt*sizeof(float) ) );
+}
+
+/**
+ * @brief Rotates a polygon into already allocated memory.
+ *
+ *    @param[out] rpolygon Rotated polygon, takes the points but not ownership.
+ *    @param[in] ipolygon Imput polygon.
+ *    @param[in] theta Rotation angle (radian).
+ *    @param[out] x Where to store the X coordinates, must fit all the points.
+ *    @param[out] y Where to store the Y coordinates, must fit all the points.
+ */
+void RotatePolygonInto( CollPoly* rpolygon, const CollPoly* ipolygon, float theta,
+      float *x, float *y )
 {
    float ct, st;
 
    rpolygon->npt = ipolygon->npt;
-   rpolygon->x = malloc( ipolygon->npt*sizeof(float) );
-   rpolygon->y = malloc( ipolygon->npt*sizeof(float) );
+   rpolygon->x = x;
+   rpolygon->y = y;
    rpolygon->xmin = 0;
    rpolygon->xmax = 0;
    rpolygon->ymin = 0;
@@ -357,9 +432,60 @@ void RotatePolygon( CollPoly* rpolygon, CollPoly* ipolygon, float theta )
    }
 }
 
+/**
+ * @brief Gets how much an edge of a polygon winds around a point.
+ *
+ *    @return 1 if the edge crosses upwards with the point on the left, -1 if
+ *            it crosses downwards with the point on the right, 0 otherwise.
+ */
+static inline int PolygonEdgeWinding( float xi, float yi, float xj, float yj,
+      float x, float y )
+{
+   float left = (xj-xi) * (y-yi) - (x-xi) * (yj-yi);
+   int up     = (yi <= y) & (yj > y) & (left > 0.);
+   int down   = (yi > y) & (yj <= y) & (left < 0.);
+   return up - down;
+}
+
+/**
+ * @brief Gets what side of a line a point is on.
+ *
+ *    @param sx X start of the line.
+ *    @param sy Y start of the line.
+ *    @param dx X direction of the line.
+ *    @param dy Y direction of the line.
+ *    @param x X coordinate of the point.
+ *    @param y Y coordinate of the point.
+ *    @return Positive on the left, negative on the right, 0 on the line.
+ */
+static inline double LineSide( double sx, double sy, double dx, double dy,
+      double x, double y )
+{
+   return dx * (y-sy) - dy * (x-sx);
+}
+
+/**
+ * @brief Checks whether a line can't hit an edge, without doing the division of
+ *        CollideLineLine.
+ *
+ *    @param ci Side of the line the first point of the edge is on.
+ *    @param cj Side of the line the second point of the edge is on.
+ *    @return 1 if both points are strictly on the same side of the line and
+ *            the edge is not parallel to it, so CollideLineLine returns 0.
+ */
+static inline int LineMissesEdge( double ci, double cj )
+{
+   return (ci != cj) && (((ci > 0.) && (cj > 0.)) || ((ci < 0.) && (cj < 0.)));
+}
+
 /**
  * @brief Checks whether or not a point is inside a polygon.
  *
+ * Uses the winding number of the polygon around the point, which is the same
+ *  as adding up the angles of the edges but without any trigonometry. The
+ *  edges are independent of each other and the loop is branchless so that the
+ *  compiler can vectorize it.
+ *
  *    @param[in] at Polygon a.
  *    @param[in] ap Position in space of polygon a.
  *    @param[in] x Coordiante of point.
@@ -369,35 +495,22 @@ void RotatePolygon( CollPoly* rpolygon, CollPoly* ipolygon, float theta )
 static int PointInPolygon( const CollPoly* at, const vec2* ap,
       float x, float y )
 {
-   float vprod, sprod, angle;
-   float dxi, dxip, dyi, dyip;
-
-   /* See if the pixel is inside the polygon:
-      We increment the angle when doing a loop along all the points
-      If the final angle is 0, we are outside the polygon
-      Otherwise, the angle should be +/- 2pi*/
-   angle = 0.0;
-   for (int i=0; i<=at->npt-2; i++) {
-      dxi  = at->x[i]  +VX(*ap)-x;
-      dxip = at->x[i+1]+VX(*ap)-x;
-      dyi  = at->y[i]  +VY(*ap)-y;
-      dyip = at->y[i+1]+VY(*ap)-y;
-      sprod = dxi * dxip + dyi * dyip;
-      vprod = dxi * dyip - dyi * dxip;
-      angle += atan2(vprod, sprod);
-   }
-   dxi  = at->x[at->npt-1] + VX(*ap) - x;
-   dxip = at->x[0] + VX(*ap) - x;
-   dyi  = at->y[at->npt-1] + VY(*ap)- y;
-   dyip = at->y[0] + VY(*ap) - y;
-   sprod = dxi * dxip + dyi * dyip;
-   vprod = dxi * dyip - dyi * dxip;
-   angle += atan2(vprod, sprod);
-
-   if (FABS(angle) < 1e-5)
-      return 0;
+   const float *restrict px = at->x;
+   const float *restrict py = at->y;
+   int wn;
 
-   return 1;
+   /* Work in the polygon's coordinates. */
+   x -= VX(*ap);
+   y -= VY(*ap);
+
+   /* Closing edge. */
+   wn = PolygonEdgeWinding( px[at->npt-1], py[at->npt-1], px[0], py[0], x, y );
+
+   /* Rest of the edges. */
+   for (int i=1; i<at->npt; i++)
+      wn += PolygonEdgeWinding( px[i-1], py[i-1], px[i], py[i], x, y );
+
+   return (wn != 0);
 }
 
 /**
@@ -416,20 +529,32 @@ static int LineOnPolygon( const CollPoly* at, const vec2* ap,
       float x1, float y1, float x2, float y2, vec2* crash )
 {
    float xi, xip, yi, yip;
+   double dx, dy, ci, cip;
 
    /* In this function, we are only looking for one collision point. */
 
+   /* Edges with both points on the same side of the line can be skipped. */
+   dx  = x2 - x1;
+   dy  = y2 - y1;
+
    xi  = at->x[at->npt-1] + ap->x;
    xip = at->x[0]         + ap->x;
    yi  = at->y[at->npt-1] + ap->y;
    yip = at->y[0]         + ap->y;
-   if ( CollideLineLine(x1, y1, x2, y2, xi, yi, xip, yip, crash) == 1 )
+   ci  = LineSide( x1, y1, dx, dy, xi, yi );
+   cip = LineSide( x1, y1, dx, dy, xip, yip );
+   if (!LineMissesEdge( ci, cip ) &&
+         (CollideLineLine(x1, y1, x2, y2, xi, yi, xip, yip, crash) == 1))
       return 1;
    for (int i=0; i<=at->npt-2; i++) {
-      xi  = at->x[i]   + ap->x;
+      xi  = xip;
+      yi  = yip;
+      ci  = cip;
       xip = at->x[i+1] + ap->x;
-      yi  = at->y[i]   + ap->y;
       yip = at->y[i+1] + ap->y;
+      cip = LineSide( x1, y1, dx, dy, xip, yip );
+      if (LineMissesEdge( ci, cip ))
+         continue;
       if ( CollideLineLine(x1, y1, x2, y2, xi, yi, xip, yip, crash) == 1 )
          return 1;
    }
@@ -659,6 +784,7 @@ int CollideLinePolygon( const vec2* ap, double ad, double al,
 {
    double ep[2];
    double xi, yi, xip, yip;
+   double dx, dy, ci, cip;
    int real_hits;
    vec2 tmp_crash;
 
@@ -728,13 +854,18 @@ int CollideLinePolygon( const vec2* ap, double ad, double al,
    }
 
    /*
-    * Now we check any line of the polygon
+    * Now we check any line of the polygon, skipping the ones that are
+    * entirely on one side of the line.
     */
+   dx  = ep[0] - ap->x;
+   dy  = ep[1] - ap->y;
    xi  = (double)bt->x[bt->npt-1] + bp->x;
    xip = (double)bt->x[0]         + bp->x;
    yi  = (double)bt->y[bt->npt-1] + bp->y;
    yip = (double)bt->y[0]         + bp->y;
-   if ( CollideLineLine(ap->x, ap->y, ep[0], ep[1],
+   ci  = LineSide( ap->x, ap->y, dx, dy, xi, yi );
+   cip = LineSide( ap->x, ap->y, dx, dy, xip, yip );
+   if ( !LineMissesEdge( ci, cip ) && CollideLineLine(ap->x, ap->y, ep[0], ep[1],
         xi, yi, xip, yip, &tmp_crash) ) {
       crash[real_hits].x = tmp_crash.x;
       crash[real_hits].y = tmp_crash.y;
@@ -743,10 +874,14 @@ int CollideLinePolygon( const vec2* ap, double ad, double al,
          return 1;
    }
    for (int i=0; i<=bt->npt-2; i++) {
-      xi  = (double)bt->x[i]   + bp->x;
+      xi  = xip;
+      yi  = yip;
+      ci  = cip;
       xip = (double)bt->x[i+1] + bp->x;
-      yi  = (double)bt->y[i]   + bp->y;
       yip = (double)bt->y[i+1] + bp->y;
+      cip = LineSide( ap->x, ap->y, dx, dy, xip, yip );
+      if (LineMissesEdge( ci, cip ))
+         continue;
       if ( CollideLineLine(ap->x, ap->y, ep[0], ep[1],
            xi, yi, xip, yip, &tmp_crash) ) {
          crash[real_hits].x = tmp_crash.x;
@@ -914,14 +1049,17 @@ int CollideCircleSprite( const vec2 *ap, double ar, const glTexture* bt,
    bbx =  bsx*(int)(bt->sw) - bx1;
    bby = rbsy*(int)(bt->sh) - by1;
    for (int y=inter_y0; y<=inter_y1; y++) {
-      for (int x=inter_x0; x<=inter_x1; x++) {
-         /* compute offsets for surface before pass to TransparentPixel test */
-         if ((!gl_isTrans(bt, bbx + x, bby + y))) {
-            if (pow2(x-acx)+pow2(y-acy) <= r*r) {
-               crash->x = x;
+      for (int x=inter_x0; x<=inter_x1; x+=64) {
+         /* Only test the opaque pixels. */
+         uint64_t m = TransRow( bt, bbx + x, bby + y ) & TransSpan( inter_x1 - x + 1 );
+         while (m) {
+            int px = x + TransFirstBit( m );
+            if (pow2(px-acx)+pow2(y-acy) <= r*r) {
+               crash->x = px;
                crash->y = y;
                return 1;
             }
+            m &= m-1;
          }
       }
    }
@@ -26,6 +26,8 @@ void FreePolygon( CollPoly *polygon );
 
 /* Rotates a polygon. */
 void RotatePolygon( CollPoly *rpolygon, CollPoly *ipolygon, float theta );
+void RotatePolygonInto( CollPoly *rpolygon, const CollPoly *ipolygon, float theta,
+      float *x, float *y );
 
 /* Returns 1 if collision is detected */
 int CollideSprite( const glTexture* at, const int asx, const int asy, const vec2* ap,
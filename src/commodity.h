@@ -76,6 +76,9 @@ typedef struct CommodityPrice_ {
    double sum;     /**< used when averaging over jump points during setup, and then for capturing the moving average when the player visits a spob. */
    double sum2;    /**< sum of (squared prices seen), used for calc of standard deviation. */
    int cnt;        /**< used for calc of mean and standard deviation - number of records in the data. */
+   unsigned int cache_gen; /**< Economy price generation of the cached price, 0 if not cached. */
+   int64_t cache_time;     /**< Time the cached price was computed for. */
+   credits_t cache_price;  /**< Cached price. */
 } CommodityPrice;
 
 /*
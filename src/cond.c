@@ -5,18 +5,41 @@
  * @file cond.c
  *
  * @brief Handles lua conditionals.
+ *
+ * Conditionals are compiled once and the chunks are cached by their string,
+ *  so checking the same conditional again only has to run it.
  */
 /** @cond */
+#include <stdlib.h>
+#include <string.h>
+
 #include "naev.h"
 /** @endcond */
 
 #include "cond.h"
 
+#include "array.h"
 #include "log.h"
 #include "nlua.h"
 #include "nluadef.h"
 
+/**
+ * @brief Compiled conditional.
+ */
+typedef struct CondChunk_ {
+   char *cond; /**< Conditional string. */
+   int chunk;  /**< Compiled chunk or LUA_NOREF if it failed to compile. */
+} CondChunk;
+
 static nlua_env cond_env = LUA_NOREF; /** Conditional Lua env. */
+static CondChunk *cond_chunks = NULL; /**< Array (array.h): Compiled conditionals sorted by string. */
+static Uint64 cond_time = 0; /**< Performance counter ticks spent checking conditionals. */
+static int cond_ncheck  = 0; /**< Number of conditionals checked. */
+
+/*
+ * Prototypes.
+ */
+static int cond_compileRaw( const char *cond );
 
 /**
  * @brief Initializes the conditional subsystem.
@@ -40,17 +63,67 @@ int cond_init (void)
  */
 void cond_exit (void)
 {
+   for (int i=0; i<array_size(cond_chunks); i++) {
+      free( cond_chunks[i].cond );
+      if (cond_chunks[i].chunk != LUA_NOREF)
+         luaL_unref( naevL, LUA_REGISTRYINDEX, cond_chunks[i].chunk );
+   }
+   array_free( cond_chunks );
+   cond_chunks = NULL;
+
    nlua_freeEnv(cond_env);
    cond_env = LUA_NOREF;
 }
 
 /**
- * @brief Compiles a conditional statement that can then be used as a reference.
+ * @brief Compares a conditional string with a compiled conditional for bsearch.
+ */
+static int cond_cmp( const void *key, const void *p )
+{
+   const CondChunk *cc = p;
+   return strcmp( key, cc->cond );
+}
+
+/**
+ * @brief Gets the compiled chunk of a conditional statement, compiling it if necessary.
+ *
+ * The chunk is owned by the conditional subsystem and must not be unreferenced.
  *
  *    @param cond Conditional string to compile.
  *    @return LUA_NOREF on failure, a valid reference otherwise.
  */
 int cond_compile( const char *cond )
+{
+   const CondChunk *found;
+   CondChunk cc;
+   int pos;
+
+   found = bsearch( cond, cond_chunks, array_size(cond_chunks), sizeof(CondChunk), cond_cmp );
+   if (found != NULL)
+      return found->chunk;
+
+   /* Compile and keep sorted, failures are kept so they only warn once. */
+   if (cond_chunks == NULL)
+      cond_chunks = array_create( CondChunk );
+   for (pos=0; pos<array_size(cond_chunks); pos++)
+      if (strcmp( cond, cond_chunks[pos].cond ) < 0)
+         break;
+   cc.cond  = strdup( cond );
+   cc.chunk = cond_compileRaw( cond );
+   array_push_back( &cond_chunks, cc );
+   memmove( &cond_chunks[pos+1], &cond_chunks[pos],
+         (array_size(cond_chunks)-pos-1) * sizeof(CondChunk) );
+   cond_chunks[pos] = cc;
+   return cc.chunk;
+}
+
+/**
+ * @brief Compiles a conditional statement.
+ *
+ *    @param cond Conditional string to compile.
+ *    @return LUA_NOREF on failure, a valid reference otherwise.
+ */
+static int cond_compileRaw( const char *cond )
 {
    int ret, ref;
    char buf[STRMAX_SHORT];
@@ -97,70 +170,34 @@ cond_err:
  */
 int cond_check( const char *cond )
 {
-   int ret;
-   char buf[STRMAX_SHORT];
-
-   /* Load the string directly. */
-   if (strstr( cond, "return" ) != NULL) {
-      lua_pushstring(naevL, cond);
-   }
-   else {
-      /* Append "return" first. */
-      lua_pushstring(naevL, "return ");
-      lua_pushstring(naevL, cond);
-      lua_concat(naevL, 2);
-   }
-   ret = nlua_dobufenv(cond_env, lua_tostring(naevL,-1),
-                       lua_strlen(naevL,-1), "Lua Conditional");
-   switch (ret) {
-      case  LUA_ERRSYNTAX:
-         snprintf( buf, sizeof(buf), _("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
-      case LUA_ERRRUN:
-         snprintf( buf, sizeof(buf), _("Lua Conditional had a runtime error: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
-      case LUA_ERRMEM:
-         snprintf( buf, sizeof(buf), _("Lua Conditional ran out of memory: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
-      case LUA_ERRERR:
-         snprintf( buf, sizeof(buf), _("Lua Conditional had an error while handling error function: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
-      default:
-         break;
-   }
-
-   /* Check the result. */
-   if (lua_isboolean(naevL, -1)) {
-      ret = !!lua_toboolean(naevL, -1);
-      lua_pop(naevL, 1);
-
-      /* Clear the stack. */
-      lua_settop(naevL, 0);
-
-      return ret;
-   }
-   snprintf( buf, sizeof(buf), _("Lua Conditional didn't return a boolean"));
-
-cond_err:
-   print_with_line_numbers( cond );
-   WARN( "%s", buf );
-
-   /* Clear the stack. */
-   lua_settop(naevL, 0);
-   return -1;
+   int chunk = cond_compile( cond );
+   if (chunk == LUA_NOREF)
+      return -1;
+   return cond_checkChunk( chunk, cond );
 }
 
+/**
+ * @brief Checks to see if a compiled condition is true.
+ *
+ *    @param chunk Compiled condition from cond_compile.
+ *    @param cond Condition string, used for error messages.
+ *    @return 0 if is false, 1 if is true, -1 on error.
+ */
 int cond_checkChunk( int chunk, const char *cond )
 {
    char buf[STRMAX_SHORT];
    int ret;
+   Uint64 t;
 
    if (chunk==LUA_NOREF) {
       WARN(_("Trying to run Lua Conditional chunk that is not referenced!"));
       return 0;
    }
 
+   t = SDL_GetPerformanceCounter();
    ret = nlua_dochunkenv( cond_env, chunk, "Lua Conditional" );
+   cond_time += SDL_GetPerformanceCounter() - t;
+   cond_ncheck++;
    switch (ret) {
       case LUA_ERRRUN:
          snprintf( buf, sizeof(buf), _("Lua Conditional had a runtime error: %s"), lua_tostring(naevL, -1));
@@ -195,3 +232,24 @@ cond_err:
    lua_settop(naevL, 0);
    return -1;
 }
+
+/**
+ * @brief Resets the conditional check counters.
+ */
+void cond_statsReset (void)
+{
+   cond_time   = 0;
+   cond_ncheck = 0;
+}
+
+/**
+ * @brief Gets the conditional check counters since the last reset.
+ *
+ *    @param[out] n Number of conditionals checked.
+ *    @param[out] ms Milliseconds spent checking them.
+ */
+void cond_stats( int *n, double *ms )
+{
+   *n  = cond_ncheck;
+   *ms = 1000. * (double)cond_time / (double)SDL_GetPerformanceFrequency();
+}
@@ -8,3 +8,5 @@ void cond_exit (void);
 int cond_compile( const char *cond );
 int cond_check( const char *cond );
 int cond_checkChunk( int chunk, const char *cond );
+void cond_statsReset (void);
+void cond_stats( int *n, double *ms );
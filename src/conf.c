@@ -104,6 +104,12 @@ static void print_usage( void )
    LOG(_("   -d, --datapath        adds a new datapath to be mounted (i.e., appends it to the search path for game assets)"));
    LOG(_("   -X, --scale           defines the scale factor"));
    LOG(_("   --devmode             enables dev mode perks like the editors"));
+   LOG(_("   --benchmark n         runs the battle benchmark for n updates and exit"));
+   LOG(_("   --benchmark-script f  runs the Lua benchmark script f from the data and exit"));
+   LOG(_("   --profile-load        writes a load time report to the data path"));
+   LOG(_("   --profile-lua         profiles Lua and writes a per frame report to the data path"));
+   LOG(_("   --record f            records the input of the session to file f"));
+   LOG(_("   --replay f            replays the session recorded in file f as fast as possible"));
    LOG(_("   -h, --help            display this message and exit"));
    LOG(_("   -v, --version         print the version and exit"));
 }
@@ -185,6 +191,13 @@ void conf_setGameplayDefaults (void)
    conf.mouse_doubleclick     = MOUSE_DOUBLECLICK_TIME;
    conf.mouse_fly             = MOUSE_FLY_DEFAULT;
    conf.zoom_manual           = MANUAL_ZOOM_DEFAULT;
+   conf.ai_budget             = AI_BUDGET_DEFAULT;
+   conf.simulate_warmup       = SIMULATE_WARMUP_DEFAULT;
+   conf.lua_gc_budget         = LUA_GC_BUDGET_DEFAULT;
+   conf.lua_gc_pause          = LUA_GC_PAUSE_DEFAULT;
+   conf.stealth_far_interval  = STEALTH_FAR_INTERVAL_DEFAULT;
+   conf.spob_far_interval     = SPOB_FAR_INTERVAL_DEFAULT;
+   conf.autonav_fastforward   = AUTONAV_FASTFORWARD_DEFAULT;
 }
 
 /**
@@ -198,6 +211,8 @@ void conf_setAudioDefaults (void)
    conf.sound        = SOUND_VOLUME_DEFAULT;
    conf.music        = MUSIC_VOLUME_DEFAULT;
    conf.engine_vol   = ENGINE_VOLUME_DEFAULT;
+   conf.sound_stream = SOUND_STREAM_DEFAULT;
+   conf.sound_memory = SOUND_MEMORY_DEFAULT;
 }
 
 /**
@@ -238,6 +253,7 @@ void conf_setVideoDefaults (void)
    conf.explicit_dim = 0; /* No need for a define, this is only for first-run. */
    conf.scalefactor  = SCALE_FACTOR_DEFAULT;
    conf.nebu_scale   = NEBULA_SCALE_FACTOR_DEFAULT;
+   conf.nebu_refresh = NEBULA_REFRESH_DEFAULT;
    conf.minimize     = MINIMIZE_DEFAULT;
    conf.colourblind_sim = COLOURBLIND_SIM_DEFAULT;
    conf.colourblind_correct = COLOURBLIND_CORRECT_DEFAULT;
@@ -255,6 +271,7 @@ void conf_setVideoDefaults (void)
 
    /* FPS. */
    conf.fps_show     = SHOW_FPS_DEFAULT;
+   conf.frametime_show = SHOW_FRAMETIME_DEFAULT;
    conf.fps_max      = FPS_MAX_DEFAULT;
 
    /* Pause. */
@@ -332,6 +349,7 @@ int conf_loadConfig ( const char* file )
       }
       conf_loadFloat( lEnv, "scalefactor", conf.scalefactor );
       conf_loadFloat( lEnv, "nebu_scale", conf.nebu_scale );
+      conf_loadInt( lEnv, "nebu_refresh", conf.nebu_refresh );
       conf_loadBool( lEnv, "fullscreen", conf.fullscreen );
       conf_loadBool( lEnv, "modesetting", conf.modesetting );
       conf_loadBool( lEnv, "notresizable", conf.notresizable );
@@ -361,6 +379,7 @@ int conf_loadConfig ( const char* file )
 
       /* FPS */
       conf_loadBool( lEnv, "showfps", conf.fps_show );
+      conf_loadBool( lEnv, "showframetime", conf.frametime_show );
       conf_loadInt( lEnv, "maxfps", conf.fps_max );
 
       /*  Pause */
@@ -372,6 +391,8 @@ int conf_loadConfig ( const char* file )
       conf_loadFloat( lEnv, "sound", conf.sound );
       conf_loadFloat( lEnv, "music", conf.music );
       conf_loadFloat( lEnv, "engine_vol", conf.engine_vol );
+      conf_loadFloat( lEnv, "sound_stream", conf.sound_stream );
+      conf_loadInt( lEnv, "sound_memory", conf.sound_memory );
 
       /* Joystick. */
       nlua_getenv( naevL, lEnv, "joystick" );
@@ -417,6 +438,13 @@ int conf_loadConfig ( const char* file )
       conf_loadBool( lEnv, "mouse_fly", conf.mouse_fly );
       conf_loadInt( lEnv, "mouse_accel", conf.mouse_accel );
       conf_loadFloat( lEnv, "mouse_doubleclick", conf.mouse_doubleclick );
+      conf_loadInt( lEnv, "ai_budget_ticks", conf.ai_budget );
+      conf_loadFloat( lEnv, "simulate_warmup", conf.simulate_warmup );
+      conf_loadFloat( lEnv, "lua_gc_budget", conf.lua_gc_budget );
+      conf_loadInt( lEnv, "lua_gc_pause", conf.lua_gc_pause );
+      conf_loadFloat( lEnv, "stealth_far_interval", conf.stealth_far_interval );
+      conf_loadFloat( lEnv, "spob_far_interval", conf.spob_far_interval );
+      conf_loadFloat( lEnv, "autonav_fastforward", conf.autonav_fastforward );
       conf_loadFloat( lEnv, "autonav_reset_dist", conf.autonav_reset_dist );
       conf_loadFloat( lEnv, "autonav_reset_shield", conf.autonav_reset_shield );
       conf_loadBool( lEnv, "devmode", conf.devmode );
@@ -572,6 +600,12 @@ void conf_parseCLI( int argc, char** argv )
       { "svol", required_argument, 0, 's' },
       { "scale", required_argument, 0, 'X' },
       { "devmode", no_argument, 0, 'D' },
+      { "benchmark", required_argument, 0, 'B' },
+      { "benchmark-script", required_argument, 0, 'b' },
+      { "profile-load", no_argument, 0, 'P' },
+      { "profile-lua", no_argument, 0, 'L' },
+      { "record", required_argument, 0, 'R' },
+      { "replay", required_argument, 0, 'Y' },
       { "help", no_argument, 0, 'h' },
       { "version", no_argument, 0, 'v' },
       { NULL, 0, 0, 0 } };
@@ -636,6 +670,27 @@ void conf_parseCLI( int argc, char** argv )
             conf.devmode = 1;
             LOG(_("Enabling developer mode."));
             break;
+         case 'B':
+            conf.benchmark = atoi(optarg);
+            break;
+         case 'b':
+            free(conf.benchmark_script);
+            conf.benchmark_script = strdup(optarg);
+            break;
+         case 'P':
+            conf.profile_load = 1;
+            break;
+         case 'L':
+            conf.profile_lua = 1;
+            break;
+         case 'R':
+            free(conf.record);
+            conf.record = strdup(optarg);
+            break;
+         case 'Y':
+            free(conf.replay);
+            conf.replay = strdup(optarg);
+            break;
 
          case 'v':
             /* by now it has already displayed the version */
@@ -873,6 +928,11 @@ int conf_saveConfig ( const char* file )
    conf_saveFloat("nebu_scale",conf.nebu_scale);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Number of frames between full redraws of the nebula."));
+   conf_saveComment(_("Values above 1 reuse the previous nebula in between, trading some smoothness for speed."));
+   conf_saveInt("nebu_refresh",conf.nebu_refresh);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Run Naev in full-screen mode"));
    conf_saveBool("fullscreen",conf.fullscreen);
    conf_saveEmptyLine();
@@ -943,6 +1003,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("showfps",conf.fps_show);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Display the frame time histogram and the time of each update and render stage"));
+   conf_saveBool("showframetime",conf.frametime_show);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Limit the rendering frame rate"));
    conf_saveInt("maxfps",conf.fps_max);
    conf_saveEmptyLine();
@@ -968,6 +1032,14 @@ int conf_saveConfig ( const char* file )
    conf_saveFloat("engine_vol", conf.engine_vol);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Ogg sounds longer than this many seconds are streamed instead of being fully decoded, 0 disables it"));
+   conf_saveFloat("sound_stream", conf.sound_stream);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Memory in MiB decoded sounds can use before the least recently played ones are freed, 0 for no limit"));
+   conf_saveInt("sound_memory", conf.sound_memory);
+   conf_saveEmptyLine();
+
    /* Joystick. */
    conf_saveComment(_("The name or numeric index of the joystick to use"));
    conf_saveComment(_("Setting this to nil disables the joystick support"));
@@ -1054,6 +1126,32 @@ int conf_saveConfig ( const char* file )
    conf_saveFloat("mouse_doubleclick",conf.mouse_doubleclick);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("AI control ticks run per frame before deferring the rest to the next frame (0 disables)."));
+   conf_saveInt("ai_budget_ticks",conf.ai_budget);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Seconds of coarse simulation without combat run when entering a system, so it does not start empty."));
+   conf_saveFloat("simulate_warmup",conf.simulate_warmup);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Milliseconds per frame spent collecting Lua garbage at the end of the frame (0 leaves it to the automatic collector)."));
+   conf_saveFloat("lua_gc_budget",conf.lua_gc_budget);
+   conf_saveComment(_("Memory growth in percent before the automatic Lua collector runs on its own, as a safety net for the per-frame collection."));
+   conf_saveInt("lua_gc_pause",conf.lua_gc_pause);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Seconds between stealth updates of stealthed pilots far from the player (0 updates them every frame)."));
+   conf_saveFloat("stealth_far_interval",conf.stealth_far_interval);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Seconds between Lua updates of spobs away from the screen (0 updates them every frame)."));
+   conf_saveFloat("spob_far_interval",conf.spob_far_interval);
+   conf_saveEmptyLine();
+
+   conf_saveComment(_("Autonav time compression past which, with no enemies nearby, the simulation uses coarse steps and skips cosmetic effects (0 disables)."));
+   conf_saveFloat("autonav_fastforward",conf.autonav_fastforward);
+   conf_saveEmptyLine();
+
    conf_saveComment(_("Enables developer mode (universe editor and the likes)"));
    conf_saveBool("devmode",conf.devmode);
    conf_saveEmptyLine();
@@ -1199,6 +1297,9 @@ void conf_copy( PlayerConf_t *dest, const PlayerConf_t *src )
    STRDUP(dev_save_sys);
    STRDUP(dev_save_map);
    STRDUP(dev_save_spob);
+   STRDUP(record);
+   STRDUP(replay);
+   STRDUP(benchmark_script);
    if (src->difficulty != NULL)
       STRDUP(difficulty);
 #undef STRDUP
@@ -1218,6 +1319,9 @@ void conf_free( PlayerConf_t *config )
    free(config->dev_save_map);
    free(config->dev_save_spob);
    free(config->difficulty);
+   free(config->record);
+   free(config->replay);
+   free(config->benchmark_script);
 
    /* Clear memory. */
    memset( config, 0, sizeof(PlayerConf_t) );
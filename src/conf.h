@@ -25,6 +25,13 @@
 #define MAP_OVERLAY_OPACITY_DEFAULT    0.3   /**< Opacity fraction (0-1) for the overlay map. */
 #define INPUT_MESSAGES_DEFAULT         5     /**< Amount of messages to display. */
 #define DIFFICULTY_DEFAULT             NULL  /**< Default difficulty. */
+#define AI_BUDGET_DEFAULT              16    /**< AI control ticks run per frame before deferring the rest (0 disables), above what big fights need steadily. */
+#define SIMULATE_WARMUP_DEFAULT        25.   /**< Seconds of reduced fidelity simulation when entering a system. */
+#define LUA_GC_BUDGET_DEFAULT          1.    /**< Milliseconds per frame of incremental Lua garbage collection (0 disables). */
+#define LUA_GC_PAUSE_DEFAULT           300   /**< Memory growth (percent) before the automatic Lua collector kicks in. */
+#define STEALTH_FAR_INTERVAL_DEFAULT   0.25  /**< Seconds between stealth updates of pilots far from the player (0 disables). */
+#define SPOB_FAR_INTERVAL_DEFAULT      0.1   /**< Seconds between Lua updates of off-screen spobs (0 disables). */
+#define AUTONAV_FASTFORWARD_DEFAULT    10.   /**< Autonav time compression past which the simulation is coarser (0 disables). */
 /* Video options */
 #define RESOLUTION_W_MIN               1280  /**< Minimum screen width (below which graphics are downscaled). */
 #define RESOLUTION_H_MIN               720   /**< Minimum screen height (below which graphics are downscaled). */
@@ -36,7 +43,9 @@
 #define VSYNC_DEFAULT                  0     /**< Whether to wait for vertical sync. */
 #define SCALE_FACTOR_DEFAULT           1.    /**< Default scale factor. */
 #define NEBULA_SCALE_FACTOR_DEFAULT    4.    /**< Default scale factor for nebula rendering. */
+#define NEBULA_REFRESH_DEFAULT         1     /**< Default number of frames between full nebula refreshes. */
 #define SHOW_FPS_DEFAULT               0     /**< Whether to display FPS on screen. */
+#define SHOW_FRAMETIME_DEFAULT         0     /**< Whether to display the frame time overlay. */
 #define FPS_MAX_DEFAULT                60    /**< Maximum FPS. */
 #define SHOW_PAUSE_DEFAULT             1     /**< Whether to display pause status. */
 #define MINIMIZE_DEFAULT               1     /**< Whether to minimize on focus loss. */
@@ -58,6 +67,8 @@
 /* Audio options */
 #define USE_EFX_DEFAULT                1     /**< Whether or not to use EFX (if using OpenAL). */
 #define MUTE_SOUND_DEFAULT             0     /**< Whether sound should be disabled. */
+#define SOUND_STREAM_DEFAULT           10.   /**< Length in seconds above which sounds are streamed. */
+#define SOUND_MEMORY_DEFAULT           128   /**< Memory cap in MiB for decoded sounds. */
 #define SOUND_VOLUME_DEFAULT           0.6   /**< Default sound volume. */
 #define MUSIC_VOLUME_DEFAULT           0.8   /**< Default music volume. */
 #define ENGINE_VOLUME_DEFAULT          0.8   /**< Default engine volume. */
@@ -91,6 +102,7 @@ typedef struct PlayerConf_s {
    int explicit_dim; /**< Dimension is explicit. */
    double scalefactor; /**< Amount to reduce resolution by. */
    double nebu_scale; /**< Downscaling factor for the expensively rendered nebula. */
+   int nebu_refresh; /**< Number of frames between full nebula refreshes. */
    int fullscreen; /**< Whether or not game is fullscreen. */
    int modesetting; /**< Whether to use modesetting for fullscreen. */
    int notresizable; /**< Whether or not the window is resizable. */
@@ -113,9 +125,12 @@ typedef struct PlayerConf_s {
    double sound; /**< Sound level for sound effects. */
    double music; /**< Sound level for music. */
    double engine_vol; /**< Sound level for engines (relative). */
+   double sound_stream; /**< Length in seconds above which sounds are streamed, 0 to disable. */
+   int sound_memory; /**< Memory cap in MiB for decoded sounds, 0 for no cap. */
 
    /* FPS. */
    int fps_show; /**< Whether or not FPS should be shown */
+   int frametime_show; /**< Whether or not the frame time overlay should be shown. */
    int fps_max; /**< Maximum FPS to limit to. */
 
    /* Pause. */
@@ -158,9 +173,22 @@ typedef struct PlayerConf_s {
    int mouse_fly; /**< Whether middle clicking enables mouse flying or not. */
    int mouse_accel; /**< Whether mouse flying controls acceleration. */
    double mouse_doubleclick; /**< How long to consider double-clicks for. */
+   int ai_budget; /**< AI control ticks per frame, over budget ones get deferred. */
+   double simulate_warmup; /**< Seconds of reduced fidelity simulation when entering a system. */
+   double lua_gc_budget; /**< Milliseconds per frame of incremental Lua garbage collection run at the end of the frame. */
+   int lua_gc_pause; /**< Memory growth (percent) before the automatic Lua collector kicks in. */
+   double stealth_far_interval; /**< Seconds between stealth updates of stealthed pilots far from the player. */
+   double spob_far_interval; /**< Seconds between Lua updates of spobs away from the screen. */
+   double autonav_fastforward; /**< Autonav time compression past which the simulation runs coarser when safe. */
    double autonav_reset_dist; /**< Enemy distance condition for resetting autonav. */
    double autonav_reset_shield; /**< Shield condition for resetting autonav speed. */
    int devmode; /**< Developer mode. */
+   int benchmark; /**< Number of updates to run the benchmark for, 0 runs the game normally. */
+   char *benchmark_script; /**< Lua script to run as a benchmark, NULL to not run any. */
+   int profile_load; /**< Whether to write a load time report. */
+   int profile_lua; /**< Whether to profile Lua and write a per frame report. */
+   char *record; /**< File to record the session to, NULL to not record. */
+   char *replay; /**< File to replay instead of playing, NULL to play normally. */
    int devautosave; /**< Developer mode autosave. */
    int lua_enet; /**< Enable the lua-enet library. */
    int lua_repl; /**< Enable the experimental CLI based on lua-repl. */
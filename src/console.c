@@ -23,6 +23,8 @@
 #include "conf.h"
 #include "font.h"
 #include "log.h"
+#include "luaprof.h"
+#include "memstats.h"
 #include "menu.h"
 #include "naev.h"
 #include "ndata.h"
@@ -58,7 +60,9 @@ static glFont *cli_font     = NULL; /**< CLI font to use. */
 #define CLI_MAX_INPUT      STRMAX_SHORT /** Maximum characters typed into console. */
 #define CLI_WIDTH          (SCREEN_W - 100) /**< Console width. */
 #define CLI_HEIGHT         (SCREEN_H - 100) /**< Console height. */
-static char **cli_buffer; /**< CLI buffer. */
+#define CLI_MAX_BUFFER     4096 /**< Lines kept in the console scrollback. */
+static char **cli_buffer; /**< CLI buffer, ring of at most CLI_MAX_BUFFER lines once full (array.h). */
+static int cli_buffer_start = 0; /**< Position of the oldest line in the full CLI buffer. */
 static char *cli_prompt; /**< Prompt string (allocated). */
 static int cli_history     = 0; /**< Position in history. */
 static int cli_scroll_pos  = -1; /**< Position in scrolling through output */
@@ -73,8 +77,12 @@ static int cli_max_lines   = 0;
  * CLI stuff.
  */
 static int cli_script( lua_State *L );
+static int cli_memory( lua_State *L );
+static int cli_luaprof( lua_State *L );
 static const luaL_Reg cli_methods[] = {
    { "script", cli_script },
+   { "memory", cli_memory },
+   { "luaprof", cli_luaprof },
    { "warn", cli_warn },
    {NULL, NULL}
 }; /**< Console only functions. */
@@ -88,6 +96,8 @@ static void cli_printCoreString( const char *s, int escape );
 static int cli_printCore( lua_State *L, int cli_only, int escape );
 static void cli_addMessage( const char *msg );
 static void cli_addMessageMax( const char *msg, const int l );
+static void cli_bufferPush( char *buf );
+static const char *cli_bufferLine( int i );
 void cli_tabComplete( unsigned int wid );
 static int cli_initLua (void);
 
@@ -236,6 +246,84 @@ static int cli_script( lua_State *L )
    return lua_gettop(L) - n;
 }
 
+/**
+ * @brief Prints the memory used by each subsystem.
+ *
+ *    @luatreturn table Bytes currently used by each subsystem.
+ * @luafunc memory
+ */
+static int cli_memory( lua_State *L )
+{
+   char buf[STRMAX_SHORT];
+   int64_t total = 0;
+
+   memstats_update();
+   lua_newtable(L);
+   cli_printCoreString( _("Memory usage (current / peak):"), 1 );
+   for (int i=0; i<MEMTAG_MAX; i++) {
+      int64_t used = memstats_get( i );
+      snprintf( buf, sizeof(buf), "   %s: %.1f / %.1f MiB", memstats_name( i ),
+            used / 1048576., memstats_peak( i ) / 1048576. );
+      cli_printCoreString( buf, 1 );
+      lua_pushnumber( L, used );
+      lua_setfield( L, -2, memstats_name( i ) );
+      total += used;
+   }
+   snprintf( buf, sizeof(buf), _("   total: %.1f MiB"), total / 1048576. );
+   cli_printCoreString( buf, 1 );
+   return 1;
+}
+
+/**
+ * @brief Prints a line of the Lua profile.
+ */
+static void cli_luaprofPrint( const char *str )
+{
+   cli_printCoreString( str, 1 );
+}
+
+/**
+ * @brief Controls the Lua profiler and shows what it recorded.
+ *
+ * With "start", "stop" or "reset" the profiler is controlled, otherwise the
+ *  environments using the most resources are shown sorted by "time" (default),
+ *  "self", "mem" or "calls".
+ *
+ *    @luatparam[opt="time"] string what What to do or sort by.
+ * @luafunc luaprof
+ */
+static int cli_luaprof( lua_State *L )
+{
+   const char *what = luaL_optstring( L, 1, "time" );
+   LuaProfSort sort;
+
+   if (strcmp( what, "start" )==0) {
+      luaprof_start();
+      return 0;
+   }
+   else if (strcmp( what, "stop" )==0) {
+      luaprof_stop();
+      return 0;
+   }
+   else if (strcmp( what, "reset" )==0) {
+      luaprof_reset();
+      return 0;
+   }
+   else if (strcmp( what, "time" )==0)
+      sort = LUAPROF_SORT_TIME;
+   else if (strcmp( what, "self" )==0)
+      sort = LUAPROF_SORT_SELF;
+   else if (strcmp( what, "mem" )==0)
+      sort = LUAPROF_SORT_MEM;
+   else if (strcmp( what, "calls" )==0)
+      sort = LUAPROF_SORT_CALLS;
+   else
+      return NLUA_ERROR( L, _("Unknown Lua profiler command '%s'."), what );
+
+   luaprof_print( sort, cli_luaprofPrint );
+   return 0;
+}
+
 /**
  * @brief Adds a message to the buffer.
  *
@@ -248,8 +336,7 @@ static void cli_addMessage( const char *msg )
    if (cli_env == LUA_NOREF)
       return;
    buf = strdup((msg != NULL) ? msg : "");
-   array_grow(&cli_buffer) = buf;
-   cli_history = array_size(cli_buffer) - 1;
+   cli_bufferPush( buf );
 }
 
 /**
@@ -265,17 +352,47 @@ static void cli_addMessageMax( const char *msg, const int l )
    if (cli_env == LUA_NOREF)
       return;
    buf = strndup((msg != NULL) ? msg : "", l);
-   array_grow(&cli_buffer) = buf;
+   cli_bufferPush( buf );
+}
+
+/**
+ * @brief Adds a line to the buffer, replacing the oldest once it is full.
+ *
+ *    @param buf Line to add, the buffer takes ownership of it.
+ */
+static void cli_bufferPush( char *buf )
+{
+   if (array_size(cli_buffer) < CLI_MAX_BUFFER)
+      array_grow(&cli_buffer) = buf;
+   else {
+      free( cli_buffer[cli_buffer_start] );
+      cli_buffer[cli_buffer_start] = buf;
+      cli_buffer_start = (cli_buffer_start+1) % CLI_MAX_BUFFER;
+      /* Scrolled position keeps showing the same lines. */
+      if (cli_scroll_pos > 0)
+         cli_scroll_pos--;
+   }
    cli_history = array_size(cli_buffer) - 1;
 }
 
+/**
+ * @brief Gets a line of the buffer.
+ *
+ *    @param i Line to get, starting from the oldest.
+ *    @return The line.
+ */
+static const char *cli_bufferLine( int i )
+{
+   return cli_buffer[ (cli_buffer_start+i) % array_size(cli_buffer) ];
+}
+
 /**
  * @brief Render function for the custom widget.
  */
 static void cli_render( double bx, double by, double w, double h, void *data )
 {
    (void) data;
-   int start;
+   int start, end;
    const glColour col = COL_ALPHA( cBlack, 0.5 );
 
    gl_renderRect( bx, by, w, h, &col );
@@ -284,11 +401,13 @@ static void cli_render( double bx, double by, double w, double h, void *data )
       start = MAX(0, array_size(cli_buffer)-CLI_MAX_LINES);
    else
       start = cli_scroll_pos;
+   end = MIN( start+CLI_MAX_LINES, array_size(cli_buffer) );
 
-   for (int i=start; i<array_size(cli_buffer); i++)
+   /* Only the lines that fit are drawn. */
+   for (int i=start; i<end; i++)
       gl_printMaxRaw( cli_font, w, bx,
             by + h - (i-start)*(cli_font->h+5),
-            &cFontWhite, -1., cli_buffer[i] );
+            &cFontWhite, -1., cli_bufferLine(i) );
 }
 
 /**
@@ -304,9 +423,10 @@ static int cli_keyhandler( unsigned int wid, SDL_Keycode key, SDL_Keymod mod, in
       /* Go up in history. */
       case SDLK_UP:
          for (int i=cli_history; i>=0; i--) {
-            if (strncmp(cli_buffer[i], "#C>", 3) == 0) {
+            const char *line = cli_bufferLine(i);
+            if (strncmp(line, "#C>", 3) == 0) {
                /* Strip escape codes from beginning and end */
-               char *str = strndup(cli_buffer[i]+5, strlen(cli_buffer[i])-7);
+               char *str = strndup(line+5, strlen(line)-7);
                if (i == cli_history &&
                   strcmp(window_getInput(wid, "inpInput"), str) == 0) {
                   free(str);
@@ -330,8 +450,9 @@ static int cli_keyhandler( unsigned int wid, SDL_Keycode key, SDL_Keymod mod, in
 
          /* Find next buffer. */
          for (int i=cli_history+1; i<array_size(cli_buffer); i++) {
-            if (strncmp(cli_buffer[i], "#C>", 3) == 0) {
-               char *str = strndup(cli_buffer[i]+5, strlen(cli_buffer[i])-7);
+            const char *line = cli_bufferLine(i);
+            if (strncmp(line, "#C>", 3) == 0) {
+               char *str = strndup(line+5, strlen(line)-7);
                window_setInput( wid, "inpInput", str );
                free(str);
                return 1;
@@ -530,6 +651,7 @@ void cli_exit (void)
       free(cli_buffer[i]);
    array_free(cli_buffer);
    cli_buffer = NULL;
+   cli_buffer_start = 0;
    free(cli_prompt);
    cli_prompt = NULL;
 }
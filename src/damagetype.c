@@ -50,6 +50,7 @@ static int DTYPE_parse( DTYPE *temp, const char *file);
 static void DTYPE_free( DTYPE *damtype );
 static DTYPE* dtype_validType( int type );
 static int dtype_cmp( const void *p1, const void *p2 );
+static void dtype_mod( DTypeMod *mod, const DTYPE *dtype, const ShipStats *s );
 
 /**
  * @brief For sorting and bsearching.
@@ -263,6 +264,41 @@ int dtype_raw( int type, double *shield, double *armour, double *knockback )
    return 0;
 }
 
+/**
+ * @brief Computes the modifiers of a damage type for a set of ship stats.
+ *
+ *    @param[out] mod Modifiers to set.
+ *    @param dtype Damage type to compute modifiers of.
+ *    @param s Ship stats to use, or NULL to use none.
+ */
+static void dtype_mod( DTypeMod *mod, const DTYPE *dtype, const ShipStats *s )
+{
+   const char *ptr = (const char*) s;
+   double multiplier;
+
+   mod->shield    = dtype->sdam;
+   mod->armour    = dtype->adam;
+   mod->knockback = dtype->knock;
+   if (s == NULL)
+      return;
+
+   /*
+    * If an offset has been specified, look for a double at that offset
+    * in the ShipStats struct, and used it as a multiplier.
+    *
+    * The 1. - n logic serves to convert the value from absorption to
+    * damage multiplier.
+    */
+   if (dtype->soffset != 0) {
+      memcpy(&multiplier, &ptr[ dtype->soffset ], sizeof(double));
+      mod->shield *= MAX( 0., 1. - multiplier );
+   }
+   if (dtype->aoffset != 0) {
+      memcpy(&multiplier, &ptr[ dtype->aoffset ], sizeof(double));
+      mod->armour *= MAX( 0., 1. - multiplier );
+   }
+}
+
 /**
  * @brief Gives the real shield damage, armour damage and knockback modifier.
  *
@@ -275,44 +311,71 @@ int dtype_raw( int type, double *shield, double *armour, double *knockback )
  */
 void dtype_calcDamage( double *dshield, double *darmour, double absorb, double *knockback, const Damage *dmg, const ShipStats *s )
 {
-   DTYPE *dtype;
-   char *ptr;
-   double multiplier;
+   DTypeMod mod;
 
    /* Must be valid. */
-   dtype = dtype_validType( dmg->type );
+   const DTYPE *dtype = dtype_validType( dmg->type );
    if (dtype == NULL)
       return;
+   dtype_mod( &mod, dtype, s );
 
    /* Set if non-nil. */
-   if (dshield != NULL) {
-      if ((dtype->soffset == 0) || (s == NULL))
-         *dshield    = dtype->sdam * dmg->damage * absorb;
-      else {
-         /*
-          * If an offset has been specified, look for a double at that offset
-          * in the ShipStats struct, and used it as a multiplier.
-          *
-          * The 1. - n logic serves to convert the value from absorption to
-          * damage multiplier.
-          */
-         ptr = (char*) s;
-         memcpy(&multiplier, &ptr[ dtype->soffset ], sizeof(double));
-         multiplier = MAX( 0., 1. - multiplier );
-         *dshield = dtype->sdam * dmg->damage * absorb * multiplier;
-      }
-   }
-   if (darmour != NULL) {
-      if ((dtype->aoffset) == 0 || (s == NULL))
-         *darmour    = dtype->adam * dmg->damage * absorb;
-      else {
-         ptr = (char*) s;
-         memcpy(&multiplier, &ptr[ dtype->aoffset ], sizeof(double));
-         multiplier = MAX( 0., 1. - multiplier );
-         *darmour = dtype->adam * dmg->damage * absorb * multiplier;
-      }
+   if (dshield != NULL)
+      *dshield    = mod.shield * dmg->damage * absorb;
+   if (darmour != NULL)
+      *darmour    = mod.armour * dmg->damage * absorb;
+   if (knockback != NULL)
+      *knockback  = mod.knockback;
+}
+
+/**
+ * @brief Computes the modifiers of all the damage types for a set of ship
+ *        stats.
+ *
+ * Meant to be refreshed whenever the stats change, so that the damage of a
+ *  hit can be computed with dtype_calcDamageMods without looking up the
+ *  ship stats of every damage type again.
+ *
+ *    @param[in,out] mods Array (array.h) of modifiers indexed by damage type,
+ *                   created if NULL.
+ *    @param s Ship stats to use.
+ */
+void dtype_calcMods( DTypeMod **mods, const ShipStats *s )
+{
+   int n = array_size(dtype_types);
+   if (*mods == NULL)
+      *mods = array_create_size( DTypeMod, n );
+   array_resize( mods, n );
+   for (int i=0; i<n; i++)
+      dtype_mod( &(*mods)[i], &dtype_types[i], s );
+}
+
+/**
+ * @brief Gives the real shield damage, armour damage and knockback modifier
+ *        from precomputed modifiers.
+ *
+ *    @param[out] dshield Real shield damage.
+ *    @param[out] darmour Real armour damage.
+ *    @param[out] knockback Knockback modifier.
+ *    @param[in] absorb Absorption value.
+ *    @param[in] dmg Damage information.
+ *    @param[in] mods Modifiers computed by dtype_calcMods.
+ */
+void dtype_calcDamageMods( double *dshield, double *darmour, double absorb, double *knockback, const Damage *dmg, const DTypeMod *mods )
+{
+   const DTypeMod *mod;
+
+   /* Fall back to the checked path when not computed or invalid. */
+   if ((dmg->type < 0) || (dmg->type >= array_size(mods))) {
+      dtype_calcDamage( dshield, darmour, absorb, knockback, dmg, NULL );
+      return;
    }
 
+   mod = &mods[ dmg->type ];
+   if (dshield != NULL)
+      *dshield    = mod->shield * dmg->damage * absorb;
+   if (darmour != NULL)
+      *darmour    = mod->armour * dmg->damage * absorb;
    if (knockback != NULL)
-      *knockback  = dtype->knock;
+      *knockback  = mod->knockback;
 }
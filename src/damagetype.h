@@ -5,6 +5,16 @@
 
 #include "outfit.h"
 
+/**
+ * @brief Damage modifiers of a damage type with the ship stats of a pilot
+ *        already applied.
+ */
+typedef struct DTypeMod_ {
+   double shield;    /**< Shield damage multiplier. */
+   double armour;    /**< Armour damage multiplier. */
+   double knockback; /**< Knockback modulator. */
+} DTypeMod;
+
 /*
  * stack manipulation
  */
@@ -23,3 +33,6 @@ void dtype_free (void);
 int dtype_raw( int type, double *shield, double *armour, double *knockback );
 void dtype_calcDamage( double *dshield, double *darmour, double absorb,
       double *knockback, const Damage *dmg, const ShipStats *s );
+void dtype_calcMods( DTypeMod **mods, const ShipStats *s );
+void dtype_calcDamageMods( double *dshield, double *darmour, double absorb,
+      double *knockback, const Damage *dmg, const DTypeMod *mods );
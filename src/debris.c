@@ -13,12 +13,15 @@
 
 #include "debris.h"
 
+#include "camera.h"
 #include "log.h"
 #include "nstring.h"
 #include "pilot.h"
 #include "rng.h"
 #include "spfx.h"
 
+#define DEBRIS_LOD_DIST 1000. /**< Distance off screen at which half of the debris gets emitted. */
+
 static int *debris_spfx = NULL; /**< Debris special effects. */
 static int debris_nspfx = 0; /**< Number of debris special effects. */
 
@@ -70,6 +73,9 @@ static int debris_load (void)
 /**
  * @brief Creates a cloud of debris.
  *
+ * The debris is emitted as particle groups, with less of it the farther off
+ *  screen the cloud is.
+ *
  *    @param mass Mass of the debris cloud.
  *    @param r Radius of the cloud.
  *    @param px X position to center cloud.
@@ -80,7 +86,8 @@ static int debris_load (void)
 void debris_add( double mass, double r, double px, double py,
       double vx, double vy )
 {
-   int n;
+   int n, nlod, nfront;
+   double cx, cy, z, d;
 
    if (!space_needsEffects())
       return;
@@ -93,25 +100,19 @@ void debris_add( double mass, double r, double px, double py,
    /* Get number of debris to render. */
    n = (int) ceil( sqrt(mass) / 1.5 );
 
-   /* Now add the spfx. */
-   for (int i=0; i<n; i++) {
-      double npx,npy, nvx,nvy;
-      double a, d;
-
-      /* Get position. */
-      d = r/2. * RNG_2SIGMA();
-      a = RNGF()*2.*M_PI;
-      npx = px + d*cos(a);
-      npy = py + d*sin(a);
-
-      /* Get velocity. */
-      d = n * RNG_2SIGMA();
-      a = RNGF()*2.*M_PI;
-      nvx = vx + d*cos(a);
-      nvy = vy + d*sin(a);
-
-      /* Create sprite. */
-      spfx_add( debris_spfx[ RNG( 0, debris_nspfx-1 ) ],
-            npx, npy, nvx, nvy, RNG(0,1) );
-   }
+   /* Fewer debris the farther off screen. */
+   cam_getPos( &cx, &cy );
+   z = MIN( cam_getZoom(), cam_getZoomTarget() );
+   d = MAX( fabs(cx-px) - SCREEN_W / (2.*z), fabs(cy-py) - SCREEN_H / (2.*z) );
+   d = MAX( d - r, 0. );
+   nlod = (int) round( n * DEBRIS_LOD_DIST / (DEBRIS_LOD_DIST + d) );
+
+   /* Split between the front and middle layers. */
+   nfront = nlod / 2;
+   if ((nlod % 2) && (RNG(0,1)==0))
+      nfront++;
+   spfx_addGroup( debris_spfx, debris_nspfx, nfront,
+         px, py, vx, vy, r, n, SPFX_LAYER_FRONT );
+   spfx_addGroup( debris_spfx, debris_nspfx, nlod-nfront,
+         px, py, vx, vy, r, n, SPFX_LAYER_MIDDLE );
 }
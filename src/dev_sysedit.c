@@ -21,7 +21,6 @@
 #include "dev_system.h"
 #include "dev_uniedit.h"
 #include "dialogue.h"
-#include "economy.h"
 #include "map.h"
 #include "ndata.h"
 #include "nstring.h"
@@ -310,8 +309,7 @@ static void sysedit_close( unsigned int wid, const char *wgt )
       dsys_saveSystem( sysedit_sys );
 
    /* Reconstruct universe presences. */
-   space_reconstructPresences();
-   safelanes_recalculate();
+   dsys_queueRecalc( DSYS_RECALC_SAFELANES );
 
    /* Close the window. */
    window_close( wid, wgt );
@@ -363,15 +361,11 @@ static void sysedit_editPntClose( unsigned int wid, const char *unused )
    array_free( sysedit_tagslist );
    sysedit_tagslist = NULL;
 
-   /* Have to recompute presences if stuff changed. */
-   space_reconstructPresences();
-
    if (conf.devautosave)
       dpl_saveSpob( p );
 
-   /* Clean up presences. */
-   space_reconstructPresences();
-   safelanes_recalculate();
+   /* Have to recompute presences if stuff changed. */
+   dsys_queueRecalc( DSYS_RECALC_SAFELANES );
 
    window_close( wid, unused );
 }
@@ -428,8 +422,7 @@ static void sysedit_btnNewSpob( unsigned int wid_unused, const char *unused )
    system_addSpob( sysedit_sys, name );
 
    /* Run galaxy modifications. */
-   space_reconstructPresences();
-   economy_execQueued();
+   dsys_queueRecalc( DSYS_RECALC_ECONOMY );
 
    if (conf.devautosave) {
       dsys_saveSystem( sysedit_sys );
@@ -583,8 +576,7 @@ static void sysedit_btnRemove( unsigned int wid_unused, const char *unused )
       }
 
       /* Run galaxy modifications. */
-      space_reconstructPresences();
-      economy_execQueued();
+      dsys_queueRecalc( DSYS_RECALC_ECONOMY );
    }
 }
 
@@ -811,6 +803,9 @@ static void sysedit_render( double bx, double by, double w, double h, void *data
          &cWhite, "% 9.2f x % 9.2f",
          (bx + sysedit_mx - x)/z,
          (by + sysedit_my - y)/z );
+
+   /* Pending work. */
+   dsys_renderStatus( bx + 5., by + 85. );
 }
 
 /**
@@ -7,6 +7,7 @@
  * @brief Handles development of star system stuff.
  */
 /** @cond */
+#include <stdatomic.h>
 #include <stdlib.h> /* qsort */
 
 #include "naev.h"
@@ -17,17 +18,41 @@
 #include "array.h"
 #include "conf.h"
 #include "dev_uniedit.h"
+#include "economy.h"
+#include "font.h"
 #include "nstring.h"
 #include "nxml.h"
 #include "physics.h"
+#include "safelanes.h"
 #include "space.h"
 #include "nebula.h"
+#include "threadpool.h"
+
+#define DSYS_SETTLE     500 /**< Milliseconds without edits before recalculating and saving. */
+
+/**
+ * @brief A system file to write in the background.
+ */
+typedef struct DSysWrite_ {
+   xmlDocPtr doc; /**< Document to write, freed once written. */
+   char *file;    /**< Path to write to. */
+} DSysWrite;
+
+static int *dsys_dirty        = NULL; /**< Array (array.h): IDs of the systems waiting to be saved. */
+static unsigned int dsys_recalc = 0;  /**< Pending recalculations (DSYS_RECALC_*). */
+static Uint32 dsys_lastEdit   = 0;    /**< Time of the last queued edit. */
+static atomic_int dsys_writing = 0;   /**< Files of the batch being written in the background. */
+static JobCounter *dsys_counter = NULL; /**< Counter of the background writes. */
 
 /*
  * Prototypes.
  */
 static int dsys_compSpob( const void *spob1, const void *spob2 );
 static int dsys_compJump( const void *jmp1, const void *jmp2 );
+static int dsys_genSystem( StarSystem *sys, xmlDocPtr *out, char **file );
+static void dsys_recalculate (void);
+static void dsys_writeBatch( int wait );
+static int dsys_writeThread( void *data );
 
 /**
  * @brief Compare function for spob qsort.
@@ -75,19 +100,21 @@ static int dsys_compJump( const void *jmp1, const void *jmp2 )
 }
 
 /**
- * @brief Saves a star system.
+ * @brief Generates the XML document of a star system.
  *
- *    @param sys Star system to save.
+ *    @param sys Star system to generate.
+ *    @param[out] out Generated document.
+ *    @param[out] file Path the system has to be saved to.
  *    @return 0 on success.
  */
-int dsys_saveSystem( StarSystem *sys )
+static int dsys_genSystem( StarSystem *sys, xmlDocPtr *out, char **file )
 {
    xmlDocPtr doc;
    xmlTextWriterPtr writer;
    const Spob **sorted_spobs;
    const VirtualSpob **sorted_virtualspobs;
    const JumpPoint **sorted_jumps;
-   char *file, *cleanName;
+   char *cleanName;
 
    /* Reconstruct jumps so jump pos are updated. */
    system_reconstructJumps(sys);
@@ -261,23 +288,40 @@ int dsys_saveSystem( StarSystem *sys )
    /* No need for writer anymore. */
    xmlFreeTextWriter(writer);
 
-   /* Write data. */
+   /* Get path. */
    cleanName = uniedit_nameFilter( sys->name );
-   SDL_asprintf( &file, "%s/%s.xml", conf.dev_save_sys, cleanName );
-   if (xmlSaveFileEnc( file, doc, "UTF-8" ) < 0)
-      WARN("Failed writing '%s'!", file);
-
-   /* Clean up. */
-   xmlFreeDoc(doc);
+   SDL_asprintf( file, "%s/%s.xml", conf.dev_save_sys, cleanName );
    free(cleanName);
-   free(file);
 
+   *out = doc;
+   return 0;
+}
+
+/**
+ * @brief Saves a star system.
+ *
+ * The system is only written once edits settle, see dsys_update.
+ *
+ *    @param sys Star system to save.
+ *    @return 0 on success.
+ */
+int dsys_saveSystem( StarSystem *sys )
+{
+   dsys_lastEdit = SDL_GetTicks();
+   if (dsys_dirty == NULL)
+      dsys_dirty = array_create( int );
+   for (int i=0; i<array_size(dsys_dirty); i++)
+      if (dsys_dirty[i] == sys->id)
+         return 0;
+   array_push_back( &dsys_dirty, sys->id );
    return 0;
 }
 
 /**
  * @brief Saves all the star systems.
  *
+ * Unlike dsys_saveSystem, the writing starts right away.
+ *
  *    @return 0 on success.
  */
 int dsys_saveAll (void)
@@ -287,6 +331,141 @@ int dsys_saveAll (void)
    /* Write systems. */
    for (int i=0; i<array_size(sys); i++)
       dsys_saveSystem( &sys[i] );
+   dsys_lastEdit = SDL_GetTicks() - DSYS_SETTLE;
 
    return 0;
 }
+
+/**
+ * @brief Queues recalculating the universe after an edit.
+ *
+ * Recalculations are coalesced and run once edits settle, see dsys_update.
+ *
+ *    @param flags What to recalculate (DSYS_RECALC_*).
+ */
+void dsys_queueRecalc( unsigned int flags )
+{
+   dsys_recalc  |= flags;
+   dsys_lastEdit = SDL_GetTicks();
+}
+
+/**
+ * @brief Runs the pending recalculations.
+ */
+static void dsys_recalculate (void)
+{
+   unsigned int flags = dsys_recalc;
+   dsys_recalc = 0;
+   if (flags & (DSYS_RECALC_PRESENCE | DSYS_RECALC_SAFELANES | DSYS_RECALC_ECONOMY))
+      space_reconstructPresences();
+   if (flags & DSYS_RECALC_SAFELANES)
+      safelanes_recalculate();
+   if (flags & DSYS_RECALC_ECONOMY)
+      economy_execQueued();
+}
+
+/**
+ * @brief Writes the systems waiting to be saved.
+ *
+ * Documents are generated on the main thread, and written in the background.
+ *
+ *    @param wait Whether or not to block until they are written.
+ */
+static void dsys_writeBatch( int wait )
+{
+   DSysWrite *batch;
+
+   /* Only one batch at a time so writes to a file stay in order. */
+   if (atomic_load( &dsys_writing ) > 0) {
+      if (!wait)
+         return;
+      job_wait( dsys_counter );
+   }
+
+   if (array_size(dsys_dirty) > 0) {
+      batch = array_create_size( DSysWrite, array_size(dsys_dirty) );
+      for (int i=0; i<array_size(dsys_dirty); i++) {
+         DSysWrite w;
+         if (dsys_genSystem( system_getIndex( dsys_dirty[i] ), &w.doc, &w.file ) == 0)
+            array_push_back( &batch, w );
+      }
+      array_resize( &dsys_dirty, 0 );
+
+      if (dsys_counter == NULL)
+         dsys_counter = job_counterCreate();
+      atomic_store( &dsys_writing, array_size(batch) );
+      job_runBackground( dsys_counter, dsys_writeThread, batch );
+   }
+
+   if (wait)
+      job_wait( dsys_counter );
+}
+
+/**
+ * @brief Writes a batch of systems.
+ */
+static int dsys_writeThread( void *data )
+{
+   DSysWrite *batch = data;
+   for (int i=0; i<array_size(batch); i++) {
+      if (xmlSaveFileEnc( batch[i].file, batch[i].doc, "UTF-8" ) < 0)
+         WARN("Failed writing '%s'!", batch[i].file);
+      xmlFreeDoc( batch[i].doc );
+      free( batch[i].file );
+      atomic_fetch_sub( &dsys_writing, 1 );
+   }
+   array_free( batch );
+   return 0;
+}
+
+/**
+ * @brief Runs the pending recalculations and saves once edits settle.
+ *
+ * Should be called every frame while editing.
+ *
+ *    @return 1 if the universe was recalculated.
+ */
+int dsys_update (void)
+{
+   if ((dsys_recalc == 0) && (array_size(dsys_dirty) == 0))
+      return 0;
+   if (SDL_GetTicks() - dsys_lastEdit < DSYS_SETTLE)
+      return 0;
+
+   if (dsys_recalc != 0) {
+      dsys_recalculate();
+      dsys_writeBatch( 0 );
+      return 1;
+   }
+   dsys_writeBatch( 0 );
+   return 0;
+}
+
+/**
+ * @brief Runs all the pending recalculations and saves, blocking until done.
+ */
+void dsys_flush (void)
+{
+   if (dsys_recalc != 0)
+      dsys_recalculate();
+   if ((array_size(dsys_dirty) > 0) || (atomic_load( &dsys_writing ) > 0))
+      dsys_writeBatch( 1 );
+}
+
+/**
+ * @brief Renders the status of the pending recalculations and saves.
+ *
+ *    @param x X position to render at.
+ *    @param y Y position to render at.
+ */
+void dsys_renderStatus( double x, double y )
+{
+   int writing = atomic_load( &dsys_writing );
+   int dirty   = array_size( dsys_dirty );
+   if (dsys_recalc != 0)
+      gl_printRaw( &gl_smallFont, x, y, &cFontYellow, -1., _("Recalculating universe once edits settle…") );
+   else if (writing > 0)
+      gl_print( &gl_smallFont, x, y, &cFontYellow, n_("Saving %d system…", "Saving %d systems…", writing), writing );
+   else if (dirty > 0)
+      gl_print( &gl_smallFont, x, y, &cFontYellow, n_("%d system waiting to be saved", "%d systems waiting to be saved", dirty), dirty );
+}
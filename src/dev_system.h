@@ -5,5 +5,15 @@
 
 #include "space.h"
 
+#define DSYS_RECALC_PRESENCE  (1<<0) /**< Recalculate the presences. */
+#define DSYS_RECALC_SAFELANES (1<<1) /**< Recalculate the safe lanes. */
+#define DSYS_RECALC_ECONOMY   (1<<2) /**< Run the queued economy updates. */
+
 int dsys_saveSystem( StarSystem *sys );
 int dsys_saveAll (void);
+
+/* Deferred work. */
+void dsys_queueRecalc( unsigned int flags );
+int dsys_update (void);
+void dsys_flush (void);
+void dsys_renderStatus( double x, double y );
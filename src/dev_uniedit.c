@@ -20,14 +20,12 @@
 #include "dev_sysedit.h"
 #include "dev_system.h"
 #include "dialogue.h"
-#include "economy.h"
 #include "map.h"
 #include "map_find.h"
 #include "ndata.h"
 #include "nstring.h"
 #include "opengl.h"
 #include "pause.h"
-#include "safelanes.h"
 #include "space.h"
 #include "tk/toolkit_priv.h"
 #include "toolkit.h"
@@ -340,6 +338,9 @@ static void uniedit_close( unsigned int wid, const char *wgt )
    /* Reconstruct jumps. */
    systems_reconstructJumps();
 
+   /* Finish pending recalculations and saves. */
+   dsys_flush();
+
    /* Unpause. */
    unpause_game();
 
@@ -812,6 +813,10 @@ static void uniedit_render( double bx, double by, double w, double h, void *data
 
    uniedit_dt += naev_getrealdt();
 
+   /* Run deferred recalculations and saves, text might need changing. */
+   if (dsys_update())
+      uniedit_selectText();
+
    /* Parameters. */
    map_renderParams( bx, by, uniedit_xpos, uniedit_ypos, w, h, uniedit_zoom, &x, &y, &r );
 
@@ -826,6 +831,9 @@ static void uniedit_render( double bx, double by, double w, double h, void *data
       gl_renderShader( x + sys->pos.x * uniedit_zoom, y + sys->pos.y * uniedit_zoom,
             1.5*r, 1.5*r, 0., &shaders.selectspob, &cWhite, 1 );
    }
+
+   /* Pending work. */
+   dsys_renderStatus( bx + 10., by + 10. );
 }
 
 static char getValCol( double val )
@@ -1428,14 +1436,14 @@ static void uniedit_renameSys (void)
       SDL_asprintf(&newName, "%s/%s.xml", conf.dev_save_sys, filtered);
       free(filtered);
 
+      /* Pending saves still use the old name. */
+      dsys_flush();
       if (rename(oldName, newName))
          WARN(_("Failed to rename '%s' to '%s'!"),oldName,newName);
 
       free(oldName);
       free(newName);
-      free(sys->name);
-
-      sys->name = name;
+      system_rename( sys, name );
       dsys_saveSystem(sys);
 
       /* Re-save adjacent systems. */
@@ -1514,8 +1522,7 @@ static void uniedit_toggleJump( StarSystem *sys )
    systems_reconstructJumps();
 
    /* Reconstruct universe presences. */
-   space_reconstructPresences();
-   safelanes_recalculate();
+   dsys_queueRecalc( DSYS_RECALC_SAFELANES );
 
    if (conf.devautosave) {
       dsys_saveSystem( sys );
@@ -2095,8 +2102,7 @@ static void uniedit_editSysClose( unsigned int wid, const char *name )
    sys->nebu_hue        = atof(window_getInput( wid, "inpHue" )) / 360.;
 
    /* Reconstruct universe presences. */
-   space_reconstructPresences();
-   safelanes_recalculate();
+   dsys_queueRecalc( DSYS_RECALC_SAFELANES );
 
    /* Text might need changing. */
    uniedit_selectText();
@@ -2132,8 +2138,7 @@ static void uniedit_btnEditRmSpob( unsigned int wid, const char *unused )
    }
 
    /* Run galaxy modifications. */
-   space_reconstructPresences();
-   economy_execQueued();
+   dsys_queueRecalc( DSYS_RECALC_ECONOMY );
 
    uniedit_editGenList( wid );
 }
@@ -2199,8 +2204,7 @@ static void uniedit_btnEditAddSpobAdd( unsigned int wid, const char *unused )
    }
 
    /* Run galaxy modifications. */
-   space_reconstructPresences();
-   economy_execQueued();
+   dsys_queueRecalc( DSYS_RECALC_ECONOMY );
 
    /* Regenerate the list. */
    uniedit_editGenList( uniedit_widEdit );
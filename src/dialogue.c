@@ -33,6 +33,7 @@
 #include "nstring.h"
 #include "opengl.h"
 #include "pause.h"
+#include "replay.h"
 #include "toolkit.h"
 
 static int dialogue_open; /**< Number of dialogues open. */
@@ -1017,7 +1018,7 @@ static int toolkit_loop( int *loop_done, dialogue_update_t *du )
       /* Loop first so exit condition is checked before next iteration. */
       main_loop( 1 );
 
-      while (!naev_isQuit() && SDL_PollEvent(&event)) { /* event loop */
+      while (!naev_isQuit() && replay_pollEvent(&event)) { /* event loop */
          if (event.type == SDL_QUIT) {
             if (menu_askQuit()) {
                naev_quit(); /* Quit is handled here */
@@ -1044,7 +1045,7 @@ static int toolkit_loop( int *loop_done, dialogue_update_t *du )
       dt = (double)(t - time_ms) / 1000.;
       time_ms = t;
       /* Sleep if necessary. */
-      if (dt < fps_max) {
+      if (!replay_isReplaying() && (dt < fps_max)) {
          double delay = fps_max - dt;
          SDL_Delay( (unsigned int)(delay * 1000.) );
       }
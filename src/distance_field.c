@@ -36,6 +36,13 @@ policies, either expressed or implied, of the freetype-gl project.
  *
  * @brief Code for generating our distance fields (\see font.c).
  * Based on the corresponding file in https://github.com/rougier/freetype-gl
+ *
+ * The distances are computed with the separable linear time transform of
+ *  Felzenszwalb and Huttenlocher ("Distance Transforms of Sampled
+ *  Functions"), in single precision. Anti-aliased edge pixels seed the
+ *  transform with their distance to the edge estimated from their coverage,
+ *  which keeps the edges sub-pixel accurate. Large images are transformed with
+ *  their rows and columns split between the job threads.
  */
 
 /** @cond */
@@ -45,7 +52,116 @@ policies, either expressed or implied, of the freetype-gl project.
 #include <string.h>
 /** @endcond */
 
-#include "edtaa3func.h"
+#include "distance_field.h"
+
+#include "threadpool.h"
+
+#define EDT_INF            1e20f       /**< Squared distance of pixels without a seed. */
+#define EDT_PARALLEL_MIN   (128*128)   /**< Pixels from which the transform uses the job threads. */
+#define EDT_CHUNK_MIN      16          /**< Minimum number of lines per job. */
+
+/**
+ * @brief Image being transformed by the line passes.
+ */
+typedef struct EDTGrid_ {
+   float *grid;   /**< Squared distances, row-major order. */
+   int width;     /**< Number of columns. */
+   int height;    /**< Number of rows. */
+} EDTGrid;
+
+/**
+ * @brief One dimensional squared distance transform of a sampled function.
+ *
+ *    @param f Values of the function, replaced by their transform.
+ *    @param n Number of values.
+ *    @param d Scratch of n values.
+ *    @param v Scratch of n values.
+ *    @param z Scratch of n+1 values.
+ */
+static void edt_1d( float *f, int n, float *d, int *v, float *z )
+{
+   int k = 0;
+   v[0] = 0;
+   z[0] = -EDT_INF;
+   z[1] = +EDT_INF;
+
+   /* Lower envelope of the parabolas rooted at each sample. */
+   for (int q=1; q<n; q++) {
+      float s;
+      do {
+         int r = v[k];
+         s = ((f[q] + (float)(q*q)) - (f[r] + (float)(r*r))) / (float)(2*(q-r));
+      } while ((s <= z[k]) && (--k >= 0));
+      k++;
+      v[k]   = q;
+      z[k]   = s;
+      z[k+1] = +EDT_INF;
+   }
+
+   /* Sample the envelope. */
+   k = 0;
+   for (int q=0; q<n; q++) {
+      float dq;
+      while (z[k+1] < (float)q)
+         k++;
+      dq   = (float)(q - v[k]);
+      d[q] = dq*dq + f[v[k]];
+   }
+   memcpy( f, d, n * sizeof(float) );
+}
+
+/**
+ * @brief Transforms a range of rows.
+ */
+static int edt_rows( void *data, int start, int end )
+{
+   EDTGrid *g = data;
+   int n = g->width;
+   float *d = malloc( (2*n+1) * sizeof(float) );
+   int *v   = malloc( n * sizeof(int) );
+   for (int y=start; y<end; y++)
+      edt_1d( &g->grid[y*n], n, d, v, &d[n] );
+   free( d );
+   free( v );
+   return 0;
+}
+
+/**
+ * @brief Transforms a range of columns.
+ */
+static int edt_cols( void *data, int start, int end )
+{
+   EDTGrid *g = data;
+   int n = g->height;
+   float *f = malloc( (3*n+1) * sizeof(float) );
+   int *v   = malloc( n * sizeof(int) );
+   for (int x=start; x<end; x++) {
+      for (int y=0; y<n; y++)
+         f[y] = g->grid[y*g->width+x];
+      edt_1d( f, n, &f[n], v, &f[2*n] );
+      for (int y=0; y<n; y++)
+         g->grid[y*g->width+x] = f[y];
+   }
+   free( f );
+   free( v );
+   return 0;
+}
+
+/**
+ * @brief Two dimensional squared distance transform, in place.
+ */
+static void edt_2d( float *grid, int width, int height )
+{
+   EDTGrid g = { .grid = grid, .width = width, .height = height };
+   if (width*height >= EDT_PARALLEL_MIN) {
+      job_parallelFor( height, EDT_CHUNK_MIN, edt_rows, &g );
+      job_parallelFor( width, EDT_CHUNK_MIN, edt_cols, &g );
+   }
+   else {
+      edt_rows( &g, 0, height );
+      edt_cols( &g, 0, width );
+   }
+}
 
 /**
  * @brief Like the original: perform a Euclidean Distance Transform on the input and
@@ -61,52 +177,48 @@ policies, either expressed or implied, of the freetype-gl project.
 make_distance_mapd( double *data, unsigned int width, unsigned int height, double *vmax )
 {
    unsigned int wh = width*height;
-   short * xdist = (short *)  malloc( wh * sizeof(short) );
-   short * ydist = (short *)  malloc( wh * sizeof(short) );
-   double * gx   = (double *) calloc( wh, sizeof(double) );
-   double * gy      = (double *) calloc( wh, sizeof(double) );
-   double * outside = (double *) calloc( wh, sizeof(double) );
-   double * inside  = (double *) calloc( wh, sizeof(double) );
-
-   // Compute outside = edtaa3(bitmap); % Transform background (0's)
-   computegradient( data, width, height, gx, gy);
-   edtaa3(data, gx, gy, width, height, xdist, ydist, outside);
-   for (unsigned int i=0; i<wh; i++)
-      if( outside[i] < 0.0 )
-         outside[i] = 0.0;
+   double diag = hypot( width, height );
+   float *outside = malloc( 2 * wh * sizeof(float) );
+   float *inside  = &outside[wh];
 
-   // Compute inside = edtaa3(1-bitmap); % Transform foreground (1's)
-   memset( gx, 0, sizeof(double)*width*height );
-   memset( gy, 0, sizeof(double)*width*height );
-   for (unsigned int i=0; i<wh; i++)
-      data[i] = 1. - data[i];
-   computegradient( data, width, height, gx, gy );
-   edtaa3( data, gx, gy, width, height, xdist, ydist, inside );
-   for (unsigned int i=0; i<wh; i++)
-      if (inside[i] < 0.)
-         inside[i] = 0.;
+   /* Seed the transforms, edge pixels are at about 0.5-a of the edge. */
+   for (unsigned int i=0; i<wh; i++) {
+      double a = data[i];
+      if (a >= 1.) {
+         outside[i] = 0.;
+         inside[i]  = EDT_INF;
+      }
+      else if (a <= 0.) {
+         outside[i] = EDT_INF;
+         inside[i]  = 0.;
+      }
+      else {
+         float d = 0.5 - a;
+         outside[i] = (d > 0.) ? d*d : 0.;
+         inside[i]  = (d < 0.) ? d*d : 0.;
+      }
+   }
+   edt_2d( outside, width, height );
+   edt_2d( inside, width, height );
 
    // distmap = outside - inside; % Bipolar distance field
    *vmax = 0.;
    for (unsigned int i=0; i<wh; i++) {
-      outside[i] -= inside[i];
-      if( *vmax < fabs( outside[i] ) )
-         *vmax = fabs( outside[i] );
+      /* Images without edges have no seeds, keep them in range. */
+      double v = fmax( -diag, fmin( diag, sqrt( outside[i] ) - sqrt( inside[i] ) ) );
+      data[i] = v;
+      if( *vmax < fabs( v ) )
+         *vmax = fabs( v );
    }
 
-   for (unsigned int i=0; i<wh; i++) {
-      double v = outside[i];
-      if     ( v < -*vmax) outside[i] = -*vmax;
-      else if( v > +*vmax) outside[i] = +*vmax;
-      data[i] = (outside[i]+*vmax)/(2. * *vmax);
-   }
+   if (*vmax > 0.)
+      for (unsigned int i=0; i<wh; i++)
+         data[i] = (data[i]+*vmax)/(2. * *vmax);
+   else
+      for (unsigned int i=0; i<wh; i++)
+         data[i] = 0.5;
 
-   free( xdist );
-   free( ydist );
-   free( gx );
-   free( gy );
    free( outside );
-   free( inside );
    return data;
 }
 
@@ -45,6 +45,7 @@
 #define ECON_FACTION_MOD   0.1 /**< Modifier on Base for faction standings. */
 #define ECON_PROD_MODIFIER 500000. /**< Production modifier, divide production by this amount. */
 #define ECON_PROD_VAR      0.01 /**< Defines the variability of production. */
+#define ECON_PRICE_EXP     0.25 /**< Exponent of the supply ratio applied to prices. */
 
 /* systems stack. */
 extern StarSystem *systems_stack; /**< Star system stack. */
@@ -58,15 +59,32 @@ extern Commodity* commodity_stack;
 static int econ_initialized   = 0; /**< Is economy system initialized? */
 static int econ_queued        = 0; /**< Whether there are any queued updates. */
 static cs *econ_G             = NULL; /**< Admittance matrix. */
+static css *econ_S            = NULL; /**< Symbolic Cholesky analysis of econ_G. */
+static csn *econ_N            = NULL; /**< Cholesky factorization of econ_G, kept until the matrix changes. */
+static double *econ_prodfactor= NULL; /**< Array (array.h): Per system, production factor. */
+static ntime_t econ_dt        = 0; /**< Time elapsed since the prices were last solved. */
+static unsigned int econ_price_gen = 1; /**< Bumped whenever prices change other than with time, invalidating cached prices. */
+static unsigned int econ_seen_gen  = 1; /**< Bumped whenever the prices seen by the player change. */
+/**
+ * @brief Cached galaxy-wide average of the seen prices of a commodity.
+ */
+typedef struct EconAverage_ {
+   unsigned int gen; /**< Value of econ_seen_gen it was computed at, 0 if never. */
+   int ret;          /**< Return value of economy_getAveragePrice. */
+   credits_t mean;   /**< Sample mean. */
+   double std;       /**< Sample standard deviation. */
+} EconAverage;
+static EconAverage *econ_average = NULL; /**< Array (array.h): Per econ_comm index, cached average price. */
 int *econ_comm                = NULL; /**< Commodities to calculate. */
 
 /*
  * Prototypes.
  */
 /* Economy. */
-//static double econ_calcJumpR( StarSystem *A, StarSystem *B );
-//static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price );
-//static int econ_createGMatrix (void);
+static double econ_calcJumpR( const StarSystem *A, const StarSystem *B );
+static void econ_updateProduction( ntime_t dt );
+static double econ_calcSysI( const StarSystem *sys, int price );
+static int econ_createGMatrix (void);
 
 /*
  * Externed prototypes.
@@ -101,8 +119,7 @@ credits_t economy_getPrice( const Commodity *com,
 credits_t economy_getPriceAtTime( const Commodity *com,
       const StarSystem *sys, const Spob *p, ntime_t tme )
 {
-   (void) sys;
-   int i, k;
+   int i, ci, k;
    double price;
    double t;
    CommodityPrice *commPrice;
@@ -126,38 +143,50 @@ credits_t economy_getPriceAtTime( const Commodity *com,
     * Journey with a single jump takes approx 3e7, so about 3 periods. */
    t = ntime_convertSeconds( tme ) / NT_PERIOD_SECONDS;
 
+   /* Get the index on this spob. */
+   for (i=0; i<array_size(p->commodities); i++) {
+      if (p->commodities[i] == com)
+         break;
+   }
+   if (i >= array_size(p->commodities)) {
+      WARN(_("Price for commodity '%s' not known on this spob."), com->name);
+      return 0;
+   }
+   commPrice = &p->commodityPrice[i];
+
+   /* Prices are queried many times for the same time, e.g., when rendering. */
+   if ((commPrice->cache_gen == econ_price_gen) && (commPrice->cache_time == tme))
+      return commPrice->cache_price;
+
    /* Get position in stack. */
    k = com - commodity_stack;
 
    /* Find what commodity that is. */
-   for (i=0; i<array_size(econ_comm); i++)
-      if (econ_comm[i] == k)
+   for (ci=0; ci<array_size(econ_comm); ci++)
+      if (econ_comm[ci] == k)
          break;
 
    /* Check if found. */
-   if (i >= array_size(econ_comm)) {
+   if (ci >= array_size(econ_comm)) {
       WARN(_("Price for commodity '%s' not known."), com->name);
       return 0;
    }
 
-   /* and get the index on this spob */
-   for (i=0; i<array_size(p->commodities); i++) {
-      if ((strcmp(p->commodities[i]->name, com->name)==0))
-         break;
-   }
-   if (i >= array_size(p->commodities)) {
-      WARN(_("Price for commodity '%s' not known on this spob."), com->name);
-      return 0;
-   }
-   commPrice = &p->commodityPrice[i];
    /* Calculate price. */
-   /* price  = (double) com->price; */
-   /* price *= sys->prices[i]; */
    price = (commPrice->price + commPrice->sysVariation
          * sin(2. * M_PI * t / commPrice->sysPeriod)
          + commPrice->spobVariation
          * sin(2. * M_PI * t / commPrice->spobPeriod));
-   return (credits_t) (price+0.5);/* +0.5 to round */
+   /* Apply the dynamic economy. */
+   if (sys == NULL)
+      sys = system_get( spob_getSystem( p->name ) );
+   if ((sys != NULL) && (sys->prices != NULL))
+      price *= sys->prices[ci];
+
+   commPrice->cache_gen   = econ_price_gen;
+   commPrice->cache_time  = tme;
+   commPrice->cache_price = (credits_t) (price+0.5);/* +0.5 to round */
+   return commPrice->cache_price;
 }
 
 /**
@@ -243,6 +272,7 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
 {
    int i, k;
    CommodityPrice *commPrice;
+   EconAverage *avg;
    double av = 0;
    double av2 = 0;
    int cnt = 0;
@@ -279,6 +309,20 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
       *std = 0;
       return 1;
    }
+
+   /* Seen prices only change when landing, so reuse the last average. */
+   if (econ_average == NULL) {
+      econ_average = array_create_size( EconAverage, array_size(econ_comm) );
+      array_resize( &econ_average, array_size(econ_comm) );
+      memset( econ_average, 0, array_size(econ_average)*sizeof(EconAverage) );
+   }
+   avg = &econ_average[i];
+   if (avg->gen == econ_seen_gen) {
+      *mean = avg->mean;
+      *std  = avg->std;
+      return avg->ret;
+   }
+
    for (i=0; i<array_size(systems_stack) ; i++) {
       StarSystem *sys = &systems_stack[i];
       for (int j=0; j<array_size(sys->spobs); j++) {
@@ -286,7 +330,7 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
 
          /* and get the index on this spob */
          for (k=0; k<array_size(p->commodities); k++) {
-            if ((strcmp(p->commodities[k]->name, com->name) == 0 ))
+            if (p->commodities[k] == com)
                break;
          }
          if (k < array_size(p->commodityPrice)) {
@@ -305,10 +349,13 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
    }
    *mean = (credits_t)(av + 0.5);
    *std = av2;
+   avg->gen  = econ_seen_gen;
+   avg->ret  = 0;
+   avg->mean = *mean;
+   avg->std  = *std;
    return 0;
 }
 
-#if 0
 /**
  * @brief Calculates the resistance between two star systems.
  *
@@ -316,7 +363,7 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean, double *std
  *    @param B Star system to calculate the resistance between.
  *    @return Resistance between A and B.
  */
-static double econ_calcJumpR( StarSystem *A, StarSystem *B )
+static double econ_calcJumpR( const StarSystem *A, const StarSystem *B )
 {
    double R;
 
@@ -340,106 +387,128 @@ static double econ_calcJumpR( StarSystem *A, StarSystem *B )
    return R;
 }
 
+/**
+ * @brief Updates the production level of the systems.
+ *
+ *    @param dt Time elapsed in NTIME.
+ */
+static void econ_updateProduction( ntime_t dt )
+{
+   double ddt = ntime_convertSeconds( dt ) / NT_PERIOD_SECONDS;
+   for (int i=0; i<array_size(econ_prodfactor); i++) {
+      double prodfactor = econ_prodfactor[i];
+      /* Add a variability factor based on the Gaussian distribution. */
+      prodfactor += ECON_PROD_VAR * RNG_2SIGMA() * ddt;
+      /* Add a tendency to return to the base production. */
+      prodfactor -= ECON_PROD_VAR * (prodfactor - 1.) * ddt;
+      econ_prodfactor[i] = MAX( prodfactor, 0. );
+   }
+}
+
 /**
  * @brief Calculates the intensity in a system node.
  *
- * @todo Make it time/item dependent.
+ *    @param sys System to calculate the intensity of.
+ *    @param price Index of the commodity in econ_comm.
+ *    @return Intensity of the system for the commodity.
  */
-static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price )
+static double econ_calcSysI( const StarSystem *sys, int price )
 {
-   int i;
-   double I;
-   double prodfactor, p;
-   double ddt;
-   Spob *spob;
+   const Commodity *com = &commodity_stack[ econ_comm[price] ];
+   double p = 0.;
 
-   ddt = (double)(dt / NTIME_UNIT_LENGTH);
-
-   /* Calculate production level. */
-   p = 0.;
-   for (i=0; i<sys->nspobs; i++) {
-      spob = sys->spobs[i];
-      if (spob_hasService(spob, SPOB_SERVICE_INHABITED)) {
-         /*
-          * Calculate production.
-          */
-         /* We base off the current production. */
-         prodfactor  = spob->cur_prodfactor;
-         /* Add a variability factor based on the Gaussian distribution. */
-         prodfactor += ECON_PROD_VAR * RNG_2SIGMA() * ddt;
-         /* Add a tendency to return to the spob's base production. */
-         prodfactor -= ECON_PROD_VAR *
-               (spob->cur_prodfactor - prodfactor)*ddt;
-         /* Save for next iteration. */
-         spob->cur_prodfactor = prodfactor;
-         /* We base off the sqrt of the population otherwise it changes too fast. */
-         p += prodfactor * sqrt(spob->population);
+   /* Calculate production level of the spobs trading the commodity. */
+   for (int i=0; i<array_size(sys->spobs); i++) {
+      const Spob *spob = sys->spobs[i];
+      if (!spob_hasService(spob, SPOB_SERVICE_INHABITED))
+         continue;
+      for (int j=0; j<array_size(spob->commodities); j++) {
+         if (spob->commodities[j] == com) {
+            /* We base off the sqrt of the population otherwise it changes too fast. */
+            p += sqrt(spob->population);
+            break;
+         }
       }
    }
 
    /* The intensity is basically the modified production. */
-   I = p / ECON_PROD_MODIFIER;
-
-   return I;
+   return econ_prodfactor[sys->id] * p / ECON_PROD_MODIFIER;
 }
 
 /**
- * @brief Creates the admittance matrix.
+ * @brief Creates the admittance matrix, factorizing it if it changed.
+ *
+ * Each jump route is a resistance between the two systems, and every system
+ *  has an additional resistance to ground for dampening, which makes the
+ *  matrix symmetric positive definite.
  *
  *    @return 0 on success.
  */
 static int econ_createGMatrix (void)
 {
-   int ret;
-   int i, j;
-   double R, Rsum;
-   cs *M;
-   StarSystem *sys;
+   int n = array_size(systems_stack);
+   cs *M, *G;
 
    /* Create the matrix. */
-   M = cs_spalloc( array_size(systems_stack), array_size(systems_stack), 1, 1, 1 );
+   M = cs_spalloc( n, n, 1, 1, 1 );
    if (M == NULL)
       ERR(_("Unable to create CSparse Matrix."));
 
    /* Fill the matrix. */
-   for (i=0; i < array_size(systems_stack); i++) {
-      sys   = &systems_stack[i];
-      Rsum = 0.;
+   for (int i=0; i<n; i++) {
+      const StarSystem *sys = &systems_stack[i];
+
+      for (int j=0; j<array_size(sys->jumps); j++) {
+         const JumpPoint *jp = &sys->jumps[j];
+         int t = jp->target->id;
+         double R;
 
-      /* Set some values. */
-      for (j=0; j < array_size(sys->jumps); j++) {
+         /* Two-way routes are only added from one end. */
+         if ((t < i) && (jp->returnJump != NULL))
+            continue;
 
-         /* Get the resistances. */
-         R     = econ_calcJumpR( sys, sys->jumps[j].target );
-         R     = 1./R; /* Must be inverted. */
-         Rsum += R;
+         /* Get the resistances, must be inverted. */
+         R = 1. / econ_calcJumpR( sys, jp->target );
 
          /* Matrix is symmetrical and non-diagonal is negative. */
-         ret = cs_entry( M, i, sys->jumps[j].target->id, -R );
-         if (ret != 1)
-            WARN(_("Unable to enter CSparse Matrix Cell."));
-         ret = cs_entry( M, sys->jumps[j].target->id, i, -R );
-         if (ret != 1)
+         if ((cs_entry( M, i, t, -R ) != 1) || (cs_entry( M, t, i, -R ) != 1) ||
+               (cs_entry( M, i, i, R ) != 1) || (cs_entry( M, t, t, R ) != 1))
             WARN(_("Unable to enter CSparse Matrix Cell."));
       }
 
-      /* Set the diagonal. */
-      Rsum += 1./ECON_SELF_RES; /* We add a resistance for dampening. */
-      cs_entry( M, i, i, Rsum );
+      /* We add a resistance for dampening. */
+      cs_entry( M, i, i, 1./ECON_SELF_RES );
    }
 
-   /* Compress M matrix and put into G. */
-   cs_spfree( econ_G );
-   econ_G = cs_compress( M );
-   if (econ_G == NULL)
+   /* Compress M matrix, summing duplicate entries. */
+   G = cs_compress( M );
+   cs_spfree( M );
+   if ((G == NULL) || !cs_dupl( G ))
       ERR(_("Unable to create economy G Matrix."));
 
-   /* Clean up. */
-   cs_spfree(M);
+   /* Keep the factorization if nothing changed. */
+   if ((econ_N != NULL) && (econ_G->n == G->n) && (econ_G->p[n] == G->p[n]) &&
+         (memcmp( econ_G->p, G->p, (n+1)*sizeof(G->p[0]) ) == 0) &&
+         (memcmp( econ_G->i, G->i, G->p[n]*sizeof(G->i[0]) ) == 0) &&
+         (memcmp( econ_G->x, G->x, G->p[n]*sizeof(G->x[0]) ) == 0)) {
+      cs_spfree( G );
+      return 0;
+   }
+   cs_spfree( econ_G );
+   econ_G = G;
+
+   /* Cholesky factorization with an AMD ordering. */
+   cs_nfree( econ_N );
+   cs_sfree( econ_S );
+   econ_S = cs_schol( 1, econ_G );
+   econ_N = (econ_S != NULL) ? cs_chol( econ_G, econ_S ) : NULL;
+   if (econ_N == NULL) {
+      WARN(_("Unable to factorize the economy G Matrix."));
+      return -1;
+   }
 
    return 0;
 }
-#endif
 
 /**
  * @brief Initializes the economy.
@@ -452,10 +521,15 @@ int economy_init (void)
    if (econ_initialized)
       return 0;
 
-   /* Allocate price space. */
+   /* Allocate price space, neutral until solved. */
+   array_free( econ_prodfactor );
+   econ_prodfactor = array_create_size( double, array_size(systems_stack) );
    for (int i=0; i<array_size(systems_stack); i++) {
       free(systems_stack[i].prices);
-      systems_stack[i].prices = calloc(array_size(econ_comm), sizeof(double));
+      systems_stack[i].prices = malloc(array_size(econ_comm) * sizeof(double));
+      for (int j=0; j<array_size(econ_comm); j++)
+         systems_stack[i].prices[j] = 1.;
+      array_push_back( &econ_prodfactor, 1. );
    }
 
    /* Mark economy as initialized. */
@@ -498,9 +572,20 @@ int economy_refresh (void)
    if (econ_initialized == 0)
       return 0;
 
+   /* New systems start at the base production and neutral prices. */
+   while (array_size(econ_prodfactor) < array_size(systems_stack))
+      array_push_back( &econ_prodfactor, 1. );
+   for (int i=0; i<array_size(systems_stack); i++) {
+      if (systems_stack[i].prices != NULL)
+         continue;
+      systems_stack[i].prices = malloc(array_size(econ_comm) * sizeof(double));
+      for (int j=0; j<array_size(econ_comm); j++)
+         systems_stack[i].prices[j] = 1.;
+   }
+
    /* Create the resistance matrix. */
-   //if (econ_createGMatrix())
-   //   return -1;
+   if (econ_createGMatrix())
+      return -1;
 
    /* Initialize the prices. */
    economy_update( 0 );
@@ -515,74 +600,50 @@ int economy_refresh (void)
  */
 int economy_update( unsigned int dt )
 {
-   (void)dt;
-#if 0
-   int i, j;
-   double *X;
-   double scale, offset;
-   /*double min, max;*/
+   int n;
+   double *X, *work;
 
    /* Economy must be initialized. */
-   if (econ_initialized == 0)
+   if ((econ_initialized == 0) || (econ_N == NULL))
       return 0;
 
-   /* Create the vector to solve the system. */
-   X = malloc(sizeof(double)*array_size(systems_stack));
-   if (X == NULL) {
-      WARN(_("Out of Memory"));
-      return -1;
-   }
-
-   /* Calculate the results for each price set. */
-   for (j=0; j<array_size(econ_comm); j++) {
-
-      /* First we must load the vector with intensities. */
-      for (i=0; i<array_size(systems_stack); i++)
-         X[i] = econ_calcSysI( dt, &systems_stack[i], j );
-
-      /* Solve the system. */
-      /** @TODO This should be improved to try to use better factorizations (LU/Cholesky)
-       * if possible or just outright try to use some other library that does fancy stuff
-       * like UMFPACK. Would be also interesting to see if it could be optimized so we
-       * store the factorization or update that instead of handling it individually. Another
-       * point of interest would be to split loops out to make the solving faster, however,
-       * this may be trickier to do (although it would surely let us use cholesky always if we
-       * enforce that condition). */
-      ret = cs_qrsol( 3, econ_G, X );
-      if (ret != 1)
-         WARN(_("Failed to solve the Economy System."));
-
-      /*
-       * Get the minimum and maximum to scale.
-       */
-      /*
-      min = +HUGE_VALF;
-      max = -HUGE_VALF;
-      for (i=0; i<array_size(systems_stack); i++) {
-         if (X[i] < min)
-            min = X[i];
-         if (X[i] > max)
-            max = X[i];
-      }
-      scale = 1. / (max - min);
-      offset = 0.5 - min * scale;
-      */
-
-      /*
-       * I'm not sure I like the filtering of the results, but it would take
-       * much more work to get a good system working without the need of post
-       * filtering.
-       */
-      scale    = 1.;
-      offset   = 1.;
-      for (i=0; i<array_size(systems_stack); i++)
-         systems_stack[i].prices[j] = X[i] * scale + offset;
+   /* Only solve once per period, unless forced by a refresh. */
+   econ_dt += dt;
+   if ((dt != 0) && (ntime_convertSeconds( econ_dt ) < NT_PERIOD_SECONDS))
+      return 0;
+   econ_updateProduction( econ_dt );
+   econ_dt = 0;
+
+   /* Load the intensities of all the commodities, one column each. */
+   n    = array_size(systems_stack);
+   X    = malloc( sizeof(double) * n * array_size(econ_comm) );
+   work = malloc( sizeof(double) * n );
+   for (int j=0; j<array_size(econ_comm); j++)
+      for (int i=0; i<n; i++)
+         X[j*n+i] = econ_calcSysI( &systems_stack[i], j );
+
+   /* Solve all of them with the stored factorization: G = P'LL'P. */
+   for (int j=0; j<array_size(econ_comm); j++) {
+      double *x = &X[j*n];
+      double mean = 0.;
+      cs_ipvec( econ_S->pinv, x, work, n );
+      cs_lsolve( econ_N->L, work );
+      cs_ltsolve( econ_N->L, work );
+      cs_pvec( econ_S->pinv, work, x, n );
+
+      /* Systems with more supply around than average get cheaper prices. */
+      for (int i=0; i<n; i++)
+         mean += x[i];
+      mean /= MAX( n, 1 );
+      for (int i=0; i<n; i++)
+         systems_stack[i].prices[j] = pow( (1.+mean) / (1.+MAX(x[i],0.)), ECON_PRICE_EXP );
    }
 
    /* Clean up. */
-   free(X);
+   free( work );
+   free( X );
 
-#endif
+   econ_price_gen++;
    econ_queued = 0;
    return 0;
 }
@@ -605,6 +666,17 @@ void economy_destroy (void)
    /* Destroy the economy matrix. */
    cs_spfree( econ_G );
    econ_G = NULL;
+   cs_nfree( econ_N );
+   econ_N = NULL;
+   cs_sfree( econ_S );
+   econ_S = NULL;
+   array_free( econ_prodfactor );
+   econ_prodfactor = NULL;
+   array_free( econ_average );
+   econ_average = NULL;
+   econ_dt = 0;
+   econ_price_gen++;
+   econ_seen_gen++;
 
    /* Economy is now deinitialized. */
    econ_initialized = 0;
@@ -858,6 +930,8 @@ static void economy_calcUpdatedCommodityPrice(StarSystem *sys)
  */
 void economy_initialiseCommodityPrices(void)
 {
+   econ_price_gen++;
+
    /* First use spob attributes to set prices and variability */
    for (int k=0; k<array_size(systems_stack); k++) {
       StarSystem *sys = &systems_stack[k];
@@ -916,6 +990,7 @@ void economy_initialiseCommodityPrices(void)
  */
 void economy_initialiseSingleSystem( StarSystem *sys, Spob *spob )
 {
+   econ_price_gen++;
    for (int i=0; i<array_size(spob->commodities); i++)
       economy_calcPrice( spob, spob->commodities[i], &spob->commodityPrice[i] );
    economy_modifySystemCommodityPrice(sys);
@@ -931,6 +1006,7 @@ void economy_averageSeenPrices( const Spob *p )
          credits_t price;
          cp->updateTime = t;
          /* Calculate values for mean and std */
+         econ_seen_gen++;
          cp->cnt++;
          price = economy_getPrice(c, NULL, p);
          cp->sum += price;
@@ -948,6 +1024,7 @@ void economy_averageSeenPricesAtTime( const Spob *p, const ntime_t tupdate )
       if (cp->updateTime < t) { /* has not yet been updated at present time. */
          credits_t price;
          cp->updateTime = t;
+         econ_seen_gen++;
          cp->cnt++;
          price = economy_getPriceAtTime(c, NULL, p, tupdate);
          cp->sum += price;
@@ -956,11 +1033,22 @@ void economy_averageSeenPricesAtTime( const Spob *p, const ntime_t tupdate )
    }
 }
 
+/**
+ * @brief Gets a counter that changes whenever the prices seen by the player change.
+ *
+ * Allows caching values derived from the seen prices.
+ */
+unsigned int economy_seenGeneration (void)
+{
+   return econ_seen_gen;
+}
+
 /**
  * @brief Clears all system knowledge.
  */
 void economy_clearKnown (void)
 {
+   econ_seen_gen++;
    for (int i=0; i<array_size(systems_stack); i++) {
       StarSystem *sys = &systems_stack[i];
       for (int j=0; j<array_size(sys->spobs); j++) {
@@ -983,6 +1071,7 @@ void economy_clearKnown (void)
  */
 void economy_clearSingleSpob(Spob *p)
 {
+   econ_seen_gen++;
    for (int k=0; k<array_size(p->commodityPrice); k++) {
       CommodityPrice *cp = &p->commodityPrice[k];
       cp->cnt = 0;
@@ -1057,6 +1146,7 @@ int economy_sysLoad( xmlNodePtr parent )
          } while (xml_nextNode(cur));
       }
    } while (xml_nextNode(node));
+   econ_seen_gen++;
    return 0;
 }
 
@@ -20,6 +20,7 @@ int economy_update( unsigned int dt );
 int economy_refresh (void);
 void economy_destroy (void);
 void economy_clearKnown (void);
+unsigned int economy_seenGeneration (void);
 void economy_clearSingleSpob( Spob *p );
 
 /*
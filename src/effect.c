@@ -43,7 +43,7 @@ static int effect_cmpTimer( const void *p1, const void *p2 )
       return -1;
    else if (e1->data->priority > e2->data->priority)
       return +1;
-   return e1->timer - e2->timer;
+   return (e1->expire > e2->expire) - (e1->expire < e2->expire);
 }
 
 /**
@@ -253,50 +253,92 @@ const EffectData *effect_get( const char *name )
 /**
  * @brief Updates an effect list.
  *
+ * Only looks at the effects when the earliest one may have expired.
+ *
  *    @param efxlist The effect list.
+ *    @param clock Clock of the effect list.
  *    @param dt The time update.
  *    @return The number of effects that ended or changed.
  */
-int effect_update( Effect **efxlist, double dt )
+int effect_update( Effect **efxlist, EffectClock *clock, double dt )
 {
    int n = 0;
+
+   clock->time += dt;
+   if (clock->time < clock->next)
+      return 0;
+
    for (int i=array_size(*efxlist)-1; i>=0; i--) {
-      Effect *e = &(*efxlist)[i];
-      e->timer -= dt;
-      e->elapsed += dt;
-      if (e->timer > 0.)
+      const Effect *e = &(*efxlist)[i];
+      const EffectData *data;
+      unsigned int parent;
+      if (e->expire > clock->time)
          continue;
 
+      /* Get rid of it before the Lua can change the list. */
+      data   = e->data;
+      parent = e->parent;
+      array_erase( efxlist, &e[0], &e[1] );
+      n++;
+
       /* Run Lua if necessary. */
-      if (e->data->lua_remove != LUA_NOREF) {
-         lua_rawgeti(naevL, LUA_REGISTRYINDEX, e->data->lua_remove); /* f */
-         lua_pushpilot(naevL, e->parent);
-         if (nlua_pcall( e->data->lua_env, 1, 0 )) {
-            WARN(_("Effect '%s' failed to run '%s':\n%s"), e->data->name, "remove", lua_tostring(naevL,-1));
+      if (data->lua_remove != LUA_NOREF) {
+         lua_rawgeti(naevL, LUA_REGISTRYINDEX, data->lua_remove); /* f */
+         lua_pushpilot(naevL, parent);
+         if (nlua_pcall( data->lua_env, 1, 0 )) {
+            WARN(_("Effect '%s' failed to run '%s':\n%s"), data->name, "remove", lua_tostring(naevL,-1));
             lua_pop(naevL,1);
          }
       }
-
-      /* Get rid of it. */
-      array_erase( efxlist, e, e+1 );
-      n++;
+      i = MIN( i, array_size(*efxlist) );
    }
+
+   /* Find the next expiry. */
+   clock->next = INFINITY;
+   for (int i=0; i<array_size(*efxlist); i++)
+      clock->next = MIN( clock->next, (*efxlist)[i].expire );
+
    if (n>0)
       gui_updateEffects();
    return n;
 }
 
+/**
+ * @brief Gets the time left on an effect.
+ *
+ *    @param e Effect to get the time left of.
+ *    @param clock Clock of the effect list.
+ *    @return The time left.
+ */
+double effect_timeLeft( const Effect *e, const EffectClock *clock )
+{
+   return e->expire - clock->time;
+}
+
+/**
+ * @brief Gets the time since an effect was first added.
+ *
+ *    @param e Effect to get the elapsed time of.
+ *    @param clock Clock of the effect list.
+ *    @return The elapsed time, not reset when the effect is overwritten.
+ */
+double effect_elapsed( const Effect *e, const EffectClock *clock )
+{
+   return clock->time - e->start;
+}
+
 /**
  * @brief Adds an effect to an effect list.
  *
  *    @param efxlist List of effects.
+ *    @param clock Clock of the effect list.
  *    @param efx Effect to add.
  *    @param duration Duration of the effect or set to negative for default.
  *    @param strength Scaling strength of the effect.
  *    @param parent Pilot the effect is being added to.
  *    @return 0 on success.
  */
-int effect_add( Effect **efxlist, const EffectData *efx, double duration, double strength, unsigned int parent )
+int effect_add( Effect **efxlist, EffectClock *clock, const EffectData *efx, double duration, double strength, unsigned int parent )
 {
    Effect *e = NULL;
    int overwrite = 0;
@@ -318,7 +360,7 @@ int effect_add( Effect **efxlist, const EffectData *efx, double duration, double
                if (el->strength > strength)
                   return 0;
                /* Case the base effect has a longer timer with same strength we ignore. */
-               if ((fabs(el->strength-strength)<1e-5) && (el->timer > duration))
+               if ((fabs(el->strength-strength)<1e-5) && (effect_timeLeft( el, clock ) > duration))
                   return 0;
                /* Procede to overwrite. */
                overwrite = 1;
@@ -343,12 +385,13 @@ int effect_add( Effect **efxlist, const EffectData *efx, double duration, double
    /* Add new effect if necessary. */
    if (e==NULL) {
       e = &array_grow( efxlist );
-      e->elapsed = 0.; /* Don't 0. when overwriting. */
+      e->start   = clock->time; /* Don't reset when overwriting. */
       e->r       = RNGF();
    }
    e->data  = efx;
    e->duration = duration;
-   e->timer = e->duration;
+   e->expire = clock->time + e->duration;
+   clock->next = MIN( clock->next, e->expire );
    e->strength = strength;
    e->parent = parent;
 
@@ -391,7 +434,7 @@ int effect_rm( Effect **efxlist, int idx )
 {
    const Effect *e;
 
-   if ((idx < 0) || (idx > array_size(efxlist))) {
+   if ((idx < 0) || (idx >= array_size(*efxlist))) {
       WARN(_("Trying to remove invalid effect ID!"));
       return -1;
    }
@@ -421,7 +464,7 @@ int effect_rm( Effect **efxlist, int idx )
 int effect_rmType( Effect **efxlist, const EffectData *efx, int all )
 {
    int ret = 0;
-   for (int i=array_size(*efxlist)-1; i>=0; i++) {
+   for (int i=array_size(*efxlist)-1; i>=0; i--) {
       const Effect *e = &(*efxlist)[i];
       if (e->data != efx)
          continue;
@@ -452,7 +495,7 @@ int effect_rmType( Effect **efxlist, const EffectData *efx, int all )
  */
 void effect_clearSpecific( Effect **efxlist, int debuffs, int buffs, int others )
 {
-   for (int i=array_size(*efxlist)-1; i>=0; i++) {
+   for (int i=array_size(*efxlist)-1; i>=0; i--) {
       const Effect *e = &(*efxlist)[i];
 
       /* See if should be eliminated. */
@@ -29,7 +29,7 @@ typedef struct EffectData_ {
    GLuint tex_mat;
    GLuint dimensions;
    GLuint u_r;
-   GLuint u_tex;
+   GLint u_tex;
    GLuint u_timer;
    GLuint u_elapsed;
    GLuint u_dir;
@@ -46,13 +46,24 @@ typedef struct EffectData_ {
 typedef struct Effect_ {
    const EffectData *data;/**< Base data of the effect. */
    unsigned int parent; /**< Pilot it is being applied to. */
-   double timer;        /**< Time left on the effect. */
+   double expire;       /**< Time of the list clock when the effect ends. */
+   double start;        /**< Time of the list clock when the effect was first added. */
    double duration;     /**< Duration of this effect. */
    double strength;     /**< Scales the effect. */
    double r;            /**< Random number. */
-   double elapsed;      /**< Total elapsed time. */
 } Effect;
 
+/**
+ * @brief Clock the effects of a list expire on.
+ *
+ * Effects store when they end instead of counting down, so that updating a
+ * list only has to compare the time with the earliest expiry.
+ */
+typedef struct EffectClock_ {
+   double time;         /**< Current time. */
+   double next;         /**< Earliest expiry of the list, may be earlier than the actual one. */
+} EffectClock;
+
 /*
  * Effect stuff.
  */
@@ -63,8 +74,10 @@ const EffectData *effect_get( const char *name );
 /*
  * Effect list stuff.
  */
-int effect_update( Effect **efxlist, double dt );
-int effect_add( Effect **efxlist, const EffectData *efx, double duration, double strength, unsigned int parent );
+int effect_update( Effect **efxlist, EffectClock *clock, double dt );
+int effect_add( Effect **efxlist, EffectClock *clock, const EffectData *efx, double duration, double strength, unsigned int parent );
+double effect_timeLeft( const Effect *e, const EffectClock *clock );
+double effect_elapsed( const Effect *e, const EffectClock *clock );
 int effect_rm( Effect **efxlist, int idx );
 int effect_rmType( Effect **efxlist, const EffectData *efx, int all );
 void effect_clearSpecific( Effect **efxlist, int debuffs, int buffs, int others );
@@ -113,6 +113,8 @@ static void equipment_outfitPopdown( unsigned int wid, const char* str );
 static void equipment_changeTab( unsigned int wid, const char *wgt, int old, int tab );
 static int equipment_playerAddOutfit( const Outfit *o, int quantity );
 static int equipment_playerRmOutfit( const Outfit *o, int quantity );
+static char *equipment_outfitAltText( unsigned int wid, const char *wgt, int pos );
+static char *equipment_intrinsicAltText( unsigned int wid, const char *wgt, int pos );
 
 /**
  * @brief Handles right-click on unequipped outfit.
@@ -501,7 +503,7 @@ static void equipment_renderColumn( double x, double y, double w, double h,
 
       if (lst[i].outfit != NULL) {
          /* Draw bugger. */
-         gl_renderScale( lst[i].outfit->gfx_store,
+         gl_renderScale( outfit_gfxStore( lst[i].outfit ),
                x, y, w, h, NULL );
       }
       else if ((o != NULL) &&
@@ -1679,7 +1681,6 @@ static void equipment_genOutfitList( unsigned int wid )
    int noutfits, active;
    ImageArrayCell *coutfits;
    int iconsize;
-   const Pilot *p = (eq_wgt.selected != NULL) ? eq_wgt.selected->p : NULL;
 
    /* Get dimensions. */
    equipment_getDim( wid, &w, &h, NULL, NULL, &ow, &oh,
@@ -1742,7 +1743,8 @@ static void equipment_genOutfitList( unsigned int wid )
 
    /* Get the outfits. */
    noutfits = player_getOutfitsFiltered( (const Outfit***)&iar_outfits[active], tabfilters[active], filtertext );
-   coutfits = outfits_imageArrayCells( (const Outfit**)iar_outfits[active], &noutfits, (p==NULL) ? player.p : p, 0 );
+   array_resize( &iar_outfits[active], noutfits );
+   coutfits = outfits_imageArrayCells( (const Outfit**)iar_outfits[active], &noutfits, 0 );
 
    /* Create the actual image array. */
    iw = ow - 6;
@@ -1762,6 +1764,7 @@ static void equipment_genOutfitList( unsigned int wid )
          equipment_rightClickOutfits );
 
    toolkit_setImageArrayAccept( wid, EQUIPMENT_OUTFITS, equipment_rightClickOutfits );
+   toolkit_setImageArrayAltText( wid, EQUIPMENT_OUTFITS, equipment_outfitAltText );
 
    equipment_updateOutfits(wid, NULL);
 }
@@ -2000,13 +2003,14 @@ void equipment_updateShips( unsigned int wid, const char* str )
       for (int i=0; i<ncells; i++)
          array_push_back( &outfits, ship->outfit_intrinsic[i].outfit );
 
-      cells = outfits_imageArrayCells( outfits, &ncells, ship, 0 );
+      cells = outfits_imageArrayCells( outfits, &ncells, 0 );
 
       window_posWidget( wid, "txtSDesc", &tx, &ty );
       window_dimWidget( wid, "txtSDesc", &tw, &th );
       ty = -40-window_getTextHeight( wid, "txtSDesc" )-10;
       window_addImageArray( wid, tx, ty, ww-x-128-30-10, ty-20+wh-bh-30, "iarIntrinsic",
          64, 64, cells, ncells, NULL, NULL, NULL );
+      toolkit_setImageArrayAltText( wid, "iarIntrinsic", equipment_intrinsicAltText );
 
       array_free(outfits);
    }
@@ -2518,6 +2522,33 @@ static int equipment_playerRmOutfit( const Outfit *o, int quantity )
    return player_rmOutfit(o,quantity);
 }
 
+/**
+ * @brief Generates the alt text of an outfit in the outfit list.
+ */
+static char *equipment_outfitAltText( unsigned int wid, const char *wgt, int pos )
+{
+   (void) wgt;
+   const Pilot *p;
+   int active = window_tabWinGetActive( wid, EQUIPMENT_OUTFIT_TAB );
+   if ((pos < 0) || (pos >= array_size(iar_outfits[active])))
+      return NULL;
+   p = (eq_wgt.selected != NULL) ? eq_wgt.selected->p : player.p;
+   return strdup( pilot_outfitSummary( p, iar_outfits[active][pos], 1 ) );
+}
+
+/**
+ * @brief Generates the alt text of an intrinsic outfit of the selected ship.
+ */
+static char *equipment_intrinsicAltText( unsigned int wid, const char *wgt, int pos )
+{
+   (void) wid;
+   (void) wgt;
+   const Pilot *p = (eq_wgt.selected != NULL) ? eq_wgt.selected->p : NULL;
+   if ((p == NULL) || (pos < 0) || (pos >= array_size(p->outfit_intrinsic)))
+      return NULL;
+   return strdup( pilot_outfitSummary( p, p->outfit_intrinsic[pos].outfit, 1 ) );
+}
+
 /**
  * @brief Cleans up after the equipment stuff.
  */
@@ -19,8 +19,24 @@
 #include "nlua.h"
 #include "nluadef.h"
 #include "nstring.h"
+#include "pilot_outfit.h"
 #include "player.h"
 
+#define ESCORT_SPAWN_PER_FRAME   4 /**< Maximum number of queued fighters launched per frame. */
+
+/**
+ * @brief Fighter waiting to be launched.
+ */
+typedef struct EscortSpawn_ {
+   unsigned int parent; /**< Pilot launching the fighter. */
+   const Ship *ship;    /**< Ship of the fighter. */
+   vec2 offset;         /**< Launch position relative to the parent. */
+   int dockslot;        /**< Outfit slot launching the fighter. */
+} EscortSpawn;
+
+static EscortSpawn *escort_spawnQueue = NULL; /**< Fighters waiting to be launched (array.h). */
+static const Pilot **escort_receivers = NULL; /**< Receivers of the group commands (array.h). */
+
 /*
  * Prototypes.
  */
@@ -222,6 +238,78 @@ unsigned int escort_createRef( Pilot *p, Pilot *pe,
    return pe->id;
 }
 
+/**
+ * @brief Queues a fighter to be launched by a fighter bay.
+ *
+ * Creating pilots is expensive, so when many bays fire at once the launches
+ *  are spread over the next frames by escorts_spawnQueued. The ammo is taken
+ *  when queuing.
+ *
+ *    @param p Pilot launching the fighter.
+ *    @param ship Ship of the fighter.
+ *    @param pos Position to launch at.
+ *    @param dockslot The outfit slot launching the fighter.
+ */
+void escort_queueBay( Pilot *p, const Ship *ship, const vec2 *pos, int dockslot )
+{
+   EscortSpawn *s;
+   if (escort_spawnQueue == NULL)
+      escort_spawnQueue = array_create( EscortSpawn );
+   s = &array_grow( &escort_spawnQueue );
+   s->parent   = p->id;
+   s->ship     = ship;
+   vec2_cset( &s->offset, pos->x - p->solid.pos.x, pos->y - p->solid.pos.y );
+   s->dockslot = dockslot;
+}
+
+/**
+ * @brief Launches the queued fighters, up to the per frame budget.
+ */
+void escorts_spawnQueued (void)
+{
+   int n = MIN( array_size(escort_spawnQueue), ESCORT_SPAWN_PER_FRAME );
+
+   for (int i=0; i<n; i++) {
+      const EscortSpawn *s = &escort_spawnQueue[i];
+      vec2 pos;
+      Pilot *p = pilot_get( s->parent );
+      /* The fighter is lost with the parent. */
+      if ((p == NULL) || pilot_isFlag( p, PILOT_DELETE ) || pilot_isFlag( p, PILOT_DEAD ))
+         continue;
+      vec2_cset( &pos, p->solid.pos.x + s->offset.x, p->solid.pos.y + s->offset.y );
+      escort_create( p, s->ship, &pos, &p->solid.vel, p->solid.dir,
+            ESCORT_TYPE_BAY, 1, s->dockslot );
+   }
+   if (n > 0)
+      array_erase( &escort_spawnQueue, &escort_spawnQueue[0], &escort_spawnQueue[n] );
+}
+
+/**
+ * @brief Drops the queued fighters, giving them back to their bays.
+ */
+void escorts_clearQueued (void)
+{
+   for (int i=0; i<array_size(escort_spawnQueue); i++) {
+      const EscortSpawn *s = &escort_spawnQueue[i];
+      Pilot *p = pilot_get( s->parent );
+      if ((p == NULL) || (s->dockslot < 0) || (s->dockslot >= array_size(p->outfits)))
+         continue;
+      pilot_addAmmo( p, p->outfits[ s->dockslot ], 1 );
+   }
+   array_erase( &escort_spawnQueue, array_begin(escort_spawnQueue), array_end(escort_spawnQueue) );
+}
+
+/**
+ * @brief Frees the escort queues.
+ */
+void escorts_free (void)
+{
+   array_free( escort_spawnQueue );
+   escort_spawnQueue = NULL;
+   array_free( escort_receivers );
+   escort_receivers = NULL;
+}
+
 /**
  * @brief Clears deployed escorts of a pilot.
  */
@@ -254,6 +342,8 @@ int escort_clearDeployed( Pilot *p )
 /**
  * @brief Runs an escort command on all of a pilot's escorts.
  *
+ * The escorts all get the same message, created once for the group.
+ *
  *    @param parent Pilot who is giving orders.
  *    @param cmd Order to give.
  *    @param idx Lua index of argument or 0.
@@ -264,13 +354,16 @@ static int escort_command( const Pilot *parent, const char *cmd, unsigned int id
    if (array_size(parent->escorts) == 0)
       return 1;
 
+   if (escort_receivers == NULL)
+      escort_receivers = array_create( const Pilot* );
+   array_resize( &escort_receivers, 0 );
    for (int i=0; i<array_size(parent->escorts); i++) {
       const Pilot *e = pilot_get( parent->escorts[i].id );
       if (e == NULL) /* Most likely died. */
          continue;
-
-      pilot_msg( parent, e, cmd, idx );
+      array_push_back( &escort_receivers, e );
    }
+   pilot_msgGroup( parent, escort_receivers, array_size(escort_receivers), cmd, idx );
 
    return 0;
 }
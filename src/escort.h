@@ -20,6 +20,10 @@ unsigned int escort_createRef( Pilot *p, Pilot *ref,
       const vec2 *pos, const vec2 *vel, double dir,
       EscortType_t type, int add, int dockslot );
 int escort_clearDeployed( Pilot *p );
+void escort_queueBay( Pilot *p, const Ship *ship, const vec2 *pos, int dockslot );
+void escorts_spawnQueued (void);
+void escorts_clearQueued (void);
+void escorts_free (void);
 
 /* Keybind commands. */
 int escorts_attack( Pilot *parent );
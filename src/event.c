@@ -22,7 +22,9 @@
 
 #include "conf.h"
 #include "array.h"
+#include "bitset.h"
 #include "cond.h"
+#include "faction.h"
 #include "hook.h"
 #include "log.h"
 #include "land.h"
@@ -40,8 +42,10 @@
 #include "npc.h"
 #include "nxml.h"
 #include "nxml_lua.h"
+#include "opengl.h"
 #include "player.h"
 #include "rng.h"
+#include "threadpool.h"
 
 #define XML_EVENT_ID          "Events" /**< XML document identifier */
 #define XML_EVENT_TAG         "event" /**< XML event tag. */
@@ -61,13 +65,15 @@ typedef struct EventData_ {
    /* For specific cases. */
    char *spob; /**< Spob name. */
    char *system; /**< System name. */
+   int spobid; /**< Id of the spob, -1 if not set or not found. */
+   int sysid; /**< Id of the system, -1 if not set or not found. */
    char *chapter; /**< Chapter name. */
    int *factions; /**< Faction checks. */
    pcre2_code *chapter_re; /**< Compiled regex chapter if applicable. */
 
    EventTrigger_t trigger; /**< What triggers the event. */
    char *cond; /**< Conditional Lua code to execute. */
-   int cond_chunk; /**< Chunk of the conditional Lua code. */
+   int cond_chunk; /**< Chunk of the conditional Lua code, owned by cond.c. */
    double chance; /**< Chance of appearing. */
    int priority; /**< Event priority: 0 = main plot, 5 = default, 10 = insignificant. */
 
@@ -79,11 +85,32 @@ typedef struct EventData_ {
  */
 static EventData *event_data   = NULL; /**< Allocated event data. */
 
+/**
+ * @brief Event data index and key it is filed under.
+ */
+typedef struct EventIndexEntry_ {
+   int key;    /**< Spob or system id. */
+   int data;   /**< Index in event_data. */
+} EventIndexEntry;
+
+/**
+ * @brief Events of a trigger, bucketed by where they can happen.
+ */
+typedef struct EventIndex_ {
+   EventIndexEntry *spob;     /**< Array (array.h): Events requiring a spob, sorted by spob id. */
+   EventIndexEntry *system;   /**< Array (array.h): Other events requiring a system, sorted by system id. */
+   int *generic;              /**< Array (array.h): Events that can happen anywhere. */
+   int *unresolved;           /**< Array (array.h): Events requiring a spob or system that doesn't exist yet. */
+} EventIndex;
+static EventIndex event_index[EVENT_TRIGGER_LOAD+1]; /**< Event index by trigger. */
+
 /*
  * Active events.
  */
 static unsigned int event_genid  = 0; /**< Event ID generator. */
 static Event_t *event_active     = NULL; /**< Active events. */
+static uint32_t *event_running   = NULL; /**< Bitset (bitset.h) of the data of the active events. */
+static int event_runningDirty    = 1; /**< Whether or not event_running has to be rebuilt. */
 
 /*
  * Prototypes.
@@ -91,9 +118,15 @@ static Event_t *event_active     = NULL; /**< Active events. */
 static unsigned int event_genID (void);
 static int event_cmp( const void* a, const void* b );
 static int event_parseFile( const char* file, EventData *temp );
+static int event_readFile( const char* file, EventData *temp );
+static void event_compile( EventData *temp );
+static int event_parseThread( void *ptr );
 static int event_parseXML( EventData *temp, const xmlNodePtr parent );
 static void event_freeData( EventData *event );
 static int event_create( int dataid, unsigned int *id );
+static void events_indexBuild (void);
+static void events_indexFree (void);
+static int *events_indexCandidates( EventTrigger_t trigger );
 int events_saveActive( xmlTextWriterPtr writer );
 int events_loadActive( xmlNodePtr parent );
 static int events_parseActive( xmlNodePtr parent );
@@ -194,6 +227,7 @@ static int event_create( int dataid, unsigned int *id )
 
    /* Create the event. */
    ev = &array_grow( &event_active );
+   event_runningDirty = 1;
    memset( ev, 0, sizeof(Event_t) );
    if ((id != NULL) && (*id != 0))
       eid = *id;
@@ -207,6 +241,7 @@ static int event_create( int dataid, unsigned int *id )
 
    /* Open the new state. */
    ev->env = nlua_newEnv();
+   nlua_setEnvName( ev->env, "event/%s", data->name );
    nlua_loadStandard(ev->env);
    nlua_loadEvt(ev->env);
    nlua_loadHook(ev->env);
@@ -276,6 +311,7 @@ void event_remove( unsigned int eventid )
 
          /* Move memory. */
          array_erase( &event_active, &event_active[i], &event_active[i+1] );
+         event_runningDirty = 1;
          return;
       }
    }
@@ -301,14 +337,14 @@ int event_save( unsigned int eventid )
  */
 int event_alreadyRunning( int data )
 {
-   /* Find events. */
-   for (int i=0; i<array_size(event_active); i++) {
-      const Event_t *ev = &event_active[i];
-      if (ev->data == data)
-         return 1;
+   /* Rebuild the bitset if the active events changed. */
+   if (event_runningDirty) {
+      bitset_clear( event_running );
+      for (int i=0; i<array_size(event_active); i++)
+         bitset_set( &event_running, event_active[i].data );
+      event_runningDirty = 0;
    }
-
-   return 0;
+   return bitset_test( event_running, data );
 }
 
 /**
@@ -319,22 +355,24 @@ int event_alreadyRunning( int data )
 void events_trigger( EventTrigger_t trigger )
 {
    int created = 0;
-   for (int i=0; i<array_size(event_data); i++) {
+   int *candidates = events_indexCandidates( trigger );
+   for (int k=0; k<array_size(candidates); k++) {
+      int i = candidates[k];
       EventData *ed = &event_data[i];
 
-      if (naev_isQuit())
+      if (naev_isQuit()) {
+         array_free( candidates );
          return;
-
-      /* Make sure trigger matches. */
-      if (ed->trigger != trigger)
-         continue;
+      }
 
       /* Spob. */
-      if ((trigger==EVENT_TRIGGER_LAND || trigger==EVENT_TRIGGER_LOAD) && (ed->spob != NULL) && (strcmp(ed->spob,land_spob->name)!=0))
+      if ((trigger==EVENT_TRIGGER_LAND || trigger==EVENT_TRIGGER_LOAD) && (ed->spob != NULL) &&
+            ((ed->spobid >= 0) ? (ed->spobid != land_spob->id) : (strcmp(ed->spob,land_spob->name)!=0)))
          continue;
 
       /* System. */
-      if ((ed->system != NULL) && (strcmp(ed->system,cur_system->name)!=0))
+      if ((ed->system != NULL) &&
+            ((ed->sysid >= 0) ? (ed->sysid != cur_system->id) : (strcmp(ed->system,cur_system->name)!=0)))
          continue;
 
       /* Make sure chance is succeeded. */
@@ -404,12 +442,157 @@ void events_trigger( EventTrigger_t trigger )
       event_create( i, NULL );
       created++;
    }
+   array_free( candidates );
 
    /* Run claims if necessary. */
    if (created)
       claim_activateAll();
 }
 
+/**
+ * @brief Compares event index entries by key and then by event.
+ */
+static int event_indexCmp( const void *p1, const void *p2 )
+{
+   const EventIndexEntry *e1 = p1;
+   const EventIndexEntry *e2 = p2;
+   if (e1->key != e2->key)
+      return e1->key - e2->key;
+   return e1->data - e2->data;
+}
+
+/**
+ * @brief Compares event data indices.
+ */
+static int event_idCmp( const void *p1, const void *p2 )
+{
+   return *(const int*)p1 - *(const int*)p2;
+}
+
+/**
+ * @brief Builds the event index, resolving the spob and system names to ids.
+ */
+static void events_indexBuild (void)
+{
+   events_indexFree();
+   for (int i=0; i<=EVENT_TRIGGER_LOAD; i++) {
+      EventIndex *ei = &event_index[i];
+      ei->spob       = array_create( EventIndexEntry );
+      ei->system     = array_create( EventIndexEntry );
+      ei->generic    = array_create( int );
+      ei->unresolved = array_create( int );
+   }
+
+   for (int i=0; i<array_size(event_data); i++) {
+      EventData *ed = &event_data[i];
+      EventIndex *ei;
+      EventIndexEntry e;
+      int usespob;
+
+      /* Resolve names, spobs and systems added by unidiffs are not known yet. */
+      ed->spobid = -1;
+      ed->sysid  = -1;
+      if ((ed->spob != NULL) && spob_exists( ed->spob ))
+         ed->spobid = spob_get( ed->spob )->id;
+      if (ed->system != NULL) {
+         const char *sysname = system_existsCase( ed->system );
+         if ((sysname != NULL) && (strcmp( sysname, ed->system ) == 0))
+            ed->sysid = system_get( sysname )->id;
+      }
+
+      if ((ed->trigger <= EVENT_TRIGGER_NONE) || (ed->trigger > EVENT_TRIGGER_LOAD))
+         continue;
+      ei = &event_index[ ed->trigger ];
+      e.data = i;
+
+      /* Spobs are only checked when landing or loading. */
+      usespob = (ed->trigger != EVENT_TRIGGER_ENTER) && (ed->spob != NULL);
+      if ((usespob && (ed->spobid < 0)) || ((ed->system != NULL) && (ed->sysid < 0)))
+         array_push_back( &ei->unresolved, i );
+      else if (usespob) {
+         e.key = ed->spobid;
+         array_push_back( &ei->spob, e );
+      }
+      else if (ed->system != NULL) {
+         e.key = ed->sysid;
+         array_push_back( &ei->system, e );
+      }
+      else
+         array_push_back( &ei->generic, i );
+   }
+
+   for (int i=0; i<=EVENT_TRIGGER_LOAD; i++) {
+      EventIndex *ei = &event_index[i];
+      qsort( ei->spob, array_size(ei->spob), sizeof(EventIndexEntry), event_indexCmp );
+      qsort( ei->system, array_size(ei->system), sizeof(EventIndexEntry), event_indexCmp );
+   }
+}
+
+/**
+ * @brief Frees the event index.
+ */
+static void events_indexFree (void)
+{
+   for (int i=0; i<=EVENT_TRIGGER_LOAD; i++) {
+      EventIndex *ei = &event_index[i];
+      array_free( ei->spob );
+      array_free( ei->system );
+      array_free( ei->generic );
+      array_free( ei->unresolved );
+      memset( ei, 0, sizeof(EventIndex) );
+   }
+}
+
+/**
+ * @brief Adds the events filed under a key to the candidates.
+ */
+static void events_indexAdd( int **candidates, const EventIndexEntry *entries, int key )
+{
+   /* Find the first entry with the key. */
+   int lo = 0, hi = array_size(entries);
+   while (lo < hi) {
+      int mid = (lo+hi) / 2;
+      if (entries[mid].key < key)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   for (int i=lo; (i<array_size(entries)) && (entries[i].key==key); i++)
+      array_push_back( candidates, entries[i].data );
+}
+
+/**
+ * @brief Gets the events that could be triggered at the current location.
+ *
+ *    @param trigger Trigger to match.
+ *    @return Array (array.h) of indices in event_data in priority order, to be freed.
+ */
+static int *events_indexCandidates( EventTrigger_t trigger )
+{
+   const EventIndex *ei;
+   int *candidates = array_create( int );
+   int n;
+
+   if ((trigger <= EVENT_TRIGGER_NONE) || (trigger > EVENT_TRIGGER_LOAD))
+      return candidates;
+   ei = &event_index[trigger];
+
+   if ((trigger != EVENT_TRIGGER_ENTER) && (land_spob != NULL))
+      events_indexAdd( &candidates, ei->spob, land_spob->id );
+   if (cur_system != NULL)
+      events_indexAdd( &candidates, ei->system, cur_system->id );
+   for (int i=0; i<array_size(ei->generic); i++)
+      array_push_back( &candidates, ei->generic[i] );
+   for (int i=0; i<array_size(ei->unresolved); i++)
+      array_push_back( &candidates, ei->unresolved[i] );
+
+   /* Back to priority order. */
+   n = array_size(candidates);
+   if (n > 1)
+      qsort( candidates, n, sizeof(int), event_idCmp );
+   return candidates;
+}
+
 /**
  * @brief Loads up an event from an XML node.
  *
@@ -505,13 +688,6 @@ static int event_parseXML( EventData *temp, const xmlNodePtr parent )
    /* Process. */
    temp->chance /= 100.;
 
-   /* Compile conditional chunk. */
-   if (temp->cond != NULL) {
-      temp->cond_chunk = cond_compile( temp->cond );
-      if (temp->cond_chunk == LUA_NOREF || temp->cond_chunk == LUA_REFNIL)
-         WARN(_("Event '%s' failed to compile Lua conditional!"), temp->name);
-   }
-
    /* Compile regex for chapter matching. */
    if (temp->chapter != NULL) {
       int errornumber;
@@ -545,6 +721,31 @@ static int event_cmp( const void* a, const void* b )
    return strcmp( ea->name, eb->name );
 }
 
+/**
+ * @brief Data of an event being parsed in the vpool.
+ */
+typedef struct EventThreadData_ {
+   EventData evt;    /**< Event being parsed. */
+   char *filename;   /**< File to parse. */
+   int ret;          /**< Result of parsing. */
+} EventThreadData;
+
+/**
+ * @brief Reads and parses the header of an event, to be run in the vpool.
+ */
+static int event_parseThread( void *ptr )
+{
+   EventThreadData *data = ptr;
+   data->ret = event_readFile( data->filename, &data->evt );
+   /* Render if necessary. */
+   if (naev_shouldRenderLoadscreen()) {
+      gl_contextSet();
+      naev_renderLoadscreen();
+      gl_contextUnset();
+   }
+   return data->ret;
+}
+
 /**
  * @brief Loads all the events.
  *
@@ -556,14 +757,40 @@ int events_load (void)
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
    char **event_files = ndata_listRecursive( EVENT_DATA_PATH );
+   EventThreadData *edata;
+   ThreadQueue *tq;
 
    /* Run over events. */
-   event_data = array_create_size( EventData, array_size( event_files ) );
+   edata = array_create_size( EventThreadData, array_size( event_files ) );
    for (int i=0; i < array_size( event_files ); i++) {
-      event_parseFile( event_files[i], NULL );
-      free( event_files[ i ] );
+      EventThreadData *ed = &array_grow( &edata );
+      ed->filename = event_files[i];
    }
    array_free( event_files );
+
+   /* The faction index is built lazily, make sure the threads only read it. */
+   faction_exists( "" );
+
+   /* Read and parse the headers in parallel, enqueuing after the data array is done. */
+   tq = vpool_create();
+   for (int i=0; i<array_size(edata); i++)
+      vpool_enqueue( tq, event_parseThread, &edata[i] );
+   SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Compile the Lua on the main state in listing order. */
+   event_data = array_create_size( EventData, array_size( edata ) );
+   for (int i=0; i<array_size(edata); i++) {
+      EventThreadData *ed = &edata[i];
+      if (!ed->ret) {
+         event_compile( &ed->evt );
+         array_push_back( &event_data, ed->evt );
+      }
+      free( ed->filename );
+   }
+   array_free( edata );
    array_shrink( &event_data );
 
 #ifdef DEBUGGING
@@ -578,6 +805,9 @@ int events_load (void)
    /* Sort based on priority so higher priority missions can establish claims first. */
    qsort( event_data, array_size(event_data), sizeof(EventData), event_cmp );
 
+   /* Index by trigger and location. */
+   events_indexBuild();
+
 #if DEBUGGING
    if (conf.devmode) {
       time = SDL_GetTicks() - time;
@@ -594,16 +824,32 @@ int events_load (void)
  * @brief Parses an event file.
  *
  *    @param file Source file path.
- *    @param temp Data to load into, or NULL for initial load.
+ *    @param temp Data to load into.
  */
 static int event_parseFile( const char* file, EventData *temp )
+{
+   if (event_readFile( file, temp ))
+      return -1;
+   event_compile( temp );
+   return 0;
+}
+
+/**
+ * @brief Reads an event and parses its XML header.
+ *
+ * Does not touch the Lua state, so it can be run from the vpool.
+ *
+ *    @param file Source file path.
+ *    @param temp Data to load into.
+ *    @return 0 on success.
+ */
+static int event_readFile( const char* file, EventData *temp )
 {
    size_t bufsize;
    xmlNodePtr node;
    xmlDocPtr doc;
    char *filebuf;
    const char *pos, *start_pos;
-   int ret;
 
    /* Load string. */
    filebuf = ndata_read( file, &bufsize );
@@ -623,7 +869,7 @@ static int event_parseFile( const char* file, EventData *temp )
       if ((pos != NULL) && !strncmp(pos,"--common",bufsize))
          WARN(_("Event '%s' has create function but no XML header!"), file);
       free(filebuf);
-      return 0;
+      return -1;
    }
 
    /* Separate XML header and Lua. */
@@ -648,12 +894,33 @@ static int event_parseFile( const char* file, EventData *temp )
       return -1;
    }
 
-   if (temp == NULL)
-      temp = &array_grow(&event_data);
    event_parseXML( temp, node );
    temp->lua = strdup(filebuf);
    temp->sourcefile = strdup(file);
 
+   /* Clean up. */
+   xmlFreeDoc(doc);
+   free(filebuf);
+
+   return 0;
+}
+
+/**
+ * @brief Compiles the Lua of an event, and its conditional, on the main state.
+ *
+ *    @param temp Event to compile.
+ */
+static void event_compile( EventData *temp )
+{
+   int ret;
+
+   /* Compile conditional chunk. */
+   if (temp->cond != NULL) {
+      temp->cond_chunk = cond_compile( temp->cond );
+      if (temp->cond_chunk == LUA_NOREF || temp->cond_chunk == LUA_REFNIL)
+         WARN(_("Event '%s' failed to compile Lua conditional!"), temp->name);
+   }
+
    /* Clear chunk if already loaded. */
    if (temp->chunk != LUA_NOREF) {
       luaL_unref( naevL, LUA_REGISTRYINDEX, temp->chunk );
@@ -663,15 +930,9 @@ static int event_parseFile( const char* file, EventData *temp )
    /* Check to see if syntax is valid. */
    ret = luaL_loadbuffer(naevL, temp->lua, strlen(temp->lua), temp->name );
    if (ret == LUA_ERRSYNTAX)
-      WARN(_("Event Lua '%s' syntax error: %s"), file, lua_tostring(naevL,-1) );
+      WARN(_("Event Lua '%s' syntax error: %s"), temp->sourcefile, lua_tostring(naevL,-1) );
    else
       temp->chunk = luaL_ref( naevL, LUA_REGISTRYINDEX );
-
-   /* Clean up. */
-   xmlFreeDoc(doc);
-   free(filebuf);
-
-   return 0;
 }
 
 /**
@@ -697,9 +958,6 @@ static void event_freeData( EventData *event )
    if (event->chunk != LUA_NOREF)
       luaL_unref( naevL, LUA_REGISTRYINDEX,event->chunk );
 
-   if (event->cond_chunk != LUA_NOREF)
-      luaL_unref( naevL, LUA_REGISTRYINDEX,event->cond_chunk );
-
    for (int i=0; i<array_size(event->tags); i++)
       free(event->tags[i]);
    array_free(event->tags);
@@ -720,6 +978,9 @@ void events_cleanup (void)
       event_cleanup( &event_active[i] );
    array_free(event_active);
    event_active = NULL;
+   array_free(event_running);
+   event_running = NULL;
+   event_runningDirty = 1;
 }
 
 /**
@@ -730,6 +991,7 @@ void events_exit (void)
    events_cleanup();
 
    /* Free data. */
+   events_indexFree();
    for (int i=0; i<array_size(event_data); i++)
       event_freeData( &event_data[i] );
    array_free(event_data);
@@ -944,8 +1206,10 @@ int event_reload( const char *name )
       return -1;
    save = *temp;
    res = event_parseFile( save.sourcefile, temp );
-   if (res == 0)
+   if (res == 0) {
       event_freeData( &save );
+      events_indexBuild(); /* Trigger or location may have changed. */
+   }
    else
       *temp = save;
    return res;
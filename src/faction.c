@@ -20,6 +20,7 @@
 #include "colour.h"
 #include "hook.h"
 #include "log.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nluadef.h"
@@ -103,8 +104,16 @@ typedef struct Faction_ {
 } Faction;
 
 static Faction* faction_stack = NULL; /**< Faction stack. */
-static int* faction_grid = NULL; /**< Grid of faction status. */
-static size_t faction_mgrid = 0; /**< Allocated memory. */
+static NameIndex faction_index; /**< Index of factions by name. */
+static int faction_indexValid = 0; /**< Whether or not faction_index matches faction_stack. */
+static uint64_t *faction_gridEnemy = NULL; /**< Packed rows of enemy bits, one row per faction. */
+static uint64_t *faction_gridAlly = NULL; /**< Packed rows of ally bits, one row per faction. */
+static size_t faction_mgrid = 0; /**< Factions the grid is allocated for. */
+static size_t faction_wgrid = 0; /**< 64 bit words per grid row. */
+static int faction_gridPlayerDirty = 1; /**< Player standings changed since they were folded into the grid. */
+
+#define FACTION_GRID_WORD(a,b)   ((size_t)(a)*faction_wgrid + ((size_t)(b)>>6)) /**< Word of b in the row of a. */
+#define FACTION_GRID_BIT(b)      ((uint64_t)1 << ((b)&63)) /**< Bit of b in its word. */
 
 /*
  * Prototypes
@@ -118,6 +127,8 @@ static int faction_parse( Faction* temp, const char *file );
 static int faction_parseSocial( const char *file );
 static void faction_addStandingScript( Faction* temp, const char* scriptname );
 static void faction_computeGrid (void);
+static void faction_gridSet( int a, int b, int enemy, int ally );
+static void faction_gridPlayer (void);
 /* externed */
 int pfaction_save( xmlTextWriterPtr writer );
 int pfaction_load( xmlNodePtr parent );
@@ -145,23 +156,15 @@ static int faction_getRaw( const char* name )
    if (strcmp(name, "Escort") == 0)
       return FACTION_PLAYER;
 
-   if (name != NULL) {
-      int i;
-      for (i=0; i<array_size(faction_stack); i++)
-         if (strcmp(faction_stack[i].name, name)==0)
-            break;
-
-      if (i != array_size(faction_stack))
-         return i;
-
-      /* Dynamic factions are why we can't have nice things.
-      const Faction f = { .name = (char*)name };
-      Faction *found = bsearch( &f, faction_stack, array_size(faction_stack), sizeof(Faction), faction_cmp );
-      if (found != NULL)
-         return found - faction_stack;
-      */
+   /* Dynamic factions are added and removed at any time, so rebuild lazily. */
+   if (!faction_indexValid) {
+      nameindex_clear( &faction_index );
+      nameindex_reserve( &faction_index, array_size(faction_stack) );
+      for (int i=0; i<array_size(faction_stack); i++)
+         nameindex_add( &faction_index, faction_stack[i].name, i );
+      faction_indexValid = 1;
    }
-   return -1;
+   return nameindex_get( &faction_index, name );
 }
 
 /**
@@ -754,6 +757,7 @@ nlua_env faction_getEquipper( int f )
 static void faction_sanitizePlayer( Faction* faction )
 {
    faction->player = CLAMP( -100., 100., faction->player );
+   faction_gridPlayerDirty = 1;
 }
 
 /**
@@ -954,6 +958,7 @@ void faction_setPlayer( int f, double value )
    faction = &faction_stack[f];
    mod = value - faction->player;
    faction->player = value;
+   faction_gridPlayerDirty = 1;
    /* Run hook if necessary. */
    if (!faction_isFlag(faction, FACTION_DYNAMIC)) {
       HookParam hparam[3];
@@ -1226,21 +1231,16 @@ double faction_reputationMax( int f )
  */
 int areEnemies( int a, int b )
 {
-   /* luckily our factions aren't masochistic */
-   if (a==b)
-      return 0;
-
    /* Make sure they're valid. */
-   if (!faction_isFaction(a) || !faction_isFaction(b))
+   if (((unsigned int)a >= faction_mgrid) || ((unsigned int)b >= faction_mgrid))
       return 0;
 
-   /* player handled separately */
-   if (a==FACTION_PLAYER)
-      return faction_isPlayerEnemy(b);
-   else if (b==FACTION_PLAYER)
-      return faction_isPlayerEnemy(a);
+   /* Player standings are folded in lazily. */
+   if (faction_gridPlayerDirty)
+      faction_gridPlayer();
 
-   return faction_grid[ a * faction_mgrid + b ] < 0;
+   /* luckily our factions aren't masochistic, the diagonal is never set */
+   return !!(faction_gridEnemy[ FACTION_GRID_WORD(a,b) ] & FACTION_GRID_BIT(b));
 }
 
 /**
@@ -1256,16 +1256,49 @@ int areAllies( int a, int b )
    if (a==b) return 1;
 
    /* Make sure they're valid. */
-   if (!faction_isFaction(a) || !faction_isFaction(b))
+   if (((unsigned int)a >= faction_mgrid) || ((unsigned int)b >= faction_mgrid))
       return 0;
 
-   /* we assume player becomes allies with high rating */
-   if (a==FACTION_PLAYER)
-      return faction_isPlayerFriend(b);
-   else if (b==FACTION_PLAYER)
-      return faction_isPlayerFriend(a);
+   /* we assume player becomes allies with high rating, folded in lazily */
+   if (faction_gridPlayerDirty)
+      faction_gridPlayer();
+
+   return !!(faction_gridAlly[ FACTION_GRID_WORD(a,b) ] & FACTION_GRID_BIT(b));
+}
+
+/**
+ * @brief Classifies many factions against a single one at once.
+ *
+ * Equivalent to calling areAllies and areEnemies on each of them, but the
+ *  row of the faction is only fetched once.
+ *
+ *    @param f Faction to compare against.
+ *    @param factions Factions to classify.
+ *    @param n Number of factions.
+ *    @param[out] out Set to 1 for allies, -1 for enemies and 0 otherwise.
+ */
+void faction_classify( int f, const int *factions, int n, int *out )
+{
+   const uint64_t *enemy, *ally;
 
-   return faction_grid[ a * faction_mgrid + b ] > 0;
+   if ((unsigned int)f >= faction_mgrid) {
+      for (int i=0; i<n; i++)
+         out[i] = 0;
+      return;
+   }
+   if (faction_gridPlayerDirty)
+      faction_gridPlayer();
+
+   enemy = &faction_gridEnemy[ FACTION_GRID_WORD(f,0) ];
+   ally  = &faction_gridAlly[ FACTION_GRID_WORD(f,0) ];
+   for (int i=0; i<n; i++) {
+      unsigned int b = factions[i];
+      if (b >= faction_mgrid) {
+         out[i] = 0;
+         continue;
+      }
+      out[i] = (int)((ally[b>>6] >> (b&63)) & 1) - (int)((enemy[b>>6] >> (b&63)) & 1);
+   }
 }
 
 /**
@@ -1600,6 +1633,7 @@ void factions_reset (void)
       faction_stack[i].player = faction_stack[i].player_def;
       faction_stack[i].flags = faction_stack[i].oflags;
    }
+   faction_gridPlayerDirty = 1;
 }
 
 /**
@@ -1639,6 +1673,7 @@ int factions_load (void)
          if (ret == 0) {
             nf.oflags = nf.flags;
             array_push_back( &faction_stack, nf );
+            faction_indexValid = 0;
          }
 
          /* Render if necessary. */
@@ -1648,6 +1683,7 @@ int factions_load (void)
 
    /* Sort by name. */
    qsort( faction_stack, array_size(faction_stack), sizeof(Faction), faction_cmp );
+   faction_indexValid = 0;
    faction_player = faction_get("Player");
 
    /* Second pass - sets allies and enemies */
@@ -1744,11 +1780,16 @@ void factions_free (void)
       faction_freeOne( &faction_stack[i] );
    array_free(faction_stack);
    faction_stack = NULL;
+   nameindex_free( &faction_index );
+   faction_indexValid = 0;
 
    /* Clean up faction grid. */
-   free( faction_grid );
-   faction_grid = NULL;
+   free( faction_gridEnemy );
+   free( faction_gridAlly );
+   faction_gridEnemy = NULL;
+   faction_gridAlly = NULL;
    faction_mgrid = 0;
+   faction_wgrid = 0;
 }
 
 /**
@@ -1823,6 +1864,7 @@ int pfaction_load( xmlNodePtr parent )
          } while (xml_nextNode(cur));
       }
    } while (xml_nextNode(node));
+   faction_gridPlayerDirty = 1;
 
    return 0;
 }
@@ -1900,6 +1942,7 @@ void factions_clearDynamic (void)
          i--;
       }
    }
+   faction_indexValid = 0;
    faction_computeGrid();
 }
 
@@ -1916,6 +1959,7 @@ int faction_dynAdd( int base, const char* name, const char* display, const char*
 {
    Faction *f = &array_grow( &faction_stack );
    memset( f, 0, sizeof(Faction) );
+   faction_indexValid = 0;
    f->name        = strdup( name );
    f->displayname = (display==NULL) ? NULL : strdup( display );
    f->ai          = (ai==NULL) ? NULL : strdup( ai );
@@ -1961,38 +2005,82 @@ int faction_dynAdd( int base, const char* name, const char* display, const char*
    return f-faction_stack;
 }
 
+/**
+ * @brief Sets the relationship of a pair of factions in the grid.
+ */
+static void faction_gridSet( int a, int b, int enemy, int ally )
+{
+   size_t w = FACTION_GRID_WORD(a,b);
+   uint64_t bit = FACTION_GRID_BIT(b);
+   faction_gridEnemy[w] = enemy ? (faction_gridEnemy[w] | bit) : (faction_gridEnemy[w] & ~bit);
+   faction_gridAlly[w]  = ally  ? (faction_gridAlly[w]  | bit) : (faction_gridAlly[w]  & ~bit);
+}
+
+/**
+ * @brief Folds the player's standings into the relationship grid.
+ */
+static void faction_gridPlayer (void)
+{
+   faction_gridPlayerDirty = 0;
+   if (!faction_isFaction( FACTION_PLAYER ) || ((size_t)FACTION_PLAYER >= faction_mgrid))
+      return;
+   for (int i=0; i<array_size(faction_stack); i++) {
+      int enemy, ally;
+      if (i == FACTION_PLAYER)
+         continue;
+      enemy = faction_isPlayerEnemy( i );
+      ally  = faction_isPlayerFriend( i );
+      faction_gridSet( FACTION_PLAYER, i, enemy, ally );
+      faction_gridSet( i, FACTION_PLAYER, enemy, ally );
+   }
+}
+
 /**
  * @brief Computes the faction relationship grid.
+ *
+ * Rows are bit sets so lookups are a single test, and the player's standings
+ *  are folded in by faction_gridPlayer when they change.
  */
 static void faction_computeGrid (void)
 {
    size_t n = array_size(faction_stack);
    if (faction_mgrid < n) {
-      free( faction_grid );
-      faction_grid = malloc( n * n * sizeof(int) );
+      free( faction_gridEnemy );
+      free( faction_gridAlly );
+      faction_wgrid = (n+63) / 64;
+      faction_gridEnemy = malloc( n * faction_wgrid * sizeof(uint64_t) );
+      faction_gridAlly  = malloc( n * faction_wgrid * sizeof(uint64_t) );
       faction_mgrid = n;
    }
    n = faction_mgrid;
-   memset( faction_grid, 0, n*n*sizeof(int) );
+   memset( faction_gridEnemy, 0, n*faction_wgrid*sizeof(uint64_t) );
+   memset( faction_gridAlly, 0, n*faction_wgrid*sizeof(uint64_t) );
    for (int i=0; i<array_size(faction_stack); i++) {
       Faction *fa = &faction_stack[i];
       for (int k=0; k<array_size(fa->allies); k++) {
          int j = fa->allies[k];
 #if DEBUGGING
-         if ((faction_grid[i*n+j] < 0) || (faction_grid[j*n+i]) < 0)
+         if ((faction_gridEnemy[FACTION_GRID_WORD(i,j)] & FACTION_GRID_BIT(j)) ||
+               (faction_gridEnemy[FACTION_GRID_WORD(j,i)] & FACTION_GRID_BIT(i)))
             WARN("Incoherent faction grid! '%s' and '%s' are already enemies, but trying to set to allies!", faction_stack[i].name, faction_stack[j].name );
 #endif /* DEBUGGING */
-         faction_grid[i*n+j] = 1;
-         faction_grid[j*n+i] = 1;
+         faction_gridSet( i, j, 0, 1 );
+         faction_gridSet( j, i, 0, 1 );
       }
       for (int k=0; k<array_size(fa->enemies); k++) {
          int j = fa->enemies[k];
 #if DEBUGGING
-         if ((faction_grid[i*n+j] > 0) || (faction_grid[j*n+i] > 0))
+         if ((faction_gridAlly[FACTION_GRID_WORD(i,j)] & FACTION_GRID_BIT(j)) ||
+               (faction_gridAlly[FACTION_GRID_WORD(j,i)] & FACTION_GRID_BIT(i)))
             WARN("Incoherent faction grid! '%s' and '%s' are already allies, but trying to set to enemies!", faction_stack[i].name, faction_stack[j].name );
 #endif /* DEBUGGING */
-         faction_grid[i*n+j] = -1;
-         faction_grid[j*n+i] = -1;
+         faction_gridSet( i, j, 1, 0 );
+         faction_gridSet( j, i, 1, 0 );
       }
    }
+
+   /* A faction is always its own ally, and never its own enemy. */
+   for (int i=0; i<array_size(faction_stack); i++)
+      faction_gridSet( i, i, 0, 1 );
+   faction_gridPlayerDirty = 1;
 }
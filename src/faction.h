@@ -76,6 +76,7 @@ char faction_getColourChar( int f );
 /* Works with only factions */
 int areEnemies( int a, int b );
 int areAllies( int a, int b );
+void faction_classify( int f, const int *factions, int n, int *out );
 
 /* load/free */
 int factions_load (void);
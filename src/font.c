@@ -16,6 +16,7 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 #include FT_MODULE_H
+#include <stdatomic.h>
 #include <wctype.h>
 #include "linebreak.h"
 #include "linebreakdef.h"
@@ -29,8 +30,11 @@
 #include "conf.h"
 #include "distance_field.h"
 #include "log.h"
+#include "md5.h"
+#include "memstats.h"
 #include "ndata.h"
 #include "nfile.h"
+#include "threadpool.h"
 #include "utf8.h"
 #include "ntracing.h"
 
@@ -39,6 +43,10 @@
 #define HASH_LUT_SIZE 512 /**< Size of glyph look up table. */
 #define DEFAULT_TEXTURE_SIZE 1024 /**< Default size of texture caches for glyphs. */
 #define MAX_ROWS 64 /**< Max number of rows per texture cache. */
+#define FONT_RUN_CACHE_SIZE   256 /**< Number of laid out text runs to cache (power of 2). */
+#define FONT_WIDTH_CACHE_SIZE 512 /**< Number of text widths to cache (power of 2). */
+#define FONT_RUN_STRIDE       4 /**< Floats per text run vertex: position and texture coordinates. */
+#define FONT_ASYNC_MIN        0x80 /**< Codepoints below this are always generated immediately. */
 
 /**
  * OpenGL rendering stuff. Since we can't actually render with multiple threads
@@ -76,6 +84,7 @@ typedef struct glFontGlyph_s {
    int ft_index; /**< HACK: Index into the array of fallback fonts. */
    int tex_index; /**< Might be on different texture. */
    GLushort vbo_id; /**< VBO index to use. */
+   int ready; /**< Whether or not the distance field is uploaded, only metrics are valid otherwise. */
    int next; /**< Stored as a linked list. */
 } glFontGlyph;
 
@@ -85,6 +94,7 @@ typedef struct glFontGlyph_s {
 typedef struct font_char_s {
    GLubyte *data; /**< Data of the character. */
    GLfloat *dataf; /**< Float data of the character. */
+   GLubyte *buffer; /**< Bordered bitmap still needing the distance field computed. */
    int w; /**< Width. */
    int h; /**< Height. */
    int ft_index; /**< HACK: Index into the array of fallback fonts. */
@@ -106,6 +116,7 @@ typedef struct glFontFile_s {
    int refcount; /**< Reference counting. */
    FT_Byte *data; /**< Font data buffer. */
    size_t datasize; /**< Font data size. */
+   char digest[33]; /**< MD5 of the font data, identifies it in the glyph cache. */
 } glFontFile;
 
 /**
@@ -145,6 +156,86 @@ typedef struct glFontStash_s {
    int refcount; /**< Reference counting. */
 } glFontStash;
 
+/**
+ * @brief Colour state at the start of a text run segment.
+ */
+enum {
+   FONT_RUN_COL_START,     /**< Colour the render was started with. */
+   FONT_RUN_COL_BASE,      /**< Colour passed to the print function (or white). */
+   FONT_RUN_COL_EXPLICIT,  /**< Colour set by an escape code. */
+};
+
+/**
+ * @brief Layout modes of a text run, determine how the parameters are used.
+ */
+enum {
+   FONT_RUN_MAX,  /**< Single line limited to a width. */
+   FONT_RUN_TEXT, /**< Block of text broken into lines. */
+};
+
+/**
+ * @brief Contiguous glyphs of a text run that can be drawn with a single call.
+ */
+typedef struct glFontRunSeg_s {
+   GLuint tex; /**< Glyph texture. */
+   GLfloat m; /**< Distance units per pixel. */
+   int colmode; /**< How to set the colour, see FONT_RUN_COL_*. */
+   const glColour *col; /**< Colour when FONT_RUN_COL_EXPLICIT. */
+   GLint first; /**< First vertex. */
+   GLsizei count; /**< Number of vertices. */
+} glFontRunSeg;
+
+/**
+ * @brief Laid out text with vertex-ready glyph quads.
+ *
+ * Runs do not depend on position nor colour, so static text only has to be
+ * laid out once and then costs one draw per segment.
+ */
+typedef struct glFontRun_s {
+   /* Key. */
+   char *text; /**< Text that was laid out (NULL if slot is empty). */
+   uint32_t hash; /**< Hash of the key. */
+   int id; /**< Font stash id. */
+   int mode; /**< Layout mode, see FONT_RUN_*. */
+   int p[3]; /**< Layout parameters. */
+   /* Results. */
+   size_t ret; /**< Number of bytes that were laid out. */
+   int width; /**< Width of the laid out text. */
+   int pending; /**< Whether or not some glyphs were still being generated. */
+   int lastcol_set; /**< Whether or not the text changed the colour. */
+   const glColour *lastcol; /**< Last colour set by the text. */
+   glFontRunSeg *segs; /**< Segments to draw. */
+   gl_vbo *vbo; /**< Vertices. */
+   GLsizei vbo_size; /**< Size of the vertex buffer. */
+} glFontRun;
+static glFontRun font_runs[FONT_RUN_CACHE_SIZE]; /**< Text run cache. */
+static GLfloat *font_run_data = NULL; /**< Vertex data used when building runs. */
+
+/**
+ * @brief Cached text width.
+ */
+typedef struct glFontWidth_s {
+   char *text; /**< Text (NULL if slot is empty). */
+   uint32_t hash; /**< Hash of the key. */
+   int id; /**< Font stash id. */
+   int width; /**< Width of the text. */
+} glFontWidth;
+static glFontWidth font_widths[FONT_WIDTH_CACHE_SIZE]; /**< Text width cache. */
+
+/**
+ * @brief Distance field of a glyph being generated in the background.
+ */
+typedef struct glFontJob_s {
+   int id; /**< Font stash id. */
+   int glyph; /**< Index of the glyph in the stash. */
+   int h; /**< Font height. */
+   font_char_t ch; /**< Character being generated. */
+   char *cachefile; /**< Where to store the result on disk, or NULL. */
+   atomic_int done; /**< Set by the job when finished. */
+} glFontJob;
+static glFontJob **font_jobs = NULL; /**< Pending glyph jobs. */
+static JobCounter *font_job_counter = NULL; /**< Counter for all the glyph jobs. */
+
 /**
  * Available fonts stashes.
  */
@@ -175,12 +266,25 @@ static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch );
  */
 static void gl_fontRenderStart( const glFontStash *stsh, double x, double y, const glColour *c, double outlineR );
 static void gl_fontRenderStartH( const glFontStash* stsh, const mat4 *H, const glColour *c, double outlineR );
-static int gl_fontRenderGlyph( glFontStash *stsh, uint32_t ch, const glColour *c, int state );
 static void gl_fontRenderEnd (void);
 /* Fussy layout concerns. */
 static void gl_fontKernStart (void);
 static int gl_fontKernGlyph( glFontStash* stsh, uint32_t ch, glFontGlyph* glyph );
 static void gl_fontstashftDestroy( glFontStashFreetype *ft );
+/* Text run cache. */
+static uint32_t font_runHash( int id, int mode, const int p[3], const char *text );
+static const glFontRun* font_runGet( const glFont *ft_font, int mode, int p0, int p1, int p2, const char *text );
+static void font_runLine( glFontRun *run, glFontStash *stsh, const char *text, size_t begin, size_t end, GLfloat y, int *state, int *colmode, const glColour **col );
+static void font_runRender( const glFontRun *run, const glColour *c );
+static void font_runFlush( int id );
+/* Glyph generation. */
+static void font_makeDistance( font_char_t *c, int h );
+static void font_md5( char digest[33], const void *data, size_t len );
+static char* font_glyphCachePath( const glFontStash *stsh, const font_char_t *c, uint32_t ch );
+static int font_glyphCacheLoad( font_char_t *c, int h, const char *path );
+static void font_glyphCacheSave( const font_char_t *c, const char *path );
+static int font_glyphJob( void *data );
+static void font_jobsProcess( int wait );
 
 /**
  * @brief Gets the font stash corresponding to a font.
@@ -268,6 +372,7 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch, glFontGlyph *
       /* Initialize size. */
       glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, stsh->tw, stsh->th, 0,
             GL_RED, GL_UNSIGNED_BYTE, NULL );
+      memstats_add( MEMTAG_FONTS, (int64_t)stsh->tw * stsh->th );
 
       /* Check for errors. */
       gl_checkErr();
@@ -603,6 +708,267 @@ static uint32_t font_nextChar( const char *s, size_t *i )
    return 0;
 }
 
+/**
+ * @brief Hashes the key of a text run or width (FNV-1a).
+ */
+static uint32_t font_runHash( int id, int mode, const int p[3], const char *text )
+{
+   uint32_t h = 2166136261u;
+   h = (h ^ (uint32_t)id) * 16777619u;
+   h = (h ^ (uint32_t)mode) * 16777619u;
+   for (int i=0; i<3; i++)
+      h = (h ^ (uint32_t)p[i]) * 16777619u;
+   for (const char *c=text; *c!='\0'; c++)
+      h = (h ^ (uint8_t)*c) * 16777619u;
+   return h;
+}
+
+/**
+ * @brief Lays out a single line of text into a run.
+ *
+ *    @param run Run to add the glyphs to.
+ *    @param stsh Font stash to use.
+ *    @param text Text being laid out.
+ *    @param begin First byte of the line.
+ *    @param end Byte after the line.
+ *    @param y Vertical offset of the line in distance field units.
+ *    @param[in,out] state Escape sequence state (1 after FONT_COLOUR_CODE).
+ *    @param[in,out] colmode Current colour mode.
+ *    @param[in,out] col Current explicit colour.
+ */
+static void font_runLine( glFontRun *run, glFontStash *stsh, const char *text, size_t begin, size_t end, GLfloat y, int *state, int *colmode, const glColour **col )
+{
+   static const int quad[6] = { 0, 1, 2, 1, 3, 2 };
+   double scale = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
+   GLfloat x = 0.;
+
+   gl_fontKernStart();
+   for (size_t i=begin; i<end; ) {
+      glFontGlyph *glyph;
+      glFontRunSeg *seg;
+      GLuint tex;
+      GLfloat *v;
+      int n;
+      uint32_t ch = u8_nextchar( text, &i );
+      if (ch == 0)
+         break;
+
+      /* Handle escape sequences. */
+      if ((ch == FONT_COLOUR_CODE) && (*state==0)) {
+         *state = 1;
+         continue;
+      }
+      if ((*state == 1) && (ch != FONT_COLOUR_CODE)) {
+         *col = gl_fontGetColour( ch );
+         *colmode = (*col != NULL) ? FONT_RUN_COL_EXPLICIT : FONT_RUN_COL_BASE;
+         run->lastcol_set = 1;
+         run->lastcol = *col;
+         *state = 0;
+         continue;
+      }
+
+      glyph = gl_fontGetGlyph( stsh, ch );
+      if (glyph == NULL) {
+         WARN(_("Unable to find glyph '%d'!"), ch );
+         *state = -1;
+         continue;
+      }
+      *state = 0;
+      x += gl_fontKernGlyph( stsh, ch, glyph ) / scale;
+
+      /* Still being generated, leave the space empty. */
+      if (!glyph->ready) {
+         run->pending = 1;
+         x += glyph->adv_x / scale;
+         continue;
+      }
+
+      /* See if we need a new segment. */
+      tex = stsh->tex[glyph->tex_index].id;
+      n = array_size(font_run_data) / FONT_RUN_STRIDE;
+      seg = (array_size(run->segs) > 0) ? &array_back(run->segs) : NULL;
+      if ((seg == NULL) || (seg->tex != tex) || (seg->m != glyph->m) ||
+            (seg->colmode != *colmode) || (seg->col != *col)) {
+         seg = &array_grow( &run->segs );
+         seg->tex = tex;
+         seg->m   = glyph->m;
+         seg->colmode = *colmode;
+         seg->col = *col;
+         seg->first = n;
+         seg->count = 0;
+      }
+
+      /* Two triangles from the triangle strip stored in the stash. */
+      array_resize( &font_run_data, (n+6)*FONT_RUN_STRIDE );
+      v = &font_run_data[ n*FONT_RUN_STRIDE ];
+      for (int j=0; j<6; j++) {
+         int k = 2*glyph->vbo_id + 2*quad[j];
+         v[0] = stsh->vbo_vert_data[k+0] + x;
+         v[1] = stsh->vbo_vert_data[k+1] + y;
+         v[2] = stsh->vbo_tex_data[k+0];
+         v[3] = stsh->vbo_tex_data[k+1];
+         v += FONT_RUN_STRIDE;
+      }
+      seg->count += 6;
+
+      x += glyph->adv_x / scale;
+   }
+}
+
+/**
+ * @brief Gets a laid out text run, laying it out if not cached.
+ *
+ *    @param ft_font Font to use.
+ *    @param mode Layout mode (FONT_RUN_*).
+ *    @param p0 Maximum width.
+ *    @param p1 Maximum height (FONT_RUN_TEXT only).
+ *    @param p2 Line height (FONT_RUN_TEXT only).
+ *    @param text Text to lay out.
+ *    @return The text run.
+ */
+static const glFontRun* font_runGet( const glFont *ft_font, int mode, int p0, int p1, int p2, const char *text )
+{
+   glFontStash *stsh = gl_fontGetStash( ft_font );
+   const int p[3] = { p0, p1, p2 };
+   uint32_t h = font_runHash( ft_font->id, mode, p, text );
+   glFontRun *run = &font_runs[ h & (FONT_RUN_CACHE_SIZE-1) ];
+   int state, colmode;
+   const glColour *col;
+   GLsizei size;
+
+   /* Cache hit. */
+   if ((run->text != NULL) && (run->hash == h) && (run->id == ft_font->id) &&
+         (run->mode == mode) && (memcmp( run->p, p, sizeof(p) )==0) &&
+         (strcmp( run->text, text )==0))
+      return run;
+
+   /* Reuse the slot. */
+   free( run->text );
+   run->text = strdup( text );
+   run->hash = h;
+   run->id   = ft_font->id;
+   run->mode = mode;
+   memcpy( run->p, p, sizeof(p) );
+   run->pending = 0;
+   run->lastcol_set = 0;
+   run->lastcol = NULL;
+   if (run->segs == NULL)
+      run->segs = array_create( glFontRunSeg );
+   array_resize( &run->segs, 0 );
+   if (font_run_data == NULL)
+      font_run_data = array_create( GLfloat );
+   array_resize( &font_run_data, 0 );
+
+   state   = 0;
+   colmode = FONT_RUN_COL_START;
+   col     = NULL;
+   if (mode == FONT_RUN_TEXT) {
+      glPrintLineIterator iter;
+      double scale = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
+      double y = p1 - (double)ft_font->h; /* y is top left corner */
+      int line_height = (p2==0) ? 1.5*(double)ft_font->h : p2;
+      gl_printLineIteratorInit( &iter, ft_font, text, p0 );
+      while ((y > -1e-5) && gl_printLineIteratorNext( &iter )) {
+         font_runLine( run, stsh, text, iter.l_begin, iter.l_end, y/scale, &state, &colmode, &col );
+         y -= line_height;
+      }
+      run->ret = strlen( text );
+      run->width = p0;
+   }
+   else {
+      run->ret = font_limitSize( stsh, &run->width, text, p0 );
+      font_runLine( run, stsh, text, 0, run->ret, 0., &state, &colmode, &col );
+   }
+
+   /* Upload the vertices. */
+   size = sizeof(GLfloat) * array_size(font_run_data);
+   if (size > 0) {
+      if (run->vbo == NULL) {
+         run->vbo = gl_vboCreateStatic( size, font_run_data );
+         run->vbo_size = size;
+      }
+      else if (size > run->vbo_size) {
+         gl_vboData( run->vbo, size, font_run_data );
+         run->vbo_size = size;
+      }
+      else
+         gl_vboSubData( run->vbo, 0, size, font_run_data );
+   }
+
+   return run;
+}
+
+/**
+ * @brief Draws a text run, must be between gl_fontRenderStart and gl_fontRenderEnd.
+ *
+ *    @param run Run to draw.
+ *    @param c Colour the text is being printed with.
+ */
+static void font_runRender( const glFontRun *run, const glColour *c )
+{
+   const GLsizei stride = sizeof(GLfloat) * FONT_RUN_STRIDE;
+   double a = (c==NULL) ? 1. : c->a;
+   GLuint tex = 0;
+
+   if (array_size(run->segs) > 0) {
+      gl_vboActivateAttribOffset( run->vbo, shaders.font.vertex, 0, 2, GL_FLOAT, stride );
+      gl_vboActivateAttribOffset( run->vbo, shaders.font.tex_coord, sizeof(GLfloat)*2, 2, GL_FLOAT, stride );
+      gl_uniformMat4( shaders.font.projection, &font_projection_mat );
+   }
+
+   for (int i=0; i<array_size(run->segs); i++) {
+      const glFontRunSeg *seg = &run->segs[i];
+
+      /* Start colour is already set by gl_fontRenderStart. */
+      if (seg->colmode == FONT_RUN_COL_EXPLICIT)
+         gl_uniformAColour( shaders.font.colour, seg->col, a );
+      else if (seg->colmode == FONT_RUN_COL_BASE)
+         gl_uniformColour( shaders.font.colour, (c==NULL) ? &cWhite : c );
+
+      if (seg->tex != tex) {
+         tex = seg->tex;
+         glBindTexture( GL_TEXTURE_2D, tex );
+      }
+      glUniform1f( shaders.font.m, seg->m );
+      gl_drawArrays( GL_TRIANGLES, seg->first, seg->count );
+   }
+
+   if (run->lastcol_set)
+      font_lastCol = run->lastcol;
+}
+
+/**
+ * @brief Empties the text run and width caches.
+ *
+ *    @param id Font stash id to flush, or -1 for all.
+ */
+static void font_runFlush( int id )
+{
+   for (int i=0; i<FONT_RUN_CACHE_SIZE; i++) {
+      glFontRun *run = &font_runs[i];
+      if ((id >= 0) && (run->id != id))
+         continue;
+      free( run->text );
+      run->text = NULL;
+      if (id < 0) {
+         array_free( run->segs );
+         gl_vboDestroy( run->vbo );
+         memset( run, 0, sizeof(glFontRun) );
+      }
+   }
+   for (int i=0; i<FONT_WIDTH_CACHE_SIZE; i++) {
+      glFontWidth *w = &font_widths[i];
+      if ((id >= 0) && (w->id != id))
+         continue;
+      free( w->text );
+      w->text = NULL;
+   }
+   if (id < 0) {
+      array_free( font_run_data );
+      font_run_data = NULL;
+   }
+}
+
 /**
  * @brief Prints text on screen.
  *
@@ -618,21 +984,17 @@ static uint32_t font_nextChar( const char *s, size_t *i )
 void gl_printRaw( const glFont *ft_font, double x, double y, const glColour* c,
       double outlineR, const char *text )
 {
-   int s;
-   size_t i;
-   uint32_t ch;
+   const glFontRun *run;
    NTracingZone( _ctx, 1 );
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
+   run = font_runGet( ft_font, FONT_RUN_MAX, INT_MAX, 0, 0, text );
 
    /* Render it. */
-   s = 0;
-   i = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
-   while ((ch = u8_nextchar( text, &i )))
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
+   font_runRender( run, c );
    gl_fontRenderEnd();
 
    NTracingZoneEnd( _ctx );
@@ -652,21 +1014,17 @@ void gl_printRaw( const glFont *ft_font, double x, double y, const glColour* c,
 void gl_printRawH( const glFont *ft_font, const mat4 *H,
       const glColour* c, const double outlineR , const char *text )
 {
-   int s;
-   size_t i;
-   uint32_t ch;
+   const glFontRun *run;
    NTracingZone( _ctx, 1 );
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
+   run = font_runGet( ft_font, FONT_RUN_MAX, INT_MAX, 0, 0, text );
 
    /* Render it. */
-   s = 0;
-   i = 0;
    gl_fontRenderStartH( stsh, H, c, outlineR );
-   while ((ch = u8_nextchar( text, &i )))
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
+   font_runRender( run, c );
    gl_fontRenderEnd();
 
    NTracingZoneEnd( _ctx);
@@ -728,9 +1086,7 @@ void gl_print( const glFont *ft_font,
 int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
       const glColour* c, double outlineR, const char *text)
 {
-   int s;
-   size_t ret, i;
-   uint32_t ch;
+   const glFontRun *run;
    NTracingZone( _ctx, 1 );
 
    if (ft_font == NULL)
@@ -738,18 +1094,15 @@ int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
    /* Limit size. */
-   ret = font_limitSize( stsh, NULL, text, max );
+   run = font_runGet( ft_font, FONT_RUN_MAX, max, 0, 0, text );
 
    /* Render it. */
-   s = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
-   i = 0;
-   while ((ch = u8_nextchar( text, &i )) && (i <= ret))
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
+   font_runRender( run, c );
    gl_fontRenderEnd();
 
    NTracingZoneEnd( _ctx );
-   return ret;
+   return run->ret;
 }
 
 /**
@@ -802,9 +1155,7 @@ int gl_printMidRaw(
       const char *text
       )
 {
-   int n, s;
-   size_t ret, i;
-   uint32_t ch;
+   const glFontRun *run;
    NTracingZone( _ctx, 1 );
 
    if (ft_font == NULL)
@@ -812,20 +1163,16 @@ int gl_printMidRaw(
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
    /* limit size */
-   n = 0;
-   ret = font_limitSize( stsh, &n, text, width );
-   x += (double)(width - n)/2.;
+   run = font_runGet( ft_font, FONT_RUN_MAX, width, 0, 0, text );
+   x += (double)(width - run->width)/2.;
 
    /* Render it. */
-   s = 0;
    gl_fontRenderStart( stsh, x, y, c, outlineR );
-   i = 0;
-   while ((ch = u8_nextchar( text, &i )) && (i <= ret))
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
+   font_runRender( run, c );
    gl_fontRenderEnd();
 
    NTracingZoneEnd( _ctx );
-   return ret;
+   return run->ret;
 }
 
 /**
@@ -882,42 +1229,24 @@ int gl_printTextRaw( const glFont *ft_font,
       const char *text
     )
 {
-   glPrintLineIterator iter;
-   int s;
-   double x,y;
-   uint32_t ch;
+   const glFontRun *run;
    NTracingZone( _ctx, 1 );
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
-   x = bx;
-   y = by + height - (double)ft_font->h; /* y is top left corner */
-
-   /* Default to 1.5 line height. */
-   if (line_height == 0)
-      line_height = 1.5*(double)ft_font->h;
+   /* Lines are laid out relative to the bottom left corner, with colours
+    * carrying over from one line to the next. */
+   run = font_runGet( ft_font, FONT_RUN_TEXT, width, height, line_height, text );
 
    /* Clears restoration. */
    gl_printRestoreClear();
 
-   s = 0;
-   gl_printLineIteratorInit( &iter, ft_font, text, width );
-   while ((y - by > -1e-5) && gl_printLineIteratorNext( &iter )) {
-      /* Must restore stuff. */
-      gl_printRestoreLast();
-
-      /* Render it. */
-      gl_fontRenderStart( stsh, x, y, c, outlineR );
-      for (size_t i = iter.l_begin; i < iter.l_end; ) {
-         ch = u8_nextchar( text, &i );
-         s = gl_fontRenderGlyph( stsh, ch, c, s );
-      }
-      gl_fontRenderEnd();
-
-      y -= line_height; /* move position down */
-   }
+   /* Render it. */
+   gl_fontRenderStart( stsh, bx, by, c, outlineR );
+   font_runRender( run, c );
+   gl_fontRenderEnd();
 
    NTracingZoneEnd( _ctx );
    return 0;
@@ -971,13 +1300,24 @@ int gl_printWidthRaw( const glFont *ft_font, const char *text )
 {
    GLfloat n, nmax;
    size_t i;
-   uint32_t ch;
+   uint32_t ch, h;
+   glFontWidth *w;
+   const int p[3] = { 0, 0, 0 };
    NTracingZone( _ctx, 1 );
 
    if (ft_font == NULL)
       ft_font = &gl_defFont;
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
+   /* See if it's memoised. */
+   h = font_runHash( ft_font->id, -1, p, text );
+   w = &font_widths[ h & (FONT_WIDTH_CACHE_SIZE-1) ];
+   if ((w->text != NULL) && (w->hash == h) && (w->id == ft_font->id) &&
+         (strcmp( w->text, text )==0)) {
+      NTracingZoneEnd( _ctx );
+      return w->width;
+   }
+
    gl_fontKernStart();
    nmax = n = 0.;
    i = 0;
@@ -996,8 +1336,15 @@ int gl_printWidthRaw( const glFont *ft_font, const char *text )
    }
    nmax = MAX( nmax, n );
 
+   /* Store for next time. */
+   free( w->text );
+   w->text  = strdup( text );
+   w->hash  = h;
+   w->id    = ft_font->id;
+   w->width = (int)round(nmax);
+
    NTracingZoneEnd( _ctx );
-   return (int)round(nmax);
+   return w->width;
 }
 
 /**
@@ -1182,6 +1529,7 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
       /* Store data. */
       c->data = NULL;
       c->dataf = NULL;
+      c->buffer = NULL;
       if (bitmap.buffer == NULL) {
          /* Space characters tend to have no buffer. */
          b = 0;
@@ -1192,18 +1540,17 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
          vmax = 1.0; /* arbitrary */
       }
       else {
-         GLubyte *buffer;
-         /* Create a larger image using an extra border and center glyph. */
+         /* Create a larger image using an extra border and center glyph.
+          * The distance field is computed afterwards by font_makeDistance,
+          * as it is by far the slowest part. */
          b = 1 + ((MAX_EFFECT_RADIUS+1) * FONT_DISTANCE_FIELD_SIZE - 1) / stsh->h;
          rw = w+b*2;
          rh = h+b*2;
-         buffer = calloc( rw*rh, sizeof(GLubyte) );
+         c->buffer = calloc( rw*rh, sizeof(GLubyte) );
          for (int v=0; v<h; v++)
             for (int u=0; u<w; u++)
-               buffer[ (b+v)*rw+(b+u) ] = bitmap.buffer[ v*w+u ];
-         /* Compute signed fdistance field with buffered glyph. */
-         c->dataf = make_distance_mapbf( buffer, rw, rh, &vmax );
-         free( buffer );
+               c->buffer[ (b+v)*rw+(b+u) ] = bitmap.buffer[ v*w+u ];
+         vmax = 0.; /* Set by font_makeDistance. */
       }
       c->w     = rw;
       c->h     = rh;
@@ -1219,6 +1566,186 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
    return -1;
 }
 
+/**
+ * @brief Computes the distance field of a character made by font_makeChar.
+ *
+ * Does not touch any shared state so it can be run from a job.
+ *
+ *    @param c Character to compute the distance field of.
+ *    @param h Height of the font.
+ */
+static void font_makeDistance( font_char_t *c, int h )
+{
+   double vmax;
+   if (c->buffer == NULL)
+      return;
+   c->dataf = make_distance_mapbf( c->buffer, c->w, c->h, &vmax );
+   c->m = (2. * vmax * h) / FONT_DISTANCE_FIELD_SIZE;
+   free( c->buffer );
+   c->buffer = NULL;
+}
+
+/**
+ * @brief Computes the hexadecimal MD5 digest of some data.
+ *
+ *    @param[out] digest Where to write the digest.
+ *    @param data Data to hash.
+ *    @param len Length of the data.
+ */
+static void font_md5( char digest[33], const void *data, size_t len )
+{
+   md5_state_t md5;
+   md5_byte_t md5val[16];
+
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t*)data, len );
+   md5_finish( &md5, md5val );
+   for (int i=0; i<16; i++)
+      snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
+}
+
+/**
+ * @brief Gets the path a glyph's distance field is cached at.
+ *
+ *    @return Newly allocated path.
+ */
+static char* font_glyphCachePath( const glFontStash *stsh, const font_char_t *c, uint32_t ch )
+{
+   char key[PATH_MAX], digest[33];
+   char *path;
+
+   /* Anything that changes the output has to be part of the key, the font
+    * contents as the file may be replaced by a plugin or an update. */
+   snprintf( key, sizeof(key), "%s:%d:%d:%d:%d:%d", stsh->ft[c->ft_index].file->digest,
+         stsh->h, FONT_DISTANCE_FIELD_SIZE, MAX_EFFECT_RADIUS, c->w, c->h );
+   font_md5( digest, key, strlen(key) );
+
+   SDL_asprintf( &path, "%sglyphs/%s_%x", nfile_cachePath(), digest, ch );
+   return path;
+}
+
+/**
+ * @brief Loads a glyph's distance field from the disk cache.
+ *
+ *    @param c Character to load the distance field into.
+ *    @param h Height of the font.
+ *    @param path Path of the cached distance field.
+ *    @return 0 on success.
+ */
+static int font_glyphCacheLoad( font_char_t *c, int h, const char *path )
+{
+   size_t filesize;
+   GLfloat *data;
+
+   if (!nfile_fileExists( path ))
+      return -1;
+   data = (GLfloat*) nfile_readFile( &filesize, path );
+   if (data == NULL)
+      return -1;
+
+   /* Consider cached data invalid if the length doesn't match. */
+   if (filesize != sizeof(GLfloat) * (1 + c->w*c->h)) {
+      free( data );
+      return -1;
+   }
+
+   /* The distance scale is stored first, height is part of the path. */
+   (void) h;
+   c->m = data[0];
+   c->dataf = malloc( sizeof(GLfloat) * c->w*c->h );
+   memcpy( c->dataf, &data[1], sizeof(GLfloat) * c->w*c->h );
+   free( data );
+   free( c->buffer );
+   c->buffer = NULL;
+   return 0;
+}
+
+/**
+ * @brief Saves a glyph's distance field to the disk cache.
+ *
+ *    @param c Character with its distance field computed.
+ *    @param path Path to save to.
+ */
+static void font_glyphCacheSave( const font_char_t *c, const char *path )
+{
+   char dirpath[PATH_MAX];
+   size_t size = sizeof(GLfloat) * (1 + c->w*c->h);
+   GLfloat *data;
+
+   if (c->dataf == NULL)
+      return;
+
+   /* Store the distance scale first. */
+   data = malloc( size );
+   data[0] = c->m;
+   memcpy( &data[1], c->dataf, sizeof(GLfloat) * c->w*c->h );
+
+   snprintf( dirpath, sizeof(dirpath), "%s/%s", nfile_cachePath(), "glyphs/" );
+   nfile_dirMakeExist( dirpath );
+   nfile_writeFile( (char*)data, size, path );
+   free( data );
+}
+
+/**
+ * @brief Job that computes a glyph's distance field.
+ */
+static int font_glyphJob( void *data )
+{
+   glFontJob *job = data;
+   font_makeDistance( &job->ch, job->h );
+   if (job->cachefile != NULL)
+      font_glyphCacheSave( &job->ch, job->cachefile );
+   atomic_store( &job->done, 1 );
+   return 0;
+}
+
+/**
+ * @brief Uploads the glyphs that finished generating in the background.
+ *
+ * Must be called from the main thread as it touches OpenGL.
+ *
+ *    @param wait Whether or not to wait for all the glyphs to be done.
+ */
+static void font_jobsProcess( int wait )
+{
+   if (array_size(font_jobs) <= 0)
+      return;
+
+   if (wait)
+      job_wait( font_job_counter );
+
+   for (int i=array_size(font_jobs)-1; i>=0; i--) {
+      glFontJob *job = font_jobs[i];
+      if (!atomic_load( &job->done ))
+         continue;
+
+      /* Make sure the stash wasn't freed in the meantime. */
+      if ((job->id < array_size(avail_fonts)) && (avail_fonts[job->id].fname != NULL)) {
+         glFontStash *stsh = &avail_fonts[ job->id ];
+         glFontGlyph *glyph = &stsh->glyphs[ job->glyph ];
+         glyph->m = job->ch.m;
+         gl_fontAddGlyphTex( stsh, &job->ch, glyph );
+         glyph->ready = 1;
+
+         /* Runs that skipped glyphs have to be laid out again. */
+         for (int j=0; j<FONT_RUN_CACHE_SIZE; j++) {
+            glFontRun *run = &font_runs[j];
+            if ((run->id != job->id) || !run->pending)
+               continue;
+            free( run->text );
+            run->text = NULL;
+         }
+      }
+
+      free( job->ch.data );
+      free( job->ch.dataf );
+      free( job->ch.buffer );
+      free( job->cachefile );
+      free( job );
+      array_erase( &font_jobs, &font_jobs[i], &font_jobs[i+1] );
+   }
+}
+
 /**
  * @brief Starts the rendering engine.
  */
@@ -1236,6 +1763,9 @@ static void gl_fontRenderStartH( const glFontStash* stsh, const mat4 *H, const g
 
    outlineR = (outlineR==-1) ? 1 : MAX( outlineR, 0 );
 
+   /* Upload any glyphs that finished in the background. */
+   font_jobsProcess( 0 );
+
    /* Handle colour. */
    a = (c==NULL) ? 1. : c->a;
    if (font_restoreLast)
@@ -1376,8 +1906,40 @@ static glFontGlyph* gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
       }
    }
 
+   /* Compute the distance field, either from the disk cache, in the
+    * background, or right away. */
+   if (ft_char.buffer != NULL) {
+      char *cachefile = font_glyphCachePath( stsh, &ft_char, ch );
+      if (font_glyphCacheLoad( &ft_char, stsh->h, cachefile ) == 0)
+         free( cachefile );
+      else if ((ch >= FONT_ASYNC_MIN) && (threadpool_threads() > 1)) {
+         glFontJob *job = calloc( 1, sizeof(glFontJob) );
+         job->id     = stsh - avail_fonts;
+         job->glyph  = idx;
+         job->h      = stsh->h;
+         job->ch     = ft_char;
+         job->cachefile = cachefile;
+         atomic_init( &job->done, 0 );
+         if (font_jobs == NULL)
+            font_jobs = array_create( glFontJob* );
+         if (font_job_counter == NULL)
+            font_job_counter = job_counterCreate();
+         array_push_back( &font_jobs, job );
+         job_run( font_job_counter, font_glyphJob, job );
+         glyph->ready = 0;
+         return glyph;
+      }
+      else {
+         font_makeDistance( &ft_char, stsh->h );
+         font_glyphCacheSave( &ft_char, cachefile );
+         free( cachefile );
+      }
+   }
+   glyph->m = ft_char.m;
+
    /* Find empty texture and render char. */
    gl_fontAddGlyphTex( stsh, &ft_char, glyph );
+   glyph->ready = 1;
 
    free(ft_char.data);
    free(ft_char.dataf);
@@ -1414,61 +1976,6 @@ static int gl_fontKernGlyph( glFontStash* stsh, uint32_t ch, glFontGlyph* glyph
    return kern_adv_x;
 }
 
-/**
- * @brief Renders a character.
- */
-static int gl_fontRenderGlyph( glFontStash* stsh, uint32_t ch, const glColour *c, int state )
-{
-   double scale;
-   int kern_adv_x;
-   glFontGlyph *glyph;
-
-   /* Handle escape sequences. */
-   if ((ch == FONT_COLOUR_CODE) && (state==0)) { /* Start sequence. */
-      return 1;
-   }
-   if ((state == 1) && (ch != FONT_COLOUR_CODE)) {
-      const glColour *col = gl_fontGetColour( ch );
-      double a = (c==NULL) ? 1. : c->a;
-      if (col != NULL)
-         gl_uniformAColour(shaders.font.colour, col, a );
-      else if (c==NULL)
-         gl_uniformColour(shaders.font.colour, &cWhite);
-      else
-         gl_uniformColour(shaders.font.colour, c);
-      font_lastCol = col;
-      return 0;
-   }
-
-   /* Unicode goes here.
-    * First try to find the glyph. */
-   glyph = gl_fontGetGlyph( stsh, ch );
-   if (glyph == NULL) {
-      WARN(_("Unable to find glyph '%d'!"), ch );
-      return -1;
-   }
-
-   /* Kern if possible. */
-   scale = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
-   kern_adv_x = gl_fontKernGlyph( stsh, ch, glyph );
-   if (kern_adv_x)
-      mat4_translate_x( &font_projection_mat, kern_adv_x/scale );
-
-   /* Activate texture. */
-   glBindTexture(GL_TEXTURE_2D, stsh->tex[glyph->tex_index].id);
-
-   glUniform1f(shaders.font.m, glyph->m);
-   gl_uniformMat4(shaders.font.projection, &font_projection_mat);
-
-   /* Draw the element. */
-   glDrawArrays( GL_TRIANGLE_STRIP, glyph->vbo_id, 4 );
-
-   /* Translate matrix. */
-   mat4_translate_x( &font_projection_mat, glyph->adv_x/scale );
-
-   return 0;
-}
-
 /**
  * @brief Ends the rendering engine.
  */
@@ -1623,6 +2130,9 @@ int gl_fontAddFallback( glFont* font, const char *fname, const char *prefix )
    int ch, ret;
    glFontStash *stsh = gl_fontGetStash( font );
 
+   /* Glyphs may now come from the fallback, so layouts are stale. */
+   font_runFlush( font->id );
+
    ret = 0;
    ch = 0;
    len = strlen(fname);
@@ -1678,6 +2188,7 @@ static int gl_fontstashAddFallback( glFontStash* stsh, const char *fname, unsign
          gl_fontstashftDestroy( &ft );
          return -1;
       }
+      font_md5( ft.file->digest, ft.file->data, ft.file->datasize );
    }
 
    /* Object which freetype uses to store font info. */
@@ -1733,14 +2244,18 @@ void gl_freeFont( glFont* font )
    if (stsh->refcount > 0)
       return;
    /* Not references and must eliminate. */
+   font_jobsProcess( 1 );
+   font_runFlush( font->id );
 
    for (int i=0; i<array_size(stsh->ft); i++)
       gl_fontstashftDestroy( &stsh->ft[i] );
    array_free( stsh->ft );
 
    free( stsh->fname );
-   for (int i=0; i<array_size(stsh->tex); i++)
-      glDeleteTextures( 1, &stsh->tex->id );
+   for (int i=0; i<array_size(stsh->tex); i++) {
+      glDeleteTextures( 1, &stsh->tex[i].id );
+      memstats_add( MEMTAG_FONTS, -(int64_t)stsh->tw * stsh->th );
+   }
    array_free( stsh->tex );
 
    array_free( stsh->glyphs );
@@ -1773,6 +2288,12 @@ static void gl_fontstashftDestroy( glFontStashFreetype *ft )
  */
 void gl_fontExit (void)
 {
+   font_jobsProcess( 1 );
+   array_free( font_jobs );
+   font_jobs = NULL;
+   job_counterDestroy( font_job_counter );
+   font_job_counter = NULL;
+   font_runFlush( -1 );
    FT_Done_FreeType( font_library );
    font_library = NULL;
    array_free( avail_fonts );
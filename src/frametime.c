@@ -0,0 +1,352 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file frametime.c
+ *
+ * @brief Frame time histogram and time spent in each stage of the frame.
+ *
+ * Keeps the duration of the last frames to draw a histogram and get the
+ *  percentiles, and the average time of each update and render stage over the
+ *  last second, along with a few draw counters. Render stages show both the CPU time, and the GPU time when
+ *  timer queries are available. Nothing is timed unless the overlay is
+ *  enabled, but the counters are always plotted to Tracy when built with it.
+ */
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "frametime.h"
+
+#include "font.h"
+#include "log.h"
+#include "ntracing.h"
+#include "opengl.h"
+
+#define FRAMETIME_FRAMES   240   /**< Number of frames kept for the histogram. */
+#define FRAMETIME_BAR_W    1.    /**< Width of each histogram bar. */
+#define FRAMETIME_BAR_H    60.   /**< Height of the histogram. */
+#define FRAMETIME_MAX_MS   50.   /**< Frame time at the top of the histogram. */
+#define FRAMETIME_GOOD_MS  (1000./60.) /**< Frame time drawn as good. */
+#define FRAMETIME_OK_MS    (1000./30.) /**< Frame time drawn as acceptable. */
+
+static const char *frametime_names[FRAME_STAGE_MAX] = {
+   [FRAME_UPDATE_PURGE]       = "purge",
+   [FRAME_UPDATE_SPACE]       = "space",
+   [FRAME_UPDATE_SPFX]        = "spfx",
+   [FRAME_UPDATE_AI]          = "ai",
+   [FRAME_UPDATE_PILOTS]      = "pilots",
+   [FRAME_UPDATE_WEAPONS]     = "weapons",
+   [FRAME_UPDATE_HOOKS]       = "hooks",
+   [FRAME_RENDER_BACKGROUND]  = "background",
+   [FRAME_RENDER_SPOBS]       = "spobs",
+   [FRAME_RENDER_SPFX]        = "spfx",
+   [FRAME_RENDER_PILOTS]      = "pilots",
+   [FRAME_RENDER_WEAPONS]     = "weapons",
+   [FRAME_RENDER_HOOKS]       = "hooks",
+   [FRAME_RENDER_GUI]         = "gui",
+   [FRAME_RENDER_POSTPROCESS] = "postprocess",
+   [FRAME_RENDER_TOOLKIT]     = "toolkit",
+   [FRAME_RENDER_SWAP]        = "swap",
+}; /**< Names of the stages. */
+
+static const char *frametime_countnames[FRAME_COUNTER_MAX] = {
+   [FRAME_COUNT_MESHES]       = "3d meshes",
+   [FRAME_COUNT_SPRITES]      = "3d sprites",
+   [FRAME_COUNT_DRAWS]        = "draw calls",
+   [FRAME_COUNT_TEXUPLOADS]   = "tex uploads",
+   [FRAME_COUNT_HOOKS]        = "hooks run",
+}; /**< Names of the counters. */
+#if HAVE_TRACY
+static const char *frametime_plotnames[FRAME_COUNTER_MAX] = {
+   [FRAME_COUNT_MESHES]       = "3d_meshes",
+   [FRAME_COUNT_SPRITES]      = "3d_sprites",
+   [FRAME_COUNT_DRAWS]        = "draw_calls",
+   [FRAME_COUNT_TEXUPLOADS]   = "tex_uploads",
+   [FRAME_COUNT_HOOKS]        = "hooks_run",
+}; /**< Names of the counter plots, Tracy needs them to stay around. */
+#endif /* HAVE_TRACY */
+
+static int frametime_on          = 0; /**< Whether or not frames are being timed. */
+static double frametime_ring[FRAMETIME_FRAMES]; /**< Duration of the last frames in ms. */
+static int frametime_head        = 0; /**< Next frame to write in the ring. */
+static int frametime_count       = 0; /**< Number of frames in the ring. */
+static Uint64 frametime_cur[FRAME_STAGE_MAX]; /**< Ticks of each stage in the current frame. */
+static Uint64 frametime_sum[FRAME_STAGE_MAX]; /**< Ticks of each stage since the last refresh. */
+static int frametime_sumframes   = 0; /**< Frames since the last refresh. */
+static double frametime_sumdt    = 0.; /**< Time since the last refresh. */
+static double frametime_avg[FRAME_STAGE_MAX]; /**< Average ms of each stage over the last second. */
+static Uint64 frametime_gpusum[FRAME_STAGE_MAX]; /**< GPU ns of each stage since the last refresh. */
+static int frametime_gpuframes   = 0; /**< Frames timed on the GPU since the last refresh. */
+static double frametime_gpuavg[FRAME_STAGE_MAX]; /**< Average GPU ms of each stage over the last second. */
+static int frametime_hasgpu      = 0; /**< Whether or not GPU times were ever received. */
+static double frametime_pct[3];  /**< 50th, 95th and 99th percentile of the frame time. */
+static unsigned int frametime_countcur[FRAME_COUNTER_MAX]; /**< Counts of the current frame. */
+static unsigned int frametime_countsum[FRAME_COUNTER_MAX]; /**< Counts since the last refresh. */
+static double frametime_countavg[FRAME_COUNTER_MAX]; /**< Average count per frame over the last second. */
+
+/*
+ * Prototypes.
+ */
+static int frametime_cmp( const void *p1, const void *p2 );
+static void frametime_refresh (void);
+
+/**
+ * @brief Enables or disables timing the frames.
+ */
+void frametime_setEnabled( int enable )
+{
+   frametime_on = enable;
+   if (enable)
+      return;
+   frametime_head = frametime_count = frametime_sumframes = 0;
+   frametime_sumdt = 0.;
+   frametime_gpuframes = 0;
+   memset( frametime_cur, 0, sizeof(frametime_cur) );
+   memset( frametime_sum, 0, sizeof(frametime_sum) );
+   memset( frametime_gpusum, 0, sizeof(frametime_gpusum) );
+   memset( frametime_countsum, 0, sizeof(frametime_countsum) );
+}
+
+/**
+ * @brief Checks to see if frames are being timed.
+ */
+int frametime_enabled (void)
+{
+   return frametime_on;
+}
+
+/**
+ * @brief Gets a mark to time a stage from.
+ *
+ *    @return The current time, or 0 when not timing.
+ */
+Uint64 frametime_mark (void)
+{
+   return frametime_on ? SDL_GetPerformanceCounter() : 0;
+}
+
+/**
+ * @brief Adds the time since a mark to a stage, and moves the mark to now.
+ *
+ * Meant to be chained through the stages of a routine without having to take
+ *  a new mark for each.
+ *
+ *    @param stage Stage to add to.
+ *    @param[in,out] mark Mark from frametime_mark or a previous call.
+ */
+void frametime_add( FrameStage stage, Uint64 *mark )
+{
+   Uint64 now;
+   if (!frametime_on)
+      return;
+   now = SDL_GetPerformanceCounter();
+   frametime_cur[stage] += now - *mark;
+   *mark = now;
+}
+
+/**
+ * @brief Adds time measured elsewhere to a stage.
+ *
+ *    @param stage Stage to add to.
+ *    @param ticks Performance counter ticks to add.
+ */
+void frametime_addTicks( FrameStage stage, Uint64 ticks )
+{
+   if (frametime_on)
+      frametime_cur[stage] += ticks;
+}
+
+/**
+ * @brief Adds the GPU times of a frame, which arrive a few frames late.
+ *
+ *    @param ns Nanoseconds spent on the GPU by each stage.
+ */
+void frametime_addGPU( const Uint64 ns[FRAME_STAGE_MAX] )
+{
+   if (!frametime_on)
+      return;
+   for (int i=0; i<FRAME_STAGE_MAX; i++)
+      frametime_gpusum[i] += ns[i];
+   frametime_gpuframes++;
+   frametime_hasgpu = 1;
+}
+
+/**
+ * @brief Adds to a counter of the current frame.
+ *
+ *    @param counter Counter to add to.
+ *    @param n Amount to add.
+ */
+void frametime_addCount( FrameCounter counter, int n )
+{
+   frametime_countcur[counter] += n;
+}
+
+/**
+ * @brief Gets the name of a stage.
+ */
+const char *frametime_name( FrameStage stage )
+{
+   return frametime_names[stage];
+}
+
+/**
+ * @brief Compares frame times for qsort.
+ */
+static int frametime_cmp( const void *p1, const void *p2 )
+{
+   double d1 = *(const double*)p1;
+   double d2 = *(const double*)p2;
+   return (d1 > d2) - (d1 < d2);
+}
+
+/**
+ * @brief Recomputes the percentiles and stage averages.
+ */
+static void frametime_refresh (void)
+{
+   double sorted[FRAMETIME_FRAMES];
+   double freq = (double)SDL_GetPerformanceFrequency();
+
+   if (frametime_count > 0) {
+      memcpy( sorted, frametime_ring, sizeof(double) * frametime_count );
+      qsort( sorted, frametime_count, sizeof(double), frametime_cmp );
+      frametime_pct[0] = sorted[ (frametime_count-1) * 50 / 100 ];
+      frametime_pct[1] = sorted[ (frametime_count-1) * 95 / 100 ];
+      frametime_pct[2] = sorted[ (frametime_count-1) * 99 / 100 ];
+   }
+
+   for (int i=0; i<FRAME_STAGE_MAX; i++) {
+      frametime_avg[i] = (frametime_sumframes > 0) ?
+            1000. * (double)frametime_sum[i] / freq / (double)frametime_sumframes : 0.;
+      frametime_sum[i] = 0;
+      frametime_gpuavg[i] = (frametime_gpuframes > 0) ?
+            1e-6 * (double)frametime_gpusum[i] / (double)frametime_gpuframes : 0.;
+      frametime_gpusum[i] = 0;
+   }
+   for (int i=0; i<FRAME_COUNTER_MAX; i++) {
+      frametime_countavg[i] = (frametime_sumframes > 0) ?
+            (double)frametime_countsum[i] / (double)frametime_sumframes : 0.;
+      frametime_countsum[i] = 0;
+   }
+   frametime_sumframes = 0;
+   frametime_gpuframes = 0;
+   frametime_sumdt     = 0.;
+}
+
+/**
+ * @brief Ends a frame.
+ *
+ *    @param dt Real duration of the frame.
+ */
+void frametime_frame( double dt )
+{
+   /* Counters are cheap, so they are kept even when not timing. */
+   for (int i=0; i<FRAME_COUNTER_MAX; i++) {
+#if HAVE_TRACY
+      NTracingPlotI( frametime_plotnames[i], (int64_t)frametime_countcur[i] );
+#endif /* HAVE_TRACY */
+      if (frametime_on)
+         frametime_countsum[i] += frametime_countcur[i];
+      frametime_countcur[i] = 0;
+   }
+
+   if (!frametime_on)
+      return;
+
+   /* The AI runs inside the pilot update, so it is taken out of it. */
+   if (frametime_cur[FRAME_UPDATE_PILOTS] >= frametime_cur[FRAME_UPDATE_AI])
+      frametime_cur[FRAME_UPDATE_PILOTS] -= frametime_cur[FRAME_UPDATE_AI];
+
+   for (int i=0; i<FRAME_STAGE_MAX; i++) {
+      frametime_sum[i] += frametime_cur[i];
+      frametime_cur[i]  = 0;
+   }
+   frametime_sumframes++;
+
+   frametime_ring[ frametime_head ] = dt * 1000.;
+   frametime_head = (frametime_head+1) % FRAMETIME_FRAMES;
+   frametime_count = MIN( frametime_count+1, FRAMETIME_FRAMES );
+
+   /* Refresh every second like the FPS. */
+   frametime_sumdt += dt;
+   if (frametime_sumdt > 1.)
+      frametime_refresh();
+}
+
+/**
+ * @brief Renders the overlay.
+ *
+ *    @param x X position to render at.
+ *    @param y Y position of the top of the overlay.
+ *    @return Y position below the overlay.
+ */
+double frametime_render( double x, double y )
+{
+   const glColour bg = { .r=0., .g=0., .b=0., .a=0.6 };
+   const double lh = gl_defFontMono.h + 5.;
+
+   if (!frametime_on)
+      return y;
+
+   /* Histogram, oldest frame on the left. */
+   y -= FRAMETIME_BAR_H;
+   gl_renderRect( x, y, FRAMETIME_FRAMES * FRAMETIME_BAR_W, FRAMETIME_BAR_H, &bg );
+   for (int i=0; i<frametime_count; i++) {
+      int j = (frametime_head - frametime_count + i + FRAMETIME_FRAMES) % FRAMETIME_FRAMES;
+      double ms = frametime_ring[j];
+      double h = FRAMETIME_BAR_H * MIN( ms / FRAMETIME_MAX_MS, 1. );
+      const glColour *c = (ms <= FRAMETIME_GOOD_MS) ? &cGreen :
+            (ms <= FRAMETIME_OK_MS) ? &cYellow : &cRed;
+      gl_renderRect( x + i * FRAMETIME_BAR_W, y, FRAMETIME_BAR_W, h, c );
+   }
+   y -= lh;
+
+   gl_print( &gl_defFontMono, x, y, &cFontWhite, _("p50 %.1f p95 %.1f p99 %.1f ms"),
+         frametime_pct[0], frametime_pct[1], frametime_pct[2] );
+   y -= lh;
+
+   /* Stages, with the GPU time of the render ones. */
+   for (int i=0; i<FRAME_STAGE_MAX; i++) {
+      const char *kind = (i < FRAME_RENDER_BACKGROUND) ? _("update") : _("render");
+      if (frametime_hasgpu && (i >= FRAME_RENDER_BACKGROUND) && (i != FRAME_RENDER_SWAP))
+         gl_print( &gl_defFontMono, x, y, &cFontWhite, _("%-6s %-11s %6.2f ms %6.2f ms GPU"),
+               kind, frametime_names[i], frametime_avg[i], frametime_gpuavg[i] );
+      else
+         gl_print( &gl_defFontMono, x, y, &cFontWhite, "%-6s %-11s %6.2f ms",
+               kind, frametime_names[i], frametime_avg[i] );
+      y -= lh;
+   }
+
+   /* Counters that were used. */
+   for (int i=0; i<FRAME_COUNTER_MAX; i++) {
+      if (frametime_countavg[i] <= 0.)
+         continue;
+      gl_print( &gl_defFontMono, x, y, &cFontWhite, _("%-18s %6.1f per frame"),
+            frametime_countnames[i], frametime_countavg[i] );
+      y -= lh;
+   }
+   return y;
+}
+
+/**
+ * @brief Prints the last statistics to the log.
+ */
+void frametime_print (void)
+{
+   if (!frametime_on || (frametime_count == 0))
+      return;
+   if (frametime_sumframes > 0)
+      frametime_refresh();
+   LOG( _("Frame time: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms"),
+         frametime_pct[0], frametime_pct[1], frametime_pct[2] );
+   for (int i=0; i<FRAME_STAGE_MAX; i++)
+      LOG( "   %s %-11s %6.2f ms (GPU %6.2f ms)", (i < FRAME_RENDER_BACKGROUND) ? "update" : "render",
+            frametime_names[i], frametime_avg[i], frametime_gpuavg[i] );
+   for (int i=0; i<FRAME_COUNTER_MAX; i++)
+      LOG( "   %-18s %6.1f per frame", frametime_countnames[i], frametime_countavg[i] );
+}
@@ -0,0 +1,61 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include "SDL.h"
+/** @endcond */
+
+/**
+ * @brief Stages of a frame that get timed.
+ *
+ * They follow the tracing zones of the update and render routines, so that
+ *  the overlay shows the same breakdown as Tracy without needing it.
+ */
+typedef enum FrameStage_ {
+   FRAME_UPDATE_PURGE,     /**< Purging the dead pilots and weapons. */
+   FRAME_UPDATE_SPACE,     /**< Updating the system. */
+   FRAME_UPDATE_SPFX,      /**< Updating the special effects. */
+   FRAME_UPDATE_AI,        /**< Pilots thinking, part of the pilot update. */
+   FRAME_UPDATE_PILOTS,    /**< Updating the pilots, not counting the AI. */
+   FRAME_UPDATE_WEAPONS,   /**< Updating the weapons and their collisions. */
+   FRAME_UPDATE_HOOKS,     /**< Running the update hooks. */
+   FRAME_RENDER_BACKGROUND,/**< Rendering the background. */
+   FRAME_RENDER_SPOBS,     /**< Rendering the space objects and asteroids. */
+   FRAME_RENDER_SPFX,      /**< Rendering the special effects. */
+   FRAME_RENDER_PILOTS,    /**< Rendering the pilots. */
+   FRAME_RENDER_WEAPONS,   /**< Rendering the weapons. */
+   FRAME_RENDER_HOOKS,     /**< Running the render hooks. */
+   FRAME_RENDER_GUI,       /**< Rendering the GUI and overlay. */
+   FRAME_RENDER_POSTPROCESS,/**< Running the post-processing shaders. */
+   FRAME_RENDER_TOOLKIT,   /**< Rendering the toolkit. */
+   FRAME_RENDER_SWAP,      /**< Swapping the buffers, mostly waiting on the GPU. */
+   FRAME_STAGE_MAX         /**< Number of stages. */
+} FrameStage;
+
+/**
+ * @brief Things counted during a frame.
+ *
+ * They are plotted to Tracy every frame, and the overlay shows their average.
+ */
+typedef enum FrameCounter_ {
+   FRAME_COUNT_MESHES,     /**< Meshes of 3D models drawn. */
+   FRAME_COUNT_SPRITES,    /**< 3D models drawn from their sprite sheet. */
+   FRAME_COUNT_DRAWS,      /**< OpenGL draw calls. */
+   FRAME_COUNT_TEXUPLOADS, /**< Texture data uploaded to the GPU. */
+   FRAME_COUNT_HOOKS,      /**< Hooks run. */
+   FRAME_COUNTER_MAX       /**< Number of counters. */
+} FrameCounter;
+
+void frametime_setEnabled( int enable );
+int frametime_enabled (void);
+Uint64 frametime_mark (void);
+void frametime_add( FrameStage stage, Uint64 *mark );
+void frametime_addTicks( FrameStage stage, Uint64 ticks );
+void frametime_addGPU( const Uint64 ns[FRAME_STAGE_MAX] );
+void frametime_addCount( FrameCounter counter, int n );
+const char *frametime_name( FrameStage stage );
+void frametime_frame( double dt );
+double frametime_render( double x, double y );
+void frametime_print (void);
@@ -5,6 +5,11 @@
  * @file gatherable.c
  *
  * @brief Handles gatherable objects.
+ *
+ * Gatherables are stored densely and removed by swapping with the last one.
+ *  They are referred to from outside by IDs made of a slot and its
+ *  generation, so that an ID stops being valid when its gatherable is removed
+ *  even if the slot is reused.
  */
 /** @cond */
 #include <stdio.h>
@@ -18,18 +23,38 @@
 
 #include "array.h"
 #include "hook.h"
+#include "opengl_render.h"
 #include "player.h"
 
 /* Gatherables */
 #define GATHER_DIST 30. /**< Maximum distance a gatherable can be gathered. */
 
+/* IDs. */
+#define GATHER_SLOT_BITS   20 /**< Bits of the ID used for the slot. */
+#define GATHER_SLOT_MASK   ((1<<GATHER_SLOT_BITS)-1) /**< Mask of the slot of an ID. */
+#define GATHER_GEN_MASK    ((1<<(31-GATHER_SLOT_BITS))-1) /**< Mask of the generation of an ID. */
+
+/**
+ * @brief Slot a gatherable ID refers to.
+ */
+typedef struct GatherableSlot_ {
+   int idx;          /**< Index in the gatherable stack, -1 if free. */
+   unsigned int gen; /**< Generation, increased when the gatherable is removed. */
+} GatherableSlot;
+
 /* gatherables stack */
 static Gatherable* gatherable_stack = NULL; /**< Contains the gatherable stuff floating around. */
+static GatherableSlot *gatherable_slots = NULL; /**< Slots of the gatherable IDs (array.h). */
+static int *gatherable_slotsFree = NULL; /**< Free slots (array.h). */
+static int *gatherable_order = NULL; /**< Gatherables sorted by x position (array.h). */
 static float noscoop_timer = 1.; /**< Timer for the "full cargo" message . */
-static IntList gather_qtquery; /**< For collisions. */
 
 /* Prototypes. */
 static int gatherable_gather( Gatherable *got, Pilot *p );
+static void gatherable_remove( int i );
+static int gatherable_id( const Gatherable *g );
+static int gatherable_orderCmp( const void *p1, const void *p2 );
+static void gatherable_gatherPilot( Pilot *p );
 
 /**
  * @brief Loads the gatherable system.
@@ -39,7 +64,6 @@ static int gatherable_gather( Gatherable *got, Pilot *p );
 int gatherable_load (void)
 {
    gatherable_stack = array_create( Gatherable );
-   il_create( &gather_qtquery, 1 );
    return 0;
 }
 
@@ -50,7 +74,44 @@ void gatherable_cleanup (void)
 {
    array_free( gatherable_stack );
    gatherable_stack = NULL;
-   il_destroy( &gather_qtquery );
+   array_free( gatherable_slots );
+   gatherable_slots = NULL;
+   array_free( gatherable_slotsFree );
+   gatherable_slotsFree = NULL;
+   array_free( gatherable_order );
+   gatherable_order = NULL;
+}
+
+/**
+ * @brief Gets the ID of a gatherable.
+ */
+static int gatherable_id( const Gatherable *g )
+{
+   unsigned int gen = gatherable_slots[ g->slot ].gen & GATHER_GEN_MASK;
+   return (int)(gen << GATHER_SLOT_BITS) | g->slot;
+}
+
+/**
+ * @brief Removes a gatherable by swapping it with the last one.
+ *
+ *    @param i Index of the gatherable in the stack.
+ */
+static void gatherable_remove( int i )
+{
+   int last = array_size(gatherable_stack)-1;
+   GatherableSlot *s = &gatherable_slots[ gatherable_stack[i].slot ];
+
+   /* Invalidate the ID. */
+   s->idx = -1;
+   s->gen++;
+   array_push_back( &gatherable_slotsFree, gatherable_stack[i].slot );
+
+   /* Fill the hole with the last one. */
+   if (i != last) {
+      gatherable_stack[i] = gatherable_stack[last];
+      gatherable_slots[ gatherable_stack[i].slot ].idx = i;
+   }
+   array_resize( &gatherable_stack, last );
 }
 
 /**
@@ -65,8 +126,29 @@ void gatherable_cleanup (void)
  */
 int gatherable_init( const Commodity* com, const vec2 *pos, const vec2 *vel, double lifeleng, int qtt, unsigned int player_only )
 {
-   Gatherable *g = &array_grow( &gatherable_stack );
+   Gatherable *g;
+   int slot;
+
+   /* Get a slot for the ID. */
+   if (array_size(gatherable_slotsFree) > 0) {
+      slot = array_back( gatherable_slotsFree );
+      array_erase( &gatherable_slotsFree, &array_back(gatherable_slotsFree), array_end(gatherable_slotsFree) );
+   }
+   else {
+      if (array_size(gatherable_slots) > GATHER_SLOT_MASK) {
+         WARN(_("Too many gatherables!"));
+         return -1;
+      }
+      if (gatherable_slots == NULL)
+         gatherable_slots = array_create( GatherableSlot );
+      slot = array_size(gatherable_slots);
+      array_grow( &gatherable_slots ).gen = 0;
+   }
+   gatherable_slots[slot].idx = array_size(gatherable_stack);
+
+   g = &array_grow( &gatherable_stack );
    memset( g, 0, sizeof(Gatherable) );
+   g->slot = slot;
    g->type = com;
    g->pos = *pos;
    g->vel = *vel;
@@ -81,7 +163,7 @@ int gatherable_init( const Commodity* com, const vec2 *pos, const vec2 *vel, dou
    else
       g->lifeleng = lifeleng;
 
-   return g-gatherable_stack;
+   return gatherable_id( g );
 }
 
 /**
@@ -91,48 +173,96 @@ int gatherable_init( const Commodity* com, const vec2 *pos, const vec2 *vel, dou
  */
 void gatherable_update( double dt )
 {
-   Pilot *const* pilot_stack = pilot_getAll();
-
    /* Update the timer for "full cargo" message. */
    noscoop_timer += dt;
 
    for (int i=array_size(gatherable_stack)-1; i>=0; i--) {
       Gatherable *g = &gatherable_stack[i];
-      const int r = ceil(GATHER_DIST);
-      int x, y;
 
       g->timer += dt;
       g->pos.x += dt*g->vel.x;
       g->pos.y += dt*g->vel.y;
 
       /* Remove the gatherable */
-      if (g->timer > g->lifeleng) {
-         array_erase( &gatherable_stack, g, g+1 );
-         continue;
-      }
+      if (g->timer > g->lifeleng)
+         gatherable_remove( i );
+   }
+   if (array_size(gatherable_stack) <= 0)
+      return;
+
+   /* Sort by position so pilots only look at the gatherables near them. */
+   if (gatherable_order == NULL)
+      gatherable_order = array_create( int );
+   array_resize( &gatherable_order, array_size(gatherable_stack) );
+   for (int i=0; i<array_size(gatherable_stack); i++)
+      gatherable_order[i] = i;
+   qsort( gatherable_order, array_size(gatherable_order), sizeof(int), gatherable_orderCmp );
+
+   /* Have the pilots pick them up, the gathered ones get removed after.
+    * Hooks can add pilots, so the stack is gotten every time. */
+   for (int i=0; i<array_size(pilot_getAll()); i++)
+      gatherable_gatherPilot( pilot_getAll()[i] );
+   for (int i=array_size(gatherable_stack)-1; i>=0; i--)
+      if (gatherable_stack[i].gathered)
+         gatherable_remove( i );
+}
 
-      /* Only player can gather player only stuff. */
-      if (g->player_only) {
-         if ((player.p!=NULL) && vec2_dist2(&player.p->solid.pos, &g->pos ) <= pow2(GATHER_DIST))
-            gatherable_gather( g, player.p );
-         continue;
-      }
+/**
+ * @brief Compares gatherables by x position.
+ */
+static int gatherable_orderCmp( const void *p1, const void *p2 )
+{
+   double x1 = gatherable_stack[ *(const int*)p1 ].pos.x;
+   double x2 = gatherable_stack[ *(const int*)p2 ].pos.x;
+   return (x1 > x2) - (x1 < x2);
+}
+
+/**
+ * @brief Has a pilot pick up the gatherables near it.
+ *
+ *    @param p Pilot to gather for.
+ */
+static void gatherable_gatherPilot( Pilot *p )
+{
+   int lo, hi, n, isplayer;
+
+   /* Only the player gets told that there is no cargo space. */
+   isplayer = pilot_isPlayer(p);
+   if (!isplayer && (pilot_cargoFree(p) < 1))
+      return;
+
+   /* Find the first gatherable that can be in range. */
+   n  = array_size(gatherable_order);
+   lo = 0;
+   hi = n;
+   while (lo < hi) {
+      int mid = (lo+hi)/2;
+      if (gatherable_stack[ gatherable_order[mid] ].pos.x < p->solid.pos.x - GATHER_DIST)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
 
-      /* Check if can be picked up. */
-      x = round( g->pos.x );
-      y = round( g->pos.y );
-      pilot_collideQueryIL( &gather_qtquery, x-r, y-r, x+r, y+r );
-      for (int j=0; j<il_size(&gather_qtquery); j++) {
-         Pilot *p = pilot_stack[ il_get( &gather_qtquery, j, 0 ) ];
+   for (int i=lo; i<n; i++) {
+      Gatherable *g;
+      int gi = gatherable_order[i];
 
-         /* See if in distance. */
-         if (vec2_dist2( &p->solid.pos, &g->pos ) > pow2(GATHER_DIST) )
-            continue;
+      /* Hooks may have cleared the gatherables. */
+      if (gi >= array_size(gatherable_stack))
+         return;
+      g = &gatherable_stack[gi];
+      if (g->pos.x > p->solid.pos.x + GATHER_DIST)
+         return;
 
-         /* Try to pick up. */
-         if (gatherable_gather( g, p ))
-            break;
-      }
+      /* Only player can gather player only stuff. */
+      if (g->gathered || (g->player_only && !isplayer))
+         continue;
+      if (vec2_dist2( &p->solid.pos, &g->pos ) > pow2(GATHER_DIST))
+         continue;
+
+      /* Stop once it can't take any more. */
+      if (!gatherable_gather( g, p ) || (pilot_cargoFree(p) < 1))
+         return;
    }
 }
 
@@ -141,7 +271,8 @@ void gatherable_update( double dt )
  */
 void gatherable_free( void )
 {
-   array_erase( &gatherable_stack, array_begin(gatherable_stack), array_end(gatherable_stack) );
+   for (int i=array_size(gatherable_stack)-1; i>=0; i--)
+      gatherable_remove( i );
 }
 
 /**
@@ -149,10 +280,12 @@ void gatherable_free( void )
  */
 void gatherable_render( void )
 {
+   gl_batchBegin();
    for (int i=0; i < array_size(gatherable_stack); i++) {
       const Gatherable *gat = &gatherable_stack[i];
       gl_renderSprite( gat->type->gfx_space, gat->pos.x, gat->pos.y, gat->sx, gat->sy, NULL );
    }
+   gl_batchEnd();
 }
 
 /**
@@ -170,12 +303,14 @@ int gatherable_getClosest( const vec2 *pos, double rad )
    for (int i=0; i < array_size(gatherable_stack); i++) {
       Gatherable *gat = &gatherable_stack[i];
       double curdist = vec2_dist(pos, &gat->pos);
+      if (gat->gathered)
+         continue;
       if ( (curdist<mindist) && (curdist<rad) ) {
          curg = i;
          mindist = curdist;
       }
    }
-   return curg;
+   return (curg < 0) ? -1 : gatherable_id( &gatherable_stack[curg] );
 }
 
 /**
@@ -183,20 +318,24 @@ int gatherable_getClosest( const vec2 *pos, double rad )
  *
  *    @param pos pointer to the position.
  *    @param vel pointer to the velocity.
- *    @param id Id of the gatherable in the stack.
+ *    @param id ID of the gatherable, from gatherable_init or gatherable_getClosest.
  *    @return flag 1->there exists a gatherable 0->elsewere.
  */
 int gatherable_getPos( vec2* pos, vec2* vel, int id )
 {
    Gatherable *gat;
+   const GatherableSlot *s;
+   int slot = id & GATHER_SLOT_MASK;
 
-   if ((id < 0) || (id > array_size(gatherable_stack)-1) ) {
+   s = ((id < 0) || (slot >= array_size(gatherable_slots))) ? NULL : &gatherable_slots[slot];
+   if ((s == NULL) || (s->idx < 0) ||
+         (((s->gen & GATHER_GEN_MASK) << GATHER_SLOT_BITS) != (unsigned int)(id & ~GATHER_SLOT_MASK))) {
       vectnull( pos );
       vectnull( vel );
       return 0;
    }
 
-   gat = &gatherable_stack[id];
+   gat = &gatherable_stack[ s->idx ];
    *pos = gat->pos;
    *vel = gat->vel;
 
@@ -231,6 +370,9 @@ static int gatherable_gather( Gatherable *gat, Pilot *p )
    q = pilot_cargoAdd( p, gat->type, gat->quantity, 0 );
 
    if (q>0) {
+      /* Remove the object from space, before hooks can move the stack. */
+      gat->gathered = 1;
+
       if (pilot_isPlayer(p)) {
          HookParam hparam[3];
          player_message( n_("%d ton of %s gathered", "%d tons of %s gathered", q), q, _(gat->type->name) );
@@ -244,9 +386,6 @@ static int gatherable_gather( Gatherable *gat, Pilot *p )
          hooks_runParam( "gather", hparam );
       }
 
-      /* Remove the object from space. */
-      array_erase( &gatherable_stack, gat, gat+1 );
-
       /* Test if there is still cargo space */
       if ((pilot_cargoFree(p) < 1) && (pilot_isPlayer(p)))
          player_message( _("No more cargo space available") );
@@ -20,7 +20,9 @@ typedef struct Gatherable_ {
    int quantity;             /**< Quantity of material. */
    int sx;                   /**< X sprite to use. */
    int sy;                   /**< Y sprite to use. */
-   int player_only;           /**< Can only be gathered by player. */
+   int player_only;          /**< Can only be gathered by player. */
+   int slot;                 /**< Slot of the ID. */
+   int gathered;             /**< Gathered this frame, to be removed. */
 } Gatherable;
 
 /*
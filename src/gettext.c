@@ -5,6 +5,11 @@
  * @file gettext.c
  *
  * @brief PhysicsFS-aware gettext implementation.
+ *
+ * Lookups from the main thread, which is where the GUI and Lua do them, go
+ *  through a cache keyed by the address of the msgid. Since the addresses of
+ *  Lua strings get reused, entries also store a hash of the string and are only
+ *  used when it matches.
  */
 /** @cond */
 #include <ctype.h>
@@ -23,6 +28,8 @@
 #include "msgcat.h"
 #include "ndata.h"
 
+#define GETTEXT_CACHE_SIZE 4096 /**< Entries of the lookup cache, must be a power of two. */
+
 typedef struct translation {
    char *language;              /**< Language code (allocated string). */
    msgcat_t *chain;             /**< Array of message catalogs to try in order. */
@@ -30,13 +37,27 @@ typedef struct translation {
    struct translation *next;    /**< Next entry in the list of loaded translations. */
 } translation_t;
 
+/**
+ * @brief Entry of the lookup cache.
+ */
+typedef struct GettextCache_ {
+   const char *msgid;           /**< Address of the msgid, NULL if unused. */
+   uint32_t hash;               /**< Hash of the msgid string. */
+   int cat;                     /**< Catalog of the chain with the translation, -1 if untranslated. */
+   const char *trans;           /**< Translation of the singular form. */
+} GettextCache;
+
 static char *gettext_systemLanguage = NULL;             /**< Language, or :-delimited list of them, from the system at startup. */
 static translation_t *gettext_translations = NULL;      /**< Linked list of loaded translation chains. */
 static translation_t *gettext_activeTranslation = NULL; /**< Active language's code. */
 static uint32_t gettext_nstrings = 0;                   /**< Number of translatable strings in the game. */
+static GettextCache gettext_cache[GETTEXT_CACHE_SIZE];  /**< Lookup cache of the active translation. */
+static SDL_threadID gettext_mainThread = 0;             /**< Only thread using the cache. */
 
 static void gettext_readStats (void);
 static const char* gettext_matchLanguage( const char* lang, size_t lang_len, char*const* available );
+static uint32_t gettext_hash( const char *str );
+static const GettextCache *gettext_cacheGet( const char *msgid );
 
 /**
  * @brief Initialize the translation system.
@@ -47,6 +68,8 @@ void gettext_init (void)
 {
    const char *env_vars[] = {"LANGUAGE", "LC_ALL", "LC_MESSAGES", "LANG"};
 
+   gettext_mainThread = SDL_ThreadID();
+
    setlocale( LC_ALL, "" );
    /* If we don't disable LC_NUMERIC, lots of stuff blows up because 1,000 can be interpreted as
     * 1.0 in certain languages. */
@@ -82,6 +105,7 @@ void gettext_exit (void)
 {
    free( gettext_systemLanguage );
    gettext_systemLanguage = NULL;
+   memset( gettext_cache, 0, sizeof(gettext_cache) );
    while (gettext_translations != NULL) {
       for (int i = 0; i < array_size(gettext_translations->chain_lang); i++)
          free( gettext_translations->chain_lang[i] );
@@ -132,6 +156,9 @@ void gettext_setLanguage( const char* lang )
    if (gettext_activeTranslation != NULL && !strcmp( lang, gettext_activeTranslation->language ))
       return;
 
+   /* The cache is for the active translation. */
+   memset( gettext_cache, 0, sizeof(gettext_cache) );
+
    /* Search for the selected language in the loaded translations. */
    for (translation_t *ptrans = gettext_translations; ptrans != NULL; ptrans = ptrans->next)
       if (!strcmp( lang, ptrans->language )) {
@@ -216,6 +243,19 @@ static const char* gettext_matchLanguage( const char* lang, size_t lang_len, cha
  */
 const char* gettext_ngettext( const char* msgid, const char* msgid_plural, uint64_t n )
 {
+   /* Try the cache first. */
+   if ((gettext_activeTranslation != NULL) && (SDL_ThreadID() == gettext_mainThread)) {
+      const GettextCache *c = gettext_cacheGet( msgid );
+      if (c->cat < 0)
+         return n>1 && msgid_plural!=NULL ? msgid_plural : msgid;
+      if (msgid_plural == NULL)
+         return c->trans;
+      const char *trans = msgcat_plural( &gettext_activeTranslation->chain[ c->cat ], c->trans, n );
+      if (trans != NULL)
+         return trans;
+      /* Fall through to the next catalogs like an uncached lookup. */
+   }
+
    if (gettext_activeTranslation != NULL) {
       msgcat_t *chain = gettext_activeTranslation->chain;
       for (int i=0; i<array_size(chain); i++) {
@@ -228,6 +268,50 @@ const char* gettext_ngettext( const char* msgid, const char* msgid_plural, uint6
    return n>1 && msgid_plural!=NULL ? msgid_plural : msgid;
 }
 
+/**
+ * @brief FNV-1a hash of a string.
+ */
+static uint32_t gettext_hash( const char *str )
+{
+   uint32_t h = 2166136261u;
+   for (const unsigned char *s = (const unsigned char*)str; *s != '\0'; s++)
+      h = (h ^ *s) * 16777619u;
+   return h;
+}
+
+/**
+ * @brief Gets the cache entry of a msgid, looking it up if it's not cached.
+ *
+ *    @param msgid The English singular form.
+ *    @return The up to date cache entry.
+ */
+static const GettextCache *gettext_cacheGet( const char *msgid )
+{
+   uintptr_t key = (uintptr_t)msgid;
+   GettextCache *c = &gettext_cache[ ((key >> 3) * 2654435761u) & (GETTEXT_CACHE_SIZE-1) ];
+   uint32_t hash = gettext_hash( msgid );
+   const msgcat_t *chain;
+
+   if ((c->msgid == msgid) && (c->hash == hash))
+      return c;
+
+   /* Look through the catalogs. */
+   c->msgid = msgid;
+   c->hash  = hash;
+   c->cat   = -1;
+   c->trans = NULL;
+   chain = gettext_activeTranslation->chain;
+   for (int i=0; i<array_size(chain); i++) {
+      const char *trans = msgcat_lookup( &chain[i], msgid );
+      if (trans != NULL) {
+         c->cat   = i;
+         c->trans = trans;
+         break;
+      }
+   }
+   return c;
+}
+
 /**
  * @brief Helper function for p_(): Return _(lookup) with a fallback of msgid rather than lookup.
  */
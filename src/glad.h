@@ -9,6 +9,7 @@
     Extensions:
         GL_ARB_shader_subroutine,
         GL_ARB_texture_filter_anisotropic,
+        GL_ARB_timer_query,
         GL_KHR_debug
     Loader: True
     Local files: False
@@ -16,9 +17,9 @@
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=3.2" --generator="c" --spec="gl" --extensions="GL_ARB_shader_subroutine,GL_ARB_texture_filter_anisotropic,GL_KHR_debug"
+        --profile="core" --api="gl=3.2" --generator="c" --spec="gl" --extensions="GL_ARB_shader_subroutine,GL_ARB_texture_filter_anisotropic,GL_ARB_timer_query,GL_KHR_debug"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D3.2&extensions=GL_ARB_shader_subroutine&extensions=GL_ARB_texture_filter_anisotropic&extensions=GL_KHR_debug
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D3.2&extensions=GL_ARB_shader_subroutine&extensions=GL_ARB_texture_filter_anisotropic&extensions=GL_ARB_timer_query&extensions=GL_KHR_debug
 */
 
 
@@ -1940,6 +1941,8 @@ GLAPI PFNGLSAMPLEMASKIPROC glad_glSampleMaski;
 #define GL_COMPATIBLE_SUBROUTINES 0x8E4B
 #define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
 #define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#define GL_TIME_ELAPSED 0x88BF
+#define GL_TIMESTAMP 0x8E28
 #define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
 #define GL_DEBUG_NEXT_LOGGED_MESSAGE_LENGTH 0x8243
 #define GL_DEBUG_CALLBACK_FUNCTION 0x8244
@@ -2053,6 +2056,19 @@ GLAPI PFNGLGETPROGRAMSTAGEIVPROC glad_glGetProgramStageiv;
 #define GL_ARB_texture_filter_anisotropic 1
 GLAPI int GLAD_GL_ARB_texture_filter_anisotropic;
 #endif
+#ifndef GL_ARB_timer_query
+#define GL_ARB_timer_query 1
+GLAPI int GLAD_GL_ARB_timer_query;
+typedef void (APIENTRYP PFNGLQUERYCOUNTERPROC)(GLuint id, GLenum target);
+GLAPI PFNGLQUERYCOUNTERPROC glad_glQueryCounter;
+#define glQueryCounter glad_glQueryCounter
+typedef void (APIENTRYP PFNGLGETQUERYOBJECTI64VPROC)(GLuint id, GLenum pname, GLint64 *params);
+GLAPI PFNGLGETQUERYOBJECTI64VPROC glad_glGetQueryObjecti64v;
+#define glGetQueryObjecti64v glad_glGetQueryObjecti64v
+typedef void (APIENTRYP PFNGLGETQUERYOBJECTUI64VPROC)(GLuint id, GLenum pname, GLuint64 *params);
+GLAPI PFNGLGETQUERYOBJECTUI64VPROC glad_glGetQueryObjectui64v;
+#define glGetQueryObjectui64v glad_glGetQueryObjectui64v
+#endif
 #ifndef GL_KHR_debug
 #define GL_KHR_debug 1
 GLAPI int GLAD_GL_KHR_debug;
@@ -70,6 +70,7 @@
 
 #define RADAR_BLINK_PILOT     0.5 /**< Blink rate of the pilot target on radar. */
 #define RADAR_BLINK_SPOB      1. /**< Blink rate of the spob target on radar. */
+#define RADAR_CULL_MARGIN     20. /**< Extra radar pixels to look for pilots in, to include the marker size. */
 
 /* some blinking stuff. */
 static double blink_pilot     = 0.; /**< Timer on target blinking on radar. */
@@ -82,6 +83,7 @@ static gl_vbo *gui_radar_select_vbo = NULL;
 static int gui_getMessage     = 1; /**< Whether or not the player should receive messages. */
 static char *gui_name         = NULL; /**< Name of the GUI (for errors and such). */
 static IntList gui_qtquery; /**< For querying collisions. */
+static int *gui_radarPilots = NULL; /**< Stack indices of the pilots to show on the radar (array.h). */
 
 extern unsigned int land_wid; /**< From land.c */
 
@@ -139,6 +141,7 @@ typedef struct Mesg_ {
    char *str;  /**< The message (allocated). */
    char *dstr; /**< The display message. */
    double t;   /**< Time to live for the message. */
+   int h;      /**< Height of the message box, 0 if it has to be computed. */
    glFontRestore restore; /**< Hack for font restoration. */
 } Mesg;
 static Mesg* mesg_stack = NULL; /**< Stack of messages, will be of mesg_max size. */
@@ -188,9 +191,11 @@ static void gui_renderTargetReticles( const SimpleShader *shd, double x, double
 static void gui_borderIntersection( double *cx, double *cy, double rx, double ry, double hw, double hh );
 /* Render GUI. */
 static void gui_renderPilotTarget (void);
+static int gui_cmpIndex( const void *p1, const void *p2 );
 static void gui_renderSpobTarget (void);
 static void gui_renderBorder( double dt );
 static void gui_renderMessages( double dt );
+static void gui_messageResetHeights (void);
 static const glColour *gui_getSpobColour( int i );
 static void gui_renderRadarOutOfRange( RadarShape sh, int w, int h, int cx, int cy, const glColour *col );
 static void gui_blink( double cx, double cy, double vr, const glColour *col, double blinkInterval, double blinkVar );
@@ -222,6 +227,18 @@ void gui_messageInit( int width, int x, int y )
    gui_mesg_w = width;
    gui_mesg_x = x;
    gui_mesg_y = y;
+   gui_messageResetHeights();
+}
+
+/**
+ * @brief Makes the heights of the messages be computed again when rendered.
+ */
+static void gui_messageResetHeights (void)
+{
+   if (mesg_stack == NULL)
+      return;
+   for (int i=0; i<mesg_max; i++)
+      mesg_stack[i].h = 0;
 }
 
 /**
@@ -315,6 +332,7 @@ void player_messageRaw( const char *str )
          free( m->dstr );
          m->dup++;
          SDL_asprintf( &m->dstr, p_("player_message","%s x%d"), str, m->dup );
+         m->h = 0;
          if (gl_printWidthRaw( &gl_smallFont, m->dstr ) <= gui_mesg_w - ((str[0]=='\t') ? 45 : 15)) {
             m->t = mesg_timeout; /* Reset time out. */
             return;
@@ -344,6 +362,7 @@ void player_messageRaw( const char *str )
       }
       m->t = mesg_timeout;
       m->dup = 1;
+      m->h = 0;
 
       iter.width = gui_mesg_w - 45; /* Remaining lines are tabbed so it's shorter. */
    }
@@ -574,6 +593,9 @@ static void gui_renderBorder( double dt )
    gl_renderRect( 15., 0., SCREEN_W - 30., 15., &cBlackHilight );
    gl_renderRect( 15., SCREEN_H - 15., SCREEN_W - 30., 15., &cBlackHilight );
 
+   /* Spob and pilot indicators get drawn together. */
+   gl_batchBegin();
+
    /* Draw spobs. */
    for (int i=0; i<array_size(cur_system->spobs); i++) {
       const Spob *pnt = cur_system->spobs[i];
@@ -589,7 +611,7 @@ static void gui_renderBorder( double dt )
          gui_borderIntersection( &cx, &cy, rx, ry, hw, hh );
 
          col = gui_getSpobColour(i);
-         gl_renderCircle(cx, cy, 5, col, 0);
+         gl_renderMarker( OPENGL_MARKER_CIRCLE, cx, cy, 5., 5., 0., col );
       }
    }
 
@@ -632,10 +654,12 @@ static void gui_renderBorder( double dt )
          gui_borderIntersection( &cx, &cy, rx, ry, hw, hh );
 
          col = gui_getPilotColour(plt);
-         gl_renderRectEmpty(cx-5, cy-5, 10, 10, col);
+         gl_renderMarker( OPENGL_MARKER_BOX, cx, cy, 5., 5., 0., col );
       }
    }
 
+   gl_batchEnd();
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -865,7 +889,7 @@ void gui_render( double dt )
       }
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clear state. */
       glDisableVertexAttribArray( shaders.jump.vertex );
@@ -916,10 +940,12 @@ int gui_radarInit( int circle, int w, int h )
  */
 void gui_radarRender( double x, double y )
 {
-   int f;
    Radar *radar;
    mat4 view_matrix_prev;
    Pilot *const* pilot_stack;
+   const Pilot *target;
+   const IntList *nearby;
+   double radar_range;
 
    if (!conf.always_radar && ovr_isOpen())
       return;
@@ -967,18 +993,29 @@ void gui_radarRender( double x, double y )
    weapon_minimap( radar->res, radar->w, radar->h,
          radar->shape, 1. );
 
-   /* render the pilot */
+   /* The pilot and asteroid markers get drawn together. */
+   gl_batchBegin();
+
+   /* render the pilots in range of the radar */
    pilot_stack = pilot_getAll();
-   f = 0;
-   for (int i=1; i<array_size(pilot_stack); i++) { /* skip the player */
-      if (pilot_stack[i]->id == player.p->target)
-         f = i;
-      else
-         gui_renderPilot( pilot_stack[i], radar->shape, radar->w, radar->h, radar->res, 0 );
+   radar_range = radar->res * (((radar->shape==RADAR_CIRCLE) ? radar->w : MAX(radar->w,radar->h)/2.) + RADAR_CULL_MARGIN);
+   nearby = pilot_getNearby( player.p->solid.pos.x, player.p->solid.pos.y, radar_range );
+   array_resize( &gui_radarPilots, 0 );
+   for (int i=0; i<il_size(nearby); i++)
+      array_push_back( &gui_radarPilots, il_get( nearby, i, 0 ) );
+   qsort( gui_radarPilots, array_size(gui_radarPilots), sizeof(int), gui_cmpIndex );
+   for (int i=0; i<array_size(gui_radarPilots); i++) {
+      const Pilot *p = pilot_stack[ gui_radarPilots[i] ];
+      if ((i > 0) && (gui_radarPilots[i-1] == gui_radarPilots[i]))
+         continue;
+      if ((p == player.p) || (p->id == player.p->target))
+         continue;
+      gui_renderPilot( p, radar->shape, radar->w, radar->h, radar->res, 0 );
    }
-   /* render the targeted pilot */
-   if (f != 0)
-      gui_renderPilot( pilot_stack[f], radar->shape, radar->w, radar->h, radar->res, 0 );
+   /* render the targeted pilot, even out of range */
+   target = pilot_get( player.p->target );
+   if ((target != NULL) && (target != player.p))
+      gui_renderPilot( target, radar->shape, radar->w, radar->h, radar->res, 0 );
 
    /* Render the asteroids */
    for (int i=0; i<array_size(cur_system->asteroids); i++) {
@@ -995,6 +1032,8 @@ void gui_radarRender( double x, double y )
       }
    }
 
+   gl_batchEnd();
+
    /* Render the player. */
    gui_renderPlayer( radar->res, 0 );
 
@@ -1006,6 +1045,14 @@ void gui_radarRender( double x, double y )
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Compares pilot stack indices, to render them in stack order.
+ */
+static int gui_cmpIndex( const void *p1, const void *p2 )
+{
+   return *(const int*)p1 - *(const int*)p2;
+}
+
 /**
  * @brief Outputs the radar's resolution.
  *
@@ -1085,14 +1132,17 @@ static void gui_renderMessages( double dt )
          /* Only handle non-NULL messages. */
          if (mesg_stack[m].str != NULL) {
             const char *str = (mesg_stack[m].dstr!=NULL) ? mesg_stack[m].dstr : mesg_stack[m].str;
+            /* Messages are already wrapped, so their height only changes with them. */
+            if (mesg_stack[m].h <= 0)
+               mesg_stack[m].h = gl_printHeightRaw( &gl_smallFont, gui_mesg_w,
+                     (str[0] == '\t') ? &str[1] : str ) + 6;
+            dy = mesg_stack[m].h;
             if (str[0] == '\t') {
                gl_printRestore( &mesg_stack[m].restore );
-               dy = gl_printHeightRaw( &gl_smallFont, gui_mesg_w, &str[1]) + 6;
                gl_renderRect( x-4., y-1., gui_mesg_w-13., dy, &msgc );
                gl_printMaxRaw( &gl_smallFont, gui_mesg_w - 45., x + 30, y + 3, &cFontWhite, -1., &str[1] );
             }
             else {
-               dy = gl_printHeightRaw( &gl_smallFont, gui_mesg_w, str) + 6;
                gl_renderRect( x-4., y-1., gui_mesg_w-13., dy, &msgc );
                gl_printMaxRaw( &gl_smallFont, gui_mesg_w - 15., x, y + 3, &cFontWhite, -1., str );
             }
@@ -1207,8 +1257,7 @@ void gui_renderPilot( const Pilot* p, RadarShape shape, double w, double h, doub
       gl_renderShader( x, y, scale*2.0, scale*2.0, 0., &shaders.hilight, &highlighted, 1 );
    }
 
-   glUseProgram(shaders.pilotmarker.program);
-   gl_renderShader( x, y, scale, scale, p->solid.dir, &shaders.pilotmarker, col, 1 );
+   gl_renderMarker( OPENGL_MARKER_PILOT, x, y, scale, scale, p->solid.dir, col );
 
    /* Draw selection if targeted. */
    if (p->id == player.p->target)
@@ -1298,8 +1347,7 @@ void gui_renderAsteroid( const Asteroid* a, double w, double h, double res, int
 
    //gl_renderRect( px, py, MIN( 2*sx, w-px ), MIN( 2*sy, h-py ), col );
    r = (sx+sy)/2.0+1.5;
-   glUseProgram(shaders.asteroidmarker.program);
-   gl_renderShader( px, py, r, r, 0., &shaders.asteroidmarker, col, 1 );
+   gl_renderMarker( OPENGL_MARKER_ASTEROID, px, py, r, r, 0., col );
 
    if (targeted)
       gui_blink( px, py, MAX(7., 2.0*r), col, RADAR_BLINK_PILOT, blink_pilot );
@@ -1677,6 +1725,7 @@ int gui_init (void)
          return -1;
       }
    }
+   gui_messageResetHeights();
 
    /* VBO. */
    if (gui_radar_select_vbo == NULL) {
@@ -1711,6 +1760,7 @@ int gui_init (void)
 
    /* Quadtrees. */
    il_create( &gui_qtquery, 1 );
+   gui_radarPilots = array_create( int );
 
    return 0;
 }
@@ -1905,7 +1955,7 @@ int gui_exists( const char *name )
 {
    char path[PATH_MAX];
    snprintf( path, sizeof(path), GUI_PATH"%s.lua", name );
-   return PHYSFS_exists( path );
+   return ndata_exists( path );
 }
 
 /**
@@ -2069,6 +2119,8 @@ void gui_free (void)
    gui_target_pilot = NULL;
 
    il_destroy( &gui_qtquery );
+   array_free( gui_radarPilots );
+   gui_radarPilots = NULL;
 
    omsg_cleanup();
 }
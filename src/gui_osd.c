@@ -27,6 +27,8 @@ typedef struct OSD_s {
    int duplicates;   /**< How many duplicates of this OSD there are. */
    char *title;      /**< Title of the OSD. */
    char **titlew;    /**< Wrapped version of the title. */
+   int wrap_w;       /**< Width the text was wrapped at, 0 if not wrapped. */
+   int wrap_dup;     /**< Duplicates the wrapped title was made for. */
 
    char **msg;       /**< Array (array.h): Stored messages. */
    char ***items;    /**< Array of array (array.h) of allocated strings. */
@@ -152,12 +154,21 @@ unsigned int osd_create( const char *title, int nitems, const char **items, int
 
 /**
  * @brief Calculates the word-wrapped osd->items from osd->msg.
+ *
+ * The text of an OSD never changes, so it is only wrapped again when the
+ *  width, font or number of duplicates in the title change.
  */
 static void osd_wordwrap( OSD_t* osd )
 {
    glPrintLineIterator iter;
    char title[STRMAX_SHORT]; /* Needs to be in the scope of the entire function as it is used in gl_printLineIteratorNext indirectly. */
 
+   /* Still up to date. */
+   if ((osd->wrap_w == osd_w) && (osd->wrap_dup == osd->duplicates))
+      return;
+   osd->wrap_w   = osd_w;
+   osd->wrap_dup = osd->duplicates;
+
    /* Do title. */
    for (int i=0; i<array_size(osd->titlew); i++)
       free(osd->titlew[i]);
@@ -339,6 +350,10 @@ int osd_setup( int x, int y, int w, int h )
    osd_tabLen = gl_printWidthRaw( &gl_smallFont, "   " );
    osd_hyphenLen = gl_printWidthRaw( &gl_smallFont, "- " );
 
+   /* Font or width may have changed, so everything has to be wrapped again. */
+   for (int i=0; i<array_size(osd_list); i++)
+      osd_list[i].wrap_w = 0;
+
    osd_calcDimensions();
 
    return 0;
@@ -31,6 +31,7 @@
 #include "array.h"
 #include "claim.h"
 #include "event.h"
+#include "frametime.h"
 #include "gatherable.h"
 #include "log.h"
 #include "menu.h"
@@ -45,6 +46,7 @@
 #include "ntracing.h"
 #include "nxml.h"
 #include "player.h"
+#include "rng.h"
 #include "space.h"
 
 /**
@@ -79,7 +81,8 @@ typedef struct Hook_ {
    struct Hook_ *next; /**< Linked list. */
 
    unsigned int id; /**< unique id */
-   char *stack; /**< stack it's a part of */
+   const char *stack; /**< stack it's a part of (interned) */
+   int stackid; /**< Interned id of the stack. */
    int created; /**< Hook has just been created. */
    int delete; /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating. */
@@ -87,12 +90,17 @@ typedef struct Hook_ {
 
    /* Timer information. */
    int is_timer; /**< Whether or not is actually a timer. */
-   double ms; /**< Milliseconds left. */
+   double ms; /**< Value of hook_timer_time at which it triggers. */
+   uint64_t wheel_expire; /**< Timer wheel tick at which it triggers. */
+   int wheel_level; /**< Level of the timer wheel it is in, -1 if not in it. */
+   int wheel_slot; /**< Slot of the timer wheel level it is in. */
+   int wheel_idx; /**< Position in the timer wheel slot. */
 
    /* Date information. */
    int is_date; /**< Whether or not it is a date hook. */
    ntime_t res; /**< Resolution to display. */
-   ntime_t acc; /**< Accumulated resolution. */
+   ntime_t due; /**< Value of hook_date at which it triggers. */
+   int date_idx; /**< Position in the date queue, -1 if not in it. */
 
    HookType_t type; /**< Type of hook. */
    union {
@@ -119,6 +127,51 @@ static Hook* hook_list        = NULL; /**< Stack of hooks. */
 static int hook_runningstack  = 0; /**< Check if stack is running. */
 static int hook_loadingstack  = 0; /**< Check if the hooks are being loaded. */
 
+/**
+ * @brief Hooks sharing a stack name.
+ */
+typedef struct HookStack_ {
+   char *name;    /**< Name of the stack. */
+   Hook **hooks;  /**< Array (array.h): Hooks of the stack, oldest first. */
+} HookStack;
+static HookStack *hook_stacks = NULL; /**< Array (array.h): Interned stacks, indexed by stack id. */
+static int *hook_stacksSorted = NULL; /**< Array (array.h): Stack ids sorted by name. */
+static Hook **hook_ids        = NULL; /**< Array (array.h): Hooks sorted by id. */
+static Hook **hook_expired    = NULL; /**< Array (array.h): Timer or date hooks being run. */
+
+/*
+ * Timer hooks are kept in a hierarchical timer wheel of millisecond ticks. The
+ *  first level has a slot per tick, and each following level has slots covering
+ *  a whole turn of the previous one. Timers are moved down a level when the
+ *  level below wraps around, so every timer is only touched a handful of times.
+ */
+#define HOOK_WHEEL_TICK    1e-3  /**< Length of a timer wheel tick in seconds. */
+#define HOOK_WHEEL_LEVELS  4     /**< Levels of the timer wheel. */
+#define HOOK_WHEEL_BITS0   8     /**< Bits of the first level of the wheel. */
+#define HOOK_WHEEL_BITS    6     /**< Bits of the other levels of the wheel. */
+#define HOOK_WHEEL_MASK0   ((1<<HOOK_WHEEL_BITS0)-1) /**< Slot mask of the first level. */
+#define HOOK_WHEEL_MASK    ((1<<HOOK_WHEEL_BITS)-1) /**< Slot mask of the other levels. */
+#define HOOK_WHEEL_RANGE   ((uint64_t)1 << (HOOK_WHEEL_BITS0 + (HOOK_WHEEL_LEVELS-1)*HOOK_WHEEL_BITS)) /**< Ticks covered by the wheel. */
+static Hook **hook_wheel[HOOK_WHEEL_LEVELS][1<<HOOK_WHEEL_BITS0]; /**< Array (array.h): Timer hooks of each slot. */
+static Hook **hook_wheel_cascade = NULL; /**< Array (array.h): Timers being moved down a level. */
+static uint64_t hook_wheel_tick = 0; /**< Current tick of the timer wheel. */
+static int hook_wheel_count   = 0; /**< Number of timers in the wheel. */
+static double hook_timer_time = 0.; /**< Time the timers have been updated for. */
+
+#define HOOK_BENCHMARK_DATE   1000 /**< Date change per update in hooks_benchmark. */
+
+static Hook **hook_dates      = NULL; /**< Array (array.h): Min-heap of date hooks by due date. */
+static ntime_t hook_date      = 0; /**< Accumulated date changes. */
+
+/*
+ * Parameters are only converted to Lua when a hook actually runs. When a stack
+ *  has several hooks, they are converted once into a table shared by all of
+ *  them, and pilots reuse the same userdata for the whole frame.
+ */
+static const HookParam *hook_paramCur = NULL; /**< Parameters shared by the running stack. */
+static int hook_paramRef      = LUA_NOREF; /**< Table of the converted shared parameters. */
+static int hook_pilotRef      = LUA_NOREF; /**< Table of the pilot userdata of the frame by id. */
+
 /*
  * prototypes
  */
@@ -129,8 +182,27 @@ static void hooks_updateDateExecute( ntime_t change );
 static void hook_rmRaw( Hook *h );
 static void hooks_purgeList (void);
 static Hook* hook_get( unsigned int id );
+static int hook_stackID( const char *stack, int create );
+static void hook_indexAdd( Hook *h );
+static void hook_indexRemove( Hook *h );
+static void hook_setID( Hook *h, unsigned int id );
+static void hook_dateSwap( int i, int j );
+static void hook_dateUp( int i );
+static void hook_dateDown( int i );
+static void hook_datePush( Hook *h );
+static void hook_dateRemove( Hook *h );
+static void hook_dateSet( Hook *h, ntime_t resolution );
+static void hook_dateExpire( ntime_t change, Hook ***expired );
+static void hook_dateRequeue( Hook *h );
+static void hook_wheelAdd( Hook *h );
+static void hook_wheelRemove( Hook *h );
+static void hook_wheelTake( int level, int slot, Hook ***out );
+static void hook_timerExpire( double dt, Hook ***expired );
+static void hook_timerPush( Hook *h );
 static unsigned int hook_genID (void);
 static Hook* hook_new( HookType_t type, const char *stack );
+static void hook_pushPilot( LuaPilot lp );
+static void hook_pushParam( const HookParam *param );
 static int hook_parseParam( const HookParam *param );
 static int hook_runMisn( Hook *hook, const HookParam *param, int claims );
 static int hook_runEvent( Hook *hook, const HookParam *param, int claims );
@@ -202,6 +274,10 @@ void hook_exclusionEnd( double dt )
    ntime_t temp;
    hook_atomic = 0;
 
+   /* New frame, the pilot userdata are no longer shared. */
+   luaL_unref( naevL, LUA_REGISTRYINDEX, hook_pilotRef );
+   hook_pilotRef = LUA_NOREF;
+
    /* Handle hook queue. */
    while (hook_queue != NULL) {
       /* Move hook down. */
@@ -231,9 +307,86 @@ void hook_exclusionEnd( double dt )
    hooks_purgeList();
 }
 
+/**
+ * @brief Pushes a pilot, reusing its userdata if it was pushed this frame.
+ *
+ *    @param lp Pilot to push.
+ */
+static void hook_pushPilot( LuaPilot lp )
+{
+   if (hook_pilotRef == LUA_NOREF) {
+      lua_newtable( naevL );
+      hook_pilotRef = luaL_ref( naevL, LUA_REGISTRYINDEX );
+   }
+   lua_rawgeti( naevL, LUA_REGISTRYINDEX, hook_pilotRef ); /* t */
+   lua_rawgeti( naevL, -1, lp );             /* t, p */
+   if (lua_isnil( naevL, -1 )) {
+      lua_pop( naevL, 1 );                   /* t */
+      lua_pushpilot( naevL, lp );            /* t, p */
+      lua_pushvalue( naevL, -1 );            /* t, p, p */
+      lua_rawseti( naevL, -3, lp );          /* t, p */
+   }
+   lua_remove( naevL, -2 );                  /* p */
+}
+
+/**
+ * @brief Pushes a single hook parameter.
+ *
+ *    @param param Parameter to push.
+ */
+static void hook_pushParam( const HookParam *param )
+{
+   switch (param->type) {
+      case HOOK_PARAM_NIL:
+         lua_pushnil( naevL );
+         break;
+      case HOOK_PARAM_NUMBER:
+         lua_pushnumber( naevL, param->u.num );
+         break;
+      case HOOK_PARAM_STRING:
+         lua_pushstring( naevL, param->u.str );
+         break;
+      case HOOK_PARAM_BOOL:
+         lua_pushboolean( naevL, param->u.b );
+         break;
+      case HOOK_PARAM_PILOT:
+         hook_pushPilot( param->u.lp );
+         break;
+      case HOOK_PARAM_SHIP:
+         lua_pushship( naevL, param->u.ship );
+         break;
+      case HOOK_PARAM_OUTFIT:
+         lua_pushoutfit( naevL, param->u.outfit );
+         break;
+      case HOOK_PARAM_COMMODITY:
+         lua_pushcommodity( naevL, param->u.commodity );
+         break;
+      case HOOK_PARAM_FACTION:
+         lua_pushfaction( naevL, param->u.lf );
+         break;
+      case HOOK_PARAM_SPOB:
+         lua_pushspob( naevL, param->u.la );
+         break;
+      case HOOK_PARAM_JUMP:
+         lua_pushjump( naevL, param->u.lj );
+         break;
+      case HOOK_PARAM_REF:
+         lua_rawgeti( naevL, LUA_REGISTRYINDEX, param->u.ref );
+         break;
+
+      default:
+         WARN( _("Unknown Lua parameter type.") );
+         lua_pushnil( naevL );
+         break;
+   }
+}
+
 /**
  * @brief Parses hook parameters.
  *
+ * Parameters shared by the running stack are converted the first time and
+ *  then pushed from the cache for the other hooks.
+ *
  *    @param param Parameters to process.
  *    @return Parameters found.
  */
@@ -244,54 +397,28 @@ static int hook_parseParam( const HookParam *param )
    if (param == NULL)
       return 0;
 
-   n = 0;
-   while (param[n].type != HOOK_PARAM_SENTINEL) {
-      switch (param[n].type) {
-         case HOOK_PARAM_NIL:
-            lua_pushnil( naevL );
-            break;
-         case HOOK_PARAM_NUMBER:
-            lua_pushnumber( naevL, param[n].u.num );
-            break;
-         case HOOK_PARAM_STRING:
-            lua_pushstring( naevL, param[n].u.str );
-            break;
-         case HOOK_PARAM_BOOL:
-            lua_pushboolean( naevL, param[n].u.b );
-            break;
-         case HOOK_PARAM_PILOT:
-            lua_pushpilot( naevL, param[n].u.lp );
-            break;
-         case HOOK_PARAM_SHIP:
-            lua_pushship( naevL, param[n].u.ship );
-            break;
-         case HOOK_PARAM_OUTFIT:
-            lua_pushoutfit( naevL, param[n].u.outfit );
-            break;
-         case HOOK_PARAM_COMMODITY:
-            lua_pushcommodity( naevL, param[n].u.commodity );
-            break;
-         case HOOK_PARAM_FACTION:
-            lua_pushfaction( naevL, param[n].u.lf );
-            break;
-         case HOOK_PARAM_SPOB:
-            lua_pushspob( naevL, param[n].u.la );
-            break;
-         case HOOK_PARAM_JUMP:
-            lua_pushjump( naevL, param[n].u.lj );
-            break;
-         case HOOK_PARAM_REF:
-            lua_rawgeti( naevL, LUA_REGISTRYINDEX, param[n].u.ref );
-            break;
+   /* Not shared, just push them. */
+   if (param != hook_paramCur) {
+      for (n=0; param[n].type != HOOK_PARAM_SENTINEL; n++)
+         hook_pushParam( &param[n] );
+      return n;
+   }
 
-         default:
-            WARN( _("Unknown Lua parameter type.") );
-            lua_pushnil( naevL );
-            break;
+   /* Convert them for the whole stack. */
+   if (hook_paramRef == LUA_NOREF) {
+      lua_newtable( naevL );
+      for (n=0; param[n].type != HOOK_PARAM_SENTINEL; n++) {
+         hook_pushParam( &param[n] );
+         lua_rawseti( naevL, -2, n+1 );
       }
-      n++;
+      hook_paramRef = luaL_ref( naevL, LUA_REGISTRYINDEX );
    }
 
+   lua_rawgeti( naevL, LUA_REGISTRYINDEX, hook_paramRef ); /* t */
+   for (n=0; param[n].type != HOOK_PARAM_SENTINEL; n++) {
+      lua_rawgeti( naevL, -1-n, n+1 );       /* t, ..., p */
+   }
+   lua_remove( naevL, -1-n );                /* ... */
    return n;
 }
 
@@ -422,6 +549,7 @@ static int hook_run( Hook *hook, const HookParam *param, int claims )
    if (menu_isOpen(MENU_MAIN))
       return 0;
 
+   frametime_addCount( FRAME_COUNT_HOOKS, 1 );
    switch (hook->type) {
       case HOOK_TYPE_MISN:
          ret = hook_runMisn(hook, param, claims);
@@ -462,13 +590,400 @@ static unsigned int hook_genID (void)
       return id;
 
    /* Must check ids for collisions. */
-   for (Hook *h=hook_list; h!=NULL; h=h->next)
-      if (id == h->id) /* Check for collision. */
-         return hook_genID(); /* recursively try again */
+   if (hook_get( id ) != NULL)
+      return hook_genID(); /* recursively try again */
+
+   return id;
+}
+
+/**
+ * @brief Compares a stack name with an interned stack for bsearch.
+ */
+static int hook_stackCmp( const void *key, const void *p )
+{
+   const int *id = p;
+   return strcmp( key, hook_stacks[*id].name );
+}
+
+/**
+ * @brief Gets the interned id of a stack.
+ *
+ *    @param stack Name of the stack.
+ *    @param create Whether to intern it if it doesn't exist.
+ *    @return The id of the stack or -1 if not found.
+ */
+static int hook_stackID( const char *stack, int create )
+{
+   const int *found;
+   HookStack *hs;
+   int id, pos;
+
+   found = bsearch( stack, hook_stacksSorted, array_size(hook_stacksSorted), sizeof(int), hook_stackCmp );
+   if (found != NULL)
+      return *found;
+   if (!create)
+      return -1;
 
+   /* Intern. */
+   if (hook_stacks == NULL) {
+      hook_stacks = array_create( HookStack );
+      hook_stacksSorted = array_create( int );
+   }
+   id = array_size(hook_stacks);
+   hs = &array_grow( &hook_stacks );
+   hs->name  = strdup( stack );
+   hs->hooks = array_create( Hook* );
+
+   /* Keep the names sorted. */
+   for (pos=0; pos<array_size(hook_stacksSorted); pos++)
+      if (strcmp( stack, hook_stacks[ hook_stacksSorted[pos] ].name ) < 0)
+         break;
+   array_push_back( &hook_stacksSorted, id );
+   memmove( &hook_stacksSorted[pos+1], &hook_stacksSorted[pos],
+         (array_size(hook_stacksSorted)-pos-1) * sizeof(int) );
+   hook_stacksSorted[pos] = id;
    return id;
 }
 
+/**
+ * @brief Gets the position a hook id has or would have in the id index.
+ */
+static int hook_idPos( unsigned int id )
+{
+   int lo = 0, hi = array_size(hook_ids);
+   while (lo < hi) {
+      int mid = (lo+hi) / 2;
+      if (hook_ids[mid]->id < id)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+/**
+ * @brief Adds a hook to the stack and id indices.
+ */
+static void hook_indexAdd( Hook *h )
+{
+   int pos;
+
+   /* Stack. */
+   array_push_back( &hook_stacks[h->stackid].hooks, h );
+
+   /* Id, usually the highest so it just gets appended. */
+   if (hook_ids == NULL)
+      hook_ids = array_create( Hook* );
+   pos = ((array_size(hook_ids) == 0) || (array_back(hook_ids)->id < h->id)) ?
+         array_size(hook_ids) : hook_idPos( h->id );
+   array_push_back( &hook_ids, h );
+   memmove( &hook_ids[pos+1], &hook_ids[pos], (array_size(hook_ids)-pos-1) * sizeof(Hook*) );
+   hook_ids[pos] = h;
+}
+
+/**
+ * @brief Removes a hook from the stack, id, timer and date indices.
+ */
+static void hook_indexRemove( Hook *h )
+{
+   Hook **hooks = hook_stacks[h->stackid].hooks;
+   int pos;
+
+   for (int i=0; i<array_size(hooks); i++) {
+      if (hooks[i] == h) {
+         array_erase( &hook_stacks[h->stackid].hooks, &hooks[i], &hooks[i+1] );
+         break;
+      }
+   }
+
+   pos = hook_idPos( h->id );
+   if ((pos < array_size(hook_ids)) && (hook_ids[pos] == h))
+      array_erase( &hook_ids, &hook_ids[pos], &hook_ids[pos+1] );
+
+   hook_wheelRemove( h );
+   hook_dateRemove( h );
+}
+
+/**
+ * @brief Changes the id of a hook.
+ */
+static void hook_setID( Hook *h, unsigned int id )
+{
+   int pos = hook_idPos( h->id );
+   if ((pos < array_size(hook_ids)) && (hook_ids[pos] == h))
+      array_erase( &hook_ids, &hook_ids[pos], &hook_ids[pos+1] );
+   h->id = id;
+   pos = hook_idPos( id );
+   array_push_back( &hook_ids, h );
+   memmove( &hook_ids[pos+1], &hook_ids[pos], (array_size(hook_ids)-pos-1) * sizeof(Hook*) );
+   hook_ids[pos] = h;
+}
+
+/**
+ * @brief Swaps two date hooks in the queue.
+ */
+static void hook_dateSwap( int i, int j )
+{
+   Hook *h = hook_dates[i];
+   hook_dates[i] = hook_dates[j];
+   hook_dates[j] = h;
+   hook_dates[i]->date_idx = i;
+   hook_dates[j]->date_idx = j;
+}
+
+/**
+ * @brief Moves a date hook up the queue.
+ */
+static void hook_dateUp( int i )
+{
+   while (i > 0) {
+      int parent = (i-1) / 2;
+      if (hook_dates[parent]->due <= hook_dates[i]->due)
+         break;
+      hook_dateSwap( i, parent );
+      i = parent;
+   }
+}
+
+/**
+ * @brief Moves a date hook down the queue.
+ */
+static void hook_dateDown( int i )
+{
+   int n = array_size(hook_dates);
+   while (1) {
+      int l = 2*i+1;
+      int r = l+1;
+      int m = i;
+      if ((l < n) && (hook_dates[l]->due < hook_dates[m]->due))
+         m = l;
+      if ((r < n) && (hook_dates[r]->due < hook_dates[m]->due))
+         m = r;
+      if (m == i)
+         break;
+      hook_dateSwap( i, m );
+      i = m;
+   }
+}
+
+/**
+ * @brief Adds a date hook to the queue.
+ */
+static void hook_datePush( Hook *h )
+{
+   if (hook_dates == NULL)
+      hook_dates = array_create( Hook* );
+   h->date_idx = array_size(hook_dates);
+   array_push_back( &hook_dates, h );
+   hook_dateUp( h->date_idx );
+}
+
+/**
+ * @brief Removes a date hook from the queue if it is in it.
+ */
+static void hook_dateRemove( Hook *h )
+{
+   int i = h->date_idx;
+   int last = array_size(hook_dates)-1;
+   if (i < 0)
+      return;
+   h->date_idx = -1;
+   if (i != last) {
+      hook_dates[i] = hook_dates[last];
+      hook_dates[i]->date_idx = i;
+   }
+   array_erase( &hook_dates, &hook_dates[last], &hook_dates[last+1] );
+   if (i < last) {
+      hook_dateUp( i );
+      hook_dateDown( hook_dates[i]->date_idx );
+   }
+}
+
+/**
+ * @brief Adds a timer hook to the wheel slot matching its expiry tick.
+ */
+static void hook_wheelAdd( Hook *h )
+{
+   uint64_t e = h->wheel_expire;
+   uint64_t d;
+   int level = 0, shift = 0, slot;
+   Hook ***hooks;
+
+   /* When cascading, timers due on the current tick go to the slot about to be run. */
+   d = e - hook_wheel_tick;
+
+   /* Timers past the last level wait at its end and get placed again when it cascades. */
+   if (d >= HOOK_WHEEL_RANGE) {
+      e = hook_wheel_tick + HOOK_WHEEL_RANGE - 1;
+      d = HOOK_WHEEL_RANGE - 1;
+   }
+   while (d >= ((uint64_t)1 << (HOOK_WHEEL_BITS0 + level*HOOK_WHEEL_BITS))) {
+      shift = HOOK_WHEEL_BITS0 + level*HOOK_WHEEL_BITS;
+      level++;
+   }
+   slot = (e >> shift) & ((level==0) ? HOOK_WHEEL_MASK0 : HOOK_WHEEL_MASK);
+
+   hooks = &hook_wheel[level][slot];
+   if (*hooks == NULL)
+      *hooks = array_create( Hook* );
+   h->wheel_level = level;
+   h->wheel_slot  = slot;
+   h->wheel_idx   = array_size(*hooks);
+   array_push_back( hooks, h );
+   hook_wheel_count++;
+}
+
+/**
+ * @brief Removes a timer hook from the wheel if it is in it.
+ */
+static void hook_wheelRemove( Hook *h )
+{
+   Hook **hooks;
+   int last;
+   if (h->wheel_level < 0)
+      return;
+   hooks = hook_wheel[h->wheel_level][h->wheel_slot];
+   last  = array_size(hooks)-1;
+   if (h->wheel_idx != last) {
+      hooks[h->wheel_idx] = hooks[last];
+      hooks[h->wheel_idx]->wheel_idx = h->wheel_idx;
+   }
+   array_erase( &hook_wheel[h->wheel_level][h->wheel_slot], &hooks[last], &hooks[last+1] );
+   h->wheel_level = -1;
+   hook_wheel_count--;
+}
+
+/**
+ * @brief Takes all the timers out of a wheel slot.
+ *
+ *    @param level Level of the slot.
+ *    @param slot Slot to empty.
+ *    @param[out] out Array (array.h) to append the timers to.
+ */
+static void hook_wheelTake( int level, int slot, Hook ***out )
+{
+   Hook **hooks = hook_wheel[level][slot];
+   int n = array_size(hooks);
+   for (int i=0; i<n; i++) {
+      hooks[i]->wheel_level = -1;
+      array_push_back( out, hooks[i] );
+   }
+   if (n > 0)
+      array_erase( &hook_wheel[level][slot], array_begin(hooks), array_end(hooks) );
+   hook_wheel_count -= n;
+}
+
+/**
+ * @brief Compares timers by trigger time.
+ */
+static int hook_timerCmp( const void *p1, const void *p2 )
+{
+   const Hook *h1 = *(const Hook**) p1;
+   const Hook *h2 = *(const Hook**) p2;
+   if (h1->ms < h2->ms)
+      return -1;
+   else if (h1->ms > h2->ms)
+      return +1;
+   return (h1->id < h2->id) ? -1 : (h1->id > h2->id);
+}
+
+/**
+ * @brief Advances the timer wheel, taking out the timers that are due.
+ *
+ * Only the slots for the ticks that went by and the slots of the higher levels
+ *  that wrap around are visited, timers that are not due are left untouched.
+ *
+ *    @param dt Time to advance in seconds.
+ *    @param[out] expired Array (array.h) to append the due timers to, sorted by trigger time.
+ */
+static void hook_timerExpire( double dt, Hook ***expired )
+{
+   uint64_t target;
+   int n = array_size(*expired);
+
+   hook_timer_time += dt;
+   target = (uint64_t)floor( hook_timer_time / HOOK_WHEEL_TICK );
+
+   while (hook_wheel_tick < target) {
+      int slot;
+
+      /* Nothing left to find. */
+      if (hook_wheel_count == 0) {
+         hook_wheel_tick = target;
+         break;
+      }
+
+      hook_wheel_tick++;
+      slot = hook_wheel_tick & HOOK_WHEEL_MASK0;
+
+      /* Cascade the higher levels when the lower one wraps around. */
+      for (int l=1; (slot==0) && (l<HOOK_WHEEL_LEVELS); l++) {
+         int shift = HOOK_WHEEL_BITS0 + (l-1)*HOOK_WHEEL_BITS;
+         int s = (hook_wheel_tick >> shift) & HOOK_WHEEL_MASK;
+         hook_wheelTake( l, s, &hook_wheel_cascade );
+         for (int i=0; i<array_size(hook_wheel_cascade); i++)
+            hook_wheelAdd( hook_wheel_cascade[i] );
+         array_erase( &hook_wheel_cascade, array_begin(hook_wheel_cascade), array_end(hook_wheel_cascade) );
+         slot = s;
+      }
+
+      hook_wheelTake( 0, hook_wheel_tick & HOOK_WHEEL_MASK0, expired );
+   }
+
+   /* Timers that expire on the same frame run in order. */
+   if (array_size(*expired) - n > 1)
+      qsort( &(*expired)[n], array_size(*expired) - n, sizeof(Hook*), hook_timerCmp );
+}
+
+/**
+ * @brief Adds a timer hook to the wheel.
+ */
+static void hook_timerPush( Hook *h )
+{
+   /* Due timers run on the next tick. */
+   double e = ceil( h->ms / HOOK_WHEEL_TICK );
+   h->wheel_expire = (e > (double)hook_wheel_tick) ? (uint64_t)e : hook_wheel_tick+1;
+   hook_wheelAdd( h );
+}
+
+/**
+ * @brief Sets the resolution of a date hook and queues it.
+ */
+static void hook_dateSet( Hook *h, ntime_t resolution )
+{
+   h->is_date  = 1;
+   h->res      = resolution;
+   h->due      = hook_date + resolution;
+   hook_datePush( h );
+}
+
+/**
+ * @brief Advances the date, taking out the date hooks that are due.
+ *
+ *    @param change Change of the date.
+ *    @param[out] expired Array (array.h) to append the due date hooks to.
+ */
+static void hook_dateExpire( ntime_t change, Hook ***expired )
+{
+   hook_date += change;
+   while ((array_size(hook_dates) > 0) && (hook_dates[0]->due <= hook_date)) {
+      Hook *h = hook_dates[0];
+      hook_dateRemove( h );
+      array_push_back( expired, h );
+   }
+}
+
+/**
+ * @brief Queues again a date hook that has been taken out.
+ */
+static void hook_dateRequeue( Hook *h )
+{
+   /* Skip all the periods that went by, as the accumulator did. */
+   if ((h->due <= hook_date) && (h->res > 0))
+      h->due = hook_date - (hook_date - (h->due - h->res)) % h->res + h->res;
+   hook_datePush( h );
+}
+
 /**
  * @brief Generates and allocates a new hook.
  *
@@ -491,8 +1006,12 @@ static Hook* hook_new( HookType_t type, const char *stack )
    /* Fill out generic details. */
    new_hook->type    = type;
    new_hook->id      = hook_genID();
-   new_hook->stack   = strdup(stack);
+   new_hook->stackid = hook_stackID( stack, 1 );
+   new_hook->stack   = hook_stacks[ new_hook->stackid ].name;
    new_hook->created = 1;
+   new_hook->wheel_level = -1;
+   new_hook->date_idx = -1;
+   hook_indexAdd( new_hook );
 
    /** @TODO fix this hack. */
    if (strcmp(stack,"safe")==0)
@@ -560,7 +1079,8 @@ unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms
 
    /* Timer information. */
    new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   new_hook->ms            = hook_timer_time + ms;
+   hook_timerPush( new_hook );
 
    return new_hook->id;
 }
@@ -584,7 +1104,8 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
 
    /* Timer information. */
    new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   new_hook->ms            = hook_timer_time + ms;
+   hook_timerPush( new_hook );
 
    return new_hook->id;
 }
@@ -628,6 +1149,7 @@ static void hooks_purgeList (void)
 
          /* Free. */
          h->next = NULL;
+         hook_indexRemove( h );
          hook_free( h );
 
          /* Last. */
@@ -660,41 +1182,41 @@ static void hooks_updateDateExecute( ntime_t change )
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
-   /* Clear creation flags. */
-   for (Hook *h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   /* Take out the date hooks that are due, hooks created while running wait for the next change. */
+   if (hook_expired == NULL)
+      hook_expired = array_create( Hook* );
+   hook_dateExpire( change, &hook_expired );
 
-   /* On j=0 we increment all timers and try to run, then on j=1 we update the timers. */
+   /* On j=1 we run the hooks with claims, then on j=0 the rest. */
    hook_runningstack++; /* running hooks */
    for (int j=1; j>=0; j--) {
-      for (Hook *h=hook_list; h!=NULL; h=h->next) {
+      for (int i=0; i<array_size(hook_expired); i++) {
+         Hook *h = hook_expired[i];
          /* Not be deleting. */
          if (h->delete)
             continue;
-         /* Find valid date hooks. */
-         if (h->is_date == 0)
-            continue;
-         /* Don't update newly created hooks. */
-         if (h->created != 0)
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if (j==1)
-            h->acc += change;
-         if (h->acc < h->res)
-            continue;
 
          /* Run the timer hook. */
          hook_run( h, NULL, j );
          /* Date hooks are not deleted. */
 
-         /* Time is modified at the end. */
-         if (j==0)
-            h->acc %= h->res; /* We'll skip all buggers. */
+         /* If hook_cleanup was run, hook_list will be NULL */
+         if (hook_list==NULL)
+            break;
       }
+      if (hook_list==NULL)
+         break;
    }
    hook_runningstack--; /* not running hooks anymore */
 
+   /* Queue them again for their next period. */
+   if (hook_list == NULL)
+      return;
+   for (int i=0; i<array_size(hook_expired); i++)
+      if (!hook_expired[i]->delete)
+         hook_dateRequeue( hook_expired[i] );
+   array_erase( &hook_expired, array_begin(hook_expired), array_end(hook_expired) );
+
    /* Second pass to delete. */
    hooks_purgeList();
 }
@@ -709,9 +1231,7 @@ unsigned int hook_addDateMisn( unsigned int parent, const char *func, ntime_t re
    new_hook->u.misn.func   = strdup(func);
 
    /* Timer information. */
-   new_hook->is_date       = 1;
-   new_hook->res           = resolution;
-   new_hook->acc           = 0;
+   hook_dateSet( new_hook, resolution );
 
    return new_hook->id;
 }
@@ -726,9 +1246,7 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
    new_hook->u.event.func   = strdup(func);
 
    /* Timer information. */
-   new_hook->is_date       = 1;
-   new_hook->res           = resolution;
-   new_hook->acc           = 0;
+   hook_dateSet( new_hook, resolution );
 
    return new_hook->id;
 }
@@ -738,47 +1256,106 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
  */
 void hooks_update( double dt )
 {
-   Hook *h;
-
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING) || player_isFlag(PLAYER_DESTROYED))
       return;
 
-   /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   /* Take out the timers that are due, timers added from now on only start counting on the next update. */
+   if (hook_expired == NULL)
+      hook_expired = array_create( Hook* );
+   hook_timerExpire( dt, &hook_expired );
 
    hook_runningstack++; /* running hooks */
    for (int j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      for (int i=0; i<array_size(hook_expired); i++) {
+         Hook *h = hook_expired[i];
          /* Not be deleting. */
          if (h->delete)
             continue;
-         /* Find valid timer hooks. */
-         if (h->is_timer == 0)
-            continue;
-         /* Don't update newly created hooks. */
-         if (h->created != 0)
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if (j==1)
-            h->ms -= dt;
-         if (h->ms > 0.)
-            continue;
 
          /* Run the timer hook. */
          hook_run( h, NULL, j );
          if (h->ran_once) /* Remove when run. */
             hook_rmRaw( h );
+
+         /* If hook_cleanup was run, hook_list will be NULL */
+         if (hook_list==NULL)
+            break;
       }
+      if (hook_list==NULL)
+         break;
    }
    hook_runningstack--; /* not running hooks anymore */
 
+   /* Timers that could not run are due again next update. */
+   if (hook_list == NULL)
+      return;
+   for (int i=0; i<array_size(hook_expired); i++)
+      if (!hook_expired[i]->delete)
+         hook_timerPush( hook_expired[i] );
+   array_erase( &hook_expired, array_begin(hook_expired), array_end(hook_expired) );
+
    /* Second pass to delete. */
    hooks_purgeList();
 }
 
+/**
+ * @brief Measures the cost of keeping track of timer and date hooks.
+ *
+ * Adds timer and date hooks spread over the run and advances them like
+ *  hooks_update and hooks_updateDate do, without running them. Due timers are
+ *  removed and due date hooks are queued again.
+ *
+ *    @param nhooks Number of timer hooks and of date hooks to add.
+ *    @param n Number of updates to run.
+ *    @param dt Time step of the updates.
+ *    @param[out] timers Performance counter ticks spent on the timer hooks.
+ *    @param[out] dates Performance counter ticks spent on the date hooks.
+ *    @return Number of times a hook was due.
+ */
+int hooks_benchmark( int nhooks, int n, double dt, Uint64 *timers, Uint64 *dates )
+{
+   unsigned int *ids = array_create_size( unsigned int, 2*nhooks );
+   Hook **expired = array_create( Hook* );
+   int due = 0;
+
+   for (int i=0; i<nhooks; i++) {
+      array_push_back( &ids, hook_addTimerEvt( 0, "benchmark", RNGF() * 2. * n * dt ) );
+      array_push_back( &ids, hook_addDateEvt( 0, "benchmark", RNG( 1, 2*n ) * HOOK_BENCHMARK_DATE ) );
+   }
+
+   *timers = 0;
+   *dates  = 0;
+   for (int i=0; i<n; i++) {
+      Uint64 t = SDL_GetPerformanceCounter();
+      hook_timerExpire( dt, &expired );
+      for (int j=0; j<array_size(expired); j++)
+         expired[j]->delete = 1;
+      due += array_size(expired);
+      array_erase( &expired, array_begin(expired), array_end(expired) );
+      *timers += SDL_GetPerformanceCounter() - t;
+
+      t = SDL_GetPerformanceCounter();
+      hook_dateExpire( HOOK_BENCHMARK_DATE, &expired );
+      for (int j=0; j<array_size(expired); j++)
+         hook_dateRequeue( expired[j] );
+      due += array_size(expired);
+      array_erase( &expired, array_begin(expired), array_end(expired) );
+      *dates += SDL_GetPerformanceCounter() - t;
+   }
+
+   /* Clean up. */
+   for (int i=0; i<array_size(ids); i++) {
+      Hook *h = hook_get( ids[i] );
+      if (h != NULL)
+         h->delete = 1;
+   }
+   hooks_purgeList();
+   array_free( ids );
+   array_free( expired );
+   return due;
+}
+
 /**
  * @brief Gets the mission of a hook.
  */
@@ -872,23 +1449,39 @@ int hook_hasEventParent( unsigned int parent )
 
 static int hooks_executeParam( const char* stack, const HookParam *param )
 {
-   int run;
+   int run, sid, nhooks, oldref;
+   const HookParam *oldparam;
 
    /* Don't update if player is dead. */
    if ((player.p == NULL) || player_isFlag(PLAYER_DESTROYED))
       return 0;
 
+   NTracingZone( _ctx, 1 );
+
+   /* Only the hooks of the stack have to be looked at. */
+   sid = hook_stackID( stack, 0 );
+   nhooks = (sid >= 0) ? array_size( hook_stacks[sid].hooks ) : 0;
+
    /* Reset the current stack's ran and creation flags. */
-   for (Hook *h=hook_list; h!=NULL; h=h->next)
-      if (strcmp(stack, h->stack)==0) {
-         h->ran_once = 0;
-         h->created = 0;
-      }
+   for (int i=0; i<nhooks; i++) {
+      Hook *h = hook_stacks[sid].hooks[i];
+      h->ran_once = 0;
+      h->created = 0;
+   }
+
+   /* Share the parameters between the hooks, saving the ones of the stack
+    * being run in case this is nested. */
+   oldparam = hook_paramCur;
+   oldref   = hook_paramRef;
+   hook_paramCur = ((param != NULL) && (nhooks > 1)) ? param : NULL;
+   hook_paramRef = LUA_NOREF;
 
    run = 0;
    hook_runningstack++; /* running hooks */
-   for (int j=1; j>=0; j--) {
-      for (Hook *h=hook_list; h!=NULL; h=h->next) {
+   for (int j=1; (j>=0) && (nhooks>0); j--) {
+      /* Newest first, hooks added while running are left for later. */
+      for (int i=nhooks-1; i>=0; i--) {
+         Hook *h = hook_stacks[sid].hooks[i];
          /* Should be deleted. */
          if (h->delete)
             continue;
@@ -898,9 +1491,6 @@ static int hooks_executeParam( const char* stack, const HookParam *param )
          /* Don't update newly created hooks. */
          if (h->created != 0)
             continue;
-         /* Doesn't match stack. */
-         if (strcmp(stack, h->stack) != 0)
-            continue;
 
          /* Run hook. */
          hook_run( h, param, j );
@@ -915,6 +1505,10 @@ static int hooks_executeParam( const char* stack, const HookParam *param )
    }
    hook_runningstack--; /* not running hooks anymore */
 
+   luaL_unref( naevL, LUA_REGISTRYINDEX, hook_paramRef );
+   hook_paramCur = oldparam;
+   hook_paramRef = oldref;
+
    /* Free reference parameters. */
    if (param != NULL) {
       int n = 0;
@@ -935,6 +1529,7 @@ static int hooks_executeParam( const char* stack, const HookParam *param )
    if (run)
       claim_activateAll();
 
+   NTracingZoneEnd( _ctx );
    return run;
 }
 
@@ -1007,10 +1602,9 @@ int hooks_run( const char* stack )
  */
 static Hook* hook_get( unsigned int id )
 {
-   for (Hook *h=hook_list; h!=NULL; h=h->next)
-      if (h->id == id)
-         return h;
-
+   int pos = hook_idPos( id );
+   if ((pos < array_size(hook_ids)) && (hook_ids[pos]->id == id))
+      return hook_ids[pos];
    return NULL;
 }
 
@@ -1091,9 +1685,6 @@ static void hook_free( Hook *h )
    /* Remove from all the pilots. */
    pilots_rmHook( h->id );
 
-   /* Generic freeing. */
-   free( h->stack );
-
    /* Free type specific. */
    switch (h->type) {
       case HOOK_TYPE_MISN:
@@ -1121,6 +1712,10 @@ void hook_cleanup (void)
    /* Clear queued hooks. */
    hq_clear();
 
+   /* Drop the shared pilot userdata. */
+   luaL_unref( naevL, LUA_REGISTRYINDEX, hook_pilotRef );
+   hook_pilotRef = LUA_NOREF;
+
    h = hook_list;
    while (h != NULL) {
       Hook *hn = h->next;
@@ -1129,6 +1724,34 @@ void hook_cleanup (void)
    }
    /* safe defaults just in case */
    hook_list  = NULL;
+
+   /* Clear the indices. */
+   for (int i=0; i<array_size(hook_stacks); i++) {
+      free( hook_stacks[i].name );
+      array_free( hook_stacks[i].hooks );
+   }
+   array_free( hook_stacks );
+   hook_stacks = NULL;
+   array_free( hook_stacksSorted );
+   hook_stacksSorted = NULL;
+   array_free( hook_ids );
+   hook_ids = NULL;
+   for (int i=0; i<HOOK_WHEEL_LEVELS; i++) {
+      for (int j=0; j<=HOOK_WHEEL_MASK0; j++) {
+         array_free( hook_wheel[i][j] );
+         hook_wheel[i][j] = NULL;
+      }
+   }
+   array_free( hook_wheel_cascade );
+   hook_wheel_cascade = NULL;
+   hook_wheel_tick = 0;
+   hook_wheel_count = 0;
+   hook_timer_time = 0.;
+   array_free( hook_dates );
+   hook_dates = NULL;
+   hook_date = 0;
+   array_free( hook_expired );
+   hook_expired = NULL;
 }
 
 /**
@@ -1349,13 +1972,11 @@ static int hook_parse( xmlNodePtr base )
          /* Set the id. */
          if (id != 0) {
             h = hook_get( new_id );
-            h->id = id;
+            hook_setID( h, id );
 
             /* Additional info. */
-            if (is_date) {
-               h->is_date = 1;
-               h->res = res;
-            }
+            if (is_date)
+               hook_dateSet( h, res );
          }
       }
    } while (xml_nextNode(node));
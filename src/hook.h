@@ -119,3 +119,6 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
 void hooks_updateDate( ntime_t change );
 unsigned int hook_addDateMisn( unsigned int parent, const char *func, ntime_t resolution );
 unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t resolution );
+
+/* Benchmark. */
+int hooks_benchmark( int nhooks, int n, double dt, Uint64 *timers, Uint64 *dates );
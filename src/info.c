@@ -1593,12 +1593,13 @@ static void info_shiplogView( unsigned int wid, const char *str )
    pos = toolkit_getListPos( wid, "lstLogEntries" );
    if (pos < 0)
       return;
-   shiplog_listLog(
-         logIDs[selectedLog], info_getLogTypeFilter(selectedLogType), &nentries,
-         &logentries, 1);
+   /* Only format the selected entry. */
+   shiplog_listLogRange(
+         logIDs[selectedLog], info_getLogTypeFilter(selectedLogType), pos, 1,
+         &nentries, &logentries );
 
-   if (pos < nentries)
-      dialogue_msgRaw( _("Log message"), logentries[pos] );
+   if (nentries > 0)
+      dialogue_msgRaw( _("Log message"), logentries[0] );
 
    for (int i=0; i<nentries; i++)
       free( logentries[i] );
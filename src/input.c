@@ -30,6 +30,7 @@
 #include "pause.h"
 #include "pilot.h"
 #include "player.h"
+#include "replay.h"
 #include "toolkit.h"
 #include "weapon.h"
 #include "utf8.h"
@@ -630,7 +631,7 @@ void input_update( double dt )
          return;
 
       /* Get time. */
-      t = SDL_GetTicks();
+      t = replay_ticks();
 
       /* Should be repeating. */
       if (repeat_keyTimer + conf.repeat_delay + repeat_keyCounter*conf.repeat_freq > t)
@@ -667,7 +668,7 @@ static void input_key( int keynum, double value, double kabs, int repeat )
    if (conf.repeat_delay != 0) {
       if ((value==KEY_PRESS) && !repeat) {
          repeat_key        = keynum;
-         repeat_keyTimer   = SDL_GetTicks();
+         repeat_keyTimer   = replay_ticks();
          repeat_keyCounter = 0;
       }
       else if (value==KEY_RELEASE) {
@@ -679,7 +680,7 @@ static void input_key( int keynum, double value, double kabs, int repeat )
 
    /* Detect if double tap. */
    if (value==KEY_PRESS) {
-      unsigned int t = SDL_GetTicks();
+      unsigned int t = replay_ticks();
       if ((keynum == doubletap_key) && (t-doubletap_t <= conf.doubletap_sens))
          isdoubletap = 1;
       else {
@@ -978,7 +979,7 @@ static void input_key( int keynum, double value, double kabs, int repeat )
       if (value==KEY_PRESS) gui_setRadarRel(1);
    /* take a screenshot */
    } else if (KEY("screenshot")) {
-      if (value==KEY_PRESS) player_screenshot();
+      if (value==KEY_PRESS) player_screenshot( NULL, NULL, NULL );
    /* toggle fullscreen */
    } else if (KEY("togglefullscreen") && !repeat) {
       if (value==KEY_PRESS) naev_toggleFullscreen();
@@ -1451,7 +1452,7 @@ void input_clicked( void *clicked )
       return;
 
    input_lastClicked = clicked;
-   input_mouseClickLast = SDL_GetTicks();
+   input_mouseClickLast = replay_ticks();
 }
 
 /**
@@ -1468,7 +1469,7 @@ int input_isDoubleClick( void *clicked )
    /* Most recent time that constitutes a valid double-click. */
    threshold = input_mouseClickLast + (int)(conf.mouse_doubleclick * 1000);
 
-   if ((SDL_GetTicks() <= threshold) && (clicked == input_lastClicked))
+   if ((replay_ticks() <= threshold) && (clicked == input_lastClicked))
       return 1;
 
    return 0;
@@ -20,6 +20,17 @@ void il_create(IntList* il, int num_fields)
    il->data = il->fixed;
    il->num = 0;
    il->cap = il_fixed_cap;
+   il->heap = 0;
+   il->num_fields = num_fields;
+   il->free_element = -1;
+}
+
+void il_create_buffer(IntList* il, int num_fields, int* buf, int cap)
+{
+   il->data = buf;
+   il->num = 0;
+   il->cap = cap;
+   il->heap = 0;
    il->num_fields = num_fields;
    il->free_element = -1;
 }
@@ -27,7 +38,7 @@ void il_create(IntList* il, int num_fields)
 void il_destroy(IntList* il)
 {
    // Free the buffer only if it was heap allocated.
-   if (il->data != il->fixed)
+   if (il->heap)
       free(il->data);
 }
 
@@ -65,12 +76,14 @@ int il_push_back(IntList* il)
       // Use double the size for the new capacity.
       const int new_cap = new_pos * 2;
 
-      // If we're pointing to the fixed buffer, allocate a new array on the
-      // heap and copy the fixed buffer contents to it.
-      if (il->cap == il_fixed_cap)
+      // If we're pointing to the fixed or caller buffer, allocate a new
+      // array on the heap and copy the buffer contents to it.
+      if (!il->heap)
       {
-         il->data = malloc(new_cap * sizeof(*il->data));
-         memcpy(il->data, il->fixed, sizeof(il->fixed));
+         int* data = malloc(new_cap * sizeof(*il->data));
+         memcpy(data, il->data, il->num * il->num_fields * sizeof(*il->data));
+         il->data = data;
+         il->heap = 1;
       }
       else
       {
@@ -34,6 +34,9 @@ struct IntList
    // Stores the capacity of the array.
    int cap;
 
+   // Nonzero if 'data' was allocated on the heap by the list.
+   int heap;
+
    // Stores an index to the free element or -1 if the free list
    // is empty.
    int free_element;
@@ -46,6 +49,11 @@ struct IntList
 // 'num_fields' specifies the number of integer fields each element has.
 void il_create( IntList* il, int num_fields );
 
+// Creates a new list that stores its elements in the caller-provided buffer
+// of 'cap' integers, typically on the stack, until it runs out of space and
+// spills to the heap. The buffer must outlive the list.
+void il_create_buffer( IntList* il, int num_fields, int* buf, int cap );
+
 // Destroys the specified list.
 void il_destroy( IntList* il );
 
@@ -24,6 +24,7 @@
 #include "music.h"
 #include "ndata.h"
 #include "nstring.h"
+#include "replay.h"
 #include "toolkit.h"
 
 #define INTRO_SPEED        30. /**< Speed of text in characters / second. */
@@ -210,7 +211,7 @@ static void intro_fade_image_in( intro_img_t *side, intro_img_t *transition,
 static int intro_event_handler( int *stop, double *offset, double *vel )
 {
    SDL_Event event; /* user key-press, mouse-push, etc. */
-   while (SDL_PollEvent(&event)) {
+   while (replay_pollEvent(&event)) {
       if (event.type == SDL_QUIT) {
          if (naev_isQuit() || menu_askQuit()) {
             naev_quit();
@@ -19,6 +19,7 @@
 
 #include "array.h"
 #include "camera.h"
+#include "cond.h"
 #include "conf.h"
 #include "dialogue.h"
 #include "economy.h"
@@ -123,6 +124,7 @@ static void land_createMainTab( unsigned int wid );
 static void land_setupTabs (void);
 static void land_cleanupWindow( unsigned int wid, const char *name );
 static void land_changeTab( unsigned int wid, const char *wgt, int old, int tab );
+static void land_openTab( int window );
 /* spaceport bar */
 static void bar_getDim( int wid, int *w, int *h, int *iw, int *ih, int *bw, int *bh );
 static void bar_open( unsigned int wid );
@@ -897,9 +899,58 @@ unsigned int land_getWid( int window )
 {
    if (land_windowsMap[window] == -1)
       return 0;
+   /* Tabs other than the main one only exist once generated. */
+   if ((window != LAND_WINDOW_MAIN) && !land_tabGenerated(window))
+      return 0;
    return land_windows[ land_windowsMap[window] ];
 }
 
+/**
+ * @brief Generates a tab if the spob has it and it wasn't generated yet.
+ *
+ * The outfitter, shipyard, equipment and commodity exchange tabs are only
+ *  generated when first opened, as they are the slowest to set up.
+ *
+ *    @param window Type of the tab to generate (LAND_WINDOW_BAR, ...).
+ */
+static void land_openTab( int window )
+{
+   unsigned int w;
+
+   if ((window == LAND_WINDOW_MAIN) || (land_windowsMap[window] == -1) ||
+         land_tabGenerated(window))
+      return;
+
+   NTracingZone( _ctx, 1 );
+
+   w = land_windows[ land_windowsMap[window] ];
+   switch (window) {
+      case LAND_WINDOW_BAR:
+         bar_open( w );
+         break;
+      case LAND_WINDOW_MISSION:
+         misn_open( w );
+         break;
+      case LAND_WINDOW_OUTFITS:
+         outfits_open( w, NULL, spob_hasService(land_spob, SPOB_SERVICE_BLACKMARKET) );
+         break;
+      case LAND_WINDOW_SHIPYARD:
+         shipyard_open( w );
+         break;
+      case LAND_WINDOW_EQUIPMENT:
+         equipment_open( w );
+         break;
+      case LAND_WINDOW_COMMODITY:
+         commodity_exchange_open( w );
+         break;
+
+      default:
+         break;
+   }
+
+   NTracingZoneEnd( _ctx );
+}
+
 /**
  * @brief Sets up the tabs for the window.
  */
@@ -1016,6 +1067,7 @@ void land_genWindows( int load )
 
    /* 2) Set as landed and run hooks. */
    if (!regen) {
+      cond_statsReset();
       landed = 1;
       music_choose("land"); /* Must be before hooks in case hooks change music. */
 
@@ -1052,35 +1104,15 @@ void land_genWindows( int load )
                MIS_AVAIL_COMPUTER );
    }
 
-   /* 4) Create other tabs. */
-#define should_open(s, w) \
-   (spob_hasService(land_spob, s) && (!land_tabGenerated(w)))
-
-   /* Things get a bit hairy here. Hooks may have triggered a GUI reload via
+   /* 4) Create the bar and mission computer tabs, the rest get generated
+    * when first opened by land_changeTab.
+    *
+    * Things get a bit hairy here. Hooks may have triggered a GUI reload via
     * e.g. player.swapShip, so the land tabs may have been generated already
-    * and we need to check that before regenerating them.
+    * and land_openTab checks that before regenerating them.
     */
-
-   /* Basic - bar + missions */
-   if (should_open( SPOB_SERVICE_BAR, LAND_WINDOW_BAR ))
-      bar_open( land_getWid(LAND_WINDOW_BAR) );
-   if (should_open( SPOB_SERVICE_MISSIONS, LAND_WINDOW_MISSION ))
-      misn_open( land_getWid(LAND_WINDOW_MISSION) );
-   /* Outfits. */
-   if (should_open( SPOB_SERVICE_OUTFITS, LAND_WINDOW_OUTFITS ))
-      outfits_open( land_getWid(LAND_WINDOW_OUTFITS), NULL, spob_hasService(land_spob, SPOB_SERVICE_BLACKMARKET) );
-   /* Shipyard. */
-   if (should_open( SPOB_SERVICE_SHIPYARD, LAND_WINDOW_SHIPYARD ))
-      shipyard_open( land_getWid(LAND_WINDOW_SHIPYARD) );
-   /* Equipment. */
-   if ((spob_hasService(land_spob, SPOB_SERVICE_OUTFITS) ||
-         spob_hasService(land_spob, SPOB_SERVICE_SHIPYARD)) &&
-         !land_tabGenerated( LAND_WINDOW_EQUIPMENT ))
-      equipment_open( land_getWid(LAND_WINDOW_EQUIPMENT) );
-   /* Commodity. */
-   if (should_open( SPOB_SERVICE_COMMODITY, LAND_WINDOW_COMMODITY ))
-      commodity_exchange_open( land_getWid(LAND_WINDOW_COMMODITY) );
-#undef should_open
+   land_openTab( LAND_WINDOW_BAR );
+   land_openTab( LAND_WINDOW_MISSION );
 
    if (!regen) {
       /* Reset markers if needed. */
@@ -1108,6 +1140,12 @@ void land_genWindows( int load )
 
    /* Finished loading. */
    land_loaded = 1;
+   if (!regen && conf.devmode) {
+      int ncond;
+      double condms;
+      cond_stats( &ncond, &condms );
+      DEBUG( n_( "Landing checked %d conditional in %.3f ms", "Landing checked %d conditionals in %.3f ms", ncond ), ncond, condms );
+   }
 
    /* Necessary if player.land() was run in an abort() function. */
    if (!load)
@@ -1165,6 +1203,9 @@ void land( Spob* p, int load )
    /* Heal the player so GUI shows player at full everything. */
    pilot_healLanded( player.p );
 
+   /* Outfit descriptions may depend on more than the player's stats. */
+   pilot_outfitDescClear();
+
    player_addEscorts(); /* TODO only regenerate fleet if planet has a shipyard */
 
    /* Stop player sounds. */
@@ -1330,6 +1371,7 @@ static void land_changeTab( unsigned int wid, const char *wgt, int old, int tab
       if (land_windowsMap[i] != tab)
          continue;
       last_window = i;
+      land_openTab( i );
       w = land_getWid( i );
 
       /* Must regenerate outfits. */
@@ -1588,7 +1630,7 @@ void takeoff( int delay, int nosave )
 static void land_stranded (void)
 {
    /* Nothing to do if there's no rescue script. */
-   if (!PHYSFS_exists(RESCUE_PATH))
+   if (!ndata_exists(RESCUE_PATH))
       return;
 
    if (rescue_env == LUA_NOREF) {
@@ -68,6 +68,9 @@ static void outfits_find( unsigned int wid, const char *str );
 static const char *outfit_getPrice( const Outfit *outfit, credits_t *price, int *canbuy, int *cansell );
 static void outfit_Popdown( unsigned int wid, const char* str );
 static void outfits_genList( unsigned int wid );
+static void outfits_refreshList( unsigned int wid );
+static void outfits_updateEquipment( unsigned int wid );
+static char *outfits_iarAltText( unsigned int wid, const char *wgt, int pos );
 static void outfits_changeTab( unsigned int wid, const char *wgt, int old, int tab );
 static void outfits_onClose( unsigned int wid, const char *str );
 static void outfit_modifiers( unsigned int wid );
@@ -438,7 +441,8 @@ static void outfits_genList( unsigned int wid )
       iar_outfits[active] = (data->outfits!=NULL) ? array_copy( Outfit*, data->outfits ) : tech_getOutfit( land_spob->tech );
    }
    noutfits = outfits_filter( (const Outfit**)iar_outfits[active], array_size(iar_outfits[active]), tabfilters[active], filtertext );
-   coutfits = outfits_imageArrayCells( (const Outfit**)iar_outfits[active], &noutfits, player.p, 1 );
+   array_resize( &iar_outfits[active], noutfits );
+   coutfits = outfits_imageArrayCells( (const Outfit**)iar_outfits[active], &noutfits, 1 );
 
    iconsize = 128;
    if (!conf.big_icons) {
@@ -450,11 +454,76 @@ static void outfits_genList( unsigned int wid )
    window_addImageArray( wid, 20, 20,
          iw, ih - 34, OUTFITS_IAR, iconsize, iconsize,
          coutfits, noutfits, outfits_update, outfits_rmouse, NULL );
+   toolkit_setImageArrayAltText( wid, OUTFITS_IAR, outfits_iarAltText );
 
    /* write the outfits stuff */
    outfits_update( wid, NULL );
 }
 
+/**
+ * @brief Updates the owned quantities of the outfit list in place.
+ *
+ * Buying or selling does not change which outfits are listed, so there is no
+ *  need to regenerate the whole list.
+ *
+ *    @param wid Window to refresh the list on.
+ */
+static void outfits_refreshList( unsigned int wid )
+{
+   int active;
+
+   if (!widget_exists( wid, OUTFITS_IAR ))
+      return;
+
+   /* The owned outfits tab can change contents. */
+   active = window_tabWinGetActive( wid, OUTFITS_TAB );
+   if (active==6) {
+      outfits_regenList( wid, NULL );
+      return;
+   }
+
+   for (int i=0; i<array_size(iar_outfits[active]); i++)
+      toolkit_setImageArrayQuantity( wid, OUTFITS_IAR, i,
+            player_outfitOwned( iar_outfits[active][i] ) );
+   outfits_update( wid, NULL );
+}
+
+/**
+ * @brief Updates the equipment and landed outfitter after buying or selling.
+ *
+ *    @param wid Window the outfits were bought or sold from.
+ */
+static void outfits_updateEquipment( unsigned int wid )
+{
+   if (landed && land_doneLoading()) {
+      if (spob_hasService(land_spob, SPOB_SERVICE_OUTFITS)) {
+         unsigned int ow = land_getWid( LAND_WINDOW_OUTFITS );
+         if ((ow > 0) && (ow != wid))
+            outfits_refreshList( ow );
+      }
+      else if (!spob_hasService(land_spob, SPOB_SERVICE_SHIPYARD))
+         return;
+
+      int ew = land_getWid( LAND_WINDOW_EQUIPMENT );
+      equipment_addAmmo();
+      /* Tabs not opened yet don't need updating. */
+      if (ew > 0)
+         equipment_regenLists( ew, 1, 0 );
+   }
+}
+
+/**
+ * @brief Generates the alt text of an outfit when it is first shown.
+ */
+static char *outfits_iarAltText( unsigned int wid, const char *wgt, int pos )
+{
+   (void) wgt;
+   int active = window_tabWinGetActive( wid, OUTFITS_TAB );
+   if ((pos < 0) || (pos >= array_size(iar_outfits[active])))
+      return NULL;
+   return strdup( pilot_outfitSummary( player.p, iar_outfits[active][pos], 1 ) );
+}
+
 /**
  * @brief Updates the outfits in the outfit window.
  *    @param wid Window to update the outfits in.
@@ -514,7 +583,7 @@ void outfits_update( unsigned int wid, const char *str )
    outfit = iar_outfits[active][i];
 
    /* new image */
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 256, 256 );
+   window_modifyImage( wid, "imgOutfit", outfit_gfxStore( outfit ), 256, 256 );
 
    /* new text */
    if (outfit->slot.type == OUTFIT_SLOT_INTRINSIC) {
@@ -598,14 +667,17 @@ void outfits_updateEquipmentOutfits( void )
    if (landed && land_doneLoading()) {
       if (spob_hasService(land_spob, SPOB_SERVICE_OUTFITS)) {
          int ow = land_getWid( LAND_WINDOW_OUTFITS );
-         outfits_regenList( ow, NULL );
+         if (ow > 0)
+            outfits_regenList( ow, NULL );
       }
       else if (!spob_hasService(land_spob, SPOB_SERVICE_SHIPYARD))
          return;
 
       int ew = land_getWid( LAND_WINDOW_EQUIPMENT );
       equipment_addAmmo();
-      equipment_regenLists( ew, 1, 0 );
+      /* Tabs not opened yet don't need updating. */
+      if (ew > 0)
+         equipment_regenLists( ew, 1, 0 );
    }
 }
 
@@ -760,7 +832,7 @@ int outfit_altText( char *buf, int n, const Outfit *o, const Pilot *plt )
 /**
  * @brief Generates image array cells corresponding to outfits.
  */
-ImageArrayCell *outfits_imageArrayCells( const Outfit **outfits, int *noutfits, const Pilot *p, int store )
+ImageArrayCell *outfits_imageArrayCells( const Outfit **outfits, int *noutfits, int store )
 {
    ImageArrayCell *coutfits = calloc( MAX(1,*noutfits), sizeof(ImageArrayCell) );
 
@@ -770,13 +842,16 @@ ImageArrayCell *outfits_imageArrayCells( const Outfit **outfits, int *noutfits,
       coutfits[0].caption = strdup( _("None") );
    }
    else {
-      /* Set alt text. */
+      /* Load all the missing store graphics in one go. */
+      outfit_gfxStoreLoad( outfits, *noutfits );
+
+      /* Alt text is left to the image array, it is expensive to generate. */
       for (int i=0; i<*noutfits; i++) {
          const glColour *c;
          glTexture *t;
          const Outfit *o = outfits[i];
 
-         coutfits[i].image = gl_dupTexture( o->gfx_store );
+         coutfits[i].image = gl_dupTexture( outfit_gfxStore( o ) );
          coutfits[i].caption = strdup( _(o->name) );
          if (!store && outfit_isProp(o, OUTFIT_PROP_UNIQUE))
             coutfits[i].quantity = -1; /* Don't display. */
@@ -790,9 +865,6 @@ ImageArrayCell *outfits_imageArrayCells( const Outfit **outfits, int *noutfits,
             c = &cBlack;
          col_blend( &coutfits[i].bg, c, &cGrey70, 1 );
 
-         /* Short description. */
-         coutfits[i].alt = strdup( pilot_outfitSummary( p, o, 1 ) );
-
          /* Slot type. */
          if ( (strcmp(outfit_slotName(o), "N/A") != 0)
                && (strcmp(outfit_slotName(o), "NULL") != 0) ) {
@@ -1059,7 +1131,7 @@ static void outfits_buy( unsigned int wid, const char *str )
       player_modCredits( -outfit->price * player_addOutfit( outfit, q ) );
 
    /* Actually buy the outfit. */
-   outfits_updateEquipmentOutfits();
+   outfits_updateEquipment( wid );
    hparam[0].type    = HOOK_PARAM_OUTFIT;
    hparam[0].u.outfit= outfit;
    hparam[1].type    = HOOK_PARAM_NUMBER;
@@ -1072,8 +1144,8 @@ static void outfits_buy( unsigned int wid, const char *str )
    if (sold != NULL)
       sold->q -= q;
 
-   /* Regenerate list. */
-   outfits_regenList( wid, NULL );
+   /* Update list. */
+   outfits_refreshList( wid );
 }
 /**
  * @brief Checks to see if the player can sell the selected outfit.
@@ -1174,7 +1246,7 @@ static void outfits_sell( unsigned int wid, const char *str )
       player_modCredits( outfit->price * q );
    }
 
-   outfits_updateEquipmentOutfits();
+   outfits_updateEquipment( wid );
    hparam[0].type    = HOOK_PARAM_OUTFIT;
    hparam[0].u.outfit= outfit;
    hparam[1].type    = HOOK_PARAM_NUMBER;
@@ -1205,8 +1277,8 @@ static void outfits_sell( unsigned int wid, const char *str )
       }
    }
 
-   /* Regenerate list. */
-   outfits_regenList( wid, NULL );
+   /* Update list. */
+   outfits_refreshList( wid );
 }
 /**
  * @brief Gets the current modifier status.
@@ -16,7 +16,7 @@ void outfits_update( unsigned int wid, const char* str );
 void outfits_updateEquipmentOutfits( void );
 int outfits_filter( const Outfit **outfits, int n,
       int(*filter)( const Outfit *o ), const char *name );
-ImageArrayCell *outfits_imageArrayCells( const Outfit **outfits, int *noutfits, const Pilot *p, int store );
+ImageArrayCell *outfits_imageArrayCells( const Outfit **outfits, int *noutfits, int store );
 int outfit_canBuy( const Outfit *outfit, int blackmarket );
 int outfit_canSell( const Outfit *outfit );
 void outfits_cleanup( void );
@@ -153,6 +153,7 @@ void shipyard_open( unsigned int wid )
       nships    = 1;
    }
    else {
+      ships_gfxLoad( shipyard_list );
       for (int i=0; i<nships; i++) {
          cships[i].caption = strdup( _(shipyard_list[i]->name) );
          cships[i].image = gl_dupTexture(shipyard_list[i]->gfx_store);
@@ -574,7 +575,8 @@ static void shipyard_trade( unsigned int wid, const char* str )
    wid = land_getWid(LAND_WINDOW_SHIPYARD);
 
    /* Update shipyard. */
-   shipyard_update(wid, NULL);
+   if (wid > 0)
+      shipyard_update(wid, NULL);
 }
 
 /**
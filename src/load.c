@@ -8,6 +8,7 @@
  */
 
 /** @cond */
+#include "libxml/xmlreader.h"
 #include "physfs.h"
 
 #include "naev.h"
@@ -98,6 +99,8 @@ static void load_snapshot_menu_delete( unsigned int wdw, const char *str );
 static void load_snapshot_menu_save( unsigned int wdw, const char *str );
 static void display_save_info( unsigned int wid, const nsave_t *ns );
 static void move_old_save( const char *path, const char *fname, const char *ext, const char *new_name );
+static int load_loadNode( nsave_t *save, xmlNodePtr parent );
+static int load_loadSummary( nsave_t *save );
 static int load_load( nsave_t *save );
 static int load_game( const nsave_t *ns );
 static int load_gameInternal( const char* file, const char* version );
@@ -113,7 +116,144 @@ static int load_sortComparePlayers( const void *p1, const void *p2 );
 static int load_sortCompareName( const void *p1, const void *p2 );
 static int load_sortCompare( const void *p1, const void *p2 );
 static xmlDocPtr load_xml_parsePhysFS( const char* filename );
+static void load_clearSave( nsave_t *ns );
 static void load_freeSave( nsave_t *ns );
+static void load_freeList( player_saves_t *saves );
+static int load_sortComparePath( const void *p1, const void *p2 );
+
+/**
+ * @brief Parses a top level node of a save into its summary.
+ *
+ *    @param[out] save Structure to populate.
+ *    @param parent Node to parse.
+ *    @return 1 if the node was used, 0 otherwise.
+ */
+static int load_loadNode( nsave_t *save, xmlNodePtr parent )
+{
+   /* Info. */
+   if (xml_isNode(parent, "version")) {
+      xmlNodePtr node = parent->xmlChildrenNode;
+      do {
+         xmlr_strd(node, "naev", save->version);
+         xmlr_strd(node, "data", save->data);
+      } while (xml_nextNode(node));
+      return 1;
+   }
+
+   /* The summary has the same layout as the player node. */
+   else if (xml_isNode(parent, "player") || xml_isNode(parent, "player_summary")) {
+      /* Get name. */
+      xmlr_attr_strd(parent, "name", save->player_name);
+      /* Parse rest. */
+      xmlNodePtr node = parent->xmlChildrenNode;
+      do {
+         xml_onlyNodes(node);
+
+         /* Player info. */
+         xmlr_strd(node, "location", save->spob);
+         xmlr_ulong(node, "credits", save->credits);
+         xmlr_strd(node, "chapter", save->chapter);
+         xmlr_strd(node, "difficulty", save->difficulty);
+
+         /* Time. */
+         if (xml_isNode(node, "time")) {
+            int cycles, periods, seconds;
+            xmlNodePtr cur = node->xmlChildrenNode;
+            cycles = periods = seconds = 0;
+            do {
+               xmlr_int(cur, "SCU", cycles);
+               xmlr_int(cur, "STP", periods);
+               xmlr_int(cur, "STU", seconds);
+            } while (xml_nextNode(cur));
+            save->date = ntime_create( cycles, periods, seconds );
+            continue;
+         }
+
+         /* Ship info. */
+         if (xml_isNode(node, "ship")) {
+            xmlr_attr_strd(node, "name", save->shipname);
+            xmlr_attr_strd(node, "model", save->shipmodel);
+            continue;
+         }
+      } while (xml_nextNode(node));
+      return 1;
+   }
+   else if (xml_isNode(parent, "plugins")) {
+      save->plugins = array_create( char* );
+      /* Parse rest. */
+      xmlNodePtr node = parent->xmlChildrenNode;
+      do {
+         xml_onlyNodes(node);
+
+         if (xml_isNode(node, "plugin")) {
+            const char *name = xml_get(node);
+            if (name != NULL)
+               array_push_back( &save->plugins, strdup(name) );
+            else
+               WARN(_("Save '%s' has unnamed plugin node!"), save->path);
+         }
+      } while (xml_nextNode(node));
+      return 1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Loads the summary at the start of a save without parsing the rest.
+ *
+ * The reader only decompresses and parses the file up to the summary, which
+ *  is a few kilobytes at most.
+ *
+ *    @param[out] save Structure to populate.
+ *    @return 0 on success, 1 if the save has no summary, -1 on error.
+ */
+static int load_loadSummary( nsave_t *save )
+{
+   char buf[PATH_MAX];
+   xmlTextReaderPtr reader;
+   int ret = 1, r;
+
+   snprintf( buf, sizeof(buf), "%s/%s", PHYSFS_getWriteDir(), save->path );
+   reader = xmlReaderForFile( buf, NULL, 0 );
+   if (reader == NULL)
+      return -1;
+
+   r = xmlTextReaderRead( reader );
+   while (r == 1) {
+      const char *name;
+      xmlNodePtr node;
+      if ((xmlTextReaderDepth( reader ) != 1) ||
+            (xmlTextReaderNodeType( reader ) != XML_READER_TYPE_ELEMENT)) {
+         r = xmlTextReaderRead( reader );
+         continue;
+      }
+
+      /* Reaching the player is an older save without summary. */
+      name = (const char*) xmlTextReaderConstName( reader );
+      if ((name == NULL) || (strcmp( name, "player" ) == 0))
+         break;
+
+      /* Other nodes, like last_played, are skipped without expanding them. */
+      if ((strcmp( name, "version" ) == 0) || (strcmp( name, "plugins" ) == 0) ||
+            (strcmp( name, "player_summary" ) == 0)) {
+         node = xmlTextReaderExpand( reader );
+         if (node == NULL) {
+            ret = -1;
+            break;
+         }
+         load_loadNode( save, node );
+         if (xml_isNode(node, "player_summary")) {
+            ret = 0;
+            break;
+         }
+      }
+
+      /* Go to the next sibling, skipping the children. */
+      r = xmlTextReaderNext( reader );
+   }
+   xmlFreeTextReader( reader );
+   return ret;
+}
 
 /**
  * @brief Loads an individual save.
@@ -124,6 +264,15 @@ static int load_load( nsave_t *save )
 {
    xmlDocPtr doc;
    xmlNodePtr root, parent;
+   int ret;
+
+   /* Try to only read the summary first. */
+   ret = load_loadSummary( save );
+   if (ret == 0)
+      goto done;
+
+   /* Start from scratch. */
+   load_clearSave( save );
 
    /* Load the XML. */
    doc = load_xml_parsePhysFS( save->path );
@@ -142,82 +291,20 @@ static int load_load( nsave_t *save )
    parent = root->xmlChildrenNode;
    do {
       xml_onlyNodes(parent);
-
-      /* Info. */
-      if (xml_isNode(parent, "version")) {
-         xmlNodePtr node = parent->xmlChildrenNode;
-         do {
-            xmlr_strd(node, "naev", save->version);
-            xmlr_strd(node, "data", save->data);
-         } while (xml_nextNode(node));
-         continue;
-      }
-
-      else if (xml_isNode(parent, "player")) {
-         /* Get name. */
-         xmlr_attr_strd(parent, "name", save->player_name);
-         /* Parse rest. */
-         xmlNodePtr node = parent->xmlChildrenNode;
-         do {
-            xml_onlyNodes(node);
-
-            /* Player info. */
-            xmlr_strd(node, "location", save->spob);
-            xmlr_ulong(node, "credits", save->credits);
-            xmlr_strd(node, "chapter", save->chapter);
-            xmlr_strd(node, "difficulty", save->difficulty);
-
-            /* Time. */
-            if (xml_isNode(node, "time")) {
-               int cycles, periods, seconds;
-               xmlNodePtr cur = node->xmlChildrenNode;
-               cycles = periods = seconds = 0;
-               do {
-                  xmlr_int(cur, "SCU", cycles);
-                  xmlr_int(cur, "STP", periods);
-                  xmlr_int(cur, "STU", seconds);
-               } while (xml_nextNode(cur));
-               save->date = ntime_create( cycles, periods, seconds );
-               continue;
-            }
-
-            /* Ship info. */
-            if (xml_isNode(node, "ship")) {
-               xmlr_attr_strd(node, "name", save->shipname);
-               xmlr_attr_strd(node, "model", save->shipmodel);
-               continue;
-            }
-         } while (xml_nextNode(node));
-         continue;
-      }
-      else if (xml_isNode(parent, "plugins")) {
-         save->plugins = array_create( char* );
-         /* Parse rest. */
-         xmlNodePtr node = parent->xmlChildrenNode;
-         do {
-            xml_onlyNodes(node);
-
-            if (xml_isNode(node, "plugin")) {
-               const char *name = xml_get(node);
-               if (name != NULL)
-                  array_push_back( &save->plugins, strdup(name) );
-               else
-                  WARN(_("Save '%s' has unnamed plugin node!"), save->path);
-            }
-         } while (xml_nextNode(node));
-         continue;
-      }
+      if (!xml_isNode(parent, "player_summary"))
+         load_loadNode( save, parent );
    } while (xml_nextNode(parent));
 
+   /* Clean up. */
+   xmlFreeDoc(doc);
+
+done:
    /* Defaults. */
    if (save->chapter==NULL)
       save->chapter = strdup( start_chapter() );
 
    save->compatible = load_compatibility( save );
 
-   /* Clean up. */
-   xmlFreeDoc(doc);
-
    return 0;
 }
 
@@ -233,25 +320,49 @@ static int load_loadThread( void *ptr )
  */
 int load_refresh (void)
 {
-   ThreadQueue *tq = vpool_create();
+   ThreadQueue *tq;
+   player_saves_t *old;
+   nsave_t **cache;
 
-   if (load_saves != NULL)
-      load_free();
+   /* The list has to include the save being written. */
+   save_wait();
+
+   /* Keep the previous list around to reuse the saves that didn't change. */
+   old = load_saves;
+   load_saves = NULL;
+   cache = array_create( nsave_t* );
+   for (int i=0; i<array_size(old); i++)
+      for (int j=0; j<array_size(old[i].saves); j++)
+         array_push_back( &cache, &old[i].saves[j] );
+   qsort( cache, array_size(cache), sizeof(nsave_t*), load_sortComparePath );
 
    /* Load the saves candidates. */
    load_saves = array_create( player_saves_t );
    PHYSFS_enumerate( "saves", load_enumerateCallback, NULL );
 
    /* Set up threads and load. */
+   tq = vpool_create();
    for (int i=0; i<array_size(load_saves); i++) {
       player_saves_t *ps = &load_saves[i];
       for (int j=0; j<array_size(ps->saves); j++) {
          nsave_t *ns = &ps->saves[j];
+         nsave_t *key = ns;
+         nsave_t **c = bsearch( &key, cache, array_size(cache), sizeof(nsave_t*), load_sortComparePath );
+         if ((c != NULL) && ((*c)->modtime == ns->modtime) && ((*c)->filesize == ns->filesize)) {
+            /* Swap so the stale copy gets freed with the old list. */
+            nsave_t tmp = *ns;
+            *ns = **c;
+            **c = tmp;
+            ns->ret = 0;
+            continue;
+         }
          vpool_enqueue( tq, load_loadThread, ns );
       }
    }
    vpool_wait( tq );
    vpool_cleanup( tq );
+   array_free( cache );
+   load_freeList( old );
 
    /* Load the saves. */
    for (int i=array_size(load_saves)-1; i>=0; i--) {
@@ -343,6 +454,7 @@ static int load_enumerateCallbackPlayer( void* data, const char* origdir, const
       ns.save_name = strdup( fname );
       ns.save_name[ strlen(ns.save_name)-3 ] = '\0';
       ns.modtime = stat.modtime;
+      ns.filesize = stat.filesize;
       array_push_back( &ps->saves, ns );
    }
    else
@@ -507,6 +619,16 @@ static int load_sortComparePlayers( const void *p1, const void *p2 )
    return load_sortCompare( &ps1->saves[0], &ps2->saves[0] );
 }
 
+/**
+ * @brief Compares pointers to saves by path.
+ */
+static int load_sortComparePath( const void *p1, const void *p2 )
+{
+   const nsave_t *ns1 = *(const nsave_t**) p1;
+   const nsave_t *ns2 = *(const nsave_t**) p2;
+   return strcmp( ns1->path, ns2->path );
+}
+
 static int load_sortCompareName( const void *p1, const void *p2 )
 {
    int ret;
@@ -556,14 +678,18 @@ static int load_sortCompare( const void *p1, const void *p2 )
    return strcmp( ns1->save_name, ns2->save_name );
 }
 
-static void load_freeSave( nsave_t *ns )
+/**
+ * @brief Clears everything loaded from a save, keeping its path and name.
+ *
+ *    @param ns Save to clear.
+ */
+static void load_clearSave( nsave_t *ns )
 {
    for (int k=0; k<array_size(ns->plugins); k++)
       free( ns->plugins[k] );
    array_free( ns->plugins );
-   free(ns->save_name);
+   ns->plugins = NULL;
    free(ns->player_name);
-   free(ns->path);
    free(ns->version);
    free(ns->data);
    free(ns->spob);
@@ -571,22 +697,44 @@ static void load_freeSave( nsave_t *ns )
    free(ns->difficulty);
    free(ns->shipname);
    free(ns->shipmodel);
+   ns->player_name = ns->version = ns->data = NULL;
+   ns->spob = ns->chapter = ns->difficulty = NULL;
+   ns->shipname = ns->shipmodel = NULL;
+   ns->date    = 0;
+   ns->credits = 0;
+}
+
+static void load_freeSave( nsave_t *ns )
+{
+   load_clearSave( ns );
+   free(ns->save_name);
+   free(ns->path);
 }
 
 /**
- * @brief Frees loaded save stuff.
+ * @brief Frees a list of saves.
+ *
+ *    @param saves Array (array.h) of saves per player to free.
  */
-void load_free (void)
+static void load_freeList( player_saves_t *saves )
 {
-   for (int i=0; i<array_size(load_saves); i++) {
-      player_saves_t *ps = &load_saves[i];
+   for (int i=0; i<array_size(saves); i++) {
+      player_saves_t *ps = &saves[i];
       free( ps->name );
       for (int j=0; j<array_size(ps->saves); j++) {
          load_freeSave( &ps->saves[j] );
       }
       array_free( ps->saves );
    }
-   array_free( load_saves );
+   array_free( saves );
+}
+
+/**
+ * @brief Frees loaded save stuff.
+ */
+void load_free (void)
+{
+   load_freeList( load_saves );
    load_saves = NULL;
 }
 
@@ -1308,7 +1456,7 @@ static int load_gameInternalHook( void *data )
       goto err_doc;
 
    /* Clean up possible stuff that should be cleaned. */
-   unidiff_universeDefer( 1 );
+   diff_begin();
    player_cleanup();
    render_postprocessCleanup();
 
@@ -1318,7 +1466,7 @@ static int load_gameInternalHook( void *data )
 
    /* Now begin to load. */
    diff_load(node); /* Must load first to work properly. */
-   unidiff_universeDefer( 0 );
+   diff_commit();
    missions_loadCommodity(node); /* Must be loaded before player. */
    pfaction_load(node); /* Must be loaded before player so the messages show up properly. */
    pnt = player_load(node);
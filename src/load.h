@@ -25,6 +25,7 @@ typedef struct nsave_s {
    char *player_name; /**< Player name. */
    char *path; /**< File path relative to PhysicsFS write directory. */
    PHYSFS_sint64 modtime; /**< Last modified time. */
+   PHYSFS_sint64 filesize; /**< File size, used with modtime to detect changes. */
 
    /* Naev info. */
    char *version; /**< Naev version. */
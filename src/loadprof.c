@@ -0,0 +1,389 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file loadprof.c
+ *
+ * @brief Load time profiler, enabled with --profile-load.
+ *
+ * Records the wall time, heap growth and ndata bytes read by each loading
+ *  stage, as well as how long every XML, Lua, image and sound file took. The
+ *  report is written as JSON to the write directory once loading is done.
+ *
+ * Stages run concurrently, so bytes are attributed to the stage running on
+ *  the reading thread, while the heap growth of overlapping stages is shared.
+ */
+/** @cond */
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define LOADPROF_MALLINFO 1 /**< Can report heap usage. */
+#endif
+#include "physfs.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "loadprof.h"
+
+#include "array.h"
+#include "conf.h"
+#include "log.h"
+#include "nstring.h"
+
+#define LOADPROF_STAGES_MAX   64 /**< Maximum number of stages that can be recorded. */
+#define LOADPROF_TOP          25 /**< Number of slowest files to report per type. */
+#define LOADPROF_SUMMARY      3  /**< Number of slowest files to show in the summary. */
+#define LOADPROF_REPORT       "load_profile.json" /**< Report file in the write directory. */
+
+/**
+ * @brief A recorded loading stage.
+ */
+typedef struct LoadProfStage_ {
+   const char *name;    /**< Name of the stage. */
+   Uint64 start;        /**< Performance counter at the start. */
+   Uint64 end;          /**< Performance counter at the end. */
+   size_t heap_start;   /**< Heap in use at the start. */
+   size_t heap_end;     /**< Heap in use at the end. */
+   atomic_size_t bytes; /**< ndata bytes read by the stage. */
+} LoadProfStage;
+
+/**
+ * @brief A recorded file load.
+ */
+typedef struct LoadProfEntry_ {
+   LoadProfFile type;   /**< Type of file. */
+   char *path;          /**< Path of the file. */
+   Uint64 ticks;        /**< Performance counter ticks it took. */
+   size_t size;         /**< Size of the file. */
+   int stage;           /**< Stage it was loaded in, -1 if none. */
+} LoadProfEntry;
+
+static const char *loadprof_typeNames[LOADPROF_FILE_MAX] = {
+   [LOADPROF_XML]    = "xml",
+   [LOADPROF_LUA]    = "lua",
+   [LOADPROF_IMAGE]  = "image",
+   [LOADPROF_SOUND]  = "sound",
+}; /**< Names of the file types in the report. */
+
+static int loadprof_on     = 0; /**< Whether the profiler is enabled. */
+static Uint64 loadprof_t0  = 0; /**< Performance counter when the profiler started. */
+static SDL_mutex *loadprof_lock = NULL; /**< Protects the stages and the entries. */
+static LoadProfStage loadprof_stages[LOADPROF_STAGES_MAX]; /**< Recorded stages. */
+static int loadprof_nstages = 0; /**< Number of recorded stages. */
+static LoadProfEntry *loadprof_entries = NULL; /**< Array (array.h): Recorded files. */
+static atomic_size_t loadprof_total = 0; /**< Total ndata bytes read. */
+static _Thread_local int loadprof_cur = -1; /**< Stage running on the thread. */
+
+/*
+ * Prototypes.
+ */
+static size_t loadprof_heap (void);
+static double loadprof_ms( Uint64 ticks );
+static int loadprof_cmp( const void *p1, const void *p2 );
+static void loadprof_writeStr( PHYSFS_File *f, const char *str );
+static void loadprof_printf( PHYSFS_File *f, const char *fmt, ... );
+
+/**
+ * @brief Gets the amount of heap memory in use.
+ */
+static size_t loadprof_heap (void)
+{
+#ifdef LOADPROF_MALLINFO
+   return mallinfo2().uordblks;
+#else /* LOADPROF_MALLINFO */
+   return 0;
+#endif /* LOADPROF_MALLINFO */
+}
+
+/**
+ * @brief Converts performance counter ticks to milliseconds.
+ */
+static double loadprof_ms( Uint64 ticks )
+{
+   return 1000. * (double)ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Starts the profiler if it was requested.
+ */
+void loadprof_init (void)
+{
+   if (!conf.profile_load || loadprof_on)
+      return;
+   loadprof_lock     = SDL_CreateMutex();
+   loadprof_entries  = array_create( LoadProfEntry );
+   loadprof_t0       = SDL_GetPerformanceCounter();
+   loadprof_on       = 1;
+}
+
+/**
+ * @brief Checks to see if the profiler is running.
+ */
+int loadprof_enabled (void)
+{
+   return loadprof_on;
+}
+
+/**
+ * @brief Starts recording a stage on the current thread.
+ *
+ *    @param name Name of the stage, must stay valid until the report is written.
+ *    @return ID of the stage to pass to loadprof_stageEnd.
+ */
+int loadprof_stageBegin( const char *name )
+{
+   LoadProfStage *st;
+   int id;
+
+   if (!loadprof_on)
+      return -1;
+
+   SDL_mutexP( loadprof_lock );
+   if (loadprof_nstages >= LOADPROF_STAGES_MAX) {
+      SDL_mutexV( loadprof_lock );
+      return -1;
+   }
+   id = loadprof_nstages++;
+   st = &loadprof_stages[id];
+   st->name       = name;
+   st->heap_start = loadprof_heap();
+   atomic_store( &st->bytes, 0 );
+   st->start      = SDL_GetPerformanceCounter();
+   SDL_mutexV( loadprof_lock );
+
+   loadprof_cur = id;
+   return id;
+}
+
+/**
+ * @brief Stops recording a stage.
+ */
+void loadprof_stageEnd( int stage )
+{
+   LoadProfStage *st;
+
+   if (!loadprof_on || (stage < 0))
+      return;
+
+   SDL_mutexP( loadprof_lock );
+   st = &loadprof_stages[stage];
+   st->end        = SDL_GetPerformanceCounter();
+   st->heap_end   = loadprof_heap();
+   SDL_mutexV( loadprof_lock );
+
+   if (loadprof_cur == stage)
+      loadprof_cur = -1;
+}
+
+/**
+ * @brief Starts timing a file.
+ *
+ *    @return Value to pass to loadprof_fileEnd.
+ */
+Uint64 loadprof_fileBegin (void)
+{
+   if (!loadprof_on)
+      return 0;
+   return SDL_GetPerformanceCounter();
+}
+
+/**
+ * @brief Records a file load.
+ *
+ *    @param type Type of the file.
+ *    @param path ndata path of the file.
+ *    @param start Value returned by loadprof_fileBegin.
+ */
+void loadprof_fileEnd( LoadProfFile type, const char *path, Uint64 start )
+{
+   PHYSFS_Stat stat;
+   LoadProfEntry e;
+
+   if (!loadprof_on || (path == NULL))
+      return;
+
+   e.type   = type;
+   e.ticks  = SDL_GetPerformanceCounter() - start;
+   e.size   = (PHYSFS_stat( path, &stat ) && (stat.filesize > 0)) ? (size_t)stat.filesize : 0;
+   e.stage  = loadprof_cur;
+   e.path   = strdup( path );
+
+   SDL_mutexP( loadprof_lock );
+   array_push_back( &loadprof_entries, e );
+   SDL_mutexV( loadprof_lock );
+}
+
+/**
+ * @brief Records bytes read from the ndata.
+ */
+void loadprof_bytes( size_t n )
+{
+   if (!loadprof_on)
+      return;
+   atomic_fetch_add( &loadprof_total, n );
+   if (loadprof_cur >= 0)
+      atomic_fetch_add( &loadprof_stages[loadprof_cur].bytes, n );
+}
+
+/**
+ * @brief Sorts entries by type and then slowest first.
+ */
+static int loadprof_cmp( const void *p1, const void *p2 )
+{
+   const LoadProfEntry *e1 = p1;
+   const LoadProfEntry *e2 = p2;
+   if (e1->type != e2->type)
+      return e1->type - e2->type;
+   if (e1->ticks != e2->ticks)
+      return (e1->ticks > e2->ticks) ? -1 : 1;
+   return strcmp( e1->path, e2->path );
+}
+
+/**
+ * @brief Gets a short description of the slowest files.
+ *
+ *    @param[out] buf Buffer to write to, empty if not profiling.
+ *    @param len Size of the buffer.
+ */
+void loadprof_summary( char *buf, size_t len )
+{
+   int idx[LOADPROF_SUMMARY];
+   int n = 0, l = 0;
+
+   if (len > 0)
+      buf[0] = '\0';
+   if (!loadprof_on)
+      return;
+
+   SDL_mutexP( loadprof_lock );
+   for (int i=0; i<array_size(loadprof_entries); i++) {
+      int j;
+      Uint64 t = loadprof_entries[i].ticks;
+      if ((n == LOADPROF_SUMMARY) && (t <= loadprof_entries[idx[n-1]].ticks))
+         continue;
+      /* Insert sorted. */
+      j = MIN( n, LOADPROF_SUMMARY-1 );
+      while ((j > 0) && (loadprof_entries[idx[j-1]].ticks < t)) {
+         idx[j] = idx[j-1];
+         j--;
+      }
+      idx[j] = i;
+      n = MIN( n+1, LOADPROF_SUMMARY );
+   }
+   for (int i=0; i<n; i++) {
+      const LoadProfEntry *e = &loadprof_entries[idx[i]];
+      l += scnprintf( &buf[l], len-l, "%s%s (%.0f ms)", (i==0) ? "" : ", ",
+            e->path, loadprof_ms( e->ticks ) );
+   }
+   SDL_mutexV( loadprof_lock );
+}
+
+/**
+ * @brief Writes a JSON string.
+ */
+static void loadprof_writeStr( PHYSFS_File *f, const char *str )
+{
+   PHYSFS_writeBytes( f, "\"", 1 );
+   for (const char *c=str; *c!='\0'; c++) {
+      if ((*c == '"') || (*c == '\\'))
+         PHYSFS_writeBytes( f, "\\", 1 );
+      if ((unsigned char)*c < 0x20)
+         loadprof_printf( f, "\\u%04x", (unsigned char)*c );
+      else
+         PHYSFS_writeBytes( f, c, 1 );
+   }
+   PHYSFS_writeBytes( f, "\"", 1 );
+}
+
+/**
+ * @brief printf to a PhysicsFS file.
+ */
+static void loadprof_printf( PHYSFS_File *f, const char *fmt, ... )
+{
+   char buf[STRMAX];
+   va_list ap;
+   int n;
+
+   va_start( ap, fmt );
+   n = vsnprintf( buf, sizeof(buf), fmt, ap );
+   va_end( ap );
+   if (n > 0)
+      PHYSFS_writeBytes( f, buf, MIN( (size_t)n, sizeof(buf)-1 ) );
+}
+
+/**
+ * @brief Writes the report to the write directory and stops the profiler.
+ */
+void loadprof_dump (void)
+{
+   PHYSFS_File *f;
+   Uint64 now;
+
+   if (!loadprof_on)
+      return;
+   loadprof_on = 0;
+   now = SDL_GetPerformanceCounter();
+
+   qsort( loadprof_entries, array_size(loadprof_entries), sizeof(LoadProfEntry), loadprof_cmp );
+
+   f = PHYSFS_openWrite( LOADPROF_REPORT );
+   if (f == NULL)
+      WARN(_("Unable to open '%s' for writing: %s"), LOADPROF_REPORT,
+            _(PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+   else {
+      loadprof_printf( f, "{\n  \"version\": " );
+      loadprof_writeStr( f, naev_version(1) );
+      loadprof_printf( f, ",\n  \"total_ms\": %.3f,\n  \"bytes_read\": %zu,\n  \"stages\": [",
+            loadprof_ms( now - loadprof_t0 ), atomic_load( &loadprof_total ) );
+      for (int i=0; i<loadprof_nstages; i++) {
+         const LoadProfStage *st = &loadprof_stages[i];
+         loadprof_printf( f, "%s\n    { \"name\": ", (i==0) ? "" : "," );
+         loadprof_writeStr( f, st->name );
+         loadprof_printf( f, ", \"start_ms\": %.3f, \"ms\": %.3f, \"heap_delta\": %lld, \"bytes_read\": %zu }",
+               loadprof_ms( st->start - loadprof_t0 ), loadprof_ms( st->end - st->start ),
+               (long long)st->heap_end - (long long)st->heap_start, atomic_load( &st->bytes ) );
+      }
+      loadprof_printf( f, "\n  ],\n  \"files\": {" );
+      for (int t=0; t<LOADPROF_FILE_MAX; t++) {
+         int n = 0, total = 0;
+         Uint64 ticks = 0;
+         for (int i=0; i<array_size(loadprof_entries); i++) {
+            if ((int)loadprof_entries[i].type != t)
+               continue;
+            total++;
+            ticks += loadprof_entries[i].ticks;
+         }
+         loadprof_printf( f, "%s\n    \"%s\": { \"count\": %d, \"ms\": %.3f, \"slowest\": [",
+               (t==0) ? "" : ",", loadprof_typeNames[t], total, loadprof_ms( ticks ) );
+         for (int i=0; i<array_size(loadprof_entries) && (n < LOADPROF_TOP); i++) {
+            const LoadProfEntry *e = &loadprof_entries[i];
+            if ((int)e->type != t)
+               continue;
+            loadprof_printf( f, "%s\n      { \"path\": ", (n==0) ? "" : "," );
+            loadprof_writeStr( f, e->path );
+            loadprof_printf( f, ", \"ms\": %.3f, \"size\": %zu, \"stage\": ", loadprof_ms( e->ticks ), e->size );
+            if (e->stage >= 0)
+               loadprof_writeStr( f, loadprof_stages[e->stage].name );
+            else
+               loadprof_printf( f, "null" );
+            loadprof_printf( f, " }" );
+            n++;
+         }
+         loadprof_printf( f, "%s] }", (n > 0) ? "\n    " : "" );
+      }
+      loadprof_printf( f, "\n  }\n}\n" );
+      PHYSFS_close( f );
+      LOG(_("Wrote load profile to '%s%s'."), PHYSFS_getWriteDir(), LOADPROF_REPORT );
+   }
+
+   for (int i=0; i<array_size(loadprof_entries); i++)
+      free( loadprof_entries[i].path );
+   array_free( loadprof_entries );
+   loadprof_entries = NULL;
+   SDL_DestroyMutex( loadprof_lock );
+   loadprof_lock = NULL;
+}
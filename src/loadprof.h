@@ -0,0 +1,36 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+#include "SDL.h"
+/** @endcond */
+
+/**
+ * @brief Types of files tracked by the load profiler.
+ */
+typedef enum LoadProfFile_ {
+   LOADPROF_XML,     /**< XML documents. */
+   LOADPROF_LUA,     /**< Lua scripts. */
+   LOADPROF_IMAGE,   /**< Images loaded as textures. */
+   LOADPROF_SOUND,   /**< Sounds. */
+   LOADPROF_FILE_MAX,
+} LoadProfFile;
+
+void loadprof_init (void);
+int loadprof_enabled (void);
+
+/* Stages. */
+int loadprof_stageBegin( const char *name );
+void loadprof_stageEnd( int stage );
+
+/* Files. */
+Uint64 loadprof_fileBegin (void);
+void loadprof_fileEnd( LoadProfFile type, const char *path, Uint64 start );
+void loadprof_bytes( size_t n );
+
+/* Report. */
+void loadprof_summary( char *buf, size_t len );
+void loadprof_dump (void);
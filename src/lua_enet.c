@@ -30,6 +30,7 @@
  * THE SOFTWARE.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -41,6 +42,8 @@
 #include "lauxlib.h"
 #include <enet/enet.h>
 
+#include "nlua_data.h"
+
 #define check_host(l, idx)\
 	*(ENetHost**)luaL_checkudata(l, idx, "enet_host")
 
@@ -132,24 +135,31 @@ static void push_peer(lua_State *l, ENetPeer *peer) {
 	lua_remove(l, -2); // remove enet_peers
 }
 
-static void push_event(lua_State *l, ENetEvent *event) {
-	lua_newtable(l); // event table
-
-	if (event->peer) {
+/**
+ * Fill the event table on top of the stack
+ * Every field is set, so tables can be reused between events.
+ */
+static void fill_event(lua_State *l, ENetEvent *event) {
+	if (event->peer)
 		push_peer(l, event->peer);
-		lua_setfield(l, -2, "peer");
-	}
+	else
+		lua_pushnil(l);
+	lua_setfield(l, -2, "peer");
 
 	switch (event->type) {
 		case ENET_EVENT_TYPE_CONNECT:
 			lua_pushinteger(l, event->data);
 			lua_setfield(l, -2, "data");
+			lua_pushnil(l);
+			lua_setfield(l, -2, "channel");
 
 			lua_pushstring(l, "connect");
 			break;
 		case ENET_EVENT_TYPE_DISCONNECT:
 			lua_pushinteger(l, event->data);
 			lua_setfield(l, -2, "data");
+			lua_pushnil(l);
+			lua_setfield(l, -2, "channel");
 
 			lua_pushstring(l, "disconnect");
 			break;
@@ -165,6 +175,11 @@ static void push_event(lua_State *l, ENetEvent *event) {
 			enet_packet_destroy(event->packet);
 			break;
 		case ENET_EVENT_TYPE_NONE:
+			lua_pushnil(l);
+			lua_setfield(l, -2, "data");
+			lua_pushnil(l);
+			lua_setfield(l, -2, "channel");
+
 			lua_pushstring(l, "none");
 			break;
 	}
@@ -172,16 +187,41 @@ static void push_event(lua_State *l, ENetEvent *event) {
 	lua_setfield(l, -2, "type");
 }
 
+static void push_event(lua_State *l, ENetEvent *event) {
+	lua_newtable(l); // event table
+	fill_event(l, event);
+}
+
 /**
- * Read a packet off the stack as a string
+ * Release the data a packet was created from without copying
+ */
+static void packet_free_data(ENetPacket *packet) {
+	luaL_unref(naevL, LUA_REGISTRYINDEX, (int)(intptr_t)packet->userData);
+}
+
+/**
+ * Read a packet off the stack as a string or data
  * idx is position of string
+ *
+ * Packets made from data point to its buffer instead of copying it, and keep
+ * a reference to it until ENet is done with them. The data must therefore not
+ * be modified until the packet has been sent.
  */
 static ENetPacket *read_packet(lua_State *l, int idx, enet_uint8 *channel_id) {
 	size_t size;
 	int argc = lua_gettop(l);
-	const void *data = luaL_checklstring(l, idx, &size);
+	const void *data;
+	LuaData_t *ld = NULL;
 	ENetPacket *packet;
 
+	if (lua_isdata(l, idx)) {
+		ld = lua_todata(l, idx);
+		data = ld->data;
+		size = ld->size;
+	}
+	else
+		data = luaL_checklstring(l, idx, &size);
+
 	enet_uint32 flags = ENET_PACKET_FLAG_RELIABLE;
 	*channel_id = 0;
 
@@ -202,7 +242,16 @@ static ENetPacket *read_packet(lua_State *l, int idx, enet_uint8 *channel_id) {
 		*channel_id = luaL_checkint(l, idx+1);
 	}
 
-	packet = enet_packet_create(data, size, flags);
+	if (ld != NULL) {
+		packet = enet_packet_create(data, size, flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+		if (packet != NULL) {
+			lua_pushvalue(l, idx);
+			packet->userData = (void*)(intptr_t)luaL_ref(l, LUA_REGISTRYINDEX);
+			packet->freeCallback = packet_free_data;
+		}
+	}
+	else
+		packet = enet_packet_create(data, size, flags);
 	if (packet == NULL) {
 		luaL_error(l, "Failed to create packet");
 	}
@@ -301,6 +350,65 @@ static int host_service(lua_State *l) {
 	return 1;
 }
 
+/**
+ * Service a host and dispatch all the pending events
+ * Args:
+ *	timeout
+ *	[events] table of a previous call to reuse
+ *
+ * Return
+ *	array of the event tables in the order received
+ *	number of events
+ *
+ * The event tables of the reused table are filled again instead of creating
+ * new ones, so they must not be kept around between calls.
+ */
+static int host_service_all(lua_State *l) {
+	ENetHost *host = check_host(l, 1);
+	if (!host) {
+		return luaL_error(l, "Tried to index a nil host!");
+	}
+	ENetEvent event;
+	int timeout = 0, out, n = 0, len;
+
+	if (lua_gettop(l) > 1 && !lua_isnil(l, 2))
+		timeout = luaL_checkint(l, 2);
+
+	if (lua_gettop(l) > 2 && !lua_isnil(l, 3)) {
+		luaL_checktype(l, 3, LUA_TTABLE);
+		lua_pushvalue(l, 3);
+	}
+	else
+		lua_newtable(l);
+	len = lua_objlen(l, -1);
+
+	out = enet_host_service(host, &event, timeout);
+	while (out > 0) {
+		n++;
+		lua_rawgeti(l, -1, n);
+		if (!lua_istable(l, -1)) {
+			lua_pop(l, 1);
+			lua_newtable(l);
+			lua_pushvalue(l, -1);
+			lua_rawseti(l, -3, n);
+		}
+		fill_event(l, &event);
+		lua_pop(l, 1);
+
+		out = enet_host_check_events(host, &event);
+	}
+	if (out < 0) return luaL_error(l, "Error during service");
+
+	// drop the events left over from the previous call
+	for (int i = n+1; i <= len; i++) {
+		lua_pushnil(l);
+		lua_rawseti(l, -2, i);
+	}
+
+	lua_pushinteger(l, n);
+	return 2;
+}
+
 /**
  * Dispatch a single event if available
  */
@@ -747,6 +855,7 @@ static const struct luaL_Reg enet_funcs [] = {
 
 static const struct luaL_Reg enet_host_funcs [] = {
 	{"service", host_service},
+	{"service_all", host_service_all},
 	{"check_events", host_check_events},
 	{"compress_with_range_coder", host_compress_with_range_coder},
 	{"connect", host_connect},
@@ -0,0 +1,448 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file luaprof.c
+ *
+ * @brief Lua profiler, attributing time and allocations to each environment.
+ *
+ * Enabled with --profile-lua, in which case a line per active environment is
+ *  also written every frame to a CSV file in the write directory, or from the
+ *  console with luaprof(). Every call made through nlua_pcall() is timed, and
+ *  nested calls into other environments are taken out of the self time of
+ *  the caller.
+ *
+ * Environments are named after the script they run or, for missions, events,
+ *  AI profiles and outfits, after what they belong to. Environments with the
+ *  same name, such as instances of a mission, are added up together. Callers
+ *  sharing an environment, such as spobs using the same script, can have their
+ *  calls recorded apart with luaprof_nextName().
+ *
+ * Allocations are counted by the allocator of the Lua state when it could be
+ *  replaced, otherwise they are estimated from the memory growth of the state
+ *  during each call, which misses what was allocated and collected in it.
+ */
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+#include "physfs.h"
+#include "SDL.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "luaprof.h"
+
+#include "array.h"
+#include "conf.h"
+#include "log.h"
+#include "nameindex.h"
+#include "nlua.h"
+#include "nstring.h"
+
+#define LUAPROF_DEPTH   64 /**< Maximum depth of nested calls that gets recorded. */
+#define LUAPROF_TOP     20 /**< Number of environments shown in the report. */
+#define LUAPROF_CSV     "lua_profile.csv" /**< Per frame report in the write directory. */
+#define LUAPROF_UNNAMED "env" /**< Name of the environments that were not given one. */
+
+/**
+ * @brief Profiling data of the environments sharing a name.
+ */
+typedef struct LuaProfEntry_ {
+   char *name;       /**< Name of the environments. */
+   int calls;        /**< Number of calls. */
+   Uint64 ticks;     /**< Ticks spent in the calls, including nested calls. */
+   Uint64 self;      /**< Ticks spent in the calls, excluding nested calls. */
+   int64_t mem;      /**< Bytes allocated. */
+   int f_calls;      /**< Calls this frame. */
+   Uint64 f_ticks;   /**< Ticks this frame, including nested calls. */
+   Uint64 f_self;    /**< Ticks this frame, excluding nested calls. */
+   int64_t f_mem;    /**< Bytes allocated this frame. */
+} LuaProfEntry;
+
+/**
+ * @brief Call being recorded.
+ */
+typedef struct LuaProfCall_ {
+   int entry;        /**< Entry the call is attributed to. */
+   Uint64 start;     /**< Performance counter at the start. */
+   Uint64 child;     /**< Ticks spent in nested calls. */
+   int64_t mem;      /**< Memory of the state at the start, when estimating. */
+   int64_t child_mem;/**< Memory growth of nested calls, when estimating. */
+} LuaProfCall;
+
+static int luaprof_on      = 0; /**< Whether the profiler is recording. */
+static int luaprof_exact   = 0; /**< Whether the allocator reports allocations. */
+static LuaProfEntry *luaprof_entries = NULL; /**< Array (array.h): Entries by name. */
+static NameIndex luaprof_names; /**< Looks up entries by name. */
+static int *luaprof_envs   = NULL; /**< Array (array.h): Entry of each environment, by reference. */
+static LuaProfCall luaprof_stack[LUAPROF_DEPTH]; /**< Calls being recorded. */
+static int luaprof_depth   = 0; /**< Number of calls being recorded. */
+static int luaprof_next    = -1; /**< Entry the next call is attributed to, -1 for that of its environment. */
+static PHYSFS_File *luaprof_csv = NULL; /**< Per frame report. */
+static unsigned int luaprof_frames = 0; /**< Frames written to the per frame report. */
+static LuaProfSort luaprof_sortby = LUAPROF_SORT_TIME; /**< What luaprof_cmp sorts by. */
+
+/*
+ * Prototypes.
+ */
+static int luaprof_entry( const char *name );
+static int64_t luaprof_mem (void);
+static double luaprof_ms( Uint64 ticks );
+static int luaprof_cmp( const void *p1, const void *p2 );
+
+/**
+ * @brief Gets the entry of a name, creating it if needed.
+ */
+static int luaprof_entry( const char *name )
+{
+   LuaProfEntry *e;
+   int id = nameindex_get( &luaprof_names, name );
+   if (id >= 0)
+      return id;
+
+   if (luaprof_entries == NULL) {
+      luaprof_entries = array_create( LuaProfEntry );
+      nameindex_init( &luaprof_names, 0 );
+   }
+   e = &array_grow( &luaprof_entries );
+   memset( e, 0, sizeof(LuaProfEntry) );
+   e->name = strdup( name );
+   id = array_size(luaprof_entries)-1;
+   nameindex_add( &luaprof_names, e->name, id );
+   return id;
+}
+
+/**
+ * @brief Gets the memory used by the Lua state in bytes.
+ */
+static int64_t luaprof_mem (void)
+{
+   return (int64_t)lua_gc( naevL, LUA_GCCOUNT, 0 )*1024 + lua_gc( naevL, LUA_GCCOUNTB, 0 );
+}
+
+/**
+ * @brief Converts performance counter ticks to milliseconds.
+ */
+static double luaprof_ms( Uint64 ticks )
+{
+   return 1000. * (double)ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Starts the profiler and the per frame report if it was requested.
+ */
+void luaprof_init (void)
+{
+   if (!conf.profile_lua)
+      return;
+
+   luaprof_csv = PHYSFS_openWrite( LUAPROF_CSV );
+   if (luaprof_csv == NULL)
+      WARN(_("Unable to open '%s' for writing: %s"), LUAPROF_CSV,
+            _(PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+   else {
+      const char header[] = "frame,env,calls,ms,self_ms,alloc_bytes\n";
+      PHYSFS_writeBytes( luaprof_csv, header, sizeof(header)-1 );
+   }
+   luaprof_start();
+}
+
+/**
+ * @brief Stops the profiler and frees its data.
+ */
+void luaprof_exit (void)
+{
+   if (luaprof_csv != NULL) {
+      PHYSFS_close( luaprof_csv );
+      LOG(_("Wrote Lua profile of %u frames to '%s%s'."), luaprof_frames,
+            PHYSFS_getWriteDir(), LUAPROF_CSV );
+      luaprof_csv = NULL;
+   }
+   luaprof_on   = 0;
+   luaprof_next = -1;
+   for (int i=0; i<array_size(luaprof_entries); i++)
+      free( luaprof_entries[i].name );
+   array_free( luaprof_entries );
+   luaprof_entries = NULL;
+   nameindex_free( &luaprof_names );
+   array_free( luaprof_envs );
+   luaprof_envs = NULL;
+}
+
+/**
+ * @brief Checks to see if the profiler is recording.
+ */
+int luaprof_enabled (void)
+{
+   return luaprof_on;
+}
+
+/**
+ * @brief Starts recording.
+ */
+void luaprof_start (void)
+{
+   luaprof_on = 1;
+}
+
+/**
+ * @brief Stops recording, keeping what was recorded.
+ */
+void luaprof_stop (void)
+{
+   luaprof_on = 0;
+}
+
+/**
+ * @brief Clears what was recorded.
+ */
+void luaprof_reset (void)
+{
+   for (int i=0; i<array_size(luaprof_entries); i++) {
+      LuaProfEntry *e = &luaprof_entries[i];
+      char *name = e->name;
+      memset( e, 0, sizeof(LuaProfEntry) );
+      e->name = name;
+   }
+}
+
+/**
+ * @brief Names an environment.
+ *
+ * Names are recorded even when the profiler is off, so that it can be started
+ *  at any time.
+ *
+ *    @param env Environment to name.
+ *    @param name Name to give.
+ *    @param replace Whether to replace the name the environment already has.
+ */
+void luaprof_setName( int env, const char *name, int replace )
+{
+   int n;
+
+   if ((env < 0) || (name == NULL))
+      return;
+   if (luaprof_envs == NULL)
+      luaprof_envs = array_create( int );
+
+   n = array_size(luaprof_envs);
+   if (env >= n) {
+      array_resize( &luaprof_envs, env+1 );
+      for (int i=n; i<=env; i++)
+         luaprof_envs[i] = -1;
+   }
+   if (!replace && (luaprof_envs[env] >= 0))
+      return;
+   luaprof_envs[env] = luaprof_entry( name );
+}
+
+/**
+ * @brief Forgets the name of a freed environment, as its reference gets reused.
+ */
+void luaprof_freeEnv( int env )
+{
+   if ((env >= 0) && (env < array_size(luaprof_envs)))
+      luaprof_envs[env] = -1;
+}
+
+/**
+ * @brief Forgets the names of all the environments, for when the Lua state is
+ *        closed.
+ */
+void luaprof_clearEnvs (void)
+{
+   if (luaprof_envs != NULL)
+      array_resize( &luaprof_envs, 0 );
+   luaprof_exact = 0;
+}
+
+/**
+ * @brief Attributes the next call to a name instead of its environment.
+ *
+ * Does nothing when the profiler is not recording.
+ *
+ *    @param name Name to attribute the next call to.
+ */
+void luaprof_nextName( const char *name )
+{
+   if (!luaprof_on || (name == NULL))
+      return;
+   luaprof_next = luaprof_entry( name );
+}
+
+/**
+ * @brief Starts recording a call.
+ *
+ *    @param env Environment being called.
+ *    @return 1 if the call is being recorded and luaprof_leave has to be called.
+ */
+int luaprof_enter( int env )
+{
+   LuaProfCall *c;
+   int next = luaprof_next;
+
+   luaprof_next = -1;
+   if (!luaprof_on || (luaprof_depth >= LUAPROF_DEPTH))
+      return 0;
+
+   c = &luaprof_stack[ luaprof_depth++ ];
+   if (next >= 0)
+      c->entry = next;
+   else if ((env >= 0) && (env < array_size(luaprof_envs)) && (luaprof_envs[env] >= 0))
+      c->entry = luaprof_envs[env];
+   else
+      c->entry = luaprof_entry( LUAPROF_UNNAMED );
+   c->child     = 0;
+   c->child_mem = 0;
+   c->mem       = luaprof_exact ? 0 : luaprof_mem();
+   c->start     = SDL_GetPerformanceCounter();
+   return 1;
+}
+
+/**
+ * @brief Finishes recording the last call started with luaprof_enter.
+ */
+void luaprof_leave (void)
+{
+   Uint64 ticks = SDL_GetPerformanceCounter();
+   LuaProfCall *c = &luaprof_stack[ --luaprof_depth ];
+   LuaProfEntry *e = &luaprof_entries[ c->entry ];
+
+   ticks -= c->start;
+   e->calls++;
+   e->f_calls++;
+   e->ticks   += ticks;
+   e->f_ticks += ticks;
+   e->self    += ticks - MIN( c->child, ticks );
+   e->f_self  += ticks - MIN( c->child, ticks );
+   if (luaprof_depth > 0)
+      luaprof_stack[ luaprof_depth-1 ].child += ticks;
+
+   /* Collections during the call can make the memory go down. */
+   if (!luaprof_exact) {
+      int64_t grown = MAX( 0, luaprof_mem() - c->mem );
+      e->mem   += MAX( 0, grown - c->child_mem );
+      e->f_mem += MAX( 0, grown - c->child_mem );
+      if (luaprof_depth > 0)
+         luaprof_stack[ luaprof_depth-1 ].child_mem += grown;
+   }
+}
+
+/**
+ * @brief Attributes an allocation to the call being recorded.
+ *
+ * Called from the allocator of the Lua state.
+ *
+ *    @param bytes Bytes allocated.
+ */
+void luaprof_alloc( size_t bytes )
+{
+   LuaProfEntry *e;
+   if (luaprof_depth <= 0)
+      return;
+   e = &luaprof_entries[ luaprof_stack[ luaprof_depth-1 ].entry ];
+   e->mem   += bytes;
+   e->f_mem += bytes;
+}
+
+/**
+ * @brief Marks allocations as reported by the allocator of the Lua state.
+ */
+void luaprof_exactAlloc (void)
+{
+   luaprof_exact = 1;
+}
+
+/**
+ * @brief Writes the frame to the per frame report, meant to be called at the
+ *        end of every frame.
+ */
+void luaprof_frame (void)
+{
+   if (!luaprof_on)
+      return;
+
+   for (int i=0; i<array_size(luaprof_entries); i++) {
+      LuaProfEntry *e = &luaprof_entries[i];
+      if (e->f_calls == 0)
+         continue;
+      if (luaprof_csv != NULL) {
+         char buf[STRMAX_SHORT];
+         int n = snprintf( buf, sizeof(buf), "%u,\"%s\",%d,%.4f,%.4f,%lld\n",
+               luaprof_frames, e->name, e->f_calls, luaprof_ms( e->f_ticks ),
+               luaprof_ms( e->f_self ), (long long)e->f_mem );
+         if (n > 0)
+            PHYSFS_writeBytes( luaprof_csv, buf, MIN( (size_t)n, sizeof(buf)-1 ) );
+      }
+      e->f_calls = 0;
+      e->f_ticks = 0;
+      e->f_self  = 0;
+      e->f_mem   = 0;
+   }
+   luaprof_frames++;
+}
+
+/**
+ * @brief Compares two entries by index, biggest first.
+ */
+static int luaprof_cmp( const void *p1, const void *p2 )
+{
+   const LuaProfEntry *e1 = &luaprof_entries[ *(const int*)p1 ];
+   const LuaProfEntry *e2 = &luaprof_entries[ *(const int*)p2 ];
+   int64_t v1, v2;
+   switch (luaprof_sortby) {
+      case LUAPROF_SORT_SELF:
+         v1 = e1->self;
+         v2 = e2->self;
+         break;
+      case LUAPROF_SORT_MEM:
+         v1 = e1->mem;
+         v2 = e2->mem;
+         break;
+      case LUAPROF_SORT_CALLS:
+         v1 = e1->calls;
+         v2 = e2->calls;
+         break;
+      default:
+         v1 = e1->ticks;
+         v2 = e2->ticks;
+         break;
+   }
+   if (v1 != v2)
+      return (v1 > v2) ? -1 : 1;
+   return strcmp( e1->name, e2->name );
+}
+
+/**
+ * @brief Prints the environments that used the most resources.
+ *
+ *    @param sort What to sort them by.
+ *    @param print Function to print each line with.
+ */
+void luaprof_print( LuaProfSort sort, void (*print)( const char *str ) )
+{
+   char buf[STRMAX_SHORT];
+   int n = array_size(luaprof_entries);
+   int *order = malloc( MAX(n,1) * sizeof(int) );
+
+   for (int i=0; i<n; i++)
+      order[i] = i;
+   luaprof_sortby = sort;
+   qsort( order, n, sizeof(int), luaprof_cmp );
+
+   snprintf( buf, sizeof(buf), _("%s (%s allocations):"),
+         luaprof_on ? _("Lua profile") : _("Lua profile (stopped)"),
+         luaprof_exact ? _("counted") : _("estimated") );
+   print( buf );
+   print( _("   calls        ms   self ms        KiB  environment") );
+   for (int i=0; i<MIN(n,LUAPROF_TOP); i++) {
+      const LuaProfEntry *e = &luaprof_entries[ order[i] ];
+      if (e->calls == 0)
+         break;
+      snprintf( buf, sizeof(buf), "%8d %9.1f %9.1f %10.1f  %s", e->calls,
+            luaprof_ms( e->ticks ), luaprof_ms( e->self ), e->mem / 1024., e->name );
+      print( buf );
+   }
+   free( order );
+}
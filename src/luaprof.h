@@ -0,0 +1,41 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+/**
+ * @brief What the Lua profiler report can be sorted by.
+ */
+typedef enum LuaProfSort_ {
+   LUAPROF_SORT_TIME,   /**< Time including nested calls. */
+   LUAPROF_SORT_SELF,   /**< Time excluding nested calls into other environments. */
+   LUAPROF_SORT_MEM,    /**< Bytes allocated. */
+   LUAPROF_SORT_CALLS,  /**< Number of calls. */
+} LuaProfSort;
+
+void luaprof_init (void);
+void luaprof_exit (void);
+int luaprof_enabled (void);
+void luaprof_start (void);
+void luaprof_stop (void);
+void luaprof_reset (void);
+
+/* Environments. */
+void luaprof_setName( int env, const char *name, int replace );
+void luaprof_freeEnv( int env );
+void luaprof_clearEnvs (void);
+
+/* Recording. */
+void luaprof_nextName( const char *name );
+int luaprof_enter( int env );
+void luaprof_leave (void);
+void luaprof_alloc( size_t bytes );
+void luaprof_exactAlloc (void);
+void luaprof_frame (void);
+
+/* Report. */
+void luaprof_print( LuaProfSort sort, void (*print)( const char *str ) );
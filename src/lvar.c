@@ -16,7 +16,6 @@
  * prototypes
  */
 static int lvar_cmp( const void *p1, const void *p2 );
-static void lvar_free( lvar *var );
 
 /**
  * @brief Compares two lua variable names. For use with qsort/bsearch.
@@ -121,7 +120,7 @@ lvar lvar_tovar( lua_State *L, const char *name, int idx )
  *
  *    @param var Lua variable to free.
  */
-static void lvar_free( lvar *var )
+void lvar_free( lvar *var )
 {
    switch (var->type) {
       case LVAR_STR:
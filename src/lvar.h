@@ -37,6 +37,7 @@ typedef struct lvar_ {
  */
 int lvar_addArray( lvar **arr, const lvar *new_var, int sort );
 void lvar_rmArray( lvar **arr, lvar *rm_var );
+void lvar_free( lvar *var );
 void lvar_freeArray( lvar *var );
 lvar *lvar_get( const lvar *arr, const char *str );
 
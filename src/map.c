@@ -16,6 +16,7 @@
 #include "array.h"
 #include "colour.h"
 #include "dialogue.h"
+#include "economy.h"
 #include "faction.h"
 #include "gui.h"
 #include "log.h"
@@ -28,17 +29,24 @@
 #include "ndata.h"
 #include "nmath.h"
 #include "nstring.h"
+#include "ntracing.h"
 #include "nxml.h"
 #include "opengl.h"
 #include "player.h"
 #include "space.h"
+#include "threadpool.h"
 #include "toolkit.h"
 #include "utf8.h"
 
 #define BUTTON_WIDTH    100 /**< Map button width. */
 #define BUTTON_HEIGHT   30 /**< Map button height. */
 #define MAP_LOOP_PROT   1000 /**< Number of iterations max in pathfinding before aborting. */
+#define MAP_JUMPDIST_CHUNK 16 /**< Minimum number of systems per thread when building the jump distances. */
 #define MAP_TEXT_INDENT   45 /**< Indentation of the text below the titles. */
+#define MAP_TILE_SIZE     256 /**< Size of the tiles the static map layers are cached in. */
+#define MAP_TILE_MAX      160 /**< Tiles to keep around before reusing the least recently used. */
+#define MAP_LANE_STRIDE   15 /**< Floats per jump lane vertex: centre, corner, direction, width and two colours. */
+#define MAP_DISK_STRIDE   9  /**< Floats per faction disk vertex: centre, corner, size and colour. */
 #define MAP_MARKER_CYCLE  750 /**< Time of a mission marker's animation cycle in milliseconds. */
 #define MAP_MOVE_THRESHOLD 20. /**< Mouse movement distance threshold */
 #define EASE_ALPHA   ease_QuadraticInOut /**< Ease function for alpha. */
@@ -94,6 +102,62 @@ static Commodity **commod_known = NULL; /**< index of known commodities */
 static char** map_modes       = NULL;   /**< Array (array.h) of the map modes' names, e.g. "Gold: Cost". */
 static int listMapModeVisible = 0;      /**< Whether the map mode list widget is visible. */
 static double commod_av_gal_price = 0;  /**< Average price across the galaxy. */
+/**
+ * @brief Known prices of the current commodity in a system.
+ */
+typedef struct MapCommodSys_ {
+   int cnt;             /**< Number of spobs with a known price. */
+   double min;          /**< Lowest known price, HUGE_VAL if none. */
+   double max;          /**< Highest known price, 0 if none. */
+   double mean;         /**< Mean of the known prices. */
+} MapCommodSys;
+/**
+ * @brief Static layers of the map that are cached in tiles.
+ */
+typedef enum MapTileLayer_ {
+   MAP_TILE_FACTION, /**< Faction disks. */
+   MAP_TILE_JUMPS,   /**< Jump routes. */
+   MAP_TILE_SYSTEMS, /**< System circles. */
+   MAP_TILE_NAMES,   /**< System names. */
+} MapTileLayer;
+/**
+ * @brief Cached rendering of a layer of the map.
+ *
+ * Tile (i,j) of a layer covers MAP_TILE_SIZE units of the zoomed map starting
+ *  at (i*MAP_TILE_SIZE, j*MAP_TILE_SIZE), so tiles do not depend on panning.
+ */
+typedef struct MapTile_ {
+   MapTileLayer layer;  /**< Layer the tile is of. */
+   int i;               /**< Horizontal index. */
+   int j;               /**< Vertical index. */
+   GLuint fbo;          /**< Framebuffer of the tile. */
+   GLuint tex;          /**< Texture of the tile, with premultiplied alpha. */
+   int valid;           /**< Whether or not the rendering is up to date. */
+   unsigned int used;   /**< Frame the tile was last drawn on. */
+} MapTile;
+static MapTile *map_tiles     = NULL; /**< Array (array.h): Cached map tiles. */
+static double map_tiles_zoom  = -1.;  /**< Zoom the tiles were rendered at. */
+static MapMode map_tiles_mode = MAPMODE_TRAVEL; /**< Mode the tiles were rendered with. */
+static int map_tiles_pw       = 0;    /**< Width of the tiles in pixels. */
+static int map_tiles_ph       = 0;    /**< Height of the tiles in pixels. */
+static unsigned int map_tiles_frame = 0; /**< Frame counter for tile eviction. */
+/**
+ * @brief Geometry of a map layer drawn in a single call.
+ *
+ * Vertices are in map coordinates, the offset and zoom are uniforms.
+ */
+typedef struct MapGeom_ {
+   gl_vbo *vbo;         /**< Vertex buffer. */
+   GLsizei size;        /**< Size of the vertex buffer. */
+   GLfloat *data;       /**< Array (array.h): Vertex data being built. */
+   int n;               /**< Number of vertices in the buffer. */
+   int valid;           /**< Whether or not the buffer is up to date. */
+} MapGeom;
+static MapGeom map_lanes = { .vbo = NULL }; /**< Jump lanes. */
+static MapGeom map_disks = { .vbo = NULL }; /**< Faction disks. */
+static MapCommodSys *commod_sys = NULL;       /**< Array (array.h): Per system, known prices of commod_sys_c. */
+static const Commodity *commod_sys_c = NULL;  /**< Commodity commod_sys was computed for. */
+static unsigned int commod_sys_gen = 0;       /**< Seen price generation commod_sys was computed at. */
 static double map_dt          = 0.;     /**< Nebula animation stuff. */
 static int map_minimal_mode   = 0;      /**< Map is in minimal mode. */
 static double map_flyto_speed = 1500.;  /**< Linear speeed at which the map flies to a location. */
@@ -128,6 +192,17 @@ static void map_renderCommodIgnorance( double x, double y, double zoom,
       const StarSystem *sys, const Commodity *c, double a );
 static void map_drawMarker( double x, double y, double zoom,
       double r, double a, int num, int cur, int type );
+static void map_tilesCheck( double zoom, MapMode mode );
+static void map_tilesFree (void);
+static MapTile *map_tileGet( MapTileLayer layer, int i, int j );
+static void map_tileRender( MapTile *t, double zoom, double r );
+static void map_renderTiles( MapTileLayer layer, double bx, double by, double w, double h,
+      double x, double y, double zoom, double r, double alpha );
+static void map_geomQuad( MapGeom *g, GLfloat *v, int stride );
+static void map_geomUpload( MapGeom *g, int stride, int valid );
+static void map_geomFree( MapGeom *g );
+static void map_genFactionDisks( int editor );
+static void map_genJumps( int editor );
 /* Mouse. */
 static void map_focusLose( unsigned int wid, const char* wgtname );
 static int map_mouse( unsigned int wid, const SDL_Event* event, double mx, double my,
@@ -147,7 +222,10 @@ static void map_buttonCommodity( unsigned int wid, const char* str );
 static void map_selectCur (void);
 static void map_genModeList(void);
 static void map_update_commod_av_price();
+static const MapCommodSys *map_commodSys( const Commodity *c );
 static void map_onClose( unsigned int wid, const char *str );
+static void A_free (void);
+static void map_jumpDistFree (void);
 
 /**
  * @brief Initializes the map subsystem.
@@ -171,6 +249,11 @@ void map_exit (void)
       decorator_stack = NULL;
    }
 
+   A_free();
+   map_jumpDistFree();
+   map_tilesFree();
+   map_geomFree( &map_lanes );
+   map_geomFree( &map_disks );
    ovr_exit();
 }
 
@@ -238,6 +321,9 @@ static void map_setup (void)
 
    /* mark systems as needed */
    mission_sysMark();
+
+   /* What the map shows may have changed. */
+   map_tilesInvalidate();
 }
 
 /**
@@ -434,6 +520,54 @@ void map_open (void)
    }
 }
 
+/**
+ * @brief Gets the known prices of a commodity in each system.
+ *
+ * They only change when the player sees new prices, so they are computed
+ *  once instead of on every frame the commodity map modes are rendered.
+ *
+ *    @param c Commodity to get prices of.
+ *    @return Array (array.h) of the prices, indexed by system id.
+ */
+static const MapCommodSys *map_commodSys( const Commodity *c )
+{
+   if ((commod_sys != NULL) && (commod_sys_c == c) && (commod_sys_gen == economy_seenGeneration())
+         && (array_size(commod_sys) == array_size(systems_stack)))
+      return commod_sys;
+
+   if (commod_sys == NULL)
+      commod_sys = array_create_size( MapCommodSys, array_size(systems_stack) );
+   array_resize( &commod_sys, array_size(systems_stack) );
+   for (int i=0; i<array_size(systems_stack); i++) {
+      const StarSystem *sys = system_getIndex( i );
+      MapCommodSys *cs = &commod_sys[i];
+      double sum = 0.;
+      cs->cnt = 0;
+      cs->min = HUGE_VAL;
+      cs->max = 0.;
+      for (int j=0; j<array_size(sys->spobs); j++) {
+         const Spob *p = sys->spobs[j];
+         for (int k=0; k<array_size(p->commodities); k++) {
+            double thisPrice;
+            if (p->commodities[k] != c)
+               continue;
+            if (p->commodityPrice[k].cnt <= 0) /* commodity is not known about */
+               continue;
+            thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
+            cs->max = MAX( thisPrice, cs->max );
+            cs->min = MIN( thisPrice, cs->min );
+            sum += thisPrice;
+            cs->cnt++;
+            break;
+         }
+      }
+      cs->mean = (cs->cnt > 0) ? sum / cs->cnt : 0.;
+   }
+   commod_sys_c   = c;
+   commod_sys_gen = economy_seenGeneration();
+   return commod_sys;
+}
+
 /*
  * Prepares economy info for rendering.  Called when cur_commod changes.
  */
@@ -448,6 +582,7 @@ static void map_update_commod_av_price (void)
 
    c = commod_known[cur_commod];
    if (cur_commod_mode == 0) {
+      const MapCommodSys *csys = map_commodSys( c );
       double totPrice = 0;
       int totPriceCnt = 0;
       for (int i=0; i<array_size(systems_stack); i++) {
@@ -458,24 +593,8 @@ static void map_update_commod_av_price (void)
               && !space_sysReachable(sys)))
             continue;
          if ((sys_isKnown(sys)) && (system_hasSpob(sys))) {
-            double sumPrice = 0;
-            int sumCnt = 0;
-            double thisPrice;
-            for (int j=0 ; j<array_size(sys->spobs); j++) {
-               Spob *p = sys->spobs[j];
-               for (int k=0; k<array_size(p->commodities); k++) {
-                  if (p->commodities[k] == c) {
-                     if (p->commodityPrice[k].cnt > 0) { /*commodity is known about*/
-                        thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                        sumPrice += thisPrice;
-                        sumCnt += 1;
-                        break;
-                     }
-                  }
-               }
-            }
-            if (sumCnt>0) {
-               totPrice += sumPrice / sumCnt;
+            if (csys[i].cnt > 0) {
+               totPrice += csys[i].mean;
                totPriceCnt++;
             }
          }
@@ -1006,6 +1125,10 @@ static void map_render( double bx, double by, double w, double h, void *data )
    map_renderParams( bx, by, cst->xpos, cst->ypos, w, h, cst->zoom, &x, &y, &r );
    z = cst->zoom;
 
+   /* Static layers are drawn from cached tiles. */
+   map_tilesCheck( z, cst->mode );
+   map_tiles_frame++;
+
    /* background */
    gl_renderRect( bx, by, w, h, &cBlack );
 
@@ -1014,29 +1137,29 @@ static void map_render( double bx, double by, double w, double h, void *data )
 
    /* Render faction disks. */
    if (cst->alpha_faction > 0.)
-      map_renderFactionDisks( x, y, z, r, 0, EASE_ALPHA(cst->alpha_faction) );
+      map_renderTiles( MAP_TILE_FACTION, bx, by, w, h, x, y, z, r, EASE_ALPHA(cst->alpha_faction) );
 
       /* Render environmental features. */
    if (cst->alpha_env > 0.)
       map_renderSystemEnvironment( x, y, z, 0, EASE_ALPHA(cst->alpha_env) );
 
    /* Render jump routes. */
-   map_renderJumps( x, y, z, r, 0 );
+   map_renderTiles( MAP_TILE_JUMPS, bx, by, w, h, x, y, z, r, 1. );
 
    /* Render the player's jump route. */
    if (cst->alpha_path > 0.)
       map_renderPath( x, y, z, r, EASE_ALPHA(cst->alpha_path) );
 
    /* Render systems. */
-   map_renderSystems( bx, by, x, y, z, w, h, r, cst->mode );
+   map_renderTiles( MAP_TILE_SYSTEMS, bx, by, w, h, x, y, z, r, 1. );
 
    /* Render system markers and notes. */
    if (cst->alpha_markers > 0.)
       map_renderMarkers( x, y, z, r, EASE_ALPHA(cst->alpha_markers) );
 
    /* Render system names and notes. */
-   if (cst->alpha_names > 0.)
-      map_renderNames( bx, by, x, y, z, w, h, 0, EASE_ALPHA(cst->alpha_names) );
+   if ((cst->alpha_names > 0.) && (z > 0.5))
+      map_renderTiles( MAP_TILE_NAMES, bx, by, w, h, x, y, z, r, EASE_ALPHA(cst->alpha_names) );
 
    /* Render commodity info. */
    if (cst->alpha_commod > 0.)
@@ -1063,6 +1186,178 @@ static void map_render( double bx, double by, double w, double h, void *data )
    glClear( GL_DEPTH_BUFFER_BIT );
 }
 
+/**
+ * @brief Marks the cached map tiles and geometry as outdated.
+ *
+ * Has to be called whenever what the map shows changes, such as known
+ *  systems and jumps or the universe itself.
+ */
+void map_tilesInvalidate (void)
+{
+   for (int i=0; i<array_size(map_tiles); i++)
+      map_tiles[i].valid = 0;
+   map_lanes.valid = 0;
+   map_disks.valid = 0;
+}
+
+/**
+ * @brief Invalidates the map tiles if they were rendered with other parameters.
+ */
+static void map_tilesCheck( double zoom, MapMode mode )
+{
+   int pw = ceil( MAP_TILE_SIZE * (double)gl_screen.rw / (double)gl_screen.nw );
+   int ph = ceil( MAP_TILE_SIZE * (double)gl_screen.rh / (double)gl_screen.nh );
+
+   /* Framebuffers have to be recreated. */
+   if ((pw != map_tiles_pw) || (ph != map_tiles_ph)) {
+      map_tilesFree();
+      map_tiles_pw = pw;
+      map_tiles_ph = ph;
+   }
+
+   if ((zoom != map_tiles_zoom) || (mode != map_tiles_mode)) {
+      map_tilesInvalidate();
+      map_tiles_zoom = zoom;
+      map_tiles_mode = mode;
+   }
+}
+
+/**
+ * @brief Frees all the cached map tiles.
+ */
+static void map_tilesFree (void)
+{
+   for (int i=0; i<array_size(map_tiles); i++) {
+      glDeleteFramebuffers( 1, &map_tiles[i].fbo );
+      glDeleteTextures( 1, &map_tiles[i].tex );
+   }
+   array_free( map_tiles );
+   map_tiles = NULL;
+}
+
+/**
+ * @brief Gets a map tile, reusing the least recently used if there are too many.
+ */
+static MapTile *map_tileGet( MapTileLayer layer, int i, int j )
+{
+   MapTile *t, *lru;
+
+   if (map_tiles == NULL)
+      map_tiles = array_create_size( MapTile, MAP_TILE_MAX );
+
+   lru = NULL;
+   for (int k=0; k<array_size(map_tiles); k++) {
+      t = &map_tiles[k];
+      if ((t->layer == layer) && (t->i == i) && (t->j == j))
+         return t;
+      if ((lru == NULL) || (t->used < lru->used))
+         lru = t;
+   }
+
+   /* Tiles drawn this frame can't be reused. */
+   if ((array_size(map_tiles) >= MAP_TILE_MAX) && (lru->used != map_tiles_frame))
+      t = lru;
+   else {
+      t = &array_grow( &map_tiles );
+      gl_fboCreate( &t->fbo, &t->tex, map_tiles_pw, map_tiles_ph );
+   }
+   t->layer = layer;
+   t->i     = i;
+   t->j     = j;
+   t->valid = 0;
+   return t;
+}
+
+/**
+ * @brief Renders a layer of the map into a tile.
+ */
+static void map_tileRender( MapTile *t, double zoom, double r )
+{
+   GLint fbo, viewport[4];
+   GLboolean scissor;
+   mat4 view = gl_view_matrix;
+   double x = -t->i * MAP_TILE_SIZE;
+   double y = -t->j * MAP_TILE_SIZE;
+
+   /* The map may be getting rendered into a framebuffer already. */
+   glGetIntegerv( GL_FRAMEBUFFER_BINDING, &fbo );
+   glGetIntegerv( GL_VIEWPORT, viewport );
+   scissor = glIsEnabled( GL_SCISSOR_TEST );
+
+   glDisable( GL_SCISSOR_TEST );
+   glBindFramebuffer( GL_FRAMEBUFFER, t->fbo );
+   glViewport( 0, 0, map_tiles_pw, map_tiles_ph );
+   glClearColor( 0., 0., 0., 0. );
+   glClear( GL_COLOR_BUFFER_BIT );
+   gl_view_matrix = mat4_ortho( 0., MAP_TILE_SIZE, 0., MAP_TILE_SIZE, -1., 1. );
+   /* Premultiply so the tiles can be faded when drawn. */
+   glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+
+   switch (t->layer) {
+      case MAP_TILE_FACTION:
+         map_renderFactionDisks( x, y, zoom, r, 0, 1. );
+         break;
+      case MAP_TILE_JUMPS:
+         map_renderJumps( x, y, zoom, r, 0 );
+         break;
+      case MAP_TILE_SYSTEMS:
+         map_renderSystems( 0., 0., x, y, zoom, MAP_TILE_SIZE, MAP_TILE_SIZE, r, map_tiles_mode );
+         break;
+      case MAP_TILE_NAMES:
+         map_renderNames( 0., 0., x, y, zoom, MAP_TILE_SIZE, MAP_TILE_SIZE, 0, 1. );
+         break;
+   }
+
+   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   gl_view_matrix = view;
+   glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+   glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+   if (scissor)
+      glEnable( GL_SCISSOR_TEST );
+   glClearColor( 0., 0., 0., 1. );
+   gl_checkErr();
+
+   t->valid = 1;
+}
+
+/**
+ * @brief Renders a static layer of the map from cached tiles.
+ *
+ *    @param layer Layer to render.
+ *    @param bx Base X position of the map widget.
+ *    @param by Base Y position of the map widget.
+ *    @param w Width of the map widget.
+ *    @param h Height of the map widget.
+ *    @param x X position of the map origin.
+ *    @param y Y position of the map origin.
+ *    @param zoom Zoom of the map.
+ *    @param r Radius of the systems.
+ *    @param alpha Alpha to render the layer with.
+ */
+static void map_renderTiles( MapTileLayer layer, double bx, double by, double w, double h,
+      double x, double y, double zoom, double r, double alpha )
+{
+   const glColour c = { .r=alpha, .g=alpha, .b=alpha, .a=alpha };
+   int imin = floor( (bx - x) / MAP_TILE_SIZE );
+   int imax = floor( (bx + w - x) / MAP_TILE_SIZE );
+   int jmin = floor( (by - y) / MAP_TILE_SIZE );
+   int jmax = floor( (by + h - y) / MAP_TILE_SIZE );
+
+   for (int j=jmin; j<=jmax; j++) {
+      for (int i=imin; i<=imax; i++) {
+         MapTile *t = map_tileGet( layer, i, j );
+         if (!t->valid)
+            map_tileRender( t, zoom, r );
+         t->used = map_tiles_frame;
+
+         glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+         gl_renderTextureRaw( t->tex, 0, x + i*MAP_TILE_SIZE, y + j*MAP_TILE_SIZE,
+               MAP_TILE_SIZE, MAP_TILE_SIZE, 0., 0., 1., 1., &c, 0. );
+         glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+      }
+   }
+}
+
 /**
  * @brief Gets the render parameters.
  */
@@ -1126,13 +1421,74 @@ void map_renderDecorators( double x, double y, double zoom, int editor, double a
 }
 
 /**
- * @brief Renders the faction disks.
+ * @brief Adds a quad to map geometry.
+ *
+ *    @param g Geometry to add to.
+ *    @param v Vertex data, the corner (third and fourth floats) is filled in.
+ *    @param stride Floats per vertex.
  */
-void map_renderFactionDisks( double x, double y, double zoom, double r, int editor, double alpha )
+static void map_geomQuad( MapGeom *g, GLfloat *v, int stride )
+{
+   static const GLfloat corners[6][2] = {
+      {-1., -1.}, {1., -1.}, {-1., 1.},
+      {1., -1.}, {1., 1.}, {-1., 1.} };
+   if (g->data == NULL)
+      g->data = array_create( GLfloat );
+   for (int i=0; i<6; i++) {
+      int n = array_size( g->data );
+      v[2] = corners[i][0];
+      v[3] = corners[i][1];
+      array_resize( &g->data, n+stride );
+      memcpy( &g->data[n], v, sizeof(GLfloat) * stride );
+   }
+}
+
+/**
+ * @brief Uploads the built map geometry.
+ *
+ *    @param g Geometry to upload.
+ *    @param stride Floats per vertex.
+ *    @param valid Whether the geometry can be reused on the next frames.
+ */
+static void map_geomUpload( MapGeom *g, int stride, int valid )
+{
+   GLsizei size = sizeof(GLfloat) * array_size( g->data );
+   g->n     = array_size( g->data ) / stride;
+   g->valid = valid;
+   if (size > 0) {
+      if (g->vbo == NULL) {
+         g->vbo  = gl_vboCreateDynamic( size, g->data );
+         g->size = size;
+      }
+      else if (size > g->size) {
+         gl_vboData( g->vbo, size, g->data );
+         g->size = size;
+      }
+      else
+         gl_vboSubData( g->vbo, 0, size, g->data );
+   }
+   array_resize( &g->data, 0 );
+}
+
+/**
+ * @brief Frees map geometry.
+ */
+static void map_geomFree( MapGeom *g )
+{
+   gl_vboDestroy( g->vbo );
+   array_free( g->data );
+   memset( g, 0, sizeof(MapGeom) );
+}
+
+/**
+ * @brief Builds the geometry of the faction disks.
+ */
+static void map_genFactionDisks( int editor )
 {
    for (int i=0; i<array_size(systems_stack); i++) {
-      glColour c;
-      double tx, ty;
+      GLfloat v[MAP_DISK_STRIDE];
+      const glColour *col;
+      double presence;
       StarSystem *sys = system_getIndex( i );
 
       if (sys_isFlag(sys,SYSTEM_HIDDEN))
@@ -1141,28 +1497,66 @@ void map_renderFactionDisks( double x, double y, double zoom, double r, int edit
       if ((!sys_isFlag(sys, SYSTEM_HAS_KNOWN_LANDABLE) || !sys_isKnown(sys)) && !editor)
          continue;
 
-      tx = x + sys->pos.x*zoom;
-      ty = y + sys->pos.y*zoom;
-
       /* System has faction and is known or we are in editor. */
-      if (sys->faction != -1) {
-         const glColour *col;
-         double presence = sqrt(sys->ownerpresence);
+      if (sys->faction == -1)
+         continue;
 
-         /* draws the disk representing the faction */
-         double sr = (40. + presence * 3.) * zoom * 0.5;
+      /* draws the disk representing the faction */
+      presence = sqrt(sys->ownerpresence);
+      col  = faction_colour(sys->faction);
+      v[0] = sys->pos.x;
+      v[1] = sys->pos.y;
+      v[4] = (40. + presence * 3.) * 0.5;
+      v[5] = col->r;
+      v[6] = col->g;
+      v[7] = col->b;
+      v[8] = 0.6;
+      map_geomQuad( &map_disks, v, MAP_DISK_STRIDE );
+   }
+   /* The editor can move systems around, so don't keep it. */
+   map_geomUpload( &map_disks, MAP_DISK_STRIDE, !editor );
+}
 
-         col = faction_colour(sys->faction);
-         c.r = col->r;
-         c.g = col->g;
-         c.b = col->b;
-         c.a = 0.6 * alpha;
+/**
+ * @brief Renders the faction disks.
+ */
+void map_renderFactionDisks( double x, double y, double zoom, double r, int editor, double alpha )
+{
+   const GLsizei stride = sizeof(GLfloat) * MAP_DISK_STRIDE;
 
-         glUseProgram(shaders.factiondisk.program);
-         glUniform1f(shaders.factiondisk.paramf, r / sr );
-         gl_renderShader( tx, ty, sr, sr, 0., &shaders.factiondisk, &c, 1 );
-      }
-   }
+   if (editor || !map_disks.valid)
+      map_genFactionDisks( editor );
+   if (map_disks.n <= 0)
+      return;
+
+   glUseProgram( shaders.factiondisk_batch.program );
+   gl_uniformMat4( shaders.factiondisk_batch.projection, &gl_view_matrix );
+   glUniform2f( shaders.factiondisk_batch.offset, x, y );
+   glUniform1f( shaders.factiondisk_batch.zoom, zoom );
+   glUniform1f( shaders.factiondisk_batch.radius, r );
+   glUniform1f( shaders.factiondisk_batch.alpha, alpha );
+
+   glEnableVertexAttribArray( shaders.factiondisk_batch.vertex_center );
+   glEnableVertexAttribArray( shaders.factiondisk_batch.vertex_corner );
+   glEnableVertexAttribArray( shaders.factiondisk_batch.vertex_size );
+   glEnableVertexAttribArray( shaders.factiondisk_batch.vertex_colour );
+   gl_vboActivateAttribOffset( map_disks.vbo, shaders.factiondisk_batch.vertex_center,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_disks.vbo, shaders.factiondisk_batch.vertex_corner,
+         sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_disks.vbo, shaders.factiondisk_batch.vertex_size,
+         sizeof(GLfloat) * 4, 1, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_disks.vbo, shaders.factiondisk_batch.vertex_colour,
+         sizeof(GLfloat) * 5, 4, GL_FLOAT, stride );
+
+   gl_drawArrays( GL_TRIANGLES, 0, map_disks.n );
+
+   glDisableVertexAttribArray( shaders.factiondisk_batch.vertex_center );
+   glDisableVertexAttribArray( shaders.factiondisk_batch.vertex_corner );
+   glDisableVertexAttribArray( shaders.factiondisk_batch.vertex_size );
+   glDisableVertexAttribArray( shaders.factiondisk_batch.vertex_colour );
+   glUseProgram( 0 );
+   gl_checkErr();
 }
 
 /**
@@ -1210,7 +1604,7 @@ void map_renderSystemEnvironment( double x, double y, double zoom, int editor, d
          /* Draw. */
          glEnableVertexAttribArray( shaders.nebula_map.vertex );
          gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula_map.vertex, 0, 2, GL_FLOAT, 0 );
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clean up. */
          glDisableVertexAttribArray( shaders.nebula_map.vertex );
@@ -1239,7 +1633,7 @@ void map_renderSystemEnvironment( double x, double y, double zoom, int editor, d
          /* Draw. */
          glEnableVertexAttribArray( sys->ms->vertex );
          gl_vboActivateAttribOffset( gl_squareVBO, sys->ms->vertex, 0, 2, GL_FLOAT, 0 );
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clean up. */
          glDisableVertexAttribArray( sys->ms->vertex );
@@ -1250,12 +1644,11 @@ void map_renderSystemEnvironment( double x, double y, double zoom, int editor, d
 }
 
 /**
- * @brief Renders the jump routes between systems.
+ * @brief Builds the geometry of the jump routes between systems.
  */
-void map_renderJumps( double x, double y, double zoom, double radius, int editor )
+static void map_genJumps( int editor )
 {
    for (int i=0; i<array_size(systems_stack); i++) {
-      double x1,y1;
       StarSystem *sys = system_getIndex( i );
 
       if (sys_isFlag(sys,SYSTEM_HIDDEN))
@@ -1264,11 +1657,9 @@ void map_renderJumps( double x, double y, double zoom, double radius, int editor
       if (!sys_isKnown(sys) && !editor)
          continue; /* we don't draw hyperspace lines */
 
-      x1 = x + sys->pos.x * zoom;
-      y1 = y + sys->pos.y * zoom;
-
       for (int j=0; j < array_size(sys->jumps); j++) {
-         double x2,y2, rx,ry, r, rw,rh;
+         GLfloat v[MAP_LANE_STRIDE];
+         double rh;
          const glColour *col, *cole;
          StarSystem *jsys = sys->jumps[j].target;
          if (sys_isFlag(jsys,SYSTEM_HIDDEN))
@@ -1294,13 +1685,6 @@ void map_renderJumps( double x, double y, double zoom, double radius, int editor
          else
             col = &cAquaBlue;
 
-         x2 = x + jsys->pos.x * zoom;
-         y2 = y + jsys->pos.y * zoom;
-         rx = x2-x1;
-         ry = y2-y1;
-         r  = atan2( ry, rx );
-         rw = MOD(rx,ry)/2.;
-
          if (sys->jumps[j].hide<=0.) {
             col = &cGreen;
             rh = 2.5;
@@ -1309,12 +1693,73 @@ void map_renderJumps( double x, double y, double zoom, double radius, int editor
             rh = 1.5;
          }
 
-         glUseProgram( shaders.jumplane.program );
-         gl_uniformColour( shaders.jumplane.paramv, cole );
-         glUniform1f( shaders.jumplane.paramf, radius );
-         gl_renderShader( (x1+x2)/2., (y1+y2)/2., rw, rh, r, &shaders.jumplane, col, 1 );
+         v[0]  = (sys->pos.x + jsys->pos.x) / 2.;
+         v[1]  = (sys->pos.y + jsys->pos.y) / 2.;
+         v[4]  = (jsys->pos.x - sys->pos.x) / 2.;
+         v[5]  = (jsys->pos.y - sys->pos.y) / 2.;
+         v[6]  = rh;
+         v[7]  = col->r;
+         v[8]  = col->g;
+         v[9]  = col->b;
+         v[10] = col->a;
+         v[11] = cole->r;
+         v[12] = cole->g;
+         v[13] = cole->b;
+         v[14] = cole->a;
+         map_geomQuad( &map_lanes, v, MAP_LANE_STRIDE );
       }
    }
+   /* The editor can move systems around, so don't keep it. */
+   map_geomUpload( &map_lanes, MAP_LANE_STRIDE, !editor );
+}
+
+/**
+ * @brief Renders the jump routes between systems.
+ */
+void map_renderJumps( double x, double y, double zoom, double radius, int editor )
+{
+   const GLsizei stride = sizeof(GLfloat) * MAP_LANE_STRIDE;
+
+   if (editor || !map_lanes.valid)
+      map_genJumps( editor );
+   if (map_lanes.n <= 0)
+      return;
+
+   glUseProgram( shaders.jumplane_batch.program );
+   gl_uniformMat4( shaders.jumplane_batch.projection, &gl_view_matrix );
+   glUniform2f( shaders.jumplane_batch.offset, x, y );
+   glUniform1f( shaders.jumplane_batch.zoom, zoom );
+   glUniform1f( shaders.jumplane_batch.paramf, radius );
+
+   glEnableVertexAttribArray( shaders.jumplane_batch.vertex_center );
+   glEnableVertexAttribArray( shaders.jumplane_batch.vertex_corner );
+   glEnableVertexAttribArray( shaders.jumplane_batch.vertex_dir );
+   glEnableVertexAttribArray( shaders.jumplane_batch.vertex_width );
+   glEnableVertexAttribArray( shaders.jumplane_batch.vertex_colour );
+   glEnableVertexAttribArray( shaders.jumplane_batch.vertex_colour2 );
+   gl_vboActivateAttribOffset( map_lanes.vbo, shaders.jumplane_batch.vertex_center,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_lanes.vbo, shaders.jumplane_batch.vertex_corner,
+         sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_lanes.vbo, shaders.jumplane_batch.vertex_dir,
+         sizeof(GLfloat) * 4, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_lanes.vbo, shaders.jumplane_batch.vertex_width,
+         sizeof(GLfloat) * 6, 1, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_lanes.vbo, shaders.jumplane_batch.vertex_colour,
+         sizeof(GLfloat) * 7, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( map_lanes.vbo, shaders.jumplane_batch.vertex_colour2,
+         sizeof(GLfloat) * 11, 4, GL_FLOAT, stride );
+
+   gl_drawArrays( GL_TRIANGLES, 0, map_lanes.n );
+
+   glDisableVertexAttribArray( shaders.jumplane_batch.vertex_center );
+   glDisableVertexAttribArray( shaders.jumplane_batch.vertex_corner );
+   glDisableVertexAttribArray( shaders.jumplane_batch.vertex_dir );
+   glDisableVertexAttribArray( shaders.jumplane_batch.vertex_width );
+   glDisableVertexAttribArray( shaders.jumplane_batch.vertex_colour );
+   glDisableVertexAttribArray( shaders.jumplane_batch.vertex_colour2 );
+   glUseProgram( 0 );
+   gl_checkErr();
 }
 
 /**
@@ -1662,6 +2107,7 @@ void map_renderCommod( double bx, double by, double x, double y,
       double zoom, double w, double h, double r, int editor, double a )
 {
    Commodity *c;
+   const MapCommodSys *csys;
    glColour ccol;
 
    /* If not plotting commodities, return */
@@ -1669,6 +2115,7 @@ void map_renderCommod( double bx, double by, double x, double y,
       return;
 
    c = commod_known[cur_commod];
+   csys = map_commodSys( c );
    if (cur_commod_mode == 1) { /*showing price difference to selected system*/
       double curMaxPrice, curMinPrice;
       StarSystem *sys = system_getIndex( map_selected );
@@ -1695,23 +2142,8 @@ void map_renderCommod( double bx, double by, double x, double y,
       else {
          /* not currently landed, so get max and min price in the selected system. */
          if ((sys_isKnown(sys)) && (system_hasSpob(sys))) {
-            double minPrice = HUGE_VAL;
-            double maxPrice = 0;
-            for (int j=0; j<array_size(sys->spobs); j++) {
-               Spob *p = sys->spobs[j];
-               for (int k=0; k<array_size(p->commodities); k++) {
-                  double thisPrice;
-                  if (p->commodities[k] != c)
-                     continue;
-                  if (p->commodityPrice[k].cnt <= 0) /* commodity is not known about */
-                     continue;
-                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                  maxPrice = MAX( thisPrice, maxPrice );
-                  minPrice = MIN( thisPrice, minPrice );
-                  break;
-               }
-
-            }
+            double minPrice = csys[sys->id].min;
+            double maxPrice = csys[sys->id].max;
             if (maxPrice == 0) { /* no prices are known here */
                map_renderCommodIgnorance( x, y, zoom, sys, c, a );
                map_renderSysBlack( bx, by, x, y, zoom, w, h, r, editor );
@@ -1747,22 +2179,8 @@ void map_renderCommod( double bx, double by, double x, double y,
 
          /* If system is known fill it. */
          if ((sys_isKnown(sys)) && (system_hasSpob(sys))) {
-            double minPrice = HUGE_VAL;
-            double maxPrice = 0;
-            for (int j=0; j<array_size(sys->spobs); j++) {
-               Spob *p = sys->spobs[j];
-               for (int k=0; k<array_size(p->commodities); k++) {
-                  double thisPrice;
-                  if (p->commodities[k] != c)
-                     continue;
-                  if (p->commodityPrice[k].cnt <= 0) /*commodity is not known about */
-                     continue;
-                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                  maxPrice = MAX( thisPrice, maxPrice );
-                  minPrice = MIN( thisPrice, minPrice );
-                  break;
-               }
-            }
+            double minPrice = csys[i].min;
+            double maxPrice = csys[i].max;
 
             /* Calculate best and worst profits */
             if (maxPrice > 0) {
@@ -1822,28 +2240,11 @@ void map_renderCommod( double bx, double by, double x, double y,
 
          /* If system is known fill it. */
          if ((sys_isKnown(sys)) && (system_hasSpob(sys))) {
-            double sumPrice = 0;
-            int sumCnt = 0;
-            for (int j=0; j<array_size(sys->spobs); j++) {
-               Spob *p = sys->spobs[j];
-               for (int k=0; k<array_size(p->commodities); k++) {
-                  double thisPrice;
-                  if (p->commodities[k] != c)
-                     continue;
-                  if (p->commodityPrice[k].cnt <= 0) /* commodity is not known about */
-                     continue;
-                  thisPrice = p->commodityPrice[k].sum / p->commodityPrice[k].cnt;
-                  sumPrice += thisPrice;
-                  sumCnt += 1;
-                  break;
-               }
-            }
-
-            if (sumCnt > 0) {
+            if (csys[i].cnt > 0) {
                /* Commodity sold at this system */
                /* Colour as a % of global average */
                double frac;
-               sumPrice /= sumCnt;
+               double sumPrice = csys[i].mean;
                if (sumPrice < commod_av_gal_price) {
                   frac = tanh(5*(commod_av_gal_price / sumPrice - 1));
                   col_blend( &ccol, &cFontOrange, &cFontYellow, frac );
@@ -2323,6 +2724,9 @@ static void map_onClose( unsigned int wid, const char *str )
    (void) str;
    free( commod_known );
    commod_known = NULL;
+   array_free( commod_sys );
+   commod_sys   = NULL;
+   commod_sys_c = NULL;
    for (int i=0; i<array_size(map_modes); i++)
       free( map_modes[i] );
    array_free( map_modes );
@@ -2529,7 +2933,7 @@ void map_select( const StarSystem *sys, char shifted )
          if (player.p != NULL) {
             posstart = &player.p->solid.pos;
          }
-         map_path = map_getJumpPath( cur_system->name, posstart, sys->name, 0, 1, map_path, NULL );
+         map_path = map_getJumpPathSys( cur_system, posstart, sys, 0, 1, map_path, NULL );
 
          if (array_size(map_path)==0) {
             player_hyperspacePreempt(0);
@@ -2649,143 +3053,139 @@ void map_toggleNotes()
  * none.
  */
 /**
- * @brief Node structure for A* pathfinding.
+ * @brief Node structure for A* pathfinding, there is one per system.
  */
 typedef struct SysNode_ {
-   struct SysNode_ *next; /**< Next node */
-   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
-
-   struct SysNode_ *parent; /**< Parent node. */
-   StarSystem* sys; /**< System in node. */
-   int g; /**< step */
-   double d; /**< the distance to go access the systems. */
-   const vec2 *pos; /**< position of the entry of the system. */
+   unsigned int gen; /**< Search the node was last set up by. */
+   int parent;       /**< Index of the parent system, -1 for the start. */
+   int heap;         /**< Position in the open heap, -1 if not in it. */
+   int closed;       /**< Whether or not the node is in the closed set. */
+   int seq;          /**< Order it was opened in, to break ties. */
+   int g;            /**< step */
+   double d;         /**< the distance to go access the systems. */
+   const vec2 *pos;  /**< position of the entry of the system. */
 } SysNode; /**< System Node for use in A* pathfinding. */
-static SysNode *A_gc;
+static SysNode *A_nodes = NULL; /**< Nodes indexed by system id (array.h), reused between searches. */
+static int *A_open = NULL;      /**< Binary heap of the ids of the open systems (array.h). */
+static unsigned int A_gen = 0;  /**< Current search, nodes from older ones count as unvisited. */
+static int A_seq = 0;           /**< Number of nodes opened in the current search. */
 /* prototypes */
-static SysNode* A_newNode( StarSystem* sys );
-static int A_g( const SysNode* n );
-static double A_d( const SysNode* n );
+static SysNode* A_node( int id );
 static int A_less( const SysNode *op1, const SysNode *op2 );
-static SysNode* A_add( SysNode *first, SysNode *cur );
-static SysNode* A_rm( SysNode *first, const StarSystem *cur );
-static SysNode* A_in( SysNode *first, const StarSystem *cur );
-static SysNode* A_lowest( SysNode *first );
-static void A_freeList( SysNode *first );
+static int A_heapLess( int id1, int id2 );
+static void A_heapSet( int pos, int id );
+static void A_heapUp( int pos );
+static void A_heapDown( int pos );
+static void A_push( int id );
+static int A_pop (void);
+static int A_search( const StarSystem *ssys, const vec2 *pos, const StarSystem *esys,
+      int ignore_known, int show_hidden, int *last );
 static int map_decorator_parse( MapDecorator *temp, const char *file );
-/** @brief Creates a new node link to star system. */
-static SysNode* A_newNode( StarSystem* sys )
-{
-   SysNode *n = malloc(sizeof(SysNode));
-
-   n->next  = NULL;
-   n->sys   = sys;
-
-   n->gnext = A_gc;
-   A_gc     = n;
-
+/** @brief Gets the node of a system, resetting it if it was from a previous search. */
+static SysNode* A_node( int id )
+{
+   SysNode *n = &A_nodes[id];
+   if (n->gen != A_gen) {
+      n->gen    = A_gen;
+      n->parent = -1;
+      n->heap   = -1;
+      n->closed = 0;
+      n->seq    = 0;
+      n->g      = 0;
+      n->d      = 0.;
+      n->pos    = NULL;
+   }
    return n;
 }
-/** @brief Gets the g from a node. */
-static int A_g( const SysNode* n )
+/** @brief op1 is less than op2. */
+static int A_less( const SysNode *op1, const SysNode *op2 )
 {
-   return n->g;
+    return (op1->g < op2->g) || (op1->g == op2->g && op1->d < op2->d);
 }
-/** @brief Gets the d from a node. */
-static double A_d( const SysNode* n )
+/** @brief Orders the open heap, ties go to the node opened first. */
+static int A_heapLess( int id1, int id2 )
 {
-   return n->d;
+   const SysNode *n1 = &A_nodes[id1];
+   const SysNode *n2 = &A_nodes[id2];
+   if (A_less( n1, n2 ))
+      return 1;
+   if (A_less( n2, n1 ))
+      return 0;
+   return (n1->seq < n2->seq);
 }
-/** @brief op1 is less than op2. */
-static int A_less( const SysNode *op1, const SysNode *op2 )
+/** @brief Places a system at a position of the open heap. */
+static void A_heapSet( int pos, int id )
 {
-    return (A_g(op1) < A_g(op2)) || (A_g(op1) == A_g(op2) && A_d(op1) < A_d(op2));
+   A_open[pos] = id;
+   A_nodes[id].heap = pos;
 }
-/** @brief Adds a node to the linked list. */
-static SysNode* A_add( SysNode *first, SysNode *cur )
+/** @brief Moves an element of the open heap up until it is in order. */
+static void A_heapUp( int pos )
 {
-   SysNode *n;
-
-   if (first == NULL)
-      return cur;
-
-   n = first;
-   while (n->next != NULL)
-      n = n->next;
-   n->next = cur;
-
-   return first;
+   int id = A_open[pos];
+   while (pos > 0) {
+      int parent = (pos-1) / 2;
+      if (!A_heapLess( id, A_open[parent] ))
+         break;
+      A_heapSet( pos, A_open[parent] );
+      pos = parent;
+   }
+   A_heapSet( pos, id );
 }
-/* @brief Removes a node from a linked list. */
-static SysNode* A_rm( SysNode *first, const StarSystem *cur )
+/** @brief Moves an element of the open heap down until it is in order. */
+static void A_heapDown( int pos )
 {
-   SysNode *n, *p;
-
-   if (first->sys == cur) {
-      n = first->next;
-      first->next = NULL;
-      return n;
-   }
-
-   p = first;
-   n = p->next;
-   do {
-      if (n->sys == cur) {
-         p->next = n->next;
-         n->next = NULL;
+   int n  = array_size(A_open);
+   int id = A_open[pos];
+   while (1) {
+      int c = 2*pos+1;
+      if (c >= n)
          break;
-      }
-      p = n;
-   } while ((n=n->next) != NULL);
-
-   return first;
+      if ((c+1 < n) && A_heapLess( A_open[c+1], A_open[c] ))
+         c++;
+      if (!A_heapLess( A_open[c], id ))
+         break;
+      A_heapSet( pos, A_open[c] );
+      pos = c;
+   }
+   A_heapSet( pos, id );
 }
-/** @brief Checks to see if node is in linked list. */
-static SysNode* A_in( SysNode *first, const StarSystem *cur )
+/** @brief Adds a system to the open heap, or updates it if its cost went down. */
+static void A_push( int id )
 {
-   SysNode *n;
-
-   if (first == NULL)
-      return NULL;
-
-   n = first;
-   do {
-      if (n->sys == cur)
-         return n;
-   } while ((n=n->next) != NULL);
-   return NULL;
+   SysNode *n = &A_nodes[id];
+   if (n->heap < 0) {
+      array_push_back( &A_open, id );
+      n->heap = array_size(A_open)-1;
+   }
+   A_heapUp( n->heap );
 }
-/** @brief Returns the lowest ranking node from a linked list of nodes. */
-static SysNode* A_lowest( SysNode *first )
+/** @brief Removes the lowest ranking system from the open heap, -1 if empty. */
+static int A_pop (void)
 {
-   SysNode *lowest, *n;
+   int id, last, n;
 
-   if (first == NULL)
-      return NULL;
+   n = array_size(A_open);
+   if (n <= 0)
+      return -1;
 
-   n = first;
-   lowest = n;
-   do {
-      if (A_less(n, lowest))
-         lowest = n;
-   } while ((n=n->next) != NULL);
-   return lowest;
+   id   = A_open[0];
+   last = A_open[n-1];
+   A_nodes[id].heap = -1;
+   array_erase( &A_open, &A_open[n-1], &A_open[n] );
+   if (n > 1) {
+      A_heapSet( 0, last );
+      A_heapDown( 0 );
+   }
+   return id;
 }
-/** @brief Frees a linked list. */
-static void A_freeList( SysNode *first )
+/** @brief Frees the pathfinding buffers. */
+static void A_free (void)
 {
-   SysNode *p, *n;
-
-   if (first == NULL)
-      return;
-
-   p = NULL;
-   n = first;
-   do {
-      free(p);
-      p = n;
-   } while ((n=n->gnext) != NULL);
-   free(p);
+   array_free( A_nodes );
+   A_nodes = NULL;
+   array_free( A_open );
+   A_open = NULL;
 }
 
 /** @brief Sets map_zoom to zoom and recreates the faction disk texture. */
@@ -2810,24 +3210,48 @@ void map_setZoom( unsigned int wid, double zoom )
 StarSystem** map_getJumpPath( const char* sysstart, const vec2 *posstart, const char* sysend,
     int ignore_known, int show_hidden, StarSystem** old_data, double *o_distance )
 {
-   int j, ojumps;
-   StarSystem *ssys, *esys, **res;
+   const StarSystem *ssys = system_get(sysstart);
+   const StarSystem *esys = system_get(sysend);
+   if ((ssys == NULL) || (esys == NULL)) {
+      array_free( old_data );
+      return NULL;
+   }
+   return map_getJumpPathSys( ssys, posstart, esys, ignore_known, show_hidden, old_data, o_distance );
+}
 
-   SysNode *cur,   *neighbour;
-   SysNode *open,  *closed;
-   SysNode *ocost, *ccost;
+/**
+ * @brief Gets the jump path between two systems.
+ *
+ * The open set is a binary heap and the nodes are indexed by system and
+ *  reused between searches, so no memory is allocated other than the result.
+ *
+ *    @param sysstart System to start from.
+ *    @param posstart Position to start from. (Ignored it if old_data != NULL or posstart == NULL.
+ *    @param sysend System to end at.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @param old_data the old path (if we're merely extending)
+ *    @param o_distance output the sum of the distances to go across the systems if it's not NULL.
+ *    @return Array (array.h): the systems in the path. NULL on failure.
+ */
+StarSystem** map_getJumpPathSys( const StarSystem* sysstart, const vec2 *posstart, const StarSystem* sysend,
+    int ignore_known, int show_hidden, StarSystem** old_data, double *o_distance )
+{
+   int ojumps, cid, found;
+   const StarSystem *ssys, *esys;
+   StarSystem **res;
+   SysNode *cur;
 
-   A_gc = NULL;
    res = old_data;
    ojumps = array_size( old_data );
 
    /* initial and target systems */
-   ssys = system_get(sysstart); /* start */
-   esys = system_get(sysend); /* goal */
+   ssys = sysstart; /* start */
+   esys = sysend; /* goal */
 
    /* Set up. */
    if (ojumps > 0)
-      ssys = system_get( array_back( old_data )->name );
+      ssys = array_back( old_data );
 
    /* Check self. */
    if (ssys==esys || array_size(ssys->jumps)==0) {
@@ -2845,45 +3269,149 @@ StarSystem** map_getJumpPath( const char* sysstart, const vec2 *posstart, const
    /* initial entry position */
    const vec2 *p_pos_entry = (ojumps > 0) ? NULL : posstart;
    if (ojumps > 0) {
-      const char *prev_name = sysstart;
-      if (ojumps > 1) {
-         prev_name = old_data[ojumps - 2]->name;
-      }
-      const JumpPoint* jp = jump_get(prev_name, ssys);
+      const StarSystem *prev = sysstart;
+      if (ojumps > 1)
+         prev = old_data[ojumps - 2];
+      const JumpPoint* jp = jump_getTarget(prev, ssys);
       if (jp != NULL) {
          p_pos_entry = &jp->pos;
       }
    }
 
-   /* start the linked lists */
-   open     = closed = NULL;
-   cur      = A_newNode( ssys );
-   cur->parent = NULL;
-   cur->g   = 0;
-   cur->d   = 0.0;
-   cur->pos = p_pos_entry;
-   open     = A_add( open, cur ); /* Initial open node is the start system */
+   found = A_search( ssys, p_pos_entry, esys, ignore_known, show_hidden, &cid );
+   cur   = &A_nodes[cid];
+
+   if (o_distance != NULL) {
+       *o_distance = cur->d;
+   }
+
+   /* Build path backwards if not broken from loop. */
+   if (found) {
+      int njumps = cur->g + ojumps;
+      assert( njumps > ojumps );
+      if (res == NULL)
+         res = array_create_size( StarSystem*, njumps );
+      array_resize( &res, njumps );
+      /* Build path. */
+      for (int i=0; i<njumps-ojumps; i++) {
+         res[njumps-i-1] = system_getIndex( cid );
+         cid = A_nodes[cid].parent;
+      }
+   }
+   else {
+      res = NULL;
+      array_free( old_data );
+   }
+
+   return res;
+}
+
+/**
+ * @brief Gets the jump distances from a system to all the others.
+ *
+ * Runs the same search as map_getJumpPathSys without a goal, so the results
+ *  match the paths it would find for each system.
+ *
+ *    @param sysstart System to start from.
+ *    @param posstart Position to start from (or NULL).
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Array (array.h) of distances indexed by system id, must be freed.
+ */
+MapJumpDist* map_getJumpDistances( const StarSystem *sysstart, const vec2 *posstart,
+      int ignore_known, int show_hidden )
+{
+   int nsys = array_size( systems_stack );
+   MapJumpDist *res = array_create_size( MapJumpDist, nsys );
+   array_resize( &res, nsys );
+
+   A_search( sysstart, posstart, NULL, ignore_known, show_hidden, NULL );
+   for (int i=0; i<nsys; i++) {
+      const SysNode *n = &A_nodes[i];
+      /* Only closed nodes have their final cost. */
+      if ((n->gen != A_gen) || !n->closed) {
+         res[i].jumps    = -1;
+         res[i].distance = 0.;
+         res[i].entry    = NULL;
+         continue;
+      }
+      res[i].jumps    = n->g;
+      res[i].distance = n->d;
+      res[i].entry    = n->pos;
+   }
+   return res;
+}
+
+/**
+ * @brief Runs the search from a system, leaving the results in the nodes.
+ *
+ *    @param ssys System to start from.
+ *    @param pos Position the start system is entered at (or NULL).
+ *    @param esys System to stop at, or NULL to visit all the reachable ones.
+ *    @param ignore_known Whether or not to ignore if systems and jump points are known.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @param[out] last Id of the last system taken out of the open set (or NULL).
+ *    @return 1 if esys was reached, 0 otherwise.
+ */
+static int A_search( const StarSystem *ssys, const vec2 *pos, const StarSystem *esys,
+      int ignore_known, int show_hidden, int *last )
+{
+   int j, nsys, cid, lid, found;
+   SysNode *cur;
+
+   /* Set up the nodes, old ones are invalidated by bumping the generation. */
+   nsys = array_size( systems_stack );
+   if (A_nodes == NULL) {
+      A_nodes = array_create_size( SysNode, nsys );
+      A_open  = array_create( int );
+   }
+   if (array_size(A_nodes) < nsys) {
+      int n = array_size(A_nodes);
+      array_resize( &A_nodes, nsys );
+      memset( &A_nodes[n], 0, (nsys-n)*sizeof(SysNode) );
+   }
+   A_gen++;
+   if (A_gen == 0) { /* Wrapped around. */
+      memset( A_nodes, 0, array_size(A_nodes)*sizeof(SysNode) );
+      A_gen = 1;
+   }
+   A_seq = 0;
+   array_resize( &A_open, 0 );
+
+   /* Initial open node is the start system */
+   cur      = A_node( ssys->id );
+   cur->pos = pos;
+   cur->seq = A_seq++;
+   A_push( ssys->id );
 
    j = 0;
-   while ((cur = A_lowest(open))) {
+   found = 0;
+   lid = ssys->id;
+   while ((cid = A_pop()) >= 0) {
+      const StarSystem *csys = system_getIndex( cid );
       int cost;
+      cur = &A_nodes[cid];
+      lid = cid;
+
       /* End condition. */
-      if (cur->sys == esys)
+      if (csys == esys) {
+         found = 1;
          break;
+      }
 
       /* Break if infinite loop. */
       j++;
       if (j > MAP_LOOP_PROT)
          break;
 
-      /* Get best from open and toss to closed */
-      open   = A_rm( open, cur->sys );
-      closed = A_add( closed, cur );
-      cost   = A_g(cur) + 1; /* Base unit is jump and always increases by 1. */
+      /* Toss to closed */
+      cur->closed = 1;
+      cost   = cur->g + 1; /* Base unit is jump and always increases by 1. */
 
-      for (int i=0; i<array_size(cur->sys->jumps); i++) {
-         JumpPoint *jp  = &cur->sys->jumps[i];
-         StarSystem *sys = jp->target;
+      for (int i=0; i<array_size(csys->jumps); i++) {
+         const JumpPoint *jp  = &csys->jumps[i];
+         const StarSystem *sys = jp->target;
+         SysNode *neighbour;
 
          /* Make sure it's reachable */
          if (!ignore_known) {
@@ -2902,64 +3430,148 @@ StarSystem** map_getJumpPath( const char* sysstart, const vec2 *posstart, const
          /* Update cost */
          const SysNode n_cost = {
              .g = cost,
-             .d = A_d(cur) + ((cur->pos != NULL) ? vec2_dist(cur->pos, &jp->pos) : 0.0)
+             .d = cur->d + ((cur->pos != NULL) ? vec2_dist(cur->pos, &jp->pos) : 0.0)
          };
 
-         /* Check to see if it's already in the closed set. */
-         ccost = A_in(closed, sys);
-         if ((ccost != NULL) && !A_less(&n_cost, ccost))
+         /* Ignore if it's already closed or open with a better cost. */
+         neighbour = A_node( sys->id );
+         if ((neighbour->closed || (neighbour->heap >= 0)) && !A_less(&n_cost, neighbour))
             continue;
-            //closed = A_rm( closed, sys );
-
-         /* Remove if it exists and current is better. */
-         ocost = A_in(open, sys);
-         if (ocost != NULL) {
-            if (A_less(&n_cost, ocost))
-               open = A_rm( open, sys ); /* New path is better */
-            else
-               continue; /* This node is worse, so ignore it. */
-         }
 
-         /* Create the node. */
-         const JumpPoint *jp_entry = jump_getTarget(cur->sys, sys);
-         neighbour         = A_newNode( sys );
-         neighbour->parent = cur;
+         /* Set up the node. */
+         const JumpPoint *jp_entry = jump_getTarget(csys, sys);
+         neighbour->parent = cid;
+         neighbour->closed = 0;
+         neighbour->seq    = A_seq++;
          neighbour->g      = n_cost.g;
          neighbour->d      = n_cost.d;
          neighbour->pos    = (jp_entry != NULL) ? &jp_entry->pos : NULL;
-         open              = A_add( open, neighbour );
+         A_push( sys->id );
       }
-
-      /* Safety check in case not linked. */
-      if (open == NULL)
-         break;
    }
 
-   if (o_distance != NULL) {
-       *o_distance = cur->d;
-   }
+   if (last != NULL)
+      *last = lid;
+   return found;
+}
 
-   /* Build path backwards if not broken from loop. */
-   if (cur != NULL && esys == cur->sys) {
-      int njumps = A_g(cur) + ojumps;
-      assert( njumps > ojumps );
-      if (res == NULL)
-         res = array_create_size( StarSystem*, njumps );
-      array_resize( &res, njumps );
-      /* Build path. */
-      for (int i=0; i<njumps-ojumps; i++) {
-         res[njumps-i-1] = cur->sys;
-         cur = cur->parent;
+/*
+ * All-pairs jump distances, ignoring what the player knows.
+ */
+static int16_t *map_jumpdist[2] = { NULL, NULL }; /**< Row-major jump distances without and with hidden jumps, -1 if unreachable. */
+static int map_jumpdist_n = 0; /**< Number of systems the distances were computed for. */
+static int map_jumpdist_valid = 0; /**< Whether or not the distances are up to date. */
+/**
+ * @brief Data to compute rows of the jump distances.
+ */
+typedef struct JumpDistBuild_ {
+   int16_t *dist; /**< Distances to fill. */
+   int n;         /**< Number of systems. */
+   int hidden;    /**< Whether or not hidden jumps can be used. */
+} JumpDistBuild;
+
+/**
+ * @brief Computes the jump distances from a range of systems with a BFS each.
+ */
+static int map_jumpDistRows( void *data, int start, int end )
+{
+   const JumpDistBuild *b = data;
+   int *queue = malloc( b->n * sizeof(int) );
+   for (int s=start; s<end; s++) {
+      int16_t *row = &b->dist[ s*b->n ];
+      int head = 0, tail = 0;
+      for (int i=0; i<b->n; i++)
+         row[i] = -1;
+      row[s] = 0;
+      queue[tail++] = s;
+      while (head < tail) {
+         int id = queue[head++];
+         const StarSystem *sys = &systems_stack[id];
+         for (int i=0; i<array_size(sys->jumps); i++) {
+            const JumpPoint *jp = &sys->jumps[i];
+            int t = jp->targetid;
+            if (jp_isFlag( jp, JP_EXITONLY ))
+               continue;
+            if (!b->hidden && jp_isFlag( jp, JP_HIDDEN ))
+               continue;
+            if ((t < 0) || (t >= b->n) || (row[t] >= 0))
+               continue;
+            row[t] = row[id]+1;
+            queue[tail++] = t;
+         }
       }
    }
-   else {
-      res = NULL;
-      array_free( old_data );
+   free( queue );
+   return 0;
+}
+
+/**
+ * @brief Recomputes the jump distances between all the systems.
+ */
+static void map_jumpDistBuild (void)
+{
+   int n = array_size( systems_stack );
+
+   NTracingZone( _ctx, 1 );
+
+   if (n != map_jumpdist_n) {
+      map_jumpDistFree();
+      map_jumpdist_n = n;
+   }
+   for (int h=0; h<2; h++) {
+      JumpDistBuild b = { .n = n, .hidden = h };
+      if (map_jumpdist[h] == NULL)
+         map_jumpdist[h] = malloc( (size_t)n * n * sizeof(int16_t) );
+      b.dist = map_jumpdist[h];
+      job_parallelFor( n, MAP_JUMPDIST_CHUNK, map_jumpDistRows, &b );
    }
+   map_jumpdist_valid = 1;
 
-   /* free the linked lists */
-   A_freeList(A_gc);
-   return res;
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Frees the jump distances.
+ */
+static void map_jumpDistFree (void)
+{
+   for (int h=0; h<2; h++) {
+      free( map_jumpdist[h] );
+      map_jumpdist[h] = NULL;
+   }
+   map_jumpdist_n = 0;
+   map_jumpdist_valid = 0;
+}
+
+/**
+ * @brief Marks the jump distances as outdated, they get recomputed on next use.
+ *
+ * Has to be called whenever jumps are added or removed.
+ */
+void map_jumpDistInvalidate (void)
+{
+   map_jumpdist_valid = 0;
+}
+
+/**
+ * @brief Gets the number of jumps between two systems, ignoring what the
+ *        player knows.
+ *
+ * Gives the same number of jumps as the path from map_getJumpPath with
+ *  ignore_known set.
+ *
+ *    @param sysstart System to start from.
+ *    @param sysend System to end at.
+ *    @param show_hidden Whether or not to use hidden jumps points.
+ *    @return Number of jumps or -1 if unreachable.
+ */
+int map_jumpDist( const StarSystem *sysstart, const StarSystem *sysend, int show_hidden )
+{
+   if (!map_jumpdist_valid || (map_jumpdist_n != array_size(systems_stack)))
+      map_jumpDistBuild();
+   if ((sysstart->id >= map_jumpdist_n) || (sysend->id >= map_jumpdist_n))
+      return -1;
+   return map_jumpdist[!!show_hidden][ sysstart->id * map_jumpdist_n + sysend->id ];
 }
 
 /**
@@ -2971,6 +3583,8 @@ StarSystem** map_getJumpPath( const char* sysstart, const vec2 *posstart, const
  */
 int map_map( const Outfit *map )
 {
+   map_tilesInvalidate();
+
    for (int i=0; i<array_size(map->u.map->systems);i++)
       sys_setFlag(map->u.map->systems[i], SYSTEM_KNOWN);
 
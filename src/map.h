@@ -27,6 +27,15 @@ typedef enum MapMode_ {
    MAPMODE_EDITOR,   /**< Shows price values and the likes. */
 } MapMode;
 
+/**
+ * @brief Jump distance to a system, see map_getJumpDistances.
+ */
+typedef struct MapJumpDist_ {
+   int jumps;           /**< Number of jumps to the system, -1 if unreachable. */
+   double distance;     /**< Distance travelled across the systems on the way. */
+   const vec2 *entry;   /**< Position the system is entered at (or NULL). */
+} MapJumpDist;
+
 /* init/exit */
 int map_init (void);
 void map_exit (void);
@@ -49,6 +58,13 @@ void map_jump (void);
 /* manipulate universe stuff */
 StarSystem **map_getJumpPath( const char *sysstart, const vec2 *posstart, const char *sysend,
       int ignore_known, int show_hidden, StarSystem **old_data, double *o_distance );
+StarSystem **map_getJumpPathSys( const StarSystem *sysstart, const vec2 *posstart, const StarSystem *sysend,
+      int ignore_known, int show_hidden, StarSystem **old_data, double *o_distance );
+MapJumpDist *map_getJumpDistances( const StarSystem *sysstart, const vec2 *posstart,
+      int ignore_known, int show_hidden );
+int map_jumpDist( const StarSystem *sysstart, const StarSystem *sysend, int show_hidden );
+void map_jumpDistInvalidate (void);
+void map_tilesInvalidate (void);
 int map_map( const Outfit *map );
 int map_isUseless( const Outfit* map );
 
@@ -36,6 +36,16 @@ static char **map_foundOutfitNames  = NULL; /**< Array (array.h): Internal names
 /* Tech hack. */
 static tech_group_t **map_known_techs = NULL; /**< Array (array.h) of known techs. */
 static Spob **map_known_spobs   = NULL;  /**< Array (array.h) of known spobs with techs. */
+/**
+ * @brief Something sold at a known spob.
+ */
+typedef struct MapFindSold_ {
+   const void *item; /**< Outfit or ship sold. */
+   int spob;         /**< Index of the spob in map_known_spobs. */
+} MapFindSold;
+static MapFindSold *map_known_outfits = NULL; /**< Array (array.h) of outfits sold at known spobs, sorted by outfit. */
+static MapFindSold *map_known_ships   = NULL; /**< Array (array.h) of ships sold at known spobs, sorted by ship. */
+static MapJumpDist *map_find_dist     = NULL; /**< Array (array.h) of jump distances from the current system during a search. */
 
 /*
  * Prototypes.
@@ -43,6 +53,9 @@ static Spob **map_known_spobs   = NULL;  /**< Array (array.h) of known spobs wit
 /* Init/cleanup. */
 static int map_knownInit (void);
 static void map_knownClean (void);
+static int map_soldCompare( const void *p1, const void *p2 );
+static const MapFindSold *map_knownSold( int ships );
+static int map_knownSoldFirst( const MapFindSold *sold, const void *item );
 /* Toolkit-related. */
 static void map_addOutfitDetailFields(unsigned int wid_results, int x, int y, int w, int h);
 static void map_findCheckUpdate( unsigned int wid_map_find, const char *str );
@@ -107,6 +120,93 @@ static void map_knownClean (void)
    map_known_techs = NULL;
    array_free( map_known_spobs );
    map_known_spobs = NULL;
+   array_free( map_known_outfits );
+   map_known_outfits = NULL;
+   array_free( map_known_ships );
+   map_known_ships = NULL;
+}
+
+/**
+ * @brief qsort compare function for sold items, by item and then by spob.
+ */
+static int map_soldCompare( const void *p1, const void *p2 )
+{
+   const MapFindSold *s1 = p1;
+   const MapFindSold *s2 = p2;
+   if ((uintptr_t)s1->item < (uintptr_t)s2->item)
+      return -1;
+   else if ((uintptr_t)s1->item > (uintptr_t)s2->item)
+      return +1;
+   return s1->spob - s2->spob;
+}
+
+/**
+ * @brief Gets what the known spobs sell, building it the first time it is needed.
+ *
+ * Walking the techs is what makes searches slow, so it is only done once per
+ *  opening of the find window instead of once per search.
+ *
+ *    @param ships Whether to get the ships instead of the outfits.
+ *    @return Array (array.h) of sold items, sorted by item and then by spob.
+ */
+static const MapFindSold *map_knownSold( int ships )
+{
+   MapFindSold **sold = ships ? &map_known_ships : &map_known_outfits;
+   int n;
+
+   if (*sold != NULL)
+      return *sold;
+
+   *sold = array_create( MapFindSold );
+   for (int i=0; i<array_size(map_known_techs); i++) {
+      if (ships) {
+         Ship **slist = tech_getShip( map_known_techs[i] );
+         for (int j=0; j<array_size(slist); j++) {
+            MapFindSold s = { .item = slist[j], .spob = i };
+            array_push_back( sold, s );
+         }
+         array_free( slist );
+      }
+      else {
+         Outfit **olist = tech_getOutfit( map_known_techs[i] );
+         for (int j=0; j<array_size(olist); j++) {
+            MapFindSold s = { .item = olist[j], .spob = i };
+            array_push_back( sold, s );
+         }
+         array_free( olist );
+      }
+   }
+   qsort( *sold, array_size(*sold), sizeof(MapFindSold), map_soldCompare );
+
+   /* Remove duplicates. */
+   n = 0;
+   for (int i=0; i<array_size(*sold); i++) {
+      if ((n > 0) && (map_soldCompare( &(*sold)[n-1], &(*sold)[i] ) == 0))
+         continue;
+      (*sold)[n++] = (*sold)[i];
+   }
+   array_resize( sold, n );
+
+   return *sold;
+}
+
+/**
+ * @brief Gets the position of the first entry of an item in the sold items.
+ *
+ *    @return Position of the first entry, array_size(sold) if not sold.
+ */
+static int map_knownSoldFirst( const MapFindSold *sold, const void *item )
+{
+   int lo = 0;
+   int hi = array_size( sold );
+   while (lo < hi) {
+      int mid = (lo+hi) / 2;
+      if ((uintptr_t)sold[mid].item < (uintptr_t)item)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   return lo;
 }
 
 /**
@@ -254,9 +354,7 @@ static void map_sortFound( map_find_t *found, int n )
  */
 static int map_findDistance( StarSystem *sys, Spob *spob, int *jumps, double *distance )
 {
-   StarSystem **slist;
-   double d;
-   int i;
+   const MapJumpDist *jd;
 
    /* Special case it's the current system. */
    if (sys == cur_system) {
@@ -269,40 +367,20 @@ static int map_findDistance( StarSystem *sys, Spob *spob, int *jumps, double *di
       return 0;
    }
 
-   /* Calculate jump path. */
-   slist = map_getJumpPath( cur_system->name, &player.p->solid.pos, sys->name, 0, 1, NULL, &d );
-   *jumps = array_size( slist );
-   if (slist==NULL)
+   /* Distances to all the systems are computed once per search. */
+   if (map_find_dist == NULL)
+      map_find_dist = map_getJumpDistances( cur_system, &player.p->solid.pos, 0, 1 );
+   jd = &map_find_dist[ sys->id ];
+   if (jd->jumps < 0)
       /* Unknown. */
       return -1;
+   *jumps    = jd->jumps;
+   *distance = jd->distance;
 
-   /* Account final travel to spob for spob targets. */
-   i = *jumps - 1;
-   if (spob != NULL) {
-      const vec2 *ve = &spob->pos;
-      vec2 *vs = NULL;
-      if (i > 0) {
-         StarSystem *ss = slist[ i ];
-         for (int j=0; j < array_size(ss->jumps); j++) {
-            if (ss->jumps[j].target == slist[i-1]) {
-               vs = &ss->jumps[j].pos;
-               break;
-            }
-         }
-      }
-      else
-         vs = &player.p->solid.pos; /* No jumps, grab from current location. */
-
-      assert( vs != NULL );
-      assert( ve != NULL );
-
-      d += vec2_dist( vs, ve );
-   }
+   /* Account final travel from the entry point to spob for spob targets. */
+   if ((spob != NULL) && (jd->entry != NULL))
+      *distance += vec2_dist( jd->entry, &spob->pos );
 
-   /* Cleanup. */
-   array_free(slist);
-
-   *distance = d;
    return 0;
 }
 
@@ -620,7 +698,7 @@ static void map_showOutfitDetail( unsigned int wid, const char* wgtname, int x,
     * a 20 px gap, 280 px for the outfit's name and a final 20 px gap. */
    iw = w - 452;
 
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 128, 128 );
+   window_modifyImage( wid, "imgOutfit", outfit_gfxStore( outfit ), 128, 128 );
    l = outfit_getNameWithClass( outfit, buf, sizeof(buf) );
    l += scnprintf( &buf[l], sizeof(buf)-l, " %s", pilot_outfitSummary( player.p, outfit, 0 ) );
    window_modifyText( wid, "txtDescShort", buf );
@@ -681,6 +759,7 @@ static int map_findSearchOutfits( unsigned int wid_map_find, const char *name )
    const char *oname, *sysname;
    char **list;
    const Outfit *o;
+   const MapFindSold *sold;
 
    assert( "Outfit search is not reentrant!" && map_foundOutfitNames == NULL );
 
@@ -722,21 +801,11 @@ static int map_findSearchOutfits( unsigned int wid_map_find, const char *name )
    /* Construct found table. */
    found = NULL;
    n = 0;
+   sold = map_knownSold( 0 );
    len = array_size(map_known_techs);
-   for (int i=0; i<len; i++) {
-      /* Try to find the outfit in the spob. */
-      int j;
-      Spob *spob;
+   for (int k=map_knownSoldFirst( sold, o ); (k<array_size(sold)) && (sold[k].item==o); k++) {
       StarSystem *sys;
-      Outfit **olist = tech_getOutfit( map_known_techs[i] );
-      for (j=array_size(olist)-1; j>=0; j--)
-         if (olist[j] == o)
-            break;
-      array_free( olist );
-      olist = NULL;
-      if (j < 0)
-         continue;
-      spob = map_known_spobs[i];
+      Spob *spob = map_known_spobs[ sold[k].spob ];
 
       /* Must have an outfitter. */
       if (!spob_hasService(spob,SPOB_SERVICE_OUTFITS))
@@ -822,7 +891,7 @@ static int map_findSearchShips( unsigned int wid_map_find, const char *name )
    const char *sname, *sysname;
    char **list;
    const Ship *s;
-   Ship **slist;
+   const MapFindSold *sold;
 
    /* Match spob first. */
    s     = NULL;
@@ -858,20 +927,10 @@ static int map_findSearchShips( unsigned int wid_map_find, const char *name )
    /* Construct found table. */
    found = NULL;
    n = 0;
+   sold = map_knownSold( 1 );
    len = array_size(map_known_techs);
-   for (int i=0; i<len; i++) {
-      int j;
-
-      /* Try to find the ship in the spob. */
-      slist = tech_getShip( map_known_techs[i] );
-      for (j=array_size(slist)-1; j>=0; j--)
-         if (slist[j] == s)
-            break;
-      array_free(slist);
-      slist = NULL;
-      if (j < 0)
-         continue;
-      spob = map_known_spobs[i];
+   for (int k=map_knownSoldFirst( sold, s ); (k<array_size(sold)) && (sold[k].item==s); k++) {
+      spob = map_known_spobs[ sold[k].spob ];
 
       /* Must have an shipyard. */
       if (!spob_hasService(spob,SPOB_SERVICE_SHIPYARD))
@@ -947,6 +1006,8 @@ static void map_findSearch( unsigned int wid_map_find, const char* str )
 
    /* Safe at last. */
    window_enableButton( wid_map_find, "btnSearch" );
+   array_free( map_find_dist );
+   map_find_dist = NULL;
 
    if (ret > 0)
       window_close( wid_map_find, str );
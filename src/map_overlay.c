@@ -91,14 +91,33 @@ static MapOverlayPos autonav_pos_mo;
 static MapOverlayPos **ovr_refresh_mo = NULL;
 static const vec2 **ovr_refresh_pos = NULL;
 
+/**
+ * @brief Solved layout of an overlay item, to reuse when it doesn't change.
+ */
+typedef struct OverlayLayout_s {
+   const MapOverlayPos *mo; /**< Item the layout is of. */
+   vec2 pos;         /**< Position of the item. */
+   float radius;     /**< Radius of the item before fitting. */
+   float text_width; /**< Width of the caption text. */
+   MapOverlayPos out;/**< Solved layout. */
+} OverlayLayout_t;
+static OverlayLayout_t *ovr_layout = NULL; /**< Solved layout of the items (array.h). */
+static const StarSystem *ovr_layout_sys = NULL; /**< System the layout was solved in. */
+static double ovr_layout_res = 0.; /**< Resolution the layout was solved at. */
+
 /*
  * Prototypes
  */
 static void force_collision( float *ox, float *oy,
       float x, float y, float w, float h,
       float mx, float my, float mw, float mh );
+static void ovr_fitRadii( int items, const vec2** pos, MapOverlayPos** mo );
+static int ovr_layoutReuse( int items, const vec2** pos, MapOverlayPos** mo,
+      const float *radius, uint8_t *dirty );
+static void ovr_layoutStore( int items, const vec2** pos, MapOverlayPos** mo,
+      const float *radius );
 static void ovr_optimizeLayout( int items, const vec2** pos,
-      MapOverlayPos** mo );
+      MapOverlayPos** mo, const uint8_t *dirty );
 static void ovr_refresh_uzawa_overlap( float *forces_x, float *forces_y,
       float x, float y, float w, float h, const vec2** pos,
       MapOverlayPos** mo, int items, int self,
@@ -216,6 +235,8 @@ void ovr_refresh (void)
    int n, items, jumpitems, spobitems;
    const vec2 **pos;
    MapOverlayPos **mo;
+   float *radius;
+   uint8_t *dirty;
    char buf[STRMAX_SHORT];
 
    /* Must be open. */
@@ -320,8 +341,19 @@ void ovr_refresh (void)
       mo[i]->radius = MAX( 2.+mo[i]->radius / ovr_res, rm );
    }
 
-   /* Compute text overlap and try to minimize it. */
-   ovr_optimizeLayout( items, pos, mo );
+   /* Items that didn't move keep their layout, the rest are solved around them. */
+   radius = malloc( items * sizeof(float) );
+   dirty  = malloc( items );
+   for (int i=0; i<items; i++)
+      radius[i] = mo[i]->radius;
+   ovr_fitRadii( items, pos, mo );
+   if (ovr_layoutReuse( items, pos, mo, radius, dirty ) > 0) {
+      /* Compute text overlap and try to minimize it. */
+      ovr_optimizeLayout( items, pos, mo, dirty );
+   }
+   ovr_layoutStore( items, pos, mo, radius );
+   free( radius );
+   free( dirty );
 
    /* Sove the moos. */
    ovr_refresh_pos = pos;
@@ -331,20 +363,12 @@ void ovr_refresh (void)
 }
 
 /**
- * @brief Makes a best effort to fit the given spobs' overlay indicators and labels fit without collisions.
+ * @brief Shrinks the radii of the overlay indicators that would overlap.
  */
-static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo )
+static void ovr_fitRadii( int items, const vec2** pos, MapOverlayPos** mo )
 {
-   float cx, cy, r, sx, sy;
-   float x, y, w, h, mx, my, mw, mh;
-   float fx, fy, best, bx, by;
-   float *forces_xa, *forces_ya, *off_buffx, *off_buffy, *off_0x, *off_0y, old_bx, old_by, *off_dx, *off_dy;
-
-   /* Parameters for the map overlay optimization. */
+   float r;
    const int max_iters = 15;    /**< Maximum amount of iterations to do. */
-   const float kx      = 0.015; /**< x softness factor. */
-   const float ky      = 0.045; /**< y softness factor (moving along y is more likely to be the right solution). */
-   const float eps_con = 1.3;   /**< Convergence criterion. */
 
    /* Nothing to do. */
    if (items <= 0)
@@ -382,13 +406,123 @@ static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo
    /* Limit shrinkage. */
    for (int i=0; i<items; i++)
       mo[i]->radius = MAX( mo[i]->radius, 4. );
+}
 
-   /* Initialization offset list. */
+/**
+ * @brief Reuses the previous layout of the items that didn't change.
+ *
+ * Items are unchanged when they are in the same system at the same
+ *  resolution, with the same position, size and caption.
+ *
+ *    @param items Number of items.
+ *    @param pos Positions of the items.
+ *    @param mo Layout of the items, with their radii fitted.
+ *    @param radius Radii of the items before fitting.
+ *    @param[out] dirty Set to whether or not each item has to be solved.
+ *    @return Number of items to solve.
+ */
+static int ovr_layoutReuse( int items, const vec2** pos, MapOverlayPos** mo,
+      const float *radius, uint8_t *dirty )
+{
+   int ndirty = 0;
+   int valid = (ovr_layout_sys == cur_system) && (ovr_layout_res == ovr_res);
+
+   for (int i=0; i<items; i++) {
+      const OverlayLayout_t *l = NULL;
+      dirty[i] = 1;
+      if (valid) {
+         /* Items usually come in the same order. */
+         if ((i < array_size(ovr_layout)) && (ovr_layout[i].mo == mo[i]))
+            l = &ovr_layout[i];
+         else {
+            for (int j=0; j<array_size(ovr_layout); j++) {
+               if (ovr_layout[j].mo == mo[i]) {
+                  l = &ovr_layout[j];
+                  break;
+               }
+            }
+         }
+      }
+      if ((l != NULL) && (l->pos.x == pos[i]->x) && (l->pos.y == pos[i]->y)
+            && (l->radius == radius[i]) && (l->text_width == mo[i]->text_width)
+            && (l->out.radius == mo[i]->radius)) {
+         mo[i]->text_offx = l->out.text_offx;
+         mo[i]->text_offy = l->out.text_offy;
+         dirty[i] = 0;
+      }
+      else
+         ndirty++;
+   }
+   return ndirty;
+}
+
+/**
+ * @brief Stores the solved layout of the items to reuse it.
+ */
+static void ovr_layoutStore( int items, const vec2** pos, MapOverlayPos** mo,
+      const float *radius )
+{
+   if (ovr_layout == NULL)
+      ovr_layout = array_create_size( OverlayLayout_t, items );
+   array_resize( &ovr_layout, items );
+   for (int i=0; i<items; i++) {
+      OverlayLayout_t *l = &ovr_layout[i];
+      l->mo         = mo[i];
+      l->pos        = *pos[i];
+      l->radius     = radius[i];
+      l->text_width = mo[i]->text_width;
+      l->out        = *mo[i];
+   }
+   ovr_layout_sys = cur_system;
+   ovr_layout_res = ovr_res;
+}
+
+/**
+ * @brief Makes a best effort to fit the given spobs' overlay indicators and labels fit without collisions.
+ *
+ * Only the dirty items get moved, the others keep their offsets and act as
+ *  obstacles, so that a few changes don't have to solve everything again.
+ *
+ *    @param items Number of items.
+ *    @param pos Positions of the items.
+ *    @param mo Layout of the items, with their radii already fitted.
+ *    @param dirty Whether or not each item has to be solved.
+ */
+static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo, const uint8_t *dirty )
+{
+   float cx, cy, sx, sy;
+   float x, y, w, h, mx, my, mw, mh;
+   float fx, fy, best, bx, by;
+   float *forces_xa, *forces_ya, *off_buffx, *off_buffy, *off_0x, *off_0y, old_bx, old_by, *off_dx, *off_dy;
+   int *active, nactive;
+
+   /* Parameters for the map overlay optimization. */
+   const int max_iters = 15;    /**< Maximum amount of iterations to do. */
+   const float kx      = 0.015; /**< x softness factor. */
+   const float ky      = 0.045; /**< y softness factor (moving along y is more likely to be the right solution). */
+   const float eps_con = 1.3;   /**< Convergence criterion. */
+
+   /* Nothing to do. */
+   if (items <= 0)
+      return;
+
+   /* Initialization offset list, the items that are kept start where they were. */
    off_0x = calloc( items, sizeof(float) );
    off_0y = calloc( items, sizeof(float) );
-
-   /* Initialize all items. */
+   active = malloc( items * sizeof(int) );
+   nactive = 0;
    for (int i=0; i<items; i++) {
+      if (dirty[i])
+         active[nactive++] = i;
+      else {
+         off_0x[i] = mo[i]->text_offx;
+         off_0y[i] = mo[i]->text_offy;
+      }
+   }
+
+   /* Initialize all items to solve. */
+   for (int a=0; a<nactive; a++) {
+      int i = active[a];
       /* Test to see what side is best to put the text on.
        * We actually compute the text overlap also so hopefully it will alternate
        * sides when stuff is clustered together. */
@@ -445,8 +579,8 @@ static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo
     * received by a given object. Then these forces are summed to obtain the total force on the object.
     * Odd lines are forces from objects and Even lines from other texts. */
 
-   forces_xa = calloc( 2*items*items, sizeof(float) );
-   forces_ya = calloc( 2*items*items, sizeof(float) );
+   forces_xa = calloc( 2*items*nactive, sizeof(float) );
+   forces_ya = calloc( 2*items*nactive, sizeof(float) );
 
    /* And buffer lists. */
    off_buffx = calloc( items, sizeof(float) );
@@ -457,12 +591,13 @@ static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo
    /* Main Uzawa Loop. */
    for (int iter=0; iter<max_iters; iter++) {
       double val = 0.; /* This stores the stagnation indicator. */
-      for (int i=0; i<items; i++) {
+      for (int a=0; a<nactive; a++) {
+         int i = active[a];
          cx = pos[i]->x / ovr_res;
          cy = pos[i]->y / ovr_res;
          /* Compute the forces. */
          ovr_refresh_uzawa_overlap(
-               forces_xa, forces_ya,
+               &forces_xa[2*items*a], &forces_ya[2*items*a],
                cx + off_dx[i] + off_0x[i] - ovr_text_pixbuf,
                cy + off_dy[i] + off_0y[i] - ovr_text_pixbuf,
                mo[i]->text_width + 2*ovr_text_pixbuf,
@@ -472,8 +607,8 @@ static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo
          /* Do the sum. */
          sx = sy = 0.;
          for (int j=0; j<2*items; j++) {
-            sx += forces_xa[2*items*i+j];
-            sy += forces_ya[2*items*i+j];
+            sx += forces_xa[2*items*a+j];
+            sy += forces_ya[2*items*a+j];
          }
 
          /* Store old version of buffers. */
@@ -488,7 +623,8 @@ static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo
       }
 
       /* Offsets are actually updated once the first loop is over. */
-      for (int i=0; i<items; i++) {
+      for (int a=0; a<nactive; a++) {
+         int i = active[a];
          off_dx[i] = off_buffx[i];
          off_dy[i] = off_buffy[i];
       }
@@ -499,7 +635,8 @@ static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo
    }
 
    /* Permanently add the initialization offset to total offset. */
-   for (int i=0; i<items; i++) {
+   for (int a=0; a<nactive; a++) {
+      int i = active[a];
       mo[i]->text_offx = off_dx[i] + off_0x[i];
       mo[i]->text_offy = off_dy[i] + off_0y[i];
    }
@@ -513,6 +650,7 @@ static void ovr_optimizeLayout( int items, const vec2** pos, MapOverlayPos** mo
    free( off_0y );
    free( off_dx );
    free( off_dy );
+   free( active );
 }
 
 /**
@@ -557,6 +695,8 @@ static void force_collision( float *ox, float *oy,
 
 /**
  * @brief Compute how an element overlaps with text and force to move away.
+ *
+ * The forces are stored in the row of the element, which has 2*items entries.
  */
 static void ovr_refresh_uzawa_overlap( float *forces_x, float *forces_y,
       float x, float y, float w, float h, const vec2** pos,
@@ -572,7 +712,7 @@ static void ovr_refresh_uzawa_overlap( float *forces_x, float *forces_y,
       mh = mw;
       mx = pos[i]->x/ovr_res - mw/2.;
       my = pos[i]->y/ovr_res - mh/2.;
-      force_collision( &forces_x[2*items*self+2*i+1], &forces_y[2*items*self+2*i+1], x, y, w, h, mx, my, mw, mh );
+      force_collision( &forces_x[2*i+1], &forces_y[2*i+1], x, y, w, h, mx, my, mw, mh );
 
       if (i == self)
          continue;
@@ -582,7 +722,7 @@ static void ovr_refresh_uzawa_overlap( float *forces_x, float *forces_y,
       mh = gl_smallFont.h + pb2;
       mx = pos[i]->x/ovr_res + offdx[i] + offx[i] - ovr_text_pixbuf;
       my = pos[i]->y/ovr_res + offdy[i] + offy[i] - ovr_text_pixbuf;
-      force_collision( &forces_x[2*items*self+2*i], &forces_y[2*items*self+2*i], x, y, w, h, mx, my, mw, mh );
+      force_collision( &forces_x[2*i], &forces_y[2*i], x, y, w, h, mx, my, mw, mh );
    }
 }
 
@@ -627,6 +767,9 @@ int ovr_init (void)
 void ovr_exit (void)
 {
    il_destroy( &ovr_qtquery );
+   array_free( ovr_layout );
+   ovr_layout = NULL;
+   ovr_layout_sys = NULL;
 }
 
 /**
@@ -892,6 +1035,7 @@ void ovr_render( double dt )
       col.r = 1.;
       col.g = 0.;
       col.b = 0.;
+      gl_batchBegin();
       for (int i=0; i<array_size(pstk); i++) {
          double r;
          if (pilot_isDisabled(pstk[i]))
@@ -903,11 +1047,10 @@ void ovr_render( double dt )
             continue;
          map_overlayToScreenPos( &x, &y, pstk[i]->solid.pos.x, pstk[i]->solid.pos.y );
          r = detect * pstk[i]->stats.ew_detect; /* Already divided by res */
-         if (r > 0.) {
-            glUseProgram( shaders.stealthaura.program );
-            gl_renderShader( x, y, r, r, 0., &shaders.stealthaura, &col, 1 );
-         }
+         if (r > 0.)
+            gl_renderMarker( OPENGL_MARKER_STEALTH, x, y, r, r, 0., &col );
       }
+      gl_batchEnd();
 
       glBlendEquation( GL_FUNC_ADD );
       glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
@@ -929,7 +1072,7 @@ void ovr_render( double dt )
       gl_uniformMat4(shaders.stealthoverlay.tex_mat, &I );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clear state. */
       glDisableVertexAttribArray( shaders.stealthoverlay.vertex );
@@ -29,6 +29,7 @@
 #include "nmath.h"
 #include "nstring.h"
 #include "opengl.h"
+#include "pilot_outfit.h"
 #include "player.h"
 #include "space.h"
 #include "toolkit.h"
@@ -46,6 +47,11 @@ static int nameWidth = 0; /**< text width of spob name */
 static int nshow = 0; /**< number of spobs shown. */
 static char infobuf[STRMAX];
 static unsigned int focusedStar = 0;
+static GLuint mapsys_fbo = GL_INVALID_VALUE; /**< Framebuffer the static content is cached in. */
+static GLuint mapsys_tex = GL_INVALID_VALUE; /**< Texture of the cached static content, with premultiplied alpha. */
+static int mapsys_pw = 0; /**< Width of the cache in pixels. */
+static int mapsys_ph = 0; /**< Height of the cache in pixels. */
+static int mapsys_valid = 0; /**< Whether or not the cache is up to date. */
 glTexture **starImages; /**< array (array.h) of star textures */
 glTexture *bgImage; /**< if not NULL, an overall background image (e.g., nebula) */
 
@@ -72,6 +78,9 @@ void map_system_updateSelected( unsigned int wid );
 
 /* Render. */
 static void map_system_render( double bx, double by, double w, double h, void *data );
+static void map_system_renderStatic( double bx, double by, double w, double h );
+static void map_system_cacheRender( double w, double h );
+static void map_system_cacheFree (void);
 /* Mouse. */
 static int map_system_mouse( unsigned int wid, const SDL_Event* event, double mx, double my,
       double w, double h, double rx, double ry, void *data );
@@ -84,6 +93,7 @@ static void map_system_genShipsList( unsigned int wid, float goodsSpace, float o
 static void map_system_genTradeList( unsigned int wid, float goodsSpace, float outfitSpace, float shipSpace );
 
 static void map_system_array_update( unsigned int wid, const char* str );
+static char *map_system_outfitAltText( unsigned int wid, const char *wgt, int pos );
 
 void map_system_buyCommodPrice( unsigned int wid, const char *str );
 
@@ -122,6 +132,81 @@ void map_system_exit( void )
    cur_spob_sel_outfits = NULL;
    array_free( cur_spob_sel_ships );
    cur_spob_sel_ships = NULL;
+   map_system_cacheFree();
+}
+
+/**
+ * @brief Marks the cached static content of the system map as outdated.
+ */
+void map_system_invalidate (void)
+{
+   mapsys_valid = 0;
+}
+
+/**
+ * @brief Frees the cached static content of the system map.
+ */
+static void map_system_cacheFree (void)
+{
+   if (mapsys_fbo != GL_INVALID_VALUE) {
+      glDeleteFramebuffers( 1, &mapsys_fbo );
+      glDeleteTextures( 1, &mapsys_tex );
+   }
+   mapsys_fbo   = GL_INVALID_VALUE;
+   mapsys_tex   = GL_INVALID_VALUE;
+   mapsys_pw    = 0;
+   mapsys_ph    = 0;
+   mapsys_valid = 0;
+}
+
+/**
+ * @brief Renders the static content of the system map into its cache.
+ *
+ *    @param w Width of the widget.
+ *    @param h Height of the widget.
+ */
+static void map_system_cacheRender( double w, double h )
+{
+   GLint fbo, viewport[4];
+   GLboolean scissor;
+   mat4 view = gl_view_matrix;
+   int pw = ceil( w * (double)gl_screen.rw / (double)gl_screen.nw );
+   int ph = ceil( h * (double)gl_screen.rh / (double)gl_screen.nh );
+
+   /* Framebuffer has to be recreated. */
+   if ((pw != mapsys_pw) || (ph != mapsys_ph)) {
+      map_system_cacheFree();
+      gl_fboCreate( &mapsys_fbo, &mapsys_tex, pw, ph );
+      mapsys_pw = pw;
+      mapsys_ph = ph;
+   }
+
+   /* The map may be getting rendered into a framebuffer already. */
+   glGetIntegerv( GL_FRAMEBUFFER_BINDING, &fbo );
+   glGetIntegerv( GL_VIEWPORT, viewport );
+   scissor = glIsEnabled( GL_SCISSOR_TEST );
+
+   glDisable( GL_SCISSOR_TEST );
+   glBindFramebuffer( GL_FRAMEBUFFER, mapsys_fbo );
+   glViewport( 0, 0, mapsys_pw, mapsys_ph );
+   glClearColor( 0., 0., 0., 0. );
+   glClear( GL_COLOR_BUFFER_BIT );
+   gl_view_matrix = mat4_ortho( 0., w, 0., h, -1., 1. );
+   /* Premultiply so the cache can be drawn over the background. */
+   glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+
+   map_system_renderStatic( 0., 0., w, h );
+
+   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   gl_view_matrix = view;
+   glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+   glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+   if (scissor)
+      glEnable( GL_SCISSOR_TEST );
+   glClearColor( 0., 0., 0., 1. );
+   gl_checkErr();
+
+   mapsys_valid = 1;
 }
 
 /**
@@ -261,7 +346,9 @@ void map_system_show( int wid, int x, int y, int w, int h)
 /**
  * @brief Renders the custom solar system map widget.
  *
- * TODO this shouldn't compute all the strings every render frame.
+ * Everything but the star and the selection marker, which are animated, is
+ *  drawn from a cache that only gets rendered again when the selection or the
+ *  content changes.
  *
  *    @param bx Base X position to render at.
  *    @param by Base Y position to render at.
@@ -271,44 +358,21 @@ void map_system_show( int wid, int x, int y, int w, int h)
 static void map_system_render( double bx, double by, double w, double h, void *data )
 {
    (void) data;
-   int i, vis_index;
+   int i;
    double iw, ih;
-   StarSystem *sys = cur_sys_sel;
-   Spob *p;
    static int phase=0;
    glColour ccol;
-   char buf[STRMAX];
-   int cnt;
-   double ast_nb, ast_area;
-   double f;
-   int hasPresence = 0;
-   double unknownPresence = 0;
-   char t;
-   const glTexture *logo;
-   int offset;
-   int txtHeight;
+   int offset = h - pitch*nshow;
+
+   /* Static content. */
+   if (!mapsys_valid
+         || (mapsys_pw != (int)ceil( w * (double)gl_screen.rw / (double)gl_screen.nw ))
+         || (mapsys_ph != (int)ceil( h * (double)gl_screen.rh / (double)gl_screen.nh )))
+      map_system_cacheRender( w, h );
+   glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   gl_renderTextureRaw( mapsys_tex, 0, bx, by, w, h, 0., 0., 1., 1., &cWhite, 0. );
+   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
-   vis_index=0;
-   offset = h - pitch*nshow;
-   for (i=0; i<array_size(sys->spobs); i++) {
-      p = sys->spobs[i];
-      if (!spob_isKnown( p ))
-         continue;
-      vis_index++;
-      if (p->gfx_space == NULL)
-         WARN( _("No gfx for %s…"),p->name );
-      else {
-         ih = pitch;
-         iw = ih;
-         if (p->gfx_space->w > p->gfx_space->h)
-            ih = ih * p->gfx_space->h / p->gfx_space->w;
-         else if ( p->gfx_space->w < p->gfx_space->h )
-            iw = iw * p->gfx_space->w / p->gfx_space->h;
-         gl_renderScale( p->gfx_space, bx+(pitch-iw)/2+2, by+(nshow-vis_index-1)*pitch + (pitch-ih)/2 + offset, iw, ih, &cWhite );
-      }
-      gl_printRaw( &gl_smallFont, bx + 5 + pitch, by + (nshow-vis_index-0.5)*pitch + offset,
-            (cur_spob_sel == vis_index ? &cFontGreen : &cFontWhite), -1., spob_name(p) );
-   }
    /* draw the star */
    ih = pitch;
    iw = ih;
@@ -341,7 +405,69 @@ static void map_system_render( double bx, double by, double w, double h, void *d
          gl_renderScale( starImages[i], bx+2, by+(nshow-1)*pitch + (pitch-ih)/2 + offset, iw, ih, &ccol );
       }
    }
-   else if (sys->nebu_density > 0.) {
+
+   /* draw marker around currently selected spob */
+   ccol.r=0; ccol.g=0.6+0.4*sin( phase/150.*2*M_PI ); ccol.b=0; ccol.a=1;
+   ih=15;
+   iw=3;
+   gl_renderRect( bx+1, by+(nshow-cur_spob_sel-1)*pitch + offset, iw, ih, &ccol );
+   gl_renderRect( bx+1, by+(nshow-cur_spob_sel)*pitch-ih + offset, iw, ih, &ccol );
+   gl_renderRect( bx+pitch+3-iw, by+(nshow-cur_spob_sel-1)*pitch + offset, iw, ih, &ccol );
+   gl_renderRect( bx+pitch+3-iw, by+(nshow-cur_spob_sel)*pitch-ih + offset, iw, ih, &ccol );
+   gl_renderRect( bx+1, by+(nshow-cur_spob_sel-1)*pitch + offset, ih, iw, &ccol );
+   gl_renderRect( bx+1, by+(nshow-cur_spob_sel)*pitch-iw + offset, ih, iw, &ccol );
+   gl_renderRect( bx+pitch+3-ih, by+(nshow-cur_spob_sel-1)*pitch + offset, ih, iw, &ccol );
+   gl_renderRect( bx+pitch+3-ih, by+(nshow-cur_spob_sel)*pitch-iw + offset, ih, iw, &ccol );
+}
+
+/**
+ * @brief Renders the static content of the solar system map widget.
+ *
+ *    @param bx Base X position to render at.
+ *    @param by Base Y position to render at.
+ *    @param w Width of the widget.
+ *    @param h Height of the widget.
+ */
+static void map_system_renderStatic( double bx, double by, double w, double h )
+{
+   int i, vis_index;
+   double iw, ih;
+   StarSystem *sys = cur_sys_sel;
+   Spob *p;
+   char buf[STRMAX];
+   int cnt;
+   double ast_nb, ast_area;
+   double f;
+   int hasPresence = 0;
+   double unknownPresence = 0;
+   char t;
+   const glTexture *logo;
+   int offset;
+   int txtHeight;
+
+   vis_index=0;
+   offset = h - pitch*nshow;
+   for (i=0; i<array_size(sys->spobs); i++) {
+      p = sys->spobs[i];
+      if (!spob_isKnown( p ))
+         continue;
+      vis_index++;
+      if (p->gfx_space == NULL)
+         WARN( _("No gfx for %s…"),p->name );
+      else {
+         ih = pitch;
+         iw = ih;
+         if (p->gfx_space->w > p->gfx_space->h)
+            ih = ih * p->gfx_space->h / p->gfx_space->w;
+         else if ( p->gfx_space->w < p->gfx_space->h )
+            iw = iw * p->gfx_space->w / p->gfx_space->h;
+         gl_renderScale( p->gfx_space, bx+(pitch-iw)/2+2, by+(nshow-vis_index-1)*pitch + (pitch-ih)/2 + offset, iw, ih, &cWhite );
+      }
+      gl_printRaw( &gl_smallFont, bx + 5 + pitch, by + (nshow-vis_index-0.5)*pitch + offset,
+            (cur_spob_sel == vis_index ? &cFontGreen : &cFontWhite), -1., spob_name(p) );
+   }
+   /* the star is animated, so only the lack of it is static */
+   if ((array_size( starImages ) <= 0) && (sys->nebu_density > 0.)) {
       /* no nebula or star images - probably due to nebula */
       txtHeight = gl_printHeightRaw( &gl_smallFont,pitch,_("Obscured by the nebula") );
       gl_printTextRaw( &gl_smallFont, pitch, txtHeight, (bx+2),
@@ -360,18 +486,6 @@ static void map_system_render( double bx, double by, double w, double h, void *d
       imgh *= s;
       gl_renderScale( bgImage, bx+w-iw+(iw-imgw)*0.5, by+h-ih+(ih-imgh)*0.5, imgw, imgh, &cWhite );
    }
-   /* draw marker around currently selected spob */
-   ccol.r=0; ccol.g=0.6+0.4*sin( phase/150.*2*M_PI ); ccol.b=0; ccol.a=1;
-   ih=15;
-   iw=3;
-   gl_renderRect( bx+1, by+(nshow-cur_spob_sel-1)*pitch + offset, iw, ih, &ccol );
-   gl_renderRect( bx+1, by+(nshow-cur_spob_sel)*pitch-ih + offset, iw, ih, &ccol );
-   gl_renderRect( bx+pitch+3-iw, by+(nshow-cur_spob_sel-1)*pitch + offset, iw, ih, &ccol );
-   gl_renderRect( bx+pitch+3-iw, by+(nshow-cur_spob_sel)*pitch-ih + offset, iw, ih, &ccol );
-   gl_renderRect( bx+1, by+(nshow-cur_spob_sel-1)*pitch + offset, ih, iw, &ccol );
-   gl_renderRect( bx+1, by+(nshow-cur_spob_sel)*pitch-iw + offset, ih, iw, &ccol );
-   gl_renderRect( bx+pitch+3-ih, by+(nshow-cur_spob_sel-1)*pitch + offset, ih, iw, &ccol );
-   gl_renderRect( bx+pitch+3-ih, by+(nshow-cur_spob_sel)*pitch-iw + offset, ih, iw, &ccol );
    cnt=0;
    buf[0]='\0';
    if (cur_spob_sel == 0) {
@@ -610,6 +724,7 @@ static void map_system_array_update( unsigned int wid, const char* str )
    char buf_price[ECON_CRED_STRLEN], buf_license[STRMAX_SHORT], buf_mass[ECON_MASS_STRLEN];
    size_t l = 0;
 
+   map_system_invalidate();
    infobuf[0] = '\0';
    i = toolkit_getImageArrayPos( wid, str );
    if (i < 0)
@@ -759,6 +874,7 @@ void map_system_updateSelected( unsigned int wid )
    Outfit **outfits;
    Ship **ships;
    float g,o,s;
+   map_system_invalidate();
    nameWidth = 0; /* get the widest spob/star name */
    nshow=1;/* start at 1 for the sun*/
    infobuf[0] = '\0'; /* clear buffer. */
@@ -891,7 +1007,7 @@ static void map_system_genOutfitsList( unsigned int wid, float goodsSpace, float
 
    if (noutfits <= 0)
       return;
-   coutfits = outfits_imageArrayCells( (const Outfit**)cur_spob_sel_outfits, &noutfits, player.p, 1 );
+   coutfits = outfits_imageArrayCells( (const Outfit**)cur_spob_sel_outfits, &noutfits, 1 );
 
    xw = ( w - nameWidth - pitch - 60 ) / 2;
    xpos = 35 + pitch + nameWidth + xw;
@@ -905,9 +1021,22 @@ static void map_system_genOutfitsList( unsigned int wid, float goodsSpace, float
    window_addImageArray( wid, xpos, ypos,
          xw, yh, MAPSYS_OUTFITS, iconsize, iconsize,
          coutfits, noutfits, map_system_array_update, NULL, NULL );
+   toolkit_setImageArrayAltText( wid, MAPSYS_OUTFITS, map_system_outfitAltText );
    toolkit_unsetSelection( wid, MAPSYS_OUTFITS );
 }
 
+/**
+ * @brief Generates the alt text of an outfit when it is first shown.
+ */
+static char *map_system_outfitAltText( unsigned int wid, const char *wgt, int pos )
+{
+   (void) wid;
+   (void) wgt;
+   if ((pos < 0) || (pos >= array_size(cur_spob_sel_outfits)))
+      return NULL;
+   return strdup( pilot_outfitSummary( player.p, cur_spob_sel_outfits[pos], 1 ) );
+}
+
 static void map_system_genShipsList( unsigned int wid, float goodsSpace, float outfitSpace, float shipSpace )
 {
    ImageArrayCell *cships;
@@ -946,6 +1075,7 @@ static void map_system_genShipsList( unsigned int wid, float goodsSpace, float o
    if (nships <= 0)
       return;
 
+   ships_gfxLoad( cur_spob_sel_ships );
    cships = calloc( nships, sizeof(ImageArrayCell) );
    for ( i=0; i<nships; i++ ) {
       cships[i].image = gl_dupTexture( cur_spob_sel_ships[i]->gfx_store );
@@ -1039,7 +1169,7 @@ void map_system_buyCommodPrice( unsigned int wid, const char *str )
       njumps = 0;
    }
    else {
-      syslist=map_getJumpPath( cur_system->name, NULL, cur_sys_sel->name, 1, 0, NULL, NULL);
+      syslist=map_getJumpPathSys( cur_system, NULL, cur_sys_sel, 1, 0, NULL, NULL);
       if ( syslist == NULL ) {
          /* no route */
          dialogue_msg( _("Unavailable"), _("Commodity prices for %s are not available here at the moment."), _(cur_spobObj_sel->name) );
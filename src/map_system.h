@@ -7,3 +7,4 @@ void map_system_open( int sys_selected );
 int map_system_init( void );
 int map_system_load( void );
 void map_system_exit( void );
+void map_system_invalidate (void);
@@ -5,6 +5,9 @@
  * @file mat4.c
  *
  * @brief Handles OpenGL matrix stuff.
+ *
+ * The operations work on whole columns of floats with fixed size loops, so
+ *  that the compiler can use SIMD for them.
  */
 /** @cond */
 #include "naev.h"
@@ -35,12 +38,14 @@ void mat4_print( const mat4 *m )
 void mat4_mul( mat4 *out, const mat4 *m1, const mat4 *m2 )
 {
    for (int i=0; i<4; i++) {
-      for (int j=0; j<4; j++) {
-         GLfloat v = 0.;
-         for (int k=0; k<4; k++)
-            v += m1->m[i][k] * m2->m[k][j];
-         out->m[i][j] = v;
+      GLfloat v[4] = { 0., 0., 0., 0. };
+      for (int k=0; k<4; k++) {
+         GLfloat l = m1->m[i][k];
+         for (int j=0; j<4; j++)
+            v[j] += l * m2->m[k][j];
       }
+      for (int j=0; j<4; j++)
+         out->m[i][j] = v[j];
    }
 }
 
@@ -120,10 +125,11 @@ void mat4_translate_xy( mat4 *m, double x, double y )
 }
 void mat4_translate_scale_xy( mat4 *m, double x, double y, double w, double h )
 {
+   GLfloat fx = x, fy = y, fw = w, fh = h;
    for (int i=0; i<4; i++) {
-      m->m[3][i] += m->m[0][i] * x + m->m[1][i] * y;
-      m->m[0][i] *= w;
-      m->m[1][i] *= h;
+      m->m[3][i] += m->m[0][i] * fx + m->m[1][i] * fy;
+      m->m[0][i] *= fw;
+      m->m[1][i] *= fh;
    }
 }
 
@@ -135,19 +141,7 @@ void mat4_translate_scale_xy( mat4 *m, double x, double y, double w, double h )
  */
 void mat4_rotate2d( mat4 *m, double angle )
 {
-   double c, s, x, y;
-
-   c = cos(angle);
-   s = sin(angle);
-   x = m->m[0][0];
-   y = m->m[1][0];
-   m->m[0][0] =  c*x + s*y;
-   m->m[1][0] = -s*x + c*y;
-
-   x = m->m[0][1];
-   y = m->m[1][1];
-   m->m[0][1] =  c*x + s*y;
-   m->m[1][1] = -s*x + c*y;
+   mat4_rotate2dv( m, cos(angle), sin(angle) );
 }
 
 /**
@@ -159,17 +153,112 @@ void mat4_rotate2d( mat4 *m, double angle )
  */
 void mat4_rotate2dv( mat4 *m, double c, double s )
 {
-   double x, y;
+   GLfloat fc = c, fs = s;
+   for (int i=0; i<4; i++) {
+      GLfloat x = m->m[0][i];
+      GLfloat y = m->m[1][i];
+      m->m[0][i] =  fc*x + fs*y;
+      m->m[1][i] = -fs*x + fc*y;
+   }
+}
+
+/**
+ * @brief Applies a 2D affine transformation to a matrix.
+ *
+ * Same as translating, rotating and scaling the matrix with the operations
+ *  the transformation was built from.
+ *
+ *    @param[in, out] m Matrix to apply the transformation to.
+ *    @param a Transformation to apply.
+ */
+void mat4_apply_affine2d( mat4 *m, const affine2d *a )
+{
+   for (int i=0; i<4; i++) {
+      GLfloat x = m->m[0][i];
+      GLfloat y = m->m[1][i];
+      m->m[3][i] += x * a->m[4] + y * a->m[5];
+      m->m[0][i]  = x * a->m[0] + y * a->m[1];
+      m->m[1][i]  = x * a->m[2] + y * a->m[3];
+   }
+}
+
+/**
+ * @brief Builds the 2D affine transformation of a quad.
+ *
+ * Maps the unit square to a rectangle rotated around its center, like the
+ *  textures are drawn.
+ *
+ *    @param[out] a Transformation to build.
+ *    @param x X position of the bottom left corner of the rectangle.
+ *    @param y Y position of the bottom left corner of the rectangle.
+ *    @param w Width of the rectangle.
+ *    @param h Height of the rectangle.
+ *    @param angle Rotation around the center of the rectangle (radians ccw).
+ */
+void affine2d_quad( affine2d *a, double x, double y, double w, double h, double angle )
+{
+   double c, s;
+   if (angle == 0.) {
+      c = 1.;
+      s = 0.;
+   }
+   else {
+      c = cos(angle);
+      s = sin(angle);
+   }
+   a->m[0] = c*w;
+   a->m[1] = s*w;
+   a->m[2] = -s*h;
+   a->m[3] = c*h;
+   /* Translation that keeps the center in place. */
+   a->m[4] = x + 0.5*w - 0.5*(a->m[0] + a->m[2]);
+   a->m[5] = y + 0.5*h - 0.5*(a->m[1] + a->m[3]);
+}
 
-   x = m->m[0][0];
-   y = m->m[1][0];
-   m->m[0][0] =  c*x + s*y;
-   m->m[1][0] = -s*x + c*y;
+/**
+ * @brief Builds the 2D affine transformations of many quads.
+ *
+ * Packed for uploading as per instance data, 6 floats per quad.
+ *
+ *    @param[out] out Transformations to build.
+ *    @param xywh Bottom left corner, width and height of each quad, 4 per quad.
+ *    @param angle Rotation of each quad, or NULL if none are rotated.
+ *    @param n Number of quads.
+ */
+void affine2d_quads( affine2d *out, const GLfloat *xywh, const GLfloat *angle, int n )
+{
+   if (angle == NULL) {
+      /* The common case, no trigonometry and nothing in the way of vectorizing. */
+      for (int i=0; i<n; i++) {
+         const GLfloat *q = &xywh[4*i];
+         out[i].m[0] = q[2];
+         out[i].m[1] = 0.;
+         out[i].m[2] = 0.;
+         out[i].m[3] = q[3];
+         out[i].m[4] = q[0];
+         out[i].m[5] = q[1];
+      }
+      return;
+   }
+   for (int i=0; i<n; i++) {
+      const GLfloat *q = &xywh[4*i];
+      affine2d_quad( &out[i], q[0], q[1], q[2], q[3], angle[i] );
+   }
+}
 
-   x = m->m[0][1];
-   y = m->m[1][1];
-   m->m[0][1] =  c*x + s*y;
-   m->m[1][1] = -s*x + c*y;
+/**
+ * @brief Transforms a point with a 2D affine transformation.
+ *
+ *    @param a Transformation to use.
+ *    @param x X coordinate of the point.
+ *    @param y Y coordinate of the point.
+ *    @param[out] ox Transformed X coordinate.
+ *    @param[out] oy Transformed Y coordinate.
+ */
+void affine2d_point( const affine2d *a, GLfloat x, GLfloat y, GLfloat *ox, GLfloat *oy )
+{
+   *ox = a->m[0]*x + a->m[2]*y + a->m[4];
+   *oy = a->m[1]*x + a->m[3]*y + a->m[5];
 }
 
 /**
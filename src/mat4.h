@@ -15,6 +15,16 @@ typedef struct mat4_ {
    };
 } mat4;
 
+/**
+ * @brief 2D affine transformation.
+ *
+ * Maps (x,y) to (m[0]*x + m[2]*y + m[4], m[1]*x + m[3]*y + m[5]), the same
+ *  layout as the x, y and translation columns of a 2D mat4, packed in 6 floats.
+ */
+typedef struct affine2d_ {
+   GLfloat m[6];
+} affine2d;
+
 /* Basic operations. */
 void mat4_print( const mat4 *m );
 void mat4_mul( mat4 *out, const mat4 *m1, const mat4 *m2 );
@@ -30,6 +40,12 @@ void mat4_translate_scale_xy( mat4 *m, double x, double y, double w, double h );
 void mat4_rotate( mat4 *m, double angle, double x, double y, double z );
 void mat4_rotate2d( mat4 *m, double angle );
 void mat4_rotate2dv( mat4 *m, double x, double y );
+void mat4_apply_affine2d( mat4 *m, const affine2d *a );
+
+/* 2D affine transformations. */
+void affine2d_quad( affine2d *a, double x, double y, double w, double h, double angle );
+void affine2d_quads( affine2d *out, const GLfloat *xywh, const GLfloat *angle, int n );
+void affine2d_point( const affine2d *a, GLfloat x, GLfloat y, GLfloat *ox, GLfloat *oy );
 
 /* Creation functions. */
 __attribute__((const)) mat4 mat4_identity( void );
@@ -0,0 +1,129 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file mempool.c
+ *
+ * @brief Slab allocator with a free list for objects of a single size.
+ */
+/** @cond */
+#include <stdalign.h>
+#include <stdlib.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "mempool.h"
+
+#include "array.h"
+#include "log.h"
+#include "ntracing.h"
+
+#define MEMPOOL_ALIGN   alignof(max_align_t) /**< Alignment of the elements. */
+
+/**
+ * @brief Gets the size of the elements once aligned.
+ */
+static size_t mempool_stride( const MemPool *mp )
+{
+   size_t s = MAX( mp->size, sizeof(void*) );
+   return (s + MEMPOOL_ALIGN - 1) / MEMPOOL_ALIGN * MEMPOOL_ALIGN;
+}
+
+/**
+ * @brief Allocates a new slab and adds its elements to the free list.
+ */
+static int mempool_grow( MemPool *mp )
+{
+   size_t stride = mempool_stride( mp );
+   char *slab = malloc( stride * mp->slab_n );
+   if (slab == NULL) {
+      WARN(_("Unable to allocate memory"));
+      return -1;
+   }
+   if (mp->slabs == NULL)
+      mp->slabs = array_create( void* );
+   array_push_back( &mp->slabs, (void*)slab );
+
+   /* Chain backwards so elements are handed out in memory order. */
+   for (int i=mp->slab_n-1; i>=0; i--) {
+      void *e = &slab[ i*stride ];
+      *(void**)e = mp->free;
+      mp->free = e;
+   }
+   return 0;
+}
+
+/**
+ * @brief Gets an element from a pool.
+ *
+ * Like malloc, the memory is not initialized.
+ *
+ *    @param mp Pool to allocate from.
+ *    @return Newly allocated element or NULL on error.
+ */
+void *mempool_alloc( MemPool *mp )
+{
+   void *ptr;
+   if ((mp->free == NULL) && mempool_grow( mp ))
+      return NULL;
+   ptr = mp->free;
+   mp->free = *(void**)ptr;
+   mp->used++;
+   mp->peak = MAX( mp->peak, mp->used );
+   NTracingAlloc( ptr, mp->size );
+   NTracingPlotI( mp->name, mp->used );
+   return ptr;
+}
+
+/**
+ * @brief Returns an element to a pool.
+ *
+ *    @param mp Pool the element was allocated from.
+ *    @param ptr Element to free, may be NULL.
+ */
+void mempool_free( MemPool *mp, void *ptr )
+{
+   if (ptr == NULL)
+      return;
+   NTracingFree( ptr );
+   *(void**)ptr = mp->free;
+   mp->free = ptr;
+   mp->used--;
+   NTracingPlotI( mp->name, mp->used );
+}
+
+/**
+ * @brief Gets the memory reserved by a pool.
+ *
+ *    @param mp Pool to get the memory of.
+ *    @return Bytes taken by the slabs of the pool.
+ */
+size_t mempool_memory( const MemPool *mp )
+{
+   return mempool_stride( mp ) * mp->slab_n * array_size( mp->slabs );
+}
+
+/**
+ * @brief Frees the memory of a pool.
+ *
+ * The slabs are only released when no elements are in use, otherwise they are
+ * kept so that the remaining elements stay valid.
+ *
+ *    @param mp Pool to destroy.
+ */
+void mempool_destroy( MemPool *mp )
+{
+   if (mp->used > 0) {
+      DEBUG(_("Memory pool '%s' still has %d elements in use, not freeing."), mp->name, mp->used);
+      return;
+   }
+   if (mp->slabs != NULL)
+      DEBUG(_("Memory pool '%s' used up to %d elements in %d slabs."), mp->name, mp->peak, array_size(mp->slabs));
+   for (int i=0; i<array_size(mp->slabs); i++)
+      free( mp->slabs[i] );
+   array_free( mp->slabs );
+   mp->slabs = NULL;
+   mp->free = NULL;
+   mp->peak = 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+/**
+ * @brief Pool of fixed size objects allocated in slabs.
+ *
+ * Freed objects are kept in a free list and reused by the next allocation, so
+ * objects that get created and destroyed all the time do not hit malloc. Not
+ * thread safe.
+ */
+typedef struct MemPool_ {
+   const char *name; /**< Name of the pool, used for tracing. */
+   size_t size;      /**< Size of the elements. */
+   int slab_n;       /**< Number of elements per slab. */
+   void *free;       /**< Head of the free list. */
+   void **slabs;     /**< Allocated slabs (array.h). */
+   int used;         /**< Number of elements in use. */
+   int peak;         /**< Largest number of elements in use at once. */
+} MemPool;
+
+/**
+ * @brief Static initializer for a memory pool.
+ *
+ *    @param type Type of the elements.
+ *    @param n Number of elements allocated at once.
+ *    @param name Name of the pool, must be a string literal.
+ */
+#define MEMPOOL_INIT( type, n, name ) { name, sizeof(type), n, NULL, NULL, 0, 0 }
+
+void *mempool_alloc( MemPool *mp );
+void mempool_free( MemPool *mp, void *ptr );
+void mempool_destroy( MemPool *mp );
+size_t mempool_memory( const MemPool *mp );
@@ -0,0 +1,136 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file memstats.c
+ *
+ * @brief Accounts the memory used by each subsystem.
+ *
+ * Subsystems either report what they allocate and free, or set the total
+ *  they hold when it is easier to compute. The totals can be seen in the
+ *  console, are plotted with Tracy and are printed on exit in devmode.
+ */
+/** @cond */
+#include <stdatomic.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "memstats.h"
+
+#include "log.h"
+#include "nlua.h"
+
+static const char *memstats_names[MEMTAG_MAX] = {
+   [MEMTAG_TEXTURES] = "textures",
+   [MEMTAG_LUA]      = "lua",
+   [MEMTAG_PILOTS]   = "pilots",
+   [MEMTAG_WEAPONS]  = "weapons",
+   [MEMTAG_SOUNDS]   = "sounds",
+   [MEMTAG_FONTS]    = "fonts",
+   [MEMTAG_XML]      = "xml",
+}; /**< Names of the tags. */
+static const char *memstats_plots[MEMTAG_MAX] = {
+   [MEMTAG_TEXTURES] = "mem_textures",
+   [MEMTAG_LUA]      = "mem_lua",
+   [MEMTAG_PILOTS]   = "mem_pilots",
+   [MEMTAG_WEAPONS]  = "mem_weapons",
+   [MEMTAG_SOUNDS]   = "mem_sounds",
+   [MEMTAG_FONTS]    = "mem_fonts",
+   [MEMTAG_XML]      = "mem_xml",
+}; /**< Names of the plots, must be string literals. */
+static _Atomic int64_t memstats_used[MEMTAG_MAX]; /**< Bytes used by each tag. */
+static _Atomic int64_t memstats_max[MEMTAG_MAX]; /**< Most bytes used by each tag. */
+
+/**
+ * @brief Updates the peak of a tag.
+ */
+static void memstats_updatePeak( MemTag tag, int64_t used )
+{
+   int64_t peak = atomic_load_explicit( &memstats_max[tag], memory_order_relaxed );
+   while ((used > peak) && !atomic_compare_exchange_weak_explicit( &memstats_max[tag],
+            &peak, used, memory_order_relaxed, memory_order_relaxed ));
+}
+
+/**
+ * @brief Accounts memory to a subsystem, can be called from any thread.
+ *
+ *    @param tag Subsystem to account to.
+ *    @param bytes Bytes allocated, negative if freed.
+ */
+void memstats_add( MemTag tag, int64_t bytes )
+{
+   int64_t used = atomic_fetch_add_explicit( &memstats_used[tag], bytes, memory_order_relaxed ) + bytes;
+   if (bytes > 0)
+      memstats_updatePeak( tag, used );
+}
+
+/**
+ * @brief Sets the memory used by a subsystem, can be called from any thread.
+ *
+ *    @param tag Subsystem to set.
+ *    @param bytes Bytes it uses.
+ */
+void memstats_set( MemTag tag, int64_t bytes )
+{
+   atomic_store_explicit( &memstats_used[tag], bytes, memory_order_relaxed );
+   memstats_updatePeak( tag, bytes );
+}
+
+/**
+ * @brief Gets the memory used by a subsystem.
+ */
+int64_t memstats_get( MemTag tag )
+{
+   return atomic_load_explicit( &memstats_used[tag], memory_order_relaxed );
+}
+
+/**
+ * @brief Gets the most memory used by a subsystem so far.
+ */
+int64_t memstats_peak( MemTag tag )
+{
+   return atomic_load_explicit( &memstats_max[tag], memory_order_relaxed );
+}
+
+/**
+ * @brief Gets the name of a tag.
+ */
+const char *memstats_name( MemTag tag )
+{
+   return memstats_names[tag];
+}
+
+/**
+ * @brief Samples the subsystems that can't report their memory and plots it,
+ *        meant to be called once a frame.
+ */
+void memstats_update (void)
+{
+   if (naevL != NULL)
+      memstats_set( MEMTAG_LUA, (int64_t)lua_gc( naevL, LUA_GCCOUNT, 0 )*1024
+            + lua_gc( naevL, LUA_GCCOUNTB, 0 ) );
+
+#if HAVE_TRACY
+   for (int i=0; i<MEMTAG_MAX; i++)
+      NTracingPlotI( memstats_plots[i], memstats_get( i ) );
+#else /* HAVE_TRACY */
+   (void) memstats_plots;
+#endif /* HAVE_TRACY */
+}
+
+/**
+ * @brief Prints the memory used by each subsystem.
+ */
+void memstats_print (void)
+{
+   int64_t total = 0;
+   memstats_update();
+   LOG(_("Memory usage (current / peak):"));
+   for (int i=0; i<MEMTAG_MAX; i++) {
+      LOG("   %-10s %8.1f / %8.1f MiB", memstats_names[i],
+            memstats_get( i ) / 1048576., memstats_peak( i ) / 1048576. );
+      total += memstats_get( i );
+   }
+   LOG("   %-10s %8.1f MiB", _("total"), total / 1048576. );
+}
@@ -0,0 +1,81 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+/** @endcond */
+
+#include "ntracing.h"
+
+/**
+ * @brief Subsystems the memory is accounted to.
+ */
+typedef enum MemTag_ {
+   MEMTAG_TEXTURES,  /**< Textures, estimated from their uncompressed size. */
+   MEMTAG_LUA,       /**< Memory of the Lua state. */
+   MEMTAG_PILOTS,    /**< Pilot pool. */
+   MEMTAG_WEAPONS,   /**< Weapon stack. */
+   MEMTAG_SOUNDS,    /**< Decoded sound buffers. */
+   MEMTAG_FONTS,     /**< Glyph textures of the fonts. */
+   MEMTAG_XML,       /**< XML files being parsed. */
+   MEMTAG_MAX        /**< Number of tags. */
+} MemTag;
+
+void memstats_add( MemTag tag, int64_t bytes );
+void memstats_set( MemTag tag, int64_t bytes );
+int64_t memstats_get( MemTag tag );
+int64_t memstats_peak( MemTag tag );
+const char *memstats_name( MemTag tag );
+void memstats_update (void);
+void memstats_print (void);
+
+/**
+ * @brief Allocates memory accounted to a subsystem.
+ */
+static inline void *nmalloc_tag( MemTag tag, size_t size )
+{
+   void *ptr = nmalloc( size );
+   if (ptr != NULL)
+      memstats_add( tag, size );
+   return ptr;
+}
+
+/**
+ * @brief Allocates zeroed memory accounted to a subsystem.
+ */
+static inline void *ncalloc_tag( MemTag tag, size_t nmemb, size_t size )
+{
+   void *ptr = ncalloc( nmemb, size );
+   if (ptr != NULL)
+      memstats_add( tag, nmemb*size );
+   return ptr;
+}
+
+/**
+ * @brief Resizes memory accounted to a subsystem.
+ *
+ * Unlike realloc, the old size has to be given as it is not stored.
+ */
+static inline void *nrealloc_tag( MemTag tag, void *ptr, size_t oldsize, size_t size )
+{
+   void *newptr = nrealloc( ptr, size );
+   if (newptr != NULL)
+      memstats_add( tag, (int64_t)size - (int64_t)oldsize );
+   return newptr;
+}
+
+/**
+ * @brief Frees memory accounted to a subsystem.
+ *
+ * Unlike free, the size has to be given as it is not stored.
+ */
+static inline void nfree_tag( MemTag tag, void *ptr, size_t size )
+{
+   if (ptr != NULL)
+      memstats_add( tag, -(int64_t)size );
+   nfree( ptr );
+}
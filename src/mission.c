@@ -16,12 +16,15 @@
 #include "mission.h"
 
 #include "array.h"
+#include "bitset.h"
 #include "cond.h"
+#include "conf.h"
 #include "faction.h"
 #include "gui_osd.h"
 #include "hook.h"
 #include "land.h"
 #include "log.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nlua_faction.h"
@@ -33,10 +36,12 @@
 #include "nstring.h"
 #include "nxml.h"
 #include "nxml_lua.h"
+#include "opengl.h"
 #include "player.h"
 #include "player_fleet.h"
 #include "rng.h"
 #include "space.h"
+#include "threadpool.h"
 #include "ntracing.h"
 
 #define XML_MISSION_TAG       "mission" /**< XML mission tag. */
@@ -47,11 +52,41 @@
 static unsigned int mission_id = 0; /**< Mission ID generator. */
 Mission **player_missions = NULL; /**< Player's active missions. */
 static char **player_missions_failed = NULL; /**< Name of missions that failed to load. */
+static uint32_t *player_missionsRunning = NULL; /**< Bitset (bitset.h) of the data of player_missions by ID. */
+static int player_missionsDirty = 1; /**< Whether or not player_missionsRunning has to be rebuilt. */
 
 /*
  * mission stack
  */
 static MissionData *mission_stack = NULL; /**< Unmutable after creation */
+static NameIndex mission_nameIndex; /**< Index of mission_stack by name. */
+
+/**
+ * @brief Mission index and key it is filed under.
+ */
+typedef struct MissionIndexEntry_ {
+   int key;    /**< Spob, system or faction id. */
+   int misn;   /**< Index in mission_stack. */
+} MissionIndexEntry;
+
+/**
+ * @brief Missions of a location, bucketed by what they require.
+ *
+ * Candidates are the union of the buckets that can match, mission_meetReq still
+ *  has the last word.
+ */
+typedef struct MissionIndex_ {
+   MissionIndexEntry *spob;   /**< Array (array.h): Missions requiring a spob, sorted by spob id. */
+   MissionIndexEntry *system; /**< Array (array.h): Missions requiring a system and no spob, sorted by system id. */
+   MissionIndexEntry *faction;/**< Array (array.h): Other missions requiring factions, sorted by faction. */
+   int *generic;              /**< Array (array.h): Other missions with no faction requirement. */
+   int *anyfaction;           /**< Array (array.h): Missions of faction and generic together. */
+   int *unresolved;           /**< Array (array.h): Missions requiring a spob or system that doesn't exist yet. */
+} MissionIndex;
+static MissionIndex mission_index[MIS_AVAIL_ENTER+1]; /**< Mission availability index by location. */
+
+static unsigned int mission_chapterGen = 1; /**< Generation of the player chapter. */
+static char *mission_chapterLast = NULL; /**< Chapter the generation corresponds to. */
 
 /*
  * prototypes
@@ -63,14 +98,21 @@ static int mission_init( Mission* mission, const MissionData* misn, int genid, i
 static void mission_freeData( MissionData* mission );
 /* Matching. */
 static int mission_compare( const void* arg1, const void* arg2 );
-static int mission_meetConditionals( const MissionData *misn );
-static int mission_meetReq( const MissionData *misn, int faction,
+static void missions_indexBuild (void);
+static void missions_indexFree (void);
+static int *missions_indexCandidates( MissionAvailability loc, int faction, const Spob *pnt, const StarSystem *sys );
+static int mission_matchChapter( MissionData *misn );
+static int mission_meetConditionals( MissionData *misn );
+static int mission_meetReq( MissionData *misn, int faction,
       const Spob *pnt, const StarSystem *sys );
 static int mission_matchFaction( const MissionData* misn, int faction );
 static int mission_location( const char *loc );
 /* Loading. */
 static int missions_cmp( const void *a, const void *b );
 static int mission_parseFile( const char* file, MissionData *temp );
+static int mission_readFile( const char* file, MissionData *temp );
+static void mission_compile( MissionData *temp );
+static int mission_parseThread( void *ptr );
 static int mission_parseXML( MissionData *temp, const xmlNodePtr parent );
 static int missions_parseActive( xmlNodePtr parent );
 /* Misc. */
@@ -100,9 +142,9 @@ static unsigned int mission_genID (void)
  */
 int mission_getID( const char* name )
 {
-   for (int i=0; i<array_size(mission_stack); i++)
-      if (strcmp(name,mission_stack[i].name)==0)
-         return i;
+   int id = nameindex_get( &mission_nameIndex, name );
+   if (id >= 0)
+      return id;
 
    WARN(_("Mission '%s' not found in stack"), name);
    return -1;
@@ -166,6 +208,7 @@ static int mission_init( Mission* mission, const MissionData* misn, int genid, i
 
    /* init Lua */
    mission->env = nlua_newEnv();
+   nlua_setEnvName( mission->env, "mission/%s", misn->name );
 
    misn_loadLibs( mission->env ); /* load our custom libraries */
 
@@ -226,35 +269,86 @@ const MissionData *mission_list (void)
 int mission_alreadyRunning( const MissionData* misn )
 {
    int n = 0;
+
+   /* Rebuild the bitset if the player's missions changed. */
+   if (player_missionsDirty) {
+      bitset_clear( player_missionsRunning );
+      for (int i=0; i<array_size(player_missions); i++)
+         if (player_missions[i]->data != NULL)
+            bitset_set( &player_missionsRunning, player_missions[i]->data - mission_stack );
+      player_missionsDirty = 0;
+   }
+   if (!bitset_test( player_missionsRunning, misn - mission_stack ))
+      return 0;
+
+   /* Only count when it is running. */
    for (int i=0; i<array_size(player_missions); i++)
       if (player_missions[i]->data == misn)
          n++;
    return n;
 }
 
-static int mission_meetConditionals( const MissionData *misn )
+/**
+ * @brief Marks the player's missions as changed.
+ *
+ * Has to be called whenever missions are added to player_missions.
+ */
+void missions_runningChanged (void)
+{
+   player_missionsDirty = 1;
+}
+
+/**
+ * @brief Matches the chapter of a mission, caching it until the chapter changes.
+ *
+ *    @return 0 if it matches, -1 if it doesn't and 1 on error.
+ */
+static int mission_matchChapter( MissionData *misn )
+{
+   pcre2_match_data *match_data;
+   int rc;
+
+   /* Chapter changed, have to match again. */
+   if ((mission_chapterLast == NULL) || (strcmp( mission_chapterLast, player.chapter ) != 0)) {
+      free( mission_chapterLast );
+      mission_chapterLast = strdup( player.chapter );
+      mission_chapterGen++;
+   }
+   if (misn->avail.chapter_gen == mission_chapterGen)
+      return misn->avail.chapter_match;
+
+   match_data = pcre2_match_data_create_from_pattern( misn->avail.chapter_re, NULL );
+   rc = pcre2_match( misn->avail.chapter_re, (PCRE2_SPTR)player.chapter, strlen(player.chapter), 0, 0, match_data, NULL );
+   pcre2_match_data_free( match_data );
+   misn->avail.chapter_match = 0;
+   if (rc < 0) {
+      switch (rc) {
+         case PCRE2_ERROR_NOMATCH:
+            misn->avail.chapter_match = -1;
+            break;
+         default:
+            WARN(_("Matching error %d"), rc );
+            break;
+      }
+   }
+   else if (rc == 0)
+      misn->avail.chapter_match = 1;
+   misn->avail.chapter_gen = mission_chapterGen;
+   return misn->avail.chapter_match;
+}
+
+static int mission_meetConditionals( MissionData *misn )
 {
    /* If chapter, must match chapter. */
    if (misn->avail.chapter_re != NULL) {
-      pcre2_match_data *match_data = pcre2_match_data_create_from_pattern( misn->avail.chapter_re, NULL );
-      int rc = pcre2_match( misn->avail.chapter_re, (PCRE2_SPTR)player.chapter, strlen(player.chapter), 0, 0, match_data, NULL );
-      pcre2_match_data_free( match_data );
-      if (rc < 0) {
-         switch (rc) {
-            case PCRE2_ERROR_NOMATCH:
-               return -1;
-            default:
-               WARN(_("Matching error %d"), rc );
-               break;
-         }
-      }
-      else if (rc == 0)
-         return 1;
+      int rc = mission_matchChapter( misn );
+      if (rc != 0)
+         return rc;
    }
 
    /* Must not be already done or running if unique. */
    if (mis_isFlag(misn,MISSION_UNIQUE) &&
-         (player_missionAlreadyDone( mission_getID(misn->name) ) ||
+         (player_missionAlreadyDone( misn - mission_stack ) ||
           mission_alreadyRunning(misn)))
       return 1;
 
@@ -286,7 +380,7 @@ static int mission_meetConditionals( const MissionData *misn )
  *    @param sys System to run on.
  *    @return 1 if requirements are met, 0 if they aren't.
  */
-static int mission_meetReq( const MissionData *misn, int faction,
+static int mission_meetReq( MissionData *misn, int faction,
       const Spob *pnt, const StarSystem *sys )
 {
    if (misn == NULL) /* In case it doesn't exist */
@@ -321,16 +415,14 @@ static int mission_meetReq( const MissionData *misn, int faction,
  */
 void missions_run( MissionAvailability loc, int faction, const Spob *pnt, const StarSystem *sys )
 {
-   for (int i=0; i<array_size(mission_stack); i++) {
+   int *candidates = missions_indexCandidates( loc, faction, pnt, sys );
+   for (int i=0; i<array_size(candidates); i++) {
       Mission mission;
       double chance;
-      MissionData *misn = &mission_stack[i];
+      MissionData *misn = &mission_stack[ candidates[i] ];
 
       if (naev_isQuit())
-         return;
-
-      if (misn->avail.loc != loc)
-         continue;
+         break;
 
       if (!mission_meetReq( misn, faction, pnt, sys ))
          continue;
@@ -344,6 +436,7 @@ void missions_run( MissionAvailability loc, int faction, const Spob *pnt, const
          mission_cleanup(&mission); /* it better clean up for itself or we do it */
       }
    }
+   array_free( candidates );
 }
 
 /**
@@ -386,14 +479,13 @@ int mission_start( const char *name, unsigned int *id )
  */
 int mission_test( const char *name )
 {
-   const MissionData *mdat;
+   int id = mission_getID( name );
 
    /* Try to get the mission. */
-   mdat = mission_get( mission_getID(name) );
-   if (mdat == NULL)
+   if (mission_get( id ) == NULL)
       return -1;
 
-   return mission_meetConditionals( mdat );
+   return mission_meetConditionals( &mission_stack[id] );
 }
 
 const char *mission_availabilityStr( MissionAvailability loc )
@@ -739,6 +831,10 @@ int mission_unlinkCargo( Mission* misn, unsigned int cargo_id )
  */
 void mission_cleanup( Mission* misn )
 {
+   /* Player's missions are accepted. */
+   if (misn->accepted && (misn->data != NULL))
+      player_missionsDirty = 1;
+
    /* Hooks and missions. */
    if (misn->id != 0) {
       hook_rmMisnParent( misn->id ); /* remove existing hooks */
@@ -828,9 +924,6 @@ static void mission_freeData( MissionData* mission )
    if (mission->chunk != LUA_NOREF)
       luaL_unref( naevL, LUA_REGISTRYINDEX, mission->chunk );
 
-   if (mission->avail.cond_chunk != LUA_NOREF)
-      luaL_unref( naevL, LUA_REGISTRYINDEX, mission->avail.cond_chunk );
-
    for (int i=0; i<array_size(mission->tags); i++)
       free(mission->tags[i]);
    array_free(mission->tags);
@@ -862,6 +955,176 @@ static int mission_matchFaction( const MissionData* misn, int faction )
    return 0;
 }
 
+/**
+ * @brief Compares mission index entries by key and then by mission.
+ */
+static int mission_indexCmp( const void *p1, const void *p2 )
+{
+   const MissionIndexEntry *e1 = p1;
+   const MissionIndexEntry *e2 = p2;
+   if (e1->key != e2->key)
+      return e1->key - e2->key;
+   return e1->misn - e2->misn;
+}
+
+/**
+ * @brief Compares mission indices.
+ */
+static int mission_idCmp( const void *p1, const void *p2 )
+{
+   return *(const int*)p1 - *(const int*)p2;
+}
+
+/**
+ * @brief Builds the mission availability index, mission_stack must not change afterwards.
+ */
+static void missions_indexBuild (void)
+{
+   missions_indexFree();
+   nameindex_reserve( &mission_nameIndex, array_size(mission_stack) );
+   for (int i=0; i<array_size(mission_stack); i++)
+      nameindex_add( &mission_nameIndex, mission_stack[i].name, i );
+   for (int i=0; i<=MIS_AVAIL_ENTER; i++) {
+      MissionIndex *mi = &mission_index[i];
+      mi->spob       = array_create( MissionIndexEntry );
+      mi->system     = array_create( MissionIndexEntry );
+      mi->faction    = array_create( MissionIndexEntry );
+      mi->generic    = array_create( int );
+      mi->anyfaction = array_create( int );
+      mi->unresolved = array_create( int );
+   }
+
+   for (int i=0; i<array_size(mission_stack); i++) {
+      const MissionData *misn = &mission_stack[i];
+      MissionIndex *mi;
+      MissionIndexEntry e;
+
+      if ((misn->avail.loc <= MIS_AVAIL_NONE) || (misn->avail.loc > MIS_AVAIL_ENTER))
+         continue;
+      mi = &mission_index[ misn->avail.loc ];
+      e.misn = i;
+
+      /* Spobs and systems added by unidiffs are not known yet, always check them. */
+      if (misn->avail.spob != NULL) {
+         if (!spob_exists( misn->avail.spob ))
+            array_push_back( &mi->unresolved, i );
+         else {
+            e.key = spob_get( misn->avail.spob )->id;
+            array_push_back( &mi->spob, e );
+         }
+      }
+      else if (misn->avail.system != NULL) {
+         const char *sysname = system_existsCase( misn->avail.system );
+         if ((sysname == NULL) || (strcmp( sysname, misn->avail.system ) != 0))
+            array_push_back( &mi->unresolved, i );
+         else {
+            e.key = system_get( sysname )->id;
+            array_push_back( &mi->system, e );
+         }
+      }
+      else {
+         array_push_back( &mi->anyfaction, i );
+         if (array_size(misn->avail.factions) == 0)
+            array_push_back( &mi->generic, i );
+         for (int j=0; j<array_size(misn->avail.factions); j++) {
+            e.key = misn->avail.factions[j];
+            array_push_back( &mi->faction, e );
+         }
+      }
+   }
+
+   for (int i=0; i<=MIS_AVAIL_ENTER; i++) {
+      MissionIndex *mi = &mission_index[i];
+      qsort( mi->spob, array_size(mi->spob), sizeof(MissionIndexEntry), mission_indexCmp );
+      qsort( mi->system, array_size(mi->system), sizeof(MissionIndexEntry), mission_indexCmp );
+      qsort( mi->faction, array_size(mi->faction), sizeof(MissionIndexEntry), mission_indexCmp );
+   }
+}
+
+/**
+ * @brief Frees the mission availability index.
+ */
+static void missions_indexFree (void)
+{
+   nameindex_free( &mission_nameIndex );
+   for (int i=0; i<=MIS_AVAIL_ENTER; i++) {
+      MissionIndex *mi = &mission_index[i];
+      array_free( mi->spob );
+      array_free( mi->system );
+      array_free( mi->faction );
+      array_free( mi->generic );
+      array_free( mi->anyfaction );
+      array_free( mi->unresolved );
+      memset( mi, 0, sizeof(MissionIndex) );
+   }
+}
+
+/**
+ * @brief Adds the missions filed under a key to the candidates.
+ */
+static void missions_indexAdd( int **candidates, const MissionIndexEntry *entries, int key )
+{
+   /* Find the first entry with the key. */
+   int lo = 0, hi = array_size(entries);
+   while (lo < hi) {
+      int mid = (lo+hi) / 2;
+      if (entries[mid].key < key)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   for (int i=lo; (i<array_size(entries)) && (entries[i].key==key); i++)
+      array_push_back( candidates, entries[i].misn );
+}
+
+/**
+ * @brief Gets the missions that could be available somewhere.
+ *
+ *    @param loc Location to match.
+ *    @param faction Faction of the spob or -1 for any.
+ *    @param pnt Spob to run on.
+ *    @param sys System to run on.
+ *    @return Array (array.h) of indices in mission_stack in priority order, to be freed.
+ */
+static int *missions_indexCandidates( MissionAvailability loc, int faction, const Spob *pnt, const StarSystem *sys )
+{
+   const MissionIndex *mi;
+   int *candidates = array_create( int );
+   int n;
+
+   if ((loc <= MIS_AVAIL_NONE) || (loc > MIS_AVAIL_ENTER))
+      return candidates;
+   mi = &mission_index[loc];
+
+   if (pnt != NULL)
+      missions_indexAdd( &candidates, mi->spob, pnt->id );
+   if (sys != NULL)
+      missions_indexAdd( &candidates, mi->system, sys->id );
+   if (faction >= 0) {
+      missions_indexAdd( &candidates, mi->faction, faction );
+      for (int i=0; i<array_size(mi->generic); i++)
+         array_push_back( &candidates, mi->generic[i] );
+   }
+   else {
+      for (int i=0; i<array_size(mi->anyfaction); i++)
+         array_push_back( &candidates, mi->anyfaction[i] );
+   }
+   for (int i=0; i<array_size(mi->unresolved); i++)
+      array_push_back( &candidates, mi->unresolved[i] );
+
+   /* Back to priority order and without repeats. */
+   n = array_size(candidates);
+   if (n > 1) {
+      int j = 1;
+      qsort( candidates, n, sizeof(int), mission_idCmp );
+      for (int i=1; i<n; i++)
+         if (candidates[i] != candidates[j-1])
+            candidates[j++] = candidates[i];
+      array_resize( &candidates, j );
+   }
+   return candidates;
+}
+
 /**
  * @brief Activates mission claims.
  */
@@ -918,6 +1181,9 @@ Mission* missions_genList( int *n, int faction,
    int m, alloced;
    int rep;
    Mission* tmp;
+   int *candidates;
+   Uint64 ttotal, tslow;
+   const char *slowest;
 
    NTracingZone( _ctx, 1 );
 
@@ -925,11 +1191,16 @@ Mission* missions_genList( int *n, int faction,
    tmp      = NULL;
    m        = 0;
    alloced  = 0;
-   for (int i=0; i<array_size(mission_stack); i++) {
+   candidates = missions_indexCandidates( loc, faction, pnt, sys );
+   ttotal   = 0;
+   tslow    = 0;
+   slowest  = NULL;
+
+   /* The create functions go through the whole game API on the single Lua
+    * state, so they have to run here one after another. */
+   for (int i=0; i<array_size(candidates); i++) {
       double chance;
-      MissionData *misn = &mission_stack[i];
-      if (misn->avail.loc != loc)
-         continue;
+      MissionData *misn = &mission_stack[ candidates[i] ];
 
       /* Must hit chance. */
       chance = (double)(misn->avail.chance % 100)/100.;
@@ -956,11 +1227,27 @@ Mission* missions_genList( int *n, int faction,
             tmp      = realloc( tmp, sizeof(Mission) * alloced );
          }
          /* Initialize the mission. */
+         Uint64 tstart = SDL_GetPerformanceCounter();
          if (mission_init( &tmp[m-1], misn, 1, 1, NULL ))
             m--;
+         tstart = SDL_GetPerformanceCounter() - tstart;
+         ttotal += tstart;
+         if (tstart > tslow) {
+            tslow    = tstart;
+            slowest  = misn->name;
+         }
       }
    }
 
+   array_free( candidates );
+
+   /* Which create functions make landing slow. */
+   if (conf.devmode && (slowest != NULL)) {
+      double freq = (double)SDL_GetPerformanceFrequency();
+      DEBUG( _("Created %d missions in %.3f ms, slowest '%s' took %.3f ms"), m,
+            1000. * (double)ttotal / freq, slowest, 1000. * (double)tslow / freq );
+   }
+
    /* Sort. */
    if (tmp != NULL) {
       qsort( tmp, m, sizeof(Mission), mission_compare );
@@ -1072,13 +1359,6 @@ static int mission_parseXML( MissionData *temp, const xmlNodePtr parent )
       WARN(_("Unknown node '%s' in mission '%s'"),node->name,temp->name);
    } while (xml_nextNode(node));
 
-   /* Compile conditional chunk. */
-   if (temp->avail.cond != NULL) {
-      temp->avail.cond_chunk = cond_compile( temp->avail.cond );
-      if (temp->avail.cond_chunk == LUA_NOREF || temp->avail.cond_chunk == LUA_REFNIL)
-         WARN(_("Mission '%s' failed to compile Lua conditional!"), temp->name);
-   }
-
    /* Compile regex for chapter matching. */
    if (temp->avail.chapter != NULL) {
       int errornumber;
@@ -1117,6 +1397,31 @@ static int missions_cmp( const void *a, const void *b )
    return strcmp( ma->name, mb->name );
 }
 
+/**
+ * @brief Data of a mission being parsed in the vpool.
+ */
+typedef struct MissionThreadData_ {
+   MissionData misn; /**< Mission being parsed. */
+   char *filename;   /**< File to parse. */
+   int ret;          /**< Result of parsing. */
+} MissionThreadData;
+
+/**
+ * @brief Reads and parses the header of a mission, to be run in the vpool.
+ */
+static int mission_parseThread( void *ptr )
+{
+   MissionThreadData *data = ptr;
+   data->ret = mission_readFile( data->filename, &data->misn );
+   /* Render if necessary. */
+   if (naev_shouldRenderLoadscreen()) {
+      gl_contextSet();
+      naev_renderLoadscreen();
+      gl_contextUnset();
+   }
+   return data->ret;
+}
+
 /**
  * @brief Loads all the mission data.
  *
@@ -1128,15 +1433,43 @@ int missions_load (void)
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
    char **mission_files;
+   MissionThreadData *mdata;
+   ThreadQueue *tq;
 
    /* Run over missions. */
    mission_files = ndata_listRecursive( MISSION_DATA_PATH );
-   mission_stack = array_create_size( MissionData, array_size( mission_files ) );
+   mdata = array_create_size( MissionThreadData, array_size( mission_files ) );
    for (int i=0; i < array_size( mission_files ); i++) {
-      mission_parseFile( mission_files[i], NULL );
-      free( mission_files[i] );
+      MissionThreadData *md = &array_grow( &mdata );
+      md->filename = mission_files[i];
    }
    array_free( mission_files );
+
+   /* The name indices are built lazily, make sure the threads only read them. */
+   faction_exists( "" );
+   spob_exists( "" );
+   system_existsCase( "" );
+
+   /* Read and parse the headers in parallel, enqueuing after the data array is done. */
+   tq = vpool_create();
+   for (int i=0; i<array_size(mdata); i++)
+      vpool_enqueue( tq, mission_parseThread, &mdata[i] );
+   SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Compile the Lua on the main state in listing order. */
+   mission_stack = array_create_size( MissionData, array_size( mdata ) );
+   for (int i=0; i<array_size(mdata); i++) {
+      MissionThreadData *md = &mdata[i];
+      if (!md->ret) {
+         mission_compile( &md->misn );
+         array_push_back( &mission_stack, md->misn );
+      }
+      free( md->filename );
+   }
+   array_free( mdata );
    array_shrink(&mission_stack);
 
 #ifdef DEBUGGING
@@ -1151,6 +1484,9 @@ int missions_load (void)
    /* Sort based on priority so higher priority missions can establish claims first. */
    qsort( mission_stack, array_size(mission_stack), sizeof(MissionData), missions_cmp );
 
+   /* Index by where they can appear. */
+   missions_indexBuild();
+
 #if DEBUGGING
    if (conf.devmode) {
       time = SDL_GetTicks() - time;
@@ -1167,9 +1503,26 @@ int missions_load (void)
  * @brief Parses a single mission.
  *
  *    @param file Source file path.
- *    @param temp Data to load into, or NULL for initial load.
+ *    @param temp Data to load into.
  */
 static int mission_parseFile( const char* file, MissionData *temp )
+{
+   if (mission_readFile( file, temp ))
+      return -1;
+   mission_compile( temp );
+   return 0;
+}
+
+/**
+ * @brief Reads a mission and parses its XML header.
+ *
+ * Does not touch the Lua state, so it can be run from the vpool.
+ *
+ *    @param file Source file path.
+ *    @param temp Data to load into.
+ *    @return 0 on success.
+ */
+static int mission_readFile( const char* file, MissionData *temp )
 {
    xmlDocPtr doc;
    xmlNodePtr node;
@@ -1219,12 +1572,30 @@ static int mission_parseFile( const char* file, MissionData *temp )
       return -1;
    }
 
-   if (temp == NULL)
-      temp = &array_grow(&mission_stack);
    mission_parseXML( temp, node );
    temp->lua = filebuf;
    temp->sourcefile = strdup(file);
 
+   /* Clean up. */
+   xmlFreeDoc(doc);
+
+   return 0;
+}
+
+/**
+ * @brief Compiles the Lua of a mission, and its conditional, on the main state.
+ *
+ *    @param temp Mission to compile.
+ */
+static void mission_compile( MissionData *temp )
+{
+   /* Compile conditional chunk. */
+   if (temp->avail.cond != NULL) {
+      temp->avail.cond_chunk = cond_compile( temp->avail.cond );
+      if (temp->avail.cond_chunk == LUA_NOREF || temp->avail.cond_chunk == LUA_REFNIL)
+         WARN(_("Mission '%s' failed to compile Lua conditional!"), temp->name);
+   }
+
    /* Clear chunk if already loaded. */
    if (temp->chunk != LUA_NOREF) {
       luaL_unref( naevL, LUA_REGISTRYINDEX, temp->chunk );
@@ -1234,14 +1605,9 @@ static int mission_parseFile( const char* file, MissionData *temp )
    /* Load the chunk. */
    int ret = luaL_loadbuffer(naevL, temp->lua, strlen(temp->lua), temp->name );
    if (ret == LUA_ERRSYNTAX)
-      WARN(_("Mission Lua '%s' syntax error: %s"), file, lua_tostring(naevL,-1) );
+      WARN(_("Mission Lua '%s' syntax error: %s"), temp->sourcefile, lua_tostring(naevL,-1) );
    else
       temp->chunk = luaL_ref( naevL, LUA_REGISTRYINDEX );
-
-   /* Clean up. */
-   xmlFreeDoc(doc);
-
-   return 0;
 }
 
 /**
@@ -1253,14 +1619,20 @@ void missions_free (void)
    missions_cleanup();
 
    /* Free the mission data. */
+   missions_indexFree();
    for (int i=0; i<array_size(mission_stack); i++)
       mission_freeData( &mission_stack[i] );
    array_free( mission_stack );
    mission_stack = NULL;
+   free( mission_chapterLast );
+   mission_chapterLast = NULL;
 
    /* Free the player mission stack. */
    array_free( player_missions );
    player_missions = NULL;
+   array_free( player_missionsRunning );
+   player_missionsRunning = NULL;
+   player_missionsDirty = 1;
 
    /* Frees failed missions. */
    array_free( player_missions_failed );
@@ -1277,6 +1649,7 @@ void missions_cleanup (void)
       free( player_missions[i] );
    }
    array_erase( &player_missions, array_begin(player_missions), array_end(player_missions) );
+   player_missionsDirty = 1;
 
    for (int i=0; i<array_size(player_missions_failed); i++)
       free( player_missions_failed[i] );
@@ -1635,8 +2008,10 @@ static int missions_parseActive( xmlNodePtr parent )
             failed = -1;
             mission_cleanup( misn );
          }
-         else
+         else {
             array_push_back( &player_missions, misn );
+            player_missionsDirty = 1;
+         }
       }
    } while (xml_nextNode(node));
 
@@ -1658,8 +2033,10 @@ int mission_reload( const char *name )
       return -1;
    save = *temp;
    res = mission_parseFile( save.sourcefile, temp );
-   if (res == 0)
+   if (res == 0) {
       mission_freeData( &save );
+      missions_indexBuild(); /* Requirements may have changed. */
+   }
    else
       *temp = save;
    return res;
@@ -43,12 +43,14 @@ typedef struct MissionAvail_s {
    char *system; /**< System name. */
    char *chapter; /**< Chapter name. */
    pcre2_code *chapter_re; /**< Compiled regex chapter if applicable. */
+   unsigned int chapter_gen; /**< Chapter generation chapter_match was computed for. */
+   int chapter_match; /**< Cached result of matching chapter_re, 0 if it matches. */
 
    /* For generic cases */
    int *factions; /**< Array (array.h): To certain factions. */
 
    char *cond; /**< Condition that must be met (Lua). */
-   int cond_chunk; /**< Chunk representing the condition. */
+   int cond_chunk; /**< Chunk representing the condition, owned by cond.c. */
    char *done; /**< Previous mission that must have been done. */
 
    int priority; /**< Mission priority: 0 = main plot, 5 = default, 10 = insignificant. */
@@ -128,6 +130,7 @@ const char *mission_availabilityStr( MissionAvailability loc );
  */
 const MissionData *mission_list (void);
 int mission_alreadyRunning( const MissionData* misn );
+void missions_runningChanged (void);
 int mission_getID( const char* name );
 const MissionData* mission_get( int id );
 const MissionData* mission_getFromName( const char* name );
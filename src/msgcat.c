@@ -86,6 +86,12 @@ void msgcat_init( msgcat_t* p, const void* map, size_t map_size )
    }
    p->nplurals = np;
    p->plural_rule = rule;
+
+   /* Evaluate the rule once for the numbers that get used the most. */
+   for (uint64_t i=0; i<MSGCAT_PLURAL_TABLE; i++) {
+      uint64_t plural = msgcat_plural_eval(rule, i);
+      p->plural_table[i] = (plural < MSGCAT_PLURAL_NONE) ? plural : MSGCAT_PLURAL_NONE;
+   }
 }
 
 /**
@@ -100,22 +106,55 @@ void msgcat_init( msgcat_t* p, const void* map, size_t map_size )
  */
 const char* msgcat_ngettext( const msgcat_t* p, const char* msgid1, const char* msgid2, uint64_t n )
 {
-   const char *trans = msgcat_mo_lookup(p->map, p->map_size, msgid1);
+   const char *trans = msgcat_lookup(p, msgid1);
    if (!trans) return NULL;
 
    /* Non-plural-processing gettext forms pass a null pointer as
     * msgid2 to request that dcngettext suppress plural processing. */
 
-   if (msgid2 && p->nplurals) {
-      uint64_t plural = msgcat_plural_eval(p->plural_rule, n);
-      if (plural > p->nplurals) return NULL;
-      while (plural--) {
-         size_t rem = p->map_size - (trans - (char *)p->map);
-         size_t l = strnlen(trans, rem);
-         if (l+1 >= rem)
-            return NULL;
-         trans += l+1;
-      }
+   if (msgid2)
+      return msgcat_plural(p, trans, n);
+   return trans;
+}
+
+/**
+ * @brief Looks up the translation of a message, without plural processing.
+ *
+ * @param p The message catalog.
+ * @param msgid The English singular form.
+ * @return The translation of the singular form, which is followed by the other forms, or NULL.
+ */
+const char* msgcat_lookup( const msgcat_t* p, const char* msgid )
+{
+   return msgcat_mo_lookup(p->map, p->map_size, msgid);
+}
+
+/**
+ * @brief Gets the plural form of a translation.
+ *
+ * @param p The message catalog.
+ * @param trans Translation from msgcat_lookup.
+ * @param n The number determining the plural form to use.
+ * @return The plural form, or NULL if it doesn't exist.
+ */
+const char* msgcat_plural( const msgcat_t* p, const char* trans, uint64_t n )
+{
+   uint64_t plural;
+
+   if (!p->nplurals)
+      return trans;
+
+   if ((n < MSGCAT_PLURAL_TABLE) && (p->plural_table[n] != MSGCAT_PLURAL_NONE))
+      plural = p->plural_table[n];
+   else
+      plural = msgcat_plural_eval(p->plural_rule, n);
+   if (plural > p->nplurals) return NULL;
+   while (plural--) {
+      size_t rem = p->map_size - (trans - (char *)p->map);
+      size_t l = strnlen(trans, rem);
+      if (l+1 >= rem)
+         return NULL;
+      trans += l+1;
    }
    return trans;
 }
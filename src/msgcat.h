@@ -7,13 +7,19 @@
 #include <stdint.h>
 /** @endcond */
 
+#define MSGCAT_PLURAL_TABLE   256 /**< Numbers the plural forms are precomputed for. */
+#define MSGCAT_PLURAL_NONE    UINT8_MAX /**< Plural form not in the table. */
+
 typedef struct msgcat {
    const void *map;             /**< .mo file contents, which we'd mmap() but for PhysicsFS. */
    size_t map_size;             /**< .mo file size. */
    const char *plural_rule;     /**< .mo "Plural-Forms" expression (RHS of "plural="), used by ngettext. */
    uint64_t nplurals;           /**< .mo "Plural-Forms" expression (RHS of "nplurals="), used by ngettext. */
+   uint8_t plural_table[MSGCAT_PLURAL_TABLE]; /**< Plural forms of the small numbers, MSGCAT_PLURAL_NONE to evaluate the rule. */
 } msgcat_t;
 
 void msgcat_init( msgcat_t* p, const void* map, size_t map_size );
 const char* msgcat_ngettext( const msgcat_t* p, const char* msgid1, const char* msgid2, uint64_t n );
+const char* msgcat_lookup( const msgcat_t* p, const char* msgid );
+const char* msgcat_plural( const msgcat_t* p, const char* trans, uint64_t n );
 uint32_t msgcat_nstringsFromHeader( const char buf[12] );
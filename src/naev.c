@@ -12,6 +12,7 @@
  * @brief Controls the overall game flow: data loading/unloading and game loop.
  */
 /** @cond */
+#include <stdatomic.h>
 #include "linebreak.h"
 #include "physfsrwops.h"
 #include "SDL.h"
@@ -27,7 +28,9 @@
 /** @endcond */
 
 #include "ai.h"
+#include "arena.h"
 #include "background.h"
+#include "benchmark.h"
 #include "camera.h"
 #include "cond.h"
 #include "conf.h"
@@ -41,16 +44,20 @@
 #include "event.h"
 #include "faction.h"
 #include "font.h"
+#include "frametime.h"
 #include "gui.h"
 #include "hook.h"
 #include "input.h"
 #include "joystick.h"
 #include "land.h"
 #include "load.h"
+#include "loadprof.h"
 #include "log.h"
+#include "luaprof.h"
 #include "map.h"
 #include "map_overlay.h"
 #include "map_system.h"
+#include "memstats.h"
 #include "menu.h"
 #include "mission.h"
 #include "music.h"
@@ -58,6 +65,7 @@
 #include "nebula.h"
 #include "news.h"
 #include "nfile.h"
+#include "nlua_canvas.h"
 #include "nlua_misn.h"
 #include "nlua_var.h"
 #include "nlua_tex.h"
@@ -79,10 +87,13 @@
 #include "physics.h"
 #include "pilot.h"
 #include "player.h"
+#include "player_autonav.h"
 #include "plugin.h"
 #include "render.h"
+#include "replay.h"
 #include "rng.h"
 #include "safelanes.h"
+#include "save.h"
 #include "semver.h"
 #include "ship.h"
 #include "slots.h"
@@ -117,8 +128,14 @@ static double fps_cur   = 0.; /**< FPS accumulator to trigger change. */
 static double fps_x     =  15.; /**< FPS X position. */
 static double fps_y     = -15.; /**< FPS Y position. */
 const double fps_min    = 1./10.; /**< New collisions allow larger fps_min. */
+#define UPDATE_DT          (1./60.) /**< Real time in seconds simulated by each fixed update. */
+#define UPDATE_TIME_MAX    (1./20.) /**< Real time in seconds updates can take per rendered frame before dropping time. */
+static double update_accum    = 0.; /**< Real time not simulated yet, less than UPDATE_DT after updating. */
+static double update_step     = 0.; /**< Game time of the last fixed update, 0 if none ran yet. */
 double elapsed_time_mod = 0.; /**< Elapsed modified time. */
 
+static UpdateTimings *update_timings = NULL; /**< Where to accumulate the update timings, if anywhere. */
+
 static nlua_env load_env = LUA_NOREF; /**< Environment for displaying load messages and stuff. */
 static int load_force_render = 0;
 static unsigned int load_last_render = 0;
@@ -139,6 +156,9 @@ static void fps_init (void);
 static double fps_elapsed (void);
 static void fps_control (void);
 static void update_all( int dohooks );
+static void update_interpBegin (void);
+static void update_interpEnd (void);
+static void update_timingMark( Uint64 *stat, int stage, Uint64 *last );
 /* Misc. */
 static void loadscreen_update( double done, const char *msg );
 void main_loop( int nested ); /* externed in dialogue.c */
@@ -170,6 +190,7 @@ int main( int argc, char** argv )
 {
    char conf_file_path[PATH_MAX], **search_path;
    Uint32 starttime;
+   int prof;
 
 #ifdef DEBUGGING
    /* Set Debugging flags. */
@@ -256,6 +277,7 @@ int main( int argc, char** argv )
 
    conf_loadConfig(conf_file_path); /* Lua to parse the configuration file */
    conf_parseCLI( argc, argv ); /* parse CLI arguments */
+   loadprof_init();
 
    /* Set up I/O. */
    ndata_setupWriteDir();
@@ -271,6 +293,8 @@ int main( int argc, char** argv )
    /* Logging the cache path is noisy, noisy is good at the DEBUG level. */
    DEBUG( _("Cache location: %s"), nfile_cachePath() );
    LOG( _("Write location: %s\n"), PHYSFS_getWriteDir() );
+   luaprof_init();
+   frametime_setEnabled( conf.frametime_show );
 
    /* Enable FPU exceptions. */
    if (conf.fpu_except)
@@ -292,6 +316,7 @@ int main( int argc, char** argv )
    /*
     * OpenGL
     */
+   prof = loadprof_stageBegin( "video" );
    if (gl_init()) { /* initializes video output */
       ERR( _("Initializing video output failed, exiting…") );
       SDL_Quit();
@@ -307,11 +332,13 @@ int main( int argc, char** argv )
 
    /* Detect size changes that occurred after window creation. */
    naev_resize();
+   loadprof_stageEnd( prof );
 
    /* Display the load screen. */
    loadscreen_load();
    loadscreen_update( 0., _("Initializing subsystems…") );
    time_ms = SDL_GetTicks64();
+   prof = loadprof_stageBegin( "subsystems" );
 
    /*
     * Input
@@ -361,9 +388,18 @@ int main( int argc, char** argv )
    map_system_init(); /* Initialise the solar system map */
    cond_init(); /* Initialize conditional subsystem. */
    cli_init(); /* Initialize console. */
+   loadprof_stageEnd( prof );
 
    /* Data loading */
    load_all();
+   loadprof_dump();
+#if DEBUGGING
+   {
+      int envlive, envcreated, envmem;
+      nlua_envStats( &envlive, &envcreated, &envmem );
+      DEBUG( _("Created %d Lua environments (%d alive), Lua is using %d KiB"), envcreated, envlive, envmem );
+   }
+#endif /* DEBUGGING */
 
    /* Detect size changes that occurred during load. */
    naev_resize();
@@ -371,8 +407,19 @@ int main( int argc, char** argv )
    /* Unload load screen. */
    loadscreen_unload();
 
-   /* Start menu. */
-   menu_main();
+   /* Start menu, or just run the benchmark if requested. */
+   if (conf.benchmark_script != NULL) {
+      conf.nosave = 1;
+      benchmark_script( conf.benchmark_script );
+      naev_quit();
+   }
+   else if (conf.benchmark > 0) {
+      conf.nosave = 1;
+      benchmark_run( conf.benchmark );
+      naev_quit();
+   }
+   else
+      menu_main();
 
    if (conf.devmode)
       LOG( _( "Reached main menu in %.3f s" ), (SDL_GetTicks()-starttime)/1000. );
@@ -432,9 +479,17 @@ int main( int argc, char** argv )
             " And again, thank you for playing!"), conf.lastversion );
    }
 
+   /* Start recording or replaying from the main menu. */
+   if (conf.replay != NULL) {
+      conf.nosave = 1;
+      replay_play( conf.replay );
+   }
+   else if (conf.record != NULL)
+      replay_record( conf.record );
+
    /* primary loop */
    while (!quit) {
-      while (!quit && SDL_PollEvent(&event)) { /* event loop */
+      while (!quit && replay_pollEvent(&event)) { /* event loop */
          if (event.type == SDL_QUIT) {
             SDL_FlushEvent( SDL_QUIT ); /* flush event to prevent it from quitting when lagging a bit. */
             if (quit || menu_askQuit()) {
@@ -456,6 +511,14 @@ int main( int argc, char** argv )
    /* Save configuration. */
    conf_saveConfig(conf_file_path);
 
+   if (conf.devmode)
+      memstats_print();
+   frametime_print();
+   replay_stop();
+
+   /* Make sure the last save made it to disk. */
+   save_exit();
+
    /* data unloading */
    unload_all();
 
@@ -482,6 +545,8 @@ int main( int argc, char** argv )
    difficulty_free(); /* Clean up difficulties. */
    music_exit(); /* Kills Lua state. */
    lua_exit(); /* Closes Lua state, and invalidates all Lua. */
+   canvas_exit(); /* Frees the canvases left by the Lua. */
+   luaprof_exit(); /* Writes the Lua profile. */
    sound_exit(); /* Kills the sound */
    gl_exit(); /* Kills video output */
 
@@ -506,9 +571,11 @@ int main( int argc, char** argv )
    log_clean();
 
    /* Really turn the lights off. */
+   ndata_exit();
    PHYSFS_deinit();
    gl_fontExit();
    gettext_exit();
+   arena_exit();
 
    /* all is well */
    debug_enableLeakSanitizer();
@@ -632,71 +699,193 @@ static void loadscreen_unload (void)
 }
 
 /**
- * @brief Loads all the data, makes main() simpler.
+ * @brief Loading tasks, in the order they get run on the main thread.
  */
-#define LOADING_STAGES     17. /**< Amount of loading stages. */
-void load_all (void)
-{
-   NTracingFrameMarkStart( "load_all" );
-
-   int stage = 0;
-   /* We can do fast stuff here. */
-   sp_load();
+enum {
+   LOAD_COMMODITY,
+   LOAD_SPFX,
+   LOAD_EFFECT,
+   LOAD_DTYPE,
+   LOAD_OUTFIT,
+   LOAD_SHIP,
+   LOAD_FACTION,
+   LOAD_OUTFITPOST,
+   LOAD_AI,
+   LOAD_TECH,
+   LOAD_SPACE,
+   LOAD_EVENT,
+   LOAD_MISSION,
+   LOAD_UNIDIFF,
+   LOAD_MAPPARSE,
+   LOAD_SAFELANES,
+   LOAD_MAX,
+};
+#define LOAD_DEP(t)  (1u<<(t)) /**< Dependency bit of a loading task. */
 
-   /* order is very important as they're interdependent */
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Commodities…") );
-   commodity_load(); /* dep for space */
-
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Special Effects…") );
-   spfx_load(); /* no dep */
-
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Effects…") );
-   effect_load(); /* no dep */
+/**
+ * @brief A stage of loading the game data.
+ *
+ * Tasks that are not async touch OpenGL or the Lua state, so they run on the
+ * main thread in the order they are declared. Async tasks only parse data and
+ * run as jobs as soon as their dependencies are done.
+ */
+typedef struct LoadTask_s {
+   const char *msg; /**< Message to display when it starts (NULL to not update). */
+   int (*func)(void); /**< Function that does the loading. */
+   unsigned int deps; /**< Tasks that have to be done before this one. */
+   int async; /**< Whether or not it can run on a worker thread. */
+} LoadTask;
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Damage Types…") );
-   dtype_load(); /* dep for outfits */
+static int load_outfitPost (void) { return outfit_loadPost(); }
+static int load_safelanes (void) { safelanes_init(); return 0; }
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Outfits…") );
-   outfit_load(); /* dep for ships, factions */
+/**
+ * @brief The loading task graph.
+ */
+static const LoadTask load_tasks[LOAD_MAX] = {
+   [LOAD_COMMODITY]  = { N_("Loading Commodities…"), commodity_load, 0, 0 },
+   [LOAD_SPFX]       = { N_("Loading Special Effects…"), spfx_load, 0, 0 },
+   [LOAD_EFFECT]     = { N_("Loading Effects…"), effect_load, 0, 0 },
+   [LOAD_DTYPE]      = { N_("Loading Damage Types…"), dtype_load, 0, 1 },
+   [LOAD_OUTFIT]     = { N_("Loading Outfits…"), outfit_load, LOAD_DEP(LOAD_DTYPE), 0 },
+   [LOAD_SHIP]       = { N_("Loading Ships…"), ships_load, LOAD_DEP(LOAD_OUTFIT), 0 },
+   [LOAD_FACTION]    = { N_("Loading Factions…"), factions_load, LOAD_DEP(LOAD_OUTFIT), 0 },
+   /* Handle outfit loading part that may use ships and factions. */
+   [LOAD_OUTFITPOST] = { NULL, load_outfitPost, LOAD_DEP(LOAD_SHIP) | LOAD_DEP(LOAD_FACTION), 0 },
+   [LOAD_AI]         = { N_("Loading AI…"), ai_load, LOAD_DEP(LOAD_FACTION), 0 },
+   [LOAD_TECH]       = { N_("Loading Techs…"), tech_load, LOAD_DEP(LOAD_OUTFIT) | LOAD_DEP(LOAD_SHIP) | LOAD_DEP(LOAD_COMMODITY), 0 },
+   [LOAD_SPACE]      = { N_("Loading the Universe…"), space_load,
+         LOAD_DEP(LOAD_COMMODITY) | LOAD_DEP(LOAD_SPFX) | LOAD_DEP(LOAD_FACTION) | LOAD_DEP(LOAD_AI) | LOAD_DEP(LOAD_TECH), 0 },
+   [LOAD_EVENT]      = { N_("Loading Events…"), events_load, LOAD_DEP(LOAD_SPACE), 0 },
+   [LOAD_MISSION]    = { N_("Loading Missions…"), missions_load, LOAD_DEP(LOAD_SPACE), 0 },
+   [LOAD_UNIDIFF]    = { N_("Loading the UniDiffs…"), diff_loadAvailable, 0, 1 },
+   [LOAD_MAPPARSE]   = { N_("Populating Maps…"), outfit_mapParse, LOAD_DEP(LOAD_OUTFIT) | LOAD_DEP(LOAD_SPACE), 1 },
+   [LOAD_SAFELANES]  = { N_("Calculating Patrols…"), load_safelanes, LOAD_DEP(LOAD_FACTION) | LOAD_DEP(LOAD_SPACE), 0 },
+};
+static atomic_int load_done; /**< Number of loading tasks that are done. */
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Ships…") );
-   ships_load(); /* dep for fleet */
+/**
+ * @brief Gets the name of a loading task for the load profiler.
+ */
+static const char *load_taskName( const LoadTask *task )
+{
+   static const char *names[LOAD_MAX] = {
+      [LOAD_COMMODITY]  = "commodity",
+      [LOAD_SPFX]       = "spfx",
+      [LOAD_EFFECT]     = "effect",
+      [LOAD_DTYPE]      = "damagetype",
+      [LOAD_OUTFIT]     = "outfit",
+      [LOAD_SHIP]       = "ship",
+      [LOAD_FACTION]    = "faction",
+      [LOAD_OUTFITPOST] = "outfit_post",
+      [LOAD_AI]         = "ai",
+      [LOAD_TECH]       = "tech",
+      [LOAD_SPACE]      = "space",
+      [LOAD_EVENT]      = "event",
+      [LOAD_MISSION]    = "mission",
+      [LOAD_UNIDIFF]    = "unidiff",
+      [LOAD_MAPPARSE]   = "map_parse",
+      [LOAD_SAFELANES]  = "safelanes",
+   };
+   return names[ task - load_tasks ];
+}
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Factions…") );
-   factions_load(); /* dep for fleet, space, missions, AI */
+/**
+ * @brief Runs an async loading task as a job.
+ */
+static int load_taskJob( void *data )
+{
+   const LoadTask *task = data;
+   int prof = loadprof_stageBegin( load_taskName( task ) );
+   task->func();
+   loadprof_stageEnd( prof );
+   atomic_fetch_add( &load_done, 1 );
+   return 0;
+}
 
-   /* Handle outfit loading part that may use ships and factions. */
-   outfit_loadPost();
+/**
+ * @brief Starts the async loading tasks that have their dependencies done.
+ *
+ *    @param done Tasks that are done.
+ *    @param[in,out] started Tasks that have been started.
+ *    @param counters Job counters of the async tasks.
+ */
+static void load_startAsync( unsigned int done, unsigned int *started, JobCounter **counters )
+{
+   for (int i=0; i<LOAD_MAX; i++) {
+      const LoadTask *task = &load_tasks[i];
+      if (!task->async || (*started & LOAD_DEP(i)) || ((task->deps & done) != task->deps))
+         continue;
+      *started |= LOAD_DEP(i);
+      counters[i] = job_counterCreate();
+      job_run( counters[i], load_taskJob, (void*) task );
+   }
+}
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading AI…") );
-   ai_load(); /* dep for fleets */
+/**
+ * @brief Loads all the data, makes main() simpler.
+ *
+ * Goes through the loading task graph, running the main thread tasks in order
+ * while the async ones run in the background. Progress is the fraction of
+ * tasks that are done.
+ */
+void load_all (void)
+{
+   NTracingFrameMarkStart( "load_all" );
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Techs…") );
-   tech_load(); /* dep for space */
+   JobCounter *counters[LOAD_MAX] = { NULL };
+   unsigned int done = 0, started = 0;
+   char summary[STRMAX_SHORT];
+   int prof;
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading the Universe…") );
-   space_load(); /* dep for events/missions */
+   /* We can do fast stuff here. */
+   sp_load();
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Events…") );
-   events_load();
+   atomic_store( &load_done, 0 );
+   load_startAsync( done, &started, counters );
+   for (int i=0; i<LOAD_MAX; i++) {
+      const LoadTask *task = &load_tasks[i];
+      if (task->async)
+         continue;
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading Missions…") );
-   missions_load();
+      /* Wait for async dependencies. */
+      for (int j=0; j<LOAD_MAX; j++) {
+         if (!(task->deps & LOAD_DEP(j)) || (done & LOAD_DEP(j)))
+            continue;
+         if (counters[j] == NULL) {
+            WARN(_("Loading task '%d' depends on task '%d' that has not been started!"), i, j);
+            continue;
+         }
+         job_wait( counters[j] );
+         done |= LOAD_DEP(j);
+      }
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Loading the UniDiffs…") );
-   diff_loadAvailable();
+      if (task->msg != NULL)
+         loadscreen_update( (double)atomic_load( &load_done ) / LOAD_MAX, _(task->msg) );
+      prof = loadprof_stageBegin( load_taskName( task ) );
+      task->func();
+      loadprof_stageEnd( prof );
+      atomic_fetch_add( &load_done, 1 );
+      done |= LOAD_DEP(i);
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Populating Maps…") );
-   outfit_mapParse();
+      /* Now async tasks waiting on this one can start. */
+      load_startAsync( done, &started, counters );
+   }
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Calculating Patrols…") );
-   safelanes_init();
+   /* Wait for everything else to finish. */
+   for (int i=0; i<LOAD_MAX; i++) {
+      if (counters[i] == NULL)
+         continue;
+      job_counterDestroy( counters[i] );
+      done |= LOAD_DEP(i);
+   }
 
-   loadscreen_update( ++stage/LOADING_STAGES, _("Initializing Details…") );
 #if DEBUGGING
-   if (stage > LOADING_STAGES)
-      WARN(_("Too many loading stages, please increase LOADING_STAGES"));
+   if (done != (LOAD_DEP(LOAD_MAX)-1))
+      WARN(_("Not all loading tasks were run, check their dependencies!"));
 #endif /* DEBUGGING */
+   loadscreen_update( 1., _("Initializing Details…") );
+   prof = loadprof_stageBegin( "details" );
    difficulty_load();
    background_init();
    map_load();
@@ -705,7 +894,17 @@ void load_all (void)
    pilots_init();
    weapon_init();
    player_init(); /* Initialize player stuff. */
-   loadscreen_update( 1., _("Loading Completed!") );
+   loadprof_stageEnd( prof );
+
+   /* Show the worst offenders when profiling. */
+   loadprof_summary( summary, sizeof(summary) );
+   if (summary[0] != '\0') {
+      char msg[STRMAX];
+      snprintf( msg, sizeof(msg), _("Loading Completed! Slowest: %s"), summary );
+      loadscreen_update( 1., msg );
+   }
+   else
+      loadscreen_update( 1., _("Loading Completed!") );
 
    NTracingFrameMarkEnd( "load_all" );
 }
@@ -769,8 +968,10 @@ void main_loop( int nested )
    }
 
    /* Safe hook should be run every frame regardless of whether game is paused or not. */
-   if (!nested)
+   if (!nested) {
       hooks_run( "safe" );
+      save_update(); /* Report deferred saves that failed. */
+   }
 
    /* Checks to see if we want to land. */
    space_checkLand();
@@ -782,13 +983,30 @@ void main_loop( int nested )
                    state where things are corrupted when trying to exit the game.
                    Avoid rendering when quitting just in case. */
       /* Clear buffer. */
+      update_interpBegin();
       render_all( game_dt, real_dt );
+      update_interpEnd();
       /* Draw buffer. */
+      Uint64 mark = frametime_mark();
       SDL_GL_SwapWindow( gl_screen.window );
+      frametime_add( FRAME_RENDER_SWAP, &mark );
+
+      /* Use the rest of the frame to collect Lua garbage. */
+      nlua_gcStep( conf.lua_gc_budget );
 
       NTracingFrameMark;
    }
 
+   /* Free the frame temporaries and end the frame of the Lua profiler. Nested
+    * loops run in the middle of an outer frame which may still be using them. */
+   if (!nested) {
+      arena_frameReset();
+      luaprof_frame();
+      frametime_frame( real_dt );
+   }
+
+   memstats_update();
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -808,6 +1026,18 @@ void naev_resize (void)
    if ((w == gl_screen.rw) && (h == gl_screen.rh))
       return;
 
+   naev_resizeForce();
+}
+
+/**
+ * @brief Redoes everything that depends on the screen dimensions, even if the
+ *        window size did not change.
+ *
+ * Used when the scaling changes, which changes the dimensions in game
+ *  coordinates. The textures and fonts don't depend on it and are kept.
+ */
+void naev_resizeForce (void)
+{
    /* Resize the GL context, etc. */
    gl_resize();
 
@@ -916,11 +1146,11 @@ static void fps_control (void)
 #endif /* HAS_POSIX */
 
    /* dt in s */
-   real_dt  = fps_elapsed();
+   real_dt  = replay_frame( fps_elapsed() );
    game_dt  = real_dt * dt_mod; /* Apply the modifier. */
 
-   /* if fps is limited */
-   if (!conf.vsync && conf.fps_max != 0) {
+   /* if fps is limited, replays run as fast as possible */
+   if (!conf.vsync && conf.fps_max != 0 && !replay_isReplaying()) {
       const double fps_max = 1./(double)conf.fps_max;
       if (real_dt < fps_max) {
          double delay = fps_max - real_dt;
@@ -967,7 +1197,14 @@ void fps_display( double dt )
    if (conf.fps_show) {
       gl_print( &gl_defFontMono, x, y, &cFontWhite, "%3.2f", fps );
       y -= gl_defFontMono.h + 5.;
+      gl_print( &gl_defFontMono, x, y, &cFontWhite,
+            n_("%u draw call", "%u draw calls", gl_drawCalls), gl_drawCalls );
+      y -= gl_defFontMono.h + 5.;
    }
+   if (conf.frametime_show)
+      y = frametime_render( x, y );
+   /* Counts a whole frame, starting from here. */
+   gl_drawCalls = 0;
 
    if ((player.p != NULL) && !player_isFlag(PLAYER_DESTROYED) &&
          !player_isFlag(PLAYER_CREATING)) {
@@ -1008,40 +1245,108 @@ static void update_all( int dohooks )
       NTracingZoneEnd( _ctx );
       return;
    }
-   else if (game_dt > fps_min) { /* We'll force a minimum FPS for physics to work alright. */
-      int n;
-      double nf, microdt, accumdt;
-
-      /* Number of frames. */
-      nf = ceil( game_dt / fps_min );
-      microdt = game_dt / nf;
-      n  = (int) nf;
-
-      /* Update as much as needed, evenly. */
-      accumdt = 0.;
-      for (int i=0; i<n; i++) {
-         update_routine( microdt, dohooks );
-         /* OK, so we need a bit of hackish logic here in case we are chopping up a
-          * very large dt and it turns out time compression changes so we're now
-          * updating in "normal time compression" zone. This amounts to many updates
-          * being run when time compression has changed and thus can cause, say, the
-          * player to exceed their target position or get mauled by an enemy ship.
-          */
-         accumdt += microdt;
-         if (accumdt > dt_mod*real_dt)
+
+   /* Autonav may fast forward with coarser steps. */
+   player_autonavFastForwardUpdate();
+
+   /* Run fixed updates for the time that passed, the leftover is carried to
+    * the next frame and rendered by interpolating. Each update simulates the
+    * same real time, with time compression making it longer in game time. */
+   update_accum += real_dt;
+   if (update_accum >= UPDATE_DT) {
+      Uint64 start = SDL_GetPerformanceCounter();
+      Uint64 budget = UPDATE_TIME_MAX * (double)SDL_GetPerformanceFrequency();
+      int done = 0;
+
+      while (update_accum >= UPDATE_DT) {
+         /* Physics needs small enough steps, so long updates are split.
+          * Checked every update as fast forwarding can stop at any time. */
+         double step = player_autonavFastForward() ? AUTONAV_FF_DT : fps_min;
+         double gdt  = UPDATE_DT * dt_mod;
+         int n       = MAX( 1, (int)ceil( gdt / step ) );
+
+         pilots_interpStore();
+         weapons_interpStore();
+         cam_interpStore();
+         for (int i=0; i<n; i++)
+            update_routine( gdt / (double)n, dohooks );
+         update_accum -= UPDATE_DT;
+         update_step   = gdt;
+         done++;
+
+         /* Guard against the spiral of death. When the updates can't keep
+          * up, running more of them every frame would only make the next
+          * frame need even more, so the time that is behind is dropped and
+          * the simulation runs slower than requested. */
+         if (SDL_GetPerformanceCounter() - start > budget) {
+            update_accum = fmod( update_accum, UPDATE_DT );
             break;
+         }
       }
-
-      /* Note we don't touch game_dt so that fps_display works well */
+      NTracingPlotI( "update_steps", done );
    }
-   else /* Standard, just update with the last dt */
-      update_routine( game_dt, dohooks );
 
    fps_skipped = 0;
 
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Moves what is rendered to where it is between the fixed updates.
+ */
+static void update_interpBegin (void)
+{
+   double alpha;
+   if (update_step <= 0.)
+      return;
+   alpha = CLAMP( 0., 1., update_accum / UPDATE_DT );
+   pilots_interpBegin( alpha, update_step );
+   weapons_interpBegin( alpha, update_step );
+   cam_interpBegin( alpha );
+}
+
+/**
+ * @brief Puts what was rendered back to the state of the last fixed update.
+ */
+static void update_interpEnd (void)
+{
+   if (update_step <= 0.)
+      return;
+   pilots_interpEnd();
+   weapons_interpEnd();
+   cam_interpEnd();
+}
+
+/**
+ * @brief Sets where to accumulate the time spent in each update stage.
+ *
+ *    @param timings Timings to add to, or NULL to disable.
+ */
+void update_setTimings( UpdateTimings *timings )
+{
+   update_timings = timings;
+}
+
+/**
+ * @brief Adds the time since the last mark to a stage when timing updates.
+ *
+ *    @param stat Stage to add to, or NULL to just set the mark.
+ *    @param stage Frame stage to add to, or -1 for none.
+ *    @param[in,out] last Last mark.
+ */
+static void update_timingMark( Uint64 *stat, int stage, Uint64 *last )
+{
+   Uint64 now;
+   if ((update_timings == NULL) && !frametime_enabled())
+      return;
+   now = SDL_GetPerformanceCounter();
+   if (stat != NULL)
+      *stat += now - *last;
+   if (stage >= 0)
+      frametime_addTicks( stage, now - *last );
+   *last = now;
+}
+
 /**
  * @brief Actually runs the updates
  *
@@ -1051,6 +1356,9 @@ static void update_all( int dohooks )
 void update_routine( double dt, int dohooks )
 {
    double real_update = dt / dt_mod;
+   UpdateTimings utdummy;
+   UpdateTimings *ut = (update_timings != NULL) ? update_timings : &utdummy;
+   Uint64 mark = 0;
 
    if (dohooks) {
       hook_exclusionStart();
@@ -1060,18 +1368,27 @@ void update_routine( double dt, int dohooks )
    }
 
    /* Clean up dead elements and build quadtrees. */
+   update_timingMark( NULL, -1, &mark );
    pilots_updatePurge();
    weapons_updatePurge();
+   update_timingMark( &ut->purge, FRAME_UPDATE_PURGE, &mark );
 
    /* Core stuff independent of collisions. */
    space_update( dt, real_update );
-   spfx_update( dt, real_update );
+   update_timingMark( &ut->space, FRAME_UPDATE_SPACE, &mark );
+   if (!space_isSimulationWarmup())
+      spfx_update( dt, real_update );
+   update_timingMark( &ut->spfx, FRAME_UPDATE_SPFX, &mark );
 
    if (dt > 0.) {
-      /* First compute weapon collisions. */
-      weapons_updateCollide( dt );
+      /* First compute weapon collisions, there are none in the warm-up. */
+      if (!space_isSimulationWarmup())
+         weapons_updateCollide( dt );
+      update_timingMark( &ut->collide, FRAME_UPDATE_WEAPONS, &mark );
       pilots_update( dt );
+      update_timingMark( &ut->pilots, FRAME_UPDATE_PILOTS, &mark );
       weapons_update( dt ); /* Has weapons think and update positions. */
+      update_timingMark( &ut->weapons, FRAME_UPDATE_WEAPONS, &mark );
 
       /* Update camera. */
       cam_update( dt );
@@ -1085,6 +1402,7 @@ void update_routine( double dt, int dohooks )
 
    if (dohooks) {
       HookParam h[3];
+      update_timingMark( NULL, -1, &mark );
       hook_exclusionEnd( dt );
       /* Hook set up. */
       h[0].type = HOOK_PARAM_NUMBER;
@@ -1094,6 +1412,7 @@ void update_routine( double dt, int dohooks )
       h[2].type = HOOK_PARAM_SENTINEL;
       /* Run the update hook. */
       hooks_runParam( "update", h );
+      update_timingMark( NULL, FRAME_UPDATE_HOOKS, &mark );
    }
 }
 
@@ -65,6 +65,18 @@
 #  define M_SQRT2       1.41421356237309504880
 #endif
 
+/**
+ * @brief Time spent in the stages of update_routine, in performance counter ticks.
+ */
+typedef struct UpdateTimings_ {
+   Uint64 purge;     /**< Purging dead elements and building the spatial indices. */
+   Uint64 space;     /**< space_update. */
+   Uint64 spfx;      /**< spfx_update. */
+   Uint64 collide;   /**< weapons_updateCollide. */
+   Uint64 pilots;    /**< pilots_update. */
+   Uint64 weapons;   /**< weapons_update. */
+} UpdateTimings;
+
 /*
  * Misc stuff.
  */
@@ -75,8 +87,10 @@ void fps_setPos( double x, double y );
 void fps_display( double dt );
 double fps_current (void);
 void naev_resize (void);
+void naev_resizeForce (void);
 void naev_toggleFullscreen (void);
 void update_routine( double dt, int dohooks );
+void update_setTimings( UpdateTimings *timings );
 const char *naev_version( int long_version );
 int naev_versionCompare( const char *version );
 void naev_quit (void);
@@ -0,0 +1,294 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file nameindex.c
+ *
+ * @brief Hash tables to look up data by name in constant time.
+ *
+ * Used to replace the linear and binary searches over the data stacks. The
+ *  tables use open addressing with linear probing, and are kept at most half
+ *  full. When a name is added more than once, the first index is kept, like
+ *  a linear search would find.
+ *
+ * Lookups can be recorded so the benchmark can replay them.
+ */
+/** @cond */
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "nameindex.h"
+
+#include "array.h"
+#include "nstring.h"
+
+#define NAMEINDEX_TRACE_MAX   (1<<20) /**< Most lookups recorded by a trace. */
+
+/*
+ * Prototypes.
+ */
+static uint32_t nameindex_hash( const char *name, int nocase );
+static const NameIndexSlot *nameindex_find( const NameIndex *ni, const char *name );
+static void nameindex_grow( NameIndex *ni, uint32_t size );
+static void nameindex_traceAdd( const NameIndex *ni, const char *name );
+
+static SDL_atomic_t nameindex_tracing; /**< Whether or not lookups are being recorded. */
+static SDL_SpinLock nameindex_traceLock = 0; /**< Lookups can happen from worker threads. */
+static NameIndexTrace *nameindex_trace = NULL; /**< Recorded lookups. */
+
+/**
+ * @brief Hashes a name (FNV-1a).
+ */
+static uint32_t nameindex_hash( const char *name, int nocase )
+{
+   uint32_t h = 2166136261u;
+   for (const unsigned char *c=(const unsigned char*)name; *c!='\0'; c++) {
+      h ^= nocase ? (uint32_t)tolower(*c) : (uint32_t)*c;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+/**
+ * @brief Initializes an empty name index.
+ *
+ *    @param ni Index to initialize.
+ *    @param nocase Whether or not lookups should be case insensitive.
+ */
+void nameindex_init( NameIndex *ni, int nocase )
+{
+   memset( ni, 0, sizeof(NameIndex) );
+   ni->nocase = nocase;
+}
+
+/**
+ * @brief Frees a name index, leaving it empty.
+ */
+void nameindex_free( NameIndex *ni )
+{
+   free( ni->slots );
+   ni->slots = NULL;
+   ni->size  = 0;
+   ni->n     = 0;
+}
+
+/**
+ * @brief Removes all the names of an index, keeping the memory.
+ */
+void nameindex_clear( NameIndex *ni )
+{
+   if (ni->slots != NULL)
+      memset( ni->slots, 0, sizeof(NameIndexSlot) * ni->size );
+   ni->n = 0;
+}
+
+/**
+ * @brief Rehashes the index to a new number of slots.
+ */
+static void nameindex_grow( NameIndex *ni, uint32_t size )
+{
+   NameIndexSlot *old = ni->slots;
+   uint32_t oldsize = ni->size;
+
+   ni->slots = calloc( size, sizeof(NameIndexSlot) );
+   ni->size  = size;
+   for (uint32_t i=0; i<oldsize; i++) {
+      uint32_t j;
+      if (old[i].name == NULL)
+         continue;
+      for (j=old[i].hash & (size-1); ni->slots[j].name!=NULL; j=(j+1) & (size-1));
+      ni->slots[j] = old[i];
+   }
+   free( old );
+}
+
+/**
+ * @brief Makes sure an index can hold a number of names without rehashing.
+ *
+ *    @param ni Index to reserve space in.
+ *    @param n Number of names it will hold.
+ */
+void nameindex_reserve( NameIndex *ni, int n )
+{
+   uint32_t size = MAX( ni->size, 16 );
+   while (size < 2u*(uint32_t)n)
+      size *= 2;
+   if (size != ni->size)
+      nameindex_grow( ni, size );
+}
+
+/**
+ * @brief Adds a name to an index.
+ *
+ *    @param ni Index to add to.
+ *    @param name Name to add, must outlive the index.
+ *    @param id Index to associate to the name.
+ */
+void nameindex_add( NameIndex *ni, const char *name, int id )
+{
+   uint32_t h, j;
+
+   if (name == NULL)
+      return;
+   nameindex_reserve( ni, ni->n+1 );
+
+   h = nameindex_hash( name, ni->nocase );
+   for (j=h & (ni->size-1); ni->slots[j].name!=NULL; j=(j+1) & (ni->size-1)) {
+      if (ni->slots[j].hash != h)
+         continue;
+      /* Keep the first one. */
+      if (ni->nocase ? (strcasecmp( ni->slots[j].name, name )==0) : (strcmp( ni->slots[j].name, name )==0))
+         return;
+   }
+   ni->slots[j].name = name;
+   ni->slots[j].hash = h;
+   ni->slots[j].id   = id;
+   ni->n++;
+}
+
+/**
+ * @brief Finds the slot of a name.
+ */
+static const NameIndexSlot *nameindex_find( const NameIndex *ni, const char *name )
+{
+   uint32_t h;
+
+   if ((name == NULL) || (ni->n == 0))
+      return NULL;
+   if (SDL_AtomicGet( &nameindex_tracing ))
+      nameindex_traceAdd( ni, name );
+
+   h = nameindex_hash( name, ni->nocase );
+   for (uint32_t j=h & (ni->size-1); ni->slots[j].name!=NULL; j=(j+1) & (ni->size-1)) {
+      const NameIndexSlot *s = &ni->slots[j];
+      if (s->hash != h)
+         continue;
+      if (ni->nocase ? (strcasecmp( s->name, name )==0) : (strcmp( s->name, name )==0))
+         return s;
+   }
+   return NULL;
+}
+
+/**
+ * @brief Looks up a name in an index.
+ *
+ *    @param ni Index to look up in.
+ *    @param name Name to look up.
+ *    @return Index associated to the name, or -1 if not found.
+ */
+int nameindex_get( const NameIndex *ni, const char *name )
+{
+   const NameIndexSlot *s = nameindex_find( ni, name );
+   return (s==NULL) ? -1 : s->id;
+}
+
+/**
+ * @brief Looks up a name in an index, getting the name as it was added.
+ *
+ * Mainly useful for case insensitive indices.
+ *
+ *    @param ni Index to look up in.
+ *    @param name Name to look up.
+ *    @return Name as it was added, or NULL if not found.
+ */
+const char *nameindex_getName( const NameIndex *ni, const char *name )
+{
+   const NameIndexSlot *s = nameindex_find( ni, name );
+   return (s==NULL) ? NULL : s->name;
+}
+
+/**
+ * @brief Records a lookup.
+ */
+static void nameindex_traceAdd( const NameIndex *ni, const char *name )
+{
+   NameIndexTrace *t;
+   int k;
+
+   SDL_AtomicLock( &nameindex_traceLock );
+   t = nameindex_trace;
+   if ((t == NULL) || (array_size(t->names) >= NAMEINDEX_TRACE_MAX)) {
+      SDL_AtomicUnlock( &nameindex_traceLock );
+      return;
+   }
+
+   /* Copy the index the first time, it is up to date while being looked up. */
+   for (k=0; k<array_size(t->sources); k++)
+      if (t->sources[k] == ni)
+         break;
+   if (k >= array_size(t->sources)) {
+      NameIndex *c = &array_grow( &t->indices );
+      *c = *ni;
+      c->slots = calloc( ni->size, sizeof(NameIndexSlot) );
+      for (uint32_t i=0; i<ni->size; i++) {
+         c->slots[i] = ni->slots[i];
+         if (ni->slots[i].name != NULL)
+            c->slots[i].name = strdup( ni->slots[i].name );
+      }
+      array_push_back( &t->sources, ni );
+   }
+
+   array_push_back( &t->lookups, k );
+   array_push_back( &t->names, strdup( name ) );
+   SDL_AtomicUnlock( &nameindex_traceLock );
+}
+
+/**
+ * @brief Starts recording the lookups of all the indices.
+ */
+void nameindex_traceStart (void)
+{
+   SDL_AtomicLock( &nameindex_traceLock );
+   if (nameindex_trace == NULL) {
+      NameIndexTrace *t = calloc( 1, sizeof(NameIndexTrace) );
+      t->indices  = array_create( NameIndex );
+      t->sources  = array_create( const NameIndex* );
+      t->lookups  = array_create( int );
+      t->names    = array_create( char* );
+      nameindex_trace = t;
+   }
+   SDL_AtomicUnlock( &nameindex_traceLock );
+   SDL_AtomicSet( &nameindex_tracing, 1 );
+}
+
+/**
+ * @brief Stops recording lookups.
+ *
+ *    @return The recorded lookups, to free with nameindex_traceFree.
+ */
+NameIndexTrace *nameindex_traceStop (void)
+{
+   NameIndexTrace *trace;
+   SDL_AtomicSet( &nameindex_tracing, 0 );
+   SDL_AtomicLock( &nameindex_traceLock );
+   trace = nameindex_trace;
+   nameindex_trace = NULL;
+   SDL_AtomicUnlock( &nameindex_traceLock );
+   return trace;
+}
+
+/**
+ * @brief Frees a trace.
+ */
+void nameindex_traceFree( NameIndexTrace *trace )
+{
+   if (trace == NULL)
+      return;
+   for (int i=0; i<array_size(trace->indices); i++) {
+      NameIndex *ni = &trace->indices[i];
+      for (uint32_t j=0; j<ni->size; j++)
+         free( (char*)ni->slots[j].name );
+      nameindex_free( ni );
+   }
+   array_free( trace->indices );
+   array_free( trace->sources );
+   array_free( trace->lookups );
+   for (int i=0; i<array_size(trace->names); i++)
+      free( trace->names[i] );
+   array_free( trace->names );
+   free( trace );
+}
@@ -0,0 +1,56 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stdint.h>
+/** @endcond */
+
+/**
+ * @brief Slot of a name index.
+ */
+typedef struct NameIndexSlot_ {
+   const char *name; /**< Name, not owned, NULL if the slot is empty. */
+   uint32_t hash;    /**< Hash of the name. */
+   int id;           /**< Index associated to the name. */
+} NameIndexSlot;
+
+/**
+ * @brief Hash table mapping names to indices.
+ *
+ * Names are not copied, so the index has to be cleared or rebuilt when the
+ *  names it points to are freed or changed.
+ */
+typedef struct NameIndex_ {
+   NameIndexSlot *slots;  /**< Open addressed slots. */
+   uint32_t size;         /**< Number of slots, a power of two or 0. */
+   int n;                 /**< Number of names in the index. */
+   int nocase;            /**< Whether or not names are case insensitive. */
+} NameIndex;
+
+/**
+ * @brief Lookups recorded while tracing, for benchmarking.
+ *
+ * The indices are copied when first looked up, so the trace stays valid
+ *  when the data they index changes.
+ */
+typedef struct NameIndexTrace_ {
+   NameIndex *indices;        /**< Copies of the indices looked up, owning their names (array.h). */
+   const NameIndex **sources; /**< Indices the copies were made from (array.h). */
+   int *lookups;              /**< Copy looked up by each lookup (array.h). */
+   char **names;              /**< Name looked up by each lookup (array.h). */
+} NameIndexTrace;
+
+void nameindex_init( NameIndex *ni, int nocase );
+void nameindex_free( NameIndex *ni );
+void nameindex_clear( NameIndex *ni );
+void nameindex_reserve( NameIndex *ni, int n );
+void nameindex_add( NameIndex *ni, const char *name, int id );
+int nameindex_get( const NameIndex *ni, const char *name );
+const char *nameindex_getName( const NameIndex *ni, const char *name );
+
+/* Tracing. */
+void nameindex_traceStart (void);
+NameIndexTrace *nameindex_traceStop (void);
+void nameindex_traceFree( NameIndexTrace *trace );
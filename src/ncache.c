@@ -0,0 +1,314 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file ncache.c
+ *
+ * @brief Versioned binary caches of data parsed from ndata.
+ *
+ * A cache is identified by a name and a key. The key is a hash of the game
+ *  version and of the path, size and modification time of every ndata file
+ *  that feeds the cached data, so any change to those files invalidates it.
+ *  Callers must treat any failure as a cache miss and parse the data
+ *  normally.
+ */
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+#include "physfs.h"
+
+#include "naev.h"
+
+#if HAS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* HAS_POSIX */
+/** @endcond */
+
+#include "ncache.h"
+
+#include "array.h"
+#include "log.h"
+#include "nfile.h"
+#include "nstring.h"
+
+#define NCACHE_MAGIC    "NCACHE\0\0" /**< Magic at the start of cache files. */
+#define NCACHE_DIR      "ndata/"     /**< Subdirectory of the cache path. */
+#define NCACHE_NULLSTR  UINT32_MAX   /**< Length used to store NULL strings. */
+
+/**
+ * @brief Header of a cache file.
+ */
+typedef struct NCacheHeader_ {
+   char magic[8];       /**< NCACHE_MAGIC. */
+   uint32_t version;    /**< NCACHE_VERSION. */
+   uint32_t flags;      /**< Unused, always 0. */
+   md5_byte_t key[16];  /**< Key the data was generated with. */
+   uint64_t size;       /**< Size of the payload. */
+} NCacheHeader;
+
+/*
+ * Prototypes.
+ */
+static void ncache_path( char *path, size_t len, const char *name );
+static const void *ncache_read( NCache *nc, size_t len );
+static void ncache_write( NCacheWriter *w, const void *data, size_t len );
+
+/**
+ * @brief Gets the path of a cache file.
+ */
+static void ncache_path( char *path, size_t len, const char *name )
+{
+   snprintf( path, len, "%s"NCACHE_DIR"%s", nfile_cachePath(), name );
+}
+
+/**
+ * @brief Computes the key of a cache from the files it depends on.
+ *
+ *    @param[out] key Key of the cache.
+ *    @param name Name of the cache.
+ *    @param files Array (array.h) of ndata paths the cached data depends on.
+ */
+void ncache_key( md5_byte_t key[16], const char *name, char *const *files )
+{
+   md5_state_t md5;
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t*)name, strlen(name)+1 );
+   md5_append( &md5, (const md5_byte_t*)naev_version(1), strlen(naev_version(1))+1 );
+   for (int i=0; i<array_size(files); i++) {
+      PHYSFS_Stat stat;
+      int64_t info[2] = { -1, -1 };
+      if (PHYSFS_stat( files[i], &stat )) {
+         info[0] = stat.filesize;
+         info[1] = stat.modtime;
+      }
+      md5_append( &md5, (const md5_byte_t*)files[i], strlen(files[i])+1 );
+      md5_append( &md5, (const md5_byte_t*)info, sizeof(info) );
+   }
+   md5_finish( &md5, key );
+}
+
+/**
+ * @brief Opens a cache for reading.
+ *
+ *    @param[out] nc Cache to open.
+ *    @param name Name of the cache.
+ *    @param key Key the cache has to match.
+ *    @return 0 if the cache was opened, nonzero if it has to be regenerated.
+ */
+int ncache_open( NCache *nc, const char *name, const md5_byte_t key[16] )
+{
+   char path[PATH_MAX];
+   const NCacheHeader *hdr;
+
+   memset( nc, 0, sizeof(NCache) );
+   ncache_path( path, sizeof(path), name );
+
+#if HAS_POSIX
+   struct stat st;
+   int fd = open( path, O_RDONLY );
+   if (fd < 0)
+      return -1;
+   if ((fstat( fd, &st ) != 0) || (st.st_size < (off_t)sizeof(NCacheHeader))) {
+      close( fd );
+      return -1;
+   }
+   nc->mapsize = st.st_size;
+   nc->map     = mmap( NULL, nc->mapsize, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+   if (nc->map == MAP_FAILED) {
+      nc->map = NULL;
+      return -1;
+   }
+   nc->mapped  = 1;
+#else /* HAS_POSIX */
+   if (!nfile_fileExists( path ))
+      return -1;
+   nc->map = nfile_readFile( &nc->mapsize, path );
+   if (nc->map == NULL)
+      return -1;
+#endif /* HAS_POSIX */
+
+   /* Validate the header. */
+   hdr = nc->map;
+   if ((nc->mapsize < sizeof(NCacheHeader)) ||
+         (memcmp( hdr->magic, NCACHE_MAGIC, sizeof(hdr->magic) ) != 0) ||
+         (hdr->version != NCACHE_VERSION) ||
+         (memcmp( hdr->key, key, sizeof(hdr->key) ) != 0) ||
+         (hdr->size != nc->mapsize - sizeof(NCacheHeader))) {
+      ncache_close( nc );
+      return -1;
+   }
+
+   nc->data = (const char*)nc->map + sizeof(NCacheHeader);
+   nc->size = hdr->size;
+   return 0;
+}
+
+/**
+ * @brief Closes a cache opened with ncache_open.
+ */
+void ncache_close( NCache *nc )
+{
+#if HAS_POSIX
+   if (nc->mapped && (nc->map != NULL))
+      munmap( nc->map, nc->mapsize );
+   else
+#endif /* HAS_POSIX */
+      free( nc->map );
+   memset( nc, 0, sizeof(NCache) );
+}
+
+/**
+ * @brief Reads raw data from a cache, setting the error flag on overrun.
+ */
+static const void *ncache_read( NCache *nc, size_t len )
+{
+   const void *ptr;
+   if (nc->err || (len > nc->size - nc->pos)) {
+      nc->err = 1;
+      return NULL;
+   }
+   ptr = &nc->data[ nc->pos ];
+   nc->pos += len;
+   return ptr;
+}
+
+/**
+ * @brief Reads an unsigned integer from a cache.
+ */
+uint32_t ncache_readU32( NCache *nc )
+{
+   uint32_t val = 0;
+   const void *ptr = ncache_read( nc, sizeof(val) );
+   if (ptr != NULL)
+      memcpy( &val, ptr, sizeof(val) );
+   return val;
+}
+
+/**
+ * @brief Reads a double from a cache.
+ */
+double ncache_readDouble( NCache *nc )
+{
+   double val = 0.;
+   const void *ptr = ncache_read( nc, sizeof(val) );
+   if (ptr != NULL)
+      memcpy( &val, ptr, sizeof(val) );
+   return val;
+}
+
+/**
+ * @brief Reads a string from a cache.
+ *
+ *    @return Newly allocated string or NULL if it was stored as NULL or on error.
+ */
+char *ncache_readStr( NCache *nc )
+{
+   const char *ptr;
+   uint32_t len = ncache_readU32( nc );
+   if (nc->err || (len == NCACHE_NULLSTR))
+      return NULL;
+   ptr = ncache_read( nc, len );
+   if (ptr == NULL)
+      return NULL;
+   return strndup( ptr, len );
+}
+
+/**
+ * @brief Starts writing a cache.
+ */
+void ncache_writeBegin( NCacheWriter *w )
+{
+   w->buf = array_create( char );
+}
+
+/**
+ * @brief Appends raw data to a cache being written.
+ */
+static void ncache_write( NCacheWriter *w, const void *data, size_t len )
+{
+   int n = array_size( w->buf );
+   array_resize( &w->buf, n+len );
+   memcpy( &w->buf[n], data, len );
+}
+
+/**
+ * @brief Writes an unsigned integer to a cache.
+ */
+void ncache_writeU32( NCacheWriter *w, uint32_t val )
+{
+   ncache_write( w, &val, sizeof(val) );
+}
+
+/**
+ * @brief Writes a double to a cache.
+ */
+void ncache_writeDouble( NCacheWriter *w, double val )
+{
+   ncache_write( w, &val, sizeof(val) );
+}
+
+/**
+ * @brief Writes a string (which may be NULL) to a cache.
+ */
+void ncache_writeStr( NCacheWriter *w, const char *str )
+{
+   if (str == NULL) {
+      ncache_writeU32( w, NCACHE_NULLSTR );
+      return;
+   }
+   uint32_t len = strlen( str );
+   ncache_writeU32( w, len );
+   ncache_write( w, str, len );
+}
+
+/**
+ * @brief Writes raw data to a cache.
+ */
+void ncache_writeData( NCacheWriter *w, const void *data, size_t len )
+{
+   ncache_write( w, data, len );
+}
+
+/**
+ * @brief Finishes writing a cache and saves it to disk.
+ *
+ *    @param w Cache being written, its buffer is freed.
+ *    @param name Name of the cache.
+ *    @param key Key of the cached data.
+ *    @return 0 on success.
+ */
+int ncache_writeEnd( NCacheWriter *w, const char *name, const md5_byte_t key[16] )
+{
+   char path[PATH_MAX];
+   NCacheHeader hdr;
+   char *data;
+   size_t len;
+   int ret;
+
+   memset( &hdr, 0, sizeof(hdr) );
+   memcpy( hdr.magic, NCACHE_MAGIC, sizeof(hdr.magic) );
+   hdr.version = NCACHE_VERSION;
+   memcpy( hdr.key, key, sizeof(hdr.key) );
+   hdr.size    = array_size( w->buf );
+
+   len  = sizeof(hdr) + hdr.size;
+   data = malloc( len );
+   memcpy( data, &hdr, sizeof(hdr) );
+   if (hdr.size > 0)
+      memcpy( &data[sizeof(hdr)], w->buf, hdr.size );
+   array_free( w->buf );
+   w->buf = NULL;
+
+   snprintf( path, sizeof(path), "%s"NCACHE_DIR, nfile_cachePath() );
+   nfile_dirMakeExist( path );
+   ncache_path( path, sizeof(path), name );
+   ret = nfile_writeFile( data, len, path );
+   if (ret)
+      WARN(_("Unable to write data cache '%s'."), path );
+   free( data );
+   return ret;
+}
@@ -0,0 +1,51 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+#include <stdint.h>
+/** @endcond */
+
+#include "md5.h"
+
+#define NCACHE_VERSION  1 /**< Version of the cache file layout, bump on change. */
+
+/**
+ * @brief Opened binary data cache being read.
+ */
+typedef struct NCache_ {
+   const char *data; /**< Payload data (after the header). */
+   size_t size;      /**< Size of the payload. */
+   size_t pos;       /**< Current read position in the payload. */
+   int err;          /**< Set when a read went past the end of the payload. */
+   void *map;        /**< Mapped or allocated file data. */
+   size_t mapsize;   /**< Size of the mapped or allocated file data. */
+   int mapped;       /**< Whether or not map was obtained with mmap. */
+} NCache;
+
+/**
+ * @brief Binary data cache being written.
+ */
+typedef struct NCacheWriter_ {
+   char *buf;        /**< Payload buffer (array.h). */
+} NCacheWriter;
+
+/* Keys. */
+void ncache_key( md5_byte_t key[16], const char *name, char *const *files );
+
+/* Reading. */
+int ncache_open( NCache *nc, const char *name, const md5_byte_t key[16] );
+void ncache_close( NCache *nc );
+uint32_t ncache_readU32( NCache *nc );
+double ncache_readDouble( NCache *nc );
+char *ncache_readStr( NCache *nc );
+
+/* Writing. */
+void ncache_writeBegin( NCacheWriter *w );
+void ncache_writeU32( NCacheWriter *w, uint32_t val );
+void ncache_writeDouble( NCacheWriter *w, double val );
+void ncache_writeStr( NCacheWriter *w, const char *str );
+void ncache_writeData( NCacheWriter *w, const void *data, size_t len );
+int ncache_writeEnd( NCacheWriter *w, const char *name, const md5_byte_t key[16] );
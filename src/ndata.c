@@ -20,6 +20,13 @@
 #include "SDL.h"
 
 #include "naev.h"
+
+#if HAS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* HAS_POSIX */
 /** @endcond */
 
 #include "ndata.h"
@@ -30,17 +37,43 @@
 #if __MACOSX__
 #include "glue_macos.h"
 #endif /* __MACOSX__ */
+#include "loadprof.h"
 #include "log.h"
+#include "nameindex.h"
 #include "nfile.h"
 #include "nstring.h"
 #include "plugin.h"
+#include "threadpool.h"
+
+#define NDATA_STREAM_CHUNK   (64*1024) /**< Size of the chunks of streamed files. */
+
+/**
+ * @brief Path of the read path index.
+ */
+typedef struct NDataIndexEntry_ {
+   char *path;          /**< Path of the file or directory. */
+   const char *realdir; /**< Directory or archive it resolves to, owned by PhysicsFS. */
+   int writedir;        /**< Whether it resolves to the write directory, which can change. */
+} NDataIndexEntry;
+static NDataIndexEntry *ndata_index = NULL; /**< Index of everything in the read path (array.h). */
+static NameIndex ndata_indexNames;           /**< Lookup of ndata_index by path. */
+static const char **ndata_indexFiles = NULL; /**< Sorted paths of the regular files of ndata_index (array.h). */
+static JobCounter *ndata_indexJob = NULL;    /**< Job building the index. */
+static SDL_atomic_t ndata_indexReady;        /**< Whether or not the index can be used. */
 
 /*
  * Prototypes.
  */
+#if HAS_POSIX
+static int ndata_mapReal( NDataMap *map, const char *path );
+#endif /* HAS_POSIX */
 static void ndata_testVersion (void);
 static int ndata_found (void);
 static int ndata_enumerateCallback( void* data, const char* origdir, const char* fname );
+static int ndata_indexCallback( void* data, const char* origdir, const char* fname );
+static int ndata_indexBuild( void *data );
+static const NDataIndexEntry *ndata_indexGet( const char *path );
+static int ndata_indexWait (void);
 
 /**
  * @brief Checks to see if the physfs search path is enough to find game data.
@@ -142,6 +175,140 @@ void ndata_setupReadDirs (void)
    plugin_init();
 
    ndata_testVersion();
+
+   /* The search path is final, index it while the game loads. */
+   ndata_indexJob = job_counterCreate();
+   job_runBackground( ndata_indexJob, ndata_indexBuild, NULL );
+}
+
+/**
+ * @brief Adds the paths of a directory of the read path to the index.
+ */
+static int ndata_indexCallback( void* data, const char* origdir, const char* fname )
+{
+   (void) data;
+   char *path;
+   const char *realdir, *writedir;
+   PHYSFS_Stat stat;
+   NDataIndexEntry *e;
+
+   if (origdir[0] == '\0')
+      path = strdup( fname );
+   else
+      SDL_asprintf( &path, "%s/%s", origdir, fname );
+
+   /* Directories are listed once per archive having them. */
+   if (nameindex_get( &ndata_indexNames, path ) >= 0) {
+      free( path );
+      return PHYSFS_ENUM_OK;
+   }
+   realdir = PHYSFS_getRealDir( path );
+   if ((realdir == NULL) || !PHYSFS_stat( path, &stat )) {
+      free( path );
+      return PHYSFS_ENUM_OK;
+   }
+
+   writedir = PHYSFS_getWriteDir();
+   e = &array_grow( &ndata_index );
+   e->path     = path;
+   e->realdir  = realdir;
+   e->writedir = (writedir != NULL) && (strcmp( realdir, writedir ) == 0);
+   nameindex_add( &ndata_indexNames, path, array_size(ndata_index)-1 );
+
+   if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+      PHYSFS_enumerate( path, ndata_indexCallback, NULL );
+   else if (stat.filetype == PHYSFS_FILETYPE_REGULAR)
+      array_push_back( &ndata_indexFiles, (const char*)path );
+   return PHYSFS_ENUM_OK;
+}
+
+/**
+ * @brief Builds the index of the read path, to be run as a job.
+ *
+ * Paths are resolved like PhysicsFS does, so the first source in the search
+ *  path (including the blacklist) wins.
+ */
+static int ndata_indexBuild( void *data )
+{
+   (void) data;
+   ndata_index = array_create_size( NDataIndexEntry, 4096 );
+   ndata_indexFiles = array_create_size( const char*, 4096 );
+   nameindex_init( &ndata_indexNames, 0 );
+   PHYSFS_enumerate( "", ndata_indexCallback, NULL );
+   /* Sorted for listing directories. */
+   qsort( ndata_indexFiles, array_size(ndata_indexFiles), sizeof(char*), strsort );
+   SDL_AtomicSet( &ndata_indexReady, 1 );
+   return 0;
+}
+
+/**
+ * @brief Looks up a path in the read path index.
+ *
+ *    @return The entry of the path, or NULL if it is not indexed.
+ */
+static const NDataIndexEntry *ndata_indexGet( const char *path )
+{
+   int id = nameindex_get( &ndata_indexNames, path );
+   return (id < 0) ? NULL : &ndata_index[id];
+}
+
+/**
+ * @brief Waits for the read path index to be built.
+ *
+ *    @return 1 if the index can be used, 0 otherwise.
+ */
+static int ndata_indexWait (void)
+{
+   if (ndata_indexJob != NULL) {
+      job_wait( ndata_indexJob );
+      job_counterDestroy( ndata_indexJob );
+      ndata_indexJob = NULL;
+   }
+   return SDL_AtomicGet( &ndata_indexReady );
+}
+
+/**
+ * @brief Checks to see if a path exists in the read path.
+ *
+ * Same as PHYSFS_exists, but looks up the index of the read path when it is
+ *  ready instead of going through every mounted archive.
+ *
+ *    @param path Path to check.
+ *    @return 1 if it exists, 0 otherwise.
+ */
+int ndata_exists( const char *path )
+{
+   char buf[PATH_MAX];
+   const NDataIndexEntry *e;
+
+   /* Unusual paths are left to PhysicsFS. */
+   if (!SDL_AtomicGet( &ndata_indexReady ) || (path[0] == '/') || (strstr( path, "//" ) != NULL))
+      return PHYSFS_exists( path );
+
+   e = ndata_indexGet( path );
+   if (e != NULL)
+      return e->writedir ? PHYSFS_exists( path ) : 1;
+
+   /* Only the write directory can get new files. */
+   if (nfile_concatPaths( buf, sizeof(buf), PHYSFS_getWriteDir(), path ) < 0)
+      return PHYSFS_exists( path );
+   return nfile_fileExists( buf ) || nfile_dirExists( buf );
+}
+
+/**
+ * @brief Frees the read path index.
+ */
+void ndata_exit (void)
+{
+   ndata_indexWait();
+   SDL_AtomicSet( &ndata_indexReady, 0 );
+   array_free( ndata_indexFiles );
+   ndata_indexFiles = NULL;
+   for (int i=0; i<array_size(ndata_index); i++)
+      free( ndata_index[i].path );
+   array_free( ndata_index );
+   ndata_index = NULL;
+   nameindex_free( &ndata_indexNames );
 }
 
 /**
@@ -216,11 +383,166 @@ void* ndata_read( const char* path, size_t *filesize )
 
    /* Close the file. */
    PHYSFS_close(file);
+   loadprof_bytes( len );
 
    *filesize = len;
    return buf;
 }
 
+#if HAS_POSIX
+/**
+ * @brief Memory maps a file if it comes from a plain directory mounted at the root.
+ *
+ *    @return 0 on success.
+ */
+static int ndata_mapReal( NDataMap *map, const char *path )
+{
+   char realpath[PATH_MAX];
+   const char *realdir, *mountpoint;
+   struct stat st;
+   void *data;
+   int fd;
+
+   /* Resolving through the index avoids going through the archives. */
+   if (SDL_AtomicGet( &ndata_indexReady )) {
+      const NDataIndexEntry *e = ndata_indexGet( path );
+      realdir = ((e != NULL) && !e->writedir) ? e->realdir : PHYSFS_getRealDir( path );
+   }
+   else
+      realdir = PHYSFS_getRealDir( path );
+   if (realdir == NULL)
+      return -1;
+   mountpoint = PHYSFS_getMountPoint( realdir );
+   if ((mountpoint == NULL) || (strcmp( mountpoint, "/" ) != 0))
+      return -1;
+   /* Archives can't be mapped. */
+   if ((stat( realdir, &st ) != 0) || !S_ISDIR( st.st_mode ))
+      return -1;
+   if (nfile_concatPaths( realpath, sizeof(realpath), realdir, path ) < 0)
+      return -1;
+
+   fd = open( realpath, O_RDONLY );
+   if (fd < 0)
+      return -1;
+   if ((fstat( fd, &st ) != 0) || !S_ISREG( st.st_mode ) || (st.st_size <= 0)) {
+      close( fd );
+      return -1;
+   }
+   data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+   if (data == MAP_FAILED)
+      return -1;
+
+   map->data   = data;
+   map->size   = st.st_size;
+   map->mapped = 1;
+   return 0;
+}
+#endif /* HAS_POSIX */
+
+/**
+ * @brief Gets a read-only view of a whole file from the ndata.
+ *
+ * Avoids the copy done by ndata_read when the file is in a plain directory.
+ *
+ *    @param[out] map Map to set up, must be freed with ndata_unmap.
+ *    @param path Path of the file to view.
+ *    @return 0 on success.
+ */
+int ndata_map( NDataMap *map, const char *path )
+{
+   memset( map, 0, sizeof(NDataMap) );
+#if HAS_POSIX
+   if (ndata_mapReal( map, path ) == 0)
+      return 0;
+#endif /* HAS_POSIX */
+   map->data = ndata_read( path, &map->size );
+   return (map->data == NULL) ? -1 : 0;
+}
+
+/**
+ * @brief Frees a view created with ndata_map.
+ */
+void ndata_unmap( NDataMap *map )
+{
+#if HAS_POSIX
+   if (map->mapped)
+      munmap( (void*)map->data, map->size );
+   else
+#endif /* HAS_POSIX */
+      free( (void*)map->data );
+   memset( map, 0, sizeof(NDataMap) );
+}
+
+/**
+ * @brief Opens a file from the ndata to be read in chunks.
+ *
+ *    @param[out] s Stream to open, must be closed with ndata_streamClose.
+ *    @param path Path of the file to read.
+ *    @return 0 on success.
+ */
+int ndata_streamOpen( NDataStream *s, const char *path )
+{
+   memset( s, 0, sizeof(NDataStream) );
+#if HAS_POSIX
+   if (ndata_mapReal( &s->map, path ) == 0)
+      return 0;
+#endif /* HAS_POSIX */
+   s->file = PHYSFS_openRead( path );
+   if (s->file == NULL) {
+      WARN( _( "Error occurred while opening '%s': %s" ), path,
+            _(PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+      return -1;
+   }
+   s->buf = malloc( NDATA_STREAM_CHUNK );
+   return 0;
+}
+
+/**
+ * @brief Reads the next chunk of a stream.
+ *
+ *    @param s Stream to read from.
+ *    @param[out] size Size of the chunk.
+ *    @return The chunk, valid until the next read, or NULL at the end of the file.
+ */
+const char *ndata_streamRead( NDataStream *s, size_t *size )
+{
+   PHYSFS_sint64 n;
+
+   *size = 0;
+   if (s->done)
+      return NULL;
+
+   if (s->map.data != NULL) {
+      s->done = 1;
+      *size = s->map.size;
+      loadprof_bytes( *size );
+      return s->map.data;
+   }
+
+   n = PHYSFS_readBytes( s->file, s->buf, NDATA_STREAM_CHUNK );
+   if (n <= 0) {
+      s->done = 1;
+      return NULL;
+   }
+   *size = n;
+   loadprof_bytes( *size );
+   return s->buf;
+}
+
+/**
+ * @brief Closes a stream opened with ndata_streamOpen.
+ */
+void ndata_streamClose( NDataStream *s )
+{
+   if (s->map.data != NULL)
+      ndata_unmap( &s->map );
+   if (s->file != NULL)
+      PHYSFS_close( s->file );
+   free( s->buf );
+   memset( s, 0, sizeof(NDataStream) );
+}
+
 /**
  * @brief Lists all the visible files in a directory, at any depth.
  *
@@ -230,7 +552,41 @@ void* ndata_read( const char* path, size_t *filesize )
  */
 char **ndata_listRecursive( const char *path )
 {
-   char **files = array_create( char * );
+   char **files;
+
+   /* The index already has everything sorted. */
+   if (ndata_indexWait()) {
+      char prefix[PATH_MAX];
+      int l, lo, hi;
+
+      l = scnprintf( prefix, sizeof(prefix), "%s", path );
+      while ((l > 0) && (prefix[l-1] == '/'))
+         l--;
+      if (l > 0)
+         l += scnprintf( &prefix[l], sizeof(prefix)-l, "/" );
+      else
+         prefix[0] = '\0';
+
+      /* Find the first path with the prefix, the rest follow. */
+      lo = 0;
+      hi = array_size( ndata_indexFiles );
+      while (lo < hi) {
+         int mid = (lo + hi) / 2;
+         if (strcmp( ndata_indexFiles[mid], prefix ) < 0)
+            lo = mid+1;
+         else
+            hi = mid;
+      }
+      files = array_create( char * );
+      for (int i=lo; i<array_size(ndata_indexFiles); i++) {
+         if (strncmp( ndata_indexFiles[i], prefix, l ) != 0)
+            break;
+         array_push_back( &files, strdup( ndata_indexFiles[i] ) );
+      }
+      return files;
+   }
+
+   files = array_create( char * );
    PHYSFS_enumerate( path, ndata_enumerateCallback, &files );
    /* Ensure unique. PhysicsFS can enumerate a path twice if it's in multiple components of a union. */
    qsort( files, array_size(files), sizeof(char*), strsort );
@@ -3,7 +3,10 @@
  */
 #pragma once
 
+/** @cond */
 #include <stdlib.h>
+#include "physfs.h"
+/** @endcond */
 
 /*
  * Define various paths
@@ -87,9 +90,41 @@
 #define SAVE_UPDATER_PATH        "save_updater.lua"
 #define DIFFICULTY_PATH          "difficulty/"
 
+/**
+ * @brief Read-only view of a whole ndata file.
+ *
+ * Files in plain directories are memory mapped, others are read into memory.
+ *  Unlike ndata_read, the data is not NUL terminated.
+ */
+typedef struct NDataMap_ {
+   const char *data; /**< File data. */
+   size_t size;      /**< Size of the file data. */
+   int mapped;       /**< Whether or not the data is memory mapped. */
+} NDataMap;
+
+/**
+ * @brief Chunked reader of an ndata file.
+ *
+ * Mappable files are returned as a single chunk, the others are read from
+ *  PhysicsFS in fixed size chunks so they never have to be fully in memory.
+ */
+typedef struct NDataStream_ {
+   NDataMap map;        /**< Mapping of the file if it could be mapped. */
+   PHYSFS_File *file;   /**< File being read in chunks otherwise. */
+   char *buf;           /**< Chunk buffer when reading in chunks. */
+   int done;            /**< Whether the whole file has been returned. */
+} NDataStream;
+
 void ndata_setupWriteDir (void);
 void ndata_setupReadDirs (void);
+void ndata_exit (void);
+int ndata_exists( const char *path );
 void* ndata_read( const char* filename, size_t *filesize );
+int ndata_map( NDataMap *map, const char *path );
+void ndata_unmap( NDataMap *map );
+int ndata_streamOpen( NDataStream *s, const char *path );
+const char *ndata_streamRead( NDataStream *s, size_t *size );
+void ndata_streamClose( NDataStream *s );
 char** ndata_listRecursive( const char *path );
 int ndata_backupIfExists( const char *path );
 int ndata_copyIfExists( const char *path1, const char *path2 );
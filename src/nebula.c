@@ -37,12 +37,22 @@ static double nebu_time = 0.; /**< Elapsed time since entering system. */
 /* Nebula scaling stuff. */
 static double nebu_scale = 4.; /**< How much to scale nebula. */
 static int nebu_dofbo    = 0;
-static GLuint nebu_fbo   = GL_INVALID_VALUE;
-static GLuint nebu_tex   = GL_INVALID_VALUE;
+static GLuint nebu_fbo   = GL_INVALID_VALUE; /**< Background framebuffer. */
+static GLuint nebu_tex   = GL_INVALID_VALUE; /**< Background texture. */
+static GLuint nebu_overlay_fbo = GL_INVALID_VALUE; /**< Overlay framebuffer. */
+static GLuint nebu_overlay_tex = GL_INVALID_VALUE; /**< Overlay texture. */
 static GLfloat nebu_render_w= 0.;
 static GLfloat nebu_render_h= 0.;
 static mat4 nebu_render_P;
 
+/* Temporal reuse. The nebula is anchored to the screen and evolves slowly, so
+ * the buffers can be reused for a few frames unless the parameters change. */
+static int nebu_bg_frames    = 0; /**< Frames left before the background is redrawn. */
+static int nebu_ov_frames    = 0; /**< Frames left before the overlay is redrawn. */
+static GLfloat nebu_bg_eddy  = 0.; /**< Eddy scale the background was drawn with. */
+static GLfloat nebu_ov_eddy  = 0.; /**< Eddy scale the overlay was drawn with. */
+static GLfloat nebu_ov_horizon= 0.; /**< Horizon the overlay was drawn with. */
+
 /**
  * @struct NebulaPuff
  *
@@ -67,7 +77,8 @@ static double puff_y          = 0.;
 static void nebu_renderPuffs( int below_player );
 /* Nebula render methods. */
 static void nebu_renderBackground( const double dt );
-static void nebu_blitFBO (void);
+static void nebu_blitFBO( GLuint tex );
+static int nebu_refresh( int *frames );
 
 /**
  * @brief Initializes the nebula.
@@ -89,22 +100,32 @@ int nebu_resize (void)
 {
    double scale;
    GLfloat fbo_w, fbo_h;
+   int dofbo;
 
    scale = conf.nebu_scale * gl_screen.scale;
    fbo_w = round(gl_screen.nw/scale);
    fbo_h = round(gl_screen.nh/scale);
-   if (scale == nebu_scale && fbo_w == nebu_render_w && fbo_h == nebu_render_h)
+   /* Reusing frames needs the buffers even at full resolution. */
+   dofbo = (scale != 1.) || (conf.nebu_refresh > 1);
+   if (scale == nebu_scale && fbo_w == nebu_render_w && fbo_h == nebu_render_h
+         && dofbo == nebu_dofbo)
       return 0;
 
    nebu_scale = scale;
    nebu_render_w = fbo_w;
    nebu_render_h = fbo_h;
-   nebu_dofbo = (nebu_scale != 1.);
+   nebu_dofbo = dofbo;
    glDeleteTextures( 1, &nebu_tex );
    glDeleteFramebuffers( 1, &nebu_fbo );
+   glDeleteTextures( 1, &nebu_overlay_tex );
+   glDeleteFramebuffers( 1, &nebu_overlay_fbo );
 
-   if (nebu_dofbo)
+   if (nebu_dofbo) {
       gl_fboCreate( &nebu_fbo, &nebu_tex, nebu_render_w, nebu_render_h );
+      gl_fboCreate( &nebu_overlay_fbo, &nebu_overlay_tex, nebu_render_w, nebu_render_h );
+   }
+   nebu_bg_frames = 0;
+   nebu_ov_frames = 0;
 
    /* Set up the matrices. */
    nebu_render_P = mat4_identity();
@@ -136,7 +157,25 @@ void nebu_exit (void)
    if (nebu_dofbo) {
       glDeleteFramebuffers( 1, &nebu_fbo );
       glDeleteTextures( 1, &nebu_tex );
+      glDeleteFramebuffers( 1, &nebu_overlay_fbo );
+      glDeleteTextures( 1, &nebu_overlay_tex );
+   }
+}
+
+/**
+ * @brief Checks to see if a nebula buffer has to be redrawn this frame.
+ *
+ *    @param[in,out] frames Frames left before the buffer has to be redrawn.
+ *    @return 1 if it has to be redrawn, 0 if the previous contents can be reused.
+ */
+static int nebu_refresh( int *frames )
+{
+   if (!nebu_dofbo || (*frames <= 0)) {
+      *frames = MAX( 1, conf.nebu_refresh ) - 1;
+      return 1;
    }
+   (*frames)--;
+   return 0;
 }
 
 /**
@@ -161,9 +200,22 @@ void nebu_render( const double dt )
  */
 static void nebu_renderBackground( const double dt )
 {
+   GLfloat eddy;
+
    /* calculate frame to draw */
    nebu_time += dt * nebu_dt;
 
+   /* Zooming changes the look, so always redraw then. */
+   eddy = nebu_view * cam_getZoom() / nebu_scale;
+   if (eddy != nebu_bg_eddy)
+      nebu_bg_frames = 0;
+   if (!nebu_refresh( &nebu_bg_frames )) {
+      nebu_blitFBO( nebu_tex );
+      gl_checkErr();
+      return;
+   }
+   nebu_bg_eddy = eddy;
+
    if (nebu_dofbo) {
       glBindFramebuffer(GL_FRAMEBUFFER, nebu_fbo);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -173,15 +225,15 @@ static void nebu_renderBackground( const double dt )
    glUseProgram(shaders.nebula_background.program);
 
    /* Set shader uniforms. */
-   glUniform1f(shaders.nebula_background.eddy_scale, nebu_view * cam_getZoom() / nebu_scale);
+   glUniform1f(shaders.nebula_background.eddy_scale, eddy);
    glUniform1f(shaders.nebula_background.time, nebu_time);
    glUniform1f(shaders.nebula_background.nonuniformity, conf.nebu_nonuniformity);
 
    /* Draw. */
    glEnableVertexAttribArray( shaders.nebula_background.vertex );
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula_background.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-   nebu_blitFBO();
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   nebu_blitFBO( nebu_tex );
 
    /* Clean up. */
    glDisableVertexAttribArray( shaders.nebula_background.vertex );
@@ -191,8 +243,10 @@ static void nebu_renderBackground( const double dt )
 
 /**
  * @brief If we're drawing the nebula buffered, copy to the screen.
+ *
+ *    @param tex Texture of the buffer to copy.
  */
-static void nebu_blitFBO (void)
+static void nebu_blitFBO( GLuint tex )
 {
    if (!nebu_dofbo)
       return;
@@ -201,7 +255,7 @@ static void nebu_blitFBO (void)
 
    glUseProgram(shaders.texture.program);
 
-   glBindTexture( GL_TEXTURE_2D, nebu_tex );
+   glBindTexture( GL_TEXTURE_2D, tex );
 
    glEnableVertexAttribArray( shaders.texture.vertex );
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture.vertex,
@@ -216,10 +270,11 @@ static void nebu_blitFBO (void)
    gl_uniformMat4( shaders.texture.tex_mat, &I );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture.vertex );
+   glUseProgram(0);
 }
 
 /**
@@ -276,6 +331,7 @@ void nebu_renderOverlay( const double dt )
 {
    (void) dt;
    double gx, gy, z;
+   GLfloat horizon, eddy;
 
    NTracingZone( _ctx, 1 );
 
@@ -290,9 +346,25 @@ void nebu_renderOverlay( const double dt )
     */
    nebu_renderPuffs( 0 );
 
+   /* Reuse the previous overlay if possible. */
+   horizon = nebu_view * z / nebu_scale;
+   eddy = nebu_dx * z / nebu_scale;
+   if ((horizon != nebu_ov_horizon) || (eddy != nebu_ov_eddy))
+      nebu_ov_frames = 0;
+   if (!nebu_refresh( &nebu_ov_frames )) {
+      nebu_blitFBO( nebu_overlay_tex );
+      gl_checkErr();
+      puff_x = 0.;
+      puff_y = 0.;
+      NTracingZoneEnd( _ctx );
+      return;
+   }
+   nebu_ov_horizon = horizon;
+   nebu_ov_eddy = eddy;
+
    /* Prepare the matrix */
    if (nebu_dofbo) {
-      glBindFramebuffer(GL_FRAMEBUFFER, nebu_fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, nebu_overlay_fbo);
       glClearColor( 0., 0., 0., 0. );
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
    }
@@ -301,16 +373,16 @@ void nebu_renderOverlay( const double dt )
    glUseProgram(shaders.nebula.program);
 
    /* Set shader uniforms. */
-   glUniform1f(shaders.nebula.horizon, nebu_view * z / nebu_scale);
-   glUniform1f(shaders.nebula.eddy_scale, nebu_dx * z / nebu_scale);
+   glUniform1f(shaders.nebula.horizon, horizon);
+   glUniform1f(shaders.nebula.eddy_scale, eddy);
    glUniform1f(shaders.nebula.time, nebu_time);
    glUniform1f(shaders.nebula.nonuniformity, conf.nebu_nonuniformity);
 
    /* Draw. */
    glEnableVertexAttribArray(shaders.nebula.vertex);
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.nebula.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-   nebu_blitFBO();
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   nebu_blitFBO( nebu_overlay_tex );
 
    /* Clean up. */
    glDisableVertexAttribArray( shaders.nebula.vertex );
@@ -368,7 +440,7 @@ static void nebu_renderPuffs( int below_player )
       glUniform1f( shaders.nebula_puff.time, nebu_time / 1.5 );
       glUniform2f( shaders.nebula_puff.r, puff->rx, puff->ry );
 
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       glDisableVertexAttribArray(shaders.nebula_puff.vertex);
       glUseProgram(0);
@@ -410,6 +482,10 @@ void nebu_prep( double density, double volatility, double hue )
    /* Done setting shaders. */
    glUseProgram(0);
 
+   /* Hue changed so the buffers are stale. */
+   nebu_bg_frames = 0;
+   nebu_ov_frames = 0;
+
    if (density > 0.) {
       /* Set density parameters. */
       nebu_density = density;
@@ -16,6 +16,7 @@
 #include "news.h"
 
 #include "array.h"
+#include "bitset.h"
 #include "faction.h"
 #include "log.h"
 #include "nlua.h"
@@ -38,6 +39,9 @@
  */
 news_t *news_list    = NULL;  /**< Linked list containing all articles */
 static int next_id   = 0; /**< next number to use as ID */
+static char **news_keys = NULL; /**< Array (array.h): Distinct article factions, compared without case. */
+static uint32_t *news_match = NULL; /**< Bitset (bitset.h): News keys matching the faction being generated. */
+static ntime_t news_expire = NEWS_FOREVER; /**< Earliest removal date of the articles. */
 
 /**
  * News line buffer.
@@ -69,6 +73,9 @@ static int news_parseArticle( xmlNodePtr parent );
 int news_saveArticles( xmlTextWriterPtr writer ); /* externed in save.c */
 int news_loadArticles( xmlNodePtr parent ); /* externed in load.c */
 static void clear_newslines (void);
+void news_free( news_t *n );
+static int news_key( const char *faction, int create );
+static const char *news_text( news_t *n );
 
 static int news_cmp( const void *p1, const void *p2 )
 {
@@ -86,6 +93,26 @@ static int news_cmp( const void *p1, const void *p2 )
    return n1->id - n2->id;
 }
 
+/**
+ * @brief Gets the index of an article faction in the news keys.
+ *
+ *    @param faction Faction or tag of the articles.
+ *    @param create Whether or not to add it if it is not found.
+ *    @return Index of the key or -1 if not found.
+ */
+static int news_key( const char *faction, int create )
+{
+   for (int i=0; i<array_size(news_keys); i++)
+      if (strcasecmp( news_keys[i], faction )==0)
+         return i;
+   if (!create)
+      return -1;
+   if (news_keys == NULL)
+      news_keys = array_create( char* );
+   array_push_back( &news_keys, strdup( faction ) );
+   return array_size(news_keys)-1;
+}
+
 /**
  * @brief makes a new article and puts it into the list
  *    @param title   the article title
@@ -101,25 +128,37 @@ int news_add( const char *title, const char *content,
       const char *faction, const char *tag,
       ntime_t date, ntime_t date_to_rm, int priority )
 {
-   news_t *n;
-   int id = ++next_id;
+   news_t n;
+   int lo, hi, id = ++next_id;
 
    if (news_list==NULL)
       news_list = array_create( news_t );
-   n = &array_grow( &news_list );
-   memset( n, 0, sizeof(news_t) );
-   n->id      = id;
-   n->title   = strdup( title );
-   n->desc    = strdup( content );
-   n->faction = strdup( faction );
+   memset( &n, 0, sizeof(news_t) );
+   n.id      = id;
+   n.title   = strdup( title );
+   n.desc    = strdup( content );
+   n.faction = strdup( faction );
    if (tag != NULL)
-      n->tag = strdup( tag );
-   n->date    = date;
-   n->date_to_rm = date_to_rm;
-   n->priority = priority;
-
-   /* Sort it! */
-   qsort( news_list, array_size(news_list), sizeof(news_t), news_cmp );
+      n.tag = strdup( tag );
+   n.date    = date;
+   n.date_to_rm = date_to_rm;
+   n.priority = priority;
+   n.key     = news_key( faction, 1 );
+   news_expire = MIN( news_expire, date_to_rm );
+
+   /* Insert it sorted. */
+   lo = 0;
+   hi = array_size(news_list);
+   while (lo < hi) {
+      int mid = (lo+hi) / 2;
+      if (news_cmp( &news_list[mid], &n ) < 0)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   array_push_back( &news_list, n );
+   memmove( &news_list[lo+1], &news_list[lo], (array_size(news_list)-lo-1) * sizeof(news_t) );
+   news_list[lo] = n;
 
    return id;
 }
@@ -148,16 +187,18 @@ void news_exit (void)
    if (news_list == NULL)
       return;
 
-   for (int i=0; i<array_size(news_list); i++) {
-      news_t *n = &news_list[i];
-
-      free(n->faction);
-      free(n->title);
-      free(n->desc);
-      free(n->tag);
-   }
+   for (int i=0; i<array_size(news_list); i++)
+      news_free( &news_list[i] );
    array_free(news_list);
    news_list = NULL;
+   news_expire = NEWS_FOREVER;
+
+   for (int i=0; i<array_size(news_keys); i++)
+      free(news_keys[i]);
+   array_free(news_keys);
+   news_keys = NULL;
+   array_free(news_match);
+   news_match = NULL;
 
    for (int i=0; i<array_size(news_lines); i++)
       free(news_lines[i]);
@@ -189,6 +230,7 @@ void news_free( news_t *n )
    free( n->desc );
    free( n->faction );
    free( n->tag );
+   free( n->text );
 }
 
 void news_rm( int id )
@@ -200,6 +242,27 @@ void news_rm( int id )
    array_erase( &news_list, &n[0], &n[1] );
 }
 
+/**
+ * @brief Gets the formatted text of an article, formatting it if needed.
+ *
+ *    @param n Article to get text of.
+ *    @return The formatted text.
+ */
+static const char *news_text( news_t *n )
+{
+   if (n->text != NULL)
+      return n->text;
+
+   if (n->date != 0) {
+      char *article_time = ntime_pretty( n->date, 1 );
+      SDL_asprintf( &n->text, " %s \n%s: %s#0\n\n", n->title, article_time, n->desc );
+      free( article_time );
+   }
+   else
+      SDL_asprintf( &n->text, " %s \n%s#0\n\n", n->title, n->desc );
+   return n->text;
+}
+
 /**
  * @brief Generates news from newslist from specific faction AND Generic news
  *
@@ -208,53 +271,43 @@ void news_rm( int id )
  */
 int *generate_news( int faction )
 {
-   const char* fname;
    ntime_t curtime = ntime_get();
    int p = 0;
-   const char **tags;
-
-   fname = (faction >= 0) ? faction_name( faction ) : NULL;
 
-   /* First pass to remove old articles. */
-   for (int i=array_size(news_list)-1; i>=0; i--) {
-      const news_t *n = &news_list[i];
+   /* Remove old articles in a single pass, only when some are due. */
+   if (news_expire <= curtime) {
+      int n = 0;
+      news_expire = NEWS_FOREVER;
+      for (int i=0; i<array_size(news_list); i++) {
+         if (news_list[i].date_to_rm <= curtime) {
+            news_free( &news_list[i] );
+            continue;
+         }
+         news_expire = MIN( news_expire, news_list[i].date_to_rm );
+         news_list[n++] = news_list[i];
+      }
+      array_resize( &news_list, n );
+   }
 
-      /* if the article is due for removal */
-      if (n->date_to_rm <= curtime)
-         news_rm( n->id );
+   /* Set the keys the faction and its tags match. */
+   bitset_clear( news_match );
+   if (faction >= 0) {
+      const char **tags = faction_tags( faction );
+      int k = news_key( faction_name( faction ), 0 );
+      if (k >= 0)
+         bitset_set( &news_match, k );
+      for (int j=0; j<array_size(tags); j++) {
+         k = news_key( tags[j], 0 );
+         if (k >= 0)
+            bitset_set( &news_match, k );
+      }
    }
 
    /* Put all acceptable news into buf */
-   tags = (faction >= 0) ? faction_tags( faction ) : NULL;
    for (int i=0; i<array_size(news_list); i++) {
       news_t *n = &news_list[i];
-      int match_tag = 0;
-
-      /* Check to see if matches tag. */
-      if (tags != NULL) {
-         for (int j=0; j<array_size(tags); j++) {
-            if (strcasecmp( tags[j], n->faction)==0) {
-               match_tag = 1;
-               break;
-            }
-         }
-      }
-
-      /* if article is okay */
-      if (match_tag || ((fname != NULL) && (strcasecmp(n->faction, fname) == 0))) {
-         if (n->date != 0) {
-            char *article_time = ntime_pretty( n->date, 1 );
-            p += scnprintf( buf+p, NEWS_MAX_LENGTH-p,
-               " %s \n"
-               "%s: %s#0\n\n", n->title, article_time, n->desc );
-            free( article_time );
-         }
-         else {
-            p += scnprintf( buf+p, NEWS_MAX_LENGTH-p,
-               " %s \n"
-               "%s#0\n\n", n->title, n->desc );
-         }
-      }
+      if (bitset_test( news_match, n->key ))
+         p += scnprintf( buf+p, NEWS_MAX_LENGTH-p, "%s", news_text( n ) );
    }
 
    if (p == 0)
@@ -24,6 +24,9 @@ typedef struct news_s {
 
    ntime_t date; /**< Date added ascribed to the article, NULL if none */
    ntime_t date_to_rm; /**< Date after which the article will be removed */
+
+   int key; /**< Index of the faction in the news keys. */
+   char *text; /**< Formatted article, generated when first displayed. */
 } news_t;
 
 /*
@@ -8,6 +8,7 @@
  */
 
 /** @cond */
+#include <stdarg.h>
 #include "physfs.h"
 
 #include "naev.h"
@@ -17,6 +18,9 @@
 
 #include "log.h"
 #include "conf.h"
+#include "loadprof.h"
+#include "luaprof.h"
+#include "ncache.h"
 #include "debug.h"
 #include "lua_enet.h"
 #include "lutf8lib.h"
@@ -29,6 +33,7 @@
 #include "nlua_diff.h"
 #include "nlua_faction.h"
 #include "nlua_file.h"
+#include "nlua_gfx.h"
 #include "nlua_jump.h"
 #include "nlua_linopt.h"
 #include "nlua_naev.h"
@@ -47,12 +52,29 @@
 #include "nlua_vec2.h"
 #include "nluadef.h"
 #include "nstring.h"
+#include "ntracing.h"
 
 lua_State *naevL = NULL; /**< Global Naev Lua state. */
 nlua_env __NLUA_CURENV = LUA_NOREF; /**< Current environment. */
-static char *common_script; /**< Common script to run when creating environments. */
-static size_t common_sz; /**< Common script size. */
 static int nlua_envs = LUA_NOREF;
+static int nlua_common = LUA_NOREF; /**< Shared read-only table with the results of the common script. */
+static int nlua_common_failed = 0; /**< Whether the common script failed to load. */
+static int nlua_envmeta = LUA_NOREF; /**< Metatable shared by environments once the common table exists. */
+static int nlua_package_setup = 0; /**< Whether the package paths and loaders have been set up. */
+static int nlua_envs_live = 0; /**< Number of environments alive. */
+static int nlua_envs_created = 0; /**< Number of environments created. */
+static int nlua_gc_active = 0; /**< Whether a collection cycle is being run by nlua_gcStep. */
+static int nlua_gc_threshold = 0; /**< Kilobytes of memory from which nlua_gcStep starts a new cycle. */
+static int nlua_gc_cycles = 0; /**< Number of cycles finished by nlua_gcStep. */
+
+#define NLUA_GC_STEPSIZE   16  /**< Size of the incremental steps run by nlua_gcStep. */
+#define NLUA_GC_IDLEPAUSE  150 /**< Memory growth (percent) before nlua_gcStep starts a new cycle. */
+
+#if HAVE_LUAJIT
+#define NLUA_BYTECODE_ID   "lua-bytecode:"LUA_RELEASE":jit" /**< Identifies the bytecode format in cache keys. */
+#else /* HAVE_LUAJIT */
+#define NLUA_BYTECODE_ID   "lua-bytecode:"LUA_RELEASE /**< Identifies the bytecode format in cache keys. */
+#endif /* HAVE_LUAJIT */
 
 /**
  * @brief Cache structure for loading chunks.
@@ -66,10 +88,17 @@ static LuaCache_t *lua_cache = NULL;
 /*
  * prototypes
  */
+static const char *nlua_streamReader( lua_State *L, void *data, size_t *size );
+static int nlua_loadStream( lua_State *L, NDataStream *stream, const char *chunkname );
+static int nlua_bytecodeLoad( lua_State *L, const char *path );
+static void nlua_bytecodeSave( lua_State *L, const char *path );
 static int nlua_package_loader_lua( lua_State* L );
 static int nlua_package_loader_c( lua_State* L );
 static int nlua_package_loader_croot( lua_State* L );
 static int nlua_require( lua_State* L );
+static int nlua_loadCommon (void);
+static int nlua_commonNewindex( lua_State *L );
+static void *nlua_alloc( void *ud, void *ptr, size_t osize, size_t nsize );
 static lua_State *nlua_newState (void); /* creates a new state */
 static int nlua_loadBasic( lua_State* L );
 static int luaB_loadstring( lua_State *L );
@@ -199,6 +228,11 @@ void lua_init (void)
    /* Better clean up. */
    lua_atpanic( naevL, nlua_panic );
 
+   /* When collecting at the end of frames, the automatic collector is only
+    * left as a safety net for when the per-frame budget can't keep up. */
+   if (conf.lua_gc_budget > 0.)
+      lua_gc( naevL, LUA_GCSETPAUSE, conf.lua_gc_pause );
+
    /* Initialize the caches. */
    lua_cache = array_create(LuaCache_t);
 }
@@ -226,9 +260,17 @@ static int luaB_loadstring( lua_State *L )
  */
 void lua_exit (void)
 {
-   free( common_script );
    lua_close(naevL);
    naevL = NULL;
+   luaprof_clearEnvs();
+   nlua_common = LUA_NOREF;
+   nlua_common_failed = 0;
+   nlua_envmeta = LUA_NOREF;
+   nlua_package_setup = 0;
+   nlua_envs_live = 0;
+   nlua_gc_active = 0;
+   nlua_gc_threshold = 0;
+   nlua_gc_cycles = 0;
    for (int i=0; i<array_size(lua_cache); i++) {
       LuaCache_t *lc = &lua_cache[i];
       free(lc->path);
@@ -263,6 +305,7 @@ int nlua_dobufenv( nlua_env env,
    ret = luaL_loadbuffer(naevL, buff, sz, name);
    if (ret != 0)
       return ret;
+   luaprof_setName( env, name, 0 );
 #if DEBUGGING
    if (conf.fpu_except)
       debug_enableFPUExcept();
@@ -290,6 +333,7 @@ int nlua_dofileenv( nlua_env env, const char *filename )
 {
    if (luaL_loadfile(naevL, filename) != 0)
       return -1;
+   luaprof_setName( env, filename, 0 );
    nlua_pushenv(naevL, env);
    lua_setfenv(naevL, -2);
    if (nlua_pcall(env, 0, LUA_MULTRET) != 0)
@@ -306,8 +350,8 @@ int nlua_dofileenv( nlua_env env, const char *filename )
  */
 int nlua_dochunkenv( nlua_env env, int chunk, const char *name )
 {
-   (void) name;
    int ret;
+   luaprof_setName( env, name, 0 );
    lua_rawgeti( naevL, LUA_REGISTRYINDEX, chunk );
    nlua_pushenv(naevL, env);
    lua_setfenv(naevL, -2);
@@ -328,10 +372,74 @@ void nlua_pushEnvTable( lua_State *L )
 }
 #endif /* DEBBUGING */
 
+/**
+ * @brief Errors out when something tries to modify the shared common table.
+ */
+static int nlua_commonNewindex( lua_State *L )
+{
+   return NLUA_ERROR( L, _("Trying to modify the read-only common table (key '%s')."), luaL_optstring(L, 2, "?") );
+}
+
+/**
+ * @brief Runs the common script once into a shared table environments inherit from.
+ *
+ *    @return 0 if the common table is available.
+ */
+static int nlua_loadCommon (void)
+{
+   char *script;
+   size_t sz;
+   int ref;
+
+   if (nlua_common != LUA_NOREF)
+      return 0;
+   if (!conf.loaded || nlua_common_failed)
+      return -1;
+
+   script = ndata_read( LUA_COMMON_PATH, &sz );
+   if (script==NULL) {
+      WARN(_("Unable to load common script '%s'!"), LUA_COMMON_PATH);
+      nlua_common_failed = 1;
+      return -1;
+   }
+
+   /* Common table looking up the globals. */
+   lua_newtable(naevL);       /* c */
+   lua_newtable(naevL);       /* c, m */
+   lua_pushvalue(naevL, LUA_GLOBALSINDEX); /* c, m, g */
+   lua_setfield(naevL, -2, "__index"); /* c, m */
+   lua_setmetatable(naevL, -2); /* c */
+   ref = luaL_ref(naevL, LUA_REGISTRYINDEX); /* */
+
+   if (luaL_loadbuffer(naevL, script, sz, LUA_COMMON_PATH) == 0) {
+      if (nlua_pcall( ref, 0, 0 ) != 0) {
+         WARN(_("Failed to run '%s':\n%s"), LUA_COMMON_PATH, lua_tostring(naevL,-1));
+         lua_pop(naevL, 1);
+      }
+   }
+   else {
+      WARN(_("Failed to load '%s':\n%s"), LUA_COMMON_PATH, lua_tostring(naevL,-1));
+      lua_pop(naevL, 1);
+   }
+   free( script );
+
+   /* Freeze it now that the script defined everything. */
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, ref); /* c */
+   lua_getmetatable(naevL, -1); /* c, m */
+   lua_pushcfunction(naevL, nlua_commonNewindex); /* c, m, f */
+   lua_setfield(naevL, -2, "__newindex"); /* c, m */
+   lua_pop(naevL, 2); /* */
+
+   nlua_common = ref;
+   return 0;
+}
+
 /*
  * @brief Create an new environment in global Lua state.
  *
- * An "environment" is a table used with setfenv for sandboxing.
+ * An "environment" is a table used with setfenv for sandboxing. The results
+ *  of the common script are not copied into it but inherited from a shared
+ *  table, so creating one is cheap.
  */
 nlua_env nlua_newEnv (void)
 {
@@ -347,10 +455,22 @@ nlua_env nlua_newEnv (void)
    lua_rawset(naevL, -3);     /* t, e */
    lua_pop(naevL,1);          /* t */
 
-   /* Metatable */
-   lua_newtable(naevL);       /* t, m */
-   lua_pushvalue(naevL, LUA_GLOBALSINDEX); /* t, m, g */
-   lua_setfield(naevL, -2, "__index"); /* t, m */
+   /* Metatable, looks up the common table and then the globals. */
+   if (nlua_envmeta != LUA_NOREF)
+      lua_rawgeti(naevL, LUA_REGISTRYINDEX, nlua_envmeta); /* t, m */
+   else {
+      int common = (nlua_loadCommon()==0);
+      lua_newtable(naevL);       /* t, m */
+      if (common)
+         lua_rawgeti(naevL, LUA_REGISTRYINDEX, nlua_common); /* t, m, c */
+      else
+         lua_pushvalue(naevL, LUA_GLOBALSINDEX); /* t, m, g */
+      lua_setfield(naevL, -2, "__index"); /* t, m */
+      if (common) {
+         lua_pushvalue(naevL, -1); /* t, m, m */
+         nlua_envmeta = luaL_ref(naevL, LUA_REGISTRYINDEX); /* t, m */
+      }
+   }
    lua_setmetatable(naevL, -2); /* t */
 
    /* Replace require() function with one that considers fenv */
@@ -358,22 +478,25 @@ nlua_env nlua_newEnv (void)
    lua_pushcclosure(naevL, nlua_require, 1); /* t, t, c */
    lua_setfield(naevL, -2, "require"); /* t, t */
 
-   /* Set up paths.
+   /* Set up paths, the package table is global so only once.
     * "package.path" to look in the data.
     * "package.cpath" unset */
-   lua_getglobal(naevL, "package"); /* t, t, p */
-   lua_pushstring(naevL, "?.lua;"LUA_INCLUDE_PATH"?.lua"); /* t, t, p, s */
-   lua_setfield(naevL, -2, "path"); /* t, t, p */
-   lua_pushstring(naevL, "");    /* t, t, p, s */
-   lua_setfield(naevL, -2, "cpath"); /* t, t, p */
-   lua_getfield(naevL, -1, "loaders"); /* t, t, p, l */
-   lua_pushcfunction(naevL, nlua_package_loader_lua); /* t, t, p, l, f */
-   lua_rawseti(naevL, -2, 2); /* t, t, p, l */
-   lua_pushcfunction(naevL, nlua_package_loader_c); /* t, t, p, l, f */
-   lua_rawseti(naevL, -2, 3); /* t, t, p, l */
-   lua_pushcfunction(naevL, nlua_package_loader_croot); /* t, t, p, l, f */
-   lua_rawseti(naevL, -2, 4); /* t, t, p, l */
-   lua_pop(naevL, 2); /* t, t */
+   if (!nlua_package_setup) {
+      lua_getglobal(naevL, "package"); /* t, t, p */
+      lua_pushstring(naevL, "?.lua;"LUA_INCLUDE_PATH"?.lua"); /* t, t, p, s */
+      lua_setfield(naevL, -2, "path"); /* t, t, p */
+      lua_pushstring(naevL, "");    /* t, t, p, s */
+      lua_setfield(naevL, -2, "cpath"); /* t, t, p */
+      lua_getfield(naevL, -1, "loaders"); /* t, t, p, l */
+      lua_pushcfunction(naevL, nlua_package_loader_lua); /* t, t, p, l, f */
+      lua_rawseti(naevL, -2, 2); /* t, t, p, l */
+      lua_pushcfunction(naevL, nlua_package_loader_c); /* t, t, p, l, f */
+      lua_rawseti(naevL, -2, 3); /* t, t, p, l */
+      lua_pushcfunction(naevL, nlua_package_loader_croot); /* t, t, p, l, f */
+      lua_rawseti(naevL, -2, 4); /* t, t, p, l */
+      lua_pop(naevL, 2); /* t, t */
+      nlua_package_setup = 1;
+   }
 
    /* The global table _G should refer back to the environment. */
    lua_pushvalue(naevL, -1); /* t, t, t */
@@ -389,27 +512,65 @@ nlua_env nlua_newEnv (void)
    lua_newtable(naevL); /* t, t, n */
    lua_setfield(naevL, -2, "naev"); /* t, t */
 
-   /* Run common script. */
-   if (conf.loaded && common_script==NULL) {
-      common_script = ndata_read( LUA_COMMON_PATH, &common_sz );
-      if (common_script==NULL)
-         WARN(_("Unable to load common script '%s'!"), LUA_COMMON_PATH);
-   }
-   if (common_script != NULL) {
-      if (luaL_loadbuffer(naevL, common_script, common_sz, LUA_COMMON_PATH) == 0) {
-         if (nlua_pcall( ref, 0, 0 ) != 0) {
-            WARN(_("Failed to run '%s':\n%s"), LUA_COMMON_PATH, lua_tostring(naevL,-1));
-            lua_pop(naevL, 1);
+   lua_pop(naevL, 1); /* t */
+
+   nlua_envs_live++;
+   nlua_envs_created++;
+   NTracingPlotI( "lua_envs", nlua_envs_live );
+   return ref;
+}
+
+/**
+ * @brief Gets statistics about the Lua environments.
+ *
+ *    @param[out] live Number of environments alive.
+ *    @param[out] created Number of environments created so far.
+ *    @param[out] mem Kilobytes of memory used by the Lua state.
+ */
+void nlua_envStats( int *live, int *created, int *mem )
+{
+   *live    = nlua_envs_live;
+   *created = nlua_envs_created;
+   *mem     = lua_gc( naevL, LUA_GCCOUNT, 0 );
+}
+
+/**
+ * @brief Runs incremental garbage collection steps on the global Lua state.
+ *
+ * Meant to be called at the end of the frame. Once a cycle is finished, a new
+ *  one is only started when the memory in use has grown enough since.
+ *
+ *    @param budget Milliseconds the collection can take.
+ */
+void nlua_gcStep( double budget )
+{
+   Uint64 start, limit;
+   int steps, kb;
+
+   if ((naevL == NULL) || (budget <= 0.))
+      return;
+
+   kb = lua_gc( naevL, LUA_GCCOUNT, 0 );
+   steps = 0;
+   if (nlua_gc_active || (kb >= nlua_gc_threshold)) {
+      nlua_gc_active = 1;
+      start = SDL_GetPerformanceCounter();
+      limit = budget * 1e-3 * (double)SDL_GetPerformanceFrequency();
+      do {
+         steps++;
+         if (lua_gc( naevL, LUA_GCSTEP, NLUA_GC_STEPSIZE )) {
+            nlua_gc_active = 0;
+            nlua_gc_cycles++;
+            kb = lua_gc( naevL, LUA_GCCOUNT, 0 );
+            nlua_gc_threshold = kb * NLUA_GC_IDLEPAUSE / 100;
+            break;
          }
-      }
-      else {
-         WARN(_("Failed to load '%s':\n%s"), LUA_COMMON_PATH, lua_tostring(naevL,-1));
-         lua_pop(naevL, 1);
-      }
+      } while (SDL_GetPerformanceCounter() - start < limit);
    }
 
-   lua_pop(naevL, 1); /* t */
-   return ref;
+   NTracingPlotI( "lua_gc_steps", steps );
+   NTracingPlotI( "lua_gc_cycles", nlua_gc_cycles );
+   NTracingPlotI( "lua_gc_kb", kb );
 }
 
 /*
@@ -433,6 +594,28 @@ void nlua_freeEnv( nlua_env env )
 
    /* Unref. */
    luaL_unref(naevL, LUA_REGISTRYINDEX, env);
+   luaprof_freeEnv( env );
+   nlua_envs_live--;
+   NTracingPlotI( "lua_envs", nlua_envs_live );
+}
+
+/**
+ * @brief Names an environment for the Lua profiler.
+ *
+ * Environments are otherwise named after the first script they run.
+ *
+ *    @param env Environment to name.
+ *    @param fmt Format of the name.
+ */
+void nlua_setEnvName( nlua_env env, const char *fmt, ... )
+{
+   char buf[STRMAX_SHORT];
+   va_list ap;
+
+   va_start( ap, fmt );
+   vsnprintf( buf, sizeof(buf), fmt, ap );
+   va_end( ap );
+   luaprof_setName( env, buf, 1 );
 }
 
 /*
@@ -504,6 +687,21 @@ void nlua_register( nlua_env env, const char *libname,
    nlua_setenv(naevL, env, libname);/* */
 }
 
+/**
+ * @brief Allocator of the Lua state, letting the profiler count allocations.
+ */
+static void *nlua_alloc( void *ud, void *ptr, size_t osize, size_t nsize )
+{
+   (void) ud;
+   if (nsize == 0) {
+      free( ptr );
+      return NULL;
+   }
+   if (luaprof_enabled() && (nsize > osize))
+      luaprof_alloc( (ptr==NULL) ? nsize : nsize-osize );
+   return realloc( ptr, nsize );
+}
+
 /**
  * @brief Wrapper around luaL_newstate.
  *
@@ -511,8 +709,12 @@ void nlua_register( nlua_env env, const char *libname,
  */
 static lua_State *nlua_newState (void)
 {
-   /* Try to create the new state */
-   lua_State *L = luaL_newstate();
+   /* Try to create the new state, LuaJIT may not support custom allocators. */
+   lua_State *L = lua_newstate( nlua_alloc, NULL );
+   if (L != NULL)
+      luaprof_exactAlloc();
+   else
+      L = luaL_newstate();
    if (L == NULL) {
       WARN(_("Failed to create new Lua state."));
       return NULL;
@@ -595,17 +797,111 @@ static int lua_cache_cmp( const void *p1, const void *p2 )
    return strcmp( lc1->path, lc2->path );
 }
 
+/**
+ * @brief lua_Reader that feeds Lua the chunks of an ndata stream.
+ */
+static const char *nlua_streamReader( lua_State *L, void *data, size_t *size )
+{
+   (void) L;
+   return ndata_streamRead( data, size );
+}
+
+/**
+ * @brief Loads a Lua chunk from an ndata stream without reading it whole.
+ *
+ *    @return Same as lua_load.
+ */
+static int nlua_loadStream( lua_State *L, NDataStream *stream, const char *chunkname )
+{
+   return lua_load( L, nlua_streamReader, stream, chunkname );
+}
+
+/**
+ * @brief Gets the name and key of the bytecode cache of a module.
+ */
+static void nlua_bytecodeKey( char *name, size_t len, md5_byte_t key[16], const char *path )
+{
+   char **files = array_create( char* );
+   array_push_back( &files, (char*)path );
+   ncache_key( key, NLUA_BYTECODE_ID, files );
+   array_free( files );
+
+   /* Flatten the path, caches don't have subdirectories. */
+   snprintf( name, len, "lua+%s", path );
+   for (char *c=name; *c!='\0'; c++)
+      if (*c=='/')
+         *c = '+';
+}
+
+/**
+ * @brief Loads the cached bytecode of a module from a previous run.
+ *
+ *    @return 0 if the compiled function was pushed onto the stack.
+ */
+static int nlua_bytecodeLoad( lua_State *L, const char *path )
+{
+   char name[PATH_MAX];
+   md5_byte_t key[16];
+   NCache nc;
+   int ret;
+
+   nlua_bytecodeKey( name, sizeof(name), key, path );
+   if (ncache_open( &nc, name, key ) != 0)
+      return -1;
+   ret = luaL_loadbuffer( L, nc.data, nc.size, path );
+   ncache_close( &nc );
+   if (ret != 0) {
+      lua_pop( L, 1 );
+      return -1;
+   }
+   return 0;
+}
+
+/**
+ * @brief lua_Writer appending to a cache.
+ */
+static int nlua_bytecodeWriter( lua_State *L, const void *p, size_t sz, void *ud )
+{
+   (void) L;
+   ncache_writeData( ud, p, sz );
+   return 0;
+}
+
+/**
+ * @brief Saves the bytecode of the compiled module at the top of the stack for the next runs.
+ */
+static void nlua_bytecodeSave( lua_State *L, const char *path )
+{
+   char name[PATH_MAX];
+   md5_byte_t key[16];
+   NCacheWriter w;
+
+   nlua_bytecodeKey( name, sizeof(name), key, path );
+   ncache_writeBegin( &w );
+   if (lua_dump( L, nlua_bytecodeWriter, &w ) != 0) {
+      array_free( w.buf );
+      return;
+   }
+   ncache_writeEnd( &w, name, key );
+}
+
 /**
  * @brief load( string module ) -- searcher function to replace package.loaders[2] (Lua 5.1), i.e., for Lua modules.
  *
+ * Compiled modules are cached and shared by all environments, as nlua_require
+ *  sets the environment before running them. The bytecode is also kept in the
+ *  cache directory between runs.
+ *
  *    @param L Lua Environment.
  *    @return Stack depth (1), and on the stack: a loader function, a string explaining there is none, or nil (no explanation).
  */
 static int nlua_package_loader_lua( lua_State* L )
 {
    LuaCache_t *lc;
-   size_t bufsize, l = 0;
-   char *buf = NULL;
+   size_t l = 0;
+   NDataStream stream;
+   Uint64 t;
+   int found = 0;
    char path_filename[PATH_MAX], tmpname[PATH_MAX], tried_paths[STRMAX];
    const char *packagepath, *start, *end;
    const char *name = luaL_checkstring(L,1);
@@ -654,45 +950,51 @@ static int nlua_package_loader_lua( lua_State* L )
          if (path_filename[i]=='.')
             path_filename[i] = '/';
 
-      /* See if cached. */
-      if (L==naevL) {
-         const LuaCache_t lcq = { .path=path_filename };
-         lc = bsearch( &lcq, lua_cache, array_size(lua_cache), sizeof(LuaCache_t), lua_cache_cmp );
-         if (lc != NULL) {
-            lua_rawgeti( naevL, LUA_REGISTRYINDEX, lc->idx );
-            return 1;
-         }
+      /* See if cached, threads share the registry. */
+      const LuaCache_t lcq = { .path=path_filename };
+      lc = bsearch( &lcq, lua_cache, array_size(lua_cache), sizeof(LuaCache_t), lua_cache_cmp );
+      if (lc != NULL) {
+         lua_rawgeti( L, LUA_REGISTRYINDEX, lc->idx );
+         return 1;
       }
 
       /* Try to load the file. */
-      if (PHYSFS_exists( path_filename )) {
-         buf = ndata_read( path_filename, &bufsize );
-         if (buf != NULL)
+      if (ndata_exists( path_filename )) {
+         if (ndata_streamOpen( &stream, path_filename ) == 0) {
+            found = 1;
             break;
+         }
       }
 
       /* Didn't get to load it. */
       l += scnprintf( &tried_paths[l], sizeof(tried_paths)-l, _("\n   no ndata path '%s'"), path_filename );
    }
 
-   /* Must have buf by now. */
-   if (buf == NULL) {
+   /* Must have found it by now. */
+   if (!found) {
       lua_pushstring(L, tried_paths);
       return 1;
    }
 
    /* Try to process the Lua. It will leave a function or message on the stack, as required. */
-   luaL_loadbuffer(L, buf, bufsize, path_filename);
-   free(buf);
+   t = loadprof_fileBegin();
+   if (nlua_bytecodeLoad( L, path_filename ) != 0) {
+      if (nlua_loadStream( L, &stream, path_filename ) != 0) {
+         ndata_streamClose( &stream );
+         loadprof_fileEnd( LOADPROF_LUA, path_filename, t );
+         return 1; /* Error message. */
+      }
+      nlua_bytecodeSave( L, path_filename );
+   }
+   ndata_streamClose( &stream );
+   loadprof_fileEnd( LOADPROF_LUA, path_filename, t );
 
    /* Cache the result. */
-   if (L==naevL) {
-      lc = &array_grow(&lua_cache);
-      lc->path = strdup(path_filename);
-      lua_pushvalue(L,-1);
-      lc->idx = luaL_ref( naevL, LUA_REGISTRYINDEX ); /* pops 1 */
-      qsort( lua_cache, array_size(lua_cache), sizeof(LuaCache_t), lua_cache_cmp );
-   }
+   lc = &array_grow(&lua_cache);
+   lc->path = strdup(path_filename);
+   lua_pushvalue(L,-1);
+   lc->idx = luaL_ref( L, LUA_REGISTRYINDEX ); /* pops 1 */
+   qsort( lua_cache, array_size(lua_cache), sizeof(LuaCache_t), lua_cache_cmp );
    return 1;
 }
 
@@ -910,7 +1212,7 @@ int nlua_errTrace( lua_State *L )
  */
 int nlua_pcall( nlua_env env, int nargs, int nresults )
 {
-   int errf, ret, prev_env;
+   int errf, ret, prev_env, prof;
 
 #if DEBUGGING
    errf = lua_gettop(naevL) - nargs;
@@ -929,7 +1231,11 @@ int nlua_pcall( nlua_env env, int nargs, int nresults )
    prev_env = __NLUA_CURENV;
    __NLUA_CURENV = env;
 
+   prof = luaprof_enter( env );
    ret = lua_pcall(naevL, nargs, nresults, errf);
+   nlua_gfxFlush(); /* Draws batched by the call. */
+   if (prof)
+      luaprof_leave();
 
    __NLUA_CURENV = prev_env;
 
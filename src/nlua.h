@@ -8,6 +8,8 @@
 #include <lauxlib.h>
 /** @endcond */
 
+#include "nstring.h"
+
 #define NLUA_LOAD_TABLE "_LOADED" /**< Table to use to store the status of required libraries. */
 
 #define NLUA_DONE       "__done__"
@@ -26,6 +28,9 @@ void lua_init (void);
 void lua_exit (void);
 nlua_env nlua_newEnv (void);
 void nlua_freeEnv(nlua_env env);
+PRINTF_FORMAT( 2, 3 ) void nlua_setEnvName( nlua_env env, const char *fmt, ... );
+void nlua_envStats( int *live, int *created, int *mem );
+void nlua_gcStep( double budget );
 void nlua_pushenv(lua_State* L, nlua_env env);
 void nlua_setenv(lua_State* L, nlua_env env, const char *name);
 void nlua_getenv(lua_State* L, nlua_env env, const char *name);
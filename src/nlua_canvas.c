@@ -14,17 +14,25 @@
 
 #include "nlua_canvas.h"
 
+#include "array.h"
 #include "log.h"
 #include "nluadef.h"
+#include "nlua_gfx.h"
 #include "nlua_tex.h"
 #include "nlua_colour.h"
 #include "render.h"
 
+#define CANVAS_POOL_MAX   16 /**< Maximum number of unused canvases kept for reuse. */
+
 static int nlua_canvas_counter = 0;
+static LuaCanvas_t *canvas_pool = NULL; /**< Array (array.h) of unused canvases, oldest first. */
 static GLuint previous_fbo = 0;
 static int previous_fbo_set = 0;
 static int was_scissored    = 0;
 
+static void canvas_destroy( const LuaCanvas_t *lc );
+static void canvas_release( const LuaCanvas_t *lc );
+
 /* Canvas metatable methods. */
 static int canvasL_gc( lua_State *L );
 static int canvasL_eq( lua_State *L );
@@ -135,9 +143,8 @@ int lua_iscanvas( lua_State *L, int ind )
 static int canvasL_gc( lua_State *L )
 {
    const LuaCanvas_t *lc = luaL_checkcanvas(L,1);
-   glDeleteFramebuffers( 1, &lc->fbo );
-   gl_freeTexture( lc->tex );
-   gl_checkErr();
+   nlua_gfxFlush();
+   canvas_release( lc );
    return 0;
 }
 
@@ -170,6 +177,23 @@ int canvas_new( LuaCanvas_t *lc, int w, int h )
    GLenum status;
    char *name;
 
+   /* Reuse an unused canvas of the same size, most recent first. */
+   for (int i=array_size(canvas_pool)-1; i>=0; i--) {
+      const LuaCanvas_t *pc = &canvas_pool[i];
+      if (((int)pc->tex->w != w) || ((int)pc->tex->h != h))
+         continue;
+      *lc = *pc;
+      array_erase( &canvas_pool, &canvas_pool[i], &canvas_pool[i+1] );
+
+      /* Lua may have changed the texture parameters through getTex. */
+      gl_texResetParameters( lc->tex );
+      glBindFramebuffer(GL_FRAMEBUFFER, lc->fbo);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
+      gl_checkErr();
+      return 0;
+   }
+
    memset( lc, 0, sizeof(LuaCanvas_t) );
 
    /* Create the texture. */
@@ -200,6 +224,53 @@ int canvas_new( LuaCanvas_t *lc, int w, int h )
    return 0;
 }
 
+/**
+ * @brief Frees the OpenGL objects of a canvas.
+ */
+static void canvas_destroy( const LuaCanvas_t *lc )
+{
+   glDeleteFramebuffers( 1, &lc->fbo );
+   gl_freeTexture( lc->tex );
+   gl_checkErr();
+}
+
+/**
+ * @brief Releases a canvas, keeping it around to be reused by canvas_new.
+ *
+ * Canvases whose texture is still referenced elsewhere (for example through
+ *  getTex) or that are being rendered to can not be reused and get freed.
+ */
+static void canvas_release( const LuaCanvas_t *lc )
+{
+   if ((lc->tex == NULL) || (gl_texUses( lc->tex ) != 1) ||
+         (gl_screen.current_fbo == lc->fbo) ||
+         (previous_fbo_set && (previous_fbo == lc->fbo))) {
+      canvas_destroy( lc );
+      return;
+   }
+
+   if (canvas_pool == NULL)
+      canvas_pool = array_create_size( LuaCanvas_t, CANVAS_POOL_MAX );
+   else if (array_size(canvas_pool) >= CANVAS_POOL_MAX) {
+      canvas_destroy( &canvas_pool[0] );
+      array_erase( &canvas_pool, &canvas_pool[0], &canvas_pool[1] );
+   }
+   array_push_back( &canvas_pool, *lc );
+}
+
+/**
+ * @brief Frees the unused canvases.
+ *
+ * Has to be called after the Lua states are closed and before OpenGL.
+ */
+void canvas_exit (void)
+{
+   for (int i=0; i<array_size(canvas_pool); i++)
+      canvas_destroy( &canvas_pool[i] );
+   array_free( canvas_pool );
+   canvas_pool = NULL;
+}
+
 /**
  * @brief Opens a new canvas.
  *
@@ -230,6 +301,7 @@ static int canvasL_new( lua_State *L )
  */
 static int canvasL_set( lua_State *L )
 {
+   nlua_gfxFlush();
    if (!lua_isnoneornil(L,1)) {
       const LuaCanvas_t *lc = luaL_checkcanvas(L,1);
       if (!previous_fbo_set) {
@@ -290,6 +362,7 @@ static int canvasL_clear( lua_State *L )
    const LuaCanvas_t *lc = luaL_checkcanvas(L,1);
    (void) lc; /* Just to enforce good practice, canvas should be already set. */
    const glColour *c = luaL_optcolour(L,2,&cBlack);
+   nlua_gfxFlush();
    glClearColor( c->r, c->g, c->b, c->a );
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
    glClearColor( 0.0, 0.0, 0.0, 1.0 );
@@ -301,6 +374,7 @@ static int canvasL_clear( lua_State *L )
  */
 void canvas_reset (void)
 {
+   nlua_gfxFlush();
    if (!previous_fbo_set)
       return;
    gl_screen.current_fbo = previous_fbo;
@@ -37,3 +37,4 @@ int lua_iscanvas( lua_State *L, int ind );
  */
 int canvas_new( LuaCanvas_t *lc, int w, int h );
 void canvas_reset (void);
+void canvas_exit (void);
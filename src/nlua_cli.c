@@ -10,6 +10,8 @@
 
 /** @cond */
 #include <lauxlib.h>
+#include <stdlib.h>
+#include "SDL_timer.h"
 
 #include "naev.h"
 /** @endcond */
@@ -19,13 +21,24 @@
 #include "log.h"
 #include "mission.h"
 #include "nluadef.h"
+#include "nstring.h"
 
+#define BENCH_RUNS_DEFAULT    1000 /**< Default number of timed calls. */
 
 /* CLI */
 static const luaL_Reg cli_methods[] = {
    {0,0}
 }; /**< CLI Lua methods. */
 
+/* Bench */
+static int benchL_run( lua_State *L );
+static int benchL_report( lua_State *L );
+static const luaL_Reg bench_methods[] = {
+   { "run", benchL_run },
+   { "report", benchL_report },
+   {0,0}
+}; /**< Benchmark Lua methods. */
+
 
 /**
  * @brief Loads the CLI Lua library.
@@ -36,5 +49,171 @@ static const luaL_Reg cli_methods[] = {
 int nlua_loadCLI( nlua_env env )
 {
    nlua_register(env, "cli", cli_methods, 0);
+   nlua_register(env, "bench", bench_methods, 0);
    return 0;
 }
+
+/**
+ * @brief Lua bindings to time functions from the console.
+ *
+ * Functions get called a number of times after some warmup calls, timing each
+ *  one of them. Garbage collection is stopped while timing so that the Lua
+ *  memory allocated by the calls can be measured.
+ *
+ * @code
+ * bench.report( "pilot.get", pilot.get ) -- Prints the timings
+ * local t = bench.run( system.jumpPath, 100, 10, system.cur(), "Delta Pavonis" )
+ * print( t.p99 )
+ * @endcode
+ *
+ * @luamod bench
+ */
+/**
+ * @brief Compares two doubles, for use with qsort.
+ */
+static int bench_cmp( const void *p1, const void *p2 )
+{
+   double d1 = *(const double*) p1;
+   double d2 = *(const double*) p2;
+   return (d1 > d2) - (d1 < d2);
+}
+
+/**
+ * @brief Gets the amount of memory used by Lua in bytes.
+ */
+static double bench_luaMem( lua_State *L )
+{
+   return 1024. * lua_gc( L, LUA_GCCOUNT, 0 ) + lua_gc( L, LUA_GCCOUNTB, 0 );
+}
+
+/**
+ * @brief Times a function, pushing the results as a table.
+ *
+ *    @param L Lua state with the function at index f, followed by the runs,
+ *             warmup runs and arguments.
+ *    @param f Index of the function to time.
+ */
+static void bench_run( lua_State *L, int f )
+{
+   int n, warmup, nargs;
+   double *t, mem, mean;
+   Uint64 freq = SDL_GetPerformanceFrequency();
+
+   luaL_checktype( L, f, LUA_TFUNCTION );
+   n      = luaL_optinteger( L, f+1, BENCH_RUNS_DEFAULT );
+   warmup = luaL_optinteger( L, f+2, MAX( 1, n/10 ) );
+   nargs  = MAX( 0, lua_gettop(L) - (f+2) );
+   if (n <= 0)
+      luaL_error( L, _("Number of runs must be positive.") );
+
+   /* Warm up. */
+   for (int i=0; i<warmup; i++) {
+      lua_pushvalue( L, f );
+      for (int j=0; j<nargs; j++)
+         lua_pushvalue( L, f+3+j );
+      lua_call( L, nargs, 0 );
+   }
+
+   /* Time the calls without the garbage collector getting in the way. */
+   t = malloc( n * sizeof(double) );
+   lua_gc( L, LUA_GCCOLLECT, 0 );
+   lua_gc( L, LUA_GCSTOP, 0 );
+   mem = bench_luaMem( L );
+   for (int i=0; i<n; i++) {
+      Uint64 start;
+      lua_pushvalue( L, f );
+      for (int j=0; j<nargs; j++)
+         lua_pushvalue( L, f+3+j );
+      start = SDL_GetPerformanceCounter();
+      if (lua_pcall( L, nargs, 0, 0 )) {
+         free( t );
+         lua_gc( L, LUA_GCRESTART, 0 );
+         lua_error( L );
+      }
+      t[i] = 1000. * (double)(SDL_GetPerformanceCounter() - start) / (double)freq;
+   }
+   mem = bench_luaMem( L ) - mem;
+   lua_gc( L, LUA_GCRESTART, 0 );
+
+   /* Statistics. */
+   mean = 0.;
+   for (int i=0; i<n; i++)
+      mean += t[i];
+   mean /= n;
+   qsort( t, n, sizeof(double), bench_cmp );
+
+   lua_newtable( L );
+   lua_pushinteger( L, n );
+   lua_setfield( L, -2, "n" );
+   lua_pushnumber( L, mean );
+   lua_setfield( L, -2, "mean" );
+   lua_pushnumber( L, t[0] );
+   lua_setfield( L, -2, "min" );
+   lua_pushnumber( L, t[n/2] );
+   lua_setfield( L, -2, "p50" );
+   lua_pushnumber( L, t[(n*9)/10] );
+   lua_setfield( L, -2, "p90" );
+   lua_pushnumber( L, t[(n*99)/100] );
+   lua_setfield( L, -2, "p99" );
+   lua_pushnumber( L, t[n-1] );
+   lua_setfield( L, -2, "max" );
+   lua_pushnumber( L, mem / n );
+   lua_setfield( L, -2, "alloc" );
+   free( t );
+}
+
+/**
+ * @brief Times a function.
+ *
+ * Timings are in milliseconds, and the allocations are the Lua memory in
+ *  bytes allocated on average by each call.
+ *
+ *    @luatparam function f Function to time.
+ *    @luatparam[opt=1000] number n Number of timed calls.
+ *    @luatparam[opt=n/10] number warmup Number of calls to do before timing.
+ *    @luaparam ... Arguments to pass to the function.
+ *    @luatreturn table Table with the fields n, mean, min, p50, p90, p99, max
+ *             and alloc.
+ * @luafunc run
+ */
+static int benchL_run( lua_State *L )
+{
+   bench_run( L, 1 );
+   return 1;
+}
+
+/**
+ * @brief Times a function and prints the results.
+ *
+ *    @luatparam string name Name to print the results with.
+ *    @luatparam function f Function to time.
+ *    @luatparam[opt=1000] number n Number of timed calls.
+ *    @luatparam[opt=n/10] number warmup Number of calls to do before timing.
+ *    @luaparam ... Arguments to pass to the function.
+ *    @luatreturn table Same table bench.run returns.
+ * @luafunc report
+ */
+static int benchL_report( lua_State *L )
+{
+   char buf[STRMAX_SHORT];
+   int t;
+   const char *name = luaL_checkstring( L, 1 );
+   bench_run( L, 2 );
+   t = lua_gettop( L );
+
+#define BENCH_FIELD(s) \
+   (lua_getfield( L, t, s ), lua_tonumber( L, -1 ))
+   snprintf( buf, sizeof(buf),
+         _("%s: mean %.4f ms, p50 %.4f ms, p90 %.4f ms, p99 %.4f ms, max %.4f ms, %.0f B/call (%d runs)"),
+         name, BENCH_FIELD("mean"), BENCH_FIELD("p50"), BENCH_FIELD("p90"),
+         BENCH_FIELD("p99"), BENCH_FIELD("max"), BENCH_FIELD("alloc"),
+         (int)BENCH_FIELD("n") );
+   lua_settop( L, t );
+#undef BENCH_FIELD
+
+   /* Print through the console. */
+   nlua_getenv( L, __NLUA_CURENV, "print" );
+   lua_pushstring( L, buf );
+   lua_call( L, 1, 0 );
+   return 1;
+}
@@ -16,6 +16,52 @@
 
 #include "log.h"
 #include "nluadef.h"
+#include "perlin.h"
+#include "threadpool.h"
+
+#define DATA_CHUNK_ELEMS   (64*1024) /**< Minimum number of elements per thread for the element wise operations. */
+#define DATA_CHUNK_MACS    (256*1024) /**< Minimum number of multiply-adds per thread when convolving. */
+
+/**
+ * @brief Arguments of addWeighted shared by the threads.
+ */
+typedef struct DataWeighted_ {
+   const float *a;   /**< First operand. */
+   const float *b;   /**< Second operand. */
+   float *o;         /**< Output. */
+   float alpha;      /**< Weight of the first operand. */
+   float beta;       /**< Weight of the second operand. */
+   float bias;       /**< Bias added to the output. */
+} DataWeighted;
+
+/**
+ * @brief Arguments of convolve2d shared by the threads.
+ */
+typedef struct DataConvolve_ {
+   const float *B;   /**< Padded input. */
+   const float *K;   /**< Kernel. */
+   float *O;         /**< Output. */
+   int bw;           /**< Width of the padded input. */
+   int kw;           /**< Width of the kernel. */
+   int kh;           /**< Height of the kernel. */
+   int ow;           /**< Width of the output. */
+} DataConvolve;
+
+/**
+ * @brief Arguments of simplex shared by the threads.
+ */
+typedef struct DataSimplex_ {
+   float *o;         /**< Output. */
+   int w;            /**< Width of the output. */
+   float x;          /**< X position of the first sample. */
+   float y;          /**< Y position of the first sample. */
+   float z;          /**< Z position of the slice. */
+   float dx;         /**< Distance between samples along X. */
+   float dy;         /**< Distance between samples along Y. */
+   int dim;          /**< Dimension of the noise, 2 or 3. */
+} DataSimplex;
+
+static perlin_data_t *data_noise = NULL; /**< Noise generator shared by the data. */
 
 /* Helper functions. */
 static size_t dataL_checkpos( lua_State *L, const LuaData_t *ld, long pos );
@@ -31,6 +77,10 @@ static int dataL_getString( lua_State *L );
 static int dataL_paste( lua_State *L );
 static int dataL_addWeighted( lua_State *L );
 static int dataL_convolve2d( lua_State *L );
+static int dataL_simplex( lua_State *L );
+static int data_weightedRange( void *data, int start, int end );
+static int data_convolveRows( void *data, int start, int end );
+static int data_simplexRows( void *data, int start, int end );
 static const luaL_Reg dataL_methods[] = {
    { "__gc", dataL_gc },
    { "__eq", dataL_eq },
@@ -42,6 +92,7 @@ static const luaL_Reg dataL_methods[] = {
    { "paste", dataL_paste },
    { "addWeighted", dataL_addWeighted },
    { "convolve2d", dataL_convolve2d },
+   { "simplex", dataL_simplex },
    {0,0}
 }; /**< Data metatable methods. */
 
@@ -278,6 +329,10 @@ static int dataL_getString( lua_State *L )
  *    @luatparam number dx Offset from start of destination.
  *    @luatparam number sx Offset from start of source.
  *    @luatparam number sw Number of data elements to copy.
+ *    @luatparam[opt=1] number rows Number of rows to copy, for pasting
+ *       rectangles of images in a single call.
+ *    @luatparam[opt=sw] number dstride Elements between rows of destination.
+ *    @luatparam[opt=sw] number sstride Elements between rows of source.
  * @luafunc paste
  */
 static int dataL_paste( lua_State *L )
@@ -287,17 +342,31 @@ static int dataL_paste( lua_State *L )
    long dx = luaL_checklong(L,3) * dest->elem;
    long sx = luaL_checklong(L,4) * source->elem;
    long sw = luaL_checklong(L,5) * source->elem;
+   long rows = luaL_optlong(L,6,1);
+   long ds = luaL_optlong(L,7,sw/source->elem) * dest->elem;
+   long ss = luaL_optlong(L,8,sw/source->elem) * source->elem;
    char *ddata = dest->data;
    const char *sdata = source->data;
+   long dend, send;
 
-   /* Check fits. */
-   if (dx+sw > (long)dest->size)
-      return NLUA_ERROR(L, _("size mismatch: out of bound access dest: %d of %d elements"), dx+sw, dest->size);
-   else if (sx+sw > (long)source->size)
-      return NLUA_ERROR(L, _("size mismatch: out of bound access of source: %d of %d elements"), sx+sw, source->size);
+   if (rows <= 0)
+      return NLUA_ERROR(L, _("invalid number of rows: %d"), rows);
+   dend = dx + (rows-1)*ds + sw;
+   send = sx + (rows-1)*ss + sw;
 
-   /* Copy memory over. */
-   memcpy( &ddata[dx], &sdata[sx], sw );
+   /* Check fits. */
+   if ((dx < 0) || (dend > (long)dest->size))
+      return NLUA_ERROR(L, _("size mismatch: out of bound access dest: %d of %d elements"), dend, dest->size);
+   else if ((sx < 0) || (send > (long)source->size))
+      return NLUA_ERROR(L, _("size mismatch: out of bound access of source: %d of %d elements"), send, source->size);
+
+   /* Copy memory over, in one go when the rows are contiguous. */
+   if ((ds == sw) && (ss == sw))
+      memmove( &ddata[dx], &sdata[sx], sw*rows );
+   else {
+      for (long r=0; r<rows; r++)
+         memmove( &ddata[dx+r*ds], &sdata[sx+r*ss], sw );
+   }
 
    /* Return destination. */
    lua_pushvalue(L,1);
@@ -323,8 +392,8 @@ static int dataL_addWeighted( lua_State *L )
    double alpha = luaL_checknumber(L,3);
    double beta = luaL_optnumber(L,4,1.-alpha);
    double bias = luaL_optnumber(L,5,0.);
-   int i, n;
-   float *o, *a, *b;
+   DataWeighted dw;
+   int n;
 
    /* Checks. */
    if (A->size != B->size)
@@ -338,19 +407,73 @@ static int dataL_addWeighted( lua_State *L )
    out.type = A->type;
    out.data = malloc( out.size );
 
-   /* Interpolate. */
+   /* Interpolate, large buffers are split across the threads. */
    n = out.size / out.elem;
-   a = (float*)A->data;
-   b = (float*)B->data;
-   o = (float*)out.data;
-   for (i=0; i<n; i++)
-      o[i] = a[i]*alpha + b[i]*beta + bias;
+   dw.a     = (const float*)A->data;
+   dw.b     = (const float*)B->data;
+   dw.o     = (float*)out.data;
+   dw.alpha = alpha;
+   dw.beta  = beta;
+   dw.bias  = bias;
+   if (n > DATA_CHUNK_ELEMS)
+      job_parallelFor( n, DATA_CHUNK_ELEMS, data_weightedRange, &dw );
+   else
+      data_weightedRange( &dw, 0, n );
 
    /* Return new data. */
    lua_pushdata(L,out);
    return 1;
 }
 
+/**
+ * @brief Computes part of addWeighted.
+ *
+ * Kept in single precision without aliasing so the compiler vectorises it.
+ */
+static int data_weightedRange( void *data, int start, int end )
+{
+   const DataWeighted *dw = data;
+   const float *restrict a = dw->a;
+   const float *restrict b = dw->b;
+   float *restrict o = dw->o;
+   const float alpha = dw->alpha;
+   const float beta  = dw->beta;
+   const float bias  = dw->bias;
+   for (int i=start; i<end; i++)
+      o[i] = a[i]*alpha + b[i]*beta + bias;
+   return 0;
+}
+
+#define POS(U,V,W)   (4*((V)*(W)+(U)))
+/**
+ * @brief Convolves some rows of the output of convolve2d.
+ *
+ * Each kernel weight is applied along a whole row at a time, which walks the
+ *  memory linearly and can be vectorised unlike going pixel by pixel.
+ */
+static int data_convolveRows( void *data, int start, int end )
+{
+   const DataConvolve *dc = data;
+   const int ow = dc->ow;
+   for (int v=start; v<end; v++) {
+      float *restrict o = &dc->O[ POS( 0, v, ow ) ];
+      for (int kv=0; kv<dc->kh; kv++) {
+         for (int ku=0; ku<dc->kw; ku++) {
+            const float *restrict b = &dc->B[ POS( ku, v+kv, dc->bw ) ];
+            const float *k = &dc->K[ POS( ku, kv, dc->kw ) ];
+            const float k0=k[0], k1=k[1], k2=k[2], k3=k[3];
+            for (int u=0; u<ow; u++) {
+               o[4*u+0] += b[4*u+0] * k0;
+               o[4*u+1] += b[4*u+1] * k1;
+               o[4*u+2] += b[4*u+2] * k2;
+               o[4*u+3] += b[4*u+3] * k3;
+            }
+         }
+      }
+   }
+   return 0;
+}
+
 /**
  * @brief Does a convolution. You'd rather be writing shaders, right?
  *
@@ -374,8 +497,9 @@ static int dataL_convolve2d( lua_State *L )
    LuaData_t out;
    int kw2,kh2, bw,bh, ow,oh;
    const float *I = (const float*)lI->data;
-   const float *K = (const float*)lK->data;
-   float *B, *O;
+   DataConvolve dc;
+   float *B;
+   long macs;
 
    /* Checks. */
    if (iw*ih*4*lI->elem != lI->size)
@@ -396,9 +520,7 @@ static int dataL_convolve2d( lua_State *L )
    out.type = lI->type;
    out.size = ow*oh*4*out.elem;
    out.data = calloc( out.size, 1 );
-   O = (float*)out.data;
 
-#define POS(U,V,W)   (4*((V)*(W)+(U)))
    /* Create buffer. */
    bw = ow+2*kw2;
    bh = oh+2*kh2;
@@ -407,24 +529,22 @@ static int dataL_convolve2d( lua_State *L )
       memcpy( &B[ POS(kw2, v+kh2, bw) ],
               &I[ POS(  0,     v, iw) ],
               4*sizeof(float)*iw );
-
-   /* Convolve. */
-   for (int v=0; v<oh; v++) {
-      for (int u=0; u<ow; u++) {
-         for (int kv=0; kv<kh; kv++) {
-            for (int ku=0; ku<kw; ku++) {
-               int bu = u + ku;
-               int bv = v + kv;
-               for (int p=0; p<4; p++)
-                  O[ POS( u, v, ow )+p ] +=
-                        B[ POS( bu, bv, bw )+p ]
-                        * K[ POS( ku, kv, kw )+p ];
-            }
-         }
-      }
-   }
 #undef POS
 
+   /* Convolve, rows are split across the threads when there is enough. */
+   dc.B  = B;
+   dc.K  = (const float*)lK->data;
+   dc.O  = (float*)out.data;
+   dc.bw = bw;
+   dc.kw = kw;
+   dc.kh = kh;
+   dc.ow = ow;
+   macs = (long)ow*oh*kw*kh;
+   if (macs > DATA_CHUNK_MACS)
+      job_parallelFor( oh, MAX( 1, DATA_CHUNK_MACS / MAX( 1, macs/oh ) ), data_convolveRows, &dc );
+   else
+      data_convolveRows( &dc, 0, oh );
+
    /* Cleanup. */
    free(B);
 
@@ -434,3 +554,77 @@ static int dataL_convolve2d( lua_State *L )
    lua_pushinteger(L,oh);
    return 3;
 }
+
+/**
+ * @brief Computes rows of simplex.
+ */
+static int data_simplexRows( void *data, int start, int end )
+{
+   const DataSimplex *ds = data;
+   float *o = &ds->o[ start*ds->w ];
+   float y  = ds->y + (float)start*ds->dy;
+   if (ds->dim == 3)
+      noise_simplex3Grid( data_noise, ds->x, y, ds->z, ds->dx, ds->dy, ds->w, end-start, o );
+   else
+      noise_simplex2Grid( data_noise, ds->x, y, ds->dx, ds->dy, ds->w, end-start, o );
+   return 0;
+}
+
+/**
+ * @brief Creates a grid of simplex noise, much faster than sampling it from Lua.
+ *
+ * The noise is the same across calls, so grids at different positions or
+ *  scales can be combined into octaves.
+ *
+ * @usage d = data.simplex( 256, 256, 0, 0, 1/64 ) -- 256x256 grid of 2D noise
+ * @usage d = data.simplex( 256, 256, 0, 0, 1/64, nil, t ) -- slice of 3D noise at t
+ *
+ *    @luatparam number w Width of the grid.
+ *    @luatparam number h Height of the grid.
+ *    @luatparam number x X position of the first sample.
+ *    @luatparam number y Y position of the first sample.
+ *    @luatparam number dx Distance between samples along X.
+ *    @luatparam[opt=dx] number dy Distance between samples along Y.
+ *    @luatparam[opt] number z Z position of the slice, to use 3D noise.
+ *    @luatreturn Data New number data of w*h samples, row-major, about in [-1,1].
+ * @luafunc simplex
+ */
+static int dataL_simplex( lua_State *L )
+{
+   LuaData_t out;
+   DataSimplex ds;
+   int w = luaL_checkinteger(L,1);
+   int h = luaL_checkinteger(L,2);
+
+   if ((w <= 0) || (h <= 0))
+      return NLUA_ERROR(L, _("size must be positive: got %dx%d"), w, h );
+
+   ds.x   = luaL_checknumber(L,3);
+   ds.y   = luaL_checknumber(L,4);
+   ds.dx  = luaL_checknumber(L,5);
+   ds.dy  = luaL_optnumber(L,6,ds.dx);
+   ds.dim = lua_isnoneornil(L,7) ? 2 : 3;
+   ds.z   = luaL_optnumber(L,7,0.);
+   ds.w   = w;
+
+   /* Lazy allocation. */
+   if (data_noise == NULL)
+      data_noise = noise_new();
+
+   /* Create new data. */
+   out.type = LUADATA_NUMBER;
+   out.elem = sizeof(float);
+   out.size = (size_t)w*h*out.elem;
+   out.data = malloc( out.size );
+   ds.o     = (float*)out.data;
+
+   /* Rows are split across the threads when there is enough. */
+   if ((long)w*h > DATA_CHUNK_ELEMS)
+      job_parallelFor( h, MAX( 1, DATA_CHUNK_ELEMS / w ), data_simplexRows, &ds );
+   else
+      data_simplexRows( &ds, 0, h );
+
+   /* Return new data. */
+   lua_pushdata(L,out);
+   return 1;
+}
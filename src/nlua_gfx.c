@@ -29,6 +29,11 @@
 #include "opengl.h"
 #include "array.h"
 
+static int gfx_batching = 0; /**< Whether the textured draws are being batched. */
+static GLuint gfx_batchTex = 0; /**< Texture of the draws being batched. */
+
+static void gfx_batchAdd( const glTexture *tex );
+
 /* GFX methods. */
 static int gfxL_dim( lua_State *L );
 static int gfxL_screencoords( lua_State *L );
@@ -111,6 +116,40 @@ int nlua_loadGFX( nlua_env env )
    return 0;
 }
 
+/**
+ * @brief Batches a textured draw.
+ *
+ * Consecutive draws with the same texture get merged into a single draw call,
+ *  a different texture flushes the previous ones so that the drawing order is
+ *  kept.
+ *
+ *    @param tex Texture about to be drawn.
+ */
+static void gfx_batchAdd( const glTexture *tex )
+{
+   if (!gfx_batching) {
+      gl_batchBegin();
+      gfx_batching = 1;
+   }
+   else if (gfx_batchTex != tex->texture)
+      gl_batchFlush();
+   gfx_batchTex = tex->texture;
+}
+
+/**
+ * @brief Draws the textured draws batched by the Lua.
+ *
+ * Has to be called before drawing anything else or changing the render state,
+ *  and is done automatically when a Lua call returns.
+ */
+void nlua_gfxFlush (void)
+{
+   if (!gfx_batching)
+      return;
+   gfx_batching = 0;
+   gl_batchEnd();
+}
+
 /**
  * @brief Lua bindings to interact with rendering and the Naev graphical environment.
  *
@@ -221,6 +260,7 @@ static int gfxL_renderTex( lua_State *L )
 #endif /* DEBUGGING */
 
    /* Render. */
+   gfx_batchAdd( tex );
    gl_renderStaticSprite( tex, x, y, sx, sy, col );
 
    return 0;
@@ -277,6 +317,7 @@ static int gfxL_renderTexScale( lua_State *L )
 #endif /* DEBUGGING */
 
    /* Render. */
+   gfx_batchAdd( tex );
    gl_renderScaleSprite( tex, x, y, sx, sy, bw, bh, col );
 
    return 0;
@@ -349,6 +390,7 @@ static int gfxL_renderTexRaw( lua_State *L )
    if (th < 0)
       ty -= th;
 
+   gfx_batchAdd( t );
    gl_renderTexture( t, px, py, pw, ph, tx, ty, tw, th, col, angle );
    return 0;
 }
@@ -378,6 +420,10 @@ static int gfxL_renderTexH( lua_State *L )
    col   = luaL_optcolour(L,4,&cWhite);
    TH    = luaL_opttransform( L,5,&ID );
 
+   /* The shader uses its own texture coordinates. */
+   gl_atlasUnpack( t );
+
+   nlua_gfxFlush();
    glUseProgram( shader->program );
 
    /* Set the vertex. */
@@ -409,7 +455,7 @@ static int gfxL_renderTexH( lua_State *L )
    gl_uniformMat4( shader->ClipSpaceFromLocal, H );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shader->VertexPosition );
@@ -452,6 +498,7 @@ static int gfxL_renderRect( lua_State *L )
    col   = luaL_checkcolour( L, 5 );
    empty = lua_toboolean( L, 6 );
 
+   nlua_gfxFlush();
    /* Render. */
    if (empty)
       gl_renderRectEmpty( x, y, w, h, col );
@@ -477,6 +524,7 @@ static int gfxL_renderRectH( lua_State *L )
    int empty = lua_toboolean(L,3);
 
    /* Render. */
+   nlua_gfxFlush();
    gl_renderRectH( H, col, !empty );
 
    return 0;
@@ -506,6 +554,7 @@ static int gfxL_renderCircle( lua_State *L )
    empty = lua_toboolean( L, 5 );
 
    /* Render. */
+   nlua_gfxFlush();
    gl_renderCircle( x, y, r, col, !empty );
 
    return 0;
@@ -528,6 +577,7 @@ static int gfxL_renderCircleH( lua_State *L )
    int empty = lua_toboolean(L,3);
 
    /* Render. */
+   nlua_gfxFlush();
    gl_renderCircleH( H, col, !empty );
 
    return 0;
@@ -554,7 +604,7 @@ static int gfxL_renderLinesH( lua_State *L )
    const glColour *c = luaL_optcolour(L,2,&cWhite);
 
    if (vbo_lines==NULL)
-      vbo_lines = gl_vboCreateDynamic( 256*sizeof(GLfloat)*2, NULL );
+      vbo_lines = gl_vboCreateRing( 256*sizeof(GLfloat)*2 );
 
    while (!lua_isnoneornil(L,i)) {
       if (n >= 256) {
@@ -580,9 +630,10 @@ static int gfxL_renderLinesH( lua_State *L )
       }
    }
 
+   nlua_gfxFlush();
    glUseProgram(shaders.lines.program);
 
-   gl_vboData( vbo_lines, sizeof(GLfloat)*2*n, buf );
+   gl_vboRingData( vbo_lines, sizeof(GLfloat)*2*n, buf );
    glEnableVertexAttribArray( shaders.lines.vertex );
    gl_vboActivateAttribOffset( vbo_lines, shaders.lines.vertex, 0,
          2, GL_FLOAT, 2*sizeof(GLfloat) );
@@ -590,7 +641,7 @@ static int gfxL_renderLinesH( lua_State *L )
    gl_uniformColour(shaders.lines.colour, c);
    gl_uniformMat4(shaders.lines.projection, H);
 
-   glDrawArrays( GL_LINE_STRIP, 0, n );
+   gl_drawArrays( GL_LINE_STRIP, 0, n );
    glUseProgram(0);
 
    /* Check for errors. */
@@ -605,6 +656,7 @@ static int gfxL_renderLinesH( lua_State *L )
 static int gfxL_clearDepth( lua_State *L )
 {
    (void) L;
+   nlua_gfxFlush();
    glClear( GL_DEPTH_BUFFER_BIT );
    return 0;
 }
@@ -781,6 +833,7 @@ static int gfxL_printf( lua_State *L )
    max   = luaL_optinteger(L,6,0);
    mid   = lua_toboolean(L,7);
 
+   nlua_gfxFlush();
    /* Render. */
    if (mid)
       gl_printMidRaw( font, max, x, y, col, 0., str );
@@ -817,6 +870,7 @@ static int gfxL_printH( lua_State *L )
    outline = luaL_optnumber(L,5,0.);
 
    /* Render. */
+   nlua_gfxFlush();
    gl_printRawH( font, H, col, outline, str );
    return 0;
 }
@@ -854,6 +908,7 @@ static int gfxL_print( lua_State *L )
    max   = luaL_optinteger(L,6,0);
    mid   = lua_toboolean(L,7);
 
+   nlua_gfxFlush();
    /* Render. */
    if (mid)
       gl_printMidRaw( font, max, x, y, col, -1., str );
@@ -898,6 +953,7 @@ static int gfxL_printText( lua_State *L )
    lh    = luaL_optinteger(L,8,0);
 
    /* Render. */
+   nlua_gfxFlush();
    gl_printTextRaw( font, w, h, x, y, lh, col, -1., str );
 
    return 0;
@@ -957,6 +1013,7 @@ static int gfxL_setBlendMode( lua_State *L )
    else if (strcmp( mode, "replace" ))
       NLUA_INVALID_PARAMETER(L,1);
 
+   nlua_gfxFlush();
    glBlendEquation(func);
    glBlendFuncSeparate(srcRGB, dstRGB, srcA, dstA);
    gl_checkErr();
@@ -978,6 +1035,7 @@ static int gfxL_setBlendMode( lua_State *L )
  */
 static int gfxL_setScissor( lua_State *L )
 {
+   nlua_gfxFlush();
    if (lua_gettop(L)>0) {
       GLint x   = luaL_optinteger(L,1,0);
       GLint y   = luaL_optinteger(L,2,0);
@@ -1015,6 +1073,7 @@ static int gfxL_screenshot( lua_State * L )
       mustfree = 1;
    }
 
+   nlua_gfxFlush();
    /* Copy over. */
    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lc->fbo);
@@ -1023,9 +1082,13 @@ static int gfxL_screenshot( lua_State * L )
    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
-   /* Return new or old canvas. */
-   lua_pushcanvas(L, *lc);
-   if (mustfree)
+   /* Return new or old canvas, the old one must not be duplicated as
+    * both copies would free it. */
+   if (mustfree) {
+      lua_pushcanvas(L, *lc);
       free( lc );
+   }
+   else
+      lua_pushvalue(L, 1);
    return 1;
 }
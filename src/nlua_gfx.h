@@ -9,3 +9,8 @@
  * Library loading
  */
 int nlua_loadGFX( nlua_env env );
+
+/*
+ * Batching.
+ */
+void nlua_gfxFlush (void);
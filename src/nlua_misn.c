@@ -599,6 +599,7 @@ static int misn_accept( lua_State *L )
       misnptr = lua_newuserdata( L, sizeof(Mission*) );
       *misnptr = cur_mission;
       nlua_setenv( L, cur_mission->env, "__misn" );
+      missions_runningChanged();
    }
 
    lua_pushboolean(L,!ret); /* we'll convert C style return to Lua */
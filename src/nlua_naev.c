@@ -30,9 +30,13 @@
 #include "pause.h"
 #include "player.h"
 #include "plugin.h"
+#include "replay.h"
 #include "semver.h"
+#include "snapshot.h"
+#include "sound.h"
 
 static int cache_table = LUA_NOREF; /* No reference. */
+static Snapshot *naev_snapshot = NULL; /**< Snapshot taken with naev.snapshot. */
 
 /* Naev methods. */
 static int naevL_version( lua_State *L );
@@ -70,6 +74,10 @@ static int naevL_hasTextInput( lua_State *L );
 static int naevL_setTextInput( lua_State *L );
 static int naevL_unit( lua_State *L );
 static int naevL_quadtreeParams( lua_State *L );
+static int naevL_spatialIndex( lua_State *L );
+static int naevL_soundMemory( lua_State *L );
+static int naevL_snapshot( lua_State *L );
+static int naevL_snapshotRestore( lua_State *L );
 #if DEBUGGING
 static int naevL_envs( lua_State *L );
 #endif /* DEBUGGING */
@@ -109,6 +117,10 @@ static const luaL_Reg naev_methods[] = {
    { "setTextInput", naevL_setTextInput },
    { "unit", naevL_unit },
    { "quadtreeParams", naevL_quadtreeParams },
+   { "spatialIndex", naevL_spatialIndex },
+   { "soundMemory", naevL_soundMemory },
+   { "snapshot", naevL_snapshot },
+   { "snapshotRestore", naevL_snapshotRestore },
 #if DEBUGGING
    { "envs", naevL_envs },
 #endif /* DEBUGGING */
@@ -212,8 +224,8 @@ static int naevL_language( lua_State *L )
  */
 static int naevL_lastplayed( lua_State *L )
 {
-   double d = difftime( time(NULL), player.last_played );
-   double g = difftime( time(NULL), conf.last_played );
+   double d = replay_value( difftime( time(NULL), player.last_played ) );
+   double g = replay_value( difftime( time(NULL), conf.last_played ) );
    lua_pushnumber(L, d/(3600.*24.)); /*< convert to days */
    lua_pushnumber(L, g/(3600.*24.)); /*< convert to days */
    return 2;
@@ -243,7 +255,7 @@ static int naevL_ticksGame( lua_State *L )
  */
 static int naevL_ticks( lua_State *L )
 {
-   lua_pushnumber(L, (double)SDL_GetTicks64() / 1000.);
+   lua_pushnumber(L, (double)replay_ticks() / 1000.);
    return 1;
 }
 
@@ -255,7 +267,7 @@ static int naevL_ticks( lua_State *L )
  */
 static int naevL_clock( lua_State *L )
 {
-   lua_pushnumber(L, (double)clock() / (double)CLOCKS_PER_SEC );
+   lua_pushnumber(L, replay_value( (double)clock() / (double)CLOCKS_PER_SEC ) );
    return 1;
 }
 
@@ -919,6 +931,106 @@ static int naevL_quadtreeParams( lua_State *L )
    return 0;
 }
 
+/**
+ * @brief Sets the spatial index used for the pilot collision queries.
+ *
+ * Takes effect when entering a system.
+ *
+ *    @luatparam string index Either "quadtree" or "grid".
+ *    @luatparam[opt] number cell_size Size of the grid cells.
+ * @luafunc spatialIndex
+ */
+static int naevL_spatialIndex( lua_State *L )
+{
+   const char *index = luaL_checkstring( L, 1 );
+   int cell_size = luaL_optinteger( L, 2, 0 );
+   if (strcmp(index,"quadtree")==0)
+      pilot_spatialIndexParams( PILOT_SPATIAL_QUADTREE, cell_size );
+   else if (strcmp(index,"grid")==0)
+      pilot_spatialIndexParams( PILOT_SPATIAL_GRID, cell_size );
+   else
+      return NLUA_ERROR( L, _("Unknown spatial index '%s'!"), index );
+   return 0;
+}
+
+/**
+ * @brief Takes a snapshot of the simulation of the current system.
+ *
+ * Replaces the previous snapshot. Meant to be used from the console to replay
+ *  fights from the same state.
+ *
+ * @usage naev.snapshot() -- Take a snapshot before the fight
+ *
+ *    @luatreturn number Size of the snapshot in bytes.
+ * @luafunc snapshot
+ */
+static int naevL_snapshot( lua_State *L )
+{
+   snapshot_free( naev_snapshot );
+   naev_snapshot = snapshot_take();
+   if (naev_snapshot == NULL)
+      return NLUA_ERROR( L, _("Unable to take snapshot!") );
+   lua_pushinteger( L, snapshot_size( naev_snapshot ) );
+   return 1;
+}
+
+/**
+ * @brief Restores the simulation of the current system to the last snapshot.
+ *
+ * Pilots that appeared since are removed, and weapons in flight are cleared.
+ *
+ * @usage naev.snapshotRestore() -- Go back to before the fight
+ *
+ *    @luatreturn number Number of pilots of the snapshot that no longer exist.
+ * @luafunc snapshotRestore
+ */
+static int naevL_snapshotRestore( lua_State *L )
+{
+   int missing;
+   if (naev_snapshot == NULL)
+      return NLUA_ERROR( L, _("No snapshot to restore!") );
+   missing = snapshot_restore( naev_snapshot );
+   if (missing < 0)
+      return NLUA_ERROR( L, _("Unable to restore snapshot!") );
+   lua_pushinteger( L, missing );
+   return 1;
+}
+
+/**
+ * @brief Gets the memory used by the loaded sounds.
+ *
+ * Meant to be used from the console to find out which sounds should be
+ *  streamed.
+ *
+ * @usage total, sounds = naev.soundMemory()
+ *
+ *    @luatreturn number Total bytes used by the sounds.
+ *    @luatreturn table Table with a table for each sound with the fields "name",
+ *                      "bytes" and "streamed".
+ * @luafunc soundMemory
+ */
+static int naevL_soundMemory( lua_State *L )
+{
+   size_t total = 0;
+   lua_newtable( L );
+   for (int i=0; i<sound_count(); i++) {
+      int streamed;
+      size_t mem = sound_memory( i, &streamed );
+      total += mem;
+      lua_newtable( L );
+      lua_pushstring( L, sound_name(i) );
+      lua_setfield( L, -2, "name" );
+      lua_pushinteger( L, mem );
+      lua_setfield( L, -2, "bytes" );
+      lua_pushboolean( L, streamed );
+      lua_setfield( L, -2, "streamed" );
+      lua_rawseti( L, -2, i+1 );
+   }
+   lua_pushinteger( L, total );
+   lua_insert( L, -2 );
+   return 2;
+}
+
 #if DEBUGGING
 /**
  * @brief Gets a table with all the active Naev environments.
@@ -456,7 +456,7 @@ static int outfitL_limit( lua_State *L )
 static int outfitL_icon( lua_State *L )
 {
    const Outfit *o = luaL_validoutfit(L,1);
-   lua_pushtex( L, gl_dupTexture( o->gfx_store ) );
+   lua_pushtex( L, gl_dupTexture( outfit_gfxStore( o ) ) );
    return 1;
 }
 
@@ -15,6 +15,7 @@
 #include "nlua_pilot.h"
 
 #include "ai.h"
+#include "arena.h"
 #include "array.h"
 #include "camera.h"
 #include "damagetype.h"
@@ -53,6 +54,19 @@
  */
 extern Pilot *cur_pilot;
 
+/**
+ * @brief Data of the pilot userdata.
+ *
+ * The ID has to come first, as the userdata is used as a LuaPilot.
+ */
+typedef struct LuaPilotData_ {
+   LuaPilot id;         /**< ID of the pilot. */
+   unsigned int epoch;  /**< Pilot epoch p was looked up at, 0 if never. */
+   Pilot *p;            /**< Cached pilot, only valid during its epoch. */
+} LuaPilotData;
+
+static const void *pilotL_metatable = NULL; /**< Pilot metatable, to check types quickly. */
+
 /*
  * Prototypes.
  */
@@ -61,6 +75,7 @@ static Task *pilotL_newtask( lua_State *L, Pilot* p, const char *task );
 static int outfit_compareActive( const void *slot1, const void *slot2 );
 static int pilotL_setFlagWrapper( lua_State *L, int flag );
 static int pilot_outfitAddSlot( Pilot *p, const Outfit *o, PilotOutfitSlot *s, int bypass_cpu, int bypass_slot );
+static void pilot_outfitsChanged( Pilot *p );
 static int luaL_checkweapset( lua_State *L, int idx );
 static PilotOutfitSlot *luaL_checkslot( lua_State *L, Pilot *p, int idx );
 
@@ -118,6 +133,7 @@ static int pilotL_position( lua_State *L );
 static int pilotL_velocity( lua_State *L );
 static int pilotL_isStopped( lua_State *L );
 static int pilotL_dir( lua_State *L );
+static int pilotL_state( lua_State *L );
 static int pilotL_signature( lua_State *L );
 static int pilotL_temp( lua_State *L );
 static int pilotL_mass( lua_State *L );
@@ -167,6 +183,7 @@ static int pilotL_outfitAddSlot( lua_State *L );
 static int pilotL_outfitRmSlot( lua_State *L );
 static int pilotL_outfitAddIntrinsic( lua_State *L );
 static int pilotL_outfitRmIntrinsic( lua_State *L );
+static int pilotL_outfitsBatch( lua_State *L );
 static int pilotL_getFuel( lua_State *L );
 static int pilotL_setFuel( lua_State *L );
 static int pilotL_intrinsicReset( lua_State *L );
@@ -307,6 +324,7 @@ static const luaL_Reg pilotL_methods[] = {
    { "vel", pilotL_velocity },
    { "isStopped", pilotL_isStopped },
    { "dir", pilotL_dir },
+   { "state", pilotL_state },
    { "signature", pilotL_signature },
    { "temp", pilotL_temp },
    { "mass", pilotL_mass },
@@ -384,6 +402,7 @@ static const luaL_Reg pilotL_methods[] = {
    { "outfitRmSlot", pilotL_outfitRmSlot },
    { "outfitAddIntrinsic", pilotL_outfitAddIntrinsic },
    { "outfitRmIntrinsic", pilotL_outfitRmIntrinsic },
+   { "outfitsBatch", pilotL_outfitsBatch },
    { "fuel", pilotL_getFuel },
    { "setFuel", pilotL_setFuel },
    { "intrinsicReset", pilotL_intrinsicReset },
@@ -469,6 +488,11 @@ int nlua_loadPilot( nlua_env env )
 {
    nlua_register(env, PILOT_METATABLE, pilotL_methods, 1);
 
+   /* The metatable is shared by all the environments. */
+   lua_getfield(naevL, LUA_REGISTRYINDEX, PILOT_METATABLE);
+   pilotL_metatable = lua_topointer(naevL, -1);
+   lua_pop(naevL, 1);
+
    /* Pilot always loads ship and asteroid. */
    nlua_loadShip(env);
    nlua_loadAsteroid(env);
@@ -521,7 +545,7 @@ static int pilotL_setFlagWrapper( lua_State *L, int flag )
  */
 LuaPilot lua_topilot( lua_State *L, int ind )
 {
-   return *((LuaPilot*) lua_touserdata(L,ind));
+   return ((LuaPilotData*) lua_touserdata(L,ind))->id;
 }
 /**
  * @brief Gets pilot at index or raises error if there is no pilot at index.
@@ -546,8 +570,25 @@ LuaPilot luaL_checkpilot( lua_State *L, int ind )
  */
 Pilot* luaL_validpilot( lua_State *L, int ind )
 {
-   Pilot *p = pilot_get(luaL_checkpilot(L,ind));
-   if (p==NULL) {
+   LuaPilotData *lp;
+   Pilot *p;
+
+   if (!lua_ispilot(L,ind)) {
+      luaL_typerror(L, ind, PILOT_METATABLE);
+      return NULL;
+   }
+
+   /* Use the cached pilot until the pilots change. */
+   lp = (LuaPilotData*) lua_touserdata(L,ind);
+   if ((lp->p != NULL) && (lp->epoch == pilot_epoch()))
+      p = lp->p;
+   else {
+      p = pilot_get( lp->id );
+      lp->p     = p;
+      lp->epoch = pilot_epoch();
+   }
+
+   if ((p==NULL) || pilot_isFlag(p, PILOT_DELETE)) {
       NLUA_ERROR(L,_("Pilot is invalid."));
       return NULL;
    }
@@ -562,11 +603,13 @@ Pilot* luaL_validpilot( lua_State *L, int ind )
  */
 LuaPilot* lua_pushpilot( lua_State *L, LuaPilot pilot )
 {
-   LuaPilot *p = (LuaPilot*) lua_newuserdata(L, sizeof(LuaPilot));
-   *p = pilot;
+   LuaPilotData *p = (LuaPilotData*) lua_newuserdata(L, sizeof(LuaPilotData));
+   p->id    = pilot;
+   p->epoch = 0;
+   p->p     = NULL;
    luaL_getmetatable(L, PILOT_METATABLE);
    lua_setmetatable(L, -2);
-   return p;
+   return &p->id;
 }
 /**
  * @brief Checks to see if ind is a pilot.
@@ -581,13 +624,11 @@ int lua_ispilot( lua_State *L, int ind )
 
    if (lua_getmetatable(L,ind)==0)
       return 0;
-   lua_getfield(L, LUA_REGISTRYINDEX, PILOT_METATABLE);
 
-   ret = 0;
-   if (lua_rawequal(L, -1, -2))  /* does it have the correct mt? */
-      ret = 1;
+   /* Compare with the cached metatable instead of looking it up. */
+   ret = (pilotL_metatable != NULL) && (lua_topointer(L, -1) == pilotL_metatable);
 
-   lua_pop(L, 2);  /* remove both metatables */
+   lua_pop(L, 1);  /* remove the metatable */
    return ret;
 }
 
@@ -1016,12 +1057,12 @@ static int pilotL_getPilots( lua_State *L )
    if (lua_istable(L,1) || lua_isfaction(L,1)) {
       int *factions;
       if (lua_isfaction(L,1)) {
-         factions = array_create( int );
+         factions = array_create_arena( int, 1, arena_frame() );
          array_push_back( &factions, lua_tofaction(L,1) );
       }
       else {
          /* Get table length and preallocate. */
-         factions = array_create_size( int, lua_objlen(L,1) );
+         factions = array_create_arena( int, lua_objlen(L,1), arena_frame() );
          /* Load up the table. */
          lua_pushnil(L);
          while (lua_next(L, 1) != 0) {
@@ -1045,9 +1086,6 @@ static int pilotL_getPilots( lua_State *L )
             }
          }
       }
-
-      /* clean up. */
-      array_free( factions );
    }
    else if ((lua_isnil(L,1)) || (lua_gettop(L) == 0)) {
       /* Now put all the matching pilots in a table. */
@@ -1067,7 +1105,11 @@ static int pilotL_getPilots( lua_State *L )
    return 1;
 }
 
-static int getFriendOrFoeTest( const Pilot *p, const Pilot *plt, int friend, double dd, int inrange, int dis, int fighters, const vec2 *v, LuaFaction lf )
+/*
+ * Helper to test a candidate for getFriendOrFoe, rel is the faction standing
+ * of the candidate as given by faction_classify when not using a pilot.
+ */
+static int getFriendOrFoeTest( const Pilot *p, const Pilot *plt, int friend, double dd, int inrange, int dis, int fighters, const vec2 *v, int rel )
 {
    /* Check if dead. */
    if (pilot_isFlag(plt, PILOT_DELETE))
@@ -1093,7 +1135,7 @@ static int getFriendOrFoeTest( const Pilot *p, const Pilot *plt, int friend, dou
    /* Check appropriate faction. */
    if (friend) {
       if (p==NULL) {
-         if (!areAllies( lf, plt->faction ))
+         if (rel <= 0)
             return 0;
       }
       else {
@@ -1103,7 +1145,7 @@ static int getFriendOrFoeTest( const Pilot *p, const Pilot *plt, int friend, dou
    }
    else {
       if (p==NULL) {
-         if (!areEnemies( lf, plt->faction ))
+         if (rel >= 0)
             return 0;
       }
       else {
@@ -1140,6 +1182,13 @@ static int pilotL_getFriendOrFoe( lua_State *L, int friend )
    const vec2 *v;
    Pilot *const* pilot_stack;
    LuaFaction lf;
+   static const Pilot **fof_pilots = NULL; /* Reused between calls. */
+   static int *fof_rel = NULL;
+
+   if (fof_pilots == NULL) {
+      fof_pilots = array_create( const Pilot* );
+      fof_rel    = array_create( int );
+   }
 
    /* Check if using faction. */
    lf = -1;
@@ -1171,34 +1220,35 @@ static int pilotL_getFriendOrFoe( lua_State *L, int friend )
    else
       dd = -1.;
 
-   /* Now put all the matching pilots in a table. */
+   /* Gather the candidates. */
    pilot_stack = pilot_getAll();
-   lua_newtable(L);
-   k = 1;
+   array_resize( &fof_pilots, 0 );
    if (dist >= 0. && dist < INFINITY) {
-      int x, y, r;
-      const IntList *qt;
-      x = round(v->x);
-      y = round(v->y);
-      r = ceil(dist);
-      qt = pilot_collideQuery( x-r, y-r, x+r, y+r );
-      for (int i=0; i<il_size(qt); i++) {
-         const Pilot *plt = pilot_stack[ il_get( qt, i, 0 ) ];
-
-         if (getFriendOrFoeTest( p, plt, friend, dd, inrange, dis, fighters, v, lf )) {
-            lua_pushpilot(L, plt->id); /* value */
-            lua_rawseti(L,-2, k++); /* table[key] = value */
-         }
-      }
+      const IntList *qt = pilot_getNearby( v->x, v->y, dist );
+      for (int i=0; i<il_size(qt); i++)
+         array_push_back( &fof_pilots, pilot_stack[ il_get( qt, i, 0 ) ] );
    }
    else {
-      for (int i=0; i<array_size(pilot_stack); i++) {
-         const Pilot *plt = pilot_stack[i];
+      for (int i=0; i<array_size(pilot_stack); i++)
+         array_push_back( &fof_pilots, pilot_stack[i] );
+   }
 
-         if (getFriendOrFoeTest( p, plt, friend, dd, inrange, dis, fighters, v, lf )) {
-            lua_pushpilot(L, plt->id); /* value */
-            lua_rawseti(L,-2, k++); /* table[key] = value */
-         }
+   /* Classify all the candidate factions at once when using a faction. */
+   array_resize( &fof_rel, array_size(fof_pilots) );
+   if (p==NULL) {
+      for (int i=0; i<array_size(fof_pilots); i++)
+         fof_rel[i] = fof_pilots[i]->faction;
+      faction_classify( lf, fof_rel, array_size(fof_rel), fof_rel );
+   }
+
+   /* Now put all the matching pilots in a table. */
+   lua_newtable(L);
+   k = 1;
+   for (int i=0; i<array_size(fof_pilots); i++) {
+      const Pilot *plt = fof_pilots[i];
+      if (getFriendOrFoeTest( p, plt, friend, dd, inrange, dis, fighters, v, (p==NULL) ? fof_rel[i] : 0 )) {
+         lua_pushpilot(L, plt->id); /* value */
+         lua_rawseti(L,-2, k++); /* table[key] = value */
       }
    }
    return 1;
@@ -1307,17 +1357,12 @@ static int pilotL_getInrange( lua_State *L )
    const vec2 *v = luaL_checkvector(L,1);
    double d = luaL_checknumber(L,2);
    int dis = lua_toboolean(L,3);
-   int x, y, r;
    const IntList *qt;
    Pilot *const* pilot_stack = pilot_getAll();
 
-   d = pow2(d); /* Square it. */
-
    /* Now put all the matching pilots in a table. */
-   x = round(v->x);
-   y = round(v->y);
-   r = ceil(d);
-   qt = pilot_collideQuery( x-r, y-r, x+r, y+r );
+   qt = pilot_getNearby( v->x, v->y, FABS(d) );
+   d = pow2(d); /* Square it. */
    lua_newtable(L);
    k = 1;
    for (int i=0; i<il_size(qt); i++) {
@@ -2845,6 +2890,37 @@ static int pilotL_dir( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Gets the pilot's position, velocity, direction and health at once.
+ *
+ * Equivalent to calling pos, vel, dir and health, for scripts that need them
+ *  all every frame.
+ *
+ * @usage pos, vel, dir, armour, shield, stress, dis = p:state()
+ *
+ *    @luatparam Pilot p Pilot to get the state of.
+ *    @luatreturn Vec2 The pilot's current position.
+ *    @luatreturn Vec2 The pilot's current velocity.
+ *    @luatreturn number The pilot's current direction (in radians).
+ *    @luatreturn number The armour in % [0:100].
+ *    @luatreturn number The shield in % [0:100].
+ *    @luatreturn number The stress in % [0:100].
+ *    @luatreturn boolean Indicates if pilot is disabled.
+ * @luafunc state
+ */
+static int pilotL_state( lua_State *L )
+{
+   const Pilot *p = luaL_validpilot(L,1);
+   lua_pushvector(L, p->solid.pos);
+   lua_pushvector(L, p->solid.vel);
+   lua_pushnumber(L, p->solid.dir);
+   lua_pushnumber(L,(p->armour_max > 0.) ? p->armour / p->armour_max * 100. : 0. );
+   lua_pushnumber(L,(p->shield_max > 0.) ? p->shield / p->shield_max * 100. : 0. );
+   lua_pushnumber(L, MIN( 1., p->stress / p->armour ) * 100. );
+   lua_pushboolean(L, pilot_isDisabled(p));
+   return 7;
+}
+
 /**
  * @brief Gets the temperature of a pilot.
  *
@@ -3640,12 +3716,31 @@ static int pilot_outfitAddSlot( Pilot *p, const Outfit *o, PilotOutfitSlot *s, i
    }
 
    /* Update GUI if necessary. */
-   if (pilot_isPlayer(p))
+   if (pilot_isPlayer(p) && !pilot_equipBatched(p))
       gui_setShip();
 
    return 1;
 }
 
+/**
+ * @brief Updates the weapon sets and interface after the outfits of a pilot
+ *        changed, once the stats are up to date.
+ */
+static void pilot_outfitsChanged( Pilot *p )
+{
+   /* Update the weapon sets. */
+   if (p->autoweap)
+      pilot_weaponAuto(p);
+
+   /* Update equipment window if operating on the player's pilot. */
+   if (player.p != NULL && player.p == p)
+      outfits_updateEquipmentOutfits();
+
+   /* Update GUI if necessary. */
+   if (pilot_isPlayer(p))
+      gui_setShip();
+}
+
 /**
  * @brief Adds an outfit to a pilot.
  *
@@ -3703,18 +3798,8 @@ static int pilotL_outfitAdd( lua_State *L )
    /* Update stats. */
    if (added > 0) {
       pilot_calcStats( p );
-
-      /* Update the weapon sets. */
-      if (p->autoweap)
-         pilot_weaponAuto(p);
-
-      /* Update equipment window if operating on the player's pilot. */
-      if (player.p != NULL && player.p == p)
-         outfits_updateEquipmentOutfits();
-
-      /* Update GUI if necessary. */
-      if (pilot_isPlayer(p))
-         gui_setShip();
+      if (!pilot_equipBatched(p))
+         pilot_outfitsChanged( p );
    }
 
    lua_pushnumber(L,added);
@@ -3779,18 +3864,8 @@ static int pilotL_outfitAddSlot( lua_State *L )
    /* Update stats. */
    if (added > 0) {
       pilot_calcStats( p );
-
-      /* Update the weapon sets. */
-      if (p->autoweap)
-         pilot_weaponAuto(p);
-
-      /* Update equipment window if operating on the player's pilot. */
-      if (player.p != NULL && player.p == p)
-         outfits_updateEquipmentOutfits();
-
-      /* Update GUI if necessary. */
-      if (pilot_isPlayer(p))
-         gui_setShip();
+      if (!pilot_equipBatched(p))
+         pilot_outfitsChanged( p );
    }
 
    lua_pushboolean(L,added);
@@ -3875,7 +3950,7 @@ static int pilotL_outfitRm( lua_State *L )
    }
 
    /* Update equipment window if operating on the player's pilot. */
-   if (player.p != NULL && player.p == p && removed > 0)
+   if (player.p != NULL && player.p == p && removed > 0 && !pilot_equipBatched(p))
       outfits_updateEquipmentOutfits();
 
    lua_pushnumber( L, removed );
@@ -3906,7 +3981,7 @@ static int pilotL_outfitRmSlot( lua_State *L )
    if (ret) {
       pilot_calcStats( p ); /* Recalculate stats. */
       /* Update equipment window if operating on the player's pilot. */
-      if (player.p != NULL && player.p == p)
+      if (player.p != NULL && player.p == p && !pilot_equipBatched(p))
          outfits_updateEquipmentOutfits();
    }
 
@@ -3934,7 +4009,7 @@ static int pilotL_outfitAddIntrinsic( lua_State *L )
    lua_pushboolean(L,ret);
 
    /* Update GUI if necessary. */
-   if (pilot_isPlayer(p))
+   if (pilot_isPlayer(p) && !pilot_equipBatched(p))
       gui_setShip();
    return 1;
 }
@@ -3958,6 +4033,43 @@ static int pilotL_outfitRmIntrinsic( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Runs a function that changes the outfits of a pilot, recalculating
+ *        the stats and weapon sets only once at the end.
+ *
+ * The stats of the pilot are not updated while the function runs, so
+ *  anything that checks them, such as adding outfits without bypassing the
+ *  CPU checks, will see the stats from before. Ammo should be filled after
+ *  the batch.
+ *
+ * @usage p:outfitsBatch( function ()
+ *    p:outfitAdd( "Laser Cannon MK1", 2, true )
+ *    p:outfitAdd( "Shield Capacitor I", 1, true )
+ * end )
+ *
+ *    @luatparam Pilot p Pilot to change the outfits of.
+ *    @luatparam function func Function to run, receives the pilot as a parameter.
+ * @luafunc outfitsBatch
+ */
+static int pilotL_outfitsBatch( lua_State *L )
+{
+   Pilot *p = luaL_validpilot(L,1);
+   int ret;
+   luaL_checktype(L,2,LUA_TFUNCTION);
+
+   pilot_equipBegin( p );
+   lua_pushvalue(L,2);
+   lua_pushvalue(L,1);
+   ret = lua_pcall(L,1,0,0);
+   /* The pilot may have died while running the function. */
+   p = pilot_get( luaL_checkpilot(L,1) );
+   if ((p != NULL) && pilot_equipCommit( p ))
+      pilot_outfitsChanged( p );
+   if (ret != 0)
+      return lua_error(L);
+   return 0;
+}
+
 /**
  * @brief Gets the amount of fuel the pilot has.
  *
@@ -4177,7 +4289,7 @@ static int pilotL_effectClear( lua_State *L )
       effect_clear( &p->effects );
    else
       effect_clearSpecific( &p->effects, !keepdebuffs, !keepbuffs, !keepothers );
-   pilot_calcStats( p );
+   pilot_calcStatsEffects( p );
    return 0;
 }
 
@@ -4199,8 +4311,8 @@ static int pilotL_effectAdd( lua_State *L )
    double scale = luaL_optnumber(L,4,1.);
    const EffectData *efx = effect_get( effectname );
    if (efx != NULL) {
-      if (!effect_add( &p->effects, efx, duration, scale, p->id ))
-         pilot_calcStats( p );
+      if (!effect_add( &p->effects, &p->effects_clock, efx, duration, scale, p->id ))
+         pilot_calcStatsEffects( p );
       lua_pushboolean(L,1);
    }
    else
@@ -4222,7 +4334,7 @@ static int pilotL_effectRm( lua_State *L )
    if (lua_isnumber(L,2)) {
       int idx = lua_tointeger(L,2);
       if (effect_rm( &p->effects, idx ))
-         pilot_calcStats( p );
+         pilot_calcStatsEffects( p );
    }
    else {
       const char *effectname = luaL_checkstring(L,2);
@@ -4230,7 +4342,7 @@ static int pilotL_effectRm( lua_State *L )
       const EffectData *efx = effect_get( effectname );
       if (efx != NULL) {
          if (effect_rmType( &p->effects, efx, all ))
-            pilot_calcStats( p );
+            pilot_calcStatsEffects( p );
       }
    }
    return 0;
@@ -4254,10 +4366,10 @@ static int pilotL_effectGet( lua_State *L )
       lua_pushstring(L,e->data->name);
       lua_setfield(L,-2,"name");
 
-      lua_pushnumber(L,e->timer);
+      lua_pushnumber(L,effect_timeLeft( e, &p->effects_clock ));
       lua_setfield(L,-2,"timer");
 
-      lua_pushnumber(L,e->timer);
+      lua_pushnumber(L,e->strength);
       lua_setfield(L,-2,"strength");
 
       lua_pushnumber(L,e->data->duration);
@@ -6348,13 +6460,11 @@ static int pilotL_collisionTest( lua_State *L )
    /* Asteroid treated separately. */
    if (lua_isasteroid(L,2)) {
       Asteroid *a = luaL_validasteroid( L, 2 );
-      CollPoly rpoly;
-      RotatePolygon( &rpoly, a->polygon, (float) a->ang );
-      int ret = CollidePolygon( getCollPoly(p), &p->solid.pos,
-            &rpoly, &a->sol.pos, &crash );
-      free(rpoly.x);
-      free(rpoly.y);
-      if (!ret)
+      const CollPoly *rpoly = asteroid_polygon( a );
+      if (rpoly == NULL)
+         return 0;
+      if (!CollidePolygon( getCollPoly(p), &p->solid.pos,
+            rpoly, &a->sol.pos, &crash ))
          return 0;
       lua_pushvector( L, crash );
       return 1;
@@ -6630,6 +6740,7 @@ static int pilotL_render( lua_State *L )
       return NLUA_ERROR( L, _("Error setting up framebuffer!"));
 
    /* I'me really stumped at why we need to pass gl_screen here for it to work... */
+   nlua_gfxFlush();
    pilot_renderFramebuffer( p, lc.fbo, gl_screen.rw, gl_screen.rh );
 
    lua_pushcanvas( L, lc );
@@ -6657,6 +6768,7 @@ static int pilotL_renderTo( lua_State *L )
             p->ship->gfx_space->sw, p->ship->gfx_space->sh );
 
    /* I'me really stumped at why we need to pass gl_screen here for it to work... */
+   nlua_gfxFlush();
    pilot_renderFramebuffer( p, lc->fbo, gl_screen.rw, gl_screen.rh );
 
    lua_pushnumber( L, p->ship->gfx_space->sw );
@@ -17,8 +17,7 @@
 /**
  * @brief Lua Pilot wrapper.
  *
- * TODO probably wrap pilots with id + index, so we can try the index look-up
- * first and fall back to bsearch otherwise.
+ * The userdata also caches the pilot the ID resolved to, see luaL_validpilot().
  */
 typedef unsigned int LuaPilot; /**< Wrapper for a Pilot. */
 
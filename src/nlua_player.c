@@ -41,6 +41,7 @@
 #include "nlua_spob.h"
 #include "nlua_ship.h"
 #include "nlua_system.h"
+#include "nlua_tex.h"
 #include "nlua_time.h"
 #include "nlua_vec2.h"
 #include "nlua_misn.h"
@@ -922,12 +923,21 @@ static int playerL_damageSPFX( lua_State *L )
 /**
  * @brief Takes a screenshot (same as the keyboard action).
  *
+ * The screenshot is written in the background over the next frames.
+ *
+ * @usage player.screenshot( function( path ) print( path ) end )
+ *
+ *    @luatparam[opt] function func Function to call once the screenshot is
+ *       written, with its path or nil if it failed.
  * @luafunc screenshot
  */
 static int playerL_screenshot( lua_State *L )
 {
-   (void) L;
-   player_screenshot();
+   void *cb = tex_writeCallback( L, 1 );
+   if (cb != NULL)
+      player_screenshot( tex_writeDone, tex_writeFree, cb );
+   else
+      player_screenshot( NULL, NULL, NULL );
    return 0;
 }
 
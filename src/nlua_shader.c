@@ -28,8 +28,11 @@ static int shaderL_new( lua_State *L );
 static int shaderL_send( lua_State *L );
 static int shaderL_sendRaw( lua_State *L );
 static int shaderL_hasUniform( lua_State *L );
+static int shaderL_uniform( lua_State *L );
+static int shaderL_sendTable( lua_State *L );
 static int shaderL_addPostProcess( lua_State *L );
 static int shaderL_rmPostProcess( lua_State *L );
+static int shaderL_skipPostProcess( lua_State *L );
 static const luaL_Reg shaderL_methods[] = {
    { "__gc", shaderL_gc },
    { "__eq", shaderL_eq },
@@ -37,8 +40,11 @@ static const luaL_Reg shaderL_methods[] = {
    { "send", shaderL_send },
    { "sendRaw", shaderL_sendRaw },
    { "hasUniform", shaderL_hasUniform },
+   { "uniform", shaderL_uniform },
+   { "sendTable", shaderL_sendTable },
    { "addPPShader", shaderL_addPostProcess },
    { "rmPPShader", shaderL_rmPostProcess },
+   { "skipPPShader", shaderL_skipPostProcess },
    {0,0}
 }; /**< Shader metatable methods. */
 
@@ -46,6 +52,8 @@ static const luaL_Reg shaderL_methods[] = {
 static int shader_compareUniform( const void *a, const void *b);
 static int shader_searchUniform( const void *id, const void *u );
 static LuaUniform_t *shader_getUniform( const LuaShader_t *ls, const char *name );
+static LuaUniform_t *shader_luaUniform( lua_State *L, const LuaShader_t *ls, int idx );
+static void shader_setUniform( lua_State *L, LuaShader_t *ls, const LuaUniform_t *u, int idx );
 static int shaderL_sendHelper( lua_State *L, int ignore_missing );
 
 /**
@@ -183,6 +191,24 @@ static LuaUniform_t *shader_getUniform( const LuaShader_t *ls, const char *name
    return bsearch( name, ls->uniforms, ls->nuniforms, sizeof(LuaUniform_t), shader_searchUniform );
 }
 
+/**
+ * @brief Gets a uniform from either its name or a handle from shader:uniform().
+ *
+ *    @return The uniform or NULL if not found.
+ */
+static LuaUniform_t *shader_luaUniform( lua_State *L, const LuaShader_t *ls, int idx )
+{
+   if (lua_type(L,idx) == LUA_TNUMBER) {
+      int h = lua_tointeger(L,idx);
+      if ((h < 1) || (h > ls->nuniforms))
+         return NULL;
+      return &ls->uniforms[h-1];
+   }
+   else if (lua_isnoneornil(L,idx))
+      return NULL;
+   return shader_getUniform( ls, luaL_checkstring(L,idx) );
+}
+
 /**
  * @brief Creates a new shader.
  *
@@ -303,7 +329,7 @@ void shader_parseUniformArgsInt( GLint values[4], lua_State *L, int idx, int n )
  * @brief Allows setting values of uniforms for a shader. Errors out if the uniform is unknown or unused (as in optimized out by the compiler).
  *
  *    @luatparam Shader shader Shader to send uniform to.
- *    @luatparam string name Name of the uniform.
+ *    @luatparam string|number name Name of the uniform or handle from shader:uniform().
  * @luafunc send
  */
 static int shaderL_send( lua_State *L )
@@ -315,7 +341,7 @@ static int shaderL_send( lua_State *L )
  * @brief Allows setting values of uniforms for a shader, while ignoring unknown (or unused) uniforms.
  *
  *    @luatparam Shader shader Shader to send uniform to.
- *    @luatparam string name Name of the uniform.
+ *    @luatparam string|number name Name of the uniform or handle from shader:uniform().
  * @luafunc send
  */
 static int shaderL_sendRaw( lua_State *L )
@@ -329,27 +355,41 @@ static int shaderL_sendRaw( lua_State *L )
 static int shaderL_sendHelper( lua_State *L, int ignore_missing )
 {
    LuaShader_t *ls;
-   LuaUniform_t *u;
-   const char *name;
-   int idx;
-   GLfloat values[4];
-   GLint ivalues[4];
-   glTexture *tex;
+   const LuaUniform_t *u;
 
    ls = luaL_checkshader(L,1);
-   name = luaL_checkstring(L,2);
-
-   u = shader_getUniform( ls, name );
+   u = shader_luaUniform( L, ls, 2 );
    if (u==NULL) {
       if (ignore_missing)
          return 0;
-      return NLUA_ERROR(L,_("Shader does not have uniform '%s'!"), name);
+      return NLUA_ERROR(L,_("Shader does not have uniform '%s'!"), luaL_optstring(L,2,"nil"));
    }
 
    /* With OpenGL 4.1 or ARB_separate_shader_objects, there
     * is no need to set the program first. */
    glUseProgram( ls->program );
-   idx = 3;
+   shader_setUniform( L, ls, u, 3 );
+   glUseProgram( 0 );
+
+   gl_checkErr();
+
+   return 0;
+}
+
+/**
+ * @brief Sets the value of a uniform from the Lua stack, the program must be in use.
+ *
+ *    @param L Lua state.
+ *    @param ls Shader the uniform belongs to.
+ *    @param u Uniform to set.
+ *    @param idx Stack index of the value, either a table or the first of the arguments.
+ */
+static void shader_setUniform( lua_State *L, LuaShader_t *ls, const LuaUniform_t *u, int idx )
+{
+   GLfloat values[4];
+   GLint ivalues[4];
+   glTexture *tex;
+
    switch (u->type) {
       case GL_FLOAT:
          shader_parseUniformArgsFloat( values, L, idx, 1 );
@@ -387,12 +427,40 @@ static int shaderL_sendHelper( lua_State *L, int ignore_missing )
 
       case GL_SAMPLER_2D:
          tex = luaL_checktex(L,idx);
+         gl_atlasUnpack( tex ); /* The shader samples the raw texture. */
          ls->tex[ u->tex ].texid = tex->texture;
          break;
 
       default:
          WARN(_("Unsupported shader uniform type '%d' for uniform '%s'. Ignoring."), u->type, u->name );
    }
+}
+
+/**
+ * @brief Sets the values of many uniforms at once, ignoring unknown (or unused) uniforms.
+ *
+ * Cheaper than calling send for each uniform as the program is only set up
+ *  once.
+ *
+ * @usage shader:sendTable{ u_time=t, u_pos={x,y}, [h]=1.0 }
+ *
+ *    @luatparam Shader shader Shader to send uniforms to.
+ *    @luatparam table values Table of values indexed by uniform name or handle from shader:uniform().
+ * @luafunc sendTable
+ */
+static int shaderL_sendTable( lua_State *L )
+{
+   LuaShader_t *ls = luaL_checkshader(L,1);
+   luaL_checktype(L,2,LUA_TTABLE);
+
+   glUseProgram( ls->program );
+   lua_pushnil(L);
+   while (lua_next(L,2) != 0) {
+      const LuaUniform_t *u = shader_luaUniform( L, ls, -2 );
+      if (u != NULL)
+         shader_setUniform( L, ls, u, lua_gettop(L) );
+      lua_pop(L,1);
+   }
    glUseProgram( 0 );
 
    gl_checkErr();
@@ -419,12 +487,34 @@ static int shaderL_hasUniform( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Gets a handle to a uniform, which is faster to send to than its name.
+ *
+ * @usage h = shader:uniform("u_time") ; shader:send( h, t )
+ *
+ *    @luatparam Shader shader Shader to get uniform of.
+ *    @luatparam string name Name of the uniform.
+ *    @luatreturn number|nil Handle of the uniform or nil if the shader does not have it.
+ * @luafunc uniform
+ */
+static int shaderL_uniform( lua_State *L )
+{
+   const LuaShader_t *ls = luaL_checkshader(L,1);
+   const char *name = luaL_checkstring(L,2);
+   const LuaUniform_t *u = shader_getUniform( ls, name );
+   if (u == NULL)
+      return 0;
+   lua_pushinteger( L, u - ls->uniforms + 1 );
+   return 1;
+}
+
 /**
  * @brief Sets a shader as a post-processing shader.
  *
  *    @luatparam Shader shader Shader to set as a post-processing shader.
  *    @luatparam[opt="final"] string layer Layer to add the shader to.
  *    @luatparam[opt=0] number priority Priority of the shader to set. Higher values mean it is run later.
+ *    @luatparam[opt="full"] string scale Resolution to run the shader at, one of "full", "half", or "quarter". Reduced resolutions are much cheaper for blurry or low frequency effects.
  *    @luatreturn boolean true on success.
  * @luafunc addPPShader
  */
@@ -433,7 +523,9 @@ static int shaderL_addPostProcess( lua_State *L )
    LuaShader_t *ls = luaL_checkshader(L,1);
    const char *str = luaL_optstring(L,2,"final");
    int priority = luaL_optinteger(L,3,0);
+   const char *scale = luaL_optstring(L,4,"full");
    int layer = PP_LAYER_FINAL;
+   unsigned int flags = 0;
 
    if (strcmp(str,"final")==0)
       layer = PP_LAYER_FINAL;
@@ -446,8 +538,15 @@ static int shaderL_addPostProcess( lua_State *L )
    else
       return NLUA_ERROR(L,_("Layer was '%s', but must be one of 'final', 'game', 'gui', or 'core'."), str);
 
+   if (strcmp(scale,"half")==0)
+      flags |= PP_SHADER_HALF;
+   else if (strcmp(scale,"quarter")==0)
+      flags |= PP_SHADER_QUARTER;
+   else if (strcmp(scale,"full")!=0)
+      return NLUA_ERROR(L,_("Scale was '%s', but must be one of 'full', 'half', or 'quarter'."), scale);
+
    if (ls->pp_id == 0)
-      ls->pp_id = render_postprocessAdd( ls, layer, priority, 0 );
+      ls->pp_id = render_postprocessAdd( ls, layer, priority, flags );
    lua_pushboolean(L, ls->pp_id>0);
    return 1;
 }
@@ -466,3 +565,22 @@ static int shaderL_rmPostProcess( lua_State *L )
    ls->pp_id = 0;
    return 1;
 }
+
+/**
+ * @brief Sets whether a post-processing shader should be skipped.
+ *
+ * Skipping a shader keeps it registered, but avoids running it while its
+ * output would be unchanged.
+ *
+ *    @luatparam Shader shader Shader to modify.
+ *    @luatparam boolean skip Whether or not to skip the shader.
+ *    @luatreturn boolean True on success.
+ * @luafunc skipPPShader
+ */
+static int shaderL_skipPostProcess( lua_State *L )
+{
+   LuaShader_t *ls = luaL_checkshader(L,1);
+   int skip = lua_toboolean(L,2);
+   lua_pushboolean( L, (ls->pp_id > 0) && (render_postprocessSkip( ls->pp_id, skip )==0) );
+   return 1;
+}
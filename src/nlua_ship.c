@@ -600,7 +600,9 @@ static int shipL_gfxComm( lua_State *L )
 static int shipL_gfxTarget( lua_State *L )
 {
    const Ship *s  = luaL_validship(L,1);
-   glTexture *tex = gl_dupTexture( s->gfx_target );
+   glTexture *tex;
+   ship_gfxLoad( s );
+   tex = gl_dupTexture( s->gfx_target );
    if (tex == NULL) {
       WARN(_("Unable to get ship target graphic for '%s'."), s->name);
       return 0;
@@ -623,7 +625,9 @@ static int shipL_gfxTarget( lua_State *L )
 static int shipL_gfx( lua_State *L )
 {
    const Ship *s  = luaL_validship(L,1);
-   glTexture *tex = gl_dupTexture( s->gfx_space );
+   glTexture *tex;
+   ship_gfxLoad( s );
+   tex = gl_dupTexture( s->gfx_space );
    if (tex == NULL) {
       WARN(_("Unable to get ship graphic for '%s'."), s->name);
       return 0;
@@ -642,6 +646,7 @@ static int shipL_gfx( lua_State *L )
 static int shipL_dims( lua_State *L )
 {
    const Ship *s = luaL_validship(L,1);
+   ship_gfxLoad( s );
    lua_pushnumber( L, s->gfx_space->sw );
    lua_pushnumber( L, s->gfx_space->sh );
    return 2;
@@ -21,6 +21,7 @@
 #include "gatherable.h"
 #include "map.h"
 #include "map_overlay.h"
+#include "map_system.h"
 #include "nebula.h"
 #include "nlua_commodity.h"
 #include "nlua_faction.h"
@@ -453,38 +454,47 @@ static int systemL_interference( lua_State *L )
  */
 static int systemL_jumpdistance( lua_State *L )
 {
-   StarSystem *sys;
    StarSystem **s;
-   const char *start, *goal;
+   const StarSystem *start, *goal;
    int h, k;
 
-   sys = luaL_validsystem(L,1);
-   start = sys->name;
+   start = luaL_validsystem(L,1);
    h   = lua_toboolean(L,3);
    k   = !lua_toboolean(L,4);
 
    if (lua_gettop(L) > 1) {
-      if (lua_isstring(L,2))
-         goal = lua_tostring(L,2);
-      else if (lua_issystem(L,2)) {
-         const StarSystem *sysp = luaL_validsystem(L,2);
-         goal = sysp->name;
+      if (lua_isstring(L,2)) {
+         goal = system_get( lua_tostring(L,2) );
+         if (goal == NULL) {
+            lua_pushnumber(L, HUGE_VAL);
+            return 1;
+         }
       }
+      else if (lua_issystem(L,2))
+         goal = luaL_validsystem(L,2);
       else
          NLUA_INVALID_PARAMETER(L,2);
    }
    else {
-      goal  = sys->name;
-      start = cur_system->name;
+      goal  = start;
+      start = cur_system;
    }
 
    /* Trivial case same system. */
-   if (strcmp(start,goal)==0) {
+   if (start == goal) {
       lua_pushnumber(L, 0.);
       return 1;
    }
 
-   s = map_getJumpPath( start, NULL, goal, k, h, NULL, NULL );
+   /* Without the player's knowledge it only depends on the jumps, which are
+    * precomputed for all the systems. */
+   if (k) {
+      int d = map_jumpDist( start, goal, h );
+      lua_pushnumber(L, (d < 0) ? HUGE_VAL : (double)d);
+      return 1;
+   }
+
+   s = map_getJumpPathSys( start, NULL, goal, k, h, NULL, NULL );
    if (s==NULL) {
       lua_pushnumber(L, HUGE_VAL);
       return 1;
@@ -521,18 +531,15 @@ static int systemL_jumpPath( lua_State *L )
    StarSystem *sys, *sysp;
    StarSystem **s;
    int sid, pushed, h;
-   const char *start, *goal;
 
    h   = lua_toboolean(L,3);
 
    /* Foo to Bar */
    sys   = luaL_validsystem(L,1);
-   start = sys->name;
    sid   = sys->id;
    sysp  = luaL_validsystem(L,2);
-   goal  = sysp->name;
 
-   s = map_getJumpPath( start, NULL, goal, 1, h, NULL, NULL );
+   s = map_getJumpPathSys( sys, NULL, sysp, 1, h, NULL, NULL );
    if (s == NULL)
       return 0;
 
@@ -899,6 +906,8 @@ static int systemL_setknown( lua_State *L )
    /* Update outfits image array. */
    outfits_updateEquipmentOutfits();
    ovr_refresh(); /* Update overlay as necessary. */
+   map_tilesInvalidate();
+   map_system_invalidate();
 
    return 0;
 }
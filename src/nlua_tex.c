@@ -22,6 +22,7 @@
 #include "ndata.h"
 #include "nlua_data.h"
 #include "nlua_file.h"
+#include "nlua_gfx.h"
 #include "nluadef.h"
 
 static int nlua_tex_counter = 0;
@@ -167,6 +168,8 @@ int lua_istex( lua_State *L, int ind )
 static int texL_close( lua_State *L )
 {
    /* Free texture. */
+   /* Batched draws could still be using it. */
+   nlua_gfxFlush();
    gl_freeTexture( luaL_checktex( L, 1 ) );
 
    return 0;
@@ -360,12 +363,77 @@ static int texL_readData( lua_State *L )
    return 3;
 }
 
+/**
+ * @brief Lua function to call once an image is written.
+ */
+typedef struct TexWriteCallback_ {
+   nlua_env env;  /**< Environment the function was passed from. */
+   int func;      /**< Reference to the function. */
+} TexWriteCallback;
+
+/**
+ * @brief Gets a function to call once an image is written in the background.
+ *
+ *    @param L Lua state.
+ *    @param ind Stack index of the function, which is optional.
+ *    @return Data to pass to tex_writeDone or NULL if there is no function.
+ */
+void *tex_writeCallback( lua_State *L, int ind )
+{
+   TexWriteCallback *cb;
+   if (lua_isnoneornil(L,ind))
+      return NULL;
+   luaL_checktype( L, ind, LUA_TFUNCTION );
+   cb = malloc( sizeof(TexWriteCallback) );
+   cb->env  = __NLUA_CURENV;
+   lua_pushvalue( L, ind );
+   cb->func = luaL_ref( L, LUA_REGISTRYINDEX );
+   return cb;
+}
+
+/**
+ * @brief Runs the Lua function of an image once it is written, with its path
+ *        or nil if it failed.
+ */
+void tex_writeDone( const char *filename, int ret, void *data )
+{
+   TexWriteCallback *cb = data;
+   lua_rawgeti( naevL, LUA_REGISTRYINDEX, cb->func );
+   if ((ret == 0) && (filename != NULL))
+      lua_pushstring( naevL, filename );
+   else
+      lua_pushnil( naevL );
+   if (nlua_pcall( cb->env, 1, 0 )) {
+      WARN(_("Image write callback: %s"), lua_tostring( naevL, -1 ));
+      lua_pop( naevL, 1 );
+   }
+   tex_writeFree( cb );
+}
+
+/**
+ * @brief Releases the Lua function of an image without running it.
+ */
+void tex_writeFree( void *data )
+{
+   TexWriteCallback *cb = data;
+   /* References go away with the Lua state if it is already closed. */
+   if (naevL != NULL)
+      luaL_unref( naevL, LUA_REGISTRYINDEX, cb->func );
+   free( cb );
+}
+
 /**
  * @brief Saves texture data as a png.
  *
+ * With a function the texture is read and written in the background without
+ *  stalling the game, like screenshots, and the function is called once done.
+ *
  *    @luatparam Tex t Texture to convert to string.
- *    @luatreturn string Texture as a string.
- * @luafunc toData
+ *    @luatparam string filename Path to write the png to.
+ *    @luatparam[opt] function func Function to call once written, with
+ *       the path or nil if it failed.
+ *    @luatreturn boolean true on success.
+ * @luafunc writeData
  */
 static int texL_writeData( lua_State *L )
 {
@@ -376,6 +444,17 @@ static int texL_writeData( lua_State *L )
    char *data;
    SDL_Surface *surface;
    SDL_RWops *rw;
+   void *cb = tex_writeCallback( L, 3 );
+
+   /* Reads the raw texture. */
+   gl_atlasUnpack( tex );
+
+   /* In the background. */
+   if (cb != NULL) {
+      gl_saveTexture( tex, filename, tex_writeDone, tex_writeFree, cb );
+      lua_pushboolean(L,1);
+      return 1;
+   }
 
    w = tex->w;
    h = tex->h;
@@ -506,6 +585,8 @@ static int texL_setFilter( lua_State *L )
    if (min==0 || mag==0)
       NLUA_INVALID_PARAMETER(L,2);
 
+   /* Would change the whole atlas otherwise. */
+   gl_atlasUnpack( tex );
    glBindTexture( GL_TEXTURE_2D, tex->texture );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min );
@@ -538,6 +619,8 @@ static int texL_setWrap( lua_State *L )
    if (horiz==0 || vert==0 || depth==0)
       NLUA_INVALID_PARAMETER(L,2);
 
+   /* Wrapping can't work inside of an atlas. */
+   gl_atlasUnpack( tex );
    glBindTexture( GL_TEXTURE_2D, tex->texture );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, horiz );
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, vert );
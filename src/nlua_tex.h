@@ -21,3 +21,10 @@ glTexture* luaL_checktex( lua_State *L, int ind );
 glTexture** lua_pushtex( lua_State *L, glTexture* tex );
 int lua_istex( lua_State *L, int ind );
 glTexture* luaL_validtex( lua_State *L, int ind, const char *searchpath );
+
+/*
+ * Background writing
+ */
+void *tex_writeCallback( lua_State *L, int ind );
+void tex_writeDone( const char *filename, int ret, void *data );
+void tex_writeFree( void *data );
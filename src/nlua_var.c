@@ -25,21 +25,35 @@
 #include "nxml.h"
 #include "nlua_time.h"
 #include "lvar.h"
+#include "nameindex.h"
+
+/**
+ * @brief Interned name of a mission variable.
+ */
+typedef struct VarName_ {
+   char *name; /**< Name of the variable. */
+   int idx;    /**< Index of the variable in var_stack, -1 if it isn't set. */
+} VarName;
 
 /*
  * variable stack
  */
-static lvar* var_stack = NULL; /**< Stack of mission variables. */
-/* externed */
+static lvar* var_stack = NULL; /**< Stack of mission variables, in no particular order. */
+static VarName *var_names = NULL; /**< Interned names (array.h), never shrinks so handles stay valid. */
+static NameIndex var_nameIndex; /**< Index of var_names by name. */
 
 /* var */
 static int varL_peek( lua_State *L );
 static int varL_pop( lua_State *L );
 static int varL_push( lua_State *L );
+static int varL_handle( lua_State *L );
+static int varL_peekHandle( lua_State *L );
 static const luaL_Reg var_methods[] = {
    { "peek", varL_peek },
    { "pop", varL_pop },
    { "push", varL_push },
+   { "handle", varL_handle },
+   { "peekHandle", varL_peekHandle },
    {0,0}
 }; /**< Mission variable Lua methods. */
 
@@ -54,12 +68,56 @@ int nlua_loadVar( nlua_env env )
    return 0;
 }
 
+/**
+ * @brief Interns the name of a mission var.
+ *
+ *    @param str Name to intern.
+ *    @return ID of the interned name, which is the handle of the var.
+ */
+static int var_intern( const char *str )
+{
+   VarName *vn;
+   int id = nameindex_get( &var_nameIndex, str );
+   if (id >= 0)
+      return id;
+
+   if (var_names == NULL)
+      var_names = array_create( VarName );
+   vn = &array_grow( &var_names );
+   vn->name = strdup( str );
+   vn->idx  = -1;
+   id = array_size(var_names)-1;
+   nameindex_add( &var_nameIndex, vn->name, id );
+   return id;
+}
+
+/**
+ * @brief Rebuilds the indices of the interned names from the var stack.
+ */
+static void var_reindex (void)
+{
+   for (int i=0; i<array_size(var_names); i++)
+      var_names[i].idx = -1;
+   for (int i=0; i<array_size(var_stack); i++)
+      var_names[ var_intern( var_stack[i].name ) ].idx = i;
+}
+
+/**
+ * @brief Gets a mission var by handle.
+ */
+static lvar *var_getHandle( int id )
+{
+   if ((id < 0) || (id >= array_size(var_names)) || (var_names[id].idx < 0))
+      return NULL;
+   return &var_stack[ var_names[id].idx ];
+}
+
 /**
  * @brief Gets a mission var by name.
  */
 static lvar *var_get( const char *str )
 {
-   return lvar_get( var_stack, str );
+   return var_getHandle( nameindex_get( &var_nameIndex, str ) );
 }
 
 /**
@@ -92,21 +150,49 @@ int var_load( xmlNodePtr parent )
          continue;
       var_stack = lvar_load( node );
    } while (xml_nextNode(node));
+   var_reindex();
    return 0;
 }
 
 /**
  * @brief Adds a var to the stack, strings will be SHARED, don't free.
  *
- *    @param new_var Variable to add.
- *    @param sort Whether or not to sort.
+ *    @param new_var Variable to add, overwriting the one with the same name.
  *    @return 0 on success.
  */
-static int var_add( lvar *new_var, int sort )
+static int var_add( lvar *new_var )
 {
+   VarName *vn = &var_names[ var_intern( new_var->name ) ];
+   if (vn->idx >= 0) {
+      lvar_free( &var_stack[ vn->idx ] );
+      var_stack[ vn->idx ] = *new_var;
+      return 0;
+   }
    if (var_stack==NULL)
       var_stack = array_create( lvar );
-   return lvar_addArray( &var_stack, new_var, sort );
+   vn->idx = array_size(var_stack);
+   array_push_back( &var_stack, *new_var );
+   return 0;
+}
+
+/**
+ * @brief Removes a var from the stack.
+ *
+ *    @param id Handle of the var to remove.
+ */
+static void var_rm( int id )
+{
+   int idx = var_names[id].idx;
+   int last = array_size(var_stack)-1;
+
+   /* Move the last var into the hole. */
+   lvar_free( &var_stack[idx] );
+   if (idx != last) {
+      var_stack[idx] = var_stack[last];
+      var_names[ nameindex_get( &var_nameIndex, var_stack[idx].name ) ].idx = idx;
+   }
+   array_erase( &var_stack, &var_stack[last], &var_stack[last+1] );
+   var_names[id].idx = -1;
 }
 
 /**
@@ -167,10 +253,10 @@ static int varL_peek( lua_State *L )
 static int varL_pop( lua_State *L )
 {
    const char* str = luaL_checkstring(L,1);
-   lvar *mv = var_get( str );
-   if (mv == NULL)
+   int id = nameindex_get( &var_nameIndex, str );
+   if (var_getHandle( id ) == NULL)
       return 0;
-   lvar_rmArray( &var_stack, mv );
+   var_rm( id );
    return 0;
 }
 
@@ -189,10 +275,48 @@ static int varL_push( lua_State *L )
 {
    const char *str = luaL_checkstring(L,1);
    lvar var = lvar_tovar( L, str, 2 );
-   var_add( &var, 1 );
+   var_add( &var );
    return 0;
 }
 
+/**
+ * @brief Gets a handle to a mission variable.
+ *
+ * Handles stay valid for the whole game, even if the variable doesn't exist
+ *  yet or gets popped, and are faster to read than names.
+ *
+ * @code
+ * local h = var.handle( "es_misn" ) -- Resolve once
+ * local v = var.peekHandle( h ) -- Read as many times as needed
+ * @endcode
+ *
+ *    @luatparam string name Name of the mission variable to get a handle to.
+ *    @luatreturn number Handle of the mission variable.
+ * @luafunc handle
+ */
+static int varL_handle( lua_State *L )
+{
+   const char *str = luaL_checkstring(L,1);
+   lua_pushinteger( L, var_intern( str ) );
+   return 1;
+}
+
+/**
+ * @brief Gets the mission variable value of a handle.
+ *
+ *    @luatparam number h Handle of the mission variable from var.handle.
+ *    @luareturn The value of the mission variable which will depend on what type
+ *             it is.
+ * @luafunc peekHandle
+ */
+static int varL_peekHandle( lua_State *L )
+{
+   const lvar *mv = var_getHandle( luaL_checkinteger(L,1) );
+   if (mv == NULL)
+      return 0;
+   return lvar_push( L, mv );
+}
+
 /**
  * @brief Cleans up all the mission variables.
  */
@@ -200,4 +324,6 @@ void var_cleanup (void)
 {
    lvar_freeArray( var_stack );
    var_stack = NULL;
+   /* Names are kept so that handles stay valid. */
+   var_reindex();
 }
@@ -270,7 +270,8 @@ static int vectorL_tostring( lua_State *L )
  * @brief Adds two vectors or a vector and some cartesian coordinates.
  *
  * If x is a vector it adds both vectors, otherwise it adds cartesian coordinates
- * to the vector.
+ * to the vector. The method form modifies the vector in place and returns it
+ * without creating a new one.
  *
  * @usage my_vec = my_vec + your_vec
  * @usage my_vec:add( your_vec )
@@ -340,7 +341,7 @@ static int vectorL_add__( lua_State *L )
 
    /* Actually add it */
    vec2_cset( v1, v1->x + x, v1->y + y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
 
    return 1;
 }
@@ -349,7 +350,8 @@ static int vectorL_add__( lua_State *L )
  * @brief Subtracts two vectors or a vector and some cartesian coordinates.
  *
  * If x is a vector it subtracts both vectors, otherwise it subtracts cartesian
- * coordinates to the vector.
+ * coordinates to the vector. The method form modifies the vector in place and
+ * returns it without creating a new one.
  *
  * @usage my_vec = my_vec - your_vec
  * @usage my_vec:sub( your_vec )
@@ -413,13 +415,16 @@ static int vectorL_sub__( lua_State *L )
 
    /* Actually add it */
    vec2_cset( v1, v1->x - x, v1->y - y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 
 /**
  * @brief Multiplies a vector by a number.
  *
+ * The method form modifies the vector in place and returns it without creating
+ * a new one.
+ *
  * @usage my_vec = my_vec * 3
  * @usage my_vec:mul( 3 )
  *
@@ -467,13 +472,16 @@ static int vectorL_mul__( lua_State *L )
    }
 
    /* Actually add it */
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 
 /**
  * @brief Divides a vector by a number.
  *
+ * The method form modifies the vector in place and returns it without creating
+ * a new one.
+ *
  * @usage my_vec = my_vec / 3
  * @usage my_vec:div(3)
  *
@@ -510,7 +518,7 @@ static int vectorL_div__( lua_State *L )
       vec2_cset( v1, v1->x / v2->x, v1->y / v2->y );
    }
 
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 static int vectorL_unm( lua_State *L )
@@ -7,11 +7,15 @@
  * Handles some complex xml parsing.
  */
 /** @cond */
+#include <limits.h>
+
 #include "naev.h"
 /** @endcond */
 
 #include "nxml.h"
 
+#include "loadprof.h"
+#include "memstats.h"
 #include "ndata.h"
 #include "nstring.h"
 
@@ -74,26 +78,55 @@ void xmlw_setParams( xmlTextWriterPtr writer )
  */
 xmlDocPtr xml_parsePhysFS( const char* filename )
 {
-   char *buf;
-   size_t bufsize;
+   NDataStream s;
+   xmlParserCtxtPtr ctxt;
+   const char *chunk;
+   size_t len;
    xmlDocPtr doc;
+   int64_t parsed = 0;
+   Uint64 t = loadprof_fileBegin();
 
-   /* @TODO: Don't slurp?
-    * Can we directly create an InputStream backed by PHYSFS_*, or use SAX? */
-   buf = ndata_read( filename, &bufsize );
-   if (buf == NULL) {
+   if (ndata_streamOpen( &s, filename )) {
       WARN( _("Unable to read data from '%s'"), filename );
       return NULL;
    }
    /* Empty file, we ignore these. */
-   if (bufsize==0) {
-      free(buf);
+   chunk = ndata_streamRead( &s, &len );
+   if (chunk == NULL) {
+      ndata_streamClose( &s );
+      return NULL;
+   }
+
+   /* Feed the parser as the file is read. */
+   ctxt = xmlCreatePushParserCtxt( NULL, NULL, NULL, 0, filename );
+   if (ctxt == NULL) {
+      ndata_streamClose( &s );
       return NULL;
    }
-   doc = xmlParseMemory( buf, bufsize );
+   do {
+      while (len > 0) {
+         int n = MIN( len, INT_MAX );
+         xmlParseChunk( ctxt, chunk, n, 0 );
+         memstats_add( MEMTAG_XML, n );
+         parsed += n;
+         chunk += n;
+         len   -= n;
+      }
+      chunk = ndata_streamRead( &s, &len );
+   } while (chunk != NULL);
+   xmlParseChunk( ctxt, NULL, 0, 1 );
+   ndata_streamClose( &s );
+
+   doc = ctxt->myDoc;
+   if (!ctxt->wellFormed) {
+      xmlFreeDoc( doc );
+      doc = NULL;
+   }
+   xmlFreeParserCtxt( ctxt );
+   memstats_add( MEMTAG_XML, -parsed );
    if (doc == NULL)
       WARN( _("Unable to parse document '%s'"), filename );
-   free( buf );
+   loadprof_fileEnd( LOADPROF_XML, filename, t );
    return doc;
 }
 
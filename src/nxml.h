@@ -150,6 +150,13 @@ do {if (xmlTextWriterWriteFormatAttribute(w,(xmlChar*)str, \
 #define xmlw_str(w,str,...) \
 do {if (xmlTextWriterWriteFormatString(w,str, ## __VA_ARGS__) < 0) { \
    ERR("xmlw: unable to write element data"); return -1; } } while (0)
+/* unformatted, for strings that are already built */
+#define xmlw_attrStr(w,n,str)  \
+do {if (xmlTextWriterWriteAttribute(w,(xmlChar*)n,(xmlChar*)str) < 0) { \
+   ERR("xmlw: unable to write element attribute"); return -1; } } while (0)
+#define xmlw_text(w,str) \
+do {if (xmlTextWriterWriteString(w,(xmlChar*)str) < 0) { \
+   ERR("xmlw: unable to write element data"); return -1; } } while (0)
 /* document level */
 #define xmlw_start(w) \
 do {if (xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL) < 0) { \
@@ -35,6 +35,9 @@
 static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer );
 static int nxml_unpersistDataNode( lua_State *L, xmlNodePtr parent );
 static int nxml_canWriteString( const char *buf, size_t len );
+static const char *nxml_attrGet( xmlNodePtr node, const char *name, char **alloc );
+
+#define NXML_NUMBER_FMT "%.14g" /**< Same format as tostring() for Lua numbers. */
 
 /**
  * @brief Persists the key of a key/value pair.
@@ -48,14 +51,14 @@ static int nxml_canWriteString( const char *buf, size_t len );
 static int nxml_saveNameAttribute( xmlTextWriterPtr writer, const char *name, size_t name_len, int keynum )
 {
    if (nxml_canWriteString( name, name_len ))
-      xmlw_attr( writer, "name", "%s", name );
+      xmlw_attrStr( writer, "name", name );
    else {
       char *encoded = base64_encode_to_cstr( name, name_len );
-      xmlw_attr( writer, "name_base64", "%s", encoded );
+      xmlw_attrStr( writer, "name_base64", encoded );
       free( encoded );
    }
    if (keynum)
-      xmlw_attr(writer,"keynum","1");
+      xmlw_attrStr(writer,"keynum","1");
    return 0;
 }
 
@@ -75,9 +78,9 @@ static int nxml_saveData( xmlTextWriterPtr writer, const char *type, const char
 {
    xmlw_startElem(writer,"data");
 
-   xmlw_attr(writer,"type","%s",type);
+   xmlw_attrStr(writer,"type",type);
    nxml_saveNameAttribute( writer, name, name_len, keynum );
-   xmlw_str(writer,"%s",value);
+   xmlw_text(writer,value);
 
    xmlw_endElem(writer); /* "data" */
 
@@ -176,6 +179,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer )
 {
    int ret;
    char buf[32]; /* Buffer large enough for a formatted i64 (base 10). */
+   char keybuf[32]; /* Buffer large enough for a formatted number key. */
    const char *name, *str, *data;
    int keynum;
    size_t len, name_len;
@@ -195,10 +199,9 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer )
          keynum   = 0;
          break;
       case LUA_TNUMBER:
-         /* Can't tostring directly. */
-         lua_pushvalue(L,-2);
-         name = lua_tolstring( L, -1, &name_len );
-         lua_pop(L,1); /* Pop the new value. */
+         /* Can't tostring directly, format it without creating a Lua string. */
+         name_len = snprintf( keybuf, sizeof(keybuf), NXML_NUMBER_FMT, lua_tonumber( L, -2 ) );
+         name = keybuf;
          /* Is a number key. */
          keynum   = 1;
          break;
@@ -216,7 +219,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer )
       case LUA_TTABLE:
          /* Start the table. */
          xmlw_startElem(writer,"data");
-         xmlw_attr(writer,"type","table");
+         xmlw_attrStr(writer,"type","table");
          nxml_saveNameAttribute( writer, name, name_len, keynum );
          lua_pushnil(L); /* key, value, nil */
          while (lua_next(L, -2) != 0) {
@@ -230,7 +233,8 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer )
 
       /* Normal number. */
       case LUA_TNUMBER:
-         nxml_saveData( writer, "number", name, name_len, lua_tostring( L, -1 ), keynum );
+         snprintf( buf, sizeof(buf), NXML_NUMBER_FMT, lua_tonumber( L, -1 ) );
+         nxml_saveData( writer, "number", name, name_len, buf, keynum );
          /* key, value */
          break;
 
@@ -248,7 +252,7 @@ static int nxml_persistDataNode( lua_State *L, xmlTextWriterPtr writer )
       case LUA_TSTRING:
          data = lua_tolstring( L, -1, &len );
          if ( nxml_canWriteString( data, len ) )
-            nxml_saveData( writer, "string", name, name_len, lua_tostring( L, -1 ), keynum );
+            nxml_saveData( writer, "string", name, name_len, data, keynum );
          else {
             char *encoded = base64_encode_to_cstr( data, len );
             nxml_saveData( writer, "string_base64", name, name_len, encoded, keynum );
@@ -394,7 +398,8 @@ int nxml_persistLua( nlua_env env, xmlTextWriterPtr writer )
 static int nxml_unpersistDataNode( lua_State *L, xmlNodePtr parent )
 {
    xmlNodePtr node;
-   char *name, *type, *buf, *num, *data;
+   const char *name, *type, *buf;
+   char *name_alloc, *type_alloc, *buf_alloc, *data;
    size_t len;
    int ret = 0;
 
@@ -402,34 +407,34 @@ static int nxml_unpersistDataNode( lua_State *L, xmlNodePtr parent )
    do {
       int failed = 0;
       if (xml_isNode(node,"data")) {
-         /* Get general info. */
-         xmlr_attr_strd(node,"name",name);
-         xmlr_attr_strd(node,"type",type);
+         /* Get general info, without copying the attributes. */
+         name = nxml_attrGet( node, "name", &name_alloc );
+         type = nxml_attrGet( node, "type", &type_alloc );
+         if (type == NULL) {
+            WARN(_("Lua data is missing its type!"));
+            free(name_alloc);
+            continue;
+         }
          /* Check to see if key is a number. */
-         xmlr_attr_strd(node,"keynum",num);
-         if (num != NULL) {
+         if ((name != NULL) && (xmlHasProp( node, (xmlChar*)"keynum" ) != NULL))
             lua_pushnumber(L, strtod( name, NULL ));
-            free(num);
-         }
          else if ( name != NULL )
             lua_pushstring(L, name);
          else {
-            xmlr_attr_strd( node, "name_base64", name );
-            data = base64_decode_cstr( &len, name );
+            buf = nxml_attrGet( node, "name_base64", &buf_alloc );
+            data = base64_decode_cstr( &len, buf );
             lua_pushlstring( L, data, len );
             free( data );
+            free( buf_alloc );
          }
 
          /* handle data types */
          /* Recursive tables. */
          if (strcmp(type,"table")==0) {
-            xmlr_attr_strd(node,"name",buf);
             /* Create new table. */
             lua_newtable(L);
             /* Save data. */
             nxml_unpersistDataNode(L,node);
-            /* Set table. */
-            free(buf);
          }
          else if (strcmp(type,"number")==0)
             lua_pushnumber(L,xml_getFloat(node));
@@ -471,8 +476,8 @@ static int nxml_unpersistDataNode( lua_State *L, xmlNodePtr parent )
          }
          else if (strcmp(type,JUMP_METATABLE)==0) {
             StarSystem *ss = system_get(xml_get(node));
-            xmlr_attr_strd(node,"dest",buf);
-            StarSystem *dest = system_get( buf );
+            buf = nxml_attrGet( node, "dest", &buf_alloc );
+            StarSystem *dest = (buf != NULL) ? system_get( buf ) : NULL;
             if ((ss != NULL) && (dest != NULL)) {
                LuaJump lj = {.srcid = ss->id, .destid = dest->id};
                lua_pushjump(L,lj);
@@ -481,7 +486,7 @@ static int nxml_unpersistDataNode( lua_State *L, xmlNodePtr parent )
                WARN(_("Failed to load nonexistent jump from '%s' to '%s'"), xml_get(node), buf);
                failed = 1;
             }
-            free(buf);
+            free(buf_alloc);
          }
          else if (strcmp(type,COMMODITY_METATABLE)==0)
             lua_pushcommodity(L, nxml_loadCommodity( node ) );
@@ -510,8 +515,8 @@ static int nxml_unpersistDataNode( lua_State *L, xmlNodePtr parent )
             lua_pop(L,1);
 
          /* cleanup */
-         free(type);
-         free(name);
+         free(type_alloc);
+         free(name_alloc);
 
          ret |= failed;
       }
@@ -548,10 +553,37 @@ int nxml_unpersistLua( nlua_env env, xmlNodePtr parent )
  */
 static int nxml_canWriteString( const char *buf, size_t len )
 {
+   int ascii = 1;
    for (size_t i = 0; i < len; i++) {
-      if ( buf[ i ] == '\0'
-           || ( buf[ i ] < 0x20 && buf[ i ] != '\t' && buf[ i ] != '\n' && buf[ i ] != '\r' ) )
+      unsigned char c = buf[ i ];
+      if ( c == '\0'
+           || ( c < 0x20 && c != '\t' && c != '\n' && c != '\r' ) )
          return 0;
+      ascii &= (c < 0x80);
    }
-   return u8_isvalid( buf, len );
+   /* Plain ASCII is always valid UTF-8. */
+   return ascii || u8_isvalid( buf, len );
+}
+
+/**
+ * @brief Gets an attribute of a node without copying it when possible.
+ *
+ *    @param node Node to get attribute of.
+ *    @param name Name of the attribute.
+ *    @param[out] alloc Set to memory to free when the attribute had to be
+ *           copied, NULL otherwise.
+ *    @return The value of the attribute or NULL if it doesn't exist.
+ */
+static const char *nxml_attrGet( xmlNodePtr node, const char *name, char **alloc )
+{
+   xmlAttrPtr attr = xmlHasProp( node, (xmlChar*)name );
+   *alloc = NULL;
+   if (attr == NULL)
+      return NULL;
+   /* Plain text values can be used in place. */
+   if ((attr->children != NULL) && (attr->children->next == NULL) &&
+         (attr->children->type == XML_TEXT_NODE))
+      return (const char*)attr->children->content;
+   xmlr_attr_strd( node, name, *alloc );
+   return *alloc;
 }
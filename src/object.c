@@ -21,6 +21,7 @@
 
 #include "array.h"
 #include "camera.h"
+#include "frametime.h"
 #include "gui.h"
 #include "log.h"
 #include "ndata.h"
@@ -28,6 +29,9 @@
 #define DELIM " \t\n"
 #define NAEV_ORTHO_SCALE 10.       /**< The cam.ortho_scale defined in the Blender script */
 #define NAEV_ORTHO_DIST 9.*M_SQRT2/**< Distance from camera to origin in the Blender script */
+#define OBJECT_SHEET_SX    8     /**< Directions along the width of the sprite sheets. */
+#define OBJECT_SHEET_SY    8     /**< Directions along the height of the sprite sheets. */
+#define OBJECT_SHEET_CELL  128   /**< Size in pixels of each direction of the sprite sheets. */
 
 typedef struct Material_ {
    char *name;
@@ -43,10 +47,19 @@ typedef struct Mesh_ {
    int material;
 } Mesh;
 
+/**
+ * @brief Part of an object pre-rendered at all the directions.
+ */
+typedef struct ObjectSheet_ {
+   char *part;       /**< Name of the part. */
+   glTexture *tex;   /**< Sprite sheet, NULL if it could not be created. */
+} ObjectSheet;
+
 typedef struct Object_ {
    Mesh *meshes;
    Material *materials;
    GLfloat radius;
+   ObjectSheet *sheets; /**< Sprite sheets of the parts, created when first needed. */
 } Object;
 
 typedef struct {
@@ -58,6 +71,12 @@ typedef struct {
 static glTexture *zeroTexture       = NULL;
 static glTexture *oneTexture        = NULL;
 static unsigned int emptyTextureRefs= 0;
+static int object_sheet_counter     = 0; /**< Used to give the sprite sheets unique names. */
+
+/*
+ * Prototypes.
+ */
+static glTexture *object_sheet( Object *object, const char *part_name );
 
 static void mesh_create( Mesh **meshes, const char* name,
                          Vertex *corners, int material )
@@ -331,9 +350,10 @@ Object *object_loadFromFile( const char *filename )
    mesh_create(&object->meshes, name, corners, material);
    free(name);
 
-   /* Calculate maximum mesh size (from center). */
-   for (int i=0; i<array_size(corners); i++) {
-      v = corners[i].ver;
+   /* Calculate maximum mesh size (from center). The corners were handed to
+    * the meshes already, so the vertices are used. */
+   for (int i=0; i+2<array_size(vertex); i+=3) {
+      v = &vertex[i];
       object->radius = MAX( object->radius, v[0]*v[0]+v[1]*v[1]+v[2]*v[2] );
    }
    object->radius = sqrt( object->radius );
@@ -371,8 +391,14 @@ void object_free( Object *object )
       gl_vboDestroy(mesh->vbo);
    }
 
+   for (int i=0; i < array_size(object->sheets); ++i) {
+      free(object->sheets[i].part);
+      gl_freeTexture(object->sheets[i].tex);
+   }
+
    array_free(object->meshes);
    array_free(object->materials);
+   array_free(object->sheets);
 
    if (--emptyTextureRefs == 0) {
       gl_freeTexture(zeroTexture);
@@ -429,31 +455,203 @@ static void object_renderMesh( const Object *object, int part, GLfloat alpha )
    glActiveTexture(GL_TEXTURE0);
    glBindTexture(GL_TEXTURE_2D, material->map_Kd == NULL ? oneTexture->texture : material->map_Kd->texture);
 
-   glDrawArrays(GL_TRIANGLES, 0, mesh->num_corners);
+   gl_drawArrays(GL_TRIANGLES, 0, mesh->num_corners);
+   frametime_addCount( FRAME_COUNT_MESHES, 1 );
 }
 
-void object_renderSolidPart( const Object *object, const Solid *solid, const char *part_name, GLfloat alpha, double scale )
+/**
+ * @brief Pre-renders a part of an object at all the directions.
+ *
+ * The part is rendered once per direction into the cells of a sprite sheet
+ *  laid out like the ones of 2D ships, so that gl_getSpriteFromDir works on
+ *  it. Each cell covers the radius of the object around its center.
+ *
+ *    @param object Object to render.
+ *    @param part_name Part to render.
+ *    @return The sprite sheet or NULL on error.
+ */
+static glTexture *object_sheet( Object *object, const char *part_name )
+{
+   ObjectSheet *sheet;
+   GLuint fbo, depth;
+   GLenum status;
+   mat4 ortho;
+   char *name;
+   const int w = OBJECT_SHEET_SX * OBJECT_SHEET_CELL;
+   const int h = OBJECT_SHEET_SY * OBJECT_SHEET_CELL;
+   const GLfloat od = NAEV_ORTHO_DIST;
+   const GLfloat os = object->radius;
+
+   /* Already done. */
+   for (int i=0; i < array_size(object->sheets); ++i)
+      if (strcmp(part_name, object->sheets[i].part) == 0)
+         return object->sheets[i].tex;
+
+   if (object->sheets == NULL)
+      object->sheets = array_create(ObjectSheet);
+   sheet = &array_grow(&object->sheets);
+   sheet->part = strdup(part_name);
+   sheet->tex  = NULL;
+   if (os <= 0.)
+      return NULL;
+
+   SDL_asprintf( &name, "object_sheet_%03d", ++object_sheet_counter );
+   sheet->tex = gl_loadImageData( NULL, w, h, OBJECT_SHEET_SX, OBJECT_SHEET_SY, name );
+   free( name );
+
+   /* Frame buffer with a depth buffer for the duration of the rendering. */
+   glGenFramebuffers( 1, &fbo );
+   glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+   glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sheet->tex->texture, 0 );
+   glGenRenderbuffers( 1, &depth );
+   glBindRenderbuffer( GL_RENDERBUFFER, depth );
+   glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h );
+   glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth );
+   status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+   if (status != GL_FRAMEBUFFER_COMPLETE) {
+      WARN(_("Error setting up framebuffer!"));
+      gl_freeTexture( sheet->tex );
+      sheet->tex = NULL;
+   }
+   else {
+      glClearColor( 0., 0., 0., 0. );
+      glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+      glUseProgram(shaders.material.program);
+      ortho = mat4_ortho(-os, os, -os, os, od, -od);
+      gl_uniformMat4(shaders.material.projection, &ortho);
+      glEnable(GL_DEPTH_TEST);
+      glDepthFunc(GL_LESS);
+
+      /* Same order and angles as gl_getSpriteFromDir. */
+      for (int s=0; s < OBJECT_SHEET_SX*OBJECT_SHEET_SY; s++) {
+         int sx = s % OBJECT_SHEET_SX;
+         int sy = s / OBJECT_SHEET_SX;
+         mat4 model = mat4_identity();
+         mat4_rotate( &model, M_PI/2. + 2.*M_PI*s / (OBJECT_SHEET_SX*OBJECT_SHEET_SY), 0., 1., 0.);
+         gl_uniformMat4(shaders.material.model, &model);
+         glViewport( sx*OBJECT_SHEET_CELL, (OBJECT_SHEET_SY-sy-1)*OBJECT_SHEET_CELL,
+               OBJECT_SHEET_CELL, OBJECT_SHEET_CELL );
+         for (int i=0; i < array_size(object->meshes); ++i)
+            if (strcmp(part_name, object->meshes[i].name) == 0)
+               object_renderMesh(object, i, 1.);
+      }
+
+      glDisable(GL_DEPTH_TEST);
+      glUseProgram(0);
+      glViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+      glClearColor( 0., 0., 0., 1. );
+   }
+
+   /* Restore state. */
+   glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.current_fbo );
+   glDeleteRenderbuffers( 1, &depth );
+   glDeleteFramebuffers( 1, &fbo );
+   gl_checkErr();
+
+   return sheet->tex;
+}
+
+/**
+ * @brief Creates the sprite sheet of a part of an object ahead of time.
+ *
+ * The sheets are otherwise created the first time the object is drawn small,
+ *  which is a noticeable hitch.
+ *
+ *    @param object Object to prefetch.
+ *    @param part_name Part to prefetch.
+ *    @return 1 if the sheet had to be created, 0 if it already existed.
+ */
+int object_prefetchSheet( Object *object, const char *part_name )
+{
+   for (int i=0; i < array_size(object->sheets); ++i)
+      if (strcmp(part_name, object->sheets[i].part) == 0)
+         return 0;
+   object_sheet( object, part_name );
+   return 1;
+}
+
+/**
+ * @brief Renders a part of an object from its sprite sheet.
+ *
+ * Much cheaper than rendering the meshes, and looks the same as long as the
+ *  object is not drawn larger than the cells of the sheet. Uses the current
+ *  view matrix, like the other sprite rendering routines.
+ *
+ *    @param object Object to render.
+ *    @param part_name Part to render.
+ *    @param x X position of the bottom left corner of the object.
+ *    @param y Y position of the bottom left corner of the object.
+ *    @param w Width to render the object at, covering its radius.
+ *    @param h Height to render the object at, covering its radius.
+ *    @param dir Direction the object is facing.
+ *    @param alpha Transparency of the part.
+ *    @return 0 on success.
+ */
+int object_renderSheet( Object *object, const char *part_name,
+      double x, double y, double w, double h, double dir, GLfloat alpha )
+{
+   int sx, sy;
+   const glTexture *tex = object_sheet( object, part_name );
+   const glColour c = { .r=1., .g=1., .b=1., .a=alpha };
+
+   if (tex == NULL)
+      return -1;
+
+   gl_getSpriteFromDir( &sx, &sy, tex, dir );
+   gl_renderTexture( tex, x, y, w, h,
+         tex->srw*sx, tex->srh*(tex->sy-sy-1), tex->srw, tex->srh, &c, 0. );
+   frametime_addCount( FRAME_COUNT_SPRITES, 1 );
+   return 0;
+}
+
+/**
+ * @brief Renders a part of an object at the position and direction of a solid.
+ *
+ * When the object is small on the screen its sprite sheet is used instead of
+ *  the meshes.
+ *
+ *    @param object Object to render.
+ *    @param solid Position and direction to render at.
+ *    @param part_name Part to render.
+ *    @param alpha Transparency of the part.
+ *    @param scale Scale of the object.
+ */
+void object_renderSolidPart( Object *object, const Solid *solid, const char *part_name, GLfloat alpha, double scale )
 {
    mat4 view, projection, model, ortho;
    const GLfloat od = NAEV_ORTHO_DIST;
    const GLfloat os = NAEV_ORTHO_SCALE / scale;
-   double x, y; //, r;
+   double x, y, r, px, cx, cy;
 
    x = solid->pos.x;
    y = solid->pos.y;
-   //r = object->radius * scale;
 
-   /*
-   // TODO fix this check to avoid rendering when not necessary
-   if ((x+r < 0.) || (x-r > SCREEN_W) ||
-         (y+r < 0.) || (y-r > SCREEN_H))
+   /* Half size of the object in the space of the projection, and on the
+    * screen. */
+   r  = object->radius / os;
+   px = r * cam_getZoom();
+   gl_gameToScreenCoords( &cx, &cy, x, y );
+   if ((cx+px < 0.) || (cx-px > SCREEN_W) ||
+         (cy+px < 0.) || (cy-px > SCREEN_H))
       return;
-   */
-
-   glUseProgram(shaders.material.program);
 
    projection = gl_gameToScreenMatrix(gl_view_matrix);
    mat4_translate_xy( &projection, x, y );
+
+   /* Small enough for the sprite sheet to look the same. */
+   if (2.*px / gl_screen.mxscale <= OBJECT_SHEET_CELL) {
+      int ret;
+      mat4 tmpm = gl_view_matrix;
+      gl_view_matrix = projection;
+      ret = object_renderSheet( object, part_name, -r, -r, 2.*r, 2.*r, solid->dir, alpha );
+      gl_view_matrix = tmpm;
+      if (ret == 0)
+         return;
+   }
+
+   glUseProgram(shaders.material.program);
+
    ortho = mat4_ortho(-os, os, -os, os, od, -od);
    mat4_mul( &view, &projection, &ortho );
    //projection = mat4_rotate(projection, M_PI/4., 1., 0., 0.);
@@ -464,10 +662,13 @@ void object_renderSolidPart( const Object *object, const Solid *solid, const cha
    gl_uniformMat4(shaders.material.projection, &view);
    gl_uniformMat4(shaders.material.model, &model);
 
-   /* Actually need depth testing now. */
+   /* Actually need depth testing now, only around the object though, as
+    * clearing the depth of the whole screen for each object adds up. */
+   gl_clipRect( floor(cx-px)-1, floor(cy-px)-1, ceil(2.*px)+2, ceil(2.*px)+2 );
+   glClear( GL_DEPTH_BUFFER_BIT );
+   gl_unclipRect();
    glEnable(GL_DEPTH_TEST);
    glDepthFunc(GL_LESS);
-   glClear( GL_DEPTH_BUFFER_BIT );
 
    for (int i=0; i < array_size(object->meshes); ++i)
       if (strcmp(part_name, object->meshes[i].name) == 0)
@@ -14,5 +14,8 @@ struct Object_;
 typedef struct Object_ Object;
 
 Object *object_loadFromFile( const char *filename );
-void object_renderSolidPart( const Object *object, const Solid *solid, const char *part_name, GLfloat alpha, double scale );
+void object_renderSolidPart( Object *object, const Solid *solid, const char *part_name, GLfloat alpha, double scale );
+int object_renderSheet( Object *object, const char *part_name,
+      double x, double y, double w, double h, double dir, GLfloat alpha );
+int object_prefetchSheet( Object *object, const char *part_name );
 void object_free( Object *object );
@@ -38,10 +38,13 @@
 
 #include "opengl.h"
 
+#include "array.h"
 #include "conf.h"
 #include "debug.h"
+#include "frametime.h"
 #include "log.h"
 #include "render.h"
+#include "threadpool.h"
 
 /*
  * Requirements
@@ -62,10 +65,41 @@ static int gl_view_y = 0; /* Y viewport offset. */
 static int gl_view_w = 0; /* Viewport width. */
 static int gl_view_h = 0; /* Viewport height. */
 mat4 gl_view_matrix = {{{{0}}}};
+unsigned int gl_drawCalls = 0; /**< Number of draw calls since last reset. */
+
+/**
+ * @brief Screenshot being read back and written.
+ */
+typedef struct GLScreenshot_ {
+   char *filename;   /**< PhysicsFS path to write to. */
+   int w;            /**< Width of the screenshot. */
+   int h;            /**< Height of the screenshot. */
+   int bpp;          /**< Bytes per pixel, 3 for the screen and 4 for textures. */
+   GLuint pbo;       /**< Pixel buffer the screen is read into. */
+   GLsync fence;     /**< Signalled once the pixels are in the buffer, NULL once read. */
+   SDL_Surface *surface; /**< Pixels being encoded. */
+   SDL_atomic_t done;/**< Set once the file has been written. */
+   int ret;          /**< 0 if the file was written. */
+   gl_screenshotFunc func; /**< Called once done. */
+   gl_screenshotFree cleanup; /**< Releases data if func is never called. */
+   void *data;       /**< Data passed to the function. */
+} GLScreenshot;
+/* Entry points the counting wrappers forward to. */
+static PFNGLDRAWARRAYSPROC gl_realDrawArrays = NULL; /**< Actual glDrawArrays. */
+static PFNGLDRAWELEMENTSPROC gl_realDrawElements = NULL; /**< Actual glDrawElements. */
+static PFNGLTEXIMAGE2DPROC gl_realTexImage2D = NULL; /**< Actual glTexImage2D. */
+static PFNGLTEXSUBIMAGE2DPROC gl_realTexSubImage2D = NULL; /**< Actual glTexSubImage2D. */
+
+static GLScreenshot **gl_shots = NULL; /**< Array (array.h): Pending screenshots. */
+static JobCounter *gl_shotCounter = NULL; /**< Counter of the encoding jobs. */
 
 /*
  * prototypes
  */
+/* misc */
+static GLScreenshot *gl_screenshotNew( const char *filename, int w, int h, int bpp, gl_screenshotFunc func, gl_screenshotFree cleanup, void *data );
+static void gl_screenshotPush( GLScreenshot *s );
+static int gl_screenshotWrite( void *data );
 /* gl */
 static int gl_setupAttributes( int fallback );
 static int gl_createWindow( unsigned int flags );
@@ -73,6 +107,7 @@ static int gl_getFullscreenMode (void);
 static int gl_getGLInfo (void);
 static int gl_defState (void);
 static int gl_setupScaling (void);
+static void gl_hookCounters (void);
 
 /*
  *
@@ -82,41 +117,161 @@ static int gl_setupScaling (void);
 /**
  * @brief Takes a screenshot.
  *
+ * The screen is read into a pixel buffer without waiting on the GPU, and the
+ *  PNG is encoded on a worker thread a few frames later, so taking
+ *  screenshots does not stall the game. See gl_screenshotUpdate.
+ *
  *    @param filename PhysicsFS path (e.g., "screenshots/screenshot042.png") of the file to save screenshot as.
+ *    @param func Function to call once the file is written or failed to, may be NULL.
+ *    @param cleanup Function to release the data if func never gets called, may be NULL.
+ *    @param data Data to pass to the function.
  */
-void gl_screenshot( const char *filename )
+void gl_screenshot( const char *filename, gl_screenshotFunc func, gl_screenshotFree cleanup, void *data )
 {
-   GLubyte *screenbuf;
-   SDL_RWops *rw;
-   SDL_Surface *surface;
-   int w, h;
+   GLScreenshot *s = gl_screenshotNew( filename, gl_screen.rw, gl_screen.rh, 3, func, cleanup, data );
+
+   /* Start reading the pixels into a pixel buffer, which returns right away. */
+   glReadPixels( 0, 0, s->w, s->h, GL_RGB, GL_UNSIGNED_BYTE, NULL );
+   gl_screenshotPush( s );
+}
+
+/**
+ * @brief Saves a texture as a PNG in the background, like gl_screenshot.
+ *
+ *    @param tex Texture to save.
+ *    @param filename PhysicsFS path of the file to save the texture as.
+ *    @param func Function to call once the file is written or failed to, may be NULL.
+ *    @param cleanup Function to release the data if func never gets called, may be NULL.
+ *    @param data Data to pass to the function.
+ */
+void gl_saveTexture( glTexture *tex, const char *filename, gl_screenshotFunc func, gl_screenshotFree cleanup, void *data )
+{
+   GLScreenshot *s;
 
-   /* Allocate data. */
-   w           = gl_screen.rw;
-   h           = gl_screen.rh;
-   screenbuf   = malloc( sizeof(GLubyte) * 3 * w*h );
-   surface     = SDL_CreateRGBSurface( 0, w, h, 24, RGBAMASK );
+   /* The raw texture of one in an atlas is the whole atlas. */
+   gl_atlasUnpack( tex );
 
-   /* Read pixels from buffer -- SLOW. */
+   s = gl_screenshotNew( filename, tex->w, tex->h, 4, func, cleanup, data );
+   glBindTexture( GL_TEXTURE_2D, tex->texture );
+   glGetTexImage( GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+   glBindTexture( GL_TEXTURE_2D, 0 );
+   gl_screenshotPush( s );
+}
+
+/**
+ * @brief Creates a screenshot and binds its pixel buffer to read into.
+ */
+static GLScreenshot *gl_screenshotNew( const char *filename, int w, int h, int bpp, gl_screenshotFunc func, gl_screenshotFree cleanup, void *data )
+{
+   GLScreenshot *s = calloc( 1, sizeof(GLScreenshot) );
+
+   s->filename = strdup( filename );
+   s->w        = w;
+   s->h        = h;
+   s->bpp      = bpp;
+   s->func     = func;
+   s->cleanup  = cleanup;
+   s->data     = data;
+
+   glGenBuffers( 1, &s->pbo );
+   glBindBuffer( GL_PIXEL_PACK_BUFFER, s->pbo );
+   glBufferData( GL_PIXEL_PACK_BUFFER, bpp * w * h, NULL, GL_STREAM_READ );
    glPixelStorei(GL_PACK_ALIGNMENT, 1); /* Force them to pack the bytes. */
-   glReadPixels( 0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, screenbuf );
+   return s;
+}
+
+/**
+ * @brief Fences the read of a screenshot and adds it to the pending ones.
+ */
+static void gl_screenshotPush( GLScreenshot *s )
+{
+   glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+   s->fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+   /* Check to see if an error occurred. */
+   gl_checkErr();
+
+   if (gl_shots == NULL)
+      gl_shots = array_create( GLScreenshot* );
+   array_push_back( &gl_shots, s );
+}
 
-   /* Convert data. */
-   for (int i=0; i<h; i++)
-      memcpy( (GLubyte*)surface->pixels + i * surface->pitch, &screenbuf[ (h - i - 1) * (3*w) ], 3*w );
-   free( screenbuf );
+/**
+ * @brief Encodes and writes a screenshot, run as a job.
+ */
+static int gl_screenshotWrite( void *data )
+{
+   GLScreenshot *s = data;
+   SDL_RWops *rw;
 
    /* Save PNG. */
-   if (!(rw = PHYSFSRWOPS_openWrite( filename )))
+   if (!(rw = PHYSFSRWOPS_openWrite( s->filename ))) {
       WARN( _("Aborting screenshot") );
+      s->ret = -1;
+   }
    else
-      IMG_SavePNG_RW( surface, rw, 1 );
+      s->ret = (IMG_SavePNG_RW( s->surface, rw, 1 ) == 0) ? 0 : -1;
 
-   /* Check to see if an error occurred. */
-   gl_checkErr();
+   SDL_AtomicSet( &s->done, 1 );
+   return 0;
+}
 
-   /* Free memory. */
-   SDL_FreeSurface( surface );
+/**
+ * @brief Moves the pending screenshots along, to be called every frame.
+ *
+ *    @param wait Whether or not to wait for all of them to be written.
+ */
+void gl_screenshotUpdate( int wait )
+{
+   for (int i=array_size(gl_shots)-1; i>=0; i--) {
+      GLScreenshot *s = gl_shots[i];
+
+      /* Pixels are in, copy them out flipped and start encoding. */
+      if (s->fence != NULL) {
+         const GLubyte *screenbuf;
+         GLenum status = glClientWaitSync( s->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+               wait ? GL_TIMEOUT_IGNORED : 0 );
+         if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+            continue;
+         glDeleteSync( s->fence );
+         s->fence = NULL;
+
+         s->surface = SDL_CreateRGBSurface( 0, s->w, s->h, 8*s->bpp, RGBAMASK );
+         glBindBuffer( GL_PIXEL_PACK_BUFFER, s->pbo );
+         screenbuf = glMapBuffer( GL_PIXEL_PACK_BUFFER, GL_READ_ONLY );
+         if (screenbuf != NULL) {
+            for (int j=0; j<s->h; j++)
+               memcpy( (GLubyte*)s->surface->pixels + j * s->surface->pitch,
+                     &screenbuf[ (s->h - j - 1) * (s->bpp*s->w) ], s->bpp*s->w );
+            glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+         }
+         glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+         glDeleteBuffers( 1, &s->pbo );
+         gl_checkErr();
+
+         /* Without worker threads there is nothing to gain from deferring it. */
+         if (threadpool_threads() <= 1)
+            gl_screenshotWrite( s );
+         else {
+            if (gl_shotCounter == NULL)
+               gl_shotCounter = job_counterCreate();
+            job_runBackground( gl_shotCounter, gl_screenshotWrite, s );
+         }
+      }
+
+      if (wait && (gl_shotCounter != NULL))
+         job_wait( gl_shotCounter );
+      if (!SDL_AtomicGet( &s->done ))
+         continue;
+
+      /* Done. */
+      if (s->func != NULL)
+         s->func( s->filename, s->ret, s->data );
+      SDL_FreeSurface( s->surface );
+      free( s->filename );
+      free( s );
+      array_erase( &gl_shots, &gl_shots[i], &gl_shots[i+1] );
+   }
 }
 
 /*
@@ -229,6 +384,75 @@ static void GLAPIENTRY gl_debugCallback( GLenum source, GLenum type, GLuint id,
 #endif /* DEBUG_GL */
 #endif /* DEBUGGING */
 
+/**
+ * @brief Draws arrays, counting the draw call for the fps display.
+ *
+ *    @param mode Primitive to render.
+ *    @param first Starting index in the enabled arrays.
+ *    @param count Number of indices to render.
+ */
+void gl_drawArrays( GLenum mode, GLint first, GLsizei count )
+{
+   gl_drawCalls++;
+   glDrawArrays( mode, first, count );
+}
+
+/**
+ * @brief glDrawArrays counting the draw calls of the frame.
+ */
+static void GLAPIENTRY gl_countDrawArrays( GLenum mode, GLint first, GLsizei count )
+{
+   frametime_addCount( FRAME_COUNT_DRAWS, 1 );
+   gl_realDrawArrays( mode, first, count );
+}
+
+/**
+ * @brief glDrawElements counting the draw calls of the frame.
+ */
+static void GLAPIENTRY gl_countDrawElements( GLenum mode, GLsizei count, GLenum type, const void *indices )
+{
+   frametime_addCount( FRAME_COUNT_DRAWS, 1 );
+   gl_realDrawElements( mode, count, type, indices );
+}
+
+/**
+ * @brief glTexImage2D counting the texture uploads of the frame.
+ */
+static void GLAPIENTRY gl_countTexImage2D( GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels )
+{
+   if (pixels != NULL)
+      frametime_addCount( FRAME_COUNT_TEXUPLOADS, 1 );
+   gl_realTexImage2D( target, level, internalformat, width, height, border, format, type, pixels );
+}
+
+/**
+ * @brief glTexSubImage2D counting the texture uploads of the frame.
+ */
+static void GLAPIENTRY gl_countTexSubImage2D( GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels )
+{
+   frametime_addCount( FRAME_COUNT_TEXUPLOADS, 1 );
+   gl_realTexSubImage2D( target, level, xoffset, yoffset, width, height, format, type, pixels );
+}
+
+/**
+ * @brief Wraps the draw and upload entry points to count them.
+ *
+ * The calls are spread all over the code, so the function pointers GLAD
+ *  loaded are swapped for ones that count them for the frame time overlay and
+ *  the Tracy plots.
+ */
+static void gl_hookCounters (void)
+{
+   gl_realDrawArrays    = glad_glDrawArrays;
+   gl_realDrawElements  = glad_glDrawElements;
+   gl_realTexImage2D    = glad_glTexImage2D;
+   gl_realTexSubImage2D = glad_glTexSubImage2D;
+   glad_glDrawArrays    = gl_countDrawArrays;
+   glad_glDrawElements  = gl_countDrawElements;
+   glad_glTexImage2D    = gl_countTexImage2D;
+   glad_glTexSubImage2D = gl_countTexSubImage2D;
+}
+
 /**
  * @brief Tries to set up the OpenGL attributes for the OpenGL context.
  *
@@ -333,13 +557,7 @@ static int gl_createWindow( unsigned int flags )
       ERR(_("Unable to create OpenGL context! %s"), SDL_GetError());
 
    /* Set Vsync. */
-   if (conf.vsync) {
-      int ret = SDL_GL_SetSwapInterval( 1 );
-      if (ret == 0)
-         gl_screen.flags |= OPENGL_VSYNC;
-   } else {
-      SDL_GL_SetSwapInterval( 0 );
-   }
+   gl_setVsync( conf.vsync );
 
    /* Finish getting attributes. */
    gl_screen.current_fbo = 0; /* No FBO set. */
@@ -353,6 +571,27 @@ static int gl_createWindow( unsigned int flags )
    return 0;
 }
 
+/**
+ * @brief Enables or disables vsync on the current context.
+ *
+ *    @param enable Whether or not to sync to the vertical refresh.
+ *    @return 0 on success.
+ */
+int gl_setVsync( int enable )
+{
+   gl_screen.flags &= ~OPENGL_VSYNC;
+   if (!enable) {
+      SDL_GL_SetSwapInterval( 0 );
+      return 0;
+   }
+   if (SDL_GL_SetSwapInterval( 1 ) != 0) {
+      WARN(_("Unable to enable vsync: %s"), SDL_GetError());
+      return -1;
+   }
+   gl_screen.flags |= OPENGL_VSYNC;
+   return 0;
+}
+
 /**
  * @brief Gets some information about the OpenGL window.
  *
@@ -498,6 +737,7 @@ int gl_init (void)
    /* Load extensions. */
    if (!gladLoadGLLoader(SDL_GL_GetProcAddress))
       ERR("Unable to load OpenGL using GLAD");
+   gl_hookCounters();
 
    /* We are interested in 3.1 because it drops all the deprecated stuff. */
    if ( !GLAD_GL_VERSION_3_1 )
@@ -520,6 +760,8 @@ int gl_init (void)
    gl_initTextures();
    gl_initVBO();
    gl_initRender();
+   gl_initTimer();
+   gl_initFrameUniforms();
 
    /* Get info about the OpenGL window */
    gl_getGLInfo();
@@ -721,6 +963,21 @@ void gl_colourblind (void)
  */
 void gl_exit (void)
 {
+   /* Finish writing the screenshots, the callbacks may be gone by now so
+    * only release what they hold. */
+   for (int i=0; i<array_size(gl_shots); i++) {
+      GLScreenshot *s = gl_shots[i];
+      if (s->cleanup != NULL)
+         s->cleanup( s->data );
+      s->func     = NULL;
+      s->cleanup  = NULL;
+   }
+   gl_screenshotUpdate( 1 );
+   array_free( gl_shots );
+   gl_shots = NULL;
+   job_counterDestroy( gl_shotCounter );
+   gl_shotCounter = NULL;
+
    for (int i=0; i<OPENGL_NUM_FBOS; i++) {
       if (gl_screen.fbo[i] != GL_INVALID_VALUE) {
          glDeleteFramebuffers( 1, &gl_screen.fbo[i] );
@@ -731,6 +988,8 @@ void gl_exit (void)
    }
 
    /* Exit the OpenGL subsystems. */
+   gl_exitFrameUniforms();
+   gl_exitTimer();
    gl_exitRender();
    gl_exitVBO();
    gl_exitTextures();
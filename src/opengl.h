@@ -17,6 +17,7 @@
 #include "opengl_render.h"
 #include "opengl_shader.h"
 #include "opengl_tex.h"
+#include "opengl_timer.h"
 #include "opengl_vbo.h"
 #include "mat4.h"
 #include "shaders.gen.h"
@@ -75,6 +76,12 @@ extern glInfo gl_screen; /* local structure set with gl_init and co */
 
 extern mat4 gl_view_matrix;
 
+/*
+ * Draw calls are counted for fps_display.
+ */
+extern unsigned int gl_drawCalls;
+void gl_drawArrays( GLenum mode, GLint first, GLsizei count );
+
 #define  SCREEN_X gl_screen.x /**< Screen X offset. */
 #define  SCREEN_Y gl_screen.y /**< Screen Y offset. */
 #define  SCREEN_W gl_screen.w /**< Screen width. */
@@ -107,6 +114,7 @@ void gl_viewport( int x, int y, int w, int h );
 void gl_defViewport (void);
 void gl_setDefViewport( int x, int y, int w, int h );
 int gl_setupFullscreen (void);
+int gl_setVsync( int enable );
 
 /*
  * misc
@@ -114,7 +122,11 @@ int gl_setupFullscreen (void);
 void gl_colourblind (void);
 GLint gl_stringToFilter( const char *s );
 GLint gl_stringToClamp( const char *s );
-void gl_screenshot( const char *filename );
+typedef void (*gl_screenshotFunc)( const char *filename, int ret, void *data ); /**< Called once a screenshot is written. */
+typedef void (*gl_screenshotFree)( void *data ); /**< Releases the data of a screenshot that will never be done. */
+void gl_screenshot( const char *filename, gl_screenshotFunc func, gl_screenshotFree cleanup, void *data );
+void gl_saveTexture( glTexture *tex, const char *filename, gl_screenshotFunc func, gl_screenshotFree cleanup, void *data );
+void gl_screenshotUpdate( int wait );
 #ifdef DEBUGGING
 #define gl_checkErr()   gl_checkHandleError( __func__, __LINE__ )
 void gl_checkHandleError( const char *func, int line );
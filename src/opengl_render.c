@@ -29,6 +29,7 @@
 
 #include "opengl_render.h"
 
+#include "array.h"
 #include "camera.h"
 #include "conf.h"
 #include "gui.h"
@@ -38,6 +39,17 @@
 #include "opengl.h"
 
 #define OPENGL_RENDER_VBO_SIZE      256 /**< Size of VBO. */
+#define OPENGL_BATCH_STRIDE         9   /**< Floats per batched vertex: position, texture, colour and interpolation. */
+#define OPENGL_MARKER_STRIDE        11  /**< Floats per batched marker vertex: position, local position, colour, dimensions and shape. */
+
+/**
+ * @brief Textured quads sharing the same textures, drawn together.
+ */
+typedef struct glBatch_ {
+   GLuint tex1;   /**< Texture of the quads. */
+   GLuint tex2;   /**< Texture to interpolate with, same as tex1 if not interpolating. */
+   GLfloat *data; /**< Vertex data of the quads (array.h). */
+} glBatch;
 
 static gl_vbo *gl_renderVBO = 0; /**< VBO for rendering stuff. */
 gl_vbo *gl_squareVBO = 0;
@@ -47,6 +59,15 @@ static gl_vbo *gl_lineVBO = 0;
 static gl_vbo *gl_triangleVBO = 0;
 static int gl_renderVBOtexOffset = 0; /**< VBO texture offset. */
 static int gl_renderVBOcolOffset = 0; /**< VBO colour offset. */
+static glBatch *gl_batches = NULL; /**< Pending batches (array.h). */
+static int gl_batchDepth = 0; /**< Number of nested gl_batchBegin. */
+static gl_vbo *gl_batchVBO = NULL; /**< VBO to stream the batches through. */
+static GLfloat *gl_markerData = NULL; /**< Vertex data of the pending markers (array.h). */
+
+static void gl_batchQuad( GLuint tex1, GLuint tex2, uint8_t flags, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle );
 
 void gl_beginSolidProgram(mat4 projection, const glColour *c)
 {
@@ -125,11 +146,11 @@ void gl_renderRectH( const mat4 *H, const glColour *c, int filled )
    gl_beginSolidProgram(*H, c);
    if (filled) {
       gl_vboActivateAttribOffset( gl_squareVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    }
    else {
       gl_vboActivateAttribOffset( gl_squareEmptyVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-      glDrawArrays( GL_LINE_STRIP, 0, 5 );
+      gl_drawArrays( GL_LINE_STRIP, 0, 5 );
    }
    gl_endSolidProgram();
 }
@@ -169,7 +190,7 @@ void gl_renderTriangleEmpty( double x, double y, double a, double s, double leng
 
    gl_beginSolidProgram(projection, c);
    gl_vboActivateAttribOffset( gl_triangleVBO, shaders.solid.vertex, 0, 2, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINE_STRIP, 0, 4 );
+   gl_drawArrays( GL_LINE_STRIP, 0, 4 );
    gl_endSolidProgram();
 }
 
@@ -194,8 +215,6 @@ void gl_renderTextureRaw( GLuint texture, uint8_t flags,
       double tx, double ty, double tw, double th,
       const glColour *c, double angle )
 {
-   // Half width and height
-   double hw, hh;
    mat4 projection, tex_mat;
 
    glUseProgram(shaders.texture.program);
@@ -207,18 +226,15 @@ void gl_renderTextureRaw( GLuint texture, uint8_t flags,
    if (c == NULL)
       c = &cWhite;
 
-   hw = w*0.5;
-   hh = h*0.5;
-
    /* Set the vertex. */
    projection = gl_view_matrix;
    if (angle==0.) {
      mat4_translate_scale_xy( &projection, x, y, w, h );
    }
    else {
-     mat4_translate_xy( &projection, x+hw, y+hh );
-     mat4_rotate2d( &projection, angle );
-     mat4_translate_scale_xy( &projection, -hw, -hh, w, h );
+     affine2d a;
+     affine2d_quad( &a, x, y, w, h, angle );
+     mat4_apply_affine2d( &projection, &a );
    }
    glEnableVertexAttribArray( shaders.texture.vertex );
    gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture.vertex,
@@ -234,7 +250,7 @@ void gl_renderTextureRaw( GLuint texture, uint8_t flags,
    gl_uniformMat4(shaders.texture.tex_mat, &tex_mat);
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture.vertex );
@@ -265,6 +281,18 @@ void gl_renderTexture( const glTexture* texture,
       double tx, double ty, double tw, double th,
       const glColour *c, double angle )
 {
+   /* Textures in an atlas only use their part of it. */
+   if (texture->flags & OPENGL_TEX_ATLAS) {
+      tx = texture->ax + tx*texture->aw;
+      ty = texture->ay + ty*texture->ah;
+      tw *= texture->aw;
+      th *= texture->ah;
+   }
+   if (gl_batchDepth > 0) {
+      gl_batchQuad( texture->texture, texture->texture, texture->flags, 1.,
+            x, y, w, h, tx, ty, tw, th, c, angle );
+      return;
+   }
    gl_renderTextureRaw( texture->texture, texture->flags, x, y, w, h, tx, ty, tw, th, c, angle );
 }
 
@@ -330,7 +358,7 @@ void gl_renderSDF( const glTexture *texture,
    glUniform1f( shaders.texturesdf.m, (2.0*texture->vmax*(w+2.)/texture->w) );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texturesdf.vertex );
@@ -379,6 +407,18 @@ void gl_renderTextureInterpolate(  const glTexture* ta,
       gl_renderTexture( tb, x, y, w, h, tx, ty, tw, th, c, 0. );
       return;
    }
+   /* Both textures are expected to share the same part of an atlas. */
+   if (ta->flags & OPENGL_TEX_ATLAS) {
+      tx = ta->ax + tx*ta->aw;
+      ty = ta->ay + ty*ta->ah;
+      tw *= ta->aw;
+      th *= ta->ah;
+   }
+   if (gl_batchDepth > 0) {
+      gl_batchQuad( ta->texture, tb->texture, ta->flags, inter,
+            x, y, w, h, tx, ty, tw, th, c, 0. );
+      return;
+   }
 
    mat4 projection, tex_mat;
 
@@ -414,7 +454,7 @@ void gl_renderTextureInterpolate(  const glTexture* ta,
    gl_uniformMat4(shaders.texture_interpolate.tex_mat, &tex_mat);
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.texture_interpolate.vertex );
@@ -425,6 +465,208 @@ void gl_renderTextureInterpolate(  const glTexture* ta,
    glUseProgram(0);
 }
 
+/**
+ * @brief Adds a textured quad to the pending batches.
+ *
+ * Same parameters as gl_renderTextureRaw, with an optional second texture to
+ *  interpolate with like gl_renderTextureInterpolate.
+ */
+static void gl_batchQuad( GLuint tex1, GLuint tex2, uint8_t flags, double inter,
+      double x, double y, double w, double h,
+      double tx, double ty, double tw, double th,
+      const glColour *c, double angle )
+{
+   static const GLfloat corners[6][2] = {
+      {0., 0.}, {1., 0.}, {0., 1.},
+      {1., 0.}, {1., 1.}, {0., 1.} };
+   glBatch *batch = NULL;
+   affine2d a;
+   GLfloat *v;
+   int n;
+
+   /* Must have colour for now. */
+   if (c == NULL)
+      c = &cWhite;
+
+   /* Find the batch, there are usually only a handful. */
+   for (int i=0; i<array_size(gl_batches); i++) {
+      if ((gl_batches[i].tex1 == tex1) && (gl_batches[i].tex2 == tex2)) {
+         batch = &gl_batches[i];
+         break;
+      }
+   }
+   if (batch == NULL) {
+      if (gl_batches == NULL)
+         gl_batches = array_create( glBatch );
+      batch = &array_grow( &gl_batches );
+      batch->tex1 = tex1;
+      batch->tex2 = tex2;
+      batch->data = array_create( GLfloat );
+   }
+
+   /* Rotation is done around the center like gl_renderTextureRaw. */
+   affine2d_quad( &a, x, y, w, h, angle );
+
+   /* Two triangles. */
+   n = array_size( batch->data );
+   array_resize( &batch->data, n + 6*OPENGL_BATCH_STRIDE );
+   v = &batch->data[n];
+   for (int i=0; i<6; i++) {
+      GLfloat ty_c = ty + corners[i][1]*th;
+      affine2d_point( &a, corners[i][0], corners[i][1], &v[0], &v[1] );
+      v[2] = tx + corners[i][0]*tw;
+      v[3] = (flags & OPENGL_TEX_VFLIP) ? 1.-ty_c : ty_c;
+      v[4] = c->r;
+      v[5] = c->g;
+      v[6] = c->b;
+      v[7] = c->a;
+      v[8] = inter;
+      v += OPENGL_BATCH_STRIDE;
+   }
+}
+
+/**
+ * @brief Starts batching textured quads.
+ *
+ * Until the matching gl_batchEnd, gl_renderTexture and
+ *  gl_renderTextureInterpolate (and so all the sprite functions) do not draw
+ *  immediately but accumulate the quads by texture, which get drawn with one
+ *  call per texture when flushed. Markers from gl_renderMarker are batched
+ *  the same way and drawn with a single call after the textures. The quads
+ *  end up drawn after anything else rendered in the meantime, so use
+ *  gl_batchFlush when the order matters. The blend mode and view matrix must
+ *  not change while batching.
+ */
+void gl_batchBegin (void)
+{
+   gl_batchDepth++;
+}
+
+/**
+ * @brief Stops batching textured quads and draws the pending ones.
+ */
+void gl_batchEnd (void)
+{
+   if (gl_batchDepth <= 0) {
+      WARN(_("gl_batchEnd called without gl_batchBegin!"));
+      return;
+   }
+   gl_batchDepth--;
+   if (gl_batchDepth == 0)
+      gl_batchFlush();
+}
+
+/**
+ * @brief Uploads vertex data to the batch VBO.
+ */
+static void gl_batchUpload( GLsizei size, const GLfloat *data )
+{
+   if (gl_batchVBO == NULL)
+      gl_batchVBO = gl_vboCreateRing( size );
+   gl_vboRingData( gl_batchVBO, size, data );
+}
+
+/**
+ * @brief Draws the pending markers.
+ */
+static void gl_batchFlushMarkers (void)
+{
+   const GLsizei stride = sizeof(GLfloat) * OPENGL_MARKER_STRIDE;
+   GLsizei size = sizeof(GLfloat) * array_size(gl_markerData);
+   if (size <= 0)
+      return;
+
+   glUseProgram( shaders.marker_batch.program );
+   gl_uniformMat4( shaders.marker_batch.projection, &gl_view_matrix );
+   glEnableVertexAttribArray( shaders.marker_batch.vertex );
+   glEnableVertexAttribArray( shaders.marker_batch.vertex_pos );
+   glEnableVertexAttribArray( shaders.marker_batch.vertex_colour );
+   glEnableVertexAttribArray( shaders.marker_batch.vertex_dim );
+   glEnableVertexAttribArray( shaders.marker_batch.vertex_shape );
+
+   gl_batchUpload( size, gl_markerData );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.marker_batch.vertex,
+         0, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.marker_batch.vertex_pos,
+         sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.marker_batch.vertex_colour,
+         sizeof(GLfloat) * 4, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.marker_batch.vertex_dim,
+         sizeof(GLfloat) * 8, 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gl_batchVBO, shaders.marker_batch.vertex_shape,
+         sizeof(GLfloat) * 10, 1, GL_FLOAT, stride );
+
+   gl_drawArrays( GL_TRIANGLES, 0, array_size(gl_markerData) / OPENGL_MARKER_STRIDE );
+   array_resize( &gl_markerData, 0 );
+
+   glDisableVertexAttribArray( shaders.marker_batch.vertex );
+   glDisableVertexAttribArray( shaders.marker_batch.vertex_pos );
+   glDisableVertexAttribArray( shaders.marker_batch.vertex_colour );
+   glDisableVertexAttribArray( shaders.marker_batch.vertex_dim );
+   glDisableVertexAttribArray( shaders.marker_batch.vertex_shape );
+   glUseProgram( 0 );
+   gl_checkErr();
+}
+
+/**
+ * @brief Draws all the pending batches.
+ */
+void gl_batchFlush (void)
+{
+   const GLsizei stride = sizeof(GLfloat) * OPENGL_BATCH_STRIDE;
+   int shader_bound = 0;
+
+   for (int i=0; i<array_size(gl_batches); i++) {
+      glBatch *batch = &gl_batches[i];
+      GLsizei size = sizeof(GLfloat) * array_size(batch->data);
+      if (size <= 0)
+         continue;
+
+      if (!shader_bound) {
+         glUseProgram( shaders.texture_batch.program );
+         glUniform1i( shaders.texture_batch.sampler1, 0 );
+         glUniform1i( shaders.texture_batch.sampler2, 1 );
+         gl_uniformMat4( shaders.texture_batch.projection, &gl_view_matrix );
+         glEnableVertexAttribArray( shaders.texture_batch.vertex );
+         glEnableVertexAttribArray( shaders.texture_batch.vertex_tex );
+         glEnableVertexAttribArray( shaders.texture_batch.vertex_colour );
+         glEnableVertexAttribArray( shaders.texture_batch.vertex_inter );
+         shader_bound = 1;
+      }
+
+      /* Upload the vertices. */
+      gl_batchUpload( size, batch->data );
+      gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex,
+            0, 2, GL_FLOAT, stride );
+      gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_tex,
+            sizeof(GLfloat) * 2, 2, GL_FLOAT, stride );
+      gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_colour,
+            sizeof(GLfloat) * 4, 4, GL_FLOAT, stride );
+      gl_vboActivateAttribOffset( gl_batchVBO, shaders.texture_batch.vertex_inter,
+            sizeof(GLfloat) * 8, 1, GL_FLOAT, stride );
+
+      /* Bind the textures, always ending with TEXTURE0 active. */
+      glActiveTexture( GL_TEXTURE1 );
+      glBindTexture( GL_TEXTURE_2D, batch->tex2 );
+      glActiveTexture( GL_TEXTURE0 );
+      glBindTexture( GL_TEXTURE_2D, batch->tex1 );
+
+      gl_drawArrays( GL_TRIANGLES, 0, array_size(batch->data) / OPENGL_BATCH_STRIDE );
+      array_resize( &batch->data, 0 );
+   }
+
+   if (shader_bound) {
+      glDisableVertexAttribArray( shaders.texture_batch.vertex );
+      glDisableVertexAttribArray( shaders.texture_batch.vertex_tex );
+      glDisableVertexAttribArray( shaders.texture_batch.vertex_colour );
+      glDisableVertexAttribArray( shaders.texture_batch.vertex_inter );
+      glUseProgram( 0 );
+      gl_checkErr();
+   }
+
+   gl_batchFlushMarkers();
+}
+
 /**
  * @brief Converts in-game coordinates to screen coordinates.
  *
@@ -956,6 +1198,79 @@ void gl_renderShader( double x, double y, double w, double h, double r, const Si
    gl_renderShaderH( shd, &projection, c, center );
 }
 
+/**
+ * @brief Renders a marker.
+ *
+ * Looks like rendering the shader or primitive of its shape (see
+ *  glMarkerShape) centered, but gets batched between gl_batchBegin and
+ *  gl_batchEnd.
+ *
+ *    @param shape Shape of the marker.
+ *    @param x X position of the center.
+ *    @param y Y position of the center.
+ *    @param w Half width.
+ *    @param h Half height.
+ *    @param r Rotation.
+ *    @param c Colour to use.
+ */
+void gl_renderMarker( glMarkerShape shape, double x, double y, double w, double h, double r, const glColour *c )
+{
+   static const GLfloat corners[6][2] = {
+      {-1., -1.}, {1., -1.}, {-1., 1.},
+      {1., -1.}, {1., 1.}, {-1., 1.} };
+   double ca, sa;
+   GLfloat *v;
+   int n;
+
+   if (gl_batchDepth <= 0) {
+      const SimpleShader *shd;
+      switch (shape) {
+         case OPENGL_MARKER_CIRCLE:
+            gl_renderCircle( x, y, w, c, 0 );
+            return;
+         case OPENGL_MARKER_BOX:
+            gl_renderRectEmpty( x-w, y-h, 2.*w, 2.*h, c );
+            return;
+         case OPENGL_MARKER_STEALTH:
+            shd = &shaders.stealthaura;
+            break;
+         case OPENGL_MARKER_ASTEROID:
+            shd = &shaders.asteroidmarker;
+            break;
+         default:
+            shd = &shaders.pilotmarker;
+            break;
+      }
+      glUseProgram( shd->program );
+      gl_renderShader( x, y, w, h, r, shd, c, 1 );
+      return;
+   }
+
+   if (gl_markerData == NULL)
+      gl_markerData = array_create( GLfloat );
+   n = array_size( gl_markerData );
+   array_resize( &gl_markerData, n + 6*OPENGL_MARKER_STRIDE );
+   v = &gl_markerData[n];
+   ca = cos(r);
+   sa = sin(r);
+   for (int i=0; i<6; i++) {
+      double px = corners[i][0]*w;
+      double py = corners[i][1]*h;
+      v[0]  = x + ca*px - sa*py;
+      v[1]  = y + sa*px + ca*py;
+      v[2]  = corners[i][0];
+      v[3]  = corners[i][1];
+      v[4]  = c->r;
+      v[5]  = c->g;
+      v[6]  = c->b;
+      v[7]  = c->a;
+      v[8]  = w;
+      v[9]  = h;
+      v[10] = shape;
+      v += OPENGL_MARKER_STRIDE;
+   }
+}
+
 /**
  * @brief Renders a simple shader with a transformation.
  *
@@ -974,7 +1289,7 @@ void gl_renderShaderH( const SimpleShader *shd, const mat4 *H, const glColour *c
 
    gl_uniformMat4(shd->projection, H);
 
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    glDisableVertexAttribArray(shd->vertex);
    glUseProgram(0);
@@ -1148,4 +1463,14 @@ void gl_exitRender (void)
    gl_vboDestroy( gl_lineVBO );
    gl_vboDestroy( gl_triangleVBO );
    gl_renderVBO = NULL;
+
+   /* Destroy the batches. */
+   for (int i=0; i<array_size(gl_batches); i++)
+      array_free( gl_batches[i].data );
+   array_free( gl_batches );
+   gl_batches = NULL;
+   array_free( gl_markerData );
+   gl_markerData = NULL;
+   gl_vboDestroy( gl_batchVBO );
+   gl_batchVBO = NULL;
 }
@@ -99,9 +99,21 @@ void gl_endSolidProgram (void);
 void gl_beginSmoothProgram(mat4 projection);
 void gl_endSmoothProgram (void);
 
+/**
+ * @brief Shapes of the radar markers, see gl_renderMarker.
+ */
+typedef enum glMarkerShape_ {
+   OPENGL_MARKER_PILOT,    /**< Pilot triangle, like the pilotmarker shader. */
+   OPENGL_MARKER_ASTEROID, /**< Asteroid box, like the asteroidmarker shader. */
+   OPENGL_MARKER_STEALTH,  /**< Detection aura, like the stealthaura shader. */
+   OPENGL_MARKER_CIRCLE,   /**< Empty circle, like gl_renderCircle. */
+   OPENGL_MARKER_BOX,      /**< Empty box, like gl_renderRectEmpty. */
+} glMarkerShape;
+
 /* Simple Shaders. */
 void gl_renderShader( double x, double y, double w, double h, double r, const SimpleShader *shd, const glColour *c, int center );
 void gl_renderShaderH( const SimpleShader *shd, const mat4 *H, const glColour *c, int center );
+void gl_renderMarker( glMarkerShape shape, double x, double y, double w, double h, double r, const glColour *c );
 
 /* Circles. */
 void gl_renderCircle( double x, double y,
@@ -123,6 +135,11 @@ void gl_renderCross( double x, double y, double r, const glColour *c );
 /* Triangle. */
 void gl_renderTriangleEmpty( double x, double y, double a, double s, double length, const glColour *c );
 
+/* Batching. */
+void gl_batchBegin (void);
+void gl_batchEnd (void);
+void gl_batchFlush (void);
+
 /* Clipping. */
 void gl_clipRect( int x, int y, int w, int h );
 void gl_unclipRect (void);
@@ -7,24 +7,76 @@
 #include "naev.h"
 /** @endcond */
 
+#include "array.h"
+#include "camera.h"
 #include "conf.h"
 #include "log.h"
+#include "md5.h"
 #include "ndata.h"
+#include "nfile.h"
 #include "nstring.h"
 #include "opengl.h"
 
 #define GLSL_VERSION    "#version 150\n\n" /**< Version to use for all shaders. */
 #define GLSL_SUBROUTINE "#define HAS_GL_ARB_shader_subroutine 1\n" /**< Has subroutines. */
+#define GLSL_STAGES     3 /**< Vertex, fragment and geometry. */
+#define GLSL_CACHE_DIR  "shaders/" /**< Subdirectory of the cache path for program binaries. */
+#define GLSL_FRAME_BLOCK   "NaevFrame" /**< Uniform block with the per frame data, see lib/frame.glsl. */
+#define GLSL_FRAME_BINDING 0 /**< Binding point of the per frame uniform block. */
+
+/* Not part of OpenGL 3.2, from GL_ARB_get_program_binary and GL_KHR_parallel_shader_compile. */
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT_  0x8257
+#define GL_PROGRAM_BINARY_LENGTH_            0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS_       0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC_)( GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary );
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC_)( GLuint program, GLenum binaryFormat, const void *binary, GLsizei length );
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC_)( GLuint program, GLenum pname, GLint value );
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_)( GLuint count );
+
+/**
+ * @brief A program being built, kept until checked when deferred.
+ */
+typedef struct GLProgramBuild_ {
+   GLuint program;               /**< Program being linked. */
+   GLuint shaders[GLSL_STAGES];  /**< Shaders being compiled. */
+   char *src[GLSL_STAGES];       /**< Preprocessed sources, for error reporting. */
+   char *name[GLSL_STAGES];      /**< Names of the shaders, for error reporting. */
+   md5_byte_t key[16];           /**< Binary cache key. */
+} GLProgramBuild;
+static GLProgramBuild *gl_builds = NULL; /**< Array (array.h): Deferred programs. */
+static int gl_defer     = 0; /**< Whether program checks are being deferred. */
+static int gl_ext_init  = 0; /**< Whether the extensions have been set up. */
+static int gl_binary    = 0; /**< Whether program binaries can be cached. */
+static PFNGLGETPROGRAMBINARYPROC_ gl_getProgramBinary = NULL; /**< glGetProgramBinary. */
+static PFNGLPROGRAMBINARYPROC_ gl_programBinary = NULL; /**< glProgramBinary. */
+static PFNGLPROGRAMPARAMETERIPROC_ gl_programParameteri = NULL; /**< glProgramParameteri. */
+
+/**
+ * @brief Per frame data shared by all the programs, with the std140 layout.
+ */
+typedef struct GLFrameUniforms_ {
+   GLfloat time[4];     /**< Real time elapsed, and duration of the frame. */
+   GLfloat camera[4];   /**< Position and zoom of the camera. */
+   GLfloat screen[4];   /**< Size of the screen, and in real pixels. */
+} GLFrameUniforms;
+static GLuint gl_frame_ubo = 0;  /**< Buffer of the per frame uniform block. */
+static GLFrameUniforms gl_frame; /**< Current per frame data. */
 
 /*
  * Prototypes.
  */
 static char* gl_shader_preprocess( size_t *size, const char *fbuf, size_t fbufsize, const char *prepend, const char *filename );
 static char* gl_shader_loadfile( const char *filename, size_t *size, const char *prepend );
-static GLuint gl_shader_compile( GLuint type, const char *buf,
-      GLint length, const char *filename);
-static int gl_program_link( GLuint program );
-static GLuint gl_program_make( GLuint vertex_shader, GLuint fragment_shader, GLuint geometry_shader );
+static void gl_program_initExt (void);
+static void gl_program_key( md5_byte_t key[16], char *const src[GLSL_STAGES], const size_t size[GLSL_STAGES] );
+static void gl_program_binaryPath( char *path, size_t len, const md5_byte_t key[16] );
+static GLuint gl_program_loadBinary( const md5_byte_t key[16] );
+static void gl_program_saveBinary( GLuint program, const md5_byte_t key[16] );
+static int gl_shader_checkCompile( GLuint shader, const char *buf, const char *filename );
+static int gl_program_checkLink( GLuint program );
+static void gl_program_bindFrame( GLuint program );
+static GLuint gl_program_build( char *src[GLSL_STAGES], const size_t size[GLSL_STAGES], const char *name[GLSL_STAGES] );
+static GLuint gl_program_finish( GLProgramBuild *b );
 static int gl_log_says_anything( const char* log );
 
 /**
@@ -144,20 +196,152 @@ static char* gl_shader_preprocess( size_t *size, const char *fbuf, size_t fbufsi
 }
 
 /**
- * @brief Open and compile GLSL shader from ndata.
+ * @brief Sets up the optional program extensions, needs a context.
  */
-static GLuint gl_shader_compile( GLuint type, const char *buf,
-      GLint length, const char *filename)
+static void gl_program_initExt (void)
 {
-   GLuint shader;
-   GLint compile_status, log_length;
+   GLint nformats = 0;
+
+   if (gl_ext_init)
+      return;
+   gl_ext_init = 1;
+
+   /* Let the driver use as many threads as it wants. */
+   if (SDL_GL_ExtensionSupported( "GL_KHR_parallel_shader_compile" )) {
+      PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_ maxthreads = SDL_GL_GetProcAddress( "glMaxShaderCompilerThreadsKHR" );
+      if (maxthreads != NULL)
+         maxthreads( 0xFFFFFFFF );
+   }
+
+   /* Program binaries need at least one format to be useful. */
+   if (SDL_GL_ExtensionSupported( "GL_ARB_get_program_binary" )) {
+      glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS_, &nformats );
+      gl_getProgramBinary  = SDL_GL_GetProcAddress( "glGetProgramBinary" );
+      gl_programBinary     = SDL_GL_GetProcAddress( "glProgramBinary" );
+      gl_programParameteri = SDL_GL_GetProcAddress( "glProgramParameteri" );
+      gl_binary = (nformats > 0) && (gl_getProgramBinary != NULL) &&
+            (gl_programBinary != NULL) && (gl_programParameteri != NULL);
+   }
+   gl_checkErr();
+}
+
+/**
+ * @brief Computes the program binary cache key of a set of shader sources.
+ */
+static void gl_program_key( md5_byte_t key[16], char *const src[GLSL_STAGES], const size_t size[GLSL_STAGES] )
+{
+   const GLenum strs[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+   md5_state_t md5;
+
+   md5_init( &md5 );
+   for (size_t i=0; i<sizeof(strs)/sizeof(strs[0]); i++) {
+      const char *str = (const char*) glGetString( strs[i] );
+      if (str != NULL)
+         md5_append( &md5, (const md5_byte_t*)str, strlen(str) );
+      md5_append( &md5, (const md5_byte_t*)"\n", 1 );
+   }
+   for (int i=0; i<GLSL_STAGES; i++) {
+      uint32_t len = (src[i] != NULL) ? size[i] : UINT32_MAX;
+      md5_append( &md5, (const md5_byte_t*)&len, sizeof(len) );
+      if (src[i] != NULL)
+         md5_append( &md5, (const md5_byte_t*)src[i], size[i] );
+   }
+   md5_finish( &md5, key );
+}
+
+/**
+ * @brief Gets the path of a program binary in the cache.
+ */
+static void gl_program_binaryPath( char *path, size_t len, const md5_byte_t key[16] )
+{
+   char digest[33];
+   for (int i=0; i<16; i++)
+      snprintf( &digest[i * 2], 3, "%02x", key[i] );
+   snprintf( path, len, "%s"GLSL_CACHE_DIR"%s", nfile_cachePath(), digest );
+}
 
-   /* Compile it. */
-   shader = glCreateShader(type);
-   glShaderSource(shader, 1, (const char**)&buf, &length);
-   glCompileShader(shader);
+/**
+ * @brief Tries to create a program from the binary cache.
+ *
+ *    @return The program or 0 if not cached or the binary was rejected.
+ */
+static GLuint gl_program_loadBinary( const md5_byte_t key[16] )
+{
+   char path[PATH_MAX];
+   char *data;
+   size_t size;
+   uint32_t format;
+   GLuint program;
+   GLint status;
+
+   if (!gl_binary)
+      return 0;
+
+   gl_program_binaryPath( path, sizeof(path), key );
+   if (!nfile_fileExists( path ))
+      return 0;
+   data = nfile_readFile( &size, path );
+   if ((data == NULL) || (size <= sizeof(format))) {
+      free( data );
+      return 0;
+   }
+   memcpy( &format, data, sizeof(format) );
+
+   /* Drivers reject binaries from other versions, so this is always safe. */
+   program = glCreateProgram();
+   gl_programBinary( program, format, &data[sizeof(format)], size-sizeof(format) );
+   free( data );
+   glGetProgramiv( program, GL_LINK_STATUS, &status );
+   if (status == GL_FALSE) {
+      glDeleteProgram( program );
+      program = 0;
+   }
+   /* Clear errors from rejected formats. */
+   while (glGetError() != GL_NO_ERROR);
+   return program;
+}
+
+/**
+ * @brief Saves a linked program to the binary cache.
+ */
+static void gl_program_saveBinary( GLuint program, const md5_byte_t key[16] )
+{
+   char path[PATH_MAX];
+   GLint len = 0;
+   GLsizei written = 0;
+   GLenum format = 0;
+   uint32_t format32;
+   char *data;
+
+   if (!gl_binary)
+      return;
+
+   glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH_, &len );
+   if (len <= 0)
+      return;
+   data = malloc( sizeof(format32) + len );
+   gl_getProgramBinary( program, len, &written, &format, &data[sizeof(format32)] );
+   if (written > 0) {
+      format32 = format;
+      memcpy( data, &format32, sizeof(format32) );
+      snprintf( path, sizeof(path), "%s"GLSL_CACHE_DIR, nfile_cachePath() );
+      nfile_dirMakeExist( path );
+      gl_program_binaryPath( path, sizeof(path), key );
+      nfile_writeFile( data, sizeof(format32) + written, path );
+   }
+   free( data );
+   gl_checkErr();
+}
+
+/**
+ * @brief Checks the compile status of a shader.
+ *
+ *    @return 0 on success.
+ */
+static int gl_shader_checkCompile( GLuint shader, const char *buf, const char *filename )
+{
+   GLint compile_status, log_length;
 
-   /* Check for compile error */
    glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
    if (log_length > 0) {
@@ -168,25 +352,21 @@ static GLuint gl_shader_compile( GLuint type, const char *buf,
          WARN("compile_status==%d: %s: [[\n%s\n]]", compile_status, filename, log);
       }
       free(log);
-      if (compile_status == GL_FALSE)
-         shader = 0;
    }
    gl_checkErr();
-   return shader;
+   return (compile_status == GL_FALSE) ? -1 : 0;
 }
 
 /**
- * @brief Link a GLSL program and check for link error.
+ * @brief Checks for link errors of a GLSL program.
  *
- *    @param[in] program Program to link.
+ *    @param[in] program Program to check.
  *    @return 0 on success.
  */
-static int gl_program_link( GLuint program )
+static int gl_program_checkLink( GLuint program )
 {
    GLint link_status, log_length;
 
-   glLinkProgram(program);
-
    /* Check for linking error */
    glGetProgramiv(program, GL_LINK_STATUS, &link_status);
    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
@@ -196,118 +376,281 @@ static int gl_program_link( GLuint program )
       if (gl_log_says_anything( log ))
          WARN("link_status==%d: [[\n%s\n]]", link_status, log);
       free(log);
-      if (link_status == GL_FALSE)
-         return -1;
    }
 
-   return 0;
+   return (link_status == GL_FALSE) ? -1 : 0;
 }
 
 /**
- * @brief Loads a vertex and fragment shader from files.
+ * @brief Builds a program from preprocessed shader sources.
  *
- *    @param[in] vertfile Vertex shader filename.
- *    @param[in] fragfile Fragment shader filename.
- *    @param[in,opt] geomfile Optional geometry shader name.
- *    @return The shader compiled program or 0 on failure.
+ * Takes ownership of the sources. When deferring (see gl_program_deferBegin)
+ *  the compilation and link are only started, and the program has to be
+ *  checked with gl_program_check before being used.
+ *
+ *    @param src Vertex, fragment and (optional) geometry shader sources.
+ *    @param size Sizes of the sources.
+ *    @param name Names of the shaders for error reporting, may be NULL.
+ *    @return The program or 0 on failure.
  */
-GLuint gl_program_vert_frag( const char *vertfile, const char *fragfile, const char *geomfile )
+static GLuint gl_program_build( char *src[GLSL_STAGES], const size_t size[GLSL_STAGES], const char *name[GLSL_STAGES] )
 {
-   char *vert_str, *frag_str, prepend[STRMAX];
-   size_t vert_size, frag_size;
-   GLuint vertex_shader, fragment_shader, geometry_shader, program;
+   const GLenum types[GLSL_STAGES] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+   GLProgramBuild b;
+
+   memset( &b, 0, sizeof(b) );
+   if ((src[0] == NULL) || (src[1] == NULL)) {
+      for (int i=0; i<GLSL_STAGES; i++)
+         free( src[i] );
+      return 0;
+   }
 
-   strncpy( prepend, GLSL_VERSION, sizeof(prepend)-1 );
-   if (gl_has( OPENGL_SUBROUTINES ))
-      strncat( prepend, GLSL_SUBROUTINE, sizeof(prepend)-strlen(prepend)-1 );
+   /* Try the cache first. */
+   gl_program_initExt();
+   gl_program_key( b.key, src, size );
+   b.program = gl_program_loadBinary( b.key );
+   if (b.program != 0) {
+      for (int i=0; i<GLSL_STAGES; i++)
+         free( src[i] );
+      gl_program_bindFrame( b.program );
+      return b.program;
+   }
 
-   vert_str = gl_shader_loadfile( vertfile, &vert_size, prepend );
-   frag_str = gl_shader_loadfile( fragfile, &frag_size, prepend );
+   /* Start compiling and linking without waiting on the results. */
+   b.program = glCreateProgram();
+   for (int i=0; i<GLSL_STAGES; i++) {
+      GLint len;
+      if (src[i] == NULL)
+         continue;
+      len = size[i];
+      b.shaders[i] = glCreateShader( types[i] );
+      glShaderSource( b.shaders[i], 1, (const char**)&src[i], &len );
+      glCompileShader( b.shaders[i] );
+      glAttachShader( b.program, b.shaders[i] );
+      b.src[i]  = src[i];
+      b.name[i] = (name[i] != NULL) ? strdup( name[i] ) : NULL;
+   }
+   if (gl_binary)
+      gl_programParameteri( b.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT_, GL_TRUE );
+   glLinkProgram( b.program );
+   gl_checkErr();
 
-   vertex_shader     = gl_shader_compile( GL_VERTEX_SHADER, vert_str, vert_size, vertfile );
-   fragment_shader   = gl_shader_compile( GL_FRAGMENT_SHADER, frag_str, frag_size, fragfile );
+   if (gl_defer) {
+      if (gl_builds == NULL)
+         gl_builds = array_create( GLProgramBuild );
+      array_push_back( &gl_builds, b );
+      return b.program;
+   }
+   return gl_program_finish( &b );
+}
 
-   free( vert_str );
-   free( frag_str );
+/**
+ * @brief Waits for a program to be built and checks it.
+ *
+ *    @return The program or 0 on failure.
+ */
+static GLuint gl_program_finish( GLProgramBuild *b )
+{
+   GLuint program = b->program;
+   int failed = 0;
+
+   for (int i=0; i<GLSL_STAGES; i++) {
+      if (b->shaders[i] == 0)
+         continue;
+      if (gl_shader_checkCompile( b->shaders[i], b->src[i], b->name[i] ) != 0)
+         failed = 1;
+      glDeleteShader( b->shaders[i] );
+   }
+   if (gl_program_checkLink( program ) != 0)
+      failed = 1;
+
+   if (failed) {
+      if ((b->name[0] != NULL) && (b->name[1] != NULL))
+         WARN(_("Failed to link vertex shader '%s' and fragment shader '%s'!"), b->name[0], b->name[1]);
+      /* Spec specifies 0 as failure value for glCreateProgram() */
+      glDeleteProgram( program );
+      program = 0;
+   }
+   else {
+      gl_program_saveBinary( program, b->key );
+      gl_program_bindFrame( program );
+   }
 
-   if (geomfile != NULL) {
-      size_t geom_size;
-      char *geom_str = gl_shader_loadfile( geomfile, &geom_size, prepend );
-      geometry_shader = gl_shader_compile( GL_GEOMETRY_SHADER, geom_str, geom_size, geomfile );
-      free( geom_str );
+   for (int i=0; i<GLSL_STAGES; i++) {
+      free( b->src[i] );
+      free( b->name[i] );
    }
-   else
-      geometry_shader = 0;
+   gl_checkErr();
+   return program;
+}
+
+/**
+ * @brief Binds the per frame uniform block of a program if it uses it.
+ */
+static void gl_program_bindFrame( GLuint program )
+{
+   GLuint block = glGetUniformBlockIndex( program, GLSL_FRAME_BLOCK );
+   if (block != GL_INVALID_INDEX)
+      glUniformBlockBinding( program, block, GLSL_FRAME_BINDING );
+}
+
+/**
+ * @brief Sets up the per frame uniform block.
+ */
+void gl_initFrameUniforms (void)
+{
+   memset( &gl_frame, 0, sizeof(gl_frame) );
+   glGenBuffers( 1, &gl_frame_ubo );
+   glBindBuffer( GL_UNIFORM_BUFFER, gl_frame_ubo );
+   glBufferData( GL_UNIFORM_BUFFER, sizeof(GLFrameUniforms), &gl_frame, GL_DYNAMIC_DRAW );
+   glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+   glBindBufferBase( GL_UNIFORM_BUFFER, GLSL_FRAME_BINDING, gl_frame_ubo );
+   gl_checkErr();
+}
+
+/**
+ * @brief Cleans up the per frame uniform block.
+ */
+void gl_exitFrameUniforms (void)
+{
+   glDeleteBuffers( 1, &gl_frame_ubo );
+   gl_frame_ubo = 0;
+}
+
+/**
+ * @brief Uploads the per frame data once for all the programs.
+ *
+ * Shaders that include "lib/frame.glsl" get the time, camera and screen size
+ *  without having to set them as uniforms of each program every frame.
+ *
+ *    @param dt Real duration of the frame.
+ */
+void gl_updateFrameUniforms( double dt )
+{
+   double cx, cy;
+
+   if (gl_frame_ubo == 0)
+      return;
+
+   cam_getPos( &cx, &cy );
+   gl_frame.time[0]   += dt;
+   gl_frame.time[1]   = dt;
+   gl_frame.camera[0] = cx;
+   gl_frame.camera[1] = cy;
+   gl_frame.camera[2] = cam_getZoom();
+   gl_frame.screen[0] = SCREEN_W;
+   gl_frame.screen[1] = SCREEN_H;
+   gl_frame.screen[2] = gl_screen.rw;
+   gl_frame.screen[3] = gl_screen.rh;
+
+   glBindBuffer( GL_UNIFORM_BUFFER, gl_frame_ubo );
+   glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof(GLFrameUniforms), &gl_frame );
+   glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+   gl_checkErr();
+}
 
-   program = gl_program_make( vertex_shader, fragment_shader, geometry_shader );
-   if (program==0)
-      WARN(_("Failed to link vertex shader '%s' and fragment shader '%s'!"), vertfile, fragfile);
+/**
+ * @brief Starts deferring program checks so that all the programs created
+ *        until gl_program_deferEnd can be compiled concurrently by the driver.
+ */
+void gl_program_deferBegin (void)
+{
+   gl_defer = 1;
+}
 
+/**
+ * @brief Waits for a deferred program and checks it.
+ *
+ * Programs that were not deferred are returned as is.
+ *
+ *    @param program Program to check.
+ *    @return The program or 0 if it failed to build.
+ */
+GLuint gl_program_check( GLuint program )
+{
+   for (int i=0; i<array_size(gl_builds); i++) {
+      if (gl_builds[i].program != program)
+         continue;
+      program = gl_program_finish( &gl_builds[i] );
+      array_erase( &gl_builds, &gl_builds[i], &gl_builds[i+1] );
+      return program;
+   }
    return program;
 }
 
 /**
- * @brief Loads a vertex and fragment shader from strings.
+ * @brief Stops deferring program checks, checking the remaining programs.
+ */
+void gl_program_deferEnd (void)
+{
+   for (int i=0; i<array_size(gl_builds); i++)
+      gl_program_finish( &gl_builds[i] );
+   array_free( gl_builds );
+   gl_builds = NULL;
+   gl_defer = 0;
+}
+
+/**
+ * @brief Loads a vertex and fragment shader from files.
  *
- *    @param[in] vert Vertex shader string.
- *    @param[in] vert_size Size of the vertex shader string.
- *    @param[in] frag Fragment shader string.
- *    @param[in] frag_size Size of the fragment shader string.
+ *    @param[in] vertfile Vertex shader filename.
+ *    @param[in] fragfile Fragment shader filename.
+ *    @param[in,opt] geomfile Optional geometry shader name.
  *    @return The shader compiled program or 0 on failure.
  */
-GLuint gl_program_vert_frag_string( const char *vert, size_t vert_size, const char *frag, size_t frag_size )
+GLuint gl_program_vert_frag( const char *vertfile, const char *fragfile, const char *geomfile )
 {
-   GLuint vertex_shader, fragment_shader;
-   char *vbuf, *fbuf;
-   size_t vlen, flen;
+   return gl_program_vert_frag_defines( vertfile, fragfile, geomfile, NULL );
+}
 
-   vbuf = gl_shader_preprocess( &vlen, vert, vert_size, NULL, NULL );
-   fbuf = gl_shader_preprocess( &flen, frag, frag_size, NULL, NULL );
+/**
+ * @brief Loads a vertex and fragment shader from files with extra defines.
+ *
+ *    @param[in] vertfile Vertex shader filename.
+ *    @param[in] fragfile Fragment shader filename.
+ *    @param[in,opt] geomfile Optional geometry shader name.
+ *    @param[in,opt] defines Optional preprocessor lines to add to all the shaders.
+ *    @return The shader compiled program or 0 on failure.
+ */
+GLuint gl_program_vert_frag_defines( const char *vertfile, const char *fragfile, const char *geomfile, const char *defines )
+{
+   char *src[GLSL_STAGES], prepend[STRMAX];
+   size_t size[GLSL_STAGES] = { 0 };
+   const char *name[GLSL_STAGES] = { vertfile, fragfile, geomfile };
 
-   /* Compile the shaders. */
-   vertex_shader     = gl_shader_compile( GL_VERTEX_SHADER, vbuf, vlen, NULL );
-   fragment_shader   = gl_shader_compile( GL_FRAGMENT_SHADER, fbuf, flen, NULL );
+   strncpy( prepend, GLSL_VERSION, sizeof(prepend)-1 );
+   if (gl_has( OPENGL_SUBROUTINES ))
+      strncat( prepend, GLSL_SUBROUTINE, sizeof(prepend)-strlen(prepend)-1 );
+   if (defines != NULL)
+      strncat( prepend, defines, sizeof(prepend)-strlen(prepend)-1 );
 
-   /* Clean up. */
-   free( vbuf );
-   free( fbuf );
+   src[0] = gl_shader_loadfile( vertfile, &size[0], prepend );
+   src[1] = gl_shader_loadfile( fragfile, &size[1], prepend );
+   src[2] = (geomfile != NULL) ? gl_shader_loadfile( geomfile, &size[2], prepend ) : NULL;
 
-   /* Link. */
-   return gl_program_make( vertex_shader, fragment_shader, 0 );
+   return gl_program_build( src, size, name );
 }
 
 /**
- * @brief Makes a shader program from a vertex and fragment shader.
+ * @brief Loads a vertex and fragment shader from strings.
  *
- *    @param vertex_shader Vertex shader to make program from.
- *    @param fragment_shader Fragment shader to make program from.
- *    @param[opt] geometry_shader Optional geometry shader to amke program from.
- *    @return New shader program or 0 on failure.
+ *    @param[in] vert Vertex shader string.
+ *    @param[in] vert_size Size of the vertex shader string.
+ *    @param[in] frag Fragment shader string.
+ *    @param[in] frag_size Size of the fragment shader string.
+ *    @return The shader compiled program or 0 on failure.
  */
-static GLuint gl_program_make( GLuint vertex_shader, GLuint fragment_shader, GLuint geometry_shader )
+GLuint gl_program_vert_frag_string( const char *vert, size_t vert_size, const char *frag, size_t frag_size )
 {
-   GLuint program = 0;
-   if (vertex_shader != 0 && fragment_shader != 0) {
-      program = glCreateProgram();
-      glAttachShader(program, vertex_shader);
-      glAttachShader(program, fragment_shader);
-      if (geometry_shader != 0)
-         glAttachShader(program, geometry_shader);
-
-      if (gl_program_link(program) == -1) {
-         /* Spec specifies 0 as failure value for glCreateProgram() */
-         program = 0;
-      }
+   char *src[GLSL_STAGES];
+   size_t size[GLSL_STAGES] = { 0 };
+   const char *name[GLSL_STAGES] = { NULL, NULL, NULL };
 
-      glDeleteShader(vertex_shader);
-      glDeleteShader(fragment_shader);
-      if (geometry_shader != 0)
-         glDeleteShader(geometry_shader);
-   }
-
-   gl_checkErr();
+   src[0] = gl_shader_preprocess( &size[0], vert, vert_size, NULL, NULL );
+   src[1] = gl_shader_preprocess( &size[1], frag, frag_size, NULL, NULL );
+   src[2] = NULL;
 
-   return program;
+   return gl_program_build( src, size, name );
 }
 
 void gl_uniformColour(GLint location, const glColour *c)
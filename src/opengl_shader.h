@@ -8,7 +8,14 @@
 #include "mat4.h"
 
 GLuint gl_program_vert_frag( const char *vert, const char *frag, const char *geom );
+GLuint gl_program_vert_frag_defines( const char *vert, const char *frag, const char *geom, const char *defines );
 GLuint gl_program_vert_frag_string( const char *vert, size_t vert_size, const char *frag, size_t frag_size );
+void gl_program_deferBegin (void);
+GLuint gl_program_check( GLuint program );
+void gl_program_deferEnd (void);
+void gl_initFrameUniforms (void);
+void gl_exitFrameUniforms (void);
+void gl_updateFrameUniforms( double dt );
 void gl_uniformColour( GLint location, const glColour *c );
 void gl_uniformAColour( GLint location, const glColour *c, GLfloat a );
 void gl_uniformMat4( GLint location, const mat4 *m );
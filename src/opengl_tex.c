@@ -9,6 +9,7 @@
 /** @cond */
 #include <stdio.h>
 #include <stdlib.h>
+#include "physfs.h"
 #include "physfsrwops.h"
 #include "SDL_image.h"
 
@@ -19,11 +20,15 @@
 #include "array.h"
 #include "conf.h"
 #include "gui.h"
+#include "loadprof.h"
 #include "log.h"
 #include "md5.h"
+#include "memstats.h"
+#include "ndata.h"
 #include "nfile.h"
 #include "nstring.h"
 #include "opengl.h"
+#include "threadpool.h"
 
 /*
  * graphic list
@@ -43,9 +48,82 @@ typedef struct glTexList_ {
    int sy; /**< Y sprites */
 } glTexList;
 static glTexList* texture_list = NULL; /**< Texture list. */
+
+/*
+ * Atlases.
+ */
+#define TEX_ATLAS_SIZE     2048  /**< Maximum width and height of an atlas. */
+#define TEX_ATLAS_PAD      8     /**< Padding and alignment of the textures in an atlas. */
+#define TEX_ATLAS_MIPMAPS  3     /**< Mipmap levels an atlas keeps, the padding must cover them. */
+/**
+ * @brief An OpenGL texture shared by the textures packed into it.
+ */
+typedef struct glAtlas_ {
+   GLuint texture; /**< OpenGL texture of the atlas. */
+   int used; /**< Number of textures still living in the atlas. */
+} glAtlas;
+static glAtlas* tex_atlases = NULL; /**< Atlases in use (array.h). */
 static SDL_threadID tex_mainthread;
 static SDL_mutex* tex_lock = NULL;
 
+/*
+ * Compressed textures, read from DDS files next to the images.
+ */
+#define TEX_DDS_HEADER        124   /**< Size of the DDS header (after the magic). */
+#define TEX_DDS_HEADER_DX10   20    /**< Size of the DX10 header extension. */
+#define TEX_DDS_LEVELS_MAX    16    /**< Maximum number of mipmap levels used. */
+#define TEX_FOURCC(a,b,c,d)   ((uint32_t)(a) | ((uint32_t)(b)<<8) | ((uint32_t)(c)<<16) | ((uint32_t)(d)<<24)) /**< Builds a FourCC code. */
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT  0x8C4D /**< From GL_EXT_texture_sRGB. */
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT  0x8C4F /**< From GL_EXT_texture_sRGB. */
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM     0x8E8D /**< From GL_ARB_texture_compression_bptc. */
+#endif
+/**
+ * @brief Parsed DDS file, pointing into the file data.
+ */
+typedef struct glDDS_ {
+   GLenum format;    /**< OpenGL compressed format. */
+   int w;            /**< Width of the first level. */
+   int h;            /**< Height of the first level. */
+   int levels;       /**< Number of mipmap levels. */
+   const uint8_t *data[TEX_DDS_LEVELS_MAX]; /**< Data of each level. */
+   size_t size[TEX_DDS_LEVELS_MAX]; /**< Size of each level. */
+} glDDS;
+static int tex_s3tc = 0; /**< Whether S3TC (BC1 and BC3) textures are supported. */
+static int tex_bptc = 0; /**< Whether BPTC (BC7) textures are supported. */
+
+/*
+ * Asynchronous loading.
+ */
+#define TEX_LOADER_STAGING_MAX   (64*1024*1024) /**< Maximum size of a staging buffer upload. */
+/**
+ * @brief An image being loaded by a glTexLoader.
+ */
+typedef struct glTexLoad_ {
+   char *path;             /**< Path of the image. */
+   int sx;                 /**< X sprites. */
+   int sy;                 /**< Y sprites. */
+   unsigned int flags;     /**< Flags to use. */
+   glTexture **out;        /**< Where to store the texture. */
+   SDL_Surface *surface;   /**< Decoded RGBA surface, NULL on failure. */
+   uint8_t *dds;           /**< Compressed texture data instead of the surface. */
+   size_t dds_size;        /**< Size of the compressed texture data. */
+   int w;                  /**< Width of the image. */
+   int h;                  /**< Height of the image. */
+   uint8_t *trans;         /**< Transparency map if OPENGL_TEX_MAPTRANS. */
+} glTexLoad;
+/**
+ * @brief A batch of asynchronous image loads.
+ */
+struct glTexLoader_ {
+   JobCounter *counter;    /**< Counter of the decode jobs. */
+   glTexLoad **loads;      /**< Array (array.h): Loads, pointers are stable for the jobs. */
+};
+
 /*
  * prototypes
  */
@@ -54,15 +132,33 @@ static uint8_t SDL_GetAlpha( SDL_Surface* s, int x, int y );
 static int SDL_IsTrans( SDL_Surface* s, int x, int y );
 static uint8_t* SDL_MapAlpha( SDL_Surface* s, int w, int h, int tight );
 static size_t gl_transSize( const int w, const int h );
+static void gl_transMask( glTexture *tex, const uint8_t *trans, int w, int h );
+static uint8_t* gl_transLoad( const char *name, SDL_Surface* surface, SDL_RWops *rw, int w, int h );
+static int gl_transHashFile( SDL_RWops *rw, char digest[17] );
+static uint8_t* gl_transReadCache( const char *cachefile, size_t cachesize );
+static void gl_transWriteCache( const char *cachefile, const uint8_t *trans, size_t cachesize );
 /* glTexture */
 static GLuint gl_texParameters( unsigned int flags );
+static void gl_texSetParameters( unsigned int flags );
+static void gl_texMipmaps (void);
+static int gl_ddsPath( char *buf, size_t len, const char *path );
+static int gl_ddsParse( const uint8_t *data, size_t size, glDDS *dds );
+static uint8_t* gl_ddsRead( const char *path, size_t *size );
+static GLuint gl_ddsUpload( const uint8_t *data, size_t size, unsigned int flags, int *w, int *h );
+static glTexture* gl_texNew( const char *name, unsigned int flags, int w, int h, int sx, int sy );
 static GLuint gl_loadSurface( SDL_Surface* surface, unsigned int flags, int freesur, double *vmax );
 static glTexture* gl_loadNewImage( const char* path, unsigned int flags );
 static glTexture* gl_loadNewImageRWops( const char *path, SDL_RWops *rw, unsigned int flags );
+static int gl_texLoadJob( void *data );
+static int gl_texLoadDecode( glTexLoad *l );
 /* List. */
 static glTexture* gl_texExists( const char* path, int sx, int sy );
 static int gl_texAdd( glTexture *tex, int sx, int sy );
 static int tex_cmp( const void *p1, const void *p2 );
+static void gl_deleteTexture( glTexture *tex );
+static void gl_atlasRelease( const glTexture *tex );
+static SDL_Surface* gl_atlasSurface( const glTexture *tex );
+static int64_t gl_texMemory( const glTexture *tex );
 
 static void tex_ctxSet (void)
 {
@@ -206,7 +302,31 @@ static size_t gl_transSize( const int w, const int h )
 }
 
 /**
- * @brief Sets default texture parameters.
+ * @brief Builds the collision bitmask of a texture from its transparency map.
+ *
+ * Rows are stored as whole 64 bit words so that collisions can test many
+ *  pixels at once.
+ *
+ *    @param tex Texture to set the bitmask of.
+ *    @param trans Transparency map as generated by SDL_MapAlpha.
+ *    @param w Width of the map.
+ *    @param h Height of the map.
+ */
+static void gl_transMask( glTexture *tex, const uint8_t *trans, int w, int h )
+{
+   tex->trans_w = MAX( 1, (w + 63) / 64 );
+   tex->trans   = calloc( tex->trans_w * MAX( 1, h ), sizeof(uint64_t) );
+   for (int i=0; i<h; i++) {
+      for (int j=0; j<w; j++) {
+         int b = i*w+j;
+         if (trans[ b/8 ] & (1 << (b%8)))
+            tex->trans[ i*tex->trans_w + j/64 ] |= UINT64_C(1) << (j%64);
+      }
+   }
+}
+
+/**
+ * @brief Creates a texture with the default texture parameters.
  */
 static GLuint gl_texParameters( unsigned int flags )
 {
@@ -215,7 +335,16 @@ static GLuint gl_texParameters( unsigned int flags )
    /* opengl texture binding */
    glGenTextures( 1, &texture ); /* Creates the texture */
    glBindTexture( GL_TEXTURE_2D, texture ); /* Loads the texture */
+   gl_texSetParameters( flags );
 
+   return texture;
+}
+
+/**
+ * @brief Sets the default texture parameters of the bound texture.
+ */
+static void gl_texSetParameters( unsigned int flags )
+{
    /* Filtering, LINEAR is better for scaling, nearest looks nicer, LINEAR
     * also seems to create a bit of artifacts around the edges */
    if ((gl_screen.scale != 1.) || (flags & OPENGL_TEX_MIPMAPS)) {
@@ -236,7 +365,212 @@ static GLuint gl_texParameters( unsigned int flags )
 
    /* Check errors. */
    gl_checkErr();
+}
+
+/**
+ * @brief Restores the default parameters of a texture, undoing changes such
+ *        as the ones done by the Lua filter and wrap settings.
+ *
+ *    @param tex Texture to reset.
+ */
+void gl_texResetParameters( const glTexture *tex )
+{
+   /* The atlas has its own parameters. */
+   if (tex->flags & OPENGL_TEX_ATLAS)
+      return;
+   glBindTexture( GL_TEXTURE_2D, tex->texture );
+   gl_texSetParameters( tex->flags );
+   glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+/**
+ * @brief Generates the mipmaps of the bound texture.
+ */
+static void gl_texMipmaps (void)
+{
+   /* Do fancy stuff. */
+   if (GLAD_GL_ARB_texture_filter_anisotropic) {
+      GLfloat param;
+      glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &param);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, param);
+   }
+
+   /* Now generate the mipmaps. */
+   glGenerateMipmap(GL_TEXTURE_2D);
+}
 
+/**
+ * @brief Gets the path of the compressed version of an image.
+ *
+ *    @return 0 on success.
+ */
+static int gl_ddsPath( char *buf, size_t len, const char *path )
+{
+   const char *ext = strrchr( path, '.' );
+   if ((ext == NULL) || (strchr( ext, '/' ) != NULL))
+      return -1;
+   snprintf( buf, len, "%.*s.dds", (int)(ext-path), path );
+   return 0;
+}
+
+/**
+ * @brief Parses a DDS header.
+ *
+ *    @param data File data.
+ *    @param size Size of the file data.
+ *    @param[out] dds Parsed information.
+ *    @return 0 if the data is a DDS file the current context can use.
+ */
+static int gl_ddsParse( const uint8_t *data, size_t size, glDDS *dds )
+{
+   uint32_t hdr[TEX_DDS_HEADER/4], fourcc, dxgi, bs;
+   size_t offset;
+   int w, h;
+
+   if ((size < 4+TEX_DDS_HEADER) || (memcmp( data, "DDS ", 4 ) != 0))
+      return -1;
+   /* Always little endian. */
+   for (int i=0; i<TEX_DDS_HEADER/4; i++)
+      hdr[i] = SDL_SwapLE32( ((const uint32_t*)(data+4))[i] );
+   if (hdr[0] != TEX_DDS_HEADER)
+      return -1;
+
+   h        = hdr[2];
+   w        = hdr[3];
+   fourcc   = hdr[20];
+   offset   = 4+TEX_DDS_HEADER;
+   dds->levels = MAX( 1, (int)hdr[6] );
+
+   /* Figure out the format. */
+   if (fourcc == TEX_FOURCC('D','X','1','0')) {
+      if (size < offset+TEX_DDS_HEADER_DX10)
+         return -1;
+      dxgi = SDL_SwapLE32( *(const uint32_t*)(data+offset) );
+      offset += TEX_DDS_HEADER_DX10;
+      switch (dxgi) {
+         case 71: /* DXGI_FORMAT_BC1_UNORM */
+         case 72: /* DXGI_FORMAT_BC1_UNORM_SRGB */
+            fourcc = TEX_FOURCC('D','X','T','1');
+            break;
+         case 77: /* DXGI_FORMAT_BC3_UNORM */
+         case 78: /* DXGI_FORMAT_BC3_UNORM_SRGB */
+            fourcc = TEX_FOURCC('D','X','T','5');
+            break;
+         case 98: /* DXGI_FORMAT_BC7_UNORM */
+         case 99: /* DXGI_FORMAT_BC7_UNORM_SRGB */
+            fourcc = 0;
+            break;
+         default:
+            return -1;
+      }
+   }
+   if (fourcc == TEX_FOURCC('D','X','T','1')) {
+      if (!tex_s3tc)
+         return -1;
+      dds->format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+      bs = 8;
+   }
+   else if (fourcc == TEX_FOURCC('D','X','T','5')) {
+      if (!tex_s3tc)
+         return -1;
+      dds->format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+      bs = 16;
+   }
+   else if (fourcc == 0) {
+      if (!tex_bptc)
+         return -1;
+      dds->format = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+      bs = 16;
+   }
+   else
+      return -1;
+
+   /* Compute the levels, stopping at the first one that doesn't fit. */
+   dds->w = w;
+   dds->h = h;
+   for (int i=0; i<dds->levels; i++) {
+      size_t lsize = (size_t)MAX( 1, (w+3)/4 ) * MAX( 1, (h+3)/4 ) * bs;
+      if ((i >= TEX_DDS_LEVELS_MAX) || (offset+lsize > size)) {
+         dds->levels = i;
+         break;
+      }
+      dds->data[i] = data + offset;
+      dds->size[i] = lsize;
+      offset += lsize;
+      w = MAX( 1, w/2 );
+      h = MAX( 1, h/2 );
+   }
+   return (dds->levels > 0) ? 0 : -1;
+}
+
+/**
+ * @brief Reads the compressed version of an image if there is a usable one.
+ *
+ * Does not touch OpenGL so it can be run from any thread.
+ *
+ *    @param path Path of the image.
+ *    @param[out] size Size of the returned data.
+ *    @return The DDS file data or NULL if not available.
+ */
+static uint8_t* gl_ddsRead( const char *path, size_t *size )
+{
+   char ddspath[PATH_MAX];
+   uint8_t *data;
+   glDDS dds;
+
+   if ((!tex_s3tc && !tex_bptc) || (path == NULL))
+      return NULL;
+   if ((gl_ddsPath( ddspath, sizeof(ddspath), path ) != 0) || !ndata_exists( ddspath ))
+      return NULL;
+
+   data = ndata_read( ddspath, size );
+   if (data == NULL)
+      return NULL;
+   if (gl_ddsParse( data, *size, &dds ) != 0) {
+      WARN(_("Compressed texture '%s' is invalid or unsupported, using '%s'."), ddspath, path);
+      free( data );
+      return NULL;
+   }
+   return data;
+}
+
+/**
+ * @brief Uploads a compressed texture.
+ *
+ *    @param data DDS file data, see gl_ddsRead.
+ *    @param size Size of the data.
+ *    @param flags Flags to use.
+ *    @param[out] w Width of the texture.
+ *    @param[out] h Height of the texture.
+ *    @return The OpenGL texture or 0 on error.
+ */
+static GLuint gl_ddsUpload( const uint8_t *data, size_t size, unsigned int flags, int *w, int *h )
+{
+   GLuint texture;
+   glDDS dds;
+
+   if (gl_ddsParse( data, size, &dds ) != 0)
+      return 0;
+
+   SDL_mutexP( tex_lock );
+   tex_ctxSet();
+
+   texture = gl_texParameters( flags );
+   for (int i=0; i<dds.levels; i++)
+      glCompressedTexImage2D( GL_TEXTURE_2D, i, dds.format,
+            MAX( 1, dds.w>>i ), MAX( 1, dds.h>>i ), 0, dds.size[i], dds.data[i] );
+   /* Mipmaps come from the file, can't generate them from compressed data. */
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, dds.levels-1 );
+   if ((flags & OPENGL_TEX_MIPMAPS) && (dds.levels == 1))
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+   glBindTexture( GL_TEXTURE_2D, 0 );
+   gl_checkErr();
+
+   tex_ctxUnset();
+   SDL_mutexV( tex_lock );
+
+   *w = dds.w;
+   *h = dds.h;
    return texture;
 }
 
@@ -317,6 +651,7 @@ glTexture* gl_loadImageData( float *data, int w, int h, int sx, int sy, const ch
    texture->sh    = texture->h / texture->sy;
    texture->srw   = texture->sw / texture->w;
    texture->srh   = texture->sh / texture->h;
+   memstats_add( MEMTAG_TEXTURES, gl_texMemory( texture ) );
 
    /* Add to list. */
    if (name != NULL) {
@@ -384,17 +719,8 @@ static GLuint gl_loadSurface( SDL_Surface* surface, unsigned int flags, int free
       SDL_FreeSurface(rgba);
 
    /* Create mipmaps. */
-   if (flags & OPENGL_TEX_MIPMAPS) {
-      /* Do fancy stuff. */
-      if (GLAD_GL_ARB_texture_filter_anisotropic) {
-         GLfloat param;
-         glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &param);
-         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, param);
-      }
-
-      /* Now generate the mipmaps. */
-      glGenerateMipmap(GL_TEXTURE_2D);
-   }
+   if (flags & OPENGL_TEX_MIPMAPS)
+      gl_texMipmaps();
 
    /* Unbind the texture. */
    glBindTexture(GL_TEXTURE_2D, 0);
@@ -410,12 +736,212 @@ static GLuint gl_loadSurface( SDL_Surface* surface, unsigned int flags, int free
    return texture;
 }
 
+/**
+ * @brief Hashes the contents of an image file (FNV-1a).
+ *
+ *    @param rw RWops to hash, read from the start.
+ *    @param[out] digest Hexadecimal hash.
+ *    @return 0 on success.
+ */
+static int gl_transHashFile( SDL_RWops *rw, char digest[17] )
+{
+   uint64_t h = 14695981039346656037u;
+   uint8_t buf[4096];
+   size_t n;
+
+   if (SDL_RWseek( rw, 0, RW_SEEK_SET ) < 0)
+      return -1;
+   while ((n = SDL_RWread( rw, buf, 1, sizeof(buf) )) > 0) {
+      for (size_t i=0; i<n; i++) {
+         h ^= buf[i];
+         h *= 1099511628211u;
+      }
+   }
+   snprintf( digest, 17, "%016"PRIx64, h );
+   return 0;
+}
+
+/**
+ * @brief Reads a cached transparency map.
+ *
+ *    @param cachefile Path of the cache file.
+ *    @param cachesize Size the transparency map must have.
+ *    @return The transparency map or NULL if not cached.
+ */
+static uint8_t* gl_transReadCache( const char *cachefile, size_t cachesize )
+{
+   size_t filesize;
+   uint8_t *trans;
+
+   if (!nfile_fileExists(cachefile))
+      return NULL;
+   trans = (uint8_t*)nfile_readFile( &filesize, cachefile );
+   /* Consider cached data invalid if the length doesn't match. */
+   if ((trans != NULL) && (cachesize != filesize)) {
+      free(trans);
+      trans = NULL;
+   }
+   return trans;
+}
+
+/**
+ * @brief Writes a transparency map to the cache.
+ *
+ *    @param cachefile Path of the cache file.
+ *    @param trans Transparency map to write.
+ *    @param cachesize Size of the transparency map.
+ */
+static void gl_transWriteCache( const char *cachefile, const uint8_t *trans, size_t cachesize )
+{
+   char dirpath[PATH_MAX];
+   snprintf( dirpath, sizeof(dirpath), "%s/%s", nfile_cachePath(), "collisions/" );
+   nfile_dirMakeExist( dirpath );
+   nfile_writeFile( (const char*)trans, cachesize, cachefile );
+}
+
+/**
+ * @brief Gets the transparency map of a surface, using the disk cache when possible.
+ *
+ * A decoded surface is mapped straight away, as that is cheaper than reading
+ *  and hashing the file to find the cache. Only compressed textures, which
+ *  would otherwise have to decode their companion image, use the cache. It is
+ *  looked up first by the path, size and modification time of the file, and
+ *  then by the hash of the contents when that key misses.
+ *
+ * Does not touch OpenGL nor the texture list so it can be run from any thread.
+ *
+ *    @param name Name of the texture, path of the image for the cache key.
+ *    @param surface Surface to get transparency map of, if NULL it gets
+ *           decoded from rw only when not cached.
+ *    @param rw RWops containing the image.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ *    @return Newly allocated transparency map.
+ */
+static uint8_t* gl_transLoad( const char *name, SDL_Surface* surface, SDL_RWops *rw, int w, int h )
+{
+   size_t cachesize;
+   uint8_t *trans;
+   char *keyfile, *hashfile;
+   SDL_Surface *decoded;
+
+   /* Already decoded, just map it. */
+   if (surface != NULL) {
+      SDL_LockSurface(surface);
+      trans = SDL_MapAlpha( surface, w, h, 1 );
+      SDL_UnlockSurface(surface);
+      return trans;
+   }
+   if (rw == NULL) {
+      WARN(_("Texture '%s' has no RWops"), name);
+      return NULL;
+   }
+
+   /* Appropriate size for the transparency map, see SDL_MapAlpha */
+   cachesize = gl_transSize(w, h);
+   keyfile  = NULL;
+   hashfile = NULL;
+   trans    = NULL;
+
+   /* Look up by file metadata, which needs no reading. */
+   if (name != NULL) {
+      PHYSFS_Stat stat;
+      if (PHYSFS_stat( name, &stat )) {
+         md5_state_t md5;
+         md5_byte_t md5val[16];
+         char digest[33];
+         int64_t info[4] = { stat.filesize, stat.modtime, w, h };
+         md5_init( &md5 );
+         md5_append( &md5, (const md5_byte_t*)name, strlen(name)+1 );
+         md5_append( &md5, (const md5_byte_t*)info, sizeof(info) );
+         md5_finish( &md5, md5val );
+         for (int i=0; i<16; i++)
+            snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
+         SDL_asprintf( &keyfile, "%scollisions/k%s", nfile_cachePath(), digest );
+         trans = gl_transReadCache( keyfile, cachesize );
+         if (trans != NULL) {
+            free( keyfile );
+            return trans;
+         }
+      }
+   }
+
+   /* Same contents may have been cached under another key. */
+   {
+      char digest[17];
+      if (gl_transHashFile( rw, digest ) == 0) {
+         SDL_asprintf( &hashfile, "%scollisions/%s", nfile_cachePath(), digest );
+         trans = gl_transReadCache( hashfile, cachesize );
+      }
+   }
+
+   /* Compressed textures only decode the companion image when needed. */
+   if (trans == NULL) {
+      SDL_RWseek( rw, 0, RW_SEEK_SET );
+      decoded = IMG_Load_RW( rw, 0 );
+      if ((decoded != NULL) && ((decoded->w != w) || (decoded->h != h))) {
+         WARN(_("Image '%s' does not match the size of its compressed texture."), name);
+         SDL_FreeSurface( decoded );
+         decoded = NULL;
+      }
+      if (decoded != NULL) {
+         SDL_LockSurface(decoded);
+         trans = SDL_MapAlpha( decoded, w, h, 1 );
+         SDL_UnlockSurface(decoded);
+         SDL_FreeSurface( decoded );
+         if (hashfile != NULL)
+            gl_transWriteCache( hashfile, trans, cachesize );
+      }
+   }
+
+   /* Remember it under the metadata key for next time. */
+   if ((trans != NULL) && (keyfile != NULL))
+      gl_transWriteCache( keyfile, trans, cachesize );
+
+   free( keyfile );
+   free( hashfile );
+   return trans;
+}
+
+/**
+ * @brief Gets the transparency map of a surface to set with gl_texSetTransMap.
+ *
+ * Does not touch OpenGL so it can be run from any thread.
+ *
+ *    @param name Name of the texture for warnings.
+ *    @param surface Surface to get transparency map of.
+ *    @param rw RWops of the image, only read when there is no surface.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ *    @return Newly allocated transparency map or NULL on failure.
+ */
+uint8_t* gl_transMapLoad( const char *name, SDL_Surface* surface, SDL_RWops *rw, int w, int h )
+{
+   return gl_transLoad( name, surface, rw, w, h );
+}
+
+/**
+ * @brief Sets the transparency map of a texture if it doesn't have one yet.
+ *
+ *    @param tex Texture to set transparency map of.
+ *    @param trans Transparency map from gl_transMapLoad.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ */
+void gl_texSetTransMap( glTexture *tex, const uint8_t *trans, int w, int h )
+{
+   SDL_mutexP( tex_lock );
+   if (tex->trans == NULL)
+      gl_transMask( tex, trans, w, h );
+   SDL_mutexV( tex_lock );
+}
+
 /**
  * @brief Wrapper for gl_loadImagePad that includes transparency mapping.
  *
  *    @param name Name to load with.
  *    @param surface Surface to load.
- *    @param rw RWops containing data to hash.
+ *    @param rw RWops of the image, only read when there is no surface.
  *    @param flags Flags to use.
  *    @param w Non-padded width.
  *    @param h Non-padded height.
@@ -428,10 +954,7 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
       unsigned int flags, int w, int h, int sx, int sy, int freesur )
 {
    glTexture *texture = NULL;
-   size_t filesize, cachesize;
    uint8_t *trans;
-   char *cachefile;
-   char digest[33];
 
    SDL_mutexP( tex_lock );
 
@@ -448,81 +971,16 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
    if (flags & OPENGL_TEX_MAPTRANS)
       flags ^= OPENGL_TEX_MAPTRANS;
 
-   /* Appropriate size for the transparency map, see SDL_MapAlpha */
-   cachesize = gl_transSize(w, h);
-
-   cachefile = NULL;
-   trans     = NULL;
-
-   if (rw != NULL) {
-      size_t pngsize;
-      md5_state_t md5;
-      char *data;
-      md5_byte_t *md5val = malloc(16);
-      md5_init(&md5);
-
-      pngsize = SDL_RWseek( rw, 0, SEEK_END );
-      SDL_RWseek( rw, 0, SEEK_SET );
-
-      data = malloc(pngsize);
-      if (data == NULL)
-         WARN(_("Out of Memory"));
-      else {
-         SDL_RWread( rw, data, pngsize, 1 );
-         md5_append( &md5, (md5_byte_t*)data, pngsize );
-         free(data);
-      }
-      md5_finish( &md5, md5val );
-
-      for (int i=0; i<16; i++)
-         snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
-      free(md5val);
-
-      SDL_asprintf( &cachefile, "%scollisions/%s",
-         nfile_cachePath(), digest );
-
-      /* Attempt to find a cached transparency map. */
-      if (nfile_fileExists(cachefile)) {
-         trans = (uint8_t*)nfile_readFile( &filesize, cachefile );
-
-         /* Consider cached data invalid if the length doesn't match. */
-         if (trans != NULL && cachesize != (unsigned int)filesize) {
-            free(trans);
-            trans = NULL;
-         }
-         /* Cached data matches, no need to overwrite. */
-         else {
-            free(cachefile);
-            cachefile = NULL;
-         }
-      }
-   }
-   else {
-      /* We could hash raw pixel data here, but that's slower than just
-       * generating the map from scratch. */
-      WARN(_("Texture '%s' has no RWops"), name);
-   }
-
-   if (trans == NULL) {
-      SDL_LockSurface(surface);
-      trans = SDL_MapAlpha( surface, w, h, 1 );
-      SDL_UnlockSurface(surface);
-
-      if (cachefile != NULL) {
-         /* Cache newly-generated transparency map. */
-         char dirpath[PATH_MAX];
-         snprintf( dirpath, sizeof(dirpath), "%s/%s", nfile_cachePath(), "collisions/" );
-         nfile_dirMakeExist( dirpath );
-         nfile_writeFile( (char*)trans, cachesize, cachefile );
-         free(cachefile);
-      }
-   }
+   trans = gl_transLoad( name, surface, rw, w, h );
 
    if (texture == NULL)
       texture = gl_loadImagePad( name, surface, flags, w, h, sx, sy, freesur );
    else if (freesur)
       SDL_FreeSurface( surface );
-   texture->trans = trans;
+   if (trans != NULL) {
+      gl_transMask( texture, trans, w, h );
+      free( trans );
+   }
    SDL_mutexV( tex_lock );
    return texture;
 }
@@ -562,21 +1020,65 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
       return texture;
    }
 
-   /* set up the texture defaults */
-   texture = calloc( 1, sizeof(glTexture) );
+   /* Prefer the compressed version if there is one of the same size. */
+   if (!(flags & OPENGL_TEX_SDF)) {
+      size_t size;
+      uint8_t *dds = gl_ddsRead( name, &size );
+      if (dds != NULL) {
+         glDDS info;
+         GLuint tex = 0;
+         int dw, dh;
+         gl_ddsParse( dds, size, &info );
+         if ((info.w != surface->w) || (info.h != surface->h))
+            WARN(_("Compressed texture for '%s' does not match the image size, ignoring."), name);
+         else
+            tex = gl_ddsUpload( dds, size, flags, &dw, &dh );
+         free( dds );
+         if (tex != 0) {
+            texture = gl_texNew( name, flags, w, h, sx, sy );
+            texture->texture = tex;
+            if (freesur)
+               SDL_FreeSurface( surface );
+            SDL_mutexV( tex_lock );
+            return texture;
+         }
+      }
+   }
+
+   texture = gl_texNew( name, flags, w, h, sx, sy );
+   texture->texture = gl_loadSurface( surface, flags, freesur, &texture->vmax );
+
+   SDL_mutexV( tex_lock );
+   return texture;
+}
+
+/**
+ * @brief Creates a new glTexture without an OpenGL texture and adds it to the
+ *        list if it has a name.
+ *
+ *    @param name Name to load with.
+ *    @param flags Flags to use.
+ *    @param w Width.
+ *    @param h Height.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @return The new glTexture.
+ */
+static glTexture* gl_texNew( const char *name, unsigned int flags, int w, int h, int sx, int sy )
+{
+   glTexture *texture = calloc( 1, sizeof(glTexture) );
 
    texture->w     = (double) w;
    texture->h     = (double) h;
    texture->sx    = (double) sx;
    texture->sy    = (double) sy;
-
-   texture->texture = gl_loadSurface( surface, flags, freesur, &texture->vmax );
-
    texture->sw    = texture->w / texture->sx;
    texture->sh    = texture->h / texture->sy;
    texture->srw   = texture->sw / texture->w;
    texture->srh   = texture->sh / texture->h;
    texture->flags = flags;
+   texture->vmax  = 1.;
+   memstats_add( MEMTAG_TEXTURES, gl_texMemory( texture ) );
 
    if (name != NULL) {
       texture->name = strdup(name);
@@ -585,7 +1087,6 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
    else
       texture->name = NULL;
 
-   SDL_mutexV( tex_lock );
    return texture;
 }
 
@@ -721,6 +1222,7 @@ static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
 {
    glTexture *texture;
    SDL_RWops *rw;
+   Uint64 t;
 
    if (path==NULL) {
       WARN(_("Trying to load image from NULL path."));
@@ -728,6 +1230,7 @@ static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
    }
 
    /* Load from packfile */
+   t = loadprof_fileBegin();
    rw = PHYSFSRWOPS_openRead( path );
    if (rw == NULL) {
       WARN(_("Failed to load surface '%s' from ndata."), path);
@@ -737,6 +1240,7 @@ static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
    texture = gl_loadNewImageRWops( path, rw, flags );
 
    SDL_RWclose( rw );
+   loadprof_fileEnd( LOADPROF_IMAGE, path, t );
    return texture;
 }
 
@@ -854,6 +1358,288 @@ glTexture* gl_newSpriteRWops( const char* path, SDL_RWops *rw,
    return texture;
 }
 
+/**
+ * @brief Starts a batch of asynchronous image loads.
+ *
+ * Images added with gl_texLoaderAdd get decoded (and get their transparency
+ *  map generated) on the worker threads right away, gl_texLoaderWait then
+ *  uploads all of them at once through a staging buffer.
+ *
+ *    @return The new loader.
+ */
+glTexLoader* gl_texLoaderCreate (void)
+{
+   glTexLoader *ld = calloc( 1, sizeof(glTexLoader) );
+   ld->counter = job_counterCreate();
+   ld->loads   = array_create( glTexLoad* );
+   return ld;
+}
+
+/**
+ * @brief Decodes an image on a worker thread.
+ */
+static int gl_texLoadJob( void *data )
+{
+   glTexLoad *l = data;
+   Uint64 t = loadprof_fileBegin();
+   int ret = gl_texLoadDecode( l );
+   loadprof_fileEnd( LOADPROF_IMAGE, l->path, t );
+   return ret;
+}
+
+/**
+ * @brief Decodes an image and builds its transparency map.
+ */
+static int gl_texLoadDecode( glTexLoad *l )
+{
+   SDL_Surface *surface;
+   SDL_RWops *rw;
+
+   /* Compressed textures skip decoding entirely. */
+   if (!(l->flags & OPENGL_TEX_SDF))
+      l->dds = gl_ddsRead( l->path, &l->dds_size );
+   if (l->dds != NULL) {
+      glDDS info;
+      gl_ddsParse( l->dds, l->dds_size, &info );
+      l->w = info.w;
+      l->h = info.h;
+      if (l->flags & OPENGL_TEX_MAPTRANS) {
+         rw = PHYSFSRWOPS_openRead( l->path );
+         if (rw != NULL) {
+            l->trans = gl_transLoad( l->path, NULL, rw, l->w, l->h );
+            SDL_RWclose( rw );
+         }
+      }
+      return 0;
+   }
+
+   rw = PHYSFSRWOPS_openRead( l->path );
+   if (rw == NULL) {
+      WARN(_("Failed to load surface '%s' from ndata."), l->path);
+      return -1;
+   }
+   surface = IMG_Load_RW( rw, 0 );
+   if (surface == NULL) {
+      WARN(_("Unable to load image '%s'."), l->path );
+      SDL_RWclose( rw );
+      return -1;
+   }
+   if (l->flags & OPENGL_TEX_MAPTRANS)
+      l->trans = gl_transLoad( l->path, surface, rw, surface->w, surface->h );
+   SDL_RWclose( rw );
+
+   /* Convert here so the upload only has to copy. */
+   if (surface->format->format != SDL_PIXELFORMAT_ABGR8888) {
+      SDL_Surface *rgba = SDL_ConvertSurfaceFormat( surface, SDL_PIXELFORMAT_ABGR8888, 0 );
+      SDL_FreeSurface( surface );
+      surface = rgba;
+   }
+   l->surface = surface;
+   l->w = surface->w;
+   l->h = surface->h;
+   return 0;
+}
+
+/**
+ * @brief Adds an image to load to a loader.
+ *
+ * Same as gl_newSprite (or gl_newImage with sx and sy of 1), except the
+ *  texture is only available in out after gl_texLoaderWait.
+ *
+ *    @param ld Loader to add to.
+ *    @param path Image to load.
+ *    @param sx Number of X sprites in image.
+ *    @param sy Number of Y sprites in image.
+ *    @param flags Flags to control image parameters.
+ *    @param[out] out Where to store the texture once loaded, set to NULL on failure.
+ */
+void gl_texLoaderAdd( glTexLoader *ld, const char *path, int sx, int sy,
+      unsigned int flags, glTexture **out )
+{
+   glTexLoad *l = calloc( 1, sizeof(glTexLoad) );
+   l->path  = strdup( path );
+   l->sx    = sx;
+   l->sy    = sy;
+   l->flags = flags | OPENGL_TEX_VFLIP;
+   l->out   = out;
+   *out     = NULL;
+   array_push_back( &ld->loads, l );
+   job_run( ld->counter, gl_texLoadJob, l );
+}
+
+/**
+ * @brief Whether or not a load was decoded successfully.
+ */
+static int gl_texLoadOK( const glTexLoad *l )
+{
+   return (l->surface != NULL) || (l->dds != NULL);
+}
+
+/**
+ * @brief Whether or not a load goes through the staging buffer.
+ */
+static int gl_texLoadStaged( const glTexLoad *l )
+{
+   return (l->surface != NULL) && !(l->flags & OPENGL_TEX_SDF);
+}
+
+/**
+ * @brief Finishes a load, creating the glTexture.
+ *
+ *    @param l Load to finish.
+ *    @param offset Offset in the bound staging buffer or NULL if not staged.
+ */
+static void gl_texLoadFinish( glTexLoad *l, const void *offset )
+{
+   glTexture *texture;
+   unsigned int flags = l->flags & ~OPENGL_TEX_MAPTRANS;
+
+   /* May have been loaded meanwhile (or earlier in the batch). */
+   if (!(flags & OPENGL_TEX_SKIPCACHE)) {
+      texture = gl_texExists( l->path, l->sx, l->sy );
+      if (texture != NULL) {
+         if ((l->trans != NULL) && (texture->trans == NULL))
+            gl_transMask( texture, l->trans, l->w, l->h );
+         *l->out = texture;
+         return;
+      }
+   }
+
+   texture = gl_texNew( l->path, flags, l->w, l->h, l->sx, l->sy );
+   if (l->dds != NULL) {
+      int w, h;
+      texture->texture = gl_ddsUpload( l->dds, l->dds_size, flags, &w, &h );
+   }
+   else if (offset == NULL)
+      texture->texture = gl_loadSurface( l->surface, flags, 0, &texture->vmax );
+   else {
+      texture->texture = gl_texParameters( flags );
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, l->surface->w, l->surface->h,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, offset );
+      if (flags & OPENGL_TEX_MIPMAPS)
+         gl_texMipmaps();
+      glBindTexture( GL_TEXTURE_2D, 0 );
+   }
+   if (l->trans != NULL)
+      gl_transMask( texture, l->trans, l->w, l->h );
+   *l->out = texture;
+}
+
+/**
+ * @brief Uploads a range of decoded loads through a single staging buffer.
+ */
+static void gl_texLoaderUpload( glTexLoad **loads, int n, size_t size )
+{
+   GLuint pbo;
+   uint8_t *dst;
+   size_t offset;
+
+   glGenBuffers( 1, &pbo );
+   glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo );
+   glBufferData( GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW );
+   dst = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size,
+         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+   if (dst == NULL) {
+      /* Fall back to uploading from the surfaces directly. */
+      glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+      glDeleteBuffers( 1, &pbo );
+      for (int i=0; i<n; i++)
+         if (gl_texLoadOK( loads[i] ))
+            gl_texLoadFinish( loads[i], NULL );
+      return;
+   }
+
+   /* Copy tightly packed rows. */
+   offset = 0;
+   for (int i=0; i<n; i++) {
+      const SDL_Surface *sur = loads[i]->surface;
+      size_t row;
+      if (!gl_texLoadStaged( loads[i] ))
+         continue;
+      row = (size_t)sur->w * 4;
+      for (int y=0; y<sur->h; y++)
+         memcpy( &dst[ offset + y*row ], (const uint8_t*)sur->pixels + y*sur->pitch, row );
+      offset += row * sur->h;
+   }
+   glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+
+   /* Create the textures from the staging buffer. */
+   offset = 0;
+   for (int i=0; i<n; i++) {
+      glTexLoad *l = loads[i];
+      if (!gl_texLoadOK( l ))
+         continue;
+      if (!gl_texLoadStaged( l )) {
+         glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+         gl_texLoadFinish( l, NULL );
+         glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo );
+         continue;
+      }
+      gl_texLoadFinish( l, (const void*)(uintptr_t)offset );
+      offset += (size_t)l->surface->w * l->surface->h * 4;
+   }
+
+   glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+   glDeleteBuffers( 1, &pbo );
+   gl_checkErr();
+}
+
+/**
+ * @brief Waits for all the images of a loader and uploads them.
+ *
+ * Has to be called from the main thread, the loader gets freed.
+ *
+ *    @param ld Loader to wait for.
+ */
+void gl_texLoaderWait( glTexLoader *ld )
+{
+   int n = array_size( ld->loads );
+
+   /* Help decoding while waiting. */
+   job_wait( ld->counter );
+   job_counterDestroy( ld->counter );
+
+   SDL_mutexP( tex_lock );
+   tex_ctxSet();
+   for (int i=0; i<n; ) {
+      size_t size = 0;
+      int j;
+      for (j=i; j<n; j++) {
+         const glTexLoad *l = ld->loads[j];
+         size_t sz;
+         if (!gl_texLoadStaged( l ))
+            continue;
+         sz = (size_t)l->surface->w * l->surface->h * 4;
+         if ((size > 0) && (size + sz > TEX_LOADER_STAGING_MAX))
+            break;
+         size += sz;
+      }
+      if (size > 0)
+         gl_texLoaderUpload( &ld->loads[i], j-i, size );
+      else {
+         for (int k=i; k<j; k++)
+            if (gl_texLoadOK( ld->loads[k] ))
+               gl_texLoadFinish( ld->loads[k], NULL );
+      }
+      i = j;
+   }
+   tex_ctxUnset();
+   SDL_mutexV( tex_lock );
+
+   /* Clean up. */
+   for (int i=0; i<n; i++) {
+      glTexLoad *l = ld->loads[i];
+      if (l->surface != NULL)
+         SDL_FreeSurface( l->surface );
+      free( l->dds );
+      free( l->trans );
+      free( l->path );
+      free( l );
+   }
+   array_free( ld->loads );
+   free( ld );
+}
+
 /**
  * @brief Frees a texture.
  *
@@ -877,7 +1663,7 @@ void gl_freeTexture( glTexture *texture )
       cur->used--;
       if (cur->used <= 0) { /* not used anymore */
          /* free the texture */
-         glDeleteTextures( 1, &texture->texture );
+         gl_deleteTexture( texture );
          free(texture->trans);
          free(texture->name);
          free(texture);
@@ -897,7 +1683,7 @@ void gl_freeTexture( glTexture *texture )
    tex_ctxSet();
 
    /* Free anyways */
-   glDeleteTextures( 1, &texture->texture );
+   gl_deleteTexture( texture );
    free(texture->trans);
    free(texture->name);
    free(texture);
@@ -937,6 +1723,362 @@ glTexture* gl_dupTexture( const glTexture *texture )
    return NULL;
 }
 
+/**
+ * @brief Gets how many references a texture has.
+ *
+ *    @param texture Texture to check.
+ *    @return Number of references, 0 if it is not in the texture list.
+ */
+int gl_texUses( const glTexture *texture )
+{
+   int used = 0;
+   SDL_mutexP( tex_lock );
+   for (int i=0; i<array_size(texture_list); i++) {
+      if (texture_list[i].tex == texture) {
+         used = texture_list[i].used;
+         break;
+      }
+   }
+   SDL_mutexV( tex_lock );
+   return used;
+}
+
+/**
+ * @brief Estimates the video memory used by a texture from its uncompressed
+ *        size, ignoring mipmaps and atlas padding.
+ */
+static int64_t gl_texMemory( const glTexture *tex )
+{
+   return (int64_t)tex->w * (int64_t)tex->h * 4;
+}
+
+/**
+ * @brief Releases a reference to an atlas, deleting it with the last one.
+ *
+ *    @param tex Texture living in the atlas.
+ */
+static void gl_atlasRelease( const glTexture *tex )
+{
+   for (int i=0; i<array_size(tex_atlases); i++) {
+      glAtlas *a = &tex_atlases[i];
+      if (a->texture != tex->texture)
+         continue;
+      a->used--;
+      if (a->used <= 0) {
+         glDeleteTextures( 1, &a->texture );
+         array_erase( &tex_atlases, &a[0], &a[1] );
+      }
+      return;
+   }
+   WARN(_("Texture '%s' not found in any atlas!"), tex->name);
+}
+
+/**
+ * @brief Deletes the OpenGL texture of a texture, taking into account atlases.
+ *
+ * Textures living in an atlas only release their reference, the atlas itself
+ *  goes away with the last of them.
+ *
+ *    @param tex Texture to delete the OpenGL texture of.
+ */
+static void gl_deleteTexture( glTexture *tex )
+{
+   memstats_add( MEMTAG_TEXTURES, -gl_texMemory( tex ) );
+   if (!(tex->flags & OPENGL_TEX_ATLAS)) {
+      glDeleteTextures( 1, &tex->texture );
+      return;
+   }
+   gl_atlasRelease( tex );
+}
+
+/**
+ * @brief Texture being packed into an atlas.
+ */
+typedef struct glAtlasEntry_ {
+   glTexture *tex;         /**< Texture to pack. */
+   SDL_Surface *surface;   /**< Image of the texture in ABGR8888. */
+   GLint x;                /**< X position in the atlas, negative if it doesn't fit. */
+   GLint y;                /**< Y position in the atlas. */
+} glAtlasEntry;
+
+/**
+ * @brief Compares two textures by height for packing, tallest first.
+ */
+static int tex_cmpAtlas( const void *p1, const void *p2 )
+{
+   const glAtlasEntry *e1 = p1;
+   const glAtlasEntry *e2 = p2;
+   return e2->surface->h - e1->surface->h;
+}
+
+/**
+ * @brief Loads the image of a texture again to pack it.
+ *
+ *    @param tex Texture to load the image of.
+ *    @return The image in ABGR8888 or NULL if it doesn't match the texture.
+ */
+static SDL_Surface* gl_atlasSurface( const glTexture *tex )
+{
+   SDL_RWops *rw;
+   SDL_Surface *surface, *rgba;
+
+   if (tex->name == NULL)
+      return NULL;
+   rw = PHYSFSRWOPS_openRead( tex->name );
+   if (rw == NULL)
+      return NULL;
+   surface = IMG_Load_RW( rw, 1 );
+   if (surface == NULL)
+      return NULL;
+   rgba = SDL_ConvertSurfaceFormat( surface, SDL_PIXELFORMAT_ABGR8888, 0 );
+   SDL_FreeSurface( surface );
+   if ((rgba != NULL) && ((rgba->w != (int)tex->w) || (rgba->h != (int)tex->h))) {
+      SDL_FreeSurface( rgba );
+      return NULL;
+   }
+   return rgba;
+}
+
+/**
+ * @brief Packs textures into a shared atlas.
+ *
+ * The images of the textures are decoded again and laid out in rows of an
+ *  atlas on the CPU, which is then uploaded once, so nothing is read back
+ *  from the GPU. Each texture then points to the atlas with the offset and
+ *  scale of its texture coordinates, so drawing a set of them does not need
+ *  to rebind textures and can be batched into a single draw call. All the
+ *  texture parameters stay the same, so gl_renderTexture and everything
+ *  built on it keep working.
+ *
+ * Only textures loaded from uncompressed images, that are neither SDF nor
+ *  already in an atlas, and that have the same flags and internal format as
+ *  the first one are packed, the rest are left untouched. The atlas gets that
+ *  same internal format. Code using the raw OpenGL texture has to call
+ *  gl_atlasUnpack first, as the raw texture is the whole atlas.
+ *
+ *    @param texs Textures to pack.
+ *    @param n Number of textures.
+ *    @return Number of textures packed.
+ */
+int gl_atlasPack( glTexture **texs, int n )
+{
+   glAtlasEntry *pack;
+   GLint size, x, y, rowh, atlas_h, format;
+   unsigned int flags;
+   int npack, packed;
+   GLuint atlas;
+   uint8_t *data;
+
+   if (n <= 1)
+      return 0;
+
+   SDL_mutexP( tex_lock );
+   tex_ctxSet();
+
+   size  = MIN( gl_screen.tex_max, TEX_ATLAS_SIZE );
+   pack  = malloc( n * sizeof(glAtlasEntry) );
+
+   /* Find the textures that can be packed. */
+   npack  = 0;
+   flags  = 0;
+   format = 0;
+   for (int i=0; i<n; i++) {
+      glTexture *t = texs[i];
+      SDL_Surface *surface;
+      GLint fmt, compressed;
+      int dup;
+      if ((t == NULL) || (t->flags & (OPENGL_TEX_SDF | OPENGL_TEX_ATLAS)))
+         continue;
+      if ((npack > 0) && (t->flags != flags))
+         continue;
+      /* Duplicates point to the same object, only pack them once. */
+      dup = 0;
+      for (int j=0; j<npack; j++) {
+         if (pack[j].tex == t) {
+            dup = 1;
+            break;
+         }
+      }
+      if (dup)
+         continue;
+
+      /* The atlas keeps the format of the textures, so they must share it. */
+      glBindTexture( GL_TEXTURE_2D, t->texture );
+      glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed );
+      glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &fmt );
+      if (compressed || ((npack > 0) && (fmt != format)))
+         continue;
+
+      surface = gl_atlasSurface( t );
+      if (surface == NULL)
+         continue;
+      if (npack == 0) {
+         flags  = t->flags;
+         format = fmt;
+      }
+      pack[npack].tex     = t;
+      pack[npack].surface = surface;
+      npack++;
+   }
+   glBindTexture( GL_TEXTURE_2D, 0 );
+   qsort( pack, npack, sizeof(glAtlasEntry), tex_cmpAtlas );
+
+   /* Lay them out in rows, tallest first so rows waste little space. */
+   x = y = rowh = 0;
+   for (int i=0; i<npack; i++) {
+      glAtlasEntry *e = &pack[i];
+      GLint tw = e->surface->w;
+      GLint th = e->surface->h;
+      if (x + tw + TEX_ATLAS_PAD > size) {
+         x = 0;
+         y += rowh;
+         rowh = 0;
+      }
+      if ((y + th + TEX_ATLAS_PAD > size) || (tw + TEX_ATLAS_PAD > size)) {
+         e->x = -1;
+         continue;
+      }
+      e->x = x + TEX_ATLAS_PAD/2;
+      e->y = y + TEX_ATLAS_PAD/2;
+      x += tw + TEX_ATLAS_PAD;
+      x += (TEX_ATLAS_PAD - x % TEX_ATLAS_PAD) % TEX_ATLAS_PAD;
+      rowh = MAX( rowh, th + TEX_ATLAS_PAD + (TEX_ATLAS_PAD - th % TEX_ATLAS_PAD) % TEX_ATLAS_PAD );
+   }
+   atlas_h = 1;
+   while (atlas_h < y + rowh)
+      atlas_h *= 2;
+
+   /* Copy the images over with transparent padding. */
+   packed = 0;
+   data = calloc( (size_t)size * atlas_h, 4 );
+   for (int i=0; i<npack; i++) {
+      glAtlasEntry *e = &pack[i];
+      if (e->x < 0)
+         continue;
+      SDL_LockSurface( e->surface );
+      for (int r=0; r<e->surface->h; r++)
+         memcpy( &data[ ((size_t)(e->y+r) * size + e->x) * 4 ],
+               (const uint8_t*)e->surface->pixels + (size_t)r * e->surface->pitch,
+               (size_t)e->surface->w * 4 );
+      SDL_UnlockSurface( e->surface );
+      packed++;
+   }
+
+   if (packed <= 1) {
+      for (int i=0; i<npack; i++)
+         SDL_FreeSurface( pack[i].surface );
+      free( data );
+      free( pack );
+      tex_ctxUnset();
+      SDL_mutexV( tex_lock );
+      return 0;
+   }
+
+   /* Upload the atlas. */
+   atlas = gl_texParameters( flags );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+   glTexImage2D( GL_TEXTURE_2D, 0, format, size, atlas_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data );
+   free( data );
+
+   /* Point the textures at the atlas. */
+   for (int i=0; i<npack; i++) {
+      glAtlasEntry *e = &pack[i];
+      glTexture *t = e->tex;
+      SDL_FreeSurface( e->surface );
+      if (e->x < 0)
+         continue;
+      glDeleteTextures( 1, &t->texture );
+
+      /* Texture coordinates get mapped as ax + tx*aw, for flipped textures
+       * the offset has to be in flipped coordinates. */
+      t->texture = atlas;
+      t->aw = t->w / (double)size;
+      t->ah = t->h / (double)atlas_h;
+      t->ax = (double)e->x / (double)size;
+      t->ay = (double)e->y / (double)atlas_h;
+      if (t->flags & OPENGL_TEX_VFLIP)
+         t->ay = 1. - t->ay - t->ah;
+      t->flags |= OPENGL_TEX_ATLAS;
+   }
+
+   /* Mipmaps past the padding would bleed between textures. */
+   if (flags & OPENGL_TEX_MIPMAPS) {
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, TEX_ATLAS_MIPMAPS );
+      gl_texMipmaps();
+   }
+   glBindTexture( GL_TEXTURE_2D, 0 );
+
+   if (tex_atlases == NULL)
+      tex_atlases = array_create( glAtlas );
+   glAtlas *a = &array_grow( &tex_atlases );
+   a->texture = atlas;
+   a->used    = packed;
+
+   free( pack );
+   gl_checkErr();
+
+   tex_ctxUnset();
+   SDL_mutexV( tex_lock );
+
+   return packed;
+}
+
+/**
+ * @brief Moves a texture out of its atlas into its own OpenGL texture.
+ *
+ * Needed before using the raw OpenGL texture, like reading it back or
+ *  changing its parameters, as for textures in an atlas that is the whole
+ *  atlas. The copy is done on the GPU. Does nothing for other textures.
+ *
+ *    @param tex Texture to move out of its atlas.
+ */
+void gl_atlasUnpack( glTexture *tex )
+{
+   GLuint fbo, texture;
+   GLint format, aw, ah, x, y, w, h;
+   double ay;
+
+   if ((tex == NULL) || !(tex->flags & OPENGL_TEX_ATLAS))
+      return;
+
+   SDL_mutexP( tex_lock );
+   tex_ctxSet();
+
+   /* Find where the texture is, undoing the flip of the offset. */
+   glBindTexture( GL_TEXTURE_2D, tex->texture );
+   glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format );
+   glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &aw );
+   glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &ah );
+   ay = (tex->flags & OPENGL_TEX_VFLIP) ? 1. - tex->ay - tex->ah : tex->ay;
+   x  = (GLint) round( tex->ax * aw );
+   y  = (GLint) round( ay * ah );
+   w  = (GLint) tex->w;
+   h  = (GLint) tex->h;
+
+   /* Copy it into its own texture. */
+   glGenFramebuffers( 1, &fbo );
+   glBindFramebuffer( GL_READ_FRAMEBUFFER, fbo );
+   glFramebufferTexture2D( GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex->texture, 0 );
+   texture = gl_texParameters( tex->flags & ~OPENGL_TEX_ATLAS );
+   glTexImage2D( GL_TEXTURE_2D, 0, format, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+   glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, x, y, w, h );
+   if (tex->flags & OPENGL_TEX_MIPMAPS)
+      gl_texMipmaps();
+   glBindTexture( GL_TEXTURE_2D, 0 );
+   glBindFramebuffer( GL_READ_FRAMEBUFFER, 0 );
+   glDeleteFramebuffers( 1, &fbo );
+   gl_checkErr();
+
+   gl_atlasRelease( tex );
+   tex->texture = texture;
+   tex->ax = tex->ay = tex->aw = tex->ah = 0.;
+   tex->flags &= ~OPENGL_TEX_ATLAS;
+
+   tex_ctxUnset();
+   SDL_mutexV( tex_lock );
+}
+
 /**
  * @brief Checks to see if a pixel is transparent in a texture.
  *
@@ -947,10 +2089,8 @@ glTexture* gl_dupTexture( const glTexture *texture )
  */
 int gl_isTrans( const glTexture* t, const int x, const int y )
 {
-   /* Get the position in the sheet. */
-   int i = y*(int)(t->w) + x ;
-   /* Now we have to pull out the individual bit. */
-   return !(t->trans[ i/8 ] & (1 << (i%8)));
+   /* Pull out the individual bit from the row. */
+   return !((t->trans[ y*t->trans_w + x/64 ] >> (x%64)) & 1);
 }
 
 /**
@@ -1005,6 +2145,11 @@ int gl_initTextures (void)
 {
    tex_lock = SDL_CreateMutex();
    tex_mainthread = SDL_ThreadID();
+
+   /* Compressed formats are only extensions on OpenGL 3.2. */
+   tex_s3tc = SDL_GL_ExtensionSupported( "GL_EXT_texture_compression_s3tc" ) &&
+         SDL_GL_ExtensionSupported( "GL_EXT_texture_sRGB" );
+   tex_bptc = SDL_GL_ExtensionSupported( "GL_ARB_texture_compression_bptc" );
    return 0;
 }
 
@@ -1015,6 +2160,7 @@ void gl_exitTextures (void)
 {
    if (array_size(texture_list) <= 0) {
       array_free(texture_list);
+      array_free(tex_atlases);
       return;
    }
 
@@ -1028,6 +2174,7 @@ void gl_exitTextures (void)
 #endif /* DEBUGGING */
 
    array_free(texture_list);
+   array_free(tex_atlases);
 
    SDL_DestroyMutex( tex_lock );
 }
@@ -27,6 +27,7 @@
 #define OPENGL_TEX_VFLIP      (1<<2) /**< Assume loaded from an image (where positive y means down). */
 #define OPENGL_TEX_SKIPCACHE  (1<<3) /**< Skip caching checks and create new texture. */
 #define OPENGL_TEX_SDF        (1<<4) /**< Convert to an SDF. Only the alpha channel gets used. */
+#define OPENGL_TEX_ATLAS      (1<<5) /**< Texture lives in a shared atlas, see gl_atlasPack. */
 
 /**
  * @brief Abstraction for rendering sprite sheets.
@@ -50,8 +51,13 @@ typedef struct glTexture_ {
 
    /* data */
    GLuint texture; /**< the opengl texture itself */
-   uint8_t* trans; /**< maps the transparency */
+   uint64_t *trans; /**< Transparency bitmask, one bit per pixel with rows padded to whole words. */
+   int trans_w; /**< Words per row of the transparency bitmask. */
    double vmax; /**< Maximum value for SDF textures. */
+   double ax; /**< X offset of the texture coordinates in its atlas. */
+   double ay; /**< Y offset of the texture coordinates in its atlas. */
+   double aw; /**< Width scale of the texture coordinates in its atlas. */
+   double ah; /**< Height scale of the texture coordinates in its atlas. */
 
    /* properties */
    uint8_t flags; /**< flags used for texture properties */
@@ -72,6 +78,8 @@ USE_RESULT glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
 USE_RESULT glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWops *rw,
       unsigned int flags, int w, int h, int sx, int sy, int freesur );
 USE_RESULT glTexture* gl_loadImage( SDL_Surface* surface, const unsigned int flags ); /* Frees the surface. */
+uint8_t* gl_transMapLoad( const char *name, SDL_Surface* surface, SDL_RWops *rw, int w, int h );
+void gl_texSetTransMap( glTexture *tex, const uint8_t *trans, int w, int h );
 USE_RESULT glTexture* gl_newImage( const char* path, const unsigned int flags );
 USE_RESULT glTexture* gl_newImageRWops( const char* path, SDL_RWops *rw, const unsigned int flags ); /* Does not close the RWops. */
 USE_RESULT glTexture* gl_newSprite( const char* path, const int sx, const int sy,
@@ -79,6 +87,19 @@ USE_RESULT glTexture* gl_newSprite( const char* path, const int sx, const int sy
 USE_RESULT glTexture* gl_newSpriteRWops( const char* path, SDL_RWops *rw,
    const int sx, const int sy, const unsigned int flags );
 USE_RESULT glTexture* gl_dupTexture( const glTexture *texture );
+int gl_texUses( const glTexture *texture );
+void gl_texResetParameters( const glTexture *tex );
+int gl_atlasPack( glTexture **texs, int n );
+void gl_atlasUnpack( glTexture *tex );
+
+/*
+ * Asynchronous loading.
+ */
+typedef struct glTexLoader_ glTexLoader;
+glTexLoader* gl_texLoaderCreate (void);
+void gl_texLoaderAdd( glTexLoader *ld, const char *path, int sx, int sy,
+      unsigned int flags, glTexture **out );
+void gl_texLoaderWait( glTexLoader *ld );
 
 /*
  * Clean up.
@@ -0,0 +1,214 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file opengl_timer.c
+ *
+ * @brief Times the render stages on the GPU.
+ *
+ * A timestamp query is issued at the start of the frame and at the end of
+ *  every render stage, so each stage is the difference between two
+ *  consecutive timestamps. Using timestamps instead of elapsed time queries
+ *  lets the stages be chained like the CPU marks without nesting queries.
+ *
+ * Results are read back a few frames later so that the CPU never waits on
+ *  the GPU, frames whose results are not ready yet are dropped. The times are
+ *  given to the frame time overlay, and emitted as GPU zones with Tracy.
+ */
+/** @cond */
+#include "naev.h"
+/** @endcond */
+
+#include "opengl_timer.h"
+
+#include "log.h"
+#include "ntracing.h"
+#include "opengl.h"
+
+#define GL_TIMER_FRAMES    3  /**< Frames in flight before reading back the results. */
+#define GL_TIMER_QUERIES   64 /**< Maximum number of timestamps per frame. */
+
+/**
+ * @brief Timestamps of a frame.
+ */
+typedef struct GLTimerFrame_ {
+   GLuint queries[GL_TIMER_QUERIES];     /**< Timestamp queries. */
+   FrameStage stages[GL_TIMER_QUERIES];  /**< Stage ended by each timestamp, the first starts the frame. */
+   int n;                                /**< Number of timestamps issued. */
+} GLTimerFrame;
+
+static int gl_timer_supported = 0; /**< Whether or not timer queries are available. */
+static GLTimerFrame gl_timer_frames[GL_TIMER_FRAMES]; /**< Frames in flight. */
+static int gl_timer_cur = -1; /**< Frame being recorded, or -1 if not timing. */
+static unsigned int gl_timer_count = 0; /**< Number of frames recorded. */
+#if HAVE_TRACY
+static struct ___tracy_source_location_data gl_timer_srcloc[FRAME_STAGE_MAX]; /**< Tracy source locations of the stages. */
+#endif /* HAVE_TRACY */
+
+/*
+ * Prototypes.
+ */
+static int gl_timerActive (void);
+static void gl_timerPush( int frame, FrameStage stage );
+static void gl_timerCollect( int frame );
+
+#if HAVE_TRACY
+/**
+ * @brief Gets the Tracy query id of a timestamp, two per timestamp as each
+ *  one ends a zone and begins the next.
+ */
+static uint16_t gl_timerTracyId( int frame, int query, int begin )
+{
+   return (uint16_t)(2 * (frame * GL_TIMER_QUERIES + query) + begin);
+}
+#endif /* HAVE_TRACY */
+
+/**
+ * @brief Initializes the GPU timer.
+ */
+int gl_initTimer (void)
+{
+   if (!GLAD_GL_ARB_timer_query || !glQueryCounter || !glGetQueryObjectui64v) {
+      DEBUG(_("GPU timer queries not supported, not timing render stages on the GPU."));
+      return 0;
+   }
+
+   for (int i=0; i<GL_TIMER_FRAMES; i++) {
+      glGenQueries( GL_TIMER_QUERIES, gl_timer_frames[i].queries );
+      gl_timer_frames[i].n = 0;
+   }
+   gl_timer_supported = 1;
+
+#if HAVE_TRACY
+   for (int i=0; i<FRAME_STAGE_MAX; i++) {
+      gl_timer_srcloc[i].name     = frametime_name( i );
+      gl_timer_srcloc[i].function = "render_all";
+      gl_timer_srcloc[i].file     = __FILE__;
+      gl_timer_srcloc[i].line     = __LINE__;
+      gl_timer_srcloc[i].color    = 0;
+   }
+   GLint64 now;
+   glGetInteger64v( GL_TIMESTAMP, &now );
+   ___tracy_emit_gpu_new_context( (struct ___tracy_gpu_new_context_data){
+         .gpuTime = now, .period = 1., .context = 0, .flags = 0, .type = 1 /* OpenGL */ } );
+#endif /* HAVE_TRACY */
+
+   gl_checkErr();
+   return 0;
+}
+
+/**
+ * @brief Cleans up the GPU timer.
+ */
+void gl_exitTimer (void)
+{
+   if (!gl_timer_supported)
+      return;
+   for (int i=0; i<GL_TIMER_FRAMES; i++)
+      glDeleteQueries( GL_TIMER_QUERIES, gl_timer_frames[i].queries );
+   gl_timer_supported = 0;
+   gl_timer_cur = -1;
+}
+
+/**
+ * @brief Checks to see if the GPU should be timed.
+ */
+static int gl_timerActive (void)
+{
+#if HAVE_TRACY
+   return gl_timer_supported;
+#else /* HAVE_TRACY */
+   return gl_timer_supported && frametime_enabled();
+#endif /* HAVE_TRACY */
+}
+
+/**
+ * @brief Issues a timestamp ending a stage.
+ */
+static void gl_timerPush( int frame, FrameStage stage )
+{
+   GLTimerFrame *f = &gl_timer_frames[frame];
+   if (f->n >= GL_TIMER_QUERIES)
+      return;
+   glQueryCounter( f->queries[f->n], GL_TIMESTAMP );
+   f->stages[f->n] = stage;
+#if HAVE_TRACY
+   if (f->n > 0) {
+      ___tracy_emit_gpu_zone_begin( (struct ___tracy_gpu_zone_begin_data){
+            .srcloc = (uint64_t)&gl_timer_srcloc[stage],
+            .queryId = gl_timerTracyId( frame, f->n-1, 1 ), .context = 0 } );
+      ___tracy_emit_gpu_zone_end( (struct ___tracy_gpu_zone_end_data){
+            .queryId = gl_timerTracyId( frame, f->n, 0 ), .context = 0 } );
+   }
+#endif /* HAVE_TRACY */
+   f->n++;
+}
+
+/**
+ * @brief Reads back the timestamps of a frame.
+ */
+static void gl_timerCollect( int frame )
+{
+   GLTimerFrame *f = &gl_timer_frames[frame];
+   Uint64 ns[FRAME_STAGE_MAX] = { 0 };
+   GLuint64 prev, t;
+   GLint avail = 0;
+
+   if (f->n < 2)
+      return;
+
+   /* Don't stall waiting on the GPU, unless Tracy is waiting on the zones. */
+   glGetQueryObjectiv( f->queries[f->n-1], GL_QUERY_RESULT_AVAILABLE, &avail );
+#if !HAVE_TRACY
+   if (!avail)
+      return;
+#endif /* !HAVE_TRACY */
+
+   glGetQueryObjectui64v( f->queries[0], GL_QUERY_RESULT, &prev );
+   for (int i=1; i<f->n; i++) {
+      glGetQueryObjectui64v( f->queries[i], GL_QUERY_RESULT, &t );
+      ns[ f->stages[i] ] += t - prev;
+#if HAVE_TRACY
+      ___tracy_emit_gpu_time( (struct ___tracy_gpu_time_data){
+            .gpuTime = (int64_t)prev, .queryId = gl_timerTracyId( frame, i-1, 1 ), .context = 0 } );
+      ___tracy_emit_gpu_time( (struct ___tracy_gpu_time_data){
+            .gpuTime = (int64_t)t, .queryId = gl_timerTracyId( frame, i, 0 ), .context = 0 } );
+#endif /* HAVE_TRACY */
+      prev = t;
+   }
+   frametime_addGPU( ns );
+}
+
+/**
+ * @brief Starts timing a frame on the GPU.
+ *
+ * Reads back the oldest frame in flight and reuses its queries.
+ */
+void gl_timerFrameStart (void)
+{
+   int frame;
+
+   if (!gl_timerActive()) {
+      gl_timer_cur = -1;
+      return;
+   }
+
+   frame = gl_timer_count % GL_TIMER_FRAMES;
+   gl_timer_count++;
+   gl_timerCollect( frame );
+   gl_timer_frames[frame].n = 0;
+   gl_timer_cur = frame;
+   gl_timerPush( frame, FRAME_STAGE_MAX );
+}
+
+/**
+ * @brief Marks the end of a render stage on the GPU.
+ *
+ *    @param stage Stage that ended.
+ */
+void gl_timerMark( FrameStage stage )
+{
+   if (gl_timer_cur < 0)
+      return;
+   gl_timerPush( gl_timer_cur, stage );
+}
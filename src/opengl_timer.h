@@ -0,0 +1,18 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+#include "frametime.h"
+
+/*
+ * Init/cleanup.
+ */
+int gl_initTimer (void);
+void gl_exitTimer (void);
+
+/*
+ * Timing.
+ */
+void gl_timerFrameStart (void);
+void gl_timerMark( FrameStage stage );
@@ -7,6 +7,8 @@
  * @brief Handles OpenGL vbos.
  */
 /** @cond */
+#include <string.h>
+
 #include "naev.h"
 /** @endcond */
 
@@ -15,6 +17,10 @@
 
 #define BUFFER_OFFSET(i) ((char *)(sizeof(char) * (i))) /**< Taken from OpengL spec. */
 
+#define VBO_RING_REGIONS   3  /**< Frames a ring VBO can have in flight. */
+#define VBO_RING_ALIGN     64 /**< Alignment of the data pushed to ring VBOs. */
+#define VBO_RING_TIMEOUT   1000000000 /**< How long to wait for a ring region to be done, in ns. */
+
 /**
  * @brief VBO types.
  */
@@ -22,7 +28,8 @@ typedef enum gl_vboType_e {
    NGL_VBO_NULL,     /**< No VBO type. */
    NGL_VBO_STREAM,   /**< VBO streaming type. */
    NGL_VBO_DYNAMIC,  /**< VBO dynamic type. */
-   NGL_VBO_STATIC    /**< VBO static type. */
+   NGL_VBO_STATIC,   /**< VBO static type. */
+   NGL_VBO_RING      /**< VBO streamed through regions that are rotated every frame. */
 } gl_vboType;
 
 /**
@@ -33,12 +40,22 @@ struct gl_vbo_s {
    gl_vboType type;  /**< VBO type. */
    GLsizei size;     /**< VBO size. */
    char* data;       /**< VBO data. */
+   /* Ring VBOs. */
+   GLuint base;      /**< Offset of the last data pushed, added when activating. */
+   GLsizei region;   /**< Size of each region. */
+   GLsizei used;     /**< Bytes used in the current region. */
+   int cur;          /**< Region being written. */
+   unsigned int frame; /**< Frame the current region was started at. */
+   GLsync fence[VBO_RING_REGIONS]; /**< Signalled once the GPU is done with each region. */
 };
 
+static unsigned int gl_vbo_frame = 0; /**< Current frame for the ring VBOs. */
+
 /**
  * Prototypes.
  */
 static gl_vbo* gl_vboCreate( GLenum target, GLsizei size, const void* data, GLenum usage );
+static void gl_vboRingReserve( gl_vbo *vbo, GLsizei size );
 
 /**
  * @brief Initializes the OpenGL VBO subsystem.
@@ -187,6 +204,123 @@ gl_vbo* gl_vboCreateStatic( GLsizei size, const void* data )
    return vbo;
 }
 
+/**
+ * @brief Creates a ring vbo for data that is rewritten every frame.
+ *
+ * The buffer is split into regions used in turn every frame, fenced so that a
+ *  region is only written again once the GPU is done drawing from it. Data is
+ *  then written without the driver having to synchronise or copy, unlike with
+ *  gl_vboData or gl_vboSubData. The offset of the data last pushed is added
+ *  when activating the vbo, so the attributes are set up as if the data were
+ *  at the start of the buffer.
+ *
+ *    @param size Expected size of the data of a frame, grown when needed.
+ */
+gl_vbo* gl_vboCreateRing( GLsizei size )
+{
+   gl_vbo *vbo;
+
+   size = MAX( size, VBO_RING_ALIGN );
+   size = (size + VBO_RING_ALIGN - 1) / VBO_RING_ALIGN * VBO_RING_ALIGN;
+   vbo = gl_vboCreate( GL_ARRAY_BUFFER, size * VBO_RING_REGIONS, NULL, GL_STREAM_DRAW );
+   vbo->type   = NGL_VBO_RING;
+   vbo->region = size;
+   vbo->frame  = gl_vbo_frame;
+
+   /* Check for errors. */
+   gl_checkErr();
+
+   return vbo;
+}
+
+/**
+ * @brief Marks the start of a new frame for the ring vbos.
+ */
+void gl_vboRingFrame (void)
+{
+   gl_vbo_frame++;
+}
+
+/**
+ * @brief Makes sure there is room for data in the current region of a ring vbo.
+ */
+static void gl_vboRingReserve( gl_vbo *vbo, GLsizei size )
+{
+   /* Move on to the next region on a new frame, the GPU being done with the
+    * region by now barring a very deep queue. */
+   if (vbo->frame != gl_vbo_frame) {
+      if (vbo->fence[vbo->cur] != NULL)
+         glDeleteSync( vbo->fence[vbo->cur] );
+      vbo->fence[vbo->cur] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+      vbo->cur   = (vbo->cur+1) % VBO_RING_REGIONS;
+      vbo->used  = 0;
+      vbo->frame = gl_vbo_frame;
+      if (vbo->fence[vbo->cur] != NULL) {
+         if (glClientWaitSync( vbo->fence[vbo->cur], GL_SYNC_FLUSH_COMMANDS_BIT, VBO_RING_TIMEOUT ) == GL_TIMEOUT_EXPIRED)
+            WARN(_("Timed out waiting for the GPU to release a VBO region!"));
+         glDeleteSync( vbo->fence[vbo->cur] );
+         vbo->fence[vbo->cur] = NULL;
+      }
+   }
+
+   /* Grow by orphaning, the old storage stays alive for the pending draws. */
+   if (vbo->used + size > vbo->region) {
+      GLsizei region = MAX( 2*vbo->region, size );
+      region = (region + VBO_RING_ALIGN - 1) / VBO_RING_ALIGN * VBO_RING_ALIGN;
+      for (int i=0; i<VBO_RING_REGIONS; i++) {
+         if (vbo->fence[i] != NULL)
+            glDeleteSync( vbo->fence[i] );
+         vbo->fence[i] = NULL;
+      }
+      vbo->region = region;
+      vbo->size   = region * VBO_RING_REGIONS;
+      vbo->cur    = 0;
+      vbo->used   = 0;
+      glBindBuffer( GL_ARRAY_BUFFER, vbo->id );
+      glBufferData( GL_ARRAY_BUFFER, vbo->size, NULL, GL_STREAM_DRAW );
+   }
+}
+
+/**
+ * @brief Maps space for new data in a ring vbo, to be unmapped with gl_vboUnmap.
+ *
+ *    @param vbo Ring vbo to write to.
+ *    @param size Size of the data (in bytes).
+ *    @return Pointer to write the data at.
+ */
+void* gl_vboRingMap( gl_vbo *vbo, GLsizei size )
+{
+   void *ptr;
+
+   gl_vboRingReserve( vbo, size );
+   vbo->base  = vbo->cur * vbo->region + vbo->used;
+   vbo->used += (size + VBO_RING_ALIGN - 1) / VBO_RING_ALIGN * VBO_RING_ALIGN;
+
+   glBindBuffer( GL_ARRAY_BUFFER, vbo->id );
+   ptr = glMapBufferRange( GL_ARRAY_BUFFER, vbo->base, size,
+         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+
+   /* Check for errors. */
+   gl_checkErr();
+
+   return ptr;
+}
+
+/**
+ * @brief Pushes new data to a ring vbo.
+ *
+ *    @param vbo Ring vbo to write to.
+ *    @param size Size of the data (in bytes).
+ *    @param data Pointer to the data.
+ */
+void gl_vboRingData( gl_vbo *vbo, GLsizei size, const void* data )
+{
+   void *ptr = gl_vboRingMap( vbo, size );
+   if (ptr != NULL)
+      memcpy( ptr, data, size );
+   gl_vboUnmap( vbo );
+}
+
 /**
  * @brief Maps a buffer.
  *
@@ -230,7 +364,7 @@ void gl_vboActivateAttribOffset( gl_vbo *vbo, GLuint index, GLuint offset,
 
    /* Set up. */
    glBindBuffer( GL_ARRAY_BUFFER, vbo->id );
-   pointer = BUFFER_OFFSET(offset);
+   pointer = BUFFER_OFFSET(vbo->base + offset);
 
    glVertexAttribPointer( index, size, type, GL_FALSE, stride, pointer );
 
@@ -248,6 +382,9 @@ void gl_vboDestroy( gl_vbo *vbo )
    if (vbo == NULL)
       return;
 
+   for (int i=0; i<VBO_RING_REGIONS; i++)
+      if (vbo->fence[i] != NULL)
+         glDeleteSync( vbo->fence[i] );
    glDeleteBuffers( 1, &vbo->id );
    gl_checkErr();
    free(vbo);
@@ -20,6 +20,7 @@ void gl_exitVBO (void);
 gl_vbo* gl_vboCreateStream( GLsizei size, const void* data );
 gl_vbo* gl_vboCreateDynamic( GLsizei size, const void* data );
 gl_vbo* gl_vboCreateStatic( GLsizei size, const void* data );
+gl_vbo* gl_vboCreateRing( GLsizei size );
 
 /*
  * Modify.
@@ -28,6 +29,9 @@ void gl_vboData( gl_vbo *vbo, GLsizei size, const void* data );
 void gl_vboSubData( gl_vbo *vbo, GLint offset, GLsizei size, const void* data );
 void* gl_vboMap( gl_vbo *vbo );
 void gl_vboUnmap( gl_vbo *vbo );
+void* gl_vboRingMap( gl_vbo *vbo, GLsizei size );
+void gl_vboRingData( gl_vbo *vbo, GLsizei size, const void* data );
+void gl_vboRingFrame (void);
 void gl_vboActivate( gl_vbo *vbo, GLuint class, GLint size, GLenum type, GLsizei stride );
 void gl_vboActivateOffset( gl_vbo *vbo, GLuint class, GLuint offset,
       GLint size, GLenum type, GLsizei stride );
@@ -19,6 +19,7 @@
 #include "array.h"
 #include "conf.h"
 #include "background.h"
+#include "camera.h"
 #include "colour.h"
 #include "dialogue.h"
 #include "difficulty.h"
@@ -1515,9 +1516,14 @@ static int opt_videoSave( unsigned int wid, const char *str )
    f = window_checkboxState( wid, "chkVSync" );
    if (conf.vsync != f) {
       conf.vsync = f;
-      opt_needRestart();
+      gl_setVsync( conf.vsync );
    }
 
+   /* Scaling changes the dimensions of everything, zoom only has to be clamped. */
+   if (FABS(conf.scalefactor-local_conf.scalefactor) > 1e-4)
+      naev_resizeForce();
+   cam_setZoom( cam_getZoom() );
+
    /* Features. */
    f = window_checkboxState( wid, "chkMinimize" );
    if (conf.minimize != f) {
@@ -1706,8 +1712,6 @@ static void opt_setScalefactor( unsigned int wid, const char *str )
    conf.scalefactor = exp(scale);
    snprintf( buf, sizeof(buf), _("Scaling: %.1fx"), conf.scalefactor );
    window_modifyText( wid, "txtScale", buf );
-   if (FABS(conf.scalefactor-local_conf.scalefactor) > 1e-4)
-      opt_needRestart();
 }
 
 /**
@@ -1728,8 +1732,6 @@ static void opt_setZoomFar( unsigned int wid, const char *str )
       window_faderSetBoundedValue( wid, "fadZoomNear", log1p(conf.zoom_far) );
       opt_setZoomNear( wid, "fadZoomNear" );
    }
-   if (FABS(conf.zoom_far-local_conf.zoom_far) > 1e-4)
-      opt_needRestart();
 }
 
 /**
@@ -1750,8 +1752,6 @@ static void opt_setZoomNear( unsigned int wid, const char *str )
       window_faderSetBoundedValue( wid, "fadZoomFar", log1p(conf.zoom_near) );
       opt_setZoomFar( wid, "fadZoomFar" );
    }
-   if (FABS(conf.zoom_near-local_conf.zoom_near) > 1e-4)
-      opt_needRestart();
 }
 
 /**
@@ -25,6 +25,7 @@
 #include "damagetype.h"
 #include "log.h"
 #include "mapData.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nfile.h"
 #include "nlua.h"
@@ -66,6 +67,8 @@ typedef struct OutfitThreadData_ {
  * the stack
  */
 static Outfit* outfit_stack = NULL; /**< Stack of outfits. */
+static NameIndex outfit_index; /**< Index of outfits by name. */
+static NameIndex outfit_indexCase; /**< Index of outfits by case insensitive name. */
 static char **license_stack = NULL; /**< Stack of available licenses. */
 
 /*
@@ -179,8 +182,8 @@ const Outfit* outfit_get( const char* name )
  */
 const Outfit* outfit_getW( const char* name )
 {
-   const Outfit s = {.name = (char*)name };
-   return bsearch( &s, outfit_stack, array_size(outfit_stack), sizeof(Outfit), outfit_cmp );
+   int id = nameindex_get( &outfit_index, name );
+   return (id < 0) ? NULL : &outfit_stack[id];
 }
 
 /**
@@ -196,10 +199,7 @@ const Outfit* outfit_getAll (void)
  */
 const char *outfit_existsCase( const char* name )
 {
-   for (int i=0; i<array_size(outfit_stack); i++)
-      if (strcasecmp(name,outfit_stack[i].name)==0)
-         return outfit_stack[i].name;
-   return NULL;
+   return nameindex_getName( &outfit_indexCase, name );
 }
 
 /**
@@ -674,6 +674,58 @@ const OutfitGFX* outfit_gfx( const Outfit* o )
    else if (outfit_isLauncher(o)) return &o->u.lau.gfx;
    return NULL;
 }
+/**
+ * @brief Gets the outfit's store graphic, loading it if necessary.
+ *    @param o Outfit to get information from.
+ */
+glTexture* outfit_gfxStore( const Outfit* o )
+{
+   if ((o->gfx_store == NULL) && (o->gfx_store_path != NULL)) {
+      /* The graphic is a cache, so it's fine to modify it. */
+      Outfit *ow = (Outfit*) o;
+      ow->gfx_store = gl_newImage( o->gfx_store_path, OPENGL_TEX_MIPMAPS );
+      if (ow->gfx_store == NULL) {
+         free( ow->gfx_store_path );
+         ow->gfx_store_path = NULL;
+      }
+   }
+   return o->gfx_store;
+}
+/**
+ * @brief Loads the store graphics of many outfits at once.
+ *
+ * The images are decoded in parallel by the asynchronous texture loader
+ *  instead of one after another by outfit_gfxStore.
+ *
+ *    @param outfits Outfits to load the store graphics of.
+ *    @param n Number of outfits.
+ */
+void outfit_gfxStoreLoad( const Outfit **outfits, int n )
+{
+   glTexLoader *ld = NULL;
+
+   for (int i=0; i<n; i++) {
+      /* The graphic is a cache, so it's fine to modify it. */
+      Outfit *o = (Outfit*) outfits[i];
+      if ((o->gfx_store != NULL) || (o->gfx_store_path == NULL))
+         continue;
+      if (ld == NULL)
+         ld = gl_texLoaderCreate();
+      gl_texLoaderAdd( ld, o->gfx_store_path, 1, 1, OPENGL_TEX_MIPMAPS, &o->gfx_store );
+   }
+   if (ld == NULL)
+      return;
+   gl_texLoaderWait( ld );
+
+   /* Don't try to load the ones that failed again. */
+   for (int i=0; i<n; i++) {
+      Outfit *o = (Outfit*) outfits[i];
+      if ((o->gfx_store == NULL) && (o->gfx_store_path != NULL)) {
+         free( o->gfx_store_path );
+         o->gfx_store_path = NULL;
+      }
+   }
+}
 /**
  * @brief Gets the outfit's collision polygon.
  *    @param o Outfit to get information from.
@@ -898,6 +950,31 @@ int outfit_soundHit( const Outfit* o )
    else if (outfit_isLauncher(o)) return o->u.lau.sound_hit;
    return -1.;
 }
+/**
+ * @brief Decodes all the sounds an outfit can play ahead of time.
+ *    @param o Outfit to preload sounds of.
+ */
+void outfit_soundPreload( const Outfit* o )
+{
+   if (outfit_isBolt(o)) {
+      sound_preload( o->u.blt.sound );
+      sound_preload( o->u.blt.sound_hit );
+   }
+   else if (outfit_isBeam(o)) {
+      sound_preload( o->u.bem.sound_warmup );
+      sound_preload( o->u.bem.sound );
+      sound_preload( o->u.bem.sound_off );
+   }
+   else if (outfit_isLauncher(o)) {
+      sound_preload( o->u.lau.sound );
+      sound_preload( o->u.lau.sound_hit );
+   }
+   else if (outfit_isAfterburner(o)) {
+      sound_preload( o->u.afb.sound_on );
+      sound_preload( o->u.afb.sound );
+      sound_preload( o->u.afb.sound_off );
+   }
+}
 /**
  * @brief Gets the outfit's ammunition mass.
  *    @param o Outfit to get ammunition mass from.
@@ -1235,7 +1312,7 @@ static int outfit_loadPLG( Outfit *temp, const char *buf )
    SDL_asprintf( &file, "%s%s.xml", OUTFIT_POLYGON_PATH, buf );
 
    /* See if the file does exist. */
-   if (!PHYSFS_exists(file)) {
+   if (!ndata_exists(file)) {
       WARN(_("%s xml collision polygon does not exist!\n \
                Please use the script 'polygon_from_sprite.py' \
 that can be found in Naev's artwork repo."), file);
@@ -1425,6 +1502,10 @@ static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent )
          outfit_setProp(temp, OUTFIT_PROP_WEAP_ONLYHITTARGET);
          continue;
       }
+      if (xml_isNode(node,"ccd")) {
+         outfit_setProp(temp, OUTFIT_PROP_WEAP_CCD);
+         continue;
+      }
       if (xml_isNode(node,"range")) {
          char *buf;
          xmlr_attr_strd(node,"blowup",buf);
@@ -1816,6 +1897,10 @@ static void outfit_parseSLauncher( Outfit* temp, const xmlNodePtr parent )
          outfit_setProp(temp, OUTFIT_PROP_WEAP_ONLYHITTARGET);
          continue;
       }
+      if (xml_isNode(node,"ccd")) {
+         outfit_setProp(temp, OUTFIT_PROP_WEAP_CCD);
+         continue;
+      }
 
       if (!outfit_isTurret(temp))
          xmlr_float(node,"arc",temp->u.lau.arc); /* This is in semi-arc like swivel. */
@@ -2523,8 +2608,18 @@ static int outfit_parse( Outfit* temp, const char* file )
                continue;
             }
             else if (xml_isNode(cur,"gfx_store")) {
-               temp->gfx_store = xml_parseTexture( cur,
-                     OUTFIT_GFX_PATH"store/%s", 1, 1, OPENGL_TEX_MIPMAPS );
+               /* Loaded on demand by outfit_gfxStore. */
+               const char *buf = xml_get(cur);
+               free( temp->gfx_store_path );
+               temp->gfx_store_path = NULL;
+               if (buf == NULL)
+                  continue;
+               if (buf[0]=='/')
+                  temp->gfx_store_path = strdup( buf );
+               else
+                  SDL_asprintf( &temp->gfx_store_path, OUTFIT_GFX_PATH"store/%s", buf );
+               if (!ndata_exists( temp->gfx_store_path ))
+                  WARN(_("Outfit '%s': unable to find '%s'!"), temp->name, temp->gfx_store_path );
                continue;
             }
             else if (xml_isNode(cur,"gfx_overlays")) {
@@ -2692,7 +2787,7 @@ if (o) WARN( _("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**<
    if (!outfit_isProp(temp,OUTFIT_PROP_TEMPLATE)) {
       MELEMENT(temp->slot.type==OUTFIT_SLOT_NULL,"slot");
       MELEMENT((temp->slot.type!=OUTFIT_SLOT_NA) && (temp->slot.type!=OUTFIT_SLOT_INTRINSIC) && (temp->slot.size==OUTFIT_SLOT_SIZE_NA),"size");
-      MELEMENT(temp->gfx_store==NULL,"gfx_store");
+      MELEMENT(temp->gfx_store_path==NULL,"gfx_store");
       MELEMENT(temp->desc_raw==NULL,"description");
    }
    /*MELEMENT(temp->mass==0,"mass"); Not really needed */
@@ -2786,6 +2881,14 @@ int outfit_load (void)
    noutfits = array_size(outfit_stack);
    /* Sort up licenses. */
    qsort( outfit_stack, noutfits, sizeof(Outfit), outfit_cmp );
+   nameindex_init( &outfit_index, 0 );
+   nameindex_init( &outfit_indexCase, 1 );
+   nameindex_reserve( &outfit_index, noutfits );
+   nameindex_reserve( &outfit_indexCase, noutfits );
+   for (int i=0; i<noutfits; i++) {
+      nameindex_add( &outfit_index, outfit_stack[i].name, i );
+      nameindex_add( &outfit_indexCase, outfit_stack[i].name, i );
+   }
    if (license_stack != NULL)
       qsort( license_stack, array_size(license_stack), sizeof(char*), strsort );
 
@@ -2810,6 +2913,7 @@ int outfit_load (void)
       }
 
       env = nlua_newEnv();
+      nlua_setEnvName( env, "outfit/%s", o->name );
       o->lua_env = env;
       /* TODO limit libraries here. */
       nlua_loadStandard( env );
@@ -3069,6 +3173,9 @@ int outfit_licenseExists( const char *name )
  */
 void outfit_free (void)
 {
+   /* The cached descriptions point to the outfits. */
+   pilot_outfitDescClear();
+
    for (int i=0; i < array_size(outfit_stack); i++) {
       Outfit *o = &outfit_stack[i];
 
@@ -3124,6 +3231,7 @@ void outfit_free (void)
       free(o->name);
       free(o->shortname);
       gl_freeTexture(o->gfx_store);
+      free(o->gfx_store_path);
       for (int j=0; j<array_size(o->gfx_overlays); j++)
          gl_freeTexture(o->gfx_overlays[j]);
       array_free(o->gfx_overlays);
@@ -3135,6 +3243,8 @@ void outfit_free (void)
    }
 
    array_free(outfit_stack);
+   nameindex_free( &outfit_index );
+   nameindex_free( &outfit_indexCase );
    array_free(license_stack);
 }
 
@@ -31,6 +31,7 @@
 #define OUTFIT_PROP_WEAP_MISS_ASTEROIDS (1<<11) /**< Weapon can not hit asteroids. */
 #define OUTFIT_PROP_WEAP_MISS_EXPLODE  (1<<12) /**< The weapon particle blows up on miss. */
 #define OUTFIT_PROP_WEAP_ONLYHITTARGET (1<<13) /**< The weapon can only hit the target (and asteroids or whatever). */
+#define OUTFIT_PROP_WEAP_CCD           (1<<14) /**< The weapon particle is tested along its whole movement so it can not tunnel through targets. */
 
 /* Outfit filter labels. [Doc comments are also translator notes and must precede the #define.] */
 /** Colour-coded abbreviation for "Weapon [outfit]", short enough to use as a tab/column title. */
@@ -350,7 +351,8 @@ typedef struct Outfit_ {
    char *desc_extra; /**< Extra description string (if static). */
    int priority;     /**< Sort priority, highest first. */
 
-   glTexture *gfx_store;   /**< Store graphic. */
+   glTexture *gfx_store;   /**< Store graphic, use outfit_gfxStore as it is loaded on demand. */
+   char *gfx_store_path;   /**< Path of the store graphic. */
    glTexture **gfx_overlays;/**< Array (array.h): Store overlay graphics. */
 
    /* Heat limits. */
@@ -474,6 +476,8 @@ char outfit_slotTypeColourFont( const OutfitSlot* os );
 size_t outfit_getNameWithClass( const Outfit* outfit, char* buf, size_t size );
 OutfitSlotSize outfit_toSlotSize( const char *s );
 const OutfitGFX* outfit_gfx( const Outfit* o );
+glTexture* outfit_gfxStore( const Outfit* o );
+void outfit_gfxStoreLoad( const Outfit **outfits, int n );
 const CollPoly* outfit_plg( const Outfit* o );
 int outfit_spfxArmour( const Outfit* o );
 int outfit_spfxShield( const Outfit* o );
@@ -493,6 +497,7 @@ double outfit_trackmax( const Outfit* o );
 int outfit_miningRarity( const Outfit* o );
 int outfit_sound( const Outfit* o );
 int outfit_soundHit( const Outfit* o );
+void outfit_soundPreload( const Outfit* o );
 double outfit_ammoMass( const Outfit *o );
 /* Active outfits. */
 double outfit_duration( const Outfit* o );
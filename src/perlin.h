@@ -10,4 +10,11 @@ void noise_delete( perlin_data_t* pdata );
 /* Simplex noise. */
 float noise_simplex1( perlin_data_t* noise, float f[1] );
 
+/* Batches of simplex noise. */
+void noise_simplex1Span( const perlin_data_t* noise, float x, float dx, int n, float *out );
+void noise_simplex2Grid( const perlin_data_t* noise, float x, float y,
+      float dx, float dy, int w, int h, float *out );
+void noise_simplex3Grid( const perlin_data_t* noise, float x, float y, float z,
+      float dx, float dy, int w, int h, float *out );
+
 /* NOTE: There are additional noise generators (turbulence1, turbulence2, turbulence3) in prior git revisions. */
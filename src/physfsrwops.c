@@ -24,6 +24,8 @@
 #include <stdio.h>  /* used for SEEK_SET, SEEK_CUR, SEEK_END ... */
 #include "physfsrwops.h"
 
+#include "loadprof.h" /* Naev: count bytes read for --profile-load. */
+
 /* SDL's RWOPS interface changed a little in SDL 2.0... */
 #if defined(SDL_VERSION_ATLEAST)
 #if SDL_VERSION_ATLEAST(2, 0, 0)
@@ -134,6 +136,8 @@ static int physfsrwops_read(SDL_RWops *rw, void *ptr, int size, int maxnum)
     PHYSFS_File *handle = (PHYSFS_File *) rw->hidden.unknown.data1;
     const PHYSFS_uint64 readlen = (PHYSFS_uint64) (maxnum * size);
     const PHYSFS_sint64 rc = PHYSFS_readBytes(handle, ptr, readlen);
+    if (rc > 0)
+        loadprof_bytes((size_t) rc);
     if (rc != ((PHYSFS_sint64) readlen))
     {
         if (!PHYSFS_eof(handle)) /* not EOF? Must be an error. */
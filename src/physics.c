@@ -12,6 +12,9 @@
 #include "nstring.h"
 #include "physics.h"
 
+#define SOLID_BATCH  32 /**< Solids integrated together by solid_updateBatch. */
+#define SOLID_INTERP_SLACK 10. /**< Distance a solid can move past its velocity and still be interpolated. */
+
 /**
  * Lists of names for some internal units we use. These just translate them
  * game values to human readable form.
@@ -226,6 +229,208 @@ static void solid_update_rk4( Solid *obj, double dt )
       obj->dir += 2.*M_PI;
 }
 
+/**
+ * @brief Integrates packed Euler solids, see solid_update_euler.
+ *
+ * The solids are copied to packed arrays so the loop has no calls through
+ *  pointers nor branches, and gives the same results as the single update.
+ */
+static void solid_batchEuler( Solid *const* solids, const double *dt, int n )
+{
+   double px[SOLID_BATCH], py[SOLID_BATCH], vx[SOLID_BATCH], vy[SOLID_BATCH];
+   double dir[SOLID_BATCH], dv[SOLID_BATCH], th[SOLID_BATCH];
+
+   for (int j=0; j<n; j++) {
+      const Solid *s = solids[j];
+      px[j]  = s->pos.x;
+      py[j]  = s->pos.y;
+      vx[j]  = s->vel.x;
+      vy[j]  = s->vel.y;
+      dir[j] = s->dir;
+      dv[j]  = s->dir_vel;
+      th[j]  = s->accel;
+   }
+
+   for (int j=0; j<n; j++) {
+      double d = dir[j] + dv[j]*dt[j];
+      d -= 2.*M_PI * (double)(d >= 2.*M_PI);
+      d += 2.*M_PI * (double)(d < 0.);
+      dir[j] = d;
+      vx[j] += th[j]*cos(d) * dt[j];
+      vy[j] += th[j]*sin(d) * dt[j];
+      px[j] += vx[j]*dt[j];
+      py[j] += vy[j]*dt[j];
+   }
+
+   for (int j=0; j<n; j++) {
+      Solid *s = solids[j];
+      s->pre = s->pos;
+      s->dir = dir[j];
+      vec2_cset( &s->vel, vx[j], vy[j] );
+      vec2_cset( &s->pos, px[j], py[j] );
+   }
+}
+
+/**
+ * @brief Integrates packed Runge-Kutta solids, see solid_update_rk4.
+ *
+ * All the solids take as many steps as the one needing the most, with the
+ *  extra steps masked out, and the speed limit is also applied with a mask.
+ *  This gives the same results as the single update.
+ */
+static void solid_batchRK4( Solid *const* solids, const double *dt, int n )
+{
+   double px[SOLID_BATCH], py[SOLID_BATCH], vx[SOLID_BATCH], vy[SOLID_BATCH];
+   double dir[SOLID_BATCH], dv[SOLID_BATCH], th[SOLID_BATCH], h[SOLID_BATCH];
+   double smax[SOLID_BATCH], limit[SOLID_BATCH];
+   int steps[SOLID_BATCH];
+   int nmax = 0;
+
+   for (int j=0; j<n; j++) {
+      const Solid *s = solids[j];
+      double vmod, vint;
+      int N;
+      px[j]    = s->pos.x;
+      py[j]    = s->pos.y;
+      vx[j]    = s->vel.x;
+      vy[j]    = s->vel.y;
+      dir[j]   = s->dir;
+      dv[j]    = s->dir_vel;
+      th[j]    = s->accel;
+      smax[j]  = s->speed_max;
+      limit[j] = (s->speed_max >= 0.);
+
+      /* Same number of steps as solid_update_rk4. */
+      N = (dt[j] > RK4_MIN_H) ? (int)(dt[j] / RK4_MIN_H) : 1;
+      vmod = MOD( vx[j], vy[j] );
+      vint = (int) vmod/100.;
+      if (N < vint)
+         N = vint;
+      steps[j] = N;
+      h[j]     = dt[j] / (double)N;
+      nmax     = MAX( nmax, N );
+   }
+
+   for (int i=0; i<nmax; i++) {
+      for (int j=0; j<n; j++) {
+         double ax, ay, vmod, vang, f, tx, ty;
+         double act = (double)(i < steps[j]);
+
+         /* Calculate acceleration for the frame. */
+         ax = th[j]*cos(dir[j]);
+         ay = th[j]*sin(dir[j]);
+
+         /* Limit the speed by applying a force against it. */
+         vmod = MOD( vx[j], vy[j] );
+         f    = ((limit[j] > 0.) && (vmod > smax[j])) ? 3. * (vmod - smax[j]) : 0.;
+         vang = ANGLE( vx[j], vy[j] ) + M_PI;
+         ax  += f * cos(vang);
+         ay  += f * sin(vang);
+
+         tx  = ax;
+         tx += 2.*ax + h[j]*tx;
+         tx += 2.*ax + h[j]*tx;
+         tx += ax + h[j]*tx;
+         tx *= h[j]/6.;
+
+         ty  = ay;
+         ty += 2.*ay + h[j]*ty;
+         ty += 2.*ay + h[j]*ty;
+         ty += ay + h[j]*ty;
+         ty *= h[j]/6.;
+
+         vx[j]  += tx * act;
+         px[j]  += vx[j] * h[j] * act;
+         vy[j]  += ty * act;
+         py[j]  += vy[j] * h[j] * act;
+         dir[j] += dv[j] * h[j] * act;
+      }
+   }
+
+   for (int j=0; j<n; j++) {
+      Solid *s = solids[j];
+      double d = dir[j];
+      d -= 2.*M_PI * (double)(d >= 2.*M_PI);
+      d += 2.*M_PI * (double)(d < 0.);
+      s->pre = s->pos;
+      s->dir = d;
+      vec2_cset( &s->vel, vx[j], vy[j] );
+      vec2_cset( &s->pos, px[j], py[j] );
+   }
+}
+
+/**
+ * @brief Updates many solids at once.
+ *
+ * Solids are grouped by integrator and integrated in packed batches, which is
+ *  equivalent to calling their update method one by one. Thread-safe as long
+ *  as each solid is only passed once.
+ *
+ *    @param solids Solids to update.
+ *    @param dts Delta tick of each solid, or NULL to use dt for all of them.
+ *    @param dt Delta tick for all the solids when dts is NULL.
+ *    @param n Number of solids.
+ */
+void solid_updateBatch( Solid *const* solids, const double *dts, double dt, int n )
+{
+   Solid *euler[SOLID_BATCH], *rk4[SOLID_BATCH];
+   double deuler[SOLID_BATCH], drk4[SOLID_BATCH];
+   int ne = 0, nr = 0;
+
+   for (int i=0; i<n; i++) {
+      Solid *s = solids[i];
+      double sdt = (dts != NULL) ? dts[i] : dt;
+      if (s->update == solid_update_euler) {
+         euler[ne]  = s;
+         deuler[ne] = sdt;
+         if (++ne >= SOLID_BATCH) {
+            solid_batchEuler( euler, deuler, ne );
+            ne = 0;
+         }
+      }
+      else if (s->update == solid_update_rk4) {
+         rk4[nr]  = s;
+         drk4[nr] = sdt;
+         if (++nr >= SOLID_BATCH) {
+            solid_batchRK4( rk4, drk4, nr );
+            nr = 0;
+         }
+      }
+      else
+         s->update( s, sdt );
+   }
+   if (ne > 0)
+      solid_batchEuler( euler, deuler, ne );
+   if (nr > 0)
+      solid_batchRK4( rk4, drk4, nr );
+}
+
+/**
+ * @brief Moves a solid to where it is rendered between two fixed updates.
+ *
+ * The solid is placed between its positions before and after the last fixed
+ *  update, so rendering lags one update behind but moves smoothly. Solids
+ *  that moved more than their velocity allows, like when jumping in, are left
+ *  where they are.
+ *
+ *    @param s Solid to move.
+ *    @param alpha Fraction of a fixed update left over after the last one.
+ *    @param step Game time of the last fixed update.
+ *    @return The real position, to restore once done rendering.
+ */
+vec2 solid_interpolate( Solid *s, double alpha, double step )
+{
+   vec2 real = s->pos;
+   double dx = s->pos.x - s->interp.x;
+   double dy = s->pos.y - s->interp.y;
+
+   if (pow2(dx)+pow2(dy) > pow2( 2.*VMOD(s->vel)*step + SOLID_INTERP_SLACK ))
+      return real;
+   s->pos.x = s->interp.x + alpha*dx;
+   s->pos.y = s->interp.y + alpha*dy;
+   return real;
+}
+
 /**
  * @brief Gets the maximum speed of any object with speed and accel.
  */
@@ -274,6 +479,7 @@ void solid_init( Solid* dest, double mass, double dir,
    else
       dest->pos = *pos;
    dest->pre = dest->pos; /* Store previous position. */
+   dest->interp = dest->pos;
 
    /* Misc. */
    dest->speed_max = -1.; /* Negative is invalid. */
@@ -48,6 +48,7 @@ typedef struct Solid_ {
    vec2 vel; /**< Velocity of the solid. */
    vec2 pos; /**< Position of the solid. */
    vec2 pre; /**< Previous position of the solid. For collisions. */
+   vec2 interp; /**< Position before the last fixed update, for rendering. */
    double accel; /**< Relative X acceleration, basically simplified for our model. */
    double speed_max; /**< Maximum speed. */
    void (*update)( struct Solid_*, double ); /**< Update method. */
@@ -59,6 +60,8 @@ typedef struct Solid_ {
 double solid_maxspeed( const Solid *s, double speed, double accel );
 void solid_init( Solid* dest, double mass, double dir,
       const vec2* pos, const vec2* vel, int update );
+void solid_updateBatch( Solid *const* solids, const double *dts, double dt, int n );
+vec2 solid_interpolate( Solid *s, double alpha, double step );
 
 /*
  * misc
@@ -18,6 +18,7 @@
 
 #include "ai.h"
 #include "array.h"
+#include "asteroid.h"
 #include "board.h"
 #include "camera.h"
 #include "damagetype.h"
@@ -27,6 +28,7 @@
 #include "explosion.h"
 #include "faction.h"
 #include "font.h"
+#include "frametime.h"
 #include "gatherable.h"
 #include "gui.h"
 #include "hook.h"
@@ -35,6 +37,8 @@
 #include "land_shipyard.h"
 #include "log.h"
 #include "map.h"
+#include "mempool.h"
+#include "memstats.h"
 #include "music.h"
 #include "nlua_pilotoutfit.h"
 #include "nlua_vec2.h"
@@ -51,6 +55,9 @@
 #include "quadtree.h"
 #include "start.h"
 #include "rng.h"
+#include "sound.h"
+#include "spatialgrid.h"
+#include "threadpool.h"
 #include "weapon.h"
 
 #define PILOT_SIZE_MIN 128 /**< Minimum chunks to increment pilot_stack by */
@@ -60,17 +67,140 @@ static unsigned int pilot_id = PLAYER_ID; /**< Stack of pilot ids to assure uniq
 
 /* stack of pilots */
 static Pilot** pilot_stack = NULL; /**< All the pilots in space. (Player may have other Pilot objects, e.g. backup ships.) */
+static MemPool pilot_pool = MEMPOOL_INIT( Pilot, 64, "pilot_pool" ); /**< Memory of all the pilots, including the player's backup ships. */
 static Quadtree pilot_quadtree; /**< Quadtree for the pilots. */
 static IntList pilot_qtquery; /**< Quadtree query. */
+static IntList pilot_nearquery; /**< Query for nearby pilots. */
 static int qt_init = 0;
+/**
+ * @brief Owner of a pilot quadtree element, used to update the tree incrementally.
+ */
+typedef struct PilotQtElem_ {
+   unsigned int id;  /**< ID of the pilot owning the element, 0 if unused. */
+   int seen;         /**< Whether or not the element was updated in the current purge. */
+} PilotQtElem;
+static PilotQtElem *pilot_qtElems = NULL; /**< Owners indexed by quadtree element (array.h). */
 /* A simple grid search procedure was used to determine the following parameters. */
 static int qt_max_elem = 2;
 static int qt_depth = 5;
+/* Spatial index. */
+static PilotSpatialIndex pilot_spatial = PILOT_SPATIAL_QUADTREE; /**< Spatial index in use. */
+static PilotSpatialIndex pilot_spatialNext = PILOT_SPATIAL_QUADTREE; /**< Spatial index to use from the next system. */
+static SpatialGrid pilot_grid; /**< Grid for the pilots. */
+static int sg_init = 0;
+static int sg_cell_size = 512; /**< Size of the grid cells. */
+static int sg_buckets = 1024; /**< Number of grid hash buckets. */
+static int pilot_spatialCount = -1; /**< Size of the stack when the spatial index was updated, -1 if the stack changed order since. */
+#define PILOT_NEAREST_RADIUS  2500. /**< Initial radius of the nearest pilot searches. */
+#define PILOT_NEAREST_MARGIN  250. /**< Allows for pilots having moved since the spatial index was updated. */
+#define PILOT_NEARBY_MAX      1e8 /**< Radius past which nearby queries just return all the pilots. */
+/* Visibility. */
+#define PILOT_CULL_MARGIN     256. /**< Screen pixels around the screen pilots are still drawn in, covers overlays like comm messages. */
+#define PILOT_EFFECT_EXTENT   2.   /**< Largest size effect shaders sample around the ship, relative to it (effect2x.vert). */
+#define PILOT_EFFECT_PAD      8.   /**< Extra pixels cleared for effect shaders that blur. */
+#define PILOT_PREFETCH_SHEETS 2    /**< Sprite sheets created at most per prefetch, they are rendered. */
+/* Think level of detail. */
+#define PILOT_LOD_RANGE       5000. /**< Distance from the camera past which escorts think less often. */
+#define PILOT_LOD_FRAMES      4    /**< Most frames between two thinks of a far escort. */
+static unsigned int pilot_lodFrame = 0; /**< Frame counter to stagger the thinks of far escorts. */
+static int *pilot_visible = NULL; /**< Stack indices of the pilots near the screen, in stack order (array.h). */
+static unsigned int pilot_stackGen = 0; /**< Bumped whenever pilots are added to or removed from the stack. */
+static unsigned int pilot_visibleGen = 0; /**< Stack generation pilot_visible was computed for. */
+static vec2 *pilot_interpSaved = NULL; /**< Real positions while rendering interpolated (array.h). */
+/* Compact state. */
+#define PILOT_STATE_HIDE      (1<<0) /**< Pilot is hidden. */
+#define PILOT_STATE_DELETE    (1<<1) /**< Pilot is being deleted. */
+#define PILOT_STATE_NOTHINK   (1<<2) /**< Pilot is dead or disabled. */
+#define PILOT_STATE_PERSIST   (1<<3) /**< Pilot persists through jumps. */
+#define PILOT_STATE_PLAYER    (1<<4) /**< Pilot is the player. */
+/**
+ * @brief Compact copy of what the loops over the stack filter on.
+ *
+ * The flags are refreshed every purge, so they can be a frame late and the
+ *  pilots that get through the filters have to be checked again. The IDs are
+ *  kept in sync with the stack as long as it is only appended to or erased
+ *  from, anything else invalidates the states until the next purge.
+ */
+typedef struct PilotState_ {
+   unsigned int id;     /**< ID of the pilot. */
+   unsigned int state;  /**< PILOT_STATE_* bits. */
+} PilotState;
+static PilotState *pilot_states = NULL; /**< State of each pilot, in stack order (array.h). */
+static int pilot_statesValid = 0; /**< Whether pilot_states matches the stack. */
+static int *pilot_thinkList = NULL; /**< Stack indices of the pilots that may think (array.h). */
+static int *pilot_updateList = NULL; /**< Stack indices of the pilots that may be updated (array.h). */
+/* ID lookup. */
+#define PILOT_SLOTS_MIN       256 /**< Minimum size of the ID table, must be a power of two. */
+/**
+ * @brief Entry of the table looking up pilots by ID.
+ *
+ * Pilots go in the slot given by the low bits of their ID, and the full ID
+ *  is kept to tell stale IDs apart, as IDs are never reused. Pilots whose slot
+ *  is taken are only counted, and looked up in the stack instead.
+ */
+typedef struct PilotSlot_ {
+   unsigned int id;  /**< ID of the pilot in the slot, 0 if empty. */
+   Pilot *p;         /**< Pilot in the slot. */
+} PilotSlot;
+static PilotSlot *pilot_slots = NULL; /**< Pilots by ID. */
+static unsigned int pilot_slotMask = 0; /**< Size of pilot_slots minus one. */
+static int pilot_slotUsed = 0; /**< Pilots in pilot_slots. */
+static int pilot_slotOverflow = 0; /**< Pilots on the stack that did not fit in pilot_slots. */
+static unsigned int pilot_epochCur = 1; /**< Changes whenever an ID may stop pointing to the same pilot. */
+
+/**
+ * @brief Scoring function for the nearest pilot searches.
+ *
+ *    @param p Pilot doing the search.
+ *    @param target Pilot being considered.
+ *    @param data User data.
+ *    @param[out] score Score of the target, lower is better.
+ *    @return 1 if the target is a valid result, 0 otherwise.
+ */
+typedef int (*PilotNearestScore)( const Pilot *p, const Pilot *target, const void *data, double *score );
 
 /* misc */
 static const double pilot_commTimeout  = 15.; /**< Time for text above pilot to time out. */
 static const double pilot_commFade     = 5.; /**< Time for text above pilot to fade out. */
 
+/**
+ * @brief Per-pilot update state carried between the update stages.
+ *
+ * The threaded stages only touch the pilot they are working on and write
+ *  anything that has side effects on the rest of the game (Lua, hooks,
+ *  weapons, sounds, ...) in here so it can be applied serially afterwards.
+ */
+typedef struct PilotUpdate_ {
+   Pilot *p;         /**< Pilot being updated. */
+   double dt;        /**< Delta tick modified by the pilot's time speedup. */
+   Pilot *target;    /**< Pilot target at the start of the update. */
+   Target wt;        /**< Weapon target at the start of the update. */
+   int cooling;      /**< Whether or not the pilot is actively cooling down. */
+   int cooldown_end; /**< Cooldown finished and has to be ended serially. */
+   int nchg;         /**< Number of outfits that changed state. */
+   int lockon;       /**< Number of launchers that just got a lock. */
+   int *outfit_off;  /**< Slots (pilot outfit ids) to turn off serially (array.h). */
+   int outfit_ticks; /**< Number of Lua outfit updates that are due. */
+   int active;       /**< Whether or not the pilot should continue through the stages. */
+   int disabled;     /**< Whether or not the pilot took the disabled/cooldown path. */
+   int integrated;   /**< Whether or not the solid was already integrated in a batch. */
+} PilotUpdate;
+static PilotUpdate *pilot_updates = NULL; /**< Update state per pilot, reused between frames (array.h). */
+static ThreadQueue *pilot_updateQueue = NULL; /**< Queue used for the threaded update stages. */
+/**
+ * @brief Chunk of work for a threaded update stage.
+ */
+typedef struct PilotUpdateChunk_ {
+   void (*batch)( PilotUpdate *pu, int n ); /**< Run on the whole chunk before the stage, may be NULL. */
+   void (*stage)( PilotUpdate *pu ); /**< Stage to run. */
+   int start;  /**< First element of pilot_updates to process. */
+   int end;    /**< One past the last element of pilot_updates to process. */
+} PilotUpdateChunk;
+static PilotUpdateChunk *pilot_updateChunks = NULL; /**< Work partitions (array.h). */
+#define PILOT_UPDATE_THREADED_MIN   64 /**< Minimum number of pilots to bother with threads. */
+#define PILOT_UPDATE_CHUNK_MIN      16 /**< Minimum pilots per thread partition. */
+#define PILOT_SOLID_BATCH           32 /**< Pilots gathered per solid_updateBatch call. */
+
 /*
  * Prototypes
  */
@@ -81,11 +211,32 @@ static void pilot_init( Pilot* dest, const Ship* ship, const char* name, int fac
 /* Update. */
 static void pilot_hyperspace( Pilot* pilot, double dt );
 static void pilot_refuel( Pilot *p, double dt );
+static void pilot_updateStart( PilotUpdate *pu );
+static int pilot_updateMain( PilotUpdate *pu );
+static void pilot_updateSolidBatch( PilotUpdate *pu, int n );
+static void pilot_updateSolid( PilotUpdate *pu );
+static void pilot_updateEnd( PilotUpdate *pu );
+static int pilots_updateStageThread( void *data );
+static void pilots_updateStage( void (*batch)( PilotUpdate *pu, int n ), void (*stage)( PilotUpdate *pu ), int n );
 /* Clean up. */
 static void pilot_erase( Pilot *p );
+/* Compact state. */
+static unsigned int pilot_stateGet( const Pilot *p );
+static void pilot_statePush( const Pilot *p );
+static void pilot_stateErase( int i );
+static int pilots_stateFilter( int **list, unsigned int skip );
+static int pilot_thinkLOD( const Pilot *p );
+static void pilot_think( Pilot *p, double dt );
+/* ID lookup. */
+static void pilot_slotSet( Pilot *p );
+static void pilot_slotInsert( Pilot *p );
+static void pilot_slotRemove( const Pilot *p );
+static void pilot_slotRebuild (void);
 /* Misc. */
-static void pilot_renderFramebufferBase( Pilot *p, GLuint fbo, double fw, double fh );
+static void pilot_renderFramebufferBase( Pilot *p, GLuint fbo, double fw, double fh, double cw, double ch );
 static int pilot_getStackPos( unsigned int id );
+static Pilot *pilot_getNearestSearch( const Pilot *p, double x, double y,
+      double weight, PilotNearestScore score, const void *data );
 static void pilot_init_trails( Pilot* p );
 static int pilot_trail_generated( Pilot* p, int generator );
 
@@ -118,14 +269,205 @@ static int pilot_getStackPos( unsigned int id )
 {
    const Pilot pid = { .id = id };
    const Pilot *pidptr = &pid;
+   Pilot **pp;
+
+   /* Binary search over the compact IDs, without touching the pilots. */
+   if (pilot_statesValid && (array_size(pilot_states) == array_size(pilot_stack))) {
+      int l = 0, h = array_size(pilot_states)-1;
+      while (l <= h) {
+         int m = (l+h) / 2;
+         if (pilot_states[m].id < id)
+            l = m+1;
+         else if (pilot_states[m].id > id)
+            h = m-1;
+         else
+            return m;
+      }
+      return -1;
+   }
+
    /* binary search */
-   Pilot **pp = bsearch(&pidptr, pilot_stack, array_size(pilot_stack), sizeof(Pilot*), pilot_cmp);
+   pp = bsearch(&pidptr, pilot_stack, array_size(pilot_stack), sizeof(Pilot*), pilot_cmp);
    if (pp == NULL)
       return -1;
    else
       return pp - pilot_stack;
 }
 
+/**
+ * @brief Puts a pilot in its slot of the ID table, the table must have room.
+ */
+static void pilot_slotSet( Pilot *p )
+{
+   PilotSlot *s = &pilot_slots[ p->id & pilot_slotMask ];
+   if (s->p == p)
+      return;
+   if (s->p == NULL) {
+      s->id = p->id;
+      s->p  = p;
+      pilot_slotUsed++;
+   }
+   /* Pilots replacing the player share its ID until the old one is purged. */
+   else if ((s->id == p->id) && pilot_isFlag(s->p, PILOT_DELETE)) {
+      s->p = p;
+      pilot_slotOverflow++;
+      pilot_epochCur++;
+   }
+   else
+      pilot_slotOverflow++;
+}
+
+/**
+ * @brief Adds a pilot that got its ID to the ID table.
+ */
+static void pilot_slotInsert( Pilot *p )
+{
+   if ((pilot_slots == NULL) ||
+         (2*(pilot_slotUsed+pilot_slotOverflow+1) > (int)pilot_slotMask+1)) {
+      pilot_slotRebuild(); /* The pilot is already on the stack. */
+      return;
+   }
+   pilot_slotSet( p );
+}
+
+/**
+ * @brief Removes a pilot about to be erased from the stack from the ID table.
+ */
+static void pilot_slotRemove( const Pilot *p )
+{
+   PilotSlot *s;
+   if ((pilot_slots == NULL) || (p->id == 0))
+      return;
+   s = &pilot_slots[ p->id & pilot_slotMask ];
+   if (s->p == p) {
+      s->id = 0;
+      s->p  = NULL;
+      pilot_slotUsed--;
+   }
+   else if (pilot_slotOverflow > 0)
+      pilot_slotOverflow--;
+   pilot_epochCur++;
+}
+
+/**
+ * @brief Rebuilds the ID table from the stack, resizing it as needed.
+ */
+static void pilot_slotRebuild (void)
+{
+   int n = array_size(pilot_stack);
+   unsigned int size = PILOT_SLOTS_MIN;
+
+   while ((int)size < 2*(n+1))
+      size *= 2;
+   if ((pilot_slots == NULL) || (size != pilot_slotMask+1)) {
+      free( pilot_slots );
+      pilot_slots    = calloc( size, sizeof(PilotSlot) );
+      pilot_slotMask = size-1;
+   }
+   else
+      memset( pilot_slots, 0, size * sizeof(PilotSlot) );
+
+   pilot_slotUsed     = 0;
+   pilot_slotOverflow = 0;
+   pilot_epochCur++;
+   for (int i=0; i<n; i++)
+      if (pilot_stack[i]->id != 0) /* Still being created. */
+         pilot_slotSet( pilot_stack[i] );
+}
+
+/**
+ * @brief Gets the compact state bits of a pilot.
+ */
+static unsigned int pilot_stateGet( const Pilot *p )
+{
+   unsigned int s = 0;
+   if (pilot_isFlag(p, PILOT_HIDE))
+      s |= PILOT_STATE_HIDE;
+   if (pilot_isFlag(p, PILOT_DELETE))
+      s |= PILOT_STATE_DELETE;
+   if (pilot_isDisabled(p) || pilot_isFlag(p, PILOT_DEAD))
+      s |= PILOT_STATE_NOTHINK;
+   if (pilot_isFlag(p, PILOT_PERSIST))
+      s |= PILOT_STATE_PERSIST;
+   if (pilot_isFlag(p, PILOT_PLAYER))
+      s |= PILOT_STATE_PLAYER;
+   return s;
+}
+
+/**
+ * @brief Adds the state of a pilot that was just appended to the stack with its final ID.
+ */
+static void pilot_statePush( const Pilot *p )
+{
+   PilotState *ps;
+   if (!pilot_statesValid)
+      return;
+   if ((array_size(pilot_states) != array_size(pilot_stack)-1) ||
+         (pilot_stack[ array_size(pilot_stack)-1 ] != p)) {
+      pilot_statesValid = 0;
+      return;
+   }
+   ps = &array_grow( &pilot_states );
+   ps->id    = p->id;
+   ps->state = pilot_stateGet( p );
+}
+
+/**
+ * @brief Removes the state of a pilot about to be erased from the stack.
+ *
+ *    @param i Stack index of the pilot.
+ */
+static void pilot_stateErase( int i )
+{
+   if (!pilot_statesValid)
+      return;
+   if ((i < 0) || (array_size(pilot_states) != array_size(pilot_stack))) {
+      pilot_statesValid = 0;
+      return;
+   }
+   array_erase( &pilot_states, &pilot_states[i], &pilot_states[i+1] );
+}
+
+/**
+ * @brief Checks to see if the compact state of a pilot has any of some bits.
+ *
+ *    @param i Stack index of the pilot.
+ *    @param bits PILOT_STATE_* bits to check.
+ *    @return 1 if the pilot has a state with any of the bits.
+ */
+static inline int pilot_stateSkip( int i, unsigned int bits )
+{
+   return pilot_statesValid && (i < array_size(pilot_states)) &&
+         (pilot_states[i].state & bits);
+}
+
+/**
+ * @brief Gets the stack indices of the pilots that have none of some state bits.
+ *
+ * Pilots added to the stack since the last purge are always included.
+ *
+ *    @param[out] list Array (array.h) to fill, created if needed.
+ *    @param skip PILOT_STATE_* bits of the pilots to leave out.
+ *    @return Number of pilots in the list.
+ */
+static int pilots_stateFilter( int **list, unsigned int skip )
+{
+   int n = array_size(pilot_stack);
+   int ns = pilot_statesValid ? MIN( n, array_size(pilot_states) ) : 0;
+   int m = 0;
+
+   if (*list == NULL)
+      *list = array_create_size( int, PILOT_SIZE_MIN );
+   array_resize( list, n );
+   for (int i=0; i<ns; i++)
+      if (!(pilot_states[i].state & skip))
+         (*list)[m++] = i;
+   for (int i=ns; i<n; i++)
+      (*list)[m++] = i;
+   array_resize( list, m );
+   return m;
+}
+
 /**
  * @brief Gets the next pilot based on id.
  *
@@ -325,30 +667,130 @@ int pilot_validEnemy( const Pilot* p, const Pilot* target )
 }
 
 /**
- * @brief Gets the nearest enemy to the pilot.
+ * @brief Gets the pilots that may be within a square around a position.
  *
- *    @param p Pilot to get the nearest enemy of.
- *    @return ID of their nearest enemy.
+ * Uses the spatial index, and also includes the pilots added to the stack
+ * since it was last updated. Falls back to all the pilots when the index can
+ * not be used.
+ *
+ *    @param x X position of the centre.
+ *    @param y Y position of the centre.
+ *    @param r Half-size of the square.
+ *    @return Stack indices of the pilots, which may include pilots outside of
+ *            the square. Only valid until the next call.
  */
-unsigned int pilot_getNearestEnemy( const Pilot* p )
+const IntList *pilot_getNearby( double x, double y, double r )
 {
-   unsigned int tp = 0;
-   double d = 0.;
+   int n = array_size(pilot_stack);
 
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      double td;
+   if ((pilot_spatialCount < 0) || (pilot_spatialCount > n) || (r > PILOT_NEARBY_MAX)) {
+      il_clear( &pilot_nearquery );
+      for (int i=0; i<n; i++)
+         il_set( &pilot_nearquery, il_push_back( &pilot_nearquery ), 0, i );
+      return &pilot_nearquery;
+   }
 
-      if (!pilot_validEnemy( p, pilot_stack[i] ))
-         continue;
+   pilot_collideQueryIL( &pilot_nearquery, floor(x-r), floor(y-r), ceil(x+r), ceil(y+r) );
+   for (int i=pilot_spatialCount; i<n; i++)
+      il_set( &pilot_nearquery, il_push_back( &pilot_nearquery ), 0, i );
+   return &pilot_nearquery;
+}
 
-      /* Check distance. */
-      td = vec2_dist2(&pilot_stack[i]->solid.pos, &p->solid.pos);
-      if (!tp || (td < d)) {
-         d  = td;
-         tp = pilot_stack[i]->id;
+/**
+ * @brief Finds the pilot with the lowest score around a position.
+ *
+ * Looks in growing squares around the position, and stops once no pilot
+ * outside of the square could beat the best one. Ties go to the pilot
+ * earliest in the stack, like a linear search would.
+ *
+ *    @param p Pilot doing the search.
+ *    @param x X position to search around.
+ *    @param y Y position to search around.
+ *    @param weight Score of a pilot at distance d is at least weight*d^2.
+ *                  Use 0 if there is no such bound to do a linear search.
+ *    @param score Scoring function.
+ *    @param data User data for the scoring function.
+ *    @return The pilot with the lowest score or NULL if none is valid.
+ */
+static Pilot *pilot_getNearestSearch( const Pilot *p, double x, double y,
+      double weight, PilotNearestScore score, const void *data )
+{
+   Pilot *best = NULL;
+   int bidx = -1;
+   double bscore = 0.;
+   double rmax = (cur_system != NULL) ? 2.2*cur_system->radius : 0.;
+
+   if ((weight > 0.) && (pilot_spatialCount >= 0)) {
+      for (double r=PILOT_NEAREST_RADIUS; r<rmax; r*=4.) {
+         const IntList *il = pilot_getNearby( x, y, r );
+         for (int i=0; i<il_size(il); i++) {
+            int idx = il_get( il, i, 0 );
+            double s;
+            if (!score( p, pilot_stack[idx], data, &s ))
+               continue;
+            if ((best==NULL) || (s < bscore) || ((s == bscore) && (idx < bidx))) {
+               best   = pilot_stack[idx];
+               bidx   = idx;
+               bscore = s;
+            }
+         }
+         /* Anything not found yet is farther than r. */
+         if ((best != NULL) && (bscore < weight*pow2(r-PILOT_NEAREST_MARGIN)))
+            return best;
       }
    }
-   return tp;
+
+   /* Linear search over everything. */
+   best = NULL;
+   for (int i=0; i<array_size(pilot_stack); i++) {
+      double s;
+      if (!score( p, pilot_stack[i], data, &s ))
+         continue;
+      if ((best==NULL) || (s < bscore)) {
+         best   = pilot_stack[i];
+         bscore = s;
+      }
+   }
+   return best;
+}
+
+/**
+ * @brief Scores enemies by distance for pilot_getNearestEnemy.
+ */
+static int pilot_nearestEnemyScore( const Pilot *p, const Pilot *target, const void *data, double *score )
+{
+   (void) data;
+   if (!pilot_validEnemy( p, target ))
+      return 0;
+   *score = vec2_dist2( &target->solid.pos, &p->solid.pos );
+   return 1;
+}
+
+/**
+ * @brief Gets the nearest enemy to the pilot.
+ *
+ *    @param p Pilot to get the nearest enemy of.
+ *    @return ID of their nearest enemy.
+ */
+unsigned int pilot_getNearestEnemy( const Pilot* p )
+{
+   const Pilot *t = pilot_getNearestSearch( p, p->solid.pos.x, p->solid.pos.y,
+         1., pilot_nearestEnemyScore, NULL );
+   return (t==NULL) ? 0 : t->id;
+}
+
+/**
+ * @brief Scores enemies within mass bounds by distance for pilot_getNearestEnemy_size.
+ */
+static int pilot_nearestEnemySizeScore( const Pilot *p, const Pilot *target, const void *data, double *score )
+{
+   const double *bounds = data;
+   if (!pilot_validEnemy( p, target ))
+      return 0;
+   if (target->solid.mass < bounds[0] || target->solid.mass > bounds[1])
+      return 0;
+   *score = vec2_dist2( &target->solid.pos, &p->solid.pos );
+   return 1;
 }
 
 /**
@@ -361,27 +803,28 @@ unsigned int pilot_getNearestEnemy( const Pilot* p )
  */
 unsigned int pilot_getNearestEnemy_size( const Pilot* p, double target_mass_LB, double target_mass_UB )
 {
-   unsigned int tp = 0;
-   double d = 0.;
-
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      double td;
-
-      if (!pilot_validEnemy( p, pilot_stack[i] ))
-         continue;
-
-      if (pilot_stack[i]->solid.mass < target_mass_LB || pilot_stack[i]->solid.mass > target_mass_UB)
-         continue;
-
-      /* Check distance. */
-      td = vec2_dist2(&pilot_stack[i]->solid.pos, &p->solid.pos);
-      if (!tp || (td < d)) {
-         d = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
+   const double bounds[2] = { target_mass_LB, target_mass_UB };
+   const Pilot *t = pilot_getNearestSearch( p, p->solid.pos.x, p->solid.pos.y,
+         1., pilot_nearestEnemySizeScore, bounds );
+   return (t==NULL) ? 0 : t->id;
+}
 
-   return tp;
+/**
+ * @brief Scores enemies for pilot_getNearestEnemy_heuristic.
+ *
+ * The relative terms are all positive, so the score is bounded by the range term.
+ */
+static int pilot_nearestEnemyHeuristicScore( const Pilot *p, const Pilot *target, const void *data, double *score )
+{
+   const double *factors = data;
+   if (!pilot_validEnemy( p, target ))
+      return 0;
+   *score = factors[3] *
+            vec2_dist2( &target->solid.pos, &p->solid.pos )
+         + FABS( pilot_relsize( p, target ) - factors[0] )
+         + FABS( pilot_relhp(   p, target ) - factors[1] )
+         + FABS( pilot_reldps(  p, target ) - factors[2] );
+   return 1;
 }
 
 /**
@@ -398,30 +841,10 @@ unsigned int pilot_getNearestEnemy_heuristic( const Pilot* p,
       double mass_factor, double health_factor,
       double damage_factor, double range_factor )
 {
-   unsigned int tp = 0;
-   double current_heuristic_value = 10e3;
-
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      double temp;
-      Pilot *target = pilot_stack[i];
-
-      if (!pilot_validEnemy( p, target ))
-         continue;
-
-      /* Check distance. */
-      temp = range_factor *
-               vec2_dist2( &target->solid.pos, &p->solid.pos )
-            + FABS( pilot_relsize( p, target ) - mass_factor )
-            + FABS( pilot_relhp(   p, target ) - health_factor )
-            + FABS( pilot_reldps(  p, target ) - damage_factor );
-
-      if ((tp == 0) || (temp < current_heuristic_value)) {
-         current_heuristic_value = temp;
-         tp = target->id;
-      }
-   }
-
-   return tp;
+   const double factors[4] = { mass_factor, health_factor, damage_factor, range_factor };
+   const Pilot *t = pilot_getNearestSearch( p, p->solid.pos.x, p->solid.pos.y,
+         MAX( 0., range_factor ), pilot_nearestEnemyHeuristicScore, factors );
+   return (t==NULL) ? 0 : t->id;
 }
 
 /**
@@ -500,6 +923,36 @@ unsigned int pilot_getBoss( const Pilot* p )
    return t;
 }
 
+/**
+ * @brief Scores pilots by distance to a position for pilot_getNearestPosPilot.
+ */
+static int pilot_nearestPosScore( const Pilot *p, const Pilot *target, const void *data, double *score )
+{
+   const double *pos = data;
+   int disabled = (pos[2] != 0.);
+
+   /* Must not be self. */
+   if (target == p)
+      return 0;
+
+   /* Player doesn't select escorts (unless disabled is active). */
+   if (!disabled && pilot_isPlayer(p) &&
+         pilot_isWithPlayer(target))
+      return 0;
+
+   /* Shouldn't be disabled. */
+   if (!disabled && pilot_isDisabled(target))
+      return 0;
+
+   /* Must be a valid target. */
+   if (!pilot_validTarget( p, target ))
+      return 0;
+
+   /* Minimum distance. */
+   *score = pow2(pos[0]-target->solid.pos.x) + pow2(pos[1]-target->solid.pos.y);
+   return 1;
+}
+
 /**
  * @brief Get the nearest pilot to a pilot from a certain position.
  *
@@ -512,36 +965,11 @@ unsigned int pilot_getBoss( const Pilot* p )
  */
 double pilot_getNearestPosPilot( const Pilot *p, Pilot **tp, double x, double y, int disabled )
 {
-   double d = 0.;
-   *tp = NULL;
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      double td;
-
-      /* Must not be self. */
-      if (pilot_stack[i] == p)
-         continue;
-
-      /* Player doesn't select escorts (unless disabled is active). */
-      if (!disabled && pilot_isPlayer(p) &&
-            pilot_isWithPlayer(pilot_stack[i]))
-         continue;
-
-      /* Shouldn't be disabled. */
-      if (!disabled && pilot_isDisabled(pilot_stack[i]))
-         continue;
-
-      /* Must be a valid target. */
-      if (!pilot_validTarget( p, pilot_stack[i] ))
-         continue;
-
-      /* Minimum distance. */
-      td = pow2(x-pilot_stack[i]->solid.pos.x) + pow2(y-pilot_stack[i]->solid.pos.y);
-      if (((*tp==NULL) || (td < d))) {
-         d = td;
-         *tp = pilot_stack[i];
-      }
-   }
-   return d;
+   const double data[3] = { x, y, disabled };
+   *tp = pilot_getNearestSearch( p, x, y, 1., pilot_nearestPosScore, data );
+   if (*tp == NULL)
+      return 0.;
+   return pow2(x-(*tp)->solid.pos.x) + pow2(y-(*tp)->solid.pos.y);
 }
 
 /**
@@ -618,25 +1046,59 @@ double pilot_getNearestAng( const Pilot *p, unsigned int *tp, double ang, int di
    return a;
 }
 
+/**
+ * @brief Gets the pilot epoch.
+ *
+ * The epoch changes whenever a pilot is freed or an ID starts pointing to
+ *  another pilot, so the pilot of an ID can be cached as long as the epoch
+ *  stays the same. Pilots can still get flagged for deletion in between.
+ *
+ *    @return The current pilot epoch.
+ */
+unsigned int pilot_epoch (void)
+{
+   return pilot_epochCur;
+}
+
 /**
  * @brief Pulls a pilot out of the pilot_stack based on ID.
  *
- * It's a binary search ( O(logn) ) therefore it's pretty fast and can be
- *  abused all the time. Maximum iterations is 32 on a platform with 32 bit
- *  unsigned ints.
+ * It's a lookup in the ID table, falling back to a binary search when some
+ *  pilots collided in it, therefore it's fast and can be abused all the time.
  *
  *    @param id ID of the pilot to get.
  *    @return The actual pilot who has matching ID or NULL if not found.
  */
 Pilot* pilot_get( unsigned int id )
 {
-   const Pilot pid = { .id = id };
-   const Pilot *pidptr = &pid;
-   /* binary search */
-   Pilot **pp = bsearch(&pidptr, pilot_stack, array_size(pilot_stack), sizeof(Pilot*), pilot_cmp);
-   if ((pp==NULL) || (pilot_isFlag(*pp, PILOT_DELETE)))
+   Pilot *p;
+   int i;
+
+   /* Single lookup in the ID table, the stack is only searched when some
+    * pilots did not fit in it. */
+   if (pilot_slots != NULL) {
+      const PilotSlot *s = &pilot_slots[ id & pilot_slotMask ];
+      if ((s->id == id) && (s->p != NULL))
+         p = s->p;
+      else if (pilot_slotOverflow == 0)
+         return NULL;
+      else {
+         i = pilot_getStackPos( id );
+         if (i < 0)
+            return NULL;
+         p = pilot_stack[i];
+      }
+   }
+   else {
+      i = pilot_getStackPos( id );
+      if (i < 0)
+         return NULL;
+      p = pilot_stack[i];
+   }
+
+   if (pilot_isFlag(p, PILOT_DELETE))
       return NULL;
-   return *pp;
+   return p;
 }
 
 /**
@@ -796,15 +1258,87 @@ PilotOutfitSlot* pilot_getDockSlot( Pilot* p )
    return NULL;
 }
 
+/**
+ * @brief Warms up what the pilots in an area need to be shown and heard.
+ *
+ * Decodes the sounds they can play and creates the sprite sheets of their 3D
+ *  models, a few at a time as they have to be rendered.
+ *
+ *    @param x1 Left edge of the area.
+ *    @param y1 Bottom edge of the area.
+ *    @param x2 Right edge of the area.
+ *    @param y2 Top edge of the area.
+ */
+void pilots_prefetch( double x1, double y1, double x2, double y2 )
+{
+   int sheets = 0;
+
+   NTracingZone( _ctx, 1 );
+
+   pilot_collideQueryIL( &pilot_qtquery, floor(x1), floor(y1), ceil(x2), ceil(y2) );
+   for (int i=0; i<il_size(&pilot_qtquery); i++) {
+      const Pilot *p;
+      int id = il_get( &pilot_qtquery, i, 0 );
+      if (id >= array_size(pilot_stack))
+         continue;
+      p = pilot_stack[id];
+      if (pilot_isFlag( p, PILOT_DELETE ))
+         continue;
+
+      if (!sound_disabled) {
+         sound_preload( p->ship->sound );
+         for (int j=0; j<array_size(p->outfits); j++)
+            if (p->outfits[j]->outfit != NULL)
+               outfit_soundPreload( p->outfits[j]->outfit );
+      }
+
+      if ((p->ship->gfx_3d != NULL) && (sheets < PILOT_PREFETCH_SHEETS)) {
+         sheets += object_prefetchSheet( p->ship->gfx_3d, "body" );
+         sheets += object_prefetchSheet( p->ship->gfx_3d, "engine" );
+      }
+   }
+
+   NTracingZoneEnd( _ctx );
+}
+
 const IntList *pilot_collideQuery( int x1, int y1, int x2, int y2 )
 {
-   qt_query( &pilot_quadtree, &pilot_qtquery, x1, y1, x2, y2 );
+   pilot_collideQueryIL( &pilot_qtquery, x1, y1, x2, y2 );
    return &pilot_qtquery;
 }
 
 void pilot_collideQueryIL( IntList *il, int x1, int y1, int x2, int y2 )
 {
-   qt_query( &pilot_quadtree, il, x1, y1, x2, y2 );
+   if (pilot_spatial == PILOT_SPATIAL_GRID)
+      sg_query( &pilot_grid, il, x1, y1, x2, y2 );
+   else
+      qt_query( &pilot_quadtree, il, x1, y1, x2, y2 );
+}
+
+void pilot_collideQueryILScratch( IntList *il, QuadtreeScratch *scratch, int x1, int y1, int x2, int y2 )
+{
+   /* Grid queries don't need scratch memory. */
+   if (pilot_spatial == PILOT_SPATIAL_GRID)
+      sg_query( &pilot_grid, il, x1, y1, x2, y2 );
+   else
+      qt_query_scratch( &pilot_quadtree, scratch, il, x1, y1, x2, y2 );
+}
+
+/**
+ * @brief Calls a function on the stack index of the pilots colliding with a
+ *        rectangle, without building a list.
+ *
+ * The function must not add, remove or move pilots in the spatial index.
+ *
+ *    @param func Function to call, returning nonzero stops the query.
+ *    @param data User data for the function.
+ */
+void pilot_collideQueryEach( int x1, int y1, int x2, int y2, QtEltFunc *func, void *data )
+{
+   if (pilot_spatial == PILOT_SPATIAL_GRID)
+      sg_query_each( &pilot_grid, x1, y1, x2, y2, func, data );
+   else
+      qt_query_each( &pilot_quadtree, x1, y1, x2, y2, func, data );
 }
 
 /**
@@ -1372,7 +1906,7 @@ double pilot_hit( Pilot* p, const Solid* w, const Pilot *pshooter,
    /* Calculate the damage. */
    absorb         = 1. - CLAMP( 0., 1., p->dmg_absorb - dmg->penetration );
    disable        = dmg->disable;
-   dtype_calcDamage( &damage_shield, &damage_armour, absorb, &knockback, dmg, &p->stats );
+   dtype_calcDamageMods( &damage_shield, &damage_armour, absorb, &knockback, dmg, p->dtype_mods );
 
    /*
     * Delay undisable if necessary. Amount varies with damage, as e.g. a
@@ -1750,8 +2284,10 @@ void pilot_explode( double x, double y, double radius, const Damage *dmg, const
  *    @param fbo Framebuffer to render to.
  *    @param fw Framebuffer width.
  *    @param fh Framebuffer height.
+ *    @param cw Width to clear from the origin in screen framebuffer units, 0 to clear it all.
+ *    @param ch Height to clear from the origin in screen framebuffer units, 0 to clear it all.
  */
-static void pilot_renderFramebufferBase( Pilot *p, GLuint fbo, double fw, double fh )
+static void pilot_renderFramebufferBase( Pilot *p, GLuint fbo, double fw, double fh, double cw, double ch )
 {
    glColour c = { 1., 1., 1., 1. };
 
@@ -1762,9 +2298,26 @@ static void pilot_renderFramebufferBase( Pilot *p, GLuint fbo, double fw, double
    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
    glClearColor( 0., 0., 0., 0. );
 
+   /* Clearing the whole screen sized framebuffer for every ship is mostly
+    * wasted fill, only what the effect can sample has to be cleared. */
+   if ((cw > 0.) && (ch > 0.)) {
+      glScissor( 0, 0, ceil( cw * gl_screen.rw / gl_screen.nw ),
+            ceil( ch * gl_screen.rh / gl_screen.nh ) );
+      glEnable( GL_SCISSOR_TEST );
+   }
+
    if (p->ship->gfx_3d != NULL) {
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-      /* TODO fix 3D rendering. */
+      const glTexture *sa = p->ship->gfx_space;
+      mat4 tmpm;
+
+      glClear( GL_COLOR_BUFFER_BIT );
+
+      /* The sprite sheets of the model fill the same box as the 2D sprite. */
+      tmpm = gl_view_matrix;
+      gl_view_matrix = mat4_ortho( 0., fw, 0, fh, -1., 1. );
+      object_renderSheet( p->ship->gfx_3d, "body", 0., 0., sa->sw, sa->sh, p->solid.dir, c.a );
+      object_renderSheet( p->ship->gfx_3d, "engine", 0., 0., sa->sw, sa->sh, p->solid.dir, c.a * p->engine_glow );
+      gl_view_matrix = tmpm;
    }
    else {
       double tx,ty;
@@ -1790,6 +2343,8 @@ static void pilot_renderFramebufferBase( Pilot *p, GLuint fbo, double fw, double
       gl_view_matrix = tmpm;
    }
 
+   if ((cw > 0.) && (ch > 0.))
+      gl_unclipRect();
    glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
    glClearColor( 0., 0., 0., 1. );
 }
@@ -1824,25 +2379,26 @@ void pilot_renderFramebuffer( Pilot *p, GLuint fbo, double fw, double fh )
 
       if (e==NULL) {
          e = eiter;
-         timeleft = e->timer;
-         elapsed = e->elapsed;
+         timeleft = effect_timeLeft( e, &p->effects_clock );
+         elapsed = effect_elapsed( e, &p->effects_clock );
       }
       else if (eiter->data==e->data) {
-         timeleft = MAX( e->timer, eiter->timer );
-         elapsed = MAX( e->elapsed, eiter->elapsed );
+         timeleft = MAX( timeleft, effect_timeLeft( eiter, &p->effects_clock ) );
+         elapsed = MAX( elapsed, effect_elapsed( eiter, &p->effects_clock ) );
       }
    }
 
    /* Render normally. */
    if (e==NULL)
-      pilot_renderFramebufferBase( p, fbo, fw, fh );
+      pilot_renderFramebufferBase( p, fbo, fw, fh, 0., 0. );
    /* Render effect single effect. */
    else {
       mat4 projection, tex_mat;
       const EffectData *ed = e->data;
 
-      /* Render onto framebuffer. */
-      pilot_renderFramebufferBase( p, gl_screen.fbo[2], gl_screen.nw, gl_screen.nh );
+      /* Render onto framebuffer, unless the effect doesn't use the ship. */
+      if (ed->u_tex >= 0)
+         pilot_renderFramebufferBase( p, gl_screen.fbo[2], gl_screen.nw, gl_screen.nh, 0., 0. );
 
       glBindFramebuffer( GL_FRAMEBUFFER, fbo );
 
@@ -1873,7 +2429,7 @@ void pilot_renderFramebuffer( Pilot *p, GLuint fbo, double fw, double fh )
       glUniform1f( ed->u_dir, p->solid.dir );
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
       /* Clear state. */
       glDisableVertexAttribArray( ed->vertex );
@@ -1921,12 +2477,12 @@ void pilot_render( Pilot *p )
 
          if (e==NULL) {
             e = eiter;
-            timeleft = e->timer;
-            elapsed = e->elapsed;
+            timeleft = effect_timeLeft( e, &p->effects_clock );
+            elapsed = effect_elapsed( e, &p->effects_clock );
          }
          else if (eiter->data==e->data) {
-            timeleft = MAX( e->timer, eiter->timer );
-            elapsed = MAX( e->elapsed, eiter->elapsed );
+            timeleft = MAX( timeleft, effect_timeLeft( eiter, &p->effects_clock ) );
+            elapsed = MAX( elapsed, effect_elapsed( eiter, &p->effects_clock ) );
          }
       }
 
@@ -1960,8 +2516,10 @@ void pilot_render( Pilot *p )
          mat4 projection, tex_mat;
          const EffectData *ed = e->data;
 
-         /* Render onto framebuffer. */
-         pilot_renderFramebufferBase( p, gl_screen.fbo[2], gl_screen.nw, gl_screen.nh );
+         /* Render onto framebuffer, unless the effect doesn't use the ship. */
+         if (ed->u_tex >= 0)
+            pilot_renderFramebufferBase( p, gl_screen.fbo[2], gl_screen.nw, gl_screen.nh,
+                  PILOT_EFFECT_EXTENT*w + PILOT_EFFECT_PAD, PILOT_EFFECT_EXTENT*h + PILOT_EFFECT_PAD );
 
          glUseProgram( ed->program );
 
@@ -1987,7 +2545,7 @@ void pilot_render( Pilot *p )
          glUniform1f( ed->u_dir, p->solid.dir );
 
          /* Draw. */
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+         gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
          /* Clear state. */
          glDisableVertexAttribArray( ed->vertex );
@@ -2121,16 +2679,55 @@ void pilot_renderOverlay( Pilot* p )
  */
 void pilot_update( Pilot* pilot, double dt )
 {
-   int cooling, nchg;
-   Pilot *target;
-   double a, px,py, vx,vy, Q;
-   Target wt;
+   PilotUpdate pu;
+   memset( &pu, 0, sizeof(pu) );
+   pu.p  = pilot;
+   pu.dt = dt;
+
+   /* Run all the stages in order on the current thread. */
+   pilot_updateStart( &pu );
+   if (pilot_updateMain( &pu )) {
+      pilot_updateSolid( &pu );
+      pilot_updateEnd( &pu );
+      for (int i=0; i<pu.outfit_ticks; i++) {
+         pilot_outfitLUpdate( pilot, PILOT_OUTFIT_LUA_UPDATE_DT );
+         if (pilot_isFlag( pilot, PILOT_DELETE ))
+            break; /* Same as with the effects, it is theoretically possible for the outfit to remove the pilot. */
+      }
+   }
+
+   array_free( pu.outfit_off );
+}
+
+/**
+ * @brief Starts updating the pilot, handling timers, reloading and heat.
+ *
+ * @note This stage must be thread-safe: it may only modify the pilot being
+ *       updated. Anything else gets stored in the PilotUpdate structure to be
+ *       handled by pilot_updateMain().
+ *
+ *    @param pu Update state of the pilot, with the pilot and delta tick set.
+ */
+static void pilot_updateStart( PilotUpdate *pu )
+{
+   Pilot *pilot = pu->p;
+   double dt, a, Q;
+   int cooling;
 
    /* Modify the dt with speedup. */
-   dt *= pilot->stats.time_speedup;
+   pu->dt *= pilot->stats.time_speedup;
+   dt = pu->dt;
+
+   /* Reset the deferred state. */
+   pu->cooldown_end = 0;
+   pu->nchg       = 0; /* Number of outfits that change state, processed at the end. */
+   pu->lockon     = 0;
+   pu->disabled   = 0;
+   if (pu->outfit_off != NULL)
+      array_erase( &pu->outfit_off, array_begin(pu->outfit_off), array_end(pu->outfit_off) );
 
    /* Check target validity. */
-   target = pilot_weaponTarget( pilot, &wt );
+   pu->target = pilot_weaponTarget( pilot, &pu->wt );
    cooling = pilot_isFlag(pilot, PILOT_COOLDOWN);
 
    /*
@@ -2141,7 +2738,7 @@ void pilot_update( Pilot* pilot, double dt )
    if (cooling) {
       pilot->ctimer   -= dt;
       if (pilot->ctimer < 0.) {
-         pilot_cooldownEnd(pilot, NULL);
+         pu->cooldown_end = 1; /* Runs Lua, so handled in pilot_updateMain. */
          cooling = 0;
       }
    }
@@ -2172,10 +2769,8 @@ void pilot_update( Pilot* pilot, double dt )
          }
       }
    }
-   /* Update heat. */
+   /* Update outfit timers. */
    a = -1.;
-   Q = 0.;
-   nchg = 0; /* Number of outfits that change state, processed at the end. */
    for (int i=0; i<array_size(pilot->outfits); i++) {
       PilotOutfitSlot *o = pilot->outfits[i];
 
@@ -2232,30 +2827,59 @@ void pilot_update( Pilot* pilot, double dt )
          o->stimer -= dt;
          if (o->stimer < 0.) {
             if (o->state == PILOT_OUTFIT_ON) {
-               pilot_outfitOff( pilot, o );
-               nchg++;
+               /* Turning off can run Lua, so handled in pilot_updateMain. */
+               if (pu->outfit_off == NULL)
+                  pu->outfit_off = array_create( int );
+               array_push_back( &pu->outfit_off, i );
+               pu->nchg++;
             }
             else if (o->state == PILOT_OUTFIT_COOLDOWN) {
                o->state  = PILOT_OUTFIT_OFF;
-               nchg++;
+               pu->nchg++;
             }
          }
       }
 
-      /* Handle heat. */
-      if (!cooling)
-         Q  += pilot_heatUpdateSlot( pilot, o, dt );
-
-      /* Handle lockons. */
-      pilot_lockUpdateSlot( pilot, o, target, &wt, &a, dt );
+      /* Handle lockons, the hook is run in pilot_updateMain. */
+      pu->lockon += pilot_lockUpdateSlot( pilot, o, pu->target, &pu->wt, &a, dt );
    }
 
-   /* Global heat. */
-   if (!cooling)
+   /* Update heat. */
+   if (!cooling) {
+      Q = pilot_heatUpdateSlots( pilot, dt );
       pilot_heatUpdateShip( pilot, Q, dt );
+   }
    else
       pilot_heatUpdateCooldown( pilot );
 
+   pu->cooling = cooling;
+}
+
+/**
+ * @brief Main part of the pilot update that can interact with the rest of the game.
+ *
+ * Must be run on the main thread after pilot_updateStart().
+ *
+ *    @param pu Update state of the pilot.
+ *    @return 1 if the pilot should continue to be updated, 0 otherwise.
+ */
+static int pilot_updateMain( PilotUpdate *pu )
+{
+   Pilot *pilot = pu->p;
+   Pilot *target = pu->target;
+   double dt = pu->dt;
+   int cooling = pu->cooling;
+   int efxchg;
+   double a, px,py, vx,vy;
+
+   /* Apply what was deferred from pilot_updateStart(). */
+   if (pu->cooldown_end)
+      pilot_cooldownEnd( pilot, NULL );
+   for (int i=0; i<array_size(pu->outfit_off); i++)
+      pilot_outfitOff( pilot, pilot->outfits[ pu->outfit_off[i] ] );
+   for (int i=0; i<pu->lockon; i++)
+      pilot_runHook( pilot, PILOT_HOOK_LOCKON );
+
    /* Update electronic warfare. */
    pilot_ewUpdateDynamic( pilot, dt );
 
@@ -2292,7 +2916,7 @@ void pilot_update( Pilot* pilot, double dt )
             pilot_setFlag(pilot, PILOT_NONTARGETABLE);
             pilot->itimer = PILOT_PLAYER_NONTARGETABLE_TAKEOFF_DELAY;
          }
-         return;
+         return 0;
       }
    }
    else if (pilot_isFlag(pilot,PILOT_LANDING)) {
@@ -2303,7 +2927,7 @@ void pilot_update( Pilot* pilot, double dt )
          }
          else
             pilot_delete(pilot);
-         return;
+         return 0;
       }
    }
    /* he's dead jim */
@@ -2381,7 +3005,7 @@ void pilot_update( Pilot* pilot, double dt )
             if (pilot->id==PLAYER_ID) /* player.p handled differently */
                player_destroyed();
             pilot_delete(pilot);
-            return;
+            return 0;
          }
       }
    }
@@ -2465,20 +3089,22 @@ void pilot_update( Pilot* pilot, double dt )
       else if (pilot->energy < 0.) {
          pilot->energy = 0.;
          /* Stop all on outfits. */
-         nchg += pilot_outfitOffAll( pilot );
+         pu->nchg += pilot_outfitOffAll( pilot );
          /* Run Lua stuff. */
          pilot_outfitLOutfofenergy( pilot );
       }
    }
 
    /* Update effects. */
-   nchg += effect_update( &pilot->effects, dt );
+   efxchg = effect_update( &pilot->effects, &pilot->effects_clock, dt );
    if (pilot_isFlag( pilot, PILOT_DELETE ))
-      return; /* It's possible for effects to remove the pilot causing future Lua to be unhappy. */
+      return 0; /* It's possible for effects to remove the pilot causing future Lua to be unhappy. */
 
    /* Must recalculate stats because something changed state. */
-   if (nchg > 0)
+   if (pu->nchg > 0)
       pilot_calcStats( pilot );
+   else if (efxchg > 0)
+      pilot_calcStatsEffects( pilot );
 
    /* purpose fallthrough to get the movement like disabled */
    if (pilot_isDisabled(pilot) || cooling) {
@@ -2486,35 +3112,8 @@ void pilot_update( Pilot* pilot, double dt )
       pilot->solid.speed_max = 0.;
       pilot_setAccel( pilot, 0. );
       pilot_setTurn( pilot, 0. );
-
-      /* update the solid */
-      pilot->solid.update( &pilot->solid, dt );
-
-      gl_getSpriteFromDir( &pilot->tsx, &pilot->tsy,
-            pilot->ship->gfx_space, pilot->solid.dir );
-
-      /* Engine glow decay. */
-      if (pilot->engine_glow > 0.) {
-         pilot->engine_glow -= pilot->speed / pilot->accel * dt;
-         if (pilot->engine_glow < 0.)
-            pilot->engine_glow = 0.;
-      }
-
-      /* Update the trail. */
-      pilot_sample_trails( pilot, 0 );
-
-      /* Cooldown still updates outfits. */
-      pilot_shipLUpdate( pilot, dt );
-
-      /* Update outfits if necessary. */
-      pilot->otimer += dt;
-      while (pilot->otimer >= PILOT_OUTFIT_LUA_UPDATE_DT) {
-         pilot_outfitLUpdate( pilot, PILOT_OUTFIT_LUA_UPDATE_DT );
-         if (pilot_isFlag( pilot, PILOT_DELETE ))
-            return; /* Same as with the effects, it is theoretically possible for the outfit to remove the pilot. */
-         pilot->otimer -= PILOT_OUTFIT_LUA_UPDATE_DT;
-      }
-      return;
+      pu->disabled = 1;
+      return 1;
    }
 
    /* Player damage decay. */
@@ -2589,23 +3188,92 @@ void pilot_update( Pilot* pilot, double dt )
          pilot->engine_glow = 0.;
    }
 
+   return 1;
+}
+
+/**
+ * @brief Integrates the solids of many pilots together.
+ *
+ * Done before pilot_updateSolid so the integration does not go through the
+ *  update pointer of each solid.
+ *
+ * @note This stage must be thread-safe: it may only modify the pilots being
+ *       updated.
+ *
+ *    @param pu Update states of the pilots.
+ *    @param n Number of update states.
+ */
+static void pilot_updateSolidBatch( PilotUpdate *pu, int n )
+{
+   Solid *solids[PILOT_SOLID_BATCH];
+   double dts[PILOT_SOLID_BATCH];
+   int ns = 0;
+
+   for (int i=0; i<n; i++) {
+      if (!pu[i].active)
+         continue;
+      solids[ns] = &pu[i].p->solid;
+      dts[ns]    = pu[i].dt;
+      pu[i].integrated = 1;
+      if (++ns >= PILOT_SOLID_BATCH) {
+         solid_updateBatch( solids, dts, 0., ns );
+         ns = 0;
+      }
+   }
+   if (ns > 0)
+      solid_updateBatch( solids, dts, 0., ns );
+}
+
+/**
+ * @brief Integrates the pilot's physics.
+ *
+ * @note This stage must be thread-safe: it may only modify the pilot being
+ *       updated.
+ *
+ *    @param pu Update state of the pilot.
+ */
+static void pilot_updateSolid( PilotUpdate *pu )
+{
+   Pilot *pilot = pu->p;
+   double dt = pu->dt;
+
    /* Update the solid, must be run after limit_speed. */
-   pilot->solid.update( &pilot->solid, dt );
+   if (!pu->integrated)
+      pilot->solid.update( &pilot->solid, dt );
    gl_getSpriteFromDir( &pilot->tsx, &pilot->tsy,
          pilot->ship->gfx_space, pilot->solid.dir );
 
+   /* Engine glow decay. */
+   if (pu->disabled && (pilot->engine_glow > 0.)) {
+      pilot->engine_glow -= pilot->speed / pilot->accel * dt;
+      if (pilot->engine_glow < 0.)
+         pilot->engine_glow = 0.;
+   }
+}
+
+/**
+ * @brief Finishes updating the pilot, running trails and Lua updates.
+ *
+ * Must be run on the main thread after pilot_updateSolid().
+ *
+ *    @param pu Update state of the pilot.
+ */
+static void pilot_updateEnd( PilotUpdate *pu )
+{
+   Pilot *pilot = pu->p;
+   double dt = pu->dt;
+
    /* Update the trail. */
    pilot_sample_trails( pilot, 0 );
 
-   /* Update pilot Lua. */
+   /* Update pilot Lua. Cooldown still updates outfits. */
    pilot_shipLUpdate( pilot, dt );
 
-   /* Update outfits if necessary. */
+   /* Count the outfit updates that are due, the caller runs them. */
+   pu->outfit_ticks = 0;
    pilot->otimer += dt;
    while (pilot->otimer >= PILOT_OUTFIT_LUA_UPDATE_DT) {
-      pilot_outfitLUpdate( pilot, PILOT_OUTFIT_LUA_UPDATE_DT );
-      if (pilot_isFlag( pilot, PILOT_DELETE ))
-         return; /* Same as with the effects, it is theoretically possible for the outfit to remove the pilot. */
+      pu->outfit_ticks++;
       pilot->otimer -= PILOT_OUTFIT_LUA_UPDATE_DT;
    }
 }
@@ -2618,7 +3286,7 @@ void pilot_update( Pilot* pilot, double dt )
  */
 void pilot_sample_trails( Pilot* p, int none )
 {
-   double d2, cx, cy, dircos, dirsin;
+   double cx, cy, z, len, dircos, dirsin;
    TrailMode mode;
 
    /* Ignore for simulation. */
@@ -2629,11 +3297,26 @@ void pilot_sample_trails( Pilot* p, int none )
    if (p->trail == NULL)
       return;
 
-   /* Skip if far away (pretty heuristic-based but seems to work). */
+   /* Skip if the trails can't reach the screen before fading out. */
    cam_getPos( &cx, &cy );
-   d2 = pow2(cx-p->solid.pos.x) + pow2(cy-p->solid.pos.y);
-   if (d2 > pow2( MAX(SCREEN_W,SCREEN_H) / conf.zoom_far * 2. ))
+   z   = MIN( cam_getZoom(), cam_getZoomTarget() );
+   len = 0.;
+   for (int g=0; g<array_size(p->ship->trail_emitters); g++)
+      len = MAX( len, p->ship->trail_emitters[g].trail_spec->ttl );
+   len = len * VMOD(p->solid.vel) + PILOT_TRAIL_MARGIN;
+   if ((fabs(cx-p->solid.pos.x) > SCREEN_W / (2.*z) + len) ||
+         (fabs(cy-p->solid.pos.y) > SCREEN_H / (2.*z) + len)) {
+      pilot_setFlag( p, PILOT_TRAILS_CULLED );
       return;
+   }
+
+   /* Coming back on screen, break the trails so they don't jump to the
+    * current position. */
+   if (pilot_isFlag( p, PILOT_TRAILS_CULLED )) {
+      pilot_rmFlag( p, PILOT_TRAILS_CULLED );
+      if (!none)
+         pilot_sample_trails( p, 1 );
+   }
 
    dircos = cos(p->solid.dir);
    dirsin = sin(p->solid.dir);
@@ -3082,6 +3765,7 @@ static void pilot_init( Pilot* pilot, const Ship* ship, const char* name, int fa
 
    /* Basic information. */
    pilot->ship = ship;
+   ship_gfxLoad( ship );
    pilot->name = strdup( (name==NULL) ? _(ship->name) : name );
 
    /* faction */
@@ -3268,7 +3952,7 @@ Pilot *pilot_create( const Ship* ship, const char* name, int faction, const char
       const PilotFlags flags, unsigned int dockpilot, int dockslot )
 {
    /* Allocate pilot memory. */
-   Pilot *p = nmalloc(sizeof(Pilot));
+   Pilot *p = mempool_alloc( &pilot_pool );
    if (p == NULL) {
       WARN(_("Unable to allocate memory"));
       return 0;
@@ -3278,6 +3962,7 @@ Pilot *pilot_create( const Ship* ship, const char* name, int faction, const char
 
    /* Set the pilot in the stack -- must be there before initializing */
    array_push_back( &pilot_stack, p );
+   pilot_stackGen++;
 
    /* Initialize the pilot. */
    pilot_init( p, ship, name, faction, dir, pos, vel, flags, dockpilot, dockslot );
@@ -3286,9 +3971,13 @@ Pilot *pilot_create( const Ship* ship, const char* name, int faction, const char
    if (pilot_isFlagRaw(flags, PILOT_PLAYER)) { /* Set player ID. TODO should probably be fixed to something better someday. */
       p->id = PLAYER_ID;
       qsort( pilot_stack, array_size(pilot_stack), sizeof(Pilot*), pilot_cmp );
+      pilot_statesValid = 0;
    }
-   else
+   else {
       p->id = ++pilot_id; /* new unique pilot id based on pilot_id, can't be 0 */
+      pilot_statePush( p );
+   }
+   pilot_slotInsert( p );
 
    /* Initialize AI if applicable. */
    if (ai == NULL)
@@ -3323,7 +4012,7 @@ Pilot *pilot_create( const Ship* ship, const char* name, int faction, const char
 Pilot* pilot_createEmpty( const Ship* ship, const char* name,
       int faction, PilotFlags flags )
 {
-   Pilot *dyn = nmalloc(sizeof(Pilot));
+   Pilot *dyn = mempool_alloc( &pilot_pool );
    if (dyn == NULL) {
       WARN(_("Unable to allocate memory"));
       return 0;
@@ -3347,7 +4036,7 @@ unsigned int pilot_clone( const Pilot *ref )
    pilot_setFlagRaw( pf, PILOT_NO_OUTFITS );
 
    /* Allocate pilot memory. */
-   dyn = nmalloc(sizeof(Pilot));
+   dyn = mempool_alloc( &pilot_pool );
    if (dyn == NULL) {
       WARN(_("Unable to allocate memory"));
       return 0;
@@ -3356,6 +4045,7 @@ unsigned int pilot_clone( const Pilot *ref )
    /* Set the pilot in the stack -- must be there before initializing */
    p = &array_grow( &pilot_stack );
    *p = dyn;
+   pilot_stackGen++;
 
    /* Initialize the pilot. */
    pilot_init( dyn, ref->ship, ref->name, ref->faction,
@@ -3383,6 +4073,9 @@ unsigned int pilot_addStack( Pilot *p )
    pilot_setFlag( p, PILOT_NOFREE );
 
    array_push_back( &pilot_stack, p );
+   pilot_stackGen++;
+   pilot_statePush( p );
+   pilot_slotInsert( p );
 
    /* Have to reset after adding to stack, as some Lua functions will run code on the pilot. */
    pilot_reset( p );
@@ -3432,6 +4125,10 @@ Pilot* pilot_setPlayer( Pilot* after )
    }
    after->id = PLAYER_ID;
    qsort( pilot_stack, array_size(pilot_stack), sizeof(Pilot*), pilot_cmp );
+   pilot_stackGen++;
+   pilot_spatialCount = -1; /* Stack indices changed. */
+   pilot_statesValid = 0;
+   pilot_slotRebuild();
 
    /* Set up stuff. */
    player.p = after;
@@ -3606,6 +4303,7 @@ void pilot_free( Pilot *p )
    /* Clean up stats. */
    ss_free( p->ship_stats );
    ss_free( p->intrinsic_stats );
+   array_free( p->dtype_mods );
 
    lvar_freeArray( p->shipvar );
 
@@ -3644,7 +4342,7 @@ void pilot_free( Pilot *p )
    memset( p, 0, sizeof(Pilot) );
 #endif /* DEBUGGING */
 
-   nfree(p);
+   mempool_free( &pilot_pool, p );
 
    NTracingZoneEnd( _ctx );
 }
@@ -3657,8 +4355,12 @@ void pilot_free( Pilot *p )
 static void pilot_erase( Pilot *p )
 {
    int i = pilot_getStackPos( p->id );
+   pilot_slotRemove( p );
    pilot_free(p);
+   pilot_stateErase( i );
    array_erase( &pilot_stack, &pilot_stack[i], &pilot_stack[i+1] );
+   pilot_stackGen++;
+   pilot_spatialCount = -1; /* Stack indices changed. */
 }
 
 /**
@@ -3671,8 +4373,12 @@ void pilot_stackRemove( Pilot *p )
    if (i < 0)
       WARN(_("Trying to remove non-existent pilot '%s' from stack!"), p->name);
 #endif /* DEBUGGING */
+   pilot_slotRemove( p );
    p->id = 0;
+   pilot_stateErase( i );
    array_erase( &pilot_stack, &pilot_stack[i], &pilot_stack[i+1] );
+   pilot_stackGen++;
+   pilot_spatialCount = -1; /* Stack indices changed. */
 }
 
 /**
@@ -3681,7 +4387,13 @@ void pilot_stackRemove( Pilot *p )
 void pilots_init (void)
 {
    pilot_stack = array_create_size( Pilot*, PILOT_SIZE_MIN );
+   pilot_updates = array_create_size( PilotUpdate, PILOT_SIZE_MIN );
+   pilot_updateChunks = array_create( PilotUpdateChunk );
+   pilot_qtElems = array_create( PilotQtElem );
+   pilot_states = array_create_size( PilotState, PILOT_SIZE_MIN );
+   pilot_slotRebuild();
    il_create( &pilot_qtquery, 1 );
+   il_create( &pilot_nearquery, 1 );
 }
 
 /**
@@ -3690,6 +4402,8 @@ void pilots_init (void)
 void pilots_free (void)
 {
    pilot_freeGlobalHooks();
+   escorts_clearQueued();
+   escorts_free();
 
    /* First pass to stop outfits. */
    for (int i=0; i < array_size(pilot_stack); i++) {
@@ -3706,13 +4420,50 @@ void pilots_free (void)
       pilot_free(pilot_stack[i]);
    array_free(pilot_stack);
    pilot_stack = NULL;
-   player.p = NULL;
-   free( player.ps.acquired );
-   memset( &player.ps, 0, sizeof(PlayerShip_t) );
+   /* Player ships live in the pool too, must go before destroying it. */
+   player_freeShips();
+   mempool_destroy( &pilot_pool );
+
+   /* Clean up update stages. */
+   for (int i=0; i<array_size(pilot_updates); i++)
+      array_free( pilot_updates[i].outfit_off );
+   array_free( pilot_updates );
+   pilot_updates = NULL;
+   array_free( pilot_updateChunks );
+   pilot_updateChunks = NULL;
+   pilot_outfitLFree();
+   if (pilot_updateQueue != NULL) {
+      vpool_cleanup( pilot_updateQueue );
+      pilot_updateQueue = NULL;
+   }
 
    /* Clean up quadtree. */
    qt_destroy( &pilot_quadtree );
+   if (sg_init)
+      sg_destroy( &pilot_grid );
+   sg_init = 0;
    il_destroy( &pilot_qtquery );
+   il_destroy( &pilot_nearquery );
+   array_free( pilot_visible );
+   pilot_visible = NULL;
+   pilot_stackGen++;
+   array_free( pilot_interpSaved );
+   pilot_interpSaved = NULL;
+   array_free( pilot_qtElems );
+   pilot_qtElems = NULL;
+
+   /* Clean up compact state. */
+   array_free( pilot_states );
+   pilot_states = NULL;
+   pilot_statesValid = 0;
+   free( pilot_slots );
+   pilot_slots = NULL;
+   pilot_slotMask = 0;
+   pilot_epochCur++;
+   array_free( pilot_thinkList );
+   pilot_thinkList = NULL;
+   array_free( pilot_updateList );
+   pilot_updateList = NULL;
 }
 
 /**
@@ -3725,6 +4476,9 @@ void pilots_clean( int persist )
    int persist_count = 0;
    NTracingZone( _ctx, 1 );
 
+   /* Queued fighters go back to their bays. */
+   escorts_clearQueued();
+
    /* First pass to stop outfits without clearing stuff - this can call all
     * sorts of Lua stuff. */
    for (int i=0; i<array_size(pilot_stack); i++) {
@@ -3764,6 +4518,10 @@ void pilots_clean( int persist )
          pilot_free(pilot_stack[i]);
    }
    array_erase( &pilot_stack, &pilot_stack[persist_count], array_end(pilot_stack) );
+   pilot_stackGen++;
+   pilot_spatialCount = -1; /* Stack indices changed. */
+   pilot_statesValid = 0;
+   pilot_slotRebuild();
 
    /* Init AI on the remaining pilots, has to be done here so the pilot_stack is consistent. */
    for (int i=0; i<array_size(pilot_stack); i++) {
@@ -3796,6 +4554,14 @@ void pilots_newSystem (void)
       qt_destroy( &pilot_quadtree );
    qt_create( &pilot_quadtree, -r, -r, r, r, qt_max_elem, qt_depth );
    qt_init = 1;
+   array_resize( &pilot_qtElems, 0 );
+
+   if (sg_init)
+      sg_destroy( &pilot_grid );
+   sg_create( &pilot_grid, sg_cell_size, sg_buckets );
+   sg_init = 1;
+   pilot_spatial = pilot_spatialNext;
+   pilot_spatialCount = -1; /* Empty until the next purge. */
 
    NTracingZoneEnd( _ctx );
 }
@@ -3823,6 +4589,10 @@ void pilots_cleanAll (void)
       memset( &player.ps, 0, sizeof(PlayerShip_t) );
    }
    array_erase( &pilot_stack, array_begin(pilot_stack), array_end(pilot_stack) );
+   pilot_stackGen++;
+   pilot_spatialCount = -1;
+   pilot_statesValid = 0;
+   pilot_slotRebuild();
 }
 
 /**
@@ -3830,6 +4600,8 @@ void pilots_cleanAll (void)
  */
 void pilots_updatePurge (void)
 {
+   int removed;
+
    NTracingZone( _ctx, 1 );
 
    /* Delete loop - this should be atomic or we get hook fuckery! */
@@ -3844,11 +4616,21 @@ void pilots_updatePurge (void)
          pilot_erase( p );
    }
 
-   /* Second loop sets up quadtrees. */
-   qt_clear( &pilot_quadtree ); /* Empty it. */
+   /* Second loop updates the spatial index. The quadtree only relinks pilots
+    * that moved across leaves, and its elements are identified by pilot ID
+    * since the stack can be rearranged. The grid is just rebuilt. */
+   if (pilot_spatial == PILOT_SPATIAL_GRID)
+      sg_clear( &pilot_grid );
+   array_resize( &pilot_states, array_size(pilot_stack) );
+   pilot_statesValid = 1;
    for (int i=0; i<array_size(pilot_stack); i++) {
       Pilot *p = pilot_stack[i];
       int x, y, w2, h2, px, py;
+      int x1, y1, x2, y2;
+
+      /* Refresh the compact state. */
+      pilot_states[i].id    = p->id;
+      pilot_states[i].state = pilot_stateGet( p );
 
       /* Ignore pilots being deleted. */
       if (pilot_isFlag(p, PILOT_DELETE))
@@ -3864,88 +4646,407 @@ void pilots_updatePurge (void)
       py = round(p->solid.pre.y);
       w2 = ceil(p->ship->gfx_space->sw * 0.5);
       h2 = ceil(p->ship->gfx_space->sh * 0.5);
-      qt_insert( &pilot_quadtree, i, MIN(x,px)-w2, MIN(y,py)-h2, MAX(x,px)+w2, MAX(y,py)+h2 );
+      x1 = MIN(x,px)-w2;
+      y1 = MIN(y,py)-h2;
+      x2 = MAX(x,px)+w2;
+      y2 = MAX(y,py)+h2;
+      if (pilot_spatial == PILOT_SPATIAL_GRID) {
+         sg_insert( &pilot_grid, i, x1, y1, x2, y2 );
+         continue;
+      }
+      if ((p->qt_elem >= 0) && (p->qt_elem < array_size(pilot_qtElems)) &&
+            (pilot_qtElems[p->qt_elem].id == p->id)) {
+         qt_move( &pilot_quadtree, p->qt_elem, x1, y1, x2, y2 );
+         qt_set_id( &pilot_quadtree, p->qt_elem, i );
+      }
+      else {
+         p->qt_elem = qt_insert( &pilot_quadtree, i, x1, y1, x2, y2 );
+         while (array_size(pilot_qtElems) <= p->qt_elem) {
+            PilotQtElem *pe = &array_grow( &pilot_qtElems );
+            pe->id   = 0;
+            pe->seen = 0;
+         }
+         pilot_qtElems[p->qt_elem].id = p->id;
+      }
+      pilot_qtElems[p->qt_elem].seen = 1;
+   }
+
+   /* Remove the elements of pilots that are gone or hidden. */
+   removed = 0;
+   for (int i=0; i<array_size(pilot_qtElems); i++) {
+      PilotQtElem *pe = &pilot_qtElems[i];
+      if ((pe->id != 0) && !pe->seen) {
+         qt_remove( &pilot_quadtree, i );
+         pe->id = 0;
+         removed = 1;
+      }
+      pe->seen = 0;
    }
+   if (removed)
+      qt_cleanup( &pilot_quadtree );
+   pilot_spatialCount = array_size(pilot_stack);
+   NTracingPlotI( "pilot_qt_nodes", il_size( &pilot_quadtree.nodes ) );
+   NTracingPlotI( "pilot_qt_elems", il_size( &pilot_quadtree.enodes ) );
+
+   /* Give the pilots that collided in the ID table another chance. */
+   if (pilot_slotOverflow > 0)
+      pilot_slotRebuild();
+
+   /* Bound for the stealth detection queries. */
+   pilots_ewUpdateDetect( pilot_stack );
+
+   /* Alerts need the updated spatial index. */
+   asteroids_alertFlush();
 
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Gets how many frames apart a pilot has to think.
+ *
+ * Only the escorts and fleet ships of the player are concerned, which tend
+ *  to be many and spend most of their time following the player around. They
+ *  think at the full rate as soon as they are in combat or close to the
+ *  camera, so what the player sees and fights with is not affected.
+ *
+ *    @param p Pilot to check.
+ *    @return Number of frames between two thinks, 1 for every frame.
+ */
+static int pilot_thinkLOD( const Pilot *p )
+{
+   double x, y, d2;
+
+   if (!pilot_isFlag(p, PILOT_PLAYER_FLEET) && (p->parent != PLAYER_ID))
+      return 1;
+   if (pilot_isFlag(p, PILOT_COMBAT) || pilot_isFlag(p, PILOT_MANUAL_CONTROL))
+      return 1;
+
+   cam_getPos( &x, &y );
+   d2 = pow2(p->solid.pos.x-x) + pow2(p->solid.pos.y-y);
+   if (d2 < pow2(PILOT_LOD_RANGE))
+      return 1;
+   else if (d2 < pow2(2.*PILOT_LOD_RANGE))
+      return PILOT_LOD_FRAMES/2;
+   return PILOT_LOD_FRAMES;
+}
+
+/**
+ * @brief Has a pilot think.
+ *
+ *    @param p Pilot to think.
+ *    @param dt Delta tick for the update.
+ */
+static void pilot_think( Pilot *p, double dt )
+{
+   /* Invisible, not doing anything. */
+   if (pilot_isFlag(p, PILOT_HIDE))
+      return;
+
+   /* See if should think. */
+   if (pilot_isDisabled(p))
+      return;
+   if (pilot_isFlag(p,PILOT_DEAD))
+      return;
+
+   /* Ignore persisting pilots during simulation since they don't get cleared. */
+   if (space_isSimulation() && (pilot_isFlag(p,PILOT_PERSIST)))
+      return;
+
+   /* Hyperspace gets special treatment */
+   if (pilot_isFlag(p, PILOT_HYP_PREP)) {
+      if (!pilot_isFlag(p, PILOT_HYPERSPACE))
+         ai_think( p, dt, 0 );
+      pilot_hyperspace(p, dt);
+   }
+   /* Entering hyperspace. */
+   else if (pilot_isFlag(p, PILOT_HYP_END)) {
+      if ((VMOD(p->solid.vel) < 2*solid_maxspeed( &p->solid, p->speed, p->accel) ) && (p->ptimer < 0.))
+         pilot_rmFlag(p, PILOT_HYP_END);
+   }
+   /* Must not be boarding to think. */
+   else if (!pilot_isFlag(p, PILOT_BOARDING) &&
+         !pilot_isFlag(p, PILOT_REFUELBOARDING) &&
+         /* Must not be landing nor taking off. */
+         !pilot_isFlag(p, PILOT_LANDING) &&
+         !pilot_isFlag(p, PILOT_TAKEOFF) &&
+         /* Must not be jumping in. */
+         !pilot_isFlag(p, PILOT_HYP_END)) {
+      if (pilot_isFlag(p, PILOT_PLAYER))
+         player_think( p, dt );
+      else {
+         /* Far escorts think every few frames, staggered by ID, with the time
+          * they skipped. Steering from their last think is kept meanwhile. */
+         int lod = pilot_thinkLOD( p );
+         if ((lod > 1) && ((pilot_lodFrame + p->id) % lod != 0)) {
+            p->think_dt += dt;
+            return;
+         }
+         ai_think( p, dt + p->think_dt, 1 );
+         p->think_dt = 0.;
+      }
+   }
+}
+
 /**
  * @brief Updates all the pilots.
  *
+ * The pilots to think and update are picked from the compact states, so the
+ *  ones that are hidden, dead or being deleted are skipped without touching
+ *  them.
+ *
  *    @param dt Delta tick for the update.
  */
 void pilots_update( double dt )
 {
+   int n, nthink, nupdate;
+   unsigned int skip;
+   Uint64 mark;
+
    NTracingZone( _ctx, 1 );
    NTracingPlotI( "pilots", array_size(pilot_stack) );
+   memstats_set( MEMTAG_PILOTS, mempool_memory( &pilot_pool ) );
+
+   /* Launch the fighters queued by the bays. */
+   escorts_spawnQueued();
+
+   /* Have all the pilots think. Pilots added while thinking think too. */
+   mark = frametime_mark();
+   pilot_lodFrame++;
+   ai_thinkBudgetStart();
+   skip = PILOT_STATE_HIDE | PILOT_STATE_NOTHINK;
+   if (space_isSimulation())
+      skip |= PILOT_STATE_PERSIST;
+   nthink = array_size(pilot_stack);
+   n = pilots_stateFilter( &pilot_thinkList, skip );
+   for (int i=0; i<n; i++) {
+      int k = pilot_thinkList[i];
+      if (k < array_size(pilot_stack))
+         pilot_think( pilot_stack[k], dt );
+   }
+   for (int i=nthink; i<array_size(pilot_stack); i++)
+      pilot_think( pilot_stack[i], dt );
+   ai_thinkFlush(); /* Apply what they decided now that everyone has thought. */
+   ai_thinkBudgetEnd();
+   frametime_add( FRAME_UPDATE_AI, &mark );
+
+   /* Now update all the pilots. The player gets updated normally, while the
+    * rest get their update split into stages, where the thread-safe ones can
+    * run in parallel. Pilots are stored in the update state as Lua may add new
+    * pilots to the stack while updating. */
+   nupdate = pilots_stateFilter( &pilot_updateList, PILOT_STATE_HIDE | PILOT_STATE_DELETE );
+   n = 0;
+   for (int j=0; j<nupdate; j++) {
+      Pilot *p = pilot_stack[ pilot_updateList[j] ];
+      PilotUpdate *pu;
 
-   /* Have all the pilots think. */
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      Pilot *p = pilot_stack[i];
+      /* Ignore. */
+      if (pilot_isFlag(p, PILOT_DELETE))
+         continue;
 
       /* Invisible, not doing anything. */
       if (pilot_isFlag(p, PILOT_HIDE))
          continue;
 
-      /* See if should think. */
-      if (pilot_isDisabled(p))
-         continue;
-      if (pilot_isFlag(p,PILOT_DEAD))
-         continue;
+      if (n >= array_size(pilot_updates))
+         memset( &array_grow( &pilot_updates ), 0, sizeof(PilotUpdate) );
+      pu = &pilot_updates[ n++ ];
+      pu->p  = p;
+      pu->dt = dt;
+      pu->active = !pilot_isFlag( p, PILOT_PLAYER );
+      pu->integrated = 0;
+   }
 
-      /* Ignore persisting pilots during simulation since they don't get cleared. */
-      if (space_isSimulation() && (pilot_isFlag(p,PILOT_PERSIST)))
-         continue;
+   /* Timers, reloading and heat. */
+   pilots_updateStage( NULL, pilot_updateStart, n );
 
-      /* Hyperspace gets special treatment */
-      if (pilot_isFlag(p, PILOT_HYP_PREP)) {
-         if (!pilot_isFlag(p, PILOT_HYPERSPACE))
-            ai_think( p, dt, 0 );
-         pilot_hyperspace(p, dt);
-      }
-      /* Entering hyperspace. */
-      else if (pilot_isFlag(p, PILOT_HYP_END)) {
-         if ((VMOD(p->solid.vel) < 2*solid_maxspeed( &p->solid, p->speed, p->accel) ) && (p->ptimer < 0.))
-            pilot_rmFlag(p, PILOT_HYP_END);
+   /* Everything that can interact with the rest of the game. */
+   for (int i=0; i<n; i++) {
+      PilotUpdate *pu = &pilot_updates[i];
+      Pilot *p = pu->p;
+
+      /* Could have been removed, we don't remove the player. */
+      if (pilot_isFlag(p, PILOT_DELETE)) {
+         pu->active = 0;
+         continue;
       }
-      /* Must not be boarding to think. */
-      else if (!pilot_isFlag(p, PILOT_BOARDING) &&
-            !pilot_isFlag(p, PILOT_REFUELBOARDING) &&
-            /* Must not be landing nor taking off. */
-            !pilot_isFlag(p, PILOT_LANDING) &&
-            !pilot_isFlag(p, PILOT_TAKEOFF) &&
-            /* Must not be jumping in. */
-            !pilot_isFlag(p, PILOT_HYP_END)) {
-         if (pilot_isFlag(p, PILOT_PLAYER))
-            player_think( p, dt );
-         else
-            ai_think( p, dt, 1 );
+
+      /* The player does all the stages normally. */
+      if (pilot_isFlag( p, PILOT_PLAYER )) {
+         player_update( p, dt );
+         continue;
       }
+
+      pu->active = pilot_updateMain( pu );
    }
 
-   /* Now update all the pilots. */
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      Pilot *p = pilot_stack[i];
+   /* Physics. */
+   pilots_updateStage( pilot_updateSolidBatch, pilot_updateSolid, n );
 
-      /* Ignore. */
-      if (pilot_isFlag(p, PILOT_DELETE))
+   /* Trails and Lua. */
+   for (int i=0; i<n; i++) {
+      PilotUpdate *pu = &pilot_updates[i];
+      if (!pu->active || pilot_isFlag(pu->p, PILOT_DELETE))
          continue;
+      pilot_updateEnd( pu );
+      if (!pilot_isFlag(pu->p, PILOT_DELETE))
+         pilot_outfitLUpdateQueue( pu->p, pu->outfit_ticks );
+   }
 
-      /* Invisible, not doing anything. */
-      if (pilot_isFlag(p, PILOT_HIDE))
+   /* Lua outfits, batched by outfit. */
+   pilot_outfitLUpdateRun( PILOT_OUTFIT_LUA_UPDATE_DT );
+
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Runs a thread-safe update stage on a chunk of the pilot updates.
+ *
+ *    @param data PilotUpdateChunk to process.
+ *    @return 0 always.
+ */
+static int pilots_updateStageThread( void *data )
+{
+   const PilotUpdateChunk *chunk = data;
+   if (chunk->batch != NULL)
+      chunk->batch( &pilot_updates[chunk->start], chunk->end - chunk->start );
+   for (int i=chunk->start; i<chunk->end; i++) {
+      PilotUpdate *pu = &pilot_updates[i];
+      if (!pu->active)
          continue;
+      chunk->stage( pu );
+   }
+   return 0;
+}
 
-      /* Just update the pilot. */
-      if (pilot_isFlag( p, PILOT_PLAYER ))
-         player_update( p, dt );
-      else
-         pilot_update( p, dt );
+/**
+ * @brief Runs a thread-safe update stage on all the pilot updates.
+ *
+ * The updates are partitioned into contiguous chunks, one per thread, so that
+ *  each pilot is only ever touched by a single thread. With few pilots it is
+ *  not worth it and everything is run on the current thread.
+ *
+ *    @param batch Run on each chunk as a whole before the stage, may be NULL.
+ *    @param stage Stage to run.
+ *    @param n Number of pilot updates to process.
+ */
+static void pilots_updateStage( void (*batch)( PilotUpdate *pu, int n ), void (*stage)( PilotUpdate *pu ), int n )
+{
+   int nchunks, size;
+
+   /* Not worth the threading overhead. */
+   nchunks = MIN( threadpool_threads(), n / PILOT_UPDATE_CHUNK_MIN );
+   if ((n < PILOT_UPDATE_THREADED_MIN) || (nchunks <= 1)) {
+      const PilotUpdateChunk chunk = { .batch = batch, .stage = stage, .start = 0, .end = n };
+      pilots_updateStageThread( (void*)&chunk );
+      return;
+   }
+
+   if (pilot_updateQueue == NULL)
+      pilot_updateQueue = vpool_create();
+   array_resize( &pilot_updateChunks, nchunks );
+   size = (n + nchunks - 1) / nchunks;
+   for (int i=0; i<nchunks; i++) {
+      PilotUpdateChunk *chunk = &pilot_updateChunks[i];
+      chunk->batch = batch;
+      chunk->stage = stage;
+      chunk->start = i * size;
+      chunk->end   = MIN( n, (i+1) * size );
+      vpool_enqueue( pilot_updateQueue, pilots_updateStageThread, chunk );
+   }
+   vpool_wait( pilot_updateQueue );
+}
+
+/**
+ * @brief Compares two stack indices.
+ */
+static int pilot_cmpIndex( const void *ptr1, const void *ptr2 )
+{
+   return *(const int*)ptr1 - *(const int*)ptr2;
+}
+
+/**
+ * @brief Finds the pilots near the screen for this frame.
+ *
+ * Queries the spatial index with the camera view, so pilots_render and
+ *  pilots_renderOverlay only go over pilots that can be seen. Their trails
+ *  are marked so the rest get drawn with the other trails.
+ */
+void pilots_cull (void)
+{
+   int n = array_size(pilot_stack);
+
+   NTracingZone( _ctx, 1 );
+
+   spfx_trail_cull();
+   if (pilot_visible == NULL)
+      pilot_visible = array_create( int );
+   array_resize( &pilot_visible, 0 );
+   pilot_visibleGen = pilot_stackGen;
+
+   if ((pilot_spatialCount < 0) || (pilot_spatialCount > n)) {
+      for (int i=0; i<n; i++)
+         array_push_back( &pilot_visible, i );
+   }
+   else {
+      double x1, y1, x2, y2;
+      int m;
+
+      /* Pilots moved since the index was updated, hence the extra margin. */
+      cam_getViewRect( &x1, &y1, &x2, &y2, PILOT_CULL_MARGIN );
+      pilot_collideQueryIL( &pilot_qtquery,
+            floor(x1-PILOT_NEAREST_MARGIN), floor(y1-PILOT_NEAREST_MARGIN),
+            ceil(x2+PILOT_NEAREST_MARGIN), ceil(y2+PILOT_NEAREST_MARGIN) );
+      for (int i=0; i<il_size(&pilot_qtquery); i++)
+         array_push_back( &pilot_visible, il_get( &pilot_qtquery, i, 0 ) );
+      for (int i=pilot_spatialCount; i<n; i++)
+         array_push_back( &pilot_visible, i );
+
+      /* Render in stack order, without duplicates. */
+      qsort( pilot_visible, array_size(pilot_visible), sizeof(int), pilot_cmpIndex );
+      m = 0;
+      for (int i=0; i<array_size(pilot_visible); i++) {
+         if ((m > 0) && (pilot_visible[m-1] == pilot_visible[i]))
+            continue;
+         pilot_visible[m++] = pilot_visible[i];
+      }
+      array_resize( &pilot_visible, m );
+   }
+
+   for (int i=0; i<array_size(pilot_visible); i++) {
+      const Pilot *p = pilot_stack[ pilot_visible[i] ];
+      for (int j=0; j<array_size(p->trail); j++)
+         spfx_trail_show( p->trail[j] );
    }
+   /* The player is drawn separately, wherever the camera is. */
+   if (player.p != NULL)
+      for (int j=0; j<array_size(player.p->trail); j++)
+         spfx_trail_show( player.p->trail[j] );
 
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Makes sure the visible pilots are still valid.
+ *
+ * Hooks can change the stack between the visibility pass and rendering, in
+ *  which case all the pilots are used.
+ *
+ *    @return Number of visible pilots.
+ */
+static int pilots_visible (void)
+{
+   if ((pilot_visible == NULL) || (pilot_visibleGen != pilot_stackGen)) {
+      int n = array_size(pilot_stack);
+      if (pilot_visible == NULL)
+         pilot_visible = array_create( int );
+      array_resize( &pilot_visible, n );
+      for (int i=0; i<n; i++)
+         pilot_visible[i] = i;
+      pilot_visibleGen = pilot_stackGen;
+   }
+   return array_size(pilot_visible);
+}
+
 /**
  * @brief Renders all the pilots.
  */
@@ -3953,8 +5054,14 @@ void pilots_render (void)
 {
    NTracingZone( _ctx, 1 );
 
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      Pilot *p = pilot_stack[i];
+   for (int i=0, n=pilots_visible(); i<n; i++) {
+      int k = pilot_visible[i];
+      Pilot *p;
+
+      /* Skip without touching the pilot when the compact state allows it. */
+      if (pilot_stateSkip( k, PILOT_STATE_HIDE | PILOT_STATE_DELETE | PILOT_STATE_PLAYER ))
+         continue;
+      p = pilot_stack[k];
 
       /* Invisible, not doing anything. */
       if (pilot_isFlag(p, PILOT_HIDE) || pilot_isFlag(p, PILOT_DELETE))
@@ -3967,6 +5074,45 @@ void pilots_render (void)
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Stores the positions of the pilots before a fixed update.
+ */
+void pilots_interpStore (void)
+{
+   for (int i=0; i<array_size(pilot_stack); i++)
+      pilot_stack[i]->solid.interp = pilot_stack[i]->solid.pos;
+}
+
+/**
+ * @brief Moves the pilots to where they are rendered between fixed updates.
+ *
+ * Has to be followed by pilots_interpEnd once done rendering.
+ *
+ *    @param alpha Fraction of a fixed update left over after the last one.
+ *    @param step Game time of the last fixed update.
+ */
+void pilots_interpBegin( double alpha, double step )
+{
+   if (pilot_interpSaved == NULL)
+      pilot_interpSaved = array_create( vec2 );
+   array_resize( &pilot_interpSaved, array_size(pilot_stack) );
+   for (int i=0; i<array_size(pilot_stack); i++)
+      pilot_interpSaved[i] = solid_interpolate( &pilot_stack[i]->solid, alpha, step );
+}
+
+/**
+ * @brief Puts the pilots back where they really are after rendering.
+ *
+ * Pilots added while rendering go at the end of the stack and were never
+ *  moved.
+ */
+void pilots_interpEnd (void)
+{
+   int n = MIN( array_size(pilot_interpSaved), array_size(pilot_stack) );
+   for (int i=0; i<n; i++)
+      pilot_stack[i]->solid.pos = pilot_interpSaved[i];
+}
+
 /**
  * @brief Renders all the pilots overlays.
  */
@@ -3974,8 +5120,14 @@ void pilots_renderOverlay (void)
 {
    NTracingZone( _ctx, 1 );
 
-   for (int i=0; i<array_size(pilot_stack); i++) {
-      Pilot *p = pilot_stack[i];
+   for (int i=0, n=pilots_visible(); i<n; i++) {
+      int k = pilot_visible[i];
+      Pilot *p;
+
+      /* Skip without touching the pilot when the compact state allows it. */
+      if (pilot_stateSkip( k, PILOT_STATE_HIDE | PILOT_STATE_DELETE | PILOT_STATE_PLAYER ))
+         continue;
+      p = pilot_stack[k];
 
       /* Invisible, not doing anything. */
       if (pilot_isFlag(p, PILOT_HIDE) || pilot_isFlag(p, PILOT_DELETE))
@@ -4002,6 +5154,7 @@ void pilot_clearTimers( Pilot *pilot )
 
    pilot->ptimer     = 0.; /* Pilot timer. */
    pilot->tcontrol   = 0.; /* AI control timer. */
+   pilot->think_dt   = 0.; /* Skipped think time. */
    pilot->stimer     = 0.; /* Shield timer. */
    pilot->dtimer     = 0.; /* Disable timer. */
    pilot->otimer     = 0.; /* Outfit timer. */
@@ -4170,6 +5323,25 @@ credits_t pilot_worth( const Pilot *p, int count_unique )
  */
 void pilot_msg( const Pilot *p, const Pilot *receiver, const char *type, unsigned int idx )
 {
+   pilot_msgGroup( p, &receiver, 1, type, idx );
+}
+
+/**
+ * @brief Sends the same message to many pilots.
+ *
+ * The message is only created once and shared by all the receivers.
+ *
+ *    @param p Pilot sending message.
+ *    @param receivers Pilots receiving the message.
+ *    @param n Number of receivers.
+ *    @param type Type of message.
+ *    @param idx Index of data on Lua stack or 0
+ */
+void pilot_msgGroup( const Pilot *p, const Pilot *const *receivers, int n, const char *type, unsigned int idx )
+{
+   if (n <= 0)
+      return;
+
    if (idx != 0)
       lua_pushvalue(naevL, idx);    /* data */
    else
@@ -4188,10 +5360,13 @@ void pilot_msg( const Pilot *p, const Pilot *receiver, const char *type, unsigne
    lua_pushvalue(naevL, -2);        /* data, msg, data */
    lua_rawseti(naevL, -2, 3);       /* data, msg */
 
-   lua_rawgeti(naevL, LUA_REGISTRYINDEX, receiver->messages); /* data, msg, messages */
-   lua_pushvalue(naevL, -2);        /* data, msg, messages, msg */
-   lua_rawseti(naevL, -2, lua_objlen(naevL, -2)+1); /* data, msg, messages */
-   lua_pop(naevL, 3); /*  */
+   for (int i=0; i<n; i++) {
+      lua_rawgeti(naevL, LUA_REGISTRYINDEX, receivers[i]->messages); /* data, msg, messages */
+      lua_pushvalue(naevL, -2);     /* data, msg, messages, msg */
+      lua_rawseti(naevL, -2, lua_objlen(naevL, -2)+1); /* data, msg, messages */
+      lua_pop(naevL, 1);            /* data, msg */
+   }
+   lua_pop(naevL, 2); /*  */
 }
 
 /**
@@ -4230,3 +5405,18 @@ void pilot_quadtreeParams( int max_elem, int depth )
    qt_max_elem = max_elem;
    qt_depth = depth;
 }
+
+/**
+ * @brief Sets the spatial index used for pilot collision queries.
+ *
+ * Like the quadtree parameters, it only takes effect when entering a system.
+ *
+ *    @param index Spatial index to use.
+ *    @param cell_size Size of the grid cells, ignored if not positive.
+ */
+void pilot_spatialIndexParams( PilotSpatialIndex index, int cell_size )
+{
+   pilot_spatialNext = index;
+   if (cell_size > 0)
+      sg_cell_size = cell_size;
+}
@@ -7,6 +7,7 @@
 
 #include "ai.h"
 #include "commodity.h"
+#include "damagetype.h"
 #include "effect.h"
 #include "faction.h"
 #include "ntime.h"
@@ -18,9 +19,18 @@
 #include "spfx.h"
 #include "lvar.h"
 #include "intlist.h"
+#include "quadtree.h"
 
 #define PLAYER_ID       1 /**< Player pilot ID. */
 
+/**
+ * @brief Spatial index used for the pilot collision queries.
+ */
+typedef enum PilotSpatialIndex_ {
+   PILOT_SPATIAL_QUADTREE, /**< Quadtree, updated incrementally. */
+   PILOT_SPATIAL_GRID,     /**< Loose hashed uniform grid, rebuilt every frame. */
+} PilotSpatialIndex;
+
 /* Hyperspace parameters. */
 #define HYPERSPACE_ENGINE_DELAY  3. /**< Time to warm up engine (seconds). */
 #define HYPERSPACE_FLY_DELAY     5. /**< Time it takes to hyperspace (seconds). */
@@ -42,7 +52,9 @@
 #define PILOT_SIZE_APPROX        0.8   /**< approximation for pilot size */
 #define PILOT_WEAPON_SETS        10    /**< Number of weapon sets the pilot has. */
 #define PILOT_WEAPSET_MAX_LEVELS 2     /**< Maximum amount of weapon levels. */
+#define PILOT_AIMCACHE_SIZE      4     /**< Number of cached weapon flight times. */
 #define PILOT_REVERSE_THRUST     0.4   /**< Ratio of normal accel to apply when reversing. */
+#define PILOT_TRAIL_MARGIN       100.  /**< Distance past the screen edge at which trails stop being sampled, on top of their length. */
 #define PILOT_PLAYER_NONTARGETABLE_TAKEOFF_DELAY 5. /**< Time the player is safe (from being targetted) after takeoff. */
 #define PILOT_PLAYER_NONTARGETABLE_JUMPIN_DELAY 5. /**< Time the player is safe (from being targetted) after jumping in. */
 
@@ -173,6 +185,23 @@ typedef struct PilotWeaponSet_ {
    double speed[PILOT_WEAPSET_MAX_LEVELS]; /**< Speed of the levels in the outfit slot. */
 } PilotWeaponSet;
 
+/**
+ * @brief Cached flight time of a projectile towards a target.
+ *
+ * The flight time only depends on the kinematics of the shooter and the
+ *  target, so turrets sharing a projectile speed can reuse it as long as
+ *  nobody moved.
+ */
+typedef struct PilotAimCache_ {
+   double speed;  /**< Speed of the projectile, 0 if unused. */
+   int absolute;  /**< Whether the projectile ignores the shooter velocity. */
+   vec2 pos;      /**< Position of the shooter. */
+   vec2 vel;      /**< Velocity of the shooter. */
+   vec2 tpos;     /**< Position of the target. */
+   vec2 tvel;     /**< Velocity of the target. */
+   double time;   /**< Cached flight time. */
+} PilotAimCache;
+
 /**
  * @brief Stores a pilot commodity.
  */
@@ -225,6 +254,7 @@ typedef struct Pilot_ {
    /* Object characteristics */
    const Ship* ship; /**< ship pilot is flying */
    Solid solid;      /**< Associated solid (physics) */
+   int qt_elem;      /**< Quadtree element, only valid if owned by the pilot. */
    double base_mass; /**< Ship mass plus core outfit mass. */
    double mass_cargo;/**< Amount of cargo mass added. */
    double mass_outfit;/**< Amount of outfit mass added. */
@@ -276,6 +306,7 @@ typedef struct Pilot_ {
    double ew_jumppoint; /**< Jump point factor, affects stealth. */
    /* misc. */
    double ew_stealth_timer; /**< Stealth timer. */
+   double ew_stealth_dt; /**< Time accumulated since the last stealth update when far from the player. */
 
    /* Heat. */
    double heat_T;    /**< Ship temperature. [K] */
@@ -291,9 +322,18 @@ typedef struct Pilot_ {
    ShipStatList *ship_stats; /**< Ship stats set by the Lua ship. Only valid if the Lua has ship defined. */
    ShipStatList *intrinsic_stats; /**< Intrinsic statistics to the ship create on the fly. */
    ShipStats stats;  /**< Pilot's copy of ship statistics, used for comparisons.. */
+   ShipStats stats_outfit; /**< Stats of the ship and outfits, before effects and system stats. */
+   int cpu_outfit;   /**< CPU used by the outfits, cached with stats_outfit. */
+   double energy_loss_outfit; /**< Energy loss of the outfits, cached with stats_outfit. */
+   int stats_cached; /**< Whether or not stats_outfit is up to date. */
+   int equip_batch;  /**< Nesting depth of the equipment batches, stats are not recalculated while positive. */
+   int equip_dirty;  /**< Whether stats were requested during the equipment batch. */
+   unsigned int stats_epoch; /**< Changes every time the stats are recalculated, unique among pilots. */
+   DTypeMod *dtype_mods; /**< Array (array.h) of the damage type modifiers with stats applied, indexed by damage type. */
 
    /* Ship effects. */
    Effect *effects; /**< Pilot's current activated effects. */
+   EffectClock effects_clock; /**< Clock the effects expire on. */
 
    /* Outfit management */
    PilotOutfitSlot **outfits;        /**< Array (array.h): Pointers to all outfits. */
@@ -308,7 +348,7 @@ typedef struct Pilot_ {
    int nbeams;        /**< Number of beams equipped. */
    int nfighterbays;  /**< Number of fighter bays available. */
    int nafterburners; /**< Number of afterburners equipped. */
-   int outfitlupdate; /**< Has outfits with Lua update scripts. */
+   unsigned int outfitlcallbacks; /**< Lua callbacks defined by the equipped outfits (PILOTOUTFIT_LUA_*). */
    double refuel_amount; /**< Amount to refuel. */
 
    /* For easier usage. */
@@ -319,6 +359,8 @@ typedef struct Pilot_ {
    int active_set;   /**< Index of the currently active weapon set. */
    int autoweap;     /**< Automatically update weapon sets. */
    int aimLines;     /**< Activate aiming helper lines. */
+   PilotAimCache aimcache[PILOT_AIMCACHE_SIZE]; /**< Recently computed flight times. */
+   int aimcache_next; /**< Next aim cache entry to replace. */
 
    /* Cargo */
    credits_t credits; /**< monies the pilot has */
@@ -349,6 +391,8 @@ typedef struct Pilot_ {
    AI_Profile* ai;   /**< AI personality profile */
    int lua_mem;      /**< AI memory. */
    double tcontrol;  /**< timer for control tick */
+   int tcontrol_deferred; /**< Number of frames the control tick has been deferred. */
+   double think_dt;  /**< Time skipped by the thinking level of detail, passed on at the next think. */
    double timer[MAX_AI_TIMERS]; /**< Timers for AI */
    Task* task;       /**< current action */
    unsigned int shoot_indicator; /**< Indicator to inform the AI if a seeker has been shot recently. */
@@ -395,6 +439,7 @@ typedef struct Pilot_ {
 /* Getting pilot stuff. */
 Pilot*const* pilot_getAll (void);
 Pilot* pilot_get( unsigned int id );
+unsigned int pilot_epoch (void);
 Pilot* pilot_getTarget( Pilot *p );
 unsigned int pilot_getNextID( unsigned int id, int mode );
 unsigned int pilot_getPrevID( unsigned int id, int mode );
@@ -473,8 +518,13 @@ void pilot_setTurn( Pilot *p, double turn );
 void pilot_update( Pilot* pilot, double dt );
 void pilots_updatePurge (void);
 void pilots_update( double dt );
+void pilots_prefetch( double x1, double y1, double x2, double y2 );
 void pilot_renderFramebuffer( Pilot *p, GLuint fbo, double fw, double fh );
+void pilots_cull (void);
 void pilots_render (void);
+void pilots_interpStore (void);
+void pilots_interpBegin( double alpha, double step );
+void pilots_interpEnd (void);
 void pilots_renderOverlay (void);
 void pilot_render( Pilot* pilot );
 void pilot_renderOverlay( Pilot* p );
@@ -499,6 +549,7 @@ char pilot_getFactionColourChar( const Pilot *p );
 
 /* Misc details. */
 void pilot_msg( const Pilot *p, const Pilot *receiver, const char *type, unsigned int index );
+void pilot_msgGroup( const Pilot *p, const Pilot *const *receivers, int n, const char *type, unsigned int index );
 void pilot_clearTrails( Pilot *p );
 void pilot_sample_trails( Pilot* p, int none );
 int pilot_hasIllegal( const Pilot *p, int faction );
@@ -511,5 +562,9 @@ ntime_t pilot_hyperspaceDelay( const Pilot *p );
 void pilot_untargetAsteroid( int anchor, int asteroid );
 PilotOutfitSlot* pilot_getDockSlot( Pilot* p );
 const IntList *pilot_collideQuery( int x1, int y1, int x2, int y2 );
+const IntList *pilot_getNearby( double x, double y, double r );
 void pilot_collideQueryIL( IntList *il, int x1, int y1, int x2, int y2 );
+void pilot_collideQueryILScratch( IntList *il, QuadtreeScratch *scratch, int x1, int y1, int x2, int y2 );
+void pilot_collideQueryEach( int x1, int y1, int x2, int y2, QtEltFunc *func, void *data );
 void pilot_quadtreeParams( int max_elem, int depth );
+void pilot_spatialIndexParams( PilotSpatialIndex index, int cell_size );
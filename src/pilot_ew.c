@@ -13,6 +13,8 @@
 /** @endcond */
 
 #include "array.h"
+#include "conf.h"
+#include "faction.h"
 #include "hook.h"
 #include "log.h"
 #include "pilot.h"
@@ -20,7 +22,11 @@
 #include "player_autonav.h"
 #include "space.h"
 
+#define EW_STEALTH_FAR_DIST   15e3 /**< Distance to the player past which stealth is updated at a reduced rate. */
+
 static double ew_interference = 1.; /**< Interference factor. */
+static double ew_detect_max = 0.; /**< Upper bound of the detection of all the pilots, for nearby queries. */
+static int *ew_nearby_fac = NULL; /**< Factions of the nearby pilots (array.h). */
 
 /*
  * Prototypes.
@@ -95,6 +101,22 @@ void pilot_ewUpdateStatic( Pilot *p )
 {
    p->ew_mass = pilot_ewMass( p->solid.mass );
    pilot_ewUpdate( p );
+   ew_detect_max = MAX( ew_detect_max, p->stats.ew_detect );
+}
+
+/**
+ * @brief Recomputes the bound of the detection of the pilots.
+ *
+ * Stats recomputed during the frame only raise it, so it stays a bound until
+ *  this is called again once per frame.
+ *
+ *    @param pilots Pilots to compute the bound of (array.h).
+ */
+void pilots_ewUpdateDetect( Pilot *const* pilots )
+{
+   ew_detect_max = 0.;
+   for (int i=0; i<array_size(pilots); i++)
+      ew_detect_max = MAX( ew_detect_max, pilots[i]->stats.ew_detect );
 }
 
 /**
@@ -407,7 +429,9 @@ double pilot_ewWeaponTrack( const Pilot *p, const Pilot *t, double trackmin, dou
 static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close, int *isplayer )
 {
    Pilot *const* ps;
+   const IntList *il;
    int n;
+   double r;
 
    /* Check nearby non-allies. */
    if (mod != NULL)
@@ -418,9 +442,22 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close, in
       *isplayer = 0;
    n = 0;
    ps = pilot_getAll();
-   for (int i=0; i<array_size(ps); i++) {
+
+   /* Only pilots within the largest detection radius can matter. */
+   r  = MAX( 0., p->ew_stealth * ew_detect_max ) * ((close != NULL) ? 1.5 : 1.);
+   il = pilot_getNearby( p->solid.pos.x, p->solid.pos.y, r );
+
+   /* Classify the factions all at once. */
+   if (ew_nearby_fac == NULL)
+      ew_nearby_fac = array_create( int );
+   array_resize( &ew_nearby_fac, il_size(il) );
+   for (int i=0; i<il_size(il); i++)
+      ew_nearby_fac[i] = ps[ il_get( il, i, 0 ) ]->faction;
+   faction_classify( p->faction, ew_nearby_fac, il_size(il), ew_nearby_fac );
+
+   for (int i=0; i<il_size(il); i++) {
       double dist;
-      Pilot *t = ps[i];
+      Pilot *t = ps[ il_get( il, i, 0 ) ];
 
       /* Quick checks first. */
       if (pilot_isDisabled(t))
@@ -433,8 +470,12 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close, in
             pilot_isFlag(t, PILOT_TAKEOFF))
          continue;
 
-      /* Allies are ignored. */
-      if (pilot_areAllies( p, t ))
+      /* Allies are ignored, the faction standing is enough unless the player is involved. */
+      if (pilot_isWithPlayer(p) || pilot_isWithPlayer(t)) {
+         if (pilot_areAllies( p, t ))
+            continue;
+      }
+      else if (ew_nearby_fac[i] > 0)
          continue;
 
       /* Stealthed pilots don't reduce stealth. */
@@ -476,6 +517,16 @@ void pilot_ewUpdateStealth( Pilot *p, double dt )
    if (!pilot_isFlag( p, PILOT_STEALTH ))
       return;
 
+   /* Pilots far from the player are updated less often, with the time accumulated. */
+   if ((conf.stealth_far_interval > 0.) && !pilot_isPlayer(p) && (player.p != NULL) &&
+         (vec2_dist2( &p->solid.pos, &player.p->solid.pos ) > pow2(EW_STEALTH_FAR_DIST))) {
+      p->ew_stealth_dt += dt;
+      if (p->ew_stealth_dt < conf.stealth_far_interval)
+         return;
+      dt = p->ew_stealth_dt;
+   }
+   p->ew_stealth_dt = 0.;
+
    /* Get nearby pilots. */
    if (pilot_isPlayer(p)) {
       if (pilot_isFlag(p, PILOT_NONTARGETABLE))
@@ -542,6 +593,7 @@ int pilot_stealth( Pilot *p )
    if (!pilot_outfitLOnstealth( p ) || ret)
       pilot_calcStats(p);
    p->ew_stealth_timer = 0.;
+   p->ew_stealth_dt = 0.;
 
    /* Run hook. */
    const HookParam hparam = { .type = HOOK_PARAM_BOOL, .u.b = 1 };
@@ -559,7 +611,7 @@ void pilot_destealth( Pilot *p )
    pilot_rmFlag( p, PILOT_STEALTH );
    p->ew_stealth_timer = 0.;
    if (!pilot_outfitLOnstealth( p ))
-      pilot_calcStats(p);
+      pilot_calcStatsEffects(p);
 
    /* Run hook. */
    const HookParam hparam = { .type = HOOK_PARAM_BOOL, .u.b = 0 };
@@ -35,6 +35,7 @@ double pilot_ewScanTime( const Pilot *p );
 void pilot_ewScanStart( Pilot *p );
 void pilot_ewUpdateStatic( Pilot *p );
 void pilot_ewUpdateDynamic( Pilot *p, double dt );
+void pilots_ewUpdateDetect( Pilot *const* pilots );
 
 /*
  * Stealth.
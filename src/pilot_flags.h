@@ -71,6 +71,7 @@ enum {
    PILOT_INVISIBLE,     /**< Pilot doesn't appear on the radar nor can be targetted, however, it still can do stuff and is rendered. */
    PILOT_HIDE,          /**< Pilot is invisible to other pilots, nor is it updated. */
    PILOT_HILIGHT,       /**< Pilot is hilighted when visible (this does not increase visibility). */
+   PILOT_TRAILS_CULLED, /**< Trails were not sampled for being off-screen. */
    /* Outfit stuff. */
    PILOT_AFTERBURNER,   /**< Pilot has their afterburner activated. */
    /* Refueling. */
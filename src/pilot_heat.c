@@ -160,7 +160,7 @@ void pilot_heatAddSlotTime( const Pilot *p, PilotOutfitSlot *o, double dt )
 }
 
 /**
- * @brief Heats the pilot's slot.
+ * @brief Heats the pilot's slots.
  *
  * We only consider conduction with the ship's chassis.
  *
@@ -170,20 +170,34 @@ void pilot_heatAddSlotTime( const Pilot *p, PilotOutfitSlot *o, double dt )
  *  k being conductivity W/(m*K)
  *  dT/dx temperature gradient along one dimension K/m
  *
- * Slots are connected only with the chassis.
+ * Slots are connected only with the chassis, whose temperature is only
+ *  updated afterwards by pilot_heatUpdateShip, so the slots don't depend on
+ *  each other and are done in a single pass.
  *
  *    @param p Pilot to update.
- *    @param o Outfit slot to update.
  *    @param dt Delta tick.
  *    @return The energy transferred.
  */
-double pilot_heatUpdateSlot( const Pilot *p, PilotOutfitSlot *o, double dt )
+double pilot_heatUpdateSlots( const Pilot *p, double dt )
 {
-   /* Calculate energy leaving/entering ship chassis. */
-   double Q = -p->heat_cond * (o->heat_T - p->heat_T) * o->heat_area * dt;
+   double kdt = p->heat_cond * dt;
+   double T   = p->heat_T;
+   double Q   = 0.;
 
-   /* Update current temperature. */
-   o->heat_T  += Q / o->heat_C;
+   for (int i=0; i<array_size(p->outfits); i++) {
+      PilotOutfitSlot *o = p->outfits[i];
+      double Qi;
+
+      if ((o->outfit == NULL) || !o->active)
+         continue;
+
+      /* Calculate energy leaving/entering ship chassis. */
+      Qi = kdt * (T - o->heat_T) * o->heat_area;
+
+      /* Update current temperature. */
+      o->heat_T += Qi / o->heat_C;
+      Q += Qi;
+   }
 
    /* Return energy moved. */
    return Q;
@@ -212,11 +226,12 @@ double pilot_heatUpdateSlot( const Pilot *p, PilotOutfitSlot *o, double dt )
  */
 void pilot_heatUpdateShip( Pilot *p, double Q_cond, double dt )
 {
-   double Q, Q_rad;
+   double Q, Q_rad, T2;
 
-   /* Calculate radiation. */
+   /* Calculate radiation, squaring twice is much cheaper than pow(). */
+   T2          = pow2( p->heat_T );
    Q_rad       = CONST_STEFAN_BOLTZMANN * p->heat_area * p->heat_emis *
-         (CONST_SPACE_STAR_TEMP_4 - pow(p->heat_T,4.)) * dt;
+         (CONST_SPACE_STAR_TEMP_4 - pow2(T2)) * dt;
 
    /* Total heat movement. */
    Q           = Q_rad - Q_cond;
@@ -279,14 +294,6 @@ double pilot_heatAccuracyMod( double T )
    return CLAMP( 0., 1., (T-500.)/600. );
 }
 
-/**
- * @brief Returns a 0:1 modifier representing fire rate (1. being normal).
- */
-double pilot_heatFireRateMod( double T )
-{
-   return CLAMP( 0., 1., (1100.-T)/300. );
-}
-
 /**
  * @brief Returns a 0:2 level of fire, 0:1 is the accuracy point, 1:2 is fire rate point.
  */
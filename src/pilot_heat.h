@@ -48,7 +48,7 @@ void pilot_heatCalcSlot( PilotOutfitSlot *o );
 void pilot_heatReset( Pilot *p );
 void pilot_heatAddSlot( const Pilot *p, PilotOutfitSlot *o );
 void pilot_heatAddSlotTime( const Pilot *p, PilotOutfitSlot *o, double dt );
-double pilot_heatUpdateSlot( const Pilot *p, PilotOutfitSlot *o, double dt );
+double pilot_heatUpdateSlots( const Pilot *p, double dt );
 void pilot_heatUpdateShip( Pilot *p, double Q_cond, double dt );
 void pilot_heatUpdateCooldown( Pilot *p );
 
@@ -57,5 +57,12 @@ void pilot_heatUpdateCooldown( Pilot *p );
  */
 double pilot_heatEfficiencyMod( double T, double Tb, double Tc );
 double pilot_heatAccuracyMod( double T );
-double pilot_heatFireRateMod( double T );
 double pilot_heatFirePercent( double T );
+
+/**
+ * @brief Returns a 0:1 modifier representing fire rate (1. being normal).
+ */
+static inline double pilot_heatFireRateMod( double T )
+{
+   return CLAMP( 0., 1., (1100.-T)/300. );
+}
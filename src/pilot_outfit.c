@@ -11,6 +11,7 @@
 /** @endcond */
 
 #include "array.h"
+#include "damagetype.h"
 #include "escort.h"
 #include "gui.h"
 #include "log.h"
@@ -31,11 +32,45 @@
 
 static int stealth_break = 0; /**< Whether or not to break stealth. */
 
+/**
+ * @brief Lua outfit update queued to be run together with the other slots
+ *        having the same outfit.
+ */
+typedef struct OutfitLUpdate_ {
+   const Outfit *outfit; /**< Outfit to update. */
+   Pilot *pilot;     /**< Pilot the slot belongs to. */
+   int slot;         /**< Index of the slot in the pilot's outfits or intrinsic outfits. */
+   int intrinsic;    /**< Whether or not the slot is an intrinsic outfit. */
+   int ticks;        /**< Number of updates to run. */
+   int seq;          /**< Order it was queued in, to keep the sort stable. */
+} OutfitLUpdate;
+static OutfitLUpdate *outfitl_updates = NULL; /**< Queued Lua outfit updates (array.h). */
+
+#define OUTFIT_DESC_CACHE  256 /**< Number of entries of the descextra cache, must be a power of 2. */
+/**
+ * @brief Cached result of a Lua outfit descextra function.
+ */
+typedef struct OutfitDescCache_ {
+   const Outfit *outfit; /**< Outfit the description is of, NULL if unused. */
+   unsigned int id;     /**< ID of the pilot passed to the function. */
+   unsigned int epoch;  /**< Stats epoch of the pilot. */
+   char *desc;          /**< Description, NULL if the function returned nothing. */
+} OutfitDescCache;
+static OutfitDescCache outfit_descCache[OUTFIT_DESC_CACHE]; /**< Direct-mapped descextra cache. */
+static unsigned int pilot_statsEpoch = 0; /**< Last stats epoch given to a pilot. */
+
 /*
  * Prototypes.
  */
 static void pilot_calcStatsSlot( Pilot *pilot, PilotOutfitSlot *slot );
+static void pilot_calcStatsOutfits( Pilot *pilot );
+static void pilot_calcStatsApply( Pilot *pilot );
 static const char *outfitkeytostr( OutfitKey key );
+static void pilot_outfitLsetmem( PilotOutfitSlot *po, nlua_env env );
+static void outfitLUpdateCall( const Pilot *pilot, PilotOutfitSlot *po, double dt );
+static void pilot_outfitLUpdateQueueSlot( Pilot *pilot, const PilotOutfitSlot *po, int slot, int intrinsic, int ticks );
+static PilotOutfitSlot *outfitl_updateSlot( const OutfitLUpdate *u );
+static int outfitl_updateCmp( const void *p1, const void *p2 );
 
 /**
  * @brief Updates the lockons on the pilot's launchers
@@ -46,19 +81,20 @@ static const char *outfitkeytostr( OutfitKey key );
  *    @param wt Pilot's target.
  *    @param a Angle to update if necessary. Should be initialized to -1 before the loop.
  *    @param dt Current delta tick.
+ *    @return 1 if the lock was just established and the lockon hook should be run, 0 otherwise.
  */
-void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, Target *wt, double *a, double dt )
+int pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, Target *wt, double *a, double dt )
 {
    double arc, max;
    int locked;
 
    /* No target. */
    if (wt->type==TARGET_NONE)
-      return;
+      return 0;
 
    /* Nota  seeker. */
    if (!outfit_isSeeker(o->outfit))
-      return;
+      return 0;
 
    /* Check arc. */
    arc = o->outfit->u.lau.arc;
@@ -101,7 +137,7 @@ void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, Target *wt, d
 
          /* Out of arc. */
          o->u.ammo.in_arc = 0;
-         return;
+         return 0;
       }
    }
 
@@ -120,10 +156,11 @@ void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, Target *wt, d
       if (o->u.ammo.lockon_timer < max)
          o->u.ammo.lockon_timer = max;
 
-      /* Trigger lockon hook. */
+      /* Lockon hook has to be triggered. */
       if (!locked && (o->u.ammo.lockon_timer < 0.))
-         pilot_runHook( p, PILOT_HOOK_LOCKON );
+         return 1;
    }
+   return 0;
 }
 
 /**
@@ -317,6 +354,9 @@ int pilot_addOutfitRaw( Pilot* pilot, const Outfit* outfit, PilotOutfitSlot *s )
    o = s->outfit;
    s->active = outfit_isActive(o);
 
+   /* Cached outfit stats no longer match. */
+   pilot->stats_cached = 0;
+
    /* Update heat. */
    pilot_heatCalcSlot( s );
 
@@ -508,6 +548,7 @@ int pilot_rmOutfitRaw( Pilot* pilot, PilotOutfitSlot *s )
    /* Remove the outfit. */
    ret         = (s->outfit==NULL);
    s->outfit   = NULL;
+   pilot->stats_cached = 0;
    //s->weapset  = -1;
 
    /* Remove secondary and such if necessary. */
@@ -907,19 +948,19 @@ double pilot_outfitRange( const Pilot *p, const Outfit *o )
 }
 
 /**
- * @brief Computes the stats for a pilot's slot.
+ * @brief Computes the stats for a pilot's slot into the cached outfit stats.
  */
 static void pilot_calcStatsSlot( Pilot *pilot, PilotOutfitSlot *slot )
 {
    const Outfit *o = slot->outfit;
-   ShipStats *s = &pilot->stats;
+   ShipStats *s = &pilot->stats_outfit;
 
    /* Outfit must exist. */
    if (o==NULL)
       return;
 
    /* Modify CPU. */
-   pilot->cpu           += outfit_cpu(o);
+   pilot->cpu_outfit    += outfit_cpu(o);
 
    /* Add mass. */
    pilot->mass_outfit   += o->mass;
@@ -939,11 +980,17 @@ static void pilot_calcStatsSlot( Pilot *pilot, PilotOutfitSlot *slot )
 
    /* Lua mods apply their stats. */
    if (slot->lua_mem != LUA_NOREF)
-      ss_statsMergeFromList( &pilot->stats, slot->lua_stats );
+      ss_statsMergeFromList( s, slot->lua_stats );
 
-   /* Has update function. */
+   /* Lua callbacks the pilot has to run. */
    if (o->lua_update != LUA_NOREF)
-      pilot->outfitlupdate = 1;
+      pilot->outfitlcallbacks |= PILOTOUTFIT_LUA_UPDATE;
+   if (o->lua_onhit != LUA_NOREF)
+      pilot->outfitlcallbacks |= PILOTOUTFIT_LUA_ONHIT;
+   if (o->lua_onshootany != LUA_NOREF)
+      pilot->outfitlcallbacks |= PILOTOUTFIT_LUA_ONSHOOTANY;
+   if (o->lua_cooldown != LUA_NOREF)
+      pilot->outfitlcallbacks |= PILOTOUTFIT_LUA_COOLDOWN;
 
    /* Apply modifications. */
    if (outfit_isMod(o)) { /* Modification */
@@ -961,7 +1008,7 @@ static void pilot_calcStatsSlot( Pilot *pilot, PilotOutfitSlot *slot )
       /* Add stats. */
       ss_statsMergeFromList( s, o->stats );
       pilot_setFlag( pilot, PILOT_AFTERBURNER ); /* We use old school flags for this still... */
-      pilot->energy_loss += pilot->afterburner->outfit->u.afb.energy; /* energy loss */
+      pilot->energy_loss_outfit += pilot->afterburner->outfit->u.afb.energy; /* energy loss */
    }
    else {
       /* Always add stats for non mod/afterburners. */
@@ -969,24 +1016,164 @@ static void pilot_calcStatsSlot( Pilot *pilot, PilotOutfitSlot *slot )
    }
 }
 
+/**
+ * @brief Computes the stats of the ship and its outfits, which only change
+ *        when the outfits or their state change.
+ *
+ *    @param pilot Pilot to compute the outfit stats of.
+ */
+static void pilot_calcStatsOutfits( Pilot *pilot )
+{
+   ShipStats *s = &pilot->stats_outfit;
+
+   pilot->base_mass     = pilot->ship->mass;
+   pilot->cpu_outfit    = 0;
+   pilot->energy_loss_outfit = 0.; /* Initially no net loss. */
+   pilot->outfitlcallbacks = 0;
+   *s = pilot->ship->stats_array;
+
+   /* Player gets difficulty applied. */
+   if (pilot_isPlayer(pilot))
+      difficulty_apply( s );
+
+   /* Now add outfit changes */
+   pilot->mass_outfit   = 0.;
+   for (int i=0; i<array_size(pilot->outfit_intrinsic); i++)
+      pilot_calcStatsSlot( pilot, &pilot->outfit_intrinsic[i] );
+   for (int i=0; i<array_size(pilot->outfits); i++)
+      pilot_calcStatsSlot( pilot, pilot->outfits[i] );
+
+   /* Merge stats. */
+   ss_statsMergeFromList( s, pilot->ship_stats );
+   ss_statsMergeFromList( s, pilot->intrinsic_stats );
+
+   pilot->stats_cached = 1;
+}
+
+#if DEBUGGING
+/**
+ * @brief Makes sure the cached outfit stats match a full recompute.
+ *
+ *    @param pilot Pilot to check.
+ */
+static void pilot_calcStatsCheck( Pilot *pilot )
+{
+   ShipStats s = pilot->stats_outfit;
+   int cpu = pilot->cpu_outfit;
+   double loss = pilot->energy_loss_outfit;
+
+   pilot_calcStatsOutfits( pilot );
+   if ((memcmp( &s, &pilot->stats_outfit, sizeof(ShipStats) ) != 0) ||
+         (cpu != pilot->cpu_outfit) || (loss != pilot->energy_loss_outfit))
+      WARN(_("Pilot '%s' had stale cached outfit stats!"), pilot->name);
+}
+#endif /* DEBUGGING */
+
 /**
  * @brief Recalculates the pilot's stats based on his outfits.
  *
+ * Inside an equipment batch the recalculation is deferred until the batch is
+ *  committed.
+ *
  *    @param pilot Pilot to recalculate his stats.
  */
 void pilot_calcStats( Pilot* pilot )
+{
+   if (pilot->equip_batch > 0) {
+      pilot->equip_dirty = 1;
+      return;
+   }
+   pilot_calcStatsOutfits( pilot );
+   pilot_calcStatsApply( pilot );
+}
+
+/**
+ * @brief Starts a batch of equipment changes.
+ *
+ * Until the matching pilot_equipCommit(), stats are not recalculated when
+ *  outfits are added or removed, so a whole loadout only recalculates them
+ *  once. The stats of the pilot are stale during the batch, so anything that
+ *  depends on them, such as the CPU checks, should not be relied on. Batches
+ *  can be nested.
+ *
+ *    @param pilot Pilot to start the batch of.
+ */
+void pilot_equipBegin( Pilot *pilot )
+{
+   pilot->equip_batch++;
+}
+
+/**
+ * @brief Ends a batch of equipment changes, recalculating the stats if needed.
+ *
+ *    @param pilot Pilot to end the batch of.
+ *    @return 1 if the outermost batch ended and the stats were recalculated.
+ */
+int pilot_equipCommit( Pilot *pilot )
+{
+   if (pilot->equip_batch <= 0) {
+      WARN(_("Pilot '%s': committing equipment without a batch!"), pilot->name);
+      return 0;
+   }
+   if (--pilot->equip_batch > 0)
+      return 0;
+   if (!pilot->equip_dirty)
+      return 0;
+   pilot->equip_dirty = 0;
+   pilot_calcStats( pilot );
+   return 1;
+}
+
+/**
+ * @brief Checks to see if the pilot is in a batch of equipment changes.
+ *
+ *    @param pilot Pilot to check.
+ *    @return 1 if the stats are being deferred.
+ */
+int pilot_equipBatched( const Pilot *pilot )
+{
+   return (pilot->equip_batch > 0);
+}
+
+/**
+ * @brief Recalculates the pilot's stats when only the effects, system or
+ *        stealth changed, reusing the cached outfit stats.
+ *
+ *    @param pilot Pilot to recalculate his stats.
+ */
+void pilot_calcStatsEffects( Pilot* pilot )
+{
+   if (!pilot->stats_cached) {
+      pilot_calcStats( pilot );
+      return;
+   }
+#if DEBUGGING
+   pilot_calcStatsCheck( pilot );
+#endif /* DEBUGGING */
+   pilot_calcStatsApply( pilot );
+}
+
+/**
+ * @brief Applies the effects, system and stealth to the cached outfit stats
+ *        and derives the pilot's properties from them.
+ *
+ *    @param pilot Pilot to apply stats to.
+ */
+static void pilot_calcStatsApply( Pilot *pilot )
 {
    double ac, sc, ec, tm; /* temporary health coefficients to set */
    ShipStats *s;
 
+   /* Invalidates the cached outfit descriptions. */
+   pilot->stats_epoch = ++pilot_statsEpoch;
+
    /*
     * Set up the basic stuff
     */
    /* mass */
    pilot->solid.mass    = pilot->ship->mass;
-   pilot->base_mass     = pilot->solid.mass;
    /* cpu */
-   pilot->cpu           = 0.;
+   pilot->cpu           = pilot->cpu_outfit;
    /* movement */
    pilot->accel_base    = pilot->ship->accel;
    pilot->turn_base     = pilot->ship->turn;
@@ -1011,28 +1198,11 @@ void pilot_calcStats( Pilot* pilot )
    /* Energy. */
    pilot->energy_max    = pilot->ship->energy;
    pilot->energy_regen  = pilot->ship->energy_regen;
-   pilot->energy_loss   = 0.; /* Initially no net loss. */
-   /* Misc. */
-   pilot->outfitlupdate = 0;
+   pilot->energy_loss   = pilot->energy_loss_outfit;
    /* Stats. */
    s = &pilot->stats;
    tm = s->time_mod;
-   *s = pilot->ship->stats_array;
-
-   /* Player gets difficulty applied. */
-   if (pilot_isPlayer(pilot))
-      difficulty_apply( s );
-
-   /* Now add outfit changes */
-   pilot->mass_outfit   = 0.;
-   for (int i=0; i<array_size(pilot->outfit_intrinsic); i++)
-      pilot_calcStatsSlot( pilot, &pilot->outfit_intrinsic[i] );
-   for (int i=0; i<array_size(pilot->outfits); i++)
-      pilot_calcStatsSlot( pilot, pilot->outfits[i] );
-
-   /* Merge stats. */
-   ss_statsMergeFromList( &pilot->stats, pilot->ship_stats );
-   ss_statsMergeFromList( &pilot->stats, pilot->intrinsic_stats );
+   *s = pilot->stats_outfit;
 
    /* Compute effects. */
    effect_compute( &pilot->stats, pilot->effects );
@@ -1102,6 +1272,9 @@ void pilot_calcStats( Pilot* pilot )
    pilot->energy_loss  += s->energy_loss;
    pilot->dmg_absorb    = CLAMP( 0., 1., pilot->dmg_absorb + s->absorb );
 
+   /* Damage type modifiers for the hits. */
+   dtype_calcMods( &pilot->dtype_mods, s );
+
    /* Give the pilot his health proportion back */
    pilot->armour = ac * pilot->armour_max;
    pilot->shield = sc * pilot->shield_max;
@@ -1267,18 +1440,26 @@ static void outfitLRunWarning( const Pilot *p, const Outfit *o, const char *name
 static int pilot_outfitLmem( PilotOutfitSlot *po, nlua_env env )
 {
    int oldmem;
+   /* Get old memory. */
+   nlua_getenv( naevL, env, "mem" ); /* oldmem */
+   oldmem = luaL_ref( naevL, LUA_REGISTRYINDEX ); /* */
+   /* Set the memory. */
+   pilot_outfitLsetmem( po, env );
+   return oldmem;
+}
+
+/**
+ * @brief Sets the outfit memory of a slot without saving the old one.
+ */
+static void pilot_outfitLsetmem( PilotOutfitSlot *po, nlua_env env )
+{
    /* Create the memory if necessary and initialize stats. */
    if (po->lua_mem == LUA_NOREF) {
       lua_newtable(naevL); /* mem */
       po->lua_mem = luaL_ref(naevL,LUA_REGISTRYINDEX); /* */
    }
-   /* Get old memory. */
-   nlua_getenv( naevL, env, "mem" ); /* oldmem */
-   oldmem = luaL_ref( naevL, LUA_REGISTRYINDEX ); /* */
-   /* Set the memory. */
    lua_rawgeti(naevL, LUA_REGISTRYINDEX, po->lua_mem); /* mem */
    nlua_setenv( naevL, env, "mem" ); /* */
-   return oldmem;
 }
 
 /**
@@ -1291,35 +1472,69 @@ static void pilot_outfitLunmem( nlua_env env, int oldmem )
    luaL_unref( naevL, LUA_REGISTRYINDEX, oldmem );
 }
 
+/**
+ * @brief Clears the cached outfit descriptions.
+ *
+ * Has to be called when the outfits are freed or whatever the Lua descextra
+ *  functions depend on besides the pilot's stats changes.
+ */
+void pilot_outfitDescClear (void)
+{
+   for (int i=0; i<OUTFIT_DESC_CACHE; i++) {
+      free( outfit_descCache[i].desc );
+      outfit_descCache[i].outfit = NULL;
+      outfit_descCache[i].desc   = NULL;
+   }
+}
+
+/**
+ * @brief Gets the extra description of an outfit for a pilot.
+ *
+ * The results of the Lua descextra function are cached until the pilot's
+ *  stats change, as the outfitter asks for them for every outfit each time
+ *  the lists are regenerated.
+ */
 static const char* pilot_outfitLDescExtra( const Pilot *p, const Outfit *o )
 {
-   static char descextra[STRMAX];
    const char *de;
+   unsigned int id, epoch;
+   OutfitDescCache *c;
+
    if (o->lua_descextra == LUA_NOREF)
       return (o->desc_extra != NULL) ? _(o->desc_extra) : NULL;
 
+   /* Look up the cache. */
+   id    = (p != NULL) ? p->id : 0;
+   epoch = (p != NULL) ? p->stats_epoch : 0;
+   c = &outfit_descCache[ (((uintptr_t)o >> 4) ^ (epoch * 2654435761u)) & (OUTFIT_DESC_CACHE-1) ];
+   if ((c->outfit == o) && (c->id == id) && (c->epoch == epoch))
+      return c->desc;
+
    /* Set up the function: init( p, po ) */
    lua_rawgeti(naevL, LUA_REGISTRYINDEX, o->lua_descextra); /* f */
-   if ((p != NULL) && (p->id > 0)) /* Needs valid ID. */
-      lua_pushpilot( naevL, p->id ); /* f, p */
+   if (id > 0) /* Needs valid ID. */
+      lua_pushpilot( naevL, id ); /* f, p */
    else
       lua_pushnil( naevL ); /* f, p */
    lua_pushoutfit( naevL, o ); /* f, p, o */
    if (nlua_pcall( o->lua_env, 2, 1 )) { /* */
       outfitLRunWarning( p, o, "descextra", lua_tostring(naevL,-1) );
-      lua_pop(naevL, 1);
-      descextra[0] = '\0';
-      return descextra;
+      de = "";
    }
    /* Case no return we just pass nothing. */
-   if (lua_isnoneornil( naevL, -1 )) {
-      lua_pop( naevL, 1 );
-      return NULL;
-   }
-   de = luaL_checkstring( naevL, -1 );
-   strncpy( descextra, de, sizeof(descextra)-1 );
+   else if (lua_isnoneornil( naevL, -1 ))
+      de = NULL;
+   else
+      de = luaL_checkstring( naevL, -1 );
+
+   /* Only fill the entry now, the function may have described other outfits. */
+   free( c->desc );
+   c->outfit = o;
+   c->id     = id;
+   c->epoch  = epoch;
+   c->desc   = (de != NULL) ? strndup( de, STRMAX-1 ) : NULL;
    lua_pop( naevL, 1 );
-   return descextra;
+   return c->desc;
 }
 
 /**
@@ -1489,30 +1704,32 @@ int pilot_outfitLInit( const Pilot *pilot, PilotOutfitSlot *po )
    return 1;
 }
 
+/**
+ * @brief Calls the update function of a slot, its memory must be already set.
+ */
+static void outfitLUpdateCall( const Pilot *pilot, PilotOutfitSlot *po, double dt )
+{
+   /* Set up the function: update( p, po, dt ) */
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, po->outfit->lua_update); /* f */
+   lua_pushpilot(naevL, pilot->id); /* f, p */
+   lua_pushpilotoutfit(naevL, po);  /* f, p, po */
+   lua_pushnumber(naevL, dt);       /* f, p, po, dt */
+   if (nlua_pcall( po->outfit->lua_env, 3, 0 )) { /* */
+      outfitLRunWarning( pilot, po->outfit, "update", lua_tostring(naevL,-1) );
+      lua_pop(naevL, 1);
+   }
+}
 static void outfitLUpdate( const Pilot *pilot, PilotOutfitSlot *po, const void *data )
 {
-   double dt;
    int oldmem;
    if (po->outfit->lua_update == LUA_NOREF)
       return;
 
    nlua_env env = po->outfit->lua_env;
 
-   /* The data. */
-   dt = *(double*)data;
-
    /* Set the memory. */
    oldmem = pilot_outfitLmem( po, env );
-
-   /* Set up the function: update( p, po, dt ) */
-   lua_rawgeti(naevL, LUA_REGISTRYINDEX, po->outfit->lua_update); /* f */
-   lua_pushpilot(naevL, pilot->id); /* f, p */
-   lua_pushpilotoutfit(naevL, po);  /* f, p, po */
-   lua_pushnumber(naevL, dt);       /* f, p, po, dt */
-   if (nlua_pcall( env, 3, 0 )) {   /* */
-      outfitLRunWarning( pilot, po->outfit, "update", lua_tostring(naevL,-1) );
-      lua_pop(naevL, 1);
-   }
+   outfitLUpdateCall( pilot, po, *(double*)data );
    pilot_outfitLunmem( env, oldmem );
 }
 /**
@@ -1523,7 +1740,7 @@ static void outfitLUpdate( const Pilot *pilot, PilotOutfitSlot *po, const void *
  */
 void pilot_outfitLUpdate( Pilot *pilot, double dt )
 {
-   if (!pilot->outfitlupdate)
+   if (!(pilot->outfitlcallbacks & PILOTOUTFIT_LUA_UPDATE))
       return;
 
    NTracingZone( _ctx, 1 );
@@ -1531,6 +1748,139 @@ void pilot_outfitLUpdate( Pilot *pilot, double dt )
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Queues the Lua outfit updates of a pilot to be run by pilot_outfitLUpdateRun.
+ *
+ *    @param pilot Pilot to queue the Lua outfits of.
+ *    @param ticks Number of updates to run for each outfit.
+ */
+void pilot_outfitLUpdateQueue( Pilot *pilot, int ticks )
+{
+   if ((ticks <= 0) || !(pilot->outfitlcallbacks & PILOTOUTFIT_LUA_UPDATE))
+      return;
+
+   if (outfitl_updates == NULL)
+      outfitl_updates = array_create( OutfitLUpdate );
+   for (int i=0; i<array_size(pilot->outfits); i++)
+      pilot_outfitLUpdateQueueSlot( pilot, pilot->outfits[i], i, 0, ticks );
+   for (int i=0; i<array_size(pilot->outfit_intrinsic); i++)
+      pilot_outfitLUpdateQueueSlot( pilot, &pilot->outfit_intrinsic[i], i, 1, ticks );
+}
+
+/**
+ * @brief Queues the update of a single slot if it has an update function.
+ */
+static void pilot_outfitLUpdateQueueSlot( Pilot *pilot, const PilotOutfitSlot *po, int slot, int intrinsic, int ticks )
+{
+   OutfitLUpdate *u;
+   if ((po->outfit==NULL) || (po->outfit->lua_update == LUA_NOREF))
+      return;
+   u = &array_grow( &outfitl_updates );
+   u->outfit   = po->outfit;
+   u->pilot    = pilot;
+   u->slot     = slot;
+   u->intrinsic = intrinsic;
+   u->ticks    = ticks;
+   u->seq      = array_size(outfitl_updates)-1;
+}
+
+/**
+ * @brief Gets the slot of a queued update if it is still valid.
+ *
+ * The update script may remove pilots or change outfits of the pilots further
+ *  down the queue, and intrinsic outfits may be reallocated.
+ */
+static PilotOutfitSlot *outfitl_updateSlot( const OutfitLUpdate *u )
+{
+   PilotOutfitSlot *po;
+   if (pilot_isFlag( u->pilot, PILOT_DELETE ))
+      return NULL;
+   if (u->intrinsic) {
+      if (u->slot >= array_size(u->pilot->outfit_intrinsic))
+         return NULL;
+      po = &u->pilot->outfit_intrinsic[ u->slot ];
+   }
+   else {
+      if (u->slot >= array_size(u->pilot->outfits))
+         return NULL;
+      po = u->pilot->outfits[ u->slot ];
+   }
+   return (po->outfit == u->outfit) ? po : NULL;
+}
+
+/**
+ * @brief Sorts the queued updates by outfit, keeping the queue order otherwise.
+ */
+static int outfitl_updateCmp( const void *p1, const void *p2 )
+{
+   const OutfitLUpdate *u1 = p1;
+   const OutfitLUpdate *u2 = p2;
+   if (u1->outfit < u2->outfit)
+      return -1;
+   else if (u1->outfit > u2->outfit)
+      return +1;
+   return u1->seq - u2->seq;
+}
+
+/**
+ * @brief Runs the queued Lua outfit updates.
+ *
+ * Updates are run grouped by outfit, so the memory of each outfit environment
+ *  only has to be saved and restored once per group.
+ *
+ *    @param dt Delta-tick of each update.
+ */
+void pilot_outfitLUpdateRun( double dt )
+{
+   int n = array_size( outfitl_updates );
+   if (n <= 0)
+      return;
+
+   NTracingZone( _ctx, 1 );
+   NTracingPlotI( "outfit_lua_updates", n );
+
+   qsort( outfitl_updates, n, sizeof(OutfitLUpdate), outfitl_updateCmp );
+   for (int i=0; i<n; ) {
+      const Outfit *o = outfitl_updates[i].outfit;
+      nlua_env env = o->lua_env;
+      int j, oldmem;
+
+      /* Save the memory once for the whole group. */
+      nlua_getenv( naevL, env, "mem" ); /* oldmem */
+      oldmem = luaL_ref( naevL, LUA_REGISTRYINDEX ); /* */
+
+      for (j=i; (j<n) && (outfitl_updates[j].outfit==o); j++) {
+         const OutfitLUpdate *u = &outfitl_updates[j];
+         for (int t=0; t<u->ticks; t++) {
+            PilotOutfitSlot *po = outfitl_updateSlot( u );
+            if (po == NULL)
+               break;
+            pilotoutfit_modified = 0;
+            pilot_outfitLsetmem( po, env );
+            outfitLUpdateCall( u->pilot, po, dt );
+            /* Recalculate if anything changed. */
+            if (pilotoutfit_modified)
+               pilot_calcStats( u->pilot );
+         }
+      }
+
+      pilot_outfitLunmem( env, oldmem );
+      i = j;
+   }
+   array_resize( &outfitl_updates, 0 );
+
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Frees the queue of Lua outfit updates.
+ */
+void pilot_outfitLFree (void)
+{
+   array_free( outfitl_updates );
+   outfitl_updates = NULL;
+}
+
 static void outfitLOutofenergy( const Pilot *pilot, PilotOutfitSlot *po, const void *data )
 {
    (void) data;
@@ -1614,6 +1964,8 @@ static void outfitLOnhit( const Pilot *pilot, PilotOutfitSlot *po, const void *d
 void pilot_outfitLOnhit( Pilot *pilot, double armour, double shield, unsigned int attacker )
 {
    const struct OnhitData data = { .armour = armour, .shield = shield, .attacker = attacker };
+   if (!(pilot->outfitlcallbacks & PILOTOUTFIT_LUA_ONHIT))
+      return;
    pilot_outfitLRun( pilot, outfitLOnhit, &data );
 }
 
@@ -1737,6 +2089,8 @@ static void outfitLCooldown( const Pilot *pilot, PilotOutfitSlot *po, const void
 void pilot_outfitLCooldown( Pilot *pilot, int done, int success, double timer )
 {
    const struct CooldownData data = { .done = done, .success = success, .timer = timer };
+   if (!(pilot->outfitlcallbacks & PILOTOUTFIT_LUA_COOLDOWN))
+      return;
    pilot_outfitLRun( pilot, outfitLCooldown, &data );
 }
 
@@ -1769,6 +2123,8 @@ static void outfitLOnshootany( const Pilot *pilot, PilotOutfitSlot *po, const vo
  */
 void pilot_outfitLOnshootany( Pilot *pilot )
 {
+   if (!(pilot->outfitlcallbacks & PILOTOUTFIT_LUA_ONSHOOTANY))
+      return;
    pilot_outfitLRun( pilot, outfitLOnshootany, NULL );
 }
 
@@ -9,6 +9,12 @@
 
 #define PILOT_OUTFIT_LUA_UPDATE_DT     (1.0/10.0)   /* How often the Lua outfits run their update script (in seconds).  */
 
+/* Lua outfit callbacks tracked per pilot. */
+#define PILOTOUTFIT_LUA_UPDATE      (1<<0) /**< Some outfit has an update function. */
+#define PILOTOUTFIT_LUA_ONHIT       (1<<1) /**< Some outfit has an onhit function. */
+#define PILOTOUTFIT_LUA_ONSHOOTANY  (1<<2) /**< Some outfit has an onshootany function. */
+#define PILOTOUTFIT_LUA_COOLDOWN    (1<<3) /**< Some outfit has a cooldown function. */
+
 typedef enum OutfitKey_ {
    OUTFIT_KEY_ACCEL,
    OUTFIT_KEY_LEFT,
@@ -18,6 +24,7 @@ typedef enum OutfitKey_ {
 /* Augmentations of normal pilot API. */
 const char* pilot_outfitDescription( const Pilot *pilot, const Outfit *o );
 const char* pilot_outfitSummary( const Pilot *p, const Outfit *o, int withname );
+void pilot_outfitDescClear (void);
 
 /* Raw changes. */
 int pilot_addOutfitRaw( Pilot* pilot, const Outfit* outfit, PilotOutfitSlot *s );
@@ -52,11 +59,15 @@ int pilot_reportSpaceworthy( const Pilot *p, char *buf, int buffSize );
 const char* pilot_canEquip( const Pilot *p, const PilotOutfitSlot *s, const Outfit *o );
 
 /* Lock-ons. */
-void pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, Target *wt, double *a, double dt );
+int pilot_lockUpdateSlot( Pilot *p, PilotOutfitSlot *o, Pilot *t, Target *wt, double *a, double dt );
 void pilot_lockClear( Pilot *p );
 
 /* Other. */
 void pilot_calcStats( Pilot *pilot );
+void pilot_equipBegin( Pilot *pilot );
+int pilot_equipCommit( Pilot *pilot );
+int pilot_equipBatched( const Pilot *pilot );
+void pilot_calcStatsEffects( Pilot *pilot );
 double pilot_massFactor( const Pilot *pilot );
 void pilot_updateMass( Pilot *pilot );
 void pilot_healLanded( Pilot *pilot );
@@ -72,6 +83,9 @@ int pilot_outfitLRemove( const Pilot *pilot, PilotOutfitSlot *po );
 void pilot_outfitLInitAll( Pilot *pilot );
 int pilot_outfitLInit( const Pilot *pilot, PilotOutfitSlot *po );
 void pilot_outfitLUpdate( Pilot *pilot, double dt );
+void pilot_outfitLUpdateQueue( Pilot *pilot, int ticks );
+void pilot_outfitLUpdateRun( double dt );
+void pilot_outfitLFree (void);
 void pilot_outfitLOutfofenergy( Pilot *pilot );
 void pilot_outfitLOnhit( Pilot *pilot, double armour, double shield, unsigned int attacker );
 int pilot_outfitLOntoggle( const Pilot *pilot, PilotOutfitSlot *po, int on );
@@ -35,6 +35,7 @@
 #include "nlua_pilotoutfit.h"
 #include "pilot.h"
 #include "player.h"
+#include "space.h"
 #include "spfx.h"
 #include "weapon.h"
 
@@ -75,6 +76,10 @@ static int pilot_weapSetFire( Pilot *p, PilotWeaponSet *ws, int level )
    double time;
    Target wt;
 
+   /* No combat in the warm-up simulation. */
+   if (space_isSimulationWarmup())
+      return 0;
+
    for (int i=0; i<array_size(ws->slots); i++) {
       PilotOutfitSlot *pos = p->outfits[ ws->slots[i].slotid ];
       const Outfit *o = pos->outfit;
@@ -1339,10 +1344,9 @@ int pilot_shootWeapon( Pilot *p, PilotOutfitSlot *w, const Target *target, doubl
             dockslot = j;
       }
 
-      /* Create the escort. */
+      /* Queue the escort, it gets created at the start of the next update. */
       if (!outfit_isProp( w->outfit, OUTFIT_PROP_SHOOT_DRY ))
-         escort_create( p, w->outfit->u.bay.ship,
-               &vp, &p->solid.vel, p->solid.dir, ESCORT_TYPE_BAY, 1, dockslot );
+         escort_queueBay( p, w->outfit->u.bay.ship, &vp, dockslot );
 
       w->u.ammo.quantity -= 1; /* we just shot it */
       p->mass_outfit     -= w->outfit->u.bay.ship_mass;
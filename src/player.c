@@ -16,6 +16,7 @@
 #include "player.h"
 
 #include "ai.h"
+#include "bitset.h"
 #include "board.h"
 #include "camera.h"
 #include "claim.h"
@@ -130,6 +131,8 @@ static double player_timer = 0.; /**< For death and such. */
  */
 static int* missions_done  = NULL; /**< Array (array.h): Saves position of completed missions. */
 static int* events_done  = NULL; /**< Array (array.h): Saves position of completed events. */
+static uint32_t* missions_doneBits = NULL; /**< Bitset (bitset.h) of the completed missions, mirrors missions_done. */
+static uint32_t* events_doneBits = NULL; /**< Bitset (bitset.h) of the completed events, mirrors events_done. */
 
 /*
  * prototypes
@@ -178,6 +181,7 @@ static int preemption = 0; /* Hyperspace target/untarget preemption. */
  * externed
  */
 int player_save( xmlTextWriterPtr writer ); /* save.c */
+int player_saveSummary( xmlTextWriterPtr writer ); /* save.c */
 Spob* player_load( xmlNodePtr parent ); /* save.c */
 
 /**
@@ -480,7 +484,8 @@ PlayerShip_t* player_newShip( const Ship* ship, const char *def_name,
    /* Update ship list if landed. */
    if (landed) {
       int w = land_getWid( LAND_WINDOW_EQUIPMENT );
-      equipment_regenLists( w, 0, 1 );
+      if (w > 0)
+         equipment_regenLists( w, 0, 1 );
    }
 
    return ps;
@@ -706,6 +711,25 @@ void player_rmPlayerShip( PlayerShip_t *ps )
    free( ps->acquired );
 }
 
+/**
+ * @brief Frees all the player's ships, including the current one.
+ *
+ * They are allocated from the pilot memory pool, so this has to be called
+ * before the pool is destroyed.
+ */
+void player_freeShips (void)
+{
+   if (player.ps.p != NULL)
+      player_rmPlayerShip( &player.ps );
+   memset( &player.ps, 0, sizeof(PlayerShip_t) );
+   player.p = NULL;
+
+   for (int i=0; i<array_size(player_stack); i++)
+      player_rmPlayerShip( &player_stack[i] );
+   array_free(player_stack);
+   player_stack = NULL;
+}
+
 /**
  * @brief Removes one of the player's ships.
  *
@@ -729,7 +753,8 @@ void player_rmShip( const char *shipname )
    /* Update ship list if landed. */
    if (landed) {
       int w = land_getWid( LAND_WINDOW_EQUIPMENT );
-      equipment_regenLists( w, 0, 1 );
+      if (w > 0)
+         equipment_regenLists( w, 0, 1 );
    }
 }
 
@@ -793,9 +818,13 @@ void player_cleanup (void)
 
    array_free(missions_done);
    missions_done = NULL;
+   array_free(missions_doneBits);
+   missions_doneBits = NULL;
 
    array_free(events_done);
    events_done = NULL;
+   array_free(events_doneBits);
+   events_doneBits = NULL;
 
    /* Clean up licenses. */
    for (int i=0; i<array_size(player_licenses); i++)
@@ -810,10 +839,7 @@ void player_cleanup (void)
    pilots_cleanAll();
 
    /* clean up the stack */
-   for (int i=0; i<array_size(player_stack); i++)
-      player_rmPlayerShip( &player_stack[i] );
-   array_free(player_stack);
-   player_stack = NULL;
+   player_freeShips();
    /* nothing left */
 
    /* Reset some player stuff. */
@@ -1061,6 +1087,7 @@ static void player_renderStealthUnderlay( double dt )
    col = cRed;
    col.a = 0.3;
    ps = pilot_getAll();
+   gl_batchBegin();
    for (int i=0; i<array_size(ps); i++) {
       double x, y, r;
       Pilot *t = ps[i];
@@ -1074,11 +1101,10 @@ static void player_renderStealthUnderlay( double dt )
 
       gl_gameToScreenCoords( &x, &y, t->solid.pos.x, t->solid.pos.y );
       r = detectz * t->stats.ew_detect;
-      if (r > 0.) {
-         glUseProgram( shaders.stealthaura.program );
-         gl_renderShader( x, y, r, r, 0., &shaders.stealthaura, &col, 1 );
-      }
+      if (r > 0.)
+         gl_renderMarker( OPENGL_MARKER_STEALTH, x, y, r, r, 0., &col );
    }
+   gl_batchEnd();
 }
 
 /**
@@ -2158,6 +2184,13 @@ void player_targetSet( unsigned int id )
    }
    gui_setTarget();
 
+   /* Likely to be hailed or boarded. */
+   if ((old != id) && (player.p->target != PLAYER_ID)) {
+      const Pilot *t = pilot_get( player.p->target );
+      if (t != NULL)
+         ship_prefetchCommGFX( t->ship );
+   }
+
    /* Clear the asteroid target. */
    player.p->nav_asteroid = -1;
    player.p->nav_anchor = -1;
@@ -2328,13 +2361,19 @@ void player_targetNearest (void)
 static int screenshot_cur = 0; /**< Current screenshot at. */
 /**
  * @brief Takes a screenshot.
+ *
+ *    @param func Function to call once the screenshot is written, may be NULL.
+ *    @param cleanup Function to release the data if func never gets called, may be NULL.
+ *    @param data Data to pass to the function.
  */
-void player_screenshot (void)
+void player_screenshot( gl_screenshotFunc func, gl_screenshotFree cleanup, void *data )
 {
    char filename[PATH_MAX];
 
    if (PHYSFS_mkdir("screenshots") == 0) {
       WARN(_("Aborting screenshot"));
+      if (func != NULL)
+         func( NULL, -1, data );
       return;
    }
 
@@ -2347,12 +2386,16 @@ void player_screenshot (void)
 
    if (screenshot_cur >= 999) { /* in case the crap system breaks :) */
       WARN(_("You have reached the maximum amount of screenshots [999]"));
+      if (func != NULL)
+         func( NULL, -1, data );
       return;
    }
 
-   /* now proceed to take the screenshot */
+   /* now proceed to take the screenshot, skipping its number right away
+    * as the file only appears once it is written. */
    DEBUG( _("Taking screenshot [%03d]..."), screenshot_cur );
-   gl_screenshot( filename );
+   gl_screenshot( filename, func, cleanup, data );
+   screenshot_cur++;
 }
 
 /**
@@ -2953,6 +2996,7 @@ void player_missionFinished( int id )
    if (missions_done == NULL)
       missions_done = array_create( int );
    array_push_back( &missions_done, id );
+   bitset_set( &missions_doneBits, id );
 
    qsort( missions_done, array_size(missions_done), sizeof(int), cmp_int );
 
@@ -2973,11 +3017,7 @@ void player_missionFinished( int id )
  */
 int player_missionAlreadyDone( int id )
 {
-   if (missions_done == NULL)
-      return 0;
-
-   const int *i = bsearch( &id, missions_done, array_size(missions_done), sizeof(int), cmp_int );
-   return i!=NULL;
+   return bitset_test( missions_doneBits, id );
 }
 
 /**
@@ -3007,6 +3047,7 @@ void player_eventFinished( int id )
    if (events_done == NULL)
       events_done = array_create( int );
    array_push_back( &events_done, id );
+   bitset_set( &events_doneBits, id );
 
    qsort( events_done, array_size(events_done), sizeof(int), cmp_int );
 
@@ -3026,11 +3067,7 @@ void player_eventFinished( int id )
  */
 int player_eventAlreadyDone( int id )
 {
-   if (events_done == NULL)
-      return 0;
-
-   const int *i = bsearch( &id, events_done, array_size(events_done), sizeof(int), cmp_int );
-   return i!=NULL;
+   return bitset_test( events_doneBits, id );
 }
 
 /**
@@ -3236,6 +3273,44 @@ static int player_saveEscorts( xmlTextWriterPtr writer )
    return 0;
 }
 
+/**
+ * @brief Saves the summary of the player shown by the load menu.
+ *
+ * It is written at the start of the save with the same layout as the player
+ *  node, so the load menu can list saves without parsing them whole.
+ *
+ *    @param writer xml Writer to use.
+ *    @return 0 on success.
+ */
+int player_saveSummary( xmlTextWriterPtr writer )
+{
+   int cycles, periods, seconds;
+   double rem;
+
+   xmlw_startElem(writer,"player_summary");
+   xmlw_attr(writer,"name","%s",player.name);
+   xmlw_elem(writer,"credits","%"CREDITS_PRI,player.p->credits);
+   xmlw_elem(writer,"chapter","%s",player.chapter);
+   if (player.difficulty != NULL)
+      xmlw_elem(writer,"difficulty","%s",player.difficulty);
+
+   xmlw_startElem(writer,"time");
+   ntime_getR( &cycles, &periods, &seconds, &rem );
+   xmlw_elem(writer,"SCU","%d", cycles);
+   xmlw_elem(writer,"STP","%d", periods);
+   xmlw_elem(writer,"STU","%d", seconds);
+   xmlw_endElem(writer); /* "time" */
+
+   xmlw_elem(writer, "location", "%s", land_spob->name);
+   xmlw_startElem(writer,"ship");
+   xmlw_attr(writer,"name","%s",player.p->name);
+   xmlw_attr(writer,"model","%s",player.p->ship->name);
+   xmlw_endElem(writer); /* "ship" */
+
+   xmlw_endElem(writer); /* "player_summary" */
+   return 0;
+}
+
 /**
  * @brief Save the freaking player in a freaking xmlfile.
  *
@@ -220,6 +220,7 @@ void player_swapShip( const char *shipname, int move_cargo );
 credits_t player_shipPrice( const char *shipname, int count_unique );
 void player_rmShip( const char *shipname );
 void player_rmPlayerShip( PlayerShip_t *ps );
+void player_freeShips (void);
 
 /*
  * Player outfits.
@@ -301,7 +302,7 @@ void player_weapSetPress( int id, double value, int repeat );
 int player_land( int loud );
 void player_approach (void);
 int player_jump (void);
-void player_screenshot (void);
+void player_screenshot( gl_screenshotFunc func, gl_screenshotFree cleanup, void *data );
 void player_accel( double acc );
 void player_accelOver (void);
 void player_hail (void);
@@ -47,6 +47,9 @@ static int func_think         = LUA_NOREF;
 static int func_update        = LUA_NOREF;
 static int func_enter         = LUA_NOREF;
 
+#define AUTONAV_FF_HOSTILE_DIST  10e3 /**< Minimum distance enemies have to be at to fast forward. */
+static int autonav_ff         = 0; /**< Whether or not the simulation is being fast forwarded. */
+
 /*
  * Prototypes.
  */
@@ -91,6 +94,7 @@ int player_autonavInit (void)
  */
 void player_autonavResetSpeed (void)
 {
+   autonav_ff = 0;
    player_resetSpeed();
 }
 
@@ -162,6 +166,7 @@ void player_autonavEnd (void)
       return;
 
    autonav_ending = 1;
+   autonav_ff = 0;
    player_rmFlag(PLAYER_AUTONAV);
    ovr_autonavClear();
    player_accelOver();
@@ -281,6 +286,9 @@ void player_autonavBoard( unsigned int p )
  */
 void player_autonavAbort( const char *reason )
 {
+   /* Fast forwarding stops right away, even for the rest of the frame. */
+   autonav_ff = 0;
+
    /* No point if player is beyond aborting. */
    if ((player.p==NULL) || pilot_isFlag(player.p, PILOT_HYPERSPACE))
       return;
@@ -409,6 +417,56 @@ void player_updateAutonav( double dt )
    }
 }
 
+/**
+ * @brief Decides whether or not to fast forward the simulation this frame.
+ *
+ * Fast forwarding is done when autonav is compressing time past the
+ *  autonav_fastforward option and there are no enemies near the player. The
+ *  simulation then uses coarse steps, skips cosmetic effects and runs AI
+ *  control ticks less often. It stops as soon as autonav is aborted, ended
+ *  or slowed down.
+ */
+void player_autonavFastForwardUpdate (void)
+{
+   Pilot *const* pilot_stack;
+   const IntList *il;
+   double r;
+
+   autonav_ff = 0;
+   if ((conf.autonav_fastforward <= 0.) || paused || (player.p==NULL) ||
+         !player_isFlag(PLAYER_AUTONAV) || player_isFlag(PLAYER_CINEMATICS) ||
+         space_isSimulation() ||
+         pilot_isFlag(player.p, PILOT_DEAD) || pilot_isDisabled(player.p) ||
+         pilot_isFlag(player.p, PILOT_HYPERSPACE) ||
+         pilot_isFlag(player.p, PILOT_HYP_END))
+      return;
+   if (dt_mod / player_dt_default() < conf.autonav_fastforward)
+      return;
+
+   /* No enemies nearby. */
+   r  = MAX( conf.autonav_reset_dist, AUTONAV_FF_HOSTILE_DIST );
+   il = pilot_getNearby( player.p->solid.pos.x, player.p->solid.pos.y, r );
+   pilot_stack = pilot_getAll();
+   for (int i=0; i<il_size(il); i++) {
+      const Pilot *p = pilot_stack[ il_get( il, i, 0 ) ];
+      if ((p == player.p) || pilot_isDisabled(p) || !pilot_canTarget(p))
+         continue;
+      if (vec2_dist2( &p->solid.pos, &player.p->solid.pos ) > pow2(r))
+         continue;
+      if (pilot_areEnemies( player.p, p ) || pilot_isHostile(p))
+         return;
+   }
+   autonav_ff = 1;
+}
+
+/**
+ * @brief Checks to see if the simulation is being fast forwarded by autonav.
+ */
+int player_autonavFastForward (void)
+{
+   return autonav_ff;
+}
+
 void player_autonavEnter (void)
 {
    /* Must be autonaving. */
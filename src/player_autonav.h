@@ -11,12 +11,17 @@ enum {
    AUTONAV_PILOT, /**< Player is going to a pilot. */
 };
 
+#define AUTONAV_FF_DT        0.25 /**< Time step used while fast forwarding. */
+#define AUTONAV_FF_AI_RATE   2.   /**< Factor of the AI control tick intervals while fast forwarding. */
+
 /* Initialization of the internal autonav stuff. */
 int player_autonavInit (void);
 
 /* Updating routines. */
 void player_thinkAutonav( Pilot *pplayer, double dt );
 void player_updateAutonav( double dt );
+void player_autonavFastForwardUpdate (void);
+int player_autonavFastForward (void);
 
 /* Control routines. */
 void player_autonavResetSpeed (void);
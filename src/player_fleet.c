@@ -94,7 +94,8 @@ int pfleet_toggleDeploy( PlayerShip_t *ps, int deploy )
    pfleet_update();
 
    /* Have to update GUI. */
-   equipment_updateShips( land_getWid( LAND_WINDOW_EQUIPMENT ), NULL );
+   if (land_getWid( LAND_WINDOW_EQUIPMENT ) > 0)
+      equipment_updateShips( land_getWid( LAND_WINDOW_EQUIPMENT ), NULL );
    return 0;
 }
 
@@ -267,22 +267,22 @@ int qt_insert (Quadtree* qt, int id, int x1, int y1, int x2, int y2 )
    return new_element;
 }
 
-void qt_remove( Quadtree* qt, int element )
+static void element_leaves( IntList* leaves, const Quadtree* qt, int element )
 {
-   // Find the leaves.
-   IntList leaves = {0};
-
    const int lft = il_get(&qt->elts, element, elt_idx_lft);
    const int top = il_get(&qt->elts, element, elt_idx_top);
    const int rgt = il_get(&qt->elts, element, elt_idx_rgt);
    const int btm = il_get(&qt->elts, element, elt_idx_btm);
 
-   il_create(&leaves, nd_num);
-   find_leaves(&leaves, qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx, qt->root_sy, lft, top, rgt, btm);
+   il_create(leaves, nd_num);
+   find_leaves(leaves, qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx, qt->root_sy, lft, top, rgt, btm);
+}
 
+static void element_unlink( Quadtree* qt, int element, const IntList* leaves )
+{
    // For each leaf node, remove the element node.
-   for (int j=0; j < il_size(&leaves); ++j) {
-      const int nd_index = il_get(&leaves, j, nd_idx_index);
+   for (int j=0; j < il_size(leaves); ++j) {
+      const int nd_index = il_get(leaves, j, nd_idx_index);
 
       // Walk the list until we find the element node.
       int node_index = il_get(&qt->nodes, nd_index, node_idx_fc);
@@ -305,23 +305,81 @@ void qt_remove( Quadtree* qt, int element )
          il_set(&qt->nodes, nd_index, node_idx_num, il_get(&qt->nodes, nd_index, node_idx_num)-1);
       }
    }
+}
+
+void qt_remove( Quadtree* qt, int element )
+{
+   // Find the leaves and remove the element node from them.
+   IntList leaves = {0};
+   element_leaves(&leaves, qt, element);
+   element_unlink(qt, element, &leaves);
    il_destroy(&leaves);
 
    // Remove the element.
    il_erase(&qt->elts, element);
 }
 
+void qt_move( Quadtree* qt, int element, int x1, int y1, int x2, int y2 )
+{
+   IntList old_leaves = {0}, new_leaves = {0};
+   int same;
+
+   // Nothing to do if the rectangle didn't change.
+   if (il_get(&qt->elts, element, elt_idx_lft) == x1 &&
+         il_get(&qt->elts, element, elt_idx_top) == y1 &&
+         il_get(&qt->elts, element, elt_idx_rgt) == x2 &&
+         il_get(&qt->elts, element, elt_idx_btm) == y2)
+      return;
+
+   // Compare the leaves the element is in with the ones it should be in. The
+   // traversal order is fixed so the same set of leaves comes out in the same order.
+   element_leaves(&old_leaves, qt, element);
+   il_create(&new_leaves, nd_num);
+   find_leaves(&new_leaves, qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx, qt->root_sy, x1, y1, x2, y2);
+   same = (il_size(&old_leaves) == il_size(&new_leaves));
+   for (int j=0; same && j < il_size(&old_leaves); ++j)
+      same = (il_get(&old_leaves, j, nd_idx_index) == il_get(&new_leaves, j, nd_idx_index));
+   il_destroy(&new_leaves);
+
+   // Only relink the element if it crossed a leaf boundary.
+   if (!same)
+      element_unlink(qt, element, &old_leaves);
+   il_destroy(&old_leaves);
+
+   il_set(&qt->elts, element, elt_idx_lft, x1);
+   il_set(&qt->elts, element, elt_idx_top, y1);
+   il_set(&qt->elts, element, elt_idx_rgt, x2);
+   il_set(&qt->elts, element, elt_idx_btm, y2);
+   if (!same)
+      node_insert(qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx, qt->root_sy, element);
+}
+
+void qt_set_id( Quadtree* qt, int element, int id )
+{
+   il_set(&qt->elts, element, elt_idx_id, id);
+}
+
 void qt_query( Quadtree* qt, IntList* out, int qlft, int qtop, int qrgt, int qbtm )
+{
+   QuadtreeScratch scratch = { .temp = qt->temp, .temp_size = qt->temp_size };
+   qt_query_scratch(qt, &scratch, out, qlft, qtop, qrgt, qbtm);
+   qt->temp = scratch.temp;
+   qt->temp_size = scratch.temp_size;
+}
+
+void qt_query_scratch( const Quadtree* qt, QuadtreeScratch* scratch, IntList* out, int qlft, int qtop, int qrgt, int qbtm )
 {
    // Find the leaves that intersect the specified query rectangle.
    IntList leaves = {0};
    const int elt_cap = il_size(&qt->elts);
+   char* temp;
 
-   if (qt->temp_size < elt_cap) {
-      qt->temp_size = elt_cap;
-      qt->temp = realloc(qt->temp, qt->temp_size * sizeof(*qt->temp));
-      memset(qt->temp, 0, qt->temp_size * sizeof(*qt->temp));
+   if (scratch->temp_size < elt_cap) {
+      scratch->temp_size = elt_cap;
+      scratch->temp = realloc(scratch->temp, scratch->temp_size * sizeof(*scratch->temp));
+      memset(scratch->temp, 0, scratch->temp_size * sizeof(*scratch->temp));
    }
+   temp = scratch->temp;
 
    // For each leaf node, look for elements that intersect.
    il_create(&leaves, nd_num);
@@ -339,9 +397,9 @@ void qt_query( Quadtree* qt, IntList* out, int qlft, int qtop, int qrgt, int qbt
          const int top = il_get(&qt->elts, element, elt_idx_top);
          const int rgt = il_get(&qt->elts, element, elt_idx_rgt);
          const int btm = il_get(&qt->elts, element, elt_idx_btm);
-         if (!qt->temp[element] && intersect(qlft,qtop,qrgt,qbtm, lft,top,rgt,btm)) {
+         if (!temp[element] && intersect(qlft,qtop,qrgt,qbtm, lft,top,rgt,btm)) {
             il_set(out, il_push_back(out), 0, element);
-            qt->temp[element] = 1;
+            temp[element] = 1;
          }
          elt_node_index = il_get(&qt->enodes, elt_node_index, enode_idx_next);
       }
@@ -352,11 +410,79 @@ void qt_query( Quadtree* qt, IntList* out, int qlft, int qtop, int qrgt, int qbt
    for (int j=0; j < il_size(out); ++j) {
       const int element = il_get(out, j, 0);
       const int id = il_get(&qt->elts, element, elt_idx_id);
-      qt->temp[element] = 0;
+      temp[element] = 0;
       il_set(out, j, 0, id);
    }
 }
 
+// Finds the leaf a point belongs to, routing it like find_leaves does.
+static int point_leaf( const Quadtree* qt, int x, int y )
+{
+   int node = 0;
+   int mx = qt->root_mx, my = qt->root_my;
+   int sx = qt->root_sx, sy = qt->root_sy;
+   while (il_get(&qt->nodes, node, node_idx_num) == -1) {
+      const int fc = il_get(&qt->nodes, node, node_idx_fc);
+      const int hx = sx >> 1, hy = sy >> 1;
+      if (y <= my) {
+         node = (x <= mx) ? fc+0 : fc+1;
+         my -= hy;
+      }
+      else {
+         node = (x <= mx) ? fc+2 : fc+3;
+         my += hy;
+      }
+      mx += (x <= mx) ? -hx : hx;
+      sx = hx;
+      sy = hy;
+   }
+   return node;
+}
+
+void qt_query_each( const Quadtree* qt, int qlft, int qtop, int qrgt, int qbtm, QtEltFunc* func, void* user_data )
+{
+   // Find the leaves that intersect the specified query rectangle.
+   IntList leaves = {0};
+   il_create(&leaves, nd_num);
+   find_leaves(&leaves, qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx, qt->root_sy, qlft, qtop, qrgt, qbtm);
+
+   for (int j=0; j < il_size(&leaves); ++j) {
+      const int nd_index = il_get(&leaves, j, nd_idx_index);
+      const int single = (il_size(&leaves) == 1);
+
+      int elt_node_index = il_get(&qt->nodes, nd_index, node_idx_fc);
+      while (elt_node_index != -1) {
+         const int element = il_get(&qt->enodes, elt_node_index, enode_idx_elt);
+         const int lft = il_get(&qt->elts, element, elt_idx_lft);
+         const int top = il_get(&qt->elts, element, elt_idx_top);
+         const int rgt = il_get(&qt->elts, element, elt_idx_rgt);
+         const int btm = il_get(&qt->elts, element, elt_idx_btm);
+         elt_node_index = il_get(&qt->enodes, elt_node_index, enode_idx_next);
+         if (!intersect(qlft,qtop,qrgt,qbtm, lft,top,rgt,btm))
+            continue;
+
+         // Elements spanning several leaves are only reported by the leaf
+         // holding the top-left corner of the intersection, which is always
+         // one of the leaves found, so no marks are needed.
+         if (!single && (point_leaf(qt, (lft > qlft) ? lft : qlft, (top > qtop) ? top : qtop) != nd_index))
+            continue;
+
+         if (func(user_data, il_get(&qt->elts, element, elt_idx_id))) {
+            il_destroy(&leaves);
+            return;
+         }
+      }
+   }
+   il_destroy(&leaves);
+}
+
+void qt_scratch_destroy( QuadtreeScratch* scratch )
+{
+   free(scratch->temp);
+   scratch->temp = NULL;
+   scratch->temp_size = 0;
+}
+
 void qt_cleanup( Quadtree* qt )
 {
    IntList to_process = {0};
@@ -46,6 +46,18 @@ struct Quadtree
    int temp_size;
 };
 
+// Temporary buffer used for queries. Each thread querying the same tree at the
+// same time needs its own.
+typedef struct QuadtreeScratch
+{
+   char* temp;
+   int temp_size;
+} QuadtreeScratch;
+
+// Function signature used for visiting the elements found by a query. Returning
+// nonzero stops the query.
+typedef int QtEltFunc( void* user_data, int id );
+
 // Function signature used for traversing a tree node.
 typedef void QtNodeFunc( Quadtree* qt, void* user_data, int node, int depth, int mx, int my, int sx, int sy );
 
@@ -65,12 +77,31 @@ int qt_insert( Quadtree* qt, int id, int x1, int y1, int x2, int y2 );
 // Removes the specified element from the tree.
 void qt_remove( Quadtree* qt, int element );
 
+// Moves the specified element to a new rectangle. The element is only relinked
+// when it ends up in different leaves, and keeps its index.
+void qt_move( Quadtree* qt, int element, int x1, int y1, int x2, int y2 );
+
+// Changes the ID of the specified element.
+void qt_set_id( Quadtree* qt, int element, int id );
+
 // Cleans up the tree, removing empty leaves.
 void qt_cleanup( Quadtree* qt );
 
 // Outputs a list of elements found in the specified rectangle.
 void qt_query( Quadtree* qt, IntList* out, int x1, int y1, int x2, int y2 );
 
+// Same as qt_query, but uses the provided temporary buffer instead of the tree's
+// so that the tree can be queried from multiple threads at the same time.
+void qt_query_scratch( const Quadtree* qt, QuadtreeScratch* scratch, IntList* out, int x1, int y1, int x2, int y2 );
+
+// Calls 'func' with the ID of each element found in the specified rectangle,
+// without building a list or needing a temporary buffer. 'func' must not
+// modify the tree.
+void qt_query_each( const Quadtree* qt, int x1, int y1, int x2, int y2, QtEltFunc* func, void* user_data );
+
+// Frees the temporary query buffer.
+void qt_scratch_destroy( QuadtreeScratch* scratch );
+
 // Traverses all the nodes in the tree, calling 'branch' for branch nodes and 'leaf'
 // for leaf nodes.
 void qt_traverse( Quadtree* qt, void* user_data, QtNodeFunc* branch, QtNodeFunc* leaf);
@@ -6,6 +6,7 @@
 #include "array.h"
 #include "conf.h"
 #include "font.h"
+#include "frametime.h"
 #include "gui.h"
 #include "hook.h"
 #include "map_overlay.h"
@@ -34,6 +35,7 @@ typedef struct PPShader_s {
    int priority; /**< Used when sorting, lower is more important. */
    unsigned int flags; /**< Flags to use. */
    double dt; /**< Used when computing u_time. */
+   int skip; /**< Whether the shader is currently a no-op and can be skipped. */
    GLuint program; /**< Main shader program. */
    /* Shared uniforms. */
    GLint ClipSpaceFromLocal;
@@ -51,13 +53,24 @@ typedef struct PPShader_s {
 static unsigned int pp_shaders_id = 0;
 static PPShader *pp_shaders_list[PP_LAYER_MAX]; /**< Post-processing shaders for game layer. */
 
+#define PP_SCALE_MAX  3 /**< Full, half and quarter resolution. */
+
+/**
+ * @brief Reduced resolution buffers for post-processing, index 0 is full
+ * resolution and uses the gl_screen framebuffers.
+ */
+static GLuint pp_fbo[PP_SCALE_MAX][2];
+static GLuint pp_fbo_tex[PP_SCALE_MAX][2];
+static int pp_fbo_w[PP_SCALE_MAX]; /**< Width the buffers were created at. */
+static int pp_fbo_h[PP_SCALE_MAX]; /**< Height the buffers were created at. */
+
 static LuaShader_t gamma_correction_shader;
 static int pp_gamma_correction = 0; /**< Gamma correction shader. */
 
 /**
  * @brief Renders an FBO.
  */
-static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader )
+static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader, int scale )
 {
    /* Have to consider alpha premultiply. */
    glBlendFuncSeparate( GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
@@ -69,7 +82,7 @@ static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader )
    /* Screen size. */
    if (shader->love_ScreenSize >= 0)
       /* TODO don't have to upload this every frame, only when resized... */
-      glUniform4f( shader->love_ScreenSize, SCREEN_W, SCREEN_H, 1., 0. );
+      glUniform4f( shader->love_ScreenSize, SCREEN_W>>scale, SCREEN_H>>scale, 1., 0. );
 
    /* Time stuff. */
    if (shader->u_time >= 0) {
@@ -101,7 +114,7 @@ static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader )
    gl_uniformMat4(shader->ClipSpaceFromLocal, &ortho);
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shader->VertexPosition );
@@ -113,39 +126,136 @@ static void render_fbo( double dt, GLuint fbo, GLuint tex, PPShader *shader )
    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 }
 
+/**
+ * @brief Gets the resolution scale a post-processing shader runs at.
+ */
+static int render_ppScale( const PPShader *pp )
+{
+   if (pp->flags & PP_SHADER_QUARTER)
+      return 2;
+   if (pp->flags & PP_SHADER_HALF)
+      return 1;
+   return 0;
+}
+
+/**
+ * @brief Gets a post-processing buffer, creating the reduced resolution ones
+ * as necessary.
+ *
+ *    @param scale Resolution scale (0 is full, 1 is half, 2 is quarter).
+ *    @param i Which of the two buffers to get.
+ *    @param[out] fbo Framebuffer.
+ *    @param[out] tex Texture of the framebuffer.
+ */
+static void render_ppBuffer( int scale, int i, GLuint *fbo, GLuint *tex )
+{
+   int w, h;
+
+   if (scale == 0) {
+      *fbo = gl_screen.fbo[i];
+      *tex = gl_screen.fbo_tex[i];
+      return;
+   }
+
+   /* Recreate if the window has been resized. */
+   w = MAX( 1, gl_screen.rw >> scale );
+   h = MAX( 1, gl_screen.rh >> scale );
+   if ((pp_fbo_w[scale] != w) || (pp_fbo_h[scale] != h)) {
+      for (int j=0; j<2; j++) {
+         if (pp_fbo_w[scale] > 0) {
+            glDeleteFramebuffers( 1, &pp_fbo[scale][j] );
+            glDeleteTextures( 1, &pp_fbo_tex[scale][j] );
+         }
+         gl_fboCreate( &pp_fbo[scale][j], &pp_fbo_tex[scale][j], w, h );
+      }
+      pp_fbo_w[scale] = w;
+      pp_fbo_h[scale] = h;
+   }
+
+   *fbo = pp_fbo[scale][i];
+   *tex = pp_fbo_tex[scale][i];
+}
+
+/**
+ * @brief Upscales a reduced resolution buffer into a full resolution one.
+ */
+static void render_ppBlit( int scale, int i, GLuint dst )
+{
+   int w = MAX( 1, gl_screen.rw >> scale );
+   int h = MAX( 1, gl_screen.rh >> scale );
+   glBindFramebuffer( GL_READ_FRAMEBUFFER, (scale==0) ? gl_screen.fbo[i] : pp_fbo[scale][i] );
+   glBindFramebuffer( GL_DRAW_FRAMEBUFFER, dst );
+   glBlitFramebuffer( 0, 0, w, h, 0, 0, gl_screen.rw, gl_screen.rh,
+         GL_COLOR_BUFFER_BIT, (scale==0) ? GL_NEAREST : GL_LINEAR );
+   glBindFramebuffer( GL_FRAMEBUFFER, dst );
+}
+
 /**
  * @brief Renders a list of FBOs.
+ *
+ * Shaders flagged as half or quarter resolution render into smaller buffers,
+ * and consecutive shaders at the same scale are chained without going back to
+ * full resolution in between. The next full resolution shader just samples the
+ * reduced buffer, so an explicit upscale is only needed when the chain ends.
+ * Shaders marked as skipped are not rendered at all.
  */
 static void render_fbo_list( double dt, PPShader *list, int *current, int done )
 {
-   PPShader *pplast;
-   int i, cur, next;
-   cur = *current;
-
-   /* Render all except the last post-process shader. */
-   for (i=0; i<array_size(list)-1; i++) {
+   int last, cur, scale;
+   GLuint fbo, tex, src;
+
+   /* Find the last shader that does something. */
+   last = -1;
+   for (int i=0; i<array_size(list); i++)
+      if (!list[i].skip)
+         last = i;
+
+   cur   = *current;
+   scale = 0;
+   for (int i=0; i<=last; i++) {
       PPShader *pp = &list[i];
-      next = 1-cur;
-      /* Render cur to next. */
-      render_fbo( dt, gl_screen.fbo[next], gl_screen.fbo_tex[cur], pp );
-      cur = next;
+      int s, next;
+
+      if (pp->skip)
+         continue;
+      render_ppBuffer( scale, cur, &fbo, &src );
+
+      /* Final full resolution render is to the screen. */
+      s = render_ppScale( pp );
+      if (done && (i==last) && (s==0)) {
+         gl_screen.current_fbo = 0;
+         render_fbo( dt, gl_screen.current_fbo, src, pp, 0 );
+         glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
+         return;
+      }
+
+      /* Render cur to next, when changing scale both buffers are free. */
+      next = (s==scale) ? 1-cur : 0;
+      render_ppBuffer( s, next, &fbo, &tex );
+      if (s > 0) {
+         glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+         glViewport( 0, 0, pp_fbo_w[s], pp_fbo_h[s] );
+         glClear( GL_COLOR_BUFFER_BIT );
+      }
+      render_fbo( dt, fbo, src, pp, s );
+      if (s > 0)
+         glViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+      cur   = next;
+      scale = s;
    }
 
-   /* Final render is to the screen. */
-   pplast = &list[i];
+   /* Nothing rendered to the screen yet, so copy the result over. */
    if (done) {
       gl_screen.current_fbo = 0;
-      /* Do the render. */
-      render_fbo( dt, gl_screen.current_fbo, gl_screen.fbo_tex[cur], pplast );
-      glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
+      render_ppBlit( scale, cur, gl_screen.current_fbo );
       return;
-
    }
 
-   /* Draw the last shader. */
-   next = 1-cur;
-   render_fbo( dt, gl_screen.fbo[next], gl_screen.fbo_tex[cur], pplast );
-   cur = next;
+   /* Chain ended at a reduced resolution, bring it back to full resolution. */
+   if (scale > 0) {
+      render_ppBlit( scale, cur, gl_screen.fbo[0] );
+      cur = 0;
+   }
 
    /* Set the framebuffer again. */
    gl_screen.current_fbo = gl_screen.fbo[cur];
@@ -155,6 +265,15 @@ static void render_fbo_list( double dt, PPShader *list, int *current, int done )
    *current = cur;
 }
 
+/**
+ * @brief Ends a render stage on both the CPU and the GPU.
+ */
+static void render_stage( FrameStage stage, Uint64 *mark )
+{
+   frametime_add( stage, mark );
+   gl_timerMark( stage );
+}
+
 /**
  * @brief Renders the game itself (player flying around and friends).
  *
@@ -180,6 +299,15 @@ void render_all( double game_dt, double real_dt )
    double dt;
    int pp_core, pp_final, pp_gui, pp_game;
    int cur = 0;
+   Uint64 mark = frametime_mark();
+
+   /* Start timing the frame on the GPU, and move the streamed VBOs on. */
+   gl_timerFrameStart();
+   gl_vboRingFrame();
+   gl_screenshotUpdate( 0 );
+
+   /* Per frame data shared by the shaders. */
+   gl_updateFrameUniforms( real_dt );
 
    /* See what post-processing is up. */
    pp_game  = (array_size(pp_shaders_list[PP_LAYER_GAME]) > 0);
@@ -215,45 +343,65 @@ void render_all( double game_dt, double real_dt )
    /* Background stuff */
    space_render( real_dt ); /* Nebula looks really weird otherwise. */
    render_reset(); /* space_render can use a lua background. */
+   render_stage( FRAME_RENDER_BACKGROUND, &mark );
    NTracingZoneName( _ctx_renderbg, "hooks[renderbg]", 1 );
    hooks_run( "renderbg" );
    NTracingZoneEnd( _ctx_renderbg );
    render_reset();
+   render_stage( FRAME_RENDER_HOOKS, &mark );
+   /* Visibility pass, the lists get reused by the overlays. */
+   pilots_cull();
+   render_stage( FRAME_RENDER_PILOTS, &mark );
+   asteroids_cull();
    spobs_render();
+   render_stage( FRAME_RENDER_SPOBS, &mark );
    spfx_render(SPFX_LAYER_BACK, dt);
+   render_stage( FRAME_RENDER_SPFX, &mark );
    weapons_render(WEAPON_LAYER_BG, dt);
+   render_stage( FRAME_RENDER_WEAPONS, &mark );
    /* Middle stuff */
    player_renderUnderlay(dt);
    pilots_render();
+   render_stage( FRAME_RENDER_PILOTS, &mark );
    spfx_render(SPFX_LAYER_MIDDLE, dt);
+   render_stage( FRAME_RENDER_SPFX, &mark );
    weapons_render(WEAPON_LAYER_FG, dt);
+   render_stage( FRAME_RENDER_WEAPONS, &mark );
    /* Foreground stuff */
    player_render(dt);
+   render_stage( FRAME_RENDER_PILOTS, &mark );
    spfx_render(SPFX_LAYER_FRONT, dt);
+   render_stage( FRAME_RENDER_SPFX, &mark );
    space_renderOverlay(dt);
    render_reset(); /* space_render can use a lua background. */
+   render_stage( FRAME_RENDER_SPOBS, &mark );
    gui_renderReticles(dt);
    pilots_renderOverlay();
+   render_stage( FRAME_RENDER_GUI, &mark );
    NTracingZoneName( _ctx_renderfg, "hooks[renderfg]", 1 );
    hooks_run( "renderfg" );
    NTracingZoneEnd( _ctx_renderfg );
    render_reset();
+   render_stage( FRAME_RENDER_HOOKS, &mark );
 
    /* Process game stuff only. */
    if (pp_game) {
       NTracingZoneName( _ctx_pp_game, "postprocess_shader[game]", 1 );
       render_fbo_list( dt, pp_shaders_list[PP_LAYER_GAME], &cur, !(pp_core || pp_final || pp_gui) );
       NTracingZoneEnd( _ctx_pp_game );
+      render_stage( FRAME_RENDER_POSTPROCESS, &mark );
    }
 
    /* GUi stuff. */
    gui_render(dt);
    render_reset();
+   render_stage( FRAME_RENDER_GUI, &mark );
 
    if (pp_gui) {
       NTracingZoneName( _ctx_pp_gui, "postprocess_shader[gui]", 1 );
       render_fbo_list( dt, pp_shaders_list[PP_LAYER_GUI], &cur, !(pp_core || pp_final) );
       NTracingZoneEnd( _ctx_pp_gui );
+      render_stage( FRAME_RENDER_POSTPROCESS, &mark );
    }
 
    /* We set the to fullscreen, ignoring the GUI modifications. */
@@ -261,29 +409,36 @@ void render_all( double game_dt, double real_dt )
 
    /* Top stuff. */
    ovr_render( real_dt ); /* Using real_dt is sort of a hack for now. */
+   render_stage( FRAME_RENDER_GUI, &mark );
    NTracingZoneName( _ctx_rendertop, "hooks[rendertop]", 1 );
    hooks_run( "rendertop" );
    NTracingZoneEnd( _ctx_rendertop );
    render_reset();
+   render_stage( FRAME_RENDER_HOOKS, &mark );
    fps_display( real_dt ); /* Exception using real_dt. */
+   render_stage( FRAME_RENDER_GUI, &mark );
    if (!menu_open)
       toolkit_render( real_dt );
+   render_stage( FRAME_RENDER_TOOLKIT, &mark );
 
    /* Final post-processing. */
    if (pp_final) {
       NTracingZoneName( _ctx_pp_final, "postprocess_shader[final]", 1 );
       render_fbo_list( dt, pp_shaders_list[PP_LAYER_FINAL], &cur, !(pp_core) );
       NTracingZoneEnd( _ctx_pp_final );
+      render_stage( FRAME_RENDER_POSTPROCESS, &mark );
    }
 
    if (menu_open)
       toolkit_render( real_dt );
+   render_stage( FRAME_RENDER_TOOLKIT, &mark );
 
    /* Final post-processing. */
    if (pp_core) {
       NTracingZoneName( _ctx_pp_core, "postprocess_shader[core]", 1 );
       render_fbo_list( dt, pp_shaders_list[PP_LAYER_CORE], &cur, 1 );
       NTracingZoneEnd( _ctx_pp_core );
+      render_stage( FRAME_RENDER_POSTPROCESS, &mark );
    }
 
    /* check error every loop */
@@ -347,6 +502,7 @@ unsigned int render_postprocessAdd( LuaShader_t *shader, int layer, int priority
    pp->u_time = glGetUniformLocation( pp->program, "u_time" );
    pp->love_ScreenSize = glGetUniformLocation( pp->program, "love_ScreenSize" );
    pp->dt = 0.;
+   pp->skip = 0;
 
    /* Resort n case stuff is weird. */
    qsort( *pp_shaders, array_size(*pp_shaders), sizeof(PPShader), ppshader_compare );
@@ -389,6 +545,32 @@ int render_postprocessRm( unsigned int id )
    return 0;
 }
 
+/**
+ * @brief Marks a post-process shader as being skipped or not.
+ *
+ * Skipped shaders stay registered but are not rendered, which is useful for
+ * shaders that know their output is unchanged (such as effects at zero
+ * intensity) and avoids a full screen pass.
+ *
+ *    @param id ID of the shader to modify.
+ *    @param skip Whether or not to skip the shader.
+ *    @return 0 on success.
+ */
+int render_postprocessSkip( unsigned int id, int skip )
+{
+   for (int j=0; j<PP_LAYER_MAX; j++) {
+      PPShader *pp_shaders = pp_shaders_list[j];
+      for (int i=0; i<array_size(pp_shaders); i++) {
+         PPShader *pp = &pp_shaders[i];
+         if (pp->id != id)
+            continue;
+         pp->skip = skip;
+         return 0;
+      }
+   }
+   return -1;
+}
+
 /**
  * @brief Cleans up the post-processing shaders.
  */
@@ -431,6 +613,14 @@ void render_exit (void)
       array_free( pp_shaders_list[i] );
       pp_shaders_list[i] = NULL;
    }
+   for (int i=1; i<PP_SCALE_MAX; i++) {
+      if (pp_fbo_w[i] <= 0)
+         continue;
+      glDeleteFramebuffers( 2, pp_fbo[i] );
+      glDeleteTextures( 2, pp_fbo_tex[i] );
+      pp_fbo_w[i] = 0;
+      pp_fbo_h[i] = 0;
+   }
 }
 
 /**
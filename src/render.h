@@ -15,6 +15,8 @@ enum {
 };
 
 #define PP_SHADER_PERMANENT   (1<<0)   /**< Shader doesn't get removed on main menu / death. */
+#define PP_SHADER_HALF        (1<<1)   /**< Shader is run at half resolution. */
+#define PP_SHADER_QUARTER     (1<<2)   /**< Shader is run at quarter resolution. */
 
 void fps_setPos( double x, double y );
 void render_all( double game_dt, double real_dt );
@@ -23,6 +25,7 @@ void render_exit (void);
 
 unsigned int render_postprocessAdd( LuaShader_t *shader, int layer, int priority, unsigned int flags );
 int render_postprocessRm( unsigned int id );
+int render_postprocessSkip( unsigned int id, int skip );
 void render_postprocessCleanup (void);
 
 /* Special post-processing shaders. */
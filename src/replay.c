@@ -0,0 +1,338 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file replay.c
+ *
+ * @brief Records and replays what makes a session nondeterministic.
+ *
+ * A recording starts with the random seed, followed by the duration of every
+ *  frame, the input events polled and the values Lua got from the clocks,
+ *  all in the order they were used. Replaying feeds them back in the same
+ *  order, without limiting the frame rate, so that a session can be
+ *  profiled again as fast as it runs. It has to be replayed with the same
+ *  build, data and configuration it was recorded with; if the game asks for
+ *  something else than what was recorded next, the replay stops.
+ *
+ * Events generated by the game itself, such as the toolkit ones, are not
+ *  recorded as they will be generated again when replaying.
+ */
+/** @cond */
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "replay.h"
+
+#include "frametime.h"
+#include "log.h"
+#include "rng.h"
+
+#define REPLAY_MAGIC    "NRPL" /**< Identifies replay files. */
+#define REPLAY_VERSION  1      /**< Version of the format. */
+
+/**
+ * @brief Type of the records.
+ */
+typedef enum ReplayTag_ {
+   REPLAY_TAG_NONE,  /**< No record read ahead. */
+   REPLAY_TAG_FRAME, /**< Frame duration, a double. */
+   REPLAY_TAG_EVENT, /**< Input event, a SDL_Event. */
+   REPLAY_TAG_VALUE, /**< Value read by Lua, a double. */
+} ReplayTag;
+
+/**
+ * @brief Header of the replay files.
+ */
+typedef struct ReplayHeader_ {
+   char magic[4];       /**< REPLAY_MAGIC. */
+   uint32_t version;    /**< REPLAY_VERSION. */
+   uint32_t event_size; /**< Size of the events, changes with the SDL version. */
+   uint32_t seed;       /**< Random seed. */
+   uint64_t ticks;      /**< Ticks when recording started. */
+} ReplayHeader;
+
+static SDL_RWops *replay_rw   = NULL; /**< File being recorded or replayed. */
+static int replay_recording   = 0; /**< Whether or not recording. */
+static int replay_replaying   = 0; /**< Whether or not replaying. */
+static ReplayTag replay_next  = REPLAY_TAG_NONE; /**< Tag of the record read ahead. */
+static double replay_ms       = 0.; /**< Virtual clock in ms, advanced by the frames. */
+static unsigned int replay_frames = 0; /**< Frames recorded or replayed. */
+static Uint64 replay_start    = 0; /**< Real ticks when replaying started. */
+
+/*
+ * Prototypes.
+ */
+static int replay_isInput( const SDL_Event *event );
+static void replay_write( ReplayTag tag, const void *data, size_t size );
+static ReplayTag replay_peek (void);
+static int replay_read( ReplayTag tag, void *data, size_t size );
+static void replay_finish( int desync );
+
+/**
+ * @brief Checks to see if an event comes from the player, and has to be recorded.
+ */
+static int replay_isInput( const SDL_Event *event )
+{
+   /* Keyboard, mouse, joystick and controller events. */
+   return (event->type >= SDL_KEYDOWN) && (event->type < SDL_FINGERDOWN);
+}
+
+/**
+ * @brief Starts recording.
+ *
+ *    @param path File to record to.
+ *    @return 0 on success.
+ */
+int replay_record( const char *path )
+{
+   ReplayHeader h;
+
+   replay_stop();
+   replay_rw = SDL_RWFromFile( path, "wb" );
+   if (replay_rw == NULL) {
+      WARN(_("Unable to open '%s' for recording: %s"), path, SDL_GetError());
+      return -1;
+   }
+
+   memcpy( h.magic, REPLAY_MAGIC, sizeof(h.magic) );
+   h.version    = REPLAY_VERSION;
+   h.event_size = sizeof(SDL_Event);
+   h.seed       = randint();
+   h.ticks      = SDL_GetTicks64();
+   SDL_RWwrite( replay_rw, &h, sizeof(h), 1 );
+
+   rng_seed( h.seed );
+   replay_ms        = (double)h.ticks;
+   replay_frames    = 0;
+   replay_recording = 1;
+   LOG(_("Recording replay to '%s'."), path);
+   return 0;
+}
+
+/**
+ * @brief Starts replaying.
+ *
+ *    @param path File to replay.
+ *    @return 0 on success.
+ */
+int replay_play( const char *path )
+{
+   ReplayHeader h;
+
+   replay_stop();
+   replay_rw = SDL_RWFromFile( path, "rb" );
+   if (replay_rw == NULL) {
+      WARN(_("Unable to open replay '%s': %s"), path, SDL_GetError());
+      return -1;
+   }
+   if ((SDL_RWread( replay_rw, &h, sizeof(h), 1 ) != 1) ||
+         (memcmp( h.magic, REPLAY_MAGIC, sizeof(h.magic) ) != 0)) {
+      WARN(_("'%s' is not a replay!"), path);
+      replay_stop();
+      return -1;
+   }
+   if ((h.version != REPLAY_VERSION) || (h.event_size != sizeof(SDL_Event))) {
+      WARN(_("Replay '%s' was recorded with an incompatible version!"), path);
+      replay_stop();
+      return -1;
+   }
+
+   rng_seed( h.seed );
+   replay_ms        = (double)h.ticks;
+   replay_frames    = 0;
+   replay_next      = REPLAY_TAG_NONE;
+   replay_start     = SDL_GetTicks64();
+   replay_replaying = 1;
+
+   /* The point of replaying is to look at the performance. */
+   frametime_setEnabled( 1 );
+   LOG(_("Replaying '%s'."), path);
+   return 0;
+}
+
+/**
+ * @brief Stops recording or replaying.
+ */
+void replay_stop (void)
+{
+   if (replay_rw != NULL)
+      SDL_RWclose( replay_rw );
+   replay_rw        = NULL;
+   replay_recording = 0;
+   replay_replaying = 0;
+   replay_next      = REPLAY_TAG_NONE;
+}
+
+/**
+ * @brief Checks to see if recording.
+ */
+int replay_isRecording (void)
+{
+   return replay_recording;
+}
+
+/**
+ * @brief Checks to see if replaying.
+ */
+int replay_isReplaying (void)
+{
+   return replay_replaying;
+}
+
+/**
+ * @brief Writes a record.
+ */
+static void replay_write( ReplayTag tag, const void *data, size_t size )
+{
+   Uint8 t = tag;
+   if ((SDL_RWwrite( replay_rw, &t, 1, 1 ) != 1) ||
+         (SDL_RWwrite( replay_rw, data, size, 1 ) != 1)) {
+      WARN(_("Failed to write replay: %s"), SDL_GetError());
+      replay_stop();
+   }
+}
+
+/**
+ * @brief Reads ahead the tag of the next record.
+ *
+ *    @return Tag of the next record, REPLAY_TAG_NONE at the end.
+ */
+static ReplayTag replay_peek (void)
+{
+   Uint8 t;
+   if (replay_next != REPLAY_TAG_NONE)
+      return replay_next;
+   if (SDL_RWread( replay_rw, &t, 1, 1 ) != 1)
+      return REPLAY_TAG_NONE;
+   replay_next = t;
+   return replay_next;
+}
+
+/**
+ * @brief Reads a record, which must be of the type expected.
+ *
+ *    @return 0 on success.
+ */
+static int replay_read( ReplayTag tag, void *data, size_t size )
+{
+   ReplayTag next = replay_peek();
+   if (next == REPLAY_TAG_NONE) {
+      replay_finish( 0 );
+      return -1;
+   }
+   if (next != tag) {
+      replay_finish( 1 );
+      return -1;
+   }
+   replay_next = REPLAY_TAG_NONE;
+   if (SDL_RWread( replay_rw, data, size, 1 ) != 1) {
+      replay_finish( 0 );
+      return -1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Ends the replay and quits.
+ *
+ *    @param desync Whether the game stopped following the replay.
+ */
+static void replay_finish( int desync )
+{
+   double wall = (double)(SDL_GetTicks64() - replay_start) / 1000.;
+   if (desync)
+      WARN(_("Replay desynchronized after %u frames!"), replay_frames);
+   LOG(_("Replayed %u frames in %.3f s."), replay_frames, wall);
+   replay_stop();
+   naev_quit();
+}
+
+/**
+ * @brief Polls for events, to be used instead of SDL_PollEvent.
+ *
+ * When replaying, the recorded input is returned instead of the real one.
+ * All the events of a frame are returned before the next frame starts.
+ *
+ *    @param[out] event Event polled.
+ *    @return 1 if there was an event.
+ */
+int replay_pollEvent( SDL_Event *event )
+{
+   if (replay_replaying) {
+      /* Let through what the game generates and quitting. */
+      while (SDL_PollEvent( event )) {
+         if (!replay_isInput( event ))
+            return 1;
+      }
+      if (replay_peek() != REPLAY_TAG_EVENT)
+         return 0;
+      return (replay_read( REPLAY_TAG_EVENT, event, sizeof(SDL_Event) ) == 0);
+   }
+
+   if (!SDL_PollEvent( event ))
+      return 0;
+   if (replay_recording && replay_isInput( event ))
+      replay_write( REPLAY_TAG_EVENT, event, sizeof(SDL_Event) );
+   return 1;
+}
+
+/**
+ * @brief Starts a frame.
+ *
+ *    @param dt Measured duration of the frame.
+ *    @return Duration of the frame to use.
+ */
+double replay_frame( double dt )
+{
+   if (replay_recording)
+      replay_write( REPLAY_TAG_FRAME, &dt, sizeof(dt) );
+   else if (replay_replaying) {
+      double rdt;
+      /* Events the game did not poll in time are dropped. */
+      while (replay_peek() == REPLAY_TAG_EVENT) {
+         SDL_Event event;
+         replay_read( REPLAY_TAG_EVENT, &event, sizeof(event) );
+      }
+      if (replay_read( REPLAY_TAG_FRAME, &rdt, sizeof(rdt) ) == 0)
+         dt = rdt;
+   }
+   else
+      return dt;
+
+   replay_ms += dt * 1000.;
+   replay_frames++;
+   return dt;
+}
+
+/**
+ * @brief Records or replays a value that is not deterministic.
+ *
+ *    @param value Real value.
+ *    @return Value to use.
+ */
+double replay_value( double value )
+{
+   if (replay_recording)
+      replay_write( REPLAY_TAG_VALUE, &value, sizeof(value) );
+   else if (replay_replaying) {
+      double v;
+      if (replay_read( REPLAY_TAG_VALUE, &v, sizeof(v) ) == 0)
+         return v;
+   }
+   return value;
+}
+
+/**
+ * @brief Gets the ticks in ms, to be used instead of SDL_GetTicks.
+ *
+ * When recording or replaying, the ticks follow the frame durations so
+ *  that they are the same in both.
+ */
+Uint64 replay_ticks (void)
+{
+   if (replay_recording || replay_replaying)
+      return (Uint64)replay_ms;
+   return SDL_GetTicks64();
+}
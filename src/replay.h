@@ -0,0 +1,21 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include "SDL.h"
+/** @endcond */
+
+/* Starting and stopping. */
+int replay_record( const char *path );
+int replay_play( const char *path );
+void replay_stop (void);
+int replay_isRecording (void);
+int replay_isReplaying (void);
+
+/* Sources of nondeterminism. */
+int replay_pollEvent( SDL_Event *event );
+double replay_frame( double dt );
+double replay_value( double value );
+Uint64 replay_ticks (void);
@@ -6,15 +6,20 @@
  *
  * @brief Handles all the random number logic.
  *
- * Random numbers are currently generated using the mersenne twister.
+ * Random numbers are currently generated using the mersenne twister, which
+ *  has global state and is only to be used from the main thread. Parallel code
+ *  uses counter based streams (RngStream) instead, either its own for
+ *  deterministic results or the one of the thread.
  */
 /** @cond */
 #include <errno.h>
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include "SDL.h"
+#include <stdatomic.h>
 
 #include "naev.h"
 
@@ -35,10 +40,20 @@
 /*
  * mersenne twister state
  */
-static uint32_t MT[624]; /**< Mersenne twister state. */
+#define MT_N   RNG_STATE_WORDS /**< Size of the mersenne twister state. */
+#define MT_M   397 /**< Offset of the word mixed in when regenerating. */
+static uint32_t MT[MT_N]; /**< Mersenne twister state. */
 static uint32_t mt_y; /**< Internal mersenne twister variable. */
 static int mt_pos = 0; /**< Current number being used. */
 
+/*
+ * Streams.
+ */
+static _Thread_local RngStream rng_threadStream; /**< Stream of the thread. */
+static _Thread_local int rng_threadInit = 0; /**< Whether the stream of the thread is set up. */
+static atomic_uint rng_threadNum = 0; /**< Streams given to threads so far. */
+static uint64_t rng_threadSeed = 0; /**< Seed of the thread streams. */
+
 /*
  * prototypes
  */
@@ -47,6 +62,7 @@ static uint32_t rng_timeEntropy (void);
 static void mt_initArray( uint32_t seed );
 static void mt_genArray (void);
 static uint32_t mt_getInt (void);
+static inline void mt_genRange( int start, int end, int offset );
 
 /**
  * @fn void rng_init (void)
@@ -80,6 +96,51 @@ void rng_init (void)
       mt_initArray( i );
    for (i=0; i<10; i++) /* generate numbers to get away from poor initial values */
       mt_genArray();
+
+   rng_threadSeed = ((uint64_t)mt_getInt() << 32) | mt_getInt();
+}
+
+/**
+ * @brief Seeds the random subsystem, so the same numbers get generated.
+ *
+ *    @param seed Seed to use.
+ */
+void rng_seed( uint32_t seed )
+{
+   mt_initArray( seed );
+   for (int i=0; i<10; i++) /* generate numbers to get away from poor initial values */
+      mt_genArray();
+
+   rng_threadSeed = seed;
+}
+
+/**
+ * @brief Gets the state of the main generator.
+ *
+ * Streams handed out to threads are not part of it.
+ *
+ *    @param[out] state State to fill.
+ */
+void rng_getState( RngState *state )
+{
+   memcpy( state->mt, MT, sizeof(MT) );
+   state->y    = mt_y;
+   state->pos  = mt_pos;
+   state->seed = rng_threadSeed;
+}
+
+/**
+ * @brief Sets the state of the main generator, so it repeats the numbers it
+ *        gave since the state was gotten.
+ *
+ *    @param state State to set.
+ */
+void rng_setState( const RngState *state )
+{
+   memcpy( MT, state->mt, sizeof(MT) );
+   mt_y           = state->y;
+   mt_pos         = state->pos;
+   rng_threadSeed = state->seed;
 }
 
 /**
@@ -114,25 +175,44 @@ static uint32_t rng_timeEntropy (void)
 static void mt_initArray( uint32_t seed )
 {
    MT[0] = seed;
-   for (int i=1; i<624; i++)
+   for (int i=1; i<MT_N; i++)
       MT[i] = 1812433253 * (MT[i-1] ^ (((MT[i-1])) + i) >> 30);
    mt_pos = 0;
 }
 
+/**
+ * @brief Regenerates part of the mersenne twister state.
+ *
+ * Written without branches nor modulo of the index so that it vectorizes. The
+ *  words read at the offset must not be written in the same range.
+ *
+ *    @param start First word to regenerate.
+ *    @param end Word after the last to regenerate.
+ *    @param offset Offset of the word to mix in.
+ */
+static inline void mt_genRange( int start, int end, int offset )
+{
+   for (int i=start; i<end; i++) {
+      uint32_t y = (MT[i] & 0x80000000) + ((MT[i] % MT_N) & 0x7FFFFFFF);
+      MT[i] = MT[i+offset] ^ (y >> 1) ^ ((0u - (y & 1u)) & 2567483615U);
+   }
+}
+
 /**
  * @fn static void mt_genArray (void)
  *
  * @brief Generates a new set of random numbers for the mersenne twister.
+ *
+ * Split in ranges that don't overlap with the words they mix in, giving the
+ *  exact same numbers as going through the words in order.
  */
 static void mt_genArray (void)
 {
-   for (int i=0; i<624; i++ ) {
-      mt_y = (MT[i] & 0x80000000) + ((MT[i] % 624) & 0x7FFFFFFF);
-      if (mt_y % 2) /* odd */
-         MT[i] = (MT[(i+397) % 624] ^ (mt_y >> 1)) ^ 2567483615U;
-      else /* even */
-         MT[i] = MT[(i+397) % 624] ^ (mt_y >> 1);
-   }
+   /* Mixes in the words that have not been regenerated yet. */
+   mt_genRange( 0, MT_N-MT_M, MT_M );
+   /* Mixes in the words regenerated by the previous ranges. */
+   mt_genRange( MT_N-MT_M, 2*(MT_N-MT_M), MT_M-MT_N );
+   mt_genRange( 2*(MT_N-MT_M), MT_N, MT_M-MT_N );
    mt_pos = 0;
 }
 
@@ -145,7 +225,7 @@ static void mt_genArray (void)
  */
 static uint32_t mt_getInt (void)
 {
-   if (mt_pos >= 624)
+   if (mt_pos >= MT_N)
       mt_genArray();
 
    mt_y = MT[mt_pos++];
@@ -183,6 +263,121 @@ double randfp (void)
    return m / m_div;
 }
 
+/**
+ * @brief Fills an array with random floats between 0 and 1 (inclusive).
+ *
+ * Gives the same numbers as calling randfp for each element.
+ *
+ *    @param out Array to fill.
+ *    @param n Number of elements to fill.
+ */
+void randfp_fill( double *out, int n )
+{
+   while (n > 0) {
+      int m;
+      if (mt_pos >= MT_N)
+         mt_genArray();
+      m = MIN( n, MT_N-mt_pos );
+      for (int i=0; i<m; i++) {
+         uint32_t y = MT[mt_pos+i];
+         y ^= y >> 11;
+         y ^= (y << 7) & 2636928640U;
+         y ^= (y << 15) & 4022730752U;
+         y ^= y >> 18;
+         out[i] = (double)y / m_div;
+      }
+      mt_pos += m;
+      out    += m;
+      n      -= m;
+   }
+}
+
+/**
+ * @brief Gets the random number of a key at a counter.
+ *
+ * Uses the SplitMix64 finalizer on the counter scaled by the golden ratio, so
+ *  any number of a stream can be gotten without generating the previous ones.
+ *
+ *    @param key Key of the stream.
+ *    @param ctr Counter of the number.
+ *    @return The random number.
+ */
+uint64_t rng_counter( uint64_t key, uint64_t ctr )
+{
+   uint64_t z = key + ctr * UINT64_C(0x9E3779B97F4A7C15);
+   z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+   z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+   return z ^ (z >> 31);
+}
+
+/**
+ * @brief Sets up a random stream.
+ *
+ *    @param s Stream to set up.
+ *    @param seed Seed, the same seed and stream number give the same numbers.
+ *    @param stream Number of the stream, such as the index of a parallel task.
+ */
+void rng_streamInit( RngStream *s, uint64_t seed, uint64_t stream )
+{
+   s->key = rng_counter( seed, rng_counter( UINT64_C(0x6A09E667F3BCC909), stream ) );
+   s->ctr = 0;
+}
+
+/**
+ * @brief Gets a random integer from a stream.
+ *
+ *    @param s Stream to get from.
+ *    @return A random 4 byte number.
+ */
+uint32_t rng_streamInt( RngStream *s )
+{
+   return rng_counter( s->key, s->ctr++ ) >> 32;
+}
+
+/**
+ * @brief Gets a random float between 0 and 1 (inclusive) from a stream.
+ *
+ *    @param s Stream to get from.
+ *    @return A random float between 0 and 1 (inclusive).
+ */
+double rng_streamFloat( RngStream *s )
+{
+   return (double)rng_streamInt( s ) / m_div;
+}
+
+/**
+ * @brief Fills an array with random floats between 0 and 1 (inclusive) from a stream.
+ *
+ *    @param s Stream to get from.
+ *    @param out Array to fill.
+ *    @param n Number of elements to fill.
+ */
+void rng_streamFill( RngStream *s, double *out, int n )
+{
+   uint64_t ctr = s->ctr;
+   for (int i=0; i<n; i++)
+      out[i] = (double)(rng_counter( s->key, ctr+i ) >> 32) / m_div;
+   s->ctr = ctr + n;
+}
+
+/**
+ * @brief Gets the random stream of the current thread.
+ *
+ * Each thread gets a different stream the first time, in the order they ask
+ *  for it, so it is not deterministic across runs. Use explicit streams for
+ *  that.
+ *
+ *    @return The stream of the thread.
+ */
+RngStream *rng_thread (void)
+{
+   if (!rng_threadInit) {
+      rng_streamInit( &rng_threadStream, rng_threadSeed, atomic_fetch_add( &rng_threadNum, 1 ) );
+      rng_threadInit = 1;
+   }
+   return &rng_threadStream;
+}
+
 /**
  * @fn double Normal( double x )
  *
@@ -3,6 +3,10 @@
  */
 #pragma once
 
+/** @cond */
+#include <stdint.h>
+/** @endcond */
+
 /**
  * @brief Gets a random number between L and H (L <= RNG <= H).
  *
@@ -38,12 +42,48 @@
  */
 #define RNG_3SIGMA()       NormalInverse(0.0013498985 + RNGF()*(1.-0.0013498985*2.))
 
+/**
+ * @brief Counter based random stream.
+ *
+ * Numbers only depend on the key and the counter, so streams can be used from
+ *  any thread and give the same numbers regardless of the scheduling when
+ *  each parallel task uses its own stream.
+ */
+typedef struct RngStream_ {
+   uint64_t key;  /**< Key of the stream, from the seed and stream number. */
+   uint64_t ctr;  /**< Counter of the next number. */
+} RngStream;
+
+#define RNG_STATE_WORDS  624 /**< Words in the state of the main generator. */
+
+/**
+ * @brief Copy of the state of the main generator, to replay random sequences.
+ */
+typedef struct RngState_ {
+   uint32_t mt[RNG_STATE_WORDS]; /**< Mersenne twister state. */
+   uint32_t y;       /**< Internal mersenne twister variable. */
+   int pos;          /**< Current number being used. */
+   uint64_t seed;    /**< Seed of the thread streams. */
+} RngState;
+
 /* Init */
 void rng_init (void);
+void rng_seed( uint32_t seed );
+void rng_getState( RngState *state );
+void rng_setState( const RngState *state );
 
 /* Random functions */
 unsigned int randint (void);
 double randfp (void);
+void randfp_fill( double *out, int n );
+
+/* Streams. */
+uint64_t rng_counter( uint64_t key, uint64_t ctr );
+void rng_streamInit( RngStream *s, uint64_t seed, uint64_t stream );
+uint32_t rng_streamInt( RngStream *s );
+double rng_streamFloat( RngStream *s );
+void rng_streamFill( RngStream *s, double *out, int n );
+RngStream *rng_thread (void);
 
 /* Probability functions */
 double Normal( double x );
@@ -42,8 +42,13 @@
 #include "array.h"
 #include "conf.h"
 #include "log.h"
+#include "md5.h"
+#include "ncache.h"
 #include "union_find.h"
 
+#define SAFELANES_CACHE       "safelanes+%x" /**< Name of the binary cache of computed lanes, by key slot. */
+#define SAFELANES_CACHE_SLOTS 16             /**< Number of universe states whose lanes are cached. */
+
 /*
  * Global parameters.
  */
@@ -51,6 +56,7 @@ static const double ALPHA            = 9.;       /**< Lane efficiency parameter.
 static const double LAMBDA           = 2e10;     /**< Regularization term for score. */
 static const double JUMP_CONDUCTIVITY= 0.001;    /**< Conductivity value for inter-system jump-point connections. */
 static const double MIN_ANGLE        = M_PI/18.; /**< Path triangles can't be more acute. */
+static const int UPDOWN_MAX_RANK     = 64;       /**< Most lanes activated in a turn for which the factorization is updated instead of recomputed. */
 enum {
    STORAGE_MODE_LOWER_TRIANGULAR_PART= -1,       /**< A CHOLMOD "stype" value: matrix is interpreted as symmetric. */
    STORAGE_MODE_UNSYMMETRIC          = 0,        /**< A CHOLMOD "stype" value: matrix holds whatever we put in it. */
@@ -108,6 +114,8 @@ static double *tmp_edge_conduct;/**< Array (array.h): Conductivity (1/len) of ea
 static int *tmp_anchor_vertices;/**< Array (array.h): One vertex ID per connected component. Used to set up "stiff". */
 static UnionFind tmp_sys_uf;    /**< The partition of {system indices} into connected components (connected by 2-way jumps). */
 static cholmod_triplet *stiff;  /**< K matrix, UT triplets: internal edges (E*3), implicit jump connections, anchor conditions. */
+static cholmod_factor *stiff_f; /**< Factorization of K, kept across turns of an optimization. */
+static int *stiff_activated;    /**< Array (array.h): Edges activated since stiff_f was last brought up to date. */
 static cholmod_sparse *QtQ;     /**< (Q*)Q where Q is the ExV difference matrix. */
 static cholmod_dense *ftilde;   /**< Fluxes (bunch of F columns in the KU=F problem). */
 static cholmod_dense *utilde;   /**< Potentials (bunch of U columns in the KU=F problem). */
@@ -129,7 +137,11 @@ static void safelanes_initOptimizer (void);
 static void safelanes_destroyOptimizer (void);
 static void safelanes_destroyStacks (void);
 static void safelanes_destroyTmp (void);
+static void safelanes_cacheKey( md5_byte_t key[16] );
+static int safelanes_cacheLoad( const md5_byte_t key[16] );
+static void safelanes_cacheSave( const md5_byte_t key[16] );
 static void safelanes_initStiff (void);
+static void safelanes_factorStiff (void);
 static double safelanes_initialConductivity ( int ei );
 static void safelanes_updateConductivity ( int ei_activated );
 static void safelanes_initQtQ (void);
@@ -146,7 +158,7 @@ static int cmp_key( const void* p1, const void* p2 );
 static inline void triplet_entry( cholmod_triplet* m, int i, int j, double v );
 static cholmod_dense* safelanes_sliceByPresence( const cholmod_dense* m, const double* sysPresence );
 static cholmod_dense* ncholmod_ddmult( cholmod_dense* A, int transA, cholmod_dense* B );
-static double safelanes_row_dot_row( cholmod_dense* A, cholmod_dense* B, int i, int j );
+static void safelanes_block_dot_block( cholmod_dense* A, cholmod_dense* B, int i, int j, int n, double *out );
 
 /**
  * @brief Like array_push_back( a, Edge{v0, v1} ), but achievable in C. :-P
@@ -164,6 +176,11 @@ static inline void array_push_back_edge( Edge **a, int v0, int v1 )
 void safelanes_init (void)
 {
    cholmod_start( &C );
+   /* Supernodal factorization spends its time in dense BLAS kernels, which can use all the cores. */
+   C.supernodal = CHOLMOD_SUPERNODAL;
+#if HAVE_OPENBLAS_CBLAS_H || HAVE_CBLAS_OPENBLAS_H || HAVE_CBLAS_HYPHEN_OPENBLAS_H
+   openblas_set_num_threads( SDL_GetCPUCount() );
+#endif
    /* Ideally we would want to recalculate here, but since we load the first
     * save and try to use unidiffs there, we instead defer the safe lane
     * computation to only if necessary after loading save unidiffs. */
@@ -255,15 +272,31 @@ void safelanes_recalculate (void)
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
 
+   md5_byte_t key[16];
+
    /* Don't recompute on exit. */
    if (naev_isQuit())
       return;
 
    safelanes_initStacks();
+
+   /* The lanes only depend on the stacks, which may have been charted before. */
+   safelanes_cacheKey( key );
+   if (safelanes_cacheLoad( key ) == 0) {
+      safelanes_destroyTmp();
+#if DEBUGGING
+      if (conf.devmode)
+         DEBUG( n_("Loaded safe lanes for %d object from cache in %.3f s", "Loaded safe lanes for %d objects from cache in %.3f s", array_size(vertex_stack)), array_size(vertex_stack), (SDL_GetTicks()-time)/1000. );
+#endif /* DEBUGGING */
+      safelanes_calculated_once = 1;
+      return;
+   }
+
    safelanes_initOptimizer();
    for (int iters_done=0; safelanes_buildOneTurn(iters_done) > 0; iters_done++)
       ;
    safelanes_destroyOptimizer();
+   safelanes_cacheSave( key );
    /* Stacks remain available for queries. */
 #if DEBUGGING
    if (conf.devmode)
@@ -273,6 +306,124 @@ void safelanes_recalculate (void)
    safelanes_calculated_once = 1;
 }
 
+/**
+ * @brief Charts the safe lanes bypassing the cache, to time the optimization.
+ *
+ * The result is the same as safelanes_recalculate gives, but is neither loaded
+ *  from nor saved to the cache.
+ *
+ *    @return Number of iterations the optimization took.
+ */
+int safelanes_benchmark (void)
+{
+   int iters_done;
+
+   safelanes_initStacks();
+   safelanes_initOptimizer();
+   for (iters_done=0; safelanes_buildOneTurn(iters_done) > 0; iters_done++)
+      ;
+   safelanes_destroyOptimizer();
+
+   safelanes_calculated_once = 1;
+   return iters_done;
+}
+
+/**
+ * @brief Hashes an array into the cache key, along with its size.
+ */
+static void safelanes_hashData( md5_state_t *md5, const void *data, size_t size )
+{
+   uint32_t n = size;
+   md5_append( md5, (const md5_byte_t*)&n, sizeof(n) );
+   if (size > 0)
+      md5_append( md5, data, size );
+}
+
+/**
+ * @brief Computes the key of the cached lanes from the stacks the optimization uses.
+ *
+ * The stacks hold everything the result depends on: vertices and edges with their
+ *  conductivities, jumps, anchors, factions and their presence in each system.
+ */
+static void safelanes_cacheKey( md5_byte_t key[16] )
+{
+   md5_state_t md5;
+   const char *version = naev_version(1);
+
+   md5_init( &md5 );
+   safelanes_hashData( &md5, version, strlen(version) );
+   safelanes_hashData( &md5, vertex_stack, array_size(vertex_stack)*sizeof(Vertex) );
+   for (int i=0; i<array_size(vertex_stack); i++)
+      md5_append( &md5, (const md5_byte_t*)vertex_pos( i ), sizeof(vec2) );
+   safelanes_hashData( &md5, sys_to_first_vertex, array_size(sys_to_first_vertex)*sizeof(int) );
+   safelanes_hashData( &md5, edge_stack, array_size(edge_stack)*sizeof(Edge) );
+   safelanes_hashData( &md5, sys_to_first_edge, array_size(sys_to_first_edge)*sizeof(int) );
+   safelanes_hashData( &md5, lane_fmask, array_size(lane_fmask)*sizeof(FactionMask) );
+   safelanes_hashData( &md5, tmp_edge_conduct, array_size(tmp_edge_conduct)*sizeof(double) );
+   safelanes_hashData( &md5, tmp_spob_indices, array_size(tmp_spob_indices)*sizeof(int) );
+   safelanes_hashData( &md5, tmp_jump_edges, array_size(tmp_jump_edges)*sizeof(Edge) );
+   safelanes_hashData( &md5, tmp_anchor_vertices, array_size(tmp_anchor_vertices)*sizeof(int) );
+   for (int fi=0; fi<array_size(faction_stack); fi++) {
+      /* Field by field, the struct has padding. */
+      const Faction *f = &faction_stack[fi];
+      md5_append( &md5, (const md5_byte_t*)&f->id, sizeof(f->id) );
+      md5_append( &md5, (const md5_byte_t*)&f->lane_length_per_presence, sizeof(double) );
+      md5_append( &md5, (const md5_byte_t*)&f->lane_base_cost, sizeof(double) );
+      safelanes_hashData( &md5, presence_budget[fi], array_size(presence_budget[fi])*sizeof(double) );
+   }
+   md5_finish( &md5, key );
+}
+
+/**
+ * @brief Loads the lanes charted for the same stacks in a previous run.
+ *
+ *    @param key Key of the current stacks.
+ *    @return 0 if lane_faction was loaded from the cache.
+ */
+static int safelanes_cacheLoad( const md5_byte_t key[16] )
+{
+   char name[32];
+   NCache nc;
+   uint32_t n;
+
+   snprintf( name, sizeof(name), SAFELANES_CACHE, key[0] % SAFELANES_CACHE_SLOTS );
+   if (ncache_open( &nc, name, key ) != 0)
+      return -1;
+
+   n = ncache_readU32( &nc );
+   if (n == (uint32_t)array_size(lane_faction))
+      for (uint32_t i=0; (i<n) && !nc.err; i++)
+         lane_faction[i] = ncache_readU32( &nc );
+   else
+      nc.err = 1;
+   if (nc.err || (nc.pos != nc.size)) {
+      WARN(_("Safe lane cache is corrupt, recomputing the lanes."));
+      memset( lane_faction, 0, array_size(lane_faction)*sizeof(lane_faction[0]) );
+      ncache_close( &nc );
+      return -1;
+   }
+   ncache_close( &nc );
+   return 0;
+}
+
+/**
+ * @brief Saves the charted lanes so the next runs can skip the optimization.
+ *
+ *    @param key Key of the current stacks.
+ */
+static void safelanes_cacheSave( const md5_byte_t key[16] )
+{
+   char name[32];
+   NCacheWriter w;
+
+   snprintf( name, sizeof(name), SAFELANES_CACHE, key[0] % SAFELANES_CACHE_SLOTS );
+   ncache_writeBegin( &w );
+   ncache_writeU32( &w, array_size(lane_faction) );
+   for (int i=0; i<array_size(lane_faction); i++)
+      ncache_writeU32( &w, lane_faction[i] );
+   ncache_writeEnd( &w, name, key );
+}
+
 /**
  * @brief Whether or not the safe lanes have been calculated at least once.
  */
@@ -305,6 +456,9 @@ static void safelanes_destroyOptimizer (void)
    cholmod_free_dense( &utilde, &C ); /* CAUTION: if we instead save it, ensure it's updated after the final activateByGradient. */
    cholmod_free_dense( &ftilde, &C );
    cholmod_free_sparse( &QtQ, &C );
+   cholmod_free_factor( &stiff_f, &C );
+   array_free( stiff_activated );
+   stiff_activated = NULL;
    cholmod_free_triplet( &stiff, &C );
 }
 
@@ -313,16 +467,19 @@ static void safelanes_destroyOptimizer (void)
  */
 static int safelanes_buildOneTurn( int iters_done )
 {
-   cholmod_sparse *stiff_s;
-   cholmod_factor *stiff_f;
    cholmod_dense *_QtQutilde, *Lambda_tilde, *Y_workspace, *E_workspace;
    int turns_next_time;
    double zero[] = {0, 0}, neg_1[] = {-1, 0};
+#if DEBUGGING
+   Uint64 t0, t1, t2;
+   t0 = SDL_GetPerformanceCounter();
+#endif /* DEBUGGING */
 
    Y_workspace = E_workspace = Lambda_tilde = NULL;
-   stiff_s = cholmod_triplet_to_sparse( stiff, 0, &C );
-   stiff_f = cholmod_analyze( stiff_s, &C );
-   cholmod_factorize( stiff_s, stiff_f, &C );
+   safelanes_factorStiff();
+#if DEBUGGING
+   t1 = SDL_GetPerformanceCounter();
+#endif /* DEBUGGING */
    cholmod_solve2( CHOLMOD_A, stiff_f, ftilde, NULL, &utilde, NULL, &Y_workspace, &E_workspace, &C );
    _QtQutilde = cholmod_zeros( utilde->nrow, utilde->ncol, CHOLMOD_REAL, &C );
    cholmod_sdmult( QtQ, 0, neg_1, zero, utilde, _QtQutilde, &C );
@@ -330,10 +487,18 @@ static int safelanes_buildOneTurn( int iters_done )
    cholmod_free_dense( &_QtQutilde, &C );
    cholmod_free_dense( &Y_workspace, &C );
    cholmod_free_dense( &E_workspace, &C );
-   cholmod_free_factor( &stiff_f, &C );
-   cholmod_free_sparse( &stiff_s, &C );
+#if DEBUGGING
+   t2 = SDL_GetPerformanceCounter();
+#endif /* DEBUGGING */
    turns_next_time = safelanes_activateByGradient( Lambda_tilde, iters_done );
    cholmod_free_dense( &Lambda_tilde, &C );
+#if DEBUGGING
+   if (conf.devmode) {
+      double freq = SDL_GetPerformanceFrequency() / 1000.;
+      DEBUG( _("Safe lanes turn %d: %.1f ms factorizing, %.1f ms solving, %.1f ms activating"), iters_done,
+            (t1-t0)/freq, (t2-t1)/freq, (SDL_GetPerformanceCounter()-t2)/freq );
+   }
+#endif /* DEBUGGING */
 
    return turns_next_time;
 }
@@ -577,6 +742,62 @@ static void safelanes_initStiff (void)
 #endif /* DEBUGGING */
 }
 
+/**
+ * @brief Brings the factorization of the stiffness matrix up to date.
+ *
+ * The sparsity pattern never changes, so the symbolic analysis is only done once per optimization. Activating a
+ * lane adds a rank-1 term to the matrix, so when few lanes were activated the factorization is updated instead.
+ */
+static void safelanes_factorStiff (void)
+{
+   cholmod_sparse *stiff_s;
+   int n = array_size( stiff_activated );
+
+   if ((stiff_f != NULL) && (n == 0))
+      return;
+
+   if ((stiff_f != NULL) && (n <= UPDOWN_MAX_RANK)) {
+      cholmod_sparse *W, *Wp;
+      const double *sv = stiff->x;
+      int ret;
+
+      /* Activation scaled the edge's conductivity by 1+ALPHA, so K grew by w w* with w = sqrt(dc) (|v0> - |v1>). */
+      W = cholmod_allocate_sparse( stiff->nrow, n, 2*n, SORTED, PACKED, STORAGE_MODE_UNSYMMETRIC, CHOLMOD_REAL, &C );
+      ((int*)W->p)[0] = 0;
+      for (int k=0; k<n; k++) {
+         int ei = stiff_activated[k];
+         double w = sqrt( sv[3*ei] * ALPHA / (1.+ALPHA) );
+         ((int*)W->p)[k+1] = 2*(k+1);
+         ((int*)W->i)[2*k+0] = MIN( edge_stack[ei][0], edge_stack[ei][1] );
+         ((int*)W->i)[2*k+1] = MAX( edge_stack[ei][0], edge_stack[ei][1] );
+         ((double*)W->x)[2*k+0] = +w;
+         ((double*)W->x)[2*k+1] = -w;
+      }
+      /* The update applies to the permuted system, and needs a simplicial LDL' factorization. */
+      Wp = cholmod_submatrix( W, stiff_f->Perm, stiff_f->n, NULL, -1, 1, SORTED, &C );
+      cholmod_free_sparse( &W, &C );
+      if (stiff_f->is_super || stiff_f->is_ll)
+         cholmod_change_factor( CHOLMOD_REAL, 0, 0, 0, 0, stiff_f, &C );
+      ret = cholmod_updown( 1, Wp, stiff_f, &C );
+      cholmod_free_sparse( &Wp, &C );
+      if (ret) {
+         array_resize( &stiff_activated, 0 );
+         return;
+      }
+      /* Fall back to refactorizing. */
+   }
+
+   /* Updates left a simplicial factorization, get back to the supernodal one. */
+   if ((stiff_f != NULL) && !stiff_f->is_super)
+      cholmod_free_factor( &stiff_f, &C );
+   stiff_s = cholmod_triplet_to_sparse( stiff, 0, &C );
+   if (stiff_f == NULL)
+      stiff_f = cholmod_analyze( stiff_s, &C );
+   cholmod_factorize( stiff_s, stiff_f, &C );
+   cholmod_free_sparse( &stiff_s, &C );
+   array_resize( &stiff_activated, 0 );
+}
+
 /**
  * @brief Returns the initial conductivity value (1/length) for edge ei.
  * The live value is stored in the stiffness matrix; \see safelanes_initStiff above.
@@ -699,7 +920,7 @@ static void safelanes_initPPl (void)
 static int safelanes_activateByGradient( const cholmod_dense* Lambda_tilde, int iters_done )
 {
    int *facind_opts, *edgeind_opts, turns_next_time;
-   double *facind_vals, Linv;
+   double *facind_vals, *lut, Linv;
    cholmod_dense **lal; /**< Per faction index, the Lambda_tilde[myDofs,:] @ PPl[fi] matrices. Calloced and lazily populated. */
    size_t *lal_bases, lal_base; /**< System si's U and Lambda rows start at sys_base; its lal rows start at lal_base. */
 
@@ -708,6 +929,7 @@ static int safelanes_activateByGradient( const cholmod_dense* Lambda_tilde, int
    edgeind_opts = array_create( int );
    facind_opts = array_create_size( int, array_size(faction_stack) );
    facind_vals = array_create_size( double, array_size(faction_stack) );
+   lut = array_create( double );
    for (int fi=0; fi<array_size(faction_stack); fi++) {
       array_push_back( &facind_opts, fi );
       array_push_back( &facind_vals, 0 );
@@ -764,26 +986,32 @@ static int safelanes_activateByGradient( const cholmod_dense* Lambda_tilde, int
          cost_best = 1. / safelanes_initialConductivity(ei_best) / faction_stack[fi].lane_length_per_presence + faction_stack[fi].lane_base_cost;
          cost_cheapest_other = +HUGE_VAL;
          if (array_size(edgeind_opts) > 0) {
+            int nv = sys_to_first_vertex[1+si] - sys_to_first_vertex[si];
+
+            if (lal[fi] == NULL) { /* Is it time to evaluate the lazily-calculated matrix? */
+               cholmod_dense *lamt = safelanes_sliceByPresence( Lambda_tilde, presence_budget[fi] );
+               lal[fi] = ncholmod_ddmult( lamt, 0, PPl[fi] );
+               cholmod_free_dense( &lamt, &C );
+            }
+
+            /* LUT = np.dot( utilde[myDofs,:], lal[myDofs,:].T ) for all the system's vertices in one product. */
+            array_resize( &lut, nv*nv );
+            safelanes_block_dot_block( utilde, lal[fi], sys_base, lal_base, nv, lut );
+
             /* There's an actual choice. Search for the best option. Lower is better. */
             for (int eii=0; eii<array_size(edgeind_opts); eii++) {
                int ei = edgeind_opts[eii];
-               int sis = edge_stack[ei][0];
-               int sjs = edge_stack[ei][1];
+               int sis = edge_stack[ei][0] - sys_base;
+               int sjs = edge_stack[ei][1] - sys_base;
                double score = 0.;
                double cost;
 
-               if (lal[fi] == NULL) { /* Is it time to evaluate the lazily-calculated matrix? */
-                  cholmod_dense *lamt = safelanes_sliceByPresence( Lambda_tilde, presence_budget[fi] );
-                  lal[fi] = ncholmod_ddmult( lamt, 0, PPl[fi] );
-                  cholmod_free_dense( &lamt, &C );
-               }
-
                /* Evaluate (LUTll[0,0] + LUTll[1,1] - LUTll[0,1] - LUTll[1,0]), */
-               /* where    LUTll = np.dot( lal[[sis,sjs],:] , utilde[[sis,sjs],:].T ) */
-               score += safelanes_row_dot_row( utilde, lal[fi], sis, sis - sys_base + lal_base );
-               score += safelanes_row_dot_row( utilde, lal[fi], sjs, sjs - sys_base + lal_base );
-               score -= safelanes_row_dot_row( utilde, lal[fi], sjs, sis - sys_base + lal_base );
-               score -= safelanes_row_dot_row( utilde, lal[fi], sis, sjs - sys_base + lal_base );
+               /* where    LUTll = LUT[[sis,sjs],:][:,[sis,sjs]] */
+               score += lut[ sis + sis*nv ];
+               score += lut[ sjs + sjs*nv ];
+               score -= lut[ sjs + sis*nv ];
+               score -= lut[ sis + sjs*nv ];
                Linv = safelanes_initialConductivity(ei);
                score *= ALPHA * Linv * Linv;
                score += LAMBDA;
@@ -814,6 +1042,7 @@ static int safelanes_activateByGradient( const cholmod_dense* Lambda_tilde, int
                lal_bases[fi] -= sys_to_first_vertex[1+si] - sys_to_first_vertex[si];
          }
          safelanes_updateConductivity( ei_best );
+         array_push_back( &stiff_activated, ei_best );
          vertex_fmask[edge_stack[ei_best][0]] |= (MASK_1<<fi);
          vertex_fmask[edge_stack[ei_best][1]] |= (MASK_1<<fi);
          lane_faction[ ei_best ] = faction_stack[fi].id;
@@ -833,6 +1062,7 @@ static int safelanes_activateByGradient( const cholmod_dense* Lambda_tilde, int
    array_free( edgeind_opts );
    array_free( facind_vals );
    array_free( facind_opts );
+   array_free( lut );
 
    return turns_next_time;
 }
@@ -973,14 +1203,15 @@ static cholmod_dense* ncholmod_ddmult( cholmod_dense* A, int transA, cholmod_den
    return out;
 }
 
-/** @brief Return the i,j entry of A*B', or equivalently the dot product of row i of A with row j of B. */
-static double safelanes_row_dot_row( cholmod_dense* A, cholmod_dense* B, int i, int j )
+/** @brief Sets out (n*n, column-major) to A[i:i+n,:] * B[j:j+n,:]', the dot products of n rows of A with n rows of B. */
+static void safelanes_block_dot_block( cholmod_dense* A, cholmod_dense* B, int i, int j, int n, double *out )
 {
    assert( A->ncol == B->ncol );
 #if I_LOVE_FORTRAN
-   blasint N = A->ncol, incA = A->d, incB = B->d;
-   return BLASFUNC(ddot)( &N, (double*)A->x + i, &incA, (double*)B->x + j, &incB);
+   blasint N = n, K = A->ncol, lda = A->d, ldb = B->d;
+   double alpha = 1., beta = 0.;
+   BLASFUNC(dgemm)( "N", "T", &N, &N, &K, &alpha, (double*)A->x + i, &lda, (double*)B->x + j, &ldb, &beta, out, &N );
 #else /* I_LOVE_FORTRAN */
-   return cblas_ddot( A->ncol, (double*)A->x + i, A->d, (double*)B->x + j, B->d);
+   cblas_dgemm( CblasColMajor, CblasNoTrans, CblasTrans, n, n, A->ncol, 1, (double*)A->x + i, A->d, (double*)B->x + j, B->d, 0, out, n );
 #endif /* I_LOVE_FORTRAN */
 }
@@ -34,15 +34,31 @@
 #include "plugin.h"
 #include "shiplog.h"
 #include "start.h"
+#include "threadpool.h"
 #include "unidiff.h"
 
+/**
+ * @brief Saved game written to a temporary file, waiting to be finished.
+ */
+typedef struct SaveJob_ {
+   int compress;           /**< Compression level to still apply, 0 if the file is final. */
+   char file[PATH_MAX];    /**< Real path of the saved game. */
+   char tmpfile[PATH_MAX]; /**< Real path of the temporary file written first. */
+   char zfile[PATH_MAX];   /**< Real path of the compressed temporary file. */
+   char old[PATH_MAX];     /**< PhysicsFS path of the save to back up, empty if none. */
+   char backup[PATH_MAX];  /**< PhysicsFS path of the backup. */
+} SaveJob;
+
 int save_loaded   = 0; /**< Just loaded the saved game. */
+static JobCounter *save_counter = NULL; /**< Counter for the pending save. */
+static SDL_atomic_t save_failed; /**< Set when the pending save failed to be written. */
 
 /*
  * prototypes
  */
 /* externs */
 /* player.c */
+extern int player_saveSummary( xmlTextWriterPtr writer ); /**< Saves the player summary. */
 extern int player_save( xmlTextWriterPtr writer ); /**< Saves player related stuff. */
 /* event.c */
 extern int events_saveActive( xmlTextWriterPtr writer );
@@ -62,6 +78,10 @@ extern int economy_sysSave( xmlTextWriterPtr writer ); /**< Saves the economy st
 extern int diff_save( xmlTextWriterPtr writer ); /**< Saves the universe diffs. */
 /* static */
 static int save_data( xmlTextWriterPtr writer );
+static int save_game( const char *name, int defer );
+static int save_write( SaveJob *job );
+static int save_compress( SaveJob *job );
+static int save_job( void *data );
 
 /**
  * @brief Saves all the player's game data.
@@ -87,36 +107,86 @@ static int save_data( xmlTextWriterPtr writer )
 }
 
 /**
- * @brief Saves the current game.
+ * @brief Saves the current game to the autosave.
+ *
+ * Compressing and writing the file is left to a worker when possible, in
+ *  which case a failure is reported by save_update.
  *
  *    @return 0 on success.
  */
 int save_all (void)
 {
-   return save_all_with_name( "autosave" );
+   return save_game( "autosave", 1 );
 }
 
 /**
  * @brief Saves the current game.
  *
+ * The save is on disk when this returns.
+ *
  *    @param name Name of custom snapshot.
  *    @return 0 on success.
  */
 int save_all_with_name( const char *name )
+{
+   return save_game( name, 0 );
+}
+
+/**
+ * @brief Saves the current game.
+ *
+ *    @param name Name of the saved game.
+ *    @param defer Whether finishing the save can be left to a worker.
+ *    @return 0 on success.
+ */
+static int save_game( const char *name, int defer )
 {
    char file[PATH_MAX];
    const plugin_t *plugins = plugin_list();
-   xmlDocPtr doc;
    xmlTextWriterPtr writer;
+   SaveJob *job;
 
    /* Do not save if saving is off. */
    if (player_isFlag(PLAYER_NOSAVE))
       return 0;
 
-   /* Create the writer. */
-   writer = xmlNewTextWriterDoc(&doc, conf.save_compress);
+   /* Only one save can be in flight at a time. */
+   save_wait();
+   save_update();
+
+   /* Without worker threads there is nothing to gain from deferring it. */
+   if (threadpool_threads() <= 1)
+      defer = 0;
+
+   /* Make sure the directories exist. */
+   if (PHYSFS_mkdir("saves") == 0) {
+      snprintf(file, sizeof(file), "%s/saves", PHYSFS_getWriteDir());
+      WARN(_( "Dir '%s' does not exist and unable to create: %s" ), file,
+         _(PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+      return -1;
+   }
+   snprintf(file, sizeof(file), "saves/%s", player.name);
+   if (PHYSFS_mkdir(file) == 0) {
+      snprintf(file, sizeof(file), "%s/saves/%s", PHYSFS_getWriteDir(), player.name);
+      WARN(_( "Dir '%s' does not exist and unable to create: %s" ), file,
+         _(PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+      return -1;
+   }
+
+   job = calloc( 1, sizeof(SaveJob) );
+   snprintf(job->file, sizeof(job->file), "%s/saves/%s/%s.ns", PHYSFS_getWriteDir(), player.name, name); /* TODO: write via physfs */
+   snprintf(job->tmpfile, sizeof(job->tmpfile), "%s.tmp", job->file);
+   snprintf(job->zfile, sizeof(job->zfile), "%s.tmpz", job->file);
+
+   /* Create the writer. It streams straight to a temporary file instead of
+    * building the whole document in memory first. When deferred, the file is
+    * written uncompressed and compressing it is left to the worker, as that
+    * is the slow part. */
+   job->compress = defer ? conf.save_compress : 0;
+   writer = xmlNewTextWriterFilename(job->tmpfile, defer ? 0 : conf.save_compress);
    if (writer == NULL) {
-      ERR(_("testXmlwriterDoc: Error creating the xml writer"));
+      WARN(_("Unable to create the xml writer for '%s'."), job->tmpfile);
+      free(job);
       return -1;
    }
 
@@ -142,62 +212,170 @@ int save_all_with_name( const char *name )
       xmlw_elem( writer, "plugin", "%s", plugin_name( &plugins[i] ) );
    xmlw_endElem(writer); /* "plugins" */
 
+   /* Save the summary for the load menu, it must come before the data. */
+   player_saveSummary(writer);
+
    /* Save the data. */
    if (save_data(writer) < 0) {
       ERR(_("Trying to save game data"));
-      goto err_writer;
+      xmlFreeTextWriter(writer);
+      remove(job->tmpfile);
+      free(job);
+      return -1;
    }
 
    /* Finish element. */
    xmlw_endElem(writer); /* "naev_save" */
    xmlw_done(writer);
 
-   /* Write to file. */
-   if (PHYSFS_mkdir("saves") == 0) {
-      snprintf(file, sizeof(file), "%s/saves", PHYSFS_getWriteDir());
-      WARN(_( "Dir '%s' does not exist and unable to create: %s" ), file,
-         _(PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
-      goto err_writer;
-   }
-   snprintf(file, sizeof(file), "saves/%s", player.name);
-   if (PHYSFS_mkdir(file) == 0) {
-      snprintf(file, sizeof(file), "%s/saves/%s", PHYSFS_getWriteDir(), player.name);
-      WARN(_( "Dir '%s' does not exist and unable to create: %s" ), file,
-         _(PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
-      goto err_writer;
-   }
+   /* Flushes and closes the file. */
+   xmlFreeTextWriter(writer);
 
-   /* Back up old saved game. */
+   /* The backup has to be decided now as save_loaded can change before a
+    * deferred save is finished. */
    if (!strcmp(name, "autosave")) {
       if (!save_loaded) {
-         char backup[PATH_MAX];
-         snprintf(file, sizeof(file), "saves/%s/autosave.ns", player.name);
-         snprintf(backup, sizeof(backup), "saves/%s/backup.ns", player.name);
-         if (ndata_copyIfExists(file, backup) < 0) {
-            WARN(_("Aborting save…"));
-            goto err_writer;
-         }
+         snprintf(job->old, sizeof(job->old), "saves/%s/autosave.ns", player.name);
+         snprintf(job->backup, sizeof(job->backup), "saves/%s/backup.ns", player.name);
       }
       save_loaded = 0;
    }
 
-   /* Critical section, if crashes here player's game gets corrupted.
-    * Luckily we have a copy just in case... */
-   xmlFreeTextWriter(writer);
-   snprintf(file, sizeof(file), "%s/saves/%s/%s.ns", PHYSFS_getWriteDir(), player.name, name); /* TODO: write via physfs */
-   if (xmlSaveFileEnc(file, doc, "UTF-8") < 0) {
-      WARN(_("Failed to write saved game!  You'll most likely have to restore it by copying your backup saved game over your current saved game."));
-      goto err;
+   if (!defer)
+      return save_write( job );
+
+   if (save_counter == NULL)
+      save_counter = job_counterCreate();
+   job_runBackground( save_counter, save_job, job );
+   return 0;
+}
+
+/**
+ * @brief Compresses the temporary file of a saved game.
+ *
+ *    @param job Saved game to compress, tmpfile is replaced by zfile.
+ *    @return 0 on success.
+ */
+static int save_compress( SaveJob *job )
+{
+   char buf[BUFSIZ];
+   size_t n;
+   FILE *in;
+   xmlOutputBufferPtr out;
+   int ret = 0;
+
+   in = fopen(job->tmpfile, "rb");
+   if (in == NULL) {
+      WARN(_("Unable to open '%s' for reading: %s"), job->tmpfile, strerror(errno));
+      return -1;
    }
-   xmlFreeDoc(doc);
+   out = xmlOutputBufferCreateFilename(job->zfile, NULL, job->compress);
+   if (out == NULL) {
+      WARN(_("Unable to open '%s' for writing."), job->zfile);
+      fclose(in);
+      return -1;
+   }
+   while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+      if (xmlOutputBufferWrite(out, n, buf) < 0) {
+         ret = -1;
+         break;
+      }
+   }
+   if (ferror(in))
+      ret = -1;
+   fclose(in);
+   if (xmlOutputBufferClose(out) < 0)
+      ret = -1;
 
+   remove(job->tmpfile);
+   if (ret) {
+      WARN(_("Failed to compress '%s'."), job->zfile);
+      remove(job->zfile);
+      return -1;
+   }
+   snprintf(job->tmpfile, sizeof(job->tmpfile), "%s", job->zfile);
    return 0;
+}
+
+/**
+ * @brief Finishes writing a saved game to disk.
+ *
+ *    @param job Saved game to finish, it gets freed.
+ *    @return 0 on success.
+ */
+static int save_write( SaveJob *job )
+{
+   int ret = -1;
+
+   if ((job->compress > 0) && (save_compress( job ) < 0))
+      goto done;
+
+   /* Back up old saved game. */
+   if ((job->old[0] != '\0') && (ndata_copyIfExists(job->old, job->backup) < 0)) {
+      WARN(_("Aborting save…"));
+      goto err;
+   }
+
+   /* Replace the old save only once the new one is complete, so a failure
+    * can't leave the player with a corrupt save. */
+#if __WIN32__
+   remove(job->file);
+#endif /* __WIN32__ */
+   if (rename(job->tmpfile, job->file) != 0) {
+      WARN(_("Failed to write saved game!  You'll most likely have to restore it by copying your backup saved game over your current saved game."));
+      goto err;
+   }
+   ret = 0;
+   goto done;
 
-err_writer:
-   xmlFreeTextWriter(writer);
 err:
-   xmlFreeDoc(doc);
-   return -1;
+   remove(job->tmpfile);
+done:
+   free(job);
+   return ret;
+}
+
+/**
+ * @brief Finishes a deferred saved game, run as a job.
+ *
+ *    @param data SaveJob to finish, it gets freed.
+ *    @return 0 on success.
+ */
+static int save_job( void *data )
+{
+   int ret = save_write( data );
+   if (ret < 0)
+      SDL_AtomicSet( &save_failed, 1 );
+   return ret;
+}
+
+/**
+ * @brief Blocks until the pending save, if any, is on disk.
+ */
+void save_wait (void)
+{
+   if (save_counter != NULL)
+      job_wait( save_counter );
+}
+
+/**
+ * @brief Tells the player if a deferred save failed.
+ *
+ * Called every frame from the main loop and before saving again.
+ */
+void save_update (void)
+{
+   if (SDL_AtomicSet( &save_failed, 0 ))
+      dialogue_alert( _("Failed to save game! You should exit and check the log to see what happened and then file a bug report!") );
+}
+
+/**
+ * @brief Finishes the pending save and frees the saving resources.
+ */
+void save_exit (void)
+{
+   job_counterDestroy( save_counter );
+   save_counter = NULL;
 }
 
 /**
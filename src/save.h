@@ -6,3 +6,6 @@
 int save_all (void);
 int save_all_with_name( const char *name );
 void save_reload (void);
+void save_wait (void);
+void save_update (void);
+void save_exit (void);
@@ -29,9 +29,12 @@ class Shader:
             yield f"      }} {subroutine};\n"
         yield f"   }} {self.name};\n"
 
-    def source_chunks(self):
+    def program_chunks(self):
         gshader = f"\"{self.geom_path}\"" if self.geom_path!=None else "NULL"
         yield f"   shaders.{self.name}.program = gl_program_vert_frag(\"{self.vs_path}\", \"{self.fs_path}\", {gshader});\n"
+
+    def source_chunks(self):
+        yield f"   shaders.{self.name}.program = gl_program_check(shaders.{self.name}.program);\n"
         for attribute in self.attributes:
             yield f"   shaders.{self.name}.{attribute} = glGetAttribLocation(shaders.{self.name}.program, \"{attribute}\");\n"
         for uniform in self.uniforms:
@@ -55,8 +58,10 @@ class SimpleShader(Shader):
         num_simpleshaders += 1
     def header_chunks(self):
         yield f"   SimpleShader {self.name};\n"
+    def program_chunks(self):
+        yield f"   shaders_loadSimple( \"{self.name}\", &shaders.{self.name}, \"{self.fs_path}\" );\n"
     def source_chunks(self):
-        yield f"   shaders_loadSimple( \"{self.name}\", &shaders.{self.name}, \"{self.fs_path}\" );"
+        yield f"   shaders_locateSimple( &shaders.{self.name} );"
 
 SHADERS = [
    Shader(
@@ -69,10 +74,10 @@ SHADERS = [
    ),
    Shader(
       name = "trail",
-      vs_path = "project_pos.vert",
+      vs_path = "trail.vert",
       fs_path = "trail.frag",
-      attributes = ["vertex"],
-      uniforms = ["projection", "c1", "c2", "t1", "t2", "dt", "pos1", "pos2", "r", "nebu_col" ],
+      attributes = ["vertex", "vertex_colour", "vertex_px", "vertex_trail"],
+      uniforms = ["projection", "nebu_col" ],
       subroutines = {
         "trail_func" : [
             "trail_default",
@@ -109,6 +114,38 @@ SHADERS = [
       uniforms = ["projection", "colour", "tex_mat", "sampler1", "sampler2", "inter"],
       subroutines = {},
    ),
+   Shader(
+      name = "texture_batch",
+      vs_path = "texture_batch.vert",
+      fs_path = "texture_batch.frag",
+      attributes = ["vertex", "vertex_tex", "vertex_colour", "vertex_inter"],
+      uniforms = ["projection", "sampler1", "sampler2"],
+      subroutines = {},
+   ),
+   Shader(
+      name = "marker_batch",
+      vs_path = "marker_batch.vert",
+      fs_path = "marker_batch.frag",
+      attributes = ["vertex", "vertex_pos", "vertex_colour", "vertex_dim", "vertex_shape"],
+      uniforms = ["projection"],
+      subroutines = {},
+   ),
+   Shader(
+      name = "jumplane_batch",
+      vs_path = "jumplane_batch.vert",
+      fs_path = "jumplane_batch.frag",
+      attributes = ["vertex_center", "vertex_corner", "vertex_dir", "vertex_width", "vertex_colour", "vertex_colour2"],
+      uniforms = ["projection", "offset", "zoom", "paramf"],
+      subroutines = {},
+   ),
+   Shader(
+      name = "factiondisk_batch",
+      vs_path = "factiondisk_batch.vert",
+      fs_path = "factiondisk_batch.frag",
+      attributes = ["vertex_center", "vertex_corner", "vertex_size", "vertex_colour"],
+      uniforms = ["projection", "offset", "zoom", "radius", "alpha"],
+      subroutines = {},
+   ),
    Shader(
       name = "texturesdf",
       vs_path = "texturesdf.vert",
@@ -169,8 +206,8 @@ SHADERS = [
       name = "dust",
       vs_path = "dust.vert",
       fs_path = "dust.frag",
-      attributes = ["vertex", "brightness"],
-      uniforms = ["projection", "offset_xy", "dims", "screen", "use_lines"],
+      attributes = [],
+      uniforms = ["projection", "offset_xy", "dims", "screen", "use_lines", "grid", "lod"],
       subroutines = {},
       geom_path = "dust.geom",
    ),
@@ -481,6 +518,16 @@ static int shaders_loadSimple( const char *name, SimpleShader *shd, const char *
 {
    shd->name   = name;
    shd->program = gl_program_vert_frag( "project_pos.vert", fs_path, NULL );
+
+   /* Add to list. */
+   shaders.simple_shaders[ nsimpleshaders++ ] = shd;
+
+   return 0;
+}
+
+static void shaders_locateSimple( SimpleShader *shd )
+{
+   shd->program = gl_program_check( shd->program );
    shd->vertex = glGetAttribLocation( shd->program, "vertex" );
    shd->projection = glGetUniformLocation( shd->program, "projection" );
    shd->colour  = glGetUniformLocation( shd->program, "colour" );
@@ -489,11 +536,6 @@ static int shaders_loadSimple( const char *name, SimpleShader *shd, const char *
    shd->paramf = glGetUniformLocation( shd->program, "paramf" );
    shd->parami = glGetUniformLocation( shd->program, "parami" );
    shd->paramv = glGetUniformLocation( shd->program, "paramv" );
-
-   /* Add to list. */
-   shaders.simple_shaders[ nsimpleshaders++ ] = shd;
-
-   return 0;
 }
 
 const SimpleShader *shaders_getSimple( const char *name )
@@ -508,13 +550,21 @@ const SimpleShader *shaders_getSimple( const char *name )
 
 void shaders_load (void) {
    Uint32 time = SDL_GetTicks();
+
+   /* Start all the compilations before waiting on any of them. */
+   gl_program_deferBegin();
 """
 
+    for shader in SHADERS:
+        yield from shader.program_chunks()
+    yield "\n   /* Check the programs and get the locations. */\n"
     for i, shader in enumerate(SHADERS):
         yield from shader.source_chunks()
         if i != len(SHADERS) - 1:
             yield "\n"
     yield """
+   gl_program_deferEnd();
+
    if (conf.devmode) {
       time = SDL_GetTicks() - time;
       DEBUG( n_("Loaded %d Shader in %.3f s", "Loaded %d Shaders in %.3f s", NUM_SHADERS ), NUM_SHADERS, time/1000. );
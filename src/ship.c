@@ -20,6 +20,7 @@
 #include "colour.h"
 #include "conf.h"
 #include "log.h"
+#include "nameindex.h"
 #include "ndata.h"
 #include "nfile.h"
 #include "nlua.h"
@@ -27,6 +28,8 @@
 #include "nlua_camera.h"
 #include "nstring.h"
 #include "nxml.h"
+#include "pilot.h"
+#include "player.h"
 #include "shipstats.h"
 #include "slots.h"
 #include "toolkit.h"
@@ -47,6 +50,9 @@
 
 #define STATS_DESC_MAX 512 /**< Maximum length for statistics description. */
 
+#define SHIP_GFX_UNUSED_MAX   3 /**< System changes before unused ship graphics get freed. */
+#define SHIP_COMM_CACHE       8 /**< Number of comm graphics kept loaded. */
+
 /**
  * @brief Structure for threaded loading.
  */
@@ -56,16 +62,49 @@ typedef struct ShipThreadData_ {
    int ret;          /**< Return status. */
 } ShipThreadData;
 
+/**
+ * @brief Graphics of a ship being loaded.
+ */
+typedef struct ShipGfxLoad_ {
+   Ship *s;             /**< Ship being loaded. */
+   SDL_Surface *space;  /**< Decoded space sprite. */
+   uint8_t *trans;      /**< Transparency map of the space sprite, if needed. */
+   SDL_Surface *target; /**< Target graphic. */
+   SDL_Surface *store;  /**< Store graphic. */
+} ShipGfxLoad;
+
 static Ship* ship_stack = NULL; /**< Stack of ships available in the game. */
+static NameIndex ship_index; /**< Index of ships by name. */
+static NameIndex ship_indexCase; /**< Index of ships by case insensitive name. */
+
+/**
+ * @brief A cached comm graphic.
+ */
+typedef struct ShipComm_ {
+   const Ship *ship;    /**< Ship the graphic belongs to, NULL if unused. */
+   glTexture *tex;      /**< Comm graphic. */
+   unsigned int used;   /**< When it was last used, for evicting. */
+   int pending;         /**< Whether it is still being loaded by ship_commLoader. */
+} ShipComm;
+static ShipComm ship_comm[SHIP_COMM_CACHE]; /**< Least recently used comm graphics. */
+static unsigned int ship_commUsed = 0; /**< Use counter of the comm graphics. */
+static glTexLoader *ship_commLoader = NULL; /**< Loader of the prefetched comm graphics. */
 
 /*
  * Prototypes
  */
 static int ship_loadGFX( Ship *temp, const char *buf, int sx, int sy, int engine );
+static int ship_gfxDecode( void *ptr );
+static void ship_gfxUpload( ShipGfxLoad *l );
+static void ship_gfxUnload( Ship *s );
 static int ship_loadPLG( Ship *temp, const char *buf, int size_hint );
 static int ship_parse( Ship *temp, const char *filename );
 static int ship_parseThread( void *ptr );
 static void ship_freeSlot( ShipOutfitSlot* s );
+static ShipComm *ship_commFind( const Ship *s );
+static ShipComm *ship_commSlot( const Ship *s );
+static void ship_commFinish (void);
+static void ship_commFree (void);
 
 /**
  * @brief Compares two ship pointers for qsort.
@@ -100,8 +139,8 @@ const Ship* ship_get( const char* name )
  */
 const Ship* ship_getW( const char* name )
 {
-   const Ship s = {.name = (char*)name };
-   return bsearch( &s, ship_stack, array_size(ship_stack), sizeof(Ship), ship_cmp );
+   int id = nameindex_get( &ship_index, name );
+   return (id < 0) ? NULL : &ship_stack[id];
 }
 
 /**
@@ -109,10 +148,7 @@ const Ship* ship_getW( const char* name )
  */
 const char *ship_existsCase( const char* name )
 {
-   for (int i=0; i<array_size(ship_stack); i++)
-      if (strcasecmp(name,ship_stack[i].name)==0)
-         return ship_stack[i].name;
-   return NULL;
+   return nameindex_getName( &ship_indexCase, name );
 }
 
 /**
@@ -295,16 +331,108 @@ credits_t ship_buyPrice( const Ship* s )
    return price;
 }
 
+/**
+ * @brief Finds the cached comm graphic of a ship.
+ */
+static ShipComm *ship_commFind( const Ship *s )
+{
+   for (int i=0; i<SHIP_COMM_CACHE; i++)
+      if (ship_comm[i].ship == s)
+         return &ship_comm[i];
+   return NULL;
+}
+
+/**
+ * @brief Evicts the least recently used comm graphic to make room for a ship.
+ */
+static ShipComm *ship_commSlot( const Ship *s )
+{
+   ShipComm *c = NULL;
+   for (int i=0; i<SHIP_COMM_CACHE; i++) {
+      /* Can't free graphics the loader will still write to. */
+      if (ship_comm[i].pending)
+         continue;
+      if ((c == NULL) || (ship_comm[i].used < c->used))
+         c = &ship_comm[i];
+   }
+   if (c == NULL) {
+      ship_commFinish();
+      c = &ship_comm[0];
+   }
+   gl_freeTexture( c->tex );
+   c->ship  = s;
+   c->tex   = NULL;
+   c->used  = ++ship_commUsed;
+   return c;
+}
+
+/**
+ * @brief Finishes loading the prefetched comm graphics.
+ */
+static void ship_commFinish (void)
+{
+   if (ship_commLoader == NULL)
+      return;
+   gl_texLoaderWait( ship_commLoader );
+   ship_commLoader = NULL;
+   for (int i=0; i<SHIP_COMM_CACHE; i++)
+      ship_comm[i].pending = 0;
+}
+
+/**
+ * @brief Frees the cached comm graphics.
+ */
+static void ship_commFree (void)
+{
+   ship_commFinish();
+   for (int i=0; i<SHIP_COMM_CACHE; i++)
+      gl_freeTexture( ship_comm[i].tex );
+   memset( ship_comm, 0, sizeof(ship_comm) );
+}
+
+/**
+ * @brief Starts loading the ship's comm graphic in the background.
+ *
+ * Meant for ships that are likely to be hailed soon, such as the player's
+ *  target, so that ship_loadCommGFX does not have to decode the image.
+ *
+ *    @param s Ship to prefetch comm graphic of.
+ */
+void ship_prefetchCommGFX( const Ship* s )
+{
+   ShipComm *c;
+   if ((s->gfx_comm == NULL) || (ship_commFind( s ) != NULL))
+      return;
+   c = ship_commSlot( s );
+   c->pending = 1;
+   if (ship_commLoader == NULL)
+      ship_commLoader = gl_texLoaderCreate();
+   gl_texLoaderAdd( ship_commLoader, s->gfx_comm, 1, 1, 0, &c->tex );
+}
+
 /**
  * @brief Loads the ship's comm graphic.
  *
+ * The last few graphics are kept loaded, so loading the same ship again or a
+ *  ship prefetched with ship_prefetchCommGFX is cheap.
+ *
  * Must be freed afterwards.
  */
 glTexture* ship_loadCommGFX( const Ship* s )
 {
-   if (s->gfx_comm != NULL)
-      return gl_newImage( s->gfx_comm, 0 );
-   return NULL;
+   ShipComm *c;
+   if (s->gfx_comm == NULL)
+      return NULL;
+
+   c = ship_commFind( s );
+   if (c == NULL) {
+      c = ship_commSlot( s );
+      c->tex = gl_newImage( s->gfx_comm, 0 );
+   }
+   else if (c->pending)
+      ship_commFinish();
+   c->used = ++ship_commUsed;
+   return gl_dupTexture( c->tex );
 }
 
 /**
@@ -348,35 +476,37 @@ int ship_size( const Ship *s )
 }
 
 /**
- * @brief Generates a target graphic for a ship.
+ * @brief Generates the target and store surfaces of a ship.
+ *
+ * Only works with surfaces so it can be run from any thread.
  */
-static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
+static int ship_genTargetSurfaces( ShipGfxLoad *l, int sx, int sy )
 {
-   SDL_Surface *gfx, *gfx_store;
+   SDL_Surface *surface = l->space;
+   const glTexture sprites = { .sx = sx, .sy = sy };
    int x, y, sw, sh;
    SDL_Rect rtemp, dstrect;
-   char buf[PATH_MAX];
 
    /* Get sprite size. */
-   sw = temp->gfx_space->w / sx;
-   sh = temp->gfx_space->h / sy;
+   sw = surface->w / sx;
+   sh = surface->h / sy;
 
    /* Create the surface. */
    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
 
    /* create the temp POT surface */
-   gfx = SDL_CreateRGBSurface( 0, sw, sh,
+   l->target = SDL_CreateRGBSurface( 0, sw, sh,
          surface->format->BytesPerPixel*8, RGBAMASK );
-   gfx_store = SDL_CreateRGBSurface( 0, SHIP_TARGET_W, SHIP_TARGET_H,
+   l->store = SDL_CreateRGBSurface( 0, SHIP_TARGET_W, SHIP_TARGET_H,
          surface->format->BytesPerPixel*8, RGBAMASK );
 
-   if (gfx == NULL) {
-      WARN( _("Unable to create ship '%s' targeting surface."), temp->name );
+   if ((l->target == NULL) || (l->store == NULL)) {
+      WARN( _("Unable to create ship '%s' targeting surface."), l->s->name );
       return -1;
    }
 
    /* Copy over for target. */
-   gl_getSpriteFromDir( &x, &y, temp->gfx_space, M_PI* 5./4. );
+   gl_getSpriteFromDir( &x, &y, &sprites, M_PI* 5./4. );
    rtemp.x = sw * x;
    rtemp.y = sh * y;
    rtemp.w = sw;
@@ -385,39 +515,32 @@ static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
    dstrect.y = 0;
    dstrect.w = rtemp.w;
    dstrect.h = rtemp.h;
-   SDL_BlitSurface( surface, &rtemp, gfx, &dstrect );
+   SDL_BlitSurface( surface, &rtemp, l->target, &dstrect );
 
    /* Copy over for store. */
    dstrect.x = (SHIP_TARGET_W - sw) / 2;
    dstrect.y = (SHIP_TARGET_H - sh) / 2;
    dstrect.w = rtemp.w;
    dstrect.h = rtemp.h;
-   SDL_BlitSurface( surface, &rtemp, gfx_store, &dstrect );
-
-   /* Load the store surface. */
-   snprintf( buf, sizeof(buf), "%s_gfx_store", temp->name );
-   temp->gfx_store = gl_loadImagePad( buf, gfx_store, OPENGL_TEX_VFLIP, SHIP_TARGET_W, SHIP_TARGET_H, 1, 1, 1 );
-
-   /* Load the surface. */
-   snprintf( buf, sizeof(buf), "%s_gfx_target", temp->name );
-   temp->gfx_target = gl_loadImagePad( buf, gfx, OPENGL_TEX_VFLIP, sw, sh, 1, 1, 1 );
+   SDL_BlitSurface( surface, &rtemp, l->store, &dstrect );
 
    return 0;
 }
 
 /**
- * @brief Loads the space graphics for a ship from an image.
+ * @brief Decodes the space graphics for a ship from an image.
  *
- *    @param temp Ship to load into.
+ * Does not touch OpenGL so it can be run from any thread, the textures get
+ *  created by ship_gfxUpload.
+ *
+ *    @param l Load to decode into.
  *    @param str Path of the image to use.
  *    @param sx Number of X sprites in image.
  *    @param sy Number of Y sprites in image.
  */
-static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy )
+static int ship_decodeSpaceImage( ShipGfxLoad *l, const char *str, int sx, int sy )
 {
    SDL_RWops *rw;
-   SDL_Surface *surface;
-   int ret;
 
    /* Load the space sprite. */
    rw    = PHYSFSRWOPS_openRead( str );
@@ -425,49 +548,74 @@ static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy )
       WARN(_("Unable to open '%s' for reading!"), str);
       return -1;
    }
-   surface = IMG_Load_RW( rw, 0 );
+   l->space = IMG_Load_RW( rw, 0 );
+   if (l->space == NULL) {
+      WARN(_("Unable to load image '%s'."), str );
+      SDL_RWclose( rw );
+      return -1;
+   }
 
-   /* Load the texture. */
-   if (temp->polygon != NULL)
-      temp->gfx_space = gl_loadImagePad( str, surface,
-            OPENGL_TEX_MIPMAPS | OPENGL_TEX_VFLIP,
-            surface->w, surface->h, sx, sy, 0 );
-   else
-      temp->gfx_space = gl_loadImagePadTrans( str, surface, rw,
-            OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS | OPENGL_TEX_VFLIP,
-            surface->w, surface->h, sx, sy, 0 );
+   /* Ships without a collision polygon collide with the transparency map. */
+   if (l->s->polygon == NULL)
+      l->trans = gl_transMapLoad( str, l->space, rw, l->space->w, l->space->h );
+   SDL_RWclose( rw );
 
    /* Create the target graphic. */
-   ret = ship_genTargetGFX( temp, surface, sx, sy );
-   if (ret != 0)
-      return ret;
-
-   /* Free stuff. */
-   SDL_RWclose( rw );
-   SDL_FreeSurface( surface );
+   return ship_genTargetSurfaces( l, sx, sy );
+}
 
-   /* Calculate mount angle. */
-   temp->mangle  = 2.*M_PI;
-   temp->mangle /= temp->gfx_space->sx * temp->gfx_space->sy;
+/**
+ * @brief Decodes the graphics of a ship, can be run from a thread.
+ *
+ * The 3D model is loaded completely as it handles its own textures.
+ */
+static int ship_gfxDecode( void *ptr )
+{
+   ShipGfxLoad *l = ptr;
+   Ship *s = l->s;
+   if (s->gfx_3d_path != NULL)
+      s->gfx_3d = object_loadFromFile( s->gfx_3d_path );
+   if (s->gfx_space_path != NULL)
+      ship_decodeSpaceImage( l, s->gfx_space_path, s->gfx_sx, s->gfx_sy );
    return 0;
 }
 
 /**
- * @brief Loads the space graphics for a ship from an image.
- *
- *    @param temp Ship to load into.
- *    @param str Path of the image to use.
- *    @param sx Number of X sprites in image.
- *    @param sy Number of Y sprites in image.
+ * @brief Creates the textures of decoded ship graphics, has to be run from
+ *        the main thread.
  */
-static int ship_loadEngineImage( Ship *temp, char *str, int sx, int sy )
+static void ship_gfxUpload( ShipGfxLoad *l )
 {
-   temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS );
-   return (temp->gfx_engine != NULL);
+   Ship *s = l->s;
+   char buf[PATH_MAX];
+
+   if (l->space != NULL) {
+      s->gfx_space = gl_loadImagePad( s->gfx_space_path, l->space,
+            OPENGL_TEX_MIPMAPS | OPENGL_TEX_VFLIP,
+            l->space->w, l->space->h, s->gfx_sx, s->gfx_sy, 0 );
+      if (l->trans != NULL)
+         gl_texSetTransMap( s->gfx_space, l->trans, l->space->w, l->space->h );
+   }
+   if (l->store != NULL) {
+      snprintf( buf, sizeof(buf), "%s_gfx_store", s->name );
+      s->gfx_store = gl_loadImagePad( buf, l->store, OPENGL_TEX_VFLIP, SHIP_TARGET_W, SHIP_TARGET_H, 1, 1, 1 );
+   }
+   if (l->target != NULL) {
+      snprintf( buf, sizeof(buf), "%s_gfx_target", s->name );
+      s->gfx_target = gl_loadImagePad( buf, l->target, OPENGL_TEX_VFLIP, l->target->w, l->target->h, 1, 1, 1 );
+   }
+
+   /* Free stuff. */
+   SDL_FreeSurface( l->space );
+   free( l->trans );
+   memset( l, 0, sizeof(ShipGfxLoad) );
+
+   s->gfx_loaded = 1;
+   s->gfx_unused = 0;
 }
 
 /**
- * @brief Loads the graphics for a ship.
+ * @brief Sets up the graphics paths for a ship, they get loaded by ship_gfxLoad.
  *
  *    @param temp Ship to load into.
  *    @param buf Name of the texture to work with.
@@ -483,26 +631,34 @@ static int ship_loadGFX( Ship *temp, const char *buf, int sx, int sy, int engine
    delim = strchr( buf, '_' );
    base = delim==NULL ? strdup( buf ) : strndup( buf, delim-buf );
 
-   /* Load the 3d model */
+   /* The 3d model. */
    snprintf(str, sizeof(str), SHIP_3DGFX_PATH"%s/%s/%s.obj", base, buf, buf);
-   if (PHYSFS_exists(str))
-      temp->gfx_3d = object_loadFromFile(str);
+   if (ndata_exists(str)) {
+      free( temp->gfx_3d_path );
+      temp->gfx_3d_path = strdup( str );
+   }
 
-   /* Load the space sprite. */
+   /* The space sprite. */
    ext = ".webp";
    snprintf( str, sizeof(str), SHIP_GFX_PATH"%s/%s%s", base, buf, ext );
-   if (!PHYSFS_exists(str)) {
+   if (!ndata_exists(str)) {
       ext = ".png";
       snprintf( str, sizeof(str), SHIP_GFX_PATH"%s/%s%s", base, buf, ext );
    }
-   ship_loadSpaceImage( temp, str, sx, sy );
+   free( temp->gfx_space_path );
+   temp->gfx_space_path = strdup( str );
+   temp->gfx_sx = sx;
+   temp->gfx_sy = sy;
 
-   /* Load the engine sprite .*/
+   /* The engine sprite .*/
    if (engine) {
       snprintf( str, sizeof(str), SHIP_GFX_PATH"%s/%s"SHIP_ENGINE"%s", base, buf, ext );
-      ship_loadEngineImage( temp, str, sx, sy );
-      if (temp->gfx_engine == NULL)
+      if (!ndata_exists(str))
          WARN(_("Ship '%s' does not have an engine sprite (%s)."), temp->name, str );
+      else {
+         free( temp->gfx_engine_path );
+         temp->gfx_engine_path = strdup( str );
+      }
    }
 
    /* Get the comm graphic for future loading. */
@@ -516,6 +672,137 @@ static int ship_loadGFX( Ship *temp, const char *buf, int sx, int sy, int engine
    return 0;
 }
 
+/**
+ * @brief Makes sure the graphics of a ship are loaded.
+ *
+ * Ship graphics are only loaded when first needed, anything that uses
+ *  gfx_space, gfx_engine, gfx_target, gfx_store or gfx_3d of a ship that is
+ *  not flown by a pilot has to call this first.
+ *
+ *    @param s Ship to load graphics of.
+ */
+void ship_gfxLoad( const Ship *s )
+{
+   /* The graphics are a cache, so it's fine to modify them. */
+   ShipGfxLoad l = { .s = (Ship*) s };
+   if (s->gfx_loaded)
+      return;
+   ship_gfxDecode( &l );
+   if (s->gfx_engine_path != NULL)
+      l.s->gfx_engine = gl_newSprite( s->gfx_engine_path, s->gfx_sx, s->gfx_sy, OPENGL_TEX_MIPMAPS );
+   ship_gfxUpload( &l );
+}
+
+/**
+ * @brief Loads the graphics of a set of ships in parallel.
+ *
+ * The images get decoded and get their transparency and target graphics
+ *  generated on the worker threads, only creating the textures is left to
+ *  the main thread.
+ *
+ *    @param ships Array (array.h) of ships to load graphics of.
+ */
+void ships_gfxLoad( Ship *const *ships )
+{
+   ThreadQueue *tq;
+   glTexLoader *ld;
+   ShipGfxLoad *loads;
+   int n = 0;
+
+   for (int i=0; i<array_size(ships); i++)
+      if (!ships[i]->gfx_loaded)
+         n++;
+   if (n == 0)
+      return;
+   if (n == 1) {
+      for (int i=0; i<array_size(ships); i++)
+         ship_gfxLoad( ships[i] );
+      return;
+   }
+
+   /* Pointers have to be stable for the jobs. */
+   loads = array_create_size( ShipGfxLoad, n );
+   ld = gl_texLoaderCreate();
+   for (int i=0; i<array_size(ships); i++) {
+      /* Duplicates are possible, only load each ship once. */
+      Ship *s = ships[i];
+      ShipGfxLoad *l;
+      if (s->gfx_loaded || (s->gfx_unused < 0))
+         continue;
+      s->gfx_unused = -1;
+      l = &array_grow( &loads );
+      memset( l, 0, sizeof(ShipGfxLoad) );
+      l->s = s;
+      if (s->gfx_engine_path != NULL)
+         gl_texLoaderAdd( ld, s->gfx_engine_path, s->gfx_sx, s->gfx_sy, OPENGL_TEX_MIPMAPS, &s->gfx_engine );
+   }
+
+   /* Decode, 3D models still need the context for their textures. */
+   tq = vpool_create();
+   for (int i=0; i<array_size(loads); i++)
+      vpool_enqueue( tq, ship_gfxDecode, &loads[i] );
+   SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Upload. */
+   for (int i=0; i<array_size(loads); i++)
+      ship_gfxUpload( &loads[i] );
+   gl_texLoaderWait( ld );
+   array_free( loads );
+}
+
+/**
+ * @brief Frees the graphics of a ship.
+ */
+static void ship_gfxUnload( Ship *s )
+{
+   object_free( s->gfx_3d );
+   gl_freeTexture( s->gfx_space );
+   gl_freeTexture( s->gfx_engine );
+   gl_freeTexture( s->gfx_target );
+   gl_freeTexture( s->gfx_store );
+   s->gfx_3d      = NULL;
+   s->gfx_space   = NULL;
+   s->gfx_engine  = NULL;
+   s->gfx_target  = NULL;
+   s->gfx_store   = NULL;
+   s->gfx_loaded  = 0;
+   s->gfx_unused  = 0;
+}
+
+/**
+ * @brief Frees the graphics of ships that have not been used for a while.
+ *
+ * Should be called on system change once the non-persistent pilots are
+ *  gone, graphics of ships no pilot has flown for SHIP_GFX_UNUSED_MAX calls
+ *  are freed.
+ */
+void ships_gfxUnloadUnused (void)
+{
+   Pilot *const* pilot_stack = pilot_getAll();
+   const PlayerShip_t *pships = player_getShipStack();
+   uint8_t *used = calloc( array_size(ship_stack), sizeof(uint8_t) );
+
+   /* Mark the ships in use. */
+   for (int i=0; i<array_size(pilot_stack); i++)
+      used[ pilot_stack[i]->ship - ship_stack ] = 1;
+   for (int i=0; i<array_size(pships); i++)
+      used[ pships[i].p->ship - ship_stack ] = 1;
+
+   for (int i=0; i<array_size(ship_stack); i++) {
+      Ship *s = &ship_stack[i];
+      if (!s->gfx_loaded)
+         continue;
+      if (used[i])
+         s->gfx_unused = 0;
+      else if (++s->gfx_unused >= SHIP_GFX_UNUSED_MAX)
+         ship_gfxUnload( s );
+   }
+   free( used );
+}
+
 /**
  * @brief Loads the collision polygon for a ship.
  *
@@ -532,7 +819,7 @@ static int ship_loadPLG( Ship *temp, const char *buf, int size_hint )
    snprintf( file, sizeof(file), "%s%s.xml", SHIP_POLYGON_PATH, buf );
 
    /* See if the file does exist. */
-   if (!PHYSFS_exists(file)) {
+   if (!ndata_exists(file)) {
       WARN(_("%s xml collision polygon does not exist!\n \
                Please use the script 'polygon_from_sprite.py' if sprites are used,\n \
                And 'polygonSTL.py' if 3D model is used in game.\n \
@@ -737,7 +1024,7 @@ static int ship_parse( Ship *temp, const char *filename )
          /* Load the polygon, run before graphics!. */
          ship_loadPLG( temp, buf, sx*sy );
 
-         /* Load the graphics. */
+         /* Set up the graphics. */
          ship_loadGFX( temp, buf, sx, sy, !noengine );
 
          continue;
@@ -764,8 +1051,11 @@ static int ship_parse( Ship *temp, const char *filename )
             ship_loadPLG( temp, plg, sx*sy );
          free( plg );
 
-         /* Load the graphics. */
-         ship_loadSpaceImage( temp, str, sx, sy );
+         /* Graphics get loaded when needed. */
+         free( temp->gfx_space_path );
+         temp->gfx_space_path = strdup( str );
+         temp->gfx_sx = sx;
+         temp->gfx_sy = sy;
 
          continue;
       }
@@ -783,8 +1073,11 @@ static int ship_parse( Ship *temp, const char *filename )
          xmlr_attr_int_def( node, "sx", sx, 8 );
          xmlr_attr_int_def( node, "sy", sy, 8 );
 
-         /* Load the graphics. */
-         ship_loadEngineImage( temp, str, sx, sy );
+         /* Graphics get loaded when needed, they share the space sprite layout. */
+         free( temp->gfx_engine_path );
+         temp->gfx_engine_path = strdup( str );
+         if ((sx != temp->gfx_sx) || (sy != temp->gfx_sy))
+            WARN(_("Ship '%s': gfx_engine sprite layout does not match gfx_space."), temp->name);
 
          continue;
       }
@@ -1028,11 +1321,18 @@ static int ship_parse( Ship *temp, const char *filename )
       }
    }
 
+   /* Mount angle only depends on the sprite layout. */
+   if (temp->gfx_space_path != NULL) {
+      if (!ndata_exists( temp->gfx_space_path ))
+         WARN(_("Ship '%s': unable to find '%s'!"), temp->name, temp->gfx_space_path );
+      temp->mangle = 2.*M_PI / (temp->gfx_sx * temp->gfx_sy);
+   }
+
    /* Ship XML validator */
 #define MELEMENT(o,s)      if (o) WARN( _("Ship '%s' missing '%s' element"), temp->name, s)
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->base_type==NULL,"base_type");
-   MELEMENT((temp->gfx_space==NULL) || (temp->gfx_comm==NULL),"GFX");
+   MELEMENT((temp->gfx_space_path==NULL) || (temp->gfx_comm==NULL),"GFX");
    MELEMENT(temp->class==SHIP_CLASS_NULL,"class");
    MELEMENT(temp->points==0,"points");
    MELEMENT(temp->price==0,"price");
@@ -1145,6 +1445,16 @@ int ships_load (void)
    /* Shrink stack. */
    array_shrink(&ship_stack);
 
+   /* Index by name. */
+   nameindex_init( &ship_index, 0 );
+   nameindex_init( &ship_indexCase, 1 );
+   nameindex_reserve( &ship_index, array_size(ship_stack) );
+   nameindex_reserve( &ship_indexCase, array_size(ship_stack) );
+   for (int i=0; i<array_size(ship_stack); i++) {
+      nameindex_add( &ship_index, ship_stack[i].name, i );
+      nameindex_add( &ship_indexCase, ship_stack[i].name, i );
+   }
+
    /* Second pass to load Lua. */
    for (int i=0; i<array_size(ship_stack); i++) {
       Ship *s = &ship_stack[i];
@@ -1205,6 +1515,8 @@ int ships_load (void)
  */
 void ships_free (void)
 {
+   ship_commFree();
+
    for (int i=0; i < array_size(ship_stack); i++) {
       Ship *s = &ship_stack[i];
 
@@ -1235,12 +1547,11 @@ void ships_free (void)
       ss_free( s->stats );
 
       /* Free graphics. */
-      object_free(s->gfx_3d);
-      gl_freeTexture(s->gfx_space);
-      gl_freeTexture(s->gfx_engine);
-      gl_freeTexture(s->gfx_target);
-      gl_freeTexture(s->gfx_store);
+      ship_gfxUnload( s );
       free(s->gfx_comm);
+      free(s->gfx_space_path);
+      free(s->gfx_engine_path);
+      free(s->gfx_3d_path);
       for (int j=0; j<array_size(s->gfx_overlays); j++)
          gl_freeTexture(s->gfx_overlays[j]);
       array_free(s->gfx_overlays);
@@ -1264,6 +1575,8 @@ void ships_free (void)
    }
 
    array_free(ship_stack);
+   nameindex_free( &ship_index );
+   nameindex_free( &ship_indexCase );
    ship_stack = NULL;
 }
 
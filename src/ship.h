@@ -140,6 +140,13 @@ typedef struct Ship_ {
    glTexture *gfx_target;  /**< Targeting window graphic. */
    glTexture *gfx_store;   /**< Store graphic. */
    char* gfx_comm;         /**< Name of graphic for communication. */
+   char *gfx_space_path;   /**< Path of the space sprite sheet, loaded by ship_gfxLoad. */
+   char *gfx_engine_path;  /**< Path of the engine glow sprite sheet, loaded by ship_gfxLoad. */
+   char *gfx_3d_path;      /**< Path of the 3d model, loaded by ship_gfxLoad. */
+   int gfx_sx;             /**< Number of X sprites in the sprite sheets. */
+   int gfx_sy;             /**< Number of Y sprites in the sprite sheets. */
+   int gfx_loaded;         /**< Whether or not the graphics above are loaded. */
+   int gfx_unused;         /**< System changes the loaded graphics have gone unused. */
    glTexture **gfx_overlays; /**< Array (array.h): Store overlay graphics. */
    ShipTrailEmitter *trail_emitters; /**< Trail emitters. */
 
@@ -184,6 +191,13 @@ typedef struct Ship_ {
 int ships_load (void);
 void ships_free (void);
 
+/*
+ * Graphics, loaded on demand.
+ */
+void ship_gfxLoad( const Ship *s );
+void ships_gfxLoad( Ship *const *ships );
+void ships_gfxUnloadUnused (void);
+
 /*
  * Getters.
  */
@@ -198,6 +212,7 @@ ShipClass ship_classFromString( const char* str );
 credits_t ship_basePrice( const Ship* s );
 credits_t ship_buyPrice( const Ship* s );
 glTexture* ship_loadCommGFX( const Ship* s );
+void ship_prefetchCommGFX( const Ship* s );
 int ship_size( const Ship *s );
 
 /*
@@ -10,13 +10,13 @@
 
 #include "shiplog.h"
 
-/*Hold a single log entry - a double linked list*/
+#include "array.h"
+
+/* Hold a single log entry. */
 typedef struct {
-  int id;
+  uint64_t seq; /**< Order the entry was added in, across all the logs. */
   ntime_t time;
   char *msg;
-  void *next;
-  void *prev;
 } ShipLogEntry;
 
 /* Holding global information about the log. */
@@ -27,18 +27,143 @@ typedef struct {
   ntime_t *removeAfter;
   char **idstrList;
   int *maxLen;
+  ShipLogEntry **entryList; /**< Entries of each log, oldest first (array.h). */
   int nlogs;
-  ShipLogEntry *head; /**< The head (newest entry) */
-  ShipLogEntry *tail; /**< The tail (oldest entry) */
+  uint64_t seq; /**< Sequence number of the last entry added. */
+  int *idstrHash; /**< Open addressing table of log indices by idstr, -1 if empty. */
+  int idstrHashSize; /**< Size of idstrHash, 0 when it has to be rebuilt. */
 } ShipLog;
 
+/* An entry with the log it is from, for listing across logs. */
+typedef struct {
+  int id;
+  const ShipLogEntry *e;
+} ShipLogRef;
 
 static ShipLog shipLog; /**< The player's ship log. */
 
 /*
  * Prototypes.
  */
-static ShipLogEntry *shiplog_removeEntry(ShipLogEntry *e);
+static int shiplog_grow (void);
+static void shiplog_removeEntries( int indx );
+static int shiplog_index( int logid );
+static int shiplog_findIdstr( const char *idstr );
+static int shiplog_cmpRef( const void *p1, const void *p2 );
+
+/**
+ * @brief Hashes an idstr.
+ */
+static unsigned int shiplog_hash( const char *str )
+{
+   unsigned int h = 2166136261u;
+   for (; *str != '\0'; str++)
+      h = (h ^ (unsigned char)*str) * 16777619u;
+   return h;
+}
+
+/**
+ * @brief Finds the index of the log with an idstr.
+ *
+ *    @param idstr ID string to look for, NULL matches the first log without one.
+ *    @return Index of the log or -1 if not found.
+ */
+static int shiplog_findIdstr( const char *idstr )
+{
+   unsigned int mask;
+
+   if (idstr == NULL) {
+      for (int i=0; i<shipLog.nlogs; i++)
+         if ((shipLog.idstrList[i] == NULL) && (shipLog.idList[i] >= 0))
+            return i;
+      return -1;
+   }
+
+   /* Rebuild the table if it was invalidated. */
+   if (shipLog.idstrHashSize == 0) {
+      int size = 16;
+      while (size < 2*shipLog.nlogs)
+         size *= 2;
+      shipLog.idstrHash = realloc( shipLog.idstrHash, sizeof(int) * size );
+      memset( shipLog.idstrHash, -1, sizeof(int) * size );
+      shipLog.idstrHashSize = size;
+      for (int i=0; i<shipLog.nlogs; i++) {
+         unsigned int h;
+         if (shipLog.idstrList[i] == NULL)
+            continue;
+         h = shiplog_hash( shipLog.idstrList[i] ) & (size-1);
+         while (shipLog.idstrHash[h] >= 0) {
+            /* Keep the first log with the idstr. */
+            if (strcmp( shipLog.idstrList[ shipLog.idstrHash[h] ], shipLog.idstrList[i] )==0)
+               break;
+            h = (h+1) & (size-1);
+         }
+         if (shipLog.idstrHash[h] < 0)
+            shipLog.idstrHash[h] = i;
+      }
+   }
+
+   mask = shipLog.idstrHashSize-1;
+   for (unsigned int h = shiplog_hash( idstr ) & mask;
+         shipLog.idstrHash[h] >= 0; h = (h+1) & mask) {
+      int i = shipLog.idstrHash[h];
+      if (strcmp( shipLog.idstrList[i], idstr )==0)
+         return i;
+   }
+   return -1;
+}
+
+/**
+ * @brief Finds the index of a log by ID.
+ *
+ *    @param logid ID of the log.
+ *    @return Index of the log or -1 if not found.
+ */
+static int shiplog_index( int logid )
+{
+   if (logid < 0)
+      return -1;
+   for (int i=0; i<shipLog.nlogs; i++)
+      if (shipLog.idList[i] == logid)
+         return i;
+   return -1;
+}
+
+/**
+ * @brief Adds space for a new log.
+ *
+ *    @return Index of the new log.
+ */
+static int shiplog_grow (void)
+{
+   int indx = shipLog.nlogs++;
+   shipLog.idList      = realloc(shipLog.idList, sizeof(int) * shipLog.nlogs);
+   shipLog.nameList    = realloc(shipLog.nameList, sizeof(char*) * shipLog.nlogs);
+   shipLog.typeList    = realloc(shipLog.typeList, sizeof(char*) * shipLog.nlogs);
+   shipLog.removeAfter = realloc(shipLog.removeAfter, sizeof(ntime_t) * shipLog.nlogs);
+   shipLog.idstrList   = realloc(shipLog.idstrList, sizeof(char*) * shipLog.nlogs);
+   shipLog.maxLen      = realloc(shipLog.maxLen, sizeof(int) * shipLog.nlogs);
+   shipLog.entryList   = realloc(shipLog.entryList, sizeof(ShipLogEntry*) * shipLog.nlogs);
+   shipLog.removeAfter[indx] = 0;
+   shipLog.idstrList[indx] = NULL;
+   shipLog.maxLen[indx] = 0;
+   shipLog.entryList[indx] = NULL;
+   shipLog.idstrHashSize = 0;
+   return indx;
+}
+
+/**
+ * @brief Removes all the entries of a log.
+ *
+ *    @param indx Index of the log.
+ */
+static void shiplog_removeEntries( int indx )
+{
+   for (int i=0; i<array_size(shipLog.entryList[indx]); i++)
+      free( shipLog.entryList[indx][i].msg );
+   array_free( shipLog.entryList[indx] );
+   shipLog.entryList[indx] = NULL;
+}
 
 
 /**
@@ -55,7 +180,6 @@ int shiplog_create( const char *idstr,
       const char *logname, const char *type,
       int overwrite, int maxLen)
 {
-   ShipLogEntry *e;
    int i, id, indx;
    indx = shipLog.nlogs;
 
@@ -64,15 +188,14 @@ int shiplog_create( const char *idstr,
       /* check to see whether this idstr or logname and type has been created before, and if so, remove all entries of that logid */
       if (idstr != NULL) {
          /* find the matching logid for this idstr */
-         for (i=0; i<shipLog.nlogs; i++) {
-            if ((shipLog.idstrList[i] != NULL)
-                  && (strcmp(shipLog.idstrList[i], idstr)==0)) {
-               /* matching idstr found. */
-               id = shipLog.idList[i];
-               indx = i;
-               break;
-            }
+         i = shiplog_findIdstr( idstr );
+         if (i >= 0) {
+            /* matching idstr found. */
+            id = shipLog.idList[i];
+            indx = i;
          }
+         else
+            i = shipLog.nlogs;
       } else {
          for (i=0; i<shipLog.nlogs; i++) {
             if ((strcmp(type, shipLog.typeList[i])==0)
@@ -84,15 +207,7 @@ int shiplog_create( const char *idstr,
          }
       }
       if (i < shipLog.nlogs) { /* prev id found - so remove all log entries of this type. */
-         e = shipLog.head;
-         while (e != NULL) {
-            if (e->id == id) {
-               /* remove this entry */
-               e = shiplog_removeEntry( e );
-            } else {
-               e = (ShipLogEntry*)e->next;
-            }
-         }
+         shiplog_removeEntries( i );
          shipLog.maxLen[i] = maxLen;
       }
    } else if (overwrite == 2) {
@@ -104,13 +219,7 @@ int shiplog_create( const char *idstr,
                   && ( strcmp(idstr, shipLog.idstrList[i]) == 0 ) )
                || ( ( idstr == NULL )
                   && ( strcmp(type, shipLog.typeList[i]) == 0 ) ) ) {
-            e = shipLog.head;
-            while (e != NULL) {
-               if (e->id == shipLog.idList[i])
-                  e = shiplog_removeEntry( e );
-               else
-                  e = e->next;
-            }
+            shiplog_removeEntries( i );
             if (found == 0) { /* This is the first entry of this type */
                found = 1;
                id = shipLog.idList[i];
@@ -122,6 +231,7 @@ int shiplog_create( const char *idstr,
                shipLog.idList[i] = LOG_ID_INVALID;
                free( shipLog.idstrList[i] );
                shipLog.idstrList[i] = NULL;
+               shipLog.idstrHashSize = 0;
             }
          }
       }
@@ -129,14 +239,11 @@ int shiplog_create( const char *idstr,
 
    if ((indx == shipLog.nlogs) && (idstr != NULL)) {
       /* see if existing log with this idstr exists, if so, append to it */
-      for (i=0; i<shipLog.nlogs; i++) {
-         if ((shipLog.idstrList[i] != NULL)
-               && (strcmp( idstr, shipLog.idstrList[i] ) == 0)) {
-            id = shipLog.idList[i];
-            indx = i;
-            shipLog.maxLen[i] = maxLen;
-            break;
-         }
+      i = shiplog_findIdstr( idstr );
+      if (i >= 0) {
+         id = shipLog.idList[i];
+         indx = i;
+         shipLog.maxLen[i] = maxLen;
       }
    }
    if (indx == shipLog.nlogs) {
@@ -147,14 +254,7 @@ int shiplog_create( const char *idstr,
             id = shipLog.idList[i];
       }
       id++;
-      shipLog.nlogs++;
-      shipLog.idList      = realloc(shipLog.idList, sizeof(int) * shipLog.nlogs);
-      shipLog.nameList    = realloc(shipLog.nameList, sizeof(char*) * shipLog.nlogs);
-      shipLog.typeList    = realloc(shipLog.typeList, sizeof(char*) * shipLog.nlogs);
-      shipLog.removeAfter = realloc(shipLog.removeAfter, sizeof(ntime_t) * shipLog.nlogs);
-      shipLog.idstrList   = realloc(shipLog.idstrList, sizeof(char*) * shipLog.nlogs);
-      shipLog.maxLen      = realloc(shipLog.maxLen, sizeof(int) * shipLog.nlogs);
-      shipLog.removeAfter[indx] = 0;
+      indx = shiplog_grow();
       shipLog.idList[indx]   = id;
       shipLog.nameList[indx] = strdup(logname);
       shipLog.typeList[indx] = strdup(type);
@@ -174,14 +274,8 @@ int shiplog_create( const char *idstr,
 int shiplog_append( const char *idstr, const char *msg )
 {
    int i, id;
-   for (i=0; i<shipLog.nlogs; i++) {
-      if (((idstr == NULL) && (shipLog.idstrList[i] == NULL) )
-            || ((idstr != NULL) && (shipLog.idstrList[i] != NULL)
-               && (strcmp(idstr, shipLog.idstrList[i]) == 0))) {
-         break;
-      }
-   }
-   if (i==shipLog.nlogs) {
+   i = shiplog_findIdstr( idstr );
+   if (i < 0) {
       WARN(_("Warning - log not found: creating it"));
       id = shiplog_create( idstr, _( "Please report this log as an error to github.com/naev" ),
                            idstr != NULL ? idstr : "", 0, 0 );
@@ -201,61 +295,39 @@ int shiplog_append( const char *idstr, const char *msg )
  */
 int shiplog_appendByID( int logid,const char *msg )
 {
-   ShipLogEntry *e;
+   ShipLogEntry *entries, *e;
    ntime_t now = ntime_get();
-   int i,maxLen=0;
+   int indx, n, maxLen;
 
-   if (logid < 0)
+   indx = shiplog_index( logid );
+   if (indx < 0)
       return -1;
+   entries = shipLog.entryList[indx];
 
    /* Check that the log hasn't already been added (e.g. if reloading) */
-   e = shipLog.head;
-   /* check for identical logs */
-   while (e != NULL) {
-      if (e->time != now) { /* logs are created in chronological order */
+   for (int i=array_size(entries)-1; i>=0; i--) {
+      if (entries[i].time != now) /* logs are created in chronological order */
          break;
-      }
-      if ((logid == e->id) && (strcmp(e->msg,msg) == 0)) {
-         /* Identical log already exists */
+      if (strcmp(entries[i].msg,msg) == 0) /* Identical log already exists */
          return 0;
-      }
-      e = e->next;
-   }
-   if ((e = calloc(sizeof(ShipLogEntry),1)) == NULL) {
-      WARN(_("Error creating new log entry - crash imminent!\n"));
-      return -1;
    }
-   e->next = shipLog.head;
-   shipLog.head = e;
-   if (shipLog.tail == NULL) /* first entry - point to both head and tail.*/
-      shipLog.tail = e;
-   if (e->next != NULL)
-      ((ShipLogEntry*)e->next)->prev = (void*)e;
-   e->id = logid;
-   e->msg = strdup(msg);
+
+   if (entries == NULL)
+      entries = array_create( ShipLogEntry );
+   e = &array_grow( &entries );
+   e->seq  = ++shipLog.seq;
+   e->msg  = strdup(msg);
    e->time = now;
-   for (i=0; i<shipLog.nlogs; i++) {
-      if (shipLog.idList[i] == logid) {
-         maxLen = shipLog.maxLen[i];
-         break;
-      }
-   }
-   if (maxLen > 0) {
-      /* prune log entries if necessary */
-      i = 0;
-      e = shipLog.head;
-      while (e != NULL) {
-         if (e->id == logid) {
-            i++;
-            if (i > maxLen)
-               e = shiplog_removeEntry( e );
-            else
-               e = (ShipLogEntry*) e->next;
-         } else {
-            e = (ShipLogEntry*) e->next;
-         }
-      }
+
+   /* prune the oldest log entries if necessary */
+   maxLen = shipLog.maxLen[indx];
+   n = array_size(entries);
+   if ((maxLen > 0) && (n > maxLen)) {
+      for (int i=0; i<n-maxLen; i++)
+         free( entries[i].msg );
+      array_erase( &entries, &entries[0], &entries[n-maxLen] );
    }
+   shipLog.entryList[indx] = entries;
    return 0;
 }
 
@@ -266,34 +338,14 @@ int shiplog_appendByID( int logid,const char *msg )
  */
 void shiplog_delete( int logid )
 {
-   ShipLogEntry *e, *tmp;
    int i;
 
    if ((logid < 0) && (logid != LOG_ID_ALL))
       return;
 
-   e = shipLog.head;
-   while ( e != NULL ) {
-      if ( logid == LOG_ID_ALL || logid == e->id ) {
-         if ( e->prev != NULL )
-            ((ShipLogEntry*)e->prev)->next = e->next;
-         if ( e->next != NULL )
-            ((ShipLogEntry*)e->next)->prev = e->prev;
-         free( e->msg );
-         if ( e == shipLog.head )
-            shipLog.head = e->next;
-         if ( e == shipLog.tail )
-            shipLog.tail = e->prev;
-         tmp = e;
-         e = (ShipLogEntry*) e->next;
-         free( tmp );
-      } else {
-         e = (ShipLogEntry*)e->next;
-      }
-   }
-
    for ( i=0; i<shipLog.nlogs; i++) {
       if ( logid == LOG_ID_ALL || logid == shipLog.idList[i] ) {
+         shiplog_removeEntries( i );
          shipLog.idList[i] = LOG_ID_INVALID;
          free(shipLog.nameList[i]);
          shipLog.nameList[i] = NULL;
@@ -303,6 +355,7 @@ void shiplog_delete( int logid )
          shipLog.idstrList[i] = NULL;
          shipLog.maxLen[i]=0;
          shipLog.removeAfter[i] = 0;
+         shipLog.idstrHashSize = 0;
       }
    }
 }
@@ -361,6 +414,8 @@ void shiplog_clear (void)
    free( shipLog.idstrList );
    free( shipLog.maxLen );
    free( shipLog.removeAfter );
+   free( shipLog.entryList );
+   free( shipLog.idstrHash );
    memset(&shipLog, 0, sizeof(ShipLog));
 }
 
@@ -378,7 +433,7 @@ void shiplog_new (void)
 int shiplog_save( xmlTextWriterPtr writer )
 {
    int i;
-   ShipLogEntry *e;
+   ShipLogRef *refs;
    ntime_t t = ntime_get();
    xmlw_startElem(writer,"shiplog");
 
@@ -399,17 +454,25 @@ int shiplog_save( xmlTextWriterPtr writer )
          xmlw_endElem(writer);/* entry */
       }
    }
-   e=shipLog.head;
-   while ( e != NULL ) {
-      if ( e->id >= 0 ) {
-         xmlw_startElem(writer, "log");
-         xmlw_attr(writer,"id","%d",e->id);
-         xmlw_attr(writer,"t","%"PRIu64,e->time);
-         xmlw_str(writer,"%s",e->msg);
-         xmlw_endElem(writer);/* log */
+   /* Entries go newest first, across all the logs. */
+   refs = array_create( ShipLogRef );
+   for (i=0; i<shipLog.nlogs; i++) {
+      if (shipLog.idList[i] < 0)
+         continue;
+      for (int j=0; j<array_size(shipLog.entryList[i]); j++) {
+         ShipLogRef r = { .id = shipLog.idList[i], .e = &shipLog.entryList[i][j] };
+         array_push_back( &refs, r );
       }
-      e=(ShipLogEntry*)e->next;
    }
+   qsort( refs, array_size(refs), sizeof(ShipLogRef), shiplog_cmpRef );
+   for (i=0; i<array_size(refs); i++) {
+      xmlw_startElem(writer, "log");
+      xmlw_attr(writer,"id","%d",refs[i].id);
+      xmlw_attr(writer,"t","%"PRIu64,refs[i].e->time);
+      xmlw_str(writer,"%s",refs[i].e->msg);
+      xmlw_endElem(writer);/* log */
+   }
+   array_free( refs );
    xmlw_endElem(writer); /* economy */
    return 0;
 }
@@ -422,10 +485,13 @@ int shiplog_save( xmlTextWriterPtr writer )
 int shiplog_load( xmlNodePtr parent )
 {
    xmlNodePtr node, cur;
-   ShipLogEntry *e;
+   ShipLogRef *refs;
    int id,i;
    shiplog_clear();
 
+   /* Entries are stored newest first, and may come before their log. */
+   refs = array_create( ShipLogRef );
+
    node = parent->xmlChildrenNode;
    do {
       if (xml_isNode(node,"shiplog")) {
@@ -434,18 +500,8 @@ int shiplog_load( xmlNodePtr parent )
             if (xml_isNode(cur, "entry")) {
                xmlr_attr_int(cur, "id", id);
                /* check this ID isn't already present */
-               for ( i=0; i<shipLog.nlogs; i++ ) {
-                  if ( shipLog.idList[i] == id )
-                     break;
-               }
-               if ( i==shipLog.nlogs ) { /* a new ID */
-                  shipLog.nlogs++;
-                  shipLog.idList    = realloc( shipLog.idList, sizeof(int) * shipLog.nlogs);
-                  shipLog.nameList  = realloc( shipLog.nameList, sizeof(char*) * shipLog.nlogs);
-                  shipLog.typeList  = realloc( shipLog.typeList, sizeof(char*) * shipLog.nlogs);
-                  shipLog.removeAfter = realloc( shipLog.removeAfter, sizeof(ntime_t) * shipLog.nlogs);
-                  shipLog.idstrList = realloc( shipLog.idstrList, sizeof(char*) * shipLog.nlogs);
-                  shipLog.maxLen    = realloc( shipLog.maxLen, sizeof(int) * shipLog.nlogs);
+               if ( shiplog_index( id ) < 0 ) { /* a new ID */
+                  shiplog_grow();
                   shipLog.idList[shipLog.nlogs-1] = id;
                   xmlr_attr_strd( cur, "t", shipLog.typeList[shipLog.nlogs-1] );
                   xmlr_attr_long( cur, "r", shipLog.removeAfter[shipLog.nlogs-1] );
@@ -458,22 +514,36 @@ int shiplog_load( xmlNodePtr parent )
                   shipLog.nameList[shipLog.nlogs-1] = strdup(xml_raw(cur));
                }
             } else if (xml_isNode(cur, "log")) {
-               e = calloc( sizeof(ShipLogEntry), 1);
-               /* put this one at the end */
-               e->prev = shipLog.tail;
-               if ( shipLog.tail == NULL )
-                  shipLog.head = e;
-               else
-                  shipLog.tail->next = e;
-               shipLog.tail = e;
-
-               xmlr_attr_int( cur, "id", e->id );
+               ShipLogEntry *e = calloc( sizeof(ShipLogEntry), 1);
+               ShipLogRef r = { .id = -1, .e = e };
+               xmlr_attr_int( cur, "id", r.id );
                xmlr_attr_long( cur, "t", e->time );
                e->msg = strdup(xml_raw(cur));
+               array_push_back( &refs, r );
             }
          } while (xml_nextNode(cur));
       }
    } while (xml_nextNode(node));
+
+   /* Put the entries in their logs, oldest first. */
+   for (i=array_size(refs)-1; i>=0; i--) {
+      ShipLogEntry *e = (ShipLogEntry*) refs[i].e;
+      int indx = shiplog_index( refs[i].id );
+      if (indx < 0) {
+         WARN(_("Ship log entry for unknown log ID %d"), refs[i].id);
+         free( e->msg );
+      }
+      else {
+         ShipLogEntry *entries = shipLog.entryList[indx];
+         if (entries == NULL)
+            entries = array_create( ShipLogEntry );
+         e->seq = ++shipLog.seq;
+         array_push_back( &entries, *e );
+         shipLog.entryList[indx] = entries;
+      }
+      free( e );
+   }
+   array_free( refs );
    return 0;
 }
 
@@ -578,78 +648,101 @@ int shiplog_getIdOfLogOfType( const char *type, int selectedLog )
 }
 
 /**
- * @brief removes an entry from the log
- * @param e the entry to remove
- * @returns the next entry.
+ * @brief Orders entries newest first.
  */
-static ShipLogEntry *shiplog_removeEntry( ShipLogEntry *e )
+static int shiplog_cmpRef( const void *p1, const void *p2 )
 {
-   ShipLogEntry *tmp;
-   /* remove this entry */
-   if ( e->prev != NULL)
-      ((ShipLogEntry*)e->prev)->next = e->next;
-   if ( e->next != NULL )
-      ((ShipLogEntry*)e->next)->prev = e->prev;
-   if ( shipLog.head == e )
-      shipLog.head = e->next;
-   if ( shipLog.tail == e )
-      shipLog.tail = e->prev;
-   free(e->msg);
-   tmp=e;
-   e=(ShipLogEntry*)e->next;
-   free(tmp);
-   return e;
+   const ShipLogRef *r1 = p1;
+   const ShipLogRef *r2 = p2;
+   if (r1->e->seq > r2->e->seq)
+      return -1;
+   else if (r1->e->seq < r2->e->seq)
+      return +1;
+   return 0;
 }
 
 /**
- * @brief Get all log entries matching logid, or if logid==LOG_ID_ALL, matching type, or if type==NULL, all.
+ * @brief Formats a log entry for display.
  */
-void shiplog_listLog( int logid,
-      const char *type,int *nentries, char ***logentries, int incempty )
+static char *shiplog_formatEntry( const ShipLogEntry *e )
 {
-   int i,n = 0,all = 0;
-   char **entries = NULL;
-   ShipLogEntry *e, *use;
    char buf[5000];
    int pos;
-   e = shipLog.head;
-   if ( logid == LOG_ID_ALL ) {
-      all = 1;
-   }
-   while ( e != NULL ) {
-      use = NULL;
-      if ( logid == LOG_ID_ALL ) {
-         if ( all ) { /* add the log */
-            if ( e->id >= 0)
-               use=e;
-         } else { /* see if this log is of type */
-            for ( i=0; i<shipLog.nlogs; i++ ) {
-               if ( ( shipLog.idList[i] >= 0 )
-                     && ( e->id == shipLog.idList[i] )
-                     && ( strcmp(shipLog.typeList[i], type) == 0 ) ) {
-                  /* the type matches current messages */
-                  use = e;
-                  break; /* there should only be 1 log of this type and id. */
-               }
-            }
+   ntime_prettyBuf(buf, sizeof(buf), e->time, 2);
+   pos = strlen(buf);
+   scnprintf(&buf[pos], sizeof(buf)-pos, ":  %s", e->msg);
+   return strdup(buf);
+}
+
+/**
+ * @brief Get a page of the log entries matching logid, or if logid==LOG_ID_ALL, matching type, or if type==NULL, all.
+ *
+ * Entries are listed newest first, and only the ones in the page get formatted.
+ *
+ *    @param logid ID of the log or LOG_ID_ALL.
+ *    @param type Type of the logs when logid is LOG_ID_ALL, or NULL for all.
+ *    @param first Position of the first entry to get.
+ *    @param count Maximum number of entries to get.
+ *    @param[out] nentries Number of entries gotten.
+ *    @param[out] logentries Entries gotten, to be freed by the caller.
+ *    @return Total number of entries matching.
+ */
+int shiplog_listLogRange( int logid, const char *type, int first, int count,
+      int *nentries, char ***logentries )
+{
+   int n = 0, total = 0;
+   char **entries = NULL;
+
+   first = MAX( first, 0 );
+   if ( logid != LOG_ID_ALL ) { /* just this particular log */
+      int indx = shiplog_index( logid );
+      if ( indx >= 0 ) {
+         const ShipLogEntry *le = shipLog.entryList[indx];
+         total = array_size( le );
+         for ( int i=first; (i<total) && (n<count); i++ ) {
+            n++;
+            entries = realloc(entries, sizeof(char*) * n);
+            entries[n-1] = shiplog_formatEntry( &le[total-1-i] );
          }
-      } else { /* just this particular log*/
-         if ( e->id == logid ) {
-            use = e;
+      }
+   }
+   else {
+      /* Combined view, merged by the order entries were added in. */
+      ShipLogRef *refs = array_create( ShipLogRef );
+      for ( int i=0; i<shipLog.nlogs; i++ ) {
+         if ( shipLog.idList[i] < 0 )
+            continue;
+         if ( ( type != NULL ) && ( strcmp(shipLog.typeList[i], type) != 0 ) )
+            continue;
+         for ( int j=0; j<array_size(shipLog.entryList[i]); j++ ) {
+            ShipLogRef r = { .id = shipLog.idList[i], .e = &shipLog.entryList[i][j] };
+            array_push_back( &refs, r );
          }
       }
-      if ( use != NULL ) {
+      total = array_size( refs );
+      qsort( refs, total, sizeof(ShipLogRef), shiplog_cmpRef );
+      for ( int i=first; (i<total) && (n<count); i++ ) {
          n++;
          entries = realloc(entries, sizeof(char*) * n);
-         ntime_prettyBuf(buf, sizeof(buf), use->time, 2);
-         pos = strlen(buf);
-         pos += scnprintf(&buf[pos], sizeof(buf)-pos, ":  %s", use->msg);
-         entries[n-1] = strdup(buf);
+         entries[n-1] = shiplog_formatEntry( refs[i].e );
       }
-
-      e = e -> next;
+      array_free( refs );
    }
-   (void)pos;
+
+   *logentries = entries;
+   *nentries = n;
+   return total;
+}
+
+/**
+ * @brief Get all log entries matching logid, or if logid==LOG_ID_ALL, matching type, or if type==NULL, all.
+ */
+void shiplog_listLog( int logid,
+      const char *type,int *nentries, char ***logentries, int incempty )
+{
+   int n;
+   char **entries;
+   shiplog_listLogRange( logid, type, 0, INT_MAX, &n, &entries );
    if ( ( n == 0 ) && ( incempty != 0 ) ) {
       /*empty list, so add "Empty" */
       n = 1;
@@ -667,15 +760,6 @@ void shiplog_listLog( int logid,
  */
 int shiplog_getID( const char *idstr )
 {
-   int id = -1;
-   int i;
-   for ( i=0; i<shipLog.nlogs; i++ ) {
-      if ( ( ( shipLog.idstrList[i] == NULL ) && ( idstr == NULL) )
-            || ( ( shipLog.idstrList[i] != NULL ) && ( idstr != NULL )
-               && ( strcmp(idstr, shipLog.idstrList[i]) == 0 ) ) ) {
-         id = shipLog.idList[i];
-         break;
-      }
-   }
-   return id;
+   int i = shiplog_findIdstr( idstr );
+   return (i < 0) ? -1 : shipLog.idList[i];
 }
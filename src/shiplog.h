@@ -36,4 +36,5 @@ void shiplog_listTypes( int *ntypes, char ***logTypes, int includeAll );
 void shiplog_listLogsOfType( const char *type, int *nlogs, char ***logsOut, int **logIDs, int includeAll );
 int shiplog_getIdOfLogOfType ( const char *type, int selectedLog );
 void shiplog_listLog( int logid, const char *type,int *nentries, char ***logentries,int incempty );
+int shiplog_listLogRange( int logid, const char *type, int first, int count, int *nentries, char ***logentries );
 int shiplog_getID( const char *idstr );
@@ -79,6 +79,15 @@ typedef struct ShipStatsLookup_ {
 #define N__ELEM( t ) \
    { .type=t, .name=NULL, .display=NULL, .unit=NULL, .inverted=0, .offset=0 }
 
+/**
+ * @brief Run of contiguous fields in ShipStats that merge the same way.
+ */
+typedef struct ShipStatsRun_ {
+   size_t offset;       /**< Byte offset of the first field. */
+   int n;               /**< Number of fields in the run. */
+   StatDataType data;   /**< How the fields are merged. */
+} ShipStatsRun;
+
 /**
  * The ultimate look up table for ship stats, everything goes through this.
  */
@@ -410,6 +419,62 @@ int ss_sort( ShipStatList **ll )
 }
 
 
+static ShipStatsRun ss_runs[ SS_TYPE_SENTINEL ]; /**< Merge plan for ss_statsMerge. */
+static int ss_nruns = 0; /**< Number of runs in ss_runs. */
+
+/**
+ * @brief Compares stats by their offset in the structure.
+ */
+static int ss_compareOffset( const void *p1, const void *p2 )
+{
+   const ShipStatsLookup *sl1 = *(const ShipStatsLookup**) p1;
+   const ShipStatsLookup *sl2 = *(const ShipStatsLookup**) p2;
+   return (sl1->offset > sl2->offset) - (sl1->offset < sl2->offset);
+}
+
+/**
+ * @brief Gets the kind of merge a data type uses, absolute percents merge as absolute.
+ */
+static StatDataType ss_mergeType( StatDataType data )
+{
+   return (data==SS_DATA_TYPE_DOUBLE_ABSOLUTE_PERCENT) ? SS_DATA_TYPE_DOUBLE_ABSOLUTE : data;
+}
+
+/**
+ * @brief Builds the merge plan, grouping fields that are next to each other
+ *        in the structure and merge the same way into runs.
+ *
+ * This lets ss_statsMerge work on plain arrays the compiler can vectorize
+ *  instead of going through the look up table for each field.
+ */
+static void ss_buildRuns (void)
+{
+   const ShipStatsLookup *sorted[ SS_TYPE_SENTINEL ];
+   int n = 0;
+
+   for (int i=0; i<SS_TYPE_SENTINEL; i++)
+      if (ss_lookup[i].name != NULL)
+         sorted[n++] = &ss_lookup[i];
+   qsort( sorted, n, sizeof(const ShipStatsLookup*), ss_compareOffset );
+
+   ss_nruns = 0;
+   for (int i=0; i<n; i++) {
+      StatDataType data = ss_mergeType( sorted[i]->data );
+      size_t size = (data==SS_DATA_TYPE_INTEGER || data==SS_DATA_TYPE_BOOLEAN) ? sizeof(int) : sizeof(double);
+      if (ss_nruns > 0) {
+         ShipStatsRun *r = &ss_runs[ ss_nruns-1 ];
+         if ((r->data == data) && (r->offset + r->n*size == sorted[i]->offset)) {
+            r->n++;
+            continue;
+         }
+      }
+      ss_runs[ ss_nruns ].offset = sorted[i]->offset;
+      ss_runs[ ss_nruns ].n      = 1;
+      ss_runs[ ss_nruns ].data   = data;
+      ss_nruns++;
+   }
+}
+
 /**
  * @brief Checks for validity.
  */
@@ -423,6 +488,7 @@ int ss_check (void)
       }
    }
 
+   ss_buildRuns();
    return 0;
 }
 
@@ -475,46 +541,39 @@ int ss_statsInit( ShipStats *stats )
  */
 int ss_statsMerge( ShipStats *dest, const ShipStats *src )
 {
-   int *destint;
-   const int *srcint;
-   double *destdbl;
-   const double *srcdbl;
-   char *destptr;
-   const char *srcptr;
+   char *destptr = (char*) dest;
+   const char *srcptr = (const char*) src;
 
-   destptr = (char*) dest;
-   srcptr = (const char*) src;
-   for (int i=0; i<SS_TYPE_SENTINEL; i++) {
-      const ShipStatsLookup *sl = &ss_lookup[ i ];
+   if (ss_nruns == 0)
+      ss_buildRuns();
 
-      /* Only want valid names. */
-      if (sl->name == NULL)
-         continue;
+   for (int i=0; i<ss_nruns; i++) {
+      const ShipStatsRun *r = &ss_runs[i];
+      double *destdbl = (double*) (void*)&destptr[ r->offset ];
+      const double *srcdbl = (const double*) (const void*)&srcptr[ r->offset ];
+      int *destint = (int*) (void*)&destptr[ r->offset ];
+      const int *srcint = (const int*) (const void*)&srcptr[ r->offset ];
 
-      switch (sl->data) {
+      switch (r->data) {
          case SS_DATA_TYPE_DOUBLE:
-            destdbl = (double*) (void*)&destptr[ sl->offset ];
-            srcdbl = (const double*) (const void*)&srcptr[ sl->offset ];
-            *destdbl = (*destdbl) * (*srcdbl);
+            for (int j=0; j<r->n; j++)
+               destdbl[j] *= srcdbl[j];
             break;
 
          case SS_DATA_TYPE_DOUBLE_ABSOLUTE:
          case SS_DATA_TYPE_DOUBLE_ABSOLUTE_PERCENT:
-            destdbl = (double*) (void*)&destptr[ sl->offset ];
-            srcdbl = (const double*) (const void*)&srcptr[ sl->offset ];
-            *destdbl = (*destdbl) + (*srcdbl);
+            for (int j=0; j<r->n; j++)
+               destdbl[j] += srcdbl[j];
             break;
 
          case SS_DATA_TYPE_INTEGER:
-            destint = (int*) &destptr[ sl->offset ];
-            srcint = (const int*) &srcptr[ sl->offset ];
-            *destint = (*destint) + (*srcint);
+            for (int j=0; j<r->n; j++)
+               destint[j] += srcint[j];
             break;
 
          case SS_DATA_TYPE_BOOLEAN:
-            destint = (int*) &destptr[ sl->offset ];
-            srcint = (const int*) &srcptr[ sl->offset ];
-            *destint = !!((*destint) + (*srcint));
+            for (int j=0; j<r->n; j++)
+               destint[j] = !!(destint[j] + srcint[j]);
             break;
       }
    }
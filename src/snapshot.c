@@ -0,0 +1,509 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file snapshot.c
+ *
+ * @brief In-memory snapshots of the simulation of the running system.
+ *
+ * A snapshot is a binary copy of the state that evolves while flying around:
+ *  the physics, health, energy, heat and timers of the pilots and their
+ *  outfits, the asteroids and the random number generator. Restoring it puts
+ *  the system back to that point, so the same fight can be replayed from an
+ *  identical state for quick reloads and benchmarks.
+ *
+ * Snapshots only live in memory and are only valid for the system and pilots
+ *  they were taken from. Pilots are matched by ID: the ones that appeared
+ *  since are removed, while the ones that died since can't be brought back.
+ *  Weapons in flight are cleared instead of being restored, and Lua state
+ *  such as AI memory and tasks is left as it is.
+ */
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "snapshot.h"
+
+#include "array.h"
+#include "asteroid.h"
+#include "log.h"
+#include "ntracing.h"
+#include "pilot.h"
+#include "player.h"
+#include "rng.h"
+#include "space.h"
+#include "weapon.h"
+
+#define SNAPSHOT_MAGIC     0x504e534e /**< "NSNP", identifies snapshots. */
+#define SNAPSHOT_VERSION   1          /**< Version of the snapshot layout. */
+
+/**
+ * @brief Snapshot of the running system.
+ */
+struct Snapshot_ {
+   const StarSystem *sys; /**< System the snapshot was taken in. */
+   char *data;             /**< Serialised state (array.h). */
+};
+
+/**
+ * @brief Header of the serialised state.
+ */
+typedef struct SnapshotHeader_ {
+   uint32_t magic;   /**< SNAPSHOT_MAGIC. */
+   uint32_t version; /**< SNAPSHOT_VERSION. */
+   RngState rng;     /**< State of the random number generator. */
+   int npilots;      /**< Number of pilots that follow. */
+   int nanchors;     /**< Number of asteroid anchors that follow the pilots. */
+} SnapshotHeader;
+
+/**
+ * @brief Serialised state of a pilot, followed by its outfit slots.
+ */
+typedef struct SnapshotPilot_ {
+   unsigned int id;  /**< ID of the pilot. */
+   double dir;       /**< Direction the pilot is facing. */
+   double dir_vel;   /**< Rotation velocity. */
+   vec2 vel;         /**< Velocity. */
+   vec2 pos;         /**< Position. */
+   vec2 pre;         /**< Previous position. */
+   double accel;     /**< Relative acceleration of the solid. */
+   double armour;    /**< Current armour. */
+   double stress;    /**< Current disable damage. */
+   double shield;    /**< Current shield. */
+   double fuel;      /**< Current fuel. */
+   double energy;    /**< Current energy. */
+   double heat_T;    /**< Ship temperature. */
+   double ctimer;    /**< Remaining cooldown time. */
+   double heat_start;/**< Temperature at the start of a cooldown. */
+   double ew_stealth_timer; /**< Stealth timer. */
+   double tcontrol;  /**< AI control tick timer. */
+   double timer[MAX_AI_TIMERS]; /**< AI timers. */
+   double ptimer;    /**< Generic pilot timer. */
+   double itimer;    /**< Invulnerability timer. */
+   double stimer;    /**< Shield regeneration timer. */
+   double sbonus;    /**< Shield regeneration bonus. */
+   double dtimer;    /**< Disable timer. */
+   double dtimer_accum; /**< Accumulated disable timer. */
+   double otimer;    /**< Lua outfit timer. */
+   double scantimer; /**< Scanning timer. */
+   unsigned int target; /**< Pilot target. */
+   int noutfits;     /**< Number of outfit slots that follow. */
+} SnapshotPilot;
+
+/**
+ * @brief Serialised state of an outfit slot.
+ */
+typedef struct SnapshotSlot_ {
+   const Outfit *outfit;   /**< Outfit in the slot, to check it didn't change. */
+   PilotOutfitState state; /**< State of the outfit. */
+   double heat_T;    /**< Slot temperature. */
+   double heat_start;/**< Slot heat at the beginning of a cooldown. */
+   double stimer;    /**< State timer. */
+   double timer;     /**< Time since last used. */
+   double rtimer;    /**< Reload timer. */
+   double progress;  /**< State progress. */
+   int quantity;     /**< Ammo, for launchers. */
+   double lockon_timer; /**< Lock on timer, for launchers. */
+} SnapshotSlot;
+
+/**
+ * @brief Serialised state of an asteroid.
+ */
+typedef struct SnapshotAsteroid_ {
+   int state;        /**< State of the asteroid. */
+   double armour;    /**< Current armour. */
+   double dir;       /**< Direction of the solid. */
+   vec2 vel;         /**< Velocity. */
+   vec2 pos;         /**< Position. */
+   vec2 pre;         /**< Previous position. */
+   double ang;       /**< Angle. */
+   double spin;      /**< Spin. */
+   double timer;     /**< Animation timer. */
+   double timer_max; /**< Animation timer initial value. */
+   int scanned;      /**< Whether the player scanned it. */
+} SnapshotAsteroid;
+
+/**
+ * @brief Reads back serialised state.
+ */
+typedef struct SnapshotReader_ {
+   const char *data; /**< Data being read. */
+   size_t size;      /**< Size of the data. */
+   size_t pos;       /**< Current read position. */
+} SnapshotReader;
+
+/*
+ * Prototypes.
+ */
+static void snapshot_write( char **buf, const void *data, size_t size );
+static int snapshot_read( SnapshotReader *r, void *data, size_t size );
+static void snapshot_writePilot( char **buf, const Pilot *p );
+static int snapshot_readPilot( SnapshotReader *r, Pilot *p );
+static int snapshot_cmpID( const void *p1, const void *p2 );
+
+/**
+ * @brief Appends data to a serialised state.
+ */
+static void snapshot_write( char **buf, const void *data, size_t size )
+{
+   int n = array_size(*buf);
+   array_resize( buf, n+size );
+   memcpy( &(*buf)[n], data, size );
+}
+
+/**
+ * @brief Reads data from a serialised state.
+ *
+ *    @return 0 on success, -1 if there is not enough data left.
+ */
+static int snapshot_read( SnapshotReader *r, void *data, size_t size )
+{
+   if (r->pos + size > r->size)
+      return -1;
+   if (data != NULL)
+      memcpy( data, &r->data[r->pos], size );
+   r->pos += size;
+   return 0;
+}
+
+/**
+ * @brief Serialises a pilot and its outfit slots.
+ */
+static void snapshot_writePilot( char **buf, const Pilot *p )
+{
+   SnapshotPilot sp;
+
+   memset( &sp, 0, sizeof(sp) );
+   sp.id       = p->id;
+   sp.dir      = p->solid.dir;
+   sp.dir_vel  = p->solid.dir_vel;
+   sp.vel      = p->solid.vel;
+   sp.pos      = p->solid.pos;
+   sp.pre      = p->solid.pre;
+   sp.accel    = p->solid.accel;
+   sp.armour   = p->armour;
+   sp.stress   = p->stress;
+   sp.shield   = p->shield;
+   sp.fuel     = p->fuel;
+   sp.energy   = p->energy;
+   sp.heat_T   = p->heat_T;
+   sp.ctimer   = p->ctimer;
+   sp.heat_start = p->heat_start;
+   sp.ew_stealth_timer = p->ew_stealth_timer;
+   sp.tcontrol = p->tcontrol;
+   memcpy( sp.timer, p->timer, sizeof(sp.timer) );
+   sp.ptimer   = p->ptimer;
+   sp.itimer   = p->itimer;
+   sp.stimer   = p->stimer;
+   sp.sbonus   = p->sbonus;
+   sp.dtimer   = p->dtimer;
+   sp.dtimer_accum = p->dtimer_accum;
+   sp.otimer   = p->otimer;
+   sp.scantimer = p->scantimer;
+   sp.target   = p->target;
+   sp.noutfits = array_size(p->outfits);
+   snapshot_write( buf, &sp, sizeof(sp) );
+
+   for (int i=0; i<sp.noutfits; i++) {
+      const PilotOutfitSlot *o = p->outfits[i];
+      SnapshotSlot ss;
+      memset( &ss, 0, sizeof(ss) );
+      ss.outfit   = o->outfit;
+      ss.state    = o->state;
+      ss.heat_T   = o->heat_T;
+      ss.heat_start = o->heat_start;
+      ss.stimer   = o->stimer;
+      ss.timer    = o->timer;
+      ss.rtimer   = o->rtimer;
+      ss.progress = o->progress;
+      if ((o->outfit != NULL) && !outfit_isBeam(o->outfit)) {
+         ss.quantity     = o->u.ammo.quantity;
+         ss.lockon_timer = o->u.ammo.lockon_timer;
+      }
+      snapshot_write( buf, &ss, sizeof(ss) );
+   }
+}
+
+/**
+ * @brief Restores a pilot and its outfit slots.
+ *
+ *    @param r Reader positioned at the pilot.
+ *    @param p Pilot to restore, or NULL to skip it.
+ *    @return 0 on success.
+ */
+static int snapshot_readPilot( SnapshotReader *r, Pilot *p )
+{
+   SnapshotPilot sp;
+   int match;
+
+   if (snapshot_read( r, &sp, sizeof(sp) ))
+      return -1;
+
+   /* Pilot is gone. */
+   if (p == NULL)
+      return snapshot_read( r, NULL, sp.noutfits * sizeof(SnapshotSlot) );
+
+   p->solid.dir     = sp.dir;
+   p->solid.dir_vel = sp.dir_vel;
+   p->solid.vel     = sp.vel;
+   p->solid.pos     = sp.pos;
+   p->solid.pre     = sp.pre;
+   p->solid.accel   = sp.accel;
+   p->armour   = sp.armour;
+   p->stress   = sp.stress;
+   p->shield   = sp.shield;
+   p->fuel     = sp.fuel;
+   p->energy   = sp.energy;
+   p->heat_T   = sp.heat_T;
+   p->ctimer   = sp.ctimer;
+   p->heat_start = sp.heat_start;
+   p->ew_stealth_timer = sp.ew_stealth_timer;
+   p->tcontrol = sp.tcontrol;
+   memcpy( p->timer, sp.timer, sizeof(sp.timer) );
+   p->ptimer   = sp.ptimer;
+   p->itimer   = sp.itimer;
+   p->stimer   = sp.stimer;
+   p->sbonus   = sp.sbonus;
+   p->dtimer   = sp.dtimer;
+   p->dtimer_accum = sp.dtimer_accum;
+   p->otimer   = sp.otimer;
+   p->scantimer = sp.scantimer;
+   if (pilot_get( sp.target ) != NULL)
+      pilot_setTarget( p, sp.target );
+
+   /* Outfits are only restored if they are still the same. */
+   match = (sp.noutfits == array_size(p->outfits));
+   for (int i=0; i<sp.noutfits; i++) {
+      PilotOutfitSlot *o;
+      SnapshotSlot ss;
+      if (snapshot_read( r, &ss, sizeof(ss) ))
+         return -1;
+      if (!match || (p->outfits[i]->outfit != ss.outfit))
+         continue;
+      o = p->outfits[i];
+      o->heat_T   = ss.heat_T;
+      o->heat_start = ss.heat_start;
+      o->stimer   = ss.stimer;
+      o->timer    = ss.timer;
+      o->rtimer   = ss.rtimer;
+      o->progress = ss.progress;
+      if (o->outfit == NULL)
+         continue;
+      if (outfit_isBeam(o->outfit)) {
+         /* Beams were cleared with the weapons, they get fired again. */
+         o->u.beamid = 0;
+         o->state    = (ss.state == PILOT_OUTFIT_ON) ? PILOT_OUTFIT_OFF : ss.state;
+      }
+      else {
+         o->state = ss.state;
+         o->u.ammo.quantity     = ss.quantity;
+         o->u.ammo.lockon_timer = ss.lockon_timer;
+      }
+   }
+   return 0;
+}
+
+/**
+ * @brief Compares pilot IDs for sorting and searching.
+ */
+static int snapshot_cmpID( const void *p1, const void *p2 )
+{
+   unsigned int id1 = *(const unsigned int*) p1;
+   unsigned int id2 = *(const unsigned int*) p2;
+   return (id1 > id2) - (id1 < id2);
+}
+
+/**
+ * @brief Takes a snapshot of the running system.
+ *
+ *    @return The new snapshot or NULL if not in a system.
+ */
+Snapshot *snapshot_take (void)
+{
+   Snapshot *snap;
+   SnapshotHeader hdr;
+   Pilot *const* pilots = pilot_getAll();
+
+   if (cur_system == NULL)
+      return NULL;
+
+   NTracingZone( _ctx, 1 );
+
+   snap       = calloc( 1, sizeof(Snapshot) );
+   snap->sys  = cur_system;
+   snap->data = array_create( char );
+
+   memset( &hdr, 0, sizeof(hdr) );
+   hdr.magic   = SNAPSHOT_MAGIC;
+   hdr.version = SNAPSHOT_VERSION;
+   rng_getState( &hdr.rng );
+   for (int i=0; i<array_size(pilots); i++)
+      if (!pilot_isFlag(pilots[i], PILOT_DELETE))
+         hdr.npilots++;
+   hdr.nanchors = array_size(cur_system->asteroids);
+   snapshot_write( &snap->data, &hdr, sizeof(hdr) );
+
+   /* Pilots. */
+   for (int i=0; i<array_size(pilots); i++)
+      if (!pilot_isFlag(pilots[i], PILOT_DELETE))
+         snapshot_writePilot( &snap->data, pilots[i] );
+
+   /* Asteroids. */
+   for (int i=0; i<hdr.nanchors; i++) {
+      const AsteroidAnchor *ast = &cur_system->asteroids[i];
+      int n = array_size(ast->asteroids);
+      snapshot_write( &snap->data, &n, sizeof(n) );
+      for (int j=0; j<n; j++) {
+         const Asteroid *a = &ast->asteroids[j];
+         SnapshotAsteroid sa;
+         memset( &sa, 0, sizeof(sa) );
+         sa.state    = a->state;
+         sa.armour   = a->armour;
+         sa.dir      = a->sol.dir;
+         sa.vel      = a->sol.vel;
+         sa.pos      = a->sol.pos;
+         sa.pre      = a->sol.pre;
+         sa.ang      = a->ang;
+         sa.spin     = a->spin;
+         sa.timer    = a->timer;
+         sa.timer_max = a->timer_max;
+         sa.scanned  = a->scanned;
+         snapshot_write( &snap->data, &sa, sizeof(sa) );
+      }
+   }
+
+   NTracingZoneEnd( _ctx );
+   return snap;
+}
+
+/**
+ * @brief Restores the running system to a snapshot.
+ *
+ *    @param snap Snapshot to restore.
+ *    @return The number of pilots of the snapshot that no longer exist, or
+ *            -1 if the snapshot can't be restored.
+ */
+int snapshot_restore( const Snapshot *snap )
+{
+   SnapshotReader r;
+   SnapshotHeader hdr;
+   unsigned int *ids;
+   int missing, restore_ast;
+
+   if ((snap == NULL) || (snap->sys != cur_system) || (cur_system == NULL)) {
+      WARN(_("Snapshot was not taken in the current system!"));
+      return -1;
+   }
+
+   r.data = snap->data;
+   r.size = array_size(snap->data);
+   r.pos  = 0;
+   if (snapshot_read( &r, &hdr, sizeof(hdr) ) ||
+         (hdr.magic != SNAPSHOT_MAGIC) || (hdr.version != SNAPSHOT_VERSION)) {
+      WARN(_("Snapshot is corrupt!"));
+      return -1;
+   }
+
+   NTracingZone( _ctx, 1 );
+
+   /* Weapons can't be recreated, so start with none. */
+   weapon_clear();
+
+   /* Pilots. */
+   missing = 0;
+   ids = malloc( MAX(1,hdr.npilots) * sizeof(unsigned int) );
+   for (int i=0; i<hdr.npilots; i++) {
+      unsigned int id;
+      Pilot *p;
+      if (snapshot_read( &r, &id, sizeof(id) ))
+         break;
+      r.pos -= sizeof(id); /* ID is part of the pilot. */
+      ids[i] = id;
+      p = pilot_get( id );
+      if ((p != NULL) && pilot_isFlag(p, PILOT_DELETE))
+         p = NULL;
+      if (p == NULL)
+         missing++;
+      if (snapshot_readPilot( &r, p )) {
+         WARN(_("Snapshot is corrupt!"));
+         free( ids );
+         NTracingZoneEnd( _ctx );
+         return -1;
+      }
+   }
+
+   /* Pilots that appeared since the snapshot go away. */
+   qsort( ids, hdr.npilots, sizeof(unsigned int), snapshot_cmpID );
+   for (int i=0; i<array_size(pilot_getAll()); i++) {
+      Pilot *p = pilot_getAll()[i]; /* Deleting runs Lua, which may touch the stack. */
+      if ((p == player.p) || pilot_isFlag(p, PILOT_DELETE))
+         continue;
+      if (bsearch( &p->id, ids, hdr.npilots, sizeof(unsigned int), snapshot_cmpID ) == NULL)
+         pilot_delete( p );
+   }
+   free( ids );
+
+   /* Asteroids, only if the fields didn't change. */
+   restore_ast = (hdr.nanchors == array_size(cur_system->asteroids));
+   for (int i=0; i<hdr.nanchors; i++) {
+      int n;
+      if (snapshot_read( &r, &n, sizeof(n) ))
+         break;
+      if (!restore_ast || (n != array_size(cur_system->asteroids[i].asteroids))) {
+         snapshot_read( &r, NULL, n * sizeof(SnapshotAsteroid) );
+         continue;
+      }
+      for (int j=0; j<n; j++) {
+         Asteroid *a = &cur_system->asteroids[i].asteroids[j];
+         SnapshotAsteroid sa;
+         if (snapshot_read( &r, &sa, sizeof(sa) ))
+            break;
+         a->state    = sa.state;
+         a->armour   = sa.armour;
+         a->sol.dir  = sa.dir;
+         a->sol.vel  = sa.vel;
+         a->sol.pos  = sa.pos;
+         a->sol.pre  = sa.pre;
+         a->ang      = sa.ang;
+         a->spin     = sa.spin;
+         a->timer    = sa.timer;
+         a->timer_max = sa.timer_max;
+         a->scanned  = sa.scanned;
+      }
+   }
+
+   /* Same random numbers from here on. */
+   rng_setState( &hdr.rng );
+
+   NTracingZoneEnd( _ctx );
+   return missing;
+}
+
+/**
+ * @brief Gets the size of the serialised state of a snapshot.
+ *
+ *    @param snap Snapshot to get the size of.
+ *    @return Size in bytes.
+ */
+size_t snapshot_size( const Snapshot *snap )
+{
+   if (snap == NULL)
+      return 0;
+   return array_size(snap->data);
+}
+
+/**
+ * @brief Frees a snapshot.
+ *
+ *    @param snap Snapshot to free.
+ */
+void snapshot_free( Snapshot *snap )
+{
+   if (snap == NULL)
+      return;
+   array_free( snap->data );
+   free( snap );
+}
@@ -0,0 +1,15 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+typedef struct Snapshot_ Snapshot; /**< Opaque snapshot of the running system. */
+
+Snapshot *snapshot_take (void);
+int snapshot_restore( const Snapshot *snap );
+size_t snapshot_size( const Snapshot *snap );
+void snapshot_free( Snapshot *snap );
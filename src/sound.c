@@ -22,6 +22,8 @@
  * will pretend to play the buffer.
  * 4) Every so often we'll check to see if the important voices are being
  * played and take away the sources from the lesser ones.
+ * 5) Voices live on the audio thread, the main thread only queues commands
+ * for it so it never waits on OpenAL to play or move sounds.
  *
  * EFX
  *
@@ -31,6 +33,7 @@
  * - Reverb
  */
 /** @cond */
+#include <stdatomic.h>
 #include <sys/stat.h>
 #include "physfs.h"
 #include "SDL.h"
@@ -48,10 +51,13 @@
 #include "camera.h"
 #include "conf.h"
 #include "env.h"
+#include "loadprof.h"
 #include "log.h"
+#include "memstats.h"
 #include "music.h"
 #include "ndata.h"
 #include "nstring.h"
+#include "ntracing.h"
 #include "physics.h"
 #include "player.h"
 #include "nopenal.h"
@@ -63,8 +69,21 @@
 #define SOUND_SUFFIX_WAV   ".wav" /**< Suffix of sounds. */
 #define SOUND_SUFFIX_OGG   ".ogg" /**< Suffix of sounds. */
 
+#define SOUND_CMD_MAX         1024 /**< Size of the command queue, must be a power of two. */
+#define SOUND_THREAD_DELAY    5    /**< Milliseconds between updates of the audio thread. */
+#define SOUND_POS_SLOTS       256  /**< Latest position slots, indexed by voice, must be a power of two. */
+
+#define SOUND_MERGE_TIME      30   /**< Milliseconds within which the same sound is merged. */
+#define SOUND_MERGE_DIST      100. /**< Distance within which the same sound is merged. */
+
+#define SOUND_STREAM_BUFFERS  4         /**< Number of buffers in the ring of a streamed voice. */
+#define SOUND_STREAM_SIZE     (32*1024) /**< Size in bytes of each streamed buffer. */
+#define SOUND_STREAM_DELAY    10        /**< Milliseconds between refills of the streaming thread. */
+
 #define voiceLock()        SDL_LockMutex(voice_mutex)
 #define voiceUnlock()      SDL_UnlockMutex(voice_mutex)
+#define streamLock()       SDL_LockMutex(stream_mutex)
+#define streamUnlock()     SDL_UnlockMutex(stream_mutex)
 
 /**
  * @struct alSound
@@ -76,9 +95,33 @@ typedef struct alSound_ {
    char *name; /**< Buffer's name. */
    double length; /**< Length of the buffer. */
    int channels; /**< Number of channels of the buffer. */
-   ALuint buf; /**< Buffer data. */
+   ALuint buf; /**< Buffer data, 0 for streamed sounds that were never decoded. */
+   unsigned int last_start; /**< Ticks when it was last played positionally. */
+   int last_voice; /**< Voice it was last played positionally with. */
+   ALfloat last_pos[2]; /**< Position it was last played at. */
+   size_t mem; /**< Size of the buffer data. */
+   int stream; /**< Whether the sound is streamed from filename when played. */
+   int nstreams; /**< Number of voices streaming the sound. */
+   unsigned int last_used; /**< Use counter value when it was last played. */
 } alSound;
 
+/**
+ * @brief Decoding state of a voice playing a streamed sound.
+ *
+ * Streams are refilled by the streaming thread, which only touches them with
+ *  stream_mutex held.
+ */
+typedef struct alStream_ {
+   int sound; /**< Sound being streamed. */
+   OggVorbis_File vf; /**< Vorbis file being decoded. */
+   ALenum format; /**< Format of the decoded data. */
+   long rate; /**< Sample rate of the decoded data. */
+   ALuint source; /**< Source the buffers are queued on. */
+   ALuint bufs[SOUND_STREAM_BUFFERS]; /**< Ring of buffers. */
+   int eof; /**< The whole file has been decoded. */
+   int done; /**< The voice was stopped, don't refill nor restart it. */
+} alStream;
+
 /**
  * @typedef voice_state_t
  * @brief The state of a voice.
@@ -109,10 +152,53 @@ typedef struct alVoice_ {
 
    ALfloat pos[3]; /**< Position of the voice. */
    ALfloat vel[3]; /**< Velocity of the voice. */
-   ALuint source; /**< Source current in use. */
+   ALuint source; /**< Source current in use, 0 if the voice is virtual. */
    ALuint buffer; /**< Buffer attached to the voice. */
+   alStream *stream; /**< Stream feeding the source, NULL if using buffer. */
+   int sound; /**< Sound being played. */
+   ALint relative; /**< Whether the voice isn't positional. */
+   unsigned int start; /**< Ticks when the voice started. */
+   unsigned int end; /**< Ticks when the voice will be done. */
+   unsigned int posseq; /**< Sequence of the last position taken from its slot. */
 } alVoice;
 
+/**
+ * @brief Types of commands for the audio thread.
+ */
+typedef enum SoundCmdType_ {
+   SOUND_CMD_PLAY,      /**< Creates and plays a voice. */
+   SOUND_CMD_UPDATEPOS, /**< Updates the position of a voice. */
+   SOUND_CMD_STOP,      /**< Stops a voice. */
+   SOUND_CMD_STOPALL,   /**< Stops all the voices. */
+   SOUND_CMD_LISTENER,  /**< Updates the listener. */
+} SoundCmdType;
+
+/**
+ * @brief Command for the audio thread.
+ */
+typedef struct SoundCmd_ {
+   SoundCmdType type; /**< Type of command. */
+   int id; /**< Voice the command affects. */
+   int sound; /**< Sound to play. */
+   ALint relative; /**< Whether the voice to play isn't positional. */
+   ALfloat pos[2]; /**< Position. */
+   ALfloat vel[2]; /**< Velocity. */
+   double dir; /**< Direction of the listener. */
+} SoundCmd;
+
+/**
+ * @brief Latest position of a voice for the audio thread.
+ *
+ * Positions are updated every frame, so instead of queueing each update only
+ *  the latest one is kept. The sequence is odd while the main thread writes.
+ */
+typedef struct SoundPos_ {
+   atomic_uint seq; /**< Sequence, bumped before and after writing. */
+   int id; /**< Voice the position belongs to. */
+   ALfloat pos[2]; /**< Position. */
+   ALfloat vel[2]; /**< Velocity. */
+} SoundPos;
+
 typedef struct alGroup_s {
    int id; /**< Group ID. */
 
@@ -137,6 +223,8 @@ static int sound_initialized  = 0; /**< Whether or not sound is initialized. */
  * Sound list.
  */
 static alSound *sound_list    = NULL; /**< List of available sounds. */
+static size_t sound_resident_mem = 0; /**< Memory used by the decoded sounds that can be evicted. */
+static unsigned int sound_usegen = 0; /**< Use counter for the LRU eviction. */
 
 /*
  * Voices.
@@ -145,6 +233,29 @@ static int voice_genid        = 0; /**< Voice identifier generator. */
 static alVoice *voice_active  = NULL; /**< Active voices. */
 static alVoice *voice_pool    = NULL; /**< Pool of free voices. */
 static SDL_mutex *voice_mutex = NULL; /**< Lock for voices. */
+static ALfloat listener_pos[2] = { 0., 0. }; /**< Listener position, for voice priorities. */
+
+/*
+ * Audio thread.
+ */
+static SDL_Thread *sound_thread = NULL; /**< Thread running the voices. */
+static atomic_int sound_thread_quit = 0; /**< Tells the audio thread to stop. */
+static SoundCmd sound_cmds[ SOUND_CMD_MAX ]; /**< Ring of commands for the audio thread. */
+static atomic_uint sound_cmd_head = 0; /**< Where the main thread pushes commands. */
+static atomic_uint sound_cmd_tail = 0; /**< Where the audio thread pops commands. */
+static unsigned int sound_cmd_dropped = 0; /**< Commands dropped because the queue was full. */
+static SDL_sem *sound_cmd_wake = NULL; /**< Wakes up the audio thread early. */
+static SoundPos sound_pos[ SOUND_POS_SLOTS ]; /**< Latest positions of the voices. */
+static atomic_uint sound_pos_gen = 0; /**< Bumped when any position is written. */
+static unsigned int sound_pos_seen = 0; /**< Last sound_pos_gen handled by the audio thread. */
+
+/*
+ * Streaming.
+ */
+static alStream **stream_list = NULL; /**< Streams being played (array.h). */
+static SDL_mutex *stream_mutex = NULL; /**< Lock for streams, taken before soundLock(). */
+static SDL_Thread *stream_thread = NULL; /**< Thread refilling the streams. */
+static int stream_quit        = 0; /**< Tells the streaming thread to stop. */
 
 /*
  * Internally used sounds.
@@ -158,7 +269,18 @@ static double snd_compression_gain = 0.; /**< Current compression gain. */
  */
 /* General. */
 static int sound_makeList (void);
+static int sound_new( SDL_RWops *rw, const char *name, const char *path );
+static int sound_decode( alSound *snd );
+static int sound_resident( alSound *snd );
+static int sound_inUse( const alSound *snd );
+static void sound_evict( const alSound *keep );
 static void sound_free( alSound *snd );
+/* Streaming. */
+static int stream_test( alSound *snd, SDL_RWops *rw );
+static alStream *stream_open( int sound, ALuint source );
+static void stream_close( alStream *st );
+static int stream_fill( alStream *st, ALuint buf );
+static int stream_threadFunc( void *data );
 /* Voices. */
 
 /*
@@ -239,10 +361,23 @@ static alGroup_t *al_getGroup( int group );
 static alVoice* voice_new (void);
 static int voice_add( alVoice* v );
 static alVoice* voice_get( int id );
+static void voice_stop( alVoice *v );
+static double voice_priority( const alVoice *v );
+static int voice_steal( const alVoice *v );
+static int voice_promote( alVoice *v, ALuint source );
 /*
  * Sound playing.
  */
 static void al_updateVoice( alVoice *v );
+static void sound_updateVoices (void);
+/*
+ * Audio thread.
+ */
+static void sound_cmdPush( const SoundCmd *cmd );
+static void sound_cmdRun (void);
+static void sound_posRun (void);
+static void sound_cmdExec( const SoundCmd *cmd );
+static int sound_threadFunc( void *data );
 static void al_volumeUpdate (void);
 /*
  * Vorbis stuff.
@@ -626,6 +761,9 @@ int sound_init (void)
    voice_mutex = SDL_CreateMutex();
    if (voice_mutex == NULL)
       WARN(_("Unable to create voice mutex."));
+   stream_mutex = SDL_CreateMutex();
+   if (stream_mutex == NULL)
+      WARN(_("Unable to create stream mutex."));
 
    /* Load available sounds. */
    ret = sound_makeList();
@@ -656,6 +794,13 @@ int sound_init (void)
       sound_speedGroup( snd_compressionG, 0 );
    }
 
+   /* Hand the voices over to their own thread. */
+   atomic_store( &sound_thread_quit, 0 );
+   sound_cmd_wake = SDL_CreateSemaphore( 0 );
+   sound_thread = SDL_CreateThread( sound_threadFunc, "sound", NULL );
+   if (sound_thread == NULL)
+      WARN(_("Unable to create audio thread, updating sound on the main thread: %s"), SDL_GetError());
+
    return 0;
 }
 
@@ -668,6 +813,38 @@ void sound_exit (void)
    if (sound_disabled || !sound_initialized)
       return;
 
+   /* Stop the audio thread, it runs the pending commands first. */
+   if (sound_thread != NULL) {
+      atomic_store( &sound_thread_quit, 1 );
+      SDL_SemPost( sound_cmd_wake );
+      SDL_WaitThread( sound_thread, NULL );
+      sound_thread = NULL;
+   }
+   SDL_DestroySemaphore( sound_cmd_wake );
+   sound_cmd_wake = NULL;
+   if (sound_cmd_dropped > 0)
+      WARN(_("%u sound commands were dropped because the queue was full."), sound_cmd_dropped);
+
+   /* Stop streaming. */
+   if (stream_thread != NULL) {
+      streamLock();
+      stream_quit = 1;
+      streamUnlock();
+      SDL_WaitThread( stream_thread, NULL );
+      stream_thread = NULL;
+      stream_quit = 0;
+   }
+   if (stream_mutex != NULL) {
+      streamLock();
+      while (array_size(stream_list) > 0)
+         stream_close( stream_list[0] );
+      array_free( stream_list );
+      stream_list = NULL;
+      streamUnlock();
+      SDL_DestroyMutex( stream_mutex );
+      stream_mutex = NULL;
+   }
+
    if (voice_mutex != NULL) {
       voiceLock();
       /* free the voices. */
@@ -721,6 +898,8 @@ void sound_exit (void)
    for (int i=0; i<array_size(sound_list); i++)
       sound_free( &sound_list[i] );
    array_free( sound_list );
+   sound_list = NULL;
+   sound_resident_mem = 0;
 
    /* Clean up EFX stuff. */
    if (al_info.efx == AL_TRUE) {
@@ -774,10 +953,16 @@ int sound_get( const char* name )
  */
 double sound_getLength( int sound )
 {
+   alSound *s;
+
    if (sound_disabled)
       return 0.;
 
-   return sound_list[sound].length;
+   /* The length of lazily loaded sounds is only known once decoded. */
+   s = &sound_list[sound];
+   if ((s->length <= 0.) && (s->buf == 0) && !s->stream)
+      sound_resident( s );
+   return s->length;
 }
 
 /**
@@ -788,8 +973,8 @@ double sound_getLength( int sound )
  */
 int sound_play( int sound )
 {
-   alVoice *v;
    alSound *s;
+   SoundCmd cmd;
 
    if (sound_disabled)
       return 0;
@@ -797,21 +982,21 @@ int sound_play( int sound )
    if ((sound < 0) || (sound >= array_size(sound_list)))
       return -1;
 
-   /* Gets a new voice. */
-   v = voice_new();
-
-   /* Get the sound. */
+   /* Get the sound, decoding it if needed. */
    s = &sound_list[sound];
-
-   /* Try to play the sound. */
-   if (al_playVoice( v, s, 0., 0., 0., 0., AL_TRUE ))
+   if (s->stream)
+      s->last_used = ++sound_usegen;
+   else if (sound_resident( s ))
       return -1;
 
-   /* Set state and add to list. */
-   v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
-   voice_add(v);
-   return v->id;
+   /* The voice gets created by the audio thread. */
+   memset( &cmd, 0, sizeof(cmd) );
+   cmd.type       = SOUND_CMD_PLAY;
+   cmd.id         = ++voice_genid;
+   cmd.sound      = sound;
+   cmd.relative   = AL_TRUE;
+   sound_cmdPush( &cmd );
+   return cmd.id;
 }
 
 /**
@@ -826,11 +1011,12 @@ int sound_play( int sound )
  */
 int sound_playPos( int sound, double px, double py, double vx, double vy )
 {
-   alVoice *v;
+   SoundCmd cmd;
    alSound *s;
    Pilot *p;
    double cx, cy, dist;
    int target;
+   unsigned int t;
 
    if (sound_disabled)
       return 0;
@@ -854,22 +1040,37 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
          return 0;
    }
 
-   /* Gets a new voice. */
-   v = voice_new();
-
-   /* Get the sound. */
+   /* The same sound started right before close by wouldn't be heard apart. */
    s = &sound_list[sound];
-
-   /* Try to play the sound. */
-   if (al_playVoice( v, s, px, py, vx, vy, AL_FALSE ))
+   t = SDL_GetTicks();
+   if ((s->last_voice > 0) && (t - s->last_start < SOUND_MERGE_TIME) &&
+         (pow2(px - s->last_pos[0]) + pow2(py - s->last_pos[1]) < pow2(SOUND_MERGE_DIST)))
+      return s->last_voice;
+
+   /* Get the sound, decoding it if needed. */
+   if (s->stream)
+      s->last_used = ++sound_usegen;
+   else if (sound_resident( s ))
       return -1;
 
-   /* Actually add the voice to the list. */
-   v->state = VOICE_PLAYING;
-   v->id = ++voice_genid;
-   voice_add(v);
-
-   return v->id;
+   /* The voice gets created by the audio thread. */
+   memset( &cmd, 0, sizeof(cmd) );
+   cmd.type       = SOUND_CMD_PLAY;
+   cmd.id         = ++voice_genid;
+   cmd.sound      = sound;
+   cmd.relative   = AL_FALSE;
+   cmd.pos[0]     = px;
+   cmd.pos[1]     = py;
+   cmd.vel[0]     = vx;
+   cmd.vel[1]     = vy;
+   sound_cmdPush( &cmd );
+
+   s->last_start  = t;
+   s->last_voice  = cmd.id;
+   s->last_pos[0] = px;
+   s->last_pos[1] = py;
+
+   return cmd.id;
 }
 
 /**
@@ -883,20 +1084,39 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
  */
 int sound_updatePos( int voice, double px, double py, double vx, double vy )
 {
-   alVoice *v;
+   SoundPos *sp;
+   unsigned int seq;
 
-   if (sound_disabled)
+   if (sound_disabled || (voice <= 0))
       return 0;
 
-   v = voice_get(voice);
-   if (v == NULL)
+   /* Without an audio thread just run it. */
+   if (sound_thread == NULL) {
+      SoundCmd cmd;
+      memset( &cmd, 0, sizeof(cmd) );
+      cmd.type    = SOUND_CMD_UPDATEPOS;
+      cmd.id      = voice;
+      cmd.pos[0]  = px;
+      cmd.pos[1]  = py;
+      cmd.vel[0]  = vx;
+      cmd.vel[1]  = vy;
+      sound_cmdPush( &cmd );
       return 0;
+   }
 
-   /* Update the voice. */
-   v->pos[0] = px;
-   v->pos[1] = py;
-   v->vel[0] = vx;
-   v->vel[1] = vy;
+   /* Overwrite the latest position of the voice. Only the main thread
+    * writes, the audio thread retries if it catches a write halfway. */
+   sp  = &sound_pos[ voice & (SOUND_POS_SLOTS-1) ];
+   seq = atomic_load_explicit( &sp->seq, memory_order_relaxed );
+   atomic_store_explicit( &sp->seq, seq+1, memory_order_relaxed );
+   atomic_thread_fence( memory_order_release );
+   sp->id      = voice;
+   sp->pos[0]  = px;
+   sp->pos[1]  = py;
+   sp->vel[0]  = vx;
+   sp->vel[1]  = vy;
+   atomic_store_explicit( &sp->seq, seq+2, memory_order_release );
+   atomic_fetch_add_explicit( &sound_pos_gen, 1, memory_order_release );
    return 0;
 }
 
@@ -959,9 +1179,26 @@ int sound_update( double dt )
       }
    }
 
-   if (voice_active == NULL)
-      return 0;
+   /* Without an audio thread the voices are handled here. */
+   if (sound_thread == NULL) {
+      sound_cmdRun();
+      sound_updateVoices();
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Updates the voices, removing obsolete ones and such.
+ */
+static void sound_updateVoices (void)
+{
+   if (voice_active == NULL) {
+      NTracingPlotI( "sound_voices", 0 );
+      return;
+   }
 
+   NTracingZone( _ctx, 1 );
    voiceLock();
 
    /* The actual control loop. */
@@ -999,9 +1236,40 @@ int sound_update( double dt )
       }
    }
 
-   voiceUnlock();
+   /* Give the free sources to the most important virtual voices. */
+   while (source_nstack > 0) {
+      alVoice *best = NULL;
+      double prio = 0.;
+      for (alVoice *v=voice_active; v!=NULL; v=v->next) {
+         double p;
+         if ((v->source != 0) || (v->state != VOICE_PLAYING) || sound_list[v->sound].stream)
+            continue;
+         p = voice_priority( v );
+         if ((best == NULL) || (p > prio)) {
+            best = v;
+            prio = p;
+         }
+      }
+      if (best == NULL)
+         break;
+      if (voice_promote( best, source_stack[source_nstack-1] ))
+         best->state = VOICE_DESTROY;
+      else
+         source_nstack--;
+   }
 
-   return 0;
+#if HAVE_TRACY
+   {
+      int nvoices = 0;
+      for (alVoice *v=voice_active; v!=NULL; v=v->next)
+         nvoices++;
+      NTracingPlotI( "sound_voices", nvoices );
+      NTracingPlotI( "sound_sources_free", source_nstack );
+   }
+#endif /* HAVE_TRACY */
+
+   voiceUnlock();
+   NTracingZoneEnd( _ctx );
 }
 
 /**
@@ -1043,27 +1311,14 @@ void sound_resume (void)
  */
 void sound_stopAll (void)
 {
-   if (sound_disabled)
-      return;
+   SoundCmd cmd;
 
-   /* Make sure there are voices. */
-   if (voice_active==NULL)
+   if (sound_disabled)
       return;
 
-   voiceLock();
-   for (alVoice *v=voice_active; v!=NULL; v=v->next) {
-      if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY))
-         continue;
-      if (v->source != 0) {
-         /* TODO not sure if we want to move the locks outside of the loop. Worried it might deadlock somewhere. */
-         soundLock();
-         alSourceStop( v->source );
-         al_checkErr();
-         soundUnlock();
-      }
-      v->state = VOICE_STOPPED;
-   }
-   voiceUnlock();
+   memset( &cmd, 0, sizeof(cmd) );
+   cmd.type = SOUND_CMD_STOPALL;
+   sound_cmdPush( &cmd );
 }
 
 /**
@@ -1073,25 +1328,15 @@ void sound_stopAll (void)
  */
 void sound_stop( int voice )
 {
-   alVoice *v;
+   SoundCmd cmd;
 
    if (sound_disabled)
       return;
 
-   v = voice_get(voice);
-   if (v == NULL)
-      return;
-
-   if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY))
-      return;
-
-   if (v->source != 0) {
-      soundLock();
-      alSourceStop( v->source );
-      al_checkErr();
-      soundUnlock();
-   }
-   v->state = VOICE_STOPPED;
+   memset( &cmd, 0, sizeof(cmd) );
+   cmd.type = SOUND_CMD_STOP;
+   cmd.id   = voice;
+   sound_cmdPush( &cmd );
 }
 
 /**
@@ -1109,38 +1354,19 @@ void sound_stop( int voice )
 int sound_updateListener( double dir, double px, double py,
       double vx, double vy )
 {
-   ALfloat ori[6], pos[3], vel[3];
-   double c, s;
+   SoundCmd cmd;
 
    if (sound_disabled)
       return 0;
 
-   c = cos(dir);
-   s = sin(dir);
-
-   soundLock();
-
-   ori[0] = c;
-   ori[1] = s;
-   ori[2] = 0.;
-   ori[3] = 0.;
-   ori[4] = 0.;
-   ori[5] = 1.;
-   alListenerfv( AL_ORIENTATION, ori );
-   pos[0] = px;
-   pos[1] = py;
-   pos[2] = 100.;
-   alListenerfv( AL_POSITION, pos );
-   vel[0] = vx;
-   vel[1] = vy;
-   vel[2] = 0.;
-   alListenerfv( AL_VELOCITY, vel );
-
-   /* Check for errors. */
-   al_checkErr();
-
-   soundUnlock();
-
+   memset( &cmd, 0, sizeof(cmd) );
+   cmd.type    = SOUND_CMD_LISTENER;
+   cmd.dir     = dir;
+   cmd.pos[0]  = px;
+   cmd.pos[1]  = py;
+   cmd.vel[0]  = vx;
+   cmd.vel[1]  = vy;
+   sound_cmdPush( &cmd );
    return 0;
 }
 
@@ -1219,6 +1445,7 @@ static int sound_makeList (void)
       int len;
       char path[PATH_MAX];
       SDL_RWops *rw;
+      Uint64 t;
       int flen = strlen(files[i]);
 
       /* Must be longer than suffix. */
@@ -1232,14 +1459,16 @@ static int sound_makeList (void)
 
       /* Load the sound. */
       snprintf( path, sizeof(path), SOUND_PATH"%s", files[i] );
+      t = loadprof_fileBegin();
       rw = PHYSFSRWOPS_openRead( path );
 
       /* remove the suffix */
       len = flen - suflen;
       files[i][len] = '\0';
 
-      source_newRW( rw, files[i], 0 );
+      sound_new( rw, files[i], path );
       SDL_RWclose( rw );
+      loadprof_fileEnd( LOADPROF_SOUND, path, t );
    }
 
    DEBUG( n_("Loaded %d Sound", "Loaded %d Sounds", array_size(sound_list)), array_size(sound_list) );
@@ -1312,6 +1541,8 @@ static void sound_free( alSound *snd )
    free(snd->filename);
 
    /* Free internals. */
+   if (snd->buf != 0)
+      memstats_add( MEMTAG_SOUNDS, -(int64_t)snd->mem );
    soundLock();
 
    alDeleteBuffers( 1, &snd->buf );
@@ -1409,6 +1640,8 @@ int sound_playGroup( int group, int sound, int once )
       return -1;
 
    s = &sound_list[sound];
+   if (sound_resident( s ))
+      return -1;
    for (int i=0; i<al_ngroups; i++) {
       alGroup_t *g;
 
@@ -1781,37 +2014,404 @@ alVoice* voice_get( int id )
 }
 
 /**
- * @brief Loads a new sound source from a RWops.
+ * @brief Queues a command for the audio thread.
+ *
+ * Only the main thread pushes commands, so the queue is single producer and
+ *  single consumer and needs no locks. Without an audio thread the command is
+ *  run right away.
+ *
+ *    @param cmd Command to push.
  */
-int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
+static void sound_cmdPush( const SoundCmd *cmd )
+{
+   unsigned int head, used;
+
+   if (sound_thread == NULL) {
+      voiceLock();
+      sound_cmdExec( cmd );
+      voiceUnlock();
+      return;
+   }
+
+   head = atomic_load_explicit( &sound_cmd_head, memory_order_relaxed );
+   used = head - atomic_load_explicit( &sound_cmd_tail, memory_order_acquire );
+   /* Full, should only happen if the audio thread is stuck. The main thread
+    * never waits on it, so the command is lost. */
+   if (used >= SOUND_CMD_MAX) {
+      if (sound_cmd_dropped++ == 0)
+         WARN(_("Sound command queue is full, dropping commands!"));
+      return;
+   }
+   sound_cmds[ head % SOUND_CMD_MAX ] = *cmd;
+   atomic_store_explicit( &sound_cmd_head, head+1, memory_order_release );
+
+   /* Filling up, don't let it wait for the next update. */
+   if (used+1 == SOUND_CMD_MAX/2)
+      SDL_SemPost( sound_cmd_wake );
+}
+
+/**
+ * @brief Runs all the queued commands.
+ */
+static void sound_cmdRun (void)
+{
+   unsigned int tail = atomic_load_explicit( &sound_cmd_tail, memory_order_relaxed );
+   unsigned int head = atomic_load_explicit( &sound_cmd_head, memory_order_acquire );
+
+   if (tail != head) {
+      voiceLock();
+      for (; tail != head; tail++)
+         sound_cmdExec( &sound_cmds[ tail % SOUND_CMD_MAX ] );
+      voiceUnlock();
+      atomic_store_explicit( &sound_cmd_tail, tail, memory_order_release );
+   }
+
+   /* Positions after the commands, so new voices get theirs right away. */
+   sound_posRun();
+}
+
+/**
+ * @brief Applies the latest positions to the voices, only for the audio thread.
+ */
+static void sound_posRun (void)
+{
+   unsigned int gen = atomic_load_explicit( &sound_pos_gen, memory_order_acquire );
+
+   if (gen == sound_pos_seen)
+      return;
+   sound_pos_seen = gen;
+
+   voiceLock();
+   for (alVoice *v=voice_active; v!=NULL; v=v->next) {
+      SoundPos *sp = &sound_pos[ v->id & (SOUND_POS_SLOTS-1) ];
+      ALfloat pos[2], vel[2];
+      unsigned int seq;
+      int id;
+
+      do {
+         seq = atomic_load_explicit( &sp->seq, memory_order_acquire );
+         id       = sp->id;
+         pos[0]   = sp->pos[0];
+         pos[1]   = sp->pos[1];
+         vel[0]   = sp->vel[0];
+         vel[1]   = sp->vel[1];
+         atomic_thread_fence( memory_order_acquire );
+      } while ((seq & 1) || (seq != atomic_load_explicit( &sp->seq, memory_order_relaxed )));
+
+      /* The slot can be taken by another voice or have nothing new. */
+      if ((id != v->id) || (seq == v->posseq))
+         continue;
+      v->posseq = seq;
+      v->pos[0] = pos[0];
+      v->pos[1] = pos[1];
+      v->vel[0] = vel[0];
+      v->vel[1] = vel[1];
+   }
+   voiceUnlock();
+}
+
+/**
+ * @brief Runs a command, with voiceLock() held.
+ *
+ *    @param cmd Command to run.
+ */
+static void sound_cmdExec( const SoundCmd *cmd )
+{
+   alVoice *v;
+
+   switch (cmd->type) {
+      case SOUND_CMD_PLAY:
+         v = voice_new();
+         if (al_playVoice( v, &sound_list[ cmd->sound ], cmd->pos[0], cmd->pos[1],
+                  cmd->vel[0], cmd->vel[1], cmd->relative ))
+            break;
+         v->state = VOICE_PLAYING;
+         v->id = cmd->id;
+         v->posseq = 0;
+         voice_add(v);
+         break;
+
+      case SOUND_CMD_UPDATEPOS:
+         v = voice_get( cmd->id );
+         if (v == NULL)
+            break;
+         v->pos[0] = cmd->pos[0];
+         v->pos[1] = cmd->pos[1];
+         v->vel[0] = cmd->vel[0];
+         v->vel[1] = cmd->vel[1];
+         break;
+
+      case SOUND_CMD_STOP:
+         v = voice_get( cmd->id );
+         if (v != NULL)
+            voice_stop( v );
+         break;
+
+      case SOUND_CMD_STOPALL:
+         for (v=voice_active; v!=NULL; v=v->next)
+            voice_stop( v );
+         break;
+
+      case SOUND_CMD_LISTENER: {
+         ALfloat ori[6], pos[3], vel[3];
+         ori[0] = cos(cmd->dir);
+         ori[1] = sin(cmd->dir);
+         ori[2] = 0.;
+         ori[3] = 0.;
+         ori[4] = 0.;
+         ori[5] = 1.;
+         pos[0] = cmd->pos[0];
+         pos[1] = cmd->pos[1];
+         pos[2] = 100.;
+         vel[0] = cmd->vel[0];
+         vel[1] = cmd->vel[1];
+         vel[2] = 0.;
+         soundLock();
+         alListenerfv( AL_ORIENTATION, ori );
+         alListenerfv( AL_POSITION, pos );
+         alListenerfv( AL_VELOCITY, vel );
+         al_checkErr();
+         soundUnlock();
+         listener_pos[0] = pos[0];
+         listener_pos[1] = pos[1];
+         break;
+      }
+   }
+}
+
+/**
+ * @brief Stops a voice from playing.
+ *
+ *    @param v Voice to stop.
+ */
+static void voice_stop( alVoice *v )
+{
+   if ((v->state == VOICE_STOPPED) || (v->state == VOICE_DESTROY))
+      return;
+
+   if (v->stream != NULL) {
+      streamLock();
+      v->stream->done = 1;
+      streamUnlock();
+   }
+   if (v->source != 0) {
+      soundLock();
+      alSourceStop( v->source );
+      al_checkErr();
+      soundUnlock();
+   }
+   v->state = VOICE_STOPPED;
+}
+
+/**
+ * @brief Runs the commands and updates the voices, so the main thread never
+ *        waits on OpenAL for them.
+ */
+static int sound_threadFunc( void *data )
+{
+   (void) data;
+   while (!atomic_load( &sound_thread_quit )) {
+      sound_cmdRun();
+      sound_updateVoices();
+      SDL_SemWaitTimeout( sound_cmd_wake, SOUND_THREAD_DELAY );
+   }
+   sound_cmdRun();
+   return 0;
+}
+
+/**
+ * @brief Adds a new sound to the sound list.
+ *
+ * Sounds with a path are only decoded when first played, and can be evicted
+ *  and decoded again later.
+ *
+ *    @param rw Data of the sound.
+ *    @param name Name of the sound.
+ *    @param path Path the sound can be reopened from, or NULL to decode it
+ *                right away and keep it.
+ *    @return ID of the new sound or -1 on error.
+ */
+static int sound_new( SDL_RWops *rw, const char *name, const char *path )
 {
    int ret;
    alSound snd, *sndl;
-   (void) flags;
 
    if (sound_disabled)
       return -1;
 
    memset( &snd, 0, sizeof(alSound) );
-   ret = al_load( &snd, rw, name );
-   if (ret)
-      return -1;
+   if (path != NULL)
+      snd.stream = stream_test( &snd, rw );
+   else {
+      ret = al_load( &snd, rw, name );
+      if (ret)
+         return -1;
+   }
 
    sndl = &array_grow( &sound_list );
    memcpy( sndl, &snd, sizeof(alSound) );
    sndl->name = strdup( name );
+   if (path != NULL)
+      sndl->filename = strdup( path );
 
    return sndl-sound_list;
 }
 
+/**
+ * @brief Decodes a sound from its file into a buffer.
+ *
+ *    @param snd Sound to decode.
+ *    @return 0 on success.
+ */
+static int sound_decode( alSound *snd )
+{
+   int ret;
+   SDL_RWops *rw = PHYSFSRWOPS_openRead( snd->filename );
+   if (rw == NULL) {
+      WARN(_("Unable to open sound file '%s'."), snd->filename);
+      return -1;
+   }
+   ret = al_load( snd, rw, snd->name );
+   SDL_RWclose( rw );
+   return ret;
+}
+
+/**
+ * @brief Makes sure a sound has its buffer decoded, evicting others if needed.
+ *
+ *    @param snd Sound to make resident.
+ *    @return 0 on success.
+ */
+static int sound_resident( alSound *snd )
+{
+   snd->last_used = ++sound_usegen;
+   if (snd->buf != 0)
+      return 0;
+   if (snd->filename == NULL)
+      return -1;
+
+   if (sound_decode( snd )) {
+      /* Don't try again every time it's played. */
+      free( snd->filename );
+      snd->filename = NULL;
+      return -1;
+   }
+   sound_resident_mem += snd->mem;
+   sound_evict( snd );
+   return 0;
+}
+
+/**
+ * @brief Checks to see if a sound's buffer is attached to a source.
+ */
+static int sound_inUse( const alSound *snd )
+{
+   int used = 0;
+
+   voiceLock();
+   for (alVoice *v=voice_active; v!=NULL; v=v->next) {
+      if ((v->source != 0) && (v->buffer == snd->buf)) {
+         used = 1;
+         break;
+      }
+   }
+   voiceUnlock();
+   if (used)
+      return 1;
+
+   soundLock();
+   for (int i=0; (i<al_ngroups) && !used; i++) {
+      const alGroup_t *g = &al_groups[i];
+      for (int j=0; j<g->nsources; j++) {
+         ALint buf;
+         alGetSourcei( g->sources[j], AL_BUFFER, &buf );
+         if ((ALuint)buf == snd->buf) {
+            used = 1;
+            break;
+         }
+      }
+   }
+   soundUnlock();
+   return used;
+}
+
+/**
+ * @brief Frees the least recently used sound buffers until under the memory cap.
+ *
+ *    @param keep Sound that must not be evicted.
+ */
+static void sound_evict( const alSound *keep )
+{
+   size_t cap;
+
+   if (conf.sound_memory <= 0)
+      return;
+
+   cap = (size_t)conf.sound_memory * 1024 * 1024;
+   while (sound_resident_mem > cap) {
+      alSound *lru = NULL;
+      for (int i=0; i<array_size(sound_list); i++) {
+         alSound *s = &sound_list[i];
+         if ((s == keep) || (s->buf == 0) || (s->filename == NULL))
+            continue;
+         if ((lru != NULL) && (s->last_used >= lru->last_used))
+            continue;
+         if (sound_inUse( s ))
+            continue;
+         lru = s;
+      }
+      if (lru == NULL)
+         break;
+
+      soundLock();
+      alDeleteBuffers( 1, &lru->buf );
+      al_checkErr();
+      soundUnlock();
+      lru->buf = 0;
+      sound_resident_mem -= lru->mem;
+      memstats_add( MEMTAG_SOUNDS, -(int64_t)lru->mem );
+      lru->mem = 0;
+   }
+}
+
+/**
+ * @brief Decodes a sound ahead of time so it doesn't hitch when first played.
+ *
+ *    @param sound ID of the sound to preload.
+ */
+void sound_preload( int sound )
+{
+   alSound *s;
+
+   if (sound_disabled || (sound < 0) || (sound >= array_size(sound_list)))
+      return;
+
+   s = &sound_list[sound];
+   if (s->stream || (s->filename == NULL))
+      return;
+   sound_resident( s );
+}
+
+/**
+ * @brief Loads a new sound source from a RWops.
+ */
+int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
+{
+   (void) flags;
+   return sound_new( rw, name, NULL );
+}
+
 /**
  * @brief Loads a new source from a file.
  */
 int source_new( const char* filename, unsigned int flags )
 {
+   (void) flags;
+   Uint64 t = loadprof_fileBegin();
    SDL_RWops *rw = PHYSFSRWOPS_openRead( filename );
-   int id = source_newRW( rw, filename, flags );
+   int id = sound_new( rw, filename, filename );
    SDL_RWclose( rw );
+   loadprof_fileEnd( LOADPROF_SOUND, filename, t );
    return id;
 }
 
@@ -1961,7 +2561,7 @@ static int al_loadOgg( ALuint *buf, OggVorbis_File *vf )
    len    = ov_pcm_total( vf, -1 ) * info->channels * sizeof(short);
 
    /* Allocate memory. */
-   data = malloc( len );
+   data = nmalloc_tag( MEMTAG_SOUNDS, len );
 
    /* Fill buffer. */
    i = 0;
@@ -1985,7 +2585,7 @@ static int al_loadOgg( ALuint *buf, OggVorbis_File *vf )
    soundUnlock();
 
    /* Clean up. */
-   free(data);
+   nfree_tag( MEMTAG_SOUNDS, data, len );
    ov_clear(vf);
 
    return 0;
@@ -2062,6 +2662,8 @@ int al_load( alSound *snd, SDL_RWops *rw, const char *name )
    else
       snd->length = (double)size / (double)(freq * (bits/8) * channels);
    snd->channels = channels;
+   snd->mem      = size;
+   memstats_add( MEMTAG_SOUNDS, size );
 
    /* Check for errors. */
    al_checkErr();
@@ -2096,17 +2698,126 @@ static void al_volumeUpdate (void)
    spfxL_setSpeedVolume( svolume * svolume_speed );
 }
 
+/**
+ * @brief Estimates how loud a voice would be, to decide which get a source.
+ *
+ * Matches the clamped inverse distance model used by the sources, so it goes
+ *  from 1 at the reference distance down to close to 0 far away.
+ */
+static double voice_priority( const alVoice *v )
+{
+   double d;
+   if (v->relative)
+      return 1.;
+   d = hypot( v->pos[0]-listener_pos[0], v->pos[1]-listener_pos[1] );
+   return SOUND_REFERENCE_DISTANCE / CLAMP( SOUND_REFERENCE_DISTANCE, SOUND_MAX_DISTANCE, d );
+}
+
+/**
+ * @brief Takes the source of the least important real voice for a voice.
+ *
+ * The voice losing the source keeps playing virtually.
+ *
+ *    @param v Voice that wants a source.
+ *    @return 0 if a source was put on the stack, -1 if v is the least important.
+ */
+static int voice_steal( const alVoice *v )
+{
+   alVoice *victim = NULL;
+   double prio = 0., vprio = voice_priority( v );
+
+   voiceLock();
+   for (alVoice *tv=voice_active; tv!=NULL; tv=tv->next) {
+      double p;
+      if ((tv->source == 0) || (tv->stream != NULL) || (tv->state != VOICE_PLAYING))
+         continue;
+      p = voice_priority( tv );
+      if ((p < vprio) && ((victim == NULL) || (p < prio))) {
+         victim = tv;
+         prio   = p;
+      }
+   }
+   if (victim != NULL) {
+      soundLock();
+      alSourceStop( victim->source );
+      alSourcei( victim->source, AL_BUFFER, AL_NONE );
+      al_checkErr();
+      soundUnlock();
+      source_stack[source_nstack++] = victim->source;
+      victim->source = 0;
+   }
+   voiceUnlock();
+
+   return (victim != NULL) ? 0 : -1;
+}
+
+/**
+ * @brief Gives a source to a virtual voice, starting where it should be at.
+ *
+ *    @param v Virtual voice.
+ *    @param source Source to give it.
+ *    @return 0 on success.
+ */
+static int voice_promote( alVoice *v, ALuint source )
+{
+   const alSound *s = &sound_list[ v->sound ];
+   ALfloat offset;
+
+   /* The buffer might have been evicted meanwhile. */
+   if ((s->buf == 0) || (s->buf != v->buffer))
+      return -1;
+
+   offset = (ALfloat)(SDL_GetTicks() - v->start) / 1000. * sound_speed;
+   if (offset >= s->length)
+      return -1;
+
+   v->source = source;
+   soundLock();
+   alSourcei(  v->source, AL_BUFFER, v->buffer );
+   alSourcei(  v->source, AL_SOURCE_RELATIVE, v->relative );
+   alSourcef(  v->source, AL_GAIN, svolume*svolume_speed );
+   alSourcefv( v->source, AL_POSITION, v->pos );
+   alSourcefv( v->source, AL_VELOCITY, v->vel );
+   alSourcei(  v->source, AL_LOOPING, AL_FALSE );
+   alSourcef(  v->source, AL_SEC_OFFSET, offset );
+   alSourcePlay( v->source );
+   al_checkErr();
+   soundUnlock();
+   return 0;
+}
+
 /**
  * @brief Plays a voice.
+ *
+ * If there are no free sources, the voice takes one from a less important
+ *  voice, or plays virtually if it is the least important.
  */
 static int al_playVoice( alVoice *v, alSound *s,
       ALfloat px, ALfloat py, ALfloat vx, ALfloat vy, ALint relative )
 {
    ALuint source;
 
+   /* Set up the voice. */
+   v->sound    = s - sound_list;
+   v->buffer   = s->buf;
+   v->source   = 0;
+   v->relative = relative;
+   v->start    = SDL_GetTicks();
+   v->end      = v->start + (unsigned int)(1000. * s->length / sound_speed);
+   v->pos[0]   = px;
+   v->pos[1]   = py;
+   v->pos[2]   = 0.;
+   v->vel[0]   = vx;
+   v->vel[1]   = vy;
+   v->vel[2]   = 0.;
+
    /* Make sure there's enough. */
-   if (source_nstack <= 0)
+   if ((source_nstack <= 0) && voice_steal( v )) {
+      /* Streams can't pick up where they should be, so they just get lost. */
+      if (s->stream)
+         v->end = v->start;
       return 0;
+   }
 
    /* Pull one off the stack. */
    source_nstack--;
@@ -2117,12 +2828,22 @@ static int al_playVoice( alVoice *v, alSound *s,
 
    if (v->source == 0)
       return -1;
-   v->buffer = s->buf;
+
+   /* Long sounds queue their first buffers instead. */
+   if (s->stream) {
+      v->stream = stream_open( s-sound_list, v->source );
+      if (v->stream == NULL) {
+         source_stack[source_nstack++] = source;
+         v->source = 0;
+         return -1;
+      }
+   }
 
    soundLock();
 
    /* Attach buffer. */
-   alSourcei( v->source, AL_BUFFER, v->buffer );
+   if (v->stream == NULL)
+      alSourcei( v->source, AL_BUFFER, v->buffer );
 
    /* Enable positional sound. */
    alSourcei( v->source, AL_SOURCE_RELATIVE, relative );
@@ -2132,14 +2853,6 @@ static int al_playVoice( alVoice *v, alSound *s,
       WARN(_("Sound '%s' has %d channels but is being played as positional. It should be mono!"), s->name, s->channels );
 #endif /* DEBUGGING */
 
-   /* Update position. */
-   v->pos[0] = px;
-   v->pos[1] = py;
-   v->pos[2] = 0.;
-   v->vel[0] = vx;
-   v->vel[1] = vy;
-   v->vel[2] = 0.;
-
    /* Set up properties. */
    alSourcef(  v->source, AL_GAIN, svolume*svolume_speed );
    alSourcefv( v->source, AL_POSITION, v->pos );
@@ -2181,17 +2894,32 @@ void al_updateVoice( alVoice *v )
 {
    ALint state;
 
-   /* Invalid source, mark to delete. */
+   /* Virtual voice, only has to be kept around until it would be done. */
    if (v->source == 0) {
-      v->state = VOICE_DESTROY;
+      if ((v->state != VOICE_PLAYING) || ((int)(SDL_GetTicks() - v->end) >= 0))
+         v->state = VOICE_DESTROY;
       return;
    }
 
+   /* Streams are only done when stopped after the last buffer, otherwise
+    * it's an underrun the streaming thread will recover from. */
+   if (v->stream != NULL) {
+      streamLock();
+      soundLock();
+      alGetSourcei( v->source, AL_SOURCE_STATE, &state );
+      soundUnlock();
+      if ((state == AL_STOPPED) && (v->stream->done || v->stream->eof)) {
+         stream_close( v->stream );
+         v->stream = NULL;
+      }
+      streamUnlock();
+   }
+
    soundLock();
 
    /* Get status. */
    alGetSourcei( v->source, AL_SOURCE_STATE, &state );
-   if (state == AL_STOPPED) {
+   if ((state == AL_STOPPED) && (v->stream == NULL)) {
 
       /* Remove buffer so it doesn't start up again if resume is called. */
       alSourcei( v->source, AL_BUFFER, AL_NONE );
@@ -2221,3 +2949,255 @@ void al_updateVoice( alVoice *v )
 
    soundUnlock();
 }
+
+/**
+ * @brief Checks to see if a sound should be streamed instead of decoded.
+ *
+ * Only Ogg Vorbis files longer than the configured threshold are streamed.
+ *
+ *    @param[out] snd Sound to set the length and channels of if streamed.
+ *    @param rw Data of the sound, it gets rewound.
+ *    @return 1 if the sound should be streamed, 0 otherwise.
+ */
+static int stream_test( alSound *snd, SDL_RWops *rw )
+{
+   OggVorbis_File vf;
+   int stream = 0;
+
+   if (conf.sound_stream <= 0.)
+      return 0;
+
+   if (ov_test_callbacks( rw, &vf, NULL, 0, sound_al_ovcall_noclose )==0) {
+      if (ov_test_open( &vf )==0) {
+         double length = ov_time_total( &vf, -1 );
+         if (length > conf.sound_stream) {
+            snd->length    = length;
+            snd->channels  = ov_info( &vf, -1 )->channels;
+            stream         = 1;
+         }
+      }
+   }
+   ov_clear( &vf );
+   SDL_RWseek( rw, 0, SEEK_SET );
+   return stream;
+}
+
+/**
+ * @brief Opens a stream for a voice and queues its first buffers.
+ *
+ *    @param sound Sound to stream.
+ *    @param source Source to queue the buffers on.
+ *    @return The new stream or NULL on error.
+ */
+static alStream *stream_open( int sound, ALuint source )
+{
+   alSound *s = &sound_list[sound];
+   alStream *st;
+   vorbis_info *info;
+   SDL_RWops *rw;
+   int n;
+
+   rw = PHYSFSRWOPS_openRead( s->filename );
+   if (rw == NULL) {
+      WARN(_("Unable to open sound file '%s'."), s->filename);
+      return NULL;
+   }
+
+   st = calloc( 1, sizeof(alStream) );
+   if (ov_open_callbacks( rw, &st->vf, NULL, 0, sound_al_ovcall ) < 0) {
+      WARN(_("Sound '%s' does not appear to be a Vorbis bitstream."), s->name);
+      SDL_RWclose( rw );
+      free( st );
+      return NULL;
+   }
+   info        = ov_info( &st->vf, -1 );
+   st->sound   = sound;
+   st->format  = (info->channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+   st->rate    = info->rate;
+   st->source  = source;
+
+   /* Fill the ring up front so playback can start right away. */
+   soundLock();
+   alGenBuffers( SOUND_STREAM_BUFFERS, st->bufs );
+   al_checkErr();
+   soundUnlock();
+   n = 0;
+   while ((n < SOUND_STREAM_BUFFERS) && (stream_fill( st, st->bufs[n] )==0))
+      n++;
+   soundLock();
+   alSourcei( source, AL_BUFFER, AL_NONE );
+   alSourceQueueBuffers( source, n, st->bufs );
+   al_checkErr();
+   soundUnlock();
+
+   /* Hand it over to the streaming thread. */
+   streamLock();
+   if (stream_list == NULL)
+      stream_list = array_create( alStream* );
+   array_push_back( &stream_list, st );
+   s->nstreams++;
+   streamUnlock();
+   if (stream_thread == NULL) {
+      stream_thread = SDL_CreateThread( stream_threadFunc, "sound_stream", NULL );
+      if (stream_thread == NULL)
+         WARN(_("Unable to create sound streaming thread: %s"), SDL_GetError());
+   }
+
+   return st;
+}
+
+/**
+ * @brief Stops and frees a stream.
+ *
+ * Has to be called with stream_mutex held.
+ *
+ *    @param st Stream to close.
+ */
+static void stream_close( alStream *st )
+{
+   for (int i=0; i<array_size(stream_list); i++) {
+      if (stream_list[i] != st)
+         continue;
+      array_erase( &stream_list, &stream_list[i], &stream_list[i+1] );
+      break;
+   }
+   sound_list[ st->sound ].nstreams--;
+
+   soundLock();
+   alSourceStop( st->source );
+   alSourcei( st->source, AL_BUFFER, AL_NONE );
+   alDeleteBuffers( SOUND_STREAM_BUFFERS, st->bufs );
+   al_checkErr();
+   soundUnlock();
+
+   ov_clear( &st->vf );
+   free( st );
+}
+
+/**
+ * @brief Decodes the next chunk of a stream into a buffer.
+ *
+ *    @param st Stream to decode.
+ *    @param buf Buffer to fill.
+ *    @return 0 if the buffer was filled, 1 at the end of the stream.
+ */
+static int stream_fill( alStream *st, ALuint buf )
+{
+   char data[ SOUND_STREAM_SIZE ];
+   size_t size = 0;
+
+   if (st->eof)
+      return 1;
+
+   while (size < sizeof(data)) {
+      int section;
+      long ret = ov_read( &st->vf, &data[size], sizeof(data)-size,
+            (SDL_BYTEORDER == SDL_BIG_ENDIAN), 2, 1, &section );
+      if (ret == 0)
+         break;
+      else if (ret == OV_HOLE)
+         continue;
+      else if (ret < 0) {
+         WARN(_("Error reading from OGG file!"));
+         break;
+      }
+      size += ret;
+   }
+   if (size < sizeof(data))
+      st->eof = 1;
+   if (size == 0)
+      return 1;
+
+   soundLock();
+   alBufferData( buf, st->format, data, size, st->rate );
+   al_checkErr();
+   soundUnlock();
+   return 0;
+}
+
+/**
+ * @brief Refills the processed buffers of all the streams.
+ */
+static int stream_threadFunc( void *data )
+{
+   (void) data;
+
+   while (1) {
+      streamLock();
+      if (stream_quit) {
+         streamUnlock();
+         return 0;
+      }
+
+      for (int i=0; i<array_size(stream_list); i++) {
+         alStream *st = stream_list[i];
+         ALint processed, queued, state;
+
+         if (st->done)
+            continue;
+
+         soundLock();
+         alGetSourcei( st->source, AL_BUFFERS_PROCESSED, &processed );
+         soundUnlock();
+         while (processed-- > 0) {
+            ALuint buf;
+            soundLock();
+            alSourceUnqueueBuffers( st->source, 1, &buf );
+            soundUnlock();
+            /* Buffers are left out once there is nothing left to decode. */
+            if (stream_fill( st, buf ))
+               continue;
+            soundLock();
+            alSourceQueueBuffers( st->source, 1, &buf );
+            soundUnlock();
+         }
+
+         /* Recover from underruns, the queue only has fresh buffers now. */
+         soundLock();
+         alGetSourcei( st->source, AL_SOURCE_STATE, &state );
+         alGetSourcei( st->source, AL_BUFFERS_QUEUED, &queued );
+         if ((state == AL_STOPPED) && (queued > 0))
+            alSourcePlay( st->source );
+         al_checkErr();
+         soundUnlock();
+      }
+      streamUnlock();
+
+      SDL_Delay( SOUND_STREAM_DELAY );
+   }
+}
+
+/**
+ * @brief Gets the number of sounds loaded.
+ */
+int sound_count (void)
+{
+   return array_size( sound_list );
+}
+
+/**
+ * @brief Gets the name of a sound.
+ *
+ *    @param sound ID of the sound.
+ *    @return Name of the sound.
+ */
+const char *sound_name( int sound )
+{
+   return sound_list[sound].name;
+}
+
+/**
+ * @brief Gets the memory used by a sound.
+ *
+ *    @param sound ID of the sound.
+ *    @param[out] streamed Whether the sound is streamed, can be NULL.
+ *    @return Bytes used by its decoded buffer and the buffers of the voices
+ *            streaming it.
+ */
+size_t sound_memory( int sound, int *streamed )
+{
+   const alSound *s = &sound_list[sound];
+   if (streamed != NULL)
+      *streamed = s->stream;
+   return s->mem + (size_t)s->nstreams * SOUND_STREAM_BUFFERS * SOUND_STREAM_SIZE;
+}
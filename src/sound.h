@@ -83,6 +83,14 @@ int source_new( const char* filename, unsigned int flags );
  */
 int sound_get( const char* name );
 double sound_getLength( int sound );
+void sound_preload( int sound );
+
+/*
+ * memory accounting
+ */
+int sound_count (void);
+const char *sound_name( int sound );
+size_t sound_memory( int sound, int *streamed );
 
 /*
  * voice management
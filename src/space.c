@@ -9,6 +9,7 @@
 /** @cond */
 #include <float.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include "physfs.h"
 
@@ -18,6 +19,7 @@
 #include "space.h"
 
 #include "background.h"
+#include "camera.h"
 #include "conf.h"
 #include "damagetype.h"
 #include "dev_uniedit.h"
@@ -27,8 +29,10 @@
 #include "hook.h"
 #include "land.h"
 #include "log.h"
+#include "luaprof.h"
 #include "map.h"
 #include "map_overlay.h"
+#include "nameindex.h"
 #include "menu.h"
 #include "mission.h"
 #include "music.h"
@@ -51,11 +55,12 @@
 #include "pause.h"
 #include "pilot.h"
 #include "player.h"
-#include "queue.h"
+#include "player_autonav.h"
 #include "rng.h"
 #include "sound.h"
 #include "spfx.h"
 #include "start.h"
+#include "threadpool.h"
 #include "toolkit.h"
 #include "weapon.h"
 
@@ -64,6 +69,8 @@
 
 #define SPOB_GFX_EXTERIOR_PATH_W 400 /**< Spob exterior graphic width. */
 #define SPOB_GFX_EXTERIOR_PATH_H 400 /**< Spob exterior graphic height. */
+#define SPOB_RENDER_MARGIN    100. /**< Screen pixels around the screen in which spobs are still rendered. */
+#define SPOB_UPDATE_MARGIN    500. /**< Screen pixels around the screen in which spobs are updated every frame. */
 
 /* used to overcome warnings due to 0 values */
 #define FLAG_POSSET           (1<<0) /**< Set the position. */
@@ -73,6 +80,46 @@
 
 #define DEBRIS_BUFFER         1000 /**< Buffer to smooth appearance of debris */
 
+#define SCHEDULER_SPAWN_BUDGET   1 /**< Faction spawns run per frame, the rest wait for the next frames. */
+
+/**
+ * @brief A system reached by presence spilling from another one.
+ */
+typedef struct SystemSpill_ {
+   int sys;    /**< Index of the system reached. */
+   int dist;   /**< Spill distance, 0 for direct neighbours. */
+} SystemSpill;
+
+/**
+ * @brief Cached spill of a system, the systems its spobs' presence reaches.
+ */
+typedef struct SpillCache_ {
+   SystemSpill *spill; /**< Array (array.h): systems reached in breadth-first order. */
+   int levels;         /**< Distances computed, -1 if not computed. */
+   int full;           /**< Whether or not all the reachable systems are in spill. */
+} SpillCache;
+
+/**
+ * @brief Spob being parsed in the vpool.
+ */
+typedef struct SpobThreadData_ {
+   Spob spob;           /**< Parsed spob. */
+   char *filename;      /**< File to parse. */
+   Commodity **stdList; /**< Standard commodities. */
+   int ret;             /**< Return of spob_parse. */
+} SpobThreadData;
+
+/**
+ * @brief Star system being parsed in the vpool.
+ */
+typedef struct SystemThreadData_ {
+   StarSystem sys;   /**< Parsed star system. */
+   char *filename;   /**< File to parse. */
+   char **spobs;     /**< Names of the spobs to add afterwards (array.h). */
+   char **vspobs;    /**< Names of the virtual spobs to add afterwards (array.h). */
+   int ret;          /**< Return of system_parse. */
+} SystemThreadData;
+
 typedef struct spob_lua_file_s {
    const char *filename;   /**< Name of the spob Lua file. */
    nlua_env env;           /**< Lua environment. */
@@ -93,11 +140,18 @@ static char** systemname_stack = NULL; /**< System name stack corresponding to s
 StarSystem *systems_stack = NULL; /**< Star system stack. */
 static Spob *spob_stack = NULL; /**< Spob stack. */
 static VirtualSpob *vspob_stack = NULL; /**< Virtual spob stack. */
-/* TODO get rid of the stack_changed stuff, and just redo all the id/pointer stuff.
- * Main issue will be redoing the Lua system/spob modules to handle such a
- * case, but can be done with  the weapon module as a referenc. */
-static int systemstack_changed = 0; /**< Whether or not the systems_stack was changed after loading. */
-static int spobstack_changed = 0; /**< Whether or not the spob_stack was changed after loading. */
+
+/*
+ * Name indices, rebuilt lazily when the stacks or names change.
+ */
+static NameIndex space_sysIndex; /**< Systems by name. */
+static NameIndex space_sysIndexCase; /**< Systems by case insensitive name. */
+static NameIndex space_spobIndex; /**< Spobs by name. */
+static NameIndex space_spobIndexCase; /**< Spobs by case insensitive name. */
+static NameIndex space_spobSysIndex; /**< Spobs by name, to their index in spobname_stack. */
+static int space_sysIndexValid = 0; /**< Whether or not the system indices are up to date. */
+static int space_spobIndexValid = 0; /**< Whether or not the spob indices are up to date. */
+static int space_spobSysIndexValid = 0; /**< Whether or not space_spobSysIndex is up to date. */
 static MapShader **mapshaders = NULL; /**< Map shaders. */
 
 /*
@@ -110,7 +164,11 @@ static glTexture *jumpbuoy_gfx = NULL; /**< Jump buoy graphics. */
 static int space_fchg = 0; /**< Faction change counter, to avoid unnecessary calls. */
 static int space_simulating = 0; /**< Are we simulating space? */
 static int space_simulating_effects = 0; /**< Are we doing special effects? */
+static int space_simulating_warmup = 0; /**< Are we doing the reduced fidelity warm-up? */
 static Spob *space_landQueueSpob = NULL;
+static StarSystem *space_prefetchSys = NULL; /**< System being prefetched. */
+static SpillCache *space_spill[2] = { NULL, NULL }; /**< Arrays (array.h) of spills per system, without and with hidden jumps. */
+static glTexLoader *space_prefetchLoader = NULL; /**< Loader of the prefetched spob graphics. */
 
 /*
  * Fleet spawning.
@@ -124,10 +182,11 @@ int space_spawn = 1; /**< Spawn enabled by default. */
 static int spob_parse( Spob *spob, const char *filename, Commodity **stdList );
 static int space_parseSpobs( xmlNodePtr parent, StarSystem* sys );
 static int spob_parsePresence( xmlNodePtr node, SpobPresence *ap );
+static glTexLoader *space_gfxLoader( StarSystem *sys );
 /* system load */
 static void system_init( StarSystem *sys );
 static int systems_load (void);
-static int system_parse( StarSystem *system, const char *filename );
+static int system_parse( StarSystem *system, const char *filename, char ***spobs, char ***vspobs );
 static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys );
 static int system_parseJumpPointDiff( const xmlNodePtr node, StarSystem *sys );
 static int system_parseJumps( StarSystem *sys );
@@ -136,6 +195,18 @@ static int system_parseAsteroidExclusion( const xmlNodePtr node, StarSystem *sys
 /* misc */
 static int spob_cmp( const void *p1, const void *p2 );
 static int getPresenceIndex( StarSystem *sys, int faction );
+static void space_indexBuild( NameIndex *ni, NameIndex *nicase, const void *base, int n, size_t stride, size_t offset );
+static void space_sysIndexCheck (void);
+static void space_spobIndexCheck (void);
+static void space_spobSysIndexCheck (void);
+static void space_indexFree (void);
+static void space_spillInvalidate (void);
+static const SystemSpill *system_getSpill( StarSystem *sys, int usehidden, int levels );
+static int presence_inFilter( const int *filter, int faction );
+static void system_presenceAdd( StarSystem *sys, int faction, double base, double bonus, const int *filter );
+static void system_presenceAddSpobFilter( StarSystem *sys, const SpobPresence *ap, const int *filter );
+static void system_addAllSpobsPresenceFilter( StarSystem *sys, const int *filter );
+static void space_presencesFinish (void);
 static void system_scheduler( double dt, int init );
 /* Markers. */
 static int space_addMarkerSystem( int sysid, MissionMarkerType type );
@@ -144,8 +215,11 @@ static int space_rmMarkerSystem( int sysid, MissionMarkerType type );
 static int space_rmMarkerSpob( int pntid, MissionMarkerType type );
 /* Render. */
 static void space_renderJumpPoint( const JumpPoint *jp, int i );
+static int space_spobOnScreen( const Spob *p, double margin );
+static int space_spobInRect( const Spob *p, double x1, double y1, double x2, double y2 );
+static void space_spobProfile( const Spob *p );
 static void space_renderSpob( const Spob *p );
-static void space_updateSpob( const Spob *p, double dt, double real_dt );
+static void space_updateSpob( Spob *p, double dt, double real_dt );
 /* Map shaders. */
 static const MapShader *mapshader_get( const char *name );
 /* Lua stuff. */
@@ -362,8 +436,11 @@ int spob_setFaction( Spob *p, int faction )
  */
 int spob_addCommodity( Spob *p, Commodity *c )
 {
+   CommodityPrice *cp;
    array_grow( &p->commodities ) = c;
-   array_grow( &p->commodityPrice ).price = c->price;
+   cp = &array_grow( &p->commodityPrice );
+   memset( cp, 0, sizeof(CommodityPrice) );
+   cp->price = c->price;
    return 0;
 }
 
@@ -444,8 +521,9 @@ int spob_rename( Spob *p, char *newname )
    free( p->name );
    p->name = newname;
 
-   /* Order changed, so no more bsearch for us. */
-   spobstack_changed = 1;
+   /* Names changed. */
+   space_spobIndexValid = 0;
+   space_spobSysIndexValid = 0;
 
    return 0;
 }
@@ -512,6 +590,10 @@ int space_hyperspace( Pilot* p )
 
    /* pilot is now going to get automatically ready for hyperspace */
    pilot_setFlag(p, PILOT_HYP_PREP);
+
+   /* Get the destination ready while the player gets in position. */
+   if (p == player.p)
+      space_prefetch( cur_system->jumps[ p->nav_hyperspace ].target );
    return 0;
 }
 
@@ -846,16 +928,14 @@ int space_sysReachable( const StarSystem *sys )
  */
 int space_sysReallyReachable( const char* sysname )
 {
-   StarSystem** path;
+   const StarSystem *sys;
 
    if (strcmp(sysname,cur_system->name)==0)
       return 1;
-   path = map_getJumpPath( cur_system->name, NULL, sysname, 1, 1, NULL, NULL );
-   if (path != NULL) {
-      array_free(path);
-      return 1;
-   }
-   return 0;
+   sys = system_get( sysname );
+   if (sys == NULL)
+      return 0;
+   return (map_jumpDist( cur_system, sys, 1 ) > 0);
 }
 
 /**
@@ -890,10 +970,8 @@ StarSystem* system_getAll (void)
  */
 const char *system_existsCase( const char* sysname )
 {
-   for (int i=0; i<array_size(systems_stack); i++)
-      if (strcasecmp(sysname, systems_stack[i].name)==0)
-         return systems_stack[i].name;
-   return NULL;
+   space_sysIndexCheck();
+   return nameindex_getName( &space_sysIndexCase, sysname );
 }
 
 /**
@@ -960,22 +1038,15 @@ static int system_cmp( const void *p1, const void *p2 )
  */
 StarSystem* system_get( const char* sysname )
 {
-   if (sysname == NULL)
-      return NULL;
+   int id;
 
-   /* Somethig was added, and since we store IDs too, everything can't be sorted anymore by name... */
-   if (systemstack_changed) {
-      for (int i=0; i<array_size(systems_stack); i++)
-         if (strcmp(systems_stack[i].name, sysname)==0)
-            return &systems_stack[i];
-      WARN(_("System '%s' not found in stack"), sysname);
+   if (sysname == NULL)
       return NULL;
-   }
 
-   const StarSystem s = {.name = (char*)sysname};
-   StarSystem *found = bsearch( &s, systems_stack, array_size(systems_stack), sizeof(StarSystem), system_cmp );
-   if (found != NULL)
-      return found;
+   space_sysIndexCheck();
+   id = nameindex_get( &space_sysIndex, sysname );
+   if (id >= 0)
+      return &systems_stack[id];
 
    WARN(_("System '%s' not found in stack"), sysname);
    return NULL;
@@ -1003,6 +1074,105 @@ int system_index( const StarSystem *sys )
    return sys->id;
 }
 
+/**
+ * @brief Builds a pair of case sensitive and insensitive name indices.
+ *
+ *    @param ni Case sensitive index to build.
+ *    @param nicase Case insensitive index to build, or NULL.
+ *    @param base Array of elements.
+ *    @param n Number of elements.
+ *    @param stride Size of the elements.
+ *    @param offset Offset of the name (char*) in the elements.
+ */
+static void space_indexBuild( NameIndex *ni, NameIndex *nicase, const void *base, int n, size_t stride, size_t offset )
+{
+   nameindex_free( ni );
+   nameindex_init( ni, 0 );
+   nameindex_reserve( ni, n );
+   if (nicase != NULL) {
+      nameindex_free( nicase );
+      nameindex_init( nicase, 1 );
+      nameindex_reserve( nicase, n );
+   }
+   for (int i=0; i<n; i++) {
+      const char *name = *(char* const*)((const char*)base + (size_t)i*stride + offset);
+      nameindex_add( ni, name, i );
+      if (nicase != NULL)
+         nameindex_add( nicase, name, i );
+   }
+}
+
+/**
+ * @brief Rebuilds the system name indices if needed.
+ */
+static void space_sysIndexCheck (void)
+{
+   if (space_sysIndexValid)
+      return;
+   space_indexBuild( &space_sysIndex, &space_sysIndexCase, systems_stack,
+         array_size(systems_stack), sizeof(StarSystem), offsetof(StarSystem,name) );
+   space_sysIndexValid = 1;
+}
+
+/**
+ * @brief Rebuilds the spob name indices if needed.
+ */
+static void space_spobIndexCheck (void)
+{
+   if (space_spobIndexValid)
+      return;
+   space_indexBuild( &space_spobIndex, &space_spobIndexCase, spob_stack,
+         array_size(spob_stack), sizeof(Spob), offsetof(Spob,name) );
+   space_spobIndexValid = 1;
+}
+
+/**
+ * @brief Rebuilds the spob to system name index if needed.
+ */
+static void space_spobSysIndexCheck (void)
+{
+   if (space_spobSysIndexValid)
+      return;
+   space_indexBuild( &space_spobSysIndex, NULL, spobname_stack,
+         array_size(spobname_stack), sizeof(char*), 0 );
+   space_spobSysIndexValid = 1;
+}
+
+/**
+ * @brief Frees the name indices.
+ */
+static void space_indexFree (void)
+{
+   nameindex_free( &space_sysIndex );
+   nameindex_free( &space_sysIndexCase );
+   nameindex_free( &space_spobIndex );
+   nameindex_free( &space_spobIndexCase );
+   nameindex_free( &space_spobSysIndex );
+   space_sysIndexValid = 0;
+   space_spobIndexValid = 0;
+   space_spobSysIndexValid = 0;
+}
+
+/**
+ * @brief Renames a star system.
+ *
+ *    @param sys System to rename.
+ *    @param newname New name to give the system, ownership is taken.
+ *    @return 0 on success.
+ */
+int system_rename( StarSystem *sys, char *newname )
+{
+   for (int i=0; i<array_size(systemname_stack); i++)
+      if (systemname_stack[i] == sys->name)
+         systemname_stack[i] = newname;
+   free( sys->name );
+   sys->name = newname;
+
+   /* Names changed. */
+   space_sysIndexValid = 0;
+   return 0;
+}
+
 /**
  * @brief Get whether or not a spob has a system (i.e. is on the map).
  *
@@ -1011,10 +1181,8 @@ int system_index( const StarSystem *sys )
  */
 int spob_hasSystem( const Spob *spb )
 {
-   for (int i=0; i<array_size(spobname_stack); i++)
-      if (strcmp(spobname_stack[i],spb->name)==0)
-         return 1;
-   return 0;
+   space_spobSysIndexCheck();
+   return (nameindex_get( &space_spobSysIndex, spb->name ) >= 0);
 }
 
 /**
@@ -1025,9 +1193,11 @@ int spob_hasSystem( const Spob *spb )
  */
 const char* spob_getSystem( const char* spobname )
 {
-   for (int i=0; i<array_size(spobname_stack); i++)
-      if (strcmp(spobname_stack[i],spobname)==0)
-         return systemname_stack[i];
+   int id;
+   space_spobSysIndexCheck();
+   id = nameindex_get( &space_spobSysIndex, spobname );
+   if (id >= 0)
+      return systemname_stack[id];
    DEBUG(_("Spob '%s' is not placed in a system"), spobname);
    return NULL;
 }
@@ -1055,19 +1225,10 @@ Spob* spob_get( const char* spobname )
       return NULL;
    }
 
-   /* Somethig was added, and since we store IDs too, everything can't be sorted anymore by name... */
-   if (spobstack_changed) {
-      for (int i=0; i<array_size(spob_stack); i++)
-         if (strcmp(spob_stack[i].name, spobname)==0)
-            return &spob_stack[i];
-      WARN(_("Spob '%s' not found in the universe"), spobname);
-      return NULL;
-   }
-
-   const Spob p = {.name = (char*)spobname};
-   Spob *found = bsearch( &p, spob_stack, array_size(spob_stack), sizeof(Spob), spob_cmp );
-   if (found != NULL)
-      return found;
+   space_spobIndexCheck();
+   int id = nameindex_get( &space_spobIndex, spobname );
+   if (id >= 0)
+      return &spob_stack[id];
 
    WARN(_("Spob '%s' not found in the universe"), spobname);
    return NULL;
@@ -1125,10 +1286,8 @@ void spob_setKnown( Spob *p )
  */
 int spob_exists( const char* spobname )
 {
-   for (int i=0; i<array_size(spob_stack); i++)
-      if (strcmp(spob_stack[i].name,spobname)==0)
-         return 1;
-   return 0;
+   space_spobIndexCheck();
+   return (nameindex_get( &space_spobIndex, spobname ) >= 0);
 }
 
 /**
@@ -1139,10 +1298,8 @@ int spob_exists( const char* spobname )
  */
 const char* spob_existsCase( const char* spobname )
 {
-   for (int i=0; i<array_size(spob_stack); i++)
-      if (strcasecmp(spob_stack[i].name,spobname)==0)
-         return spob_stack[i].name;
-   return NULL;
+   space_spobIndexCheck();
+   return nameindex_getName( &space_spobIndexCase, spobname );
 }
 
 /**
@@ -1263,17 +1420,26 @@ const char *jump_getSymbol( const JumpPoint *jp )
 /**
  * @brief Controls fleet spawning.
  *
+ * Outside of initialization only SCHEDULER_SPAWN_BUDGET factions may spawn
+ *  per frame, so that timers running out together don't stall a single
+ *  frame. Factions that have to wait keep their negative timer and spawn
+ *  in the next frames, starting from the one after the last that spawned.
+ *
  *    @param dt Current delta tick.
  *    @param init Should be 1 to initialize the scheduler.
  */
 static void system_scheduler( double dt, int init )
 {
+   static int scheduler_next = 0;
+   int nspawned = 0;
+   int npresence = array_size(cur_system->presence);
    NTracingZone( _ctx, 1 );
 
    /* Go through all the factions and reduce the timer. */
-   for (int i=0; i < array_size(cur_system->presence); i++) {
+   for (int k=0; k < npresence; k++) {
       int n;
       nlua_env env;
+      int i = (init) ? k : (scheduler_next + k) % npresence;
       SystemPresence *p = &cur_system->presence[i];
       if (p->value <= 0.)
          continue;
@@ -1305,6 +1471,12 @@ static void system_scheduler( double dt, int init )
          if (p->timer >= 0.)
             continue;
 
+         /* Over budget, wait for the next frame. */
+         if (nspawned >= SCHEDULER_SPAWN_BUDGET)
+            continue;
+         nspawned++;
+         scheduler_next = i+1;
+
          nlua_getenv( naevL, env, "spawn" ); /* f */
          if (lua_isnil(naevL,-1)) {
             WARN(_("Lua Spawn script for faction '%s' missing obligatory entry point 'spawn'."),
@@ -1535,12 +1707,25 @@ int space_isSimulation( void )
    return space_simulating;
 }
 
+/**
+ * @brief returns whether we're doing the reduced fidelity warm-up.
+ *
+ * During it the time steps are coarse and there are no weapons, collisions
+ *  or special effects, only movement and AI.
+ */
+int space_isSimulationWarmup (void)
+{
+   return space_simulating_warmup;
+}
+
 /**
  * @brief returns whether or not we're simulating with effects.
+ *
+ * Cosmetic effects are also skipped while autonav fast forwards.
  */
 int space_needsEffects (void)
 {
-   return space_simulating_effects;
+   return space_simulating_effects && !player_autonavFastForward();
 }
 
 /**
@@ -1566,6 +1751,7 @@ void space_init( const char* sysname, int do_simulate )
    player_clear(); /* clears targets */
    ovr_mrkClear(); /* Clear markers when jumping. */
    pilots_clean(1); /* destroy non-persistent pilots */
+   ships_gfxUnloadUnused(); /* free graphics of ships not seen in a while */
    weapon_clear(); /* get rid of all the weapons */
    spfx_clear(); /* get rid of the explosions */
    gatherable_free(); /* get rid of gatherable stuff. */
@@ -1621,7 +1807,7 @@ void space_init( const char* sysname, int do_simulate )
       Pilot *const* pilot_stack = pilot_getAll();
       for (int i=0; i<array_size(pilot_stack); i++) {
          Pilot *p = pilot_stack[i];
-         pilot_calcStats( p );
+         pilot_calcStatsEffects( p );
          if (pilot_isWithPlayer(p))
             pilot_setFlag( p, PILOT_HIDE );
       }
@@ -1679,9 +1865,13 @@ void space_init( const char* sysname, int do_simulate )
       s = sound_disabled;
       sound_disabled = 1;
       ntime_allowUpdate( 0 );
-      n = SYSTEM_SIMULATE_TIME_PRE / fps_min_simulation;
+      /* Coarse warm-up to get the pilots spread out, without combat. */
+      space_simulating_warmup = 1;
+      n = MAX( 0., conf.simulate_warmup ) / SYSTEM_SIMULATE_DT_WARMUP;
       for (int i=0; i<n; i++)
-         update_routine( fps_min_simulation, 0 );
+         update_routine( SYSTEM_SIMULATE_DT_WARMUP, 0 );
+      space_simulating_warmup = 0;
+      /* Full fidelity for the last bit so there are effects and weapons flying. */
       space_simulating_effects = 1;
       n = SYSTEM_SIMULATE_TIME_POST / fps_min_simulation;
       for (int i=0; i<n; i++)
@@ -1703,6 +1893,18 @@ void space_init( const char* sysname, int do_simulate )
    space_simulating = 0;
    NTracingZoneEnd( _ctx_simulating );
 
+   /* Decode the sounds the pilots around can play. */
+   if (!sound_disabled) {
+      Pilot *const* pilot_stack = pilot_getAll();
+      for (int i=0; i<array_size(pilot_stack); i++) {
+         const Pilot *p = pilot_stack[i];
+         sound_preload( p->ship->sound );
+         for (int j=0; j<array_size(p->outfits); j++)
+            if (p->outfits[j]->outfit != NULL)
+               outfit_soundPreload( p->outfits[j]->outfit );
+      }
+   }
+
    /* Refresh overlay if necessary (player kept it open). */
    ovr_refresh();
 
@@ -1724,8 +1926,7 @@ Spob *spob_new (void)
    Spob *p, *old_stack;
    int realloced;
 
-   if (!systems_loading)
-      spobstack_changed = 1;
+   space_spobIndexValid = 0;
 
    /* Grow and initialize memory. */
    old_stack   = spob_stack;
@@ -1769,6 +1970,22 @@ const char *spob_name( const Spob *p )
    return _(p->name);
 }
 
+/**
+ * @brief Parses a spob, to be run in the vpool.
+ */
+static int spob_parseThread( void *ptr )
+{
+   SpobThreadData *data = ptr;
+   data->ret = spob_parse( &data->spob, data->filename, data->stdList );
+   /* Render if necessary. */
+   if (naev_shouldRenderLoadscreen()) {
+      gl_contextSet();
+      naev_renderLoadscreen();
+      gl_contextUnset();
+   }
+   return data->ret;
+}
+
 /**
  * @brief Loads all the spobs in the game.
  *
@@ -1778,6 +1995,8 @@ static int spobs_load (void)
 {
    char **spob_files;
    Commodity **stdList;
+   ThreadQueue *tq;
+   SpobThreadData *sdata;
 
    /* Initialize stack if needed. */
    if (spob_stack == NULL)
@@ -1788,28 +2007,46 @@ static int spobs_load (void)
 
    /* Load XML stuff. */
    spob_files = ndata_listRecursive( SPOB_DATA_PATH );
+   sdata = array_create_size( SpobThreadData, array_size(spob_files) );
    for (int i=0; i<array_size(spob_files); i++) {
       if (ndata_matchExt( spob_files[i], "xml" )) {
-         Spob s;
-         int ret = spob_parse( &s, spob_files[i], stdList );
-         if (ret == 0) {
-            s.id = array_size( spob_stack );
-            array_push_back( &spob_stack, s );
-         }
-
-         /* Render if necessary. */
-         naev_renderLoadscreen();
+         SpobThreadData *sd = &array_grow( &sdata );
+         sd->filename = spob_files[i];
+         sd->stdList  = stdList;
       }
+      else
+         free( spob_files[i] );
+   }
+   array_free( spob_files );
 
-      /* Clean up. */
-      free( spob_files[i] );
+   /* The faction index is built lazily, make sure the threads only read it. */
+   faction_exists( "" );
+
+   /* Parse in parallel, enqueuing after the data array is done. */
+   tq = vpool_create();
+   for (int i=0; i<array_size(sdata); i++)
+      vpool_enqueue( tq, spob_parseThread, &sdata[i] );
+   SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Add them in the same order as they were listed. */
+   for (int i=0; i<array_size(sdata); i++) {
+      SpobThreadData *sd = &sdata[i];
+      if (sd->ret == 0) {
+         sd->spob.id = array_size( spob_stack );
+         array_push_back( &spob_stack, sd->spob );
+      }
+      free( sd->filename );
    }
+   array_free( sdata );
    qsort( spob_stack, array_size(spob_stack), sizeof(Spob), spob_cmp );
+   space_spobIndexValid = 0;
    for (int j=0; j<array_size(spob_stack); j++)
       spob_stack[j].id = j;
 
    /* Clean up. */
-   array_free( spob_files );
    array_free( stdList );
 
    return 0;
@@ -2056,6 +2293,8 @@ int spob_luaInit( Spob *spob )
    spob->lua_land    = nlua_refenvtype( env, "land",     LUA_TFUNCTION );
    spob->lua_render  = nlua_refenvtype( env, "render",   LUA_TFUNCTION );
    spob->lua_update  = nlua_refenvtype( env, "update",   LUA_TFUNCTION );
+   spob->lua_update_dt      = 0.;
+   spob->lua_update_real_dt = 0.;
    spob->lua_comm    = nlua_refenvtype( env, "comm",     LUA_TFUNCTION );
    spob->lua_population=nlua_refenvtype(env, "population",LUA_TFUNCTION );
    spob->lua_barbg   = nlua_refenvtype( env, "barbg",    LUA_TFUNCTION );
@@ -2127,6 +2366,66 @@ void spob_gfxLoad( Spob *spob )
       spob->radius = (spob->gfx_space->w + spob->gfx_space->h)/4.;
 }
 
+/**
+ * @brief Starts decoding the plain spob images of a system.
+ */
+static glTexLoader *space_gfxLoader( StarSystem *sys )
+{
+   glTexLoader *ld = gl_texLoaderCreate();
+   for (int i=0; i<array_size(sys->spobs); i++) {
+      Spob *spob = sys->spobs[i];
+      if ((spob->lua_load == LUA_NOREF) && (spob->gfx_space == NULL) && (spob->gfx_spaceName != NULL))
+         gl_texLoaderAdd( ld, spob->gfx_spaceName, 1, 1, OPENGL_TEX_MIPMAPS, &spob->gfx_space );
+   }
+   return ld;
+}
+
+/**
+ * @brief Starts loading the assets of a system in the background.
+ *
+ * Used while preparing to jump so that entering the system does not have to
+ *  wait on them. The spob images get decoded on the worker threads and the
+ *  background script environment is created.
+ *
+ *    @param sys System to prefetch.
+ */
+void space_prefetch( StarSystem *sys )
+{
+   if ((sys == NULL) || (sys == space_prefetchSys) || (sys == cur_system))
+      return;
+   space_prefetchCancel();
+
+   NTracingZone( _ctx, 1 );
+   space_prefetchSys    = sys;
+   space_prefetchLoader = space_gfxLoader( sys );
+   background_prefetch( sys->background );
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Drops a system prefetched with space_prefetch.
+ */
+void space_prefetchCancel (void)
+{
+   StarSystem *sys = space_prefetchSys;
+   if (sys == NULL)
+      return;
+   space_prefetchSys = NULL;
+
+   /* The loads have to finish before their textures can be freed. */
+   gl_texLoaderWait( space_prefetchLoader );
+   space_prefetchLoader = NULL;
+   if (sys != cur_system) {
+      for (int i=0; i<array_size(sys->spobs); i++) {
+         Spob *spob = sys->spobs[i];
+         if (spob->lua_load != LUA_NOREF)
+            continue;
+         gl_freeTexture( spob->gfx_space );
+         spob->gfx_space = NULL;
+      }
+   }
+}
+
 /**
  * @brief Loads all the graphics for a star system.
  *
@@ -2134,8 +2433,21 @@ void spob_gfxLoad( Spob *spob )
  */
 void space_gfxLoad( StarSystem *sys )
 {
+   glTexLoader *ld;
    NTracingZone( _ctx, 1 );
 
+   /* Decode the plain images in parallel first, spob_gfxLoad then only has
+    * to handle Lua and the defaults. If the system was prefetched they are
+    * most likely decoded already. */
+   if (space_prefetchSys == sys) {
+      ld = space_prefetchLoader;
+      space_prefetchSys    = NULL;
+      space_prefetchLoader = NULL;
+   }
+   else
+      ld = space_gfxLoader( sys );
+   gl_texLoaderWait( ld );
+
    for (int i=0; i<array_size(sys->spobs); i++)
       spob_gfxLoad( sys->spobs[i] );
 
@@ -2149,6 +2461,10 @@ void space_gfxLoad( StarSystem *sys )
  */
 void space_gfxUnload( StarSystem *sys )
 {
+   /* The pending loads would write to the spobs. */
+   if (space_prefetchSys == sys)
+      space_prefetchCancel();
+
    for (int i=0; i<array_size(sys->spobs); i++) {
       Spob *spob = sys->spobs[i];
 
@@ -2405,9 +2721,9 @@ static int spob_parse( Spob *spob, const char *filename, Commodity **stdList )
 
 #if DEBUGGING
    /* Check for graphics. */
-   if ((spob->gfx_exterior != NULL) && !PHYSFS_exists(spob->gfx_exterior))
+   if ((spob->gfx_exterior != NULL) && !ndata_exists(spob->gfx_exterior))
       WARN(_("Can not find exterior graphic '%s' for spob '%s'!"), spob->gfx_exterior, spob->name);
-   if ((spob->gfx_comm != NULL) && !PHYSFS_exists(spob->gfx_comm))
+   if ((spob->gfx_comm != NULL) && !ndata_exists(spob->gfx_comm))
       WARN(_("Can not find comm graphic '%s' for spob '%s'!"), spob->gfx_comm, spob->name);
 #endif /* DEBUGGING */
 
@@ -2488,6 +2804,7 @@ int system_addSpob( StarSystem *sys, const char *spobname )
    /* add spob <-> star system to name stack */
    array_push_back( &spobname_stack, spob->name );
    array_push_back( &systemname_stack, sys->name );
+   space_spobSysIndexValid = 0;
 
    economy_addQueuedUpdate();
    /* This is required to clear the player statistics for this spob */
@@ -2545,6 +2862,7 @@ int system_rmSpob( StarSystem *sys, const char *spobname )
       if (strcmp(spobname, spobname_stack[i])==0) {
          array_erase( &spobname_stack, &spobname_stack[i], &spobname_stack[i+1] );
          array_erase( &systemname_stack, &systemname_stack[i], &systemname_stack[i+1] );
+         space_spobSysIndexValid = 0;
          found = 1;
          break;
       }
@@ -2669,6 +2987,8 @@ int system_rmJump( StarSystem *sys, const char *jumpname )
 
    /* Remove jump from system. */
    array_erase( &sys->jumps, &sys->jumps[i], &sys->jumps[i+1] );
+   map_jumpDistInvalidate();
+   space_spillInvalidate();
 
    economy_addQueuedUpdate();
 
@@ -2698,8 +3018,7 @@ StarSystem *system_new (void)
    StarSystem *sys;
    int id;
 
-   if (!systems_loading)
-      systemstack_changed = 1;
+   space_sysIndexValid = 0;
 
    /* Protect current system in case of realloc. */
    id = -1;
@@ -2770,6 +3089,8 @@ void systems_reconstructJumps (void)
       for (int j=0; j<array_size(sys->jumps); j++)
          sys->jumps[j].targetid = sys->jumps[j].target->id;
    }
+   map_jumpDistInvalidate();
+   space_spillInvalidate();
 
    NTracingZoneEnd( _ctx );
 }
@@ -2925,7 +3246,7 @@ if (o) WARN(_("Asteroid Exclusion Zone in Star System '%s' has missing/invalid '
  *    @param filename Name of the file to parse.
  *    @return 0 on success.
  */
-static int system_parse( StarSystem *sys, const char *filename )
+static int system_parse( StarSystem *sys, const char *filename, char ***spobs, char ***vspobs )
 {
    xmlNodePtr node, parent;
    xmlDocPtr doc;
@@ -3005,12 +3326,13 @@ static int system_parse( StarSystem *sys, const char *filename )
          xmlNodePtr cur = node->children;
          do {
             xml_onlyNodes(cur);
+            /* Added by systems_load, as it changes global state. */
             if (xml_isNode(cur,"spob")) {
-               system_addSpob( sys, xml_get(cur) );
+               array_push_back( spobs, xml_getStrd(cur) );
                continue;
             }
             if (xml_isNode(cur,"spob_virtual")) {
-               system_addVirtualSpob( sys, xml_get(cur) );
+               array_push_back( vspobs, xml_getStrd(cur) );
                continue;
             }
             DEBUG(_("Unknown node '%s' in star system '%s'"),node->name,sys->name);
@@ -3068,18 +3390,12 @@ static int system_parse( StarSystem *sys, const char *filename )
    } while (xml_nextNode(node));
 
    ss_sort( &sys->stats );
-   array_shrink( &sys->spobs );
-   array_shrink( &sys->spobsid );
    array_shrink( &sys->asteroids );
    array_shrink( &sys->astexclude );
 
    /* Convert hue from 0 to 359 value to 0 to 1 value. */
    sys->nebu_hue /= 360.;
 
-   /* Load the shader. */
-   if (sys->map_shader != NULL)
-      sys->ms = mapshader_get( sys->map_shader );
-
 #define MELEMENT(o,s)      if (o) WARN(_("Star System '%s' missing '%s' element"), sys->name, s)
    if (sys->name == NULL) WARN(_("Star System '%s' missing 'name' tag"), sys->name);
    MELEMENT((flags&FLAG_POSSET)==0,"pos");
@@ -3389,6 +3705,22 @@ int space_loadLua (void)
    return ret;
 }
 
+/**
+ * @brief Parses a star system, to be run in the vpool.
+ */
+static int system_parseThread( void *ptr )
+{
+   SystemThreadData *data = ptr;
+   data->ret = system_parse( &data->sys, data->filename, &data->spobs, &data->vspobs );
+   /* Render if necessary. */
+   if (naev_shouldRenderLoadscreen()) {
+      gl_contextSet();
+      naev_renderLoadscreen();
+      gl_contextUnset();
+   }
+   return data->ret;
+}
+
 /**
  * @brief Loads the entire systems, needs to be called after spobs_load.
  *
@@ -3405,6 +3737,8 @@ static int systems_load (void)
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
    char **system_files;
+   ThreadQueue *tq;
+   SystemThreadData *sdata;
 
    /* Allocate if needed. */
    if (systems_stack == NULL)
@@ -3415,27 +3749,62 @@ static int systems_load (void)
    /*
     * First pass - loads all the star systems_stack.
     */
+   sdata = array_create_size( SystemThreadData, array_size(system_files) );
    for (int i=0; i<array_size(system_files); i++) {
-      StarSystem sys;
-
+      SystemThreadData *sd;
       if (!ndata_matchExt( system_files[i], "xml" ))
          continue;
+      sd = &array_grow( &sdata );
+      memset( sd, 0, sizeof(SystemThreadData) );
+      sd->filename = system_files[i];
+      sd->spobs    = array_create( char* );
+      sd->vspobs   = array_create( char* );
+   }
 
-      int ret = system_parse( &sys, system_files[i] );
-      if (ret == 0) {
-         sys.filename = system_files[i];
-         sys.id = array_size(systems_stack);
+   /* Parse in parallel, enqueuing after the data array is done. */
+   tq = vpool_create();
+   for (int i=0; i<array_size(sdata); i++)
+      vpool_enqueue( tq, system_parseThread, &sdata[i] );
+   SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Add them in the same order as they were listed, with what has to be
+    * done serially. */
+   for (int i=0; i<array_size(sdata); i++) {
+      SystemThreadData *sd = &sdata[i];
+      StarSystem *sys = &sd->sys;
+      if (sd->ret == 0) {
+         for (int j=0; j<array_size(sd->spobs); j++)
+            system_addSpob( sys, sd->spobs[j] );
+         for (int j=0; j<array_size(sd->vspobs); j++)
+            system_addVirtualSpob( sys, sd->vspobs[j] );
+         array_shrink( &sys->spobs );
+         array_shrink( &sys->spobsid );
+
+         /* Load the shader. */
+         if (sys->map_shader != NULL)
+            sys->ms = mapshader_get( sys->map_shader );
+
+         sys->filename = sd->filename;
+         sys->id = array_size(systems_stack);
 
          /* Update asteroid info. */
-         system_updateAsteroids( &sys );
-
-         array_push_back( &systems_stack, sys );
+         system_updateAsteroids( sys );
 
-         /* Render if necessary. */
-         naev_renderLoadscreen();
+         array_push_back( &systems_stack, *sys );
       }
+      for (int j=0; j<array_size(sd->spobs); j++)
+         free( sd->spobs[j] );
+      for (int j=0; j<array_size(sd->vspobs); j++)
+         free( sd->vspobs[j] );
+      array_free( sd->spobs );
+      array_free( sd->vspobs );
    }
+   array_free( sdata );
    qsort( systems_stack, array_size(systems_stack), sizeof(StarSystem), system_cmp );
+   space_sysIndexValid = 0;
    for (int j=0; j<array_size(systems_stack); j++) {
       systems_stack[j].id = j;
       systems_stack[j].note = NULL; /* just to be sure */
@@ -3532,12 +3901,9 @@ void spobs_render (void)
    for (int i=0; i < array_size(cur_system->spobs); i++)
       space_renderSpob( cur_system->spobs[i] );
 
-   /* Render the asteroids & debris. */
+   /* Render the asteroids & debris, and the gatherables with them. */
    asteroids_render();
 
-   /* Render gatherable stuff. */
-   gatherable_render();
-
    NTracingZoneEnd( _ctx );
 
 }
@@ -3569,14 +3935,61 @@ static void space_renderJumpPoint( const JumpPoint *jp, int i )
    }
 }
 
+/**
+ * @brief Checks to see if a spob can be seen on screen.
+ *
+ *    @param p Spob to check.
+ *    @param margin Space around the screen that counts as on screen, in screen pixels.
+ *    @return 1 if the spob may be on screen.
+ */
+static int space_spobOnScreen( const Spob *p, double margin )
+{
+   double x1, y1, x2, y2;
+   cam_getViewRect( &x1, &y1, &x2, &y2, margin );
+   return space_spobInRect( p, x1, y1, x2, y2 );
+}
+
+/**
+ * @brief Checks to see if a spob overlaps a rectangle.
+ */
+static int space_spobInRect( const Spob *p, double x1, double y1, double x2, double y2 )
+{
+   double r;
+
+   /* The radius is only known once the graphics are loaded. */
+   if (p->gfx_space != NULL)
+      r = 0.5 * MAX( p->gfx_space->sw, p->gfx_space->sh );
+   else
+      r = MAX( p->radius, 0. );
+
+   return !((p->pos.x+r < x1) || (p->pos.x-r > x2) ||
+         (p->pos.y+r < y1) || (p->pos.y-r > y2));
+}
+
+/**
+ * @brief Records the next Lua call of a spob apart in the Lua profiler, as
+ *        spobs running the same script share their environment.
+ */
+static void space_spobProfile( const Spob *p )
+{
+   char buf[STRMAX_SHORT];
+   if (!luaprof_enabled())
+      return;
+   snprintf( buf, sizeof(buf), "spob: %s", p->name );
+   luaprof_nextName( buf );
+}
+
 /**
  * @brief Renders a spob.
  */
 static void space_renderSpob( const Spob *p )
 {
+   if (!space_spobOnScreen( p, SPOB_RENDER_MARGIN ))
+      return;
+
    if (p->lua_render != LUA_NOREF) {
       spob_luaInitMem( p );
-      /* TODO do a clip test first. */
+      space_spobProfile( p );
       lua_rawgeti(naevL, LUA_REGISTRYINDEX, p->lua_render); /* f */
       if (nlua_pcall( p->lua_env, 0, 0 )) {
          WARN(_("Spob '%s' failed to run '%s':\n%s"), p->name, "render", lua_tostring(naevL,-1));
@@ -3588,14 +4001,41 @@ static void space_renderSpob( const Spob *p )
 }
 
 /**
- * @brief Renders a spob.
+ * @brief Updates a spob.
+ *
+ * Spobs away from the screen are updated less often, with the time accumulated.
+ *  The ones the camera is heading to are updated every frame, so they don't
+ *  have to catch up all at once when they come into view.
  */
-static void space_updateSpob( const Spob *p, double dt, double real_dt )
+static void space_updateSpob( Spob *p, double dt, double real_dt )
 {
+   int far = 0;
+
    if (p->lua_update == LUA_NOREF)
       return;
-   /* TODO do a clip test first. */
+
+   if (conf.spob_far_interval > 0.) {
+      double x1, y1, x2, y2;
+      cam_getAheadRect( &x1, &y1, &x2, &y2, SPOB_UPDATE_MARGIN );
+      far = !space_spobInRect( p, x1, y1, x2, y2 );
+   }
+   if (far) {
+      p->lua_update_dt      += dt;
+      p->lua_update_real_dt += real_dt;
+      if (p->lua_update_real_dt < conf.spob_far_interval)
+         return;
+      dt      = p->lua_update_dt;
+      real_dt = p->lua_update_real_dt;
+   }
+   else {
+      dt      += p->lua_update_dt;
+      real_dt += p->lua_update_real_dt;
+   }
+   p->lua_update_dt      = 0.;
+   p->lua_update_real_dt = 0.;
+
    spob_luaInitMem( p );
+   space_spobProfile( p );
    lua_rawgeti(naevL, LUA_REGISTRYINDEX, p->lua_update); /* f */
    lua_pushnumber(naevL, dt); /* f, dt */
    lua_pushnumber(naevL, real_dt); /* f, real_dt */
@@ -3610,6 +4050,8 @@ static void space_updateSpob( const Spob *p, double dt, double real_dt )
  */
 void space_exit (void)
 {
+   space_prefetchCancel();
+
    /* Free standalone graphic textures */
    gl_freeTexture(jumppoint_gfx);
    jumppoint_gfx = NULL;
@@ -3619,6 +4061,10 @@ void space_exit (void)
    /* Free the names. */
    array_free(spobname_stack);
    array_free(systemname_stack);
+   space_indexFree();
+
+   /* Free the presence spills. */
+   space_spillInvalidate();
 
    /* Free the spobs. */
    for (int i=0; i < array_size(spob_stack); i++) {
@@ -4092,6 +4538,122 @@ static int getPresenceIndex( StarSystem *sys, int faction )
    return n;
 }
 
+/**
+ * @brief Frees the cached presence spills, to be called when jumps change.
+ */
+static void space_spillInvalidate (void)
+{
+   for (int h=0; h<2; h++) {
+      for (int i=0; i<array_size(space_spill[h]); i++)
+         array_free( space_spill[h][i].spill );
+      array_free( space_spill[h] );
+      space_spill[h] = NULL;
+   }
+}
+
+/**
+ * @brief Gets the systems the presence of a system spills into.
+ *
+ * This is the dependency index of spob presence: spobs only affect their own
+ *  system and the systems returned here. Spills are computed breadth-first
+ *  and cached until the jumps change.
+ *
+ *    @param sys System to get the spill of.
+ *    @param usehidden Whether or not the spill goes through hidden jumps.
+ *    @param levels Number of distances needed.
+ *    @return Array (array.h) of the systems reached, sorted by distance.
+ */
+static const SystemSpill *system_getSpill( StarSystem *sys, int usehidden, int levels )
+{
+   SpillCache *sc;
+   int n, head;
+
+   /* Make sure the cache covers all the systems. */
+   if (array_size(space_spill[usehidden]) != array_size(systems_stack)) {
+      for (int i=0; i<array_size(space_spill[usehidden]); i++)
+         array_free( space_spill[usehidden][i].spill );
+      array_free( space_spill[usehidden] );
+      space_spill[usehidden] = array_create_size( SpillCache, array_size(systems_stack) );
+      for (int i=0; i<array_size(systems_stack); i++) {
+         SpillCache c = { .spill = NULL, .levels = -1, .full = 0 };
+         array_push_back( &space_spill[usehidden], c );
+      }
+   }
+   sc = &space_spill[usehidden][ system_index(sys) ];
+   if (sc->full || (sc->levels >= levels))
+      return sc->spill;
+
+   /* Breadth-first search, the array doubles as the queue. */
+   array_free( sc->spill );
+   sc->spill = array_create( SystemSpill );
+   sys->spilled = 1;
+   for (int i=0; i<array_size(sys->jumps); i++) {
+      JumpPoint *jp = &sys->jumps[i];
+      if (jp->target->spilled == 0 && (usehidden || !jp_isFlag( jp, JP_HIDDEN )) && !jp_isFlag( jp, JP_EXITONLY )) {
+         SystemSpill s = { .sys = system_index( jp->target ), .dist = 0 };
+         array_push_back( &sc->spill, s );
+         jp->target->spilled = 1;
+      }
+   }
+   head = 0;
+   while (head < array_size(sc->spill)) {
+      SystemSpill cur = sc->spill[head++];
+      StarSystem *csys = &systems_stack[ cur.sys ];
+      if (cur.dist+1 >= levels)
+         continue;
+      for (int i=0; i<array_size(csys->jumps); i++) {
+         JumpPoint *jp = &csys->jumps[i];
+         if (jp->target->spilled == 0 && (usehidden || !jp_isFlag( jp, JP_HIDDEN )) && !jp_isFlag( jp, JP_EXITONLY )) {
+            SystemSpill s = { .sys = system_index( jp->target ), .dist = cur.dist+1 };
+            array_push_back( &sc->spill, s );
+            jp->target->spilled = 1;
+         }
+      }
+   }
+
+   /* Only clean up the systems we touched. */
+   n = array_size(sc->spill);
+   sys->spilled = 0;
+   for (int i=0; i<n; i++)
+      systems_stack[ sc->spill[i].sys ].spilled = 0;
+
+   /* Reached everything if the last distance wasn't cut off. */
+   sc->levels = levels;
+   sc->full   = (n == 0) || (sc->spill[n-1].dist+1 < levels);
+   return sc->spill;
+}
+
+/**
+ * @brief Checks to see if a faction is in a presence filter.
+ *
+ *    @param filter Array (array.h) of factions, NULL matches all of them.
+ *    @param faction Faction to check.
+ *    @return 1 if the faction is in the filter.
+ */
+static int presence_inFilter( const int *filter, int faction )
+{
+   if (filter == NULL)
+      return 1;
+   for (int i=0; i<array_size(filter); i++)
+      if (filter[i] == faction)
+         return 1;
+   return 0;
+}
+
+/**
+ * @brief Adds presence of a single faction to a system.
+ */
+static void system_presenceAdd( StarSystem *sys, int faction, double base, double bonus, const int *filter )
+{
+   int id;
+   if (!presence_inFilter( filter, faction ))
+      return;
+   id = getPresenceIndex(sys, faction);
+   sys->presence[id].base   = MAX( sys->presence[id].base, base );
+   sys->presence[id].bonus += bonus;
+   sys->presence[id].value  = sys->presence[id].base + sys->presence[id].bonus;
+}
+
 /**
  * @brief Adds (or removes) some presence to a system.
  *
@@ -4100,14 +4662,25 @@ static int getPresenceIndex( StarSystem *sys, int faction )
  */
 void system_presenceAddSpob( StarSystem *sys, const SpobPresence *ap )
 {
-   int id, curSpill;
-   Queue q, qn;
-   double spillfactor;
+   system_presenceAddSpobFilter( sys, ap, NULL );
+}
+
+/**
+ * @brief Adds the presence of a spob to a system and its spill, only for
+ *        some factions.
+ *
+ *    @param sys Pointer to the system to add to or remove from.
+ *    @param ap Spob presence to add.
+ *    @param filter Array (array.h) of the factions to add, NULL for all.
+ */
+static void system_presenceAddSpobFilter( StarSystem *sys, const SpobPresence *ap, const int *filter )
+{
+   const SystemSpill *spill;
    int faction = ap->faction;
    double base = ap->base;
    double bonus = ap->bonus;
    double range = ap->range;
-   int usehidden = faction_usesHiddenJumps( faction );
+   int usehidden;
    const FactionGenerator *fgens;
 
    /* Check for NULL and display a warning. */
@@ -4127,95 +4700,40 @@ void system_presenceAddSpob( StarSystem *sys, const SpobPresence *ap )
    /* Get secondary if applicable. */
    fgens = faction_generators( faction );
 
-   /* Add the presence to the current system. */
-   id = getPresenceIndex(sys, faction);
-   sys->presence[id].base   = MAX( sys->presence[id].base, base );
-   sys->presence[id].bonus += bonus;
-   sys->presence[id].value  = sys->presence[id].base + sys->presence[id].bonus;
-   for (int i=0; i<array_size(fgens); i++) {
-      int x = getPresenceIndex(sys, fgens[i].id);
-      sys->presence[x].base   = MAX( sys->presence[x].base, MAX(0., base*fgens[i].weight) );
-      sys->presence[x].bonus += MAX(0., bonus*fgens[i].weight);
-      sys->presence[x].value  = sys->presence[x].base + sys->presence[x].bonus;
+   /* Skip spobs that don't touch the filtered factions. */
+   if (filter != NULL) {
+      int touched = presence_inFilter( filter, faction );
+      for (int i=0; !touched && (i<array_size(fgens)); i++)
+         touched = presence_inFilter( filter, fgens[i].id );
+      if (!touched)
+         return;
    }
 
+   /* Add the presence to the current system. */
+   system_presenceAdd( sys, faction, base, bonus, filter );
+   for (int i=0; i<array_size(fgens); i++)
+      system_presenceAdd( sys, fgens[i].id, MAX(0., base*fgens[i].weight),
+            MAX(0., bonus*fgens[i].weight), filter );
+
    /* If there's no range, we're done here. */
    if (range < 1)
       return;
 
-   /* Add the spill. */
-   sys->spilled   = 1;
-   curSpill       = 0;
-   q              = q_create();
-   qn             = q_create();
-
-   /* Create the initial queue consisting of sys adjacencies. */
-   for (int i=0; i < array_size(sys->jumps); i++) {
-      if (sys->jumps[i].target->spilled == 0 && (usehidden || !jp_isFlag( &sys->jumps[i], JP_HIDDEN )) && !jp_isFlag( &sys->jumps[i], JP_EXITONLY )) {
-         q_enqueue( q, sys->jumps[i].target );
-         sys->jumps[i].target->spilled = 1;
-      }
-   }
-
-   /* If it's empty, something's wrong. */
-   if (q_isEmpty(q)) {
-      /* Means system isn't connected. */
-      /*WARN(_("q is empty after getting adjacencies of %s."), sys->name);*/
-      q_destroy(q);
-      q_destroy(qn);
-      goto sys_cleanup;
-   }
-
-   while (curSpill < range) {
-      int x;
-
-      /* Pull one off the current range queue. */
-      StarSystem *cur = q_dequeue(q);
-
-      /* Ran out of candidates before running out of spill range! */
-      if (cur == NULL)
+   /* Spill some presence. */
+   usehidden = !!faction_usesHiddenJumps( faction );
+   spill = system_getSpill( sys, usehidden, (int)ceil(range) );
+   for (int i=0; i<array_size(spill); i++) {
+      StarSystem *cur;
+      double spillfactor;
+      if (spill[i].dist >= range)
          break;
-
-      /* Enqueue all its adjacencies to the next range queue. */
-      for (int i=0; i<array_size(cur->jumps); i++) {
-         if (cur->jumps[i].target->spilled == 0 && (usehidden || !jp_isFlag( &cur->jumps[i], JP_HIDDEN )) && !jp_isFlag( &cur->jumps[i], JP_EXITONLY )) {
-            q_enqueue( qn, cur->jumps[i].target );
-            cur->jumps[i].target->spilled = 1;
-         }
-      }
-
-      /* Spill some presence. */
-      x = getPresenceIndex(cur, faction);
-      spillfactor = 1. / (2. + (double)curSpill);
-      cur->presence[x].base   = MAX( cur->presence[x].base, base * spillfactor );
-      cur->presence[x].bonus += bonus * spillfactor;
-      cur->presence[x].value  = cur->presence[x].base + cur->presence[x].bonus;
-
-      for (int i=0; i<array_size(fgens); i++) {
-         int y = getPresenceIndex(cur, fgens[i].id);
-         cur->presence[y].base   = MAX( cur->presence[y].base, MAX(0., base*spillfactor*fgens[i].weight) );
-         cur->presence[y].bonus += MAX(0., bonus*spillfactor*fgens[i].weight );
-         cur->presence[y].value  = cur->presence[y].base + cur->presence[y].bonus;
-      }
-
-      /* Check to see if we've finished this range and grab the next queue. */
-      if (q_isEmpty(q)) {
-         curSpill++;
-         q_destroy(q);
-         q  = qn;
-         qn = q_create();
-      }
+      cur = &systems_stack[ spill[i].sys ];
+      spillfactor = 1. / (2. + (double)spill[i].dist);
+      system_presenceAdd( cur, faction, base * spillfactor, bonus * spillfactor, filter );
+      for (int j=0; j<array_size(fgens); j++)
+         system_presenceAdd( cur, fgens[j].id, MAX(0., base*spillfactor*fgens[j].weight),
+               MAX(0., bonus*spillfactor*fgens[j].weight), filter );
    }
-
-   /* Destroy the queues. */
-   q_destroy(q);
-   q_destroy(qn);
-
-sys_cleanup:
-   /* Clean up our mess. */
-   for (int i=0; i < array_size(systems_stack); i++)
-      systems_stack[i].spilled = 0;
-   return;
 }
 
 /**
@@ -4285,6 +4803,17 @@ double system_getPresenceFull( const StarSystem *sys, int faction, double *base,
  *    @param sys Pointer to the system to process.
  */
 void system_addAllSpobsPresence( StarSystem *sys )
+{
+   system_addAllSpobsPresenceFilter( sys, NULL );
+}
+
+/**
+ * @brief Go through all the spobs and add their presence for some factions.
+ *
+ *    @param sys Pointer to the system to process.
+ *    @param filter Array (array.h) of the factions to add, NULL for all.
+ */
+static void system_addAllSpobsPresenceFilter( StarSystem *sys, const int *filter )
 {
    /* Check for NULL and display a warning. */
 #if DEBUGGING
@@ -4296,12 +4825,12 @@ void system_addAllSpobsPresence( StarSystem *sys )
 
    /* Real spobs. */
    for (int i=0; i<array_size(sys->spobs); i++)
-      system_presenceAddSpob(sys, &sys->spobs[i]->presence );
+      system_presenceAddSpobFilter(sys, &sys->spobs[i]->presence, filter );
 
    /* Virtual spobs. */
    for (int i=0; i<array_size(sys->spobs_virtual); i++)
       for (int j=0; j<array_size(sys->spobs_virtual[i]->presences); j++)
-         system_presenceAddSpob(sys, &sys->spobs_virtual[i]->presences[j] );
+         system_presenceAddSpobFilter(sys, &sys->spobs_virtual[i]->presences[j], filter );
 }
 
 /**
@@ -4309,6 +4838,9 @@ void system_addAllSpobsPresence( StarSystem *sys )
  */
 void space_reconstructPresences (void)
 {
+   /* Jumps may have changed in ways we don't track (editor). */
+   space_spillInvalidate();
+
    /* Reset the presence in each system. */
    for (int i=0; i<array_size(systems_stack); i++) {
       array_free(systems_stack[i].presence);
@@ -4320,6 +4852,74 @@ void space_reconstructPresences (void)
    for (int i=0; i<array_size(systems_stack); i++)
       system_addAllSpobsPresence(&systems_stack[i]);
 
+   space_presencesFinish();
+}
+
+/**
+ * @brief Reconstructs the presence of only some factions.
+ *
+ * Presence of other factions is left untouched, so this is only valid when
+ *  the jumps didn't change. Factions generated by the given factions are
+ *  reconstructed too.
+ *
+ *    @param factions Array (array.h) of the factions whose spobs changed.
+ */
+void space_reconstructPresencesFactions( const int *factions )
+{
+   int *filter = array_create( int );
+
+   /* Get all the factions that have to be redone. */
+   for (int i=0; i<array_size(factions); i++) {
+      const FactionGenerator *fgens;
+      if (!faction_isFaction( factions[i] ))
+         continue;
+      if (!presence_inFilter( filter, factions[i] ))
+         array_push_back( &filter, factions[i] );
+      fgens = faction_generators( factions[i] );
+      for (int j=0; j<array_size(fgens); j++)
+         if (!presence_inFilter( filter, fgens[j].id ))
+            array_push_back( &filter, fgens[j].id );
+   }
+   if (array_size(filter) == 0) {
+      array_free( filter );
+      return;
+   }
+
+   /* Reset the presence of the factions. */
+   for (int i=0; i<array_size(systems_stack); i++) {
+      StarSystem *sys = &systems_stack[i];
+      for (int j=0; j<array_size(sys->presence); j++) {
+         if (!presence_inFilter( filter, sys->presence[j].faction ))
+            continue;
+         sys->presence[j].base  = 0.;
+         sys->presence[j].bonus = 0.;
+         sys->presence[j].value = 0.;
+      }
+   }
+
+   /* Re-add presence of the factions. */
+   for (int i=0; i<array_size(systems_stack); i++)
+      system_addAllSpobsPresenceFilter( &systems_stack[i], filter );
+
+   /* Drop the factions that are no longer present, like a full reconstruction would. */
+   for (int i=0; i<array_size(systems_stack); i++) {
+      StarSystem *sys = &systems_stack[i];
+      for (int j=array_size(sys->presence)-1; j>=0; j--) {
+         SystemPresence *sp = &sys->presence[j];
+         if ((sp->base == 0.) && (sp->bonus == 0.) && presence_inFilter( filter, sp->faction ))
+            array_erase( &sys->presence, sp, sp+1 );
+      }
+   }
+
+   array_free( filter );
+   space_presencesFinish();
+}
+
+/**
+ * @brief Updates what depends on the presence once it has been reconstructed.
+ */
+static void space_presencesFinish (void)
+{
    /* Determine dominant faction. */
    for (int i=0; i<array_size(systems_stack); i++) {
       system_setFaction( &systems_stack[i] );
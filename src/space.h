@@ -15,7 +15,7 @@
 #include "tech.h"
 #include "asteroid.h"
 
-#define SYSTEM_SIMULATE_TIME_PRE   25. /**< Time to simulate system before player is added, during this time special effect creation is disabled. */
+#define SYSTEM_SIMULATE_DT_WARMUP  0.25 /**< Time step of the reduced fidelity warm-up (the duration is conf.simulate_warmup). */
 #define SYSTEM_SIMULATE_TIME_POST   5. /**< Time to simulate the system before the player is added, however, effects are added. */
 #define MAX_HYPERSPACE_VEL    25. /**< Speed to brake to before jumping. */
 
@@ -147,6 +147,8 @@ typedef struct Spob_ {
    int lua_comm;     /**< Run when player communicates with the spob. */
    int lua_population; /**< Run when getting a string representing the population of the spob. */
    int lua_barbg;    /**< Run to generate bar backgrounds as necessary. */
+   double lua_update_dt; /**< Game time accumulated since the last update when off-screen. */
+   double lua_update_real_dt; /**< Real time accumulated since the last update when off-screen. */
 } Spob;
 
 /*
@@ -340,6 +342,7 @@ int spob_addCommodity( Spob *p, Commodity *c );
 int spob_addService( Spob *p, int service );
 int spob_rmService( Spob *p, int service );
 int spob_rename( Spob *p, char *newname );
+int system_rename( StarSystem *sys, char *newname );
 /* Land related stuff. */
 char spob_getColourChar( const Spob *p );
 const char *spob_getSymbol( const Spob *p );
@@ -391,6 +394,7 @@ double system_getPresence( const StarSystem *sys, int faction );
 double system_getPresenceFull( const StarSystem *sys, int faction, double *base, double *bonus );
 void system_addAllSpobsPresence( StarSystem *sys );
 void space_reconstructPresences( void );
+void space_reconstructPresencesFactions( const int *factions );
 void system_rmCurrentPresence( StarSystem *sys, int faction, double amount );
 
 /*
@@ -398,6 +402,7 @@ void system_rmCurrentPresence( StarSystem *sys, int faction, double amount );
  */
 void space_update( double dt, double real_dt );
 int space_isSimulation (void);
+int space_isSimulationWarmup (void);
 int space_needsEffects (void);
 
 /*
@@ -405,6 +410,8 @@ int space_needsEffects (void);
  */
 void space_gfxLoad( StarSystem *sys );
 void space_gfxUnload( StarSystem *sys );
+void space_prefetch( StarSystem *sys );
+void space_prefetchCancel (void);
 
 /*
  * Getting stuff.
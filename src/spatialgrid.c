@@ -0,0 +1,222 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file spatialgrid.c
+ *
+ * @brief Loose hashed uniform grid, alternative to the quadtree.
+ *
+ * Insertion is constant time so the grid is just rebuilt every frame, and
+ * queries do not need any scratch memory so they can be run from multiple
+ * threads at the same time.
+ */
+/** @cond */
+#include <stdlib.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "spatialgrid.h"
+
+/* Element fields. */
+enum {
+   sg_elt_lft,    /* Rectangle encompassing the element. */
+   sg_elt_top,
+   sg_elt_rgt,
+   sg_elt_btm,
+   sg_elt_id,     /* ID of the element. */
+   sg_elt_cx,     /* Cell the element is stored in. */
+   sg_elt_cy,
+   sg_elt_next,   /* Next element in the bucket, -1 if last. */
+   sg_elt_num,
+};
+
+/**
+ * @brief Gets the cell of a coordinate, rounding towards negative infinity.
+ */
+static int sg_cell( const SpatialGrid *sg, int x )
+{
+   if (x >= 0)
+      return x / sg->cell_size;
+   return -((-x + sg->cell_size - 1) / sg->cell_size);
+}
+
+/**
+ * @brief Gets the bucket of a cell.
+ */
+static int sg_hash( const SpatialGrid *sg, int cx, int cy )
+{
+   unsigned int h = ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u);
+   return h & (sg->nbuckets-1);
+}
+
+/**
+ * @brief Checks to see if an element intersects a rectangle.
+ */
+static int sg_intersect( const SpatialGrid *sg, int elt, int x1, int y1, int x2, int y2 )
+{
+   return (il_get( &sg->elts, elt, sg_elt_lft ) <= x2) &&
+         (il_get( &sg->elts, elt, sg_elt_rgt ) >= x1) &&
+         (il_get( &sg->elts, elt, sg_elt_top ) <= y2) &&
+         (il_get( &sg->elts, elt, sg_elt_btm ) >= y1);
+}
+
+/**
+ * @brief Creates a spatial grid.
+ *
+ *    @param sg Grid to create.
+ *    @param cell_size Size of the cells, should be around the size of the queries.
+ *    @param nbuckets Number of hash buckets, rounded up to a power of two.
+ */
+void sg_create( SpatialGrid *sg, int cell_size, int nbuckets )
+{
+   sg->cell_size = MAX( 1, cell_size );
+   sg->nbuckets = 1;
+   while (sg->nbuckets < nbuckets)
+      sg->nbuckets <<= 1;
+   sg->buckets = malloc( sg->nbuckets * sizeof(int) );
+   il_create( &sg->elts, sg_elt_num );
+   sg_clear( sg );
+}
+
+/**
+ * @brief Destroys a spatial grid.
+ *
+ *    @param sg Grid to destroy.
+ */
+void sg_destroy( SpatialGrid *sg )
+{
+   free( sg->buckets );
+   sg->buckets = NULL;
+   il_destroy( &sg->elts );
+}
+
+/**
+ * @brief Removes all the elements from a spatial grid.
+ *
+ *    @param sg Grid to clear.
+ */
+void sg_clear( SpatialGrid *sg )
+{
+   for (int i=0; i<sg->nbuckets; i++)
+      sg->buckets[i] = -1;
+   il_clear( &sg->elts );
+   sg->max_hw = 0;
+   sg->max_hh = 0;
+}
+
+/**
+ * @brief Inserts an element into a spatial grid.
+ *
+ *    @param sg Grid to insert into.
+ *    @param id ID of the element, returned by the queries.
+ *    @param x1 Left of the element.
+ *    @param y1 Bottom of the element.
+ *    @param x2 Right of the element.
+ *    @param y2 Top of the element.
+ */
+void sg_insert( SpatialGrid *sg, int id, int x1, int y1, int x2, int y2 )
+{
+   int cx = sg_cell( sg, x1 + (x2-x1)/2 );
+   int cy = sg_cell( sg, y1 + (y2-y1)/2 );
+   int b  = sg_hash( sg, cx, cy );
+   int e  = il_push_back( &sg->elts );
+
+   il_set( &sg->elts, e, sg_elt_lft, x1 );
+   il_set( &sg->elts, e, sg_elt_top, y1 );
+   il_set( &sg->elts, e, sg_elt_rgt, x2 );
+   il_set( &sg->elts, e, sg_elt_btm, y2 );
+   il_set( &sg->elts, e, sg_elt_id, id );
+   il_set( &sg->elts, e, sg_elt_cx, cx );
+   il_set( &sg->elts, e, sg_elt_cy, cy );
+   il_set( &sg->elts, e, sg_elt_next, sg->buckets[b] );
+   sg->buckets[b] = e;
+
+   /* Centres are rounded down, so the half-size may be one more. */
+   sg->max_hw = MAX( sg->max_hw, (x2-x1)/2+1 );
+   sg->max_hh = MAX( sg->max_hh, (y2-y1)/2+1 );
+}
+
+/**
+ * @brief Adds an element found by a query to a list.
+ */
+static int sg_queryPush( void *data, int id )
+{
+   IntList *out = data;
+   il_set( out, il_push_back( out ), 0, id );
+   return 0;
+}
+
+/**
+ * @brief Gets the elements that intersect a rectangle.
+ *
+ * Does not modify the grid, so it can be called from multiple threads.
+ *
+ *    @param sg Grid to query.
+ *    @param[out] out List of the IDs of the intersecting elements.
+ *    @param x1 Left of the rectangle.
+ *    @param y1 Bottom of the rectangle.
+ *    @param x2 Right of the rectangle.
+ *    @param y2 Top of the rectangle.
+ */
+void sg_query( const SpatialGrid *sg, IntList *out, int x1, int y1, int x2, int y2 )
+{
+   il_clear( out );
+   sg_query_each( sg, x1, y1, x2, y2, sg_queryPush, out );
+}
+
+/**
+ * @brief Calls a function on the elements that intersect a rectangle.
+ *
+ * Does not modify the grid, so it can be called from multiple threads. The
+ *  function must not modify the grid either.
+ *
+ *    @param sg Grid to query.
+ *    @param x1 Left of the rectangle.
+ *    @param y1 Bottom of the rectangle.
+ *    @param x2 Right of the rectangle.
+ *    @param y2 Top of the rectangle.
+ *    @param func Function to call with the ID of each element, returning
+ *                nonzero stops the query.
+ *    @param data User data for the function.
+ */
+void sg_query_each( const SpatialGrid *sg, int x1, int y1, int x2, int y2, QtEltFunc *func, void *data )
+{
+   int cx1, cy1, cx2, cy2;
+   double ncells;
+
+   if (il_size( &sg->elts ) <= 0)
+      return;
+
+   /* Elements can stick out of their cell by up to their half-size. */
+   cx1 = sg_cell( sg, x1 - sg->max_hw );
+   cy1 = sg_cell( sg, y1 - sg->max_hh );
+   cx2 = sg_cell( sg, x2 + sg->max_hw );
+   cy2 = sg_cell( sg, y2 + sg->max_hh );
+
+   /* Large queries are faster by just going over all the elements. */
+   ncells = (double)(cx2-cx1+1) * (double)(cy2-cy1+1);
+   if (ncells >= il_size( &sg->elts )) {
+      for (int e=0; e<il_size( &sg->elts ); e++)
+         if (sg_intersect( sg, e, x1, y1, x2, y2 ) &&
+               func( data, il_get( &sg->elts, e, sg_elt_id ) ))
+            return;
+      return;
+   }
+
+   for (int cy=cy1; cy<=cy2; cy++) {
+      for (int cx=cx1; cx<=cx2; cx++) {
+         int e = sg->buckets[ sg_hash( sg, cx, cy ) ];
+         while (e != -1) {
+            /* Buckets can be shared by multiple cells, only use the elements
+             * that belong to this one so nothing gets visited twice. */
+            if ((il_get( &sg->elts, e, sg_elt_cx ) == cx) &&
+                  (il_get( &sg->elts, e, sg_elt_cy ) == cy) &&
+                  sg_intersect( sg, e, x1, y1, x2, y2 ) &&
+                  func( data, il_get( &sg->elts, e, sg_elt_id ) ))
+               return;
+            e = il_get( &sg->elts, e, sg_elt_next );
+         }
+      }
+   }
+}
@@ -0,0 +1,30 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+#include "intlist.h"
+#include "quadtree.h"
+
+/**
+ * @brief Loose hashed uniform grid for rectangle queries.
+ *
+ * Elements are stored only in the cell containing their centre, and queries
+ * are grown by the largest element half-size to make up for it. Cells are
+ * hashed into a fixed amount of buckets so the grid has no bounds.
+ */
+typedef struct SpatialGrid_ {
+   int cell_size; /**< Size of a cell. */
+   int nbuckets;  /**< Number of hash buckets, power of two. */
+   int *buckets;  /**< First element of each bucket, -1 if empty. */
+   IntList elts;  /**< Elements stored in the grid. */
+   int max_hw;    /**< Largest half-width of the elements. */
+   int max_hh;    /**< Largest half-height of the elements. */
+} SpatialGrid;
+
+void sg_create( SpatialGrid *sg, int cell_size, int nbuckets );
+void sg_destroy( SpatialGrid *sg );
+void sg_clear( SpatialGrid *sg );
+void sg_insert( SpatialGrid *sg, int id, int x1, int y1, int x2, int y2 );
+void sg_query( const SpatialGrid *sg, IntList *out, int x1, int y1, int x2, int y2 );
+void sg_query_each( const SpatialGrid *sg, int x1, int y1, int x2, int y2, QtEltFunc *func, void *data );
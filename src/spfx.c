@@ -20,7 +20,9 @@
 #include "array.h"
 #include "camera.h"
 #include "debris.h"
+#include "gui.h"
 #include "log.h"
+#include "mempool.h"
 #include "ndata.h"
 #include "nxml.h"
 #include "opengl.h"
@@ -47,8 +49,23 @@
 
 /* Trail stuff. */
 #define TRAIL_UPDATE_DT       0.05  /**< Rate (in seconds) at which trail is updated. */
+#define TRAIL_UPDATE_DT_MAX   0.2   /**< Longest time between control points of straight trails, as a fraction of their time to live. */
+#define TRAIL_MERGE_DIST      2.    /**< Screen distance (in pixels) under which samples are merged. */
+#define TRAIL_STRAIGHT_DIST   0.5   /**< Screen distance (in pixels) from a line under which trails are straight. */
 static TrailSpec* trail_spec_stack; /**< Trail specifications. */
 static Trail_spfx** trail_spfx_stack; /**< Active trail effects. */
+static MemPool trail_spfx_pool = MEMPOOL_INIT( Trail_spfx, 128, "trail_spfx_pool" ); /**< Memory of the trail effects. */
+#define TRAIL_BATCH_STRIDE    14    /**< Floats per vertex: position, corner, colour, length, thicknesses, time, timer and seed. */
+/**
+ * @brief Pending trail segments sharing a trail type.
+ */
+typedef struct TrailBatch_ {
+   GLuint type; /**< Shader subroutine of the segments. */
+   GLfloat *data; /**< Vertex data of the segments (array.h). */
+} TrailBatch;
+static TrailBatch *trail_batches = NULL; /**< Pending trail segments per type (array.h). */
+static gl_vbo *trail_vbo = NULL; /**< VBO the trail segments get streamed to. */
+static unsigned int trail_frame = 0; /**< Current visibility frame of the trails. */
 
 /*
  * Special hard-coded special effects
@@ -86,6 +103,32 @@ static TrailSpec* trailSpec_getRaw( const char* name );
 static void spfx_updateShake( double dt );
 static void spfx_updateDamage( double dt );
 
+/*
+ * Particles.
+ */
+#define SPFX_LAYERS        3  /**< Number of spfx layers. */
+#define SPFX_RING_SIZE     64 /**< Initial number of particles in a ring. */
+#define SPFX_PARTICLE_LEN  7  /**< Floats per particle: position, velocity, emission time, death time and seed. */
+#define SPFX_PARTICLE_GEOM "spfx_particle.geom" /**< Geometry shader turning particles into quads. */
+#define SPFX_PARTICLE_DEFINES "#define SPFX_PARTICLE 1\n" /**< Lets the effect shaders read per particle values. */
+
+/**
+ * @brief Ring buffer of emitted shader effect particles.
+ *
+ * Only the emission of the particles is stored, the shaders compute their
+ *  current position and time, so there is nothing to update on the CPU.
+ */
+typedef struct SPFX_Ring_ {
+   GLfloat *data; /**< Emission data, SPFX_PARTICLE_LEN floats per particle. */
+   int size; /**< Number of particles that fit in the ring. */
+   int head; /**< Next slot to emit into, also the oldest particle. */
+   int dirty; /**< Whether or not the VBO is out of date. */
+   double epoch; /**< Time the emission times are relative to, keeps them precise as floats. */
+   double last; /**< Time the last particle dies. */
+   gl_vbo *vbo; /**< VBO with the emission data. */
+   int vbo_size; /**< Number of particles the VBO holds. */
+} SPFX_Ring;
+
 /**
  * @struct SPFX_Base
  *
@@ -103,11 +146,12 @@ typedef struct SPFX_Base_ {
    /* Shaders! */
    double size; /**< Default size. */
    GLint shader; /**< Shader to use. */
-   GLint vertex;
+   GLint particle; /**< Position and velocity attribute of the particles. */
+   GLint particle_time; /**< Time and seed attribute of the particles. */
    GLint projection;
-   GLint u_time; /**< Time variable in shader. */
-   GLint u_r; /**< Unique shader value. */
+   GLint u_now; /**< Current time of the ring in the shader. */
    GLint u_size; /**< Size of the shader. */
+   SPFX_Ring ring[SPFX_LAYERS]; /**< Particles of each layer. */
 } SPFX_Base;
 
 static SPFX_Base *spfx_effects = NULL; /**< Total special effects. */
@@ -125,16 +169,50 @@ typedef struct SPFX_ {
    int effect; /**< The real effect */
 
    double timer; /**< Time left */
-
-   /* For shaders. */
-   GLfloat time; /**< Time elapsed (not left). */
-   GLfloat unique; /**< Uniqueness value in the shader. */
 } SPFX;
 
 /* front stack is for effects on player, back is for the rest */
 static SPFX *spfx_stack_front = NULL; /**< Frontal special effect layer. */
 static SPFX *spfx_stack_middle = NULL; /**< Middle special effect layer. */
 static SPFX *spfx_stack_back = NULL; /**< Back special effect layer. */
+static double spfx_time = 0.; /**< Time the particle rings run on. */
+
+/*
+ * Particle groups.
+ */
+#define SPFX_GROUP_BUDGET  512 /**< Maximum number of group particles emitted per frame. */
+#define SPFX_GROUP_DIRS    64  /**< Number of precomputed directions particles get scattered along. */
+
+/**
+ * @brief A particle of a group, relative to the group itself.
+ */
+typedef struct SPFX_GroupParticle_ {
+   GLfloat x, y; /**< Offset from the group when emitted. */
+   GLfloat vx, vy; /**< Velocity relative to the group. */
+   GLfloat ttl; /**< Age of the group the particle dies at. */
+   int effect; /**< The real effect. */
+   int lastframe; /**< Needed when paused. */
+} SPFX_GroupParticle;
+
+/**
+ * @brief Group of sprite particles emitted together, such as debris.
+ *
+ * The particles only move linearly, so their positions are computed when
+ *  rendering and updating the group just ages it.
+ */
+typedef struct SPFX_Group_ {
+   vec2 pos; /**< Position the group was emitted at. */
+   vec2 vel; /**< Velocity of the group. */
+   double age; /**< Time since the group was emitted. */
+   double ttl; /**< Age the last particle dies at. */
+   int layer; /**< Layer of the particles. */
+   SPFX_GroupParticle *p; /**< Particles of the group. */
+   int n; /**< Number of particles. */
+} SPFX_Group;
+static SPFX_Group *spfx_groups = NULL; /**< Active particle groups (array.h). */
+static int spfx_group_budget = SPFX_GROUP_BUDGET; /**< Particles groups may still emit this frame. */
+static vec2 spfx_group_dirs[SPFX_GROUP_DIRS]; /**< Unit vectors to scatter particles along. */
+static int spfx_group_ndirs = 0; /**< Whether or not spfx_group_dirs is set up. */
 
 /*
  * prototypes
@@ -144,6 +222,11 @@ static int spfx_base_cmp( const void *p1, const void *p2 );
 static int spfx_base_parse( SPFX_Base *temp, const char *filename );
 static void spfx_base_free( SPFX_Base *effect );
 static void spfx_update_layer( SPFX *layer, const double dt );
+static void spfx_ringGrow( SPFX_Ring *ring );
+static void spfx_ringEmit( SPFX_Ring *ring, double px, double py, double vx, double vy, double ttl );
+static void spfx_renderParticles( int layer );
+static void spfx_update_groups( double dt );
+static void spfx_renderGroups( int layer );
 /* Haptic. */
 static int spfx_hapticInit (void);
 static void spfx_hapticRumble( double mod );
@@ -151,6 +234,8 @@ static void spfx_hapticRumble( double mod );
 static void spfx_update_trails( double dt );
 static void spfx_trail_update( Trail_spfx* trail, double dt );
 static void spfx_trail_free( Trail_spfx* trail );
+static void spfx_trail_batch( const Trail_spfx* trail );
+static void spfx_trail_flush (void);
 
 /**
  * @brief For sorting and stuff.
@@ -231,11 +316,12 @@ static int spfx_base_parse( SPFX_Base *temp, const char *filename )
 
    /* Has shaders. */
    if (shadervert != NULL && shaderfrag != NULL) {
-      temp->shader      = gl_program_vert_frag( shadervert, shaderfrag, NULL );
-      temp->vertex      = glGetAttribLocation( temp->shader, "vertex");
-      temp->projection  = glGetUniformLocation( temp->shader, "projection");
-      temp->u_r         = glGetUniformLocation( temp->shader, "u_r" );
-      temp->u_time      = glGetUniformLocation( temp->shader, "u_time" );
+      temp->shader      = gl_program_vert_frag_defines( shadervert, shaderfrag,
+            SPFX_PARTICLE_GEOM, SPFX_PARTICLE_DEFINES );
+      temp->particle    = glGetAttribLocation( temp->shader, "particle" );
+      temp->particle_time = glGetAttribLocation( temp->shader, "particle_time" );
+      temp->projection  = glGetUniformLocation( temp->shader, "projection" );
+      temp->u_now       = glGetUniformLocation( temp->shader, "u_now" );
       temp->u_size      = glGetUniformLocation( temp->shader, "u_size" );
       if (uniforms != NULL) {
          glUseProgram( temp->shader );
@@ -331,6 +417,10 @@ static void spfx_base_free( SPFX_Base *effect )
 {
    free(effect->name);
    gl_freeTexture(effect->gfx);
+   for (int i=0; i<SPFX_LAYERS; i++) {
+      free(effect->ring[i].data);
+      gl_vboDestroy(effect->ring[i].vbo);
+   }
 }
 
 /**
@@ -438,6 +528,10 @@ void spfx_free (void)
    spfx_stack_middle = NULL;
    array_free(spfx_stack_back);
    spfx_stack_back = NULL;
+   for (int i=0; i<array_size(spfx_groups); i++)
+      free( spfx_groups[i].p );
+   array_free(spfx_groups);
+   spfx_groups = NULL;
 
    /* now clear the effects */
    for (int i=0; i<array_size(spfx_effects); i++)
@@ -453,6 +547,13 @@ void spfx_free (void)
       spfx_trail_free( trail_spfx_stack[i] );
    array_free( trail_spfx_stack );
    trail_spfx_stack = NULL;
+   mempool_destroy( &trail_spfx_pool );
+   for (int i=0; i<array_size(trail_batches); i++)
+      array_free( trail_batches[i].data );
+   array_free( trail_batches );
+   trail_batches = NULL;
+   gl_vboDestroy( trail_vbo );
+   trail_vbo = NULL;
 
    /* Free the trail styles. */
    for (int i=0; i<array_size(trail_spec_stack); i++) {
@@ -482,13 +583,31 @@ void spfx_add( int effect,
       int layer )
 {
    SPFX *cur_spfx;
-   double ttl, anim;
+   double ttl, anim, timer;
 
    if ((effect < 0) || (effect > array_size(spfx_effects))) {
       WARN(_("Trying to add spfx with invalid effect!"));
       return;
    }
 
+   /* Timer magic if ttl != anim */
+   ttl = spfx_effects[effect].ttl;
+   anim = spfx_effects[effect].anim;
+   if (ttl != anim)
+      timer = ttl + RNGF()*anim;
+   else
+      timer = ttl;
+
+   /* Shader effects only get emitted, the GPU does the rest. */
+   if (spfx_effects[effect].shader >= 0) {
+      if ((layer < 0) || (layer >= SPFX_LAYERS)) {
+         WARN(_("Invalid SPFX layer."));
+         return;
+      }
+      spfx_ringEmit( &spfx_effects[effect].ring[layer], px, py, vx, vy, timer );
+      return;
+   }
+
    /*
     * Select the Layer
     */
@@ -507,17 +626,196 @@ void spfx_add( int effect,
    cur_spfx->effect = effect;
    vec2_csetmin( &cur_spfx->pos, px, py );
    vec2_csetmin( &cur_spfx->vel, vx, vy );
-   /* Timer magic if ttl != anim */
-   ttl = spfx_effects[effect].ttl;
-   anim = spfx_effects[effect].anim;
-   if (ttl != anim)
-      cur_spfx->timer = ttl + RNGF()*anim;
-   else
-      cur_spfx->timer = ttl;
+   cur_spfx->timer = timer;
+}
+
+/**
+ * @brief Creates a group of sprite particles scattered around a point.
+ *
+ * This is much cheaper than adding the particles with spfx_add one by one,
+ *  both when emitting and updating them, and their sprites get batched when
+ *  rendering. The particles emitted by all the groups in a frame are capped,
+ *  so emitting many groups at once doesn't stall the frame.
+ *
+ *    @param effects Effects to pick the particles from at random.
+ *    @param neffects Number of effects.
+ *    @param n Number of particles to emit.
+ *    @param px X position of the group.
+ *    @param py Y position of the group.
+ *    @param vx X velocity of the group.
+ *    @param vy Y velocity of the group.
+ *    @param r Spread of the positions of the particles.
+ *    @param speed Spread of the velocities of the particles.
+ *    @param layer Layer to put the particles on.
+ *    @return Number of particles actually emitted.
+ */
+int spfx_addGroup( const int *effects, int neffects, int n,
+      double px, double py, double vx, double vy,
+      double r, double speed, int layer )
+{
+   SPFX_Group *g;
 
-   /* Shader magic. */
-   cur_spfx->unique = RNGF();
-   cur_spfx->time = 0.0;
+   if ((layer < 0) || (layer >= SPFX_LAYERS)) {
+      WARN(_("Invalid SPFX layer."));
+      return 0;
+   }
+   n = MIN( n, spfx_group_budget );
+   if ((n <= 0) || (neffects <= 0))
+      return 0;
+   spfx_group_budget -= n;
+
+   /* Directions get looked up instead of doing trigonometry per particle. */
+   if (!spfx_group_ndirs) {
+      for (int i=0; i<SPFX_GROUP_DIRS; i++)
+         vec2_pset( &spfx_group_dirs[i], 1., 2.*M_PI*(double)i/SPFX_GROUP_DIRS );
+      spfx_group_ndirs = 1;
+   }
+
+   if (spfx_groups == NULL)
+      spfx_groups = array_create( SPFX_Group );
+   g = &array_grow( &spfx_groups );
+   vec2_cset( &g->pos, px, py );
+   vec2_cset( &g->vel, vx, vy );
+   g->age   = 0.;
+   g->ttl   = 0.;
+   g->layer = layer;
+   g->n     = n;
+   g->p     = malloc( n * sizeof(SPFX_GroupParticle) );
+   for (int i=0; i<n; i++) {
+      SPFX_GroupParticle *p = &g->p[i];
+      const SPFX_Base *effect;
+      const vec2 *dp, *dv;
+      double d;
+
+      p->effect = effects[ RNG( 0, neffects-1 ) ];
+      effect = &spfx_effects[ p->effect ];
+      p->ttl = (effect->ttl != effect->anim) ? effect->ttl + RNGF()*effect->anim : effect->ttl;
+      p->lastframe = 0;
+      g->ttl = MAX( g->ttl, p->ttl );
+
+      /* Sum of uniforms approximates the truncated normal of RNG_2SIGMA. */
+      dp = &spfx_group_dirs[ RNG( 0, SPFX_GROUP_DIRS-1 ) ];
+      d  = r/2. * (RNGF()+RNGF()+RNGF()-1.5) * (4./3.);
+      p->x = d * dp->x;
+      p->y = d * dp->y;
+      dv = &spfx_group_dirs[ RNG( 0, SPFX_GROUP_DIRS-1 ) ];
+      d  = speed * (RNGF()+RNGF()+RNGF()-1.5) * (4./3.);
+      p->vx = d * dv->x;
+      p->vy = d * dv->y;
+   }
+   return n;
+}
+
+/**
+ * @brief Ages the particle groups, removing the ones that are done.
+ */
+static void spfx_update_groups( double dt )
+{
+   spfx_group_budget = SPFX_GROUP_BUDGET;
+   for (int i=array_size(spfx_groups)-1; i>=0; i--) {
+      SPFX_Group *g = &spfx_groups[i];
+      g->age += dt;
+      if (g->age >= g->ttl) {
+         free( g->p );
+         array_erase( &spfx_groups, g, g+1 );
+      }
+   }
+}
+
+/**
+ * @brief Renders the particle groups of a layer.
+ */
+static void spfx_renderGroups( int layer )
+{
+   gl_batchBegin();
+   for (int i=0; i<array_size(spfx_groups); i++) {
+      SPFX_Group *g = &spfx_groups[i];
+      double gx, gy;
+      if (g->layer != layer)
+         continue;
+      gx = g->pos.x + g->vel.x * g->age;
+      gy = g->pos.y + g->vel.y * g->age;
+      for (int j=0; j<g->n; j++) {
+         SPFX_GroupParticle *p = &g->p[j];
+         const SPFX_Base *effect;
+         int sx, sy;
+         double timer = p->ttl - g->age;
+         if (timer <= 0.)
+            continue;
+         effect = &spfx_effects[ p->effect ];
+         sx = (int)effect->gfx->sx;
+         sy = (int)effect->gfx->sy;
+         if (!paused) { /* don't calculate frame if paused */
+            double time = 1. - fmod(timer,effect->anim) / effect->anim;
+            p->lastframe = sx * sy * MIN(time, 1.);
+         }
+         gl_renderSprite( effect->gfx,
+               gx + p->x + p->vx * g->age, gy + p->y + p->vy * g->age,
+               p->lastframe % sx, p->lastframe / sx, NULL );
+      }
+   }
+   gl_batchEnd();
+}
+
+/**
+ * @brief Makes room in a particle ring.
+ *
+ * The particles from the head onwards are the oldest, so they get moved to
+ *  the end and the new free slots start at the head.
+ *
+ *    @param ring Ring to grow.
+ */
+static void spfx_ringGrow( SPFX_Ring *ring )
+{
+   int size = MAX( SPFX_RING_SIZE, 2*ring->size );
+   int n = ring->size - ring->head;
+   ring->data = realloc( ring->data, size * SPFX_PARTICLE_LEN * sizeof(GLfloat) );
+   memmove( &ring->data[ (size-n)*SPFX_PARTICLE_LEN ], &ring->data[ ring->head*SPFX_PARTICLE_LEN ],
+         n * SPFX_PARTICLE_LEN * sizeof(GLfloat) );
+   memset( &ring->data[ ring->head*SPFX_PARTICLE_LEN ], 0,
+         (size-ring->size) * SPFX_PARTICLE_LEN * sizeof(GLfloat) );
+   ring->size = size;
+}
+
+/**
+ * @brief Emits a particle into a ring.
+ *
+ *    @param ring Ring to emit into.
+ *    @param px X position of the particle.
+ *    @param py Y position of the particle.
+ *    @param vx X velocity of the particle.
+ *    @param vy Y velocity of the particle.
+ *    @param ttl Time the particle lives.
+ */
+static void spfx_ringEmit( SPFX_Ring *ring, double px, double py, double vx, double vy, double ttl )
+{
+   GLfloat *p;
+   double now;
+
+   /* Empty rings start over so the relative times stay small. */
+   if (spfx_time >= ring->last) {
+      ring->epoch = spfx_time;
+      ring->head  = 0;
+      if (ring->data != NULL)
+         memset( ring->data, 0, ring->size * SPFX_PARTICLE_LEN * sizeof(GLfloat) );
+   }
+   now = spfx_time - ring->epoch;
+
+   /* Never overwrite a particle that is still alive. */
+   if ((ring->size == 0) || (ring->data[ ring->head*SPFX_PARTICLE_LEN+5 ] > now))
+      spfx_ringGrow( ring );
+
+   p = &ring->data[ ring->head*SPFX_PARTICLE_LEN ];
+   p[0] = px;
+   p[1] = py;
+   p[2] = vx;
+   p[3] = vy;
+   p[4] = now;
+   p[5] = now + ttl;
+   p[6] = RNGF();
+   ring->head  = (ring->head+1) % ring->size;
+   ring->last  = MAX( ring->last, spfx_time + ttl );
+   ring->dirty = 1;
 }
 
 /**
@@ -560,10 +858,13 @@ void spfx_update( const double dt, const double real_dt )
    NTracingZone( _ctx, 1 );
    NTracingPlotI( "spfx", array_size(spfx_stack_front)+array_size(spfx_stack_middle)+array_size(spfx_stack_back) );
    NTracingPlotI( "trails", array_size(trail_spfx_stack) );
+   NTracingPlotI( "spfx_groups", array_size(spfx_groups) );
 
    spfx_update_layer( spfx_stack_front, dt );
    spfx_update_layer( spfx_stack_middle, dt );
    spfx_update_layer( spfx_stack_back, dt );
+   spfx_update_groups( dt );
+   spfx_time += dt;
    spfx_update_trails( dt );
 
    /* Decrement the haptic timer. */
@@ -599,8 +900,6 @@ static void spfx_update_layer( SPFX *layer, const double dt )
          i--;
          continue;
       }
-      layer[i].time  += dt; /* Shader timer. */
-
       /* actually update it */
       vec2_cadd( &layer[i].pos, dt*VX(layer[i].vel), dt*VY(layer[i].vel) );
    }
@@ -702,7 +1001,8 @@ static void spfx_updateDamage( double dt )
  */
 Trail_spfx* spfx_trail_create( const TrailSpec* spec )
 {
-   Trail_spfx *trail = calloc( 1, sizeof(Trail_spfx) );
+   Trail_spfx *trail = mempool_alloc( &trail_spfx_pool );
+   memset( trail, 0, sizeof(Trail_spfx) );
    trail->spec       = spec;
    trail->capacity   = 1;
    trail->iread      = trail->iwrite = 0;
@@ -784,8 +1084,31 @@ void spfx_trail_sample( Trail_spfx* trail, double x, double y, TrailMode mode, i
    trail_back( trail ) = p;
 
    /* We may need to insert a control point, but not if our last sample was recent enough. */
-   if (!force && trail_size(trail) > 1 && trail_at( trail, trail->iwrite-2 ).t >= 1.-TRAIL_UPDATE_DT)
-      return;
+   if (!force && trail_size(trail) > 1) {
+      const TrailPoint *b = &trail_at( trail, trail->iwrite-2 );
+      double z, d2;
+      if (b->t >= 1.-TRAIL_UPDATE_DT)
+         return;
+
+      /* Keep the control points that have a different mode. */
+      if (b->mode == mode) {
+         z  = cam_getZoom();
+         d2 = pow2(x-b->x) + pow2(y-b->y);
+         /* Barely moved, merge with the previous control point. */
+         if (d2*pow2(z) < pow2(TRAIL_MERGE_DIST))
+            return;
+         /* Going straight, the previous control point can be stretched for a while. */
+         if ((trail_size(trail) > 2) && (b->t >= 1.-TRAIL_UPDATE_DT_MAX)) {
+            const TrailPoint *a = &trail_at( trail, trail->iwrite-3 );
+            double ux = x - a->x;
+            double uy = y - a->y;
+            double cross = ux*(b->y - a->y) - uy*(b->x - a->x);
+            /* Distance of b to the line going from a to the new point. */
+            if ((a->mode == mode) && (pow2(cross)*pow2(z) < pow2(TRAIL_STRAIGHT_DIST) * (pow2(ux)+pow2(uy))))
+               return;
+         }
+      }
+   }
 
    /* If the last time we inserted a control point was recent enough, we don't need a new one. */
    if (trail_size(trail) == trail->capacity) {
@@ -817,15 +1140,56 @@ static void spfx_trail_free( Trail_spfx* trail )
 {
    assert(trail->refcount == 0);
    free(trail->point_ringbuf);
-   free(trail);
+   mempool_free( &trail_spfx_pool, trail );
+}
+
+/**
+ * @brief Starts a new visibility frame for the trails.
+ *
+ * Trails drawn on top of their owner are drawn by the owner, unless the owner
+ *  got culled and did not call spfx_trail_show this frame. Those get drawn
+ *  with the rest of the trails instead so they don't pop in.
+ */
+void spfx_trail_cull (void)
+{
+   trail_frame++;
+}
+
+/**
+ * @brief Marks a trail as belonging to an owner that is visible this frame.
+ *
+ *    @param trail Trail to mark.
+ */
+void spfx_trail_show( Trail_spfx* trail )
+{
+   trail->frame = trail_frame;
 }
 
 /**
  * @brief Draws a trail on screen.
+ *
+ * The whole trail goes out in a single draw call, use spfx_trail_batch to
+ *  share it with other trails.
  */
 void spfx_trail_draw( const Trail_spfx* trail )
 {
+   spfx_trail_batch( trail );
+   spfx_trail_flush();
+}
+
+/**
+ * @brief Adds the segments of a trail to the pending trail batches.
+ *
+ * Everything that used to be a per segment uniform is a vertex attribute, so
+ *  trails of the same type can be drawn together by spfx_trail_flush.
+ */
+static void spfx_trail_batch( const Trail_spfx* trail )
+{
+   static const GLfloat corners[6][2] = {
+      {0., 0.}, {1., 0.}, {0., 1.},
+      {1., 0.}, {1., 1.}, {0., 1.} };
    const TrailStyle *styles;
+   TrailBatch *batch;
    size_t n;
    GLfloat len;
    double z;
@@ -835,21 +1199,29 @@ void spfx_trail_draw( const Trail_spfx* trail )
       return;
    styles = trail->spec->style;
 
-   /* Stuff that doesn't change for the entire trail. */
-   glUseProgram( shaders.trail.program );
-   if (gl_has( OPENGL_SUBROUTINES ))
-      glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &trail->spec->type );
-   glEnableVertexAttribArray( shaders.trail.vertex );
-   gl_vboActivateAttribOffset( gl_squareVBO, shaders.trail.vertex, 0, 2, GL_FLOAT, 0 );
-   glUniform1f( shaders.trail.dt, trail->dt );
-   glUniform1f( shaders.trail.r, trail->r );
+   /* Find the batch of the trail type, there are only a handful. */
+   batch = NULL;
+   for (int i=0; i<array_size(trail_batches); i++) {
+      if (trail_batches[i].type == trail->spec->type) {
+         batch = &trail_batches[i];
+         break;
+      }
+   }
+   if (batch == NULL) {
+      if (trail_batches == NULL)
+         trail_batches = array_create( TrailBatch );
+      batch = &array_grow( &trail_batches );
+      batch->type = trail->spec->type;
+      batch->data = array_create( GLfloat );
+   }
 
    z   = cam_getZoom();
    len = 0.;
    for (size_t i=trail->iread + 1; i < trail->iwrite; i++) {
-      mat4 projection;
       const TrailStyle *sp, *spp;
-      double x1, y1, x2, y2, s;
+      double x1, y1, x2, y2, s, c, sn, w;
+      GLfloat *v;
+      int nv;
       TrailPoint *tp  = &trail_at( trail, i );
       TrailPoint *tpp = &trail_at( trail, i-1 );
 
@@ -874,29 +1246,106 @@ void spfx_trail_draw( const Trail_spfx* trail )
       sp  = &styles[tp->mode];
       spp = &styles[tpp->mode];
 
-      /* Set vertex. */
-      projection = gl_view_matrix;
-      mat4_translate_xy( &projection, x1, y1 );
-      mat4_rotate2dv( &projection, (x2-x1)/s, (y2-y1)/s );
-      mat4_scale_xy( &projection, s, z*(sp->thick+spp->thick) );
-      mat4_translate_xy( &projection, 0., -0.5 );
-
-      /* Set uniforms. */
-      gl_uniformMat4(shaders.trail.projection, &projection);
-      gl_uniformColour(shaders.trail.c1, &sp->col);
-      gl_uniformColour(shaders.trail.c2, &spp->col);
-      glUniform1f(shaders.trail.t1, tp->t);
-      glUniform1f(shaders.trail.t2, tpp->t);
-      glUniform2f(shaders.trail.pos2, len, sp->thick);
+      /* Segment goes from x1 to x2 with the thickness of both ends. */
+      c  = (x2-x1)/s;
+      sn = (y2-y1)/s;
+      w  = z*(sp->thick+spp->thick);
+      nv = array_size( batch->data );
+      array_resize( &batch->data, nv + 6*TRAIL_BATCH_STRIDE );
+      v  = &batch->data[nv];
+      for (int k=0; k<6; k++) {
+         double cx = corners[k][0];
+         double cy = corners[k][1];
+         double lx = cx*s;
+         double ly = (cy-0.5)*w;
+         const glColour *col = (cx > 0.) ? &spp->col : &sp->col;
+         v[0]  = x1 + c*lx - sn*ly;
+         v[1]  = y1 + sn*lx + c*ly;
+         v[2]  = cx;
+         v[3]  = cy;
+         v[4]  = col->r;
+         v[5]  = col->g;
+         v[6]  = col->b;
+         v[7]  = col->a;
+         v[8]  = (cx > 0.) ? len : len+s;
+         v[9]  = spp->thick;
+         v[10] = sp->thick;
+         v[11] = (cx > 0.) ? tpp->t : tp->t;
+         v[12] = trail->dt;
+         v[13] = trail->r;
+         v += TRAIL_BATCH_STRIDE;
+      }
       len += s;
-      glUniform2f(shaders.trail.pos1, len, spp->thick);
+   }
+}
 
-      /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+/**
+ * @brief Draws all the pending trail batches.
+ *
+ * All the batches get uploaded together, and then take one draw call per
+ *  trail type as the type is a shader subroutine.
+ */
+static void spfx_trail_flush (void)
+{
+   const GLsizei stride = sizeof(GLfloat) * TRAIL_BATCH_STRIDE;
+   GLsizei size, offset;
+   GLint first;
+   char *buf;
+
+   /* Upload everything at once. */
+   size = 0;
+   for (int i=0; i<array_size(trail_batches); i++)
+      size += sizeof(GLfloat) * array_size(trail_batches[i].data);
+   if (size <= 0)
+      return;
+   if (trail_vbo == NULL)
+      trail_vbo = gl_vboCreateRing( size );
+   buf = gl_vboRingMap( trail_vbo, size );
+   offset = 0;
+   for (int i=0; (buf != NULL) && (i<array_size(trail_batches)); i++) {
+      GLsizei bsize = sizeof(GLfloat) * array_size(trail_batches[i].data);
+      if (bsize <= 0)
+         continue;
+      memcpy( &buf[offset], trail_batches[i].data, bsize );
+      offset += bsize;
+   }
+   gl_vboUnmap( trail_vbo );
+
+   /* Stuff that doesn't change for any of the trails. */
+   glUseProgram( shaders.trail.program );
+   gl_uniformMat4( shaders.trail.projection, &gl_view_matrix );
+   glEnableVertexAttribArray( shaders.trail.vertex );
+   glEnableVertexAttribArray( shaders.trail.vertex_colour );
+   glEnableVertexAttribArray( shaders.trail.vertex_px );
+   glEnableVertexAttribArray( shaders.trail.vertex_trail );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex,
+         0, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_colour,
+         sizeof(GLfloat) * 4, 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_px,
+         sizeof(GLfloat) * 8, 3, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_trail,
+         sizeof(GLfloat) * 11, 3, GL_FLOAT, stride );
+
+   /* Draw each type. */
+   first = 0;
+   for (int i=0; i<array_size(trail_batches); i++) {
+      TrailBatch *batch = &trail_batches[i];
+      GLint count = array_size(batch->data) / TRAIL_BATCH_STRIDE;
+      if (count <= 0)
+         continue;
+      if (gl_has( OPENGL_SUBROUTINES ))
+         glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &batch->type );
+      gl_drawArrays( GL_TRIANGLES, first, count );
+      first += count;
+      array_resize( &batch->data, 0 );
    }
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.trail.vertex );
+   glDisableVertexAttribArray( shaders.trail.vertex_colour );
+   glDisableVertexAttribArray( shaders.trail.vertex_px );
+   glDisableVertexAttribArray( shaders.trail.vertex_trail );
    glUseProgram(0);
 
    /* Check errors. */
@@ -1024,77 +1473,101 @@ void spfx_cinematic (void)
    gl_renderRect( 0., SCREEN_H*0.8, SCREEN_W, SCREEN_H,     &cBlack );
 }
 
-static void spfx_renderStack( SPFX *spfx_stack )
+/**
+ * @brief Renders the particles of the shader effects on a layer.
+ *
+ * Each effect draws its whole ring with a single call, particles that are
+ *  dead get dropped by the geometry shader.
+ *
+ *    @param layer Layer to render.
+ */
+static void spfx_renderParticles( int layer )
 {
-   for (int i=array_size(spfx_stack)-1; i>=0; i--) {
-      SPFX *spfx        = &spfx_stack[i];
-      SPFX_Base *effect = &spfx_effects[ spfx->effect ];
-
-      /* Render shader. */
-      if (effect->shader >= 0) {
-         double x, y, z, s2;
-         double w, h;
-         mat4 projection;
-
-         /* Translate coords. */
-         s2 = effect->size/2.;
-         z = cam_getZoom();
-         gl_gameToScreenCoords( &x, &y, spfx->pos.x-s2, spfx->pos.y-s2 );
-         w = h = effect->size*z;
+   double cx, cy, gx, gy, z;
+   mat4 projection;
+   int init = 0;
 
-         /* Check if inbounds. */
-         if ((x < -w) || (x > SCREEN_W+w) ||
-               (y < -h) || (y > SCREEN_H+h))
-            continue;
+   for (int i=0; i<array_size(spfx_effects); i++) {
+      SPFX_Base *effect = &spfx_effects[i];
+      SPFX_Ring *ring;
 
-         /* Let's get to business. */
-         glUseProgram( effect->shader );
+      if (effect->shader < 0)
+         continue;
+      ring = &effect->ring[layer];
+      if (spfx_time >= ring->last)
+         continue;
 
-         /* Set up the vertex. */
+      /* Game coordinates to screen. */
+      if (!init) {
+         cam_getPos( &cx, &cy );
+         z = cam_getZoom();
+         gui_getOffset( &gx, &gy );
          projection = gl_view_matrix;
-         mat4_translate_scale_xy( &projection, x, y, w, h );
-         glEnableVertexAttribArray( effect->vertex );
-         gl_vboActivateAttribOffset( gl_squareVBO, effect->vertex,
-               0, 2, GL_FLOAT, 0 );
+         mat4_translate_scale_xy( &projection, gx+SCREEN_W*0.5-cx*z, gy+SCREEN_H*0.5-cy*z, z, z );
+         init = 1;
+      }
 
-         /* Set shader uniforms. */
-         gl_uniformMat4(effect->projection, &projection);
-         glUniform1f(effect->u_time, spfx->time);
-         glUniform1f(effect->u_r, spfx->unique);
-         glUniform1f(effect->u_size, effect->size);
+      /* Upload the new emissions. */
+      if (ring->vbo_size != ring->size) {
+         gl_vboDestroy( ring->vbo );
+         ring->vbo = gl_vboCreateStream( ring->size * SPFX_PARTICLE_LEN * sizeof(GLfloat), ring->data );
+         ring->vbo_size = ring->size;
+         ring->dirty = 0;
+      }
+      else if (ring->dirty) {
+         gl_vboSubData( ring->vbo, 0, ring->size * SPFX_PARTICLE_LEN * sizeof(GLfloat), ring->data );
+         ring->dirty = 0;
+      }
 
-         /* Draw. */
-         glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      glUseProgram( effect->shader );
+      glEnableVertexAttribArray( effect->particle );
+      glEnableVertexAttribArray( effect->particle_time );
+      gl_vboActivateAttribOffset( ring->vbo, effect->particle,
+            0, 4, GL_FLOAT, SPFX_PARTICLE_LEN * sizeof(GLfloat) );
+      gl_vboActivateAttribOffset( ring->vbo, effect->particle_time,
+            4 * sizeof(GLfloat), 3, GL_FLOAT, SPFX_PARTICLE_LEN * sizeof(GLfloat) );
 
-         /* Clear state. */
-         glDisableVertexAttribArray( shaders.texture.vertex );
+      /* Set shader uniforms. */
+      gl_uniformMat4( effect->projection, &projection );
+      glUniform1f( effect->u_now, spfx_time - ring->epoch );
+      glUniform1f( effect->u_size, effect->size );
 
-         /* anything failed? */
-         gl_checkErr();
+      /* Draw. */
+      gl_drawArrays( GL_POINTS, 0, ring->size );
 
-         glUseProgram(0);
+      /* Clear state. */
+      glDisableVertexAttribArray( effect->particle );
+      glDisableVertexAttribArray( effect->particle_time );
+   }
 
-      }
-      /* No shader. */
-      else {
-         int sx, sy;
+   if (init) {
+      glUseProgram( 0 );
+      gl_checkErr();
+   }
+}
 
-         /* Simplifies */
-         sx = (int)effect->gfx->sx;
-         sy = (int)effect->gfx->sy;
+static void spfx_renderStack( SPFX *spfx_stack )
+{
+   for (int i=array_size(spfx_stack)-1; i>=0; i--) {
+      SPFX *spfx        = &spfx_stack[i];
+      SPFX_Base *effect = &spfx_effects[ spfx->effect ];
+      int sx, sy;
 
-         if (!paused) { /* don't calculate frame if paused */
-            double time = 1. - fmod(spfx_stack[i].timer,effect->anim) / effect->anim;
-            spfx_stack[i].lastframe = sx * sy * MIN(time, 1.);
-         }
+      /* Simplifies */
+      sx = (int)effect->gfx->sx;
+      sy = (int)effect->gfx->sy;
 
-         /* Renders */
-         gl_renderSprite( effect->gfx,
-               VX(spfx_stack[i].pos), VY(spfx_stack[i].pos),
-               spfx_stack[i].lastframe % sx,
-               spfx_stack[i].lastframe / sx,
-               NULL );
+      if (!paused) { /* don't calculate frame if paused */
+         double time = 1. - fmod(spfx->timer,effect->anim) / effect->anim;
+         spfx->lastframe = sx * sy * MIN(time, 1.);
       }
+
+      /* Renders */
+      gl_renderSprite( effect->gfx,
+            VX(spfx->pos), VY(spfx->pos),
+            spfx->lastframe % sx,
+            spfx->lastframe / sx,
+            NULL );
    }
 }
 
@@ -1111,26 +1584,33 @@ void spfx_render( int layer, double dt )
    /* get the appropriate layer */
    switch (layer) {
       case SPFX_LAYER_FRONT:
+         spfx_renderParticles( layer );
          spfx_renderStack( spfx_stack_front );
+         spfx_renderGroups( layer );
          spfxL_renderfg( dt );
          break;
 
       case SPFX_LAYER_MIDDLE:
+         spfx_renderParticles( layer );
          spfx_renderStack( spfx_stack_middle );
+         spfx_renderGroups( layer );
          spfxL_rendermg( dt );
          break;
 
       case SPFX_LAYER_BACK:
+         spfx_renderParticles( layer );
          spfx_renderStack( spfx_stack_back );
+         spfx_renderGroups( layer );
          spfxL_renderbg( dt );
 
          NTracingZoneName( _ctx_trails, "spfx_render[trails]", 1 );
          /* Trails are special (for now?). */
          for (int i=0; i<array_size(trail_spfx_stack); i++) {
             const Trail_spfx *trail = trail_spfx_stack[i];
-            if (!trail->ontop)
-               spfx_trail_draw( trail );
+            if (!trail->ontop || (trail->frame != trail_frame))
+               spfx_trail_batch( trail );
          }
+         spfx_trail_flush();
          NTracingZoneEnd( _ctx_trails );
          break;
 
@@ -71,6 +71,7 @@ typedef struct Trail_spfx_ {
    double dt;        /**< Timer accumulator (in seconds). */
    GLfloat r;        /**< Random variable between 0 and 1 to make each trail unique. */
    unsigned int ontop; /**< Boolean to decide if the trail is drawn before or after the ship. */
+   unsigned int frame; /**< Last visibility frame the owner was seen in, see spfx_trail_show. */
 } Trail_spfx;
 
 /** @brief Indexes into a trail's circular buffer.  */
@@ -91,6 +92,9 @@ void spfx_add( int effect,
       const double px, const double py,
       const double vx, const double vy,
       int layer );
+int spfx_addGroup( const int *effects, int neffects, int n,
+      double px, double py, double vx, double vy,
+      double r, double speed, int layer );
 
 /*
  * stack mass manipulation functions
@@ -102,6 +106,8 @@ Trail_spfx* spfx_trail_create( const TrailSpec* spec );
 void spfx_trail_sample( Trail_spfx* trail, double x, double y, TrailMode mode, int force );
 void spfx_trail_remove( Trail_spfx* trail );
 void spfx_trail_draw( const Trail_spfx* trail );
+void spfx_trail_cull (void);
+void spfx_trail_show( Trail_spfx* trail );
 
 /*
  * Misc effects.
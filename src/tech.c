@@ -8,6 +8,8 @@
  *        shipyard and commodity exchange.
  */
 /** @cond */
+#include <stdatomic.h>
+
 #include "naev.h"
 /** @endcond */
 
@@ -51,6 +53,15 @@ typedef struct tech_item_s {
    } u;                    /**< Data union. */
 } tech_item_t;
 
+/**
+ * @brief Flattened contents of a tech group and all the groups it includes.
+ */
+typedef struct tech_cache_s {
+   unsigned int gen;    /**< Generation the cache was built at, 0 if never. */
+   void **items[TECH_TYPE_GROUP]; /**< Array (array.h): Items of each type, sorted like the getters return them. */
+   uint32_t *outfits;   /**< Bitset of the outfits by index in outfit_getAll(). */
+} tech_cache_t;
+
 /**
  * @brief Group of tech items, basic unit of the tech trees.
  */
@@ -58,12 +69,14 @@ struct tech_group_s {
    char *name;          /**< Name of the tech group. */
    char *filename;      /**< Name of the file. */
    tech_item_t *items;  /**< Items in the tech group. */
+   tech_cache_t *cache; /**< Flattened contents, built on demand. */
 };
 
 /*
  * Group list.
  */
 static tech_group_t *tech_groups = NULL;
+static atomic_uint tech_gen = 1; /**< Changes whenever any group changes, invalidating the caches. Atomic as spobs create groups in parallel. */
 
 /*
  * Prototypes.
@@ -83,7 +96,9 @@ static int tech_getID( const char *name );
 static int tech_addItemGroupPointer( tech_group_t *grp, const tech_group_t *ptr );
 static int tech_addItemGroup( tech_group_t *grp, const char* name );
 /* Getting by tech. */
-static void** tech_addGroupItem( void **items, tech_item_type_t type, const tech_group_t *tech );
+static const tech_cache_t *tech_getCache( const tech_group_t *tech );
+static int tech_cmpPtr( const void *p1, const void *p2 );
+static void **tech_copyItems( void **items );
 
 
 static int tech_cmp( const void *p1, const void *p2 )
@@ -168,6 +183,12 @@ static void tech_freeGroup( tech_group_t *grp )
    free(grp->name);
    free(grp->filename);
    array_free( grp->items );
+   if (grp->cache != NULL) {
+      for (int i=0; i<TECH_TYPE_GROUP; i++)
+         array_free( grp->cache->items[i] );
+      free( grp->cache->outfits );
+      free( grp->cache );
+   }
 }
 
 /**
@@ -470,6 +491,7 @@ int tech_addItem( const char *name, const char *value )
       return -1;
    }
 
+   tech_gen++;
    return 0;
 }
 
@@ -490,6 +512,7 @@ int tech_addItemTech( tech_group_t *tech, const char *value )
       WARN(_("Generic item '%s' not found in tech group"), value );
       return -1;
    }
+   tech_gen++;
    return 0;
 }
 
@@ -504,6 +527,7 @@ int tech_rmItemTech( tech_group_t *tech, const char *value )
       const char *buf = tech_getItemName( &tech->items[i] );
       if (strcmp(buf, value)==0) {
          array_erase( &tech->items, &tech->items[i], &tech->items[i+1] );
+         tech_gen++;
          return 0;
       }
    }
@@ -536,6 +560,7 @@ int tech_rmItem( const char *name, const char *value )
       const char *buf = tech_getItemName( &tech->items[i] );
       if (strcmp(buf, value)==0) {
          array_erase( &tech->items, &tech->items[i], &tech->items[i+1] );
+         tech_gen++;
          return 0;
       }
    }
@@ -608,51 +633,101 @@ static void tech_createMetaGroup( tech_group_t *grp, tech_group_t **tech, int nu
 }
 
 /**
- * @brief Recursive function for creating an array of commodities from a tech group.
+ * @brief Compares two pointers, for sorting the items out of duplicates.
  */
-static void** tech_addGroupItem( void **items, tech_item_type_t type, const tech_group_t *tech )
+static int tech_cmpPtr( const void *p1, const void *p2 )
 {
-   /* Set up. */
-   int size  = array_size( tech->items );
+   uintptr_t a = (uintptr_t) *(void*const*)p1;
+   uintptr_t b = (uintptr_t) *(void*const*)p2;
+   return (a > b) - (a < b);
+}
 
-   /* Load commodities first, then we handle groups. */
-   for (int i=0; i<size; i++) {
-      int f;
-      tech_item_t *item = &tech->items[i];
+/**
+ * @brief Gets the flattened contents of a tech group, building them if needed.
+ *
+ * Groups are flattened from the caches of the groups they include, so that
+ *  shared subgroups are only walked once per change of any group.
+ */
+static const tech_cache_t *tech_getCache( const tech_group_t *tech )
+{
+   tech_cache_t *c = tech->cache;
+   int noutfits;
 
-      /* Only handle commodities for now. */
-      if (item->type != type)
-         continue;
+   if ((c != NULL) && (c->gen == tech_gen))
+      return c;
+   if (c == NULL) {
+      /* The cache is not part of what the group holds. */
+      c = calloc( 1, sizeof(tech_cache_t) );
+      ((tech_group_t*)tech)->cache = c;
+   }
 
-      /* Skip if already in list. */
-      f = 0;
-      for (int j=0; j<array_size(items); j++) {
-         if (items[j] == item->u.ptr) {
-            f = 1;
-            break;
-         }
-      }
-      if (f == 1)
-         continue;
+   for (int t=0; t<TECH_TYPE_GROUP; t++) {
+      void **items = c->items[t];
+      int n;
 
-      /* Add. */
       if (items == NULL)
          items = array_create( void* );
-      array_push_back( &items, item->u.ptr );
-   }
+      array_resize( &items, 0 );
+
+      /* Own items first, then those of the included groups. */
+      for (int i=0; i<array_size(tech->items); i++) {
+         const tech_item_t *item = &tech->items[i];
+         const tech_cache_t *sub;
+         if (item->type == (tech_item_type_t)t) {
+            array_push_back( &items, item->u.ptr );
+            continue;
+         }
+         if (item->type == TECH_TYPE_GROUP)
+            sub = tech_getCache( &tech_groups[ item->u.grp ] );
+         else if (item->type == TECH_TYPE_GROUP_POINTER)
+            sub = tech_getCache( item->u.grpptr );
+         else
+            continue;
+         for (int j=0; j<array_size(sub->items[t]); j++)
+            array_push_back( &items, sub->items[t][j] );
+      }
 
-   /* Now handle other groups. */
-   for (int i=0; i<size; i++) {
-      tech_item_t *item = &tech->items[i];
+      /* Remove duplicates. */
+      qsort( items, array_size(items), sizeof(void*), tech_cmpPtr );
+      n = 0;
+      for (int i=0; i<array_size(items); i++)
+         if ((n == 0) || (items[n-1] != items[i]))
+            items[n++] = items[i];
+      array_resize( &items, n );
+
+      /* Sort like the getters return them. */
+      if (t == TECH_TYPE_OUTFIT)
+         qsort( items, n, sizeof(void*), outfit_compareTech );
+      else if (t == TECH_TYPE_SHIP)
+         qsort( items, n, sizeof(void*), ship_compareTech );
+      else
+         qsort( items, n, sizeof(void*), commodity_compareTech );
+      c->items[t] = items;
+   }
 
-      /* Only handle commodities for now. */
-      if (item->type == TECH_TYPE_GROUP)
-         items  = tech_addGroupItem( items, type, &tech_groups[ item->u.grp ] );
-      else if (item->type == TECH_TYPE_GROUP_POINTER)
-         items  = tech_addGroupItem( items, type, item->u.grpptr );
+   /* Outfit membership. */
+   noutfits = array_size( outfit_getAll() );
+   free( c->outfits );
+   c->outfits = calloc( (noutfits+31)/32 + 1, sizeof(uint32_t) );
+   for (int i=0; i<array_size(c->items[TECH_TYPE_OUTFIT]); i++) {
+      const Outfit *o = c->items[TECH_TYPE_OUTFIT][i];
+      int id = o - outfit_getAll();
+      if ((id >= 0) && (id < noutfits))
+         c->outfits[id/32] |= 1u << (id%32);
    }
 
-   return items;
+   c->gen = tech_gen;
+   return c;
+}
+
+/**
+ * @brief Copies the cached items for the caller to own, NULL if there are none.
+ */
+static void **tech_copyItems( void **items )
+{
+   if (array_size(items) <= 0)
+      return NULL;
+   return array_copy( void*, items );
 }
 
 /**
@@ -739,11 +814,7 @@ Outfit** tech_getOutfit( const tech_group_t *tech )
    if (tech==NULL)
       return NULL;
 
-   o  = (Outfit**)tech_addGroupItem( NULL, TECH_TYPE_OUTFIT, tech );
-
-   /* Sort. */
-   if (o != NULL)
-      qsort( o, array_size(o), sizeof(Outfit*), outfit_compareTech );
+   o = (Outfit**) tech_copyItems( tech_getCache( tech )->items[TECH_TYPE_OUTFIT] );
 
    return o;
 }
@@ -787,12 +858,8 @@ Ship** tech_getShip( const tech_group_t *tech )
    if (tech==NULL)
       return NULL;
 
-   /* Get the outfits. */
-   s  = (Ship**) tech_addGroupItem( NULL, TECH_TYPE_SHIP, tech );
-
-   /* Sort. */
-   if (s != NULL)
-      qsort( s, array_size(s), sizeof(Ship*), ship_compareTech );
+   /* Get the ships. */
+   s = (Ship**) tech_copyItems( tech_getCache( tech )->items[TECH_TYPE_SHIP] );
 
    return s;
 }
@@ -861,11 +928,7 @@ Commodity** tech_getCommodity( const tech_group_t *tech )
       return NULL;
 
    /* Get the commodities. */
-   c  = (Commodity**) tech_addGroupItem( NULL, TECH_TYPE_COMMODITY, tech );
-
-   /* Sort. */
-   if (c != NULL)
-      qsort( c, array_size(c), sizeof(Commodity*), commodity_compareTech );
+   c = (Commodity**) tech_copyItems( tech_getCache( tech )->items[TECH_TYPE_COMMODITY] );
 
    return c;
 }
@@ -875,13 +938,15 @@ Commodity** tech_getCommodity( const tech_group_t *tech )
  */
 int tech_checkOutfit( const tech_group_t *tech, const Outfit *o )
 {
-   Outfit **to = tech_getOutfit( tech );
-   for (int i=0; i<array_size(to); i++) {
-      if (to[i]==o) {
-         array_free(to);
-         return 1;
-      }
-   }
-   array_free(to);
-   return 0;
+   const tech_cache_t *c;
+   int id;
+
+   if (tech==NULL)
+      return 0;
+
+   c  = tech_getCache( tech );
+   id = o - outfit_getAll();
+   if ((id < 0) || (id >= array_size( outfit_getAll() )))
+      return 0;
+   return !!(c->outfits[id/32] & (1u << (id%32)));
 }
@@ -2,34 +2,40 @@
  * See Licensing and Copyright notice in threadpool.h
  */
 /*
- * @brief A simple threadpool implementation using a single queue.
+ * @brief A work-stealing threadpool.
  *
- * The queue is inspired by this paper (look for the queue with two locks):
+ * Every thread of the pool owns a double-ended queue of jobs. Threads push
+ *  and pop jobs at the bottom of their own queue, and idle threads steal jobs
+ *  from the top of the queues of other threads. The queues are the lock-free
+ *  ones from:
  *
- * Maged M. Michael and Michael L. Scott. 1998. Nonblocking algorithms and
- * preemption-safe locking on multiprogrammed shared memory multiprocessors. J.
- * Parallel Distrib. Comput. 51, 1 (May 1998), 1-26. DOI=10.1006/jpdc.1998.1446
- * http://dx.doi.org/10.1006/jpdc.1998.1446
+ * Nhat Minh Lê, Antoniu Pop, Albert Cohen, and Francesco Zappa Nardelli. 2013.
+ * Correct and efficient work-stealing for weak memory models. SIGPLAN Not. 48,
+ * 8 (August 2013), 69-80. DOI=10.1145/2517327.2442524
+ * http://dx.doi.org/10.1145/2517327.2442524
  *
- * @ARTICLE{Michael98non-blockingalgorithms,
- *    author = {Maged M. Michael and Michael L. Scott},
- *    title = {Non-Blocking Algorithms and Preemption-Safe Locking on Multiprogrammed Shared Memory Multiprocessors},
- *    journal = {Journal of Parallel and Distributed Computing},
- *    year = {1998},
- *    volume = {51},
- *    pages = {1--26},
- * }
+ * Jobs are grouped with counters, which can be waited on or used as a
+ *  dependency of other jobs. Threads waiting on a counter run jobs instead of
+ *  blocking, so jobs can wait on other jobs without deadlocking. When there is
+ *  nothing to run they sleep until a job is pushed or a counter finishes.
  *
- * @note The algorithm/strategy for killing idle workers should be moved into
- *       the threadhandler and it should also be improved (the current strategy
- *       is probably not very good).
+ * Background jobs (disk writes and the like) go in a separate queue that only
+ *  the workers drain, so a thread waiting on a counter never ends up running an
+ *  unrelated slow job. The only background jobs a waiting thread runs are those
+ *  of the counter it is waiting on.
+ *
+ * The vpool interface is kept as a thin wrapper on top of the counters.
  */
 
 /** @cond */
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "SDL.h"
 #include "SDL_error.h"
 #include "SDL_thread.h"
+
+#include "naev.h"
 /** @endcond */
 
 #include "threadpool.h"
@@ -38,431 +44,361 @@
 #include "array.h"
 
 #define THREADPOOL_TIMEOUT (5 * 100) /* The time a worker thread waits in ms. */
-#define THREADSIG_STOP     (1) /* The signal to stop a worker thread */
-#define THREADSIG_RUN      (0) /* The signal to indicate the worker thread is running */
+#define JOB_DEQUE_SIZE     4096 /* Maximum amount of jobs queued per thread, must be power of two. */
+#define JOB_SPIN           64 /* Attempts to find a job before going to sleep. */
 
 /**
- * Threads to use.
+ * @brief A job to be run.
  */
-static int MAXTHREADS = 8; /* Bit overkill, but oh well. */
+typedef struct Job_ {
+   int (*function)(void *);   /**< The function to be called */
+   void *data;                /**< And its arguments */
+   JobCounter *counter;       /**< Counter to decrement when done, may be NULL. */
+   struct Job_ *next;         /**< Next job waiting on the same dependency or in the background queue. */
+} Job;
 
 /**
- * @brief Node in the thread queue.
+ * @brief Counter of pending jobs.
  */
-typedef struct Node_ {
-   void *data;          /**< The element in the list */
-   struct Node_ *next;  /**< The next node in the list */
-} Node;
+struct JobCounter_ {
+   atomic_int count;       /**< Number of jobs not finished yet. */
+   SDL_SpinLock lock;      /**< Protects the waiting list against the count reaching zero. */
+   Job *waiting;           /**< Jobs waiting for the count to reach zero. */
+};
 
-struct vpoolThreadData_;
+/**
+ * @brief Lock-free work-stealing deque of jobs.
+ *
+ * Only the owner thread can push and pop, any thread can steal.
+ */
+typedef struct JobDeque_ {
+   atomic_long top;        /**< Where jobs are stolen from. */
+   char pad[64];           /**< Keep top and bottom on separate cache lines. */
+   atomic_long bottom;     /**< Where the owner pushes and pops. */
+   Job *_Atomic buf[JOB_DEQUE_SIZE]; /**< Circular buffer of jobs. */
+} JobDeque;
 
 /**
- * @brief Threadqueue itself.
+ * @brief Job range for parallel for loops.
  */
-struct ThreadQueue_ {
-   Node *first;         /**< The first node */
-   Node *last;          /**< The second node */
-   Node *reserve;       /**< Reserve buffer. */
-   /* A semaphore to ensure reads only happen when the queue is not empty */
-   SDL_sem *semaphore;
-   SDL_mutex *t_lock;   /**< Tail lock. Lock when reading/updating tail */
-   SDL_mutex *h_lock;   /**< Same as tail lock, except it's head lock */
-   SDL_mutex *r_lock;   /**< For reserve buffer. */
-   /* For vpools. */
-   SDL_cond *cond;
-   SDL_mutex *mutex;
-   struct vpoolThreadData_ *arg;
-   int cnt;
-};
+typedef struct JobRange_ {
+   int (*function)(void *data, int start, int end); /**< Function to run. */
+   void *data;             /**< User data. */
+   int start;              /**< First element of the range. */
+   int end;                /**< One past the last element of the range. */
+} JobRange;
 
 /**
  * @brief Data for the threadqueue.
  */
 typedef struct ThreadQueueData_ {
-   int (*function)(void *);  /* The function to be called */
-   void *data;               /* And its arguments */
+   int (*function)(void *); /* The function to be called */
+   void *data;              /* And its arguments */
 } ThreadQueueData;
 
 /**
- * @brief Thread data.
+ * @brief Virtual thread pool, jobs are only started when waited on.
  */
-typedef struct ThreadData_ {
-   int (*function)(void *); /* The function to be called */
-   void *data;             /* Arguments to the above function */
-   int signal;             /* Signals to the thread */
-   SDL_sem *semaphore;     /* The semaphore to signal new jobs or new signal in the
-                              'signal' variable */
-   ThreadQueue *idle;      /* The queue with idle threads */
-   ThreadQueue *stopped;   /* The queue with stopped threads */
-} ThreadData;
-
-/**
- * @brief Virtual thread pool data.
- */
-struct vpoolThreadData_ {
-   SDL_cond *cond;         /**< Condition variable for signalling all jobs in the vpool
-                              are done */
-   SDL_mutex *mutex;       /**< The mutex to use with the above condition variable */
-   int *count;             /**< Variable to count number of finished jobs in the vpool */
-   ThreadQueueData node;   /**< The job to be done */
-   ThreadQueueData wrapper;/**< Wrapper to avoid malloc. */
+struct ThreadQueue_ {
+   JobCounter counter;     /**< Counter of the running jobs. */
+   ThreadQueueData *jobs;  /**< Jobs enqueued, array.h */
 };
-typedef struct vpoolThreadData_ vpoolThreadData;
 
-/* The global threadpool queue */
-static ThreadQueue *global_queue = NULL;
+/*
+ * The threadpool itself.
+ */
+static int job_nthreads       = 0;     /**< Threads running jobs, including the main thread. */
+static JobDeque *job_deques   = NULL;  /**< Deques of the threads, plus one for external threads. */
+static SDL_SpinLock job_extlock = 0;   /**< Lock to use the external deque. */
+static SDL_sem *job_wake      = NULL;  /**< Wakes up sleeping workers. */
+static atomic_int job_sleeping = 0;    /**< Number of sleeping workers. */
+static _Thread_local int job_thread = 0; /**< Deque of the thread plus one, 0 if not part of the pool. */
+static _Thread_local unsigned int job_rng = 0; /**< Thread state to pick victims to steal from. */
+static SDL_SpinLock job_bglock = 0;    /**< Lock for the background queue. */
+static Job *job_bghead        = NULL;  /**< First background job, only run by workers. */
+static Job *job_bgtail        = NULL;  /**< Last background job. */
+static SDL_mutex *job_waitlock = NULL; /**< Lock for threads blocked in job_wait. */
+static SDL_cond *job_waitcond = NULL;  /**< Wakes up threads blocked in job_wait. */
+static atomic_int job_waiters = 0;     /**< Number of threads that may be blocked in job_wait. */
+static atomic_uint job_pushed = 0;     /**< Incremented every time a job is pushed. */
 
 /*
  * Prototypes.
  */
-static ThreadQueue* tq_create (void);
-static void tq_enqueue( ThreadQueue *q, void *data );
-static void* tq_dequeue( ThreadQueue *q );
-static void tq_destroy( ThreadQueue *q );
-static int threadpool_worker( void *data );
-static int threadpool_handler( void *data );
-static int vpool_worker( void *data );
+static int jd_push( JobDeque *d, Job *job );
+static Job* jd_pop( JobDeque *d );
+static Job* jd_steal( JobDeque *d );
+static void job_push( Job *job );
+static Job* job_find (void);
+static Job* job_findBackground( const JobCounter *counter );
+static void job_wakeWaiters (void);
+static void job_execute( Job *job );
+static void job_counterInit( JobCounter *counter );
+static int job_worker( void *data );
+static int job_rangeWorker( void *data );
 
 /**
- * @brief Creates a concurrent queue.
- *
- * The basic concept is that we have a separate lock for both head and tail, so
- *  we can operate separately on either head or tail. This lets us enqueue at
- *  tail and dequeue at the head in true FIFO fashion.
+ * @brief Pushes a job at the bottom of a deque, only for the owner.
  *
- *    @return The ThreadQueue.
+ *    @return 0 on success, -1 if the deque is full.
  */
-static ThreadQueue* tq_create (void)
+static int jd_push( JobDeque *d, Job *job )
 {
-   ThreadQueue *q;
-   Node *n;
-
-   /* Queue memory allocation. */
-   q        = calloc( 1, sizeof(ThreadQueue) );
-
-   /* Allocate and insert the dummy node */
-   n        = calloc( 1, sizeof(Node) );
-   n->next  = NULL;
-   q->first = n;
-   q->last  = n;
-
-   /* Create locks. */
-   q->t_lock      = SDL_CreateMutex();
-   q->h_lock      = SDL_CreateMutex();
-   q->r_lock      = SDL_CreateMutex();
-   q->semaphore   = SDL_CreateSemaphore( 0 );
-
-   return q;
+   long b = atomic_load_explicit( &d->bottom, memory_order_relaxed );
+   long t = atomic_load_explicit( &d->top, memory_order_acquire );
+   if (b - t >= JOB_DEQUE_SIZE)
+      return -1;
+   atomic_store_explicit( &d->buf[ b & (JOB_DEQUE_SIZE-1) ], job, memory_order_relaxed );
+   atomic_store_explicit( &d->bottom, b+1, memory_order_release );
+   return 0;
 }
 
 /**
- * @brief Enqueue data to the ThreadQueue q.
- *
- *    @param q The queue to be inserted into.
- *    @param data The element to be stored in the queue.
+ * @brief Pops a job from the bottom of a deque, only for the owner.
  */
-static void tq_enqueue( ThreadQueue *q, void *data )
+static Job* jd_pop( JobDeque *d )
 {
-   Node *n;
+   Job *job;
+   long b = atomic_load_explicit( &d->bottom, memory_order_relaxed ) - 1;
+   long t;
+   atomic_store_explicit( &d->bottom, b, memory_order_relaxed );
+   atomic_thread_fence( memory_order_seq_cst );
+   t = atomic_load_explicit( &d->top, memory_order_relaxed );
+
+   /* Empty. */
+   if (t > b) {
+      atomic_store_explicit( &d->bottom, b+1, memory_order_relaxed );
+      return NULL;
+   }
 
-   /* Try to grab reserved struct if possible. */
-   SDL_mutexP( q->r_lock );
-   if (q->reserve!=NULL) {
-      n = q->reserve;
-      q->reserve = n->next;
+   job = atomic_load_explicit( &d->buf[ b & (JOB_DEQUE_SIZE-1) ], memory_order_relaxed );
+   if (t == b) {
+      /* Last job, race against the thieves for it. */
+      if (!atomic_compare_exchange_strong_explicit( &d->top, &t, t+1,
+               memory_order_seq_cst, memory_order_relaxed ))
+         job = NULL;
+      atomic_store_explicit( &d->bottom, b+1, memory_order_relaxed );
    }
-   else
-      n = malloc( sizeof(Node) );
-   n->data  = data;
-   n->next  = NULL;
-   SDL_mutexV( q->r_lock );
-
-   /* Lock */
-   SDL_mutexP( q->t_lock );
-
-   /* Enqueue. */
-   q->last->next  = n;
-   q->last        = n;
-
-   /* Signal and unlock. This wil break if someone tries to enqueue 2^32+1
-    * elements or something. */
-   SDL_SemPost( q->semaphore );
-   SDL_mutexV( q->t_lock );
+   return job;
 }
 
 /**
- * @brief Dequeue from the ThreadQueue q.
- *
- * @attention The callee should ALWAYS have called SDL_SemWait() on the semaphore.
- *
- *    @param q The queue to dequeue from.
- *    @return A void pointer to the element from the queue.
+ * @brief Steals a job from the top of a deque, can be used by any thread.
  */
-static void* tq_dequeue( ThreadQueue *q )
+static Job* jd_steal( JobDeque *d )
 {
-   void *d;
-   Node *newhead, *node;
-
-   /* Lock the head. */
-   SDL_mutexP( q->h_lock );
-
-   /* Start running. */
-   node     = q->first;
-   newhead  = node->next;
-
-   /* Head not consistent. */
-   if (newhead == NULL) {
-      WARN(_("Tried to dequeue while the queue was empty!"));
-      /* Ugly fix :/ */
-      /*
-      SDL_mutexV(q->h_lock);
+   Job *job;
+   long t = atomic_load_explicit( &d->top, memory_order_acquire );
+   long b;
+   atomic_thread_fence( memory_order_seq_cst );
+   b = atomic_load_explicit( &d->bottom, memory_order_acquire );
+   if (t >= b)
       return NULL;
-      */
-      /* We prefer to wait until the cache updates :/ */
-      do {
-         node     = q->first;
-         newhead  = node->next;
-      } while (newhead == NULL);
+
+   job = atomic_load_explicit( &d->buf[ t & (JOB_DEQUE_SIZE-1) ], memory_order_relaxed );
+   if (!atomic_compare_exchange_strong_explicit( &d->top, &t, t+1,
+            memory_order_seq_cst, memory_order_relaxed ))
+      return NULL;
+   return job;
+}
+
+/**
+ * @brief Makes a job available to the pool.
+ */
+static void job_push( Job *job )
+{
+   int ret;
+
+   /* Not initialized, just run it. */
+   if (job_deques == NULL) {
+      job_execute( job );
+      return;
    }
 
-   /* Remember the value and assign newhead as the new dummy element. */
-   d        = newhead->data;
-   q->first = newhead;
+   if (job_thread > 0)
+      ret = jd_push( &job_deques[ job_thread-1 ], job );
+   else {
+      SDL_AtomicLock( &job_extlock );
+      ret = jd_push( &job_deques[ job_nthreads ], job );
+      SDL_AtomicUnlock( &job_extlock );
+   }
 
-   /* Unlock */
-   SDL_mutexV( q->h_lock );
+   /* Queue is full, so run it directly. */
+   if (ret) {
+      job_execute( job );
+      return;
+   }
 
-   /* Save memory in reserve. */
-   SDL_mutexP( q->r_lock );
-   node->next = q->reserve;
-   q->reserve = node;
-   SDL_mutexV( q->r_lock );
+   /* Wake up a worker if they are sleeping. The fence pairs with the one in
+    * job_worker so either the worker sees the job or we see the worker. */
+   atomic_thread_fence( memory_order_seq_cst );
+   if (atomic_load_explicit( &job_sleeping, memory_order_relaxed ) > 0)
+      SDL_SemPost( job_wake );
 
-   return d;
+   /* Threads blocked in job_wait may be able to help with it. */
+   atomic_fetch_add( &job_pushed, 1 );
+   job_wakeWaiters();
 }
 
 /**
- * @brief Destroys and frees a ThreadQueue.
- *
- * Frees all elements too.
- *
- *    @param q The ThreadQueue to free.
+ * @brief Wakes up the threads blocked in job_wait, if any.
  */
-static void tq_destroy( ThreadQueue *q )
+static void job_wakeWaiters (void)
 {
-   /* Iterate through the list and free the nodes */
-   while (q->first != NULL) {
-      Node *n = q->first;
-      q->first = n->next;
-      free(n);
-   }
-
-   /* Free reserve. */
-   while (q->reserve != NULL) {
-      Node *n = q->reserve;
-      q->reserve = n->next;
-      free(n);
-   }
+   if (atomic_load( &job_waiters ) <= 0)
+      return;
+   SDL_LockMutex( job_waitlock );
+   SDL_CondBroadcast( job_waitcond );
+   SDL_UnlockMutex( job_waitlock );
+}
 
-   /* Clean up threading structures. */
-   SDL_DestroySemaphore( q->semaphore );
-   SDL_DestroyMutex( q->h_lock );
-   SDL_DestroyMutex( q->t_lock );
-   SDL_DestroyMutex( q->r_lock );
+/**
+ * @brief Finds a job to run, first from the own deque then stealing.
+ */
+static Job* job_find (void)
+{
+   Job *job;
+   int n, start;
 
+   if (job_deques == NULL)
+      return NULL;
 
-   /* Clean up vpool structures. */
-   if (q->mutex != NULL)
-      SDL_DestroyMutex( q->mutex );
-   if (q->cond != NULL)
-      SDL_DestroyCond( q->cond );
-   array_free(q->arg);
+   /* Own work first. */
+   if (job_thread > 0) {
+      job = jd_pop( &job_deques[ job_thread-1 ] );
+      if (job != NULL)
+         return job;
+   }
+   else {
+      SDL_AtomicLock( &job_extlock );
+      job = jd_pop( &job_deques[ job_nthreads ] );
+      SDL_AtomicUnlock( &job_extlock );
+      if (job != NULL)
+         return job;
+   }
 
-   free( q->first );
-   free( q );
+   /* Steal starting from a random victim to spread contention. */
+   n = job_nthreads+1;
+   job_rng = job_rng * 1103515245u + 12345u + (unsigned int)job_thread;
+   start = (job_rng >> 16) % n;
+   for (int i=0; i<n; i++) {
+      int v = (start+i) % n;
+      if (v == job_thread-1)
+         continue;
+      job = jd_steal( &job_deques[v] );
+      if (job != NULL)
+         return job;
+   }
+   return NULL;
 }
 
 /**
- * @brief The worker function for the threadpool.
+ * @brief Takes a job from the background queue.
  *
- * It waits for a signal from the handler. If it receives THREADSIG_STOP it
- *  means the worker thread should stop. Else it dequeues a job from the
- *  global_queue and executes it.
- *
- *    @param data A pointer to the ThreadData struct used for a lot of stuff.
+ *    @param counter Only take jobs of this counter, or NULL to take any.
+ *    @return The job or NULL if there is none.
  */
-static int threadpool_worker( void *data )
+static Job* job_findBackground( const JobCounter *counter )
 {
-   ThreadData *work = (ThreadData*) data;
+   Job *job, *prev;
+
+   SDL_AtomicLock( &job_bglock );
+   prev = NULL;
+   job  = job_bghead;
+   while ((job != NULL) && (counter != NULL) && (job->counter != counter)) {
+      prev = job;
+      job  = job->next;
+   }
+   if (job != NULL) {
+      if (prev == NULL)
+         job_bghead = job->next;
+      else
+         prev->next = job->next;
+      if (job_bgtail == job)
+         job_bgtail = prev;
+      job->next = NULL;
+   }
+   SDL_AtomicUnlock( &job_bglock );
+   return job;
+}
 
-   /* Work loop */
-   while (1) {
-      /* Wait for new signal */
-      while (SDL_SemWait( work->semaphore ) == -1) {
-          /* Putting this in a while-loop is probably a really bad idea, but I
-           * don't have any better ideas. */
-          WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-      }
-      /* Break if received signal to stop */
-      if (work->signal == THREADSIG_STOP)
-         break;
+/**
+ * @brief Runs a job, releases the jobs depending on it and frees it.
+ */
+static void job_execute( Job *job )
+{
+   JobCounter *c = job->counter;
+   Job *waiting = NULL;
+   int done = 0;
 
-      /* Do work :-) */
-      work->function( work->data );
+   job->function( job->data );
+   free( job );
 
-      /* Enqueue itself in the idle worker threads queue */
-      tq_enqueue( work->idle, work );
-   }
-   /* Enqueue itself in the stopped worker threads queue when stopped */
-   tq_enqueue( work->stopped, work );
+   if (c == NULL)
+      return;
 
-   return 0;
+   /* The count is decremented with the lock held so that waiting jobs can't
+    * be added after the list is taken, and so job_wait can tell when the
+    * counter is no longer being used. */
+   SDL_AtomicLock( &c->lock );
+   if (atomic_fetch_sub( &c->count, 1 ) == 1) {
+      waiting = c->waiting;
+      c->waiting = NULL;
+      done = 1;
+   }
+   SDL_AtomicUnlock( &c->lock );
+   /* The counter may be freed by its waiter from here on, don't touch it. */
+
+   /* Whoever is waiting on the counter has to recheck it. */
+   if (done)
+      job_wakeWaiters();
+
+   while (waiting != NULL) {
+      Job *next = waiting->next;
+      waiting->next = NULL;
+      job_push( waiting );
+      waiting = next;
+   }
 }
 
 /**
- * @brief Handles assigning jobs to the workers and killing them if necessary.
- *
- * @note Stopping the threeadpool_handler is not yet implemented.
- *
- * Process is:
+ * @brief The worker function for the threadpool.
  *
- * 1) Wait for job
- * 2) if Timed out -> kill idle, putting on stopped, go to 1)
- * 3) Have thread run job
- * 3.1) Grab a job from the queue
- * 3.2) If idle thread, grab idle thread
- *      else if stopped threads, reactivate stopped thread
- *      else wait for running thread
- * 4) Go to 1)
+ * Runs jobs while there are any, and sleeps until woken up by new jobs
+ *  otherwise.
  *
- *    @param data Not used. SDL threading requires functions to take a void
- *                pointer as argument.
- *    @return Not really implemented yet.
+ *    @param data Index of the deque of the worker plus one.
  */
-static int threadpool_handler( void *data )
+static int job_worker( void *data )
 {
-   (void) data;
-   int nrunning, newthread;
-   ThreadData *threadargs, *threadarg;
-   /* Queues for idle workers and stopped workers */
-   ThreadQueue *idle, *stopped;
-   ThreadQueueData *node;
-
-   /* Initialize the idle and stopped queues. */
-   idle     = tq_create();
-   stopped  = tq_create();
-
-   /* Allocate threadargs to communicate with workers */
-   threadargs = calloc( MAXTHREADS, sizeof(ThreadData) );
-
-   /* Initialize threadargs */
-   for (int i=0; i<MAXTHREADS; i++) {
-      threadargs[i].function  = NULL;
-      threadargs[i].data      = NULL;
-      threadargs[i].semaphore = SDL_CreateSemaphore( 0 ); /* Used to give orders. */
-      threadargs[i].idle      = idle;
-      threadargs[i].stopped   = stopped;
-      threadargs[i].signal    = THREADSIG_RUN;
-      /* 'Workers' that do not have a thread are considered stopped */
-      tq_enqueue( stopped, &threadargs[i] );
-   }
-
-   /* Set the number of running threads to 0 */
-   nrunning = 0;
+   job_thread = (int)(intptr_t)data;
+   job_rng    = (unsigned int)job_thread;
 
-   /*
-    * Thread handler main loop.
-    */
    while (1) {
-      /*
-       * We must now wait, this shall be done on each active thread. However they will
-       * be put to sleep as time passes. When we receive a command we'll proceed to process
-       * it.
-       */
-      if (nrunning > 0) {
-         /*
-          * Here we'll wait until thread gets work to do. If it doesn't it will
-          * just stop a worker thread and wait until it gets something to do.
-          */
-         if (SDL_SemWaitTimeout( global_queue->semaphore, THREADPOOL_TIMEOUT ) != 0) {
-            /* There weren't any new jobs so we'll start killing threads ;) */
-            if (SDL_SemTryWait( idle->semaphore ) == 0) {
-               threadarg         = tq_dequeue( idle );
-               /* Set signal to stop worker thread */
-               threadarg->signal = THREADSIG_STOP;
-               /* Signal thread and decrement running threads counter */
-               SDL_SemPost( threadarg->semaphore );
-               nrunning -= 1;
-            }
-
-            /* We just go back to waiting on a thread. */
-            continue;
-         }
-
-         /* We got work. Continue to handle work. */
-      }
-      else {
-         /*
-          * Here we wait for a new job. No threads are alive at this point and the
-          * threadpool is just patiently waiting for work to arrive.
-          */
-         if (SDL_SemWait( global_queue->semaphore ) == -1) {
-             WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-             continue;
-         }
-
-         /* We got work. Continue to handle work. */
+      Job *job = NULL;
+
+      /* Try for a while before going to sleep. */
+      for (int i=0; i<JOB_SPIN && job==NULL; i++)
+         job = job_find();
+
+      /* Background jobs only when there is nothing more urgent. */
+      if (job == NULL)
+         job = job_findBackground( NULL );
+
+      if (job == NULL) {
+         atomic_fetch_add( &job_sleeping, 1 );
+         atomic_thread_fence( memory_order_seq_cst );
+         job = job_find();
+         if (job == NULL)
+            job = job_findBackground( NULL );
+         if (job == NULL)
+            SDL_SemWaitTimeout( job_wake, THREADPOOL_TIMEOUT );
+         atomic_fetch_sub( &job_sleeping, 1 );
       }
 
-      /*
-       * Get a new job from the queue. This should be safe as we have received
-       * a permission from the global_queue->semaphore.
-       */
-      node        = tq_dequeue( global_queue );
-      newthread   = 0;
-
-      /*
-       * Choose where to get the thread. Either idle, revive stopped or block until
-       * another thread becomes idle.
-       */
-      /* Idle thread available */
-      if (SDL_SemTryWait(idle->semaphore) == 0)
-         threadarg         = tq_dequeue( idle );
-      /* Make a new thread */
-      else if (SDL_SemTryWait(stopped->semaphore) == 0) {
-         threadarg         = tq_dequeue( stopped );
-         threadarg->signal = THREADSIG_RUN;
-         newthread         = 1;
-      }
-      /* Wait for idle thread */
-      else {
-         while (SDL_SemWait(idle->semaphore) == -1) {
-             /* Bad idea */
-             WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-         }
-         threadarg         = tq_dequeue( idle );
-      }
-
-      /* Assign arguments for the thread */
-      threadarg->function  = node->function;
-      threadarg->data      = node->data;
-      /* Signal the thread that there's a new job */
-      SDL_SemPost( threadarg->semaphore );
-
-      /* Start a new thread and increment the thread counter */
-      if (newthread) {
-         SDL_CreateThread( threadpool_worker,
-               "threadpool_worker",
-               threadarg );
-         nrunning += 1;
-      }
+      if (job != NULL)
+         job_execute( job );
    }
-   /** @TODO A way to stop the threadpool. */
-
-   /* Clean up. */
-   tq_destroy( idle );
-   tq_destroy( stopped );
-   free( threadargs );
 
    return 0;
 }
@@ -470,146 +406,313 @@ static int threadpool_handler( void *data )
 /**
  * @brief Initialize the global threadpool.
  *
+ * The calling thread is considered the main thread and gets its own deque.
+ *
  *    @return Returns 0 on success and -1 if there's already a threadpool.
  */
 int threadpool_init (void)
 {
-   MAXTHREADS = SDL_GetCPUCount() + 1; /* SDL 1.3 is pretty cool. */
+   int nworkers;
 
-   /* There's already a queue */
-   if (global_queue != NULL) {
+   /* There's already a threadpool */
+   if (job_deques != NULL) {
       WARN(_("Threadpool has already been initialized!"));
       return -1;
    }
 
-   /* Create the global queue queue */
-   global_queue = tq_create();
-
-   /* Initialize the threadpool handler. */
-   if ( SDL_CreateThread( threadpool_handler, "threadpool_handler", NULL ) == NULL ) {
-      ERR( _( "Threadpool init failed: %s" ), SDL_GetError() );
-      return -1;
+   /* Leave a core for the main thread, but always have a worker so loading
+    * doesn't all end up on the main thread. */
+   nworkers       = MAX( 1, SDL_GetCPUCount()-1 );
+   job_nthreads   = nworkers+1;
+   job_deques     = calloc( job_nthreads+1, sizeof(JobDeque) );
+   job_wake       = SDL_CreateSemaphore( 0 );
+   job_waitlock   = SDL_CreateMutex();
+   job_waitcond   = SDL_CreateCond();
+   job_thread     = 1;
+   job_rng        = 1;
+
+   for (int i=0; i<nworkers; i++) {
+      SDL_Thread *t = SDL_CreateThread( job_worker, "threadpool_worker", (void*)(intptr_t)(i+2) );
+      if (t == NULL) {
+         ERR( _( "Threadpool init failed: %s" ), SDL_GetError() );
+         return -1;
+      }
+      SDL_DetachThread( t );
    }
 
    return 0;
 }
 
 /**
- * @brief Creates a new vpool queue.
+ * @brief Gets the number of threads that run jobs.
  *
- * This is just an interface to make running a number of jobs and then wait for
- *  them to finish more pleasant. You should not nest vpools as of now as there
- *  are only a limit number of worker threads and we can't have them wait for a
- *  thread to finish that doesn't exist.
+ *    @return Number of threads, including the main thread.
+ */
+int threadpool_threads (void)
+{
+   return MAX( 1, job_nthreads );
+}
+
+/**
+ * @brief Initializes a job counter.
+ */
+static void job_counterInit( JobCounter *counter )
+{
+   atomic_init( &counter->count, 0 );
+   counter->lock     = 0;
+   counter->waiting  = NULL;
+}
+
+/**
+ * @brief Creates a job counter.
  *
- * If you really want to sort of nest vpools, you should start a new thread
- *  instead of using the threadpool. I might add a vpool_waitInANewThread
- *  function some day.
+ *    @return The new counter with no jobs.
+ */
+JobCounter* job_counterCreate (void)
+{
+   JobCounter *counter = malloc( sizeof(JobCounter) );
+   job_counterInit( counter );
+   return counter;
+}
+
+/**
+ * @brief Destroys a job counter.
  *
- *    @return Returns a ThreadQueue to be used.
+ *    @param counter Counter to destroy, must not have any pending jobs.
  */
-ThreadQueue* vpool_create (void)
+void job_counterDestroy( JobCounter *counter )
 {
-   ThreadQueue *tq = tq_create();
-   /* Create vpool-specific threading structures. */
-   tq->cond  = SDL_CreateCond();
-   tq->mutex = SDL_CreateMutex();
-   tq->arg   = array_create( vpoolThreadData );
-   return tq;
+   if (counter == NULL)
+      return;
+   job_wait( counter );
+   free( counter );
 }
 
 /**
- * @brief Enqueue a job in the vpool queue.
+ * @brief Runs a job in the threadpool.
  *
- * @warning Do NOT enqueue jobs that wait for another job to be done, as this
- *          could lead to a deadlock.
+ *    @param counter Counter to add the job to, or NULL.
+ *    @param function Function to run.
+ *    @param data Data to pass to the function.
+ */
+void job_run( JobCounter *counter, int (*function)(void *), void *data )
+{
+   job_runAfter( counter, NULL, function, data );
+}
+
+/**
+ * @brief Runs a job in the threadpool once other jobs are done.
  *
- * @warning Do NOT enqueue jobs that wait for a vpool, as this could lead to a
- *          deadlock.
+ *    @param counter Counter to add the job to, or NULL.
+ *    @param dependency Job counter that has to be done before the job is run,
+ *                      or NULL.
+ *    @param function Function to run.
+ *    @param data Data to pass to the function.
  */
-void vpool_enqueue( ThreadQueue *queue, int (*function)(void *), void *data )
+void job_runAfter( JobCounter *counter, JobCounter *dependency, int (*function)(void *), void *data )
 {
-   vpoolThreadData *arg = &array_grow( &queue->arg );
-   memset( arg, 0, sizeof(vpoolThreadData) );
-   /* Common field.s */
-   arg->cond   = queue->cond;
-   arg->mutex  = queue->mutex;
-   arg->count  = &queue->cnt;
-   /* Task-specific stuff. */
-   arg->node.data = data;
-   arg->node.function = function;
-   SDL_SemPost( queue->semaphore );
-   arg->wrapper.function = vpool_worker;
+   Job *job = malloc( sizeof(Job) );
+   job->function  = function;
+   job->data      = data;
+   job->counter   = counter;
+   job->next      = NULL;
+
+   if (counter != NULL)
+      atomic_fetch_add( &counter->count, 1 );
+
+   if (dependency != NULL) {
+      SDL_AtomicLock( &dependency->lock );
+      if (atomic_load( &dependency->count ) > 0) {
+         job->next = dependency->waiting;
+         dependency->waiting = job;
+         SDL_AtomicUnlock( &dependency->lock );
+         return;
+      }
+      SDL_AtomicUnlock( &dependency->lock );
+   }
+
+   job_push( job );
 }
 
 /**
- * @brief A special vpool worker that signals the waiting thread when all jobs
- *        are done.
+ * @brief Runs a job in the background queue.
+ *
+ * Background jobs are only picked up by worker threads, so they never run
+ *  inside job_wait of an unrelated counter. Meant for slow jobs like writing
+ *  files that nothing waits on every frame.
  *
- * It uses a mutex+condition variable+counter.
+ *    @param counter Counter to add the job to, or NULL.
+ *    @param function Function to run.
+ *    @param data Data to pass to the function.
  */
-static int vpool_worker( void *data )
+void job_runBackground( JobCounter *counter, int (*function)(void *), void *data )
 {
-   int cnt;
-   vpoolThreadData *work = (vpoolThreadData*) data;
+   Job *job = malloc( sizeof(Job) );
+   job->function  = function;
+   job->data      = data;
+   job->counter   = counter;
+   job->next      = NULL;
+
+   if (counter != NULL)
+      atomic_fetch_add( &counter->count, 1 );
+
+   /* Not initialized, just run it. */
+   if (job_deques == NULL) {
+      job_execute( job );
+      return;
+   }
 
-   /* Do work */
-   work->node.function( work->node.data );
+   SDL_AtomicLock( &job_bglock );
+   if (job_bgtail == NULL)
+      job_bghead = job;
+   else
+      job_bgtail->next = job;
+   job_bgtail = job;
+   SDL_AtomicUnlock( &job_bglock );
 
-   /* Decrement the counter and signal vpool_wait if all threads are done */
-   SDL_mutexP( work->mutex );
-   cnt   = *(work->count) - 1;
-   if (cnt <= 0)                    /* All jobs done. */
-      SDL_CondSignal( work->cond );  /* Signal waiting thread */
-   *(work->count) = cnt;
-   SDL_mutexV( work->mutex );
+   atomic_thread_fence( memory_order_seq_cst );
+   if (atomic_load_explicit( &job_sleeping, memory_order_relaxed ) > 0)
+      SDL_SemPost( job_wake );
 
-   return 0;
+   /* Someone may already be waiting on the counter. */
+   atomic_fetch_add( &job_pushed, 1 );
+   job_wakeWaiters();
 }
 
-/* @brief Run every job in the vpool queue and block until every job in the
- *        queue is done.
+/**
+ * @brief Blocks until all the jobs of a counter are done.
+ *
+ * The thread runs other jobs while waiting, but of the background jobs only
+ *  those of the counter. It sleeps when there is nothing to run.
  *
- * @note It destroys the queue when it's done.
+ *    @param counter Counter to wait on.
  */
-void vpool_wait( ThreadQueue *queue )
+void job_wait( JobCounter *counter )
 {
-   /* Number of tasks we have. */
-   int cnt;
-   queue->cnt = array_size( queue->arg );
-   cnt = queue->cnt;
+   while (atomic_load( &counter->count ) > 0) {
+      Job *job;
+      unsigned int pushed;
+
+      /* Register first so pushes after reading the count wake us up. */
+      atomic_fetch_add( &job_waiters, 1 );
+      pushed = atomic_load( &job_pushed );
+
+      job = job_find();
+      if (job == NULL)
+         job = job_findBackground( counter );
+      if (job != NULL) {
+         atomic_fetch_sub( &job_waiters, 1 );
+         job_execute( job );
+         continue;
+      }
 
-   if (global_queue == NULL) {
-      WARN(_("Threadpool has not been initialized yet!"));
-      return;
+      /* Nothing to do, sleep until a job is pushed or a counter finishes. */
+      if (job_waitlock != NULL) {
+         SDL_LockMutex( job_waitlock );
+         if ((atomic_load( &counter->count ) > 0) && (atomic_load( &job_pushed ) == pushed))
+            SDL_CondWait( job_waitcond, job_waitlock );
+         SDL_UnlockMutex( job_waitlock );
+      }
+      atomic_fetch_sub( &job_waiters, 1 );
    }
 
-   /* Nothing to do. */
-   if (cnt <= 0)
+   /* Make sure the last job is done touching the counter. */
+   SDL_AtomicLock( &counter->lock );
+   SDL_AtomicUnlock( &counter->lock );
+}
+
+/**
+ * @brief Runs a part of a parallel for loop.
+ */
+static int job_rangeWorker( void *data )
+{
+   JobRange *r = (JobRange*) data;
+   return r->function( r->data, r->start, r->end );
+}
+
+/**
+ * @brief Runs a function over a range in parallel.
+ *
+ * The range is split into a few chunks per thread so threads that finish
+ *  early can steal the rest. Blocks until the whole range is done.
+ *
+ *    @param n Number of elements in the range.
+ *    @param chunk_min Minimum amount of elements per chunk.
+ *    @param function Function to run on each chunk, gets the range [start,end).
+ *    @param data Data to pass to the function.
+ */
+void job_parallelFor( int n, int chunk_min, int (*function)(void *data, int start, int end), void *data )
+{
+   JobCounter counter;
+   JobRange *ranges;
+   int nchunks, chunk;
+
+   if (n <= 0)
       return;
 
-   /* Allocate all vpoolThreadData objects */
-   SDL_mutexP( queue->mutex );
-   /* Initialize the vpoolThreadData */
-   for (int i=0; i<cnt; i++) {
-      vpoolThreadData *arg;
-      /* This is needed to keep the invariants of the queue */
-      while (SDL_SemWait( queue->semaphore ) == -1) {
-          /* Again, a really bad idea */
-          WARN(_("SDL_SemWait failed! Error: %s"), SDL_GetError());
-      }
-      /* Launch new job. */
-      arg = &queue->arg[i];
-      arg->wrapper.data = arg;
-      tq_enqueue( global_queue, &queue->arg[i].wrapper );
+   nchunks = MIN( 4*threadpool_threads(), n / MAX(1,chunk_min) );
+   if (nchunks <= 1) {
+      function( data, 0, n );
+      return;
+   }
+   chunk  = (n + nchunks - 1) / nchunks;
+   ranges = malloc( nchunks * sizeof(JobRange) );
+   job_counterInit( &counter );
+   for (int i=0; i<nchunks; i++) {
+      JobRange *r = &ranges[i];
+      r->function = function;
+      r->data     = data;
+      r->start    = i*chunk;
+      r->end      = MIN( n, (i+1)*chunk );
+      if (r->start >= r->end)
+         break;
+      job_run( &counter, job_rangeWorker, r );
    }
+   job_wait( &counter );
+   free( ranges );
+}
 
-   /* Wait for the threads to finish */
-   SDL_CondWait( queue->cond, queue->mutex );
-   SDL_mutexV( queue->mutex );
+/**
+ * @brief Creates a new vpool queue.
+ *
+ * This is just an interface to make running a number of jobs and then wait for
+ *  them to finish more pleasant.
+ *
+ *    @return Returns a ThreadQueue to be used.
+ */
+ThreadQueue* vpool_create (void)
+{
+   ThreadQueue *tq = calloc( 1, sizeof(ThreadQueue) );
+   job_counterInit( &tq->counter );
+   tq->jobs = array_create( ThreadQueueData );
+   return tq;
+}
+
+/**
+ * @brief Enqueue a job in the vpool queue.
+ *
+ * The job is not started until vpool_wait is called.
+ */
+void vpool_enqueue( ThreadQueue *queue, int (*function)(void *), void *data )
+{
+   ThreadQueueData *job = &array_grow( &queue->jobs );
+   job->function  = function;
+   job->data      = data;
+}
+
+/* @brief Run every job in the vpool queue and block until every job in the
+ *        queue is done.
+ *
+ * The queue is emptied so it can be reused.
+ */
+void vpool_wait( ThreadQueue *queue )
+{
+   for (int i=0; i<array_size(queue->jobs); i++)
+      job_run( &queue->counter, queue->jobs[i].function, queue->jobs[i].data );
+   job_wait( &queue->counter );
 
    /* Can toss away all the queue stuff. */
-   array_erase( &queue->arg, array_begin(queue->arg), array_end(queue->arg) );
+   array_erase( &queue->jobs, array_begin(queue->jobs), array_end(queue->jobs) );
 }
 
 /**
@@ -617,6 +720,9 @@ void vpool_wait( ThreadQueue *queue )
  */
 void vpool_cleanup( ThreadQueue* queue )
 {
-   /* Clean up */
-   tq_destroy( queue );
+   if (queue == NULL)
+      return;
+   job_wait( &queue->counter );
+   array_free( queue->jobs );
+   free( queue );
 }
@@ -17,15 +17,42 @@
 struct ThreadQueue_;
 typedef struct ThreadQueue_ ThreadQueue;
 
+struct JobCounter_;
+typedef struct JobCounter_ JobCounter;
+
 /* Initializes the threadpool */
 int threadpool_init (void);
 
+/* Number of threads able to run jobs, including the main thread. */
+int threadpool_threads (void);
+
+/* Creates a counter to keep track of a group of jobs. */
+JobCounter* job_counterCreate (void);
+
+/* Destroys a counter. It must not have any pending jobs. */
+void job_counterDestroy( JobCounter *counter );
+
+/* Runs a job, counter can be NULL if it's not waited on. */
+void job_run( JobCounter *counter, int (*function)(void *), void *data );
+
+/* Runs a slow job that only worker threads pick up, never an unrelated job_wait. */
+void job_runBackground( JobCounter *counter, int (*function)(void *), void *data );
+
+/* Runs a job once all the jobs of dependency are done. */
+void job_runAfter( JobCounter *counter, JobCounter *dependency, int (*function)(void *), void *data );
+
+/* Blocks until every job of the counter is done, running jobs while waiting.
+ * Unlike vpools, it is safe to wait from inside a job. */
+void job_wait( JobCounter *counter );
+
+/* Splits [0,n) into ranges of at least chunk_min and runs them in parallel,
+ * blocking until they are all done. */
+void job_parallelFor( int n, int chunk_min, int (*function)(void *data, int start, int end), void *data );
+
 /* Creates a new vpool queue. Destroy with vpool_wait. */
 ThreadQueue* vpool_create (void);
 
-/* Enqueue a job in the vpool queue. Do NOT enqueue a job that has to wait for
- * another job to be done as this could lead to a deadlock. Also do not enqueue
- * jobs from enqueued threads. */
+/* Enqueue a job in the vpool queue. Jobs only start running on vpool_wait. */
 void vpool_enqueue( ThreadQueue* queue, int (*function)(void *), void *data );
 
 /* Run every job in the vpool queue and block until every job in the queue is
@@ -179,6 +179,16 @@ typedef struct Window_ {
    int focus; /**< Current focused widget. */
    Widget *widgets; /**< Widget storage. */
    void *udata; /**< Custom data of the window. */
+
+   /* Cached rendering. */
+   GLuint fbo; /**< Framebuffer the window is rendered to, GL_INVALID_VALUE if not created. */
+   GLuint fbo_tex; /**< Texture of the framebuffer. */
+   int fbo_w; /**< Width of the framebuffer. */
+   int fbo_h; /**< Height of the framebuffer. */
+   int dirty; /**< Whether the cached rendering has to be redone. */
+   int cache_x; /**< X position the window was cached at. */
+   int cache_y; /**< Y position the window was cached at. */
+   int cache_top; /**< Whether the window was at the top when cached. */
 } Window;
 
 /* Window stuff. */
@@ -192,6 +202,7 @@ void window_render( Window* w, int top );
 void window_renderDynamic( Window *w );
 void window_renderOverlay( Window* w );
 void window_kill( Window *wdw );
+void window_rerender( Window *wdw );
 
 /* Widget stuff. */
 Widget* window_newWidget( Window* w, const char *name );
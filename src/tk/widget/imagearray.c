@@ -299,6 +299,7 @@ static void iar_renderOverlay( Widget* iar, double bx, double by )
 {
    double x, y;
    const char *alt;
+   ImageArrayCell *cell;
 
    /*
     * Draw Alt text if applicable.
@@ -310,8 +311,11 @@ static void iar_renderOverlay( Widget* iar, double bx, double by )
       x = bx + iar->x + iar->dat.iar.altx;
       y = by + iar->y + iar->dat.iar.alty;
 
-      /* Draw alt text. */
-      alt = iar->dat.iar.images[iar->dat.iar.alt].alt;
+      /* Draw alt text, generating it the first time it is shown. */
+      cell = &iar->dat.iar.images[iar->dat.iar.alt];
+      if ((cell->alt == NULL) && (iar->dat.iar.altptr != NULL))
+         cell->alt = iar->dat.iar.altptr( iar->wdw, iar->name, iar->dat.iar.alt );
+      alt = cell->alt;
       if (alt != NULL)
          toolkit_drawAltText( x, y, alt );
    }
@@ -992,6 +996,51 @@ void toolkit_setImageArrayAccept( unsigned int wid, const char *name, void (*fpt
    wgt->dat.iar.accept = fptr;
 }
 
+/**
+ * @brief Sets the function generating the alt text of an Image Array.
+ *
+ * Cells with no alt text get it from the function the first time it has to
+ *  be shown, so it does not have to be generated for every element up front.
+ *
+ *    @param wid Window where image array is.
+ *    @param name Name of the image array.
+ *    @param fptr Function taking the window, name and position of the
+ *                element, and returning a newly allocated alt text or NULL.
+ */
+void toolkit_setImageArrayAltText( unsigned int wid, const char *name, char* (*fptr)(unsigned int,const char*,int) )
+{
+   Widget *wgt = iar_getWidget( wid, name );
+   if (wgt == NULL)
+      return;
+   wgt->dat.iar.altptr = fptr;
+}
+
+/**
+ * @brief Updates the quantity of an element of an Image Array in place.
+ *
+ *    @param wid Window where image array is.
+ *    @param name Name of the image array.
+ *    @param pos Position of the element.
+ *    @param quantity Quantity to set.
+ *    @return 0 on success.
+ */
+int toolkit_setImageArrayQuantity( unsigned int wid, const char *name, int pos, int quantity )
+{
+   ImageArrayCell *cell;
+   Widget *wgt = iar_getWidget( wid, name );
+   if (wgt == NULL)
+      return -1;
+   if ((pos < 0) || (pos >= wgt->dat.iar.nelements))
+      return -1;
+
+   cell = &wgt->dat.iar.images[pos];
+   if (cell->quantity == quantity)
+      return 0;
+   cell->quantity = quantity;
+   toolkit_rerender();
+   return 0;
+}
+
 /**
  * @brief Gets the number of visible elements in an image array.
  *
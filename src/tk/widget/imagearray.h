@@ -43,6 +43,7 @@ typedef struct WidgetImageArrayData_ {
    void (*rmptr) (unsigned int,const char*); /**< Right click callback. */
    void (*dblptr) (unsigned int,const char*); /**< Double click callback (for one selection). */
    void (*accept) (unsigned int, const char*); /**< Accept function pointer (when hitting enter). */
+   char* (*altptr) (unsigned int, const char*, int); /**< Generates missing alt text when first shown. */
 } WidgetImageArrayData;
 
 /**
@@ -80,5 +81,7 @@ int toolkit_loadImageArrayData( unsigned int wid, const char *name,
 void toolkit_initImageArrayData( iar_data_t *iar_data );
 int toolkit_unsetSelection( unsigned int wid, const char *name );
 void toolkit_setImageArrayAccept( unsigned int wid, const char *name, void (*fptr)(unsigned int,const char*) );
+void toolkit_setImageArrayAltText( unsigned int wid, const char *name, char* (*fptr)(unsigned int,const char*,int) );
+int toolkit_setImageArrayQuantity( unsigned int wid, const char *name, int pos, int quantity );
 int toolkit_getImageArrayVisibleElements( unsigned int wid, const char *name );
 int toolkit_simImageArrayVisibleElements( int w, int h, int iw, int ih );
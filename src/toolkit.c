@@ -29,7 +29,8 @@
 
 static unsigned int genwid = 0; /**< Generates unique window ids, > 0 */
 
-static int toolkit_needsRender = 1; /**< Whether or not toolkit needs a render. */
+static int toolkit_needsRender = 1; /**< Whether or not all the windows need a render. */
+static int toolkit_needsComposite = 1; /**< Whether or not the cached windows need to be composited again. */
 static int toolkit_delayCounter = 0; /**< Horrible hack around secondary loop. */
 
 /*
@@ -70,6 +71,7 @@ static GLsizei toolkit_vboColourOffset; /**< Colour offset. */
  * static prototypes
  */
 /* input */
+static void toolkit_vboUpload( const void *vertex, GLsizei vsize, const void *colours, GLsizei csize );
 static int toolkit_mouseEvent( Window *w, SDL_Event* event );
 static int toolkit_mouseEventWidget( Window *w, Widget *wgt,
       SDL_Event *event, int x, int y, int rx, int ry );
@@ -81,6 +83,8 @@ static Widget* toolkit_getFocus( Window *wdw );
 static void toolkit_expose( Window *wdw, int expose );
 /* render */
 static void window_renderBorder( const Window* w );
+static void window_renderCached( Window *w, int top );
+static void toolkit_composite( const Window *top );
 /* Death. */
 static void widget_kill( Widget *wgt );
 static void window_cleanup( Window *wdw );
@@ -726,6 +730,8 @@ unsigned int window_createFlags( const char* name, const char *displayname,
    wdw->yrel         = -1.;
    wdw->flags        = flags;
    wdw->exposed      = !window_isFlag(wdw, WINDOW_NOFOCUS);
+   wdw->fbo          = GL_INVALID_VALUE;
+   wdw->dirty        = 1;
 
    /* Dimensions. */
    wdw->w            = (w == -1) ? gl_screen.nw : (double) w;
@@ -1004,8 +1010,14 @@ void widget_cleanup( Widget *widget )
 
 void widget_setStatus( Widget *wgt, WidgetStatus sts )
 {
-   if (wgt->status != sts)
-      toolkit_rerender();
+   if (wgt->status != sts) {
+      /* Only the look of the widget changes. */
+      Window *wdw = window_wgetW( wgt->wdw );
+      if (wdw != NULL)
+         window_rerender( wdw );
+      else
+         toolkit_rerender();
+   }
    wgt->status = sts;
 }
 
@@ -1121,6 +1133,10 @@ static void window_remove( Window *wdw )
    /* Destroy the window. */
    free(wdw->name);
    free(wdw->displayname);
+   if (wdw->fbo != GL_INVALID_VALUE) {
+      glDeleteFramebuffers( 1, &wdw->fbo );
+      glDeleteTextures( 1, &wdw->fbo_tex );
+   }
    wgt = wdw->widgets;
    while (wgt != NULL) {
       Widget *wgtkill = wgt;
@@ -1200,6 +1216,22 @@ static void widget_kill( Widget *wgt )
    nfree(wgt);
 }
 
+/**
+ * @brief Streams vertices and their colours to the toolkit VBO.
+ *
+ * The colours go at toolkit_vboColourOffset after the vertices, as one push
+ *  to the ring so both are set up with the same base.
+ */
+static void toolkit_vboUpload( const void *vertex, GLsizei vsize, const void *colours, GLsizei csize )
+{
+   char *buf = gl_vboRingMap( toolkit_vbo, toolkit_vboColourOffset + csize );
+   if (buf != NULL) {
+      memcpy( buf, vertex, vsize );
+      memcpy( &buf[toolkit_vboColourOffset], colours, csize );
+   }
+   gl_vboUnmap( toolkit_vbo );
+}
+
 /**
  * @brief Draws an outline.
  *
@@ -1267,14 +1299,13 @@ void toolkit_drawOutlineThick( int x, int y, int w, int h, int b,
    colours[9]    = *lc;
 
    /* Upload to the VBO. */
-   gl_vboSubData( toolkit_vbo, 0, sizeof(tri), tri );
-   gl_vboSubData( toolkit_vbo, toolkit_vboColourOffset, sizeof(colours), colours );
+   toolkit_vboUpload( tri, sizeof(tri), colours, sizeof(colours) );
 
    gl_beginSmoothProgram(gl_view_matrix);
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 10 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 10 );
    gl_endSmoothProgram();
 }
 
@@ -1319,14 +1350,13 @@ void toolkit_drawOutline( int x, int y, int w, int h, int b,
    colours[3]    = *lc;
 
    /* Upload to the VBO. */
-   gl_vboSubData( toolkit_vbo, 0, sizeof(lines), lines );
-   gl_vboSubData( toolkit_vbo, toolkit_vboColourOffset, sizeof(colours), colours );
+   toolkit_vboUpload( lines, sizeof(lines), colours, sizeof(colours) );
 
    gl_beginSmoothProgram(gl_view_matrix);
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_LINE_LOOP, 0, 4 );
+   gl_drawArrays( GL_LINE_LOOP, 0, 4 );
    gl_endSmoothProgram();
 }
 /**
@@ -1367,14 +1397,13 @@ void toolkit_drawRect( int x, int y, int w, int h,
    colours[3]   = *lc;
 
    /* Upload to the VBO. */
-   gl_vboSubData( toolkit_vbo, 0, sizeof(vertex), vertex );
-   gl_vboSubData( toolkit_vbo, toolkit_vboColourOffset, sizeof(colours), colours );
+   toolkit_vboUpload( vertex, sizeof(vertex), colours, sizeof(colours) );
 
    gl_beginSmoothProgram(gl_view_matrix);
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
    gl_endSmoothProgram();
 }
 
@@ -1409,14 +1438,13 @@ void toolkit_drawTriangle( int x1, int y1, int x2, int y2, int x3, int y3,
    colours[2]   = *c;
 
    /* Upload to the VBO. */
-   gl_vboSubData( toolkit_vbo, 0, sizeof(vertex), vertex );
-   gl_vboSubData( toolkit_vbo, toolkit_vboColourOffset, sizeof(colours), colours );
+   toolkit_vboUpload( vertex, sizeof(vertex), colours, sizeof(colours) );
 
    gl_beginSmoothProgram(gl_view_matrix);
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex, 0, 2, GL_SHORT, 0 );
    gl_vboActivateAttribOffset( toolkit_vbo, shaders.smooth.vertex_colour,
          toolkit_vboColourOffset, 4, GL_FLOAT, 0 );
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 3 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 3 );
    gl_endSmoothProgram();
 }
 
@@ -1535,6 +1563,85 @@ void window_render( Window *w, int top )
    }
 }
 
+/**
+ * @brief Renders a window into its own framebuffer if it changed.
+ *
+ *    @param w Window to render.
+ *    @param top Whether or not the window is at the top.
+ */
+static void window_renderCached( Window *w, int top )
+{
+   /* Framebuffers have to match the screen, the window is rendered at its
+    * screen position. */
+   if ((w->fbo == GL_INVALID_VALUE) || (w->fbo_w != gl_screen.rw) || (w->fbo_h != gl_screen.rh)) {
+      if (w->fbo != GL_INVALID_VALUE) {
+         glDeleteFramebuffers( 1, &w->fbo );
+         glDeleteTextures( 1, &w->fbo_tex );
+      }
+      gl_fboCreate( &w->fbo, &w->fbo_tex, gl_screen.rw, gl_screen.rh );
+      w->fbo_w = gl_screen.rw;
+      w->fbo_h = gl_screen.rh;
+      w->dirty = 1;
+   }
+
+   if (!w->dirty && (w->cache_x == w->x) && (w->cache_y == w->y) && (w->cache_top == top))
+      return;
+
+   glBindFramebuffer( GL_FRAMEBUFFER, w->fbo );
+   glClearColor( 0., 0., 0., 0. );
+   glClear( GL_COLOR_BUFFER_BIT );
+   window_render( w, top );
+
+   w->dirty     = 0;
+   w->cache_x   = w->x;
+   w->cache_y   = w->y;
+   w->cache_top = top;
+   toolkit_needsComposite = 1;
+}
+
+/**
+ * @brief Composites the cached windows in order.
+ *
+ *    @param top Window at the top.
+ */
+static void toolkit_composite( const Window *top )
+{
+   const mat4 ortho = mat4_ortho(0., 1., 0., 1., 1., -1.);
+   const mat4 I = mat4_identity();
+
+   glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.fbo[3] );
+   glClearColor( 0., 0., 0., 0. );
+   glClear( GL_COLOR_BUFFER_BIT );
+
+   /* The cached windows have premultiplied colours. */
+   glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   glUseProgram( shaders.texture.program );
+   glActiveTexture( GL_TEXTURE0 );
+   glUniform1i( shaders.texture.sampler, 0 );
+   glEnableVertexAttribArray( shaders.texture.vertex );
+   gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture.vertex,
+         0, 2, GL_FLOAT, 0 );
+   gl_uniformColour( shaders.texture.colour, &cWhite );
+   gl_uniformMat4( shaders.texture.projection, &ortho );
+   gl_uniformMat4( shaders.texture.tex_mat, &I );
+
+   for (const Window *w = windows; w!=NULL; w = w->next) {
+      if (window_isFlag(w, WINDOW_NORENDER | WINDOW_KILL))
+         continue;
+      if ((w==top) && window_isFlag(w,WINDOW_DYNAMIC))
+         continue;
+      if (w->fbo == GL_INVALID_VALUE)
+         continue;
+      glBindTexture( GL_TEXTURE_2D, w->fbo_tex );
+      gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   }
+
+   glDisableVertexAttribArray( shaders.texture.vertex );
+   glBindTexture( GL_TEXTURE_2D, 0 );
+   glUseProgram( 0 );
+   gl_checkErr();
+}
+
 /**
  * @brief Renders the dynamic components of a window.
  */
@@ -1598,29 +1705,30 @@ void toolkit_render( double dt )
 
    NTracingZone( _ctx, 1 );
 
+   /* Each window is cached in its own framebuffer, and only windows that
+    * changed get rendered again. */
    if (toolkit_needsRender) {
       toolkit_needsRender = 0;
+      for (Window *w = windows; w!=NULL; w = w->next)
+         w->dirty = 1;
+   }
+   glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   for (Window *w = windows; w!=NULL; w = w->next) {
+      if (window_isFlag(w, WINDOW_NORENDER | WINDOW_KILL))
+         continue;
+      if ((w==top) && window_isFlag(w,WINDOW_DYNAMIC))
+         continue;
 
-      glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.fbo[3] );
-      glClearColor( 0., 0., 0., 0. );
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-      glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
-
-      /* Render base. */
-      for (Window *w = windows; w!=NULL; w = w->next) {
-         if (window_isFlag(w, WINDOW_NORENDER | WINDOW_KILL))
-            continue;
-         if ((w==top) && window_isFlag(w,WINDOW_DYNAMIC))
-            continue;
-
-         /* The actual rendering. */
-         window_render( w, w==top );
-      }
-
-      glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-      glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
-      glClearColor( 0., 0., 0., 1. );
+      /* The actual rendering. */
+      window_renderCached( w, w==top );
    }
+   if (toolkit_needsComposite) {
+      toolkit_needsComposite = 0;
+      toolkit_composite( top );
+   }
+   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+   glBindFramebuffer(GL_FRAMEBUFFER, gl_screen.current_fbo);
+   glClearColor( 0., 0., 0., 1. );
 
    glUseProgram(shaders.texture.program);
 
@@ -1642,7 +1750,7 @@ void toolkit_render( double dt )
    gl_uniformMat4(shaders.texture.tex_mat, &I);
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clean up. */
    glDisableVertexAttribArray( shaders.texture.vertex );
@@ -1668,6 +1776,19 @@ void toolkit_rerender (void)
    toolkit_needsRender = 1;
 }
 
+/**
+ * @brief Marks a single window for needing a rerender.
+ *
+ * Use when only the looks of the window changed, anything that may affect
+ *  other windows should use toolkit_rerender.
+ *
+ *    @param wdw Window to rerender.
+ */
+void window_rerender( Window *wdw )
+{
+   wdw->dirty = 1;
+}
+
 /**
  * @brief Toolkit input handled here.
  *
@@ -2656,7 +2777,7 @@ int toolkit_init (void)
    /* Create the VBO. */
    toolkit_vboColourOffset = sizeof(GLshort) * 2 * 31;
    size = (sizeof(GLshort)*2 + sizeof(GLfloat)*4) * 31;
-   toolkit_vbo = gl_vboCreateStream( size, NULL );
+   toolkit_vbo = gl_vboCreateRing( size );
 
    /* Disable the cursor. */
    input_mouseHide();
@@ -22,7 +22,10 @@
 #include "array.h"
 #include "economy.h"
 #include "log.h"
+#include "map.h"
 #include "map_overlay.h"
+#include "map_system.h"
+#include "ncache.h"
 #include "ndata.h"
 #include "nstring.h"
 #include "nxml.h"
@@ -30,14 +33,7 @@
 #include "space.h"
 #include "player.h"
 
-/**
- * @brief Universe diff filepath list.
- */
-typedef struct UniDiffData_ {
-   char *name;       /**< Name of the diff (read from XML). */
-   char *filename;   /**< Filename of the diff. */
-} UniDiffData_t;
-static UniDiffData_t *diff_available = NULL; /**< Available diffs. */
+#define UNIDIFF_CACHE   "unidiff" /**< Name of the binary cache of diff headers. */
 
 /**
  * @enum UniHunkTargetType_t
@@ -128,7 +124,7 @@ typedef struct UniHunk_ {
    UniHunkTarget_t target; /**< Hunk's target. */
 
    UniHunkType_t type; /**< Type of hunk it is. */
-   xmlNodePtr node; /**< Parent node. */
+   xmlNodePtr node; /**< Copy of the jump node for jump additions, owned by the parsed diff. */
    union {
       char *name;
       int data;
@@ -150,34 +146,71 @@ typedef struct UniDiff_ {
    UniHunk_t *failed;   /**< Failed hunks. */
 } UniDiff_t;
 
+/**
+ * @brief Universe diff filepath list.
+ *
+ * The hunks are parsed the first time the diff is applied, and replayed from
+ *  then on without reading the XML again.
+ */
+typedef struct UniDiffData_ {
+   char *name;       /**< Name of the diff (read from XML). */
+   char *filename;   /**< Filename of the diff. */
+   int parsed;       /**< Whether or not the hunks have been parsed. */
+   UniHunk_t *hunks; /**< Array (array.h) of the parsed hunks, to be copied when applied. */
+} UniDiffData_t;
+static UniDiffData_t *diff_available = NULL; /**< Available diffs. */
+
+/*
+ * Dirty flags, what has to be recomputed once the diffs are applied.
+ */
+#define DIFF_DIRTY_MAP        (1<<0) /**< Map and overlay information changed. */
+#define DIFF_DIRTY_SAFELANES  (1<<1) /**< Safe lanes have to be recomputed. */
+#define DIFF_DIRTY_ECONOMY    (1<<2) /**< Economy and commodity prices have to be recomputed. */
+#define DIFF_DIRTY_GFX        (1<<3) /**< Graphics of the current system have to be reloaded. */
+#define DIFF_DIRTY_NAV        (1<<4) /**< Spob and jump indices changed, targets have to be reset. */
+
 /*
  * Diff stack.
  */
 static UniDiff_t *diff_stack = NULL; /**< Currently applied universe diffs. */
 
 /* Useful variables. */
-static int diff_universe_changed = 0; /**< Whether or not the universe changed. */
-static int diff_universe_defer = 0; /**< Defers changes to later. */
+static unsigned int diff_universe_changed = 0; /**< What the applied hunks changed (DIFF_DIRTY_*). */
+static int diff_transaction = 0; /**< Depth of nested diff_begin calls. */
+static int diff_presence_full = 0; /**< Whether or not all the presence has to be reconstructed. */
+static int *diff_presence_factions = NULL; /**< Array (array.h) of the factions whose presence changed. */
 static const char *diff_nav_spob = NULL; /**< Stores the player's spob target if necessary. */
 static const char *diff_nav_hyperspace = NULL; /**< Stores the player's hyperspace target if necessary. */
 
 /*
  * Prototypes.
  */
-static int diff_applyInternal( const char *name, int oneshot );
+static int diff_applyInternal( const char *name );
 NONNULL( 1 ) static UniDiff_t *diff_get( const char *name );
 static UniDiff_t *diff_newDiff (void);
 static int diff_removeDiff( UniDiff_t *diff );
-static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node );
-static int diff_patchTech( UniDiff_t *diff, xmlNodePtr node );
-static int diff_patch( xmlNodePtr parent );
+static int diff_parse( UniDiffData_t *diff );
+static int diff_parseSystem( UniDiffData_t *diff, xmlNodePtr node );
+static int diff_parseTech( UniDiffData_t *diff, xmlNodePtr node );
+static int diff_parseSpob( UniDiffData_t *diff, xmlNodePtr node );
+static int diff_parseFaction( UniDiffData_t *diff, xmlNodePtr node );
+static void diff_parseHunk( UniDiffData_t *diff, const UniHunk_t *hunk );
+static int diff_patch( const UniDiffData_t *data );
 static int diff_patchHunk( UniHunk_t *hunk );
 static void diff_hunkFailed( UniDiff_t *diff, const UniHunk_t *hunk );
 static void diff_hunkSuccess( UniDiff_t *diff, const UniHunk_t *hunk );
 static void diff_cleanup( UniDiff_t *diff );
 static void diff_cleanupHunk( UniHunk_t *hunk );
+static int diff_hunkHasName( UniHunkType_t type );
 /* Misc. */
 static int diff_checkUpdateUniverse (void);
+static unsigned int diff_hunkDirty( UniHunkType_t type );
+static void diff_presenceFaction( int faction );
+static void diff_presenceSpob( const char *name );
+static void diff_presenceVirtualSpob( const char *name );
+static void diff_presenceReset (void);
+static int diff_loadCache( const md5_byte_t key[16] );
+static void diff_saveCache( const md5_byte_t key[16] );
 /* Externed. */
 int diff_save( xmlTextWriterPtr writer ); /**< Used in save.c */
 int diff_load( xmlNodePtr parent ); /**< Used in save.c */
@@ -193,6 +226,60 @@ static int diff_cmp( const void *p1, const void *p2 )
    return strcmp( d1->name, d2->name );
 }
 
+/**
+ * @brief Loads the available diffs from the binary cache.
+ *
+ *    @param key Key the cache has to match.
+ *    @return 0 if the diffs were loaded from the cache.
+ */
+static int diff_loadCache( const md5_byte_t key[16] )
+{
+   NCache nc;
+   uint32_t n;
+
+   if (ncache_open( &nc, UNIDIFF_CACHE, key ) != 0)
+      return -1;
+
+   n = ncache_readU32( &nc );
+   diff_available = array_create( UniDiffData_t );
+   for (uint32_t i=0; (i<n) && !nc.err; i++) {
+      UniDiffData_t *diff = &array_grow(&diff_available);
+      memset( diff, 0, sizeof(UniDiffData_t) );
+      diff->name     = ncache_readStr( &nc );
+      diff->filename = ncache_readStr( &nc );
+      if ((diff->name == NULL) || (diff->filename == NULL))
+         nc.err = 1;
+   }
+   if (nc.err || (nc.pos != nc.size)) {
+      WARN(_("UniDiff cache is corrupt, reparsing the diffs."));
+      for (int i=0; i<array_size(diff_available); i++) {
+         free( diff_available[i].name );
+         free( diff_available[i].filename );
+      }
+      array_free( diff_available );
+      diff_available = NULL;
+   }
+   ncache_close( &nc );
+   return (diff_available==NULL) ? -1 : 0;
+}
+
+/**
+ * @brief Saves the available diffs to the binary cache.
+ *
+ *    @param key Key of the available diffs.
+ */
+static void diff_saveCache( const md5_byte_t key[16] )
+{
+   NCacheWriter w;
+   ncache_writeBegin( &w );
+   ncache_writeU32( &w, array_size(diff_available) );
+   for (int i=0; i<array_size(diff_available); i++) {
+      ncache_writeStr( &w, diff_available[i].name );
+      ncache_writeStr( &w, diff_available[i].filename );
+   }
+   ncache_writeEnd( &w, UNIDIFF_CACHE, key );
+}
+
 /**
  * @brief Loads available universe diffs.
  *
@@ -203,8 +290,20 @@ int diff_loadAvailable (void)
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
+   md5_byte_t key[16];
    char **diff_files = ndata_listRecursive( UNIDIFF_DATA_PATH );
-   diff_available    = array_create_size( UniDiffData_t, array_size( diff_files ) );
+
+   /* Headers only change with the files, so try to skip parsing them. */
+   ncache_key( key, UNIDIFF_CACHE, diff_files );
+   if (diff_loadCache( key )==0) {
+      for (int i=0; i<array_size(diff_files); i++)
+         free( diff_files[i] );
+      array_free( diff_files );
+      diff_files = NULL;
+   }
+   else
+      diff_available = array_create_size( UniDiffData_t, array_size( diff_files ) );
+
    for (int i=0; i<array_size(diff_files); i++ ) {
       xmlDocPtr doc;
       xmlNodePtr node;
@@ -226,12 +325,16 @@ int diff_loadAvailable (void)
       }
 
       diff = &array_grow(&diff_available);
+      memset( diff, 0, sizeof(UniDiffData_t) );
       diff->filename = diff_files[i];
       xmlr_attr_strd(node, "name", diff->name);
       xmlFreeDoc(doc);
    }
-   array_free( diff_files );
-   array_shrink(&diff_available);
+   if (diff_files != NULL) {
+      array_free( diff_files );
+      array_shrink(&diff_available);
+      diff_saveCache( key );
+   }
 
    /* Sort and warn about duplicates. */
    qsort( diff_available, array_size(diff_available), sizeof(UniDiffData_t), diff_cmp );
@@ -288,38 +391,67 @@ static UniDiff_t* diff_get( const char *name )
  */
 int diff_apply( const char *name )
 {
+   int ret;
+   diff_begin();
+   ret = diff_applyInternal( name );
+   diff_commit();
+   return ret;
+}
+
+/**
+ * @brief Starts a diff transaction.
+ *
+ * Diffs applied or removed until the matching diff_commit only gather what
+ *  they change, and the universe is updated once at the end. Transactions
+ *  can be nested, only the outermost one updates the universe.
+ */
+void diff_begin (void)
+{
+   if (diff_transaction++ > 0)
+      return;
+
+   /* Remember the player's targets, indices may change. */
    diff_nav_hyperspace = NULL;
    diff_nav_spob = NULL;
-   if (player.p) {
+   if (player.p && (cur_system != NULL)) {
       if (player.p->nav_hyperspace >= 0)
          diff_nav_hyperspace = cur_system->jumps[ player.p->nav_hyperspace ].target->name;
       if (player.p->nav_spob >= 0)
          diff_nav_spob = cur_system->spobs[ player.p->nav_spob ]->name;
    }
-   return diff_applyInternal( name, 1 );
+}
+
+/**
+ * @brief Ends a diff transaction, updating the universe once if needed.
+ */
+void diff_commit (void)
+{
+   if (diff_transaction <= 0) {
+      WARN(_("diff_commit called without a matching diff_begin!"));
+      return;
+   }
+   if (--diff_transaction > 0)
+      return;
+   diff_checkUpdateUniverse();
 }
 
 /**
  * @brief Applies a diff to the universe.
  *
+ *
+ * The universe is only updated by the diff_commit of the current transaction.
+ *
  *    @param name Diff to apply.
- *    @param oneshot Whether or not this diff should be applied as a single one-shot diff.
  *    @return 0 on success.
  */
-static int diff_applyInternal( const char *name, int oneshot )
+static int diff_applyInternal( const char *name )
 {
-   xmlNodePtr node;
-   xmlDocPtr doc;
    UniDiffData_t *d;
 
    /* Check if already applied. */
    if (diff_isApplied(name))
       return 0;
 
-   /* Reset change variable. */
-   if (oneshot && !diff_universe_defer)
-      diff_universe_changed = 0;
-
    const UniDiffData_t q = { .name = (char*)name };
    d = bsearch( &q, diff_available, array_size(diff_available), sizeof(UniDiffData_t), diff_cmp );
    if (d == NULL) {
@@ -327,34 +459,81 @@ static int diff_applyInternal( const char *name, int oneshot )
       return -1;
    }
 
-   doc = xml_parsePhysFS( d->filename );
+   /* Only read the file the first time. */
+   if (!d->parsed && (diff_parse( d ) != 0))
+      return -1;
+
+   /* Apply it. */
+   diff_patch( d );
+
+   return 0;
+}
+
+/**
+ * @brief Parses the hunks of a diff from its file.
+ *
+ *    @param diff Diff to parse.
+ *    @return 0 on success.
+ */
+static int diff_parse( UniDiffData_t *diff )
+{
+   xmlNodePtr parent, node;
+   xmlDocPtr doc = xml_parsePhysFS( diff->filename );
+   if (doc == NULL)
+      return -1;
 
-   node = doc->xmlChildrenNode;
-   if (strcmp((char*)node->name,"unidiff")) {
+   parent = doc->xmlChildrenNode;
+   if (strcmp((char*)parent->name,"unidiff")) {
       ERR(_("Malformed unidiff file: missing root element 'unidiff'"));
       return 0;
    }
 
-   /* Apply it. */
-   diff_patch( node );
+   diff->hunks = array_create( UniHunk_t );
+   node = parent->xmlChildrenNode;
+   do {
+      xml_onlyNodes(node);
+      if (xml_isNode(node,"system"))
+         diff_parseSystem( diff, node );
+      else if (xml_isNode(node, "tech"))
+         diff_parseTech( diff, node );
+      else if (xml_isNode(node, "spob"))
+         diff_parseSpob( diff, node );
+      else if (xml_isNode(node, "faction"))
+         diff_parseFaction( diff, node );
+      else
+         WARN(_("Unidiff '%s' has unknown node '%s'."), diff->name, node->name);
+   } while (xml_nextNode(node));
+   array_shrink( &diff->hunks );
+   diff->parsed = 1;
 
    xmlFreeDoc(doc);
 
-   /* Update universe. */
-   if (oneshot)
-      diff_checkUpdateUniverse();
-
    return 0;
 }
 
 /**
- * @brief Patches a system.
+ * @brief Adds a parsed hunk to a diff.
  *
- *    @param diff Diff that is doing the patching.
+ *    @param diff Diff to add the hunk to, takes ownership of its data.
+ *    @param hunk Hunk to add.
+ */
+static void diff_parseHunk( UniDiffData_t *diff, const UniHunk_t *hunk )
+{
+   UniHunk_t *h = &array_grow( &diff->hunks );
+   *h = *hunk;
+   if (h->type != HUNK_TYPE_JUMP_ADD)
+      h->node = NULL;
+   memset( &h->o, 0, sizeof(h->o) );
+}
+
+/**
+ * @brief Parses the hunks patching a system.
+ *
+ *    @param diff Diff that is being parsed.
  *    @param node Node containing the system.
  *    @return 0 on success.
  */
-static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node )
+static int diff_parseSystem( UniDiffData_t *diff, xmlNodePtr node )
 {
    UniHunk_t base, hunk;
    xmlNodePtr cur;
@@ -394,11 +573,8 @@ static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node )
          else
             WARN(_("Unidiff '%s': Unknown hunk type '%s' for spob '%s'."), diff->name, buf, hunk.u.name);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"spob_virtual")) {
@@ -422,11 +598,8 @@ static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node )
          else
             WARN(_("Unidiff '%s': Unknown hunk type '%s' for virtual spob '%s'."), diff->name, buf, hunk.u.name);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"jump")) {
@@ -450,13 +623,11 @@ static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node )
          else
             WARN(_("Unidiff '%s': Unknown hunk type '%s' for jump '%s'."), diff->name, buf, hunk.u.name);
 
-         hunk.node = cur;
+         /* The jump is parsed when applied, so keep its node around. */
+         hunk.node = (hunk.type==HUNK_TYPE_JUMP_ADD) ? xmlCopyNode( cur, 1 ) : NULL;
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"background")) {
@@ -465,11 +636,8 @@ static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SSYS_BACKGROUND;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"features")) {
@@ -478,11 +646,8 @@ static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SSYS_FEATURES;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       WARN(_("Unidiff '%s' has unknown node '%s'."), diff->name, node->name);
@@ -496,13 +661,13 @@ static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node )
 }
 
 /**
- * @brief Patches a tech.
+ * @brief Parses the hunks patching a tech.
  *
- *    @param diff Diff that is doing the patching.
+ *    @param diff Diff that is being parsed.
  *    @param node Node containing the tech.
  *    @return 0 on success.
  */
-static int diff_patchTech( UniDiff_t *diff, xmlNodePtr node )
+static int diff_parseTech( UniDiffData_t *diff, xmlNodePtr node )
 {
    UniHunk_t base, hunk;
    xmlNodePtr cur;
@@ -530,11 +695,8 @@ static int diff_patchTech( UniDiff_t *diff, xmlNodePtr node )
          /* Get the data. */
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"remove")) {
@@ -547,11 +709,8 @@ static int diff_patchTech( UniDiff_t *diff, xmlNodePtr node )
          /* Get the data. */
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       WARN(_("Unidiff '%s' has unknown node '%s'."), diff->name, node->name);
@@ -565,13 +724,13 @@ static int diff_patchTech( UniDiff_t *diff, xmlNodePtr node )
 }
 
 /**
- * @brief Patches a spob.
+ * @brief Parses the hunks patching a spob.
  *
- *    @param diff Diff that is doing the patching.
+ *    @param diff Diff that is being parsed.
  *    @param node Node containing the spob.
  *    @return 0 on success.
  */
-static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
+static int diff_parseSpob( UniDiffData_t *diff, xmlNodePtr node )
 {
    UniHunk_t base, hunk;
    xmlNodePtr cur;
@@ -595,11 +754,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_FACTION;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"population")) {
@@ -608,11 +764,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_POPULATION;
          hunk.u.data = xml_getUInt(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"displayname")) {
@@ -621,11 +774,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_DISPLAYNAME;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"description")) {
@@ -634,11 +784,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_DESCRIPTION;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"bar")) {
@@ -647,11 +794,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_BAR;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"service_add")) {
@@ -660,11 +804,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_SERVICE_ADD;
          hunk.u.data = spob_getService( xml_get(cur) );
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"service_remove")) {
@@ -673,11 +814,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_SERVICE_REMOVE;
          hunk.u.data = spob_getService( xml_get(cur) );
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"nomissionspawn_add")) {
@@ -685,11 +823,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.target.u.name = strdup(base.target.u.name);
          hunk.type = HUNK_TYPE_SPOB_NOMISNSPAWN_ADD;
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"nomissionspawn_remove")) {
@@ -697,11 +832,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.target.u.name = strdup(base.target.u.name);
          hunk.type = HUNK_TYPE_SPOB_NOMISNSPAWN_REMOVE;
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"tech_add")) {
@@ -710,11 +842,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_TECH_ADD;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"tech_remove")) {
@@ -723,11 +852,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_TECH_REMOVE;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"tag_add")) {
@@ -736,11 +862,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_TAG_ADD;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"tag_remove")) {
@@ -749,11 +872,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          hunk.type = HUNK_TYPE_SPOB_TAG_REMOVE;
          hunk.u.name = xml_getStrd(cur);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"gfx_space")) {
@@ -764,11 +884,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          snprintf( str, sizeof(str), SPOB_GFX_SPACE_PATH"%s", xml_get(cur));
          hunk.u.name = strdup(str);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"gfx_exterior")) {
@@ -779,11 +896,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          snprintf( str, sizeof(str), SPOB_GFX_EXTERIOR_PATH"%s", xml_get(cur));
          hunk.u.name = strdup(str);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"lua")) {
@@ -797,11 +911,8 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
          else
             hunk.u.name = NULL;
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       WARN(_("Unidiff '%s' has unknown node '%s'."), diff->name, cur->name);
@@ -815,13 +926,13 @@ static int diff_patchSpob( UniDiff_t *diff, xmlNodePtr node )
 }
 
 /**
- * @brief Patches a faction.
+ * @brief Parses the hunks patching a faction.
  *
- *    @param diff Diff that is doing the patching.
+ *    @param diff Diff that is being parsed.
  *    @param node Node containing the spob.
  *    @return 0 on success.
  */
-static int diff_patchFaction( UniDiff_t *diff, xmlNodePtr node )
+static int diff_parseFaction( UniDiffData_t *diff, xmlNodePtr node )
 {
    UniHunk_t base, hunk;
    xmlNodePtr cur;
@@ -850,11 +961,8 @@ static int diff_patchFaction( UniDiff_t *diff, xmlNodePtr node )
          /* There is no name. */
          hunk.u.name = NULL;
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"invisible")) {
@@ -867,11 +975,8 @@ static int diff_patchFaction( UniDiff_t *diff, xmlNodePtr node )
          /* There is no name. */
          hunk.u.name = NULL;
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       else if (xml_isNode(cur,"faction")) {
@@ -897,11 +1002,8 @@ static int diff_patchFaction( UniDiff_t *diff, xmlNodePtr node )
          else
             WARN(_("Unidiff '%s': Unknown hunk type '%s' for faction '%s'."), diff->name, buf, hunk.u.name);
 
-         /* Apply diff. */
-         if (diff_patchHunk( &hunk ) < 0)
-            diff_hunkFailed( diff, &hunk );
-         else
-            diff_hunkSuccess( diff, &hunk );
+         /* Store the hunk. */
+         diff_parseHunk( diff, &hunk );
          continue;
       }
       WARN(_("Unidiff '%s' has unknown node '%s'."), diff->name, node->name);
@@ -915,42 +1017,33 @@ static int diff_patchFaction( UniDiff_t *diff, xmlNodePtr node )
 }
 
 /**
- * @brief Actually applies a diff in XML node form.
+ * @brief Actually applies the parsed hunks of a diff.
  *
- *    @param parent Node containing the diff information.
+ *    @param data Parsed diff to apply.
  *    @return 0 on success.
  */
-static int diff_patch( xmlNodePtr parent )
+static int diff_patch( const UniDiffData_t *data )
 {
    UniDiff_t *diff;
-   xmlNodePtr node;
    int nfailed;
 
    /* Prepare it. */
    diff = diff_newDiff();
    memset(diff, 0, sizeof(UniDiff_t));
-   xmlr_attr_strd(parent,"name",diff->name);
+   diff->name = strdup( data->name );
 
-   node = parent->xmlChildrenNode;
-   do {
-      xml_onlyNodes(node);
-      if (xml_isNode(node,"system")) {
-         diff_universe_changed = 1;
-         diff_patchSystem( diff, node );
-      }
-      else if (xml_isNode(node, "tech"))
-         diff_patchTech( diff, node );
-      else if (xml_isNode(node, "spob")) {
-         diff_universe_changed = 1;
-         diff_patchSpob( diff, node );
-      }
-      else if (xml_isNode(node, "faction")) {
-         diff_universe_changed = 1;
-         diff_patchFaction( diff, node );
-      }
+   /* Applied hunks own their data, so work on copies. */
+   for (int i=0; i<array_size(data->hunks); i++) {
+      UniHunk_t hunk = data->hunks[i];
+      hunk.target.u.name = strdup( hunk.target.u.name );
+      if (diff_hunkHasName( hunk.type ) && (hunk.u.name != NULL))
+         hunk.u.name = strdup( hunk.u.name );
+
+      if (diff_patchHunk( &hunk ) < 0)
+         diff_hunkFailed( diff, &hunk );
       else
-         WARN(_("Unidiff '%s' has unknown node '%s'."), diff->name, node->name);
-   } while (xml_nextNode(node));
+         diff_hunkSuccess( diff, &hunk );
+   }
 
    nfailed = array_size(diff->failed);
    if (nfailed > 0) {
@@ -1130,34 +1223,36 @@ static int diff_patchHunk( UniHunk_t *hunk )
    StarSystem *ssys;
    int a, b;
 
+   diff_universe_changed |= diff_hunkDirty( hunk->type );
+
    switch (hunk->type) {
 
       /* Adding an spob. */
       case HUNK_TYPE_SPOB_ADD:
          spob_luaInit( spob_get(hunk->u.name) );
-         diff_universe_changed = 1;
+         diff_presenceSpob( hunk->u.name );
          return system_addSpob( system_get(hunk->target.u.name), hunk->u.name );
       /* Removing an spob. */
       case HUNK_TYPE_SPOB_REMOVE:
-         diff_universe_changed = 1;
+         diff_presenceSpob( hunk->u.name );
          return system_rmSpob( system_get(hunk->target.u.name), hunk->u.name );
 
       /* Adding an spob. */
       case HUNK_TYPE_VSPOB_ADD:
-         diff_universe_changed = 1;
+         diff_presenceVirtualSpob( hunk->u.name );
          return system_addVirtualSpob( system_get(hunk->target.u.name), hunk->u.name );
       /* Removing an spob. */
       case HUNK_TYPE_VSPOB_REMOVE:
-         diff_universe_changed = 1;
+         diff_presenceVirtualSpob( hunk->u.name );
          return system_rmVirtualSpob( system_get(hunk->target.u.name), hunk->u.name );
 
       /* Adding a Jump. */
       case HUNK_TYPE_JUMP_ADD:
-         diff_universe_changed = 1;
+         diff_presence_full = 1;
          return system_addJumpDiff( system_get(hunk->target.u.name), hunk->node );
       /* Removing a jump. */
       case HUNK_TYPE_JUMP_REMOVE:
-         diff_universe_changed = 1;
+         diff_presence_full = 1;
          return system_rmJump( system_get(hunk->target.u.name), hunk->u.name );
 
       /* Changing system background. */
@@ -1198,13 +1293,16 @@ static int diff_patchHunk( UniHunk_t *hunk )
             hunk->o.name = NULL;
          else
             hunk->o.name = faction_name( p->presence.faction );
-         diff_universe_changed = 1;
+         diff_presenceFaction( p->presence.faction );
+         diff_presenceFaction( faction_get(hunk->u.name) );
          return spob_setFaction( p, faction_get(hunk->u.name) );
       case HUNK_TYPE_SPOB_FACTION_REMOVE:
          p = spob_get( hunk->target.u.name );
          if (p==NULL)
             return -1;
-         diff_universe_changed = 1;
+         diff_presenceFaction( p->presence.faction );
+         if (hunk->o.name!=NULL)
+            diff_presenceFaction( faction_get(hunk->o.name) );
          if (hunk->o.name==NULL)
             return spob_setFaction( p, -1 );
          else
@@ -1278,7 +1376,6 @@ static int diff_patchHunk( UniHunk_t *hunk )
          if (spob_hasService( p, hunk->u.data ))
             return -1;
          spob_addService( p, hunk->u.data );
-         diff_universe_changed = 1;
          return 0;
       case HUNK_TYPE_SPOB_SERVICE_REMOVE:
          p = spob_get( hunk->target.u.name );
@@ -1287,7 +1384,6 @@ static int diff_patchHunk( UniHunk_t *hunk )
          if (!spob_hasService( p, hunk->u.data ))
             return -1;
          spob_rmService( p, hunk->u.data );
-         diff_universe_changed = 1;
          return 0;
 
       /* Modifying mission spawn. */
@@ -1359,14 +1455,12 @@ static int diff_patchHunk( UniHunk_t *hunk )
             return -1;
          hunk->o.name = p->gfx_spaceName;
          p->gfx_spaceName = hunk->u.name;
-         diff_universe_changed = 1;
          return 0;
       case HUNK_TYPE_SPOB_SPACE_REVERT:
          p = spob_get( hunk->target.u.name );
          if (p==NULL)
             return -1;
          p->gfx_spaceName = (char*)hunk->o.name;
-         diff_universe_changed = 1;
          return 0;
 
       /* Changing spob exterior graphics. */
@@ -1392,7 +1486,6 @@ static int diff_patchHunk( UniHunk_t *hunk )
          hunk->o.name = p->lua_file;
          p->lua_file = hunk->u.name;
          spob_luaInit( p );
-         diff_universe_changed = 1;
          return 0;
       case HUNK_TYPE_SPOB_LUA_REVERT:
          p = spob_get( hunk->target.u.name );
@@ -1400,7 +1493,6 @@ static int diff_patchHunk( UniHunk_t *hunk )
             return -1;
          p->lua_file = (char*)hunk->o.name;
          spob_luaInit( p );
-         diff_universe_changed = 1;
          return 0;
 
       /* Making a faction visible. */
@@ -1524,9 +1616,9 @@ void diff_remove( const char *name )
    if (diff == NULL)
       return;
 
+   diff_begin();
    diff_removeDiff(diff);
-
-   diff_checkUpdateUniverse();
+   diff_commit();
 }
 
 /**
@@ -1534,12 +1626,12 @@ void diff_remove( const char *name )
  */
 void diff_clear (void)
 {
+   diff_begin();
    while (array_size(diff_stack) > 0)
       diff_removeDiff(&diff_stack[array_size(diff_stack)-1]);
    array_free( diff_stack );
    diff_stack = NULL;
-
-   diff_checkUpdateUniverse();
+   diff_commit();
 }
 
 /**
@@ -1552,9 +1644,15 @@ void diff_free (void)
       UniDiffData_t *d = &diff_available[i];
       free( d->name );
       free( d->filename );
+      for (int j=0; j<array_size(d->hunks); j++) {
+         xmlFreeNode( d->hunks[j].node );
+         diff_cleanupHunk( &d->hunks[j] );
+      }
+      array_free( d->hunks );
    }
    array_free(diff_available);
    diff_available = NULL;
+   diff_presenceReset();
 }
 
 /**
@@ -1735,7 +1833,22 @@ static void diff_cleanupHunk( UniHunk_t *hunk )
    free(hunk->target.u.name);
    hunk->target.u.name = NULL;
 
-   switch (hunk->type) { /* TODO: Does it really matter? */
+   if (diff_hunkHasName( hunk->type )) {
+      free(hunk->u.name);
+      hunk->u.name = NULL;
+   }
+   memset( hunk, 0, sizeof(UniHunk_t) );
+}
+
+/**
+ * @brief Checks to see if the data of a hunk type is a string.
+ *
+ *    @param type Type of hunk to check.
+ *    @return 1 if the hunk uses u.name, 0 if it uses u.data.
+ */
+static int diff_hunkHasName( UniHunkType_t type )
+{
+   switch (type) {
       case HUNK_TYPE_SPOB_ADD:
       case HUNK_TYPE_SPOB_REMOVE:
       case HUNK_TYPE_VSPOB_ADD:
@@ -1770,14 +1883,11 @@ static void diff_cleanupHunk( UniHunk_t *hunk )
       case HUNK_TYPE_FACTION_ENEMY:
       case HUNK_TYPE_FACTION_NEUTRAL:
       case HUNK_TYPE_FACTION_REALIGN:
-         free(hunk->u.name);
-         hunk->u.name = NULL;
-         break;
+         return 1;
 
       default:
-         break;
+         return 0;
    }
-   memset( hunk, 0, sizeof(UniHunk_t) );
 }
 
 /**
@@ -1810,15 +1920,12 @@ int diff_save( xmlTextWriterPtr writer )
 int diff_load( xmlNodePtr parent )
 {
    xmlNodePtr node;
-   int defer = diff_universe_defer;
 
-   /* Don't update universe here. */
-   diff_universe_defer = 1;
-   diff_universe_changed = 0;
+   /* Update the universe only once for all the diffs. */
+   diff_begin();
    diff_nav_spob = NULL;
    diff_nav_hyperspace = NULL;
    diff_clear();
-   diff_universe_defer = defer;
 
    node = parent->xmlChildrenNode;
    do {
@@ -1831,14 +1938,14 @@ int diff_load( xmlNodePtr parent )
                   WARN( _( "Expected node \"diff\" to contain the name of a unidiff. Was empty." ) );
                   continue;
                }
-               diff_applyInternal( diffName, 0 );
+               diff_applyInternal( diffName );
             }
          } while (xml_nextNode(cur));
       }
    } while (xml_nextNode(node));
 
    /* Update as necessary. */
-   diff_checkUpdateUniverse();
+   diff_commit();
 
    return 0;
 }
@@ -1849,24 +1956,38 @@ int diff_load( xmlNodePtr parent )
 static int diff_checkUpdateUniverse (void)
 {
    Pilot *const* pilots;
+   unsigned int dirty = diff_universe_changed;
 
-   if (!diff_universe_changed || diff_universe_defer)
+   if (!dirty || (diff_transaction > 0))
       return 0;
+   diff_universe_changed = 0;
 
    /* Update presences, then safelanes. */
-   space_reconstructPresences();
-   safelanes_recalculate();
+   if (diff_presence_full)
+      space_reconstructPresences();
+   else if (array_size(diff_presence_factions) > 0)
+      space_reconstructPresencesFactions( diff_presence_factions );
+   diff_presenceReset();
+   if (dirty & DIFF_DIRTY_SAFELANES)
+      safelanes_recalculate();
+   map_tilesInvalidate();
+   map_system_invalidate();
 
    /* Re-compute the economy. */
-   economy_execQueued();
-   economy_initialiseCommodityPrices();
+   if (dirty & DIFF_DIRTY_ECONOMY) {
+      economy_execQueued();
+      economy_initialiseCommodityPrices();
+   }
 
    /* Have to update planet graphics if necessary. */
-   if (cur_system != NULL) {
+   if ((dirty & DIFF_DIRTY_GFX) && (cur_system != NULL)) {
       space_gfxUnload( cur_system );
       space_gfxLoad( cur_system );
    }
 
+   if (!(dirty & DIFF_DIRTY_NAV))
+      return 1;
+
    /* Have to pilot targetting just in case. */
    pilots = pilot_getAll();
    for (int i=0; i<array_size(pilots); i++) {
@@ -1921,19 +2042,130 @@ static int diff_checkUpdateUniverse (void)
    else
       player_targetHyperspaceSet( -1, 0 );
 
-   diff_universe_changed = 0;
    return 1;
 }
 
 /**
- * @brief Sets whether or not to defer universe change stuff.
+ * @brief Gets what has to be recomputed after applying a type of hunk.
  *
- *    @param enable Whether or not to enable deferring.
+ *    @param type Type of the hunk.
+ *    @return Dirty flags (DIFF_DIRTY_*) of the hunk.
+ */
+static unsigned int diff_hunkDirty( UniHunkType_t type )
+{
+   switch (type) {
+      case HUNK_TYPE_SPOB_ADD:
+      case HUNK_TYPE_SPOB_REMOVE:
+      case HUNK_TYPE_JUMP_ADD:
+      case HUNK_TYPE_JUMP_REMOVE:
+         return DIFF_DIRTY_MAP | DIFF_DIRTY_SAFELANES | DIFF_DIRTY_ECONOMY | DIFF_DIRTY_GFX | DIFF_DIRTY_NAV;
+
+      case HUNK_TYPE_VSPOB_ADD:
+      case HUNK_TYPE_VSPOB_REMOVE:
+      case HUNK_TYPE_SPOB_FACTION:
+      case HUNK_TYPE_SPOB_FACTION_REMOVE:
+      case HUNK_TYPE_SPOB_SERVICE_ADD:
+      case HUNK_TYPE_SPOB_SERVICE_REMOVE:
+      case HUNK_TYPE_FACTION_VISIBLE:
+      case HUNK_TYPE_FACTION_INVISIBLE:
+      case HUNK_TYPE_FACTION_ALLY:
+      case HUNK_TYPE_FACTION_ENEMY:
+      case HUNK_TYPE_FACTION_NEUTRAL:
+      case HUNK_TYPE_FACTION_REALIGN:
+         return DIFF_DIRTY_MAP | DIFF_DIRTY_SAFELANES | DIFF_DIRTY_ECONOMY;
+
+      case HUNK_TYPE_SPOB_POPULATION:
+      case HUNK_TYPE_SPOB_POPULATION_REMOVE:
+         return DIFF_DIRTY_MAP | DIFF_DIRTY_ECONOMY;
+
+      case HUNK_TYPE_SPOB_SPACE:
+      case HUNK_TYPE_SPOB_SPACE_REVERT:
+      case HUNK_TYPE_SPOB_LUA:
+      case HUNK_TYPE_SPOB_LUA_REVERT:
+         return DIFF_DIRTY_MAP | DIFF_DIRTY_GFX;
+
+      case HUNK_TYPE_SSYS_BACKGROUND:
+      case HUNK_TYPE_SSYS_BACKGROUND_REVERT:
+      case HUNK_TYPE_SSYS_FEATURES:
+      case HUNK_TYPE_SSYS_FEATURES_REVERT:
+      case HUNK_TYPE_SPOB_DISPLAYNAME:
+      case HUNK_TYPE_SPOB_DISPLAYNAME_REVERT:
+      case HUNK_TYPE_SPOB_DESCRIPTION:
+      case HUNK_TYPE_SPOB_DESCRIPTION_REVERT:
+      case HUNK_TYPE_SPOB_BAR:
+      case HUNK_TYPE_SPOB_BAR_REVERT:
+      case HUNK_TYPE_SPOB_NOMISNSPAWN_ADD:
+      case HUNK_TYPE_SPOB_NOMISNSPAWN_REMOVE:
+      case HUNK_TYPE_SPOB_TECH_ADD:
+      case HUNK_TYPE_SPOB_TECH_REMOVE:
+      case HUNK_TYPE_SPOB_TAG_ADD:
+      case HUNK_TYPE_SPOB_TAG_REMOVE:
+      case HUNK_TYPE_SPOB_EXTERIOR:
+      case HUNK_TYPE_SPOB_EXTERIOR_REVERT:
+         return DIFF_DIRTY_MAP;
+
+      case HUNK_TYPE_NONE:
+      case HUNK_TYPE_TECH_ADD:
+      case HUNK_TYPE_TECH_REMOVE:
+         return 0;
+   }
+   return 0;
+}
+
+/**
+ * @brief Marks the presence of a faction as changed by the diffs.
+ *
+ *    @param faction Faction whose spobs changed.
+ */
+static void diff_presenceFaction( int faction )
+{
+   if (faction < 0)
+      return;
+   if (diff_presence_factions == NULL)
+      diff_presence_factions = array_create( int );
+   for (int i=0; i<array_size(diff_presence_factions); i++)
+      if (diff_presence_factions[i] == faction)
+         return;
+   array_push_back( &diff_presence_factions, faction );
+}
+
+/**
+ * @brief Marks the presence of the faction of a spob as changed by the diffs.
+ *
+ *    @param name Name of the spob being added or removed.
+ */
+static void diff_presenceSpob( const char *name )
+{
+   const Spob *p = spob_get( name );
+   if (p == NULL)
+      diff_presence_full = 1;
+   else
+      diff_presenceFaction( p->presence.faction );
+}
+
+/**
+ * @brief Marks the presence of the factions of a virtual spob as changed by
+ *        the diffs.
+ *
+ *    @param name Name of the virtual spob being added or removed.
+ */
+static void diff_presenceVirtualSpob( const char *name )
+{
+   const VirtualSpob *va = virtualspob_get( name );
+   if (va == NULL) {
+      diff_presence_full = 1;
+      return;
+   }
+   for (int i=0; i<array_size(va->presences); i++)
+      diff_presenceFaction( va->presences[i].faction );
+}
+
+/**
+ * @brief Clears the presence changes made by the diffs.
  */
-void unidiff_universeDefer( int enable )
+static void diff_presenceReset (void)
 {
-   int defer = diff_universe_defer;
-   diff_universe_defer = enable;
-   if (defer && !enable)
-      diff_checkUpdateUniverse();
+   diff_presence_full = 0;
+   array_free( diff_presence_factions );
+   diff_presence_factions = NULL;
 }
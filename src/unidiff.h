@@ -11,4 +11,5 @@ NONNULL( 1 ) void diff_remove( const char *name );
 void diff_clear (void);
 void diff_free (void);
 NONNULL( 1 ) int diff_isApplied( const char *name );
-void unidiff_universeDefer( int enable );
+void diff_begin (void);
+void diff_commit (void);
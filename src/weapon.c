@@ -25,6 +25,7 @@
 #include "explosion.h"
 #include "gui.h"
 #include "log.h"
+#include "memstats.h"
 #include "ntracing.h"
 #include "nstring.h"
 #include "nlua_pilot.h"
@@ -35,6 +36,7 @@
 #include "player.h"
 #include "rng.h"
 #include "spfx.h"
+#include "threadpool.h"
 #include "intlist.h"
 
 /**
@@ -48,6 +50,7 @@ typedef struct WeaponCollision_ {
    double beamrange;       /**< Range of the weapon if beam. */
    const CollPoly *polygon;/**< Collision polygon of the weapon if applicable. */
    int explosion;          /**< Collision is an explosion. */
+   int ccd;                /**< Should test the whole movement of the weapon. */
 } WeaponCollision;
 
 /**
@@ -63,8 +66,39 @@ typedef struct WeaponHit_ {
    const vec2 *pos; /* Location of the hit, can be 2d array in the case of beams. */
 } WeaponHit;
 
+/**
+ * @brief Potential hit found while looking for weapon collisions.
+ *
+ * Gets validated again when applied, since earlier hits may have changed
+ * the state of the target.
+ */
+typedef struct WeaponCandidate_ {
+   int weapon;          /**< Index of the weapon in the weapon stack. */
+   int expired;         /**< Weapon ran out of time and has to miss instead. */
+   TargetType type;     /**< Class of object hit. */
+   union {
+      Pilot    *plt;    /**< Hit a pilot. */
+      Asteroid *ast;    /**< Hit an asteroid. */
+      int      wpn;     /**< Index of the weapon hit in the weapon stack. */
+   } u;
+   vec2 crash[2];       /**< Location of the hit. */
+} WeaponCandidate;
+
+/**
+ * @brief Partition of the weapon stack for the threaded collision pass.
+ */
+typedef struct WeaponCollideChunk_ {
+   int start;              /**< First weapon to process. */
+   int end;                /**< One past the last weapon to process. */
+   double dt;              /**< Current delta tick. */
+   IntList qtquery;        /**< For querying collisions. */
+   QuadtreeScratch qtscratch; /**< Scratch memory for the quadtree queries. */
+   WeaponCandidate *cands; /**< Found candidates ordered by weapon (array.h). */
+} WeaponCollideChunk;
+
 /* Weapon layers. */
 static Weapon* weapon_stack = NULL; /**< All the weapon munitions are piled up here. */
+static vec2 *weapon_interpSaved = NULL; /**< Real positions while rendering interpolated (array.h). */
 
 /* Graphics. */
 static gl_vbo  *weapon_vbo     = NULL; /**< Weapon VBO. */
@@ -75,8 +109,50 @@ static size_t weapon_vboSize   = 0; /**< Size of the VBO. */
 static unsigned int weapon_idgen = 0; /**< Weapon identifier generator. */
 static int qt_init = 0; /**< Whether or not the quadtree was created. */
 static Quadtree weapon_quadtree; /**< Quadtree for weapons. */
+/**
+ * @brief Owner of a weapon quadtree element, used to update the tree incrementally.
+ */
+typedef struct WeaponQtElem_ {
+   unsigned int id;  /**< ID of the weapon owning the element, 0 if unused. */
+   int seen;         /**< Whether or not the element was updated in the current purge. */
+} WeaponQtElem;
+static WeaponQtElem *weapon_qtElems = NULL; /**< Owners indexed by quadtree element (array.h). */
 static IntList weapon_qtquery; /**< For querying collisions. */
 static IntList weapon_qtexp; /**< For querying collisions from explosions. */
+static IntList weapon_qtexpw; /**< For querying munitions hit by explosions. */
+static QuadtreeScratch weapon_qtscratch; /**< Scratch memory for serial collision queries. */
+static WeaponCandidate *weapon_collideCands = NULL; /**< Candidates for serial collisions (array.h). */
+static Solid **weapon_solids = NULL; /**< Solids integrated together in weapons_update (array.h). */
+
+/**
+ * @brief State of a seeker target, fetched once for all the missiles chasing it.
+ */
+typedef struct SeekerTarget_ {
+   int valid;           /**< Whether or not the pilot exists. */
+   vec2 pos;            /**< Position of the target. */
+   vec2 vel;            /**< Velocity of the target. */
+   double jam_chance;   /**< Jamming chance of the target. */
+   double ew_signature; /**< Signature of the target, limits the jamming range. */
+} SeekerTarget;
+/**
+ * @brief Seeker thinking in the grouped pass.
+ */
+typedef struct SeekerEntry_ {
+   int w;            /**< Index of the seeker in the weapon stack. */
+   int tgt;          /**< Index of its target in weapon_seekerTargets. */
+   int steer;        /**< Whether it steers this frame, -1 if the target is gone. */
+} SeekerEntry;
+static SeekerEntry *weapon_seekers = NULL; /**< Seekers with a pilot target, in stack order (array.h). */
+static uint64_t *weapon_seekerOrder = NULL; /**< Target ID and seeker index, sorted to group them by target (array.h). */
+static SeekerTarget *weapon_seekerTargets = NULL; /**< Targets of the seekers this frame (array.h). */
+
+/* Threaded collisions. */
+static ThreadQueue *weapon_collideQueue = NULL; /**< Queue used for threaded collisions. */
+static WeaponCollideChunk *weapon_collideChunks = NULL; /**< Work partitions, not moved since they hold IntList. */
+static int weapon_ncollideChunks = 0; /**< Number of work partitions. */
+#define WEAPON_COLLIDE_THREADED_MIN 512 /**< Minimum number of weapons to bother with threads. */
+#define WEAPON_COLLIDE_CHUNK_MIN    128 /**< Minimum weapons per thread partition. */
+#define WEAPON_BEAM_PIECE           512. /**< Length of the pieces beams are split in for the spatial queries. */
 
 /*
  * Prototypes
@@ -99,8 +175,22 @@ static double weapon_computeTimes( double rdir, double rx, double ry, double dvx
       double vmin, double acc, double *tt );
 /* Updating. */
 static void weapon_render( Weapon* w, double dt );
+static int weapon_updateTimer( Weapon* w, double dt );
+static void weapon_expire( Weapon* w );
+static void weapon_collideSetup( Weapon* w, WeaponCollision *wc, int *x1, int *y1, int *x2, int *y2 );
+static void weapon_collideFind( const Weapon* w, int wid, const WeaponCollision *wc,
+      int x1, int y1, int x2, int y2, IntList *qtquery, QuadtreeScratch *qtscratch,
+      WeaponCandidate **cands );
+static int weapon_beamPieces( const WeaponCollision *wc );
+static void weapon_beamPiece( const Weapon *w, const WeaponCollision *wc, int k, int n,
+      int *x1, int *y1, int *x2, int *y2 );
+static int weapon_candFound( WeaponCandidate *const* cands, int start, TargetType type,
+      const void *obj, int wpn );
+static int weapon_collideValid( const Weapon* w, const WeaponCandidate *cand );
+static void weapon_collideApply( const WeaponCandidate *cands, int n, double dt );
+static int weapons_updateCollideThread( void *data );
 static void weapon_updateCollide( Weapon* w, double dt );
-static void weapon_update( Weapon* w, double dt );
+static void weapon_updateMoved( Weapon* w );
 static void weapon_sample_trail( Weapon* w );
 /* Destruction. */
 static void weapon_destroy( Weapon* w );
@@ -108,13 +198,24 @@ static void weapon_free( Weapon* w );
 /* Hitting. */
 static int weapon_checkCanHit( const Weapon* w, const Pilot *p );
 static void weapon_damage( Weapon *w, const Damage *dmg );
+static void weapon_explodeMunitions( double x, double y, double radius,
+      const Damage *dmg, const Pilot *parent, int friendlyfire, const Weapon *skip );
 static void weapon_hit( Weapon *w, const WeaponHit *hit );
 static void weapon_hitBeam( Weapon* w, const WeaponHit *hit, double dt );
 static void weapon_miss( Weapon *w );
 static int weapon_testCollision( const WeaponCollision *wc, const glTexture *ctex,
    int csx, int csy, const Solid *csol, const CollPoly *cpol, double cradius, vec2 crash[2] );
+static int weapon_testCollisionStatic( const WeaponCollision *wc, const glTexture *ctex,
+   int csx, int csy, const Solid *csol, const CollPoly *cpol, double cradius, vec2 crash[2] );
+static int weapon_testCollisionSwept( const WeaponCollision *wc, const glTexture *ctex,
+   int csx, int csy, const Solid *csol, const CollPoly *cpol, double cradius, vec2 crash[2] );
 /* think */
 static void think_seeker( Weapon* w, double dt );
+static int weapon_seekerTarget( SeekerTarget *tgt, unsigned int id );
+static int weapon_seekerStatus( Weapon *w, const SeekerTarget *tgt, double dt );
+static void weapon_seekerSteer( Weapon *w, const SeekerTarget *tgt, int steer, double dt );
+static void weapons_thinkSeekers( double dt );
+static int weapon_cmpSeeker( const void *ptr1, const void *ptr2 );
 static void think_beam( Weapon* w, double dt );
 /* externed */
 void weapon_minimap( double res, double w,
@@ -131,6 +232,22 @@ void weapon_init (void)
    weapon_stack = array_create(Weapon);
    il_create( &weapon_qtquery, 1 );
    il_create( &weapon_qtexp, 1 );
+   il_create( &weapon_qtexpw, 1 );
+   weapon_collideCands = array_create( WeaponCandidate );
+   weapon_qtElems = array_create( WeaponQtElem );
+   weapon_solids = array_create( Solid* );
+   weapon_seekers = array_create( SeekerEntry );
+   weapon_seekerOrder = array_create( uint64_t );
+   weapon_seekerTargets = array_create( SeekerTarget );
+
+   /* Set up the threaded collision partitions. */
+   weapon_ncollideChunks = threadpool_threads();
+   weapon_collideChunks = calloc( weapon_ncollideChunks, sizeof(WeaponCollideChunk) );
+   for (int i=0; i<weapon_ncollideChunks; i++) {
+      WeaponCollideChunk *chunk = &weapon_collideChunks[i];
+      il_create( &chunk->qtquery, 1 );
+      chunk->cands = array_create( WeaponCandidate );
+   }
 }
 
 /**
@@ -153,8 +270,7 @@ static void weapon_updateVBO (void)
       size = sizeof(GLfloat) * (2+4) * weapon_vboSize;
       weapon_vboData = realloc( weapon_vboData, size );
       if (weapon_vbo == NULL)
-         weapon_vbo = gl_vboCreateStream( size, NULL );
-      gl_vboData( weapon_vbo, size, weapon_vboData );
+         weapon_vbo = gl_vboCreateRing( size );
    }
 }
 
@@ -193,6 +309,7 @@ void weapon_newSystem (void)
       qt_destroy( &weapon_quadtree );
    qt_create( &weapon_quadtree, -r, -r, r, r, 4, 6 ); /* TODO tune parameters. */
    qt_init = 1;
+   array_resize( &weapon_qtElems, 0 );
 
    NTracingZoneEnd( _ctx );
 }
@@ -279,18 +396,21 @@ void weapon_minimap( double res, double w,
 
    /* Only render with something to draw. */
    if (p > 0) {
-      /* Upload data changes. */
-      gl_vboSubData( weapon_vbo, 0, sizeof(GLfloat) * 2*p, weapon_vboData );
-      gl_vboSubData( weapon_vbo, offset * sizeof(GLfloat),
-            sizeof(GLfloat) * 4*p, &weapon_vboData[offset] );
+      /* Upload data changes, the colours right after the used vertices. */
+      GLfloat *buf = gl_vboRingMap( weapon_vbo, sizeof(GLfloat) * 6*p );
+      if (buf != NULL) {
+         memcpy( buf, weapon_vboData, sizeof(GLfloat) * 2*p );
+         memcpy( &buf[2*p], &weapon_vboData[offset], sizeof(GLfloat) * 4*p );
+      }
+      gl_vboUnmap( weapon_vbo );
 
       glUseProgram(shaders.points.program);
       glEnableVertexAttribArray(shaders.points.vertex);
       glEnableVertexAttribArray(shaders.points.vertex_colour);
       gl_uniformMat4(shaders.points.projection, &gl_view_matrix);
       gl_vboActivateAttribOffset( weapon_vbo, shaders.points.vertex, 0, 2, GL_FLOAT, 0 );
-      gl_vboActivateAttribOffset( weapon_vbo, shaders.points.vertex_colour, offset * sizeof(GLfloat), 4, GL_FLOAT, 0 );
-      glDrawArrays( GL_POINTS, 0, p );
+      gl_vboActivateAttribOffset( weapon_vbo, shaders.points.vertex_colour, 2*p * sizeof(GLfloat), 4, GL_FLOAT, 0 );
+      gl_drawArrays( GL_POINTS, 0, p );
       glDisableVertexAttribArray(shaders.points.vertex);
       glDisableVertexAttribArray(shaders.points.vertex_colour);
       glUseProgram(0);
@@ -317,30 +437,41 @@ static void weapon_setTurn( Weapon *w, double turn )
 }
 
 /**
- * @brief The AI of seeker missiles.
+ * @brief Gets the state of a seeker target.
  *
- *    @param w Weapon to do the thinking.
- *    @param dt Current delta tick.
+ *    @param[out] tgt State to fill.
+ *    @param id ID of the target pilot.
+ *    @return 0 if the pilot exists.
  */
-static void think_seeker( Weapon* w, double dt )
+static int weapon_seekerTarget( SeekerTarget *tgt, unsigned int id )
 {
-   const Pilot *p;
-   vec2 v;
-   double turn_max, jc, speed_mod;
-
-   if (w->target.type != TARGET_PILOT)
-      return; /* Ignore no targets. */
-
-   p = pilot_get(w->target.u.id); /* No null pilot */
-   if (p==NULL) {
-      weapon_setAccel( w, 0. );
-      weapon_setTurn( w, 0. );
-      return;
-   }
-
+   const Pilot *p = pilot_get( id ); /* No null pilot */
+   memset( tgt, 0, sizeof(SeekerTarget) );
+   if (p==NULL)
+      return -1;
    //ewtrack = pilot_ewWeaponTrack( pilot_get(w->parent), p, w->outfit->u.lau.resist );
+   tgt->valid        = 1;
+   tgt->pos          = p->solid.pos;
+   tgt->vel          = p->solid.vel;
+   tgt->jam_chance   = p->stats.jam_chance;
+   tgt->ew_signature = p->ew_signature;
+   return 0;
+}
+
+/**
+ * @brief Updates the lock on and jamming status of a seeker.
+ *
+ * Jamming rolls random numbers, so this has to be run in stack order.
+ *
+ *    @param w Seeker to update.
+ *    @param tgt Target of the seeker.
+ *    @param dt Current delta tick.
+ *    @return 1 if the seeker steers towards the target this frame.
+ */
+static int weapon_seekerStatus( Weapon *w, const SeekerTarget *tgt, double dt )
+{
+   double jc;
 
-   /* Handle by status. */
    switch (w->status) {
       case WEAPON_STATUS_LOCKING: /* Check to see if we can get a lock on. */
          w->timer2 -= dt;
@@ -352,11 +483,11 @@ static void think_seeker( Weapon* w, double dt )
          break;
 
       case WEAPON_STATUS_OK: /* Check to see if can get jammed */
-         jc = p->stats.jam_chance - w->outfit->u.lau.resist;
+         jc = tgt->jam_chance - w->outfit->u.lau.resist;
          if (jc > 0.) {
             /* Roll based on distance. */
-            double d = vec2_dist( &p->solid.pos, &w->solid.pos );
-            if (d < w->r * p->ew_signature) {
+            double d = vec2_dist( &tgt->pos, &w->solid.pos );
+            if (d < w->r * tgt->ew_signature) {
                if (RNGF() < jc) {
                   double r = RNGF();
                   if (r < 0.3) {
@@ -382,78 +513,96 @@ static void think_seeker( Weapon* w, double dt )
                   w->status = WEAPON_STATUS_UNJAMMED;
             }
          }
-         FALLTHROUGH;
+         return 1;
 
       case WEAPON_STATUS_JAMMED_SLOWED: /* Slowed down. */
       case WEAPON_STATUS_UNJAMMED: /* Work as expected */
-         turn_max = w->outfit->u.lau.turn;// * ewtrack;
-         if (w->status==WEAPON_STATUS_JAMMED_SLOWED)
-            turn_max *= w->falloff;
+         return 1;
 
-         /* Smart seekers take into account ship velocity. */
-         if (w->outfit->u.lau.ai == AMMO_AI_SMART) {
-            /*
-              The control interval is short enough compared to the maximum turn rate,
-              so we can use a bang-bang control.
-            */
-            vec2_csetmin( &v, p->solid.pos.x - w->solid.pos.x,
-                  p->solid.pos.y - w->solid.pos.y );
+      case WEAPON_STATUS_JAMMED: /* Continue doing whatever */
+         /* Do nothing, dir_vel should be set already if needed */
+         break;
+
+      default:
+         WARN(_("Unknown weapon status for '%s'"), w->outfit->name);
+         break;
+   }
+   return 0;
+}
+
+/**
+ * @brief Steers a seeker towards its target and limits its speed.
+ *
+ *    @param w Seeker to steer.
+ *    @param tgt Target of the seeker.
+ *    @param steer Whether or not to turn towards the target.
+ *    @param dt Current delta tick.
+ */
+static void weapon_seekerSteer( Weapon *w, const SeekerTarget *tgt, int steer, double dt )
+{
+   double speed_mod;
+
+   if (steer) {
+      vec2 v;
+      double turn_max = w->outfit->u.lau.turn;// * ewtrack;
+      if (w->status==WEAPON_STATUS_JAMMED_SLOWED)
+         turn_max *= w->falloff;
+
+      /* Smart seekers take into account ship velocity. */
+      if (w->outfit->u.lau.ai == AMMO_AI_SMART) {
+         /*
+           The control interval is short enough compared to the maximum turn rate,
+           so we can use a bang-bang control.
+         */
+         vec2_csetmin( &v, tgt->pos.x - w->solid.pos.x,
+               tgt->pos.y - w->solid.pos.y );
 
 #define QUADRATURE(ref, v) ((v).x * (-(ref).y) + (v).y * (ref).x)
-            if (vec2_dot(&v, &w->solid.vel) < 0) {
+         if (vec2_dot(&v, &w->solid.vel) < 0) {
+            /*
+              The target's behind the weapon.
+              Make U-turn.
+            */
+            if (QUADRATURE(w->solid.vel, v) > 0)
+               weapon_setTurn( w, turn_max );
+            else
+               weapon_setTurn( w, -turn_max );
+         }
+         else {
+            vec2 r_vel;
+            vec2_csetmin( &r_vel, tgt->vel.x - w->solid.vel.x,
+                  tgt->vel.y - w->solid.vel.y);
+            if (vec2_dot(&r_vel, &w->solid.vel) > 0) {
                /*
-                 The target's behind the weapon.
-                 Make U-turn.
+                 The target is going away.
+                 Run parallel to the target.
                */
-               if (QUADRATURE(w->solid.vel, v) > 0)
+               if (QUADRATURE(w->solid.vel, tgt->vel) > 0)
                   weapon_setTurn( w, turn_max );
                else
                   weapon_setTurn( w, -turn_max );
             }
             else {
-               vec2 r_vel;
-               vec2_csetmin( &r_vel, p->solid.vel.x - w->solid.vel.x,
-                     p->solid.vel.y - w->solid.vel.y);
-               if (vec2_dot(&r_vel, &w->solid.vel) > 0) {
-                  /*
-                    The target is going away.
-                    Run parallel to the target.
-                  */
-                  if (QUADRATURE(w->solid.vel, p->solid.vel) > 0)
-                     weapon_setTurn( w, turn_max );
-                  else
-                     weapon_setTurn( w, -turn_max );
-               }
-               else {
-                  /*
-                    Match the horizontal speed of the missile to the target's.
-                    (cf. Proportional navigation)
-                    It assumes that the approaching speed is a positive number.
-                  */
-                  if (QUADRATURE(r_vel, v) < 0)
-                     weapon_setTurn( w, turn_max );
-                  else
-                     weapon_setTurn( w, -turn_max );
-               }
+               /*
+                 Match the horizontal speed of the missile to the target's.
+                 (cf. Proportional navigation)
+                 It assumes that the approaching speed is a positive number.
+               */
+               if (QUADRATURE(r_vel, v) < 0)
+                  weapon_setTurn( w, turn_max );
+               else
+                  weapon_setTurn( w, -turn_max );
             }
-#undef QUADRATURE
-         }
-         /* Other seekers are simplistic. */
-         else {
-            double diff = angle_diff(w->solid.dir, /* Get angle to target pos */
-                  vec2_angle(&w->solid.pos, &p->solid.pos));
-            weapon_setTurn( w, CLAMP( -turn_max, turn_max,
-                  10 * diff * w->outfit->u.lau.turn ));
          }
-         break;
-
-      case WEAPON_STATUS_JAMMED: /* Continue doing whatever */
-         /* Do nothing, dir_vel should be set already if needed */
-         break;
-
-      default:
-         WARN(_("Unknown weapon status for '%s'"), w->outfit->name);
-         break;
+#undef QUADRATURE
+      }
+      /* Other seekers are simplistic. */
+      else {
+         double diff = angle_diff(w->solid.dir, /* Get angle to target pos */
+               vec2_angle(&w->solid.pos, &tgt->pos));
+         weapon_setTurn( w, CLAMP( -turn_max, turn_max,
+               10 * diff * w->outfit->u.lau.turn ));
+      }
    }
 
    /* Slow off based on falloff. */
@@ -467,6 +616,105 @@ static void think_seeker( Weapon* w, double dt )
    //w->solid.speed_max = w->outfit->u.lau.speed * ewtrack;
 }
 
+/**
+ * @brief The AI of seeker missiles.
+ *
+ * weapons_update thinks all the seekers together in weapons_thinkSeekers,
+ *  this is the same for a single one.
+ *
+ *    @param w Weapon to do the thinking.
+ *    @param dt Current delta tick.
+ */
+static void think_seeker( Weapon* w, double dt )
+{
+   SeekerTarget tgt;
+
+   if (w->target.type != TARGET_PILOT)
+      return; /* Ignore no targets. */
+
+   if (weapon_seekerTarget( &tgt, w->target.u.id )) {
+      weapon_setAccel( w, 0. );
+      weapon_setTurn( w, 0. );
+      return;
+   }
+   weapon_seekerSteer( w, &tgt, weapon_seekerStatus( w, &tgt, dt ), dt );
+}
+
+/**
+ * @brief Compares two seekers by target and then stack order.
+ */
+static int weapon_cmpSeeker( const void *ptr1, const void *ptr2 )
+{
+   uint64_t k1 = *(const uint64_t*)ptr1;
+   uint64_t k2 = *(const uint64_t*)ptr2;
+   return (k1 > k2) - (k1 < k2);
+}
+
+/**
+ * @brief Thinks all the seekers targeting pilots, grouped by target.
+ *
+ * Swarms share a few targets, so each target is looked up once per frame.
+ *  The lock on and jamming status are updated in stack order to consume
+ *  random numbers like before, then the steering runs target by target with
+ *  the target state at hand.
+ *
+ *    @param dt Current delta tick.
+ */
+static void weapons_thinkSeekers( double dt )
+{
+   int n = array_size(weapon_seekers);
+   unsigned int id = 0;
+
+   if (n <= 0)
+      return;
+
+   NTracingZone( _ctx, 1 );
+
+   /* Group by target. */
+   array_resize( &weapon_seekerOrder, n );
+   for (int i=0; i<n; i++) {
+      const Weapon *w = &weapon_stack[ weapon_seekers[i].w ];
+      weapon_seekerOrder[i] = ((uint64_t)w->target.u.id << 32) | (uint64_t)i;
+   }
+   qsort( weapon_seekerOrder, n, sizeof(uint64_t), weapon_cmpSeeker );
+
+   /* Look up each target once. */
+   array_resize( &weapon_seekerTargets, 0 );
+   for (int i=0; i<n; i++) {
+      unsigned int tid = weapon_seekerOrder[i] >> 32;
+      SeekerEntry *e = &weapon_seekers[ weapon_seekerOrder[i] & 0xffffffff ];
+      if ((i==0) || (tid != id)) {
+         id = tid;
+         weapon_seekerTarget( &array_grow( &weapon_seekerTargets ), id );
+      }
+      e->tgt = array_size(weapon_seekerTargets)-1;
+   }
+
+   /* Status in stack order. */
+   for (int i=0; i<n; i++) {
+      SeekerEntry *e = &weapon_seekers[i];
+      Weapon *w = &weapon_stack[ e->w ];
+      const SeekerTarget *tgt = &weapon_seekerTargets[ e->tgt ];
+      if (!tgt->valid) {
+         weapon_setAccel( w, 0. );
+         weapon_setTurn( w, 0. );
+         e->steer = -1;
+         continue;
+      }
+      e->steer = weapon_seekerStatus( w, tgt, dt );
+   }
+
+   /* Steering by target. */
+   for (int i=0; i<n; i++) {
+      const SeekerEntry *e = &weapon_seekers[ weapon_seekerOrder[i] & 0xffffffff ];
+      if (e->steer < 0)
+         continue;
+      weapon_seekerSteer( &weapon_stack[ e->w ], &weapon_seekerTargets[ e->tgt ], e->steer, dt );
+   }
+
+   NTracingZoneEnd( _ctx );
+}
+
 /**
  * @brief The pseudo-ai of the beam weapons.
  *
@@ -595,24 +843,32 @@ static void think_beam( Weapon* w, double dt )
  */
 void weapons_updatePurge (void)
 {
-   NTracingZone( _ctx, 1 );
+   int removed, n;
 
-   /* Clear quadtree. */
-   qt_clear( &weapon_quadtree );
+   NTracingZone( _ctx, 1 );
 
-   /* Actually purge and remove weapons. */
-   for (int i=array_size(weapon_stack)-1; i>=0; i--) {
+   /* Actually purge and remove weapons, compacting the stack in a single pass
+    * while keeping the order. */
+   n = 0;
+   for (int i=0; i<array_size(weapon_stack); i++) {
       Weapon *w  = &weapon_stack[i];
-      if (!weapon_isFlag(w,WEAPON_FLAG_DESTROYED))
+      if (weapon_isFlag(w,WEAPON_FLAG_DESTROYED)) {
+         weapon_free( w );
          continue;
-      weapon_free( w );
-      array_erase( &weapon_stack, &weapon_stack[i], &weapon_stack[i+1] );
+      }
+      if (n != i)
+         weapon_stack[n] = *w;
+      n++;
    }
+   array_resize( &weapon_stack, n );
 
-   /* Do a second pass to add the quadtree elements. */
+   /* Do a second pass to update the quadtree elements, only relinking weapons
+    * that moved across leaves. Elements are identified by weapon ID since
+    * the stack gets compacted. */
    for (int i=0; i<array_size(weapon_stack); i++) {
-      const Weapon *w  = &weapon_stack[i];
+      Weapon *w  = &weapon_stack[i];
       int x,y, px,py, w2,h2;
+      int x1, y1, x2, y2;
       const OutfitGFX *gfx;
       double range;
 
@@ -632,76 +888,214 @@ void weapons_updatePurge (void)
       py = round(w->solid.pre.y);
       w2 = ceil(range * 0.5);
       h2 = ceil(range * 0.5);
-      qt_insert( &weapon_quadtree, i, MIN(x,px)-w2, MIN(y,py)-h2, MAX(x,px)+w2, MAX(y,py)+h2 );
+      x1 = MIN(x,px)-w2;
+      y1 = MIN(y,py)-h2;
+      x2 = MAX(x,px)+w2;
+      y2 = MAX(y,py)+h2;
+      if ((w->qt_elem >= 0) && (w->qt_elem < array_size(weapon_qtElems)) &&
+            (weapon_qtElems[w->qt_elem].id == w->id)) {
+         qt_move( &weapon_quadtree, w->qt_elem, x1, y1, x2, y2 );
+         qt_set_id( &weapon_quadtree, w->qt_elem, i );
+      }
+      else {
+         w->qt_elem = qt_insert( &weapon_quadtree, i, x1, y1, x2, y2 );
+         while (array_size(weapon_qtElems) <= w->qt_elem) {
+            WeaponQtElem *we = &array_grow( &weapon_qtElems );
+            we->id   = 0;
+            we->seen = 0;
+         }
+         weapon_qtElems[w->qt_elem].id = w->id;
+      }
+      weapon_qtElems[w->qt_elem].seen = 1;
    }
 
+   /* Remove the elements of weapons that are gone or not hittable. */
+   removed = 0;
+   for (int i=0; i<array_size(weapon_qtElems); i++) {
+      WeaponQtElem *we = &weapon_qtElems[i];
+      if ((we->id != 0) && !we->seen) {
+         qt_remove( &weapon_quadtree, i );
+         we->id = 0;
+         removed = 1;
+      }
+      we->seen = 0;
+   }
+   if (removed)
+      qt_cleanup( &weapon_quadtree );
+   NTracingPlotI( "weapon_qt_nodes", il_size( &weapon_quadtree.nodes ) );
+   NTracingPlotI( "weapon_qt_elems", il_size( &weapon_quadtree.enodes ) );
+
    NTracingZoneEnd( _ctx );
 }
 
 /**
- * @brief Handles weapon collisions.
+ * @brief Updates the timers of a weapon.
+ *
+ * Does not have side effects outside of the weapon so it can be run threaded.
+ *
+ *    @param w Weapon to update.
+ *    @param dt Current delta tick.
+ *    @return 1 if the weapon ran out of time and has to be expired with weapon_expire.
  */
-void weapons_updateCollide( double dt )
+static int weapon_updateTimer( Weapon* w, double dt )
 {
-   NTracingZone( _ctx, 1 );
-   NTracingPlotI( "weapons", array_size(weapon_stack) );
+   /* Handle types. */
+   switch (w->outfit->type) {
 
-   for (int i=0; i<array_size(weapon_stack); i++) {
+      /* most missiles behave the same */
+      case OUTFIT_TYPE_LAUNCHER:
+      case OUTFIT_TYPE_TURRET_LAUNCHER:
+         w->timer -= dt;
+         if (w->timer < 0.)
+            return 1;
+         break;
+
+      case OUTFIT_TYPE_BOLT:
+      case OUTFIT_TYPE_TURRET_BOLT:
+         w->timer -= dt;
+         if (w->timer < 0.)
+            return 1;
+         else if (w->timer < w->falloff)
+            w->strength = w->timer / w->falloff * w->strength_base;
+         break;
+
+      /* Beam weapons handled a part. */
+      case OUTFIT_TYPE_BEAM:
+      case OUTFIT_TYPE_TURRET_BEAM:
+         /* Beams don't have inherent accuracy, so we use the
+          * heatAccuracyMod to modulate duration. */
+         w->timer -= dt / (1.-pilot_heatAccuracyMod(w->mount->heat_T));
+         if (w->timer < 0. || (w->outfit->u.bem.min_duration > 0. &&
+               w->mount->stimer < 0.))
+            return 1;
+         /* We use the explosion timer to tell when we have to create explosions. */
+         w->timer2 -= dt;
+         if (w->timer2 < -1.)
+            w->timer2 = 0.100;
+         break;
+      default:
+         WARN(_("Weapon of type '%s' has no update implemented yet!"),
+               w->outfit->name);
+         break;
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Makes a weapon that ran out of time miss.
+ *
+ *    @param w Weapon to expire.
+ */
+static void weapon_expire( Weapon* w )
+{
+   if (outfit_isBeam(w->outfit)) {
+      const Pilot *p = pilot_get(w->parent);
+      if (p != NULL)
+         pilot_stopBeam(p, w->mount);
+   }
+   weapon_miss(w);
+}
+
+/**
+ * @brief Looks for the collisions of a partition of the weapon stack.
+ *
+ * Only modifies the weapons in the partition, hits are stored as candidates
+ * to be applied afterwards by weapon_collideApply.
+ *
+ *    @param data WeaponCollideChunk to process.
+ *    @return 0 always.
+ */
+static int weapons_updateCollideThread( void *data )
+{
+   WeaponCollideChunk *chunk = data;
+
+   array_resize( &chunk->cands, 0 );
+   for (int i=chunk->start; i<chunk->end; i++) {
       Weapon *w = &weapon_stack[i];
+      WeaponCollision wc;
+      int x1, y1, x2, y2;
 
       /* Ignore destroyed wapons. */
       if (weapon_isFlag(w, WEAPON_FLAG_DESTROYED))
          continue;
 
-      /* Handle types. */
-      switch (w->outfit->type) {
+      /* Expiring is deferred to keep the order. */
+      if (weapon_updateTimer( w, chunk->dt )) {
+         WeaponCandidate *cand = &array_grow( &chunk->cands );
+         cand->weapon   = i;
+         cand->expired  = 1;
+         continue;
+      }
 
-         /* most missiles behave the same */
-         case OUTFIT_TYPE_LAUNCHER:
-         case OUTFIT_TYPE_TURRET_LAUNCHER:
-            w->timer -= dt;
-            if (w->timer < 0.)
-               weapon_miss(w);
-            break;
+      weapon_collideSetup( w, &wc, &x1, &y1, &x2, &y2 );
+      weapon_collideFind( w, i, &wc, x1, y1, x2, y2,
+            &chunk->qtquery, &chunk->qtscratch, &chunk->cands );
+   }
+   return 0;
+}
 
-         case OUTFIT_TYPE_BOLT:
-         case OUTFIT_TYPE_TURRET_BOLT:
-            w->timer -= dt;
-            if (w->timer < 0.) {
-               weapon_miss(w);
-               break;
-            }
-            else if (w->timer < w->falloff)
-               w->strength = w->timer / w->falloff * w->strength_base;
-            break;
+/**
+ * @brief Handles weapon collisions.
+ *
+ * With many weapons, the collisions are first looked for in parallel and then
+ * applied serially in weapon stack order so that the results do not depend on
+ * the threading.
+ */
+void weapons_updateCollide( double dt )
+{
+   int n, nchunks, serial;
 
-         /* Beam weapons handled a part. */
-         case OUTFIT_TYPE_BEAM:
-         case OUTFIT_TYPE_TURRET_BEAM:
-            /* Beams don't have inherent accuracy, so we use the
-             * heatAccuracyMod to modulate duration. */
-            w->timer -= dt / (1.-pilot_heatAccuracyMod(w->mount->heat_T));
-            if (w->timer < 0. || (w->outfit->u.bem.min_duration > 0. &&
-                  w->mount->stimer < 0.)) {
-               const Pilot *p = pilot_get(w->parent);
-               if (p != NULL)
-                  pilot_stopBeam(p, w->mount);
-               weapon_miss(w);
-               break;
-            }
-            /* We use the explosion timer to tell when we have to create explosions. */
-            w->timer2 -= dt;
-            if (w->timer2 < -1.)
-               w->timer2 = 0.100;
-            break;
-         default:
-            WARN(_("Weapon of type '%s' has no update implemented yet!"),
-                  w->outfit->name);
-            break;
+   NTracingZone( _ctx, 1 );
+   NTracingPlotI( "weapons", array_size(weapon_stack) );
+
+   /* Not worth the threading overhead. */
+   n = array_size(weapon_stack);
+   nchunks = MIN( weapon_ncollideChunks, n / WEAPON_COLLIDE_CHUNK_MIN );
+   if ((n < WEAPON_COLLIDE_THREADED_MIN) || (nchunks <= 1))
+      serial = 0;
+   else {
+      int size = (n + nchunks - 1) / nchunks;
+
+      /* Find the candidates. */
+      if (weapon_collideQueue == NULL)
+         weapon_collideQueue = vpool_create();
+      for (int i=0; i<nchunks; i++) {
+         WeaponCollideChunk *chunk = &weapon_collideChunks[i];
+         chunk->start = i * size;
+         chunk->end   = MIN( n, (i+1) * size );
+         chunk->dt    = dt;
+         vpool_enqueue( weapon_collideQueue, weapons_updateCollideThread, chunk );
+      }
+      vpool_wait( weapon_collideQueue );
+
+      /* Apply them, partitions are contiguous so this is in weapon order. */
+      for (int i=0; i<nchunks; i++) {
+         const WeaponCollideChunk *chunk = &weapon_collideChunks[i];
+         int ncands = array_size(chunk->cands);
+         for (int j=0; j<ncands; ) {
+            int k = j+1;
+            while ((k < ncands) && (chunk->cands[k].weapon == chunk->cands[j].weapon))
+               k++;
+            weapon_collideApply( &chunk->cands[j], k-j, dt );
+            j = k;
+         }
       }
 
-      /* Only increment if weapon wasn't destroyed. */
-      if (!weapon_isFlag(w, WEAPON_FLAG_DESTROYED))
+      /* Weapons created while applying get handled serially. */
+      serial = n;
+   }
+
+   for (int i=serial; i<array_size(weapon_stack); i++) {
+      Weapon *w = &weapon_stack[i];
+
+      /* Ignore destroyed wapons. */
+      if (weapon_isFlag(w, WEAPON_FLAG_DESTROYED))
+         continue;
+
+      if (weapon_updateTimer( w, dt ))
+         weapon_expire( w );
+      else
          weapon_updateCollide( w, dt );
    }
 
@@ -717,11 +1111,37 @@ void weapons_update( double dt )
 {
    NTracingZone( _ctx, 1 );
 
+   if (weapon_stack != NULL)
+      memstats_set( MEMTAG_WEAPONS, (int64_t)array_reserved(weapon_stack) * sizeof(Weapon) );
+
+   /* Smart weapons get to think their next move first. */
+   array_resize( &weapon_solids, 0 );
+   array_resize( &weapon_seekers, 0 );
    for (int i=0; i<array_size(weapon_stack); i++) {
       Weapon *w = &weapon_stack[i];
       /* Only increment if weapon wasn't destroyed. */
+      if (weapon_isFlag(w, WEAPON_FLAG_DESTROYED))
+         continue;
+      /* Seekers chasing pilots think together afterwards. */
+      if ((w->think==think_seeker) && (w->target.type==TARGET_PILOT)) {
+         SeekerEntry *e = &array_grow( &weapon_seekers );
+         e->w     = i;
+         e->tgt   = -1;
+         e->steer = 0;
+      }
+      else if (w->think!=NULL)
+         (*w->think)( w, dt );
+      array_push_back( &weapon_solids, &w->solid );
+   }
+   weapons_thinkSeekers( dt );
+
+   /* Then they all move together. */
+   solid_updateBatch( weapon_solids, NULL, dt, array_size(weapon_solids) );
+
+   for (int i=0; i<array_size(weapon_stack); i++) {
+      Weapon *w = &weapon_stack[i];
       if (!weapon_isFlag(w, WEAPON_FLAG_DESTROYED))
-         weapon_update( w, dt );
+         weapon_updateMoved( w );
    }
 
    NTracingZoneEnd( _ctx );
@@ -737,15 +1157,54 @@ void weapons_render( const WeaponLayer layer, double dt )
 {
    NTracingZone( _ctx, 1 );
 
+   /* Sprites are drawn together by texture at the end. */
+   gl_batchBegin();
    for (int i=0; i<array_size(weapon_stack); i++) {
       Weapon *w = &weapon_stack[i];
       if (w->layer==layer)
          weapon_render( w, dt );
    }
+   gl_batchEnd();
 
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Stores the positions of the weapons before a fixed update.
+ */
+void weapons_interpStore (void)
+{
+   for (int i=0; i<array_size(weapon_stack); i++)
+      weapon_stack[i].solid.interp = weapon_stack[i].solid.pos;
+}
+
+/**
+ * @brief Moves the weapons to where they are rendered between fixed updates.
+ *
+ * Has to be followed by weapons_interpEnd once done rendering.
+ *
+ *    @param alpha Fraction of a fixed update left over after the last one.
+ *    @param step Game time of the last fixed update.
+ */
+void weapons_interpBegin( double alpha, double step )
+{
+   if (weapon_interpSaved == NULL)
+      weapon_interpSaved = array_create( vec2 );
+   array_resize( &weapon_interpSaved, array_size(weapon_stack) );
+   for (int i=0; i<array_size(weapon_stack); i++)
+      weapon_interpSaved[i] = solid_interpolate( &weapon_stack[i].solid, alpha, step );
+}
+
+/**
+ * @brief Puts the weapons back where they really are after rendering.
+ */
+void weapons_interpEnd (void)
+{
+   int n = MIN( array_size(weapon_interpSaved), array_size(weapon_stack) );
+   for (int i=0; i<n; i++)
+      weapon_stack[i].solid.pos = weapon_interpSaved[i];
+}
+
 static void weapon_renderBeam( Weapon* w, double dt )
 {
    double x, y, z;
@@ -786,7 +1245,7 @@ static void weapon_renderBeam( Weapon* w, double dt )
       glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &w->outfit->u.bem.shader );
 
    /* Draw. */
-   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+   gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.beam.vertex );
@@ -908,7 +1367,7 @@ static void weapon_render( Weapon* w, double dt )
                glEnableVertexAttribArray( gfx->vertex );
                gl_vboActivateAttribOffset( gl_circleVBO, gfx->vertex, 0, 2, GL_FLOAT, 0 );
 
-               glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+               gl_drawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
                glDisableVertexAttribArray(gfx->vertex);
                glUseProgram(0);
@@ -1012,6 +1471,28 @@ static int weapon_checkCanHit( const Weapon* w, const Pilot *p )
  */
 static int weapon_testCollision( const WeaponCollision *wc, const glTexture *ctex,
    int csx, int csy, const Solid *csol, const CollPoly *cpol, double cradius, vec2 crash[2] )
+{
+   int ret = weapon_testCollisionStatic( wc, ctex, csx, csy, csol, cpol, cradius, crash );
+   if ((ret == 0) && wc->ccd)
+      ret = weapon_testCollisionSwept( wc, ctex, csx, csy, csol, cpol, cradius, crash );
+   return ret;
+}
+
+/**
+ * @brief Tests to see if a weapon collides with a ship at its current position.
+ *
+ *    @param wc Weapon collision data.
+ *    @param ctex Collision target texture.
+ *    @param csx Collision target texture x sprite.
+ *    @param csy Collision target texture y sprite.
+ *    @param csol Collision target solid.
+ *    @param cpol Collision target collision polygon (NULL if none).
+ *    @param cradius Collision radius fallback (if no texture and polygon are provided).
+ *    @param[out] crash Crash location, which is only set if collision is detected.
+ *    @return Number of collisions detected (0 to 2)
+ */
+static int weapon_testCollisionStatic( const WeaponCollision *wc, const glTexture *ctex,
+   int csx, int csy, const Solid *csol, const CollPoly *cpol, double cradius, vec2 crash[2] )
 {
    const Weapon *w = wc->w;
    vec2 wipos, cipos; /* Interpolated positions. */
@@ -1164,54 +1645,101 @@ static int weapon_testCollision( const WeaponCollision *wc, const glTexture *cte
 }
 
 /**
- * @brief Updates an individual weapon.
+ * @brief Tests to see if a weapon collides with a ship anywhere along its
+ *        movement during the last update.
  *
- *    @param w Weapon to update.
- *    @param dt Current delta tick.
+ * The movement of the weapon relative to the target is tested as a line, so
+ *  fast weapons can not go through targets between updates.
+ *
+ *    @param wc Weapon collision data.
+ *    @param ctex Collision target texture.
+ *    @param csx Collision target texture x sprite.
+ *    @param csy Collision target texture y sprite.
+ *    @param csol Collision target solid.
+ *    @param cpol Collision target collision polygon (NULL if none).
+ *    @param cradius Collision radius fallback (if no texture and polygon are provided).
+ *    @param[out] crash Crash location, which is only set if collision is detected.
+ *    @return Number of collisions detected (0 to 2)
  */
-static void weapon_updateCollide( Weapon* w, double dt )
+static int weapon_testCollisionSwept( const WeaponCollision *wc, const glTexture *ctex,
+   int csx, int csy, const Solid *csol, const CollPoly *cpol, double cradius, vec2 crash[2] )
 {
-   vec2 crash[2];
-   WeaponCollision wc;
-   Pilot *const* pilot_stack = pilot_getAll();
-   int x1, y1, x2, y2;
+   const Weapon *w = wc->w;
+   vec2 start;
+   double dx, dy, len;
+
+   /* Where the weapon started relative to the current position of the target. */
+   start.x = w->solid.pre.x + csol->pos.x - csol->pre.x;
+   start.y = w->solid.pre.y + csol->pos.y - csol->pre.y;
+   dx  = w->solid.pos.x - start.x;
+   dy  = w->solid.pos.y - start.y;
+   len = MOD( dx, dy );
+
+   /* Movements smaller than the weapon are already handled by the static test. */
+   if (len <= wc->range)
+      return 0;
+
+   if (cpol != NULL) {
+      int k = ctex->sx * csy + csx;
+      return CollideLinePolygon( &start, ANGLE( dx, dy ), len, &cpol[k], &csol->pos, crash );
+   }
+   else if (ctex != NULL)
+      return CollideLineSprite( &start, ANGLE( dx, dy ), len, ctex, csx, csy, &csol->pos, crash );
+   else
+      return CollideLineCircle( &start, &w->solid.pos, &csol->pos, cradius + wc->range, crash );
+}
 
+/**
+ * @brief Sets up the collision data of a weapon.
+ *
+ * Only modifies the weapon itself.
+ *
+ *    @param w Weapon to set up.
+ *    @param[out] wc Collision data of the weapon.
+ *    @param[out] x1 Left of the quadtree query.
+ *    @param[out] y1 Bottom of the quadtree query.
+ *    @param[out] x2 Right of the quadtree query.
+ *    @param[out] y2 Top of the quadtree query.
+ */
+static void weapon_collideSetup( Weapon* w, WeaponCollision *wc, int *x1, int *y1, int *x2, int *y2 )
+{
    /* Get the sprite direction to speed up calculations. */
-   wc.explosion   = 0;
-   wc.w           = w;
-   wc.beam        = outfit_isBeam(w->outfit);
-   if (!wc.beam) {
+   wc->explosion  = 0;
+   wc->w          = w;
+   wc->beam       = outfit_isBeam(w->outfit);
+   wc->ccd        = !wc->beam && outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_CCD );
+   if (!wc->beam) {
       int x, y, w2, h2, px, py;
-      wc.gfx = outfit_gfx(w->outfit);
-      if (wc.gfx->tex != NULL) {
+      wc->gfx = outfit_gfx(w->outfit);
+      if (wc->gfx->tex != NULL) {
          const CollPoly *plg = outfit_plg(w->outfit);
          if (plg!=NULL) {
             int n;
-            gl_getSpriteFromDir( &w->sx, &w->sy, wc.gfx->tex, w->solid.dir );
-            n = wc.gfx->tex->sx * w->sy + w->sx;
-            wc.polygon = &plg[n];
+            gl_getSpriteFromDir( &w->sx, &w->sy, wc->gfx->tex, w->solid.dir );
+            n = wc->gfx->tex->sx * w->sy + w->sx;
+            wc->polygon = &plg[n];
          }
          else
-            wc.polygon = NULL;
-         wc.range = wc.gfx->size; /* Range is set to size in this case. */
+            wc->polygon = NULL;
+         wc->range = wc->gfx->size; /* Range is set to size in this case. */
       }
       else {
-         wc.polygon = NULL;
-         wc.range = wc.gfx->col_size;
+         wc->polygon = NULL;
+         wc->range = wc->gfx->col_size;
       }
-      wc.beamrange = 0.;
+      wc->beamrange = 0.;
 
       /* Determine quadtree location. */
       x  = round(w->solid.pos.x);
       y  = round(w->solid.pos.y);
       px = x+round(w->solid.pre.x);
       py = y+round(w->solid.pre.y);
-      w2 = ceil(wc.range * 0.5);
-      h2 = ceil(wc.range * 0.5);
-      x1 = MIN(x,px)-w2;
-      y1 = MIN(y,py)-h2;
-      x2 = MAX(x,px)+w2;
-      y2 = MAX(y,py)+h2;
+      w2 = ceil(wc->range * 0.5);
+      h2 = ceil(wc->range * 0.5);
+      *x1 = MIN(x,px)-w2;
+      *y1 = MIN(y,py)-h2;
+      *x2 = MAX(x,px)+w2;
+      *y2 = MAX(y,py)+h2;
    }
    else {
       Pilot *p = pilot_get( w->parent );
@@ -1228,76 +1756,180 @@ static void weapon_updateCollide( Weapon* w, double dt )
          }
          w->dam_as_dis_mod = CLAMP( 0., 1., w->dam_as_dis_mod );
       }
-      wc.gfx = NULL;
-      wc.polygon = NULL;
-      wc.range = w->outfit->u.bem.width*0.5; /* Set beam range. */
-      wc.beamrange = w->outfit->u.bem.range; /* Set beam range. */
+      wc->gfx = NULL;
+      wc->polygon = NULL;
+      wc->range = w->outfit->u.bem.width*0.5; /* Set beam range. */
+      wc->beamrange = w->outfit->u.bem.range; /* Set beam range. */
 
       /* Determine quadtree location. */
-      x1 = round(w->solid.pos.x);
-      y1 = round(w->solid.pos.y);
-      x2 = x1 + ceil( w->outfit->u.bem.range * cos(w->solid.dir) );
-      y2 = y1 + ceil( w->outfit->u.bem.range * sin(w->solid.dir) );
-      if (x1 > x2) {
-         int t = x1;
-         x1 = x2;
-         x2 = t;
+      *x1 = round(w->solid.pos.x);
+      *y1 = round(w->solid.pos.y);
+      *x2 = *x1 + ceil( w->outfit->u.bem.range * cos(w->solid.dir) );
+      *y2 = *y1 + ceil( w->outfit->u.bem.range * sin(w->solid.dir) );
+      if (*x1 > *x2) {
+         int t = *x1;
+         *x1 = *x2;
+         *x2 = t;
       }
-      if (y1 > y2) {
-         int t = y1;
-         y1 = y2;
-         y2 = t;
+      if (*y1 > *y2) {
+         int t = *y1;
+         *y1 = *y2;
+         *y2 = t;
       }
    }
+}
+
+/**
+ * @brief Gets the number of pieces to split the spatial queries of a weapon in.
+ *
+ * The bounding box of a long diagonal beam covers a huge area, so beams get
+ *  queried piece by piece along their length instead.
+ */
+static int weapon_beamPieces( const WeaponCollision *wc )
+{
+   if (!wc->beam)
+      return 1;
+   return MAX( 1, (int)ceil( wc->beamrange / WEAPON_BEAM_PIECE ) );
+}
+
+/**
+ * @brief Gets the bounding box of a piece of a beam.
+ *
+ *    @param w Beam weapon.
+ *    @param wc Collision data of the weapon.
+ *    @param k Piece to get, starting from the beam origin.
+ *    @param n Total number of pieces.
+ *    @param[out] x1 Left of the piece.
+ *    @param[out] y1 Bottom of the piece.
+ *    @param[out] x2 Right of the piece.
+ *    @param[out] y2 Top of the piece.
+ */
+static void weapon_beamPiece( const Weapon *w, const WeaponCollision *wc, int k, int n,
+      int *x1, int *y1, int *x2, int *y2 )
+{
+   double c  = cos(w->solid.dir) * wc->beamrange / (double)n;
+   double s  = sin(w->solid.dir) * wc->beamrange / (double)n;
+   double ax = w->solid.pos.x + c*k;
+   double ay = w->solid.pos.y + s*k;
+   double bx = ax + c;
+   double by = ay + s;
+   *x1 = floor( MIN( ax, bx ) );
+   *y1 = floor( MIN( ay, by ) );
+   *x2 = ceil( MAX( ax, bx ) );
+   *y2 = ceil( MAX( ay, by ) );
+}
+
+/**
+ * @brief Checks to see if an object was already hit by a weapon.
+ *
+ * Beam pieces overlap at the ends, so objects near the boundary can show up in
+ *  more than one query.
+ *
+ *    @param cands Candidates found so far (array.h).
+ *    @param start First candidate of the current weapon.
+ *    @param type Type of the object.
+ *    @param obj Pilot or asteroid to look for.
+ *    @param wpn Index of the weapon to look for.
+ *    @return 1 if the object is already a candidate.
+ */
+static int weapon_candFound( WeaponCandidate *const* cands, int start, TargetType type,
+      const void *obj, int wpn )
+{
+   for (int i=start; i<array_size(*cands); i++) {
+      const WeaponCandidate *cand = &(*cands)[i];
+      if (cand->type != type)
+         continue;
+      if (((type == TARGET_PILOT) && (cand->u.plt == obj)) ||
+            ((type == TARGET_ASTEROID) && (cand->u.ast == obj)) ||
+            ((type == TARGET_WEAPON) && (cand->u.wpn == wpn)))
+         return 1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Looks for the collisions of a weapon without applying them.
+ *
+ * Does not modify anything but the candidates and scratch memory, so it can be
+ * run from multiple threads with different candidates and scratch memory.
+ * Non-beam weapons stop at the first candidate, since they get destroyed.
+ * Beams are queried in pieces going away from their origin, so the
+ * candidates are found roughly in the order the beam crosses them.
+ *
+ *    @param w Weapon to check.
+ *    @param wid Index of the weapon in the weapon stack.
+ *    @param wc Collision data of the weapon.
+ *    @param x1 Left of the quadtree query.
+ *    @param y1 Bottom of the quadtree query.
+ *    @param x2 Right of the quadtree query.
+ *    @param y2 Top of the quadtree query.
+ *    @param qtquery List to use for the quadtree queries.
+ *    @param qtscratch Scratch memory to use for the quadtree queries.
+ *    @param[out] cands Array to append the candidates to (array.h).
+ */
+static void weapon_collideFind( const Weapon* w, int wid, const WeaponCollision *wc,
+      int x1, int y1, int x2, int y2, IntList *qtquery, QuadtreeScratch *qtscratch,
+      WeaponCandidate **cands )
+{
+   vec2 crash[2];
+   Pilot *const* pilot_stack = pilot_getAll();
+   int npieces = weapon_beamPieces( wc );
+   int start = array_size( *cands );
 
    /* Get colliding pilots. */
    if (!outfit_isProp(w->outfit,OUTFIT_PROP_WEAP_MISS_SHIPS)) {
-      pilot_collideQueryIL( &weapon_qtquery, x1, y1, x2, y2 );
-      for (int i=0; i<il_size(&weapon_qtquery); i++) {
-         Pilot *p = pilot_stack[ il_get( &weapon_qtquery, i, 0 ) ];
-         WeaponHit hit;
+      for (int k=0; k<npieces; k++) {
+         if (npieces > 1)
+            weapon_beamPiece( w, wc, k, npieces, &x1, &y1, &x2, &y2 );
+         pilot_collideQueryILScratch( qtquery, qtscratch, x1, y1, x2, y2 );
+         for (int i=0; i<il_size(qtquery); i++) {
+            Pilot *p = pilot_stack[ il_get( qtquery, i, 0 ) ];
+            WeaponCandidate *cand;
+
+            /* Ignore pilots being deleted. */
+            if (pilot_isFlag(p, PILOT_DELETE))
+               continue;
 
-         /* Ignore pilots being deleted. */
-         if (pilot_isFlag(p, PILOT_DELETE))
-            continue;
+            /* Ignore if parent is self. */
+            if (w->parent==p->id)
+               continue; /* pilot is self */
 
-         /* Ignore if parent is self. */
-         if (w->parent==p->id)
-            continue; /* pilot is self */
+            /* Smart weapons only collide with their target */
+            if (outfit_isSeeker(w->outfit)) {
+               int isjammed = ((w->status == WEAPON_STATUS_JAMMED) || (w->status == WEAPON_STATUS_JAMMED_SLOWED));
+               if (!isjammed && (w->target.type==TARGET_PILOT) && (p->id != w->target.u.id))
+                  continue;
+            }
 
-         /* Smart weapons only collide with their target */
-         if (outfit_isSeeker(w->outfit)) {
-            int isjammed = ((w->status == WEAPON_STATUS_JAMMED) || (w->status == WEAPON_STATUS_JAMMED_SLOWED));
-            if (!isjammed && (w->target.type==TARGET_PILOT) && (p->id != w->target.u.id))
-               continue;
-         }
+            /* Check if only hit target. */
+            if (weapon_isFlag(w,WEAPON_FLAG_ONLYHITTARGET)) {
+               if ((w->target.type==TARGET_PILOT) && (p->id != w->target.u.id))
+                  continue;
+            }
 
-         /* Check if only hit target. */
-         if (weapon_isFlag(w,WEAPON_FLAG_ONLYHITTARGET)) {
-            if ((w->target.type==TARGET_PILOT) && (p->id != w->target.u.id))
+            /* Check to see if it can hit. */
+            if (!weapon_checkCanHit(w,p))
                continue;
-         }
 
-         /* Check to see if it can hit. */
-         if (!weapon_checkCanHit(w,p))
-            continue;
+            /* Already hit by an earlier piece. */
+            if ((k > 0) && weapon_candFound( cands, start, TARGET_PILOT, p, 0 ))
+               continue;
 
-         /* Test if hit. */
-         if (!weapon_testCollision( &wc, p->ship->gfx_space, p->tsx, p->tsy,
-               &p->solid, p->ship->polygon, 0., crash ))
-            continue;
+            /* Test if hit. */
+            if (!weapon_testCollision( wc, p->ship->gfx_space, p->tsx, p->tsy,
+                  &p->solid, p->ship->polygon, 0., crash ))
+               continue;
 
-         /* Handle the hit. */
-         hit.type    = TARGET_PILOT;
-         hit.u.plt   = p;
-         hit.pos     = crash;
-         if (wc.beam)
-            weapon_hitBeam( w, &hit, dt );
-            /* No return because beam can still think, it's not
-            * destroyed like the other weapons.*/
-         else {
-            weapon_hit( w, &hit );
-            return; /* Weapon is destroyed. */
+            /* Store the hit. */
+            cand = &array_grow( cands );
+            cand->weapon   = wid;
+            cand->expired  = 0;
+            cand->type     = TARGET_PILOT;
+            cand->u.plt    = p;
+            cand->crash[0] = crash[0];
+            cand->crash[1] = crash[1];
+            if (!wc->beam)
+               return; /* Weapon will be destroyed. */
          }
       }
    }
@@ -1305,91 +1937,183 @@ static void weapon_updateCollide( Weapon* w, double dt )
    /* Collide with asteroids. */
    if (!outfit_isProp(w->outfit,OUTFIT_PROP_WEAP_MISS_ASTEROIDS)) {
       for (int i=0; i<array_size(cur_system->asteroids); i++) {
-         AsteroidAnchor *ast = &cur_system->asteroids[i];
+         const AsteroidAnchor *ast = &cur_system->asteroids[i];
 
          /* Early in-range check with the asteroid field.
           * Since range for beam weapons is set to width, we have to use the max. */
          if (vec2_dist2( &w->solid.pos, &ast->pos ) >
-               pow2( ast->radius + ast->margin + MAX(wc.range, wc.beamrange) ))
+               pow2( ast->radius + ast->margin + MAX(wc->range, wc->beamrange) ))
             continue;
 
          /* Quadtree collisions. */
-         asteroid_collideQueryIL( ast, &weapon_qtquery, x1, y1, x2, y2 );
-         for (int j=0; j<il_size(&weapon_qtquery); j++) {
-            Asteroid *a = &ast->asteroids[ il_get( &weapon_qtquery, j, 0 ) ];
-            int coll;
-            WeaponHit hit;
+         for (int k=0; k<npieces; k++) {
+            if (npieces > 1)
+               weapon_beamPiece( w, wc, k, npieces, &x1, &y1, &x2, &y2 );
+            asteroid_collideQueryILScratch( ast, qtquery, qtscratch, x1, y1, x2, y2 );
+            for (int j=0; j<il_size(qtquery); j++) {
+               Asteroid *a = &ast->asteroids[ il_get( qtquery, j, 0 ) ];
+               int coll;
+               WeaponCandidate *cand;
+
+               if (a->state != ASTEROID_FG)
+                  continue;
+
+               /* Already hit by an earlier piece. */
+               if ((k > 0) && weapon_candFound( cands, start, TARGET_ASTEROID, a, 0 ))
+                  continue;
+
+               coll = weapon_testCollision( wc, a->gfx, 0, 0, &a->sol, asteroid_polygon( a ), 0., crash );
+
+               /* Missed. */
+               if (!coll)
+                  continue;
+
+               /* Store the hit. */
+               cand = &array_grow( cands );
+               cand->weapon   = wid;
+               cand->expired  = 0;
+               cand->type     = TARGET_ASTEROID;
+               cand->u.ast    = a;
+               cand->crash[0] = crash[0];
+               cand->crash[1] = crash[1];
+               if (!wc->beam)
+                  return; /* Weapon will be destroyed. */
+            }
+         }
+      }
+   }
 
-            if (a->state != ASTEROID_FG)
+   /* Finally do a point defense test. */
+   if (outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_POINTDEFENSE )) {
+      for (int k=0; k<npieces; k++) {
+         if (npieces > 1)
+            weapon_beamPiece( w, wc, k, npieces, &x1, &y1, &x2, &y2 );
+         qt_query_scratch( &weapon_quadtree, qtscratch, qtquery, x1, y1, x2, y2 );
+         for (int i=0; i<il_size(qtquery); i++) {
+            int hid = il_get( qtquery, i, 0 );
+            const Weapon *whit = &weapon_stack[ hid ];
+            const OutfitGFX *gfx;
+            const CollPoly *polygon;
+            double range;
+            int coll, sx, sy;
+            WeaponCandidate *cand;
+
+            /* Already hit by an earlier piece. */
+            if ((k > 0) && weapon_candFound( cands, start, TARGET_WEAPON, NULL, hid ))
                continue;
 
-            if (a->polygon->npt!=0) {
-               CollPoly rpoly;
-               RotatePolygon( &rpoly, a->polygon, (float) a->ang );
-               coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, &rpoly, 0., crash );
-               free(rpoly.x);
-               free(rpoly.y);
+            /* We can only hit ammo weapons, so no beams. The sprite is computed
+             * locally as the other weapon may be getting updated at the same time. */
+            sx = sy = 0;
+            gfx = outfit_gfx(w->outfit);
+            if (gfx->tex != NULL) {
+               gl_getSpriteFromDir( &sx, &sy, gfx->tex, w->solid.dir );
+               polygon = outfit_plg(w->outfit);
+               range = gfx->size; /* Range is set to size in this case. */
+            }
+            else {
+               polygon = NULL;
+               range = gfx->col_size;
             }
-            else
-               coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, NULL, 0., crash );
 
-            /* Missed. */
+            /* Do the real collision test. */
+            coll = weapon_testCollision( wc, gfx->tex, sx, sy, &whit->solid, polygon, range, crash );
             if (!coll)
                continue;
 
-            /* Handle the hit. */
-            hit.type    = TARGET_ASTEROID;
-            hit.u.ast   = a;
-            hit.pos     = crash;
-            if (wc.beam)
-               weapon_hitBeam( w, &hit, dt );
-            else {
-               weapon_hit( w, &hit );
-               return; /* Weapon is destroyed. */
-            }
+            /* Store the hit. */
+            cand = &array_grow( cands );
+            cand->weapon   = wid;
+            cand->expired  = 0;
+            cand->type     = TARGET_WEAPON;
+            cand->u.wpn    = hid;
+            cand->crash[0] = crash[0];
+            cand->crash[1] = crash[1];
+            if (!wc->beam)
+               return; /* Weapon will be destroyed. */
          }
       }
    }
+}
 
-   /* Finally do a point defense test. */
-   if (outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_POINTDEFENSE )) {
-      qt_query( &weapon_quadtree, &weapon_qtquery, x1, y1, x2, y2 );
-      for (int i=0; i<il_size(&weapon_qtquery); i++) {
-         Weapon *whit = &weapon_stack[ il_get( &weapon_qtquery, i, 0 ) ];
-         WeaponCollision wchit;
-         int coll;
-         WeaponHit hit;
+/**
+ * @brief Checks to see if a collision candidate is still valid.
+ *
+ *    @param w Weapon of the candidate.
+ *    @param cand Candidate to check.
+ *    @return 1 if the hit should still be applied, 0 otherwise.
+ */
+static int weapon_collideValid( const Weapon* w, const WeaponCandidate *cand )
+{
+   switch (cand->type) {
+      case TARGET_PILOT:
+         if (pilot_isFlag(cand->u.plt, PILOT_DELETE))
+            return 0;
+         return weapon_checkCanHit( w, cand->u.plt );
 
-         /* We can only hit ammo weapons, so no beams. */
-         wchit.w        = whit;
-         wchit.explosion= 0;
-         wchit.beam     = 0;
-         wchit.gfx      = outfit_gfx(w->outfit);
-         if (wchit.gfx->tex != NULL) {
-            gl_getSpriteFromDir( &whit->sx, &whit->sy, wchit.gfx->tex, w->solid.dir );
-            wchit.polygon = outfit_plg(w->outfit);
-            wchit.range = wchit.gfx->size; /* Range is set to size in this case. */
-         }
-         else {
-            wchit.polygon = NULL;
-            wchit.range = wchit.gfx->col_size;
-         }
+      case TARGET_ASTEROID:
+         return (cand->u.ast->state == ASTEROID_FG);
 
-         /* Do the real collision test. */
-         coll = weapon_testCollision( &wc, wchit.gfx->tex, whit->sx, whit->sy, &whit->solid, wchit.polygon, wchit.range, crash );
-         if (!coll)
-            continue;
+      default:
+         return 1;
+   }
+}
 
-         /* Handle the hit. */
-         hit.type    = TARGET_WEAPON;
-         hit.u.wpn   = whit;
-         hit.pos     = crash;
-         if (wc.beam)
-            weapon_hitBeam( w, &hit, dt );
-         else {
-            weapon_hit( w, &hit );
-            return; /* Weapon is destroyed. */
+/**
+ * @brief Applies the collision candidates of a weapon.
+ *
+ *    @param cands Candidates of the same weapon, in the order they were found.
+ *    @param n Number of candidates.
+ *    @param dt Current delta tick.
+ */
+static void weapon_collideApply( const WeaponCandidate *cands, int n, double dt )
+{
+   int wid = cands[0].weapon;
+
+   /* May have been hit by an earlier weapon. */
+   if (weapon_isFlag(&weapon_stack[wid], WEAPON_FLAG_DESTROYED))
+      return;
+
+   if (cands[0].expired) {
+      weapon_expire( &weapon_stack[wid] );
+      return;
+   }
+
+   for (int i=0; i<n; i++) {
+      const WeaponCandidate *cand = &cands[i];
+      Weapon *w = &weapon_stack[wid];
+      WeaponHit hit;
+
+      if (!weapon_collideValid( w, cand )) {
+         /* The hit is gone, but it may still hit something else. */
+         if (!outfit_isBeam(w->outfit)) {
+            weapon_updateCollide( w, dt );
+            return;
          }
+         continue;
+      }
+
+      hit.type    = cand->type;
+      hit.pos     = cand->crash;
+      switch (cand->type) {
+         case TARGET_PILOT:
+            hit.u.plt = cand->u.plt;
+            break;
+         case TARGET_ASTEROID:
+            hit.u.ast = cand->u.ast;
+            break;
+         default:
+            hit.u.wpn = &weapon_stack[ cand->u.wpn ];
+            break;
+      }
+
+      if (outfit_isBeam(w->outfit))
+         weapon_hitBeam( w, &hit, dt );
+         /* No return because beam can still think, it's not
+          * destroyed like the other weapons.*/
+      else {
+         weapon_hit( w, &hit );
+         return; /* Weapon is destroyed. */
       }
    }
 }
@@ -1400,15 +2124,26 @@ static void weapon_updateCollide( Weapon* w, double dt )
  *    @param w Weapon to update.
  *    @param dt Current delta tick.
  */
-static void weapon_update( Weapon* w, double dt )
+static void weapon_updateCollide( Weapon* w, double dt )
 {
-   /* Smart weapons also get to think their next move */
-   if (w->think!=NULL)
-      (*w->think)( w, dt );
+   WeaponCollision wc;
+   int x1, y1, x2, y2;
 
-   /* Update the solid position. */
-   (*w->solid.update)( &w->solid, dt );
+   weapon_collideSetup( w, &wc, &x1, &y1, &x2, &y2 );
+   array_resize( &weapon_collideCands, 0 );
+   weapon_collideFind( w, w-weapon_stack, &wc, x1, y1, x2, y2,
+         &weapon_qtquery, &weapon_qtscratch, &weapon_collideCands );
+   if (array_size(weapon_collideCands) > 0)
+      weapon_collideApply( weapon_collideCands, array_size(weapon_collideCands), dt );
+}
 
+/**
+ * @brief Updates what follows an individual weapon once it has moved.
+ *
+ *    @param w Weapon that moved.
+ */
+static void weapon_updateMoved( Weapon* w )
+{
    /* Update the sound. */
    sound_updatePos(w->voice, w->solid.pos.x, w->solid.pos.y,
          w->solid.vel.x, w->solid.vel.y);
@@ -1510,6 +2245,7 @@ static void weapon_hitExplode( Weapon *w, const Damage *dmg, double radius )
    wc.range = radius;
    wc.polygon = NULL;
    wc.explosion = 1;
+   wc.ccd   = 0;
 
    /* Set up coordinates. */
    x = round(w->solid.pos.x);
@@ -1555,6 +2291,11 @@ static void weapon_hitExplode( Weapon *w, const Damage *dmg, double radius )
       }
    }
 
+   /* Point defense explosions also take out munitions. */
+   if (outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_POINTDEFENSE ))
+      weapon_explodeMunitions( w->solid.pos.x, w->solid.pos.y, radius, dmg, parent,
+            outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_FRIENDLYFIRE ), w );
+
    /* Test asteroids. */
    if (!outfit_isProp(w->outfit,OUTFIT_PROP_WEAP_MISS_ASTEROIDS)) {
       double mining_bonus = (parent != NULL) ? parent->stats.mining_bonus : 1.;
@@ -1576,15 +2317,7 @@ static void weapon_hitExplode( Weapon *w, const Damage *dmg, double radius )
             if (a->state != ASTEROID_FG)
                continue;
 
-            if (a->polygon->npt!=0) {
-               CollPoly rpoly;
-               RotatePolygon( &rpoly, a->polygon, (float) a->ang );
-               coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, &rpoly, 0., crash );
-               free(rpoly.x);
-               free(rpoly.y);
-            }
-            else
-               coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, NULL, 0., crash );
+            coll = weapon_testCollision( &wc, a->gfx, 0, 0, &a->sol, asteroid_polygon( a ), 0., crash );
 
             /* Missed. */
             if (!coll)
@@ -1807,6 +2540,73 @@ static void weapon_damage( Weapon *w, const Damage *dmg )
    weapon_destroy( w );
 }
 
+/**
+ * @brief Damages the munitions in the radius of an explosion.
+ *
+ * Only hittable weapons are in the weapon quadtree, so a single radius query
+ *  finds all the candidates. Damage falls off with the distance like for
+ *  pilots.
+ *
+ *    @param x X position of the explosion center.
+ *    @param y Y position of the explosion center.
+ *    @param radius Radius of the explosion.
+ *    @param dmg Damage characteristics.
+ *    @param parent Parent of the explosion, NULL if none.
+ *    @param friendlyfire Whether or not the munitions of the parent are hit.
+ *    @param skip Weapon to not damage, NULL if none.
+ */
+static void weapon_explodeMunitions( double x, double y, double radius,
+      const Damage *dmg, const Pilot *parent, int friendlyfire, const Weapon *skip )
+{
+   int qx, qy, qr;
+   double rad2 = pow2(radius);
+   Damage ddmg = *dmg;
+
+   qx = round(x);
+   qy = round(y);
+   qr = ceil(radius);
+   qt_query( &weapon_quadtree, &weapon_qtexpw, qx-qr, qy-qr, qx+qr, qy+qr );
+   for (int i=0; i<il_size(&weapon_qtexpw); i++) {
+      int idx = il_get( &weapon_qtexpw, i, 0 );
+      Weapon *whit;
+      double dist;
+
+      if (idx >= array_size(weapon_stack))
+         continue;
+      whit = &weapon_stack[ idx ];
+      if ((whit == skip) || weapon_isFlag( whit, WEAPON_FLAG_DESTROYED ) ||
+            !weapon_isFlag( whit, WEAPON_FLAG_HITTABLE ))
+         continue;
+      if (!friendlyfire && (parent != NULL) && (whit->parent == parent->id))
+         continue;
+
+      /* Take into account the munition size. */
+      dist = pow2(whit->solid.pos.x-x) + pow2(whit->solid.pos.y-y);
+      dist -= pow2( outfit_gfx(whit->outfit)->col_size * 0.5 );
+      dist = MAX( 0., dist );
+      if (dist > rad2)
+         continue;
+
+      ddmg.damage = dmg->damage * (1. - sqrt(dist / rad2));
+      ddmg.disable = dmg->disable * (1. - sqrt(dist / rad2));
+      weapon_damage( whit, &ddmg );
+   }
+}
+
+/**
+ * @brief Damages the munitions in the radius of an explosion.
+ *
+ *    @param x X position of the explosion center.
+ *    @param y Y position of the explosion center.
+ *    @param radius Radius of the explosion.
+ *    @param dmg Damage characteristics.
+ *    @param parent Parent of the explosion, NULL if none.
+ */
+void weapon_explode( double x, double y, double radius, const Damage *dmg, const Pilot *parent )
+{
+   weapon_explodeMunitions( x, y, radius, dmg, parent, 1, NULL );
+}
+
 /**
  * @brief A beam weapon hit something.
  *
@@ -2560,10 +3360,58 @@ Weapon *weapon_add( PilotOutfitSlot *po, const Outfit *ref,
    return w;
 }
 
+/**
+ * @brief Gets the fly time of a weapon towards a position, reusing the pilot
+ *        aim cache when possible.
+ *
+ *    @param o Weapon to shoot.
+ *    @param p Pilot shooting.
+ *    @param pos Position of the target.
+ *    @param vel Velocity of the target.
+ *    @return The estimated fly time.
+ */
+static double weapon_flyTimeCached( const Outfit *o, Pilot *p, const vec2 *pos, const vec2 *vel )
+{
+   PilotAimCache *ac;
+   double speed;
+   int absolute;
+
+   /* Beams and fighter bays are trivial. */
+   if (outfit_isBeam(o) || outfit_isFighterBay(o))
+      return pilot_weapFlyTime( o, p, pos, vel );
+
+   speed    = outfit_speed(o);
+   absolute = outfit_isLauncher(o) && (o->u.lau.ai != AMMO_AI_UNGUIDED);
+   for (int i=0; i<PILOT_AIMCACHE_SIZE; i++) {
+      ac = &p->aimcache[i];
+      if ((ac->speed == speed) && (ac->absolute == absolute) &&
+            (ac->tpos.x == pos->x) && (ac->tpos.y == pos->y) &&
+            (ac->tvel.x == vel->x) && (ac->tvel.y == vel->y) &&
+            (ac->pos.x == p->solid.pos.x) && (ac->pos.y == p->solid.pos.y) &&
+            (ac->vel.x == p->solid.vel.x) && (ac->vel.y == p->solid.vel.y))
+         return ac->time;
+   }
+
+   /* Replace the oldest entry. */
+   ac = &p->aimcache[ p->aimcache_next ];
+   p->aimcache_next = (p->aimcache_next+1) % PILOT_AIMCACHE_SIZE;
+   ac->speed   = speed;
+   ac->absolute = absolute;
+   ac->pos     = p->solid.pos;
+   ac->vel     = p->solid.vel;
+   ac->tpos    = *pos;
+   ac->tvel    = *vel;
+   ac->time    = pilot_weapFlyTime( o, p, pos, vel );
+   return ac->time;
+}
+
 /**
  * @brief Gets the fly time for a weapon target.
+ *
+ * Turrets sharing a projectile speed all solve the same intercept, so the
+ *  result is cached in the pilot until either the pilot or the target moves.
  */
-double weapon_targetFlyTime( const Outfit *o, const Pilot *p, const Target *t )
+double weapon_targetFlyTime( const Outfit *o, Pilot *p, const Target *t )
 {
    switch (t->type) {
       case TARGET_NONE:
@@ -2573,7 +3421,7 @@ double weapon_targetFlyTime( const Outfit *o, const Pilot *p, const Target *t )
             const Pilot *pt = pilot_get( t->u.id );
             if (pt==NULL)
                return HUGE_VAL;
-            return pilot_weapFlyTime( o, p, &pt->solid.pos, &pt->solid.vel );
+            return weapon_flyTimeCached( o, p, &pt->solid.pos, &pt->solid.vel );
          }
          break;
       case TARGET_WEAPON:
@@ -2581,14 +3429,14 @@ double weapon_targetFlyTime( const Outfit *o, const Pilot *p, const Target *t )
             const Weapon *w = weapon_getID( t->u.id );
             if (w==NULL)
                return HUGE_VAL;
-            return pilot_weapFlyTime( o, p, &w->solid.pos, &w->solid.vel );
+            return weapon_flyTimeCached( o, p, &w->solid.pos, &w->solid.vel );
          }
          break;
       case TARGET_ASTEROID:
          {
             const AsteroidAnchor *field = &cur_system->asteroids[t->u.ast.anchor];
             const Asteroid *ast = &field->asteroids[t->u.ast.asteroid];
-            return pilot_weapFlyTime( o, p, &ast->sol.pos, &ast->sol.vel );
+            return weapon_flyTimeCached( o, p, &ast->sol.pos, &ast->sol.vel );
          }
          break;
    }
@@ -2719,6 +3567,11 @@ void weapon_clear (void)
    /* We can restart the idgen. */
    weapon_idgen = 0; /* May mess up Lua stuff... */
 
+   /* IDs get reused, so quadtree elements can't be kept. */
+   if (qt_init)
+      qt_clear( &weapon_quadtree );
+   array_resize( &weapon_qtElems, 0 );
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -2731,6 +3584,8 @@ void weapon_exit (void)
 
    /* Destroy weapon stack. */
    array_free( weapon_stack );
+   array_free( weapon_interpSaved );
+   weapon_interpSaved = NULL;
 
    /* Destroy VBO. */
    free( weapon_vboData );
@@ -2742,6 +3597,35 @@ void weapon_exit (void)
    qt_destroy( &weapon_quadtree );
    il_destroy( &weapon_qtquery );
    il_destroy( &weapon_qtexp );
+   il_destroy( &weapon_qtexpw );
+   qt_scratch_destroy( &weapon_qtscratch );
+   array_free( weapon_collideCands );
+   array_free( weapon_solids );
+   weapon_solids = NULL;
+   array_free( weapon_seekers );
+   weapon_seekers = NULL;
+   array_free( weapon_seekerOrder );
+   weapon_seekerOrder = NULL;
+   array_free( weapon_seekerTargets );
+   weapon_seekerTargets = NULL;
+   weapon_collideCands = NULL;
+   array_free( weapon_qtElems );
+   weapon_qtElems = NULL;
+
+   /* Clean up threaded collisions. */
+   if (weapon_collideQueue != NULL) {
+      vpool_cleanup( weapon_collideQueue );
+      weapon_collideQueue = NULL;
+   }
+   for (int i=0; i<weapon_ncollideChunks; i++) {
+      WeaponCollideChunk *chunk = &weapon_collideChunks[i];
+      il_destroy( &chunk->qtquery );
+      qt_scratch_destroy( &chunk->qtscratch );
+      array_free( chunk->cands );
+   }
+   free( weapon_collideChunks );
+   weapon_collideChunks = NULL;
+   weapon_ncollideChunks = 0;
 }
 
 const IntList *weapon_collideQuery( int x1, int y1, int x2, int y2 )
@@ -42,43 +42,45 @@ typedef enum WeaponStatus_ {
  * @struct Weapon
  *
  * @brief In-game representation of a weapon.
+ *
+ * Fields are ordered by how often they are used, so that the per tick update
+ *  and collision loops only touch the first few cache lines of each weapon.
  */
 typedef struct Weapon_ {
-   WeaponLayer layer;   /**< Weapon layer. */
+   /* Hot data, used every tick. */
    unsigned int flags;  /**< Weapon flags. */
-   Solid solid;         /**< Actually has its own solid :) */
+   WeaponLayer layer;   /**< Weapon layer. */
    unsigned int id;     /**< Unique weapon id. */
-
+   int qt_elem;         /**< Quadtree element, only valid if owned by the weapon. */
+   Solid solid;         /**< Actually has its own solid :) */
+   const Outfit* outfit; /**< related outfit that fired it or whatnot */
+   void (*think)(struct Weapon_*, double); /**< for the smart missiles */
+   double timer;        /**< mainly used to see when the weapon was fired */
+   double strength;     /**< Calculated with falloff. */
+   double falloff;      /**< Point at which damage falls off. Used to determine slowdown for smart seekers.  */
+   double real_vel;     /**< Keeps track of the real velocity. */
    int faction;         /**< faction of pilot that shot it */
    unsigned int parent; /**< pilot that shot it */
    Target target; /**< Weapon target. */
-   const Outfit* outfit; /**< related outfit that fired it or whatnot */
-
-   double real_vel;     /**< Keeps track of the real velocity. */
+   int sx;              /**< Current X sprite to use. */
+   int sy;              /**< Current Y sprite to use. */
+   double armour;       /**< Health status of the weapon. */
+   double timer2;       /**< Explosion timer for beams, and lockon for ammo. */
    double dam_mod;      /**< Damage modifier. */
    double dam_as_dis_mod; /**< Damage as disable modifier. */
-   int voice;           /**< Weapon's voice. */
-   double timer2;       /**< Explosion timer for beams, and lockon for ammo. */
-   double paramf;       /**< Arbitrary parameter for outfits. */
+   WeaponStatus status; /**< Weapon status - to check for jamming */
+
+   /* Cold data, only used on creation, hits, rendering or from Lua. */
+   double strength_base;/**< Base strength, set via Lua. */
    double life;         /**< Total life. */
-   double timer;        /**< mainly used to see when the weapon was fired */
    double anim;         /**< Used for beam weapon graphics and others. */
    GLfloat r;           /**< Unique random value . */
    int sprite;          /**< Used for spinning outfits. */
+   int voice;           /**< Weapon's voice. */
+   double paramf;       /**< Arbitrary parameter for outfits. */
    PilotOutfitSlot *mount; /**< Used for beam weapons. */
    int lua_mem;         /**< Mem table, in case of a Pilot Outfit. */
-   double falloff;      /**< Point at which damage falls off. Used to determine slowdown for smart seekers.  */
-   double strength;     /**< Calculated with falloff. */
-   double strength_base;/**< Base strength, set via Lua. */
-   int sx;              /**< Current X sprite to use. */
-   int sy;              /**< Current Y sprite to use. */
    Trail_spfx *trail;   /**< Trail graphic if applicable, else NULL. */
-
-   double armour;       /**< Health status of the weapon. */
-
-   void (*think)(struct Weapon_*, double); /**< for the smart missiles */
-
-   WeaponStatus status; /**< Weapon status - to check for jamming */
 } Weapon;
 
 Weapon *weapon_getStack (void);
@@ -91,7 +93,7 @@ Weapon *weapon_add( PilotOutfitSlot *po, const Outfit *ref,
 
 /* Targetting. */
 int weapon_inArc( const Outfit *o, const Pilot *parent, const Target *target, const vec2 *pos, const vec2 *vel, double dir, double time );
-double weapon_targetFlyTime( const Outfit *o, const Pilot *p, const Target *t );
+double weapon_targetFlyTime( const Outfit *o, Pilot *p, const Target *t );
 
 /* Beam weapons. */
 unsigned int beam_start( PilotOutfitSlot *po,
@@ -103,12 +105,16 @@ void beam_end( unsigned int beam );
 void weapon_hitAI( Pilot *p, const Pilot *shooter, double dmg );
 const IntList *weapon_collideQuery( int x1, int y1, int x2, int y2 );
 void weapon_collideQueryIL( IntList *il, int x1, int y1, int x2, int y2 );
+void weapon_explode( double x, double y, double radius, const Damage *dmg, const Pilot *parent );
 
 /* Update. */
 void weapons_updatePurge (void);
 void weapons_updateCollide( double dt );
 void weapons_update( double dt );
 void weapons_render( const WeaponLayer layer, double dt );
+void weapons_interpStore (void);
+void weapons_interpBegin( double alpha, double step );
+void weapons_interpEnd (void);
 
 /* Clean. */
 void weapon_init (void);
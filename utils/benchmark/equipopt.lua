@@ -0,0 +1,15 @@
+-- Quick equipopt benchmark with the default solver parameters, meant to be run with
+-- naev -d . --benchmark-script utils/benchmark/equipopt.lua
+-- The parameter sweeps are in equipopt_glpk_mip.lua and equipopt_glpk_simplex.lua.
+local benchmark = require "utils.benchmark.equipopt_glpk_common"
+
+local reps = 3
+
+print("====== BENCHMARK START ======")
+local bl_mean, bl_stddev, bl_vals = benchmark.run( "Baseline", reps )
+local def_mean, def_stddev, def_vals = benchmark.run( "Defaults", reps, {} )
+print( string.format( "% 10s: %.3f (%.3f) ms", "Baseline", bl_mean, bl_stddev ) )
+print( string.format( "% 10s: %.3f (%.3f) ms", "Defaults", def_mean, def_stddev ) )
+benchmark.report( "equipopt", "baseline", bl_vals )
+benchmark.report( "equipopt", "defaults", def_vals )
+print("====== BENCHMARK END ======")
@@ -61,6 +61,16 @@ function benchmark.run( _testname, reps, sparams )
    return mean, stddev, vals
 end
 
+-- Print the results in the same "benchmark,scenario,stage,count,total ms,ms per count"
+-- format as the engine benchmarks, so they can be grepped from the output.
+function benchmark.report( scenario, testname, vals )
+   local total = 0
+   for k,v in ipairs(vals) do
+      total = total + v
+   end
+   print(string.format("benchmark,%s,%s,%d,%.4f,%.6f", scenario, testname, #vals, total, total / math.max(#vals,1) ))
+end
+
 function benchmark.csv_open( header, reps )
    local csvfile = file.new("benchmark.csv")
    csvfile:open("w")
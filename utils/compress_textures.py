@@ -0,0 +1,77 @@
+#!/usr/bin/python3
+"""
+Generates compressed DDS textures next to the images in the given directories.
+
+The game uses a DDS file instead of the image with the same base name when
+the OpenGL context supports its format. The images are still used for the
+collision transparency maps, so both have to be shipped.
+
+Encoding is done with nvcompress from the NVIDIA Texture Tools, WebP images
+are converted to PNG first with Pillow.
+
+    ./compress_textures.py [--format bc7|bc3|bc1] [--force] DIR [DIR ...]
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+EXTENSIONS = ( '.png', '.webp' )
+
+def needs_update( src, dst, force ):
+    if force or not os.path.exists( dst ):
+        return True
+    return os.path.getmtime( dst ) < os.path.getmtime( src )
+
+def to_png( src, tmpdir ):
+    if src.endswith( '.png' ):
+        return src
+    try:
+        from PIL import Image
+    except ImportError:
+        sys.exit( "Pillow is required to convert '%s'" % src )
+    out = os.path.join( tmpdir, os.path.basename( os.path.splitext( src )[0] ) + '.png' )
+    Image.open( src ).convert( 'RGBA' ).save( out )
+    return out
+
+def compress( src, dst, fmt, tmpdir ):
+    png = to_png( src, tmpdir )
+    cmd = [ 'nvcompress', '-silent', '-srgb', '-'+fmt, png, dst ]
+    ret = subprocess.run( cmd )
+    if ret.returncode != 0:
+        print( "Failed to compress '%s'" % src, file=sys.stderr )
+        return False
+    return True
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser( description='Generates compressed DDS textures next to images.' )
+    parser.add_argument( 'dirs', metavar='DIR', nargs='+', help='Directories to process recursively.' )
+    parser.add_argument( '--format', default='bc7', choices=['bc7','bc3','bc1'], help='Compressed format to use.' )
+    parser.add_argument( '--force', action='store_true', help='Regenerate up to date textures.' )
+    args = parser.parse_args()
+
+    if shutil.which( 'nvcompress' ) is None:
+        sys.exit( "nvcompress not found, install the NVIDIA Texture Tools" )
+
+    done = 0
+    failed = 0
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for d in args.dirs:
+            for root, _, files in os.walk( d ):
+                for f in sorted(files):
+                    base, ext = os.path.splitext( f )
+                    if ext not in EXTENSIONS:
+                        continue
+                    src = os.path.join( root, f )
+                    dst = os.path.join( root, base + '.dds' )
+                    if not needs_update( src, dst, args.force ):
+                        continue
+                    if compress( src, dst, args.format, tmpdir ):
+                        done += 1
+                    else:
+                        failed += 1
+    print( "Compressed %d textures, %d failed" % (done, failed) )
+    sys.exit( 1 if failed > 0 else 0 )